@@ -0,0 +1,168 @@
+#ifndef ASLAM_BENCHMARKS_BENCHMARK_H_
+#define ASLAM_BENCHMARKS_BENCHMARK_H_
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <aslam/common/allocation-counter.h>
+#include <aslam/common/macros.h>
+#include <glog/logging.h>
+
+namespace aslam {
+namespace benchmarks {
+
+/// Latencies in milliseconds and heap allocations of the timed calls of a benchmark.
+struct Measurements {
+  std::vector<double> durations_ms;
+  std::vector<size_t> num_allocations;
+
+  size_t size() const { return durations_ms.size(); }
+  double getMean() const;
+  double getStandardDeviation() const;
+  double getMin() const;
+  /// Nearest-rank percentile in [0, 1], i.e. 1 is the maximum.
+  double getPercentile(double percentile) const;
+  double getMeanNumAllocations() const;
+};
+
+/// \class BenchmarkState
+/// \brief Passed to every benchmark function, which sets up its inputs and then times the
+///        calls under test with run(...) or measure(...). Everything outside of these calls is
+///        neither timed nor counted, e.g.
+///   void benchmarkProjection(BenchmarkState* state) {
+///     const Eigen::Matrix3Xd points = createPoints(kNumPoints);
+///     Eigen::Matrix2Xd keypoints;
+///     std::vector<ProjectionResult> results;
+///     state->setNumItemsPerCall(kNumPoints);
+///     state->run([&]() { camera->project3Vectorized(points, &keypoints, &results); });
+///   }
+class BenchmarkState {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(BenchmarkState);
+
+  BenchmarkState(size_t num_repetitions, size_t num_warmup_repetitions)
+      : num_repetitions_(num_repetitions), num_warmup_repetitions_(num_warmup_repetitions),
+        num_items_per_call_(0u) {
+    CHECK_GT(num_repetitions_, 0u);
+  }
+
+  /// Calls the function num_warmup_repetitions times untimed and then num_repetitions times
+  /// timed. Use measure(...) if the inputs have to be reset between the calls.
+  template <typename Function>
+  void run(const Function& function) {
+    for (size_t i = 0u; i < num_warmup_repetitions_; ++i) {
+      function();
+    }
+    for (size_t i = 0u; i < num_repetitions_; ++i) {
+      measure(function);
+    }
+  }
+
+  /// Times a single call. Benchmarks that use this directly should call it
+  /// getNumRepetitions() times.
+  template <typename Function>
+  void measure(const Function& function) {
+    common::AllocationCounter allocation_counter;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    function();
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    measurements_.num_allocations.push_back(allocation_counter.getNumAllocations());
+    measurements_.durations_ms.push_back(
+        std::chrono::duration<double, std::milli>(end - start).count());
+  }
+
+  size_t getNumRepetitions() const { return num_repetitions_; }
+  size_t getNumWarmupRepetitions() const { return num_warmup_repetitions_; }
+
+  /// Number of processed items per call, e.g. points or keypoints, reported as time per item.
+  void setNumItemsPerCall(size_t num_items_per_call) { num_items_per_call_ = num_items_per_call; }
+  size_t getNumItemsPerCall() const { return num_items_per_call_; }
+
+  /// Additional outputs of the benchmark that are reported as is, e.g. the number of matches.
+  /// They let the comparison tool catch changes of the results along with the timings.
+  void setCounter(const std::string& name, double value) { counters_[name] = value; }
+  const std::map<std::string, double>& getCounters() const { return counters_; }
+
+  const Measurements& getMeasurements() const { return measurements_; }
+
+ private:
+  const size_t num_repetitions_;
+  const size_t num_warmup_repetitions_;
+  size_t num_items_per_call_;
+  std::map<std::string, double> counters_;
+  Measurements measurements_;
+};
+
+typedef std::function<void(BenchmarkState*)> BenchmarkFunction;
+
+struct Benchmark {
+  /// The package the benchmark belongs to, e.g. "cameras".
+  std::string suite;
+  /// Unique within the suite, parameters are appended with slashes, e.g.
+  /// "project3_vectorized/pinhole_radtan/points=10000".
+  std::string name;
+  BenchmarkFunction function;
+
+  std::string getFullName() const { return suite + "/" + name; }
+};
+
+/// \class BenchmarkRegistry
+/// \brief The benchmarks of all suites, in the order of registration.
+class BenchmarkRegistry {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(BenchmarkRegistry);
+  BenchmarkRegistry() = default;
+
+  void add(const std::string& suite, const std::string& name, const BenchmarkFunction& function);
+
+  const std::vector<Benchmark>& getBenchmarks() const { return benchmarks_; }
+
+  /// The benchmarks whose full name contains any of the comma separated patterns, or all
+  /// benchmarks if the filter is empty.
+  std::vector<const Benchmark*> getFilteredBenchmarks(const std::string& filter) const;
+
+ private:
+  std::vector<Benchmark> benchmarks_;
+};
+
+struct BenchmarkResult {
+  std::string suite;
+  std::string name;
+  size_t num_warmup_repetitions;
+  size_t num_items_per_call;
+  std::map<std::string, double> counters;
+  Measurements measurements;
+};
+
+/// Runs the benchmark with the given numbers of repetitions.
+BenchmarkResult runBenchmark(
+    const Benchmark& benchmark, size_t num_repetitions, size_t num_warmup_repetitions);
+
+struct SystemInfo;
+/// Writes the system info and the results as one JSON document, see the schema in
+/// benchmark-runner.cc.
+void writeResultsJson(const SystemInfo& system_info, const std::vector<BenchmarkResult>& results,
+                      std::ostream* out);
+
+/// Writes the string as a quoted JSON string.
+void writeJsonString(const std::string& value, std::ostream* out);
+
+/// Splits a comma separated list, skipping empty items.
+std::vector<std::string> splitList(const std::string& list);
+
+/// Parses a positive decimal integer, e.g. an item of a list flag. Returns false if the string
+/// is not one or doesn't fit a size_t.
+bool parsePositiveInteger(const std::string& string, size_t* value);
+
+/// gflags validator of the flags holding comma separated lists of positive integers, which
+/// reports the invalid items.
+bool validatePositiveIntegerList(const char* flag_name, const std::string& list);
+
+}  // namespace benchmarks
+}  // namespace aslam
+
+#endif  // ASLAM_BENCHMARKS_BENCHMARK_H_
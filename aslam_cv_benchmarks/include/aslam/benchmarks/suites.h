@@ -0,0 +1,35 @@
+#ifndef ASLAM_BENCHMARKS_SUITES_H_
+#define ASLAM_BENCHMARKS_SUITES_H_
+
+#include <cstdint>
+
+#include "aslam/benchmarks/benchmark.h"
+
+namespace aslam {
+namespace benchmarks {
+
+/// Seed of the random inputs of all suites, such that every run times the same inputs.
+constexpr uint32_t kSeed = 42u;
+/// Size of the synthetic images and cameras, the WVGA resolution of common VIO sensors.
+constexpr uint32_t kImageWidth = 752u;
+constexpr uint32_t kImageHeight = 480u;
+
+/// Every suite adds its benchmarks, one per function and parameter set. The names of the suites
+/// are the package names without the aslam_cv_ prefix. Benchmark names and their parameters
+/// must stay stable, the comparison against stored baselines matches results by name.
+void registerCameraBenchmarks(BenchmarkRegistry* registry);
+void registerCommonBenchmarks(BenchmarkRegistry* registry);
+void registerDetectorBenchmarks(BenchmarkRegistry* registry);
+void registerGeometricVisionBenchmarks(BenchmarkRegistry* registry);
+void registerMatcherBenchmarks(BenchmarkRegistry* registry);
+void registerPipelineBenchmarks(BenchmarkRegistry* registry);
+void registerTrackerBenchmarks(BenchmarkRegistry* registry);
+void registerTriangulationBenchmarks(BenchmarkRegistry* registry);
+
+/// All of the above.
+void registerAllBenchmarks(BenchmarkRegistry* registry);
+
+}  // namespace benchmarks
+}  // namespace aslam
+
+#endif  // ASLAM_BENCHMARKS_SUITES_H_
@@ -0,0 +1,26 @@
+#ifndef ASLAM_BENCHMARKS_SYNTHETIC_SCENES_H_
+#define ASLAM_BENCHMARKS_SYNTHETIC_SCENES_H_
+
+#include <cstdint>
+
+#include <aslam/simulation/synthetic-scene.h>
+
+namespace aslam {
+namespace benchmarks {
+
+/// Keypoints of the synthetic frames are kept this far from the image border.
+constexpr size_t kMinDistanceToImageBorderPx = 30u;
+
+/// \brief Options of a scene rotating in place by rotation_deg per frame about a random axis,
+///        for the matcher, tracker and geometric vision benchmarks.
+///
+/// The poses have no noise, such that SyntheticScene::get_T_Ca_Cb() is the exact rotation of the
+/// gyro predictions. The frames have 48 byte descriptors and are 50 ms apart, the first one at
+/// 50 ms.
+simulation::SyntheticScene::Options createRotationSceneOptions(
+    size_t num_frames, double rotation_deg, uint32_t seed);
+
+}  // namespace benchmarks
+}  // namespace aslam
+
+#endif  // ASLAM_BENCHMARKS_SYNTHETIC_SCENES_H_
@@ -0,0 +1,40 @@
+#ifndef ASLAM_BENCHMARKS_SYSTEM_INFO_H_
+#define ASLAM_BENCHMARKS_SYSTEM_INFO_H_
+
+#include <string>
+#include <vector>
+
+namespace aslam {
+namespace benchmarks {
+
+/// The machine and the build the benchmarks ran on. Results are only comparable between runs
+/// with the same CPU, instruction set level and build flags.
+struct SystemInfo {
+  /// "model name" of /proc/cpuinfo, "unknown" if not available.
+  std::string cpu_model;
+  size_t num_hardware_threads;
+  /// scaling_governor of cpu0, empty if not available. Anything but "performance" adds noise.
+  std::string cpu_scaling_governor;
+  std::string hostname;
+
+  /// The instruction set levels of aslam/common/cpu.h the CPU supports, and the best level
+  /// the kernels dispatch to, which honors --aslam_force_isa.
+  std::vector<std::string> detected_isas;
+  std::string best_supported_isa;
+
+  /// The instruction sets the benchmarks were compiled for, e.g. "avx2" for -mavx2.
+  std::vector<std::string> compiled_isas;
+  std::string compiler;
+  /// "release" if compiled with NDEBUG, which disables the DCHECKs, otherwise "debug".
+  std::string build_type;
+
+  /// Start of the run, UTC in ISO 8601.
+  std::string timestamp;
+};
+
+SystemInfo getSystemInfo();
+
+}  // namespace benchmarks
+}  // namespace aslam
+
+#endif  // ASLAM_BENCHMARKS_SYSTEM_INFO_H_
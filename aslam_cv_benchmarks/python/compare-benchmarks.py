@@ -0,0 +1,106 @@
+#!/usr/bin/env python
+# Compares the JSON output of benchmark_runner against a baseline of the same machine and build,
+# e.g.
+#   compare-benchmarks.py baseline.json current.json --metric p50_ms --threshold 0.1
+# Exits with 1 if any benchmark got slower than the threshold.
+
+from __future__ import print_function
+
+import argparse
+import json
+import sys
+
+SYSTEM_KEYS_TO_MATCH = ['cpu_model', 'best_supported_isa', 'build_type', 'compiled_isas']
+METRICS = ['mean_ms', 'min_ms', 'p50_ms', 'p99_ms', 'max_ms', 'ns_per_item',
+           'allocations_per_call']
+
+
+def load_results(path):
+    with open(path) as json_file:
+        document = json.load(json_file)
+    if document.get('schema_version') != 1:
+        raise ValueError('%s: unsupported schema version %s.' %
+                         (path, document.get('schema_version')))
+    results = {}
+    for result in document['benchmarks']:
+        results[result['suite'] + '/' + result['name']] = result
+    return document['system'], results
+
+
+def warn_about_system_differences(baseline_system, current_system):
+    for key in SYSTEM_KEYS_TO_MATCH:
+        if baseline_system.get(key) != current_system.get(key):
+            print('WARNING: %s differs, baseline: %s, current: %s. The timings are not comparable.'
+                  % (key, baseline_system.get(key), current_system.get(key)))
+    if current_system.get('cpu_scaling_governor') not in (None, '', 'performance'):
+        print('WARNING: The CPU scaling governor is %s, the timings can be noisy.' %
+              current_system['cpu_scaling_governor'])
+
+
+def relative_change(baseline_value, current_value):
+    if baseline_value is None or current_value is None:
+        return None
+    if baseline_value == 0.0:
+        return 0.0 if current_value == 0.0 else float('inf')
+    return (current_value - baseline_value) / baseline_value
+
+
+def format_value(value):
+    return 'n/a' if value is None else '%.4g' % value
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compares benchmark results to a baseline.')
+    parser.add_argument('baseline', help='JSON output of benchmark_runner used as reference.')
+    parser.add_argument('current', help='JSON output of benchmark_runner to check.')
+    parser.add_argument('--metric', default='p50_ms', choices=METRICS,
+                        help='Result field to compare, lower is better.')
+    parser.add_argument('--threshold', type=float, default=0.1,
+                        help='Relative slowdown that counts as a regression.')
+    parser.add_argument('--fail-on-missing', action='store_true',
+                        help='Also fail if a benchmark of the baseline was not run.')
+    args = parser.parse_args()
+
+    baseline_system, baseline_results = load_results(args.baseline)
+    current_system, current_results = load_results(args.current)
+    warn_about_system_differences(baseline_system, current_system)
+
+    regressions = []
+    improvements = []
+    print('%-80s %12s %12s %9s' % ('benchmark', 'baseline', 'current', 'change'))
+    for name in sorted(set(baseline_results) & set(current_results)):
+        baseline = baseline_results[name]
+        current = current_results[name]
+        change = relative_change(baseline.get(args.metric), current.get(args.metric))
+        status = ''
+        if change is not None and change > args.threshold:
+            status = 'REGRESSION'
+            regressions.append(name)
+        elif change is not None and change < -args.threshold:
+            status = 'improvement'
+            improvements.append(name)
+        print('%-80s %12s %12s %9s %s' % (
+            name, format_value(baseline.get(args.metric)), format_value(current.get(args.metric)),
+            'n/a' if change is None else '%+.1f%%' % (100.0 * change), status))
+        # Changed outputs hint at a change of the algorithm rather than of the implementation.
+        if baseline.get('counters', {}) != current.get('counters', {}):
+            print('  counters changed, baseline: %s, current: %s' %
+                  (baseline.get('counters'), current.get('counters')))
+
+    missing = sorted(set(baseline_results) - set(current_results))
+    new = sorted(set(current_results) - set(baseline_results))
+    for name in missing:
+        print('MISSING: %s' % name)
+    for name in new:
+        print('NEW: %s' % name)
+
+    print('\n%d regressions, %d improvements above %.1f%% in %s, %d missing, %d new.' % (
+        len(regressions), len(improvements), 100.0 * args.threshold, args.metric, len(missing),
+        len(new)))
+    if regressions or (args.fail_on_missing and missing):
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,112 @@
+// Runs the benchmarks of all packages on synthetic inputs and writes the latencies together with
+// the CPU, the detected instruction sets and the build configuration as JSON, e.g.
+//   rosrun aslam_cv_benchmarks benchmark_runner --benchmark_filter=matcher/,cameras/pinhole \
+//       --benchmark_output_json=current.json
+//   aslam_cv_benchmarks/python/compare-benchmarks.py baseline.json current.json
+//
+// Schema, version 1:
+//   {"schema_version": 1,
+//    "system": {"cpu_model", "num_hardware_threads", "cpu_scaling_governor", "hostname",
+//               "detected_isas", "best_supported_isa", "compiled_isas", "compiler",
+//               "build_type", "timestamp"},
+//    "benchmarks": [{"suite", "name", "num_repetitions", "num_warmup_repetitions",
+//                    "mean_ms", "stddev_ms", "min_ms", "p50_ms", "p99_ms", "max_ms",
+//                    "items_per_call", "ns_per_item", "allocations_per_call",
+//                    "counters": {<name>: <value>}}]}
+// ns_per_item is based on the median and null if the benchmark processes no items,
+// allocations_per_call is null if the allocation hooks are not linked.
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "aslam/benchmarks/benchmark.h"
+#include "aslam/benchmarks/suites.h"
+#include "aslam/benchmarks/system-info.h"
+
+DEFINE_string(benchmark_filter, "",
+              "Comma separated substrings of the full names <suite>/<name> of the benchmarks to "
+              "run, all benchmarks if empty.");
+DEFINE_bool(benchmark_list, false, "List the selected benchmarks without running them.");
+DEFINE_int32(benchmark_num_repetitions, 20, "Number of timed calls per benchmark.");
+DEFINE_int32(benchmark_num_warmup_repetitions, 2, "Number of untimed calls per benchmark.");
+DEFINE_string(benchmark_output_json, "", "Write the results to this file instead of stdout.");
+
+namespace aslam {
+namespace benchmarks {
+
+void registerAllBenchmarks(BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+  registerCameraBenchmarks(registry);
+  registerCommonBenchmarks(registry);
+  registerDetectorBenchmarks(registry);
+  registerGeometricVisionBenchmarks(registry);
+  registerMatcherBenchmarks(registry);
+  registerPipelineBenchmarks(registry);
+  registerTrackerBenchmarks(registry);
+  registerTriangulationBenchmarks(registry);
+}
+
+namespace {
+
+int runBenchmarks() {
+  CHECK_GT(FLAGS_benchmark_num_repetitions, 0);
+  CHECK_GE(FLAGS_benchmark_num_warmup_repetitions, 0);
+  BenchmarkRegistry registry;
+  registerAllBenchmarks(&registry);
+  const std::vector<const Benchmark*> benchmarks =
+      registry.getFilteredBenchmarks(FLAGS_benchmark_filter);
+  if (FLAGS_benchmark_list) {
+    for (const Benchmark* benchmark : benchmarks) {
+      std::cout << benchmark->getFullName() << std::endl;
+    }
+    return 0;
+  }
+  CHECK(!benchmarks.empty()) << "No benchmark matches the filter " << FLAGS_benchmark_filter;
+
+  if (!common::areAllocationHooksInstalled()) {
+    LOG(WARNING) << "The allocation hooks are not linked, no allocations are counted.";
+  }
+  const SystemInfo system_info = getSystemInfo();
+  if (!system_info.cpu_scaling_governor.empty() &&
+      system_info.cpu_scaling_governor != "performance") {
+    LOG(WARNING) << "The CPU scaling governor is " << system_info.cpu_scaling_governor
+                 << ", the timings can be noisy.";
+  }
+
+  std::vector<BenchmarkResult> results;
+  results.reserve(benchmarks.size());
+  for (size_t i = 0u; i < benchmarks.size(); ++i) {
+    const Benchmark& benchmark = *benchmarks[i];
+    LOG(INFO) << "[" << (i + 1u) << "/" << benchmarks.size() << "] "
+              << benchmark.getFullName();
+    results.push_back(runBenchmark(
+        benchmark, FLAGS_benchmark_num_repetitions, FLAGS_benchmark_num_warmup_repetitions));
+    LOG(INFO) << "  p50: " << results.back().measurements.getPercentile(0.5) << " ms, mean: "
+              << results.back().measurements.getMean() << " ms";
+  }
+
+  if (FLAGS_benchmark_output_json.empty()) {
+    writeResultsJson(system_info, results, &std::cout);
+  } else {
+    std::ofstream output(FLAGS_benchmark_output_json);
+    CHECK(output.is_open()) << "Could not open " << FLAGS_benchmark_output_json << ".";
+    writeResultsJson(system_info, results, &output);
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace benchmarks
+}  // namespace aslam
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  return aslam::benchmarks::runBenchmarks();
+}
@@ -0,0 +1,289 @@
+#include "aslam/benchmarks/benchmark.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+
+#include "aslam/benchmarks/system-info.h"
+
+namespace aslam {
+namespace benchmarks {
+namespace {
+
+/// JSON has no representation of NaN and infinity.
+void writeJsonNumber(double value, std::ostream* out) {
+  CHECK_NOTNULL(out);
+  if (std::isfinite(value)) {
+    *out << value;
+  } else {
+    *out << "null";
+  }
+}
+
+void writeJsonStringList(const std::vector<std::string>& values, std::ostream* out) {
+  CHECK_NOTNULL(out);
+  *out << "[";
+  for (size_t i = 0u; i < values.size(); ++i) {
+    *out << (i > 0u ? ", " : "");
+    writeJsonString(values[i], out);
+  }
+  *out << "]";
+}
+
+void writeSystemInfoJson(const SystemInfo& info, std::ostream* out) {
+  CHECK_NOTNULL(out);
+  *out << "{\"cpu_model\": ";
+  writeJsonString(info.cpu_model, out);
+  *out << ", \"num_hardware_threads\": " << info.num_hardware_threads
+       << ", \"cpu_scaling_governor\": ";
+  writeJsonString(info.cpu_scaling_governor, out);
+  *out << ", \"hostname\": ";
+  writeJsonString(info.hostname, out);
+  *out << ",\n             \"detected_isas\": ";
+  writeJsonStringList(info.detected_isas, out);
+  *out << ", \"best_supported_isa\": ";
+  writeJsonString(info.best_supported_isa, out);
+  *out << ", \"compiled_isas\": ";
+  writeJsonStringList(info.compiled_isas, out);
+  *out << ",\n             \"compiler\": ";
+  writeJsonString(info.compiler, out);
+  *out << ", \"build_type\": ";
+  writeJsonString(info.build_type, out);
+  *out << ", \"timestamp\": ";
+  writeJsonString(info.timestamp, out);
+  *out << "}";
+}
+
+void writeResultJson(const BenchmarkResult& result, std::ostream* out) {
+  CHECK_NOTNULL(out);
+  const Measurements& measurements = result.measurements;
+  *out << "    {\"suite\": ";
+  writeJsonString(result.suite, out);
+  *out << ", \"name\": ";
+  writeJsonString(result.name, out);
+  *out << ", \"num_repetitions\": " << measurements.size()
+       << ", \"num_warmup_repetitions\": " << result.num_warmup_repetitions
+       << ",\n     \"mean_ms\": ";
+  writeJsonNumber(measurements.getMean(), out);
+  *out << ", \"stddev_ms\": ";
+  writeJsonNumber(measurements.getStandardDeviation(), out);
+  *out << ", \"min_ms\": ";
+  writeJsonNumber(measurements.getMin(), out);
+  *out << ", \"p50_ms\": ";
+  writeJsonNumber(measurements.getPercentile(0.5), out);
+  *out << ", \"p99_ms\": ";
+  writeJsonNumber(measurements.getPercentile(0.99), out);
+  *out << ", \"max_ms\": ";
+  writeJsonNumber(measurements.getPercentile(1.0), out);
+  *out << ",\n     \"items_per_call\": " << result.num_items_per_call << ", \"ns_per_item\": ";
+  if (result.num_items_per_call > 0u) {
+    writeJsonNumber(measurements.getPercentile(0.5) * 1.0e6 / result.num_items_per_call, out);
+  } else {
+    *out << "null";
+  }
+  *out << ", \"allocations_per_call\": ";
+  writeJsonNumber(measurements.getMeanNumAllocations(), out);
+  *out << ",\n     \"counters\": {";
+  bool is_first = true;
+  for (const std::pair<const std::string, double>& counter : result.counters) {
+    *out << (is_first ? "" : ", ");
+    writeJsonString(counter.first, out);
+    *out << ": ";
+    writeJsonNumber(counter.second, out);
+    is_first = false;
+  }
+  *out << "}}";
+}
+
+}  // namespace
+
+double Measurements::getMean() const {
+  CHECK(!durations_ms.empty());
+  double sum = 0.0;
+  for (const double duration_ms : durations_ms) {
+    sum += duration_ms;
+  }
+  return sum / durations_ms.size();
+}
+
+double Measurements::getStandardDeviation() const {
+  CHECK(!durations_ms.empty());
+  if (durations_ms.size() == 1u) {
+    return 0.0;
+  }
+  const double mean = getMean();
+  double sum_squares = 0.0;
+  for (const double duration_ms : durations_ms) {
+    sum_squares += (duration_ms - mean) * (duration_ms - mean);
+  }
+  return std::sqrt(sum_squares / (durations_ms.size() - 1u));
+}
+
+double Measurements::getMin() const {
+  CHECK(!durations_ms.empty());
+  return *std::min_element(durations_ms.begin(), durations_ms.end());
+}
+
+double Measurements::getPercentile(double percentile) const {
+  CHECK(!durations_ms.empty());
+  CHECK_GE(percentile, 0.0);
+  CHECK_LE(percentile, 1.0);
+  std::vector<double> sorted = durations_ms;
+  std::sort(sorted.begin(), sorted.end());
+  // The smallest value with at least the given share of the values less or equal to it.
+  const size_t rank = static_cast<size_t>(std::ceil(percentile * sorted.size()));
+  return sorted[std::min<size_t>(sorted.size(), std::max<size_t>(rank, 1u)) - 1u];
+}
+
+double Measurements::getMeanNumAllocations() const {
+  if (!common::areAllocationHooksInstalled() || num_allocations.empty()) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  double sum = 0.0;
+  for (const size_t count : num_allocations) {
+    sum += static_cast<double>(count);
+  }
+  return sum / num_allocations.size();
+}
+
+void BenchmarkRegistry::add(
+    const std::string& suite, const std::string& name, const BenchmarkFunction& function) {
+  CHECK(!suite.empty());
+  CHECK(!name.empty());
+  CHECK(function);
+  Benchmark benchmark;
+  benchmark.suite = suite;
+  benchmark.name = name;
+  benchmark.function = function;
+  for (const Benchmark& other : benchmarks_) {
+    CHECK_NE(other.getFullName(), benchmark.getFullName()) << "Duplicate benchmark.";
+  }
+  benchmarks_.push_back(benchmark);
+}
+
+std::vector<const Benchmark*> BenchmarkRegistry::getFilteredBenchmarks(
+    const std::string& filter) const {
+  const std::vector<std::string> patterns = splitList(filter);
+  std::vector<const Benchmark*> filtered_benchmarks;
+  for (const Benchmark& benchmark : benchmarks_) {
+    const std::string full_name = benchmark.getFullName();
+    bool is_selected = patterns.empty();
+    for (const std::string& pattern : patterns) {
+      is_selected |= full_name.find(pattern) != std::string::npos;
+    }
+    if (is_selected) {
+      filtered_benchmarks.push_back(&benchmark);
+    }
+  }
+  return filtered_benchmarks;
+}
+
+BenchmarkResult runBenchmark(
+    const Benchmark& benchmark, size_t num_repetitions, size_t num_warmup_repetitions) {
+  BenchmarkState state(num_repetitions, num_warmup_repetitions);
+  benchmark.function(&state);
+  CHECK_GT(state.getMeasurements().size(), 0u)
+      << benchmark.getFullName() << " did not time any call.";
+
+  BenchmarkResult result;
+  result.suite = benchmark.suite;
+  result.name = benchmark.name;
+  result.num_warmup_repetitions = num_warmup_repetitions;
+  result.num_items_per_call = state.getNumItemsPerCall();
+  result.counters = state.getCounters();
+  result.measurements = state.getMeasurements();
+  return result;
+}
+
+void writeResultsJson(const SystemInfo& system_info, const std::vector<BenchmarkResult>& results,
+                      std::ostream* out) {
+  CHECK_NOTNULL(out);
+  *out << "{\n  \"schema_version\": 1,\n  \"system\": ";
+  writeSystemInfoJson(system_info, out);
+  *out << ",\n  \"benchmarks\": [\n";
+  for (size_t i = 0u; i < results.size(); ++i) {
+    writeResultJson(results[i], out);
+    *out << (i + 1u < results.size() ? ",\n" : "\n");
+  }
+  *out << "  ]\n}\n";
+}
+
+void writeJsonString(const std::string& value, std::ostream* out) {
+  CHECK_NOTNULL(out);
+  *out << "\"";
+  for (const char character : value) {
+    switch (character) {
+      case '"':
+        *out << "\\\"";
+        break;
+      case '\\':
+        *out << "\\\\";
+        break;
+      case '\n':
+        *out << "\\n";
+        break;
+      case '\t':
+        *out << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(character) < 0x20u) {
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<int>(character));
+          *out << escaped;
+        } else {
+          *out << character;
+        }
+    }
+  }
+  *out << "\"";
+}
+
+std::vector<std::string> splitList(const std::string& list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+bool parsePositiveInteger(const std::string& string, size_t* value) {
+  CHECK_NOTNULL(value);
+  // strtoull accepts leading whitespace and signs, which are not part of a valid item.
+  if (string.empty() || !std::all_of(string.begin(), string.end(), [](const char character) {
+        return std::isdigit(static_cast<unsigned char>(character)) != 0;
+      })) {
+    return false;
+  }
+  errno = 0;
+  const unsigned long long parsed_value = std::strtoull(string.c_str(), nullptr, 10);
+  if (errno == ERANGE || parsed_value == 0u ||
+      parsed_value > std::numeric_limits<size_t>::max()) {
+    return false;
+  }
+  *value = static_cast<size_t>(parsed_value);
+  return true;
+}
+
+bool validatePositiveIntegerList(const char* flag_name, const std::string& list) {
+  bool is_valid = true;
+  for (const std::string& item : splitList(list)) {
+    size_t value;
+    if (!parsePositiveInteger(item, &value)) {
+      LOG(ERROR) << "--" << flag_name << ": '" << item << "' is not a positive integer.";
+      is_valid = false;
+    }
+  }
+  return is_valid;
+}
+
+}  // namespace benchmarks
+}  // namespace aslam
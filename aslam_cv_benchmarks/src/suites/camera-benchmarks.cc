@@ -0,0 +1,294 @@
+// Projection, back-projection and distortion of every camera and distortion model, through the
+// point-wise, the functional and the vectorized interfaces, in double and single precision.
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/camera-unified-projection.h>
+#include <aslam/cameras/distortion-equidistant.h>
+#include <aslam/cameras/distortion-fisheye.h>
+#include <aslam/cameras/distortion-null.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <Eigen/Core>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "aslam/benchmarks/suites.h"
+
+DEFINE_string(benchmark_cameras_num_points, "1,10,100,1000,10000",
+              "Comma separated numbers of points per projection call.");
+static const bool num_points_validator_registered = google::RegisterFlagValidator(
+    &FLAGS_benchmark_cameras_num_points, &aslam::benchmarks::validatePositiveIntegerList);
+
+namespace aslam {
+namespace benchmarks {
+namespace {
+
+struct CameraModel {
+  std::string name;
+  std::function<Camera::Ptr()> create;
+};
+
+/// Every camera with every distortion, with the parameters of the unit tests.
+std::vector<CameraModel> getCameraModels() {
+  return {
+      {"pinhole", []() -> Camera::Ptr { return PinholeCamera::createTestCamera(); }},
+      {"pinhole_radtan",
+       []() -> Camera::Ptr { return PinholeCamera::createTestCamera<RadTanDistortion>(); }},
+      {"pinhole_equidistant",
+       []() -> Camera::Ptr {
+         return PinholeCamera::createTestCamera<EquidistantDistortion>();
+       }},
+      {"pinhole_fisheye",
+       []() -> Camera::Ptr { return PinholeCamera::createTestCamera<FisheyeDistortion>(); }},
+      {"unified", []() -> Camera::Ptr { return UnifiedProjectionCamera::createTestCamera(); }},
+      {"unified_radtan",
+       []() -> Camera::Ptr {
+         return UnifiedProjectionCamera::createTestCamera<RadTanDistortion>();
+       }},
+      {"unified_equidistant",
+       []() -> Camera::Ptr {
+         return UnifiedProjectionCamera::createTestCamera<EquidistantDistortion>();
+       }},
+      {"unified_fisheye",
+       []() -> Camera::Ptr {
+         return UnifiedProjectionCamera::createTestCamera<FisheyeDistortion>();
+       }}};
+}
+
+/// Visible points 1 - 10 m in front of the camera and their keypoints.
+void createVisiblePoints(const Camera& camera, size_t num_points, Eigen::Matrix3Xd* points_3d,
+                         Eigen::Matrix2Xd* keypoints) {
+  CHECK_NOTNULL(points_3d);
+  CHECK_NOTNULL(keypoints);
+  // The random samples of the cameras use std::rand().
+  std::srand(kSeed);
+  points_3d->resize(Eigen::NoChange, num_points);
+  keypoints->resize(Eigen::NoChange, num_points);
+  for (size_t i = 0u; i < num_points; ++i) {
+    const double depth = 1.0 + 9.0 * static_cast<double>(i) / num_points;
+    Eigen::Vector2d keypoint;
+    do {
+      points_3d->col(i) = camera.createRandomVisiblePoint(depth);
+    } while (!camera.project3(points_3d->col(i), &keypoint).isKeypointVisible());
+    keypoints->col(i) = keypoint;
+  }
+}
+
+/// The camera of a model with the visible points and their keypoints.
+struct ProjectionInputs {
+  ProjectionInputs(const CameraModel& model, size_t num_points) : camera(model.create()) {
+    createVisiblePoints(*camera, num_points, &points_3d, &keypoints);
+  }
+
+  const Camera::Ptr camera;
+  Eigen::Matrix3Xd points_3d;
+  Eigen::Matrix2Xd keypoints;
+};
+
+/// The normalized image plane coordinates of the points, i.e. the inputs of the distortion.
+Eigen::Matrix2Xd getNormalizedPoints(const Eigen::Matrix3Xd& points_3d) {
+  Eigen::Matrix2Xd points(2, points_3d.cols());
+  for (int i = 0; i < points_3d.cols(); ++i) {
+    points.col(i) = points_3d.col(i).head<2>() / points_3d(2, i);
+  }
+  return points;
+}
+
+void registerCameraModelBenchmarks(const CameraModel& model, size_t num_points,
+                                   const std::string& suffix, BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+  // The point-wise interfaces, called in a loop as by the callers that project single points.
+  registry->add("cameras", "project3/" + model.name + suffix,
+                [model, num_points](BenchmarkState* state) {
+    const ProjectionInputs inputs(model, num_points);
+    Eigen::Matrix2Xd projected_keypoints(2, num_points);
+    state->setNumItemsPerCall(num_points);
+    state->run([&]() {
+      Eigen::Vector2d keypoint;
+      for (size_t i = 0u; i < num_points; ++i) {
+        inputs.camera->project3(inputs.points_3d.col(i), &keypoint);
+        projected_keypoints.col(i) = keypoint;
+      }
+    });
+  });
+
+  registry->add("cameras", "project3_with_jacobian/" + model.name + suffix,
+                [model, num_points](BenchmarkState* state) {
+    const ProjectionInputs inputs(model, num_points);
+    Eigen::Matrix2Xd projected_keypoints(2, num_points);
+    Eigen::Matrix<double, 2, 3> jacobian_point;
+    state->setNumItemsPerCall(num_points);
+    state->run([&]() {
+      Eigen::Vector2d keypoint;
+      for (size_t i = 0u; i < num_points; ++i) {
+        inputs.camera->project3(inputs.points_3d.col(i), &keypoint, &jacobian_point);
+        projected_keypoints.col(i) = keypoint;
+      }
+    });
+  });
+
+  registry->add("cameras", "project3_functional/" + model.name + suffix,
+                [model, num_points](BenchmarkState* state) {
+    const ProjectionInputs inputs(model, num_points);
+    const Eigen::VectorXd intrinsics = inputs.camera->getParameters();
+    const Eigen::VectorXd distortion_coefficients =
+        inputs.camera->getDistortion().getParameters();
+    Eigen::Matrix2Xd projected_keypoints(2, num_points);
+    state->setNumItemsPerCall(num_points);
+    state->run([&]() {
+      Eigen::Vector2d keypoint;
+      for (size_t i = 0u; i < num_points; ++i) {
+        inputs.camera->project3Functional(
+            inputs.points_3d.col(i), &intrinsics, &distortion_coefficients, &keypoint);
+        projected_keypoints.col(i) = keypoint;
+      }
+    });
+  });
+
+  // All Jacobians, as used by the residuals of the calibration.
+  registry->add("cameras", "project3_functional_with_jacobians/" + model.name + suffix,
+                [model, num_points](BenchmarkState* state) {
+    const ProjectionInputs inputs(model, num_points);
+    const Eigen::VectorXd intrinsics = inputs.camera->getParameters();
+    const Eigen::VectorXd distortion_coefficients =
+        inputs.camera->getDistortion().getParameters();
+    Eigen::Matrix2Xd projected_keypoints(2, num_points);
+    Eigen::Matrix<double, 2, 3> jacobian_point;
+    Eigen::Matrix<double, 2, Eigen::Dynamic> jacobian_intrinsics;
+    Eigen::Matrix<double, 2, Eigen::Dynamic> jacobian_distortion;
+    state->setNumItemsPerCall(num_points);
+    state->run([&]() {
+      Eigen::Vector2d keypoint;
+      for (size_t i = 0u; i < num_points; ++i) {
+        inputs.camera->project3Functional(
+            inputs.points_3d.col(i), &intrinsics, &distortion_coefficients, &keypoint,
+            &jacobian_point, &jacobian_intrinsics,
+            inputs.camera->hasDistortion() ? &jacobian_distortion : nullptr);
+        projected_keypoints.col(i) = keypoint;
+      }
+    });
+  });
+
+  registry->add("cameras", "back_project3/" + model.name + suffix,
+                [model, num_points](BenchmarkState* state) {
+    const ProjectionInputs inputs(model, num_points);
+    Eigen::Matrix3Xd bearing_vectors(3, num_points);
+    state->setNumItemsPerCall(num_points);
+    state->run([&]() {
+      Eigen::Vector3d bearing_vector;
+      for (size_t i = 0u; i < num_points; ++i) {
+        inputs.camera->backProject3(inputs.keypoints.col(i), &bearing_vector);
+        bearing_vectors.col(i) = bearing_vector;
+      }
+    });
+  });
+
+  registry->add("cameras", "project3_vectorized/" + model.name + suffix,
+                [model, num_points](BenchmarkState* state) {
+    const ProjectionInputs inputs(model, num_points);
+    Eigen::Matrix2Xd projected_keypoints;
+    std::vector<ProjectionResult> results;
+    state->setNumItemsPerCall(num_points);
+    state->run([&]() {
+      inputs.camera->project3Vectorized(inputs.points_3d, &projected_keypoints, &results);
+    });
+  });
+
+  registry->add("cameras", "project3_vectorized_with_jacobians/" + model.name + suffix,
+                [model, num_points](BenchmarkState* state) {
+    const ProjectionInputs inputs(model, num_points);
+    Eigen::Matrix2Xd projected_keypoints;
+    Eigen::Matrix<double, 6, Eigen::Dynamic> jacobians_point;
+    std::vector<ProjectionResult> results;
+    state->setNumItemsPerCall(num_points);
+    state->run([&]() {
+      inputs.camera->project3VectorizedWithJacobians(
+          inputs.points_3d, &projected_keypoints, &jacobians_point, nullptr, &results);
+    });
+  });
+
+  registry->add("cameras", "project3_vectorized_float/" + model.name + suffix,
+                [model, num_points](BenchmarkState* state) {
+    const ProjectionInputs inputs(model, num_points);
+    const Eigen::Matrix3Xf points_3d_float = inputs.points_3d.cast<float>();
+    Eigen::Matrix2Xf projected_keypoints;
+    std::vector<ProjectionResult> results;
+    state->setNumItemsPerCall(num_points);
+    state->run([&]() {
+      inputs.camera->project3VectorizedFloat(points_3d_float, &projected_keypoints, &results);
+    });
+  });
+
+  registry->add("cameras", "back_project3_vectorized/" + model.name + suffix,
+                [model, num_points](BenchmarkState* state) {
+    const ProjectionInputs inputs(model, num_points);
+    Eigen::Matrix3Xd bearing_vectors;
+    std::vector<unsigned char> success;
+    state->setNumItemsPerCall(num_points);
+    state->run([&]() {
+      inputs.camera->backProject3Vectorized(inputs.keypoints, &bearing_vectors, &success);
+    });
+  });
+
+  registry->add("cameras", "back_project3_vectorized_float/" + model.name + suffix,
+                [model, num_points](BenchmarkState* state) {
+    const ProjectionInputs inputs(model, num_points);
+    const Eigen::Matrix2Xf keypoints_float = inputs.keypoints.cast<float>();
+    Eigen::Matrix3Xf bearing_vectors;
+    std::vector<unsigned char> success;
+    state->setNumItemsPerCall(num_points);
+    state->run([&]() {
+      inputs.camera->backProject3VectorizedFloat(keypoints_float, &bearing_vectors, &success);
+    });
+  });
+
+  if (!model.create()->hasDistortion()) {
+    return;
+  }
+  registry->add("cameras", "distort_vectorized/" + model.name + suffix,
+                [model, num_points](BenchmarkState* state) {
+    const ProjectionInputs inputs(model, num_points);
+    const Eigen::Matrix2Xd points = getNormalizedPoints(inputs.points_3d);
+    Eigen::Matrix2Xd distorted_points;
+    state->setNumItemsPerCall(num_points);
+    state->run([&]() {
+      inputs.camera->getDistortion().distortVectorized(points, &distorted_points, nullptr);
+    });
+  });
+
+  registry->add("cameras", "undistort_vectorized/" + model.name + suffix,
+                [model, num_points](BenchmarkState* state) {
+    const ProjectionInputs inputs(model, num_points);
+    Eigen::Matrix2Xd distorted_points;
+    inputs.camera->getDistortion().distortVectorized(
+        getNormalizedPoints(inputs.points_3d), &distorted_points, nullptr);
+    Eigen::Matrix2Xd undistorted_points;
+    state->setNumItemsPerCall(num_points);
+    state->run([&]() {
+      inputs.camera->getDistortion().undistortVectorized(
+          distorted_points, &undistorted_points, nullptr);
+    });
+  });
+}
+
+}  // namespace
+
+void registerCameraBenchmarks(BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+  for (const std::string& num_points_string : splitList(FLAGS_benchmark_cameras_num_points)) {
+    size_t num_points;
+    CHECK(parsePositiveInteger(num_points_string, &num_points))
+        << "--benchmark_cameras_num_points: '" << num_points_string
+        << "' is not a positive integer.";
+    const std::string suffix = "/points=" + num_points_string;
+    for (const CameraModel& model : getCameraModels()) {
+      registerCameraModelBenchmarks(model, num_points, suffix, registry);
+    }
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace aslam
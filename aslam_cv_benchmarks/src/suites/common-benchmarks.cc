@@ -0,0 +1,195 @@
+// Hamming kernels for every supported instruction set level, the weighted occupancy grid and the
+// thread pool and parallel loops.
+#include <atomic>
+#include <cmath>
+#include <future>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <aslam/common/hamming.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/occupancy-grid.h>
+#include <aslam/common/parallel-for.h>
+#include <aslam/common/thread-pool.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "aslam/benchmarks/suites.h"
+
+DEFINE_int32(benchmark_common_num_descriptors, 2000,
+             "Number of descriptors every Hamming query is compared against.");
+DEFINE_int32(benchmark_common_num_grid_points, 5000,
+             "Number of points added to the occupancy grid per call.");
+DEFINE_int32(benchmark_common_num_tasks, 1000, "Number of thread pool tasks per call.");
+
+namespace aslam {
+namespace benchmarks {
+namespace {
+
+#ifndef __ARM_NEON__
+void registerHammingBenchmarks(BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+  typedef common::Hamming Hamming;
+  CHECK_GT(FLAGS_benchmark_common_num_descriptors, 0);
+  const size_t num_descriptors = FLAGS_benchmark_common_num_descriptors;
+  const Hamming::Implementation kImplementations[] = {
+      Hamming::Implementation::kSSSE3, Hamming::Implementation::kAVX2,
+      Hamming::Implementation::kAVX512};
+  const int kDescriptorSizesBytes[] = {48, 64, 96};
+
+  for (const Hamming::Implementation implementation : kImplementations) {
+    // Unsupported kernels are not registered, the comparison reports them as missing.
+    if (!Hamming::isImplementationSupported(implementation)) {
+      continue;
+    }
+    const std::string implementation_name = Hamming::getImplementationName(implementation);
+    for (const int descriptor_size : kDescriptorSizesBytes) {
+      const std::string parameters = implementation_name + "/bytes=" +
+          std::to_string(descriptor_size) + "/descriptors=" + std::to_string(num_descriptors);
+      registry->add("common", "hamming_batch/" + parameters,
+                    [=](BenchmarkState* state) {
+        std::mt19937 generator(kSeed);
+        std::uniform_int_distribution<int> byte(0, 255);
+        // Eigen's aligned allocator guarantees the 16 byte alignment of the SSSE3 kernel.
+        Aligned<std::vector, unsigned char> descriptors(num_descriptors * descriptor_size);
+        Aligned<std::vector, unsigned char> query(descriptor_size);
+        for (unsigned char& value : descriptors) {
+          value = static_cast<unsigned char>(byte(generator));
+        }
+        for (unsigned char& value : query) {
+          value = static_cast<unsigned char>(byte(generator));
+        }
+        std::vector<int> candidate_indices(num_descriptors);
+        for (size_t i = 0u; i < num_descriptors; ++i) {
+          candidate_indices[i] = static_cast<int>(i);
+        }
+        std::vector<Hamming::ResultType> distances(num_descriptors);
+        state->setNumItemsPerCall(num_descriptors);
+        state->run([&]() {
+          Hamming::evaluateBatchWith(implementation, query.data(), descriptors.data(),
+                                     descriptor_size, candidate_indices.data(), num_descriptors,
+                                     descriptor_size, distances.data());
+        });
+        int64_t checksum = 0;
+        for (const Hamming::ResultType distance : distances) {
+          checksum += distance;
+        }
+        state->setCounter("checksum", static_cast<double>(checksum));
+      });
+    }
+  }
+}
+#endif  // __ARM_NEON__
+
+void registerOccupancyGridBenchmarks(BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+  CHECK_GT(FLAGS_benchmark_common_num_grid_points, 0);
+  const size_t num_points = FLAGS_benchmark_common_num_grid_points;
+  const std::string suffix = "/points=" + std::to_string(num_points);
+  typedef common::WeightedOccupancyGrid<> Grid;
+  const double kCellSize = 40.0;
+
+  const auto sample_points = [=]() {
+    std::mt19937 generator(kSeed);
+    std::uniform_real_distribution<double> u(0.0, kImageHeight - 1.0);
+    std::uniform_real_distribution<double> v(0.0, kImageWidth - 1.0);
+    std::uniform_real_distribution<double> weight(0.0, 1.0);
+    std::vector<Grid::Point> points;
+    points.reserve(num_points);
+    for (size_t i = 0u; i < num_points; ++i) {
+      points.emplace_back(u(generator), v(generator), weight(generator), i);
+    }
+    return points;
+  };
+
+  registry->add("common", "occupancy_grid_add_or_replace_weakest/cell_capacity=4" + suffix,
+                [=](BenchmarkState* state) {
+    const std::vector<Grid::Point> points = sample_points();
+    Grid grid(kImageHeight, kImageWidth, kCellSize, kCellSize);
+    const size_t kMaxNumPointsPerCell = 4u;
+    state->setNumItemsPerCall(num_points);
+    for (size_t repetition = 0u; repetition < state->getNumRepetitions(); ++repetition) {
+      grid.reset();
+      state->measure([&]() {
+        for (const Grid::Point& point : points) {
+          grid.addPointOrReplaceWeakestIfCellFull(point, kMaxNumPointsPerCell);
+        }
+      });
+    }
+    state->setCounter("points_in_grid", grid.getNumPoints());
+  });
+
+  registry->add("common", "occupancy_grid_add_or_replace_nearest/min_distance=5" + suffix,
+                [=](BenchmarkState* state) {
+    const std::vector<Grid::Point> points = sample_points();
+    Grid grid(kImageHeight, kImageWidth, kCellSize, kCellSize);
+    const double kMinDistance = 5.0;
+    state->setNumItemsPerCall(num_points);
+    for (size_t repetition = 0u; repetition < state->getNumRepetitions(); ++repetition) {
+      grid.reset();
+      state->measure([&]() {
+        for (const Grid::Point& point : points) {
+          grid.addPointOrReplaceWeakestNearestPoints(point, kMinDistance);
+        }
+      });
+    }
+    state->setCounter("points_in_grid", grid.getNumPoints());
+  });
+}
+
+void registerThreadPoolBenchmarks(BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+  CHECK_GT(FLAGS_benchmark_common_num_tasks, 0);
+  const size_t num_tasks = FLAGS_benchmark_common_num_tasks;
+  const size_t kNumThreads = 4u;
+
+  registry->add("common", "thread_pool_enqueue_and_wait/threads=4/tasks=" +
+                std::to_string(num_tasks), [=](BenchmarkState* state) {
+    ThreadPool thread_pool(kNumThreads);
+    std::vector<std::future<void>> futures;
+    futures.reserve(num_tasks);
+    std::atomic<size_t> num_done(0u);
+    state->setNumItemsPerCall(num_tasks);
+    state->run([&]() {
+      futures.clear();
+      for (size_t i = 0u; i < num_tasks; ++i) {
+        futures.emplace_back(thread_pool.enqueue([&num_done]() { ++num_done; }));
+      }
+      for (std::future<void>& future : futures) {
+        future.wait();
+      }
+    });
+  });
+
+  // Tiny chunks measure the scheduling overhead of the loop rather than the work.
+  const size_t kNumIndices = 1u << 16;
+  const size_t kGrainSize = 256u;
+  registry->add("common", "parallel_for/grain_size=256/indices=65536",
+                [=](BenchmarkState* state) {
+    std::vector<double> values(kNumIndices, 1.0);
+    state->setNumItemsPerCall(kNumIndices);
+    state->run([&]() {
+      common::parallelFor(common::IndexRange(0u, kNumIndices), kGrainSize,
+                          [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          values[i] = std::sqrt(values[i] + static_cast<double>(i));
+        }
+      });
+    });
+  });
+}
+
+}  // namespace
+
+void registerCommonBenchmarks(BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+#ifndef __ARM_NEON__
+  registerHammingBenchmarks(registry);
+#endif  // __ARM_NEON__
+  registerOccupancyGridBenchmarks(registry);
+  registerThreadPoolBenchmarks(registry);
+}
+
+}  // namespace benchmarks
+}  // namespace aslam
@@ -0,0 +1,76 @@
+// The line segment detector, whole image and tiled, and the KAZE detector on a synthetic image,
+// see kaze-benchmark.cc of aslam_cv_detector for the timings of the single KAZE kernels. The
+// BRISK detector is part of the pipeline suite.
+#include <random>
+#include <string>
+#include <vector>
+
+#include <aslam/detectors/line-segment-detector.h>
+#include <aslam/simulation/synthetic-scene.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <kaze/KAZE.h>
+#include <opencv2/core/core.hpp>
+
+#include "aslam/benchmarks/suites.h"
+
+namespace aslam {
+namespace benchmarks {
+namespace {
+
+cv::Mat sampleImage() {
+  std::mt19937 generator(kSeed);
+  return simulation::createTexturedImage(kImageWidth, kImageHeight, &generator);
+}
+
+void benchmarkLineSegmentDetector(const LineSegmentDetector::Options& options,
+                                  BenchmarkState* state) {
+  CHECK_NOTNULL(state);
+  const cv::Mat image = sampleImage();
+  LineSegmentDetector detector(options);
+  Lines lines;
+  state->setNumItemsPerCall(image.total());
+  state->run([&]() {
+    lines.clear();
+    detector.detect(image, &lines);
+  });
+  state->setCounter("lines", lines.size());
+}
+
+}  // namespace
+
+void registerDetectorBenchmarks(BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+
+  registry->add("detector", "line_segment_detector/752x480", [](BenchmarkState* state) {
+    benchmarkLineSegmentDetector(LineSegmentDetector::Options(), state);
+  });
+
+  registry->add("detector", "line_segment_detector_tiled/tile=256/threads=4/752x480",
+                [](BenchmarkState* state) {
+    LineSegmentDetector::Options options;
+    options.tile_size_px = 256u;
+    options.num_threads = 4u;
+    benchmarkLineSegmentDetector(options, state);
+  });
+
+  // The detector reuses its scale space across calls, like the KAZE pipeline.
+  registry->add("detector", "kaze_detector/752x480", [](BenchmarkState* state) {
+    const cv::Mat image = sampleImage();
+    KAZEOptions options;
+    options.img_width = image.cols;
+    options.img_height = image.rows;
+    libKAZE::KAZE kaze(options);
+    std::vector<cv::KeyPoint> keypoints;
+    state->setNumItemsPerCall(image.total());
+    state->run([&]() {
+      kaze.Create_Nonlinear_Scale_Space(image);
+      keypoints.clear();
+      kaze.Feature_Detection(keypoints);
+    });
+    state->setCounter("keypoints", keypoints.size());
+  });
+}
+
+}  // namespace benchmarks
+}  // namespace aslam
@@ -0,0 +1,191 @@
+// Absolute pose RANSAC on synthetic 2D-3D correspondences and the two-point outlier rejection of
+// frame-to-frame matches.
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/geometric-vision/match-outlier-rejection-twopt.h>
+#include <aslam/geometric-vision/pnp-pose-estimator.h>
+#include <aslam/matcher/gyro-two-frame-matcher.h>
+#include <aslam/matcher/match-helpers.h>
+#include <aslam/simulation/synthetic-scene.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "aslam/benchmarks/suites.h"
+#include "aslam/benchmarks/synthetic-scenes.h"
+
+DEFINE_int32(benchmark_geometric_vision_num_correspondences, 500,
+             "Number of 2D-3D correspondences of the absolute pose RANSAC.");
+DEFINE_double(benchmark_geometric_vision_outlier_ratio, 0.3,
+              "Ratio of the correspondences with a random measurement.");
+
+namespace aslam {
+namespace benchmarks {
+namespace {
+
+const double kPixelSigma = 0.8;
+const int kMaxNumRansacIterations = 500;
+
+struct AbsolutePoseProblem {
+  Camera::Ptr camera;
+  Eigen::Matrix2Xd measurements;
+  Eigen::Matrix3Xd G_landmarks;
+};
+
+/// Landmarks 2 - 10 m in front of a random camera pose, whose projections are perturbed by the
+/// pixel noise or replaced by random keypoints for the outliers.
+AbsolutePoseProblem createAbsolutePoseProblem(size_t num_correspondences, double outlier_ratio) {
+  AbsolutePoseProblem problem;
+  problem.camera =
+      simulation::createPinholeNCamera(kImageWidth, kImageHeight)->getCameraShared(0u);
+  // The random samples of the cameras and poses use std::rand().
+  std::srand(kSeed);
+  std::mt19937 generator(kSeed);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::normal_distribution<double> noise(0.0, kPixelSigma);
+  Transformation T_G_C;
+  T_G_C.setRandom(1.0, 0.5);
+
+  problem.measurements.resize(2, num_correspondences);
+  problem.G_landmarks.resize(3, num_correspondences);
+  for (size_t i = 0u; i < num_correspondences; ++i) {
+    const Eigen::Vector3d C_landmark =
+        problem.camera->createRandomVisiblePoint(2.0 + 8.0 * unit(generator));
+    problem.G_landmarks.col(i) = T_G_C.transform(C_landmark);
+    Eigen::Vector2d keypoint;
+    problem.camera->project3(C_landmark, &keypoint);
+    if (unit(generator) < outlier_ratio) {
+      keypoint = problem.camera->createRandomKeypoint();
+    } else {
+      keypoint += Eigen::Vector2d(noise(generator), noise(generator));
+    }
+    problem.measurements.col(i) = keypoint;
+  }
+  return problem;
+}
+
+/// Frames k and (k+1) and the matches of the gyro matcher between them.
+struct MatchedFramePair {
+  VisualFrame::Ptr frame_k;
+  VisualFrame::Ptr frame_kp1;
+  Quaternion q_Ckp1_Ck;
+  FrameToFrameMatchesWithScore matches_kp1_k;
+};
+
+MatchedFramePair createMatchedFramePair(size_t num_keypoints) {
+  const size_t kNumFrames = 2u;
+  const double kRotationDeg = 2.0;
+  const simulation::SyntheticScene::Ptr scene =
+      simulation::SyntheticScene::createWithNumKeypointsPerFrame(
+          simulation::createPinholeNCamera(kImageWidth, kImageHeight), num_keypoints,
+          createRotationSceneOptions(kNumFrames, kRotationDeg, kSeed));
+
+  MatchedFramePair frames;
+  frames.frame_k = scene->createNFrame(0u).nframe->getFrameShared(0u);
+  frames.frame_kp1 = scene->createNFrame(1u).nframe->getFrameShared(0u);
+  frames.q_Ckp1_Ck = scene->get_T_Ca_Cb(1u, 0u, 0u).getRotation();
+  Eigen::Matrix2Xd predicted_keypoints_kp1;
+  std::vector<unsigned char> prediction_success;
+  predictKeypointsByRotation(*frames.frame_k, frames.q_Ckp1_Ck, &predicted_keypoints_kp1,
+                             &prediction_success);
+  GyroTwoFrameMatcher matcher(kImageHeight);
+  matcher.match(frames.q_Ckp1_Ck, *frames.frame_kp1, *frames.frame_k, predicted_keypoints_kp1,
+                prediction_success, &frames.matches_kp1_k);
+  return frames;
+}
+
+}  // namespace
+
+void registerGeometricVisionBenchmarks(BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+  CHECK_GT(FLAGS_benchmark_geometric_vision_num_correspondences, 0);
+  CHECK_GE(FLAGS_benchmark_geometric_vision_outlier_ratio, 0.0);
+  CHECK_LT(FLAGS_benchmark_geometric_vision_outlier_ratio, 1.0);
+  const size_t num_correspondences = FLAGS_benchmark_geometric_vision_num_correspondences;
+  const double outlier_ratio = FLAGS_benchmark_geometric_vision_outlier_ratio;
+
+  const size_t kNumRansacThreads[] = {1u, 4u};
+  for (const size_t num_threads : kNumRansacThreads) {
+    registry->add("geometric_vision", "absolute_pose_ransac/threads=" +
+                  std::to_string(num_threads) + "/correspondences=" +
+                  std::to_string(num_correspondences), [=](BenchmarkState* state) {
+      const AbsolutePoseProblem problem =
+          createAbsolutePoseProblem(num_correspondences, outlier_ratio);
+      // Deterministic seed, every call generates the same hypotheses.
+      const bool kRunNonlinearRefinement = true;
+      const bool kRandomSeed = false;
+      geometric_vision::PnpPoseEstimator estimator(
+          kRunNonlinearRefinement, kRandomSeed, num_threads);
+      Transformation T_G_C;
+      std::vector<int> inliers;
+      int num_iterations = 0;
+      state->setNumItemsPerCall(num_correspondences);
+      state->run([&]() {
+        estimator.absolutePoseRansacPinholeCam(
+            problem.measurements, problem.G_landmarks, kPixelSigma, kMaxNumRansacIterations,
+            problem.camera, &T_G_C, &inliers, &num_iterations);
+      });
+      state->setCounter("inliers", inliers.size());
+      state->setCounter("iterations", num_iterations);
+    });
+  }
+
+  const size_t kNumKeypoints = 1000u;
+  // 1 - cos(0.5 deg), the ray disparity threshold of the tracker.
+  const double kRansacThreshold = 1.0 - std::cos(0.5 * M_PI / 180.0);
+  const size_t kMaxNumTwoPointIterations = 200u;
+  registry->add("geometric_vision", "two_point_outlier_rejection_sac/keypoints=1000",
+                [=](BenchmarkState* state) {
+    const MatchedFramePair frames = createMatchedFramePair(kNumKeypoints);
+    FrameToFrameMatchesWithScore inlier_matches_kp1_k;
+    FrameToFrameMatchesWithScore outlier_matches_kp1_k;
+    state->setNumItemsPerCall(frames.matches_kp1_k.size());
+    state->run([&]() {
+      geometric_vision::rejectOutlierFeatureMatchesTranslationRotationSAC(
+          *frames.frame_kp1, *frames.frame_k, frames.q_Ckp1_Ck, frames.matches_kp1_k, true,
+          kRansacThreshold, kMaxNumTwoPointIterations, &inlier_matches_kp1_k,
+          &outlier_matches_kp1_k);
+    });
+    state->setCounter("inliers", inlier_matches_kp1_k.size());
+  });
+
+  registry->add("geometric_vision", "two_point_outlier_rejection_single_pass/keypoints=1000",
+                [=](BenchmarkState* state) {
+    const MatchedFramePair frames = createMatchedFramePair(kNumKeypoints);
+    const double kEarlyExitInlierRatio = 1.0;
+    FrameToFrameMatchesWithScore inlier_matches_kp1_k;
+    FrameToFrameMatchesWithScore outlier_matches_kp1_k;
+    state->setNumItemsPerCall(frames.matches_kp1_k.size());
+    state->run([&]() {
+      geometric_vision::rejectOutlierFeatureMatchesTranslationRotationSinglePass(
+          *frames.frame_kp1, *frames.frame_k, frames.q_Ckp1_Ck, frames.matches_kp1_k, true,
+          kRansacThreshold, kMaxNumTwoPointIterations, kEarlyExitInlierRatio,
+          &inlier_matches_kp1_k, &outlier_matches_kp1_k);
+    });
+    state->setCounter("inliers", inlier_matches_kp1_k.size());
+  });
+
+  registry->add("geometric_vision", "two_point_outlier_rejection_gyro_prior/keypoints=1000",
+                [=](BenchmarkState* state) {
+    const MatchedFramePair frames = createMatchedFramePair(kNumKeypoints);
+    const bool kRefineRotation = true;
+    FrameToFrameMatchesWithScore inlier_matches_kp1_k;
+    FrameToFrameMatchesWithScore outlier_matches_kp1_k;
+    state->setNumItemsPerCall(frames.matches_kp1_k.size());
+    state->run([&]() {
+      geometric_vision::rejectOutlierFeatureMatchesGyroPriorSAC(
+          *frames.frame_kp1, *frames.frame_k, frames.q_Ckp1_Ck, frames.matches_kp1_k, true,
+          kRansacThreshold, kMaxNumTwoPointIterations, kRefineRotation, &inlier_matches_kp1_k,
+          &outlier_matches_kp1_k);
+    });
+    state->setCounter("inliers", inlier_matches_kp1_k.size());
+  });
+}
+
+}  // namespace benchmarks
+}  // namespace aslam
@@ -0,0 +1,142 @@
+// The frame-to-frame matching problem, the matching engines on top of it and the gyro two frame
+// matcher on synthetic frames, see matcher-benchmark.cc of aslam_cv_matcher for the sweep over
+// descriptor sizes, search radii and rotations.
+#include <string>
+#include <vector>
+
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/gyro-two-frame-matcher.h>
+#include <aslam/matcher/match-helpers.h>
+#include <aslam/matcher/matching-engine-cross-check.h>
+#include <aslam/matcher/matching-engine-exclusive.h>
+#include <aslam/matcher/matching-engine-greedy.h>
+#include <aslam/matcher/matching-engine-non-exclusive.h>
+#include <aslam/matcher/matching-problem-frame-to-frame.h>
+#include <aslam/simulation/synthetic-scene.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "aslam/benchmarks/suites.h"
+#include "aslam/benchmarks/synthetic-scenes.h"
+
+DEFINE_string(benchmark_matcher_num_keypoints, "1000,5000",
+              "Comma separated numbers of keypoints per frame.");
+static const bool num_keypoints_validator_registered = google::RegisterFlagValidator(
+    &FLAGS_benchmark_matcher_num_keypoints, &aslam::benchmarks::validatePositiveIntegerList);
+
+namespace aslam {
+namespace benchmarks {
+namespace {
+
+const double kRotationDeg = 2.0;
+const double kSearchRadiusPx = 25.0;
+const int kHammingDistanceThreshold = 60;
+
+/// Frame k, frame (k+1) rotated by q_Ckp1_Ck and the rotation.
+struct FramePair {
+  VisualFrame::Ptr frame_k;
+  VisualFrame::Ptr frame_kp1;
+  Quaternion q_Ckp1_Ck;
+};
+
+FramePair createFramePair(size_t num_keypoints) {
+  const size_t kNumFrames = 2u;
+  const simulation::SyntheticScene::Ptr scene =
+      simulation::SyntheticScene::createWithNumKeypointsPerFrame(
+          simulation::createPinholeNCamera(kImageWidth, kImageHeight), num_keypoints,
+          createRotationSceneOptions(kNumFrames, kRotationDeg, kSeed));
+  FramePair frames;
+  frames.frame_k = scene->createNFrame(0u).nframe->getFrameShared(0u);
+  frames.frame_kp1 = scene->createNFrame(1u).nframe->getFrameShared(0u);
+  frames.q_Ckp1_Ck = scene->get_T_Ca_Cb(1u, 0u, 0u).getRotation();
+  return frames;
+}
+
+/// Apples are the keypoints of frame k, bananas the ones of frame (k+1).
+template <typename MatchingEngine>
+void benchmarkEngine(size_t num_keypoints, BenchmarkState* state) {
+  CHECK_NOTNULL(state);
+  const FramePair frames = createFramePair(num_keypoints);
+  const Quaternion q_Ck_Ckp1 = frames.q_Ckp1_Ck.inverse();
+  MatchingEngine engine;
+  MatchingProblemFrameToFrame::MatchesWithScore matches;
+  state->setNumItemsPerCall(frames.frame_k->getNumKeypointMeasurements());
+  state->run([&]() {
+    MatchingProblemFrameToFrame problem(*frames.frame_k, *frames.frame_kp1, q_Ck_Ckp1,
+                                        kSearchRadiusPx, kHammingDistanceThreshold);
+    engine.match(&problem, &matches);
+  });
+  state->setCounter("matches", matches.size());
+}
+
+}  // namespace
+
+void registerMatcherBenchmarks(BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+  for (const std::string& num_keypoints_string :
+       splitList(FLAGS_benchmark_matcher_num_keypoints)) {
+    size_t num_keypoints;
+    CHECK(parsePositiveInteger(num_keypoints_string, &num_keypoints))
+        << "--benchmark_matcher_num_keypoints: '" << num_keypoints_string
+        << "' is not a positive integer.";
+    const std::string suffix = "/keypoints=" + num_keypoints_string;
+
+    registry->add("matcher", "frame_to_frame_setup_and_candidates" + suffix,
+                  [num_keypoints](BenchmarkState* state) {
+      const FramePair frames = createFramePair(num_keypoints);
+      const Quaternion q_Ck_Ckp1 = frames.q_Ckp1_Ck.inverse();
+      MatchingProblem::CandidatesList candidates;
+      state->setNumItemsPerCall(frames.frame_k->getNumKeypointMeasurements());
+      state->run([&]() {
+        MatchingProblemFrameToFrame problem(*frames.frame_k, *frames.frame_kp1, q_Ck_Ckp1,
+                                            kSearchRadiusPx, kHammingDistanceThreshold);
+        problem.doSetup();
+        problem.getCandidates(&candidates);
+      });
+      size_t num_candidates = 0u;
+      for (const MatchingProblem::Candidates& banana_candidates : candidates) {
+        num_candidates += banana_candidates.size();
+      }
+      state->setCounter("candidates", num_candidates);
+    });
+
+    registry->add("matcher", "engine_exclusive" + suffix, [num_keypoints](BenchmarkState* state) {
+      benchmarkEngine<MatchingEngineExclusive<MatchingProblemFrameToFrame>>(num_keypoints, state);
+    });
+    registry->add("matcher", "engine_greedy" + suffix, [num_keypoints](BenchmarkState* state) {
+      benchmarkEngine<MatchingEngineGreedy<MatchingProblemFrameToFrame>>(num_keypoints, state);
+    });
+    registry->add("matcher", "engine_non_exclusive" + suffix,
+                  [num_keypoints](BenchmarkState* state) {
+      benchmarkEngine<MatchingEngineNonExclusive<MatchingProblemFrameToFrame>>(
+          num_keypoints, state);
+    });
+    registry->add("matcher", "engine_cross_check" + suffix,
+                  [num_keypoints](BenchmarkState* state) {
+      benchmarkEngine<MatchingEngineCrossCheck<MatchingProblemFrameToFrame>>(
+          num_keypoints, state);
+    });
+
+    registry->add("matcher", "gyro_two_frame_matcher" + suffix,
+                  [num_keypoints](BenchmarkState* state) {
+      const FramePair frames = createFramePair(num_keypoints);
+      Eigen::Matrix2Xd predicted_keypoints_kp1;
+      std::vector<unsigned char> prediction_success;
+      predictKeypointsByRotation(*frames.frame_k, frames.q_Ckp1_Ck, &predicted_keypoints_kp1,
+                                 &prediction_success);
+      // Long-lived like in the tracker, reuses its buffers across calls.
+      GyroTwoFrameMatcher matcher(kImageHeight);
+      FrameToFrameMatchesWithScore matches_kp1_k;
+      state->setNumItemsPerCall(frames.frame_k->getNumKeypointMeasurements());
+      state->run([&]() {
+        matcher.match(frames.q_Ckp1_Ck, *frames.frame_kp1, *frames.frame_k,
+                      predicted_keypoints_kp1, prediction_success, &matches_kp1_k);
+      });
+      state->setCounter("matches", matches_kp1_k.size());
+    });
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace aslam
@@ -0,0 +1,109 @@
+// The image undistortion and the BRISK and FAST/BRIEF visual pipelines on synthetic images, see
+// pipeline-benchmark.cc of aslam_cv_tracker for recorded sequences.
+#include <memory>
+#include <random>
+#include <string>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <aslam/common/types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/pipeline/undistorter-mapped.h>
+#include <aslam/pipeline/visual-pipeline-brisk.h>
+#include <aslam/pipeline/visual-pipeline-fast-brief.h>
+#include <aslam/simulation/synthetic-scene.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "aslam/benchmarks/suites.h"
+
+namespace aslam {
+namespace benchmarks {
+namespace {
+
+const int64_t kTimestampNanoseconds = 50000000;
+
+// The defaults of pipeline-benchmark.cc.
+const size_t kBriskOctaves = 0u;
+const double kBriskUniformityRadius = 5.0;
+const double kBriskAbsoluteThreshold = 45.0;
+const size_t kBriskMaxNumKeypoints = 1000u;
+const bool kRotationInvariant = true;
+const bool kScaleInvariant = false;
+
+cv::Mat sampleImage(const Camera& camera) {
+  std::mt19937 generator(kSeed);
+  return simulation::createTexturedImage(camera.imageWidth(), camera.imageHeight(), &generator);
+}
+
+std::unique_ptr<MappedUndistorter> createUndistorter(const PinholeCamera& camera) {
+  const float kAlpha = 0.0f;
+  const float kScale = 1.0f;
+  return createMappedUndistorter(camera, kAlpha, kScale, InterpolationMethod::Linear);
+}
+
+}  // namespace
+
+void registerPipelineBenchmarks(BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+
+  registry->add("pipeline", "mapped_undistorter/pinhole_radtan/640x480",
+                [](BenchmarkState* state) {
+    const PinholeCamera::Ptr camera = PinholeCamera::createTestCamera<RadTanDistortion>();
+    const std::unique_ptr<MappedUndistorter> undistorter = createUndistorter(*camera);
+    const cv::Mat image = sampleImage(*camera);
+    cv::Mat undistorted_image;
+    state->setNumItemsPerCall(image.total());
+    state->run([&]() { undistorter->processImage(image, &undistorted_image); });
+  });
+
+  registry->add("pipeline", "brisk_visual_pipeline/pinhole/752x480",
+                [](BenchmarkState* state) {
+    const Camera::Ptr camera =
+        simulation::createPinholeNCamera(kImageWidth, kImageHeight)->getCameraShared(0u);
+    const bool kCopyImages = false;
+    BriskVisualPipeline pipeline(camera, kCopyImages, kBriskOctaves, kBriskUniformityRadius,
+                                 kBriskAbsoluteThreshold, kBriskMaxNumKeypoints,
+                                 kRotationInvariant, kScaleInvariant);
+    const cv::Mat image = sampleImage(*camera);
+    VisualFrame::Ptr frame;
+    state->setNumItemsPerCall(image.total());
+    state->run([&]() { frame = pipeline.processImage(image, kTimestampNanoseconds); });
+    state->setCounter("keypoints", frame->getNumKeypointMeasurements());
+  });
+
+  // The same keypoint budget as the BRISK pipeline.
+  registry->add("pipeline", "fast_brief_visual_pipeline/pinhole/752x480",
+                [](BenchmarkState* state) {
+    const Camera::Ptr camera =
+        simulation::createPinholeNCamera(kImageWidth, kImageHeight)->getCameraShared(0u);
+    const bool kCopyImages = false;
+    FastBriefVisualPipeline::Options options;
+    options.max_num_keypoints = kBriskMaxNumKeypoints;
+    options.rotation_invariant = kRotationInvariant;
+    FastBriefVisualPipeline pipeline(camera, kCopyImages, options);
+    const cv::Mat image = sampleImage(*camera);
+    VisualFrame::Ptr frame;
+    state->setNumItemsPerCall(image.total());
+    state->run([&]() { frame = pipeline.processImage(image, kTimestampNanoseconds); });
+    state->setCounter("keypoints", frame->getNumKeypointMeasurements());
+  });
+
+  registry->add("pipeline", "brisk_visual_pipeline_undistorted/pinhole_radtan/640x480",
+                [](BenchmarkState* state) {
+    const PinholeCamera::Ptr camera = PinholeCamera::createTestCamera<RadTanDistortion>();
+    std::unique_ptr<Undistorter> undistorter(createUndistorter(*camera).release());
+    const bool kCopyImages = false;
+    BriskVisualPipeline pipeline(undistorter, kCopyImages, kBriskOctaves, kBriskUniformityRadius,
+                                 kBriskAbsoluteThreshold, kBriskMaxNumKeypoints,
+                                 kRotationInvariant, kScaleInvariant);
+    const cv::Mat image = sampleImage(*camera);
+    VisualFrame::Ptr frame;
+    state->setNumItemsPerCall(image.total());
+    state->run([&]() { frame = pipeline.processImage(image, kTimestampNanoseconds); });
+    state->setCounter("keypoints", frame->getNumKeypointMeasurements());
+  });
+}
+
+}  // namespace benchmarks
+}  // namespace aslam
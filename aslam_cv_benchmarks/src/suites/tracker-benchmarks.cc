@@ -0,0 +1,153 @@
+// The tracker stages on synthetic frames: the rotation prediction, GyroTracker::track and
+// UniformTrackManager::applyMatchesToFrames, see tracker-benchmark.cc of aslam_cv_tracker for
+// the sweep over image sizes and rotations.
+#include <string>
+#include <vector>
+
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/match-helpers.h>
+#include <aslam/simulation/synthetic-scene.h>
+#include <aslam/tracker/feature-tracker-gyro.h>
+#include <aslam/tracker/track-manager.h>
+#include <brisk/brisk.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "aslam/benchmarks/suites.h"
+#include "aslam/benchmarks/synthetic-scenes.h"
+
+DEFINE_string(benchmark_tracker_num_keypoints, "1000,2000",
+              "Comma separated numbers of keypoints per frame.");
+static const bool num_keypoints_validator_registered = google::RegisterFlagValidator(
+    &FLAGS_benchmark_tracker_num_keypoints, &aslam::benchmarks::validatePositiveIntegerList);
+
+namespace aslam {
+namespace benchmarks {
+namespace {
+
+const double kRotationDeg = 2.0;
+
+const size_t kNumTrackingBucketsRoot = 4u;
+const size_t kMaxNumWeakNewTracks = 200u;
+const size_t kNumStrongNewTracksToForcePush = 50u;
+const double kStrongNewTrackScoreThreshold = 0.85;
+
+/// Frames (k-1), k and (k+1) with images, rotated by q_Ck_Ckm1 and q_Ckp1_Ck.
+struct FrameTriple {
+  Camera::Ptr camera;
+  VisualFrame::Ptr frame_km1;
+  VisualFrame::Ptr frame_k;
+  VisualFrame::Ptr frame_kp1;
+  Quaternion q_Ck_Ckm1;
+  Quaternion q_Ckp1_Ck;
+};
+
+FrameTriple createFrameTriple(size_t num_keypoints) {
+  const size_t kNumFrames = 3u;
+  simulation::SyntheticScene::Options options =
+      createRotationSceneOptions(kNumFrames, kRotationDeg, kSeed);
+  options.add_raw_images = true;
+  const NCamera::Ptr ncamera = simulation::createPinholeNCamera(kImageWidth, kImageHeight);
+  const simulation::SyntheticScene::Ptr scene =
+      simulation::SyntheticScene::createWithNumKeypointsPerFrame(ncamera, num_keypoints, options);
+
+  FrameTriple frames;
+  frames.camera = ncamera->getCameraShared(0u);
+  frames.frame_km1 = scene->createNFrame(0u).nframe->getFrameShared(0u);
+  frames.frame_k = scene->createNFrame(1u).nframe->getFrameShared(0u);
+  frames.frame_kp1 = scene->createNFrame(2u).nframe->getFrameShared(0u);
+  frames.q_Ck_Ckm1 = scene->get_T_Ca_Cb(1u, 0u, 0u).getRotation();
+  frames.q_Ckp1_Ck = scene->get_T_Ca_Cb(2u, 1u, 0u).getRotation();
+  return frames;
+}
+
+/// Copies of the frames, which are modified by the tracker and the track manager.
+struct TrackedFrames {
+  explicit TrackedFrames(const FrameTriple& frames)
+      : frame_km1(*frames.frame_km1), frame_k(*frames.frame_k), frame_kp1(*frames.frame_kp1) {}
+  VisualFrame frame_km1;
+  VisualFrame frame_k;
+  VisualFrame frame_kp1;
+};
+
+}  // namespace
+
+void registerTrackerBenchmarks(BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+  for (const std::string& num_keypoints_string :
+       splitList(FLAGS_benchmark_tracker_num_keypoints)) {
+    size_t num_keypoints;
+    CHECK(parsePositiveInteger(num_keypoints_string, &num_keypoints))
+        << "--benchmark_tracker_num_keypoints: '" << num_keypoints_string
+        << "' is not a positive integer.";
+    const std::string suffix = "/keypoints=" + num_keypoints_string;
+
+    registry->add("tracker", "predict_keypoints_by_rotation" + suffix,
+                  [num_keypoints](BenchmarkState* state) {
+      const FrameTriple frames = createFrameTriple(num_keypoints);
+      Eigen::Matrix2Xd predicted_keypoints_kp1;
+      std::vector<unsigned char> prediction_success;
+      state->setNumItemsPerCall(frames.frame_k->getNumKeypointMeasurements());
+      state->run([&]() {
+        predictKeypointsByRotation(*frames.frame_k, frames.q_Ckp1_Ck, &predicted_keypoints_kp1,
+                                   &prediction_success);
+      });
+    });
+
+    registry->add("tracker", "gyro_tracker_track" + suffix,
+                  [num_keypoints](BenchmarkState* state) {
+      const FrameTriple frames = createFrameTriple(num_keypoints);
+      const cv::Ptr<cv::DescriptorExtractor> extractor(
+          new brisk::BriskDescriptorExtractor(true, false));
+      UniformTrackManager track_manager(kNumTrackingBucketsRoot, kMaxNumWeakNewTracks,
+                                        kNumStrongNewTracksToForcePush,
+                                        kStrongNewTrackScoreThreshold);
+      size_t num_tracked = 0u;
+      state->setNumItemsPerCall(frames.frame_k->getNumKeypointMeasurements());
+      for (size_t repetition = 0u; repetition < state->getNumRepetitions(); ++repetition) {
+        // The tracker keeps state between the calls, start every repetition from scratch and
+        // track (k-1) -> k first, such that the LK tracking of k -> (k+1) has candidates.
+        GyroTracker tracker(*frames.camera, kMinDistanceToImageBorderPx, extractor);
+        TrackedFrames tracked(frames);
+        FrameToFrameMatchesWithScore matches_k_km1;
+        tracker.track(frames.q_Ck_Ckm1, tracked.frame_km1, &tracked.frame_k, &matches_k_km1);
+        track_manager.applyMatchesToFrames(matches_k_km1, &tracked.frame_k, &tracked.frame_km1);
+
+        FrameToFrameMatchesWithScore matches_kp1_k;
+        state->measure([&]() {
+          tracker.track(frames.q_Ckp1_Ck, tracked.frame_k, &tracked.frame_kp1, &matches_kp1_k);
+        });
+        num_tracked += matches_kp1_k.size();
+      }
+      state->setCounter("tracked_per_call",
+                        static_cast<double>(num_tracked) / state->getNumRepetitions());
+    });
+
+    registry->add("tracker", "uniform_track_manager_apply_matches" + suffix,
+                  [num_keypoints](BenchmarkState* state) {
+      const FrameTriple frames = createFrameTriple(num_keypoints);
+      const cv::Ptr<cv::DescriptorExtractor> extractor(
+          new brisk::BriskDescriptorExtractor(true, false));
+      GyroTracker tracker(*frames.camera, kMinDistanceToImageBorderPx, extractor);
+      TrackedFrames reference(frames);
+      FrameToFrameMatchesWithScore matches_kp1_k;
+      tracker.track(frames.q_Ckp1_Ck, reference.frame_k, &reference.frame_kp1, &matches_kp1_k);
+      state->setNumItemsPerCall(frames.frame_k->getNumKeypointMeasurements());
+      for (size_t repetition = 0u; repetition < state->getNumRepetitions(); ++repetition) {
+        UniformTrackManager track_manager(kNumTrackingBucketsRoot, kMaxNumWeakNewTracks,
+                                          kNumStrongNewTracksToForcePush,
+                                          kStrongNewTrackScoreThreshold);
+        VisualFrame frame_k(reference.frame_k);
+        VisualFrame frame_kp1(reference.frame_kp1);
+        state->measure([&]() {
+          track_manager.applyMatchesToFrames(matches_kp1_k, &frame_kp1, &frame_k);
+        });
+      }
+      state->setCounter("matches", matches_kp1_k.size());
+    });
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace aslam
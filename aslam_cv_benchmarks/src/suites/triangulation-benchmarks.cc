@@ -0,0 +1,252 @@
+// The triangulation variants on synthetic landmarks observed by a single camera, see
+// triangulation-benchmark.cc of aslam_cv_triangulation for the accuracy sweep over the noise and
+// the number of cameras of the rig. The multi-camera variant triangulates the tracks of a
+// synthetic scene observed by a surround view rig.
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/simulation/synthetic-scene.h>
+#include <aslam/triangulation/triangulation.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "aslam/benchmarks/suites.h"
+
+DEFINE_int32(benchmark_triangulation_num_landmarks, 2000,
+             "Number of landmarks triangulated per call.");
+
+namespace aslam {
+namespace benchmarks {
+namespace {
+
+/// Keypoint noise of 0.5 px at a focal length of 400 px.
+const double kNoiseSigmaNormalized = 0.5 / 400.0;
+
+/// All landmarks of one configuration, observed along a 1 m baseline.
+struct Problems {
+  Aligned<std::vector, Eigen::Vector3d> G_landmarks;
+  std::vector<Aligned<std::vector, Eigen::Vector2d>> measurements;
+  std::vector<TransformationVector> T_G_Cs;
+  std::vector<Eigen::Matrix3Xd> G_bearing_vectors;
+  std::vector<Eigen::Matrix3Xd> p_G_Cs;
+};
+
+Problems createProblems(size_t num_landmarks, size_t num_observations) {
+  CHECK_GE(num_observations, 2u);
+  // Transformation::setRandom uses std::rand().
+  std::srand(kSeed);
+  std::mt19937 generator(kSeed);
+  std::uniform_real_distribution<double> unit_distribution(-1.0, 1.0);
+  std::normal_distribution<double> noise_distribution(0.0, kNoiseSigmaNormalized);
+
+  Problems problems;
+  problems.G_landmarks.resize(num_landmarks);
+  problems.measurements.resize(num_landmarks);
+  problems.T_G_Cs.resize(num_landmarks);
+  problems.G_bearing_vectors.resize(num_landmarks);
+  problems.p_G_Cs.resize(num_landmarks);
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks; ++landmark_idx) {
+    const Eigen::Vector3d G_landmark(unit_distribution(generator), unit_distribution(generator),
+                                     6.0 + 2.0 * unit_distribution(generator));
+    problems.G_landmarks[landmark_idx] = G_landmark;
+    problems.measurements[landmark_idx].resize(num_observations);
+    problems.T_G_Cs[landmark_idx].resize(num_observations);
+    problems.G_bearing_vectors[landmark_idx].resize(3, num_observations);
+    problems.p_G_Cs[landmark_idx].resize(3, num_observations);
+    for (size_t i = 0u; i < num_observations; ++i) {
+      Transformation& T_G_C = problems.T_G_Cs[landmark_idx][i];
+      T_G_C.setRandom(0.05, 0.05);
+      T_G_C.getPosition() += Eigen::Vector3d(
+          static_cast<double>(i) / (num_observations - 1u) - 0.5, 0.0, 0.0);
+      const Eigen::Vector3d C_landmark = T_G_C.inverse().transform(G_landmark);
+      const Eigen::Vector2d measurement = C_landmark.head<2>() / C_landmark(2) +
+          Eigen::Vector2d(noise_distribution(generator), noise_distribution(generator));
+      problems.measurements[landmark_idx][i] = measurement;
+      problems.G_bearing_vectors[landmark_idx].col(i) =
+          T_G_C.getRotationMatrix() * Eigen::Vector3d(measurement(0), measurement(1), 1.0);
+      problems.p_G_Cs[landmark_idx].col(i) = T_G_C.getPosition();
+    }
+  }
+  return problems;
+}
+
+/// Times the triangulation of all landmarks per call and reports the success rate and the mean
+/// error of the last call.
+template <typename TriangulationFunction>
+void benchmarkVariant(size_t num_landmarks, size_t num_observations,
+                      const TriangulationFunction& triangulate, BenchmarkState* state) {
+  CHECK_NOTNULL(state);
+  const Problems problems = createProblems(num_landmarks, num_observations);
+  Aligned<std::vector, Eigen::Vector3d> G_points(num_landmarks);
+  std::vector<unsigned char> success(num_landmarks);
+  state->setNumItemsPerCall(num_landmarks);
+  state->run([&]() {
+    for (size_t i = 0u; i < num_landmarks; ++i) {
+      success[i] = static_cast<bool>(triangulate(problems, i, &G_points[i]));
+    }
+  });
+
+  size_t num_successful = 0u;
+  double sum_errors = 0.0;
+  for (size_t i = 0u; i < num_landmarks; ++i) {
+    if (success[i]) {
+      ++num_successful;
+      sum_errors += (G_points[i] - problems.G_landmarks[i]).norm();
+    }
+  }
+  state->setCounter("success_rate", static_cast<double>(num_successful) / num_landmarks);
+  // Without a successful triangulation the error is undefined and not reported.
+  if (num_successful > 0u) {
+    state->setCounter("mean_error_m", sum_errors / num_successful);
+  }
+}
+
+/// The observations of every landmark of a synthetic scene, in all cameras of all nframes.
+struct SceneTracks {
+  Aligned<std::vector, Eigen::Vector3d> G_landmarks;
+  std::vector<Aligned<std::vector, Eigen::Vector2d>> measurements;
+  std::vector<std::vector<size_t>> camera_indices;
+  std::vector<TransformationVector> T_G_Bs;
+  TransformationVector T_B_Cs;
+};
+
+SceneTracks createSceneTracks(size_t num_landmarks, size_t num_frames) {
+  simulation::SyntheticScene::Options options;
+  options.num_landmarks = num_landmarks;
+  options.num_frames = num_frames;
+  options.seed = kSeed;
+  const NCamera::Ptr ncamera = NCamera::createSurroundViewTestNCamera();
+  const simulation::SyntheticScene scene(ncamera, options);
+  const std::vector<simulation::SyntheticNFrame> nframes = scene.createAllNFrames();
+
+  SceneTracks all_tracks;
+  all_tracks.measurements.resize(num_landmarks);
+  all_tracks.camera_indices.resize(num_landmarks);
+  all_tracks.T_G_Bs.resize(num_landmarks);
+  for (size_t camera_idx = 0u; camera_idx < ncamera->getNumCameras(); ++camera_idx) {
+    all_tracks.T_B_Cs.push_back(ncamera->get_T_C_B(camera_idx).inverse());
+  }
+  for (const simulation::SyntheticNFrame& nframe : nframes) {
+    for (size_t camera_idx = 0u; camera_idx < ncamera->getNumCameras(); ++camera_idx) {
+      const VisualFrame& frame = nframe.nframe->getFrame(camera_idx);
+      const Eigen::VectorXi& landmark_indices = nframe.landmark_indices[camera_idx];
+      for (int i = 0; i < landmark_indices.size(); ++i) {
+        Eigen::Vector3d C_ray;
+        if (landmark_indices(i) < 0 ||
+            !ncamera->getCamera(camera_idx).backProject3(frame.getKeypointMeasurement(i), &C_ray)) {
+          continue;
+        }
+        const size_t landmark_idx = landmark_indices(i);
+        all_tracks.measurements[landmark_idx].push_back(C_ray.head<2>() / C_ray(2));
+        all_tracks.camera_indices[landmark_idx].push_back(camera_idx);
+        all_tracks.T_G_Bs[landmark_idx].push_back(nframe.T_G_B);
+      }
+    }
+  }
+
+  // Only the landmarks with at least two observations.
+  SceneTracks tracks;
+  tracks.T_B_Cs = all_tracks.T_B_Cs;
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks; ++landmark_idx) {
+    if (all_tracks.measurements[landmark_idx].size() < 2u) {
+      continue;
+    }
+    tracks.G_landmarks.push_back(scene.getLandmarks().col(landmark_idx));
+    tracks.measurements.push_back(all_tracks.measurements[landmark_idx]);
+    tracks.camera_indices.push_back(all_tracks.camera_indices[landmark_idx]);
+    tracks.T_G_Bs.push_back(all_tracks.T_G_Bs[landmark_idx]);
+  }
+  return tracks;
+}
+
+}  // namespace
+
+void registerTriangulationBenchmarks(BenchmarkRegistry* registry) {
+  CHECK_NOTNULL(registry);
+  CHECK_GT(FLAGS_benchmark_triangulation_num_landmarks, 0);
+  const size_t num_landmarks = FLAGS_benchmark_triangulation_num_landmarks;
+  const Transformation T_B_C;
+  const size_t kNumObservations[] = {2u, 3u, 10u};
+
+  for (const size_t num_observations : kNumObservations) {
+    const std::string suffix = "/observations=" + std::to_string(num_observations) +
+        "/landmarks=" + std::to_string(num_landmarks);
+
+    registry->add("triangulation", "linear_n_views" + suffix, [=](BenchmarkState* state) {
+      benchmarkVariant(num_landmarks, num_observations,
+                       [&T_B_C](const Problems& problems, size_t i, Eigen::Vector3d* G_point) {
+        return linearTriangulateFromNViews<Eigen::Dynamic>(
+            problems.measurements[i], problems.T_G_Cs[i], T_B_C, G_point);
+      }, state);
+    });
+
+    // The dispatching version, which uses the fixed-size solvers for 2 and 3 views.
+    registry->add("triangulation", "linear_n_views_dispatch" + suffix,
+                  [=](BenchmarkState* state) {
+      benchmarkVariant(num_landmarks, num_observations,
+                       [&T_B_C](const Problems& problems, size_t i, Eigen::Vector3d* G_point) {
+        return linearTriangulateFromNViews(
+            problems.measurements[i], problems.T_G_Cs[i], T_B_C, G_point);
+      }, state);
+    });
+
+    registry->add("triangulation", "linear_n_views_bearing_vectors" + suffix,
+                  [=](BenchmarkState* state) {
+      benchmarkVariant(num_landmarks, num_observations,
+                       [](const Problems& problems, size_t i, Eigen::Vector3d* G_point) {
+        return linearTriangulateFromNViews(
+            problems.G_bearing_vectors[i], problems.p_G_Cs[i], G_point);
+      }, state);
+    });
+
+    registry->add("triangulation", "gauss_newton_n_views" + suffix, [=](BenchmarkState* state) {
+      benchmarkVariant(num_landmarks, num_observations,
+                       [&T_B_C](const Problems& problems, size_t i, Eigen::Vector3d* G_point) {
+        return iterativeGaussNewtonTriangulateFromNViews(
+            problems.measurements[i], problems.T_G_Cs[i], T_B_C, G_point);
+      }, state);
+    });
+  }
+
+  const size_t kNumSceneFrames = 10u;
+  registry->add("triangulation", "linear_n_views_multi_cam/surround_view/frames=" +
+                std::to_string(kNumSceneFrames) + "/landmarks=" + std::to_string(num_landmarks),
+                [=](BenchmarkState* state) {
+    const SceneTracks tracks = createSceneTracks(num_landmarks, kNumSceneFrames);
+    const size_t num_tracks = tracks.G_landmarks.size();
+    CHECK_GT(num_tracks, 0u);
+    Aligned<std::vector, Eigen::Vector3d> G_points(num_tracks);
+    std::vector<unsigned char> success(num_tracks);
+    state->setNumItemsPerCall(num_tracks);
+    state->run([&]() {
+      for (size_t i = 0u; i < num_tracks; ++i) {
+        success[i] = static_cast<bool>(linearTriangulateFromNViewsMultiCam(
+            tracks.measurements[i], tracks.camera_indices[i], tracks.T_G_Bs[i], tracks.T_B_Cs,
+            &G_points[i]));
+      }
+    });
+
+    size_t num_successful = 0u;
+    double sum_errors = 0.0;
+    for (size_t i = 0u; i < num_tracks; ++i) {
+      if (success[i]) {
+        ++num_successful;
+        sum_errors += (G_points[i] - tracks.G_landmarks[i]).norm();
+      }
+    }
+    state->setCounter("tracks", num_tracks);
+    state->setCounter("success_rate", static_cast<double>(num_successful) / num_tracks);
+    if (num_successful > 0u) {
+      state->setCounter("mean_error_m", sum_errors / num_successful);
+    }
+  });
+}
+
+}  // namespace benchmarks
+}  // namespace aslam
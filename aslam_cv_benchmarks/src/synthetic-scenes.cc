@@ -0,0 +1,35 @@
+#include "aslam/benchmarks/synthetic-scenes.h"
+
+#include <cmath>
+
+#include <glog/logging.h>
+
+namespace aslam {
+namespace benchmarks {
+namespace {
+const int64_t kFramePeriodNanoseconds = 50000000;
+const size_t kDescriptorSizeBytes = 48u;
+const double kKeypointNoisePx = 0.5;
+}  // namespace
+
+simulation::SyntheticScene::Options createRotationSceneOptions(
+    size_t num_frames, double rotation_deg, uint32_t seed) {
+  CHECK_GT(num_frames, 0u);
+  simulation::SyntheticScene::Options options;
+  options.num_frames = num_frames;
+  options.frame_period_nanoseconds = kFramePeriodNanoseconds;
+  options.start_timestamp_nanoseconds = kFramePeriodNanoseconds;
+  options.trajectory_type = simulation::TrajectoryType::kRotation;
+  options.angular_speed_rad_s =
+      rotation_deg / 180.0 * M_PI / (kFramePeriodNanoseconds * 1e-9);
+  options.position_noise_m = 0.0;
+  options.orientation_noise_rad = 0.0;
+  options.descriptor_size_bytes = kDescriptorSizeBytes;
+  options.keypoint_noise_px = kKeypointNoisePx;
+  options.min_distance_to_image_border_px = kMinDistanceToImageBorderPx;
+  options.seed = seed;
+  return options;
+}
+
+}  // namespace benchmarks
+}  // namespace aslam
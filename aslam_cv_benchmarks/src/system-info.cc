@@ -0,0 +1,95 @@
+#include "aslam/benchmarks/system-info.h"
+
+#include <unistd.h>
+
+#include <ctime>
+#include <fstream>
+#include <thread>
+
+#include <aslam/common/cpu.h>
+
+namespace aslam {
+namespace benchmarks {
+namespace {
+
+std::string readCpuModel() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    // x86 reports "model name", most ARM kernels only "Hardware".
+    if (line.compare(0u, 10u, "model name") == 0 || line.compare(0u, 8u, "Hardware") == 0) {
+      const size_t separator = line.find(':');
+      if (separator != std::string::npos && separator + 2u <= line.size()) {
+        return line.substr(separator + 2u);
+      }
+    }
+  }
+  return "unknown";
+}
+
+std::string readFirstLine(const std::string& path) {
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+}  // namespace
+
+SystemInfo getSystemInfo() {
+  SystemInfo info;
+  info.cpu_model = readCpuModel();
+  info.num_hardware_threads = std::thread::hardware_concurrency();
+  info.cpu_scaling_governor =
+      readFirstLine("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor");
+  char hostname[256];
+  if (gethostname(hostname, sizeof(hostname)) == 0) {
+    hostname[sizeof(hostname) - 1u] = '\0';
+    info.hostname = hostname;
+  }
+
+  typedef common::cpu::Isa Isa;
+  const Isa kIsas[] = {Isa::kGeneric, Isa::kSSSE3, Isa::kPopcnt, Isa::kAVX2, Isa::kAVX512,
+                       Isa::kNEON};
+  for (const Isa isa : kIsas) {
+    if (common::cpu::isIsaDetected(isa)) {
+      info.detected_isas.push_back(common::cpu::getIsaName(isa));
+    }
+  }
+  info.best_supported_isa = common::cpu::getIsaName(common::cpu::getBestSupportedIsa());
+
+#ifdef __SSSE3__
+  info.compiled_isas.push_back("ssse3");
+#endif
+#ifdef __POPCNT__
+  info.compiled_isas.push_back("popcnt");
+#endif
+#ifdef __AVX2__
+  info.compiled_isas.push_back("avx2");
+#endif
+#ifdef __AVX512F__
+  info.compiled_isas.push_back("avx512f");
+#endif
+#ifdef __ARM_NEON__
+  info.compiled_isas.push_back("neon");
+#endif
+#ifdef __VERSION__
+  info.compiler = __VERSION__;
+#endif
+#ifdef NDEBUG
+  info.build_type = "release";
+#else
+  info.build_type = "debug";
+#endif
+
+  const std::time_t now = std::time(nullptr);
+  std::tm utc;
+  gmtime_r(&now, &utc);
+  char timestamp[32];
+  std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+  info.timestamp = timestamp;
+  return info;
+}
+
+}  // namespace benchmarks
+}  // namespace aslam
@@ -0,0 +1,113 @@
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+
+#include "aslam/benchmarks/benchmark.h"
+
+namespace aslam {
+namespace benchmarks {
+
+TEST(BenchmarkTest, PercentilesAreNearestRanks) {
+  Measurements measurements;
+  measurements.durations_ms = {7.0, 3.0, 10.0, 1.0, 5.0, 9.0, 2.0, 8.0, 4.0, 6.0};
+  EXPECT_EQ(1.0, measurements.getPercentile(0.0));
+  EXPECT_EQ(1.0, measurements.getPercentile(0.1));
+  EXPECT_EQ(2.0, measurements.getPercentile(0.15));
+  EXPECT_EQ(5.0, measurements.getPercentile(0.5));
+  EXPECT_EQ(10.0, measurements.getPercentile(0.99));
+  EXPECT_EQ(10.0, measurements.getPercentile(1.0));
+  EXPECT_EQ(1.0, measurements.getMin());
+  EXPECT_DOUBLE_EQ(5.5, measurements.getMean());
+
+  Measurements single_measurement;
+  single_measurement.durations_ms = {3.0};
+  EXPECT_EQ(3.0, single_measurement.getPercentile(0.0));
+  EXPECT_EQ(3.0, single_measurement.getPercentile(0.5));
+  EXPECT_EQ(3.0, single_measurement.getPercentile(1.0));
+  EXPECT_EQ(0.0, single_measurement.getStandardDeviation());
+}
+
+TEST(BenchmarkTest, JsonStringsAreEscaped) {
+  const auto to_json = [](const std::string& value) {
+    std::ostringstream out;
+    writeJsonString(value, &out);
+    return out.str();
+  };
+  EXPECT_EQ("\"\"", to_json(""));
+  EXPECT_EQ("\"Intel(R) Core(TM) i7\"", to_json("Intel(R) Core(TM) i7"));
+  EXPECT_EQ("\"a \\\"b\\\" c\"", to_json("a \"b\" c"));
+  EXPECT_EQ("\"C:\\\\tmp\"", to_json("C:\\tmp"));
+  EXPECT_EQ("\"a\\nb\\tc\"", to_json("a\nb\tc"));
+  EXPECT_EQ("\"\\u0001\\u001f\"", to_json(std::string("\x01\x1f")));
+  // UTF-8 is passed through.
+  EXPECT_EQ("\"\xc2\xb5s\"", to_json("\xc2\xb5s"));
+}
+
+TEST(BenchmarkTest, ListsAreSplitAtCommas) {
+  EXPECT_TRUE(splitList("").empty());
+  EXPECT_TRUE(splitList(",,").empty());
+  EXPECT_EQ(std::vector<std::string>({"1000"}), splitList("1000"));
+  EXPECT_EQ(std::vector<std::string>({"1000", "5000"}), splitList("1000,,5000,"));
+  EXPECT_EQ(std::vector<std::string>({"752x480", " 1280x720"}), splitList("752x480, 1280x720"));
+}
+
+TEST(BenchmarkTest, PositiveIntegersAreValidated) {
+  size_t value = 0u;
+  EXPECT_TRUE(parsePositiveInteger("1000", &value));
+  EXPECT_EQ(1000u, value);
+  for (const std::string& invalid : {"", "0", "-1", "+1", " 1", "1 ", "10k", "1e3", "0x10",
+                                     "99999999999999999999999"}) {
+    EXPECT_FALSE(parsePositiveInteger(invalid, &value)) << "'" << invalid << "'";
+  }
+  EXPECT_EQ(1000u, value);
+
+  EXPECT_TRUE(validatePositiveIntegerList("benchmark_num_points", "1,10,,100"));
+  EXPECT_TRUE(validatePositiveIntegerList("benchmark_num_points", ""));
+  EXPECT_FALSE(validatePositiveIntegerList("benchmark_num_points", "1,ten,100"));
+  EXPECT_FALSE(validatePositiveIntegerList("benchmark_num_points", "1,0"));
+}
+
+TEST(BenchmarkTest, FilterSelectsBenchmarksContainingAnyPattern) {
+  BenchmarkRegistry registry;
+  const BenchmarkFunction function = [](BenchmarkState* state) {
+    state->run([]() {});
+  };
+  registry.add("cameras", "project3/pinhole", function);
+  registry.add("matcher", "engine_greedy/keypoints=1000", function);
+  registry.add("matcher", "engine_exclusive/keypoints=5000", function);
+  registry.add("tracker", "gyro_tracker_track/keypoints=1000", function);
+
+  const auto get_full_names = [&registry](const std::string& filter) {
+    std::vector<std::string> full_names;
+    for (const Benchmark* benchmark : registry.getFilteredBenchmarks(filter)) {
+      full_names.push_back(benchmark->getFullName());
+    }
+    return full_names;
+  };
+  EXPECT_EQ(4u, get_full_names("").size());
+  EXPECT_EQ(std::vector<std::string>({"matcher/engine_greedy/keypoints=1000",
+                                      "matcher/engine_exclusive/keypoints=5000"}),
+            get_full_names("matcher/"));
+  // In the order of registration, every benchmark once.
+  EXPECT_EQ(std::vector<std::string>({"cameras/project3/pinhole",
+                                      "matcher/engine_greedy/keypoints=1000",
+                                      "tracker/gyro_tracker_track/keypoints=1000"}),
+            get_full_names("keypoints=1000,cameras,tracker"));
+  EXPECT_TRUE(get_full_names("detector").empty());
+
+  const std::vector<const Benchmark*> benchmarks = registry.getFilteredBenchmarks("cameras");
+  ASSERT_EQ(1u, benchmarks.size());
+  EXPECT_EQ(&registry.getBenchmarks()[0], benchmarks[0]);
+  const BenchmarkResult result = runBenchmark(*benchmarks[0], 5u, 2u);
+  EXPECT_EQ(5u, result.measurements.size());
+  EXPECT_EQ("cameras", result.suite);
+}
+
+}  // namespace benchmarks
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
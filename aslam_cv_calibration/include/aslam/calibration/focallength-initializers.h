@@ -3,6 +3,7 @@
 
 #include <vector>
 
+#include <aslam/common/memory.h>
 #include <Eigen/Core>
 
 #include "aslam/calibration/target-observation.h"
@@ -38,6 +39,35 @@ bool initFocalLengthAbsoluteConic(
   const std::vector<TargetObservation::Ptr>& observations,
   Eigen::VectorXd* intrinsics);
 
+enum class FocalLengthCandidateMethod {
+  /// One candidate per pair of target rows, see initFocalLengthVanishingPoints.
+  kVanishingPoints,
+  /// One candidate per observation, see initFocalLengthAbsoluteConic.
+  kAbsoluteConic
+};
+
+// Computes the focal length candidates (fu, fv) of all complete observations, in blocks of
+// observations on the shared pool of common::parallelFor, or on the calling thread if
+// num_threads is 1. The candidates are ordered by observation.
+void computeFocalLengthCandidates(
+    const std::vector<TargetObservation::Ptr>& observations, FocalLengthCandidateMethod method,
+    size_t num_threads, Aligned<std::vector, Eigen::Vector2d>* candidates);
+
+// Selects the focal lengths (fu, fv) supported by the most candidates. A candidate supports
+// another one if their geometric mean focal lengths differ by less than the relative inlier
+// tolerance. The result is the per-axis median of the largest consistent set. Returns false if
+// there are no valid candidates.
+bool selectFocalLengthRobust(
+    const Aligned<std::vector, Eigen::Vector2d>& candidates, double inlier_tolerance,
+    Eigen::Vector2d* focal_lengths, size_t* num_inliers);
+
+// Initializes the intrinsics vector from many observations. The candidates are computed in
+// parallel with fixed-size types and the focal length is selected robustly, hence unlike the
+// functions above, outlier observations don't bias the result.
+bool initFocalLengthRobust(
+    const std::vector<TargetObservation::Ptr>& observations, FocalLengthCandidateMethod method,
+    size_t num_threads, Eigen::VectorXd* intrinsics);
+
 }  // namespace calibration
 }  // namespace aslam
 
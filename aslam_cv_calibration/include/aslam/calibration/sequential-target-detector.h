@@ -0,0 +1,85 @@
+#ifndef ASLAM_CALIBRATION_SEQUENTIAL_TARGET_DETECTOR_H
+#define ASLAM_CALIBRATION_SEQUENTIAL_TARGET_DETECTOR_H
+
+#include <aslam/cameras/camera.h>
+#include <aslam/common/macros.h>
+#include <Eigen/Core>
+#include <opencv2/core/core.hpp>
+
+#include "aslam/calibration/target-base.h"
+#include "aslam/calibration/target-observation.h"
+
+namespace aslam {
+namespace calibration {
+
+/// \class SequentialTargetDetector
+/// \brief Detects a target in an image sequence, searching near the last detection first.
+///
+/// The region of the target in the next image is predicted from the last observation: with a
+/// camera, the target pose is estimated with estimateTargetTransformation and the whole target is
+/// projected, which also covers corners that were not observed. Without a camera, the whole
+/// target is mapped with the homography of the observed corners. The region is expanded by a
+/// margin to allow for motion, and the target is searched in it first. The full image is searched
+/// if the target is not found in the region or with fewer corners than in the last image, the
+/// observation with more corners is returned.
+class SequentialTargetDetector {
+ public:
+  ASLAM_POINTER_TYPEDEFS(SequentialTargetDetector);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(SequentialTargetDetector);
+
+  struct Configuration {
+    Configuration()
+        : roi_margin_fraction(0.25),
+          min_roi_margin_px(32.0) {};
+    /// Margin added on every side of the predicted target region, relative to its size.
+    double roi_margin_fraction;
+    /// Min. margin added on every side of the predicted target region. [px]
+    double min_roi_margin_px;
+  };
+
+  /// @param[in] detector Detects the target in the region or the full image.
+  /// @param[in] camera   Camera of the image sequence, used to predict the target region. Can be
+  ///                     nullptr, the region then bounds the observed corners.
+  SequentialTargetDetector(const DetectorBase::Ptr& detector, const Camera::ConstPtr& camera,
+                           const Configuration& config);
+  ~SequentialTargetDetector() {};
+
+  /// Detect the target in the next image of the sequence, nullptr if it was not found.
+  TargetObservation::Ptr detectTargetInImage(const cv::Mat& image);
+
+  /// Forget the last detection, the next image is searched completely.
+  void reset() {
+    has_roi_ = false;
+    num_last_observed_corners_ = 0u;
+  }
+
+  /// The region searched first in the next image, if any.
+  bool hasRoi() const { return has_roi_; }
+  const cv::Rect& getRoi() const { return roi_; }
+
+  size_t getNumRoiDetections() const { return num_roi_detections_; }
+  size_t getNumFullImageDetections() const { return num_full_image_detections_; }
+
+ private:
+  TargetObservation::Ptr detectTargetInRoi(const cv::Mat& image, const cv::Rect& roi) const;
+  /// The homography from the target plane to the image, false if it could not be estimated.
+  static bool estimateTargetHomography(const TargetObservation& observation, cv::Mat* H_I_G);
+  /// Predicts the region of the next detection, returns false if none could be predicted.
+  bool predictRoi(const TargetObservation& observation, int image_width, int image_height,
+                  cv::Rect* roi) const;
+
+  const DetectorBase::Ptr detector_;
+  const Camera::ConstPtr camera_;
+  const Configuration config_;
+
+  bool has_roi_;
+  cv::Rect roi_;
+  size_t num_last_observed_corners_;
+  size_t num_roi_detections_;
+  size_t num_full_image_detections_;
+};
+
+}  // namespace calibration
+}  // namespace aslam
+
+#endif  // ASLAM_CALIBRATION_SEQUENTIAL_TARGET_DETECTOR_H
@@ -1,6 +1,8 @@
 #ifndef ASLAM_CALIBRATION_TARGET_ALGORITHMS_H
 #define ASLAM_CALIBRATION_TARGET_ALGORITHMS_H
 
+#include <vector>
+
 #include <aslam/cameras/camera.h>
 #include <aslam/common/pose-types.h>
 
@@ -22,6 +24,38 @@ bool estimateTargetTransformation(
     const bool run_nonlinear_refinement, const double ransac_pixel_sigma,
     const int ransac_max_iters);
 
+struct TargetTransformationBatchOptions {
+  TargetTransformationBatchOptions()
+      : run_nonlinear_refinement(true),
+        ransac_pixel_sigma(1.0),
+        ransac_max_iters(200),
+        num_threads(0u),
+        seed_from_previous_observation(false),
+        seed_max_reprojection_error_px(2.0),
+        seed_min_inlier_ratio(0.9) {};
+  bool run_nonlinear_refinement;
+  double ransac_pixel_sigma;
+  int ransac_max_iters;
+  /// 1 runs on the calling thread, any other value on the shared pool of common::parallelFor.
+  size_t num_threads;
+
+  /// For sequential observations: refine the pose of the previous observation instead of running
+  /// RANSAC, if the refined pose explains at least seed_min_inlier_ratio of the corners with less
+  /// than seed_max_reprojection_error_px.
+  bool seed_from_previous_observation;
+  double seed_max_reprojection_error_px;
+  double seed_min_inlier_ratio;
+};
+
+// Estimates the target transforms of all observations on the shared pool of common::parallelFor.
+// Every chunk of contiguous observations reuses one PnP solver, such that sequential
+// observations can be seeded from their predecessor. Returns the number of successful
+// estimations, failed estimations are marked in successes.
+size_t estimateTargetTransformations(
+    const std::vector<TargetObservation::Ptr>& target_observations,
+    const aslam::Camera::ConstPtr& camera_ptr, const TargetTransformationBatchOptions& options,
+    aslam::TransformationVector* T_G_Cs, std::vector<bool>* successes);
+
 }  // namespace calibration
 }  // namespace aslam
 
@@ -1,6 +1,7 @@
 #ifndef ASLAM_CALIBRATION_TARGET_APRILGRID_H
 #define ASLAM_CALIBRATION_TARGET_APRILGRID_H
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -77,7 +78,8 @@ class DetectorAprilGrid : public DetectorBase {
         : run_subpixel_refinement(true),
           max_subpixel_refine_displacement_px_sq(1.5),
           min_visible_tags_for_valid_obs(4),
-          min_border_distance_px(4.0) {};
+          min_border_distance_px(4.0),
+          detection_downscale_factor(1u) {};
     /// Perform subpixel refinement of extracted corners.
     bool run_subpixel_refinement;
     /// Max. displacement squared in subpixel refinement. [px^2]
@@ -86,6 +88,12 @@ class DetectorAprilGrid : public DetectorBase {
     size_t min_visible_tags_for_valid_obs;
     /// Min. distance from image border for valid corners. [px]
     double min_border_distance_px;
+    /// Detect the tags on an image downscaled by this factor, which is much faster on high
+    /// resolution images. The corners are then refined on the full resolution image, with the
+    /// refinement window and the max. displacement scaled by the factor. Corners whose
+    /// refinement fails are rejected, hence factors > 1 need run_subpixel_refinement. 1 to
+    /// detect on the full resolution image.
+    size_t detection_downscale_factor;
   };
 
   DetectorAprilGrid(const TargetAprilGrid::Ptr& target,
@@ -94,7 +102,33 @@ class DetectorAprilGrid : public DetectorBase {
 
   virtual TargetObservation::Ptr detectTargetInImage(const cv::Mat& image) const;
 
+  /// Provides the next image of a batch, returns false once there are no more images. Called
+  /// from the worker threads, but never concurrently, and not after it returned false.
+  typedef std::function<bool(cv::Mat* image)> ImageSource;
+  /// Receives the observations in the order of the images, the observation is nullptr if the
+  /// target was not detected. Returning false cancels the remaining detections.
+  typedef std::function<bool(size_t image_index, const TargetObservation::Ptr& observation)>
+      ObservationCallback;
+
+  /// \brief Detects the target in a stream of images on num_threads threads.
+  ///
+  /// Every thread owns an AprilTags detector. At most max_num_images_in_flight images are read
+  /// but not yet passed to the callback, which bounds the memory of long calibration datasets.
+  /// The callback runs on the calling thread. Unlike detectTargetInImage, images with tags that
+  /// don't belong to the target are only logged and not shown.
+  /// @param[in] num_threads  Number of detection threads, 0 to use all cores.
+  /// @return The number of images passed to the callback.
+  size_t detectTargetInImages(const ImageSource& image_source, size_t num_threads,
+                              size_t max_num_images_in_flight,
+                              const ObservationCallback& callback) const;
+  /// Detects the target in all images, see above.
+  std::vector<TargetObservation::Ptr> detectTargetInImages(
+      const std::vector<cv::Mat>& images, size_t num_threads) const;
+
  private:
+  TargetObservation::Ptr detectTargetInImage(
+      const cv::Mat& image, AprilTags::TagDetector* tag_detector, bool show_wild_tags) const;
+
   const TargetAprilGrid::Ptr target_;
   const DetectorConfiguration detector_config_;
 
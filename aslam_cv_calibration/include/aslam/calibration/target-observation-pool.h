@@ -0,0 +1,99 @@
+#ifndef ASLAM_CALIBRATION_TARGET_OBSERVATION_POOL_H
+#define ASLAM_CALIBRATION_TARGET_OBSERVATION_POOL_H
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/macros.h>
+#include <glog/logging.h>
+
+#include "aslam/calibration/target-base.h"
+#include "aslam/calibration/target-observation.h"
+
+namespace aslam {
+namespace calibration {
+
+/// \class TargetObservationPool
+/// \brief Contiguous storage of many observations of the same target.
+///
+/// The corners of all observations are stored back to back in one array, sorted by corner id
+/// per observation. The observed corners of an observation are indexed by a bitset over the
+/// corners of the target: the index of a corner is the number of observed corners with a smaller
+/// id. Hence, an observation costs its corners plus one bit per target corner, and no allocation.
+class TargetObservationPool {
+ public:
+  ASLAM_POINTER_TYPEDEFS(TargetObservationPool);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(TargetObservationPool);
+
+  typedef Eigen::Map<const Eigen::Matrix2Xd> ConstCornersMap;
+  typedef Eigen::Map<const Eigen::VectorXi> ConstCornerIdsMap;
+
+  explicit TargetObservationPool(const TargetBase::Ptr& target);
+  ~TargetObservationPool() {};
+
+  /// Reserve the storage of num_observations observations with num_corners corners on average.
+  void reserve(size_t num_observations, size_t num_corners);
+  void clear();
+
+  /// Add an observation, returns its index. The corner ids need to be unique.
+  size_t add(uint32_t im_height, uint32_t im_width, const Eigen::VectorXi& corner_ids,
+             const Eigen::Matrix2Xd& image_corners);
+  /// Add an observation of the target of this pool, returns its index.
+  size_t add(const TargetObservation& observation);
+
+  size_t size() const { return observations_.size(); }
+  bool empty() const { return observations_.empty(); }
+  const TargetBase::Ptr& getTarget() const { return target_; }
+
+  uint32_t getImageWidth(size_t obs_idx) const { return getRecord(obs_idx).image_width; }
+  uint32_t getImageHeight(size_t obs_idx) const { return getRecord(obs_idx).image_height; }
+
+  size_t numObservedCorners(size_t obs_idx) const { return getRecord(obs_idx).num_corners; }
+  bool allCornersObservered(size_t obs_idx) const {
+    return numObservedCorners(obs_idx) == target_->size();
+  }
+  bool observedCornerId(size_t obs_idx, size_t corner_id) const;
+  bool getObservedCornerById(size_t obs_idx, size_t corner_id, Eigen::Vector2d* obs_corner) const;
+
+  /// The observed corners and their ids, sorted by corner id. The maps are invalidated by add.
+  ConstCornersMap getObservedCorners(size_t obs_idx) const;
+  ConstCornerIdsMap getObservedCornerIds(size_t obs_idx) const;
+
+  /// Copies an observation out of the pool, e.g. for the functions taking TargetObservations.
+  TargetObservation::Ptr getObservation(size_t obs_idx) const;
+
+  /// Approximate memory used by the pool, excluding the target. [bytes]
+  size_t getNumBytes() const;
+
+ private:
+  struct ObservationRecord {
+    uint32_t corner_offset;
+    uint32_t num_corners;
+    uint32_t image_height;
+    uint32_t image_width;
+  };
+
+  const ObservationRecord& getRecord(size_t obs_idx) const {
+    CHECK_LT(obs_idx, observations_.size());
+    return observations_[obs_idx];
+  }
+  const uint64_t* getCornerBitset(size_t obs_idx) const {
+    return &corner_bitsets_[obs_idx * num_bitset_words_];
+  }
+
+  const TargetBase::Ptr target_;
+  const size_t num_bitset_words_;
+
+  std::vector<ObservationRecord> observations_;
+  // Bitset of the observed corner ids, num_bitset_words_ words per observation.
+  std::vector<uint64_t> corner_bitsets_;
+  // Column-major (u, v) of all corners.
+  std::vector<double> image_corners_;
+  std::vector<int> corner_ids_;
+};
+
+}  // namespace calibration
+}  // namespace aslam
+
+#endif  // ASLAM_CALIBRATION_TARGET_OBSERVATION_POOL_H
@@ -0,0 +1,162 @@
+#ifndef ASLAM_CALIBRATION_TARGET_OBSERVATION_STORE_H
+#define ASLAM_CALIBRATION_TARGET_OBSERVATION_STORE_H
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/macros.h>
+#include <aslam/common/mapped-file.h>
+
+#include "aslam/calibration/target-base.h"
+#include "aslam/calibration/target-observation.h"
+
+/// \file
+/// Append-only binary file of TargetObservations of one target, keyed by camera index and
+/// timestamp.
+///
+/// The file starts with a 64 byte header followed by the observation records in append order.
+/// A record is a 32 byte header, the image corners as 2 x N doubles (column-major) and the N
+/// corner ids as int32, padded to a multiple of 8 bytes. The reader maps the file and builds its
+/// index by hopping over the record headers, hence a store that was not closed properly (e.g.
+/// after a crash) is readable up to the last complete record.
+
+namespace aslam {
+namespace calibration {
+namespace observation_store {
+constexpr uint32_t kStoreMagic = 0x4f544341u;  // "ACTO"
+constexpr uint32_t kRecordMagic = 0x52544341u;  // "ACTR"
+constexpr uint16_t kFormatVersion = 1u;
+
+struct StoreHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size_bytes;
+  /// Grid size of the observed target.
+  uint32_t target_rows;
+  uint32_t target_cols;
+  uint64_t reserved[6];
+};
+static_assert(sizeof(StoreHeader) == 64u, "Unexpected store header padding.");
+
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t camera_index;
+  int64_t timestamp_nanoseconds;
+  uint32_t image_height;
+  uint32_t image_width;
+  uint32_t num_corners;
+  uint32_t reserved;
+};
+static_assert(sizeof(RecordHeader) == 32u, "Unexpected record header padding.");
+
+/// Size of a record with num_corners corners, including its header and padding.
+inline size_t getRecordSizeBytes(size_t num_corners) {
+  const size_t unpadded_size_bytes =
+      sizeof(RecordHeader) + num_corners * (2u * sizeof(double) + sizeof(int32_t));
+  return (unpadded_size_bytes + 7u) & ~static_cast<size_t>(7u);
+}
+}  // namespace observation_store
+
+/// \class TargetObservationStoreWriter
+/// \brief Appends observations to a store. Not thread-safe.
+class TargetObservationStoreWriter {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(TargetObservationStoreWriter);
+  typedef std::function<bool(size_t image_index, const TargetObservation::Ptr& observation)>
+      ObservationCallback;
+
+  TargetObservationStoreWriter();
+  /// Closes the store if it is still open.
+  ~TargetObservationStoreWriter();
+
+  /// Create or truncate the store of observations of target at path. Returns false on an IO
+  /// error.
+  bool open(const std::string& path, const TargetBase& target);
+  bool isOpen() const { return file_.is_open(); }
+
+  /// Append an observation of the target of the store. Returns false on an IO error.
+  bool append(size_t camera_index, int64_t timestamp_nanoseconds,
+              const TargetObservation& observation);
+  /// Flush and close the store. Returns false on an IO error.
+  bool close();
+
+  size_t getNumObservations() const { return num_observations_; }
+
+  /// Returns a callback for DetectorAprilGrid::detectTargetInImages that appends the detections
+  /// of the camera. The timestamp of an image is looked up by its index, images without a
+  /// detection are skipped. The callback cancels the detection on an IO error.
+  ObservationCallback getAppendCallback(
+      size_t camera_index, const std::function<int64_t(size_t image_index)>& get_timestamp);
+
+ private:
+  std::string path_;
+  std::ofstream file_;
+  size_t target_rows_;
+  size_t target_cols_;
+  size_t num_observations_;
+  std::vector<char> record_buffer_;
+};
+
+/// \class TargetObservationStore
+/// \brief Read-only memory mapped access to a store.
+///
+/// The observations are indexed in order of camera index and then timestamp. The returned maps
+/// point into the mapping and are valid until the store is closed.
+class TargetObservationStore {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(TargetObservationStore);
+  typedef Eigen::Map<const Eigen::Matrix2Xd> ConstCornersMap;
+  typedef Eigen::Map<const Eigen::VectorXi> ConstCornerIdsMap;
+
+  TargetObservationStore();
+  ~TargetObservationStore();
+
+  /// Map the store of observations of target. Returns false if the file is malformed or the
+  /// grid size of the target differs.
+  bool open(const std::string& path, const TargetBase::Ptr& target);
+  void close();
+  bool isOpen() const { return mapped_file_.isOpen(); }
+
+  size_t getNumObservations() const { return entries_.size(); }
+
+  size_t getCameraIndex(size_t index) const { return getRecordHeader(index).camera_index; }
+  int64_t getTimestampNanoseconds(size_t index) const {
+    return getRecordHeader(index).timestamp_nanoseconds;
+  }
+  uint32_t getImageHeight(size_t index) const { return getRecordHeader(index).image_height; }
+  uint32_t getImageWidth(size_t index) const { return getRecordHeader(index).image_width; }
+  size_t numObservedCorners(size_t index) const { return getRecordHeader(index).num_corners; }
+
+  ConstCornersMap getObservedCorners(size_t index) const;
+  ConstCornerIdsMap getObservedCornerIds(size_t index) const;
+  /// Copies the observation out of the mapping.
+  TargetObservation::Ptr getObservation(size_t index) const;
+
+  /// Returns false if the camera has no observation at the given timestamp.
+  bool findObservation(size_t camera_index, int64_t timestamp_nanoseconds, size_t* index) const;
+  /// Range [begin, end) of the observations of a camera, empty if there are none.
+  void getObservationsOfCamera(size_t camera_index, size_t* begin, size_t* end) const;
+
+ private:
+  struct IndexEntry {
+    uint32_t camera_index;
+    int64_t timestamp_nanoseconds;
+    uint64_t offset;
+  };
+
+  bool buildIndex();
+  const observation_store::RecordHeader& getRecordHeader(size_t index) const;
+
+  TargetBase::Ptr target_;
+  common::MappedFile mapped_file_;
+  std::vector<IndexEntry> entries_;
+};
+
+}  // namespace calibration
+}  // namespace aslam
+
+#endif  // ASLAM_CALIBRATION_TARGET_OBSERVATION_STORE_H
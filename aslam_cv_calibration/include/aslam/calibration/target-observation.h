@@ -1,9 +1,10 @@
 #ifndef ASLAM_CALIBRATION_TARGET_OBSERVATION_H
 #define ASLAM_CALIBRATION_TARGET_OBSERVATION_H
 
+#include <cstdint>
 #include <memory>
-#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <Eigen/Core>
 #include <aslam/common/macros.h>
@@ -43,16 +44,16 @@ class TargetObservation {
     return target_;
   };
 
-  uint32_t getImageWidth() {
+  uint32_t getImageWidth() const {
     return image_width;
   };
-  uint32_t getImageHeight() {
+  uint32_t getImageHeight() const {
     return image_height;
   };
 
-  bool observedCornerId(size_t corner_id) {
+  bool observedCornerId(size_t corner_id) const {
     CHECK_LT(corner_id, target_->size());
-    return (cornerid_to_index_map_.count(corner_id) == 1);
+    return corner_index_by_id_[corner_id] != kInvalidCornerIndex;
   }
 
   bool allCornersObservered() const {
@@ -78,15 +79,15 @@ class TargetObservation {
   }
 
   bool getObservedCornerById(int corner_id, Eigen::Vector2d* obs_corner) const {
-    CHECK_LT(corner_id, corner_ids_.rows());
-
-    for (int i = 0; i < corner_ids_.rows(); ++i) {
-      if (corner_id == corner_ids_(i)) {
-        *obs_corner = this->getObservedCorner(i);
-        return true;
-      }
+    CHECK_NOTNULL(obs_corner);
+    CHECK_GE(corner_id, 0);
+    CHECK_LT(static_cast<size_t>(corner_id), target_->size());
+    const uint16_t index = corner_index_by_id_[corner_id];
+    if (index == kInvalidCornerIndex) {
+      return false;
     }
-    return false;
+    *obs_corner = image_corners_.col(index);
+    return true;
   }
 
   size_t getObservedCornerId(int idx) const {
@@ -113,10 +114,20 @@ class TargetObservation {
   }
 
  private:
+  enum : uint16_t { kInvalidCornerIndex = 0xffff };
+
+  // Dense index over all corners of the target, as the target has a fixed size.
   void buildIndex() {
-    cornerid_to_index_map_.clear();
+    CHECK_LT(target_->size(), static_cast<size_t>(kInvalidCornerIndex));
+    corner_index_by_id_.assign(target_->size(), kInvalidCornerIndex);
     for (int index = 0; index < corner_ids_.rows(); ++index) {
-      cornerid_to_index_map_.emplace(corner_ids_(index), index);
+      const int corner_id = corner_ids_(index);
+      CHECK_GE(corner_id, 0);
+      CHECK_LT(static_cast<size_t>(corner_id), target_->size());
+      // Keeps the first observation of a corner.
+      if (corner_index_by_id_[corner_id] == kInvalidCornerIndex) {
+        corner_index_by_id_[corner_id] = static_cast<uint16_t>(index);
+      }
     }
   };
 
@@ -126,7 +137,8 @@ class TargetObservation {
   const Eigen::VectorXi corner_ids_;
   const Eigen::Matrix2Xd image_corners_;
 
-  std::unordered_map<size_t, size_t> cornerid_to_index_map_;
+  // Index of the observed corner per corner id, kInvalidCornerIndex if not observed.
+  std::vector<uint16_t> corner_index_by_id_;
 };
 
 }  // namespace calibration
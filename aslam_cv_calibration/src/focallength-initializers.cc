@@ -1,18 +1,189 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include <aslam/cameras/camera-pinhole.h>
 #include <aslam/common/memory.h>
+#include <aslam/common/parallel-for.h>
 #include <aslam/common/stl-helpers.h>
 #include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+#include <Eigen/LU>
 #include <Eigen/StdVector>
 #include <glog/logging.h>
 #include <opencv2/calib3d/calib3d.hpp>
 
-#include "aslam/calibration/target-observation.h"
+#include "aslam/calibration/focallength-initializers.h"
 #include "aslam/calibration/helpers.h"
+#include "aslam/calibration/target-observation.h"
 
 namespace aslam {
 namespace calibration {
+namespace {
+// Number of observations processed per task of the batch initializer.
+constexpr size_t kNumObservationsPerBlock = 16u;
+
+// Returns the corners of a complete observation ordered by corner id.
+void getCornersById(const TargetObservation& observation, Eigen::Matrix2Xd* corners) {
+  CHECK_NOTNULL(corners);
+  const Eigen::Matrix2Xd& observed_corners = observation.getObservedCorners();
+  const Eigen::VectorXi& corner_ids = observation.getObservedCornerIds();
+  corners->resize(2, observed_corners.cols());
+  for (int idx = 0; idx < corner_ids.rows(); ++idx) {
+    CHECK_LT(corner_ids(idx), observed_corners.cols());
+    corners->col(corner_ids(idx)) = observed_corners.col(idx);
+  }
+}
+
+// Same as InitializerHelpers::fitCircle, returns (center_x, center_y, radius).
+Eigen::Vector3d fitCircle(const Eigen::Ref<const Eigen::Matrix2Xd>& points) {
+  const double n = static_cast<double>(points.cols());
+  Eigen::Vector2d sum = Eigen::Vector2d::Zero();
+  Eigen::Vector3d sum_squares = Eigen::Vector3d::Zero();  // xx, xy, yy
+  Eigen::Vector4d sum_cubes = Eigen::Vector4d::Zero();    // xxx, xxy, xyy, yyy
+  for (int i = 0; i < points.cols(); ++i) {
+    const double x = points(0, i);
+    const double y = points(1, i);
+    sum += points.col(i);
+    sum_squares += Eigen::Vector3d(x * x, x * y, y * y);
+    sum_cubes += Eigen::Vector4d(x * x * x, x * x * y, x * y * y, y * y * y);
+  }
+  const double A = n * sum_squares(0) - sum(0) * sum(0);
+  const double B = n * sum_squares(1) - sum(0) * sum(1);
+  const double C = n * sum_squares(2) - sum(1) * sum(1);
+  const double D = 0.5 * (n * sum_cubes(2) - sum(0) * sum_squares(2) +
+      n * sum_cubes(0) - sum(0) * sum_squares(0));
+  const double E = 0.5 * (n * sum_cubes(1) - sum(1) * sum_squares(0) +
+      n * sum_cubes(3) - sum(1) * sum_squares(2));
+
+  Eigen::Vector3d circle;
+  circle(0) = (D * C - B * E) / (A * C - B * B);
+  circle(1) = (A * E - B * D) / (A * C - B * B);
+  circle(2) = (points.colwise() - circle.head<2>()).colwise().norm().sum() / n;
+  return circle;
+}
+
+void addVanishingPointCandidates(
+    const TargetObservation& observation, Aligned<std::vector, Eigen::Vector2d>* candidates) {
+  CHECK_NOTNULL(candidates);
+  const TargetBase::ConstPtr target = observation.getTarget();
+  const size_t num_rows = target->rows();
+  const size_t num_cols = target->cols();
+  Eigen::Matrix2Xd corners;
+  getCornersById(observation, &corners);
+
+  Aligned<std::vector, Eigen::Vector3d> circles(num_rows);
+  for (size_t r = 0u; r < num_rows; ++r) {
+    circles[r] = fitCircle(corners.middleCols(r * num_cols, num_cols));
+  }
+
+  // The distance between the two intersections of a pair of circles is the distance between the
+  // vanishing points, see InitializerHelpers::intersectCircles.
+  for (size_t j = 0u; j < num_rows; ++j) {
+    for (size_t k = j + 1u; k < num_rows; ++k) {
+      const double r_j = circles[j](2);
+      const double r_k = circles[k](2);
+      const double d = (circles[j].head<2>() - circles[k].head<2>()).norm();
+      if (d > r_j + r_k || d < std::abs(r_j - r_k)) {
+        continue;
+      }
+      const double a = (r_j * r_j - r_k * r_k + d * d) / (2.0 * d);
+      const double h = std::sqrt(r_j * r_j - a * a);
+      if (!(h >= 1e-10)) {
+        continue;
+      }
+      const double f_guess = 2.0 * h / M_PI;
+      candidates->emplace_back(f_guess, f_guess);
+    }
+  }
+}
+
+// Returns the normalizing similarity transformation of Hartley's normalized DLT.
+Eigen::Matrix3d getNormalizingTransformation(const Eigen::Matrix2Xd& points) {
+  const Eigen::Vector2d centroid = points.rowwise().mean();
+  const double mean_distance = (points.colwise() - centroid).colwise().norm().mean();
+  const double scale = mean_distance > 0.0 ? std::sqrt(2.0) / mean_distance : 1.0;
+  Eigen::Matrix3d T = Eigen::Matrix3d::Identity();
+  T.topLeftCorner<2, 2>() *= scale;
+  T.topRightCorner<2, 1>() = -scale * centroid;
+  return T;
+}
+
+// Estimates the homography image_H_target from planar correspondences with the normalized DLT.
+bool estimateHomography(
+    const Eigen::Matrix2Xd& target_points, const Eigen::Matrix2Xd& image_points,
+    Eigen::Matrix3d* H) {
+  CHECK_NOTNULL(H);
+  CHECK_EQ(target_points.cols(), image_points.cols());
+  if (target_points.cols() < 4) {
+    return false;
+  }
+  const Eigen::Matrix3d T_target = getNormalizingTransformation(target_points);
+  const Eigen::Matrix3d T_image = getNormalizingTransformation(image_points);
+
+  typedef Eigen::Matrix<double, 9, 1> Vector9d;
+  typedef Eigen::Matrix<double, 9, 9> Matrix9d;
+  Matrix9d AtA = Matrix9d::Zero();
+  for (int i = 0; i < target_points.cols(); ++i) {
+    const Eigen::Vector3d X = T_target * target_points.col(i).homogeneous();
+    const Eigen::Vector3d x = T_image * image_points.col(i).homogeneous();
+    Vector9d row_u, row_v;
+    row_u << -X, Eigen::Vector3d::Zero(), x(0) * X;
+    row_v << Eigen::Vector3d::Zero(), -X, x(1) * X;
+    AtA.selfadjointView<Eigen::Lower>().rankUpdate(row_u);
+    AtA.selfadjointView<Eigen::Lower>().rankUpdate(row_v);
+  }
+  const Eigen::SelfAdjointEigenSolver<Matrix9d> solver(AtA);
+  if (solver.info() != Eigen::Success) {
+    return false;
+  }
+  // The eigenvalues are sorted in increasing order.
+  const Vector9d h = solver.eigenvectors().col(0);
+  const Eigen::Matrix3d H_normalized =
+      Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(h.data());
+  *H = T_image.inverse() * H_normalized * T_target;
+  return H->allFinite();
+}
+
+void addAbsoluteConicCandidate(
+    const TargetObservation& observation, const Eigen::Vector2d& principal_point,
+    Aligned<std::vector, Eigen::Vector2d>* candidates) {
+  CHECK_NOTNULL(candidates);
+  const TargetBase::ConstPtr target = observation.getTarget();
+  Eigen::Matrix2Xd corners;
+  getCornersById(observation, &corners);
+  const Eigen::Matrix2Xd target_points = target->points().topRows<2>();
+
+  Eigen::Matrix3d H;
+  if (!estimateHomography(target_points, corners, &H)) {
+    return;
+  }
+  H.row(0) -= principal_point(0) * H.row(2);
+  H.row(1) -= principal_point(1) * H.row(2);
+
+  // Orthogonality constraints on the image of the absolute conic diag(1/fu^2, 1/fv^2, 1).
+  const Eigen::Vector3d h = H.col(0).normalized();
+  const Eigen::Vector3d v = H.col(1).normalized();
+  const Eigen::Vector3d d1 = (H.col(0) + H.col(1)).normalized();
+  const Eigen::Vector3d d2 = (H.col(0) - H.col(1)).normalized();
+  Eigen::Matrix2d A;
+  A << h(0) * v(0), h(1) * v(1),
+       d1(0) * d2(0), d1(1) * d2(1);
+  const Eigen::Vector2d b(-h(2) * v(2), -d1(2) * d2(2));
+  const Eigen::FullPivLU<Eigen::Matrix2d> lu(A);
+  if (!lu.isInvertible()) {
+    return;
+  }
+  const Eigen::Vector2d inverse_squared_focal_lengths = lu.solve(b);
+  if (!(inverse_squared_focal_lengths.minCoeff() > 0.0)) {
+    return;
+  }
+  const Eigen::Vector2d focal_lengths = inverse_squared_focal_lengths.cwiseInverse().cwiseSqrt();
+  if (focal_lengths.allFinite()) {
+    candidates->push_back(focal_lengths);
+  }
+}
+}  // namespace
 
 // Initializes the intrinsics vector based on one views of a calibration targets.
 // On success it returns true. These functions are based on functions from Lionel Heng and
@@ -200,5 +371,128 @@ bool initFocalLengthAbsoluteConic(
  return true;
 }
 
+void computeFocalLengthCandidates(
+    const std::vector<TargetObservation::Ptr>& observations, FocalLengthCandidateMethod method,
+    size_t num_threads, Aligned<std::vector, Eigen::Vector2d>* candidates) {
+  CHECK_NOTNULL(candidates)->clear();
+  if (observations.empty()) {
+    return;
+  }
+  const Eigen::Vector2d principal_point(
+      (observations.front()->getImageWidth() - 1.0) / 2.0,
+      (observations.front()->getImageHeight() - 1.0) / 2.0);
+
+  // Every block writes the candidates of its own observations.
+  const size_t num_obs = observations.size();
+  std::vector<Aligned<std::vector, Eigen::Vector2d>> candidates_per_obs(num_obs);
+  common::parallelFor(common::IndexRange(0u, num_obs),
+                      num_threads == 1u ? num_obs : kNumObservationsPerBlock,
+                      [&](size_t block_begin, size_t block_end) {
+    for (size_t obs_idx = block_begin; obs_idx < block_end; ++obs_idx) {
+      const TargetObservation::ConstPtr& obs = observations[obs_idx];
+      CHECK(obs);
+      CHECK(obs->getTarget()) << "The TargetObservation has no target object.";
+      // We can only process complete image observations.
+      if (!obs->allCornersObservered()) {
+        continue;
+      }
+      switch (method) {
+        case FocalLengthCandidateMethod::kVanishingPoints:
+          addVanishingPointCandidates(*obs, &candidates_per_obs[obs_idx]);
+          break;
+        case FocalLengthCandidateMethod::kAbsoluteConic:
+          addAbsoluteConicCandidate(*obs, principal_point, &candidates_per_obs[obs_idx]);
+          break;
+        default:
+          LOG(FATAL) << "Unknown focal length candidate method.";
+      }
+    }
+  });
+
+  for (const Aligned<std::vector, Eigen::Vector2d>& obs_candidates : candidates_per_obs) {
+    candidates->insert(candidates->end(), obs_candidates.begin(), obs_candidates.end());
+  }
+}
+
+bool selectFocalLengthRobust(
+    const Aligned<std::vector, Eigen::Vector2d>& candidates, double inlier_tolerance,
+    Eigen::Vector2d* focal_lengths, size_t* num_inliers) {
+  CHECK_NOTNULL(focal_lengths);
+  CHECK_GT(inlier_tolerance, 0.0);
+
+  // Scores the candidates in log space, where the tolerance is the same for all focal lengths.
+  // A sliding window over the sorted candidates finds the largest consistent set in O(n log n).
+  std::vector<std::pair<double, size_t>> sorted_log_focal_lengths;
+  sorted_log_focal_lengths.reserve(candidates.size());
+  for (size_t idx = 0u; idx < candidates.size(); ++idx) {
+    const Eigen::Vector2d& candidate = candidates[idx];
+    if (candidate.allFinite() && candidate.minCoeff() > 0.0) {
+      sorted_log_focal_lengths.emplace_back(0.5 * std::log(candidate.prod()), idx);
+    }
+  }
+  if (sorted_log_focal_lengths.empty()) {
+    return false;
+  }
+  std::sort(sorted_log_focal_lengths.begin(), sorted_log_focal_lengths.end());
+
+  const double window_size = 2.0 * std::log1p(inlier_tolerance);
+  size_t best_begin = 0u;
+  size_t best_end = 0u;
+  size_t window_end = 0u;
+  for (size_t window_begin = 0u; window_begin < sorted_log_focal_lengths.size(); ++window_begin) {
+    while (window_end < sorted_log_focal_lengths.size() &&
+        sorted_log_focal_lengths[window_end].first -
+        sorted_log_focal_lengths[window_begin].first <= window_size) {
+      ++window_end;
+    }
+    if (window_end - window_begin > best_end - best_begin) {
+      best_begin = window_begin;
+      best_end = window_end;
+    }
+  }
+
+  std::vector<double> inlier_fu, inlier_fv;
+  inlier_fu.reserve(best_end - best_begin);
+  inlier_fv.reserve(best_end - best_begin);
+  for (size_t idx = best_begin; idx < best_end; ++idx) {
+    const Eigen::Vector2d& candidate = candidates[sorted_log_focal_lengths[idx].second];
+    inlier_fu.push_back(candidate(0));
+    inlier_fv.push_back(candidate(1));
+  }
+  (*focal_lengths)(0) = aslam::common::median(inlier_fu.begin(), inlier_fu.end());
+  (*focal_lengths)(1) = aslam::common::median(inlier_fv.begin(), inlier_fv.end());
+  if (num_inliers != nullptr) {
+    *num_inliers = best_end - best_begin;
+  }
+  return true;
+}
+
+bool initFocalLengthRobust(
+    const std::vector<TargetObservation::Ptr>& observations, FocalLengthCandidateMethod method,
+    size_t num_threads, Eigen::VectorXd* intrinsics) {
+  CHECK_NOTNULL(intrinsics);
+  CHECK(!observations.empty()) << "Need at least one observation.";
+  // Relative difference of focal length candidates supporting each other.
+  constexpr double kInlierTolerance = 0.05;
+
+  Aligned<std::vector, Eigen::Vector2d> candidates;
+  computeFocalLengthCandidates(observations, method, num_threads, &candidates);
+  Eigen::Vector2d focal_lengths;
+  size_t num_inliers = 0u;
+  if (!selectFocalLengthRobust(candidates, kInlierTolerance, &focal_lengths, &num_inliers)) {
+    return false;
+  }
+  VLOG(3) << "Focal lengths " << focal_lengths.transpose() << " supported by " << num_inliers
+      << " of " << candidates.size() << " candidates.";
+
+  // Sets the first intrinsics estimate.
+  intrinsics->resize(aslam::PinholeCamera::parameterCount());
+  (*intrinsics)(PinholeCamera::kFu) = focal_lengths(0);
+  (*intrinsics)(PinholeCamera::kFv) = focal_lengths(1);
+  (*intrinsics)(PinholeCamera::kCu) = (observations.front()->getImageWidth() - 1.0) / 2.0;
+  (*intrinsics)(PinholeCamera::kCv) = (observations.front()->getImageHeight() - 1.0) / 2.0;
+  return true;
+}
+
 }  // namespace calibration
 }  // namespace aslam
@@ -0,0 +1,148 @@
+#include "aslam/calibration/sequential-target-detector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <aslam/common/pose-types.h>
+#include <glog/logging.h>
+#include <opencv2/calib3d/calib3d.hpp>
+
+#include "aslam/calibration/target-algorithms.h"
+
+namespace aslam {
+namespace calibration {
+
+SequentialTargetDetector::SequentialTargetDetector(
+    const DetectorBase::Ptr& detector, const Camera::ConstPtr& camera,
+    const Configuration& config)
+    : detector_(detector),
+      camera_(camera),
+      config_(config),
+      has_roi_(false),
+      num_last_observed_corners_(0u),
+      num_roi_detections_(0u),
+      num_full_image_detections_(0u) {
+  CHECK(detector_);
+  CHECK_GE(config_.roi_margin_fraction, 0.0);
+  CHECK_GE(config_.min_roi_margin_px, 0.0);
+}
+
+TargetObservation::Ptr SequentialTargetDetector::detectTargetInImage(const cv::Mat& image) {
+  TargetObservation::Ptr observation;
+  if (has_roi_) {
+    observation = detectTargetInRoi(image, roi_);
+  }
+  // A region that cuts off a part of the target yields fewer corners than the last detection.
+  if (observation && observation->numObservedCorners() >= num_last_observed_corners_) {
+    ++num_roi_detections_;
+  } else {
+    if (has_roi_) {
+      VLOG(3) << "Target not found completely in the predicted region, searching the full image.";
+    }
+    const TargetObservation::Ptr full_image_observation = detector_->detectTargetInImage(image);
+    if (full_image_observation && (!observation || full_image_observation->numObservedCorners() >=
+                                                   observation->numObservedCorners())) {
+      observation = full_image_observation;
+      ++num_full_image_detections_;
+    } else if (observation) {
+      ++num_roi_detections_;
+    }
+  }
+  num_last_observed_corners_ = observation ? observation->numObservedCorners() : 0u;
+  has_roi_ = observation && predictRoi(*observation, image.cols, image.rows, &roi_);
+  return observation;
+}
+
+TargetObservation::Ptr SequentialTargetDetector::detectTargetInRoi(
+    const cv::Mat& image, const cv::Rect& roi) const {
+  // A continuous copy, the detectors don't necessarily support strided images.
+  const cv::Mat roi_image = image(roi).clone();
+  const TargetObservation::Ptr roi_observation = detector_->detectTargetInImage(roi_image);
+  if (!roi_observation) {
+    return TargetObservation::Ptr();
+  }
+  Eigen::Matrix2Xd image_corners = roi_observation->getObservedCorners();
+  image_corners.colwise() += Eigen::Vector2d(roi.x, roi.y);
+  return TargetObservation::Ptr(new TargetObservation(
+      roi_observation->getTarget(), image.rows, image.cols,
+      roi_observation->getObservedCornerIds(), image_corners));
+}
+
+bool SequentialTargetDetector::estimateTargetHomography(
+    const TargetObservation& observation, cv::Mat* H_I_G) {
+  CHECK_NOTNULL(H_I_G);
+  const size_t kMinNumCorners = 4u;
+  const size_t num_corners = observation.numObservedCorners();
+  if (num_corners < kMinNumCorners) {
+    return false;
+  }
+  const Eigen::Matrix3Xd points_G = observation.getCorrespondingTargetPoints();
+  std::vector<cv::Point2d> target_points(num_corners);
+  std::vector<cv::Point2d> image_points(num_corners);
+  for (size_t corner_idx = 0u; corner_idx < num_corners; ++corner_idx) {
+    target_points[corner_idx] = cv::Point2d(points_G(0, corner_idx), points_G(1, corner_idx));
+    image_points[corner_idx] = cv::Point2d(observation.getObservedCorners()(0, corner_idx),
+                                           observation.getObservedCorners()(1, corner_idx));
+  }
+  // The least-squares fit, the detected corners are not expected to contain outliers.
+  *H_I_G = cv::findHomography(target_points, image_points, 0);
+  return !H_I_G->empty();
+}
+
+bool SequentialTargetDetector::predictRoi(
+    const TargetObservation& observation, int image_width, int image_height,
+    cv::Rect* roi) const {
+  CHECK_NOTNULL(roi);
+  Eigen::Vector2d min_corner = observation.getObservedCorners().rowwise().minCoeff();
+  Eigen::Vector2d max_corner = observation.getObservedCorners().rowwise().maxCoeff();
+
+  // The bounds of the whole target, assuming it doesn't move much until the next image.
+  // Bounding only the observed corners would shrink the region whenever corners are missed.
+  const Eigen::Matrix3Xd& points_G = observation.getTarget()->points();
+  aslam::Transformation T_G_C;
+  cv::Mat H_I_G;
+  if (camera_ && estimateTargetTransformation(observation, camera_, &T_G_C)) {
+    const aslam::Transformation T_C_G = T_G_C.inverse();
+    for (int point_idx = 0; point_idx < points_G.cols(); ++point_idx) {
+      Eigen::Vector2d keypoint;
+      const ProjectionResult result =
+          camera_->project3(T_C_G.transform(points_G.col(point_idx)), &keypoint);
+      if (result.isKeypointVisible() ||
+          result == ProjectionResult::Status::KEYPOINT_OUTSIDE_IMAGE_BOX) {
+        min_corner = min_corner.cwiseMin(keypoint);
+        max_corner = max_corner.cwiseMax(keypoint);
+      }
+    }
+  } else if (estimateTargetHomography(observation, &H_I_G)) {
+    // Without a camera, the planar target is mapped with the homography of the observed corners.
+    for (int point_idx = 0; point_idx < points_G.cols(); ++point_idx) {
+      const cv::Mat point_I =
+          H_I_G * (cv::Mat_<double>(3, 1) << points_G(0, point_idx), points_G(1, point_idx), 1.0);
+      const double w = point_I.at<double>(2);
+      if (w > 0.0) {
+        const Eigen::Vector2d keypoint(point_I.at<double>(0) / w, point_I.at<double>(1) / w);
+        min_corner = min_corner.cwiseMin(keypoint);
+        max_corner = max_corner.cwiseMax(keypoint);
+      }
+    }
+  }
+
+  const Eigen::Vector2d margin =
+      ((max_corner - min_corner) * config_.roi_margin_fraction)
+          .cwiseMax(Eigen::Vector2d::Constant(config_.min_roi_margin_px));
+  min_corner -= margin;
+  max_corner += margin;
+  const int x_min = std::max(0, static_cast<int>(std::floor(min_corner.x())));
+  const int y_min = std::max(0, static_cast<int>(std::floor(min_corner.y())));
+  const int x_max = std::min(image_width, static_cast<int>(std::ceil(max_corner.x())) + 1);
+  const int y_max = std::min(image_height, static_cast<int>(std::ceil(max_corner.y())) + 1);
+  if (x_max <= x_min || y_max <= y_min) {
+    return false;
+  }
+  *roi = cv::Rect(x_min, y_min, x_max - x_min, y_max - y_min);
+  return true;
+}
+
+}  // namespace calibration
+}  // namespace aslam
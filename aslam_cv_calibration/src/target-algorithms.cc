@@ -1,10 +1,107 @@
 #include "aslam/calibration/target-algorithms.h"
 
+#include <algorithm>
+#include <atomic>
+
+#include <Eigen/Cholesky>
 #include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <aslam/common/parallel-for.h>
 #include <aslam/geometric-vision/pnp-pose-estimator.h>
 
 namespace aslam {
 namespace calibration {
+namespace {
+// Number of observations per chunk of the batch estimation, only the first observation of a
+// chunk can't be seeded. The chunks don't depend on the number of threads, hence neither do
+// the seeds.
+constexpr size_t kNumObservationsPerChunk = 16u;
+
+inline Eigen::Matrix3d skew(const Eigen::Vector3d& vector) {
+  Eigen::Matrix3d matrix;
+  matrix << 0.0, -vector(2), vector(1),
+            vector(2), 0.0, -vector(0),
+            -vector(1), vector(0), 0.0;
+  return matrix;
+}
+
+// Gauss-Newton refinement of T_G_C on the reprojection errors, starting from the given pose.
+// Returns the number of corners with a reprojection error below max_reprojection_error_px.
+size_t refineTargetTransformation(
+    const Eigen::Matrix2Xd& observed_corners, const Eigen::Matrix3Xd& corner_positions_G,
+    const aslam::Camera& camera, double max_reprojection_error_px,
+    aslam::Transformation* T_G_C) {
+  CHECK_NOTNULL(T_G_C);
+  CHECK_EQ(observed_corners.cols(), corner_positions_G.cols());
+  constexpr int kMaxNumIterations = 10;
+  constexpr double kMinUpdateNorm = 1e-10;
+  typedef Eigen::Matrix<double, 6, 1> Vector6d;
+  typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+
+  const aslam::Transformation T_C_G = T_G_C->inverse();
+  Eigen::Matrix3d R_C_G = T_C_G.getRotationMatrix();
+  Eigen::Vector3d p_C_G = T_C_G.getPosition();
+  const double inverse_squared_max_reprojection_error =
+      1.0 / (max_reprojection_error_px * max_reprojection_error_px);
+  for (int iteration = 0; iteration < kMaxNumIterations; ++iteration) {
+    Matrix6d H = Matrix6d::Zero();
+    Vector6d b = Vector6d::Zero();
+    for (int i = 0; i < observed_corners.cols(); ++i) {
+      const Eigen::Vector3d point_C = R_C_G * corner_positions_G.col(i) + p_C_G;
+      Eigen::Vector2d keypoint;
+      Eigen::Matrix<double, 2, 3> J_keypoint_point;
+      const ProjectionResult result = camera.project3(point_C, &keypoint, &J_keypoint_point);
+      if (!result.isKeypointVisible() &&
+          result != ProjectionResult::Status::KEYPOINT_OUTSIDE_IMAGE_BOX) {
+        continue;
+      }
+      // Left perturbation of T_C_G by (rotation, translation).
+      Eigen::Matrix<double, 3, 6> J_point_pose;
+      J_point_pose << -skew(point_C), Eigen::Matrix3d::Identity();
+      const Eigen::Matrix<double, 2, 6> J = J_keypoint_point * J_point_pose;
+      const Eigen::Vector2d residual = observed_corners.col(i) - keypoint;
+      // Cauchy weights suppress the outlier corners.
+      const double weight =
+          1.0 / (1.0 + residual.squaredNorm() * inverse_squared_max_reprojection_error);
+      H.noalias() += weight * J.transpose() * J;
+      b.noalias() += weight * J.transpose() * residual;
+    }
+    const Eigen::LDLT<Matrix6d> ldlt(H);
+    if (ldlt.info() != Eigen::Success) {
+      return 0u;
+    }
+    const Vector6d update = ldlt.solve(b);
+    if (!update.allFinite()) {
+      return 0u;
+    }
+    const double angle = update.head<3>().norm();
+    const Eigen::Matrix3d delta_R = angle > 0.0 ?
+        Eigen::AngleAxisd(angle, update.head<3>() / angle).toRotationMatrix() :
+        Eigen::Matrix3d::Identity();
+    R_C_G = delta_R * R_C_G;
+    p_C_G = delta_R * p_C_G + update.tail<3>();
+    if (update.norm() < kMinUpdateNorm) {
+      break;
+    }
+  }
+
+  size_t num_inliers = 0u;
+  const double max_squared_error = max_reprojection_error_px * max_reprojection_error_px;
+  for (int i = 0; i < observed_corners.cols(); ++i) {
+    Eigen::Vector2d keypoint;
+    const ProjectionResult result =
+        camera.project3(R_C_G * corner_positions_G.col(i) + p_C_G, &keypoint);
+    if ((result.isKeypointVisible() ||
+         result == ProjectionResult::Status::KEYPOINT_OUTSIDE_IMAGE_BOX) &&
+        (observed_corners.col(i) - keypoint).squaredNorm() < max_squared_error) {
+      ++num_inliers;
+    }
+  }
+  const Eigen::Quaterniond q_C_G(R_C_G);
+  *T_G_C = aslam::Transformation(aslam::Quaternion(q_C_G.normalized()), p_C_G).inverse();
+  return num_inliers;
+}
+}  // namespace
 
 bool estimateTargetTransformation(
     const TargetObservation& target_observation,
@@ -48,5 +145,79 @@ bool estimateTargetTransformation(
   return pnp_success;
 }
 
+size_t estimateTargetTransformations(
+    const std::vector<TargetObservation::Ptr>& target_observations,
+    const aslam::Camera::ConstPtr& camera_ptr, const TargetTransformationBatchOptions& options,
+    aslam::TransformationVector* T_G_Cs, std::vector<bool>* successes) {
+  CHECK(camera_ptr);
+  CHECK_NOTNULL(T_G_Cs);
+  CHECK_NOTNULL(successes);
+  CHECK_GT(options.ransac_pixel_sigma, 0.0);
+  CHECK_GT(options.ransac_max_iters, 0);
+  CHECK_GT(options.seed_max_reprojection_error_px, 0.0);
+  const size_t num_observations = target_observations.size();
+  T_G_Cs->assign(num_observations, aslam::Transformation());
+  successes->assign(num_observations, false);
+  if (num_observations == 0u) {
+    return 0u;
+  }
+
+  // Every observation is written by exactly one chunk. std::vector<bool> packs its entries,
+  // hence the chunks write to a byte per observation.
+  std::vector<unsigned char> chunk_successes(num_observations, 0u);
+  std::atomic<size_t> num_seeded(0u);
+  const size_t grain_size =
+      options.num_threads == 1u ? num_observations : kNumObservationsPerChunk;
+  common::parallelFor(common::IndexRange(0u, num_observations), grain_size,
+                      [&](size_t chunk_begin, size_t chunk_end) {
+    aslam::geometric_vision::PnpPoseEstimator pnp(options.run_nonlinear_refinement);
+    Eigen::Matrix3Xd corner_positions_G;
+    std::vector<int> inliers;
+    bool has_seed = false;
+    for (size_t obs_idx = chunk_begin; obs_idx < chunk_end; ++obs_idx) {
+      const TargetObservation& observation = *CHECK_NOTNULL(target_observations[obs_idx].get());
+      const Eigen::Matrix2Xd& observed_corners = observation.getObservedCorners();
+      const Eigen::VectorXi& corner_ids = observation.getObservedCornerIds();
+      // The grid points of the target are shared by all observations.
+      const Eigen::Matrix3Xd& target_points = observation.getTarget()->points();
+      corner_positions_G.resize(3, corner_ids.rows());
+      for (int i = 0; i < corner_ids.rows(); ++i) {
+        corner_positions_G.col(i) = target_points.col(corner_ids(i));
+      }
+
+      aslam::Transformation& T_G_C = (*T_G_Cs)[obs_idx];
+      bool success = false;
+      if (options.seed_from_previous_observation && has_seed) {
+        T_G_C = (*T_G_Cs)[obs_idx - 1u];
+        const size_t num_seed_inliers = refineTargetTransformation(
+            observed_corners, corner_positions_G, *camera_ptr,
+            options.seed_max_reprojection_error_px, &T_G_C);
+        success = observed_corners.cols() > 0 && num_seed_inliers >=
+            options.seed_min_inlier_ratio * static_cast<double>(observed_corners.cols());
+        if (success) {
+          ++num_seeded;
+        }
+      }
+      if (!success) {
+        int num_iters = 0;
+        success = pnp.absolutePoseRansacPinholeCam(
+            observed_corners, corner_positions_G, options.ransac_pixel_sigma,
+            options.ransac_max_iters, camera_ptr, &T_G_C, &inliers, &num_iters);
+      }
+      chunk_successes[obs_idx] = success ? 1u : 0u;
+      has_seed = success;
+    }
+  });
+
+  size_t num_successes = 0u;
+  for (size_t obs_idx = 0u; obs_idx < num_observations; ++obs_idx) {
+    (*successes)[obs_idx] = chunk_successes[obs_idx] != 0u;
+    num_successes += chunk_successes[obs_idx];
+  }
+  VLOG(3) << "Estimated " << num_successes << "/" << num_observations
+          << " target transformations, " << num_seeded << " of them from the previous one.";
+  return num_successes;
+}
+
 }  // namespace calibration
 }  // namespace aslam
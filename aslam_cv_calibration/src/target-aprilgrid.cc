@@ -1,5 +1,9 @@
 #include <algorithm>
+#include <condition_variable>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include <apriltags/TagDetector.h>
@@ -66,13 +70,173 @@ DetectorAprilGrid::DetectorAprilGrid(
       detector_config_(detector_config),
       tag_codes_(AprilTags::tagCodes36h11) {
   CHECK(target);
+  CHECK_GT(detector_config_.detection_downscale_factor, 0u);
+  CHECK(detector_config_.detection_downscale_factor == 1u ||
+        detector_config_.run_subpixel_refinement)
+      << "The corners detected on a downscaled image need the subpixel refinement.";
   tag_detector_.reset(
       new AprilTags::TagDetector(tag_codes_, target_->getConfig().black_tag_border_bits));
 }
 
 TargetObservation::Ptr DetectorAprilGrid::detectTargetInImage(const cv::Mat& image) const {
-  // Detect all Apriltags in the image.
-  std::vector<AprilTags::TagDetection> detections = tag_detector_->extractTags(image);
+  return detectTargetInImage(image, tag_detector_.get(), true /*show_wild_tags*/);
+}
+
+size_t DetectorAprilGrid::detectTargetInImages(
+    const ImageSource& image_source, size_t num_threads, size_t max_num_images_in_flight,
+    const ObservationCallback& callback) const {
+  CHECK(image_source);
+  CHECK(callback);
+  CHECK_GT(max_num_images_in_flight, 0u);
+  if (num_threads == 0u) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // The source has its own mutex, such that reading an image doesn't block the threads that
+  // store their observations.
+  std::mutex source_mutex;
+  bool has_source_ended = false;
+  size_t num_images_read = 0u;
+
+  std::mutex mutex;
+  std::condition_variable cv_observation_added;
+  std::condition_variable cv_observation_consumed;
+  // Images being read count as in flight, the total is known once the source has ended.
+  size_t num_images_reserved = 0u;
+  size_t num_images_consumed = 0u;
+  size_t num_images_total = 0u;
+  bool is_source_exhausted = false;
+  bool is_cancelled = false;
+  std::map<size_t, TargetObservation::Ptr> observations;
+
+  const auto detect = [&]() {
+    AprilTags::TagDetector tag_detector(tag_codes_, target_->getConfig().black_tag_border_bits);
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!is_cancelled && !is_source_exhausted &&
+               num_images_reserved - num_images_consumed >= max_num_images_in_flight) {
+          cv_observation_consumed.wait(lock);
+        }
+        if (is_cancelled || is_source_exhausted) {
+          return;
+        }
+        ++num_images_reserved;
+      }
+
+      cv::Mat image;
+      size_t image_index = 0u;
+      bool has_image = false;
+      {
+        std::lock_guard<std::mutex> source_lock(source_mutex);
+        if (!has_source_ended) {
+          has_image = image_source(&image);
+          if (has_image) {
+            image_index = num_images_read++;
+          } else {
+            has_source_ended = true;
+          }
+        }
+        if (!has_image) {
+          std::lock_guard<std::mutex> lock(mutex);
+          --num_images_reserved;
+          num_images_total = num_images_read;
+          is_source_exhausted = true;
+          cv_observation_added.notify_all();
+          cv_observation_consumed.notify_all();
+          return;
+        }
+      }
+
+      const TargetObservation::Ptr observation =
+          detectTargetInImage(image, &tag_detector, false /*show_wild_tags*/);
+      std::lock_guard<std::mutex> lock(mutex);
+      observations.emplace(image_index, observation);
+      cv_observation_added.notify_all();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < num_threads; ++thread_idx) {
+    threads.emplace_back(detect);
+  }
+
+  // Pass the observations on in order, the callback runs without holding the lock.
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    while (observations.count(num_images_consumed) == 0u &&
+           !(is_source_exhausted && num_images_consumed == num_images_total)) {
+      cv_observation_added.wait(lock);
+    }
+    std::map<size_t, TargetObservation::Ptr>::iterator it =
+        observations.find(num_images_consumed);
+    if (it == observations.end()) {
+      break;
+    }
+    const TargetObservation::Ptr observation = it->second;
+    observations.erase(it);
+    lock.unlock();
+    const bool is_continuing = callback(num_images_consumed, observation);
+    lock.lock();
+    ++num_images_consumed;
+    cv_observation_consumed.notify_all();
+    if (!is_continuing) {
+      is_cancelled = true;
+      break;
+    }
+  }
+  lock.unlock();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return num_images_consumed;
+}
+
+std::vector<TargetObservation::Ptr> DetectorAprilGrid::detectTargetInImages(
+    const std::vector<cv::Mat>& images, size_t num_threads) const {
+  std::vector<TargetObservation::Ptr> observations(images.size());
+  size_t next_image_index = 0u;
+  detectTargetInImages(
+      [&](cv::Mat* image) {
+        if (next_image_index == images.size()) {
+          return false;
+        }
+        *CHECK_NOTNULL(image) = images[next_image_index++];
+        return true;
+      },
+      num_threads, std::max<size_t>(1u, images.size()),
+      [&](size_t image_index, const TargetObservation::Ptr& observation) {
+        observations[image_index] = observation;
+        return true;
+      });
+  return observations;
+}
+
+TargetObservation::Ptr DetectorAprilGrid::detectTargetInImage(
+    const cv::Mat& image, AprilTags::TagDetector* tag_detector, bool show_wild_tags) const {
+  CHECK_NOTNULL(tag_detector);
+  // Detect all Apriltags in the image, or in the downscaled image.
+  const size_t downscale_factor = detector_config_.detection_downscale_factor;
+  std::vector<AprilTags::TagDetection> detections;
+  if (downscale_factor > 1u) {
+    cv::Mat downscaled_image;
+    cv::resize(image, downscaled_image, cv::Size(), 1.0 / downscale_factor,
+               1.0 / downscale_factor, cv::INTER_AREA);
+    detections = tag_detector->extractTags(downscaled_image);
+    // A downscaled pixel averages downscale_factor^2 pixels, its center is in the middle of them.
+    const float scale = static_cast<float>(downscale_factor);
+    const auto upscale = [scale](std::pair<float, float>* point) {
+      point->first = (point->first + 0.5f) * scale - 0.5f;
+      point->second = (point->second + 0.5f) * scale - 0.5f;
+    };
+    for (AprilTags::TagDetection& detection : detections) {
+      for (int tag_corner_idx = 0; tag_corner_idx < 4; ++tag_corner_idx) {
+        upscale(&detection.p[tag_corner_idx]);
+      }
+      upscale(&detection.cxy);
+    }
+  } else {
+    detections = tag_detector->extractTags(image);
+  }
 
   // Remove bad tags.
   std::vector<AprilTags::TagDetection>::iterator iter = detections.begin();
@@ -125,6 +289,11 @@ TargetObservation::Ptr DetectorAprilGrid::detectTargetInImage(const cv::Mat& ima
   if (detections.size() > 1) {
     for (size_t tag_idx = 0; tag_idx < detections.size() - 1; ++tag_idx)
       if (detections[tag_idx].id == detections[tag_idx + 1].id) {
+        if (!show_wild_tags) {
+          LOG(WARNING) << "Found apriltag not belonging to calibration board, dropping the "
+                       << "observation.";
+          return TargetObservation::Ptr();
+        }
         // Show image of duplicate Apriltag.
         cv::destroyAllWindows();
         cv::namedWindow("Wild Apriltag detected. Hide them!");
@@ -177,10 +346,16 @@ TargetObservation::Ptr DetectorAprilGrid::detectTargetInImage(const cv::Mat& ima
   cv::Mat tag_corners_raw = tag_corners.clone();
 
   // Perform optional subpixel refinement on all tag corners (four corners each tag).
+  // Corners detected on the downscaled image are off by up to about the downscale factor.
   if (detector_config_.run_subpixel_refinement) {
-    cv::cornerSubPix(image, tag_corners, cv::Size(2, 2), cv::Size(-1, -1),
+    const int window_half_size = 2 * static_cast<int>(downscale_factor);
+    cv::cornerSubPix(image, tag_corners, cv::Size(window_half_size, window_half_size),
+                     cv::Size(-1, -1),
                      cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
   }
+  const double max_subpixel_refine_displacement_px_sq =
+      detector_config_.max_subpixel_refine_displacement_px_sq *
+      static_cast<double>(downscale_factor * downscale_factor);
 
   // Insert the observed points into the correct location of the grid point array.
   // point ordering
@@ -216,9 +391,17 @@ TargetObservation::Ptr DetectorAprilGrid::detectTargetInImage(const cv::Mat& ima
           tag_corners_raw.row(4 * tag_idx + tag_corner_idx).at<float>(0),
           tag_corners_raw.row(4 * tag_idx + tag_corner_idx).at<float>(1));
 
+      // cornerSubPix returns the initial corner if the refinement diverges. The coarse corners
+      // of the downscaled image are then rejected instead of being accepted unrefined.
+      if (downscale_factor > 1u && corner_refined == corner_raw) {
+        VLOG(3) << "The refinement of corner " << point_indices_tag[tag_corner_idx]
+                << " of the downscaled detection failed.";
+        continue;
+      }
+
       // Add corner points if it has not moved too far in the subpix refinement.
       const double subpix_displacement_squarred = (corner_refined - corner_raw).squaredNorm();
-      if (subpix_displacement_squarred <= detector_config_.max_subpixel_refine_displacement_px_sq) {
+      if (subpix_displacement_squarred <= max_subpixel_refine_displacement_px_sq) {
         corner_ids(out_point_idx) = point_indices_tag[tag_corner_idx];
         image_corners.col(out_point_idx) = corner_refined;
         ++out_point_idx;
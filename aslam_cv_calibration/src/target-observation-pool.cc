@@ -0,0 +1,136 @@
+#include "aslam/calibration/target-observation-pool.h"
+
+#include <algorithm>
+#include <bitset>
+#include <limits>
+#include <numeric>
+
+namespace aslam {
+namespace calibration {
+namespace {
+constexpr size_t kNumBitsPerWord = 64u;
+
+inline size_t countBits(uint64_t word) {
+  return std::bitset<kNumBitsPerWord>(word).count();
+}
+}  // namespace
+
+TargetObservationPool::TargetObservationPool(const TargetBase::Ptr& target)
+    : target_(target),
+      num_bitset_words_(
+          (CHECK_NOTNULL(target.get())->size() + kNumBitsPerWord - 1u) / kNumBitsPerWord) {}
+
+void TargetObservationPool::reserve(size_t num_observations, size_t num_corners) {
+  observations_.reserve(num_observations);
+  corner_bitsets_.reserve(num_observations * num_bitset_words_);
+  image_corners_.reserve(2u * num_observations * num_corners);
+  corner_ids_.reserve(num_observations * num_corners);
+}
+
+void TargetObservationPool::clear() {
+  observations_.clear();
+  corner_bitsets_.clear();
+  image_corners_.clear();
+  corner_ids_.clear();
+}
+
+size_t TargetObservationPool::add(
+    uint32_t im_height, uint32_t im_width, const Eigen::VectorXi& corner_ids,
+    const Eigen::Matrix2Xd& image_corners) {
+  CHECK_EQ(corner_ids.rows(), image_corners.cols());
+  CHECK_LT(corner_ids_.size() + corner_ids.rows(),
+           static_cast<size_t>(std::numeric_limits<uint32_t>::max()));
+  const size_t num_corners = static_cast<size_t>(corner_ids.rows());
+
+  // Sorted by id, the index of a corner is then its rank in the bitset.
+  std::vector<int> order(num_corners);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&corner_ids](int lhs, int rhs) {
+    return corner_ids(lhs) < corner_ids(rhs);
+  });
+
+  ObservationRecord record;
+  record.corner_offset = static_cast<uint32_t>(corner_ids_.size());
+  record.num_corners = static_cast<uint32_t>(num_corners);
+  record.image_height = im_height;
+  record.image_width = im_width;
+
+  const size_t bitset_offset = corner_bitsets_.size();
+  corner_bitsets_.resize(bitset_offset + num_bitset_words_, 0u);
+  uint64_t* bitset = &corner_bitsets_[bitset_offset];
+  for (int index : order) {
+    const int corner_id = corner_ids(index);
+    CHECK_GE(corner_id, 0);
+    CHECK_LT(static_cast<size_t>(corner_id), target_->size());
+    uint64_t& word = bitset[corner_id / kNumBitsPerWord];
+    const uint64_t bit = uint64_t{1} << (corner_id % kNumBitsPerWord);
+    CHECK_EQ(word & bit, 0u) << "Corner " << corner_id << " observed twice.";
+    word |= bit;
+    corner_ids_.push_back(corner_id);
+    image_corners_.push_back(image_corners(0, index));
+    image_corners_.push_back(image_corners(1, index));
+  }
+  observations_.push_back(record);
+  return observations_.size() - 1u;
+}
+
+size_t TargetObservationPool::add(const TargetObservation& observation) {
+  CHECK(observation.getTarget() == target_)
+      << "The observation is of a different target than the pool.";
+  return add(observation.getImageHeight(), observation.getImageWidth(),
+             observation.getObservedCornerIds(), observation.getObservedCorners());
+}
+
+bool TargetObservationPool::observedCornerId(size_t obs_idx, size_t corner_id) const {
+  CHECK_LT(obs_idx, observations_.size());
+  CHECK_LT(corner_id, target_->size());
+  const uint64_t* bitset = getCornerBitset(obs_idx);
+  return (bitset[corner_id / kNumBitsPerWord] >> (corner_id % kNumBitsPerWord)) & 1u;
+}
+
+bool TargetObservationPool::getObservedCornerById(
+    size_t obs_idx, size_t corner_id, Eigen::Vector2d* obs_corner) const {
+  CHECK_NOTNULL(obs_corner);
+  if (!observedCornerId(obs_idx, corner_id)) {
+    return false;
+  }
+  const uint64_t* bitset = getCornerBitset(obs_idx);
+  const size_t word_idx = corner_id / kNumBitsPerWord;
+  size_t rank = 0u;
+  for (size_t i = 0u; i < word_idx; ++i) {
+    rank += countBits(bitset[i]);
+  }
+  const uint64_t lower_bits_mask = (uint64_t{1} << (corner_id % kNumBitsPerWord)) - 1u;
+  rank += countBits(bitset[word_idx] & lower_bits_mask);
+  const double* corner = &image_corners_[2u * (observations_[obs_idx].corner_offset + rank)];
+  *obs_corner << corner[0], corner[1];
+  return true;
+}
+
+TargetObservationPool::ConstCornersMap TargetObservationPool::getObservedCorners(
+    size_t obs_idx) const {
+  const ObservationRecord& record = getRecord(obs_idx);
+  return ConstCornersMap(image_corners_.data() + 2u * record.corner_offset, 2, record.num_corners);
+}
+
+TargetObservationPool::ConstCornerIdsMap TargetObservationPool::getObservedCornerIds(
+    size_t obs_idx) const {
+  const ObservationRecord& record = getRecord(obs_idx);
+  return ConstCornerIdsMap(corner_ids_.data() + record.corner_offset, record.num_corners);
+}
+
+TargetObservation::Ptr TargetObservationPool::getObservation(size_t obs_idx) const {
+  const ObservationRecord& record = getRecord(obs_idx);
+  return TargetObservation::Ptr(new TargetObservation(
+      target_, record.image_height, record.image_width, getObservedCornerIds(obs_idx),
+      getObservedCorners(obs_idx)));
+}
+
+size_t TargetObservationPool::getNumBytes() const {
+  return sizeof(*this) + observations_.capacity() * sizeof(ObservationRecord) +
+      corner_bitsets_.capacity() * sizeof(uint64_t) +
+      image_corners_.capacity() * sizeof(double) + corner_ids_.capacity() * sizeof(int);
+}
+
+}  // namespace calibration
+}  // namespace aslam
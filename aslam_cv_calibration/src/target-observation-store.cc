@@ -0,0 +1,250 @@
+#include "aslam/calibration/target-observation-store.h"
+
+#include <errno.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <tuple>
+
+#include <glog/logging.h>
+
+namespace aslam {
+namespace calibration {
+using namespace observation_store;  // NOLINT
+
+TargetObservationStoreWriter::TargetObservationStoreWriter()
+    : target_rows_(0u), target_cols_(0u), num_observations_(0u) {}
+
+TargetObservationStoreWriter::~TargetObservationStoreWriter() {
+  if (isOpen()) {
+    close();
+  }
+}
+
+bool TargetObservationStoreWriter::open(const std::string& path, const TargetBase& target) {
+  CHECK(!isOpen()) << "The store " << path_ << " is still open.";
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  if (!file_.is_open()) {
+    LOG(ERROR) << "Could not open " << path << " for writing.";
+    return false;
+  }
+  path_ = path;
+  target_rows_ = target.rows();
+  target_cols_ = target.cols();
+  num_observations_ = 0u;
+
+  StoreHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kStoreMagic;
+  header.version = kFormatVersion;
+  header.header_size_bytes = static_cast<uint16_t>(sizeof(StoreHeader));
+  header.target_rows = static_cast<uint32_t>(target_rows_);
+  header.target_cols = static_cast<uint32_t>(target_cols_);
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  return file_.good();
+}
+
+bool TargetObservationStoreWriter::append(
+    size_t camera_index, int64_t timestamp_nanoseconds, const TargetObservation& observation) {
+  CHECK(isOpen());
+  const TargetBase::ConstPtr target = observation.getTarget();
+  CHECK(target->rows() == target_rows_ && target->cols() == target_cols_)
+      << "The observation is of a different target than the store.";
+  CHECK_LE(camera_index, std::numeric_limits<uint32_t>::max());
+  const size_t num_corners = observation.numObservedCorners();
+
+  RecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kRecordMagic;
+  header.camera_index = static_cast<uint32_t>(camera_index);
+  header.timestamp_nanoseconds = timestamp_nanoseconds;
+  header.image_height = observation.getImageHeight();
+  header.image_width = observation.getImageWidth();
+  header.num_corners = static_cast<uint32_t>(num_corners);
+
+  // The record is assembled in memory, the file stream buffers the writes.
+  record_buffer_.assign(getRecordSizeBytes(num_corners), 0);
+  char* data = record_buffer_.data();
+  std::memcpy(data, &header, sizeof(header));
+  data += sizeof(header);
+  std::memcpy(data, observation.getObservedCorners().data(), 2u * num_corners * sizeof(double));
+  data += 2u * num_corners * sizeof(double);
+  const Eigen::VectorXi& corner_ids = observation.getObservedCornerIds();
+  for (size_t i = 0u; i < num_corners; ++i) {
+    const int32_t corner_id = static_cast<int32_t>(corner_ids(i));
+    std::memcpy(data + i * sizeof(int32_t), &corner_id, sizeof(int32_t));
+  }
+  file_.write(record_buffer_.data(), record_buffer_.size());
+  if (!file_.good()) {
+    LOG(ERROR) << "Writing to " << path_ << " failed.";
+    return false;
+  }
+  ++num_observations_;
+  return true;
+}
+
+bool TargetObservationStoreWriter::close() {
+  CHECK(isOpen());
+  file_.flush();
+  const bool success = file_.good();
+  file_.close();
+  if (!success) {
+    LOG(ERROR) << "Closing " << path_ << " failed.";
+  }
+  return success;
+}
+
+TargetObservationStoreWriter::ObservationCallback TargetObservationStoreWriter::getAppendCallback(
+    size_t camera_index, const std::function<int64_t(size_t image_index)>& get_timestamp) {
+  CHECK(get_timestamp);
+  return [this, camera_index, get_timestamp](
+      size_t image_index, const TargetObservation::Ptr& observation) {
+    if (!observation) {
+      return true;
+    }
+    return append(camera_index, get_timestamp(image_index), *observation);
+  };
+}
+
+TargetObservationStore::TargetObservationStore() {}
+
+TargetObservationStore::~TargetObservationStore() {
+  close();
+}
+
+bool TargetObservationStore::open(const std::string& path, const TargetBase::Ptr& target) {
+  CHECK(target);
+  close();
+  if (!mapped_file_.open(path)) {
+    LOG(ERROR) << "Could not open " << path << ": " << std::strerror(errno);
+    return false;
+  }
+  if (mapped_file_.sizeBytes() < sizeof(StoreHeader)) {
+    LOG(ERROR) << path << " is not a target observation store.";
+    close();
+    return false;
+  }
+
+  const StoreHeader* header = reinterpret_cast<const StoreHeader*>(mapped_file_.data());
+  if (header->magic != kStoreMagic || header->version != kFormatVersion ||
+      header->header_size_bytes != sizeof(StoreHeader)) {
+    LOG(ERROR) << path << " is not a target observation store of format version "
+               << kFormatVersion << ".";
+    close();
+    return false;
+  }
+  if (header->target_rows != target->rows() || header->target_cols != target->cols()) {
+    LOG(ERROR) << path << " holds observations of a " << header->target_rows << "x"
+               << header->target_cols << " target, not of a " << target->rows() << "x"
+               << target->cols() << " target.";
+    close();
+    return false;
+  }
+  target_ = target;
+  return buildIndex();
+}
+
+void TargetObservationStore::close() {
+  mapped_file_.close();
+  entries_.clear();
+  target_.reset();
+}
+
+bool TargetObservationStore::buildIndex() {
+  entries_.clear();
+  const char* data = mapped_file_.data();
+  const size_t size_bytes = mapped_file_.sizeBytes();
+  size_t offset = sizeof(StoreHeader);
+  while (offset < size_bytes) {
+    const size_t remaining_bytes = size_bytes - offset;
+    if (remaining_bytes < sizeof(RecordHeader)) {
+      break;
+    }
+    const RecordHeader* header = reinterpret_cast<const RecordHeader*>(data + offset);
+    if (header->magic != kRecordMagic || header->num_corners > target_->size() ||
+        getRecordSizeBytes(header->num_corners) > remaining_bytes) {
+      break;
+    }
+    IndexEntry entry;
+    entry.camera_index = header->camera_index;
+    entry.timestamp_nanoseconds = header->timestamp_nanoseconds;
+    entry.offset = offset;
+    entries_.push_back(entry);
+    offset += getRecordSizeBytes(header->num_corners);
+  }
+  if (offset < size_bytes) {
+    // A truncated last record is expected after a crash while writing.
+    LOG(WARNING) << "Ignoring " << size_bytes - offset << " bytes after the last valid record.";
+  }
+  std::stable_sort(entries_.begin(), entries_.end(),
+                   [](const IndexEntry& lhs, const IndexEntry& rhs) {
+    return std::tie(lhs.camera_index, lhs.timestamp_nanoseconds) <
+        std::tie(rhs.camera_index, rhs.timestamp_nanoseconds);
+  });
+  return true;
+}
+
+const RecordHeader& TargetObservationStore::getRecordHeader(size_t index) const {
+  CHECK_LT(index, entries_.size());
+  return *reinterpret_cast<const RecordHeader*>(mapped_file_.data() + entries_[index].offset);
+}
+
+TargetObservationStore::ConstCornersMap TargetObservationStore::getObservedCorners(
+    size_t index) const {
+  const RecordHeader& header = getRecordHeader(index);
+  const double* corners = reinterpret_cast<const double*>(
+      reinterpret_cast<const char*>(&header) + sizeof(RecordHeader));
+  return ConstCornersMap(corners, 2, header.num_corners);
+}
+
+TargetObservationStore::ConstCornerIdsMap TargetObservationStore::getObservedCornerIds(
+    size_t index) const {
+  static_assert(sizeof(int) == sizeof(int32_t), "The corner ids are stored as int32.");
+  const RecordHeader& header = getRecordHeader(index);
+  const int* corner_ids = reinterpret_cast<const int*>(
+      reinterpret_cast<const char*>(&header) + sizeof(RecordHeader) +
+      2u * header.num_corners * sizeof(double));
+  return ConstCornerIdsMap(corner_ids, header.num_corners);
+}
+
+TargetObservation::Ptr TargetObservationStore::getObservation(size_t index) const {
+  const RecordHeader& header = getRecordHeader(index);
+  return TargetObservation::Ptr(new TargetObservation(
+      target_, header.image_height, header.image_width, getObservedCornerIds(index),
+      getObservedCorners(index)));
+}
+
+bool TargetObservationStore::findObservation(
+    size_t camera_index, int64_t timestamp_nanoseconds, size_t* index) const {
+  CHECK_NOTNULL(index);
+  const std::vector<IndexEntry>::const_iterator it = std::lower_bound(
+      entries_.begin(), entries_.end(), std::make_pair(camera_index, timestamp_nanoseconds),
+      [](const IndexEntry& entry, const std::pair<size_t, int64_t>& key) {
+    return std::make_pair(static_cast<size_t>(entry.camera_index), entry.timestamp_nanoseconds) <
+        key;
+  });
+  if (it == entries_.end() || it->camera_index != camera_index ||
+      it->timestamp_nanoseconds != timestamp_nanoseconds) {
+    return false;
+  }
+  *index = it - entries_.begin();
+  return true;
+}
+
+void TargetObservationStore::getObservationsOfCamera(
+    size_t camera_index, size_t* begin, size_t* end) const {
+  CHECK_NOTNULL(begin);
+  CHECK_NOTNULL(end);
+  *begin = std::lower_bound(entries_.begin(), entries_.end(), camera_index,
+                            [](const IndexEntry& entry, size_t camera) {
+    return entry.camera_index < camera;
+  }) - entries_.begin();
+  *end = std::upper_bound(entries_.begin(), entries_.end(), camera_index,
+                          [](size_t camera, const IndexEntry& entry) {
+    return camera < entry.camera_index;
+  }) - entries_.begin();
+}
+
+}  // namespace calibration
+}  // namespace aslam
@@ -11,6 +11,7 @@
 #include <aslam/cameras/camera-factory.h>
 #include <aslam/cameras/camera-pinhole.h>
 #include <aslam/cameras/distortion.h>
+#include <aslam/cameras/distortion-radtan.h>
 #include <aslam/common/entrypoint.h>
 #include <aslam/common/pose-types.h>
 
@@ -152,4 +153,70 @@ TYPED_TEST(TestCameras, DISABLED_InitializeIntrinsics) {
   EXPECT_TRUE(EIGEN_MATRIX_NEAR(intrinsics_guess, this->camera_->getParameters(), kTolerance));
 }
 
+TEST(FocalLengthInitializers, SelectFocalLengthRobust) {
+  aslam::Aligned<std::vector, Eigen::Vector2d> candidates;
+  candidates.emplace_back(400.0, 402.0);
+  candidates.emplace_back(398.0, 400.0);
+  candidates.emplace_back(401.0, 399.0);
+  candidates.emplace_back(900.0, 900.0);
+  candidates.emplace_back(50.0, 50.0);
+  candidates.emplace_back(-400.0, 400.0);
+
+  Eigen::Vector2d focal_lengths;
+  size_t num_inliers = 0u;
+  ASSERT_TRUE(aslam::calibration::selectFocalLengthRobust(
+      candidates, 0.05, &focal_lengths, &num_inliers));
+  EXPECT_EQ(3u, num_inliers);
+  EXPECT_EQ(400.0, focal_lengths(0));
+  EXPECT_EQ(400.0, focal_lengths(1));
+
+  EXPECT_FALSE(aslam::calibration::selectFocalLengthRobust(
+      aslam::Aligned<std::vector, Eigen::Vector2d>(), 0.05, &focal_lengths, &num_inliers));
+}
+
+TEST(FocalLengthInitializers, InitFocalLengthRobustAbsoluteConic) {
+  aslam::PinholeCamera::Ptr camera =
+      aslam::PinholeCamera::createIntrinsicsTestCamera<aslam::RadTanDistortion>();
+  aslam::calibration::TargetAprilGrid::TargetConfiguration aprilgrid_config;
+  aslam::calibration::TargetAprilGrid::Ptr aprilgrid(
+      new aslam::calibration::TargetAprilGrid(aprilgrid_config));
+
+  constexpr size_t kNumCamPoses = 200u;
+  constexpr size_t kNumOutlierPoses = 20u;
+  constexpr double kMaxTranslationM = 0.1;
+  constexpr double kMaxRotationDeg = 20.0;
+
+  // The target center in front of the camera.
+  aslam::Transformation T_C_T_nominal;
+  T_C_T_nominal.getPosition() = Eigen::Vector3d(-0.33, -0.33, 1.5);
+
+  std::vector<aslam::calibration::TargetObservation::Ptr> target_observations;
+  while (target_observations.size() < kNumCamPoses) {
+    aslam::Transformation disturbance;
+    disturbance.setRandom(kMaxTranslationM, kMaxRotationDeg * kDegToRad);
+    aslam::calibration::TargetObservation::Ptr obs =
+        simulateTargetObservation(aprilgrid, *camera, T_C_T_nominal * disturbance);
+    if (!obs->allCornersObservered()) {
+      continue;
+    }
+    if (target_observations.size() < kNumOutlierPoses) {
+      // Corrupt the corners, e.g. by a wrong detection.
+      Eigen::Matrix2Xd corners = obs->getObservedCorners();
+      corners.array() += 30.0 * corners.array().sin();
+      obs.reset(new aslam::calibration::TargetObservation(
+          aprilgrid, camera->imageHeight(), camera->imageWidth(),
+          obs->getObservedCornerIds(), corners));
+    }
+    target_observations.push_back(obs);
+  }
+
+  for (size_t num_threads : {1u, 4u}) {
+    Eigen::VectorXd intrinsics;
+    ASSERT_TRUE(aslam::calibration::initFocalLengthRobust(
+        target_observations, aslam::calibration::FocalLengthCandidateMethod::kAbsoluteConic,
+        num_threads, &intrinsics));
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(intrinsics, camera->getParameters(), 1e-2));
+  }
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
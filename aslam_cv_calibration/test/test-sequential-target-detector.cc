@@ -0,0 +1,194 @@
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/entrypoint.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+
+#include "aslam/calibration/sequential-target-detector.h"
+#include "aslam/calibration/target-base.h"
+#include "aslam/calibration/target-observation.h"
+
+namespace aslam {
+namespace calibration {
+
+constexpr size_t kTargetRows = 4u;
+constexpr size_t kTargetCols = 8u;
+constexpr double kCornerSpacingM = 0.1;
+constexpr int kCornerSpacingPx = 20;
+
+/// A planar grid of kTargetRows x kTargetCols points.
+class GridTarget : public TargetBase {
+ public:
+  GridTarget() : TargetBase(kTargetRows, kTargetCols, createPoints()) {}
+  virtual ~GridTarget() {}
+
+ private:
+  static Eigen::Matrix3Xd createPoints() {
+    Eigen::Matrix3Xd points(3, kTargetRows * kTargetCols);
+    for (size_t row_idx = 0u; row_idx < kTargetRows; ++row_idx) {
+      for (size_t col_idx = 0u; col_idx < kTargetCols; ++col_idx) {
+        points.col(kTargetCols * row_idx + col_idx) =
+            Eigen::Vector3d(kCornerSpacingM * col_idx, kCornerSpacingM * row_idx, 0.0);
+      }
+    }
+    return points;
+  }
+};
+
+/// Detects the corners drawn as single pixels with the value corner id + 1.
+class PixelCornerDetector : public DetectorBase {
+ public:
+  explicit PixelCornerDetector(const TargetBase::Ptr& target)
+      : target_(target), num_calls_(0u) {}
+  virtual ~PixelCornerDetector() {}
+
+  virtual TargetObservation::Ptr detectTargetInImage(const cv::Mat& image) const {
+    CHECK_EQ(image.type(), CV_8UC1);
+    ++num_calls_;
+    last_image_size_ = image.size();
+    std::vector<int> corner_ids;
+    std::vector<Eigen::Vector2d> corners;
+    for (int y = 0; y < image.rows; ++y) {
+      for (int x = 0; x < image.cols; ++x) {
+        if (image.at<uchar>(y, x) > 0u) {
+          corner_ids.push_back(image.at<uchar>(y, x) - 1);
+          corners.emplace_back(x, y);
+        }
+      }
+    }
+    if (corner_ids.size() < 4u) {
+      return TargetObservation::Ptr();
+    }
+    Eigen::VectorXi corner_ids_vector(corner_ids.size());
+    Eigen::Matrix2Xd corners_matrix(2, corners.size());
+    for (size_t corner_idx = 0u; corner_idx < corners.size(); ++corner_idx) {
+      corner_ids_vector(corner_idx) = corner_ids[corner_idx];
+      corners_matrix.col(corner_idx) = corners[corner_idx];
+    }
+    return TargetObservation::Ptr(new TargetObservation(
+        target_, image.rows, image.cols, corner_ids_vector, corners_matrix));
+  }
+
+  size_t getNumCalls() const { return num_calls_; }
+  const cv::Size& getLastImageSize() const { return last_image_size_; }
+
+ private:
+  const TargetBase::Ptr target_;
+  mutable size_t num_calls_;
+  mutable cv::Size last_image_size_;
+};
+
+class SequentialTargetDetectorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    target_.reset(new GridTarget);
+    detector_.reset(new PixelCornerDetector(target_));
+    sequential_detector_.reset(new SequentialTargetDetector(
+        detector_, Camera::ConstPtr(), SequentialTargetDetector::Configuration()));
+  }
+
+  /// An image with the target at the offset, only the first num_cols columns are drawn.
+  cv::Mat drawTarget(int offset_x, int offset_y, size_t num_cols = kTargetCols) const {
+    cv::Mat image = cv::Mat::zeros(480, 640, CV_8UC1);
+    for (size_t row_idx = 0u; row_idx < kTargetRows; ++row_idx) {
+      for (size_t col_idx = 0u; col_idx < num_cols; ++col_idx) {
+        const cv::Point corner = getCorner(offset_x, offset_y, row_idx, col_idx);
+        if (corner.inside(cv::Rect(0, 0, image.cols, image.rows))) {
+          image.at<uchar>(corner) = static_cast<uchar>(kTargetCols * row_idx + col_idx + 1u);
+        }
+      }
+    }
+    return image;
+  }
+
+  static cv::Point getCorner(int offset_x, int offset_y, size_t row_idx, size_t col_idx) {
+    return cv::Point(offset_x + kCornerSpacingPx * static_cast<int>(col_idx),
+                     offset_y + kCornerSpacingPx * static_cast<int>(row_idx));
+  }
+
+  TargetBase::Ptr target_;
+  std::shared_ptr<PixelCornerDetector> detector_;
+  SequentialTargetDetector::Ptr sequential_detector_;
+};
+
+TEST_F(SequentialTargetDetectorTest, SearchesThePredictedRegionFirst) {
+  TargetObservation::Ptr observation =
+      sequential_detector_->detectTargetInImage(drawTarget(100, 100));
+  ASSERT_TRUE(observation);
+  EXPECT_EQ(1u, sequential_detector_->getNumFullImageDetections());
+  ASSERT_TRUE(sequential_detector_->hasRoi());
+
+  observation = sequential_detector_->detectTargetInImage(drawTarget(110, 105));
+  ASSERT_TRUE(observation);
+  EXPECT_EQ(1u, sequential_detector_->getNumRoiDetections());
+  EXPECT_EQ(1u, sequential_detector_->getNumFullImageDetections());
+  EXPECT_EQ(2u, detector_->getNumCalls());
+  EXPECT_LT(detector_->getLastImageSize().area(), 640 * 480);
+  // The corners are in the coordinates of the full image.
+  ASSERT_EQ(kTargetRows * kTargetCols, observation->numObservedCorners());
+  for (size_t corner_idx = 0u; corner_idx < observation->numObservedCorners(); ++corner_idx) {
+    const int corner_id = observation->getObservedCornerIds()(corner_idx);
+    const cv::Point corner = getCorner(110, 105, corner_id / kTargetCols, corner_id % kTargetCols);
+    EXPECT_EQ(static_cast<double>(corner.x), observation->getObservedCorners()(0, corner_idx));
+    EXPECT_EQ(static_cast<double>(corner.y), observation->getObservedCorners()(1, corner_idx));
+  }
+}
+
+TEST_F(SequentialTargetDetectorTest, FallsBackToTheFullImageForPartialDetections) {
+  ASSERT_TRUE(sequential_detector_->detectTargetInImage(drawTarget(100, 100)));
+  ASSERT_TRUE(sequential_detector_->hasRoi());
+  const cv::Rect roi = sequential_detector_->getRoi();
+
+  // The target moved such that its last column is outside of the region.
+  const int offset_x =
+      roi.x + roi.width - kCornerSpacingPx * static_cast<int>(kTargetCols - 1u) + 5;
+  ASSERT_FALSE(getCorner(offset_x, 100, 0u, kTargetCols - 1u).inside(roi));
+  ASSERT_TRUE(getCorner(offset_x, 100, 0u, 0u).inside(roi));
+  const TargetObservation::Ptr observation =
+      sequential_detector_->detectTargetInImage(drawTarget(offset_x, 100));
+  ASSERT_TRUE(observation);
+  EXPECT_EQ(kTargetRows * kTargetCols, observation->numObservedCorners());
+  EXPECT_EQ(0u, sequential_detector_->getNumRoiDetections());
+  EXPECT_EQ(2u, sequential_detector_->getNumFullImageDetections());
+  EXPECT_EQ(3u, detector_->getNumCalls());
+}
+
+TEST_F(SequentialTargetDetectorTest, FallsBackToTheFullImageIfTheRegionFails) {
+  ASSERT_TRUE(sequential_detector_->detectTargetInImage(drawTarget(100, 100)));
+  ASSERT_TRUE(sequential_detector_->hasRoi());
+  // The target jumped to the other side of the image.
+  ASSERT_TRUE(sequential_detector_->detectTargetInImage(drawTarget(400, 300)));
+  EXPECT_EQ(2u, sequential_detector_->getNumFullImageDetections());
+  EXPECT_TRUE(sequential_detector_->getRoi().contains(getCorner(400, 300, 0u, 0u)));
+
+  EXPECT_FALSE(sequential_detector_->detectTargetInImage(cv::Mat::zeros(480, 640, CV_8UC1)));
+  EXPECT_FALSE(sequential_detector_->hasRoi());
+}
+
+TEST_F(SequentialTargetDetectorTest, RegionCoversTheUnobservedCorners) {
+  // Only the first half of the target is visible, the region still covers all of it.
+  ASSERT_TRUE(sequential_detector_->detectTargetInImage(drawTarget(100, 100, kTargetCols / 2u)));
+  ASSERT_TRUE(sequential_detector_->hasRoi());
+  EXPECT_TRUE(sequential_detector_->getRoi().contains(
+      getCorner(100, 100, kTargetRows - 1u, kTargetCols - 1u)));
+
+  // The whole target is found in the region, and the region doesn't shrink.
+  const cv::Rect roi = sequential_detector_->getRoi();
+  const TargetObservation::Ptr observation =
+      sequential_detector_->detectTargetInImage(drawTarget(100, 100));
+  ASSERT_TRUE(observation);
+  EXPECT_EQ(kTargetRows * kTargetCols, observation->numObservedCorners());
+  EXPECT_EQ(1u, sequential_detector_->getNumRoiDetections());
+  for (size_t frame_idx = 0u; frame_idx < 5u; ++frame_idx) {
+    ASSERT_TRUE(sequential_detector_->detectTargetInImage(drawTarget(100, 100)));
+    EXPECT_EQ(roi, sequential_detector_->getRoi());
+  }
+  EXPECT_EQ(6u, sequential_detector_->getNumRoiDetections());
+}
+
+}  // namespace calibration
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <apriltags/Tag36h11.h>
+#include <Eigen/Core>
+#include <aslam/common/entrypoint.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "aslam/calibration/target-aprilgrid.h"
+#include "aslam/calibration/target-observation.h"
+
+namespace aslam {
+namespace calibration {
+
+constexpr size_t kNumTagRows = 3u;
+constexpr size_t kNumTagCols = 4u;
+constexpr size_t kTagBorderBits = 2u;
+constexpr int kBitSizePx = 8;
+constexpr int kTagSizePx = (6 + 2 * static_cast<int>(kTagBorderBits)) * kBitSizePx;
+constexpr int kTagSpacingPx = 24;
+constexpr int kMarginPx = 40;
+
+class DetectorAprilGridTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    TargetAprilGrid::TargetConfiguration target_config;
+    target_config.num_tag_rows = kNumTagRows;
+    target_config.num_tag_cols = kNumTagCols;
+    target_config.tag_size_meter = 0.1;
+    target_config.tag_inbetween_space_meter = 0.1 * kTagSpacingPx / kTagSizePx;
+    target_config.black_tag_border_bits = kTagBorderBits;
+    target_.reset(new TargetAprilGrid(target_config));
+    detector_.reset(new DetectorAprilGrid(target_, DetectorAprilGrid::DetectorConfiguration()));
+    grid_image_ = renderGrid();
+  }
+
+  /// The tag of row tag_row_idx, counted from the bottom of the target, in the image.
+  static cv::Rect getTagRect(size_t tag_row_idx, size_t tag_col_idx) {
+    return cv::Rect(
+        kMarginPx + static_cast<int>(tag_col_idx) * (kTagSizePx + kTagSpacingPx),
+        kMarginPx + static_cast<int>(kNumTagRows - 1u - tag_row_idx) *
+            (kTagSizePx + kTagSpacingPx),
+        kTagSizePx, kTagSizePx);
+  }
+
+  /// Renders the grid facing the camera, the target y axis pointing up in the image. The code
+  /// bits of a tag are drawn row by row from its top left corner, most significant bit first.
+  static cv::Mat renderGrid() {
+    const int width = 2 * kMarginPx + static_cast<int>(kNumTagCols) * kTagSizePx +
+        static_cast<int>(kNumTagCols - 1u) * kTagSpacingPx;
+    const int height = 2 * kMarginPx + static_cast<int>(kNumTagRows) * kTagSizePx +
+        static_cast<int>(kNumTagRows - 1u) * kTagSpacingPx;
+    cv::Mat image(height, width, CV_8UC1, cv::Scalar(255));
+    for (size_t tag_row_idx = 0u; tag_row_idx < kNumTagRows; ++tag_row_idx) {
+      for (size_t tag_col_idx = 0u; tag_col_idx < kNumTagCols; ++tag_col_idx) {
+        const cv::Rect tag_rect = getTagRect(tag_row_idx, tag_col_idx);
+        image(tag_rect).setTo(cv::Scalar(0));
+        const unsigned long long code =
+            AprilTags::tagCodes36h11.codes[tag_row_idx * kNumTagCols + tag_col_idx];
+        for (int bit_idx = 0; bit_idx < 36; ++bit_idx) {
+          if ((code >> (35 - bit_idx)) & 1ull) {
+            const cv::Rect bit_rect(
+                tag_rect.x + (static_cast<int>(kTagBorderBits) + bit_idx % 6) * kBitSizePx,
+                tag_rect.y + (static_cast<int>(kTagBorderBits) + bit_idx / 6) * kBitSizePx,
+                kBitSizePx, kBitSizePx);
+            image(bit_rect).setTo(cv::Scalar(255));
+          }
+        }
+      }
+    }
+    cv::GaussianBlur(image, image, cv::Size(3, 3), 0.8);
+    return image;
+  }
+
+  /// Checks that every corner of the target is observed where it was rendered.
+  void expectGridObserved(const TargetObservation& observation) const {
+    ASSERT_TRUE(observation.allCornersObservered());
+    const size_t num_point_cols = 2u * kNumTagCols;
+    for (size_t idx = 0u; idx < observation.numObservedCorners(); ++idx) {
+      const size_t corner_id = observation.getObservedCornerId(idx);
+      const size_t point_row_idx = corner_id / num_point_cols;
+      const size_t point_col_idx = corner_id % num_point_cols;
+      const cv::Rect tag_rect = getTagRect(point_row_idx / 2u, point_col_idx / 2u);
+      // The lower row of the tag corners is at the bottom of the tag in the image.
+      const Eigen::Vector2d expected_corner(
+          tag_rect.x - 0.5 + (point_col_idx % 2u) * kTagSizePx,
+          tag_rect.y - 0.5 + (1u - point_row_idx % 2u) * kTagSizePx);
+      EXPECT_LT((observation.getObservedCorner(idx) - expected_corner).norm(), 1.0)
+          << "Corner " << corner_id;
+    }
+  }
+
+  TargetAprilGrid::Ptr target_;
+  DetectorAprilGrid::Ptr detector_;
+  cv::Mat grid_image_;
+};
+
+TEST_F(DetectorAprilGridTest, DetectsSyntheticGrid) {
+  const TargetObservation::Ptr observation = detector_->detectTargetInImage(grid_image_);
+  ASSERT_TRUE(observation);
+  EXPECT_EQ(target_->size(), observation->numObservedCorners());
+  expectGridObserved(*observation);
+}
+
+TEST_F(DetectorAprilGridTest, DetectsSyntheticGridOnDownscaledImage) {
+  DetectorAprilGrid::DetectorConfiguration detector_config;
+  detector_config.detection_downscale_factor = 2u;
+  const DetectorAprilGrid downscaled_detector(target_, detector_config);
+  const TargetObservation::Ptr observation =
+      downscaled_detector.detectTargetInImage(grid_image_);
+  ASSERT_TRUE(observation);
+  EXPECT_EQ(target_->size(), observation->numObservedCorners());
+  expectGridObserved(*observation);
+
+  // The corners are refined on the full resolution image, as precisely as without downscaling.
+  const TargetObservation::Ptr full_resolution_observation =
+      detector_->detectTargetInImage(grid_image_);
+  ASSERT_TRUE(full_resolution_observation);
+  ASSERT_EQ(full_resolution_observation->getObservedCornerIds(),
+            observation->getObservedCornerIds());
+  for (size_t idx = 0u; idx < observation->numObservedCorners(); ++idx) {
+    EXPECT_LT((full_resolution_observation->getObservedCorner(idx) -
+               observation->getObservedCorner(idx)).norm(), 0.2) << "Corner " << idx;
+  }
+}
+
+TEST_F(DetectorAprilGridTest, DownscaledDetectionNeedsTheRefinement) {
+  DetectorAprilGrid::DetectorConfiguration detector_config;
+  detector_config.detection_downscale_factor = 2u;
+  detector_config.run_subpixel_refinement = false;
+  EXPECT_DEATH(DetectorAprilGrid detector(target_, detector_config), "subpixel refinement");
+}
+
+TEST_F(DetectorAprilGridTest, BatchedDetectionMatchesSingleImages) {
+  const cv::Mat blank_image(grid_image_.size(), CV_8UC1, cv::Scalar(255));
+  std::vector<cv::Mat> images;
+  for (size_t image_idx = 0u; image_idx < 12u; ++image_idx) {
+    images.push_back(image_idx % 3u == 1u ? blank_image : grid_image_);
+  }
+
+  const std::vector<TargetObservation::Ptr> observations =
+      detector_->detectTargetInImages(images, 4u);
+  ASSERT_EQ(images.size(), observations.size());
+  const TargetObservation::Ptr single_observation = detector_->detectTargetInImage(grid_image_);
+  ASSERT_TRUE(single_observation);
+  for (size_t image_idx = 0u; image_idx < images.size(); ++image_idx) {
+    if (image_idx % 3u == 1u) {
+      EXPECT_FALSE(observations[image_idx]) << "Image " << image_idx;
+      continue;
+    }
+    ASSERT_TRUE(observations[image_idx]) << "Image " << image_idx;
+    EXPECT_EQ(single_observation->getObservedCornerIds(),
+              observations[image_idx]->getObservedCornerIds());
+    EXPECT_EQ(single_observation->getObservedCorners(),
+              observations[image_idx]->getObservedCorners());
+  }
+}
+
+TEST_F(DetectorAprilGridTest, StreamIsReadSeriallyAndPassedOnInOrder) {
+  constexpr size_t kNumImages = 20u;
+  constexpr size_t kMaxNumImagesInFlight = 3u;
+  std::atomic<bool> is_source_running(false);
+  std::atomic<size_t> num_images_in_flight(0u);
+  size_t max_num_images_in_flight = 0u;
+  size_t num_images_read = 0u;
+  size_t num_source_calls_after_end = 0u;
+  std::vector<size_t> image_indices;
+  const cv::Mat blank_image(grid_image_.size(), CV_8UC1, cv::Scalar(255));
+
+  const size_t num_images_passed = detector_->detectTargetInImages(
+      [&](cv::Mat* image) {
+        EXPECT_FALSE(is_source_running.exchange(true));
+        bool has_image = false;
+        if (num_images_read < kNumImages) {
+          *image = (num_images_read % 2u == 0u) ? grid_image_ : blank_image;
+          ++num_images_read;
+          max_num_images_in_flight =
+              std::max<size_t>(max_num_images_in_flight, ++num_images_in_flight);
+          has_image = true;
+        } else {
+          ++num_source_calls_after_end;
+        }
+        is_source_running = false;
+        return has_image;
+      },
+      4u, kMaxNumImagesInFlight,
+      [&](size_t image_index, const TargetObservation::Ptr& observation) {
+        --num_images_in_flight;
+        image_indices.push_back(image_index);
+        EXPECT_EQ(image_index % 2u == 0u, static_cast<bool>(observation));
+        return true;
+      });
+
+  EXPECT_EQ(kNumImages, num_images_passed);
+  ASSERT_EQ(kNumImages, image_indices.size());
+  for (size_t idx = 0u; idx < kNumImages; ++idx) {
+    EXPECT_EQ(idx, image_indices[idx]);
+  }
+  EXPECT_LE(max_num_images_in_flight, kMaxNumImagesInFlight);
+  // The source is read until it first returns false.
+  EXPECT_EQ(1u, num_source_calls_after_end);
+}
+
+TEST_F(DetectorAprilGridTest, CallbackCancelsTheStream) {
+  constexpr size_t kMaxNumImagesInFlight = 2u;
+  size_t num_images_read = 0u;
+  const size_t num_images_passed = detector_->detectTargetInImages(
+      [&](cv::Mat* image) {
+        *image = grid_image_;
+        ++num_images_read;
+        return true;
+      },
+      2u, kMaxNumImagesInFlight,
+      [&](size_t image_index, const TargetObservation::Ptr& observation) {
+        EXPECT_TRUE(observation);
+        return image_index < 4u;
+      });
+  EXPECT_EQ(5u, num_images_passed);
+  // The images read ahead are bounded by the images in flight.
+  EXPECT_LE(num_images_read, num_images_passed + kMaxNumImagesInFlight);
+}
+
+}  // namespace calibration
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -1,4 +1,9 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
 #include <random>
+#include <string>
 #include <vector>
 
 #include <Eigen/Core>
@@ -14,6 +19,8 @@
 
 #include "aslam/calibration/target-algorithms.h"
 #include "aslam/calibration/target-aprilgrid.h"
+#include "aslam/calibration/target-observation-pool.h"
+#include "aslam/calibration/target-observation-store.h"
 #include "aslam/calibration/target-observation.h"
 
 class TargetObservationTest : public ::testing::Test {
@@ -27,6 +34,40 @@ class TargetObservationTest : public ::testing::Test {
     setTargetObservation();
   }
 
+  /// \brief Observation of the grid from T_G_C_observation, with noisy corners. Every
+  ///        corner_skip-th corner and the corners outside of the image are not observed.
+  aslam::calibration::TargetObservation::Ptr createObservation(
+      const aslam::Transformation& T_G_C_observation, int corner_skip,
+      std::mt19937* random_generator) const {
+    CHECK_NOTNULL(random_generator);
+    CHECK_GT(corner_skip, 1);
+    const Eigen::Matrix3Xd corner_points_C =
+        T_G_C_observation.inverse().transformVectorized(april_grid->points());
+    Eigen::Matrix2Xd corners;
+    std::vector<aslam::ProjectionResult> projection_results;
+    camera->project3Vectorized(corner_points_C, &corners, &projection_results);
+    std::normal_distribution<> normal_distribution(0.0, 0.5);
+    Eigen::VectorXi corner_ids(corners.cols());
+    Eigen::Matrix2Xd observed_corners(2, corners.cols());
+    int num_observed_corners = 0;
+    for (int index = 0; index < corners.cols(); ++index) {
+      if (index % corner_skip == 0 || !projection_results[index]) {
+        continue;
+      }
+      corner_ids(num_observed_corners) = index;
+      observed_corners.col(num_observed_corners) =
+          corners.col(index) + Eigen::Vector2d(normal_distribution(*random_generator),
+                                               normal_distribution(*random_generator));
+      ++num_observed_corners;
+    }
+    corner_ids.conservativeResize(num_observed_corners);
+    observed_corners.conservativeResize(Eigen::NoChange, num_observed_corners);
+    return aslam::calibration::TargetObservation::Ptr(
+        new aslam::calibration::TargetObservation(
+            april_grid, camera->imageHeight(), camera->imageWidth(), corner_ids,
+            observed_corners));
+  }
+
   aslam::calibration::TargetBase::Ptr april_grid;
   aslam::Camera::ConstPtr camera;
   aslam::Transformation T_G_C;
@@ -143,4 +184,163 @@ TEST_F(TargetObservationTest, AprilGridPoseEstimation) {
           << angle_error_rad;
 }
 
+TEST_F(TargetObservationTest, AprilGridBatchPoseEstimation) {
+  constexpr double kTolerancePositionMeters = 0.03;
+  constexpr double kToleranceRotationRad = 0.03;
+  constexpr size_t kNumObservations = 20u;
+  // A camera moving along the target, with different corners observed in every observation,
+  // such that results that are mixed up between observations or chunks are detected.
+  std::mt19937 random_generator(42);
+  aslam::TransformationVector T_G_C_observations;
+  std::vector<aslam::calibration::TargetObservation::Ptr> observations;
+  for (size_t obs_idx = 0u; obs_idx < kNumObservations; ++obs_idx) {
+    const double progress = static_cast<double>(obs_idx) / (kNumObservations - 1u) - 0.5;
+    const aslam::Quaternion q_C_C0(aslam::AngleAxis(0.1 * progress, Eigen::Vector3d::UnitZ()));
+    const aslam::Transformation T_C0_C(q_C_C0.inverse(),
+                                       aslam::Position3D(0.1 * progress, 0.05 * progress,
+                                                         -0.1 * progress));
+    T_G_C_observations.push_back(T_G_C * T_C0_C);
+    observations.push_back(createObservation(T_G_C_observations.back(),
+                                             2 + static_cast<int>(obs_idx % 3u),
+                                             &random_generator));
+  }
+
+  for (const bool seed_from_previous_observation : {false, true}) {
+    aslam::calibration::TargetTransformationBatchOptions options;
+    options.num_threads = 4u;
+    options.seed_from_previous_observation = seed_from_previous_observation;
+    aslam::TransformationVector T_G_Cs;
+    std::vector<bool> successes;
+    EXPECT_EQ(kNumObservations, aslam::calibration::estimateTargetTransformations(
+        observations, camera, options, &T_G_Cs, &successes));
+    ASSERT_EQ(kNumObservations, T_G_Cs.size());
+    ASSERT_EQ(kNumObservations, successes.size());
+    for (size_t obs_idx = 0u; obs_idx < kNumObservations; ++obs_idx) {
+      EXPECT_TRUE(successes[obs_idx]);
+      const aslam::Transformation T_C_Cest =
+          T_G_C_observations[obs_idx].inverse() * T_G_Cs[obs_idx];
+      EXPECT_LT(T_C_Cest.getPosition().norm(), kTolerancePositionMeters)
+          << "Observation " << obs_idx;
+      EXPECT_LT(aslam::AngleAxis(T_C_Cest.getRotation()).angle(), kToleranceRotationRad)
+          << "Observation " << obs_idx;
+
+      // The batch estimates equal the single observation estimates.
+      aslam::Transformation T_G_C_single;
+      ASSERT_TRUE(aslam::calibration::estimateTargetTransformation(
+          *observations[obs_idx], camera, &T_G_C_single));
+      EXPECT_LT((T_G_C_single.inverse() * T_G_Cs[obs_idx]).getPosition().norm(),
+                kTolerancePositionMeters) << "Observation " << obs_idx;
+    }
+  }
+}
+
+TEST_F(TargetObservationTest, CornerIndex) {
+  // Every other corner, in reverse order.
+  const Eigen::Matrix2Xd& all_corners = april_grid_observation->getObservedCorners();
+  const int num_corners = static_cast<int>(april_grid->size()) / 2;
+  Eigen::VectorXi corner_ids(num_corners);
+  Eigen::Matrix2Xd corners(2, num_corners);
+  for (int i = 0; i < num_corners; ++i) {
+    corner_ids(i) = 2 * (num_corners - 1 - i);
+    corners.col(i) = all_corners.col(corner_ids(i));
+  }
+  const aslam::calibration::TargetObservation observation(
+      april_grid, camera->imageHeight(), camera->imageWidth(), corner_ids, corners);
+
+  aslam::calibration::TargetObservationPool pool(april_grid);
+  ASSERT_EQ(0u, pool.add(*april_grid_observation));
+  ASSERT_EQ(1u, pool.add(observation));
+  EXPECT_TRUE(pool.allCornersObservered(0u));
+  EXPECT_FALSE(pool.allCornersObservered(1u));
+  EXPECT_EQ(static_cast<size_t>(num_corners), pool.numObservedCorners(1u));
+  EXPECT_EQ(camera->imageWidth(), pool.getImageWidth(1u));
+  EXPECT_EQ(camera->imageHeight(), pool.getImageHeight(1u));
+
+  for (size_t corner_id = 0u; corner_id < april_grid->size(); ++corner_id) {
+    const bool observed = corner_id % 2u == 0u;
+    EXPECT_EQ(observed, observation.observedCornerId(corner_id));
+    EXPECT_EQ(observed, pool.observedCornerId(1u, corner_id));
+    Eigen::Vector2d corner, pooled_corner;
+    EXPECT_EQ(observed, observation.getObservedCornerById(corner_id, &corner));
+    EXPECT_EQ(observed, pool.getObservedCornerById(1u, corner_id, &pooled_corner));
+    if (observed) {
+      EXPECT_EQ(all_corners.col(corner_id), corner);
+      EXPECT_EQ(all_corners.col(corner_id), pooled_corner);
+    }
+  }
+
+  // The pooled corners are sorted by id.
+  const aslam::calibration::TargetObservation::Ptr copy = pool.getObservation(1u);
+  ASSERT_EQ(static_cast<size_t>(num_corners), copy->numObservedCorners());
+  for (int i = 0; i < num_corners; ++i) {
+    EXPECT_EQ(2 * i, copy->getObservedCornerIds()(i));
+    EXPECT_EQ(all_corners.col(2 * i), copy->getObservedCorner(i));
+  }
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(
+      april_grid_observation->getObservedCorners(), pool.getObservedCorners(0u)));
+}
+
+TEST_F(TargetObservationTest, ObservationStore) {
+  char store_path[] = "/tmp/test-target-observation-store-XXXXXX";
+  const int file_descriptor = mkstemp(store_path);
+  ASSERT_GE(file_descriptor, 0);
+  ::close(file_descriptor);
+  const std::string kStorePath = store_path;
+  const Eigen::Matrix2Xd& all_corners = april_grid_observation->getObservedCorners();
+  Eigen::VectorXi corner_ids(3);
+  corner_ids << 7, 2, 5;
+  Eigen::Matrix2Xd corners(2, 3);
+  corners << all_corners.col(7), all_corners.col(2), all_corners.col(5);
+  const aslam::calibration::TargetObservation partial_observation(
+      april_grid, camera->imageHeight(), camera->imageWidth(), corner_ids, corners);
+
+  aslam::calibration::TargetObservationStoreWriter writer;
+  ASSERT_TRUE(writer.open(kStorePath, *april_grid));
+  // Out of order, the store is indexed by camera and timestamp.
+  ASSERT_TRUE(writer.append(1u, 200, *april_grid_observation));
+  ASSERT_TRUE(writer.append(0u, 300, partial_observation));
+  aslam::calibration::TargetObservationStoreWriter::ObservationCallback callback =
+      writer.getAppendCallback(0u, [](size_t image_index) {
+    return static_cast<int64_t>(100 * image_index);
+  });
+  EXPECT_TRUE(callback(1u, aslam::calibration::TargetObservation::Ptr()));
+  EXPECT_TRUE(callback(2u, aslam::calibration::TargetObservation::Ptr(
+      new aslam::calibration::TargetObservation(
+          april_grid, camera->imageHeight(), camera->imageWidth(),
+          april_grid_observation->getObservedCornerIds(), all_corners))));
+  EXPECT_EQ(3u, writer.getNumObservations());
+  ASSERT_TRUE(writer.close());
+
+  aslam::calibration::TargetObservationStore store;
+  ASSERT_TRUE(store.open(kStorePath, april_grid));
+  ASSERT_EQ(3u, store.getNumObservations());
+  EXPECT_EQ(0u, store.getCameraIndex(0u));
+  EXPECT_EQ(200, store.getTimestampNanoseconds(0u));
+  EXPECT_EQ(0u, store.getCameraIndex(1u));
+  EXPECT_EQ(300, store.getTimestampNanoseconds(1u));
+  EXPECT_EQ(1u, store.getCameraIndex(2u));
+  EXPECT_EQ(200, store.getTimestampNanoseconds(2u));
+
+  size_t index = 0u;
+  ASSERT_TRUE(store.findObservation(0u, 300, &index));
+  EXPECT_EQ(1u, index);
+  EXPECT_FALSE(store.findObservation(1u, 300, &index));
+  size_t begin = 0u, end = 0u;
+  store.getObservationsOfCamera(0u, &begin, &end);
+  EXPECT_EQ(0u, begin);
+  EXPECT_EQ(2u, end);
+  store.getObservationsOfCamera(2u, &begin, &end);
+  EXPECT_EQ(begin, end);
+
+  EXPECT_EQ(camera->imageWidth(), store.getImageWidth(1u));
+  EXPECT_EQ(camera->imageHeight(), store.getImageHeight(1u));
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(corners, store.getObservedCorners(1u)));
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(corner_ids, store.getObservedCornerIds(1u)));
+  const aslam::calibration::TargetObservation::Ptr observation = store.getObservation(2u);
+  ASSERT_TRUE(observation->allCornersObservered());
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(all_corners, observation->getObservedCorners()));
+  store.close();
+  std::remove(kStorePath.c_str());
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,98 @@
+#ifndef ASLAM_CAMERAS_BEARING_VECTOR_LOOKUP_TABLE_H_
+#define ASLAM_CAMERAS_BEARING_VECTOR_LOOKUP_TABLE_H_
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/common/macros.h>
+
+namespace aslam {
+
+/// \class BearingVectorLookupTable
+/// \brief Precomputed back-projection of a camera on a regular grid of image coordinates.
+///
+/// The grid vertices are back-projected once with the exact (iterative) camera functions and
+/// stored as packed floats. A query interpolates the bearing vectors of the four surrounding
+/// vertices bilinearly, which replaces the iterative undistortion per keypoint by a few
+/// multiplications. The bearing vectors have the scale of Camera::backProject3, e.g. z = 1 for
+/// pinhole cameras, such that the table is a drop-in replacement.
+///
+/// Keypoints outside of the image and keypoints in cells with a vertex that could not be
+/// back-projected, e.g. at the border of the field of view of a unified projection camera, fall
+/// back to the exact camera functions.
+///
+/// The interpolation error is measured against the exact path at the center of every cell when
+/// the table is built, see getMaxAngularError. It shrinks quadratically with the cell size.
+class BearingVectorLookupTable {
+ public:
+  ASLAM_POINTER_TYPEDEFS(BearingVectorLookupTable);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(BearingVectorLookupTable);
+
+  /// @param[in] camera       Camera to back-project, it must not change while the table is used.
+  /// @param[in] cell_size_px Distance of the grid vertices in pixels, e.g. 0.5 for two vertices
+  ///                         per pixel.
+  /// @param[in] num_threads  Number of threads building the table, 0 uses all hardware threads.
+  BearingVectorLookupTable(const Camera::ConstPtr& camera, double cell_size_px,
+                           size_t num_threads);
+
+  /// \brief Restores a table written by serializeToBinary, which is much faster than building
+  ///        it. The table has to be built for the same camera geometry.
+  /// @return A nullptr if the payload is invalid or belongs to a different camera.
+  static BearingVectorLookupTable::Ptr deserializeFromBinary(
+      const Camera::ConstPtr& camera, const char* data, size_t size_bytes);
+
+  /// Encode the table, e.g. to bundle it with the rig in a binary calibration file.
+  void serializeToBinary(std::vector<char>* payload) const;
+
+  /// \brief Back-projects a keypoint, see Camera::backProject3.
+  bool backProject3(const Eigen::Ref<const Eigen::Vector2d>& keypoint,
+                    Eigen::Vector3d* out_point_3d) const;
+
+  /// \brief Back-projects all keypoints, see Camera::backProject3Vectorized. The keypoints
+  ///        without table entry are back-projected in one call to the camera.
+  void backProject3Vectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints,
+                              Eigen::Matrix3Xd* out_points_3d,
+                              std::vector<unsigned char>* out_success) const;
+
+  /// Max. angle in radians between the interpolated and the exact bearing vectors at the cell
+  /// centers.
+  double getMaxAngularError() const { return max_angular_error_; }
+  double getCellSize() const { return cell_size_px_; }
+  /// Size of the stored bearing vectors in bytes.
+  size_t getNumBytes() const { return bearing_vectors_.size() * sizeof(float); }
+  /// Was the table built for the current calibration of the camera, see
+  /// Camera::getParameterVersion.
+  bool isUpToDate() const { return camera_->getParameterVersion() == camera_version_; }
+
+ private:
+  /// Allocates the table without filling it.
+  BearingVectorLookupTable(const Camera::ConstPtr& camera, double cell_size_px);
+
+  /// Back-projects the grid vertices of the rows [row_begin, row_end).
+  void buildRows(int row_begin, int row_end);
+
+  /// Max. angular error at the centers of the cells of the rows [row_begin, row_end).
+  double computeMaxAngularError(int row_begin, int row_end) const;
+
+  /// Interpolates the bearing vector, returns false if the keypoint has no table entry.
+  inline bool interpolate(double u, double v, Eigen::Vector3d* out_point_3d) const;
+
+  const Camera::ConstPtr camera_;
+  /// The parameter version of the camera the table was built for.
+  const ParameterVersion camera_version_;
+  const double cell_size_px_;
+  const double inverse_cell_size_;
+  int num_cols_;
+  int num_rows_;
+
+  /// x, y and z of the bearing vectors of the vertices, row-major. The x coordinate of vertices
+  /// which could not be back-projected is NaN.
+  std::vector<float> bearing_vectors_;
+  double max_angular_error_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_CAMERAS_BEARING_VECTOR_LOOKUP_TABLE_H_
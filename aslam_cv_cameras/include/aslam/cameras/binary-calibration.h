@@ -0,0 +1,239 @@
+#ifndef ASLAM_CAMERAS_BINARY_CALIBRATION_H_
+#define ASLAM_CAMERAS_BINARY_CALIBRATION_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/mapped-file.h>
+
+namespace aslam {
+namespace binary_calibration {
+
+/// "ACVC" in little endian.
+constexpr uint32_t kFileMagic = 0x43564341u;
+/// Increment whenever the layout of the header or of a section payload changes.
+constexpr uint16_t kFormatVersion = 1u;
+/// Section payloads start at multiples of this, such that mapped data can be read in place.
+constexpr size_t kAlignmentBytes = 64u;
+
+/// Tags of the sections known to aslam_cv. The index of a section tells sections with the
+/// same tag apart, e.g. the camera index of a lookup table.
+enum SectionTag : uint32_t {
+  kNCameraSection = 1u,
+  kBearingVectorLookupTableSection = 2u,
+  kUndistortionMapSection = 3u,
+  /// Tags from here on are free for users.
+  kFirstUserSection = 1024u
+};
+
+struct FileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size_bytes;
+  uint32_t num_sections;
+  uint32_t reserved_0;
+  /// Size of the whole file including this header.
+  uint64_t total_size_bytes;
+  /// FNV-1a hash of all bytes behind the header.
+  uint64_t checksum;
+  uint64_t reserved_1[4];
+};
+static_assert(sizeof(FileHeader) == 64u, "Unexpected binary calibration header size.");
+
+/// The section table directly follows the file header.
+struct SectionEntry {
+  uint32_t tag;
+  uint32_t index;
+  /// Offset of the payload from the beginning of the file.
+  uint64_t offset_bytes;
+  uint64_t size_bytes;
+  uint64_t reserved;
+};
+static_assert(sizeof(SectionEntry) == 32u, "Unexpected binary calibration section size.");
+
+inline size_t alignSize(size_t size_bytes) {
+  return (size_bytes + kAlignmentBytes - 1u) / kAlignmentBytes * kAlignmentBytes;
+}
+
+/// 64bit FNV-1a, stable across builds and platforms.
+uint64_t computeChecksum(const char* data, size_t size_bytes);
+
+/// \class PayloadWriter
+/// \brief Appends plain values to the payload of a section.
+class PayloadWriter {
+ public:
+  explicit PayloadWriter(std::vector<char>* payload) : payload_(CHECK_NOTNULL(payload)) {}
+
+  void writeBytes(const void* data, size_t size_bytes) {
+    const char* bytes = static_cast<const char*>(data);
+    payload_->insert(payload_->end(), bytes, bytes + size_bytes);
+  }
+
+  template <typename Type>
+  void write(const Type& value) {
+    static_assert(std::is_pod<Type>::value, "Only plain values can be written.");
+    writeBytes(&value, sizeof(Type));
+  }
+
+  void writeString(const std::string& value) {
+    write(static_cast<uint64_t>(value.size()));
+    writeBytes(value.data(), value.size());
+  }
+
+  void writeVector(const Eigen::VectorXd& vector) {
+    write(static_cast<uint64_t>(vector.size()));
+    writeBytes(vector.data(), vector.size() * sizeof(double));
+  }
+
+ private:
+  std::vector<char>* const payload_;
+};
+
+/// \class PayloadReader
+/// \brief Reads the values written by a PayloadWriter. All reads are bounds checked and return
+///        false if the payload is too short, corrupted payloads never crash.
+class PayloadReader {
+ public:
+  PayloadReader(const char* data, size_t size_bytes)
+      : data_(data), size_bytes_(size_bytes), position_(0u) {
+    CHECK(data_ != nullptr || size_bytes_ == 0u);
+  }
+
+  /// Returns a pointer to the next size_bytes bytes and skips them, nullptr if the payload is
+  /// too short.
+  const char* readView(size_t size_bytes) {
+    if (size_bytes > getNumRemainingBytes()) {
+      return nullptr;
+    }
+    const char* view = data_ + position_;
+    position_ += size_bytes;
+    return view;
+  }
+
+  bool readBytes(void* data, size_t size_bytes) {
+    const char* view = readView(size_bytes);
+    if (view == nullptr) {
+      return false;
+    }
+    std::memcpy(data, view, size_bytes);
+    return true;
+  }
+
+  template <typename Type>
+  bool read(Type* value) {
+    static_assert(std::is_pod<Type>::value, "Only plain values can be read.");
+    return readBytes(CHECK_NOTNULL(value), sizeof(Type));
+  }
+
+  bool readString(std::string* value) {
+    CHECK_NOTNULL(value);
+    uint64_t size = 0u;
+    if (!read(&size) || size > getNumRemainingBytes()) {
+      return false;
+    }
+    value->assign(readView(size), size);
+    return true;
+  }
+
+  bool readVector(Eigen::VectorXd* vector) {
+    CHECK_NOTNULL(vector);
+    uint64_t size = 0u;
+    if (!read(&size) || size > getNumRemainingBytes() / sizeof(double)) {
+      return false;
+    }
+    vector->resize(size);
+    return readBytes(vector->data(), size * sizeof(double));
+  }
+
+  size_t getNumRemainingBytes() const { return size_bytes_ - position_; }
+
+ private:
+  const char* const data_;
+  const size_t size_bytes_;
+  size_t position_;
+};
+
+}  // namespace binary_calibration
+
+/// \class BinaryCalibrationWriter
+/// \brief Bundles the payloads of several calibration objects in one binary file.
+///
+/// The file starts with a FileHeader and a table of SectionEntry, followed by the payloads at
+/// aligned offsets. A checksum over everything behind the header detects truncated and
+/// corrupted files.
+class BinaryCalibrationWriter {
+ public:
+  ASLAM_POINTER_TYPEDEFS(BinaryCalibrationWriter);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(BinaryCalibrationWriter);
+
+  BinaryCalibrationWriter() = default;
+
+  /// Adds a section, the pair of tag and index has to be unique.
+  void addSection(uint32_t tag, uint32_t index, std::vector<char>&& payload);
+
+  /// Writes the file into the buffer.
+  void writeToBuffer(std::vector<char>* buffer) const;
+
+  /// \brief Writes the file. A temporary file is renamed to the final path, readers never see
+  ///        partially written files.
+  /// @return False if the file could not be written.
+  bool writeToFile(const std::string& file_path) const;
+
+ private:
+  struct Section {
+    uint32_t tag;
+    uint32_t index;
+    std::vector<char> payload;
+  };
+  std::vector<Section> sections_;
+};
+
+/// \class BinaryCalibrationReader
+/// \brief Provides the sections of a binary calibration file, see BinaryCalibrationWriter.
+///
+/// Files are memory mapped, the section data stays valid as long as the reader lives.
+class BinaryCalibrationReader {
+ public:
+  ASLAM_POINTER_TYPEDEFS(BinaryCalibrationReader);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(BinaryCalibrationReader);
+
+  BinaryCalibrationReader();
+  ~BinaryCalibrationReader();
+
+  /// \brief Maps and validates the file.
+  /// @return False if the file can't be read or is not a valid calibration file.
+  bool openFile(const std::string& file_path);
+
+  /// \brief Validates a file in memory, the buffer has to outlive the reader.
+  /// @return False if the buffer doesn't hold a valid calibration file.
+  bool openBuffer(const char* data, size_t size_bytes);
+
+  bool hasSection(uint32_t tag, uint32_t index) const;
+
+  /// \brief Gets the payload of a section.
+  /// @return False if there is no such section.
+  bool getSection(uint32_t tag, uint32_t index, const char** data, size_t* size_bytes) const;
+
+  /// Number of sections with the tag.
+  size_t getNumSections(uint32_t tag) const;
+
+ private:
+  void close();
+
+  const char* data_;
+  size_t size_bytes_;
+  /// Open if data_ points into a memory mapping owned by the reader.
+  common::MappedFile mapped_file_;
+  std::vector<binary_calibration::SectionEntry> sections_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_CAMERAS_BINARY_CALIBRATION_H_
@@ -38,6 +38,34 @@ bool Camera::isKeypointVisibleWithMargin(
       && keypoint[1] < (static_cast<Scalar>(imageHeight()) - margin);
 }
 
+template <>
+inline void Camera::project3VectorizedWithScalar<double>(
+    const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d, Eigen::Matrix2Xd* out_keypoints,
+    std::vector<ProjectionResult>* out_results) const {
+  project3Vectorized(points_3d, out_keypoints, out_results);
+}
+
+template <>
+inline void Camera::project3VectorizedWithScalar<float>(
+    const Eigen::Ref<const Eigen::Matrix3Xf>& points_3d, Eigen::Matrix2Xf* out_keypoints,
+    std::vector<ProjectionResult>* out_results) const {
+  project3VectorizedFloat(points_3d, out_keypoints, out_results);
+}
+
+template <>
+inline void Camera::backProject3VectorizedWithScalar<double>(
+    const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints, Eigen::Matrix3Xd* out_points_3d,
+    std::vector<unsigned char>* out_success) const {
+  backProject3Vectorized(keypoints, out_points_3d, out_success);
+}
+
+template <>
+inline void Camera::backProject3VectorizedWithScalar<float>(
+    const Eigen::Ref<const Eigen::Matrix2Xf>& keypoints, Eigen::Matrix3Xf* out_points_3d,
+    std::vector<unsigned char>* out_success) const {
+  backProject3VectorizedFloat(keypoints, out_points_3d, out_success);
+}
+
 inline std::ostream& operator<<(std::ostream& out, const Camera::Type& value) {
   static std::map<Camera::Type, std::string> names;
   if (names.size() == 0) {
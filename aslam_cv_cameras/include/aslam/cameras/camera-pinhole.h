@@ -11,6 +11,8 @@ namespace aslam {
 
 // Forward declarations.
 class MappedUndistorter;
+template <typename CameraType, typename DistortionType>
+class ProjectionKernel;
 
 /// \class PinholeCamera
 /// \brief An implementation of the pinhole camera model with (optional) distortion.
@@ -116,6 +118,47 @@ class PinholeCamera : public aslam::Cloneable<Camera, PinholeCamera> {
   virtual bool backProject3(const Eigen::Ref<const Eigen::Vector2d>& keypoint,
                             Eigen::Vector3d* out_point_3d) const;
 
+  /// \brief Back-projects all keypoints at once. Undistorts the whole block through
+  ///        Distortion::undistortVectorized instead of one virtual call per keypoint.
+  /// @param[in]  keypoints     Keypoints in image coordinates.
+  /// @param[out] out_points_3d Bearing vectors in euclidean coordinates with z=1.
+  /// @param[out] out_success   Were the projections successful? Always true for this model.
+  virtual void backProject3Vectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints,
+                                      Eigen::Matrix3Xd* out_points_3d,
+                                      std::vector<unsigned char>* out_success) const;
+
+  /// \brief Projects all points at once. Distorts the whole block through
+  ///        Distortion::distortVectorized instead of one virtual call per point.
+  /// @param[in]  points_3d     The points in euclidean coordinates.
+  /// @param[out] out_keypoints The keypoints in image coordinates.
+  /// @param[out] out_results   The projection result of every point.
+  virtual void project3Vectorized(const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d,
+                                  Eigen::Matrix2Xd* out_keypoints,
+                                  std::vector<ProjectionResult>* out_results) const;
+
+  /// \brief Projects all points at once and computes the Jacobians on arrays, see
+  ///        Camera::project3VectorizedWithJacobians.
+  virtual void project3VectorizedWithJacobians(
+      const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d, Eigen::Matrix2Xd* out_keypoints,
+      Eigen::Matrix<double, 6, Eigen::Dynamic>* out_jacobians_point,
+      Eigen::MatrixXd* out_jacobians_intrinsics,
+      std::vector<ProjectionResult>* out_results) const;
+
+  /// \brief Projects all points into caller-provided buffers, see Camera::project3Batch. Uses
+  ///        the allocation-free ProjectionKernel if there is one for the distortion type.
+  virtual void project3Batch(const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d,
+                             const ProjectionJacobianBuffers& buffers) const;
+
+  /// \brief Single-precision version of project3Vectorized.
+  virtual void project3VectorizedFloat(const Eigen::Ref<const Eigen::Matrix3Xf>& points_3d,
+                                       Eigen::Matrix2Xf* out_keypoints,
+                                       std::vector<ProjectionResult>* out_results) const;
+
+  /// \brief Single-precision version of backProject3Vectorized.
+  virtual void backProject3VectorizedFloat(const Eigen::Ref<const Eigen::Matrix2Xf>& keypoints,
+                                           Eigen::Matrix3Xf* out_points_3d,
+                                           std::vector<unsigned char>* out_success) const;
+
   /// \brief Checks the success of a projection operation and returns the result in a
   ///        ProjectionResult object.
   /// @param[in] keypoint Keypoint in image coordinates.
@@ -267,6 +310,10 @@ class PinholeCamera : public aslam::Cloneable<Camera, PinholeCamera> {
   /// @}
 
  private:
+  /// The projection kernels evaluate the projection result like this camera.
+  template <typename CameraType, typename DistortionType>
+  friend class ProjectionKernel;
+
   /// \brief Minimal depth for a valid projection.
   static const double kMinimumDepth;
 };
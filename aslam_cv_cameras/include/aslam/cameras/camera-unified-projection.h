@@ -121,6 +121,32 @@ class UnifiedProjectionCamera : public aslam::Cloneable<Camera, UnifiedProjectio
   virtual bool backProject3(const Eigen::Ref<const Eigen::Vector2d>& keypoint,
                             Eigen::Vector3d* out_point_3d) const;
 
+  /// \brief Back-projects all keypoints at once. Undistorts the whole block through
+  ///        Distortion::undistortVectorized and lifts the keypoints on arrays.
+  /// @param[in]  keypoints     Keypoints in image coordinates.
+  /// @param[out] out_points_3d Bearing vectors in euclidean coordinates, see backProject3.
+  /// @param[out] out_success   Were the keypoints liftable to the unit sphere?
+  virtual void backProject3Vectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints,
+                                      Eigen::Matrix3Xd* out_points_3d,
+                                      std::vector<unsigned char>* out_success) const;
+
+  /// \brief Projects all points at once. Distorts the whole block through
+  ///        Distortion::distortVectorized instead of one virtual call per point.
+  /// @param[in]  points_3d     The points in euclidean coordinates.
+  /// @param[out] out_keypoints The keypoints in image coordinates.
+  /// @param[out] out_results   The projection result of every point.
+  virtual void project3Vectorized(const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d,
+                                  Eigen::Matrix2Xd* out_keypoints,
+                                  std::vector<ProjectionResult>* out_results) const;
+
+  /// \brief Projects all points at once and computes the Jacobians on arrays, see
+  ///        Camera::project3VectorizedWithJacobians.
+  virtual void project3VectorizedWithJacobians(
+      const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d, Eigen::Matrix2Xd* out_keypoints,
+      Eigen::Matrix<double, 6, Eigen::Dynamic>* out_jacobians_point,
+      Eigen::MatrixXd* out_jacobians_intrinsics,
+      std::vector<ProjectionResult>* out_results) const;
+
   /// \brief Checks the success of a projection operation and returns the result in a
   ///        ProjectionResult object.
   /// @param[in] keypoint Keypoint in image coordinates.
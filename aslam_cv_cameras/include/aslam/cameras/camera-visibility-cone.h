@@ -0,0 +1,96 @@
+#ifndef ASLAM_CAMERA_VISIBILITY_CONE_H_
+#define ASLAM_CAMERA_VISIBILITY_CONE_H_
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <aslam/common/pose-types.h>
+
+namespace aslam {
+class Camera;
+
+/// \class CameraVisibilityCone
+/// \brief Conservative visibility pre-filter of a camera: a cone around the viewing direction
+///        that contains the bearing vectors of all (unmasked) pixels.
+///
+/// Points outside the cone can not project into the image, hence landmark batches can be culled
+/// with one dot product per point before the full (distorted) projection. Points inside the
+/// cone may still project outside the image, as the cone is round and the image is not.
+///
+/// The cone is computed once from the camera model by back-projecting the border of the image,
+/// or of the bounding box of the unmasked pixels. The apex is the camera center, which is
+/// exact for central cameras.
+class CameraVisibilityCone {
+ public:
+  /// Keypoints sampled along every border of the image.
+  static constexpr int kNumBorderSamples = 32;
+
+  /// Cone of all bearing vectors, which does not cull any point.
+  CameraVisibilityCone();
+  /// @param[in] axis_C      Unit axis of the cone in the camera frame.
+  /// @param[in] half_angle  Half opening angle in radians, culls nothing if >= pi.
+  CameraVisibilityCone(const Eigen::Vector3d& axis_C, double half_angle);
+  /// The cone of the camera, based on its intrinsics, distortion and mask.
+  explicit CameraVisibilityCone(const Camera& camera);
+
+  const Eigen::Vector3d& getAxis() const { return axis_C_; }
+  double getHalfAngle() const { return half_angle_; }
+
+  /// Can the point in the camera frame be visible.
+  bool mayBeVisible(const Eigen::Vector3d& point_C) const;
+
+  /// \brief Vectorized visibility test of points in the camera frame.
+  /// @param[in]  points_C           The points in the camera frame.
+  /// @param[out] out_may_be_visible Is point i inside the cone.
+  void mayBeVisibleVectorized(const Eigen::Ref<const Eigen::Matrix3Xd>& points_C,
+                              std::vector<unsigned char>* out_may_be_visible) const;
+
+  /// \brief Indices of the points in frame G that are inside the cone of the camera at T_C_G.
+  ///
+  /// The cone is transformed into frame G once instead of transforming every point.
+  void getCandidates(const Eigen::Ref<const Eigen::Matrix3Xd>& points_G,
+                     const Transformation& T_C_G, std::vector<int>* candidate_indices) const;
+
+  /// Does a sphere in the camera frame intersect the cone.
+  bool intersectsSphere(const Eigen::Vector3d& center_C, double radius) const;
+
+ private:
+  Eigen::Vector3d axis_C_;
+  double half_angle_;
+  double cos_half_angle_;
+};
+
+/// \class LandmarkSpatialHash
+/// \brief Buckets landmarks into a uniform voxel grid, such that whole cells outside the
+///        visibility cone of a camera are culled without testing their landmarks.
+///
+/// Built once per landmark set, e.g. the map around the current position, and queried for
+/// every camera and frame.
+class LandmarkSpatialHash {
+ public:
+  /// @param[in] points_G  The landmark positions, the indices of the queries are their columns.
+  /// @param[in] cell_size Edge length of the cubic cells in meters.
+  LandmarkSpatialHash(const Eigen::Ref<const Eigen::Matrix3Xd>& points_G, double cell_size);
+
+  /// \brief Indices of the landmarks inside the cone of the camera at T_C_G. The landmarks of
+  ///        cells intersecting the cone are tested individually. Sorted by cell.
+  void getCandidates(const CameraVisibilityCone& cone, const Transformation& T_C_G,
+                     std::vector<int>* candidate_indices) const;
+
+  size_t getNumLandmarks() const { return points_G_.cols(); }
+  size_t getNumCells() const { return cell_centers_G_.cols(); }
+  double getCellSize() const { return cell_size_; }
+
+ private:
+  const double cell_size_;
+  Eigen::Matrix3Xd points_G_;
+  Eigen::Matrix3Xd cell_centers_G_;
+  /// The landmarks of cell c are sorted_indices_[cell_begin_[c], cell_begin_[c + 1]).
+  std::vector<int> cell_begin_;
+  std::vector<int> sorted_indices_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_CAMERA_VISIBILITY_CONE_H_
@@ -0,0 +1,64 @@
+#ifndef ASLAM_CAMERAS_CAMERA_VISITOR_INL_H_
+#define ASLAM_CAMERAS_CAMERA_VISITOR_INL_H_
+
+namespace aslam {
+namespace internal {
+
+/// Binds the typed camera to the functor, such that visitDistortion can add the distortion.
+template <typename CameraType, typename Functor>
+struct TypedCameraVisitor {
+  template <typename DistortionType>
+  void operator()(const DistortionType& distortion) {
+    (*functor)(camera, distortion);
+  }
+
+  const CameraType& camera;
+  Functor* functor;
+};
+
+template <typename CameraType, typename Functor>
+void visitTypedCamera(const Camera& camera, Functor* functor) {
+  TypedCameraVisitor<CameraType, Functor> visitor{static_cast<const CameraType&>(camera),
+                                                  functor};
+  visitDistortion(camera.getDistortion(), &visitor);
+}
+
+}  // namespace internal
+
+template <typename Functor>
+void visitCamera(const Camera& camera, Functor* functor) {
+  CHECK_NOTNULL(functor);
+  switch (camera.getType()) {
+    case Camera::Type::kPinhole:
+      internal::visitTypedCamera<PinholeCamera>(camera, functor);
+      return;
+    case Camera::Type::kUnifiedProjection:
+      internal::visitTypedCamera<UnifiedProjectionCamera>(camera, functor);
+      return;
+  }
+  LOG(FATAL) << "Unknown camera type " << camera.getType() << ".";
+}
+
+template <typename Functor>
+void visitDistortion(const Distortion& distortion, Functor* functor) {
+  CHECK_NOTNULL(functor);
+  switch (distortion.getType()) {
+    case Distortion::Type::kNoDistortion:
+      (*functor)(static_cast<const NullDistortion&>(distortion));
+      return;
+    case Distortion::Type::kEquidistant:
+      (*functor)(static_cast<const EquidistantDistortion&>(distortion));
+      return;
+    case Distortion::Type::kFisheye:
+      (*functor)(static_cast<const FisheyeDistortion&>(distortion));
+      return;
+    case Distortion::Type::kRadTan:
+      (*functor)(static_cast<const RadTanDistortion&>(distortion));
+      return;
+  }
+  LOG(FATAL) << "Unknown distortion type " << distortion.getType() << ".";
+}
+
+}  // namespace aslam
+
+#endif  // ASLAM_CAMERAS_CAMERA_VISITOR_INL_H_
@@ -0,0 +1,42 @@
+#ifndef ASLAM_CAMERAS_CAMERA_VISITOR_H_
+#define ASLAM_CAMERAS_CAMERA_VISITOR_H_
+
+#include <glog/logging.h>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/camera-unified-projection.h>
+#include <aslam/cameras/distortion.h>
+#include <aslam/cameras/distortion-equidistant.h>
+#include <aslam/cameras/distortion-fisheye.h>
+#include <aslam/cameras/distortion-null.h>
+#include <aslam/cameras/distortion-radtan.h>
+
+namespace aslam {
+
+/// \brief Calls (*functor)(typed_camera, typed_distortion) with the camera and its distortion
+///        cast to their concrete types, e.g. const PinholeCamera& and const RadTanDistortion&.
+///
+/// The types are switched on once per call, hence a loop inside the functor is instantiated
+/// for every camera and distortion model and the calls of the concrete classes can be inlined
+/// instead of going through the virtual interface for every point. The functor needs a
+/// templated call operator for all combinations:
+///
+///    struct Projector {
+///      template <typename CameraType, typename DistortionType>
+///      void operator()(const CameraType& camera, const DistortionType& distortion) {
+///        // Loop over the points.
+///      }
+///    };
+template <typename Functor>
+void visitCamera(const Camera& camera, Functor* functor);
+
+/// \brief Calls (*functor)(typed_distortion) with the distortion cast to its concrete type.
+template <typename Functor>
+void visitDistortion(const Distortion& distortion, Functor* functor);
+
+}  // namespace aslam
+
+#include "aslam/cameras/camera-visitor-inl.h"
+
+#endif  // ASLAM_CAMERAS_CAMERA_VISITOR_H_
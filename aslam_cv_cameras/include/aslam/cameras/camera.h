@@ -1,6 +1,7 @@
 #ifndef ASLAM_CAMERAS_CAMERA_H_
 #define ASLAM_CAMERAS_CAMERA_H_
 
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 #include <memory>
@@ -11,6 +12,7 @@
 #include <glog/logging.h>
 
 #include <aslam/common/macros.h>
+#include <aslam/common/parameter-version.h>
 #include <aslam/common/types.h>
 #include <aslam/common/unique-id.h>
 #include <aslam/cameras/distortion.h>
@@ -88,6 +90,23 @@ struct ProjectionResult {
   Status status_;
 };
 
+/// \struct ProjectionJacobianBuffers
+/// \brief Caller-owned output buffers of Camera::project3Batch. The buffers are preallocated for
+///        all points and have a fixed stride per point, the data of point i starts at:
+///          keypoints + 2 * i                (u, v)
+///          jacobians_point + 6 * i          (column-major 2x3)
+///          jacobians_intrinsics + 2 * N * i (column-major 2xN, N = Camera::getParameterSize())
+///          jacobians_distortion + 2 * M * i (column-major 2xM, M = Distortion::getParameterSize())
+///          results + i
+///        All outputs but the keypoints and the results are optional, nullptr skips them.
+struct ProjectionJacobianBuffers {
+  double* keypoints = nullptr;
+  double* jacobians_point = nullptr;
+  double* jacobians_intrinsics = nullptr;
+  double* jacobians_distortion = nullptr;
+  ProjectionResult* results = nullptr;
+};
+
 /// \class Camera
 /// \brief The base camera class provides methods to project/backproject euclidean and
 ///        homogeneous points. The actual projection is implemented in the derived classes
@@ -157,6 +176,7 @@ class Camera {
   /// Copy constructor for clone operation.
   Camera(const Camera& other) :
     line_delay_nanoseconds_(other.line_delay_nanoseconds_),
+    parameter_version_(other.parameter_version_),
     label_(other.label_),
     id_(other.id_),
     image_width_(other.image_width_),
@@ -245,6 +265,43 @@ class Camera {
                                   Eigen::Matrix2Xd* out_keypoints,
                                   std::vector<ProjectionResult>* out_results) const;
 
+  /// \brief Projects a matrix of euclidean points and computes the Jacobians of all projections
+  ///        in one call.
+  ///
+  /// This vanilla version calls project3Functional for every point. Camera implementers are
+  /// encouraged to override it with an array implementation.
+  /// @param[in]  points_3d                The points in euclidean coordinates.
+  /// @param[out] out_keypoints            The keypoints in image coordinates.
+  /// @param[out] out_jacobians_point      The Jacobians wrt. to changes in the points, one
+  ///                                      column-major 2x3 matrix per column, i.e.
+  ///                                      Eigen::Map<Eigen::Matrix<double, 2, 3>>(col(i).data()).
+  ///                                        nullptr: calculation is skipped.
+  /// @param[out] out_jacobians_intrinsics The Jacobians wrt. to changes in the intrinsics, one
+  ///                                      column-major 2xN matrix per column with
+  ///                                      N = getParameterSize().
+  ///                                        nullptr: calculation is skipped.
+  /// @param[out] out_results              The projection result of every point. The Jacobians
+  ///                                      of invalid projections are zero.
+  virtual void project3VectorizedWithJacobians(
+      const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d, Eigen::Matrix2Xd* out_keypoints,
+      Eigen::Matrix<double, 6, Eigen::Dynamic>* out_jacobians_point,
+      Eigen::MatrixXd* out_jacobians_intrinsics,
+      std::vector<ProjectionResult>* out_results) const;
+
+  /// \brief Projects a matrix of euclidean points into caller-provided buffers with the
+  ///        Jacobians wrt. the points, the intrinsics and the distortion coefficients, e.g. for
+  ///        the residuals of an optimization back-end. The results equal project3Functional
+  ///        with the internal parameters, except that the Jacobians of invalid projections are
+  ///        zero.
+  ///
+  /// This vanilla version calls project3Functional for every point and allocates its scratch
+  /// Jacobians once per call. Camera implementers are encouraged to override it with an
+  /// implementation that does not allocate at all.
+  /// @param[in]  points_3d The points in euclidean coordinates.
+  /// @param[out] buffers   The preallocated output buffers, see \ref ProjectionJacobianBuffers.
+  virtual void project3Batch(const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d,
+                             const ProjectionJacobianBuffers& buffers) const;
+
   /// \brief Compute the 3d bearing vector in euclidean coordinates given a keypoint in
   ///        image coordinates. Uses the projection (& distortion) models.
   ///        The result might be in normalized image plane for some camera implementations but not
@@ -267,6 +324,36 @@ class Camera {
   virtual void backProject3Vectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints,
                                       Eigen::Matrix3Xd* out_points_3d,
                                       std::vector<unsigned char>* out_success) const;
+
+  /// \brief Single-precision version of project3Vectorized. This vanilla version converts the
+  ///        points to double, camera implementers are encouraged to override it with float
+  ///        arithmetic.
+  virtual void project3VectorizedFloat(const Eigen::Ref<const Eigen::Matrix3Xf>& points_3d,
+                                       Eigen::Matrix2Xf* out_keypoints,
+                                       std::vector<ProjectionResult>* out_results) const;
+
+  /// \brief Single-precision version of backProject3Vectorized. This vanilla version converts
+  ///        the keypoints to double, camera implementers are encouraged to override it with float
+  ///        arithmetic.
+  virtual void backProject3VectorizedFloat(const Eigen::Ref<const Eigen::Matrix2Xf>& keypoints,
+                                           Eigen::Matrix3Xf* out_points_3d,
+                                           std::vector<unsigned char>* out_success) const;
+
+  /// \brief project3Vectorized for ScalarType double and project3VectorizedFloat for float, for
+  ///        code that is templated on the precision.
+  template <typename ScalarType>
+  void project3VectorizedWithScalar(
+      const Eigen::Ref<const Eigen::Matrix<ScalarType, 3, Eigen::Dynamic>>& points_3d,
+      Eigen::Matrix<ScalarType, 2, Eigen::Dynamic>* out_keypoints,
+      std::vector<ProjectionResult>* out_results) const;
+
+  /// \brief backProject3Vectorized for ScalarType double and backProject3VectorizedFloat for
+  ///        float, for code that is templated on the precision.
+  template <typename ScalarType>
+  void backProject3VectorizedWithScalar(
+      const Eigen::Ref<const Eigen::Matrix<ScalarType, 2, Eigen::Dynamic>>& keypoints,
+      Eigen::Matrix<ScalarType, 3, Eigen::Dynamic>* out_points_3d,
+      std::vector<unsigned char>* out_success) const;
   /// @}
 
   //////////////////////////////////////////////////////////////
@@ -370,6 +457,7 @@ class Camera {
   /// @param[in] line_delay_nano_seconds Line delay in nano seconds.
   void setLineDelayNanoSeconds(uint64_t line_delay_nano_seconds) {
     line_delay_nanoseconds_ = line_delay_nano_seconds;
+    markParametersChanged();
   }
 
   /// \brief The amount of time elapsed between the first row of the image and the
@@ -389,6 +477,33 @@ class Camera {
     return this->imageHeight() * line_delay_nanoseconds_;
   }
 
+  /// \brief Projects a matrix of euclidean points into a rolling shutter image, with the
+  ///        camera moving at constant velocity during the readout.
+  ///
+  /// Point i is observed at the readout time t_i = row_i * line delay of its own keypoint row,
+  /// at which it is at p_i - t_i * (w x p_i + v) in the camera frame (first-order motion). The
+  /// fixed point of the row times is found with num_iterations vectorized projections of all
+  /// points, starting from the global shutter projection. As the row changes little with the
+  /// row time, 2-3 iterations converge for realistic line delays and velocities. With a zero
+  /// line delay the result equals project3VectorizedWithJacobians.
+  /// @param[in]  points_3d           The points in the camera frame at the time of the first row.
+  /// @param[in]  linear_velocity_C   Velocity v of the camera in [m/s], in the camera frame.
+  /// @param[in]  angular_velocity_C  Angular velocity w of the camera in [rad/s], in the camera
+  ///                                 frame.
+  /// @param[in]  num_iterations      Fixed-point iterations, at least one.
+  /// @param[out] out_keypoints       The keypoints in image coordinates.
+  /// @param[out] out_jacobians_point The Jacobians of the keypoints wrt. points_3d, including
+  ///                                 the change of the row time, in the layout of
+  ///                                 project3VectorizedWithJacobians.
+  ///                                   nullptr: calculation is skipped.
+  /// @param[out] out_results         The projection result of every point.
+  void project3RollingShutterVectorized(
+      const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d,
+      const Eigen::Vector3d& linear_velocity_C, const Eigen::Vector3d& angular_velocity_C,
+      int num_iterations, Eigen::Matrix2Xd* out_keypoints,
+      Eigen::Matrix<double, 6, Eigen::Dynamic>* out_jacobians_point,
+      std::vector<ProjectionResult>* out_results) const;
+
   /// @}
 
   //////////////////////////////////////////////////////////////
@@ -443,6 +558,7 @@ class Camera {
   /// Set the distortion model.
   void setDistortion(aslam::Distortion::UniquePtr& distortion) {
     distortion_ = std::move(distortion);
+    markParametersChanged();
   };
 
   /// Is a distortion model set for this camera.
@@ -452,7 +568,10 @@ class Camera {
   }
 
   /// Remove the distortion model from this camera.
-  void removeDistortion() { distortion_.reset(new NullDistortion); };
+  void removeDistortion() {
+    distortion_.reset(new NullDistortion);
+    markParametersChanged();
+  };
   /// @}
 
   //////////////////////////////////////////////////////////////
@@ -462,16 +581,34 @@ class Camera {
   /// Get the intrinsic parameters (const).
   inline const Eigen::VectorXd& getParameters() const { return intrinsics_; };
 
-  /// Get the intrinsic parameters.
-  inline double* getParametersMutable() { return &intrinsics_.coeffRef(0, 0); };
+  /// Get the intrinsic parameters. The next call of getParameterVersion takes a new version.
+  inline double* getParametersMutable() {
+    parameter_version_.markPendingWrite();
+    return &intrinsics_.coeffRef(0, 0);
+  };
 
   /// Set the intrinsic parameters. Parameters are documented in the specialized
   /// camera classes.
   void setParameters(const Eigen::VectorXd& params) {
     CHECK_EQ(getParameterSize(), params.size());
     intrinsics_ = params;
+    markParametersChanged();
+  }
+
+  /// \brief Version of the calibration, see ParameterVersion: the intrinsics, the distortion,
+  ///        the mask and the line delay. Use it to rebuild data derived from the camera with a
+  ///        DerivedCache, e.g. lookup tables or visibility cones.
+  ///
+  /// The version increases with every setter and mutable parameter accessor of the camera and
+  /// of its distortion. The id and the label are not part of the calibration.
+  inline ParameterVersion getParameterVersion() const {
+    return std::max(parameter_version_.get(), getDistortion().getParameterVersion());
   }
 
+  /// \brief Takes a new parameter version. Call it after writing to the intrinsics through a
+  ///        pointer obtained before, e.g. after every step of an optimizer.
+  inline void markParametersChanged() { parameter_version_.markChanged(); }
+
   /// Function to check whether the given intrinsic parameters are valid for this model.
   virtual bool intrinsicsValid(const Eigen::VectorXd& intrinsics) = 0;
 
@@ -494,14 +631,34 @@ class Camera {
   /// Does the camera have a mask?
   bool hasMask() const;
 
-  /// Check if the keypoint is masked.
+  /// Check if the keypoint is masked. Keypoints outside of the image are masked.
   inline bool isMasked(const Eigen::Ref<const Eigen::Vector2d>& keypoint) const {
-    return keypoint[0] < 0.0 || keypoint[0] >= static_cast<double>(image_width_) ||
-        keypoint[1] < 0.0 || keypoint[1] >= static_cast<double>(image_height_) ||
-        (!mask_.empty() && mask_.at<uint8_t>(static_cast<int>(keypoint[1]),
-                                             static_cast<int>(keypoint[0])) == 0);
+    if (keypoint[0] < 0.0 || keypoint[0] >= static_cast<double>(image_width_) ||
+        keypoint[1] < 0.0 || keypoint[1] >= static_cast<double>(image_height_)) {
+      return true;
+    }
+    if (mask_tile_states_.empty()) {
+      return false;
+    }
+    const int u = static_cast<int>(keypoint[0]);
+    const int v = static_cast<int>(keypoint[1]);
+    const int num_words_per_row = getNumMaskWordsPerRow();
+    const int word_index = u / kMaskTileSize;
+    switch (mask_tile_states_[(v / kMaskTileSize) * num_words_per_row + word_index]) {
+      case MaskTileState::kValid:
+        return false;
+      case MaskTileState::kMasked:
+        return true;
+      case MaskTileState::kMixed:
+        break;
+    }
+    return (mask_bits_[v * num_words_per_row + word_index] >> (u % kMaskTileSize)) & 1u;
   }
 
+  /// Check for all keypoints if they are masked, see isMasked.
+  void isMaskedVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints,
+                          std::vector<unsigned char>* out_masked) const;
+
   /// @}
 
   /// \name Factory Methods
@@ -528,6 +685,8 @@ class Camera {
  private:
   /// The delay per scanline for a rolling shutter camera in nanoseconds.
   uint64_t line_delay_nanoseconds_;
+  /// The version of the calibration of the camera without the distortion.
+  ParameterVersionTracker parameter_version_;
   /// A label for this camera, a name.
   std::string label_;
   /// The id of this camera.
@@ -539,6 +698,18 @@ class Camera {
   /// The image mask.
   cv::Mat_<uint8_t> mask_;
 
+  /// Side length of the square mask tiles in pixels, which is the number of bits per word.
+  static constexpr int kMaskTileSize = 64;
+  enum class MaskTileState : uint8_t { kValid, kMasked, kMixed };
+  inline int getNumMaskWordsPerRow() const {
+    return (static_cast<int>(image_width_) + kMaskTileSize - 1) / kMaskTileSize;
+  }
+  /// The mask packed into bits, set bits are masked. Every image row starts with a new word.
+  std::vector<uint64_t> mask_bits_;
+  /// Whether all, none or some of the pixels of a tile are masked, row-major. Empty if the
+  /// camera has no mask.
+  std::vector<MaskTileState> mask_tile_states_;
+
  protected:
   /// Parameter vector for the intrinsic parameters of the model.
   Eigen::VectorXd intrinsics_;
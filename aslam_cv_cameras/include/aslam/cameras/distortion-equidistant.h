@@ -1,11 +1,14 @@
 #ifndef ASLAM_EQUIDISTANT_DISTORTION_H_
 #define ASLAM_EQUIDISTANT_DISTORTION_H_
 
+#include <memory>
+
 #include <Eigen/Core>
 #include <glog/logging.h>
 
 #include <aslam/common/crtp-clone.h>
 #include <aslam/cameras/distortion.h>
+#include <aslam/cameras/radial-inverse-table.h>
 #include <aslam/common/macros.h>
 
 namespace aslam {
@@ -16,7 +19,9 @@ namespace aslam {
 ///        Fish-Eye Lenses" by Juho Kannala and Sami S. Brandt for further information.
 ///        The ordering of the parameter vector is: k1 k2 k3 k4
 ///        NOTE: The inverse transformation (undistort) in this case is not available in
-///        closed form and so it is computed iteratively!
+///        closed form and so it is computed iteratively! The iteration starts at the incidence
+///        angle interpolated from a table of the inverse of the radial function, which is built
+///        once per parameter set, and usually takes a single Newton step.
 class EquidistantDistortion : public aslam::Cloneable<Distortion, EquidistantDistortion> {
  public:
   /** \brief Number of parameters used for this distortion model. */
@@ -83,6 +88,11 @@ class EquidistantDistortion : public aslam::Cloneable<Distortion, EquidistantDis
                                         const Eigen::Vector2d& point,
                                         Eigen::Matrix<double, 2, Eigen::Dynamic>* out_jacobian) const;
 
+  /// \brief Distorts all columns at once, evaluating the model on contiguous coordinate arrays.
+  virtual void distortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                 Eigen::Matrix2Xd* out_points,
+                                 Eigen::Matrix4Xd* out_jacobians) const;
+
   /// @}
 
   //////////////////////////////////////////////////////////////
@@ -91,13 +101,20 @@ class EquidistantDistortion : public aslam::Cloneable<Distortion, EquidistantDis
 
   /// \brief Apply undistortion to recover a point in the normalized image plane using provided
   ///        distortion coefficients. External distortion coefficients can be specified using this
-  ///        function. Ignores the internally  stored parameters.
+  ///        function. Ignores the internally  stored parameters. The inverse table is only used
+  ///        if the coefficients equal the internal ones.
   /// @param[in]      dist_coeffs  Vector containing the coefficients for the distortion model.
   /// @param[in,out]  point        The distorted point. After the function, this point is in the
   ///                              normalized image plane.
   virtual void undistortUsingExternalCoefficients(const Eigen::VectorXd& dist_coeffs,
                                                   Eigen::Vector2d* point) const;
 
+  /// \brief Undistorts all columns at once by solving the radial polynomial for the incidence
+  ///        angle with Newton steps that run in lockstep on arrays.
+  virtual void undistortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                   Eigen::Matrix2Xd* out_points,
+                                   Eigen::Matrix4Xd* out_jacobians) const;
+
   /// @}
 
   //////////////////////////////////////////////////////////////
@@ -149,6 +166,12 @@ class EquidistantDistortion : public aslam::Cloneable<Distortion, EquidistantDis
 
   /// @}
 
+ private:
+  /// Returns the table of the incidence angle as a function of the distorted radius for the
+  /// internal parameters. It is rebuilt after the parameters changed.
+  std::shared_ptr<const RadialInverseTable> getInverseTable() const;
+
+  mutable DerivedCache<RadialInverseTable> inverse_table_;
 };
 
 } // namespace aslam
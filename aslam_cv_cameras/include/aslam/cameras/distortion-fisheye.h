@@ -77,6 +77,11 @@ class FisheyeDistortion : public aslam::Cloneable<Distortion, FisheyeDistortion>
                                         const Eigen::Vector2d& point,
                                         Eigen::Matrix<double, 2, Eigen::Dynamic>* out_jacobian) const;
 
+  /// \brief Distorts all columns at once, evaluating the model on contiguous coordinate arrays.
+  virtual void distortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                 Eigen::Matrix2Xd* out_points,
+                                 Eigen::Matrix4Xd* out_jacobians) const;
+
   /// @}
 
   //////////////////////////////////////////////////////////////
@@ -92,6 +97,11 @@ class FisheyeDistortion : public aslam::Cloneable<Distortion, FisheyeDistortion>
   virtual void undistortUsingExternalCoefficients(const Eigen::VectorXd& dist_coeffs,
                                                   Eigen::Vector2d* point) const;
 
+  /// \brief Undistorts all columns at once using the closed form inverse.
+  virtual void undistortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                   Eigen::Matrix2Xd* out_points,
+                                   Eigen::Matrix4Xd* out_jacobians) const;
+
   /// @}
 
   //////////////////////////////////////////////////////////////
@@ -86,6 +86,40 @@ class NullDistortion : public aslam::Cloneable<Distortion, NullDistortion> {
     }
   }
 
+  /// \brief Copies the points, there is no distortion to apply.
+  virtual void distortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                 Eigen::Matrix2Xd* out_points,
+                                 Eigen::Matrix4Xd* out_jacobians) const {
+    CHECK_NOTNULL(out_points);
+    *out_points = points;
+    if (out_jacobians) {
+      // Column-major identity matrices.
+      out_jacobians->resize(Eigen::NoChange, points.cols());
+      out_jacobians->colwise() = Eigen::Vector4d(1.0, 0.0, 0.0, 1.0);
+    }
+  }
+
+  /// \brief Copies the points, there is no distortion to apply.
+  virtual void distortVectorizedFloat(const Eigen::Ref<const Eigen::Matrix2Xf>& points,
+                                      Eigen::Matrix2Xf* out_points) const {
+    *CHECK_NOTNULL(out_points) = points;
+  }
+
+  /// \brief Non-virtual version of distortUsingExternalCoefficients, used by the
+  ///        ProjectionKernel.
+  template <bool kComputeJacobian>
+  static void distortPoint(const Eigen::Matrix<double, kNumOfParams, 1>& /* dist_coeffs */,
+                           Eigen::Vector2d* /* point */, Eigen::Matrix2d* out_jacobian) {
+    if (kComputeJacobian) {
+      out_jacobian->setIdentity();
+    }
+  }
+
+  /// \brief Non-virtual version of distortParameterJacobian, there are no parameters.
+  static void distortParameterJacobianPoint(
+      const Eigen::Vector2d& /* point */,
+      Eigen::Matrix<double, 2, kNumOfParams>* /* out_jacobian */) {}
+
   /// @}
 
   //////////////////////////////////////////////////////////////
@@ -102,6 +136,30 @@ class NullDistortion : public aslam::Cloneable<Distortion, NullDistortion> {
       const Eigen::VectorXd& /*dist_coeffs*/,
       Eigen::Vector2d* /*point*/) const {}
 
+  /// \brief Copies the points, there is no distortion to remove.
+  virtual void undistortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                   Eigen::Matrix2Xd* out_points,
+                                   Eigen::Matrix4Xd* out_jacobians) const {
+    CHECK_NOTNULL(out_points);
+    *out_points = points;
+    if (out_jacobians) {
+      // Column-major identity matrices.
+      out_jacobians->resize(Eigen::NoChange, points.cols());
+      out_jacobians->colwise() = Eigen::Vector4d(1.0, 0.0, 0.0, 1.0);
+    }
+  }
+
+  /// \brief Copies the points, there is no distortion to remove.
+  virtual void undistortVectorizedFloat(const Eigen::Ref<const Eigen::Matrix2Xf>& points,
+                                        Eigen::Matrix2Xf* out_points) const {
+    *CHECK_NOTNULL(out_points) = points;
+  }
+
+  /// \brief Non-virtual version of undistortUsingExternalCoefficients, used by the
+  ///        ProjectionKernel.
+  static void undistortPoint(const Eigen::Matrix<double, kNumOfParams, 1>& /* dist_coeffs */,
+                             Eigen::Vector2d* /* point */) {}
+
   /// @}
 
   //////////////////////////////////////////////////////////////
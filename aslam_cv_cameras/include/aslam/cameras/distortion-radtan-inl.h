@@ -0,0 +1,74 @@
+#ifndef ASLAM_RADTAN_DISTORTION_INL_H_
+#define ASLAM_RADTAN_DISTORTION_INL_H_
+
+namespace aslam {
+
+template <bool kComputeJacobian>
+inline void RadTanDistortion::distortPoint(
+    const Eigen::Matrix<double, kNumOfParams, 1>& dist_coeffs,
+    Eigen::Vector2d* point, Eigen::Matrix2d* out_jacobian) {
+  double& x = (*point)(0);
+  double& y = (*point)(1);
+
+  const double& k1 = dist_coeffs(0); // The first radial distortion parameter.
+  const double& k2 = dist_coeffs(1); // The second radial distortion parameter.
+  const double& p1 = dist_coeffs(2); // The first tangential distortion parameter.
+  const double& p2 = dist_coeffs(3); // The second tangential distortion parameter.
+
+  const double mx2_u = x * x;
+  const double my2_u = y * y;
+  const double mxy_u = x * y;
+  const double rho2_u = mx2_u + my2_u;
+  const double rad_dist_u = k1 * rho2_u + k2 * rho2_u * rho2_u;
+
+  if (kComputeJacobian) {
+    const double duf_du =   1.0 + rad_dist_u
+                          + 2.0 * k1 * mx2_u
+                          + 4.0 * k2 * rho2_u * mx2_u
+                          + 2.0 * p1 * y
+                          + 6.0 * p2 * x;
+
+    const double duf_dv =   2.0 * k1 * mxy_u
+                          + 4.0 * k2 * rho2_u * mxy_u
+                          + 2.0 * p1 * x
+                          + 2.0 * p2 * y;
+
+    const double dvf_du = duf_dv;
+
+    const double dvf_dv =   1.0 + rad_dist_u
+                          + 2.0 * k1 * my2_u
+                          + 4.0 * k2 * rho2_u * my2_u
+                          + 2.0 * p2 * x
+                          + 6.0 * p1 * y;
+
+    *out_jacobian << duf_du, duf_dv,
+                     dvf_du, dvf_dv;
+  }
+
+  x += x * rad_dist_u + 2.0 * p1 * mxy_u + p2 * (rho2_u + 2.0 * mx2_u);
+  y += y * rad_dist_u + 2.0 * p2 * mxy_u + p1 * (rho2_u + 2.0 * my2_u);
+}
+
+inline void RadTanDistortion::distortParameterJacobianPoint(
+    const Eigen::Vector2d& point, Eigen::Matrix<double, 2, kNumOfParams>* out_jacobian) {
+  const double& y0 = point(0);
+  const double& y1 = point(1);
+  const double r2 = y0 * y0 + y1 * y1;
+  const double r4 = r2 * r2;
+
+  const double duf_dk1 = y0 * r2;
+  const double duf_dk2 = y0 * r4;
+  const double duf_dp1 = 2.0 * y0 * y1;
+  const double duf_dp2 = r2 + 2.0 * y0 * y0;
+  const double dvf_dk1 = y1 * r2;
+  const double dvf_dk2 = y1 * r4;
+  const double dvf_dp1 = r2 + 2.0 * y1 * y1;
+  const double dvf_dp2 = 2.0 * y0 * y1;
+
+  (*out_jacobian) << duf_dk1, duf_dk2, duf_dp1, duf_dp2,
+                     dvf_dk1, dvf_dk2, dvf_dp1, dvf_dp2;
+}
+
+}  // namespace aslam
+
+#endif  // ASLAM_RADTAN_DISTORTION_INL_H_
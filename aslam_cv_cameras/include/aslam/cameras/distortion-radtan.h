@@ -71,6 +71,27 @@ class RadTanDistortion : public aslam::Cloneable<Distortion, RadTanDistortion> {
                                         const Eigen::Vector2d& point,
                                         Eigen::Matrix<double, 2, Eigen::Dynamic>* out_jacobian) const;
 
+  /// \brief Distorts all columns at once, evaluating the model on contiguous coordinate arrays.
+  virtual void distortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                 Eigen::Matrix2Xd* out_points,
+                                 Eigen::Matrix4Xd* out_jacobians) const;
+
+  /// \brief Single-precision version of distortVectorized.
+  virtual void distortVectorizedFloat(const Eigen::Ref<const Eigen::Matrix2Xf>& points,
+                                      Eigen::Matrix2Xf* out_points) const;
+
+  /// \brief Non-virtual version of distortUsingExternalCoefficients for fixed-size
+  ///        coefficients, used by the ProjectionKernel. The Jacobian is only evaluated if
+  ///        kComputeJacobian is set, out_jacobian is ignored otherwise.
+  template <bool kComputeJacobian>
+  static void distortPoint(const Eigen::Matrix<double, kNumOfParams, 1>& dist_coeffs,
+                           Eigen::Vector2d* point, Eigen::Matrix2d* out_jacobian);
+
+  /// \brief Non-virtual version of distortParameterJacobian with a fixed-size Jacobian, used by
+  ///        the ProjectionKernel. The Jacobian does not depend on the coefficients.
+  static void distortParameterJacobianPoint(const Eigen::Vector2d& point,
+                                            Eigen::Matrix<double, 2, kNumOfParams>* out_jacobian);
+
   /// @}
 
   //////////////////////////////////////////////////////////////
@@ -86,6 +107,21 @@ class RadTanDistortion : public aslam::Cloneable<Distortion, RadTanDistortion> {
   virtual void undistortUsingExternalCoefficients(const Eigen::VectorXd& dist_coeffs,
                                                   Eigen::Vector2d* point) const;
 
+  /// \brief Undistorts all columns at once. Runs the same Gauss-Newton iteration as the scalar
+  ///        version in lockstep on coordinate arrays; converged points are frozen by masking.
+  virtual void undistortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                   Eigen::Matrix2Xd* out_points,
+                                   Eigen::Matrix4Xd* out_jacobians) const;
+
+  /// \brief Single-precision version of undistortVectorized.
+  virtual void undistortVectorizedFloat(const Eigen::Ref<const Eigen::Matrix2Xf>& points,
+                                        Eigen::Matrix2Xf* out_points) const;
+
+  /// \brief Non-virtual version of undistortUsingExternalCoefficients for fixed-size
+  ///        coefficients, used by the ProjectionKernel.
+  static void undistortPoint(const Eigen::Matrix<double, kNumOfParams, 1>& dist_coeffs,
+                             Eigen::Vector2d* point);
+
   /// @}
 
   //////////////////////////////////////////////////////////////
@@ -137,7 +173,27 @@ class RadTanDistortion : public aslam::Cloneable<Distortion, RadTanDistortion> {
 
   /// @}
 
+ private:
+  template <typename ScalarType>
+  using Array = Eigen::Array<ScalarType, Eigen::Dynamic, 1>;
+
+  /// \brief Evaluates the model and optionally its Jacobian (duf_du, duf_dv = dvf_du, dvf_dv) on
+  ///        coordinate arrays. The Jacobian is skipped if duf_du is a nullptr.
+  template <typename ScalarType>
+  static void distortArrays(const Eigen::VectorXd& dist_coeffs,
+                            const Array<ScalarType>& x, const Array<ScalarType>& y,
+                            Array<ScalarType>* x_distorted, Array<ScalarType>* y_distorted,
+                            Array<ScalarType>* duf_du, Array<ScalarType>* duf_dv,
+                            Array<ScalarType>* dvf_dv);
+
+  /// \brief Undistorts coordinate arrays with Gauss-Newton steps that run in lockstep.
+  template <typename ScalarType>
+  static void undistortArrays(const Eigen::VectorXd& dist_coeffs,
+                              const Array<ScalarType>& x, const Array<ScalarType>& y,
+                              Array<ScalarType>* x_undistorted, Array<ScalarType>* y_undistorted);
 };
 } // namespace aslam
 
+#include "aslam/cameras/distortion-radtan-inl.h"
+
 #endif /* ASLAM_RADTAN_DISTORTION_H_ */
@@ -2,6 +2,7 @@
 #define ASLAM_CAMERAS_DISTORTION_H_
 
 #include <aslam/common/macros.h>
+#include <aslam/common/parameter-version.h>
 #include <Eigen/Dense>
 #include <gflags/gflags.h>
 
@@ -109,6 +110,25 @@ class Distortion {
                                  const Eigen::Vector2d& point,
                                  Eigen::Matrix<double, 2, Eigen::Dynamic>* out_jacobian) const = 0;
 
+  /// \brief Apply distortion to a block of points in the normalized image plane, one point per
+  ///        column. This vanilla version distorts every column separately. Distortion models are
+  ///        encouraged to override it with an array implementation.
+  /// @param[in]  points        The points in the normalized image plane.
+  /// @param[out] out_points    The distorted points. May alias points.
+  /// @param[out] out_jacobians The Jacobians of the distortion with respect to small changes in
+  ///                           the input points, one column-major 2x2 matrix per column, i.e.
+  ///                           Eigen::Map<Eigen::Matrix2d>(out_jacobians->col(i).data()).
+  ///                           If nullptr is passed, the Jacobian calculation is skipped.
+  virtual void distortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                 Eigen::Matrix2Xd* out_points,
+                                 Eigen::Matrix4Xd* out_jacobians) const;
+
+  /// \brief Single-precision version of distortVectorized without Jacobians. This vanilla version
+  ///        converts the points to double, distortion models are encouraged to override it with
+  ///        float arithmetic.
+  virtual void distortVectorizedFloat(const Eigen::Ref<const Eigen::Matrix2Xf>& points,
+                                      Eigen::Matrix2Xf* out_points) const;
+
   /// @}
 
   //////////////////////////////////////////////////////////////
@@ -135,6 +155,24 @@ class Distortion {
   virtual void undistortUsingExternalCoefficients(const Eigen::VectorXd& dist_coeffs,
                                                   Eigen::Vector2d* point) const = 0;
 
+  /// \brief Apply undistortion to a block of distorted points, one point per column. This
+  ///        vanilla version undistorts every column separately. Distortion models are encouraged
+  ///        to override it with an array implementation.
+  /// @param[in]  points        The distorted points.
+  /// @param[out] out_points    The points in the normalized image plane. May alias points.
+  /// @param[out] out_jacobians The Jacobians of the undistortion with respect to small changes in
+  ///                           the distorted points, stored like in distortVectorized. If nullptr
+  ///                           is passed, the Jacobian calculation is skipped.
+  virtual void undistortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                   Eigen::Matrix2Xd* out_points,
+                                   Eigen::Matrix4Xd* out_jacobians) const;
+
+  /// \brief Single-precision version of undistortVectorized without Jacobians. This vanilla
+  ///        version converts the points to double, distortion models are encouraged to override
+  ///        it with float arithmetic.
+  virtual void undistortVectorizedFloat(const Eigen::Ref<const Eigen::Matrix2Xf>& points,
+                                        Eigen::Matrix2Xf* out_points) const;
+
   /// @}
 
   //////////////////////////////////////////////////////////////
@@ -149,9 +187,21 @@ class Distortion {
   /// @return Vector containing the coefficients.
   inline const Eigen::VectorXd& getParameters() const { return distortion_coefficients_; };
 
-  /// \brief Get the pointer to the distortion model coefficients.
+  /// \brief Get the pointer to the distortion model coefficients. The next call of
+  ///        getParameterVersion takes a new parameter version.
   /// @return Pointer to the first coefficient.
-  inline double* getParametersMutable() { return &distortion_coefficients_.coeffRef(0, 0); };
+  inline double* getParametersMutable() {
+    parameter_version_.markPendingWrite();
+    return &distortion_coefficients_.coeffRef(0, 0);
+  };
+
+  /// \brief Version of the coefficients, see ParameterVersion. Changes with every call of
+  ///        setParameters or getParametersMutable, use it to rebuild data derived from them.
+  inline ParameterVersion getParameterVersion() const { return parameter_version_.get(); }
+
+  /// \brief Takes a new parameter version. Call it after writing to the coefficients through a
+  ///        pointer obtained before, e.g. after every step of an optimizer.
+  inline void markParametersChanged() { parameter_version_.markChanged(); }
 
   /// \brief Returns the number of parameters used in the distortion model.
   ///        NOTE: Use the constexpr function parameterCount if you know the exact distortion type.
@@ -174,11 +224,20 @@ class Distortion {
   /// @}
 
  protected:
+  /// \brief Computes the undistortion Jacobians by inverting the distortion Jacobians at the
+  ///        given undistorted points.
+  void computeUndistortionJacobiansVectorized(const Eigen::Matrix2Xd& undistorted_points,
+                                              Eigen::Matrix4Xd* out_jacobians) const;
+
   /// \brief Parameter vector for the distortion model.
   Eigen::VectorXd distortion_coefficients_;
 
   /// \brief Enum field to store the type of distortion model.
   Type distortion_type_;
+
+ private:
+  /// \brief The version of distortion_coefficients_.
+  ParameterVersionTracker parameter_version_;
 };
 }  // namespace aslam
 #include "distortion-inl.h"
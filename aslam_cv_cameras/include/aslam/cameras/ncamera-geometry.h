@@ -0,0 +1,102 @@
+#ifndef ASLAM_NCAMERA_GEOMETRY_H_
+#define ASLAM_NCAMERA_GEOMETRY_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+#include <aslam/cameras/camera-visibility-cone.h>
+#include <aslam/common/macros.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/common/unique-id.h>
+
+namespace aslam {
+class NCamera;
+
+/// \class NCameraGeometry
+/// \brief Immutable snapshot of the derived geometry of a camera rig.
+///
+/// Holds the inverse mounting transformations, the relative transformations of all pairs of
+/// cameras, a hash map from camera id to index and the field of view overlap of all pairs of
+/// cameras. Use NCamera::getGeometry to get the cached instance of a rig, which is rebuilt
+/// lazily after the rig was changed.
+///
+/// The overlap of camera j with camera i is the fraction of the image of camera j that is
+/// visible in camera i, for points at infinity. It is estimated by back-projecting a regular
+/// grid of keypoints of camera j into camera i, the translation between the cameras is
+/// neglected. An overlap of zero means that no distant point can be seen by both cameras.
+class NCameraGeometry {
+ public:
+  ASLAM_POINTER_TYPEDEFS(NCameraGeometry);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(NCameraGeometry);
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /// Number of grid keypoints per image axis used to estimate the overlaps.
+  static constexpr int kNumOverlapSamplesPerAxis = 16;
+
+  explicit NCameraGeometry(const NCamera& ncamera);
+
+  size_t getNumCameras() const { return num_cameras_; }
+
+  /// Get the pose of camera i with respect to the body frame.
+  const Transformation& get_T_B_C(size_t camera_index) const;
+
+  /// Get the transformation that takes points from camera j to camera i.
+  const Transformation& get_T_Ci_Cj(size_t camera_index_i, size_t camera_index_j) const;
+
+  /// Get the rotation that takes directions from camera j to camera i.
+  const Eigen::Matrix3d& get_R_Ci_Cj(size_t camera_index_i, size_t camera_index_j) const;
+
+  /// \brief Get the index of the camera with the id.
+  /// @returns -1 if the rig doesn't have a camera with this id.
+  int getCameraIndex(const CameraId& id) const;
+
+  /// Fraction of the image of camera j that is visible in camera i, in [0, 1].
+  double getOverlap(size_t camera_index_i, size_t camera_index_j) const;
+
+  /// Can camera i see any distant point that camera j sees.
+  bool haveOverlap(size_t camera_index_i, size_t camera_index_j) const {
+    return getOverlap(camera_index_i, camera_index_j) > 0.0;
+  }
+
+  /// All overlaps, the element (i, j) is getOverlap(i, j).
+  const Eigen::MatrixXd& getOverlapMatrix() const { return overlaps_; }
+
+  /// Conservative visibility cone of camera i, in the frame of camera i.
+  const CameraVisibilityCone& getVisibilityCone(size_t camera_index) const {
+    CHECK_LT(camera_index, num_cameras_);
+    return visibility_cones_[camera_index];
+  }
+
+ private:
+  /// Estimates the overlaps of all pairs of cameras.
+  void computeOverlaps(const NCamera& ncamera);
+
+  inline size_t getPairIndex(size_t camera_index_i, size_t camera_index_j) const {
+    CHECK_LT(camera_index_i, num_cameras_);
+    CHECK_LT(camera_index_j, num_cameras_);
+    return camera_index_i * num_cameras_ + camera_index_j;
+  }
+
+  const size_t num_cameras_;
+
+  /// The inverse mounting transformations.
+  TransformationVector T_B_C_;
+
+  /// The relative transformations and rotations of all pairs, camera i major.
+  TransformationVector T_Ci_Cj_;
+  std::vector<Eigen::Matrix3d> R_Ci_Cj_;
+
+  /// Map from camera id to index.
+  std::unordered_map<CameraId, size_t> id_to_index_;
+
+  Eigen::MatrixXd overlaps_;
+
+  std::vector<CameraVisibilityCone> visibility_cones_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_NCAMERA_GEOMETRY_H_
@@ -7,6 +7,7 @@
 #include <vector>
 
 #include <aslam/common/macros.h>
+#include <aslam/common/parameter-version.h>
 #include <aslam/common/pose-types.h>
 #include <aslam/common/unique-id.h>
 #include <aslam/common/yaml-serialization.h>
@@ -17,6 +18,7 @@ class PropertyTree;
 }
 namespace aslam {
 class Camera;
+class NCameraGeometry;
 }
 
 namespace aslam {
@@ -36,7 +38,7 @@ class NCamera {
 
 protected:
   /// Default constructor builds an empty camera rig.
-  NCamera() = default;
+  NCamera() : parameter_version_(getNextParameterVersion()) {}
 
 public:
   /// \brief initialize from a list of transformations and a list of cameras
@@ -81,6 +83,18 @@ public:
   bool saveToYaml(const std::string& yaml_file) const;
   void serializeToYaml(YAML::Node* yaml_node) const;
 
+  /// Load a camera rig from a binary calibration file, see BinaryCalibrationWriter. Returns a
+  /// nullptr if the loading fails.
+  static NCamera::Ptr loadFromBinary(const std::string& binary_file);
+  /// Decode a rig from the payload of a binary_calibration::kNCameraSection. Returns a nullptr
+  /// if the payload is invalid.
+  static NCamera::Ptr deserializeFromBinary(const char* data, size_t size_bytes);
+
+  /// Save this ncamera to a binary calibration file holding only the rig.
+  bool saveToBinary(const std::string& binary_file) const;
+  /// Encode the rig including the camera masks, e.g. to bundle it with other sections.
+  void serializeToBinary(std::vector<char>* payload) const;
+
   /// Get the number of cameras.
   size_t getNumCameras() const;
 
@@ -147,6 +161,25 @@ public:
   /// Set a label for the camera.
   inline void setLabel(const std::string& label) {label_ = label;}
 
+  /// \brief Get the derived geometry of the rig: the inverse extrinsics, the relative
+  ///        transformations and the field of view overlaps of all pairs of cameras.
+  ///
+  /// The geometry is built on the first call and cached for the current parameter version of
+  /// the rig, so it is rebuilt after changes of the extrinsics or of any camera. This method is
+  /// thread-safe.
+  std::shared_ptr<const NCameraGeometry> getGeometry() const;
+
+  /// \brief Version of the calibration of the rig, see ParameterVersion: the extrinsics, the
+  ///        set of cameras and their calibrations.
+  ///
+  /// The extrinsics take a new version in set_T_C_B, get_T_C_B_Mutable and setCamera. Changes
+  /// of the cameras are tracked by the camera versions.
+  ParameterVersion getParameterVersion() const;
+
+  /// \brief Takes a new parameter version. Call it after writing to the extrinsics through a
+  ///        reference obtained before from get_T_C_B_Mutable.
+  void markParametersChanged();
+
   /// Create a test NCamera object for unit testing.
   static NCamera::Ptr createTestNCamera(size_t num_cameras);
 
@@ -177,6 +210,12 @@ private:
 
   /// A label for this camera rig, a name.
   std::string label_;
+
+  /// The version of the extrinsics and of the set of cameras.
+  ParameterVersion parameter_version_;
+
+  /// The lazily built geometry of the rig.
+  mutable DerivedCache<NCameraGeometry> geometry_;
 };
 
 } // namespace aslam
@@ -0,0 +1,142 @@
+#ifndef ASLAM_CAMERAS_PROJECTION_KERNEL_INL_H_
+#define ASLAM_CAMERAS_PROJECTION_KERNEL_INL_H_
+
+namespace aslam {
+
+template <typename DistortionType>
+ProjectionKernel<PinholeCamera, DistortionType>::ProjectionKernel(const Camera& camera) {
+  CHECK(isCompatible(camera)) << "The camera of type " << camera.getType()
+      << " does not match the projection kernel.";
+  const PinholeCamera& pinhole_camera = static_cast<const PinholeCamera&>(camera);
+  fu_ = pinhole_camera.fu();
+  fv_ = pinhole_camera.fv();
+  cu_ = pinhole_camera.cu();
+  cv_ = pinhole_camera.cv();
+  image_width_ = static_cast<double>(camera.imageWidth());
+  image_height_ = static_cast<double>(camera.imageHeight());
+
+  const Eigen::VectorXd& distortion_coefficients = camera.getDistortion().getParameters();
+  CHECK_EQ(distortion_coefficients.size(), DistortionType::kNumOfParams);
+  distortion_coefficients_ = distortion_coefficients;
+}
+
+template <typename DistortionType>
+bool ProjectionKernel<PinholeCamera, DistortionType>::isCompatible(const Camera& camera) {
+  return dynamic_cast<const PinholeCamera*>(&camera) != nullptr &&
+      dynamic_cast<const DistortionType*>(&camera.getDistortion()) != nullptr;
+}
+
+template <typename DistortionType>
+template <bool kComputeJacobian, bool kComputeParameterJacobians>
+const ProjectionResult ProjectionKernel<PinholeCamera, DistortionType>::project3Impl(
+    const Eigen::Vector3d& point_3d, Eigen::Vector2d* out_keypoint,
+    Eigen::Matrix<double, 2, 3>* out_jacobian_point,
+    IntrinsicsJacobian* out_jacobian_intrinsics,
+    DistortionJacobian* out_jacobian_distortion) const {
+  CHECK_NOTNULL(out_keypoint);
+  const double& x = point_3d[0];
+  const double& y = point_3d[1];
+  const double& z = point_3d[2];
+
+  const double rz = 1.0 / z;
+  (*out_keypoint)[0] = x * rz;
+  (*out_keypoint)[1] = y * rz;
+
+  if (kComputeParameterJacobians && out_jacobian_distortion) {
+    DistortionType::distortParameterJacobianPoint(*out_keypoint, out_jacobian_distortion);
+    out_jacobian_distortion->row(0) *= fu_;
+    out_jacobian_distortion->row(1) *= fv_;
+  }
+
+  Eigen::Matrix2d J_distortion;
+  DistortionType::template distortPoint<kComputeJacobian>(
+      distortion_coefficients_, out_keypoint, &J_distortion);
+
+  if (kComputeJacobian) {
+    const double rz2 = rz * rz;
+    (*out_jacobian_point) <<
+        fu_ * J_distortion(0, 0) * rz,
+        fu_ * J_distortion(0, 1) * rz,
+        -fu_ * (x * J_distortion(0, 0) + y * J_distortion(0, 1)) * rz2,
+        fv_ * J_distortion(1, 0) * rz,
+        fv_ * J_distortion(1, 1) * rz,
+        -fv_ * (x * J_distortion(1, 0) + y * J_distortion(1, 1)) * rz2;
+  }
+
+  if (kComputeParameterJacobians && out_jacobian_intrinsics) {
+    (*out_jacobian_intrinsics) << (*out_keypoint)[0], 0.0, 1.0, 0.0,
+                                  0.0, (*out_keypoint)[1], 0.0, 1.0;
+  }
+
+  // Normalized image plane to camera plane.
+  (*out_keypoint)[0] = fu_ * (*out_keypoint)[0] + cu_;
+  (*out_keypoint)[1] = fv_ * (*out_keypoint)[1] + cv_;
+
+  return evaluateProjectionResult(*out_keypoint, z);
+}
+
+template <typename DistortionType>
+bool ProjectionKernel<PinholeCamera, DistortionType>::backProject3(
+    const Eigen::Vector2d& keypoint, Eigen::Vector3d* out_point_3d) const {
+  CHECK_NOTNULL(out_point_3d);
+  Eigen::Vector2d normalized_keypoint((keypoint[0] - cu_) / fu_, (keypoint[1] - cv_) / fv_);
+  DistortionType::undistortPoint(distortion_coefficients_, &normalized_keypoint);
+
+  (*out_point_3d)[0] = normalized_keypoint[0];
+  (*out_point_3d)[1] = normalized_keypoint[1];
+  (*out_point_3d)[2] = 1.0;
+
+  // Always valid for the pinhole model.
+  return true;
+}
+
+template <typename DistortionType>
+const ProjectionResult ProjectionKernel<PinholeCamera, DistortionType>::evaluateProjectionResult(
+    const Eigen::Vector2d& keypoint, double depth) const {
+  const bool visibility = keypoint[0] >= 0.0 && keypoint[1] >= 0.0 &&
+      keypoint[0] < image_width_ && keypoint[1] < image_height_;
+
+  if (visibility && (depth > PinholeCamera::kMinimumDepth))
+    return ProjectionResult(ProjectionResult::Status::KEYPOINT_VISIBLE);
+  else if (!visibility && (depth > PinholeCamera::kMinimumDepth))
+    return ProjectionResult(ProjectionResult::Status::KEYPOINT_OUTSIDE_IMAGE_BOX);
+  else if (depth < 0.0)
+    return ProjectionResult(ProjectionResult::Status::POINT_BEHIND_CAMERA);
+  else
+    return ProjectionResult(ProjectionResult::Status::PROJECTION_INVALID);
+}
+
+namespace internal {
+
+/// Passes the kernel of the typed camera to the functor, see visitCamera. The functor is only
+/// instantiated for the cameras that have a kernel.
+template <typename Functor>
+struct ProjectionKernelVisitor {
+  template <typename CameraType, typename DistortionType>
+  void operator()(const CameraType& /*camera*/, const DistortionType& /*distortion*/) {}
+  void operator()(const PinholeCamera& camera, const NullDistortion& /*distortion*/) {
+    (*functor)(PinholeProjectionKernel(camera));
+    has_kernel = true;
+  }
+  void operator()(const PinholeCamera& camera, const RadTanDistortion& /*distortion*/) {
+    (*functor)(PinholeRadTanProjectionKernel(camera));
+    has_kernel = true;
+  }
+
+  Functor* functor;
+  bool has_kernel;
+};
+
+}  // namespace internal
+
+template <typename Functor>
+bool visitProjectionKernel(const Camera& camera, Functor* functor) {
+  CHECK_NOTNULL(functor);
+  internal::ProjectionKernelVisitor<Functor> visitor{functor, false};
+  visitCamera(camera, &visitor);
+  return visitor.has_kernel;
+}
+
+}  // namespace aslam
+
+#endif  // ASLAM_CAMERAS_PROJECTION_KERNEL_INL_H_
@@ -0,0 +1,143 @@
+#ifndef ASLAM_CAMERAS_PROJECTION_KERNEL_H_
+#define ASLAM_CAMERAS_PROJECTION_KERNEL_H_
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/camera-visitor.h>
+#include <aslam/cameras/distortion-null.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <aslam/common/pose-types.h>
+
+namespace aslam {
+
+/// \class ProjectionKernel
+/// \brief Non-virtual (de)projection of a camera with a known camera and distortion type.
+///
+/// The kernel copies the intrinsics and the distortion coefficients of a camera into fixed-size
+/// members once, such that the projection of a point is fully inlined: There is no virtual call
+/// to the camera or the distortion and no runtime check of the optional Jacobians. The results
+/// equal the ones of Camera::project3 and Camera::backProject3.
+///
+/// The kernel is a snapshot, it does not follow later changes of the camera parameters.
+/// Kernels are specialized for PinholeCamera with NullDistortion and RadTanDistortion, use
+/// visitProjectionKernel to get the kernel of a camera of unknown type.
+///
+///    if (!aslam::visitProjectionKernel(camera, &functor)) {
+///      // Virtual fallback, there is no kernel for this camera.
+///    }
+template <typename CameraType, typename DistortionType>
+class ProjectionKernel;
+
+template <typename DistortionType>
+class ProjectionKernel<PinholeCamera, DistortionType> {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  typedef Eigen::Matrix<double, DistortionType::kNumOfParams, 1> DistortionCoefficients;
+  typedef Eigen::Matrix<double, 2, PinholeCamera::kNumOfParams> IntrinsicsJacobian;
+  typedef Eigen::Matrix<double, 2, DistortionType::kNumOfParams> DistortionJacobian;
+
+  /// The camera must be a PinholeCamera with a distortion of type DistortionType.
+  explicit ProjectionKernel(const Camera& camera);
+
+  /// Does the camera have the camera and distortion type of this kernel.
+  static bool isCompatible(const Camera& camera);
+
+  /// \brief Projects a euclidean point to a keypoint, see Camera::project3.
+  inline const ProjectionResult project3(const Eigen::Vector3d& point_3d,
+                                         Eigen::Vector2d* out_keypoint) const {
+    return project3Impl<false, false>(point_3d, out_keypoint, nullptr, nullptr, nullptr);
+  }
+
+  /// \brief Projects a euclidean point to a keypoint and computes the Jacobian of the keypoint
+  ///        with respect to the point, see Camera::project3.
+  inline const ProjectionResult project3(const Eigen::Vector3d& point_3d,
+                                         Eigen::Vector2d* out_keypoint,
+                                         Eigen::Matrix<double, 2, 3>* out_jacobian_point) const {
+    CHECK_NOTNULL(out_jacobian_point);
+    return project3Impl<true, false>(
+        point_3d, out_keypoint, out_jacobian_point, nullptr, nullptr);
+  }
+
+  /// \brief Projects a euclidean point with the optional Jacobians wrt. the point, the
+  ///        intrinsics and the distortion coefficients, see Camera::project3Functional. The
+  ///        Jacobians have fixed sizes, nothing is allocated.
+  inline const ProjectionResult project3Functional(
+      const Eigen::Vector3d& point_3d, Eigen::Vector2d* out_keypoint,
+      Eigen::Matrix<double, 2, 3>* out_jacobian_point,
+      IntrinsicsJacobian* out_jacobian_intrinsics,
+      DistortionJacobian* out_jacobian_distortion) const {
+    if (out_jacobian_point) {
+      return project3Impl<true, true>(point_3d, out_keypoint, out_jacobian_point,
+                                      out_jacobian_intrinsics, out_jacobian_distortion);
+    }
+    return project3Impl<false, true>(point_3d, out_keypoint, nullptr, out_jacobian_intrinsics,
+                                     out_jacobian_distortion);
+  }
+
+  /// \brief Computes the bearing vector [u, v, 1] of a keypoint, see Camera::backProject3.
+  inline bool backProject3(const Eigen::Vector2d& keypoint, Eigen::Vector3d* out_point_3d) const;
+
+ private:
+  /// The parameter Jacobians are only considered if kComputeParameterJacobians is set, each
+  /// of them may be nullptr.
+  template <bool kComputeJacobian, bool kComputeParameterJacobians>
+  inline const ProjectionResult project3Impl(
+      const Eigen::Vector3d& point_3d, Eigen::Vector2d* out_keypoint,
+      Eigen::Matrix<double, 2, 3>* out_jacobian_point,
+      IntrinsicsJacobian* out_jacobian_intrinsics,
+      DistortionJacobian* out_jacobian_distortion) const;
+
+  /// Same as PinholeCamera::evaluateProjectionResult.
+  inline const ProjectionResult evaluateProjectionResult(
+      const Eigen::Vector2d& keypoint, double depth) const;
+
+  DistortionCoefficients distortion_coefficients_;
+  double fu_;
+  double fv_;
+  double cu_;
+  double cv_;
+  double image_width_;
+  double image_height_;
+};
+
+typedef ProjectionKernel<PinholeCamera, NullDistortion> PinholeProjectionKernel;
+typedef ProjectionKernel<PinholeCamera, RadTanDistortion> PinholeRadTanProjectionKernel;
+
+/// \brief Calls (*functor)(kernel) with the projection kernel of the camera. The camera type is
+///        switched on once with visitCamera.
+/// @return False without calling the functor if there is no kernel for the camera and
+///         distortion type of the camera.
+template <typename Functor>
+bool visitProjectionKernel(const Camera& camera, Functor* functor);
+
+/// \brief Transforms points into the camera frame and projects them in one pass, the results
+///        equal Camera::project3Vectorized(T_C_X * X_points).
+///
+/// The rotation of T_C_X is converted to a matrix once. Cameras with a projection kernel
+/// transform blocks of points with the SIMD kernel of aslam/common/pose-batch.h into a buffer
+/// that stays in cache and project them with the kernel, the camera frame points are never
+/// stored. Other cameras transform all points with the batch transformation and call
+/// project3Vectorized.
+void transformAndProject3Vectorized(const Camera& camera, const Transformation& T_C_X,
+                                    const Eigen::Matrix3Xd& X_points,
+                                    Eigen::Matrix2Xd* out_keypoints,
+                                    std::vector<ProjectionResult>* out_results);
+
+/// \brief Single-precision version of transformAndProject3Vectorized.
+///
+/// Blocks of points are transformed in float with the SIMD kernel of aslam/common/pose-batch.h
+/// into a buffer that stays in cache and projected with Camera::project3VectorizedFloat, the
+/// camera frame points are never stored.
+void transformAndProject3VectorizedFloat(const Camera& camera, const Transformation& T_C_X,
+                                         const Eigen::Matrix3Xf& X_points,
+                                         Eigen::Matrix2Xf* out_keypoints,
+                                         std::vector<ProjectionResult>* out_results);
+
+}  // namespace aslam
+
+#include "aslam/cameras/projection-kernel-inl.h"
+
+#endif  // ASLAM_CAMERAS_PROJECTION_KERNEL_H_
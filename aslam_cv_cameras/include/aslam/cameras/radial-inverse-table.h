@@ -0,0 +1,59 @@
+#ifndef ASLAM_CAMERAS_RADIAL_INVERSE_TABLE_H_
+#define ASLAM_CAMERAS_RADIAL_INVERSE_TABLE_H_
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <aslam/common/macros.h>
+
+namespace aslam {
+
+/// \class RadialInverseTable
+/// \brief Tabulated inverse of an increasing radial function with f(0) = 0, e.g. the distorted
+///        radius of a radial distortion model as a function of the incidence angle.
+///
+/// The inverse is sampled at equidistant values and interpolated linearly, which gives a start
+/// point for a Newton step on the exact function that is accurate to the square of the
+/// interpolation error. The table is built once per parameter set of the distortion, see
+/// DerivedCache.
+class RadialInverseTable {
+ public:
+  ASLAM_POINTER_TYPEDEFS(RadialInverseTable);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(RadialInverseTable);
+
+  /// Returns f(argument) and writes df/dargument to *derivative.
+  typedef std::function<double(double argument, double* derivative)> RadialFunction;
+
+  /// @param[in] function     The radial function to invert.
+  /// @param[in] max_argument The table covers the arguments [0, max_argument], it ends earlier
+  ///                         at the first argument at which the function stops increasing.
+  /// @param[in] num_samples  Number of tabulated values, at least 2.
+  RadialInverseTable(const RadialFunction& function, double max_argument, size_t num_samples);
+
+  /// Is value within [0, getMaxValue()], i.e. can it be looked up.
+  inline bool isInRange(double value) const {
+    return value >= 0.0 && value <= max_value_ && !arguments_.empty();
+  }
+
+  /// Interpolated argument of the function at value, value has to be in range.
+  inline double lookup(double value) const {
+    const double position = value * inverse_step_;
+    const size_t index = std::min(static_cast<size_t>(position), arguments_.size() - 2u);
+    const double weight = position - static_cast<double>(index);
+    return arguments_[index] + weight * (arguments_[index + 1u] - arguments_[index]);
+  }
+
+  /// Largest value of the table, the value of the function at the end of the covered arguments.
+  double getMaxValue() const { return max_value_; }
+
+ private:
+  /// Arguments of the function at the values i / inverse_step_.
+  std::vector<double> arguments_;
+  double max_value_;
+  double inverse_step_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_CAMERAS_RADIAL_INVERSE_TABLE_H_
@@ -0,0 +1,282 @@
+#include <aslam/cameras/bearing-vector-lookup-table.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <limits>
+#include <thread>
+
+#include <glog/logging.h>
+
+#include <aslam/cameras/binary-calibration.h>
+#include <aslam/common/thread-pool.h>
+
+namespace aslam {
+
+namespace {
+/// Number of grid rows per band, bounds the size of the intermediate projection buffers.
+constexpr int kNumRowsPerBand = 16;
+
+/// Calls process_band(band_idx, row_begin, row_end) for all bands of rows, on a thread pool if
+/// more than one thread is used.
+void processBands(int num_rows, size_t num_threads,
+                  const std::function<void(int, int, int)>& process_band) {
+  const int num_bands = (num_rows + kNumRowsPerBand - 1) / kNumRowsPerBand;
+  num_threads = std::min(num_threads, static_cast<size_t>(num_bands));
+
+  auto process = [&process_band, num_rows](int band_idx) {
+    const int row_begin = band_idx * kNumRowsPerBand;
+    process_band(band_idx, row_begin, std::min(row_begin + kNumRowsPerBand, num_rows));
+  };
+  if (num_threads <= 1u) {
+    for (int band_idx = 0; band_idx < num_bands; ++band_idx) {
+      process(band_idx);
+    }
+    return;
+  }
+  ThreadPool thread_pool(num_threads);
+  std::vector<std::future<void>> band_futures;
+  band_futures.reserve(num_bands);
+  for (int band_idx = 0; band_idx < num_bands; ++band_idx) {
+    band_futures.emplace_back(thread_pool.enqueue([&process, band_idx]() {
+      process(band_idx);
+    }));
+  }
+  for (std::future<void>& band_future : band_futures) {
+    CHECK(band_future.valid());
+    band_future.get();
+  }
+}
+
+/// Hash of the camera geometry, detects tables of a camera that was recalibrated since.
+uint64_t computeCameraChecksum(const Camera& camera) {
+  std::vector<char> geometry;
+  binary_calibration::PayloadWriter writer(&geometry);
+  writer.write(static_cast<int32_t>(camera.getType()));
+  writer.write(camera.imageWidth());
+  writer.write(camera.imageHeight());
+  writer.writeVector(camera.getParameters());
+  writer.write(static_cast<int32_t>(camera.getDistortion().getType()));
+  writer.writeVector(camera.getDistortion().getParameters());
+  return binary_calibration::computeChecksum(geometry.data(), geometry.size());
+}
+}  // namespace
+
+BearingVectorLookupTable::BearingVectorLookupTable(
+    const Camera::ConstPtr& camera, double cell_size_px)
+    : camera_(camera),
+      camera_version_(CHECK_NOTNULL(camera.get())->getParameterVersion()),
+      cell_size_px_(cell_size_px),
+      inverse_cell_size_(1.0 / cell_size_px),
+      max_angular_error_(0.0) {
+  CHECK(camera_);
+  CHECK_GT(cell_size_px_, 0.0);
+  CHECK_GT(camera_->imageWidth(), 0u);
+  CHECK_GT(camera_->imageHeight(), 0u);
+  num_cols_ = static_cast<int>(std::ceil(camera_->imageWidth() * inverse_cell_size_)) + 1;
+  num_rows_ = static_cast<int>(std::ceil(camera_->imageHeight() * inverse_cell_size_)) + 1;
+  bearing_vectors_.resize(3u * num_cols_ * num_rows_);
+}
+
+BearingVectorLookupTable::BearingVectorLookupTable(
+    const Camera::ConstPtr& camera, double cell_size_px, size_t num_threads)
+    : BearingVectorLookupTable(camera, cell_size_px) {
+  if (num_threads == 0u) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  processBands(num_rows_, num_threads, [this](int /* band_idx */, int row_begin, int row_end) {
+    buildRows(row_begin, row_end);
+  });
+
+  const int num_cell_rows = num_rows_ - 1;
+  std::vector<double> band_max_angular_errors(
+      (num_cell_rows + kNumRowsPerBand - 1) / kNumRowsPerBand, 0.0);
+  processBands(num_cell_rows, num_threads,
+               [this, &band_max_angular_errors](int band_idx, int row_begin, int row_end) {
+    band_max_angular_errors[band_idx] = computeMaxAngularError(row_begin, row_end);
+  });
+  for (const double band_max_angular_error : band_max_angular_errors) {
+    max_angular_error_ = std::max(max_angular_error_, band_max_angular_error);
+  }
+  VLOG(3) << "Built a " << num_cols_ << "x" << num_rows_ << " bearing vector lookup table ("
+      << getNumBytes() << " bytes), max. angular error " << max_angular_error_ << " rad.";
+}
+
+BearingVectorLookupTable::Ptr BearingVectorLookupTable::deserializeFromBinary(
+    const Camera::ConstPtr& camera, const char* data, size_t size_bytes) {
+  CHECK(camera);
+  binary_calibration::PayloadReader reader(data, size_bytes);
+  uint64_t camera_id_words[2];
+  uint64_t camera_checksum;
+  double cell_size_px;
+  double max_angular_error;
+  if (!reader.read(&camera_id_words) || !reader.read(&camera_checksum) ||
+      !reader.read(&cell_size_px) || !reader.read(&max_angular_error)) {
+    LOG(ERROR) << "The bearing vector lookup table data is truncated.";
+    return BearingVectorLookupTable::Ptr();
+  }
+  CameraId camera_id;
+  camera_id.fromUint64(camera_id_words);
+  if (camera_id != camera->getId() || camera_checksum != computeCameraChecksum(*camera)) {
+    LOG(ERROR) << "The bearing vector lookup table was built for a different camera.";
+    return BearingVectorLookupTable::Ptr();
+  }
+  if (!(cell_size_px > 0.0)) {
+    LOG(ERROR) << "Invalid cell size " << cell_size_px << " of the bearing vector lookup table.";
+    return BearingVectorLookupTable::Ptr();
+  }
+
+  BearingVectorLookupTable::Ptr lookup_table(new BearingVectorLookupTable(camera, cell_size_px));
+  if (!reader.readBytes(lookup_table->bearing_vectors_.data(), lookup_table->getNumBytes()) ||
+      reader.getNumRemainingBytes() != 0u) {
+    LOG(ERROR) << "The bearing vector lookup table data has an unexpected size.";
+    return BearingVectorLookupTable::Ptr();
+  }
+  lookup_table->max_angular_error_ = max_angular_error;
+  return lookup_table;
+}
+
+void BearingVectorLookupTable::serializeToBinary(std::vector<char>* payload) const {
+  CHECK_NOTNULL(payload)->clear();
+  binary_calibration::PayloadWriter writer(payload);
+  uint64_t camera_id_words[2];
+  camera_->getId().toUint64(camera_id_words);
+  writer.write(camera_id_words);
+  writer.write(computeCameraChecksum(*camera_));
+  writer.write(cell_size_px_);
+  writer.write(max_angular_error_);
+  writer.writeBytes(bearing_vectors_.data(), getNumBytes());
+}
+
+void BearingVectorLookupTable::buildRows(int row_begin, int row_end) {
+  const int num_vertices = (row_end - row_begin) * num_cols_;
+  Eigen::Matrix2Xd keypoints(2, num_vertices);
+  for (int row = row_begin; row < row_end; ++row) {
+    for (int col = 0; col < num_cols_; ++col) {
+      keypoints.col((row - row_begin) * num_cols_ + col) << col * cell_size_px_,
+          row * cell_size_px_;
+    }
+  }
+  Eigen::Matrix3Xd points_3d;
+  std::vector<unsigned char> success;
+  camera_->backProject3Vectorized(keypoints, &points_3d, &success);
+  CHECK_EQ(points_3d.cols(), num_vertices);
+  CHECK_EQ(static_cast<int>(success.size()), num_vertices);
+
+  float* bearing_vectors = bearing_vectors_.data() + 3 * row_begin * num_cols_;
+  for (int i = 0; i < num_vertices; ++i) {
+    if (success[i]) {
+      bearing_vectors[3 * i] = static_cast<float>(points_3d(0, i));
+      bearing_vectors[3 * i + 1] = static_cast<float>(points_3d(1, i));
+      bearing_vectors[3 * i + 2] = static_cast<float>(points_3d(2, i));
+    } else {
+      bearing_vectors[3 * i] = std::numeric_limits<float>::quiet_NaN();
+    }
+  }
+}
+
+double BearingVectorLookupTable::computeMaxAngularError(int row_begin, int row_end) const {
+  const int num_cell_cols = num_cols_ - 1;
+  Eigen::Matrix2Xd cell_centers(2, (row_end - row_begin) * num_cell_cols);
+  for (int row = row_begin; row < row_end; ++row) {
+    for (int col = 0; col < num_cell_cols; ++col) {
+      cell_centers.col((row - row_begin) * num_cell_cols + col) <<
+          (col + 0.5) * cell_size_px_, (row + 0.5) * cell_size_px_;
+    }
+  }
+  Eigen::Matrix3Xd exact_points_3d;
+  std::vector<unsigned char> success;
+  camera_->backProject3Vectorized(cell_centers, &exact_points_3d, &success);
+
+  double max_angular_error = 0.0;
+  Eigen::Vector3d interpolated_point_3d;
+  for (int i = 0; i < cell_centers.cols(); ++i) {
+    if (!success[i] ||
+        !interpolate(cell_centers(0, i), cell_centers(1, i), &interpolated_point_3d)) {
+      continue;
+    }
+    const Eigen::Vector3d exact_point_3d = exact_points_3d.col(i);
+    const double angular_error = std::atan2(exact_point_3d.cross(interpolated_point_3d).norm(),
+                                            exact_point_3d.dot(interpolated_point_3d));
+    max_angular_error = std::max(max_angular_error, angular_error);
+  }
+  return max_angular_error;
+}
+
+inline bool BearingVectorLookupTable::interpolate(
+    double u, double v, Eigen::Vector3d* out_point_3d) const {
+  // Also rejects NaN coordinates.
+  if (!(u >= 0.0 && v >= 0.0 && u < camera_->imageWidth() && v < camera_->imageHeight())) {
+    return false;
+  }
+  const double u_cell = u * inverse_cell_size_;
+  const double v_cell = v * inverse_cell_size_;
+  const int col = std::min(static_cast<int>(u_cell), num_cols_ - 2);
+  const int row = std::min(static_cast<int>(v_cell), num_rows_ - 2);
+  const float* top_left = bearing_vectors_.data() + 3 * (row * num_cols_ + col);
+  const float* bottom_left = top_left + 3 * num_cols_;
+  if (std::isnan(top_left[0]) || std::isnan(top_left[3]) ||
+      std::isnan(bottom_left[0]) || std::isnan(bottom_left[3])) {
+    return false;
+  }
+
+  const double du = u_cell - col;
+  const double dv = v_cell - row;
+  const double w_top_left = (1.0 - du) * (1.0 - dv);
+  const double w_top_right = du * (1.0 - dv);
+  const double w_bottom_left = (1.0 - du) * dv;
+  const double w_bottom_right = du * dv;
+  for (int i = 0; i < 3; ++i) {
+    (*out_point_3d)[i] = w_top_left * top_left[i] + w_top_right * top_left[3 + i] +
+        w_bottom_left * bottom_left[i] + w_bottom_right * bottom_left[3 + i];
+  }
+  return true;
+}
+
+bool BearingVectorLookupTable::backProject3(const Eigen::Ref<const Eigen::Vector2d>& keypoint,
+                                            Eigen::Vector3d* out_point_3d) const {
+  CHECK_NOTNULL(out_point_3d);
+  if (interpolate(keypoint[0], keypoint[1], out_point_3d)) {
+    return true;
+  }
+  return camera_->backProject3(keypoint, out_point_3d);
+}
+
+void BearingVectorLookupTable::backProject3Vectorized(
+    const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints, Eigen::Matrix3Xd* out_points_3d,
+    std::vector<unsigned char>* out_success) const {
+  CHECK_NOTNULL(out_points_3d);
+  CHECK_NOTNULL(out_success);
+  const int num_keypoints = keypoints.cols();
+  out_points_3d->resize(3, num_keypoints);
+  out_success->resize(num_keypoints);
+
+  std::vector<int> fallback_indices;
+  Eigen::Vector3d point_3d;
+  for (int i = 0; i < num_keypoints; ++i) {
+    if (interpolate(keypoints(0, i), keypoints(1, i), &point_3d)) {
+      out_points_3d->col(i) = point_3d;
+      (*out_success)[i] = true;
+    } else {
+      fallback_indices.emplace_back(i);
+    }
+  }
+  if (fallback_indices.empty()) {
+    return;
+  }
+
+  Eigen::Matrix2Xd fallback_keypoints(2, fallback_indices.size());
+  for (size_t i = 0u; i < fallback_indices.size(); ++i) {
+    fallback_keypoints.col(i) = keypoints.col(fallback_indices[i]);
+  }
+  Eigen::Matrix3Xd fallback_points_3d;
+  std::vector<unsigned char> fallback_success;
+  camera_->backProject3Vectorized(fallback_keypoints, &fallback_points_3d, &fallback_success);
+  for (size_t i = 0u; i < fallback_indices.size(); ++i) {
+    out_points_3d->col(fallback_indices[i]) = fallback_points_3d.col(i);
+    (*out_success)[fallback_indices[i]] = fallback_success[i];
+  }
+}
+
+}  // namespace aslam
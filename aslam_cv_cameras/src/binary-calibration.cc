@@ -0,0 +1,217 @@
+#include <aslam/cameras/binary-calibration.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#include <unistd.h>
+
+namespace aslam {
+namespace binary_calibration {
+
+uint64_t computeChecksum(const char* data, size_t size_bytes) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0u; i < size_bytes; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+}  // namespace binary_calibration
+
+void BinaryCalibrationWriter::addSection(
+    uint32_t tag, uint32_t index, std::vector<char>&& payload) {
+  for (const Section& section : sections_) {
+    CHECK(section.tag != tag || section.index != index)
+        << "Duplicate section with tag " << tag << " and index " << index << ".";
+  }
+  sections_.emplace_back();
+  sections_.back().tag = tag;
+  sections_.back().index = index;
+  sections_.back().payload = std::move(payload);
+}
+
+void BinaryCalibrationWriter::writeToBuffer(std::vector<char>* buffer) const {
+  CHECK_NOTNULL(buffer);
+  using binary_calibration::alignSize;
+  using binary_calibration::FileHeader;
+  using binary_calibration::SectionEntry;
+
+  std::vector<SectionEntry> entries(sections_.size());
+  size_t offset_bytes = alignSize(sizeof(FileHeader) + sections_.size() * sizeof(SectionEntry));
+  for (size_t i = 0u; i < sections_.size(); ++i) {
+    std::memset(&entries[i], 0, sizeof(SectionEntry));
+    entries[i].tag = sections_[i].tag;
+    entries[i].index = sections_[i].index;
+    entries[i].offset_bytes = offset_bytes;
+    entries[i].size_bytes = sections_[i].payload.size();
+    offset_bytes = alignSize(offset_bytes + sections_[i].payload.size());
+  }
+
+  // The padding is zeroed, the checksum is deterministic.
+  buffer->assign(offset_bytes, 0);
+  if (!entries.empty()) {
+    std::memcpy(buffer->data() + sizeof(FileHeader), entries.data(),
+                entries.size() * sizeof(SectionEntry));
+  }
+  for (size_t i = 0u; i < sections_.size(); ++i) {
+    if (!sections_[i].payload.empty()) {
+      std::memcpy(buffer->data() + entries[i].offset_bytes, sections_[i].payload.data(),
+                  sections_[i].payload.size());
+    }
+  }
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(FileHeader));
+  header.magic = binary_calibration::kFileMagic;
+  header.version = binary_calibration::kFormatVersion;
+  header.header_size_bytes = sizeof(FileHeader);
+  header.num_sections = static_cast<uint32_t>(sections_.size());
+  header.total_size_bytes = buffer->size();
+  header.checksum = binary_calibration::computeChecksum(
+      buffer->data() + sizeof(FileHeader), buffer->size() - sizeof(FileHeader));
+  std::memcpy(buffer->data(), &header, sizeof(FileHeader));
+}
+
+bool BinaryCalibrationWriter::writeToFile(const std::string& file_path) const {
+  std::vector<char> buffer;
+  writeToBuffer(&buffer);
+
+  std::ostringstream temporary_file_path;
+  temporary_file_path << file_path << ".tmp." << getpid();
+  {
+    std::ofstream file(temporary_file_path.str(), std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      LOG(ERROR) << "Could not open " << temporary_file_path.str() << " for writing.";
+      return false;
+    }
+    file.write(buffer.data(), buffer.size());
+    if (!file.good()) {
+      LOG(ERROR) << "Could not write the calibration file " << temporary_file_path.str() << ".";
+      std::remove(temporary_file_path.str().c_str());
+      return false;
+    }
+  }
+  if (std::rename(temporary_file_path.str().c_str(), file_path.c_str()) != 0) {
+    LOG(ERROR) << "Could not move the calibration file to " << file_path << ".";
+    std::remove(temporary_file_path.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+BinaryCalibrationReader::BinaryCalibrationReader() : data_(nullptr), size_bytes_(0u) {}
+
+BinaryCalibrationReader::~BinaryCalibrationReader() {
+  close();
+}
+
+void BinaryCalibrationReader::close() {
+  mapped_file_.close();
+  data_ = nullptr;
+  size_bytes_ = 0u;
+  sections_.clear();
+}
+
+bool BinaryCalibrationReader::openFile(const std::string& file_path) {
+  close();
+  common::MappedFile mapped_file;
+  if (!mapped_file.open(file_path)) {
+    LOG(ERROR) << "Could not open the calibration file " << file_path << ".";
+    return false;
+  }
+  if (mapped_file.sizeBytes() == 0u) {
+    LOG(ERROR) << "The calibration file " << file_path << " is empty.";
+    return false;
+  }
+  if (!openBuffer(mapped_file.data(), mapped_file.sizeBytes())) {
+    LOG(ERROR) << "Invalid calibration file " << file_path << ".";
+    return false;
+  }
+  // openBuffer() closes the reader, hence the mapping is handed over afterwards.
+  mapped_file_ = std::move(mapped_file);
+  return true;
+}
+
+bool BinaryCalibrationReader::openBuffer(const char* data, size_t size_bytes) {
+  using binary_calibration::FileHeader;
+  using binary_calibration::SectionEntry;
+  close();
+  if (data == nullptr || size_bytes < sizeof(FileHeader)) {
+    LOG(WARNING) << "The calibration data is too short.";
+    return false;
+  }
+  FileHeader header;
+  std::memcpy(&header, data, sizeof(FileHeader));
+  if (header.magic != binary_calibration::kFileMagic) {
+    LOG(WARNING) << "The calibration data has an invalid magic number.";
+    return false;
+  }
+  if (header.version != binary_calibration::kFormatVersion) {
+    LOG(WARNING) << "Unsupported calibration format version " << header.version
+                 << ", expected " << binary_calibration::kFormatVersion << ".";
+    return false;
+  }
+  if (header.header_size_bytes != sizeof(FileHeader) || header.total_size_bytes != size_bytes ||
+      header.num_sections > (size_bytes - sizeof(FileHeader)) / sizeof(SectionEntry)) {
+    LOG(WARNING) << "The calibration data is truncated.";
+    return false;
+  }
+  if (binary_calibration::computeChecksum(data + sizeof(FileHeader),
+                                          size_bytes - sizeof(FileHeader)) != header.checksum) {
+    LOG(WARNING) << "The calibration data has an invalid checksum.";
+    return false;
+  }
+
+  std::vector<SectionEntry> sections(header.num_sections);
+  if (!sections.empty()) {
+    std::memcpy(sections.data(), data + sizeof(FileHeader),
+                sections.size() * sizeof(SectionEntry));
+  }
+  for (const SectionEntry& section : sections) {
+    if (section.offset_bytes > size_bytes ||
+        section.size_bytes > size_bytes - section.offset_bytes) {
+      LOG(WARNING) << "A calibration section exceeds the data.";
+      return false;
+    }
+  }
+  data_ = data;
+  size_bytes_ = size_bytes;
+  sections_.swap(sections);
+  return true;
+}
+
+bool BinaryCalibrationReader::hasSection(uint32_t tag, uint32_t index) const {
+  const char* data;
+  size_t size_bytes;
+  return getSection(tag, index, &data, &size_bytes);
+}
+
+bool BinaryCalibrationReader::getSection(
+    uint32_t tag, uint32_t index, const char** data, size_t* size_bytes) const {
+  CHECK_NOTNULL(data);
+  CHECK_NOTNULL(size_bytes);
+  for (const binary_calibration::SectionEntry& section : sections_) {
+    if (section.tag == tag && section.index == index) {
+      *data = data_ + section.offset_bytes;
+      *size_bytes = section.size_bytes;
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t BinaryCalibrationReader::getNumSections(uint32_t tag) const {
+  size_t num_sections = 0u;
+  for (const binary_calibration::SectionEntry& section : sections_) {
+    if (section.tag == tag) {
+      ++num_sections;
+    }
+  }
+  return num_sections;
+}
+
+}  // namespace aslam
@@ -4,9 +4,59 @@
 #include <aslam/cameras/camera-pinhole.h>
 
 #include <aslam/cameras/camera-factory.h>
+#include <aslam/cameras/projection-kernel.h>
 #include <aslam/common/types.h>
 
 namespace aslam {
+namespace {
+/// Copies a Jacobian into its batch buffer, the Jacobians of invalid projections are zero.
+template <typename JacobianType>
+void writeBatchJacobian(const JacobianType& jacobian, bool is_valid, double* buffer) {
+  Eigen::Map<JacobianType> buffer_jacobian(buffer);
+  if (is_valid) {
+    buffer_jacobian = jacobian;
+  } else {
+    buffer_jacobian.setZero();
+  }
+}
+
+/// Fills the batch buffers with the projection kernel of the camera.
+struct BatchProjector {
+  template <typename KernelType>
+  void operator()(const KernelType& kernel) const {
+    Eigen::Vector2d keypoint;
+    Eigen::Matrix<double, 2, 3> J_point;
+    typename KernelType::IntrinsicsJacobian J_intrinsics;
+    typename KernelType::DistortionJacobian J_distortion;
+    for (int i = 0; i < points_3d.cols(); ++i) {
+      const ProjectionResult result = kernel.project3Functional(
+          points_3d.col(i), &keypoint, buffers.jacobians_point ? &J_point : nullptr,
+          buffers.jacobians_intrinsics ? &J_intrinsics : nullptr,
+          buffers.jacobians_distortion ? &J_distortion : nullptr);
+      Eigen::Map<Eigen::Vector2d>(buffers.keypoints + 2 * i) = keypoint;
+      buffers.results[i] = result;
+
+      const bool is_valid =
+          result.getDetailedStatus() != ProjectionResult::Status::PROJECTION_INVALID;
+      if (buffers.jacobians_point) {
+        writeBatchJacobian(J_point, is_valid, buffers.jacobians_point + J_point.size() * i);
+      }
+      if (buffers.jacobians_intrinsics) {
+        writeBatchJacobian(J_intrinsics, is_valid,
+                           buffers.jacobians_intrinsics + J_intrinsics.size() * i);
+      }
+      if (buffers.jacobians_distortion) {
+        writeBatchJacobian(J_distortion, is_valid,
+                           buffers.jacobians_distortion + J_distortion.size() * i);
+      }
+    }
+  }
+
+  const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d;
+  const ProjectionJacobianBuffers& buffers;
+};
+}  // namespace
+
 std::ostream& operator<<(std::ostream& out, const PinholeCamera& camera) {
   camera.printParameters(out, std::string(""));
   return out;
@@ -77,6 +127,155 @@ bool PinholeCamera::backProject3(const Eigen::Ref<const Eigen::Vector2d>& keypoi
   return true;
 }
 
+void PinholeCamera::backProject3Vectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints,
+                                           Eigen::Matrix3Xd* out_points_3d,
+                                           std::vector<unsigned char>* out_success) const {
+  CHECK_NOTNULL(out_points_3d);
+  CHECK_NOTNULL(out_success);
+
+  Eigen::Matrix2Xd normalized_keypoints(2, keypoints.cols());
+  normalized_keypoints.row(0) = ((keypoints.row(0).array() - cu()) / fu()).matrix();
+  normalized_keypoints.row(1) = ((keypoints.row(1).array() - cv()) / fv()).matrix();
+
+  distortion_->undistortVectorized(normalized_keypoints, &normalized_keypoints, nullptr);
+
+  out_points_3d->resize(Eigen::NoChange, keypoints.cols());
+  out_points_3d->topRows<2>() = normalized_keypoints;
+  out_points_3d->row(2).setOnes();
+
+  // Always valid for the pinhole model.
+  out_success->assign(keypoints.cols(), true);
+}
+
+void PinholeCamera::backProject3VectorizedFloat(
+    const Eigen::Ref<const Eigen::Matrix2Xf>& keypoints, Eigen::Matrix3Xf* out_points_3d,
+    std::vector<unsigned char>* out_success) const {
+  CHECK_NOTNULL(out_points_3d);
+  CHECK_NOTNULL(out_success);
+
+  Eigen::Matrix2Xf normalized_keypoints(2, keypoints.cols());
+  normalized_keypoints.row(0) =
+      ((keypoints.row(0).array() - static_cast<float>(cu())) / static_cast<float>(fu())).matrix();
+  normalized_keypoints.row(1) =
+      ((keypoints.row(1).array() - static_cast<float>(cv())) / static_cast<float>(fv())).matrix();
+
+  distortion_->undistortVectorizedFloat(normalized_keypoints, &normalized_keypoints);
+
+  out_points_3d->resize(Eigen::NoChange, keypoints.cols());
+  out_points_3d->topRows<2>() = normalized_keypoints;
+  out_points_3d->row(2).setOnes();
+
+  // Always valid for the pinhole model.
+  out_success->assign(keypoints.cols(), true);
+}
+
+void PinholeCamera::project3Vectorized(const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d,
+                                       Eigen::Matrix2Xd* out_keypoints,
+                                       std::vector<ProjectionResult>* out_results) const {
+  project3VectorizedWithJacobians(points_3d, out_keypoints, nullptr, nullptr, out_results);
+}
+
+void PinholeCamera::project3Batch(const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d,
+                                  const ProjectionJacobianBuffers& buffers) const {
+  CHECK_NOTNULL(buffers.keypoints);
+  CHECK_NOTNULL(buffers.results);
+  BatchProjector projector{points_3d, buffers};
+  if (!visitProjectionKernel(*this, &projector)) {
+    Camera::project3Batch(points_3d, buffers);
+  }
+}
+
+void PinholeCamera::project3VectorizedWithJacobians(
+    const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d, Eigen::Matrix2Xd* out_keypoints,
+    Eigen::Matrix<double, 6, Eigen::Dynamic>* out_jacobians_point,
+    Eigen::MatrixXd* out_jacobians_intrinsics,
+    std::vector<ProjectionResult>* out_results) const {
+  CHECK_NOTNULL(out_keypoints);
+  CHECK_NOTNULL(out_results);
+  const int num_points = points_3d.cols();
+
+  const Eigen::ArrayXd x = points_3d.row(0).transpose().array();
+  const Eigen::ArrayXd y = points_3d.row(1).transpose().array();
+  const Eigen::ArrayXd rz = points_3d.row(2).transpose().array().inverse();
+  Eigen::Matrix2Xd normalized_points(2, num_points);
+  normalized_points.row(0) = (x * rz).matrix().transpose();
+  normalized_points.row(1) = (y * rz).matrix().transpose();
+
+  Eigen::Matrix4Xd J_distortion;
+  distortion_->distortVectorized(normalized_points, out_keypoints,
+                                 out_jacobians_point ? &J_distortion : nullptr);
+
+  if (out_jacobians_point) {
+    // Rows of the column-major 2x2 distortion Jacobians.
+    const Eigen::ArrayXd Jd_00 = J_distortion.row(0).transpose().array();
+    const Eigen::ArrayXd Jd_10 = J_distortion.row(1).transpose().array();
+    const Eigen::ArrayXd Jd_01 = J_distortion.row(2).transpose().array();
+    const Eigen::ArrayXd Jd_11 = J_distortion.row(3).transpose().array();
+    const Eigen::ArrayXd rz2 = rz * rz;
+
+    out_jacobians_point->resize(Eigen::NoChange, num_points);
+    out_jacobians_point->row(0) = (fu() * Jd_00 * rz).matrix().transpose();
+    out_jacobians_point->row(1) = (fv() * Jd_10 * rz).matrix().transpose();
+    out_jacobians_point->row(2) = (fu() * Jd_01 * rz).matrix().transpose();
+    out_jacobians_point->row(3) = (fv() * Jd_11 * rz).matrix().transpose();
+    out_jacobians_point->row(4) =
+        (-fu() * (x * Jd_00 + y * Jd_01) * rz2).matrix().transpose();
+    out_jacobians_point->row(5) =
+        (-fv() * (x * Jd_10 + y * Jd_11) * rz2).matrix().transpose();
+  }
+
+  if (out_jacobians_intrinsics) {
+    // Column-major 2x4 Jacobians wrt. fu, fv, cu and cv.
+    out_jacobians_intrinsics->setZero(2 * kNumOfParams, num_points);
+    out_jacobians_intrinsics->row(0) = out_keypoints->row(0);
+    out_jacobians_intrinsics->row(3) = out_keypoints->row(1);
+    out_jacobians_intrinsics->row(4).setOnes();
+    out_jacobians_intrinsics->row(7).setOnes();
+  }
+
+  out_keypoints->row(0) = (out_keypoints->row(0).array() * fu() + cu()).matrix();
+  out_keypoints->row(1) = (out_keypoints->row(1).array() * fv() + cv()).matrix();
+
+  out_results->resize(num_points);
+  for (int i = 0; i < num_points; ++i) {
+    (*out_results)[i] = evaluateProjectionResult(out_keypoints->col(i), points_3d.col(i));
+    if ((*out_results)[i].getDetailedStatus() == ProjectionResult::Status::PROJECTION_INVALID) {
+      if (out_jacobians_point) {
+        out_jacobians_point->col(i).setZero();
+      }
+      if (out_jacobians_intrinsics) {
+        out_jacobians_intrinsics->col(i).setZero();
+      }
+    }
+  }
+}
+
+void PinholeCamera::project3VectorizedFloat(const Eigen::Ref<const Eigen::Matrix3Xf>& points_3d,
+                                            Eigen::Matrix2Xf* out_keypoints,
+                                            std::vector<ProjectionResult>* out_results) const {
+  CHECK_NOTNULL(out_keypoints);
+  CHECK_NOTNULL(out_results);
+
+  const Eigen::ArrayXf rz = points_3d.row(2).transpose().array().inverse();
+  Eigen::Matrix2Xf normalized_points(2, points_3d.cols());
+  normalized_points.row(0) = (points_3d.row(0).transpose().array() * rz).matrix().transpose();
+  normalized_points.row(1) = (points_3d.row(1).transpose().array() * rz).matrix().transpose();
+
+  distortion_->distortVectorizedFloat(normalized_points, out_keypoints);
+
+  const float fu_float = static_cast<float>(fu());
+  const float fv_float = static_cast<float>(fv());
+  const float cu_float = static_cast<float>(cu());
+  const float cv_float = static_cast<float>(cv());
+  out_keypoints->row(0) = (out_keypoints->row(0).array() * fu_float + cu_float).matrix();
+  out_keypoints->row(1) = (out_keypoints->row(1).array() * fv_float + cv_float).matrix();
+
+  out_results->resize(points_3d.cols());
+  for (int i = 0; i < points_3d.cols(); ++i) {
+    (*out_results)[i] = evaluateProjectionResult(out_keypoints->col(i), points_3d.col(i));
+  }
+}
+
 const ProjectionResult PinholeCamera::project3Functional(
     const Eigen::Ref<const Eigen::Vector3d>& point_3d,
     const Eigen::VectorXd* intrinsics_external,
@@ -86,6 +86,130 @@ bool UnifiedProjectionCamera::backProject3(const Eigen::Ref<const Eigen::Vector2
   return isUndistortedKeypointValid(rho2_d, xi());
 }
 
+void UnifiedProjectionCamera::backProject3Vectorized(
+    const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints, Eigen::Matrix3Xd* out_points_3d,
+    std::vector<unsigned char>* out_success) const {
+  CHECK_NOTNULL(out_points_3d);
+  CHECK_NOTNULL(out_success);
+  const int num_keypoints = keypoints.cols();
+
+  Eigen::Matrix2Xd normalized_keypoints(2, num_keypoints);
+  normalized_keypoints.row(0) = ((keypoints.row(0).array() - cu()) / fu()).matrix();
+  normalized_keypoints.row(1) = ((keypoints.row(1).array() - cv()) / fv()).matrix();
+
+  distortion_->undistortVectorized(normalized_keypoints, &normalized_keypoints, nullptr);
+
+  const double xi = this->xi();
+  const Eigen::ArrayXd rho2_d = normalized_keypoints.colwise().squaredNorm().transpose().array();
+  const Eigen::ArrayXd tmpD = (1.0 + (1.0 - xi * xi) * rho2_d).max(0.0);
+
+  out_points_3d->resize(Eigen::NoChange, num_keypoints);
+  out_points_3d->topRows<2>() = normalized_keypoints;
+  out_points_3d->row(2) = (1.0 - xi * (rho2_d + 1.0) / (xi + tmpD.sqrt())).matrix().transpose();
+
+  out_success->resize(num_keypoints);
+  for (int i = 0; i < num_keypoints; ++i) {
+    (*out_success)[i] = isUndistortedKeypointValid(rho2_d[i], xi);
+  }
+}
+
+void UnifiedProjectionCamera::project3Vectorized(
+    const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d, Eigen::Matrix2Xd* out_keypoints,
+    std::vector<ProjectionResult>* out_results) const {
+  project3VectorizedWithJacobians(points_3d, out_keypoints, nullptr, nullptr, out_results);
+}
+
+void UnifiedProjectionCamera::project3VectorizedWithJacobians(
+    const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d, Eigen::Matrix2Xd* out_keypoints,
+    Eigen::Matrix<double, 6, Eigen::Dynamic>* out_jacobians_point,
+    Eigen::MatrixXd* out_jacobians_intrinsics,
+    std::vector<ProjectionResult>* out_results) const {
+  CHECK_NOTNULL(out_keypoints);
+  CHECK_NOTNULL(out_results);
+  const int num_points = points_3d.cols();
+  const double xi = this->xi();
+
+  const Eigen::ArrayXd x = points_3d.row(0).transpose().array();
+  const Eigen::ArrayXd y = points_3d.row(1).transpose().array();
+  const Eigen::ArrayXd z = points_3d.row(2).transpose().array();
+  const Eigen::ArrayXd d = points_3d.colwise().norm().transpose().array();
+  const Eigen::ArrayXd rz = (z + xi * d).inverse();
+
+  // Points outside of the field of view are projected to the origin, such that the distortion
+  // only sees valid inputs.
+  const Eigen::Array<bool, Eigen::Dynamic, 1> valid_proj = z > -(fov_parameter(xi) * d);
+  Eigen::Matrix2Xd normalized_points(2, num_points);
+  normalized_points.row(0) = valid_proj.select(x * rz, 0.0).matrix().transpose();
+  normalized_points.row(1) = valid_proj.select(y * rz, 0.0).matrix().transpose();
+
+  const bool compute_jacobians = out_jacobians_point || out_jacobians_intrinsics;
+  Eigen::Matrix4Xd J_distortion;
+  distortion_->distortVectorized(normalized_points, out_keypoints,
+                                 compute_jacobians ? &J_distortion : nullptr);
+
+  if (compute_jacobians) {
+    // Rows of the column-major 2x2 distortion Jacobians.
+    const Eigen::ArrayXd Jd_00 = J_distortion.row(0).transpose().array();
+    const Eigen::ArrayXd Jd_10 = J_distortion.row(1).transpose().array();
+    const Eigen::ArrayXd Jd_01 = J_distortion.row(2).transpose().array();
+    const Eigen::ArrayXd Jd_11 = J_distortion.row(3).transpose().array();
+
+    if (out_jacobians_point) {
+      // Jacobian of the projection onto the normalized image plane wrt. the point.
+      const Eigen::ArrayXd rz2 = rz * rz / d;
+      const Eigen::ArrayXd P_00 = rz2 * (d * z + xi * (y * y + z * z));
+      const Eigen::ArrayXd P_10 = -rz2 * xi * x * y;
+      const Eigen::ArrayXd P_11 = rz2 * (d * z + xi * (x * x + z * z));
+      const Eigen::ArrayXd P_02 = x * rz2 * (-xi * z - d);
+      const Eigen::ArrayXd P_12 = y * rz2 * (-xi * z - d);
+
+      out_jacobians_point->resize(Eigen::NoChange, num_points);
+      out_jacobians_point->row(0) = (fu() * (P_00 * Jd_00 + P_10 * Jd_01)).matrix().transpose();
+      out_jacobians_point->row(1) = (fv() * (P_00 * Jd_10 + P_10 * Jd_11)).matrix().transpose();
+      out_jacobians_point->row(2) = (fu() * (P_10 * Jd_00 + P_11 * Jd_01)).matrix().transpose();
+      out_jacobians_point->row(3) = (fv() * (P_10 * Jd_10 + P_11 * Jd_11)).matrix().transpose();
+      out_jacobians_point->row(4) = (fu() * (P_02 * Jd_00 + P_12 * Jd_01)).matrix().transpose();
+      out_jacobians_point->row(5) = (fv() * (P_02 * Jd_10 + P_12 * Jd_11)).matrix().transpose();
+    }
+
+    if (out_jacobians_intrinsics) {
+      // Column-major 2x5 Jacobians wrt. xi, fu, fv, cu and cv.
+      const Eigen::ArrayXd Jxi_0 = -x * rz * d * rz;
+      const Eigen::ArrayXd Jxi_1 = -y * rz * d * rz;
+      out_jacobians_intrinsics->setZero(2 * kNumOfParams, num_points);
+      out_jacobians_intrinsics->row(0) =
+          (fu() * (Jd_00 * Jxi_0 + Jd_01 * Jxi_1)).matrix().transpose();
+      out_jacobians_intrinsics->row(1) =
+          (fv() * (Jd_10 * Jxi_0 + Jd_11 * Jxi_1)).matrix().transpose();
+      out_jacobians_intrinsics->row(2) = out_keypoints->row(0);
+      out_jacobians_intrinsics->row(5) = out_keypoints->row(1);
+      out_jacobians_intrinsics->row(6).setOnes();
+      out_jacobians_intrinsics->row(9).setOnes();
+    }
+  }
+
+  out_keypoints->row(0) = (out_keypoints->row(0).array() * fu() + cu()).matrix();
+  out_keypoints->row(1) = (out_keypoints->row(1).array() * fv() + cv()).matrix();
+
+  out_results->resize(num_points);
+  for (int i = 0; i < num_points; ++i) {
+    if (valid_proj[i]) {
+      (*out_results)[i] = evaluateProjectionResult(out_keypoints->col(i), points_3d.col(i));
+    } else {
+      out_keypoints->col(i).setZero();
+      (*out_results)[i] = ProjectionResult(ProjectionResult::Status::PROJECTION_INVALID);
+    }
+    if ((*out_results)[i].getDetailedStatus() == ProjectionResult::Status::PROJECTION_INVALID) {
+      if (out_jacobians_point) {
+        out_jacobians_point->col(i).setZero();
+      }
+      if (out_jacobians_intrinsics) {
+        out_jacobians_intrinsics->col(i).setZero();
+      }
+    }
+  }
+}
+
 const ProjectionResult UnifiedProjectionCamera::project3Functional(
     const Eigen::Ref<const Eigen::Vector3d>& point_3d,
     const Eigen::VectorXd* intrinsics_external,
@@ -0,0 +1,236 @@
+#include <aslam/cameras/camera-visibility-cone.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+#include <glog/logging.h>
+#include <opencv2/core/core.hpp>
+
+#include <aslam/cameras/camera.h>
+
+namespace aslam {
+namespace {
+/// Are the points inside a cone given their dot products with the axis and squared distances
+/// to the apex, without square roots.
+inline Eigen::Array<bool, 1, Eigen::Dynamic> isInsideCone(
+    const Eigen::Array<double, 1, Eigen::Dynamic>& dots,
+    const Eigen::Array<double, 1, Eigen::Dynamic>& squared_norms, double cos_half_angle) {
+  const double cos_half_angle_pw2 = cos_half_angle * cos_half_angle;
+  if (cos_half_angle >= 0.0) {
+    return dots >= 0.0 && dots * dots >= cos_half_angle_pw2 * squared_norms;
+  }
+  return dots >= 0.0 || dots * dots <= cos_half_angle_pw2 * squared_norms;
+}
+
+/// Cell coordinates packed into one key, 21 bits per axis.
+constexpr int64_t kCellCoordinateOffset = int64_t(1) << 20;
+
+inline int64_t getCellKey(const Eigen::Vector3d& point, double cell_size) {
+  int64_t key = 0;
+  for (int axis = 0; axis < 3; ++axis) {
+    const int64_t coordinate =
+        static_cast<int64_t>(std::floor(point(axis) / cell_size)) + kCellCoordinateOffset;
+    CHECK_GE(coordinate, 0) << "Point " << point.transpose() << " is too far from the origin.";
+    CHECK_LT(coordinate, 2 * kCellCoordinateOffset)
+        << "Point " << point.transpose() << " is too far from the origin.";
+    key = (key << 21) | coordinate;
+  }
+  return key;
+}
+}  // namespace
+
+constexpr int CameraVisibilityCone::kNumBorderSamples;
+
+CameraVisibilityCone::CameraVisibilityCone()
+    : CameraVisibilityCone(Eigen::Vector3d::UnitZ(), M_PI) {}
+
+CameraVisibilityCone::CameraVisibilityCone(const Eigen::Vector3d& axis_C, double half_angle)
+    : axis_C_(axis_C.normalized()), half_angle_(std::min(half_angle, M_PI)),
+      cos_half_angle_(std::cos(half_angle_)) {
+  CHECK_GE(half_angle, 0.0);
+}
+
+CameraVisibilityCone::CameraVisibilityCone(const Camera& camera)
+    : CameraVisibilityCone() {
+  // The region of the image with unmasked pixels.
+  cv::Rect region(0, 0, camera.imageWidth(), camera.imageHeight());
+  if (camera.hasMask()) {
+    std::vector<cv::Point> unmasked_pixels;
+    cv::findNonZero(camera.getMask(), unmasked_pixels);
+    if (unmasked_pixels.empty()) {
+      // Nothing is visible.
+      half_angle_ = 0.0;
+      cos_half_angle_ = 1.0;
+      return;
+    }
+    int u_min = camera.imageWidth(), u_max = 0, v_min = camera.imageHeight(), v_max = 0;
+    for (const cv::Point& pixel : unmasked_pixels) {
+      u_min = std::min(u_min, pixel.x);
+      u_max = std::max(u_max, pixel.x);
+      v_min = std::min(v_min, pixel.y);
+      v_max = std::max(v_max, pixel.y);
+    }
+    region = cv::Rect(u_min, v_min, u_max - u_min + 1, v_max - v_min + 1);
+  }
+  const double u_min = region.x;
+  const double u_max = region.x + region.width;
+  const double v_min = region.y;
+  const double v_max = region.y + region.height;
+
+  // Border keypoints in order around the region.
+  Eigen::Matrix2Xd keypoints(2, 4 * kNumBorderSamples);
+  for (int i = 0; i < kNumBorderSamples; ++i) {
+    const double s = static_cast<double>(i) / kNumBorderSamples;
+    keypoints.col(i) << u_min + s * (u_max - u_min), v_min;
+    keypoints.col(kNumBorderSamples + i) << u_max, v_min + s * (v_max - v_min);
+    keypoints.col(2 * kNumBorderSamples + i) << u_max - s * (u_max - u_min), v_max;
+    keypoints.col(3 * kNumBorderSamples + i) << u_min, v_max - s * (v_max - v_min);
+  }
+  Eigen::Matrix3Xd bearings;
+  std::vector<unsigned char> success;
+  camera.backProject3Vectorized(keypoints, &bearings, &success);
+  if (std::find(success.begin(), success.end(), 0u) != success.end()) {
+    // The border can not be bounded, don't cull anything.
+    LOG(WARNING) << "Could not back-project the image border of camera " << camera.getLabel()
+        << ", its visibility cone does not cull any point.";
+    return;
+  }
+  bearings.colwise().normalize();
+
+  Eigen::Vector3d axis_C;
+  const Eigen::Vector2d center(0.5 * (u_min + u_max), 0.5 * (v_min + v_max));
+  if (!camera.backProject3(center, &axis_C)) {
+    axis_C = bearings.rowwise().sum();
+  }
+  axis_C_ = axis_C.normalized();
+
+  // The bearings between two border samples deviate from the axis by at most the angle between
+  // the samples more than the samples themselves.
+  double max_angle = 0.0;
+  double max_sample_spacing = 0.0;
+  for (int i = 0; i < bearings.cols(); ++i) {
+    const Eigen::Vector3d& bearing = bearings.col(i);
+    const Eigen::Vector3d& next_bearing = bearings.col((i + 1) % bearings.cols());
+    max_angle = std::max(max_angle, std::acos(std::min(1.0, axis_C_.dot(bearing))));
+    max_sample_spacing = std::max(
+        max_sample_spacing, std::acos(std::min(1.0, bearing.dot(next_bearing))));
+  }
+  half_angle_ = std::min(M_PI, max_angle + max_sample_spacing);
+  cos_half_angle_ = std::cos(half_angle_);
+}
+
+bool CameraVisibilityCone::mayBeVisible(const Eigen::Vector3d& point_C) const {
+  const double dot = axis_C_.dot(point_C);
+  const double cos_half_angle_pw2 = cos_half_angle_ * cos_half_angle_;
+  if (cos_half_angle_ >= 0.0) {
+    return dot >= 0.0 && dot * dot >= cos_half_angle_pw2 * point_C.squaredNorm();
+  }
+  return dot >= 0.0 || dot * dot <= cos_half_angle_pw2 * point_C.squaredNorm();
+}
+
+void CameraVisibilityCone::mayBeVisibleVectorized(
+    const Eigen::Ref<const Eigen::Matrix3Xd>& points_C,
+    std::vector<unsigned char>* out_may_be_visible) const {
+  CHECK_NOTNULL(out_may_be_visible);
+  const Eigen::Array<bool, 1, Eigen::Dynamic> is_inside = isInsideCone(
+      (axis_C_.transpose() * points_C).array(), points_C.colwise().squaredNorm().array(),
+      cos_half_angle_);
+  out_may_be_visible->resize(points_C.cols());
+  for (int i = 0; i < points_C.cols(); ++i) {
+    (*out_may_be_visible)[i] = is_inside(i) ? 1u : 0u;
+  }
+}
+
+void CameraVisibilityCone::getCandidates(
+    const Eigen::Ref<const Eigen::Matrix3Xd>& points_G, const Transformation& T_C_G,
+    std::vector<int>* candidate_indices) const {
+  CHECK_NOTNULL(candidate_indices)->clear();
+  const Eigen::Matrix3d R_G_C = T_C_G.getRotationMatrix().transpose();
+  const Eigen::Vector3d axis_G = R_G_C * axis_C_;
+  const Eigen::Vector3d p_G_C = -R_G_C * T_C_G.getPosition();
+  const Eigen::Matrix3Xd rays_G = points_G.colwise() - p_G_C;
+  const Eigen::Array<bool, 1, Eigen::Dynamic> is_inside = isInsideCone(
+      (axis_G.transpose() * rays_G).array(), rays_G.colwise().squaredNorm().array(),
+      cos_half_angle_);
+  candidate_indices->reserve(is_inside.count());
+  for (int i = 0; i < points_G.cols(); ++i) {
+    if (is_inside(i)) {
+      candidate_indices->push_back(i);
+    }
+  }
+}
+
+bool CameraVisibilityCone::intersectsSphere(const Eigen::Vector3d& center_C,
+                                            double radius) const {
+  const double distance = center_C.norm();
+  if (distance <= radius || half_angle_ >= M_PI) {
+    return true;
+  }
+  const double angle_to_axis = std::acos(std::max(-1.0, std::min(1.0,
+      axis_C_.dot(center_C) / distance)));
+  return angle_to_axis - std::asin(radius / distance) <= half_angle_;
+}
+
+LandmarkSpatialHash::LandmarkSpatialHash(const Eigen::Ref<const Eigen::Matrix3Xd>& points_G,
+                                         double cell_size)
+    : cell_size_(cell_size), points_G_(points_G) {
+  CHECK_GT(cell_size_, 0.0);
+  const int num_points = static_cast<int>(points_G_.cols());
+  std::unordered_map<int64_t, int> key_to_cell;
+  std::vector<int> point_cells(num_points);
+  std::vector<Eigen::Vector3d> cell_corners;
+  for (int i = 0; i < num_points; ++i) {
+    const int64_t key = getCellKey(points_G_.col(i), cell_size_);
+    const std::pair<std::unordered_map<int64_t, int>::iterator, bool> inserted =
+        key_to_cell.emplace(key, static_cast<int>(cell_corners.size()));
+    if (inserted.second) {
+      cell_corners.emplace_back(
+          (points_G_.col(i) / cell_size_).array().floor().matrix() * cell_size_);
+    }
+    point_cells[i] = inserted.first->second;
+  }
+
+  const int num_cells = static_cast<int>(cell_corners.size());
+  cell_centers_G_.resize(Eigen::NoChange, num_cells);
+  for (int cell = 0; cell < num_cells; ++cell) {
+    cell_centers_G_.col(cell) =
+        cell_corners[cell] + Eigen::Vector3d::Constant(0.5 * cell_size_);
+  }
+  cell_begin_.assign(num_cells + 1, 0);
+  for (const int cell : point_cells) {
+    ++cell_begin_[cell + 1];
+  }
+  for (int cell = 0; cell < num_cells; ++cell) {
+    cell_begin_[cell + 1] += cell_begin_[cell];
+  }
+  sorted_indices_.resize(num_points);
+  std::vector<int> cell_fill(cell_begin_.begin(), cell_begin_.end() - 1);
+  for (int i = 0; i < num_points; ++i) {
+    sorted_indices_[cell_fill[point_cells[i]]++] = i;
+  }
+}
+
+void LandmarkSpatialHash::getCandidates(
+    const CameraVisibilityCone& cone, const Transformation& T_C_G,
+    std::vector<int>* candidate_indices) const {
+  CHECK_NOTNULL(candidate_indices)->clear();
+  const Eigen::Matrix3d R_C_G = T_C_G.getRotationMatrix();
+  const Eigen::Vector3d p_C_G = T_C_G.getPosition();
+  // Radius of the sphere around a cell.
+  const double cell_radius = 0.5 * std::sqrt(3.0) * cell_size_;
+  for (int cell = 0; cell < cell_centers_G_.cols(); ++cell) {
+    if (!cone.intersectsSphere(R_C_G * cell_centers_G_.col(cell) + p_C_G, cell_radius)) {
+      continue;
+    }
+    for (int i = cell_begin_[cell]; i < cell_begin_[cell + 1]; ++i) {
+      const int index = sorted_indices_[i];
+      if (cone.mayBeVisible(R_C_G * points_G_.col(index) + p_C_G)) {
+        candidate_indices->push_back(index);
+      }
+    }
+  }
+}
+
+}  // namespace aslam
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <memory>
 
 #include <glog/logging.h>
@@ -200,6 +203,171 @@ void Camera::project3Vectorized(
   }
 }
 
+void Camera::project3VectorizedWithJacobians(
+    const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d, Eigen::Matrix2Xd* out_keypoints,
+    Eigen::Matrix<double, 6, Eigen::Dynamic>* out_jacobians_point,
+    Eigen::MatrixXd* out_jacobians_intrinsics,
+    std::vector<ProjectionResult>* out_results) const {
+  CHECK_NOTNULL(out_keypoints);
+  CHECK_NOTNULL(out_results);
+  const int num_points = points_3d.cols();
+  const int num_params = getParameterSize();
+  out_keypoints->resize(Eigen::NoChange, num_points);
+  out_results->resize(num_points, ProjectionResult::Status::UNINITIALIZED);
+  if (out_jacobians_point) {
+    out_jacobians_point->resize(Eigen::NoChange, num_points);
+  }
+  if (out_jacobians_intrinsics) {
+    out_jacobians_intrinsics->resize(2 * num_params, num_points);
+  }
+
+  Eigen::Vector2d projection;
+  Eigen::Matrix<double, 2, 3> J_point;
+  Eigen::Matrix<double, 2, Eigen::Dynamic> J_intrinsics;
+  for (int i = 0; i < num_points; ++i) {
+    J_point.setZero();
+    (*out_results)[i] = project3Functional(
+        points_3d.col(i), nullptr, nullptr, &projection,
+        out_jacobians_point ? &J_point : nullptr,
+        out_jacobians_intrinsics ? &J_intrinsics : nullptr, nullptr);
+    out_keypoints->col(i) = projection;
+    const bool is_valid =
+        (*out_results)[i].getDetailedStatus() != ProjectionResult::Status::PROJECTION_INVALID;
+    if (out_jacobians_point) {
+      Eigen::Map<Eigen::Matrix<double, 2, 3>>(out_jacobians_point->col(i).data()) =
+          is_valid ? J_point : Eigen::Matrix<double, 2, 3>::Zero();
+    }
+    if (out_jacobians_intrinsics) {
+      Eigen::Map<Eigen::Matrix<double, 2, Eigen::Dynamic>> J(
+          out_jacobians_intrinsics->col(i).data(), 2, num_params);
+      if (is_valid) {
+        J = J_intrinsics;
+      } else {
+        J.setZero();
+      }
+    }
+  }
+}
+
+void Camera::project3Batch(const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d,
+                           const ProjectionJacobianBuffers& buffers) const {
+  CHECK_NOTNULL(buffers.keypoints);
+  CHECK_NOTNULL(buffers.results);
+  const int num_params = getParameterSize();
+  const int num_distortion_params = distortion_->getParameterSize();
+
+  Eigen::Vector2d keypoint;
+  Eigen::Matrix<double, 2, 3> J_point;
+  Eigen::Matrix<double, 2, Eigen::Dynamic> J_intrinsics(2, num_params);
+  Eigen::Matrix<double, 2, Eigen::Dynamic> J_distortion(2, num_distortion_params);
+  for (int i = 0; i < points_3d.cols(); ++i) {
+    const ProjectionResult result = project3Functional(
+        points_3d.col(i), nullptr, nullptr, &keypoint,
+        buffers.jacobians_point ? &J_point : nullptr,
+        buffers.jacobians_intrinsics ? &J_intrinsics : nullptr,
+        buffers.jacobians_distortion ? &J_distortion : nullptr);
+    Eigen::Map<Eigen::Vector2d>(buffers.keypoints + 2 * i) = keypoint;
+    buffers.results[i] = result;
+
+    const bool is_valid =
+        result.getDetailedStatus() != ProjectionResult::Status::PROJECTION_INVALID;
+    if (buffers.jacobians_point) {
+      Eigen::Map<Eigen::Matrix<double, 2, 3>> J(buffers.jacobians_point + 6 * i);
+      if (is_valid) {
+        J = J_point;
+      } else {
+        J.setZero();
+      }
+    }
+    if (buffers.jacobians_intrinsics) {
+      Eigen::Map<Eigen::Matrix<double, 2, Eigen::Dynamic>> J(
+          buffers.jacobians_intrinsics + 2 * num_params * i, 2, num_params);
+      if (is_valid) {
+        J = J_intrinsics;
+      } else {
+        J.setZero();
+      }
+    }
+    if (buffers.jacobians_distortion) {
+      Eigen::Map<Eigen::Matrix<double, 2, Eigen::Dynamic>> J(
+          buffers.jacobians_distortion + 2 * num_distortion_params * i, 2,
+          num_distortion_params);
+      if (is_valid) {
+        J = J_distortion;
+      } else {
+        J.setZero();
+      }
+    }
+  }
+}
+
+void Camera::project3RollingShutterVectorized(
+    const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d,
+    const Eigen::Vector3d& linear_velocity_C, const Eigen::Vector3d& angular_velocity_C,
+    int num_iterations, Eigen::Matrix2Xd* out_keypoints,
+    Eigen::Matrix<double, 6, Eigen::Dynamic>* out_jacobians_point,
+    std::vector<ProjectionResult>* out_results) const {
+  CHECK_NOTNULL(out_keypoints);
+  CHECK_NOTNULL(out_results);
+  CHECK_GE(num_iterations, 1);
+  const int num_points = points_3d.cols();
+  const double line_delay_seconds = static_cast<double>(line_delay_nanoseconds_) * 1e-9;
+  if (line_delay_seconds == 0.0) {
+    project3VectorizedWithJacobians(points_3d, out_keypoints, out_jacobians_point, nullptr,
+                                    out_results);
+    return;
+  }
+
+  // The points move with -(w x p + v) relative to the camera.
+  Eigen::Matrix3d skew_angular_velocity;
+  skew_angular_velocity << 0.0, -angular_velocity_C.z(), angular_velocity_C.y(),
+                           angular_velocity_C.z(), 0.0, -angular_velocity_C.x(),
+                           -angular_velocity_C.y(), angular_velocity_C.x(), 0.0;
+  Eigen::Matrix3Xd point_velocities = skew_angular_velocity * points_3d;
+  point_velocities.colwise() += linear_velocity_C;
+
+  // Readout times of the rows, clamped to the image such that points leaving it stay finite.
+  const double max_row = static_cast<double>(imageHeight());
+  Eigen::RowVectorXd row_times = Eigen::RowVectorXd::Zero(num_points);
+  Eigen::Array<bool, 1, Eigen::Dynamic> is_row_clamped =
+      Eigen::Array<bool, 1, Eigen::Dynamic>::Constant(1, num_points, false);
+  Eigen::Matrix3Xd moved_points(3, num_points);
+  for (int iteration = 0; iteration < num_iterations; ++iteration) {
+    moved_points = points_3d - point_velocities * row_times.asDiagonal();
+    const bool is_last_iteration = iteration + 1 == num_iterations;
+    project3VectorizedWithJacobians(
+        moved_points, out_keypoints, is_last_iteration ? out_jacobians_point : nullptr, nullptr,
+        out_results);
+    if (!is_last_iteration) {
+      const Eigen::Array<double, 1, Eigen::Dynamic> rows = out_keypoints->row(1).array();
+      is_row_clamped = rows < 0.0 || rows > max_row;
+      row_times = line_delay_seconds * rows.max(0.0).min(max_row).matrix();
+    }
+  }
+  if (out_jacobians_point == nullptr || num_iterations == 1) {
+    // A single iteration is the global shutter projection.
+    return;
+  }
+
+  // At the fixed point, the keypoint k = pi(p - t (w x p + v)) with t = line delay * k_y, hence
+  // dk/dp = A + b (dk_y/dp) with A = J_pi (I - t [w]x) and b = -J_pi (w x p + v) line delay.
+  for (int i = 0; i < num_points; ++i) {
+    Eigen::Map<Eigen::Matrix<double, 2, 3>> J(out_jacobians_point->col(i).data());
+    const Eigen::Matrix<double, 2, 3> J_projection = J;
+    J -= row_times(i) * J_projection * skew_angular_velocity;
+    if (is_row_clamped(i)) {
+      continue;
+    }
+    const Eigen::Vector2d J_row_time =
+        -line_delay_seconds * J_projection * point_velocities.col(i);
+    const double denominator = 1.0 - J_row_time(1);
+    if (std::abs(denominator) > std::numeric_limits<double>::epsilon()) {
+      const Eigen::Matrix<double, 1, 3> J_row = J.row(1) / denominator;
+      J += J_row_time * J_row;
+    }
+  }
+}
+
 void Camera::backProject3Vectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints,
                                     Eigen::Matrix3Xd* out_points_3d,
                                     std::vector<unsigned char>* out_success) const {
@@ -214,15 +382,84 @@ void Camera::backProject3Vectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& ke
   }
 }
 
+constexpr int Camera::kMaskTileSize;
+
 void Camera::setMask(const cv::Mat& mask) {
   CHECK_EQ(image_height_, static_cast<size_t>(mask.rows));
   CHECK_EQ(image_width_, static_cast<size_t>(mask.cols));
   CHECK_EQ(mask.type(), CV_8UC1);
   mask_ = mask;
+  markParametersChanged();
+
+  // Pack the mask into bits and summarize the tiles, such that isMasked only reads the mask
+  // for tiles which are partially masked.
+  const int num_words_per_row = getNumMaskWordsPerRow();
+  const int num_tile_rows = (mask_.rows + kMaskTileSize - 1) / kMaskTileSize;
+  mask_bits_.assign(static_cast<size_t>(mask_.rows) * num_words_per_row, 0u);
+  std::vector<int> num_masked_pixels(num_tile_rows * num_words_per_row, 0);
+  for (int v = 0; v < mask_.rows; ++v) {
+    const uint8_t* mask_row = mask_.ptr<uint8_t>(v);
+    uint64_t* bits_row = mask_bits_.data() + v * num_words_per_row;
+    int* num_masked_pixels_row =
+        num_masked_pixels.data() + (v / kMaskTileSize) * num_words_per_row;
+    for (int u = 0; u < mask_.cols; ++u) {
+      if (mask_row[u] == 0) {
+        bits_row[u / kMaskTileSize] |= uint64_t{1} << (u % kMaskTileSize);
+        ++num_masked_pixels_row[u / kMaskTileSize];
+      }
+    }
+  }
+
+  mask_tile_states_.resize(num_masked_pixels.size());
+  for (int tile_row = 0; tile_row < num_tile_rows; ++tile_row) {
+    const int tile_height = std::min(kMaskTileSize, mask_.rows - tile_row * kMaskTileSize);
+    for (int tile_col = 0; tile_col < num_words_per_row; ++tile_col) {
+      const int tile_width = std::min(kMaskTileSize, mask_.cols - tile_col * kMaskTileSize);
+      const int tile_index = tile_row * num_words_per_row + tile_col;
+      if (num_masked_pixels[tile_index] == 0) {
+        mask_tile_states_[tile_index] = MaskTileState::kValid;
+      } else if (num_masked_pixels[tile_index] == tile_width * tile_height) {
+        mask_tile_states_[tile_index] = MaskTileState::kMasked;
+      } else {
+        mask_tile_states_[tile_index] = MaskTileState::kMixed;
+      }
+    }
+  }
 }
 
 void Camera::clearMask() {
   mask_ = cv::Mat();
+  markParametersChanged();
+  mask_bits_.clear();
+  mask_tile_states_.clear();
+}
+
+void Camera::project3VectorizedFloat(
+    const Eigen::Ref<const Eigen::Matrix3Xf>& points_3d, Eigen::Matrix2Xf* out_keypoints,
+    std::vector<ProjectionResult>* out_results) const {
+  CHECK_NOTNULL(out_keypoints);
+  Eigen::Matrix2Xd keypoints;
+  project3Vectorized(points_3d.cast<double>(), &keypoints, out_results);
+  *out_keypoints = keypoints.cast<float>();
+}
+
+void Camera::backProject3VectorizedFloat(
+    const Eigen::Ref<const Eigen::Matrix2Xf>& keypoints, Eigen::Matrix3Xf* out_points_3d,
+    std::vector<unsigned char>* out_success) const {
+  CHECK_NOTNULL(out_points_3d);
+  Eigen::Matrix3Xd points_3d;
+  backProject3Vectorized(keypoints.cast<double>(), &points_3d, out_success);
+  *out_points_3d = points_3d.cast<float>();
+}
+
+void Camera::isMaskedVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints,
+                                std::vector<unsigned char>* out_masked) const {
+  CHECK_NOTNULL(out_masked);
+  const int num_keypoints = keypoints.cols();
+  out_masked->resize(num_keypoints);
+  for (int i = 0; i < num_keypoints; ++i) {
+    (*out_masked)[i] = isMasked(keypoints.col(i));
+  }
 }
 
 bool Camera::hasMask() const {
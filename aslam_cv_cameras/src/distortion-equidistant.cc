@@ -1,6 +1,38 @@
 #include <aslam/cameras/distortion-equidistant.h>
 
+#include <cmath>
+#include <memory>
+
 namespace aslam {
+
+namespace {
+/// Number of tabulated incidence angles of the inverse table.
+constexpr size_t kNumInverseTableSamples = 2048u;
+
+/// The distorted radius thetad(theta) = theta * (1 + k1 theta^2 + k2 theta^4 + k3 theta^6 +
+/// k4 theta^8) of the incidence angle theta and its derivative.
+inline double computeThetad(const Eigen::VectorXd& dist_coeffs, double theta,
+                            double* dthetad_dtheta) {
+  const double k1 = dist_coeffs(0);
+  const double k2 = dist_coeffs(1);
+  const double k3 = dist_coeffs(2);
+  const double k4 = dist_coeffs(3);
+  const double theta2 = theta * theta;
+  *dthetad_dtheta =
+      1.0 + theta2 * (3.0 * k1 + theta2 * (5.0 * k2 + theta2 * (7.0 * k3 + theta2 * 9.0 * k4)));
+  return theta * (1.0 + theta2 * (k1 + theta2 * (k2 + theta2 * (k3 + theta2 * k4))));
+}
+
+/// The inverse table last used by the scalar undistortion on this thread, such that the cache
+/// of the distortion is only locked if the parameters changed. Equal versions imply equal
+/// coefficients, also across distortions, hence the version identifies the table.
+struct ThreadInverseTable {
+  ParameterVersion version = 0u;
+  std::shared_ptr<const RadialInverseTable> table;
+};
+thread_local ThreadInverseTable thread_inverse_table;
+}  // namespace
+
 std::ostream& operator<<(std::ostream& out, const EquidistantDistortion& distortion) {
   distortion.printParameters(out, std::string(""));
   return out;
@@ -106,6 +138,53 @@ void EquidistantDistortion::distortUsingExternalCoefficients(
   y *= scaling;
 }
 
+void EquidistantDistortion::distortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                              Eigen::Matrix2Xd* out_points,
+                                              Eigen::Matrix4Xd* out_jacobians) const {
+  CHECK_NOTNULL(out_points);
+  CHECK_EQ(distortion_coefficients_.size(), kNumOfParams) << "dist_coeffs: invalid size!";
+
+  const double k1 = distortion_coefficients_(0);
+  const double k2 = distortion_coefficients_(1);
+  const double k3 = distortion_coefficients_(2);
+  const double k4 = distortion_coefficients_(3);
+
+  const Eigen::ArrayXd x = points.row(0).transpose().array();
+  const Eigen::ArrayXd y = points.row(1).transpose().array();
+
+  const Eigen::ArrayXd r2 = x.square() + y.square();
+  const Eigen::ArrayXd r = r2.sqrt();
+  const Eigen::ArrayXd theta = r.atan();
+  const Eigen::ArrayXd theta2 = theta.square();
+  const Eigen::ArrayXd thetad =
+      theta * (1.0 + theta2 * (k1 + theta2 * (k2 + theta2 * (k3 + theta2 * k4))));
+
+  // Points close to the image center remain unchanged, like in the scalar version.
+  const Eigen::Array<bool, Eigen::Dynamic, 1> is_off_center = r > 1e-8;
+  const Eigen::ArrayXd scaling = is_off_center.select(thetad / r, 1.0);
+
+  if (out_jacobians) {
+    // The model scales the point radially by s(r) = thetad / r, hence
+    // J = s * I + ds/dr * p * p^T / r, with dthetad/dr = dthetad/dtheta / (1 + r^2).
+    // Unlike the scalar version, which returns zero, the Jacobian at the center is the identity.
+    const Eigen::ArrayXd dthetad_dr =
+        (1.0 + theta2 * (3.0 * k1 + theta2 * (5.0 * k2 + theta2 * (7.0 * k3 + theta2 * 9.0 * k4))))
+        / (1.0 + r2);
+    const Eigen::ArrayXd dscaling_dr_over_r =
+        is_off_center.select((dthetad_dr * r - thetad) / (r2 * r), 0.0);
+    const Eigen::ArrayXd duf_dv = dscaling_dr_over_r * x * y;
+    out_jacobians->resize(Eigen::NoChange, x.size());
+    out_jacobians->row(0) = (scaling + dscaling_dr_over_r * x.square()).matrix().transpose();
+    out_jacobians->row(1) = duf_dv.matrix().transpose();
+    out_jacobians->row(2) = duf_dv.matrix().transpose();
+    out_jacobians->row(3) = (scaling + dscaling_dr_over_r * y.square()).matrix().transpose();
+  }
+
+  out_points->resize(Eigen::NoChange, x.size());
+  out_points->row(0) = (x * scaling).matrix().transpose();
+  out_points->row(1) = (y * scaling).matrix().transpose();
+}
+
 void EquidistantDistortion::distortParameterJacobian(
     const Eigen::VectorXd* dist_coeffs,
     const Eigen::Vector2d& point,
@@ -149,14 +228,41 @@ void EquidistantDistortion::undistortUsingExternalCoefficients(const Eigen::Vect
   const int n = 30;  // Max. number of iterations
 
   Eigen::Vector2d& y = *point;
-  Eigen::Vector2d ybar = y;
-  Eigen::Matrix2d F;
-  Eigen::Vector2d y_tmp;
 
   // Handle special case around image center.
   if (y.squaredNorm() < 1e-6)
     return; // Point remains unchanged.
 
+  // Solve thetad(theta) = r_d for the incidence angle, starting at the tabulated inverse.
+  const double r_d = y.norm();
+  if (dist_coeffs == distortion_coefficients_) {
+    const ParameterVersion version = getParameterVersion();
+    if (thread_inverse_table.version != version) {
+      thread_inverse_table.table = getInverseTable();
+      thread_inverse_table.version = version;
+    }
+    const RadialInverseTable& inverse_table = *thread_inverse_table.table;
+    if (inverse_table.isInRange(r_d)) {
+      double theta = inverse_table.lookup(r_d);
+      double dthetad_dtheta;
+      int i;
+      for (i = 0; i < n; ++i) {
+        const double e = r_d - computeThetad(dist_coeffs, theta, &dthetad_dtheta);
+        theta += e / dthetad_dtheta;
+        if (e * e <= FLAGS_acv_inv_distortion_tolerance)
+          break;
+      }
+      LOG_IF(WARNING, i >= n) << "Did not converge with max. iterations.";
+      y *= std::tan(theta) / r_d;
+      return;
+    }
+  }
+
+  // Points beyond the table and external coefficients solve the full 2d problem.
+  Eigen::Vector2d ybar = y;
+  Eigen::Matrix2d F;
+  Eigen::Vector2d y_tmp;
+
   int i;
   for (i = 0; i < n; ++i) {
     y_tmp = ybar;
@@ -172,6 +278,69 @@ void EquidistantDistortion::undistortUsingExternalCoefficients(const Eigen::Vect
   y = ybar;
 }
 
+void EquidistantDistortion::undistortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                                Eigen::Matrix2Xd* out_points,
+                                                Eigen::Matrix4Xd* out_jacobians) const {
+  CHECK_NOTNULL(out_points);
+  CHECK_EQ(distortion_coefficients_.size(), kNumOfParams) << "dist_coeffs: invalid size!";
+
+  const int n = 30;  // Max. number of iterations
+
+  const double k1 = distortion_coefficients_(0);
+  const double k2 = distortion_coefficients_(1);
+  const double k3 = distortion_coefficients_(2);
+  const double k4 = distortion_coefficients_(3);
+
+  const Eigen::ArrayXd x = points.row(0).transpose().array();
+  const Eigen::ArrayXd y = points.row(1).transpose().array();
+
+  // The distorted radius equals thetad, solve thetad(theta) = r_d for the incidence angle.
+  const Eigen::ArrayXd r_d2 = x.square() + y.square();
+  const Eigen::ArrayXd r_d = r_d2.sqrt();
+  Eigen::Array<bool, Eigen::Dynamic, 1> is_active = r_d2 >= 1e-6;
+
+  // Start at the tabulated inverse, which converges in about one step. Points beyond the table
+  // start at theta = r_d.
+  const std::shared_ptr<const RadialInverseTable> inverse_table = getInverseTable();
+  Eigen::ArrayXd theta(r_d.size());
+  for (int i = 0; i < r_d.size(); ++i) {
+    theta(i) = inverse_table->isInRange(r_d(i)) ? inverse_table->lookup(r_d(i)) : r_d(i);
+  }
+
+  for (int i = 0; i < n && is_active.any(); ++i) {
+    const Eigen::ArrayXd theta2 = theta.square();
+    const Eigen::ArrayXd e =
+        r_d - theta * (1.0 + theta2 * (k1 + theta2 * (k2 + theta2 * (k3 + theta2 * k4))));
+    const Eigen::ArrayXd dthetad_dtheta =
+        1.0 + theta2 * (3.0 * k1 + theta2 * (5.0 * k2 + theta2 * (7.0 * k3 + theta2 * 9.0 * k4)));
+    theta = is_active.select(theta + e / dthetad_dtheta, theta);
+    is_active = is_active && (e.square() > FLAGS_acv_inv_distortion_tolerance);
+  }
+  LOG_IF(WARNING, is_active.any()) << is_active.count() << " points did not converge with max. "
+      << "iterations.";
+
+  // Handle special case around image center: the point remains unchanged.
+  const Eigen::ArrayXd scaling = (r_d2 < 1e-6).select(1.0, theta.tan() / r_d);
+
+  out_points->resize(Eigen::NoChange, x.size());
+  out_points->row(0) = (x * scaling).matrix().transpose();
+  out_points->row(1) = (y * scaling).matrix().transpose();
+  if (out_jacobians) {
+    computeUndistortionJacobiansVectorized(*out_points, out_jacobians);
+  }
+}
+
+std::shared_ptr<const RadialInverseTable> EquidistantDistortion::getInverseTable() const {
+  return inverse_table_.get(getParameterVersion(), [this]() {
+    const Eigen::VectorXd dist_coeffs = distortion_coefficients_;
+    // The incidence angle of points in front of the camera is below 90 degrees.
+    return std::make_shared<const RadialInverseTable>(
+        [dist_coeffs](double theta, double* dthetad_dtheta) {
+          return computeThetad(dist_coeffs, theta, dthetad_dtheta);
+        }, 0.5 * M_PI, kNumInverseTableSamples);
+  });
+}
+
 bool EquidistantDistortion::areParametersValid(const Eigen::VectorXd& parameters) {
   // Check the vector size.
   if (parameters.size() != kNumOfParams)
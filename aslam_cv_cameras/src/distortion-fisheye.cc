@@ -79,6 +79,52 @@ void FisheyeDistortion::distortUsingExternalCoefficients(const Eigen::VectorXd*
   *point *= r_rd;
 }
 
+void FisheyeDistortion::distortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                          Eigen::Matrix2Xd* out_points,
+                                          Eigen::Matrix4Xd* out_jacobians) const {
+  CHECK_NOTNULL(out_points);
+  CHECK_EQ(distortion_coefficients_.size(), kNumOfParams) << "dist_coeffs: invalid size!";
+
+  const double w = distortion_coefficients_(0);
+  if (w * w < 1e-5) {
+    // Limit w > 0: the model is the identity.
+    *out_points = points;
+    if (out_jacobians) {
+      out_jacobians->resize(Eigen::NoChange, points.cols());
+      out_jacobians->colwise() = Eigen::Vector4d(1.0, 0.0, 0.0, 1.0);
+    }
+    return;
+  }
+  const double tanwhalf = tan(w / 2.);
+
+  const Eigen::ArrayXd x = points.row(0).transpose().array();
+  const Eigen::ArrayXd y = points.row(1).transpose().array();
+
+  const Eigen::ArrayXd r_u2 = x.square() + y.square();
+  const Eigen::ArrayXd r_u = r_u2.sqrt();
+  const Eigen::ArrayXd atan_wrd = (2. * tanwhalf * r_u).atan();
+  // Limit r_u > 0: the coordinates get multiplied by an expression not depending on r_u.
+  const Eigen::Array<bool, Eigen::Dynamic, 1> is_off_center = r_u2 >= 1e-5;
+  const Eigen::ArrayXd r_rd = is_off_center.select(atan_wrd / (r_u * w), 2. * tanwhalf / w);
+
+  if (out_jacobians) {
+    // Radial model: J = r_rd * I + d(r_rd)/dr * p * p^T / r.
+    const Eigen::ArrayXd dr_rd_dr_over_r = is_off_center.select(
+        (2. * tanwhalf * r_u / (4. * tanwhalf * tanwhalf * r_u2 + 1.) - atan_wrd)
+            / (w * r_u2 * r_u), 0.0);
+    const Eigen::ArrayXd duf_dv = dr_rd_dr_over_r * x * y;
+    out_jacobians->resize(Eigen::NoChange, x.size());
+    out_jacobians->row(0) = (r_rd + dr_rd_dr_over_r * x.square()).matrix().transpose();
+    out_jacobians->row(1) = duf_dv.matrix().transpose();
+    out_jacobians->row(2) = duf_dv.matrix().transpose();
+    out_jacobians->row(3) = (r_rd + dr_rd_dr_over_r * y.square()).matrix().transpose();
+  }
+
+  out_points->resize(Eigen::NoChange, x.size());
+  out_points->row(0) = (x * r_rd).matrix().transpose();
+  out_points->row(1) = (y * r_rd).matrix().transpose();
+}
+
 void FisheyeDistortion::distortParameterJacobian(const Eigen::VectorXd* dist_coeffs,
                                                  const Eigen::Vector2d& point,
                                                  Eigen::Matrix<double, 2, Eigen::Dynamic>* out_jacobian) const {
@@ -142,6 +188,41 @@ void FisheyeDistortion::undistortUsingExternalCoefficients(const Eigen::VectorXd
   (*point) *= r_u;
 }
 
+void FisheyeDistortion::undistortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                            Eigen::Matrix2Xd* out_points,
+                                            Eigen::Matrix4Xd* out_jacobians) const {
+  CHECK_NOTNULL(out_points);
+  CHECK_EQ(distortion_coefficients_.size(), kNumOfParams) << "dist_coeffs: invalid size!";
+
+  const double w = distortion_coefficients_(0);
+  const double mul2tanwby2 = tan(w / 2.0) * 2.0;
+  if (mul2tanwby2 == 0) {
+    *out_points = points;
+    if (out_jacobians) {
+      computeUndistortionJacobiansVectorized(*out_points, out_jacobians);
+    }
+    return;
+  }
+
+  const Eigen::ArrayXd x = points.row(0).transpose().array();
+  const Eigen::ArrayXd y = points.row(1).transpose().array();
+
+  // Points at the center or beyond the maximal valid angle remain unchanged, like in the scalar
+  // version.
+  const Eigen::ArrayXd r_d = (x.square() + y.square()).sqrt();
+  const Eigen::ArrayXd r_dw = r_d * w;
+  const double max_valid_angle = kMaxValidAngle;
+  const Eigen::ArrayXd r_u = (r_d == 0.0 || r_dw.abs() > max_valid_angle)
+      .select(1.0, r_dw.tan() / (r_d * mul2tanwby2));
+
+  out_points->resize(Eigen::NoChange, x.size());
+  out_points->row(0) = (x * r_u).matrix().transpose();
+  out_points->row(1) = (y * r_u).matrix().transpose();
+  if (out_jacobians) {
+    computeUndistortionJacobiansVectorized(*out_points, out_jacobians);
+  }
+}
+
 bool FisheyeDistortion::areParametersValid(const Eigen::VectorXd& parameters) {
   // Check the vector size.
   if (parameters.size() != kNumOfParams)
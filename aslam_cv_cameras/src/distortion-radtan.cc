@@ -17,51 +17,95 @@ void RadTanDistortion::distortUsingExternalCoefficients(
     Eigen::Matrix2d* out_jacobian) const {
   CHECK_NOTNULL(point);
 
-  double& x = (*point)(0);
-  double& y = (*point)(1);
-
   // Use internal params if dist_coeffs==nullptr
   if(!dist_coeffs)
     dist_coeffs = &distortion_coefficients_;
   CHECK_EQ(dist_coeffs->size(), kNumOfParams) << "dist_coeffs: invalid size!";
 
-  const double& k1 = (*dist_coeffs)(0); // The first radial distortion parameter.
-  const double& k2 = (*dist_coeffs)(1); // The second radial distortion parameter.
-  const double& p1 = (*dist_coeffs)(2); // The first tangential distortion parameter.
-  const double& p2 = (*dist_coeffs)(3); // The second tangential distortion parameter.
+  if (out_jacobian) {
+    distortPoint<true>(*dist_coeffs, point, out_jacobian);
+  } else {
+    distortPoint<false>(*dist_coeffs, point, nullptr);
+  }
+}
+
+void RadTanDistortion::distortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                         Eigen::Matrix2Xd* out_points,
+                                         Eigen::Matrix4Xd* out_jacobians) const {
+  CHECK_NOTNULL(out_points);
+  CHECK_EQ(distortion_coefficients_.size(), kNumOfParams) << "dist_coeffs: invalid size!";
+
+  // Copy the coordinates into contiguous arrays such that Eigen can use packet math.
+  const Eigen::ArrayXd x = points.row(0).transpose().array();
+  const Eigen::ArrayXd y = points.row(1).transpose().array();
+  Eigen::ArrayXd x_distorted, y_distorted;
+
+  out_points->resize(Eigen::NoChange, x.size());
+  if (out_jacobians) {
+    Eigen::ArrayXd duf_du, duf_dv, dvf_dv;
+    distortArrays<double>(distortion_coefficients_, x, y, &x_distorted, &y_distorted,
+                          &duf_du, &duf_dv, &dvf_dv);
+    out_jacobians->resize(Eigen::NoChange, x.size());
+    out_jacobians->row(0) = duf_du.matrix().transpose();
+    out_jacobians->row(1) = duf_dv.matrix().transpose();
+    out_jacobians->row(2) = duf_dv.matrix().transpose();
+    out_jacobians->row(3) = dvf_dv.matrix().transpose();
+  } else {
+    distortArrays<double>(distortion_coefficients_, x, y, &x_distorted, &y_distorted,
+                          nullptr, nullptr, nullptr);
+  }
+  out_points->row(0) = x_distorted.matrix().transpose();
+  out_points->row(1) = y_distorted.matrix().transpose();
+}
 
-  double mx2_u = x * x;
-  double my2_u = y * y;
-  double mxy_u = x * y;
-  double rho2_u = mx2_u + my2_u;
-  double rad_dist_u = k1 * rho2_u + k2 * rho2_u * rho2_u;
+void RadTanDistortion::distortVectorizedFloat(const Eigen::Ref<const Eigen::Matrix2Xf>& points,
+                                              Eigen::Matrix2Xf* out_points) const {
+  CHECK_NOTNULL(out_points);
+  CHECK_EQ(distortion_coefficients_.size(), kNumOfParams) << "dist_coeffs: invalid size!";
+  const Eigen::ArrayXf x = points.row(0).transpose().array();
+  const Eigen::ArrayXf y = points.row(1).transpose().array();
+  Eigen::ArrayXf x_distorted, y_distorted;
+  distortArrays<float>(distortion_coefficients_, x, y, &x_distorted, &y_distorted,
+                       nullptr, nullptr, nullptr);
+  out_points->resize(Eigen::NoChange, x.size());
+  out_points->row(0) = x_distorted.matrix().transpose();
+  out_points->row(1) = y_distorted.matrix().transpose();
+}
 
-  if (out_jacobian) {
-    const double duf_du =   1.0 + rad_dist_u
-                          + 2.0 * k1 * mx2_u
-                          + 4.0 * k2 * rho2_u * mx2_u
-                          + 2.0 * p1 * y
-                          + 6.0 * p2 * x;
-
-    const double duf_dv =   2.0 * k1 * mxy_u
-                          + 4.0 * k2 * rho2_u * mxy_u
-                          + 2.0 * p1 * x
-                          + 2.0 * p2 * y;
-
-    const double dvf_du = duf_dv;
-
-    const double dvf_dv =   1.0 + rad_dist_u
-                          + 2.0 * k1 * my2_u
-                          + 4.0 * k2 * rho2_u * my2_u
-                          + 2.0 * p2 * x
-                          + 6.0 * p1 * y;
-
-    *out_jacobian << duf_du, duf_dv,
-                     dvf_du, dvf_dv;
+template <typename ScalarType>
+void RadTanDistortion::distortArrays(const Eigen::VectorXd& dist_coeffs,
+                                     const Array<ScalarType>& x, const Array<ScalarType>& y,
+                                     Array<ScalarType>* x_distorted,
+                                     Array<ScalarType>* y_distorted,
+                                     Array<ScalarType>* duf_du, Array<ScalarType>* duf_dv,
+                                     Array<ScalarType>* dvf_dv) {
+  CHECK_NOTNULL(x_distorted);
+  CHECK_NOTNULL(y_distorted);
+  const ScalarType k1 = static_cast<ScalarType>(dist_coeffs(0));
+  const ScalarType k2 = static_cast<ScalarType>(dist_coeffs(1));
+  const ScalarType p1 = static_cast<ScalarType>(dist_coeffs(2));
+  const ScalarType p2 = static_cast<ScalarType>(dist_coeffs(3));
+  const ScalarType one(1), two(2), four(4), six(6);
+
+  const Array<ScalarType> mx2_u = x.square();
+  const Array<ScalarType> my2_u = y.square();
+  const Array<ScalarType> mxy_u = x * y;
+  const Array<ScalarType> rho2_u = mx2_u + my2_u;
+  const Array<ScalarType> rad_dist_u = k1 * rho2_u + k2 * rho2_u.square();
+
+  if (duf_du) {
+    // The Jacobian is symmetric, hence dvf_du equals duf_dv.
+    CHECK_NOTNULL(duf_dv);
+    CHECK_NOTNULL(dvf_dv);
+    *duf_du = one + rad_dist_u + two * k1 * mx2_u + four * k2 * rho2_u * mx2_u
+        + two * p1 * y + six * p2 * x;
+    *duf_dv = two * k1 * mxy_u + four * k2 * rho2_u * mxy_u + two * p1 * x + two * p2 * y;
+    *dvf_dv = one + rad_dist_u + two * k1 * my2_u + four * k2 * rho2_u * my2_u
+        + two * p2 * x + six * p1 * y;
   }
 
-  x += x * rad_dist_u + 2.0 * p1 * mxy_u + p2 * (rho2_u + 2.0 * mx2_u);
-  y += y * rad_dist_u + 2.0 * p2 * mxy_u + p1 * (rho2_u + 2.0 * my2_u);
+  *x_distorted = x + x * rad_dist_u + two * p1 * mxy_u + p2 * (rho2_u + two * mx2_u);
+  *y_distorted = y + y * rad_dist_u + two * p2 * mxy_u + p1 * (rho2_u + two * my2_u);
 }
 
 void RadTanDistortion::distortParameterJacobian(
@@ -71,29 +115,21 @@ void RadTanDistortion::distortParameterJacobian(
   CHECK_EQ(dist_coeffs->size(), kNumOfParams) << "dist_coeffs: invalid size!";
   CHECK_NOTNULL(out_jacobian);
 
-  const double& y0 = point(0);
-  const double& y1 = point(1);
-  const double r2 = y0 * y0 + y1 * y1;
-  const double r4 = r2 * r2;
-
-  const double duf_dk1 = y0 * r2;
-  const double duf_dk2 = y0 * r4;
-  const double duf_dp1 = 2.0 * y0 * y1;
-  const double duf_dp2 = r2 + 2.0 * y0 * y0;
-  const double dvf_dk1 = y1 * r2;
-  const double dvf_dk2 = y1 * r4;
-  const double dvf_dp1 = r2 + 2.0 * y1 * y1;
-  const double dvf_dp2 = 2.0 * y0 * y1;
-
-  out_jacobian->resize(2, kNumOfParams);
-  (*out_jacobian) << duf_dk1, duf_dk2, duf_dp1, duf_dp2,
-                     dvf_dk1, dvf_dk2, dvf_dp1, dvf_dp2;
+  Eigen::Matrix<double, 2, kNumOfParams> jacobian;
+  distortParameterJacobianPoint(point, &jacobian);
+  *out_jacobian = jacobian;
 }
 
 void RadTanDistortion::undistortUsingExternalCoefficients(const Eigen::VectorXd& dist_coeffs,
                                                           Eigen::Vector2d* point) const {
   CHECK_EQ(dist_coeffs.size(), kNumOfParams) << "dist_coeffs: invalid size!";
   CHECK_NOTNULL(point);
+  undistortPoint(dist_coeffs, point);
+}
+
+void RadTanDistortion::undistortPoint(const Eigen::Matrix<double, kNumOfParams, 1>& dist_coeffs,
+                                      Eigen::Vector2d* point) {
+  CHECK_NOTNULL(point);
 
   const int n = 30;  // Max. number of iterations
 
@@ -105,7 +141,7 @@ void RadTanDistortion::undistortUsingExternalCoefficients(const Eigen::VectorXd&
   int i;
   for (i = 0; i < n; ++i) {
     y_tmp = ybar;
-    distortUsingExternalCoefficients(&dist_coeffs, &y_tmp, &F);
+    distortPoint<true>(dist_coeffs, &y_tmp, &F);
     Eigen::Vector2d e(y - y_tmp);
     Eigen::Vector2d du = (F.transpose() * F).inverse() * F.transpose() * e;
     ybar += du;
@@ -117,6 +153,74 @@ void RadTanDistortion::undistortUsingExternalCoefficients(const Eigen::VectorXd&
   y = ybar;
 }
 
+void RadTanDistortion::undistortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                           Eigen::Matrix2Xd* out_points,
+                                           Eigen::Matrix4Xd* out_jacobians) const {
+  CHECK_NOTNULL(out_points);
+  CHECK_EQ(distortion_coefficients_.size(), kNumOfParams) << "dist_coeffs: invalid size!";
+
+  const Eigen::ArrayXd x = points.row(0).transpose().array();
+  const Eigen::ArrayXd y = points.row(1).transpose().array();
+  Eigen::ArrayXd x_bar, y_bar;
+  undistortArrays<double>(distortion_coefficients_, x, y, &x_bar, &y_bar);
+
+  out_points->resize(Eigen::NoChange, x.size());
+  out_points->row(0) = x_bar.matrix().transpose();
+  out_points->row(1) = y_bar.matrix().transpose();
+  if (out_jacobians) {
+    computeUndistortionJacobiansVectorized(*out_points, out_jacobians);
+  }
+}
+
+void RadTanDistortion::undistortVectorizedFloat(const Eigen::Ref<const Eigen::Matrix2Xf>& points,
+                                                Eigen::Matrix2Xf* out_points) const {
+  CHECK_NOTNULL(out_points);
+  CHECK_EQ(distortion_coefficients_.size(), kNumOfParams) << "dist_coeffs: invalid size!";
+
+  const Eigen::ArrayXf x = points.row(0).transpose().array();
+  const Eigen::ArrayXf y = points.row(1).transpose().array();
+  Eigen::ArrayXf x_bar, y_bar;
+  undistortArrays<float>(distortion_coefficients_, x, y, &x_bar, &y_bar);
+
+  out_points->resize(Eigen::NoChange, x.size());
+  out_points->row(0) = x_bar.matrix().transpose();
+  out_points->row(1) = y_bar.matrix().transpose();
+}
+
+template <typename ScalarType>
+void RadTanDistortion::undistortArrays(const Eigen::VectorXd& dist_coeffs,
+                                       const Array<ScalarType>& x, const Array<ScalarType>& y,
+                                       Array<ScalarType>* x_undistorted,
+                                       Array<ScalarType>* y_undistorted) {
+  CHECK_NOTNULL(x_undistorted);
+  CHECK_NOTNULL(y_undistorted);
+  const int n = 30;  // Max. number of iterations
+  const ScalarType tolerance = static_cast<ScalarType>(FLAGS_acv_inv_distortion_tolerance);
+
+  Array<ScalarType>& x_bar = *x_undistorted;
+  Array<ScalarType>& y_bar = *y_undistorted;
+  x_bar = x;
+  y_bar = y;
+  Array<ScalarType> x_tmp, y_tmp, duf_du, duf_dv, dvf_dv;
+  Eigen::Array<bool, Eigen::Dynamic, 1> is_active =
+      Eigen::Array<bool, Eigen::Dynamic, 1>::Constant(x.size(), true);
+
+  // All points take the same steps, the points that already converged keep their estimate.
+  for (int i = 0; i < n && is_active.any(); ++i) {
+    distortArrays<ScalarType>(dist_coeffs, x_bar, y_bar, &x_tmp, &y_tmp,
+                              &duf_du, &duf_dv, &dvf_dv);
+    const Array<ScalarType> e_x = x - x_tmp;
+    const Array<ScalarType> e_y = y - y_tmp;
+    // Solve F * du = e with the closed form inverse of the symmetric 2x2 Jacobian F.
+    const Array<ScalarType> inverse_determinant = (duf_du * dvf_dv - duf_dv.square()).inverse();
+    x_bar = is_active.select(x_bar + (dvf_dv * e_x - duf_dv * e_y) * inverse_determinant, x_bar);
+    y_bar = is_active.select(y_bar + (duf_du * e_y - duf_dv * e_x) * inverse_determinant, y_bar);
+    is_active = is_active && (e_x.square() + e_y.square() > tolerance);
+  }
+  LOG_IF(WARNING, is_active.any()) << is_active.count() << " points did not converge with max. "
+      << "iterations.";
+}
+
 bool RadTanDistortion::areParametersValid(const Eigen::VectorXd& parameters) {
   // Just check the vector size.
   if (parameters.size() != kNumOfParams)
@@ -62,9 +62,85 @@ void Distortion::undistort(const Eigen::Vector2d& point,
   undistortUsingExternalCoefficients(distortion_coefficients_, out_point);
 }
 
+void Distortion::distortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                   Eigen::Matrix2Xd* out_points,
+                                   Eigen::Matrix4Xd* out_jacobians) const {
+  CHECK_NOTNULL(out_points);
+  *out_points = points;
+  if (out_jacobians) {
+    out_jacobians->resize(Eigen::NoChange, points.cols());
+  }
+  Eigen::Vector2d point;
+  Eigen::Matrix2d jacobian;
+  for (int i = 0; i < out_points->cols(); ++i) {
+    point = out_points->col(i);
+    if (out_jacobians) {
+      distortUsingExternalCoefficients(nullptr, &point, &jacobian);
+      Eigen::Map<Eigen::Matrix2d>(out_jacobians->col(i).data()) = jacobian;
+    } else {
+      distortUsingExternalCoefficients(nullptr, &point, nullptr);
+    }
+    out_points->col(i) = point;
+  }
+}
+
+void Distortion::undistortVectorized(const Eigen::Ref<const Eigen::Matrix2Xd>& points,
+                                     Eigen::Matrix2Xd* out_points,
+                                     Eigen::Matrix4Xd* out_jacobians) const {
+  CHECK_NOTNULL(out_points);
+  *out_points = points;
+  Eigen::Vector2d point;
+  for (int i = 0; i < out_points->cols(); ++i) {
+    point = out_points->col(i);
+    undistortUsingExternalCoefficients(distortion_coefficients_, &point);
+    out_points->col(i) = point;
+  }
+  if (out_jacobians) {
+    computeUndistortionJacobiansVectorized(*out_points, out_jacobians);
+  }
+}
+
+void Distortion::distortVectorizedFloat(const Eigen::Ref<const Eigen::Matrix2Xf>& points,
+                                        Eigen::Matrix2Xf* out_points) const {
+  CHECK_NOTNULL(out_points);
+  Eigen::Matrix2Xd distorted_points;
+  distortVectorized(points.cast<double>(), &distorted_points, nullptr);
+  *out_points = distorted_points.cast<float>();
+}
+
+void Distortion::undistortVectorizedFloat(const Eigen::Ref<const Eigen::Matrix2Xf>& points,
+                                          Eigen::Matrix2Xf* out_points) const {
+  CHECK_NOTNULL(out_points);
+  Eigen::Matrix2Xd undistorted_points;
+  undistortVectorized(points.cast<double>(), &undistorted_points, nullptr);
+  *out_points = undistorted_points.cast<float>();
+}
+
+void Distortion::computeUndistortionJacobiansVectorized(
+    const Eigen::Matrix2Xd& undistorted_points, Eigen::Matrix4Xd* out_jacobians) const {
+  CHECK_NOTNULL(out_jacobians);
+  Eigen::Matrix2Xd distorted_points;
+  Eigen::Matrix4Xd distortion_jacobians;
+  distortVectorized(undistorted_points, &distorted_points, &distortion_jacobians);
+
+  // Closed form inverse of the column-major 2x2 matrices [a c; b d].
+  const Eigen::ArrayXd a = distortion_jacobians.row(0).transpose().array();
+  const Eigen::ArrayXd b = distortion_jacobians.row(1).transpose().array();
+  const Eigen::ArrayXd c = distortion_jacobians.row(2).transpose().array();
+  const Eigen::ArrayXd d = distortion_jacobians.row(3).transpose().array();
+  const Eigen::ArrayXd inverse_determinant = (a * d - b * c).inverse();
+
+  out_jacobians->resize(Eigen::NoChange, undistorted_points.cols());
+  out_jacobians->row(0) = (d * inverse_determinant).matrix().transpose();
+  out_jacobians->row(1) = (-b * inverse_determinant).matrix().transpose();
+  out_jacobians->row(2) = (-c * inverse_determinant).matrix().transpose();
+  out_jacobians->row(3) = (a * inverse_determinant).matrix().transpose();
+}
+
 void Distortion::setParameters(const Eigen::VectorXd& dist_coeffs) {
   CHECK(distortionParametersValid(dist_coeffs)) << "Distortion parameters invalid!";
   distortion_coefficients_ = dist_coeffs;
+  markParametersChanged();
 }
 
 }  // namespace aslam
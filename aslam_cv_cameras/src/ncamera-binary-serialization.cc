@@ -0,0 +1,223 @@
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <opencv2/core/core.hpp>
+
+#include <aslam/cameras/binary-calibration.h>
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/camera-factory.h>
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/camera-unified-projection.h>
+#include <aslam/cameras/distortion-equidistant.h>
+#include <aslam/cameras/distortion-fisheye.h>
+#include <aslam/cameras/distortion-null.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+
+namespace aslam {
+
+namespace {
+void writeId(const HashId& id, binary_calibration::PayloadWriter* writer) {
+  CHECK_NOTNULL(writer);
+  uint64_t id_words[2];
+  id.toUint64(id_words);
+  writer->write(id_words);
+}
+
+bool readId(binary_calibration::PayloadReader* reader, HashId* id) {
+  CHECK_NOTNULL(reader);
+  CHECK_NOTNULL(id);
+  uint64_t id_words[2];
+  if (!reader->read(&id_words)) {
+    return false;
+  }
+  id->fromUint64(id_words);
+  return id->isValid();
+}
+
+void writeCamera(const Camera& camera, const Transformation& T_C_B,
+                 binary_calibration::PayloadWriter* writer) {
+  CHECK_NOTNULL(writer);
+  writeId(camera.getId(), writer);
+  writer->writeString(camera.getLabel());
+  writer->write(static_cast<int32_t>(camera.getType()));
+  writer->write(camera.imageWidth());
+  writer->write(camera.imageHeight());
+  writer->write(camera.getLineDelayNanoSeconds());
+  writer->writeVector(camera.getParameters());
+  writer->write(static_cast<int32_t>(camera.getDistortion().getType()));
+  writer->writeVector(camera.getDistortion().getParameters());
+
+  // The quaternion is stored instead of the matrix, it is restored without any rounding.
+  const double T_C_B_raw[7] = {
+      T_C_B.getRotation().w(), T_C_B.getRotation().x(), T_C_B.getRotation().y(),
+      T_C_B.getRotation().z(), T_C_B.getPosition()[0], T_C_B.getPosition()[1],
+      T_C_B.getPosition()[2]};
+  writer->write(T_C_B_raw);
+
+  writer->write(static_cast<uint8_t>(camera.hasMask()));
+  if (camera.hasMask()) {
+    const cv::Mat& mask = camera.getMask();
+    const cv::Mat mask_continuous = mask.isContinuous() ? mask : mask.clone();
+    writer->writeBytes(mask_continuous.data, mask_continuous.total());
+  }
+}
+
+bool areCameraParametersValid(Camera::Type camera_type, const Eigen::VectorXd& intrinsics) {
+  switch (camera_type) {
+    case Camera::Type::kPinhole:
+      return PinholeCamera::areParametersValid(intrinsics);
+    case Camera::Type::kUnifiedProjection:
+      return UnifiedProjectionCamera::areParametersValid(intrinsics);
+    default:
+      return false;
+  }
+}
+
+bool areDistortionParametersValid(Distortion::Type distortion_type,
+                                  const Eigen::VectorXd& distortion_parameters) {
+  switch (distortion_type) {
+    case Distortion::Type::kNoDistortion:
+      return NullDistortion::areParametersValid(distortion_parameters);
+    case Distortion::Type::kEquidistant:
+      return EquidistantDistortion::areParametersValid(distortion_parameters);
+    case Distortion::Type::kFisheye:
+      return FisheyeDistortion::areParametersValid(distortion_parameters);
+    case Distortion::Type::kRadTan:
+      return RadTanDistortion::areParametersValid(distortion_parameters);
+    default:
+      return false;
+  }
+}
+
+/// Returns a nullptr if the payload doesn't hold a valid camera.
+Camera::Ptr readCamera(binary_calibration::PayloadReader* reader, Transformation* T_C_B) {
+  CHECK_NOTNULL(reader);
+  CHECK_NOTNULL(T_C_B);
+  CameraId id;
+  std::string label;
+  int32_t camera_type;
+  uint32_t image_width;
+  uint32_t image_height;
+  uint64_t line_delay_nano_seconds;
+  Eigen::VectorXd intrinsics;
+  int32_t distortion_type;
+  Eigen::VectorXd distortion_parameters;
+  double T_C_B_raw[7];
+  uint8_t has_mask;
+  if (!readId(reader, &id) || !reader->readString(&label) || !reader->read(&camera_type) ||
+      !reader->read(&image_width) || !reader->read(&image_height) ||
+      !reader->read(&line_delay_nano_seconds) || !reader->readVector(&intrinsics) ||
+      !reader->read(&distortion_type) || !reader->readVector(&distortion_parameters) ||
+      !reader->read(&T_C_B_raw) || !reader->read(&has_mask)) {
+    LOG(ERROR) << "The camera data is truncated.";
+    return Camera::Ptr();
+  }
+  if (!areCameraParametersValid(static_cast<Camera::Type>(camera_type), intrinsics) ||
+      !areDistortionParametersValid(static_cast<Distortion::Type>(distortion_type),
+                                    distortion_parameters)) {
+    LOG(ERROR) << "Invalid parameters of the camera " << id.hexString() << ".";
+    return Camera::Ptr();
+  }
+  const Eigen::Vector4d q_C_B_raw(T_C_B_raw[0], T_C_B_raw[1], T_C_B_raw[2], T_C_B_raw[3]);
+  if (std::abs(q_C_B_raw.squaredNorm() - 1.0) > 1e-9) {
+    LOG(ERROR) << "Invalid extrinsics of the camera " << id.hexString() << ".";
+    return Camera::Ptr();
+  }
+
+  Camera::Ptr camera = createCamera(
+      id, intrinsics, image_width, image_height, distortion_parameters,
+      static_cast<Camera::Type>(camera_type), static_cast<Distortion::Type>(distortion_type));
+  CHECK(camera);
+  camera->setLabel(label);
+  camera->setLineDelayNanoSeconds(line_delay_nano_seconds);
+  if (has_mask) {
+    const size_t mask_size_bytes = static_cast<size_t>(image_width) * image_height;
+    const char* mask_data = reader->readView(mask_size_bytes);
+    if (mask_data == nullptr) {
+      LOG(ERROR) << "The mask of the camera " << id.hexString() << " is truncated.";
+      return Camera::Ptr();
+    }
+    // Copy the mask out of the payload, it must not depend on the lifetime of the file.
+    camera->setMask(cv::Mat(image_height, image_width, CV_8UC1,
+                            const_cast<char*>(mask_data)).clone());
+  }
+  *T_C_B = Transformation(
+      Quaternion(T_C_B_raw[0], T_C_B_raw[1], T_C_B_raw[2], T_C_B_raw[3]),
+      Eigen::Vector3d(T_C_B_raw[4], T_C_B_raw[5], T_C_B_raw[6]));
+  return camera;
+}
+}  // namespace
+
+NCamera::Ptr NCamera::loadFromBinary(const std::string& binary_file) {
+  BinaryCalibrationReader reader;
+  if (!reader.openFile(binary_file)) {
+    return NCamera::Ptr();
+  }
+  const char* data;
+  size_t size_bytes;
+  if (!reader.getSection(binary_calibration::kNCameraSection, 0u, &data, &size_bytes)) {
+    LOG(ERROR) << "The calibration file " << binary_file << " doesn't contain a camera rig.";
+    return NCamera::Ptr();
+  }
+  return deserializeFromBinary(data, size_bytes);
+}
+
+NCamera::Ptr NCamera::deserializeFromBinary(const char* data, size_t size_bytes) {
+  binary_calibration::PayloadReader reader(data, size_bytes);
+  NCameraId id;
+  std::string label;
+  uint64_t num_cameras;
+  if (!readId(&reader, &id) || !reader.readString(&label) || !reader.read(&num_cameras)) {
+    LOG(ERROR) << "The camera rig data is truncated.";
+    return NCamera::Ptr();
+  }
+  if (num_cameras == 0u) {
+    LOG(ERROR) << "Number of cameras is 0.";
+    return NCamera::Ptr();
+  }
+
+  TransformationVector T_C_B;
+  std::vector<Camera::Ptr> cameras;
+  for (uint64_t camera_index = 0u; camera_index < num_cameras; ++camera_index) {
+    Transformation T_Ci_B;
+    Camera::Ptr camera = readCamera(&reader, &T_Ci_B);
+    if (!camera) {
+      LOG(ERROR) << "Unable to decode camera " << camera_index << ".";
+      return NCamera::Ptr();
+    }
+    T_C_B.emplace_back(T_Ci_B);
+    cameras.emplace_back(camera);
+  }
+  if (reader.getNumRemainingBytes() != 0u) {
+    LOG(ERROR) << "Unexpected data behind the camera rig.";
+    return NCamera::Ptr();
+  }
+  return aligned_shared<NCamera>(id, T_C_B, cameras, label);
+}
+
+bool NCamera::saveToBinary(const std::string& binary_file) const {
+  std::vector<char> payload;
+  serializeToBinary(&payload);
+  BinaryCalibrationWriter writer;
+  writer.addSection(binary_calibration::kNCameraSection, 0u, std::move(payload));
+  return writer.writeToFile(binary_file);
+}
+
+void NCamera::serializeToBinary(std::vector<char>* payload) const {
+  CHECK_NOTNULL(payload)->clear();
+  binary_calibration::PayloadWriter writer(payload);
+  writeId(id_, &writer);
+  writer.writeString(label_);
+  writer.write(static_cast<uint64_t>(getNumCameras()));
+  for (size_t camera_index = 0u; camera_index < getNumCameras(); ++camera_index) {
+    writeCamera(getCamera(camera_index), get_T_C_B(camera_index), &writer);
+  }
+}
+
+}  // namespace aslam
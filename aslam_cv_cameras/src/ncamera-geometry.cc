@@ -0,0 +1,119 @@
+#include <aslam/cameras/ncamera-geometry.h>
+
+#include <glog/logging.h>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/ncamera.h>
+
+namespace aslam {
+
+constexpr int NCameraGeometry::kNumOverlapSamplesPerAxis;
+
+NCameraGeometry::NCameraGeometry(const NCamera& ncamera)
+    : num_cameras_(ncamera.getNumCameras()) {
+  T_B_C_.reserve(num_cameras_);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras_; ++camera_idx) {
+    T_B_C_.emplace_back(ncamera.get_T_C_B(camera_idx).inverse());
+    id_to_index_.emplace(ncamera.getCameraId(camera_idx), camera_idx);
+  }
+
+  T_Ci_Cj_.reserve(num_cameras_ * num_cameras_);
+  R_Ci_Cj_.reserve(num_cameras_ * num_cameras_);
+  for (size_t camera_idx_i = 0u; camera_idx_i < num_cameras_; ++camera_idx_i) {
+    const Transformation& T_Ci_B = ncamera.get_T_C_B(camera_idx_i);
+    for (size_t camera_idx_j = 0u; camera_idx_j < num_cameras_; ++camera_idx_j) {
+      T_Ci_Cj_.emplace_back(T_Ci_B * T_B_C_[camera_idx_j]);
+      R_Ci_Cj_.emplace_back(T_Ci_Cj_.back().getRotationMatrix());
+    }
+  }
+  computeOverlaps(ncamera);
+
+  visibility_cones_.reserve(num_cameras_);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras_; ++camera_idx) {
+    visibility_cones_.emplace_back(ncamera.getCamera(camera_idx));
+  }
+}
+
+void NCameraGeometry::computeOverlaps(const NCamera& ncamera) {
+  overlaps_.setIdentity(num_cameras_, num_cameras_);
+  Eigen::Matrix2Xd keypoints(2, kNumOverlapSamplesPerAxis * kNumOverlapSamplesPerAxis);
+  Eigen::Matrix3Xd bearings;
+  std::vector<unsigned char> backprojection_success;
+  Eigen::Matrix2Xd projected_keypoints;
+  std::vector<ProjectionResult> projection_results;
+
+  for (size_t camera_idx_j = 0u; camera_idx_j < num_cameras_; ++camera_idx_j) {
+    // Back-project the centers of a regular grid of image cells of camera j.
+    const Camera& camera_j = ncamera.getCamera(camera_idx_j);
+    const double cell_width = static_cast<double>(camera_j.imageWidth()) /
+        kNumOverlapSamplesPerAxis;
+    const double cell_height = static_cast<double>(camera_j.imageHeight()) /
+        kNumOverlapSamplesPerAxis;
+    for (int row = 0; row < kNumOverlapSamplesPerAxis; ++row) {
+      for (int col = 0; col < kNumOverlapSamplesPerAxis; ++col) {
+        keypoints.col(row * kNumOverlapSamplesPerAxis + col) <<
+            (col + 0.5) * cell_width, (row + 0.5) * cell_height;
+      }
+    }
+    camera_j.backProject3Vectorized(keypoints, &bearings, &backprojection_success);
+    size_t num_valid_bearings = 0u;
+    for (const unsigned char success : backprojection_success) {
+      num_valid_bearings += success ? 1u : 0u;
+    }
+    if (num_valid_bearings == 0u) {
+      LOG(WARNING) << "No keypoint of camera " << camera_idx_j << " could be back-projected.";
+      overlaps_(camera_idx_j, camera_idx_j) = 0.0;
+      continue;
+    }
+
+    for (size_t camera_idx_i = 0u; camera_idx_i < num_cameras_; ++camera_idx_i) {
+      if (camera_idx_i == camera_idx_j) {
+        continue;
+      }
+      ncamera.getCamera(camera_idx_i).project3Vectorized(
+          get_R_Ci_Cj(camera_idx_i, camera_idx_j) * bearings, &projected_keypoints,
+          &projection_results);
+      size_t num_visible = 0u;
+      for (size_t sample_idx = 0u; sample_idx < projection_results.size(); ++sample_idx) {
+        if (backprojection_success[sample_idx] &&
+            projection_results[sample_idx].isKeypointVisible()) {
+          ++num_visible;
+        }
+      }
+      overlaps_(camera_idx_i, camera_idx_j) =
+          static_cast<double>(num_visible) / num_valid_bearings;
+    }
+  }
+}
+
+const Transformation& NCameraGeometry::get_T_B_C(size_t camera_index) const {
+  CHECK_LT(camera_index, num_cameras_);
+  return T_B_C_[camera_index];
+}
+
+const Transformation& NCameraGeometry::get_T_Ci_Cj(size_t camera_index_i,
+                                                   size_t camera_index_j) const {
+  return T_Ci_Cj_[getPairIndex(camera_index_i, camera_index_j)];
+}
+
+const Eigen::Matrix3d& NCameraGeometry::get_R_Ci_Cj(size_t camera_index_i,
+                                                    size_t camera_index_j) const {
+  return R_Ci_Cj_[getPairIndex(camera_index_i, camera_index_j)];
+}
+
+int NCameraGeometry::getCameraIndex(const CameraId& id) const {
+  CHECK(id.isValid());
+  std::unordered_map<CameraId, size_t>::const_iterator it = id_to_index_.find(id);
+  if (it == id_to_index_.end()) {
+    return -1;
+  }
+  return static_cast<int>(it->second);
+}
+
+double NCameraGeometry::getOverlap(size_t camera_index_i, size_t camera_index_j) const {
+  CHECK_LT(camera_index_i, num_cameras_);
+  CHECK_LT(camera_index_j, num_cameras_);
+  return overlaps_(camera_index_i, camera_index_j);
+}
+
+}  // namespace aslam
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <string>
 #include <utility>
 
@@ -7,6 +8,7 @@
 #include <aslam/cameras/camera-pinhole.h>
 #include <aslam/cameras/distortion-radtan.h>
 #include <aslam/cameras/ncamera.h>
+#include <aslam/cameras/ncamera-geometry.h>
 #include <aslam/cameras/yaml/ncamera-yaml-serialization.h>
 #include <aslam/common/pose-types.h>
 #include <aslam/common/predicates.h>
@@ -86,6 +88,25 @@ void NCamera::initInternal() {
     CHECK(cameras_[i]->getId().isValid());
     id_to_index_[cameras_[i]->getId()] = i;
   }
+  markParametersChanged();
+}
+
+std::shared_ptr<const NCameraGeometry> NCamera::getGeometry() const {
+  return geometry_.get(getParameterVersion(), [this]() {
+    return std::make_shared<const NCameraGeometry>(*this);
+  });
+}
+
+ParameterVersion NCamera::getParameterVersion() const {
+  ParameterVersion version = parameter_version_;
+  for (const Camera::Ptr& camera : cameras_) {
+    version = std::max(version, camera->getParameterVersion());
+  }
+  return version;
+}
+
+void NCamera::markParametersChanged() {
+  parameter_version_ = getNextParameterVersion();
 }
 
 size_t NCamera::getNumCameras() const {
@@ -99,6 +120,7 @@ const Transformation& NCamera::get_T_C_B(size_t camera_index) const {
 
 Transformation& NCamera::get_T_C_B_Mutable(size_t camera_index) {
   CHECK_LT(camera_index, cameras_.size());
+  markParametersChanged();
   return T_C_B_[camera_index];
 }
 
@@ -121,6 +143,7 @@ Transformation& NCamera::get_T_C_B_Mutable(const CameraId& camera_id) {
 void NCamera::set_T_C_B(size_t camera_index, const Transformation& T_Ci_B) {
   CHECK_LT(camera_index, T_C_B_.size());
   T_C_B_[camera_index] = T_Ci_B;
+  markParametersChanged();
 }
 
 const TransformationVector& NCamera::getTransformationVector() const {
@@ -155,6 +178,7 @@ void NCamera::setCamera(size_t camera_index, Camera::Ptr camera) {
   id_to_index_.erase(cameras_[camera_index]->getId());
   cameras_[camera_index] = camera;
   id_to_index_[camera->getId()] = camera_index;
+  markParametersChanged();
 }
 
 size_t NCamera::numCameras() const {
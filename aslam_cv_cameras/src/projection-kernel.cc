@@ -0,0 +1,81 @@
+#include "aslam/cameras/projection-kernel.h"
+
+#include <algorithm>
+
+#include <aslam/common/pose-batch.h>
+
+namespace aslam {
+namespace {
+// Points per block of the fused transformation and projection.
+constexpr int kTransformBlockSize = 64;
+
+struct TransformAndProjectFunctor {
+  template <typename KernelType>
+  void operator()(const KernelType& kernel) const {
+    const int num_points = static_cast<int>(X_points->cols());
+    Eigen::Matrix<double, 3, kTransformBlockSize> C_points_block;
+    Eigen::Vector2d keypoint;
+    for (int block_start = 0; block_start < num_points; block_start += kTransformBlockSize) {
+      const int block_size = std::min(kTransformBlockSize, num_points - block_start);
+      internal::transformPointsKernel(R_C_X, C_t_C_X, X_points->col(block_start).data(),
+                                      block_size, C_points_block.data());
+      for (int block_idx = 0; block_idx < block_size; ++block_idx) {
+        const Eigen::Vector3d C_point = C_points_block.col(block_idx);
+        (*out_results)[block_start + block_idx] = kernel.project3(C_point, &keypoint);
+        out_keypoints->col(block_start + block_idx) = keypoint;
+      }
+    }
+  }
+
+  Eigen::Matrix3d R_C_X;
+  Eigen::Vector3d C_t_C_X;
+  const Eigen::Matrix3Xd* X_points;
+  Eigen::Matrix2Xd* out_keypoints;
+  std::vector<ProjectionResult>* out_results;
+};
+}  // namespace
+
+void transformAndProject3Vectorized(const Camera& camera, const Transformation& T_C_X,
+                                    const Eigen::Matrix3Xd& X_points,
+                                    Eigen::Matrix2Xd* out_keypoints,
+                                    std::vector<ProjectionResult>* out_results) {
+  CHECK_NOTNULL(out_keypoints);
+  CHECK_NOTNULL(out_results);
+  out_keypoints->resize(Eigen::NoChange, X_points.cols());
+  out_results->resize(X_points.cols());
+  TransformAndProjectFunctor functor{T_C_X.getRotationMatrix(), T_C_X.getPosition(), &X_points,
+                                     out_keypoints, out_results};
+  if (!visitProjectionKernel(camera, &functor)) {
+    Eigen::Matrix3Xd C_points;
+    transformPoints(T_C_X, X_points, &C_points);
+    camera.project3Vectorized(C_points, out_keypoints, out_results);
+  }
+}
+
+void transformAndProject3VectorizedFloat(const Camera& camera, const Transformation& T_C_X,
+                                         const Eigen::Matrix3Xf& X_points,
+                                         Eigen::Matrix2Xf* out_keypoints,
+                                         std::vector<ProjectionResult>* out_results) {
+  CHECK_NOTNULL(out_keypoints);
+  CHECK_NOTNULL(out_results);
+  const int num_points = static_cast<int>(X_points.cols());
+  out_keypoints->resize(Eigen::NoChange, num_points);
+  out_results->resize(num_points);
+  const Eigen::Matrix3f R_C_X = T_C_X.getRotationMatrix().cast<float>();
+  const Eigen::Vector3f C_t_C_X = T_C_X.getPosition().cast<float>();
+  Eigen::Matrix<float, 3, kTransformBlockSize> C_points_block;
+  Eigen::Matrix2Xf keypoints_block;
+  std::vector<ProjectionResult> results_block;
+  for (int block_start = 0; block_start < num_points; block_start += kTransformBlockSize) {
+    const int block_size = std::min(kTransformBlockSize, num_points - block_start);
+    internal::transformPointsKernel(R_C_X, C_t_C_X, X_points.col(block_start).data(), block_size,
+                                    C_points_block.data());
+    camera.project3VectorizedFloat(C_points_block.leftCols(block_size), &keypoints_block,
+                                   &results_block);
+    out_keypoints->middleCols(block_start, block_size) = keypoints_block;
+    std::copy(results_block.begin(), results_block.end(),
+              out_results->begin() + block_start);
+  }
+}
+
+}  // namespace aslam
@@ -0,0 +1,64 @@
+#include <aslam/cameras/radial-inverse-table.h>
+
+#include <glog/logging.h>
+
+namespace aslam {
+
+namespace {
+/// The defined range of the function is scanned with this many steps per tabulated value.
+constexpr size_t kNumScanStepsPerSample = 4u;
+/// Bisection steps per tabulated value, enough for double precision on unit intervals.
+constexpr int kNumBisectionSteps = 60;
+}  // namespace
+
+RadialInverseTable::RadialInverseTable(
+    const RadialFunction& function, double max_argument, size_t num_samples)
+    : max_value_(0.0), inverse_step_(0.0) {
+  CHECK(function);
+  CHECK_GT(max_argument, 0.0);
+  CHECK_GE(num_samples, 2u);
+
+  // Find the end of the increasing part of the function.
+  const size_t num_scan_steps = kNumScanStepsPerSample * num_samples;
+  double derivative;
+  double previous_value = function(0.0, &derivative);
+  CHECK_EQ(previous_value, 0.0) << "The radial function has to be zero at zero.";
+  double end_argument = 0.0;
+  for (size_t i = 1u; i <= num_scan_steps; ++i) {
+    const double argument = max_argument * static_cast<double>(i) / num_scan_steps;
+    const double value = function(argument, &derivative);
+    if (!(value > previous_value) || !(derivative > 0.0)) {
+      break;
+    }
+    previous_value = value;
+    end_argument = argument;
+  }
+  if (end_argument == 0.0) {
+    LOG(WARNING) << "The radial function does not increase, the table is empty.";
+    return;
+  }
+  max_value_ = previous_value;
+
+  // Invert the function at equidistant values by bisection on the increasing part, the
+  // arguments increase with the values.
+  arguments_.resize(num_samples);
+  arguments_.front() = 0.0;
+  arguments_.back() = end_argument;
+  for (size_t i = 1u; i + 1u < num_samples; ++i) {
+    const double value = max_value_ * static_cast<double>(i) / (num_samples - 1u);
+    double lower = arguments_[i - 1u];
+    double upper = end_argument;
+    for (int step = 0; step < kNumBisectionSteps; ++step) {
+      const double middle = 0.5 * (lower + upper);
+      if (function(middle, &derivative) < value) {
+        lower = middle;
+      } else {
+        upper = middle;
+      }
+    }
+    arguments_[i] = 0.5 * (lower + upper);
+  }
+  inverse_step_ = (num_samples - 1u) / max_value_;
+}
+
+}  // namespace aslam
@@ -0,0 +1,127 @@
+#include <cmath>
+#include <vector>
+
+#include <Eigen/Core>
+#include <eigen-checks/gtest.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/bearing-vector-lookup-table.h>
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/camera-unified-projection.h>
+#include <aslam/cameras/distortion-equidistant.h>
+#include <aslam/cameras/distortion-fisheye.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <aslam/common/entrypoint.h>
+
+namespace {
+double getAngle(const Eigen::Vector3d& lhs, const Eigen::Vector3d& rhs) {
+  return std::atan2(lhs.cross(rhs).norm(), lhs.dot(rhs));
+}
+
+/// Compares the table against the exact back-projection for random keypoints in and around
+/// the image.
+void checkLookupTable(const aslam::Camera::ConstPtr& camera, double cell_size_px,
+                      double max_angular_error) {
+  aslam::BearingVectorLookupTable lookup_table(camera, cell_size_px, 2u);
+  EXPECT_GT(lookup_table.getMaxAngularError(), 0.0);
+  EXPECT_LT(lookup_table.getMaxAngularError(), max_angular_error);
+
+  constexpr int kNumKeypoints = 10000;
+  Eigen::Matrix2Xd keypoints(2, kNumKeypoints);
+  for (int i = 0; i < kNumKeypoints; ++i) {
+    // 10% of the keypoints are outside of the image.
+    keypoints.col(i) = (i % 10 == 0) ?
+        Eigen::Vector2d(-10.0, camera->imageHeight() + 10.0) : camera->createRandomKeypoint();
+  }
+  Eigen::Matrix3Xd points_3d, exact_points_3d;
+  std::vector<unsigned char> success, exact_success;
+  lookup_table.backProject3Vectorized(keypoints, &points_3d, &success);
+  camera->backProject3Vectorized(keypoints, &exact_points_3d, &exact_success);
+  ASSERT_EQ(points_3d.cols(), kNumKeypoints);
+  ASSERT_EQ(success.size(), exact_success.size());
+
+  for (int i = 0; i < kNumKeypoints; ++i) {
+    EXPECT_EQ(success[i], exact_success[i]);
+    if (!success[i]) {
+      continue;
+    }
+    EXPECT_LT(getAngle(points_3d.col(i), exact_points_3d.col(i)), max_angular_error);
+    // Same scale as the exact bearing vectors.
+    EXPECT_NEAR(points_3d.col(i).norm() / exact_points_3d.col(i).norm(), 1.0, 1e-3);
+
+    Eigen::Vector3d point_3d;
+    EXPECT_TRUE(lookup_table.backProject3(keypoints.col(i), &point_3d));
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(point_3d, points_3d.col(i), 1e-9));
+  }
+}
+}  // namespace
+
+TEST(BearingVectorLookupTable, PinholeRadTan) {
+  checkLookupTable(aslam::PinholeCamera::createTestCamera<aslam::RadTanDistortion>(), 1.0, 1e-4);
+}
+
+TEST(BearingVectorLookupTable, PinholeEquidistant) {
+  checkLookupTable(
+      aslam::PinholeCamera::createTestCamera<aslam::EquidistantDistortion>(), 1.0, 1e-4);
+}
+
+TEST(BearingVectorLookupTable, UnifiedProjectionFisheye) {
+  checkLookupTable(
+      aslam::UnifiedProjectionCamera::createTestCamera<aslam::FisheyeDistortion>(), 1.0, 1e-4);
+}
+
+TEST(BearingVectorLookupTable, ErrorShrinksWithCellSize) {
+  aslam::Camera::ConstPtr camera =
+      aslam::PinholeCamera::createTestCamera<aslam::RadTanDistortion>();
+  aslam::BearingVectorLookupTable coarse_table(camera, 4.0, 0u);
+  aslam::BearingVectorLookupTable fine_table(camera, 0.5, 0u);
+  EXPECT_LT(fine_table.getMaxAngularError(), coarse_table.getMaxAngularError());
+  EXPECT_GT(fine_table.getNumBytes(), coarse_table.getNumBytes());
+}
+
+TEST(BearingVectorLookupTable, BinarySerialization) {
+  aslam::Camera::Ptr camera = aslam::PinholeCamera::createTestCamera<aslam::RadTanDistortion>();
+  aslam::BearingVectorLookupTable lookup_table(camera, 2.0, 0u);
+  std::vector<char> payload;
+  lookup_table.serializeToBinary(&payload);
+
+  aslam::BearingVectorLookupTable::Ptr lookup_table_loaded =
+      aslam::BearingVectorLookupTable::deserializeFromBinary(
+          camera, payload.data(), payload.size());
+  ASSERT_TRUE(lookup_table_loaded != nullptr);
+  EXPECT_EQ(lookup_table_loaded->getMaxAngularError(), lookup_table.getMaxAngularError());
+  EXPECT_EQ(lookup_table_loaded->getCellSize(), lookup_table.getCellSize());
+  constexpr int kNumKeypoints = 100;
+  for (int i = 0; i < kNumKeypoints; ++i) {
+    const Eigen::Vector2d keypoint = camera->createRandomKeypoint();
+    Eigen::Vector3d point_3d, point_3d_loaded;
+    ASSERT_TRUE(lookup_table.backProject3(keypoint, &point_3d));
+    ASSERT_TRUE(lookup_table_loaded->backProject3(keypoint, &point_3d_loaded));
+    EXPECT_TRUE(EIGEN_MATRIX_EQUAL(point_3d, point_3d_loaded));
+  }
+
+  // Tables of a different calibration and truncated payloads are rejected.
+  aslam::Camera::Ptr recalibrated_camera(camera->clone());
+  Eigen::VectorXd intrinsics = recalibrated_camera->getParameters();
+  intrinsics[0] += 1.0;
+  recalibrated_camera->setParameters(intrinsics);
+  EXPECT_TRUE(aslam::BearingVectorLookupTable::deserializeFromBinary(
+      recalibrated_camera, payload.data(), payload.size()) == nullptr);
+  EXPECT_TRUE(aslam::BearingVectorLookupTable::deserializeFromBinary(
+      camera, payload.data(), payload.size() - 1u) == nullptr);
+}
+
+TEST(BearingVectorLookupTable, DetectsRecalibration) {
+  aslam::Camera::Ptr camera = aslam::PinholeCamera::createTestCamera<aslam::RadTanDistortion>();
+  aslam::BearingVectorLookupTable lookup_table(camera, 4.0, 0u);
+  EXPECT_TRUE(lookup_table.isUpToDate());
+  camera->setLabel("renamed camera");
+  EXPECT_TRUE(lookup_table.isUpToDate());
+  Eigen::VectorXd distortion = camera->getDistortion().getParameters();
+  distortion[0] += 0.01;
+  camera->getDistortionMutable()->setParameters(distortion);
+  EXPECT_FALSE(lookup_table.isUpToDate());
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
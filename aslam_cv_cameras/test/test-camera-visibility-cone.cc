@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/camera-unified-projection.h>
+#include <aslam/cameras/camera-visibility-cone.h>
+#include <aslam/cameras/distortion-fisheye.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-types.h>
+
+namespace aslam {
+
+/// Every point that projects into the image is inside the cone, and most points that do not
+/// are culled.
+void checkConeIsConservative(const Camera& camera) {
+  const CameraVisibilityCone cone(camera);
+  constexpr int kNumPoints = 20000;
+  const Eigen::Matrix3Xd points_C = 20.0 * Eigen::Matrix3Xd::Random(3, kNumPoints);
+  std::vector<unsigned char> may_be_visible;
+  cone.mayBeVisibleVectorized(points_C, &may_be_visible);
+  ASSERT_EQ(static_cast<size_t>(kNumPoints), may_be_visible.size());
+
+  int num_visible = 0;
+  int num_culled_invisible = 0;
+  for (int i = 0; i < kNumPoints; ++i) {
+    EXPECT_EQ(cone.mayBeVisible(points_C.col(i)), may_be_visible[i] != 0u);
+    Eigen::Vector2d keypoint;
+    if (camera.project3(points_C.col(i), &keypoint).isKeypointVisible() &&
+        !camera.isMasked(keypoint)) {
+      ++num_visible;
+      EXPECT_TRUE(may_be_visible[i]) << "Visible point " << points_C.col(i).transpose()
+          << " was culled.";
+    } else if (!may_be_visible[i]) {
+      ++num_culled_invisible;
+    }
+  }
+  EXPECT_GT(num_visible, 0);
+  EXPECT_GT(num_culled_invisible, (kNumPoints - num_visible) / 2);
+}
+
+TEST(CameraVisibilityConeTest, PinholeConeIsConservative) {
+  checkConeIsConservative(*PinholeCamera::createTestCamera<RadTanDistortion>());
+  checkConeIsConservative(*PinholeCamera::createTestCamera<FisheyeDistortion>());
+}
+
+TEST(CameraVisibilityConeTest, UnifiedProjectionConeIsConservative) {
+  checkConeIsConservative(*UnifiedProjectionCamera::createTestCamera<FisheyeDistortion>());
+}
+
+TEST(CameraVisibilityConeTest, MaskNarrowsTheCone) {
+  PinholeCamera::Ptr camera = PinholeCamera::createTestCamera<RadTanDistortion>();
+  const CameraVisibilityCone full_cone(*camera);
+  // Only a block in the upper left of the image is unmasked.
+  cv::Mat mask = cv::Mat::zeros(camera->imageHeight(), camera->imageWidth(), CV_8UC1);
+  mask(cv::Rect(0, 0, camera->imageWidth() / 4, camera->imageHeight() / 4)).setTo(255);
+  camera->setMask(mask);
+  const CameraVisibilityCone masked_cone(*camera);
+  EXPECT_LT(masked_cone.getHalfAngle(), full_cone.getHalfAngle());
+  checkConeIsConservative(*camera);
+}
+
+TEST(CameraVisibilityConeTest, CandidatesInOtherFrameAndSpatialHash) {
+  PinholeCamera::Ptr camera = PinholeCamera::createTestCamera<RadTanDistortion>();
+  const CameraVisibilityCone cone(*camera);
+  constexpr int kNumPoints = 5000;
+  const Eigen::Matrix3Xd points_G = 30.0 * Eigen::Matrix3Xd::Random(3, kNumPoints);
+  const Transformation T_C_G(
+      Quaternion(Eigen::AngleAxisd(0.7, Eigen::Vector3d(1.0, 2.0, 3.0).normalized())
+          .toRotationMatrix()), Eigen::Vector3d(1.0, -2.0, 3.0));
+
+  std::vector<int> candidates;
+  cone.getCandidates(points_G, T_C_G, &candidates);
+  std::vector<int> expected_candidates;
+  for (int i = 0; i < kNumPoints; ++i) {
+    if (cone.mayBeVisible(T_C_G * static_cast<Eigen::Vector3d>(points_G.col(i)))) {
+      expected_candidates.push_back(i);
+    }
+  }
+  EXPECT_EQ(expected_candidates, candidates);
+  EXPECT_LT(candidates.size(), static_cast<size_t>(kNumPoints));
+
+  const LandmarkSpatialHash spatial_hash(points_G, 4.0);
+  EXPECT_LT(spatial_hash.getNumCells(), static_cast<size_t>(kNumPoints));
+  std::vector<int> hash_candidates;
+  spatial_hash.getCandidates(cone, T_C_G, &hash_candidates);
+  std::sort(hash_candidates.begin(), hash_candidates.end());
+  EXPECT_EQ(expected_candidates, hash_candidates);
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -2,12 +2,14 @@
 #include <eigen-checks/gtest.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <type_traits>
 #include <typeinfo>
 
 #include <aslam/cameras/camera.h>
 #include <aslam/cameras/camera-factory.h>
 #include <aslam/cameras/camera-pinhole.h>
 #include <aslam/cameras/camera-unified-projection.h>
+#include <aslam/cameras/camera-visitor.h>
 #include <aslam/cameras/distortion.h>
 #include <aslam/cameras/distortion-fisheye.h>
 #include <aslam/cameras/distortion-radtan.h>
@@ -311,6 +313,300 @@ TYPED_TEST(TestCameras, CameraTest_isInvertible) {
   EXPECT_TRUE(EIGEN_MATRIX_NEAR(points1, points3, 1e-2));
 }
 
+TYPED_TEST(TestCameras, VectorizedProjectionMatchesScalar) {
+  const int kNumPoints = 500;
+  Eigen::Matrix3Xd points(3, kNumPoints);
+  for (int n = 0; n < kNumPoints; ++n) {
+    points.col(n) = this->camera_->createRandomVisiblePoint(5.0);
+  }
+  // Cover invisible projections as well.
+  points.col(0) << 0.0, 0.0, -1.0;
+  points.col(1) << 100.0, 0.0, 1.0;
+
+  Eigen::Matrix2Xd keypoints;
+  std::vector<aslam::ProjectionResult> results;
+  this->camera_->project3Vectorized(points, &keypoints, &results);
+  ASSERT_EQ(static_cast<size_t>(kNumPoints), results.size());
+
+  Eigen::Matrix3Xd bearings;
+  std::vector<unsigned char> success;
+  this->camera_->backProject3Vectorized(keypoints, &bearings, &success);
+  ASSERT_EQ(static_cast<size_t>(kNumPoints), success.size());
+
+  for (int n = 0; n < kNumPoints; ++n) {
+    Eigen::Vector2d keypoint;
+    const aslam::ProjectionResult result = this->camera_->project3(points.col(n), &keypoint);
+    EXPECT_EQ(result.getDetailedStatus(), results[n].getDetailedStatus());
+    if (!result.isKeypointVisible()) {
+      continue;
+    }
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(keypoint, keypoints.col(n), 1e-9));
+
+    Eigen::Vector3d bearing;
+    const bool back_projection_success = this->camera_->backProject3(keypoints.col(n), &bearing);
+    EXPECT_EQ(back_projection_success, static_cast<bool>(success[n]));
+    // Both paths undistort iteratively and stop within FLAGS_acv_inv_distortion_tolerance.
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(bearing, bearings.col(n), 1e-7));
+  }
+}
+
+TYPED_TEST(TestCameras, VectorizedJacobiansMatchScalar) {
+  const int kNumPoints = 500;
+  Eigen::Matrix3Xd points(3, kNumPoints);
+  for (int n = 0; n < kNumPoints; ++n) {
+    points.col(n) = this->camera_->createRandomVisiblePoint(5.0);
+  }
+  // Cover invisible and invalid projections as well. The point behind the camera is off the
+  // optical axis, where the scalar equidistant distortion returns a zero Jacobian.
+  points.col(0) << 0.1, 0.2, -1.0;
+  points.col(1) << 100.0, 0.0, 1.0;
+  points.col(2).setZero();
+
+  Eigen::Matrix2Xd keypoints;
+  Eigen::Matrix<double, 6, Eigen::Dynamic> J_points;
+  Eigen::MatrixXd J_intrinsics;
+  std::vector<aslam::ProjectionResult> results;
+  this->camera_->project3VectorizedWithJacobians(
+      points, &keypoints, &J_points, &J_intrinsics, &results);
+  const int num_params = this->camera_->getParameterSize();
+  ASSERT_EQ(static_cast<size_t>(kNumPoints), results.size());
+  ASSERT_EQ(kNumPoints, J_points.cols());
+  ASSERT_EQ(2 * num_params, J_intrinsics.rows());
+  ASSERT_EQ(kNumPoints, J_intrinsics.cols());
+
+  for (int n = 0; n < kNumPoints; ++n) {
+    Eigen::Vector2d keypoint;
+    Eigen::Matrix<double, 2, 3> J_point;
+    Eigen::Matrix<double, 2, Eigen::Dynamic> J_intrinsic;
+    const aslam::ProjectionResult result = this->camera_->project3Functional(
+        points.col(n), nullptr, nullptr, &keypoint, &J_point, &J_intrinsic, nullptr);
+    EXPECT_EQ(result.getDetailedStatus(), results[n].getDetailedStatus());
+    const Eigen::Map<const Eigen::Matrix<double, 2, 3>> J_point_vectorized(J_points.col(n).data());
+    const Eigen::Map<const Eigen::Matrix<double, 2, Eigen::Dynamic>> J_intrinsic_vectorized(
+        J_intrinsics.col(n).data(), 2, num_params);
+    if (result.getDetailedStatus() == aslam::ProjectionResult::Status::PROJECTION_INVALID) {
+      EXPECT_TRUE(J_point_vectorized.isZero());
+      EXPECT_TRUE(J_intrinsic_vectorized.isZero());
+      continue;
+    }
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(keypoint, keypoints.col(n), 1e-9));
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(J_point, J_point_vectorized, 1e-9));
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(J_intrinsic, J_intrinsic_vectorized, 1e-9));
+  }
+
+  // Skipping the Jacobians leaves the keypoints unchanged.
+  Eigen::Matrix2Xd keypoints_without_jacobians;
+  this->camera_->project3VectorizedWithJacobians(
+      points, &keypoints_without_jacobians, nullptr, nullptr, &results);
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(keypoints, keypoints_without_jacobians, 1e-12));
+}
+
+TYPED_TEST(TestCameras, RollingShutterProjectionIsAFixedPoint) {
+  const int kNumPoints = 50;
+  const int kNumIterations = 4;
+  Eigen::Matrix3Xd points(3, kNumPoints);
+  for (int n = 0; n < kNumPoints; ++n) {
+    points.col(n) = this->camera_->createRandomVisiblePoint(5.0);
+  }
+  const Eigen::Vector3d linear_velocity_C(1.0, -0.5, 0.3);
+  const Eigen::Vector3d angular_velocity_C(0.5, 1.0, -0.3);
+
+  // Without line delay, the projection is the global shutter one.
+  Eigen::Matrix2Xd keypoints, global_shutter_keypoints;
+  Eigen::Matrix<double, 6, Eigen::Dynamic> J_points, global_shutter_J_points;
+  std::vector<aslam::ProjectionResult> results, global_shutter_results;
+  this->camera_->setLineDelayNanoSeconds(0u);
+  this->camera_->project3RollingShutterVectorized(
+      points, linear_velocity_C, angular_velocity_C, kNumIterations, &keypoints, &J_points,
+      &results);
+  this->camera_->project3VectorizedWithJacobians(
+      points, &global_shutter_keypoints, &global_shutter_J_points, nullptr,
+      &global_shutter_results);
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(keypoints, global_shutter_keypoints, 1e-12));
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(J_points, global_shutter_J_points, 1e-12));
+
+  const uint64_t kLineDelayNanoSeconds = 30000u;
+  const double line_delay_seconds = kLineDelayNanoSeconds * 1e-9;
+  this->camera_->setLineDelayNanoSeconds(kLineDelayNanoSeconds);
+  this->camera_->project3RollingShutterVectorized(
+      points, linear_velocity_C, angular_velocity_C, kNumIterations, &keypoints, &J_points,
+      &results);
+  ASSERT_EQ(static_cast<size_t>(kNumPoints), results.size());
+
+  // Moved point observed at the readout time of its own keypoint row.
+  auto project_rolling_shutter = [&](const Eigen::Vector3d& point, double row_time) {
+    Eigen::Vector2d keypoint;
+    this->camera_->project3(
+        point - row_time * (angular_velocity_C.cross(point) + linear_velocity_C), &keypoint);
+    return keypoint;
+  };
+  for (int n = 0; n < kNumPoints; ++n) {
+    if (!results[n].isKeypointVisible()) {
+      continue;
+    }
+    const Eigen::Vector2d keypoint = keypoints.col(n);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(
+        project_rolling_shutter(points.col(n), line_delay_seconds * keypoint(1)), keypoint,
+        1e-3));
+
+    // Central differences of the converged projection.
+    const double kStep = 1e-6;
+    Eigen::Matrix<double, 2, 3> J_numerical;
+    for (int d = 0; d < 3; ++d) {
+      Eigen::Matrix3Xd perturbed_points(3, 2);
+      perturbed_points.col(0) = points.col(n) + kStep * Eigen::Vector3d::Unit(d);
+      perturbed_points.col(1) = points.col(n) - kStep * Eigen::Vector3d::Unit(d);
+      Eigen::Matrix2Xd perturbed_keypoints;
+      std::vector<aslam::ProjectionResult> perturbed_results;
+      this->camera_->project3RollingShutterVectorized(
+          perturbed_points, linear_velocity_C, angular_velocity_C, 20, &perturbed_keypoints,
+          nullptr, &perturbed_results);
+      J_numerical.col(d) =
+          (perturbed_keypoints.col(0) - perturbed_keypoints.col(1)) / (2.0 * kStep);
+    }
+    const Eigen::Map<const Eigen::Matrix<double, 2, 3>> J_point(J_points.col(n).data());
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(J_point, J_numerical, 1e-3 * J_numerical.norm()));
+  }
+}
+
+TYPED_TEST(TestCameras, BatchProjectionMatchesFunctional) {
+  const int kNumPoints = 200;
+  Eigen::Matrix3Xd points(3, kNumPoints);
+  for (int n = 0; n < kNumPoints; ++n) {
+    points.col(n) = this->camera_->createRandomVisiblePoint(5.0);
+  }
+  // Cover invisible and invalid projections as well.
+  points.col(0) << 0.1, 0.2, -1.0;
+  points.col(1) << 100.0, 0.0, 1.0;
+  points.col(2).setZero();
+
+  const int num_params = this->camera_->getParameterSize();
+  const int num_distortion_params = this->camera_->getDistortion().getParameterSize();
+  Eigen::Matrix2Xd keypoints(2, kNumPoints);
+  Eigen::Matrix<double, 6, Eigen::Dynamic> J_points(6, kNumPoints);
+  Eigen::MatrixXd J_intrinsics(2 * num_params, kNumPoints);
+  Eigen::MatrixXd J_distortions(2 * num_distortion_params, kNumPoints);
+  std::vector<aslam::ProjectionResult> results(kNumPoints);
+  aslam::ProjectionJacobianBuffers buffers;
+  buffers.keypoints = keypoints.data();
+  buffers.jacobians_point = J_points.data();
+  buffers.jacobians_intrinsics = J_intrinsics.data();
+  buffers.jacobians_distortion = J_distortions.data();
+  buffers.results = results.data();
+  this->camera_->project3Batch(points, buffers);
+
+  for (int n = 0; n < kNumPoints; ++n) {
+    Eigen::Vector2d keypoint;
+    Eigen::Matrix<double, 2, 3> J_point;
+    Eigen::Matrix<double, 2, Eigen::Dynamic> J_intrinsic, J_distortion;
+    const aslam::ProjectionResult result = this->camera_->project3Functional(
+        points.col(n), nullptr, nullptr, &keypoint, &J_point, &J_intrinsic, &J_distortion);
+    EXPECT_EQ(result.getDetailedStatus(), results[n].getDetailedStatus());
+    const Eigen::Map<const Eigen::Matrix<double, 2, 3>> J_point_batch(J_points.col(n).data());
+    const Eigen::Map<const Eigen::Matrix<double, 2, Eigen::Dynamic>> J_intrinsic_batch(
+        J_intrinsics.col(n).data(), 2, num_params);
+    const Eigen::Map<const Eigen::Matrix<double, 2, Eigen::Dynamic>> J_distortion_batch(
+        J_distortions.col(n).data(), 2, num_distortion_params);
+    if (result.getDetailedStatus() == aslam::ProjectionResult::Status::PROJECTION_INVALID) {
+      EXPECT_TRUE(J_point_batch.isZero());
+      EXPECT_TRUE(J_intrinsic_batch.isZero());
+      EXPECT_TRUE(J_distortion_batch.isZero());
+      continue;
+    }
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(keypoint, keypoints.col(n), 1e-9));
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(J_point, J_point_batch, 1e-9));
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(J_intrinsic, J_intrinsic_batch, 1e-9));
+    if (num_distortion_params > 0) {
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(J_distortion, J_distortion_batch, 1e-9));
+    }
+  }
+
+  // The Jacobians are optional.
+  Eigen::Matrix2Xd keypoints_only(2, kNumPoints);
+  aslam::ProjectionJacobianBuffers keypoint_buffers;
+  keypoint_buffers.keypoints = keypoints_only.data();
+  keypoint_buffers.results = results.data();
+  this->camera_->project3Batch(points, keypoint_buffers);
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(keypoints, keypoints_only, 1e-12));
+}
+
+TYPED_TEST(TestCameras, FloatProjectionMatchesDouble) {
+  const int kNumPoints = 500;
+  Eigen::Matrix3Xd points(3, kNumPoints);
+  for (int n = 0; n < kNumPoints; ++n) {
+    points.col(n) = this->camera_->createRandomVisiblePoint(5.0);
+  }
+  points.col(0) << 0.0, 0.0, -1.0;
+
+  Eigen::Matrix2Xd keypoints;
+  std::vector<aslam::ProjectionResult> results;
+  this->camera_->template project3VectorizedWithScalar<double>(points, &keypoints, &results);
+  Eigen::Matrix2Xf keypoints_float;
+  std::vector<aslam::ProjectionResult> results_float;
+  this->camera_->template project3VectorizedWithScalar<float>(
+      points.cast<float>(), &keypoints_float, &results_float);
+  ASSERT_EQ(results.size(), results_float.size());
+
+  Eigen::Matrix3Xd bearings;
+  std::vector<unsigned char> success;
+  this->camera_->backProject3Vectorized(keypoints, &bearings, &success);
+  Eigen::Matrix3Xf bearings_float;
+  std::vector<unsigned char> success_float;
+  this->camera_->backProject3VectorizedFloat(
+      keypoints.cast<float>(), &bearings_float, &success_float);
+  ASSERT_EQ(success.size(), success_float.size());
+
+  // Single precision is good to a small fraction of a pixel and a few micro radians.
+  constexpr double kMaxKeypointErrorPx = 1e-3;
+  constexpr double kMaxBearingAngleRad = 1e-5;
+  for (int n = 0; n < kNumPoints; ++n) {
+    EXPECT_EQ(results[n].getDetailedStatus(), results_float[n].getDetailedStatus());
+    if (!results[n].isKeypointVisible()) {
+      continue;
+    }
+    EXPECT_LT((keypoints.col(n) - keypoints_float.col(n).cast<double>()).norm(),
+              kMaxKeypointErrorPx);
+
+    EXPECT_EQ(success[n], success_float[n]);
+    if (success[n]) {
+      const Eigen::Vector3d bearing = bearings.col(n).normalized();
+      const Eigen::Vector3d bearing_float = bearings_float.col(n).cast<double>().normalized();
+      EXPECT_LT(std::atan2(bearing.cross(bearing_float).norm(), bearing.dot(bearing_float)),
+                kMaxBearingAngleRad);
+    }
+  }
+}
+
+/// Checks that the visitor passes the concrete types of the test camera and that projecting
+/// with them equals the virtual projection.
+template <typename ExpectedCameraType, typename ExpectedDistortionType>
+struct TypedProjectionChecker {
+  template <typename CameraType, typename DistortionType>
+  void operator()(const CameraType& typed_camera, const DistortionType& typed_distortion) {
+    ++num_calls;
+    EXPECT_TRUE((std::is_same<CameraType, ExpectedCameraType>::value));
+    EXPECT_TRUE((std::is_same<DistortionType, ExpectedDistortionType>::value));
+    EXPECT_EQ(&typed_distortion, &typed_camera.getDistortion());
+    for (int n = 0; n < 100; ++n) {
+      const Eigen::Vector3d point = typed_camera.createRandomVisiblePoint(5.0);
+      Eigen::Vector2d typed_keypoint, keypoint;
+      EXPECT_EQ(typed_camera.project3(point, &typed_keypoint),
+                camera->project3(point, &keypoint));
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(typed_keypoint, keypoint, 1e-12));
+    }
+  }
+
+  const aslam::Camera* camera;
+  int num_calls;
+};
+
+TYPED_TEST(TestCameras, VisitorPassesConcreteTypes) {
+  TypedProjectionChecker<typename TestFixture::CameraType, typename TestFixture::DistortionType>
+      checker{this->camera_.get(), 0};
+  aslam::visitCamera(*this->camera_, &checker);
+  EXPECT_EQ(1, checker.num_calls);
+}
+
 TYPED_TEST(TestCameras, TestClone) {
   aslam::Camera::Ptr cam1(this->camera_->clone());
 
@@ -325,6 +621,40 @@ TYPED_TEST(TestCameras, TestClone) {
   EXPECT_TRUE(this->camera_->getDistortion() == cam1->getDistortion());
 }
 
+TYPED_TEST(TestCameras, ParameterVersionTracksCalibration) {
+  aslam::ParameterVersion version = this->camera_->getParameterVersion();
+  EXPECT_GT(version, 0u);
+  // Copies have the same calibration.
+  aslam::Camera::Ptr clone(this->camera_->clone());
+  EXPECT_EQ(version, clone->getParameterVersion());
+  this->camera_->setLabel("label");
+  EXPECT_EQ(version, this->camera_->getParameterVersion());
+
+  auto expect_new_version = [this, &version]() {
+    const aslam::ParameterVersion new_version = this->camera_->getParameterVersion();
+    EXPECT_GT(new_version, version);
+    version = new_version;
+  };
+  this->camera_->setParameters(this->camera_->getParameters());
+  expect_new_version();
+  this->camera_->getParametersMutable()[0] += 1.0;
+  expect_new_version();
+  this->camera_->setLineDelayNanoSeconds(1000u);
+  expect_new_version();
+  this->camera_->setMask(cv::Mat::ones(
+      this->camera_->imageHeight(), this->camera_->imageWidth(), CV_8UC1));
+  expect_new_version();
+  this->camera_->clearMask();
+  expect_new_version();
+  this->camera_->getDistortionMutable()->markParametersChanged();
+  expect_new_version();
+  aslam::Distortion::UniquePtr distortion(clone->getDistortion().clone());
+  this->camera_->setDistortion(distortion);
+  expect_new_version();
+  EXPECT_EQ(version, this->camera_->getParameterVersion());
+  EXPECT_LT(clone->getParameterVersion(), version);
+}
+
 TYPED_TEST(TestCameras, invalidMaskTest) {
   // Die on empty mask.
   cv::Mat mask;
@@ -370,6 +700,45 @@ TYPED_TEST(TestCameras, validMaskTest) {
   EXPECT_TRUE(this->camera_->isMasked(Vec2(10.5, 20.5)));
 }
 
+TYPED_TEST(TestCameras, maskTilesTest) {
+  const int width = this->camera_->imageWidth();
+  const int height = this->camera_->imageHeight();
+  // A fully masked block, a fully valid remainder and a ragged border in between.
+  cv::Mat mask = cv::Mat::ones(cv::Size2i(width, height), CV_8UC1);
+  mask(cv::Rect(0, 0, width / 2, height / 2)).setTo(0);
+  for (int v = height / 2; v < height; v += 3) {
+    mask.at<uint8_t>(v, (7 * v) % width) = 0;
+  }
+  this->camera_->setMask(mask);
+
+  const int kNumKeypoints = 10000;
+  Eigen::Matrix2Xd keypoints(2, kNumKeypoints);
+  keypoints.row(0).setRandom();
+  keypoints.row(1).setRandom();
+  keypoints.row(0) = (keypoints.row(0).array() + 1.0) * 0.55 * width - 0.05 * width;
+  keypoints.row(1) = (keypoints.row(1).array() + 1.0) * 0.55 * height - 0.05 * height;
+  // Exercise the partially masked tiles.
+  for (int v = height / 2, i = 0; v < height && i < kNumKeypoints; v += 3, i += 2) {
+    keypoints.col(i) << (7 * v) % width, v;
+    keypoints.col(i + 1) << (7 * v) % width + 0.5, v;
+  }
+
+  std::vector<unsigned char> masked;
+  this->camera_->isMaskedVectorized(keypoints, &masked);
+  ASSERT_EQ(masked.size(), static_cast<size_t>(kNumKeypoints));
+  for (int i = 0; i < kNumKeypoints; ++i) {
+    const double u = keypoints(0, i);
+    const double v = keypoints(1, i);
+    const bool expected_masked = u < 0.0 || v < 0.0 || u >= width || v >= height ||
+        mask.at<uint8_t>(static_cast<int>(v), static_cast<int>(u)) == 0;
+    EXPECT_EQ(expected_masked, this->camera_->isMasked(keypoints.col(i))) << u << ", " << v;
+    EXPECT_EQ(expected_masked, static_cast<bool>(masked[i])) << u << ", " << v;
+  }
+
+  this->camera_->clearMask();
+  EXPECT_FALSE(this->camera_->isMasked(Eigen::Vector2d(0.0, 0.0)));
+}
+
 TYPED_TEST(TestCameras, YamlSerialization){
   ASSERT_NE(this->camera_, nullptr);
   this->camera_->saveToYaml("test.yaml");
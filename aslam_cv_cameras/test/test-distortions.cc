@@ -10,6 +10,7 @@
 #include <aslam/cameras/distortion-null.h>
 #include <aslam/cameras/distortion-radtan.h>
 #include <aslam/cameras/distortion-equidistant.h>
+#include <aslam/cameras/radial-inverse-table.h>
 #include <aslam/common/numdiff-jacobian-tester.h>
 
 ///////////////////////////////////////////////
@@ -113,6 +114,62 @@ TYPED_TEST(TestDistortions, DistortAndUndistortImageCenter) {
   EXPECT_TRUE(EIGEN_MATRIX_NEAR(keypoint2, keypoint, 1e-12));
 }
 
+TYPED_TEST(TestDistortions, VectorizedMatchesScalar) {
+  const int kNumPoints = 1000;
+  Eigen::Matrix2Xd points = 2.5 * Eigen::Matrix2Xd::Random(2, kNumPoints);
+  // Include the image center to cover the special cases of the models.
+  points.col(0).setZero();
+
+  Eigen::Matrix2Xd distorted_points;
+  Eigen::Matrix4Xd distortion_jacobians;
+  this->distortion_->distortVectorized(points, &distorted_points, &distortion_jacobians);
+  ASSERT_EQ(kNumPoints, distorted_points.cols());
+  ASSERT_EQ(kNumPoints, distortion_jacobians.cols());
+  Eigen::Matrix2Xd undistorted_points;
+  this->distortion_->undistortVectorized(distorted_points, &undistorted_points, nullptr);
+  ASSERT_EQ(kNumPoints, undistorted_points.cols());
+
+  for (int i = 0; i < kNumPoints; ++i) {
+    Eigen::Vector2d point = points.col(i);
+    Eigen::Matrix2d jacobian;
+    this->distortion_->distort(&point, &jacobian);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(point, distorted_points.col(i), 1e-12));
+    // The scalar equidistant model returns a zero Jacobian at the center.
+    if (i > 0) {
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(
+          jacobian, Eigen::Map<const Eigen::Matrix2d>(distortion_jacobians.col(i).data()), 1e-9));
+    }
+    this->distortion_->undistort(&point);
+    // The iterative models may take different steps than their scalar version.
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(point, undistorted_points.col(i), 1e-6));
+  }
+
+  // Distorting in place must give the same result.
+  this->distortion_->distortVectorized(points, &points, nullptr);
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(points, distorted_points, 1e-15));
+}
+
+TYPED_TEST(TestDistortions, VectorizedUndistortionJacobianInvertsDistortionJacobian) {
+  const int kNumPoints = 1000;
+  const Eigen::Matrix2Xd points = Eigen::Matrix2Xd::Random(2, kNumPoints);
+
+  Eigen::Matrix2Xd distorted_points;
+  Eigen::Matrix4Xd distortion_jacobians;
+  this->distortion_->distortVectorized(points, &distorted_points, &distortion_jacobians);
+  Eigen::Matrix2Xd undistorted_points;
+  Eigen::Matrix4Xd undistortion_jacobians;
+  this->distortion_->undistortVectorized(
+      distorted_points, &undistorted_points, &undistortion_jacobians);
+  ASSERT_EQ(kNumPoints, undistortion_jacobians.cols());
+
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(points, undistorted_points, 1e-5));
+  for (int i = 0; i < kNumPoints; ++i) {
+    const Eigen::Matrix2d product =
+        Eigen::Map<const Eigen::Matrix2d>(undistortion_jacobians.col(i).data()) *
+        Eigen::Map<const Eigen::Matrix2d>(distortion_jacobians.col(i).data());
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(product, Eigen::Matrix2d::Identity(), 1e-4));
+  }
+}
 
 /// Wrapper that brings the distortion function to the form needed by the differentiator.
 struct Point3dJacobianFunctor : public aslam::common::NumDiffFunctor<2, 2> {
@@ -196,6 +253,91 @@ TYPED_TEST(TestDistortionsNotNull, JacobianWrtDistortion) {
                                   dist_coeffs, 1e-5, 1e-4, *(this->distortion_), keypoint);
 }
 
+TEST(TestEquidistantDistortion, SingleNewtonStepFromInverseTableIsAccurate) {
+  aslam::EquidistantDistortion::Ptr distortion =
+      aslam::EquidistantDistortion::createTestDistortion();
+  const Eigen::Matrix2Xd points = 2.5 * Eigen::Matrix2Xd::Random(2, 1000);
+
+  // Accept every step, such that the result only depends on the start point from the table.
+  const double tolerance = FLAGS_acv_inv_distortion_tolerance;
+  FLAGS_acv_inv_distortion_tolerance = 1.0;
+  // Halving the parameters has to rebuild the table.
+  for (const double scale : {1.0, 0.5}) {
+    distortion->setParameters(scale * distortion->createTestDistortion()->getParameters());
+    Eigen::Matrix2Xd distorted_points;
+    distortion->distortVectorized(points, &distorted_points, nullptr);
+    Eigen::Matrix2Xd undistorted_points;
+    distortion->undistortVectorized(distorted_points, &undistorted_points, nullptr);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(undistorted_points, points, 1e-9));
+    for (int i = 0; i < points.cols(); ++i) {
+      Eigen::Vector2d point = distorted_points.col(i);
+      distortion->undistort(&point);
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(point, points.col(i), 1e-9));
+    }
+  }
+  FLAGS_acv_inv_distortion_tolerance = tolerance;
+}
+
+TEST(TestEquidistantDistortion, ScalarUndistortionAlternatesBetweenDistortions) {
+  aslam::EquidistantDistortion::Ptr distortion =
+      aslam::EquidistantDistortion::createTestDistortion();
+  aslam::EquidistantDistortion::Ptr other_distortion =
+      aslam::EquidistantDistortion::createTestDistortion();
+  other_distortion->setParameters(0.5 * distortion->getParameters());
+  const Eigen::Matrix2Xd points = 2.5 * Eigen::Matrix2Xd::Random(2, 100);
+
+  const double tolerance = FLAGS_acv_inv_distortion_tolerance;
+  FLAGS_acv_inv_distortion_tolerance = 1.0;
+  for (int i = 0; i < points.cols(); ++i) {
+    // Each point switches the table of this thread.
+    for (const aslam::EquidistantDistortion::Ptr& current : {distortion, other_distortion}) {
+      Eigen::Vector2d point = points.col(i);
+      current->distort(&point);
+      current->undistort(&point);
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(point, points.col(i), 1e-9));
+    }
+  }
+  FLAGS_acv_inv_distortion_tolerance = tolerance;
+}
+
+TEST(TestEquidistantDistortion, WritesThroughTheMutableParametersRebuildTheInverseTable) {
+  aslam::EquidistantDistortion::Ptr distortion =
+      aslam::EquidistantDistortion::createTestDistortion();
+  const Eigen::Matrix2Xd points = 2.5 * Eigen::Matrix2Xd::Random(2, 100);
+  Eigen::Matrix2Xd undistorted_points;
+  // Builds the table of the test parameters.
+  distortion->undistortVectorized(points, &undistorted_points, nullptr);
+
+  const double tolerance = FLAGS_acv_inv_distortion_tolerance;
+  FLAGS_acv_inv_distortion_tolerance = 1.0;
+  const aslam::ParameterVersion version = distortion->getParameterVersion();
+  double* parameters = distortion->getParametersMutable();
+  for (int i = 0; i < distortion->getParameterSize(); ++i) {
+    parameters[i] *= 0.5;
+  }
+  EXPECT_GT(distortion->getParameterVersion(), version);
+  Eigen::Matrix2Xd distorted_points;
+  distortion->distortVectorized(points, &distorted_points, nullptr);
+  distortion->undistortVectorized(distorted_points, &undistorted_points, nullptr);
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(undistorted_points, points, 1e-9));
+  FLAGS_acv_inv_distortion_tolerance = tolerance;
+}
+
+TEST(TestRadialInverseTable, InvertsTheIncreasingPart) {
+  // x - x^3 / 3 increases on [0, 1], the table ends at its maximum 2 / 3.
+  const aslam::RadialInverseTable table([](double x, double* derivative) {
+    *derivative = 1.0 - x * x;
+    return x - x * x * x / 3.0;
+  }, 2.0, 1000u);
+  EXPECT_NEAR(table.getMaxValue(), 2.0 / 3.0, 1e-5);
+  EXPECT_FALSE(table.isInRange(-0.1));
+  EXPECT_FALSE(table.isInRange(0.7));
+  EXPECT_EQ(table.lookup(0.0), 0.0);
+  for (const double x : {0.1, 0.5, 0.8}) {
+    EXPECT_NEAR(table.lookup(x - x * x * x / 3.0), x, 1e-5);
+  }
+}
+
 ///////
 // Test parameters
 ///////
@@ -1,10 +1,17 @@
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <Eigen/Core>
 #include <eigen-checks/gtest.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
 
+#include <aslam/cameras/binary-calibration.h>
 #include <aslam/cameras/camera.h>
 #include <aslam/cameras/ncamera.h>
+#include <aslam/cameras/ncamera-geometry.h>
 #include <aslam/cameras/yaml/ncamera-yaml-serialization.h>
 #include <aslam/common/entrypoint.h>
 #include <aslam/common/yaml-serialization.h>
@@ -48,6 +55,80 @@ TEST(TestNCameraYamlSerialization, testSerialization) {
   EXPECT_TRUE(*ncamera == *ncamera_loaded);
 }
 
+TEST(TestNCameraBinarySerialization, testSerialization) {
+  aslam::NCamera::Ptr ncamera = aslam::NCamera::createTestNCamera(4u);
+  ASSERT_TRUE(ncamera.get() != nullptr);
+  aslam::Camera& masked_camera = ncamera->getCameraMutable(1u);
+  cv::Mat mask(masked_camera.imageHeight(), masked_camera.imageWidth(), CV_8UC1,
+               cv::Scalar(255));
+  for (int v = 0; v < 50; ++v) {
+    for (int u = 0; u < 100; ++u) {
+      mask.at<uint8_t>(v, u) = 0u;
+    }
+  }
+  masked_camera.setMask(mask);
+  masked_camera.setLineDelayNanoSeconds(20000u);
+
+  const std::string filename = "test_ncamera.bin";
+  ASSERT_TRUE(ncamera->saveToBinary(filename));
+  aslam::NCamera::Ptr ncamera_loaded = aslam::NCamera::loadFromBinary(filename);
+  ASSERT_TRUE(ncamera_loaded.get() != nullptr);
+
+  EXPECT_EQ(ncamera_loaded->getLabel(), ncamera->getLabel());
+  EXPECT_EQ(ncamera_loaded->getId(), ncamera->getId());
+  ASSERT_EQ(ncamera_loaded->getNumCameras(), 4u);
+  for (size_t cam_idx = 0u; cam_idx < ncamera->getNumCameras(); ++cam_idx) {
+    const aslam::Camera& camera_loaded = ncamera_loaded->getCamera(cam_idx);
+    const aslam::Camera& camera_gt = ncamera->getCamera(cam_idx);
+    EXPECT_EQ(camera_loaded.getId(), camera_gt.getId());
+    EXPECT_EQ(camera_loaded.getLabel(), camera_gt.getLabel());
+    EXPECT_EQ(camera_loaded.getLineDelayNanoSeconds(), camera_gt.getLineDelayNanoSeconds());
+    EXPECT_EQ(camera_loaded.hasMask(), camera_gt.hasMask());
+    // The binary format is lossless.
+    EXPECT_EQ(ncamera->get_T_C_B(cam_idx), ncamera_loaded->get_T_C_B(cam_idx));
+    EXPECT_TRUE(camera_loaded == camera_gt);
+  }
+  const cv::Mat& mask_loaded = ncamera_loaded->getCamera(1u).getMask();
+  for (int v = 0; v < mask.rows; ++v) {
+    for (int u = 0; u < mask.cols; ++u) {
+      ASSERT_EQ(mask_loaded.at<uint8_t>(v, u), mask.at<uint8_t>(v, u));
+    }
+  }
+  EXPECT_TRUE(*ncamera == *ncamera_loaded);
+}
+
+TEST(TestNCameraBinarySerialization, testInvalidData) {
+  aslam::NCamera::Ptr ncamera = aslam::NCamera::createTestNCamera(2u);
+  std::vector<char> payload;
+  ncamera->serializeToBinary(&payload);
+  aslam::BinaryCalibrationWriter writer;
+  writer.addSection(aslam::binary_calibration::kNCameraSection, 0u, std::move(payload));
+  std::vector<char> buffer;
+  writer.writeToBuffer(&buffer);
+
+  aslam::BinaryCalibrationReader reader;
+  ASSERT_TRUE(reader.openBuffer(buffer.data(), buffer.size()));
+  const char* data;
+  size_t size_bytes;
+  ASSERT_TRUE(reader.getSection(
+      aslam::binary_calibration::kNCameraSection, 0u, &data, &size_bytes));
+  EXPECT_FALSE(reader.hasSection(aslam::binary_calibration::kNCameraSection, 1u));
+  EXPECT_TRUE(aslam::NCamera::deserializeFromBinary(data, size_bytes) != nullptr);
+
+  // Truncated payloads are rejected.
+  for (size_t truncated_size_bytes = 0u; truncated_size_bytes < size_bytes;
+       truncated_size_bytes += 7u) {
+    EXPECT_TRUE(aslam::NCamera::deserializeFromBinary(data, truncated_size_bytes) == nullptr);
+  }
+
+  // The checksum detects corrupted files.
+  std::vector<char> corrupted_buffer = buffer;
+  corrupted_buffer.back() ^= 1;
+  EXPECT_FALSE(reader.openBuffer(corrupted_buffer.data(), corrupted_buffer.size()));
+  EXPECT_FALSE(reader.openBuffer(buffer.data(), buffer.size() - 1u));
+  EXPECT_FALSE(aslam::NCamera::loadFromBinary("does_not_exist.bin"));
+}
+
 TEST(TestNCamera, testClone) {
   aslam::NCamera::Ptr ncamera = aslam::NCamera::createTestNCamera(4u);
   ASSERT_TRUE(ncamera.get() != nullptr);
@@ -90,4 +171,74 @@ TEST(TestNCamera, testCloneRigWithoutDistortion) {
   }
 }
 
+TEST(TestNCamera, testGeometry) {
+  aslam::NCamera::Ptr ncamera = aslam::NCamera::createSurroundViewTestNCamera();
+  std::shared_ptr<const aslam::NCameraGeometry> geometry = ncamera->getGeometry();
+  ASSERT_TRUE(geometry != nullptr);
+  EXPECT_EQ(geometry.get(), ncamera->getGeometry().get());
+  const size_t num_cameras = ncamera->getNumCameras();
+  ASSERT_EQ(geometry->getNumCameras(), num_cameras);
+
+  for (size_t i = 0u; i < num_cameras; ++i) {
+    EXPECT_EQ(geometry->getCameraIndex(ncamera->getCameraId(i)), static_cast<int>(i));
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(
+        geometry->get_T_B_C(i).getTransformationMatrix(),
+        ncamera->get_T_C_B(i).inverse().getTransformationMatrix(), 1e-12));
+    EXPECT_DOUBLE_EQ(geometry->getOverlap(i, i), 1.0);
+    for (size_t j = 0u; j < num_cameras; ++j) {
+      const aslam::Transformation T_Ci_Cj =
+          ncamera->get_T_C_B(i) * ncamera->get_T_C_B(j).inverse();
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(geometry->get_T_Ci_Cj(i, j).getTransformationMatrix(),
+                                    T_Ci_Cj.getTransformationMatrix(), 1e-12));
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(geometry->get_R_Ci_Cj(i, j), T_Ci_Cj.getRotationMatrix(),
+                                    1e-12));
+    }
+  }
+  EXPECT_EQ(geometry->getCameraIndex(aslam::CameraId::Random()), -1);
+
+  // The opposite cameras of the surround view rig do not see the same points.
+  EXPECT_FALSE(geometry->haveOverlap(0u, 2u));
+  EXPECT_FALSE(geometry->haveOverlap(1u, 3u));
+
+  // Changing the rig drops the cache.
+  ncamera->set_T_C_B(2u, ncamera->get_T_C_B(0u));
+  std::shared_ptr<const aslam::NCameraGeometry> new_geometry = ncamera->getGeometry();
+  EXPECT_NE(new_geometry.get(), geometry.get());
+  EXPECT_DOUBLE_EQ(new_geometry->getOverlap(0u, 2u), 1.0);
+  EXPECT_DOUBLE_EQ(new_geometry->getOverlap(2u, 0u), 1.0);
+  // The old snapshot is unchanged.
+  EXPECT_FALSE(geometry->haveOverlap(0u, 2u));
+}
+
+TEST(TestNCamera, testParameterVersion) {
+  aslam::NCamera::Ptr ncamera = aslam::NCamera::createTestNCamera(2u);
+  std::shared_ptr<const aslam::NCameraGeometry> geometry = ncamera->getGeometry();
+  aslam::ParameterVersion version = ncamera->getParameterVersion();
+
+  // Read access and access to the cameras without changes keep the version and the geometry.
+  ncamera->getCameraMutable(0u);
+  ncamera->getCameraShared(1u);
+  EXPECT_EQ(version, ncamera->getParameterVersion());
+  EXPECT_EQ(geometry.get(), ncamera->getGeometry().get());
+
+  // Recalibrating a camera through a reference obtained before is detected.
+  aslam::Camera& camera = ncamera->getCameraMutable(1u);
+  Eigen::VectorXd intrinsics = camera.getParameters();
+  intrinsics[0] += 1.0;
+  camera.setParameters(intrinsics);
+  EXPECT_GT(ncamera->getParameterVersion(), version);
+  version = ncamera->getParameterVersion();
+  std::shared_ptr<const aslam::NCameraGeometry> new_geometry = ncamera->getGeometry();
+  EXPECT_NE(geometry.get(), new_geometry.get());
+
+  // So are writes to the extrinsics which are marked.
+  aslam::Transformation& T_C_B = ncamera->get_T_C_B_Mutable(0u);
+  EXPECT_GT(ncamera->getParameterVersion(), version);
+  version = ncamera->getParameterVersion();
+  T_C_B.getPosition()(0) += 1.0;
+  ncamera->markParametersChanged();
+  EXPECT_GT(ncamera->getParameterVersion(), version);
+  EXPECT_NE(new_geometry.get(), ncamera->getGeometry().get());
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
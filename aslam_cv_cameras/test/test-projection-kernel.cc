@@ -0,0 +1,138 @@
+#include <Eigen/Core>
+#include <eigen-checks/gtest.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/camera-unified-projection.h>
+#include <aslam/cameras/distortion-equidistant.h>
+#include <aslam/cameras/distortion-null.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <aslam/cameras/projection-kernel.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-types.h>
+
+namespace {
+/// Compares the kernel against the virtual camera functions on random points.
+struct KernelChecker {
+  template <typename KernelType>
+  void operator()(const KernelType& kernel) const {
+    ++(*num_calls);
+    for (int i = 0; i < 1000; ++i) {
+      // Some of the points are outside of the image or behind the camera.
+      Eigen::Vector3d point_3d =
+          camera->createRandomVisiblePoint(10.0) + 2.0 * Eigen::Vector3d::Random();
+      if (i % 10 == 0) {
+        point_3d = -point_3d;
+      }
+
+      Eigen::Vector2d keypoint, kernel_keypoint;
+      Eigen::Matrix<double, 2, 3> J, kernel_J;
+      const aslam::ProjectionResult result = camera->project3(point_3d, &keypoint, &J);
+      EXPECT_EQ(result, kernel.project3(point_3d, &kernel_keypoint));
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(keypoint, kernel_keypoint, 1e-9));
+      EXPECT_EQ(result, kernel.project3(point_3d, &kernel_keypoint, &kernel_J));
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(J, kernel_J, 1e-9));
+
+      typename KernelType::IntrinsicsJacobian kernel_J_intrinsics;
+      typename KernelType::DistortionJacobian kernel_J_distortion;
+      Eigen::Matrix<double, 2, Eigen::Dynamic> J_intrinsics, J_distortion;
+      EXPECT_EQ(result, camera->project3Functional(point_3d, nullptr, nullptr, &keypoint, &J,
+                                                   &J_intrinsics, &J_distortion));
+      EXPECT_EQ(result, kernel.project3Functional(point_3d, &kernel_keypoint, &kernel_J,
+                                                  &kernel_J_intrinsics, &kernel_J_distortion));
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(keypoint, kernel_keypoint, 1e-9));
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(J, kernel_J, 1e-9));
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(J_intrinsics, kernel_J_intrinsics, 1e-9));
+      if (kernel_J_distortion.size() > 0) {
+        EXPECT_TRUE(EIGEN_MATRIX_NEAR(J_distortion, kernel_J_distortion, 1e-9));
+      }
+
+      if (result.isKeypointVisible()) {
+        Eigen::Vector3d bearing, kernel_bearing;
+        EXPECT_EQ(camera->backProject3(keypoint, &bearing),
+                  kernel.backProject3(keypoint, &kernel_bearing));
+        EXPECT_TRUE(EIGEN_MATRIX_NEAR(bearing, kernel_bearing, 1e-9));
+      }
+    }
+  }
+
+  const aslam::Camera* camera;
+  int* num_calls;
+};
+}  // namespace
+
+TEST(ProjectionKernel, PinholeNullMatchesCamera) {
+  aslam::PinholeCamera::Ptr camera =
+      aslam::PinholeCamera::createTestCamera<aslam::NullDistortion>();
+  EXPECT_TRUE(aslam::PinholeProjectionKernel::isCompatible(*camera));
+  EXPECT_FALSE(aslam::PinholeRadTanProjectionKernel::isCompatible(*camera));
+  int num_calls = 0;
+  KernelChecker checker{camera.get(), &num_calls};
+  EXPECT_TRUE(aslam::visitProjectionKernel(*camera, &checker));
+  EXPECT_EQ(num_calls, 1);
+}
+
+TEST(ProjectionKernel, PinholeRadTanMatchesCamera) {
+  aslam::PinholeCamera::Ptr camera =
+      aslam::PinholeCamera::createTestCamera<aslam::RadTanDistortion>();
+  EXPECT_FALSE(aslam::PinholeProjectionKernel::isCompatible(*camera));
+  EXPECT_TRUE(aslam::PinholeRadTanProjectionKernel::isCompatible(*camera));
+  int num_calls = 0;
+  KernelChecker checker{camera.get(), &num_calls};
+  EXPECT_TRUE(aslam::visitProjectionKernel(*camera, &checker));
+  EXPECT_EQ(num_calls, 1);
+}
+
+TEST(ProjectionKernel, NoKernelForOtherModels) {
+  int num_calls = 0;
+  aslam::Camera::Ptr equidistant_camera =
+      aslam::PinholeCamera::createTestCamera<aslam::EquidistantDistortion>();
+  KernelChecker equidistant_checker{equidistant_camera.get(), &num_calls};
+  EXPECT_FALSE(aslam::visitProjectionKernel(*equidistant_camera, &equidistant_checker));
+
+  aslam::Camera::Ptr unified_camera =
+      aslam::UnifiedProjectionCamera::createTestCamera<aslam::NullDistortion>();
+  KernelChecker unified_checker{unified_camera.get(), &num_calls};
+  EXPECT_FALSE(aslam::visitProjectionKernel(*unified_camera, &unified_checker));
+  EXPECT_EQ(num_calls, 0);
+}
+
+TEST(ProjectionKernel, TransformAndProjectMatchesCamera) {
+  const aslam::Transformation T_C_X(
+      aslam::Quaternion(aslam::AngleAxis(0.1, Eigen::Vector3d(0.2, 1.0, -0.3).normalized())),
+      aslam::Position3D(0.3, -0.1, 0.5));
+  // The kernel path and the virtual fallback, with more points than a block.
+  const aslam::Camera::Ptr cameras[] = {
+      aslam::PinholeCamera::createTestCamera<aslam::RadTanDistortion>(),
+      aslam::UnifiedProjectionCamera::createTestCamera<aslam::NullDistortion>()};
+  for (const aslam::Camera::Ptr& camera : cameras) {
+    Eigen::Matrix3Xd X_points(3, 150);
+    for (int i = 0; i < X_points.cols(); ++i) {
+      X_points.col(i) = T_C_X.inverse() * camera->createRandomVisiblePoint(10.0);
+    }
+    X_points.col(7) = -X_points.col(7);
+    const Eigen::Matrix3Xd C_points = T_C_X.transformVectorized(X_points);
+    Eigen::Matrix2Xd keypoints, fused_keypoints;
+    std::vector<aslam::ProjectionResult> results, fused_results;
+    camera->project3Vectorized(C_points, &keypoints, &results);
+    aslam::transformAndProject3Vectorized(*camera, T_C_X, X_points, &fused_keypoints,
+                                          &fused_results);
+    EXPECT_EQ(results, fused_results);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(keypoints, fused_keypoints, 1e-9));
+
+    Eigen::Matrix2Xf float_keypoints;
+    std::vector<aslam::ProjectionResult> float_results;
+    aslam::transformAndProject3VectorizedFloat(*camera, T_C_X, X_points.cast<float>(),
+                                               &float_keypoints, &float_results);
+    ASSERT_EQ(results.size(), float_results.size());
+    for (size_t i = 0u; i < results.size(); ++i) {
+      if (results[i].isKeypointVisible()) {
+        EXPECT_TRUE(EIGEN_MATRIX_NEAR(
+            keypoints.col(i), float_keypoints.col(i).cast<double>(), 1e-2));
+      }
+    }
+  }
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
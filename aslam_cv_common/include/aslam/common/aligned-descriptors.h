@@ -0,0 +1,99 @@
+#ifndef ASLAM_COMMON_ALIGNED_DESCRIPTORS_H_
+#define ASLAM_COMMON_ALIGNED_DESCRIPTORS_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+#include <aslam/common/hamming.h>
+#include <aslam/common/macros.h>
+
+namespace aslam {
+namespace common {
+
+/// \class AlignedDescriptors
+/// \brief Binary descriptor storage with a padded, SIMD friendly layout.
+///
+/// The descriptors are stored one after the other with a stride that is rounded up to a multiple
+/// of kStrideAlignmentBytes, starting at a kBaseAlignmentBytes aligned address. The padding is
+/// kept zero, such that the Hamming kernels can process whole 256 bit words of every descriptor
+/// without a tail and for any descriptor size. getDescriptors() returns a zero-copy column view
+/// with the layout of VisualFrame::DescriptorsT for existing callers.
+class AlignedDescriptors {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(AlignedDescriptors);
+
+  typedef Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> DescriptorsT;
+  typedef Eigen::Map<const DescriptorsT, Eigen::Unaligned, Eigen::OuterStride<>>
+      ConstDescriptorsMap;
+  typedef Eigen::Map<DescriptorsT, Eigen::Unaligned, Eigen::OuterStride<>> DescriptorsMap;
+
+  /// The stride is a multiple of one AVX2 word, the base pointer is cache line aligned.
+  static constexpr size_t kStrideAlignmentBytes = 32u;
+  static constexpr size_t kBaseAlignmentBytes = 64u;
+
+  AlignedDescriptors();
+  /// Copy the descriptors, one per column, into the padded layout.
+  explicit AlignedDescriptors(const DescriptorsT& descriptors);
+
+  /// Copy the descriptors, one per column, into the padded layout.
+  void setDescriptors(const DescriptorsT& descriptors);
+  /// Resize to num_descriptors zero descriptors of descriptor_size_bytes bytes.
+  void resize(size_t descriptor_size_bytes, size_t num_descriptors);
+
+  size_t size() const { return num_descriptors_; }
+  bool empty() const { return num_descriptors_ == 0u; }
+  size_t getDescriptorSizeBytes() const { return descriptor_size_bytes_; }
+  size_t getStrideBytes() const { return stride_bytes_; }
+  static size_t getStrideBytes(size_t descriptor_size_bytes);
+
+  const unsigned char* data() const { return data_; }
+  const unsigned char* getDescriptor(size_t index) const {
+    DCHECK_LT(index, num_descriptors_);
+    return data_ + stride_bytes_ * index;
+  }
+
+  /// Zero-copy views, the padding rows are not part of the view. Writes through the mutable view
+  /// must leave the padding untouched.
+  ConstDescriptorsMap getDescriptors() const;
+  DescriptorsMap getDescriptorsMutable();
+
+ private:
+  size_t descriptor_size_bytes_;
+  size_t stride_bytes_;
+  size_t num_descriptors_;
+  size_t capacity_bytes_;
+
+  /// The allocation and its first kBaseAlignmentBytes aligned byte.
+  std::unique_ptr<unsigned char[]> buffer_;
+  unsigned char* data_;
+};
+
+/// Same as computeHammingDistancesBatch() of feature-descriptor-ref.h, over padded descriptors.
+/// The distances are computed over the whole zero padded stride, which yields the same result
+/// with the full-width SIMD loads.
+/// @param[in]  query              The query descriptor, in a padded layout of the same stride.
+/// @param[in]  descriptors        The candidate descriptors.
+/// @param[in]  candidate_indices  Indices of the candidate descriptors.
+/// @param[out] out_distances      The distances, in the order of candidate_indices.
+void computeHammingDistancesBatch(
+    const unsigned char* query, const AlignedDescriptors& descriptors,
+    const std::vector<int>& candidate_indices, std::vector<Hamming::ResultType>* out_distances);
+
+/// Bounded variant of the above, the distances are only exact up to max_distance, see
+/// Hamming::evaluateBounded(). The zero padding never adds to the distance.
+/// @param[in] fixed_size_function  Optional, the kernel of Hamming::getFixedSizeBatchFunction()
+///                                 for the descriptor size, which computes exact distances.
+void computeHammingDistancesBatchBounded(
+    const unsigned char* query, const AlignedDescriptors& descriptors,
+    const std::vector<int>& candidate_indices, const Hamming::ResultType max_distance,
+    std::vector<Hamming::ResultType>* out_distances,
+    const Hamming::FixedSizeBatchFunction fixed_size_function = nullptr);
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_ALIGNED_DESCRIPTORS_H_
@@ -0,0 +1,97 @@
+#ifndef ASLAM_COMMON_ALLOCATION_COUNTER_H_
+#define ASLAM_COMMON_ALLOCATION_COUNTER_H_
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+#include <aslam/common/macros.h>
+
+namespace aslam {
+namespace common {
+
+namespace internal {
+/// Called by the allocation hooks on every heap allocation and deallocation.
+void recordHeapAllocation(size_t num_bytes);
+void recordHeapDeallocation();
+void setAllocationHooksInstalled();
+}  // namespace internal
+
+/// \class AllocationCounter
+/// \brief Counts the heap allocations of the calling thread while the counter is alive.
+///
+/// Allocations are only observed if the executable links the aslam_cv_common_allocation_hooks
+/// library, which replaces the global operator new and delete. Counters can be nested, an
+/// allocation counts towards all counters of the thread. A counter with a subsystem name adds
+/// its counts to the process-wide statistics of the subsystem when it is destroyed, which
+/// costs a lock and is skipped without the hooks, hence hot paths keep their counters, e.g.
+///   void GyroTracker::track(...) {
+///     common::AllocationCounter allocation_counter("GyroTracker::track");
+///     ...
+///   }
+/// The counter has to be destroyed on the thread that created it.
+class AllocationCounter {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(AllocationCounter);
+  /// @param[in] subsystem_name  The statistics to add the counts to, null for none. Must
+  ///                            outlive the counter, usually a string literal.
+  explicit AllocationCounter(const char* subsystem_name = nullptr);
+  ~AllocationCounter();
+
+  size_t getNumAllocations() const { return num_allocations_; }
+  size_t getNumAllocatedBytes() const { return num_allocated_bytes_; }
+  size_t getNumDeallocations() const { return num_deallocations_; }
+
+ private:
+  friend void internal::recordHeapAllocation(size_t num_bytes);
+  friend void internal::recordHeapDeallocation();
+
+  const char* const subsystem_name_;
+  AllocationCounter* const parent_;
+  size_t num_allocations_;
+  size_t num_allocated_bytes_;
+  size_t num_deallocations_;
+};
+
+/// The accumulated counts of the counters of a subsystem.
+struct AllocationStatistics {
+  AllocationStatistics() : num_scopes(0u), num_allocations(0u), num_allocated_bytes(0u),
+                           max_num_allocations_per_scope(0u) {}
+  size_t num_scopes;
+  size_t num_allocations;
+  size_t num_allocated_bytes;
+  size_t max_num_allocations_per_scope;
+};
+
+/// The statistics of all subsystems since the start or the last reset, by subsystem name.
+std::map<std::string, AllocationStatistics> getAllocationStatistics();
+void resetAllocationStatistics();
+
+/// Were the allocation hooks linked, i.e. are allocations observed at all.
+bool areAllocationHooksInstalled();
+
+/// Number of heap allocations of all threads since the start of the process, e.g. to count the
+/// allocations of a multi-threaded benchmark. Zero without the hooks.
+size_t getNumProcessHeapAllocations();
+
+/// \class ProcessAllocationCounter
+/// \brief Counts the heap allocations of all threads since the counter was created.
+///
+/// Unlike AllocationCounter it also observes the worker threads of a call, at the price of
+/// counting the allocations of unrelated threads, hence it is meant for benchmarks.
+class ProcessAllocationCounter {
+ public:
+  ProcessAllocationCounter() : num_allocations_start_(getNumProcessHeapAllocations()) {}
+
+  size_t getNumAllocations() const {
+    return getNumProcessHeapAllocations() - num_allocations_start_;
+  }
+
+ private:
+  const size_t num_allocations_start_;
+};
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_ALLOCATION_COUNTER_H_
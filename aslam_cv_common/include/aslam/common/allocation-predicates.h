@@ -0,0 +1,35 @@
+#ifndef ASLAM_COMMON_ALLOCATION_PREDICATES_H_
+#define ASLAM_COMMON_ALLOCATION_PREDICATES_H_
+
+#include <cstddef>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/allocation-counter.h>
+
+/// Checks that the statements make at most max_num_allocations heap allocations on the calling
+/// thread. The test has to link aslam_cv_common_allocation_hooks. Warm up the code under test
+/// first, e.g. to let recycled buffers reach their steady size:
+///   matcher.match(&problem, &matches);
+///   EXPECT_MAX_ALLOCATIONS(0u, { matcher.match(&problem, &matches); });
+#define EXPECT_MAX_ALLOCATIONS(max_num_allocations, ...) \
+  ASLAM_CHECK_MAX_ALLOCATIONS(EXPECT_LE, max_num_allocations, __VA_ARGS__)
+
+#define ASSERT_MAX_ALLOCATIONS(max_num_allocations, ...) \
+  ASLAM_CHECK_MAX_ALLOCATIONS(ASSERT_LE, max_num_allocations, __VA_ARGS__)
+
+#define ASLAM_CHECK_MAX_ALLOCATIONS(check, max_num_allocations, ...)                       \
+  do {                                                                                    \
+    ASSERT_TRUE(::aslam::common::areAllocationHooksInstalled())                           \
+        << "Link aslam_cv_common_allocation_hooks to count the allocations.";             \
+    size_t aslam_num_allocations = 0u;                                                    \
+    {                                                                                     \
+      ::aslam::common::AllocationCounter aslam_allocation_counter;                        \
+      __VA_ARGS__;                                                                        \
+      aslam_num_allocations = aslam_allocation_counter.getNumAllocations();               \
+    }                                                                                     \
+    check(aslam_num_allocations, static_cast<size_t>(max_num_allocations))                \
+        << "Heap allocations of: " #__VA_ARGS__;                                          \
+  } while (false)
+
+#endif  // ASLAM_COMMON_ALLOCATION_PREDICATES_H_
@@ -0,0 +1,26 @@
+#ifndef ASLAM_COMMON_BASE64_H_
+#define ASLAM_COMMON_BASE64_H_
+
+#include <cstddef>
+#include <string>
+
+namespace aslam {
+namespace common {
+
+/// Number of base64 characters of the padded encoding of num_bytes bytes.
+inline size_t getBase64EncodedSize(size_t num_bytes) {
+  return (num_bytes + 2u) / 3u * 4u;
+}
+
+/// \brief Encode bytes to padded base64 (RFC 4648) without line breaks.
+std::string encodeBase64(const void* data, size_t num_bytes);
+
+/// \brief Decode padded base64 directly into a buffer of the expected decoded size.
+/// @return False if the string has the wrong length or contains invalid characters, the buffer is
+///         undefined then.
+bool decodeBase64(const std::string& encoded, void* data, size_t num_bytes);
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_BASE64_H_
@@ -9,7 +9,7 @@
 #include <aslam/common/channel.h>
 #include <aslam/common/macros.h>
 
-#define DECLARE_CHANNEL_IMPL(NAME, TYPE)                                   \
+#define DECLARE_CHANNEL_IMPL(NAME, SLOT, TYPE)                             \
 namespace aslam {                                                          \
 namespace channels {                                                       \
                                                                            \
@@ -26,6 +26,10 @@ typedef Channel<NAME##_ChannelValueType> NAME##_ChannelType;               \
 NAME##_ChannelValueType& get_##NAME##_Data(                                \
     const ChannelGroup& channel_group) {                                   \
   std::lock_guard<std::mutex> lock(channel_group.m_channels_);             \
+  ChannelBase* slot = internal::getChannelSlot<SLOT>(channel_group);       \
+  if (slot != nullptr) {                                                   \
+    return static_cast<NAME##_ChannelType*>(slot)->value_;                 \
+  }                                                                        \
   const ChannelMap& channels = channel_group.channels_;                    \
   ChannelMap::const_iterator it = channels.find(NAME##_CHANNEL);           \
   CHECK(it != channels.end()) << "Channelgroup does not "                  \
@@ -34,6 +38,33 @@ NAME##_ChannelValueType& get_##NAME##_Data(                                \
      std::dynamic_pointer_cast<NAME##_ChannelType>(it->second);            \
   CHECK(derived) << "Channel cast to derived failed " <<                   \
      "channel: " << NAME##_CHANNEL;                                        \
+  /* Slots only cache decoded channels. */                                 \
+  derived->load();                                                         \
+  internal::setChannelSlot<SLOT>(derived.get(), channel_group);            \
+  return derived->value_;                                                  \
+}                                                                          \
+                                                                           \
+/* Copy-on-write access: a channel shared with copies of the group is     \
+   detached first. With copy_if_shared = false the detached channel is     \
+   default constructed, e.g. if the value is overwritten anyway, and a     \
+   lazy payload is dropped instead of decoded. */                          \
+NAME##_ChannelValueType& get_##NAME##_DataMutable(                         \
+    ChannelGroup* channel_group, bool copy_if_shared = true) {              \
+  CHECK_NOTNULL(channel_group);                                            \
+  std::lock_guard<std::mutex> lock(channel_group->m_channels_);            \
+  ChannelMap::iterator it = channel_group->channels_.find(NAME##_CHANNEL); \
+  CHECK(it != channel_group->channels_.end()) << "Channelgroup does not "  \
+      "contain channel " << NAME##_CHANNEL;                                \
+  NAME##_ChannelType* derived = internal::getUniqueChannel<                \
+      NAME##_ChannelType>(&it->second, copy_if_shared);                    \
+  CHECK(derived) << "Channel cast to derived failed " <<                   \
+     "channel: " << NAME##_CHANNEL;                                        \
+  if (copy_if_shared) {                                                    \
+    derived->load();                                                       \
+  } else {                                                                 \
+    derived->discardLazyPayload();                                         \
+  }                                                                        \
+  internal::setChannelSlot<SLOT>(derived, *channel_group);                 \
   return derived->value_;                                                  \
 }                                                                          \
                                                                            \
@@ -47,11 +78,15 @@ NAME##_ChannelValueType& add_##NAME##_Channel(                             \
       "contains channel " << NAME##_CHANNEL;                               \
   std::shared_ptr<NAME##_ChannelType> derived(new NAME##_ChannelType);     \
   (*channels)[NAME##_CHANNEL] = derived;                                   \
+  internal::setChannelSlot<SLOT>(derived.get(), *channel_group);           \
   return derived->value_;                                                  \
 }                                                                          \
                                                                            \
 bool has_##NAME##_Channel(const ChannelGroup& channel_group) {             \
   std::lock_guard<std::mutex> lock(channel_group.m_channels_);             \
+  if (internal::getChannelSlot<SLOT>(channel_group) != nullptr) {          \
+    return true;                                                           \
+  }                                                                        \
   const ChannelMap& channels = channel_group.channels_;                    \
   ChannelMap::const_iterator it = channels.find(NAME##_CHANNEL);           \
   return it != channels.end();                                             \
@@ -63,12 +98,16 @@ void remove_##NAME##_Channel(ChannelGroup* channel_group) {                \
   ChannelMap& channels = channel_group->channels_;                         \
   CHECK_EQ(channels.erase(NAME##_CHANNEL), 1u)                             \
     << "Channelgroup does not contain channel " << NAME##_CHANNEL;         \
+  internal::setChannelSlot<SLOT>(nullptr, *channel_group);                 \
 }                                                                          \
 }                                                                          \
 }                                                                          \
 
 // Wrap types that contain commas inside braces.
-#define DECLARE_CHANNEL(x, ...) DECLARE_CHANNEL_IMPL(x, (__VA_ARGS__))
+#define DECLARE_CHANNEL(x, ...) DECLARE_CHANNEL_IMPL(x, kNoChannelSlot, (__VA_ARGS__))
+
+// Declare a built-in channel that is additionally cached in the given ChannelSlot of the group.
+#define DECLARE_CHANNEL_WITH_SLOT(x, slot, ...) DECLARE_CHANNEL_IMPL(x, slot, (__VA_ARGS__))
 
 namespace aslam {
 namespace channels {
@@ -84,6 +123,30 @@ CHANNEL_DATA_TYPE& getChannelData(const std::string& channel_name,
       std::dynamic_pointer_cast < DerivedChannel > (it->second);
   CHECK(derived) << "Channel cast to derived failed " <<
                     "channel: " << channel_name;
+  derived->load();
+  return derived->value_;
+}
+
+/// Copy-on-write access to the channel data, see get_<NAME>_DataMutable.
+template<typename CHANNEL_DATA_TYPE>
+CHANNEL_DATA_TYPE& getChannelDataMutable(const std::string& channel_name,
+                                         ChannelGroup* channel_group,
+                                         bool copy_if_shared = true) {
+  CHECK_NOTNULL(channel_group);
+  std::lock_guard<std::mutex> lock(channel_group->m_channels_);
+  ChannelMap::iterator it = channel_group->channels_.find(channel_name);
+  CHECK(it != channel_group->channels_.end()) << "Channelgroup does not "
+      "contain channel " << channel_name;
+  typedef Channel<CHANNEL_DATA_TYPE> DerivedChannel;
+  DerivedChannel* derived =
+      internal::getUniqueChannel<DerivedChannel>(&it->second, copy_if_shared);
+  CHECK(derived) << "Channel cast to derived failed " <<
+                    "channel: " << channel_name;
+  if (copy_if_shared) {
+    derived->load();
+  } else {
+    derived->discardLazyPayload();
+  }
   return derived->value_;
 }
 
@@ -107,6 +170,24 @@ CHANNEL_DATA_TYPE& addChannel(const std::string& channel_name,
   channel_group->channels_[channel_name] = derived;
   return derived->value_;
 }
+
+/// Add a channel that is decoded from the raw data on first access, see
+/// ChannelBase::setLazyPayload. The channel is not cached in a slot until it is decoded.
+template<typename CHANNEL_DATA_TYPE>
+void addLazyChannel(const std::string& channel_name,
+                    const aslam::internal::RawChannelData& raw_data,
+                    const std::shared_ptr<const void>& buffer,
+                    ChannelGroup* channel_group) {
+  CHECK_NOTNULL(channel_group);
+  std::lock_guard<std::mutex> lock(channel_group->m_channels_);
+  ChannelMap::iterator it = channel_group->channels_.find(channel_name);
+  CHECK(it == channel_group->channels_.end()) << "Channelgroup already "
+      "contains channel " << channel_name;
+  typedef Channel<CHANNEL_DATA_TYPE> DerivedChannel;
+  std::shared_ptr<DerivedChannel> derived(new DerivedChannel);
+  derived->setLazyPayload(raw_data, buffer);
+  channel_group->channels_[channel_name] = derived;
+}
 }  // namespace channels
 }  // namespace aslam
 
@@ -1,12 +1,15 @@
 #ifndef ASLAM_CV_COMMON_CHANNEL_DEFINITIONS_H_
 #define ASLAM_CV_COMMON_CHANNEL_DEFINITIONS_H_
 
+#include <vector>
+
 #include <Eigen/Dense>
 #include <aslam/common/channel-declaration.h>
 
 /// Coordinates of the raw keypoints. (keypoint detector output)
 /// (cols are keypoints)
-DECLARE_CHANNEL(VISUAL_KEYPOINT_MEASUREMENTS, Eigen::Matrix2Xd)
+DECLARE_CHANNEL_WITH_SLOT(VISUAL_KEYPOINT_MEASUREMENTS, kVisualKeypointMeasurementsSlot,
+                          Eigen::Matrix2Xd)
 
 /// Keypoint coordinate uncertainties of the raw keypoints. (keypoint detector output)
 /// (cols are uncertainties)
@@ -15,26 +18,47 @@ DECLARE_CHANNEL(VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES, Eigen::VectorXd)
 /// Keypoint orientation from keypoint extractor. (keypoint detector output)
 /// Computed orientation of the keypoint (-1 if not applicable);
 /// it's in [0,360) degrees and measured relative to image coordinate system, ie in clockwise.
-DECLARE_CHANNEL(VISUAL_KEYPOINT_ORIENTATIONS, Eigen::VectorXd)
+DECLARE_CHANNEL_WITH_SLOT(VISUAL_KEYPOINT_ORIENTATIONS, kVisualKeypointOrientationsSlot,
+                          Eigen::VectorXd)
 
 /// Diameter of the meaningful keypoint neighborhood. (keypoint detector output)
-DECLARE_CHANNEL(VISUAL_KEYPOINT_SCALES, Eigen::VectorXd)
+DECLARE_CHANNEL_WITH_SLOT(VISUAL_KEYPOINT_SCALES, kVisualKeypointScalesSlot, Eigen::VectorXd)
 
 /// The score by which the most strong keypoints have been selected. Can be used for the further
 /// sorting or subsampling. (keypoint detector output)
-DECLARE_CHANNEL(VISUAL_KEYPOINT_SCORES, Eigen::VectorXd)
+DECLARE_CHANNEL_WITH_SLOT(VISUAL_KEYPOINT_SCORES, kVisualKeypointScoresSlot, Eigen::VectorXd)
 
 /// The keypoint descriptors. (extractor output)
 /// (cols are descriptors)
-DECLARE_CHANNEL(DESCRIPTORS,
-                Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>)
+DECLARE_CHANNEL_WITH_SLOT(DESCRIPTORS, kDescriptorsSlot,
+                          Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>)
+
+/// Floating point keypoint descriptors, e.g. of KAZE. (extractor output)
+/// (cols are descriptors)
+DECLARE_CHANNEL(FLOAT_DESCRIPTORS, Eigen::MatrixXf)
 
 /// Track ID's for tracked features. (-1 if not tracked); (feature tracker output)
-DECLARE_CHANNEL(TRACK_IDS, Eigen::VectorXi)
+DECLARE_CHANNEL_WITH_SLOT(TRACK_IDS, kTrackIdsSlot, Eigen::VectorXi)
+
+/// Line segments, (x, y) of the start point followed by (x, y) of the end point.
+/// (cols are segments; line detector output)
+DECLARE_CHANNEL(VISUAL_LINE_SEGMENTS, Eigen::Matrix4Xd)
+
+/// The score by which the segments can be ranked, e.g. their length. (line detector output)
+DECLARE_CHANNEL(VISUAL_LINE_SEGMENT_SCORES, Eigen::VectorXd)
 
 /// The raw image.
 DECLARE_CHANNEL(RAW_IMAGE, cv::Mat)
 
 DECLARE_CHANNEL(CV_MAT, cv::Mat)
 
+/// Image pyramid of the image the keypoints were detected in, as built by
+/// cv::buildOpticalFlowPyramid. Can be passed to cv::calcOpticalFlowPyrLK in place of the image.
+DECLARE_CHANNEL(IMAGE_PYRAMID, std::vector<cv::Mat>)
+
+/// Matches between the keypoints of two cameras of an nframe, (camera index, keypoint index) of
+/// the apple followed by (camera index, keypoint index) of the banana.
+/// (cols are matches; intra-rig matcher output)
+DECLARE_CHANNEL(INTRA_RIG_MATCHES, Eigen::Matrix4Xi)
+
 #endif  // ASLAM_CV_COMMON_CHANNEL_DEFINITIONS_H_
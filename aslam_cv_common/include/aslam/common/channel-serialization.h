@@ -1,11 +1,16 @@
 #ifndef ASLAM_CHANNEL_SERIALIZATION_H_
 #define ASLAM_CHANNEL_SERIALIZATION_H_
 
+#include <sys/uio.h>
+
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <type_traits>
+#include <vector>
 
 #include <glog/logging.h>
 #include <Eigen/Dense>
@@ -156,6 +161,16 @@ bool deSerializeFromBuffer(const char* const buffer, size_t size,
 bool serializeToBuffer(const cv::Mat& matrix,
                        char** buffer, size_t* size);
 
+/// Image lists, e.g. image pyramids, are stored as the number of images followed by the size and
+/// the serialized data of every image.
+bool serializeToString(const std::vector<cv::Mat>& images, std::string* string);
+
+bool deSerializeFromString(const std::string& string, std::vector<cv::Mat>* images);
+
+bool deSerializeFromBuffer(const char* const buffer, size_t size, std::vector<cv::Mat>* images);
+
+bool serializeToBuffer(const std::vector<cv::Mat>& images, char** buffer, size_t* size);
+
 template<typename Scalar>
 bool serializeToString(const Scalar& value, std::string* string) {
   CHECK_NOTNULL(string);
@@ -202,6 +217,314 @@ bool deSerializeFromBuffer(const char* const buffer, size_t size, Scalar* value)
   return true;
 }
 
+/// \class SerializationSink
+/// \brief Receives the bytes of a streamed channel serialization, the concatenation of all
+///        writes equals the string of serializeToString.
+class SerializationSink {
+ public:
+  virtual ~SerializationSink() {}
+  /// Write bytes that are only valid during the call, e.g. headers on the stack.
+  virtual bool write(const char* data, size_t size_bytes) = 0;
+  /// Write bytes of the channel value, they stay valid as long as the value is alive and
+  /// unmodified. Sinks may reference them instead of copying.
+  virtual bool writePersistent(const char* data, size_t size_bytes) {
+    return write(data, size_bytes);
+  }
+};
+
+/// Writes straight into an output stream.
+class StreamSerializationSink : public SerializationSink {
+ public:
+  explicit StreamSerializationSink(std::ostream* stream) : stream_(CHECK_NOTNULL(stream)) {}
+  bool write(const char* data, size_t size_bytes) {
+    stream_->write(data, size_bytes);
+    return stream_->good();
+  }
+
+ private:
+  std::ostream* stream_;
+};
+
+/// Writes into a preallocated buffer, e.g. of the size given by SizeSerializationSink. Fails
+/// instead of writing past the end of the buffer.
+class BufferSerializationSink : public SerializationSink {
+ public:
+  BufferSerializationSink(char* buffer, size_t size_bytes)
+      : buffer_(CHECK_NOTNULL(buffer)), size_bytes_(size_bytes), num_bytes_written_(0u) {}
+  bool write(const char* data, size_t size_bytes) {
+    if (size_bytes > size_bytes_ - num_bytes_written_) {
+      return false;
+    }
+    memcpy(buffer_ + num_bytes_written_, data, size_bytes);
+    num_bytes_written_ += size_bytes;
+    return true;
+  }
+  size_t getNumBytesWritten() const { return num_bytes_written_; }
+
+ private:
+  char* buffer_;
+  size_t size_bytes_;
+  size_t num_bytes_written_;
+};
+
+/// Only counts the bytes, to size buffers before serializing.
+class SizeSerializationSink : public SerializationSink {
+ public:
+  SizeSerializationSink() : num_bytes_(0u) {}
+  bool write(const char* /*data*/, size_t size_bytes) {
+    num_bytes_ += size_bytes;
+    return true;
+  }
+  size_t getNumBytes() const { return num_bytes_; }
+
+ private:
+  size_t num_bytes_;
+};
+
+/// Collects the serialization as iovecs for writev. The iovecs of the channel values point
+/// directly at their memory, only the headers are copied into buffers owned by the sink. The
+/// values must therefore stay alive and unmodified until the iovecs have been written.
+class IoVectorSerializationSink : public SerializationSink {
+ public:
+  IoVectorSerializationSink() : num_bytes_(0u) {}
+  bool write(const char* data, size_t size_bytes) {
+    if (size_bytes == 0u) {
+      return true;
+    }
+    buffers_.emplace_back(data, data + size_bytes);
+    return writePersistent(buffers_.back().data(), size_bytes);
+  }
+  bool writePersistent(const char* data, size_t size_bytes) {
+    if (size_bytes == 0u) {
+      return true;
+    }
+    iovec io_vector;
+    io_vector.iov_base = const_cast<char*>(data);
+    io_vector.iov_len = size_bytes;
+    io_vectors_.push_back(io_vector);
+    num_bytes_ += size_bytes;
+    return true;
+  }
+  const std::vector<iovec>& getIoVectors() const { return io_vectors_; }
+  size_t getNumBytes() const { return num_bytes_; }
+
+ private:
+  /// A deque keeps the buffers in place while new ones are added.
+  std::deque<std::vector<char>> buffers_;
+  std::vector<iovec> io_vectors_;
+  size_t num_bytes_;
+};
+
+/// \class DeSerializationSource
+/// \brief Provides the bytes of a streamed channel serialization. The values read their headers
+///        and then their data directly into their own memory, without an intermediate string.
+class DeSerializationSource {
+ public:
+  virtual ~DeSerializationSource() {}
+  virtual bool read(char* data, size_t size_bytes) = 0;
+};
+
+class StreamDeSerializationSource : public DeSerializationSource {
+ public:
+  explicit StreamDeSerializationSource(std::istream* stream) : stream_(CHECK_NOTNULL(stream)) {}
+  bool read(char* data, size_t size_bytes) {
+    stream_->read(data, size_bytes);
+    return static_cast<size_t>(stream_->gcount()) == size_bytes;
+  }
+
+ private:
+  std::istream* stream_;
+};
+
+/// Reads from a buffer, e.g. a mapped file, without copying it first.
+class BufferDeSerializationSource : public DeSerializationSource {
+ public:
+  BufferDeSerializationSource(const char* buffer, size_t size_bytes)
+      : buffer_(CHECK_NOTNULL(buffer)), size_bytes_(size_bytes), num_bytes_read_(0u) {}
+  bool read(char* data, size_t size_bytes) {
+    if (size_bytes > size_bytes_ - num_bytes_read_) {
+      return false;
+    }
+    memcpy(data, buffer_ + num_bytes_read_, size_bytes);
+    num_bytes_read_ += size_bytes;
+    return true;
+  }
+  size_t getNumBytesRead() const { return num_bytes_read_; }
+
+ private:
+  const char* buffer_;
+  size_t size_bytes_;
+  size_t num_bytes_read_;
+};
+
+/// Streams values without a raw memory representation through their string serialization.
+template<typename ValueType>
+bool serializeToSink(const ValueType& value, SerializationSink* sink) {
+  CHECK_NOTNULL(sink);
+  std::string string;
+  if (!serializeToString(value, &string)) {
+    return false;
+  }
+  return sink->write(string.data(), string.size());
+}
+
+template<typename ValueType>
+bool deSerializeFromSource(DeSerializationSource* source, size_t size, ValueType* value) {
+  CHECK_NOTNULL(source);
+  CHECK_NOTNULL(value);
+  std::string string(size, '\0');
+  if (size > 0u && !source->read(&string[0], size)) {
+    return false;
+  }
+  return deSerializeFromString(string, value);
+}
+
+template<typename Scalar, int ROWS, int COLS>
+bool serializeToSink(const Eigen::Matrix<Scalar, ROWS, COLS>& matrix, SerializationSink* sink) {
+  CHECK_NOTNULL(sink);
+  HeaderInformation header;
+  // Eigen matrices have only one channel
+  makeHeaderInformation<Scalar>(matrix.rows(), matrix.cols(), 1, &header);
+  char header_buffer[sizeof(HeaderInformation)];
+  CHECK_LE(header.size(), sizeof(header_buffer));
+  if (!header.serializeToBuffer(header_buffer, 0) ||
+      !sink->write(header_buffer, header.size())) {
+    return false;
+  }
+  return sink->writePersistent(reinterpret_cast<const char*>(matrix.data()),
+                               sizeof(Scalar) * matrix.size());
+}
+
+template<typename Scalar, int ROWS, int COLS>
+bool deSerializeFromSource(DeSerializationSource* source, size_t size,
+                           Eigen::Matrix<Scalar, ROWS, COLS>* matrix) {
+  CHECK_NOTNULL(source);
+  CHECK_NOTNULL(matrix);
+  HeaderInformation header;
+  CHECK_GE(size, header.size());
+  char header_buffer[sizeof(HeaderInformation)];
+  if (!source->read(header_buffer, header.size()) ||
+      !header.deSerializeFromBuffer(header_buffer, 0)) {
+    LOG(ERROR) << "Failed to deserialize the matrix header.";
+    return false;
+  }
+  if (ROWS != Eigen::Dynamic) {
+    CHECK_EQ(header.rows, static_cast<uint32_t>(ROWS));
+  }
+  if (COLS != Eigen::Dynamic) {
+    CHECK_EQ(header.cols, static_cast<uint32_t>(COLS));
+  }
+  CHECK_EQ(header.depth, cv::DataType<Scalar>::depth);
+  CHECK_EQ(1u, header.channels) << "Eigen matrices must have one channel.";
+  matrix->resize(header.rows, header.cols);
+  const size_t matrix_size = sizeof(Scalar) * matrix->size();
+  CHECK_EQ(size, matrix_size + header.size());
+  return source->read(reinterpret_cast<char*>(matrix->data()), matrix_size);
+}
+
+/// Images are streamed row by row, hence views like pyramid levels are not copied first.
+bool serializeToSink(const cv::Mat& image, SerializationSink* sink);
+
+bool deSerializeFromSource(DeSerializationSource* source, size_t size, cv::Mat* image);
+
+bool serializeToSink(const std::vector<cv::Mat>& images, SerializationSink* sink);
+
+bool deSerializeFromSource(DeSerializationSource* source, size_t size,
+                           std::vector<cv::Mat>* images);
+
+/// Describes the memory of a channel value for serializers that write it without copying.
+struct RawChannelData {
+  const char* data;
+  size_t size_bytes;
+  uint32_t rows;
+  uint32_t cols;
+  /// OpenCV depth of the scalar type, e.g. CV_64F.
+  uint32_t depth;
+  /// Interleaved channels of an image, one for Eigen matrices.
+  uint32_t channels;
+  bool column_major;
+};
+
+/// Values without a contiguous memory representation provide no raw data.
+template<typename ValueType>
+bool getRawChannelData(const ValueType& /*value*/, RawChannelData* /*raw_data*/) {
+  return false;
+}
+
+template<typename Scalar, int ROWS, int COLS, int OPTIONS, int MAX_ROWS, int MAX_COLS>
+bool getRawChannelData(
+    const Eigen::Matrix<Scalar, ROWS, COLS, OPTIONS, MAX_ROWS, MAX_COLS>& matrix,
+    RawChannelData* raw_data) {
+  CHECK_NOTNULL(raw_data);
+  raw_data->data = reinterpret_cast<const char*>(matrix.data());
+  raw_data->size_bytes = sizeof(Scalar) * matrix.size();
+  raw_data->rows = static_cast<uint32_t>(matrix.rows());
+  raw_data->cols = static_cast<uint32_t>(matrix.cols());
+  raw_data->depth = cv::DataType<Scalar>::depth;
+  raw_data->channels = 1u;
+  raw_data->column_major = !(OPTIONS & Eigen::RowMajor);
+  return true;
+}
+
+inline bool getRawChannelData(const cv::Mat& image, RawChannelData* raw_data) {
+  CHECK_NOTNULL(raw_data);
+  if (!image.empty() && !image.isContinuous()) {
+    return false;
+  }
+  raw_data->data = reinterpret_cast<const char*>(image.data);
+  raw_data->size_bytes = image.total() * image.elemSize();
+  raw_data->rows = static_cast<uint32_t>(image.rows);
+  raw_data->cols = static_cast<uint32_t>(image.cols);
+  raw_data->depth = static_cast<uint32_t>(image.depth());
+  raw_data->channels = static_cast<uint32_t>(image.channels());
+  raw_data->column_major = false;
+  return true;
+}
+
+/// Copy raw data back into a value, the inverse of getRawChannelData. Returns false if the
+/// description does not match the value type.
+template<typename ValueType>
+bool setFromRawChannelData(const RawChannelData& /*raw_data*/, ValueType* /*value*/) {
+  return false;
+}
+
+template<typename Scalar, int ROWS, int COLS, int OPTIONS, int MAX_ROWS, int MAX_COLS>
+bool setFromRawChannelData(
+    const RawChannelData& raw_data,
+    Eigen::Matrix<Scalar, ROWS, COLS, OPTIONS, MAX_ROWS, MAX_COLS>* matrix) {
+  CHECK_NOTNULL(matrix);
+  const bool column_major = !(OPTIONS & Eigen::RowMajor);
+  if (raw_data.depth != static_cast<uint32_t>(cv::DataType<Scalar>::depth) ||
+      raw_data.channels != 1u || raw_data.column_major != column_major ||
+      (ROWS != Eigen::Dynamic && raw_data.rows != static_cast<uint32_t>(ROWS)) ||
+      (COLS != Eigen::Dynamic && raw_data.cols != static_cast<uint32_t>(COLS)) ||
+      raw_data.size_bytes != sizeof(Scalar) * raw_data.rows * raw_data.cols) {
+    return false;
+  }
+  matrix->resize(raw_data.rows, raw_data.cols);
+  if (raw_data.size_bytes > 0u) {
+    memcpy(matrix->data(), CHECK_NOTNULL(raw_data.data), raw_data.size_bytes);
+  }
+  return true;
+}
+
+inline bool setFromRawChannelData(const RawChannelData& raw_data, cv::Mat* image) {
+  CHECK_NOTNULL(image);
+  if (raw_data.column_major || raw_data.channels == 0u) {
+    return false;
+  }
+  if (raw_data.rows == 0u || raw_data.cols == 0u) {
+    *image = cv::Mat();
+    return raw_data.size_bytes == 0u;
+  }
+  image->create(raw_data.rows, raw_data.cols, CV_MAKETYPE(raw_data.depth, raw_data.channels));
+  if (image->total() * image->elemSize() != raw_data.size_bytes) {
+    return false;
+  }
+  memcpy(image->data, CHECK_NOTNULL(raw_data.data), raw_data.size_bytes);
+  return true;
+}
+
 }  // namespace internal
 }  // namespace aslam
 
@@ -15,13 +15,18 @@
 /// @}
 /// @}
 
+#include <array>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <aslam/common/channel-serialization.h>
 #include <aslam/common/crtp-clone.h>
 #include <aslam/common/macros.h>
+#include <aslam/common/memory-usage.h>
 #include <aslam/common/meta.h>
 
 namespace aslam {
@@ -54,15 +59,80 @@ class ChannelBase {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   ASLAM_DISALLOW_EVIL_CONSTRUCTORS(ChannelBase);
-  ChannelBase() {}
+  ChannelBase() : has_lazy_payload_(false) {}
   virtual ~ChannelBase() {};
   virtual bool serializeToString(std::string* string) const = 0;
   virtual bool deSerializeFromString(const std::string& string) = 0;
   virtual bool serializeToBuffer(char** buffer, size_t* size) const = 0;
   virtual bool deSerializeFromBuffer(const char* const buffer, size_t size) = 0;
+  /// Stream the serialization into a sink without an intermediate string, the written bytes
+  /// equal the string of serializeToString.
+  virtual bool serializeToSink(aslam::internal::SerializationSink* sink) const = 0;
+  /// Read a serialization of size bytes directly into the value.
+  virtual bool deSerializeFromSource(aslam::internal::DeSerializationSource* source,
+                                     size_t size) = 0;
   virtual std::string name() const = 0;
   virtual ChannelBase* clone() const = 0;
   virtual bool compare(const ChannelBase& right) = 0;
+  /// Get a view of the value memory, returns false if the value is not stored contiguously.
+  virtual bool getRawData(aslam::internal::RawChannelData* raw_data) const = 0;
+  /// Memory of the channel and its value. The buffer of a pending lazy payload is not owned by
+  /// the channel and not counted.
+  virtual size_t getMemoryUsageBytes() const = 0;
+
+  /// Size of the serialization, e.g. to preallocate the buffer of
+  /// serializeToPreallocatedBuffer or to write a length prefix.
+  size_t getSerializedSize() const {
+    aslam::internal::SizeSerializationSink sink;
+    CHECK(serializeToSink(&sink));
+    return sink.getNumBytes();
+  }
+  bool serializeToStream(std::ostream* stream) const {
+    aslam::internal::StreamSerializationSink sink(stream);
+    return serializeToSink(&sink);
+  }
+  /// Fails if the buffer is smaller than getSerializedSize().
+  bool serializeToPreallocatedBuffer(char* buffer, size_t size) const {
+    aslam::internal::BufferSerializationSink sink(buffer, size);
+    return serializeToSink(&sink);
+  }
+  bool deSerializeFromStream(std::istream* stream, size_t size) {
+    aslam::internal::StreamDeSerializationSource source(stream);
+    return deSerializeFromSource(&source, size);
+  }
+
+  /// \brief Defer the decoding of the value: The value is set from the raw data when the channel
+  ///        is first accessed through the channel group accessors. The buffer owns the memory the
+  ///        raw data points into and is released after the decoding.
+  void setLazyPayload(const aslam::internal::RawChannelData& raw_data,
+                      const std::shared_ptr<const void>& buffer);
+  /// Is the value still waiting to be decoded from a lazy payload?
+  bool hasLazyPayload() const {
+    return has_lazy_payload_.load(std::memory_order_acquire);
+  }
+  /// Decode a pending lazy payload into the value, a no-op otherwise. Safe to call concurrently.
+  void load() const;
+  /// Drop a pending lazy payload without decoding it, e.g. because the value is overwritten.
+  void discardLazyPayload();
+
+ protected:
+  /// Set the value from the raw data of a lazy payload.
+  virtual bool setValueFromRawData(const aslam::internal::RawChannelData& raw_data) = 0;
+  /// Get the raw data of a pending lazy payload, returns false if the value is decoded.
+  bool getLazyRawData(aslam::internal::RawChannelData* raw_data) const;
+  /// Share the pending lazy payload of another channel, returns false if the other channel is
+  /// decoded already.
+  bool copyLazyPayloadFrom(const ChannelBase& other);
+
+ private:
+  struct LazyPayload {
+    aslam::internal::RawChannelData raw_data;
+    std::shared_ptr<const void> buffer;
+  };
+  mutable std::mutex m_lazy_payload_;
+  mutable std::unique_ptr<LazyPayload> lazy_payload_;
+  /// Set while lazy_payload_ is pending, checked before taking the lock.
+  mutable std::atomic<bool> has_lazy_payload_;
 };
 
 template<typename TYPE>
@@ -77,27 +147,57 @@ class Channel : public aslam::Cloneable<ChannelBase, Channel<TYPE>> {
   virtual std::string name() const { return "unnamed"; }
   bool operator==(const Channel<TYPE>& other);
 
+  /// A pending lazy payload is shared with the copy instead of being decoded.
   Channel(const Channel<TYPE>& other) {
-    value_ = internal::ChannelValueCloner<TYPE>::clone(other.value_);
+    if (!this->copyLazyPayloadFrom(other)) {
+      value_ = internal::ChannelValueCloner<TYPE>::clone(other.value_);
+    }
   }
   void operator=(const Channel<TYPE>&) = delete;
   virtual bool compare(const ChannelBase& other) {
     return *this == *CHECK_NOTNULL(dynamic_cast<const Channel<TYPE>*>(&other));
   }
   bool serializeToString(std::string* string) const {
+    this->load();
     return aslam::internal::serializeToString(value_, string);
   }
   bool serializeToBuffer(char** buffer, size_t* size) const {
+    this->load();
     return aslam::internal::serializeToBuffer(value_, buffer, size);
   }
   bool deSerializeFromString(const std::string& string) {
+    this->discardLazyPayload();
     return aslam::internal::deSerializeFromString(string, &value_);
   }
   bool deSerializeFromBuffer(const char* const buffer, size_t size) {
+    this->discardLazyPayload();
     return aslam::internal::deSerializeFromBuffer(buffer, size, &value_);
   }
+  bool serializeToSink(aslam::internal::SerializationSink* sink) const {
+    this->load();
+    return aslam::internal::serializeToSink(value_, sink);
+  }
+  bool deSerializeFromSource(aslam::internal::DeSerializationSource* source, size_t size) {
+    this->discardLazyPayload();
+    return aslam::internal::deSerializeFromSource(source, size, &value_);
+  }
+  /// A pending lazy payload is returned as is, i.e. re-serializing it does not decode it.
+  bool getRawData(aslam::internal::RawChannelData* raw_data) const {
+    if (this->getLazyRawData(raw_data)) {
+      return true;
+    }
+    return aslam::internal::getRawChannelData(value_, raw_data);
+  }
+  size_t getMemoryUsageBytes() const {
+    return sizeof(*this) + aslam::common::getMemoryUsageBytes(value_);
+  }
   TYPE value_;
 
+ protected:
+  bool setValueFromRawData(const aslam::internal::RawChannelData& raw_data) {
+    return aslam::internal::setFromRawChannelData(raw_data, &value_);
+  }
+
  private:
   bool equal_to(const Channel<TYPE>& other, std::true_type /*is_not_pointer */) {
     return value_ == other.value_;
@@ -114,19 +214,41 @@ class Channel : public aslam::Cloneable<ChannelBase, Channel<TYPE>> {
 };
 
 template<> bool Channel<cv::Mat>::operator==(const Channel<cv::Mat>& other);
+template<> bool Channel<std::vector<cv::Mat>>::operator==(
+    const Channel<std::vector<cv::Mat>>& other);
 template<typename TYPE>
 bool Channel<TYPE>::operator==(const Channel<TYPE>& other) {
+  this->load();
+  other.load();
   return equal_to(other, typename is_not_pointer<TYPE>::type());
 }
 
+/// Statically indexed slots of the built-in channels that are accessed in the inner loops of the
+/// trackers and matchers. The slot caches the channel of the map to skip the string lookup and
+/// the dynamic cast; all other channels only live in the string-keyed map.
+enum ChannelSlot : int {
+  kNoChannelSlot = -1,
+  kVisualKeypointMeasurementsSlot = 0,
+  kVisualKeypointScoresSlot,
+  kVisualKeypointScalesSlot,
+  kVisualKeypointOrientationsSlot,
+  kDescriptorsSlot,
+  kTrackIdsSlot,
+  kNumChannelSlots
+};
+
 typedef std::unordered_map<std::string, std::shared_ptr<ChannelBase>> ChannelMap;
 struct ChannelGroup {
-  ChannelGroup() = default;
+  ChannelGroup() {
+    slots_.fill(nullptr);
+  }
   ChannelGroup(ChannelGroup& other) {
     *this = other;
   }
   ChannelGroup& operator=(const ChannelGroup& other) {
     channels_ = other.channels_;
+    // The slots are refilled lazily from the new map.
+    slots_.fill(nullptr);
     return *this;
   }
 
@@ -145,10 +267,57 @@ struct ChannelGroup {
 
   ChannelMap channels_;
   mutable std::mutex m_channels_;
+  /// Non-owning cache of the channels in channels_, indexed by ChannelSlot. A non-null slot always
+  /// points to the channel stored under the slot's name. Guarded by m_channels_.
+  mutable std::array<ChannelBase*, kNumChannelSlots> slots_;
 };
 
+namespace internal {
+template<int SLOT>
+inline ChannelBase* getChannelSlot(const ChannelGroup& channel_group) {
+  static_assert(SLOT >= 0 && SLOT < kNumChannelSlots, "Invalid channel slot.");
+  return channel_group.slots_[SLOT];
+}
+template<>
+inline ChannelBase* getChannelSlot<kNoChannelSlot>(const ChannelGroup& /*channel_group*/) {
+  return nullptr;
+}
+template<int SLOT>
+inline void setChannelSlot(ChannelBase* channel, const ChannelGroup& channel_group) {
+  static_assert(SLOT >= 0 && SLOT < kNumChannelSlots, "Invalid channel slot.");
+  channel_group.slots_[SLOT] = channel;
+}
+template<>
+inline void setChannelSlot<kNoChannelSlot>(ChannelBase* /*channel*/,
+                                           const ChannelGroup& /*channel_group*/) {}
+
+/// Make sure the channel is not shared with another group before it is modified. A shared
+/// channel is replaced by a clone, or by a default constructed channel if the value is not needed.
+/// Returns null if the channel is not of type DerivedChannel.
+template<typename DerivedChannel>
+DerivedChannel* getUniqueChannel(std::shared_ptr<ChannelBase>* channel, bool copy_if_shared) {
+  CHECK_NOTNULL(channel);
+  CHECK(*channel);
+  if (channel->use_count() > 1) {
+    if (copy_if_shared) {
+      channel->reset((*channel)->clone());
+    } else {
+      channel->reset(new DerivedChannel);
+    }
+  }
+  return dynamic_cast<DerivedChannel*>(channel->get());
+}
+}  // namespace internal
+
 ChannelGroup cloneChannelGroup(const ChannelGroup& channels);
+/// Copy a group by sharing its channels. The channels are copied on write, i.e. when they are
+/// accessed through the get*Mutable functions of either group.
+ChannelGroup shareChannelGroup(const ChannelGroup& channels);
 bool isChannelGroupEqual(const ChannelGroup& left, const ChannelGroup& right);
+/// Memory of all channels of the group. Adds the channels as "<tag>/<channel name>" to the
+/// report if it is not null.
+size_t getChannelGroupMemoryUsageBytes(const ChannelGroup& channels, const std::string& tag,
+                                       common::MemoryUsageReport* report);
 
 }  // namespace channels
 }  // namespace aslam
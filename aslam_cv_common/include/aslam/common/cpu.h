@@ -0,0 +1,138 @@
+#ifndef ASLAM_COMMON_CPU_H_
+#define ASLAM_COMMON_CPU_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DECLARE_string(aslam_force_isa);
+
+namespace aslam {
+namespace common {
+namespace cpu {
+
+/// Instruction set levels that kernels can be specialized for. The levels of one architecture
+/// are ordered, i.e. a CPU supporting a level is expected to support all lower levels.
+enum class Isa {
+  kGeneric,
+  kSSSE3,
+  kPopcnt,
+  kAVX2,
+  kAVX512,
+  kNEON
+};
+
+/// The instruction set extensions of the CPU, detected once on first use. Checks the CPUID
+/// feature bits as well as the OS support for the extended registers.
+struct Features {
+  bool ssse3 = false;
+  bool popcnt = false;
+  bool avx2 = false;
+  bool avx512f = false;
+  bool avx512bw = false;
+  bool avx512vpopcntdq = false;
+  bool neon = false;
+};
+const Features& getFeatures();
+
+/// Does the CPU support the level, independent of FLAGS_aslam_force_isa.
+bool isIsaDetected(const Isa isa);
+
+/// Does the CPU support the level and is it not above the level forced with
+/// --aslam_force_isa, e.g. --aslam_force_isa=ssse3 disables all AVX and popcnt kernels.
+bool isIsaSupported(const Isa isa);
+
+/// The forced level, --aslam_force_isa is parsed and validated once on first use.
+/// @return False if no level is forced.
+bool getForcedIsa(Isa* isa);
+/// Replace the level of --aslam_force_isa, e.g. in tests. Kernels that were resolved before
+/// keep their variant.
+void setForcedIsa(const Isa isa);
+void clearForcedIsa();
+
+/// The highest supported level of this architecture.
+Isa getBestSupportedIsa();
+
+const char* getIsaName(const Isa isa);
+/// Parses the lower case names accepted by --aslam_force_isa: generic, ssse3, popcnt, avx2,
+/// avx512 and neon.
+bool parseIsa(const std::string& name, Isa* isa);
+
+/// \class KernelRegistry
+/// \brief The variants of a kernel for the different instruction set levels. Subsystems
+///        register their variants once and resolve the best one once, e.g.
+///   static const KernelRegistry<DistanceFunction> registry = makeDistanceRegistry();
+///   static const DistanceFunction kDistance = registry.getBest();
+template <typename Function>
+class KernelRegistry {
+ public:
+  explicit KernelRegistry(const char* kernel_name) : kernel_name_(kernel_name) {}
+
+  /// Adds the variant using the instruction set level. Variants of levels that were not
+  /// compiled in should not be added.
+  void add(const Isa isa, Function function) {
+    CHECK(function != nullptr);
+    CHECK(!hasVariant(isa)) << "The kernel " << kernel_name_ << " already has a "
+                            << getIsaName(isa) << " variant.";
+    variants_.emplace_back(isa, function);
+  }
+
+  bool hasVariant(const Isa isa) const {
+    for (const std::pair<Isa, Function>& variant : variants_) {
+      if (variant.first == isa) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// The variant of the highest supported level, or null if no variant is supported.
+  Function getBest() const {
+    Isa isa;
+    return getBestIsa(&isa) ? get(isa) : nullptr;
+  }
+
+  /// The highest supported level that has a variant.
+  bool getBestIsa(Isa* isa) const {
+    CHECK_NOTNULL(isa);
+    bool found = false;
+    for (const std::pair<Isa, Function>& variant : variants_) {
+      if (isIsaSupported(variant.first) && (!found || variant.first > *isa)) {
+        *isa = variant.first;
+        found = true;
+      }
+    }
+    return found;
+  }
+
+  /// The variant of the level, which must be supported on this machine.
+  Function get(const Isa isa) const {
+    CHECK(isIsaSupported(isa)) << "The " << getIsaName(isa) << " variant of the kernel "
+                               << kernel_name_ << " is not supported on this machine.";
+    for (const std::pair<Isa, Function>& variant : variants_) {
+      if (variant.first == isa) {
+        return variant.second;
+      }
+    }
+    LOG(FATAL) << "The kernel " << kernel_name_ << " has no " << getIsaName(isa)
+               << " variant.";
+    return nullptr;
+  }
+
+  const char* getKernelName() const {
+    return kernel_name_;
+  }
+
+ private:
+  const char* kernel_name_;
+  std::vector<std::pair<Isa, Function>> variants_;
+};
+
+}  // namespace cpu
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_CPU_H_
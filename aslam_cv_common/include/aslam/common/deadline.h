@@ -0,0 +1,135 @@
+#ifndef ASLAM_COMMON_DEADLINE_H_
+#define ASLAM_COMMON_DEADLINE_H_
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include <aslam/common/macros.h>
+
+namespace aslam {
+namespace common {
+
+/// The shortcuts a processing stage took to finish before its deadline.
+enum class Degradation : uint32_t {
+  /// The pipeline described fewer keypoints than it detected.
+  kCappedKeypoints = 1u << 0,
+  /// The keypoints were not refined to subpixel accuracy.
+  kSkippedSubpixelRefinement = 1u << 1,
+  /// The matcher only searched the small windows around the predicted keypoints.
+  kShrunkSearchWindows = 1u << 2,
+  /// The matcher skipped (some of) the rounds re-matching the inferior matches.
+  kSkippedInferiorMatching = 1u << 3,
+  /// The tracker skipped the Lucas-Kanade tracking of the unmatched keypoints.
+  kSkippedLkTracking = 1u << 4,
+  /// RANSAC stopped before its stopping criterion was met.
+  kCutRansacIterations = 1u << 5
+};
+
+/// \class Degradations
+/// \brief A set of degradations, e.g. the ones applied to a frame.
+class Degradations {
+ public:
+  Degradations() : flags_(0u) {}
+  explicit Degradations(uint32_t flags) : flags_(flags) {}
+
+  void add(Degradation degradation) { flags_ |= static_cast<uint32_t>(degradation); }
+  void add(const Degradations& other) { flags_ |= other.flags_; }
+  bool has(Degradation degradation) const {
+    return (flags_ & static_cast<uint32_t>(degradation)) != 0u;
+  }
+  bool empty() const { return flags_ == 0u; }
+  void clear() { flags_ = 0u; }
+  uint32_t getFlags() const { return flags_; }
+
+  bool operator==(const Degradations& other) const { return flags_ == other.flags_; }
+  bool operator!=(const Degradations& other) const { return flags_ != other.flags_; }
+
+  /// Comma separated names of the degradations, e.g. "capped_keypoints,skipped_lk_tracking",
+  /// or "none".
+  std::string toString() const;
+
+ private:
+  uint32_t flags_;
+};
+
+/// \class Deadline
+/// \brief A point in time on the steady clock by which a frame should be processed, together
+///        with the budget it was created from. The default deadline is unbounded.
+class Deadline {
+ public:
+  Deadline()
+      : deadline_time_nanoseconds_(kUnboundedNanoseconds),
+        budget_nanoseconds_(kUnboundedNanoseconds) {}
+
+  /// A deadline budget_nanoseconds after now().
+  static Deadline fromNow(int64_t budget_nanoseconds) {
+    return fromStartTime(now(), budget_nanoseconds);
+  }
+  /// A deadline budget_nanoseconds after the start time, e.g. the arrival time of an image.
+  static Deadline fromStartTime(int64_t start_time_nanoseconds, int64_t budget_nanoseconds);
+
+  /// The steady clock time in nanoseconds the deadlines are measured with.
+  static int64_t now();
+
+  bool isBounded() const { return deadline_time_nanoseconds_ != kUnboundedNanoseconds; }
+  bool hasExpired() const { return isBounded() && now() >= deadline_time_nanoseconds_; }
+
+  /// The time left until the deadline, 0 once it expired and the maximum if it is unbounded.
+  int64_t getRemainingNanoseconds() const;
+  /// The time left as a fraction of the budget in [0, 1], 1 if the deadline is unbounded.
+  double getRemainingRatio() const;
+
+  int64_t getDeadlineTimeNanoseconds() const { return deadline_time_nanoseconds_; }
+  int64_t getBudgetNanoseconds() const { return budget_nanoseconds_; }
+
+ private:
+  static constexpr int64_t kUnboundedNanoseconds = std::numeric_limits<int64_t>::max();
+
+  int64_t deadline_time_nanoseconds_;
+  int64_t budget_nanoseconds_;
+};
+
+/// \class DeadlineScope
+/// \brief Sets the deadline of the processing of the calling thread and collects the
+///        degradations the stages applied within the scope.
+///
+/// The stages whose interfaces don't take a deadline, e.g. VisualPipeline::processFrameImpl()
+/// or FeatureTracker::track(), check the remaining budget with getCurrentDeadline() and record
+/// the shortcuts they took with addDegradation(). Scopes can be nested, a nested scope passes
+/// its degradations on to the enclosing scope when it ends. Work handed to other threads has to
+/// open a scope with the deadline there. Example:
+///   aslam::common::DeadlineScope deadline_scope(
+///       aslam::common::Deadline::fromNow(aslam::time::milliseconds(20)));
+///   tracker.track(q_Ckp1_Ck, *frame_k, frame_kp1.get(), &matches_kp1_k);
+///   LOG_IF(INFO, !deadline_scope.getDegradations().empty())
+///       << "Degraded: " << deadline_scope.getDegradations().toString();
+class DeadlineScope {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(DeadlineScope);
+
+  /// A scope with the deadline of the enclosing scope, to collect the degradations of a part of
+  /// the processing.
+  DeadlineScope();
+  explicit DeadlineScope(const Deadline& deadline);
+  ~DeadlineScope();
+
+  const Deadline& getDeadline() const { return deadline_; }
+  /// The degradations recorded within this scope and its nested scopes so far.
+  const Degradations& getDegradations() const { return degradations_; }
+
+  /// The deadline of the innermost scope of the calling thread, unbounded outside of a scope.
+  static const Deadline& getCurrentDeadline();
+  /// Record a degradation in the innermost scope of the calling thread, if any.
+  static void addDegradation(Degradation degradation);
+
+ private:
+  const Deadline deadline_;
+  Degradations degradations_;
+  DeadlineScope* const enclosing_scope_;
+};
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_DEADLINE_H_
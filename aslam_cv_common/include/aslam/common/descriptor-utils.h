@@ -1,6 +1,11 @@
 #ifndef VI_MAP_DESCRIPTOR_UTILS_H_
 #define VI_MAP_DESCRIPTOR_UTILS_H_
 
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <vector>
 
 #include <Eigen/Core>
@@ -8,6 +13,7 @@
 
 #include "aslam/common/feature-descriptor-ref.h"
 #include "aslam/common/hamming.h"
+#include "aslam/common/parallel-for.h"
 
 namespace aslam {
 namespace common {
@@ -38,22 +44,61 @@ inline void setBit(unsigned int bit, DescriptorType* descriptor) {
   (*descriptor)(byte) |= (1 << bit_in_byte);
 }
 
+namespace internal {
+// Entry b holds bit k of the byte b in its byte k, such that adding up the
+// entries of many bytes counts all of their 8 bits at once.
+struct SpreadBitsTable {
+  SpreadBitsTable() {
+    for (size_t byte = 0u; byte < 256u; ++byte) {
+      values[byte] = 0u;
+      for (size_t bit = 0u; bit < kBitsPerByte; ++bit) {
+        values[byte] |= static_cast<uint64_t>((byte >> bit) & 1u) << (kBitsPerByte * bit);
+      }
+    }
+  }
+  uint64_t values[256];
+};
+
+// Adds the number of descriptors that have a bit set to sums, indexed like
+// getBit().
+inline void accumulateBitSums(
+    const DescriptorsType& descriptors, std::vector<int>* sums) {
+  const int num_bytes = descriptors.rows();
+  CHECK_EQ(CHECK_NOTNULL(sums)->size(), num_bytes * kBitsPerByte);
+  static const SpreadBitsTable kSpreadBits;
+  // A byte of the partial sums overflows after 255 descriptors.
+  constexpr int kMaxNumDescriptorsPerPartialSum = 255;
+  std::vector<uint64_t> partial_sums(num_bytes);
+  for (int begin = 0; begin < descriptors.cols();
+       begin += kMaxNumDescriptorsPerPartialSum) {
+    const int end = std::min<int>(
+        descriptors.cols(), begin + kMaxNumDescriptorsPerPartialSum);
+    std::fill(partial_sums.begin(), partial_sums.end(), 0u);
+    for (int i = begin; i < end; ++i) {
+      const unsigned char* descriptor = descriptors.data() + i * num_bytes;
+      for (int byte = 0; byte < num_bytes; ++byte) {
+        partial_sums[byte] += kSpreadBits.values[descriptor[byte]];
+      }
+    }
+    for (int byte = 0; byte < num_bytes; ++byte) {
+      for (size_t bit = 0u; bit < kBitsPerByte; ++bit) {
+        (*sums)[byte * kBitsPerByte + bit] += static_cast<int>(
+            (partial_sums[byte] >> (kBitsPerByte * bit)) & 0xffu);
+      }
+    }
+  }
+}
+
+}  // namespace internal
+
 inline void descriptorMeanRoundedToBinaryValue(
     const DescriptorsType& descriptors, DescriptorType* median) {
   CHECK_GT(descriptors.rows(), 0);
   CHECK_NOTNULL(median)->resize(descriptors.rows(), Eigen::NoChange);
   median->setZero();
 
-  std::vector<int> sums;
-  sums.resize(descriptors.rows() * kBitsPerByte, 0);
-  const size_t num_descriptor_bits = descriptors.rows() * kBitsPerByte;
-  for (int i = 0; i < descriptors.cols(); ++i) {
-    for (size_t bit = 0u; bit < num_descriptor_bits; ++bit) {
-      if (getBit(bit, descriptors.col(i))) {
-        ++sums[bit];
-      }
-    }
-  }
+  std::vector<int> sums(descriptors.rows() * kBitsPerByte, 0);
+  internal::accumulateBitSums(descriptors, &sums);
   const int half = descriptors.cols() / 2;
   for (size_t bit = 0u; bit < sums.size(); ++bit) {
     if (sums[bit] > half) {
@@ -62,6 +107,23 @@ inline void descriptorMeanRoundedToBinaryValue(
   }
 }
 
+// Computes descriptorMeanRoundedToBinaryValue for many sets of descriptors,
+// e.g. the tracks of many landmarks. num_threads = 1 runs on the calling thread,
+// any other value on the shared pool of common::parallelFor.
+inline void descriptorMeansRoundedToBinaryValue(
+    const std::vector<DescriptorsType>& descriptor_sets, size_t num_threads,
+    std::vector<DescriptorType>* medians) {
+  const size_t num_sets = descriptor_sets.size();
+  CHECK_NOTNULL(medians)->resize(num_sets);
+  parallelFor(IndexRange(0u, num_sets), num_threads == 1u ? std::max<size_t>(1u, num_sets) : 1u,
+              [&](size_t begin, size_t end) {
+    for (size_t set_index = begin; set_index < end; ++set_index) {
+      descriptorMeanRoundedToBinaryValue(
+          descriptor_sets[set_index], &(*medians)[set_index]);
+    }
+  });
+}
+
 // Returns the col-index into raw_descriptors of the descriptor with
 // smallest accumulated descriptor distance wrt. all other descriptors in
 // raw_descriptors.
@@ -70,48 +132,220 @@ inline void getIndexOfDescriptorClosestToMedian(
   const int descriptor_size_bytes = raw_descriptors.rows();
   CHECK_GT(descriptor_size_bytes, 0);
   CHECK_NOTNULL(median_descriptor_index);
-
-  std::vector<aslam::common::FeatureDescriptorConstRef> wrapped_descriptors;
   const int num_descriptors = raw_descriptors.cols();
-  wrapped_descriptors.reserve(num_descriptors);
-
-  for (int descriptor_idx = 0; descriptor_idx < num_descriptors;
-       ++descriptor_idx) {
-    wrapped_descriptors.emplace_back(
-        &raw_descriptors.coeffRef(0, descriptor_idx),
-        descriptor_size_bytes);
-  }
-
-  Eigen::MatrixXi hamming_distance_matrix =
-      Eigen::MatrixXi::Zero(num_descriptors, num_descriptors);
+  CHECK_GT(num_descriptors, 0);
 
+  // Only the accumulated distances are needed, not the distance matrix.
+  std::vector<int> accumulated_distances(num_descriptors, 0);
+  Hamming hamming;
   for (int descriptor_idx_row = 0; descriptor_idx_row < num_descriptors;
        ++descriptor_idx_row) {
-    const aslam::common::FeatureDescriptorConstRef& row_descriptor =
-        wrapped_descriptors[descriptor_idx_row];
+    const unsigned char* row_descriptor =
+        raw_descriptors.data() + descriptor_idx_row * descriptor_size_bytes;
     for (int descriptor_idx_col = descriptor_idx_row + 1;
         descriptor_idx_col < num_descriptors; ++descriptor_idx_col) {
-      const aslam::common::FeatureDescriptorConstRef& col_descriptor =
-          wrapped_descriptors[descriptor_idx_col];
-
-      const int hamming_distance =
-          aslam::common::GetNumBitsDifferent(row_descriptor, col_descriptor);
+      const int hamming_distance = static_cast<int>(hamming(
+          row_descriptor,
+          raw_descriptors.data() + descriptor_idx_col * descriptor_size_bytes,
+          descriptor_size_bytes));
       CHECK_GE(hamming_distance, 0);
-
-      hamming_distance_matrix(descriptor_idx_row, descriptor_idx_col) =
-          hamming_distance;
-      hamming_distance_matrix(descriptor_idx_col, descriptor_idx_row) =
-          hamming_distance;
+      accumulated_distances[descriptor_idx_row] += hamming_distance;
+      accumulated_distances[descriptor_idx_col] += hamming_distance;
     }
   }
 
-  Eigen::MatrixXi::Index eigen_median_descriptor_index;
-  hamming_distance_matrix.colwise().sum().minCoeff(&eigen_median_descriptor_index);
-  CHECK_GE(static_cast<int>(eigen_median_descriptor_index), 0);
-  *median_descriptor_index = static_cast<size_t>(eigen_median_descriptor_index);
+  // The first of equally close descriptors.
+  *median_descriptor_index = static_cast<size_t>(
+      std::min_element(accumulated_distances.begin(), accumulated_distances.end()) -
+      accumulated_distances.begin());
   CHECK_LT(*median_descriptor_index, static_cast<size_t>(num_descriptors));
 }
 
+// Approximates getIndexOfDescriptorClosestToMedian by accumulating the
+// distances to num_reference_descriptors evenly spaced descriptors only, which
+// takes O(N * num_reference_descriptors) instead of O(N^2) distances. The
+// result is exact if there are at most num_reference_descriptors descriptors.
+inline void getIndexOfDescriptorClosestToMedianSampled(
+    const DescriptorsType& raw_descriptors, size_t num_reference_descriptors,
+    size_t* median_descriptor_index) {
+  CHECK_GT(num_reference_descriptors, 0u);
+  const size_t num_descriptors = static_cast<size_t>(raw_descriptors.cols());
+  if (num_descriptors <= num_reference_descriptors) {
+    getIndexOfDescriptorClosestToMedian(
+        raw_descriptors, median_descriptor_index);
+    return;
+  }
+  const int descriptor_size_bytes = raw_descriptors.rows();
+  CHECK_GT(descriptor_size_bytes, 0);
+  CHECK_NOTNULL(median_descriptor_index);
+
+  std::vector<int> reference_indices(num_reference_descriptors);
+  for (size_t i = 0u; i < num_reference_descriptors; ++i) {
+    reference_indices[i] =
+        static_cast<int>(i * num_descriptors / num_reference_descriptors);
+  }
+  std::vector<Hamming::ResultType> distances(num_reference_descriptors);
+  Hamming::ResultType min_accumulated_distance = 0;
+  for (size_t descriptor_idx = 0u; descriptor_idx < num_descriptors;
+       ++descriptor_idx) {
+    Hamming::evaluateBatch(
+        raw_descriptors.data() + descriptor_idx * descriptor_size_bytes,
+        raw_descriptors.data(), descriptor_size_bytes,
+        reference_indices.data(), num_reference_descriptors,
+        descriptor_size_bytes, distances.data());
+    Hamming::ResultType accumulated_distance = 0;
+    for (const Hamming::ResultType distance : distances) {
+      accumulated_distance += distance;
+    }
+    if (descriptor_idx == 0u ||
+        accumulated_distance < min_accumulated_distance) {
+      min_accumulated_distance = accumulated_distance;
+      *median_descriptor_index = descriptor_idx;
+    }
+  }
+}
+
+// Computes getIndexOfDescriptorClosestToMedian for many sets of descriptors,
+// e.g. the tracks of many landmarks. num_threads = 1 runs on the calling thread,
+// any other value on the shared pool of common::parallelFor. Sets with more
+// than max_num_reference_descriptors descriptors use the sampled
+// approximation, 0 computes all exactly.
+inline void getIndicesOfDescriptorsClosestToMedian(
+    const std::vector<DescriptorsType>& descriptor_sets,
+    size_t max_num_reference_descriptors, size_t num_threads,
+    std::vector<size_t>* median_descriptor_indices) {
+  const size_t num_sets = descriptor_sets.size();
+  CHECK_NOTNULL(median_descriptor_indices)->resize(num_sets);
+  parallelFor(IndexRange(0u, num_sets), num_threads == 1u ? std::max<size_t>(1u, num_sets) : 1u,
+              [&](size_t begin, size_t end) {
+    for (size_t set_index = begin; set_index < end; ++set_index) {
+      size_t* median_descriptor_index =
+          &(*median_descriptor_indices)[set_index];
+      if (max_num_reference_descriptors == 0u) {
+        getIndexOfDescriptorClosestToMedian(
+            descriptor_sets[set_index], median_descriptor_index);
+      } else {
+        getIndexOfDescriptorClosestToMedianSampled(
+            descriptor_sets[set_index], max_num_reference_descriptors,
+            median_descriptor_index);
+      }
+    }
+  });
+}
+
+// Keeps the representatives of a growing or shrinking set of descriptors, e.g.
+// the observations of a landmark, up to date without recomputing them over the
+// whole set. The per-bit counts give the descriptor of
+// descriptorMeanRoundedToBinaryValue in O(bits). The accumulated distance of
+// every descriptor to all others is updated in O(N) distances per added or
+// removed descriptor, such that the descriptor of
+// getIndexOfDescriptorClosestToMedian is found in O(N) instead of O(N^2)
+// distances. Both are exact. The descriptor size must be a multiple of 16
+// bytes, see Hamming::evaluate().
+class IncrementalRepresentativeDescriptor {
+ public:
+  explicit IncrementalRepresentativeDescriptor(size_t descriptor_size_bytes)
+      : descriptor_size_bytes_(descriptor_size_bytes),
+        bit_counts_(descriptor_size_bytes * kBitsPerByte, 0) {
+    CHECK_GT(descriptor_size_bytes_, 0u);
+  }
+
+  // Appends a descriptor of descriptor_size_bytes.
+  void addDescriptor(const unsigned char* descriptor) {
+    CHECK_NOTNULL(descriptor);
+    const int size = static_cast<int>(descriptor_size_bytes_);
+    Hamming::ResultType accumulated_distance = 0;
+    for (size_t i = 0u; i < getNumDescriptors(); ++i) {
+      const Hamming::ResultType distance =
+          Hamming::evaluate(descriptor, getDescriptor(i), size);
+      accumulated_distances_[i] += distance;
+      accumulated_distance += distance;
+    }
+    accumulated_distances_.push_back(accumulated_distance);
+    descriptors_.insert(
+        descriptors_.end(), descriptor, descriptor + descriptor_size_bytes_);
+    updateBitCounts(descriptor, 1);
+  }
+
+  void addDescriptor(const DescriptorType& descriptor) {
+    CHECK_EQ(static_cast<size_t>(descriptor.size()), descriptor_size_bytes_);
+    addDescriptor(descriptor.data());
+  }
+
+  // Removes the descriptor of the index, the following descriptors move up by
+  // one index.
+  void removeDescriptor(size_t index) {
+    CHECK_LT(index, getNumDescriptors());
+    const unsigned char* removed_descriptor = getDescriptor(index);
+    const int size = static_cast<int>(descriptor_size_bytes_);
+    for (size_t i = 0u; i < getNumDescriptors(); ++i) {
+      if (i != index) {
+        accumulated_distances_[i] -=
+            Hamming::evaluate(removed_descriptor, getDescriptor(i), size);
+      }
+    }
+    updateBitCounts(removed_descriptor, -1);
+    accumulated_distances_.erase(accumulated_distances_.begin() + index);
+    const std::vector<unsigned char>::iterator removed_begin =
+        descriptors_.begin() + index * descriptor_size_bytes_;
+    descriptors_.erase(removed_begin, removed_begin + descriptor_size_bytes_);
+  }
+
+  void clear() {
+    descriptors_.clear();
+    accumulated_distances_.clear();
+    std::fill(bit_counts_.begin(), bit_counts_.end(), 0);
+  }
+
+  size_t getNumDescriptors() const { return accumulated_distances_.size(); }
+  size_t getDescriptorSizeBytes() const { return descriptor_size_bytes_; }
+
+  const unsigned char* getDescriptor(size_t index) const {
+    CHECK_LT(index, getNumDescriptors());
+    return descriptors_.data() + index * descriptor_size_bytes_;
+  }
+
+  // Same as descriptorMeanRoundedToBinaryValue of all descriptors.
+  void getMeanRoundedToBinaryValue(DescriptorType* median) const {
+    CHECK_NOTNULL(median)->resize(descriptor_size_bytes_, Eigen::NoChange);
+    median->setZero();
+    const int half = static_cast<int>(getNumDescriptors()) / 2;
+    for (size_t bit = 0u; bit < bit_counts_.size(); ++bit) {
+      if (bit_counts_[bit] > half) {
+        setBit(bit, median);
+      }
+    }
+  }
+
+  // Same as getIndexOfDescriptorClosestToMedian of all descriptors.
+  size_t getIndexOfDescriptorClosestToMedian() const {
+    CHECK_GT(getNumDescriptors(), 0u);
+    return static_cast<size_t>(
+        std::min_element(accumulated_distances_.begin(),
+                         accumulated_distances_.end()) -
+        accumulated_distances_.begin());
+  }
+
+ private:
+  void updateBitCounts(const unsigned char* descriptor, int increment) {
+    for (size_t byte = 0u; byte < descriptor_size_bytes_; ++byte) {
+      for (size_t bit = 0u; bit < kBitsPerByte; ++bit) {
+        if (descriptor[byte] & (1u << bit)) {
+          bit_counts_[byte * kBitsPerByte + bit] += increment;
+        }
+      }
+    }
+  }
+
+  const size_t descriptor_size_bytes_;
+  // The descriptors in order, descriptor_size_bytes_ each.
+  std::vector<unsigned char> descriptors_;
+  // The number of descriptors that have a bit set, indexed like getBit().
+  std::vector<int> bit_counts_;
+  // The sum of the distances of every descriptor to all others.
+  std::vector<Hamming::ResultType> accumulated_distances_;
+};
+
 inline double descriptorMeanAbsoluteDeviation(
     const DescriptorsType& descriptors) {
   if (descriptors.cols() < 2) {
@@ -140,15 +374,8 @@ void floatDescriptorMean(const DescriptorsType& descriptors,
       ->resize(descriptors.rows() * kBitsPerByte, Eigen::NoChange);
   mean->setZero();
 
-  std::vector<int> sums;
-  sums.resize(descriptors.rows() * kBitsPerByte, 0);
-  for (int i = 0; i < descriptors.cols(); ++i) {
-    for (size_t bit = 0u; bit < descriptors.rows() * kBitsPerByte; ++bit) {
-      if (getBit(bit, descriptors.col(i))) {
-        ++sums[bit];
-      }
-    }
-  }
+  std::vector<int> sums(descriptors.rows() * kBitsPerByte, 0);
+  internal::accumulateBitSums(descriptors, &sums);
 
   for (size_t bit = 0u; bit < sums.size(); ++bit) {
     (*mean)(bit) = static_cast<MeanType>(sums[bit]) / descriptors.cols();
@@ -193,6 +420,169 @@ inline double descriptorMeanStandardDeviation(
   return sqrt(deviation_squared);
 }
 
+// The size of compressed descriptors must be a multiple of this.
+constexpr size_t kCompressedDescriptorSizeStepBytes = 16u;
+
+// Selects the bits of compressed descriptors, see learnBitSelection().
+struct DescriptorBitSelection {
+  DescriptorBitSelection() : full_size_bytes(0u) {}
+  size_t getCompressedSizeBytes() const { return bits.size() / kBitsPerByte; }
+  bool isValid() const {
+    return full_size_bytes > 0u && !bits.empty() && bits.size() % kBitsPerByte == 0u;
+  }
+
+  // Size of the uncompressed descriptors.
+  size_t full_size_bytes;
+  // Bit j of a compressed descriptor is bit bits[j] of the full descriptor, indexed like
+  // getBit(). In increasing order.
+  std::vector<int> bits;
+};
+
+// Learns which bits of the descriptors to keep for compressed descriptors of
+// compressed_size_bytes, e.g. 16 or 32 bytes of 48 byte BRISK descriptors for the map. The
+// bits are ranked by their variance over the training descriptors, bits that are set in half of
+// them carry the most information. Going down the ranking, a bit is only kept if the absolute
+// correlation with all kept bits is below max_correlation, as correlated bits add little
+// distance information. If too few bits pass, the best ranked rejected bits are added. A
+// max_correlation of 1 selects the bits by variance only.
+inline void learnBitSelection(const DescriptorsType& training_descriptors,
+                              size_t compressed_size_bytes, double max_correlation,
+                              DescriptorBitSelection* selection) {
+  CHECK_NOTNULL(selection);
+  const size_t full_size_bytes = static_cast<size_t>(training_descriptors.rows());
+  const size_t num_descriptors = static_cast<size_t>(training_descriptors.cols());
+  CHECK_GT(full_size_bytes, 0u);
+  CHECK_GT(num_descriptors, 0u);
+  CHECK_GT(compressed_size_bytes, 0u);
+  CHECK_LE(compressed_size_bytes, full_size_bytes);
+  CHECK_EQ(compressed_size_bytes % kCompressedDescriptorSizeStepBytes, 0u)
+      << "The Hamming kernels work on blocks of " << kCompressedDescriptorSizeStepBytes
+      << " bytes.";
+  CHECK_GT(max_correlation, 0.0);
+  const size_t num_bits = full_size_bytes * kBitsPerByte;
+  const size_t num_selected_bits = compressed_size_bytes * kBitsPerByte;
+
+  // The value of every bit over all descriptors, packed into 64 bit words.
+  const size_t num_words = (num_descriptors + 63u) / 64u;
+  std::vector<uint64_t> bit_columns(num_bits * num_words, 0u);
+  for (size_t i = 0u; i < num_descriptors; ++i) {
+    const unsigned char* descriptor = training_descriptors.data() + i * full_size_bytes;
+    const uint64_t descriptor_mask = static_cast<uint64_t>(1u) << (i % 64u);
+    for (size_t bit = 0u; bit < num_bits; ++bit) {
+      if (descriptor[bit / kBitsPerByte] & (1u << (bit % kBitsPerByte))) {
+        bit_columns[bit * num_words + i / 64u] |= descriptor_mask;
+      }
+    }
+  }
+  std::vector<int> sums(num_bits, 0);
+  internal::accumulateBitSums(training_descriptors, &sums);
+  std::vector<double> probabilities(num_bits);
+  std::vector<int> ranking(num_bits);
+  for (size_t bit = 0u; bit < num_bits; ++bit) {
+    probabilities[bit] = static_cast<double>(sums[bit]) / num_descriptors;
+    ranking[bit] = static_cast<int>(bit);
+  }
+  // Decreasing variance p * (1 - p), the lower bit first among equal ones.
+  std::stable_sort(ranking.begin(), ranking.end(), [&](int lhs, int rhs) {
+    return probabilities[lhs] * (1.0 - probabilities[lhs]) >
+        probabilities[rhs] * (1.0 - probabilities[rhs]);
+  });
+
+  const auto correlation = [&](int lhs, int rhs) -> double {
+    const double variance_product = probabilities[lhs] * (1.0 - probabilities[lhs]) *
+        probabilities[rhs] * (1.0 - probabilities[rhs]);
+    if (variance_product <= 0.0) {
+      // Constant bits carry no information at all.
+      return 1.0;
+    }
+    size_t num_both_set = 0u;
+    for (size_t word = 0u; word < num_words; ++word) {
+      num_both_set += std::bitset<64>(
+          bit_columns[lhs * num_words + word] & bit_columns[rhs * num_words + word]).count();
+    }
+    const double covariance = static_cast<double>(num_both_set) / num_descriptors -
+        probabilities[lhs] * probabilities[rhs];
+    return covariance / std::sqrt(variance_product);
+  };
+
+  std::vector<int> selected_bits;
+  selected_bits.reserve(num_selected_bits);
+  std::vector<int> rejected_bits;
+  for (const int bit : ranking) {
+    if (selected_bits.size() == num_selected_bits) {
+      break;
+    }
+    bool is_decorrelated = true;
+    if (max_correlation < 1.0) {
+      for (const int selected_bit : selected_bits) {
+        if (std::abs(correlation(bit, selected_bit)) >= max_correlation) {
+          is_decorrelated = false;
+          break;
+        }
+      }
+    }
+    if (is_decorrelated) {
+      selected_bits.push_back(bit);
+    } else {
+      rejected_bits.push_back(bit);
+    }
+  }
+  for (size_t i = 0u; selected_bits.size() < num_selected_bits; ++i) {
+    CHECK_LT(i, rejected_bits.size());
+    selected_bits.push_back(rejected_bits[i]);
+  }
+  std::sort(selected_bits.begin(), selected_bits.end());
+
+  selection->full_size_bytes = full_size_bytes;
+  selection->bits.swap(selected_bits);
+}
+
+// Writes the selected bits of one full descriptor into compressed, which holds
+// selection.getCompressedSizeBytes() bytes.
+inline void compressDescriptor(const unsigned char* descriptor,
+                               const DescriptorBitSelection& selection,
+                               unsigned char* compressed) {
+  CHECK_NOTNULL(descriptor);
+  CHECK_NOTNULL(compressed);
+  const size_t compressed_size_bytes = selection.getCompressedSizeBytes();
+  for (size_t byte = 0u; byte < compressed_size_bytes; ++byte) {
+    unsigned char value = 0u;
+    const int* bits = selection.bits.data() + byte * kBitsPerByte;
+    for (size_t bit_in_byte = 0u; bit_in_byte < kBitsPerByte; ++bit_in_byte) {
+      const int bit = bits[bit_in_byte];
+      value |= static_cast<unsigned char>(
+          ((descriptor[bit / kBitsPerByte] >> (bit % kBitsPerByte)) & 1u) << bit_in_byte);
+    }
+    compressed[byte] = value;
+  }
+}
+
+// Compresses all descriptors, e.g. VisualFrame::DescriptorsT or the descriptors of the
+// landmarks of a map. num_threads = 1 runs on the calling thread, any other value on the
+// shared pool of common::parallelFor. The Hamming distance of two
+// compressed descriptors is the number of differing selected bits. Compressed descriptors of
+// 16 and 32 bytes have a fixed size Hamming kernel, see Hamming::getFixedSizeBatchFunction().
+inline void compressDescriptors(const DescriptorsType& descriptors,
+                                const DescriptorBitSelection& selection, size_t num_threads,
+                                DescriptorsType* compressed_descriptors) {
+  CHECK_NOTNULL(compressed_descriptors);
+  CHECK(selection.isValid());
+  CHECK_EQ(static_cast<size_t>(descriptors.rows()), selection.full_size_bytes);
+  const size_t compressed_size_bytes = selection.getCompressedSizeBytes();
+  compressed_descriptors->resize(compressed_size_bytes, descriptors.cols());
+  // Blocks of descriptors per task, such that the threads don't share cache lines.
+  constexpr size_t kNumDescriptorsPerBlock = 256u;
+  const size_t num_descriptors = static_cast<size_t>(descriptors.cols());
+  parallelFor(IndexRange(0u, num_descriptors),
+              num_threads == 1u ? std::max<size_t>(1u, num_descriptors) : kNumDescriptorsPerBlock,
+              [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      compressDescriptor(descriptors.data() + i * selection.full_size_bytes, selection,
+                         compressed_descriptors->data() + i * compressed_size_bytes);
+    }
+  });
+}
+
 // Returned in order: p1p0, p2p0, p3p0, ... pnp0, p2p1, p3p1, ..., just like in
 // matlab pdist.
 inline void pairwiseEuclidianDistances(const DescriptorsType& descriptors,
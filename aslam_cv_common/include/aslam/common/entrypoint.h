@@ -17,6 +17,18 @@
   return RUN_ALL_TESTS();\
 }
 
+// Skips the rest of a test, e.g. if the hardware of a backend is missing. Older gtest releases
+// have no GTEST_SKIP, the test is reported as passed there.
+#ifdef GTEST_SKIP
+#define ASLAM_SKIP_TEST(message) GTEST_SKIP() << message
+#else
+#define ASLAM_SKIP_TEST(message)\
+  do {\
+    LOG(WARNING) << "Skipping the test: " << message;\
+    return;\
+  } while (false)
+#endif
+
 // Make the eclipse parser silent.
 #ifndef TYPED_TEST
 #define TYPED_TEST(x,y) int x##y()
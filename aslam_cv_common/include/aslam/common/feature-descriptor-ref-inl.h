@@ -188,6 +188,61 @@ operator[](size_t index) const {
   return data_[index];
 }
 
+template <typename PointerType, int AccessorLevel>
+inline void computeHammingDistancesBatch(
+    const FeatureDescriptorRefBase<PointerType, AccessorLevel>& query,
+    const Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>& descriptors,
+    const std::vector<int>& candidate_indices,
+    std::vector<Hamming::ResultType>* out_distances) {
+  CHECK_NOTNULL(out_distances);
+  CHECK_EQ(static_cast<int>(query.size()), descriptors.rows())
+      << "Cannot compare descriptors of unequal size.";
+  out_distances->resize(candidate_indices.size());
+  if (candidate_indices.empty()) {
+    return;
+  }
+  CHECK_NOTNULL(query.data());
+  for (const int candidate_index : candidate_indices) {
+    DCHECK_GE(candidate_index, 0);
+    DCHECK_LT(candidate_index, descriptors.cols());
+  }
+  Hamming::evaluateBatch(
+      query.data(), descriptors.data(), static_cast<size_t>(descriptors.rows()),
+      candidate_indices.data(), candidate_indices.size(), query.size(),
+      out_distances->data());
+}
+
+template <typename PointerType, int AccessorLevel>
+inline void computeHammingDistancesBatchBounded(
+    const FeatureDescriptorRefBase<PointerType, AccessorLevel>& query,
+    const Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>& descriptors,
+    const std::vector<int>& candidate_indices, const Hamming::ResultType max_distance,
+    std::vector<Hamming::ResultType>* out_distances,
+    const Hamming::FixedSizeBatchFunction fixed_size_function) {
+  CHECK_NOTNULL(out_distances);
+  CHECK_EQ(static_cast<int>(query.size()), descriptors.rows())
+      << "Cannot compare descriptors of unequal size.";
+  out_distances->resize(candidate_indices.size());
+  if (candidate_indices.empty()) {
+    return;
+  }
+  CHECK_NOTNULL(query.data());
+  for (const int candidate_index : candidate_indices) {
+    DCHECK_GE(candidate_index, 0);
+    DCHECK_LT(candidate_index, descriptors.cols());
+  }
+  if (fixed_size_function != nullptr) {
+    fixed_size_function(query.data(), descriptors.data(), static_cast<size_t>(descriptors.rows()),
+                        candidate_indices.data(), candidate_indices.size(),
+                        out_distances->data());
+    return;
+  }
+  Hamming::evaluateBatchBounded(
+      query.data(), descriptors.data(), static_cast<size_t>(descriptors.rows()),
+      candidate_indices.data(), candidate_indices.size(), query.size(), max_distance,
+      out_distances->data());
+}
+
 template <typename TYPE, int ACCESSOR>
 void DescriptorMean(
     const std::vector<FeatureDescriptorRefBase<TYPE, ACCESSOR>*>& features,
@@ -6,6 +6,8 @@
 #include <stdlib.h>
 #include <vector>
 
+#include <Eigen/Core>
+
 #include "aslam/common/hamming.h"
 
 namespace aslam {
@@ -152,6 +154,35 @@ inline size_t GetNumBitsDifferent(
   return static_cast<size_t>(hamming(descriptor1.data(), descriptor2.data(), descriptor_size));
 }
 
+/// \brief Computes the Hamming distances between the query and a subset of the
+///        descriptors of a column-major descriptor block.
+///
+/// The query is loaded once and the candidates are streamed from the block, which
+/// avoids the per pair overhead of GetNumBitsDifferent.
+/// @param[in]  query              The query descriptor.
+/// @param[in]  descriptors        One descriptor per column, e.g. VisualFrame::DescriptorsT.
+/// @param[in]  candidate_indices  Column indices of the candidate descriptors.
+/// @param[out] out_distances      The distances, in the order of candidate_indices.
+template <typename PointerType, int AccessorLevel>
+inline void computeHammingDistancesBatch(
+    const FeatureDescriptorRefBase<PointerType, AccessorLevel>& query,
+    const Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>& descriptors,
+    const std::vector<int>& candidate_indices,
+    std::vector<Hamming::ResultType>* out_distances);
+
+/// \brief Same as computeHammingDistancesBatch(), but the distances are only exact up to
+///        max_distance, see Hamming::evaluateBounded(). Larger distances are reported as some
+///        value larger than max_distance.
+/// @param[in] fixed_size_function  Optional, the kernel of Hamming::getFixedSizeBatchFunction()
+///                                 for the descriptor size, which computes exact distances.
+template <typename PointerType, int AccessorLevel>
+inline void computeHammingDistancesBatchBounded(
+    const FeatureDescriptorRefBase<PointerType, AccessorLevel>& query,
+    const Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>& descriptors,
+    const std::vector<int>& candidate_indices, const Hamming::ResultType max_distance,
+    std::vector<Hamming::ResultType>* out_distances,
+    const Hamming::FixedSizeBatchFunction fixed_size_function = nullptr);
+
 template <typename TYPE, int ACCESSOR>
 inline void DescriptorMean(
     const std::vector<FeatureDescriptorRefBase<TYPE, ACCESSOR>*>& features,
@@ -41,6 +41,9 @@
 #ifndef ASLAM_COMMON_HAMMING_H_
 #define ASLAM_COMMON_HAMMING_H_
 
+#include <cstddef>
+#include <cstdint>
+
 #ifdef __ARM_NEON__
 #include <arm_neon.h>
 #else
@@ -56,6 +59,12 @@ class  Hamming {
  public:
   Hamming() { }
 
+  typedef unsigned char ValueType;
+
+  // Important that this is signed as weird behavior happens in BruteForce if
+  // not.
+  typedef int ResultType;
+
 #ifdef __ARM_NEON__
   static __inline__ uint32_t NEONPopcntofXORed(const uint8x16_t* signature1,
                                                const uint8x16_t* signature2,
@@ -73,6 +82,25 @@ class  Hamming {
     return NEONPopcntofXORed(signature1, signature2, numberOf128BitWords);
   }
 #else
+  /// Available x86 popcount kernels. The fastest one supported by the CPU is
+  /// selected once at runtime and then used by evaluate().
+  enum class Implementation {
+    kSSSE3,
+    kAVX2,
+    kAVX512
+  };
+
+  typedef uint32_t (*PopcntFunction)(const unsigned char* signature1,
+                                     const unsigned char* signature2,
+                                     const int numberOf128BitWords);
+  typedef void (*BatchPopcntFunction)(const unsigned char* query,
+                                      const unsigned char* candidates,
+                                      const size_t candidate_stride_bytes,
+                                      const int* candidate_indices,
+                                      const size_t num_candidates,
+                                      const int numberOf128BitWords,
+                                      ResultType* distances);
+
   static __inline__ uint32_t SSSE3PopcntofXORed(const __m128i* signature1,
                                                 const __m128i* signature2,
                                                 const int numberOf128BitWords);
@@ -88,13 +116,67 @@ class  Hamming {
                               reinterpret_cast<const __m128i*>(signature2),
                               numberOf128BitWords);
   }
-#endif  // __ARM_NEON__
 
-  typedef unsigned char ValueType;
+  /// Nibble lookup via vpshufb on 256 bit lanes, remaining 128 bit word is
+  /// handled with the 128 bit variant. The signatures need not be aligned.
+  static uint32_t AVX2PopcntofXORed(const unsigned char* signature1,
+                                    const unsigned char* signature2,
+                                    const int numberOf128BitWords);
+  /// Uses vpopcntq on 512 bit lanes, the tail is read with a masked load.
+  /// The signatures need not be aligned.
+  static uint32_t AVX512PopcntofXORed(const unsigned char* signature1,
+                                      const unsigned char* signature2,
+                                      const int numberOf128BitWords);
 
-  // Important that this is signed as weird behavior happens in BruteForce if
-  // not.
-  typedef int ResultType;
+  /// One-to-many variants of the above, see evaluateBatch().
+  static void AVX2BatchPopcntofXORed(const unsigned char* query,
+                                     const unsigned char* candidates,
+                                     const size_t candidate_stride_bytes,
+                                     const int* candidate_indices,
+                                     const size_t num_candidates,
+                                     const int numberOf128BitWords,
+                                     ResultType* distances);
+  static void AVX512BatchPopcntofXORed(const unsigned char* query,
+                                       const unsigned char* candidates,
+                                       const size_t candidate_stride_bytes,
+                                       const int* candidate_indices,
+                                       const size_t num_candidates,
+                                       const int numberOf128BitWords,
+                                       ResultType* distances);
+
+  /// Returns true if the kernel was compiled in and its instruction set level
+  /// is supported, see cpu::isIsaSupported() and --aslam_force_isa.
+  static bool isImplementationSupported(const Implementation implementation);
+  /// The fastest supported implementation, resolved with the kernel registry
+  /// of aslam/common/cpu.h.
+  static Implementation getBestSupportedImplementation();
+  static PopcntFunction getPopcntFunction(const Implementation implementation);
+  static BatchPopcntFunction getBatchPopcntFunction(
+      const Implementation implementation);
+  static const char* getImplementationName(const Implementation implementation);
+
+  /// Counts the bits in a ^ b with an explicitly chosen kernel. The
+  /// implementation must be supported on this machine.
+  static ResultType evaluateWith(const Implementation implementation,
+                                 const unsigned char* a,
+                                 const unsigned char* b,
+                                 const int size) {
+    return getPopcntFunction(implementation)(a, b, size / 16);
+  }
+
+  static void evaluateBatchWith(const Implementation implementation,
+                                const unsigned char* query,
+                                const unsigned char* candidates,
+                                const size_t candidate_stride_bytes,
+                                const int* candidate_indices,
+                                const size_t num_candidates,
+                                const int size,
+                                ResultType* distances) {
+    getBatchPopcntFunction(implementation)(
+        query, candidates, candidate_stride_bytes, candidate_indices,
+        num_candidates, size / 16, distances);
+  }
+#endif  // __ARM_NEON__
 
   static ResultType evaluate(const unsigned char* a,
                              const unsigned char* b,
@@ -104,12 +186,111 @@ class  Hamming {
                              reinterpret_cast<const uint8x16_t*>(b),
                              size / 16);
 #else
-    return SSSE3PopcntofXORed(reinterpret_cast<const __m128i*>(a),
-                              reinterpret_cast<const __m128i*>(b),
-                              size / 16);
+    // Resolved on first use, thread-safe as per C++11.
+    static const PopcntFunction kPopcntFunction =
+        getPopcntFunction(getBestSupportedImplementation());
+    return kPopcntFunction(a, b, size / 16);
+#endif  // __ARM_NEON__
+  }
+
+  /// \brief Counts the bits in query ^ candidate for many candidates at once.
+  ///
+  /// The query is loaded only once and the candidates are read from a strided
+  /// block, e.g. the columns of a column-major descriptor matrix.
+  /// @param[in]  query                   The query descriptor.
+  /// @param[in]  candidates              Start of the candidate descriptor block.
+  /// @param[in]  candidate_stride_bytes  Offset between two candidates in bytes.
+  /// @param[in]  candidate_indices       Indices of the candidates in the block.
+  /// @param[in]  num_candidates          Number of candidate indices.
+  /// @param[in]  size                    Descriptor size in bytes.
+  /// @param[out] distances               Dense output of num_candidates entries.
+  static void evaluateBatch(const unsigned char* query,
+                            const unsigned char* candidates,
+                            const size_t candidate_stride_bytes,
+                            const int* candidate_indices,
+                            const size_t num_candidates,
+                            const int size,
+                            ResultType* distances) {
+#ifdef __ARM_NEON__
+    for (size_t i = 0u; i < num_candidates; ++i) {
+      distances[i] = NEONPopcntofXORed(
+          reinterpret_cast<const uint8x16_t*>(query),
+          reinterpret_cast<const uint8x16_t*>(
+              candidates + candidate_stride_bytes * candidate_indices[i]),
+          size / 16);
+    }
+#else
+    static const BatchPopcntFunction kBatchPopcntFunction =
+        getBatchPopcntFunction(getBestSupportedImplementation());
+    kBatchPopcntFunction(query, candidates, candidate_stride_bytes,
+                         candidate_indices, num_candidates, size / 16,
+                         distances);
 #endif  // __ARM_NEON__
   }
 
+  /// One-to-many kernel for a descriptor size known at compile time, see
+  /// getFixedSizeBatchFunction(). The distances are exact.
+  typedef void (*FixedSizeBatchFunction)(const unsigned char* query,
+                                         const unsigned char* candidates,
+                                         const size_t candidate_stride_bytes,
+                                         const int* candidate_indices,
+                                         const size_t num_candidates,
+                                         ResultType* distances);
+
+  /// \brief The batch kernel specialized for the descriptor size, for ORB
+  ///        (32 bytes), BRISK (48 bytes) and FREAK (64 bytes) descriptors and
+  ///        compressed descriptors of 16 bytes, see
+  ///        descriptor_utils::compressDescriptors().
+  ///
+  /// The loop over the 64 bit words of a descriptor is unrolled at compile
+  /// time and the query is held in registers for all candidates. Resolve the
+  /// kernel once per descriptor size, e.g. when setting up a matching problem.
+  /// @return Null for other sizes or if the popcount level is not supported,
+  ///         see cpu::isIsaSupported(). Use evaluateBatch() then.
+  static FixedSizeBatchFunction getFixedSizeBatchFunction(const int size);
+
+  /// Chunk size of the bounded evaluation, one AVX2 word.
+  static constexpr int kBoundedChunkSizeBytes = 32;
+
+  /// \brief Same as evaluate(), but stops counting after the first chunk of
+  ///        kBoundedChunkSizeBytes at which the running distance exceeds
+  ///        max_distance.
+  ///
+  /// The result is exact if it is at most max_distance. Otherwise it is some
+  /// value larger than max_distance and at most the exact distance.
+  static ResultType evaluateBounded(const unsigned char* a,
+                                    const unsigned char* b,
+                                    const int size,
+                                    const ResultType max_distance) {
+    ResultType distance = 0;
+    for (int offset = 0; offset < size; offset += kBoundedChunkSizeBytes) {
+      // No std::min, it would odr-use the constant.
+      const int chunk_size_bytes = size - offset < kBoundedChunkSizeBytes ?
+          size - offset : kBoundedChunkSizeBytes;
+      distance += evaluate(a + offset, b + offset, chunk_size_bytes);
+      if (distance > max_distance) {
+        break;
+      }
+    }
+    return distance;
+  }
+
+  /// \brief Bounded variant of evaluateBatch(), see evaluateBounded().
+  static void evaluateBatchBounded(const unsigned char* query,
+                                   const unsigned char* candidates,
+                                   const size_t candidate_stride_bytes,
+                                   const int* candidate_indices,
+                                   const size_t num_candidates,
+                                   const int size,
+                                   const ResultType max_distance,
+                                   ResultType* distances) {
+    for (size_t i = 0u; i < num_candidates; ++i) {
+      distances[i] = evaluateBounded(
+          query, candidates + candidate_stride_bytes * candidate_indices[i],
+          size, max_distance);
+    }
+  }
+
   // This will count the bits in a ^ b.
   inline ResultType operator()(const unsigned char* a,
                                const unsigned char* b,
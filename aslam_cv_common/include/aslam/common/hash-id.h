@@ -8,6 +8,7 @@
 #include <iostream>
 #include <random>
 #include <mutex>
+#include <vector>
 
 namespace aslam {
 
@@ -46,8 +47,7 @@ class HashId {
   }
 
   /**
-   * Generates a random Hash ID seeded from the nanosecond time of the first
-   * call of this function
+   * Generates a random Hash ID, see randomize().
    */
   inline static HashId random() {
     HashId generated;
@@ -55,6 +55,17 @@ class HashId {
     return generated;
   }
 
+  /**
+   * Generates num_ids random Hash IDs at once, cheaper than calling random()
+   * for each of them.
+   */
+  static void generateIds(size_t num_ids, HashId* ids);
+  inline static std::vector<HashId> generateIds(size_t num_ids) {
+    std::vector<HashId> ids(num_ids);
+    generateIds(num_ids, ids.data());
+    return ids;
+  }
+
   /**
    * Returns hexadecimal string for debugging or serialization
    */
@@ -111,7 +122,7 @@ class HashId {
    * is fine since we can disambiguate the actual hashes using operator==.
    * So this does not increase the probability of ID collision.
    * Version that skips prime multiplication for seeds that are already well
-   * distributed.
+   * distributed, like the ones generated by randomize(). Used by std::hash.
    */
   inline size_t hashToSizeTFast() const {
     size_t hash = HashPrimeAndBase::kOffsetBasis;
@@ -121,18 +132,11 @@ class HashId {
   }
 
   /**
-   * Randomizes to ID seeded from the nanosecond time of the first
-   * call of this function
+   * Randomizes to an ID that is unique within the process. Every thread
+   * generates its IDs without locking, by permuting its thread index and the
+   * number of IDs it generated with a key that is seeded randomly per process.
    */
-  inline void randomize(){
-    static std::mt19937_64 rng(time64());
-    static std::mutex m_rng;
-    {
-      std::unique_lock<std::mutex> lock(m_rng);
-      val_.u64[0] = rng();
-      val_.u64[1] = rng();
-    }
-  }
+  void randomize();
 
   inline void operator =(const HashId& other) {
     memcpy(&val_, &other.val_, sizeof(val_));
@@ -168,19 +172,6 @@ class HashId {
   }
 
  private:
-  /**
-   * Time seed from nanoseconds. Covers 584 years if we assume no two agents
-   * initialize in the same nanosecond.
-   */
-  inline static int64_t time64() {
-    std::chrono::high_resolution_clock::duration current =
-        std::chrono::high_resolution_clock::now().time_since_epoch();
-    using std::chrono::duration_cast;
-    using std::chrono::nanoseconds;
-    // count() specified to return at least 64 bits
-    return duration_cast<nanoseconds>(current).count();
-  }
-
   /**
    * Internal representation
    */
@@ -208,7 +199,7 @@ struct hash<aslam::HashId>{
   typedef std::size_t value_type;
 
   value_type operator()(const argument_type& hash_id) const {
-    return hash_id.hashToSizeT();
+    return hash_id.hashToSizeTFast();
   }
 };
 } // namespace std
@@ -222,7 +213,7 @@ struct hash<aslam::HashId>{
       typedef FullyQualifiedIdTypeName argument_type;                     \
       typedef std::size_t value_type;                                     \
       value_type operator()(const argument_type& hash_id) const {         \
-        return hash_id.hashToSizeT();                                     \
+        return hash_id.hashToSizeTFast();                                 \
       }                                                                   \
     };                                                                    \
 }  /* namespace std */                                                \
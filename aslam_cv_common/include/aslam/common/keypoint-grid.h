@@ -0,0 +1,162 @@
+#ifndef ASLAM_COMMON_KEYPOINT_GRID_H_
+#define ASLAM_COMMON_KEYPOINT_GRID_H_
+
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+namespace aslam {
+namespace common {
+
+/// \class KeypointGrid
+/// \brief A flat 2D bucket grid over keypoint positions for fast window and radius lookups.
+///
+/// The grid is built in one counting-sort pass: the keypoint indices are stored sorted by cell in
+/// a single array together with their coordinates and a CSR-style offset array marks where every
+/// cell starts. Cells are stored row-major, hence consecutive cells of a grid row (and, for grids
+/// with a single column, consecutive rows) are contiguous in memory. Within a cell the keypoints
+/// keep their original order.
+///
+/// Keypoints are expected as (x, y) = (column, row) image coordinates. Keypoints outside of the
+/// covered area are assigned to the closest border cell.
+class KeypointGrid {
+ public:
+  ASLAM_POINTER_TYPEDEFS(KeypointGrid);
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /// Creates an empty grid with zero cells. Call initialize() before building.
+  KeypointGrid();
+
+  /// @param[in] num_cell_rows  Number of cells in y direction.
+  /// @param[in] num_cell_cols  Number of cells in x direction.
+  /// @param[in] cell_size_rows Height of a cell in pixels.
+  /// @param[in] cell_size_cols Width of a cell in pixels.
+  KeypointGrid(size_t num_cell_rows, size_t num_cell_cols, double cell_size_rows,
+               double cell_size_cols);
+
+  /// Creates a grid with square cells that covers an image of the given size.
+  static KeypointGrid createForImage(size_t image_width, size_t image_height,
+                                     double cell_size_pixels);
+
+  void initialize(size_t num_cell_rows, size_t num_cell_cols, double cell_size_rows,
+                  double cell_size_cols);
+
+  /// \brief Sorts the keypoints into the grid, replacing the previous content.
+  /// @param[in] keypoints  The keypoints, one per column.
+  /// @param[in] is_valid   Optional flags marking keypoints that should be inserted. All
+  ///                       keypoints are inserted if this is a nullptr.
+  void build(const Eigen::Matrix2Xd& keypoints, const std::vector<bool>* is_valid);
+
+  /// Removes all keypoints, keeping the grid layout.
+  void clear();
+
+  inline size_t numCellRows() const { return num_cell_rows_; }
+  inline size_t numCellCols() const { return num_cell_cols_; }
+  inline size_t numCells() const { return num_cell_rows_ * num_cell_cols_; }
+  /// Number of keypoints that were inserted into the grid.
+  inline size_t numKeypoints() const { return sorted_keypoint_indices_.size(); }
+
+  /// Cell coordinates of an image location, clamped to the grid.
+  inline size_t getCellRow(double y) const;
+  inline size_t getCellCol(double x) const;
+  inline size_t getCellIndex(size_t cell_row, size_t cell_col) const {
+    return cell_row * num_cell_cols_ + cell_col;
+  }
+
+  /// \brief Position of the first keypoint of a cell in the sorted arrays.
+  ///
+  /// Valid for cell_index in [0, numCells()], where getCellOffset(numCells()) equals
+  /// numKeypoints(). The keypoints of cell i are [getCellOffset(i), getCellOffset(i + 1)).
+  inline size_t getCellOffset(size_t cell_index) const {
+    DCHECK_LT(cell_index, cell_offsets_.size());
+    return cell_offsets_[cell_index];
+  }
+
+  /// Original keypoint index of the keypoint at the given sorted position.
+  inline int getSortedKeypointIndex(size_t sorted_position) const {
+    DCHECK_LT(sorted_position, sorted_keypoint_indices_.size());
+    return sorted_keypoint_indices_[sorted_position];
+  }
+  inline const std::vector<int>& getSortedKeypointIndices() const {
+    return sorted_keypoint_indices_;
+  }
+  /// Coordinates of the keypoints in sorted order, one per column.
+  inline const Eigen::Matrix2Xd& getSortedKeypoints() const { return sorted_keypoints_; }
+
+  /// \brief Calls the functor with the sorted position range [begin, end) of all cells that
+  ///        intersect the given window. Neighboring cells of a grid row are merged into one range.
+  template <typename RangeFunctor>
+  inline void forEachRangeInWindow(double x_min, double x_max, double y_min, double y_max,
+                                   const RangeFunctor& range_functor) const;
+
+  /// \brief Appends the original indices of all keypoints with a distance smaller than radius
+  ///        to the given center.
+  void getKeypointIndicesInRadius(const Eigen::Vector2d& center, double radius,
+                                  std::vector<int>* keypoint_indices) const;
+
+ private:
+  size_t num_cell_rows_;
+  size_t num_cell_cols_;
+  double inverse_cell_size_rows_;
+  double inverse_cell_size_cols_;
+
+  /// CSR offsets, numCells() + 1 entries.
+  std::vector<size_t> cell_offsets_;
+  /// Original keypoint indices sorted by cell.
+  std::vector<int> sorted_keypoint_indices_;
+  /// Keypoint coordinates sorted by cell.
+  Eigen::Matrix2Xd sorted_keypoints_;
+  /// Cell index of every keypoint during the build, kept to avoid reallocations.
+  std::vector<size_t> keypoint_cell_indices_;
+};
+
+inline size_t KeypointGrid::getCellRow(double y) const {
+  DCHECK_GT(num_cell_rows_, 0u);
+  const double cell_row = y * inverse_cell_size_rows_;
+  if (!(cell_row >= 0.0)) {
+    return 0u;
+  }
+  if (cell_row >= static_cast<double>(num_cell_rows_)) {
+    return num_cell_rows_ - 1u;
+  }
+  return static_cast<size_t>(cell_row);
+}
+
+inline size_t KeypointGrid::getCellCol(double x) const {
+  DCHECK_GT(num_cell_cols_, 0u);
+  const double cell_col = x * inverse_cell_size_cols_;
+  if (!(cell_col >= 0.0)) {
+    return 0u;
+  }
+  if (cell_col >= static_cast<double>(num_cell_cols_)) {
+    return num_cell_cols_ - 1u;
+  }
+  return static_cast<size_t>(cell_col);
+}
+
+template <typename RangeFunctor>
+inline void KeypointGrid::forEachRangeInWindow(double x_min, double x_max, double y_min,
+                                               double y_max,
+                                               const RangeFunctor& range_functor) const {
+  if (numKeypoints() == 0u || x_min > x_max || y_min > y_max) {
+    return;
+  }
+  const size_t cell_col_min = getCellCol(x_min);
+  const size_t cell_col_max = getCellCol(x_max);
+  const size_t cell_row_min = getCellRow(y_min);
+  const size_t cell_row_max = getCellRow(y_max);
+  for (size_t cell_row = cell_row_min; cell_row <= cell_row_max; ++cell_row) {
+    const size_t begin = cell_offsets_[getCellIndex(cell_row, cell_col_min)];
+    const size_t end = cell_offsets_[getCellIndex(cell_row, cell_col_max) + 1u];
+    if (begin < end) {
+      range_functor(begin, end);
+    }
+  }
+}
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_KEYPOINT_GRID_H_
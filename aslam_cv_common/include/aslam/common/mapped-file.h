@@ -0,0 +1,55 @@
+#ifndef ASLAM_COMMON_MAPPED_FILE_H_
+#define ASLAM_COMMON_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+namespace aslam {
+namespace common {
+
+/// \class MappedFile
+/// \brief Owns the memory mapping of a file or of a POSIX shared memory object and unmaps it
+///        when closed or destroyed.
+///
+/// The file descriptor is closed as soon as the object is mapped. On failure the methods return
+/// false without logging and leave errno set, such that the callers can report the error in
+/// terms of what the file holds.
+class MappedFile {
+ public:
+  MappedFile();
+  MappedFile(MappedFile&& other);
+  MappedFile& operator=(MappedFile&& other);
+  MappedFile(const MappedFile&) = delete;
+  void operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  /// Maps the file read-only. An empty file is open with a null data pointer.
+  bool open(const std::string& path);
+  /// Maps the existing shared memory object, e.g. "/ring", readable and writable.
+  bool openSharedMemory(const std::string& name);
+  /// \brief Creates the zero-filled shared memory object and maps it readable and writable.
+  ///
+  /// Fails if the object exists. The object is unlinked again if it can't be mapped, otherwise
+  /// the caller unlinks it with shm_unlink once it is no longer published.
+  bool createSharedMemory(const std::string& name, size_t size_bytes);
+  void close();
+
+  bool isOpen() const { return is_open_; }
+  const char* data() const { return data_; }
+  /// Only the mappings of shared memory objects are writable.
+  char* data() { return data_; }
+  size_t sizeBytes() const { return size_bytes_; }
+
+ private:
+  /// Maps the file descriptor and closes it.
+  bool map(int file_descriptor, size_t size_bytes, int protection);
+
+  char* data_;
+  size_t size_bytes_;
+  bool is_open_;
+};
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_MAPPED_FILE_H_
@@ -0,0 +1,92 @@
+#ifndef ASLAM_COMMON_MEMORY_USAGE_H_
+#define ASLAM_COMMON_MEMORY_USAGE_H_
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <Eigen/Core>
+#include <opencv2/core/core.hpp>
+
+namespace aslam {
+namespace common {
+
+/// \brief Heap memory owned by a value, i.e. excluding sizeof(value). Values without dynamic
+///        storage own none.
+///
+/// The memory of reference counted images is counted for every image header referencing it,
+/// hence an image shared by several frames is counted several times.
+template <typename ValueType>
+size_t getMemoryUsageBytes(const ValueType& /*value*/) {
+  return 0u;
+}
+
+template <typename Scalar, int ROWS, int COLS, int OPTIONS, int MAX_ROWS, int MAX_COLS>
+size_t getMemoryUsageBytes(
+    const Eigen::Matrix<Scalar, ROWS, COLS, OPTIONS, MAX_ROWS, MAX_COLS>& matrix) {
+  if (ROWS != Eigen::Dynamic && COLS != Eigen::Dynamic) {
+    return 0u;
+  }
+  return sizeof(Scalar) * static_cast<size_t>(matrix.size());
+}
+
+inline size_t getMemoryUsageBytes(const cv::Mat& image) {
+  return image.empty() ? 0u : image.total() * image.elemSize();
+}
+
+template <typename ValueType, typename Allocator>
+size_t getMemoryUsageBytes(const std::vector<ValueType, Allocator>& values) {
+  size_t num_bytes = values.capacity() * sizeof(ValueType);
+  if (!std::is_trivially_copyable<ValueType>::value) {
+    for (const ValueType& value : values) {
+      num_bytes += getMemoryUsageBytes(value);
+    }
+  }
+  return num_bytes;
+}
+
+/// \class MemoryUsageReport
+/// \brief The memory of the components of a system under hierarchical tags such as
+///        "VisualNPipeline/completed", e.g. to enforce memory budgets on embedded targets.
+///
+/// The components add their usage through their getMemoryUsage() methods. A report is a
+/// snapshot; collect one periodically and add it to the statistics to track the usage over time.
+class MemoryUsageReport {
+ public:
+  typedef std::map<std::string, size_t> EntryMap;
+
+  /// Add the memory of a component, the bytes of entries with the same tag are summed.
+  void add(const std::string& tag, size_t num_bytes);
+  void clear() { entries_.clear(); }
+
+  const EntryMap& getEntries() const { return entries_; }
+  /// The bytes of the tag and of all tags below it, e.g. "VisualNPipeline" includes
+  /// "VisualNPipeline/completed". The empty tag is the total, unknown tags have 0 bytes.
+  size_t getBytes(const std::string& tag) const;
+  size_t getTotalBytes() const;
+
+  /// \brief Check the entries against budgets in bytes, the budget of a tag bounds the sum of
+  ///        getBytes(). Tags without a budget are unbounded; the empty tag is the budget of the
+  ///        total.
+  /// @param[out] exceeded_tags The tags over budget, can be null.
+  /// @return True if all entries are within their budgets.
+  bool isWithinBudgets(const EntryMap& budgets_bytes,
+                       std::vector<std::string>* exceeded_tags) const;
+
+  /// Add every entry as sample in MiB of the statistics tag "memory/<tag>", and the total as
+  /// "memory/total".
+  void addToStatistics() const;
+
+  void print(std::ostream& out) const;  // NOLINT
+
+ private:
+  EntryMap entries_;
+};
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_MEMORY_USAGE_H_
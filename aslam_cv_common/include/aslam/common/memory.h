@@ -1,6 +1,8 @@
 #ifndef ASLAM_COMMON_MEMORY_H_
 #define ASLAM_COMMON_MEMORY_H_
 
+#include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
@@ -8,9 +10,11 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <Eigen/Core>
 #include <Eigen/StdVector>
+#include <glog/logging.h>
 
 #include "aslam/common/eigen-hash.h"
 
@@ -80,4 +84,245 @@ inline AlignedUniquePtr<Type> aligned_unique(Arguments&&... arguments) {
   return std::move(AlignedUniquePtr<Type>(obj));
 }
 
+namespace aslam {
+namespace common {
+
+/// Alignment required by vectorized Eigen types.
+#if defined(EIGEN_MAX_ALIGN_BYTES) && EIGEN_MAX_ALIGN_BYTES > 16
+constexpr size_t kEigenAlignmentBytes = EIGEN_MAX_ALIGN_BYTES;
+#else
+constexpr size_t kEigenAlignmentBytes = 16u;
+#endif
+
+/// \class MonotonicArena
+/// \brief Hands out memory by bumping a pointer, and frees all of it at once on reset().
+///
+/// Meant for scratch memory of one frame or one task: allocate freely while processing, then
+/// reset(). If the arena had to grow, reset() replaces the blocks by a single block of the total
+/// size, such that the following frames of similar size don't allocate at all. Destructors are
+/// never called, hence only trivially destructible objects can be created in the arena. Not
+/// thread-safe, use one arena per thread, e.g. getThreadLocalArena().
+class MonotonicArena {
+ public:
+  explicit MonotonicArena(size_t initial_capacity_bytes = 64u * 1024u)
+      : current_block_offset_(0u), num_bytes_used_(0u) {
+    CHECK_GT(initial_capacity_bytes, 0u);
+    addBlock(initial_capacity_bytes);
+  }
+  MonotonicArena(const MonotonicArena&) = delete;
+  MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+  /// Returns uninitialized memory, the alignment must be a power of two.
+  void* allocate(size_t num_bytes, size_t alignment = kEigenAlignmentBytes) {
+    CHECK_GT(alignment, 0u);
+    CHECK_EQ(alignment & (alignment - 1u), 0u) << "The alignment must be a power of two.";
+    void* memory = allocateFromCurrentBlock(num_bytes, alignment);
+    if (memory == nullptr) {
+      addBlock(std::max(2u * blocks_.back().size, num_bytes + alignment));
+      memory = allocateFromCurrentBlock(num_bytes, alignment);
+      CHECK(memory != nullptr);
+    }
+    num_bytes_used_ += num_bytes;
+    return memory;
+  }
+
+  /// Uninitialized memory for num_objects objects.
+  template <typename Type>
+  Type* allocateArray(size_t num_objects) {
+    static_assert(std::is_trivially_destructible<Type>::value,
+                  "The arena never calls destructors.");
+    return static_cast<Type*>(allocate(
+        num_objects * sizeof(Type), std::max(alignof(Type), kEigenAlignmentBytes)));
+  }
+
+  template <typename Type, typename... Arguments>
+  Type* create(Arguments&&... arguments) {
+    return ::new (allocateArray<Type>(1u)) Type(std::forward<Arguments>(arguments)...);
+  }
+
+  /// Invalidates all memory handed out so far.
+  void reset() {
+    if (blocks_.size() > 1u) {
+      const size_t capacity = getCapacity();
+      blocks_.clear();
+      addBlock(capacity);
+    }
+    current_block_offset_ = 0u;
+    num_bytes_used_ = 0u;
+  }
+
+  /// Bytes requested since the last reset, without the alignment padding.
+  size_t getNumBytesUsed() const { return num_bytes_used_; }
+  size_t getCapacity() const {
+    size_t capacity = 0u;
+    for (const Block& block : blocks_) {
+      capacity += block.size;
+    }
+    return capacity;
+  }
+  size_t getNumBlocks() const { return blocks_.size(); }
+
+ private:
+  struct Block {
+    std::unique_ptr<unsigned char[]> data;
+    size_t size;
+  };
+
+  void addBlock(size_t size) {
+    blocks_.emplace_back();
+    blocks_.back().data.reset(new unsigned char[size]);
+    blocks_.back().size = size;
+    current_block_offset_ = 0u;
+  }
+
+  void* allocateFromCurrentBlock(size_t num_bytes, size_t alignment) {
+    const Block& block = blocks_.back();
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(block.data.get());
+    const uintptr_t aligned =
+        (begin + current_block_offset_ + alignment - 1u) & ~(uintptr_t(alignment) - 1u);
+    const size_t offset = static_cast<size_t>(aligned - begin);
+    if (offset + num_bytes > block.size) {
+      return nullptr;
+    }
+    current_block_offset_ = offset + num_bytes;
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  std::vector<Block> blocks_;
+  size_t current_block_offset_;
+  size_t num_bytes_used_;
+};
+
+/// The arena of the calling thread, to be reset by the code that owns the thread.
+inline MonotonicArena& getThreadLocalArena() {
+  static thread_local MonotonicArena arena;
+  return arena;
+}
+
+/// \class ArenaAllocator
+/// \brief Standard allocator drawing from a MonotonicArena, like a std::pmr allocator.
+///
+/// The memory is aligned for Eigen types and only released when the arena is reset, which must
+/// not happen while a container still uses it.
+///   MonotonicArena arena;
+///   ArenaVector<Eigen::Vector4d> points{ArenaAllocator<Eigen::Vector4d>(&arena)};
+template <typename Type>
+class ArenaAllocator {
+ public:
+  typedef Type value_type;
+  template <typename OtherType>
+  struct rebind {
+    typedef ArenaAllocator<OtherType> other;
+  };
+
+  explicit ArenaAllocator(MonotonicArena* arena) : arena_(CHECK_NOTNULL(arena)) {}
+  template <typename OtherType>
+  ArenaAllocator(const ArenaAllocator<OtherType>& other)  // NOLINT
+      : arena_(other.getArena()) {}
+
+  Type* allocate(size_t num_objects) {
+    return static_cast<Type*>(arena_->allocate(
+        num_objects * sizeof(Type), std::max(alignof(Type), kEigenAlignmentBytes)));
+  }
+  void deallocate(Type* /*objects*/, size_t /*num_objects*/) {}
+
+  MonotonicArena* getArena() const { return arena_; }
+
+ private:
+  MonotonicArena* arena_;
+};
+
+template <typename Type, typename OtherType>
+bool operator==(const ArenaAllocator<Type>& lhs, const ArenaAllocator<OtherType>& rhs) {
+  return lhs.getArena() == rhs.getArena();
+}
+template <typename Type, typename OtherType>
+bool operator!=(const ArenaAllocator<Type>& lhs, const ArenaAllocator<OtherType>& rhs) {
+  return !(lhs == rhs);
+}
+
+template <typename Type>
+using ArenaVector = std::vector<Type, ArenaAllocator<Type>>;
+
+/// \class TypedObjectPool
+/// \brief Creates objects in recycled, Eigen aligned slots.
+///
+/// Slots are allocated in chunks and never released before the pool is destroyed, so creating
+/// and destroying objects in steady state doesn't allocate. All objects must be destroyed before
+/// the pool. Not thread-safe, see ObjectPool for a thread-safe pool of shared objects.
+template <typename ObjectType>
+class TypedObjectPool {
+ public:
+  explicit TypedObjectPool(size_t num_objects_per_chunk = 64u)
+      : num_objects_per_chunk_(num_objects_per_chunk), first_free_slot_(nullptr),
+        num_objects_in_use_(0u) {
+    CHECK_GT(num_objects_per_chunk_, 0u);
+  }
+  TypedObjectPool(const TypedObjectPool&) = delete;
+  TypedObjectPool& operator=(const TypedObjectPool&) = delete;
+
+  ~TypedObjectPool() {
+    CHECK_EQ(num_objects_in_use_, 0u) << "Objects of the pool are still in use.";
+    Eigen::aligned_allocator<Slot> allocator;
+    for (Slot* chunk : chunks_) {
+      allocator.deallocate(chunk, num_objects_per_chunk_);
+    }
+  }
+
+  template <typename... Arguments>
+  ObjectType* create(Arguments&&... arguments) {
+    if (first_free_slot_ == nullptr) {
+      addChunk();
+    }
+    Slot* slot = first_free_slot_;
+    // The object overwrites the link, the slot is taken once the constructor succeeded.
+    Slot* next_free_slot = slot->next_free_slot;
+    ObjectType* object =
+        ::new (static_cast<void*>(&slot->storage)) ObjectType(
+            std::forward<Arguments>(arguments)...);
+    first_free_slot_ = next_free_slot;
+    ++num_objects_in_use_;
+    return object;
+  }
+
+  void destroy(ObjectType* object) {
+    CHECK_NOTNULL(object)->~ObjectType();
+    Slot* slot = reinterpret_cast<Slot*>(object);
+    slot->next_free_slot = first_free_slot_;
+    first_free_slot_ = slot;
+    CHECK_GT(num_objects_in_use_, 0u);
+    --num_objects_in_use_;
+  }
+
+  size_t getNumObjectsInUse() const { return num_objects_in_use_; }
+  size_t getCapacity() const { return chunks_.size() * num_objects_per_chunk_; }
+
+ private:
+  static_assert(alignof(ObjectType) <= kEigenAlignmentBytes,
+                "Eigen::aligned_allocator can't align the objects.");
+  union Slot {
+    Slot* next_free_slot;
+    typename std::aligned_storage<sizeof(ObjectType), alignof(ObjectType)>::type storage;
+  };
+
+  void addChunk() {
+    Eigen::aligned_allocator<Slot> allocator;
+    Slot* chunk = allocator.allocate(num_objects_per_chunk_);
+    chunks_.push_back(chunk);
+    for (size_t i = 0u; i < num_objects_per_chunk_; ++i) {
+      chunk[i].next_free_slot =
+          (i + 1u < num_objects_per_chunk_) ? &chunk[i + 1u] : first_free_slot_;
+    }
+    first_free_slot_ = chunk;
+  }
+
+  const size_t num_objects_per_chunk_;
+  std::vector<Slot*> chunks_;
+  Slot* first_free_slot_;
+  size_t num_objects_in_use_;
+};
+
+}  // namespace common
+}  // namespace aslam
+
 #endif  // ASLAM_COMMON_MEMORY_H_
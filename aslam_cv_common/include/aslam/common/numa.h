@@ -0,0 +1,38 @@
+#ifndef ASLAM_COMMON_NUMA_H_
+#define ASLAM_COMMON_NUMA_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace aslam {
+namespace common {
+
+/// \brief Number of NUMA nodes of the machine as listed in /sys/devices/system/node. 1 if the
+///        topology can't be read, e.g. on other platforms, such that a single node holds all
+///        CPUs.
+size_t getNumNumaNodes();
+
+/// \brief The CPUs of a NUMA node, e.g. to pin the workers processing the data of the node
+///        (see ThreadPool::setCpuAffinity()). Empty if the topology can't be read.
+std::vector<size_t> getNumaNodeCpuIds(size_t node);
+
+/// \brief Parse a Linux CPU list as in /sys/devices/system/node/node0/cpulist, e.g.
+///        "0-3,8,10-11".
+/// @return False if the list is malformed.
+bool parseCpuList(const std::string& cpu_list, std::vector<size_t>* cpu_ids);
+
+/// \brief Bind the pages of a buffer to a NUMA node and migrate the pages that are already on
+///        another node. The pages at the start and the end of the buffer may be shared with
+///        other data, which moves as well.
+///
+/// Buffers the workers of a node fill themselves are best touched first by those workers, the
+/// kernel then places their pages on the node without binding. This is for buffers that are
+/// created elsewhere and only read by the node, e.g. lookup tables.
+/// @return False if the memory policies are not supported or binding failed.
+bool bindMemoryToNumaNode(void* data, size_t num_bytes, size_t node);
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_NUMA_H_
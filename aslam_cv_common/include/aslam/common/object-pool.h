@@ -0,0 +1,121 @@
+#ifndef ASLAM_COMMON_OBJECT_POOL_H_
+#define ASLAM_COMMON_OBJECT_POOL_H_
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <glog/logging.h>
+
+namespace aslam {
+namespace common {
+
+/// \class ObjectPool
+/// \brief A thread-safe pool of recycled objects handed out as shared pointers.
+///
+/// Objects return to the pool once the last shared pointer referencing them is released, which
+/// keeps the objects together with any memory they own alive for the next acquire() call. The
+/// recycler is called on the releasing thread before an object returns to the pool. Objects
+/// released after the pool has been destroyed are deleted.
+template <typename ObjectType>
+class ObjectPool {
+ public:
+  ASLAM_POINTER_TYPEDEFS(ObjectPool);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(ObjectPool);
+
+  typedef std::function<ObjectType*()> Factory;
+  typedef std::function<void(ObjectType*)> Recycler;
+
+  /// @param[in] max_num_pooled_objects Released objects are deleted once this many are pooled.
+  /// @param[in] factory  Creates a new object if the pool is empty.
+  /// @param[in] recycler Resets an object before it returns to the pool, can be empty.
+  ObjectPool(size_t max_num_pooled_objects, const Factory& factory, const Recycler& recycler)
+      : state_(std::make_shared<State>()) {
+    CHECK(factory);
+    state_->max_num_pooled_objects = max_num_pooled_objects;
+    state_->factory = factory;
+    state_->recycler = recycler;
+  }
+
+  /// Get a pooled object or create a new one if the pool is empty.
+  std::shared_ptr<ObjectType> acquire() {
+    ObjectType* object = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      if (!state_->pooled_objects.empty()) {
+        object = state_->pooled_objects.back().release();
+        state_->pooled_objects.pop_back();
+      }
+    }
+    if (object == nullptr) {
+      object = CHECK_NOTNULL(state_->factory());
+    }
+    const std::weak_ptr<State> weak_state = state_;
+    return std::shared_ptr<ObjectType>(object, [weak_state](ObjectType* released_object) {
+      std::unique_ptr<ObjectType> owned_object(released_object);
+      const std::shared_ptr<State> state = weak_state.lock();
+      if (!state) {
+        return;
+      }
+      if (state->recycler) {
+        state->recycler(owned_object.get());
+      }
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (state->pooled_objects.size() < state->max_num_pooled_objects) {
+        state->pooled_objects.emplace_back(std::move(owned_object));
+      }
+    });
+  }
+
+  /// \brief Create objects up front until num_objects are pooled, e.g. to allocate the working
+  ///        memory of a real-time loop before it starts.
+  /// @param[in] initializer Called on every new object, e.g. to size and pre-fault its buffers.
+  ///                        Can be empty.
+  void preallocate(size_t num_objects, const Recycler& initializer) {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    CHECK_LE(num_objects, state_->max_num_pooled_objects);
+    while (state_->pooled_objects.size() < num_objects) {
+      std::unique_ptr<ObjectType> object(CHECK_NOTNULL(state_->factory()));
+      if (initializer) {
+        initializer(object.get());
+      }
+      state_->pooled_objects.emplace_back(std::move(object));
+    }
+  }
+
+  /// Number of objects that are ready for reuse.
+  size_t numPooledObjects() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->pooled_objects.size();
+  }
+
+  /// Memory kept alive by the pooled objects, the memory of an object is given by
+  /// get_memory_usage_bytes. The objects in use are accounted for by their users.
+  template <typename MemoryUsageFunction>
+  size_t getPooledMemoryUsageBytes(const MemoryUsageFunction& get_memory_usage_bytes) const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    size_t num_bytes = state_->pooled_objects.capacity() * sizeof(std::unique_ptr<ObjectType>);
+    for (const std::unique_ptr<ObjectType>& object : state_->pooled_objects) {
+      num_bytes += get_memory_usage_bytes(*object);
+    }
+    return num_bytes;
+  }
+
+ private:
+  // Shared with the deleters of the handed out objects, which may outlive the pool.
+  struct State {
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<ObjectType>> pooled_objects;
+    size_t max_num_pooled_objects;
+    Factory factory;
+    Recycler recycler;
+  };
+  const std::shared_ptr<State> state_;
+};
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_OBJECT_POOL_H_
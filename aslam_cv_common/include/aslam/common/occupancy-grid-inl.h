@@ -2,6 +2,8 @@
 #define ASLAM_FEATURE_TRACKER_OCCUPANCY_GRID_INL_H_
 
 #include <algorithm>
+#include <cstring>
+#include <new>
 #include <unordered_map>
 
 #include <aslam/common/stl-helpers.h>
@@ -9,6 +11,49 @@
 
 namespace aslam {
 namespace common {
+namespace internal {
+/// Half widths of the rows of a filled disk, from the top to the bottom row.
+inline std::vector<int> computeDiskHalfWidths(int radius) {
+  CHECK_GE(radius, 0);
+  std::vector<int> half_widths(2 * radius + 1);
+  for (int row = -radius; row <= radius; ++row) {
+    half_widths[row + radius] = static_cast<int>(
+        std::floor(std::sqrt(static_cast<double>(radius * radius - row * row))));
+  }
+  return half_widths;
+}
+
+/// Zeroes the disk around the pixel, clipped to the mask.
+inline void stampDisk(int center_row, int center_col, const std::vector<int>& half_widths,
+                      cv::Mat* mask) {
+  CHECK_NOTNULL(mask);
+  const int radius = static_cast<int>(half_widths.size() / 2u);
+  const int row_begin = std::max(center_row - radius, 0);
+  const int row_end = std::min(center_row + radius, mask->rows - 1);
+  for (int row = row_begin; row <= row_end; ++row) {
+    const int half_width = half_widths[row - center_row + radius];
+    const int col_begin = std::max(center_col - half_width, 0);
+    const int col_end = std::min(center_col + half_width, mask->cols - 1);
+    if (col_begin <= col_end) {
+      std::memset(mask->ptr<unsigned char>(row) + col_begin, 0, col_end - col_begin + 1);
+    }
+  }
+}
+
+/// Zeroes the rectangle with the inclusive corners, clipped to the mask.
+inline void stampRectangle(int top_row, int left_col, int bottom_row, int right_col,
+                           cv::Mat* mask) {
+  CHECK_NOTNULL(mask);
+  const int col_begin = std::max(left_col, 0);
+  const int col_end = std::min(right_col, mask->cols - 1);
+  if (col_begin > col_end) {
+    return;
+  }
+  for (int row = std::max(top_row, 0); row <= std::min(bottom_row, mask->rows - 1); ++row) {
+    std::memset(mask->ptr<unsigned char>(row) + col_begin, 0, col_end - col_begin + 1);
+  }
+}
+}  // namespace internal
 
 template<typename PointType>
 WeightedOccupancyGrid<PointType>::WeightedOccupancyGrid(
@@ -184,9 +229,8 @@ void WeightedOccupancyGrid<PointType>::addPointOrReplaceWeakestNearestPoints(
       distance_violating_points) {
     PointList& cell = *CHECK_NOTNULL(cell_indices_pair.first);
     const std::vector<size_t>& indices_to_remove_from_cell = cell_indices_pair.second;
-    PointList reduced_cell =
-        aslam::common::eraseIndicesFromVector(cell, indices_to_remove_from_cell);
-    cell.swap(reduced_cell);
+    // The indices were collected in increasing order.
+    aslam::common::eraseIndicesFromVectorInPlace(indices_to_remove_from_cell, &cell);
     current_num_points_ -= indices_to_remove_from_cell.size();
   }
 }
@@ -237,6 +281,11 @@ size_t WeightedOccupancyGrid<PointType>::getNumPoints() const {
   return current_num_points_;
 }
 
+template<typename PointType>
+size_t WeightedOccupancyGrid<PointType>::getMemoryUsageBytes() const {
+  return sizeof(*this) + common::getMemoryUsageBytes(grid_);
+}
+
 template<typename PointType>
 typename WeightedOccupancyGrid<PointType>::GridCoordinates
 WeightedOccupancyGrid<PointType>::getFullestGridCell() const {
@@ -302,35 +351,69 @@ size_t WeightedOccupancyGrid<PointType>::removeWeightedPointsFromOverfullCells(
 template<typename PointType>
 cv::Mat WeightedOccupancyGrid<PointType>::getOccupancyMask(
     CoordinatesType radius_mask_around_points, size_t max_points_per_cell) const {
+  cv::Mat mask;
+  getOccupancyMask(radius_mask_around_points, max_points_per_cell, &mask);
+  return mask;
+}
+
+template<typename PointType>
+void WeightedOccupancyGrid<PointType>::getOccupancyMask(
+    CoordinatesType radius_mask_around_points, size_t max_points_per_cell,
+    cv::Mat* mask) const {
+  CHECK_NOTNULL(mask);
   CHECK_GT(radius_mask_around_points, static_cast<CoordinatesType>(0.0));
   CHECK_GT(max_points_per_cell, 0u);
 
   // Go over all cells and mask either the entire cell if the max. point count has been reached
   // in this cell or otherwise mask out the point in this cell.
-  cv::Mat mask(static_cast<int>(std::floor(max_input_coordinate_rows_)),
-               static_cast<int>(std::floor(max_input_coordinate_cols_)),
-               CV_8UC1, cv::Scalar(255));
+  mask->create(static_cast<int>(std::floor(max_input_coordinate_rows_)),
+               static_cast<int>(std::floor(max_input_coordinate_cols_)), CV_8UC1);
+  mask->setTo(cv::Scalar(255));
+  const int radius_px = static_cast<int>(radius_mask_around_points);
+  const std::vector<int> disk_half_widths = internal::computeDiskHalfWidths(radius_px);
 
   for (size_t i_row = 0u; i_row < num_grid_rows_; ++i_row) {
     for (size_t j_col = 0u; j_col < num_grid_cols_; ++j_col) {
       const PointList& cell = getGridCell(GridCoordinates(i_row, j_col));
+      const int top_row = static_cast<int>(i_row * cell_size_rows_);
+      const int left_col = static_cast<int>(j_col * cell_size_cols_);
+      const int bottom_row = static_cast<int>((i_row + 1) * cell_size_rows_ - 1);
+      const int right_col = static_cast<int>((j_col + 1) * cell_size_cols_ - 1);
+
+      // Mask the entire cell if the cell is full.
+      const bool is_cell_full = cell.size() >= max_points_per_cell;
+      if (is_cell_full) {
+        internal::stampRectangle(top_row, left_col, bottom_row, right_col, mask);
+      }
 
       // Mask out the individual keypoints in the cell.
       for (const PointType& point : cell) {
-        cv::circle(mask, cv::Point(point.v_cols, point.u_rows), radius_mask_around_points,
-                   cv::Scalar(0), CV_FILLED);
+        const int point_row = static_cast<int>(point.u_rows);
+        const int point_col = static_cast<int>(point.v_cols);
+        if (is_cell_full && point_row - radius_px >= top_row &&
+            point_row + radius_px <= bottom_row && point_col - radius_px >= left_col &&
+            point_col + radius_px <= right_col) {
+          continue;
+        }
+        internal::stampDisk(point_row, point_col, disk_half_widths, mask);
       }
+    }
+  }
+}
 
-      // Mask the entire cell if the cell is full.
-      if (cell.size() >= max_points_per_cell) {
-        cv::Point top_left(j_col * cell_size_cols_, i_row * cell_size_rows_);
-        cv::Point bottom_right((j_col + 1) * cell_size_cols_ - 1,
-                               (i_row + 1) * cell_size_rows_ - 1);
-        cv::rectangle(mask, top_left, bottom_right, cv::Scalar(0), CV_FILLED);
-      }
+template<typename PointType>
+void WeightedOccupancyGrid<PointType>::getCellOccupancyMask(
+    size_t max_points_per_cell, cv::Mat* cell_mask) const {
+  CHECK_NOTNULL(cell_mask);
+  CHECK_GT(max_points_per_cell, 0u);
+  cell_mask->create(static_cast<int>(num_grid_rows_), static_cast<int>(num_grid_cols_),
+                    CV_8UC1);
+  for (size_t i_row = 0u; i_row < num_grid_rows_; ++i_row) {
+    unsigned char* cell_mask_row = cell_mask->ptr<unsigned char>(static_cast<int>(i_row));
+    for (size_t j_col = 0u; j_col < num_grid_cols_; ++j_col) {
+      cell_mask_row[j_col] = grid_[i_row][j_col].size() >= max_points_per_cell ? 0u : 255u;
     }
   }
-  return mask;
 }
 
 template<typename PointType>
@@ -392,6 +475,201 @@ WeightedOccupancyGrid<PointType>::inputToGridCoordinates(
   return grid_coordinates;
 }
 
+template<typename PointType>
+FixedCapacityOccupancyGrid<PointType>::FixedCapacityOccupancyGrid(
+    CoordinatesType max_input_coordinate_rows,
+    CoordinatesType max_input_coordinate_cols,
+    CoordinatesType cell_size_rows, CoordinatesType cell_size_cols,
+    size_t max_points_per_cell)
+ : max_input_coordinate_rows_(max_input_coordinate_rows),
+   max_input_coordinate_cols_(max_input_coordinate_cols),
+   cell_size_rows_(cell_size_rows),
+   cell_size_cols_(cell_size_cols),
+   max_points_per_cell_(max_points_per_cell),
+   current_num_points_(0u) {
+  CHECK_GT(max_input_coordinate_rows, static_cast<CoordinatesType>(0.0));
+  CHECK_GT(max_input_coordinate_cols, static_cast<CoordinatesType>(0.0));
+  CHECK_GE(max_input_coordinate_rows, cell_size_rows);
+  CHECK_GE(max_input_coordinate_cols, cell_size_cols);
+  CHECK_GT(max_points_per_cell, 0u);
+
+  num_grid_rows_ = static_cast<size_t>(std::ceil(
+      static_cast<double>(max_input_coordinate_rows) / cell_size_rows_));
+  num_grid_cols_ = static_cast<size_t>(std::ceil(
+      static_cast<double>(max_input_coordinate_cols) / cell_size_cols_));
+  CHECK_GT(num_grid_rows_, 0u);
+  CHECK_GT(num_grid_cols_, 0u);
+
+  // The only allocations of the grid.
+  const size_t num_cells = num_grid_rows_ * num_grid_cols_;
+  point_slots_.resize(num_cells * max_points_per_cell_);
+  cell_sizes_.resize(num_cells, 0u);
+  cell_weakest_point_indices_.resize(num_cells, 0u);
+  cell_weakest_point_weights_.resize(num_cells);
+}
+
+template<typename PointType>
+void FixedCapacityOccupancyGrid<PointType>::reset() {
+  // The weakest points are only valid for non-empty cells and don't need to be cleared.
+  std::fill(cell_sizes_.begin(), cell_sizes_.end(), 0u);
+  current_num_points_ = 0u;
+}
+
+template<typename PointType>
+bool FixedCapacityOccupancyGrid<PointType>::addPointOrReplaceWeakestIfCellFull(
+    const PointType& point) {
+  const size_t cell_index = inputToCellIndex(point.u_rows, point.v_cols);
+  size_t& cell_size = cell_sizes_[cell_index];
+  PointType* cell_points = getCellPoints(cell_index);
+
+  if (cell_size < max_points_per_cell_) {
+    new (&cell_points[cell_size]) PointType(point);
+    if (cell_size == 0u || point.weight < cell_weakest_point_weights_[cell_index]) {
+      cell_weakest_point_indices_[cell_index] = cell_size;
+      cell_weakest_point_weights_[cell_index] = point.weight;
+    }
+    ++cell_size;
+    ++current_num_points_;
+    return true;
+  }
+
+  // Replace the point with the lowest weight if the added point has a higher weight.
+  if (cell_weakest_point_weights_[cell_index] < point.weight) {
+    cell_points[cell_weakest_point_indices_[cell_index]] = point;
+    updateWeakestPointOfCell(cell_index);
+    return true;
+  }
+  return false;
+}
+
+template<typename PointType>
+void FixedCapacityOccupancyGrid<PointType>::removePointsFromFullestCellsUntilSize(
+    size_t max_total_num_points) {
+  CHECK_GT(max_total_num_points, 0u);
+  while (current_num_points_ > max_total_num_points) {
+    const size_t fullest_cell_index = static_cast<size_t>(
+        std::max_element(cell_sizes_.begin(), cell_sizes_.end()) - cell_sizes_.begin());
+    size_t& cell_size = cell_sizes_[fullest_cell_index];
+    CHECK_GT(cell_size, 0u);
+
+    // Move the last point of the cell into the slot of the weakest one.
+    PointType* cell_points = getCellPoints(fullest_cell_index);
+    --cell_size;
+    cell_points[cell_weakest_point_indices_[fullest_cell_index]] = cell_points[cell_size];
+    --current_num_points_;
+    updateWeakestPointOfCell(fullest_cell_index);
+  }
+}
+
+template<typename PointType>
+size_t FixedCapacityOccupancyGrid<PointType>::getMemoryUsageBytes() const {
+  return sizeof(*this) + common::getMemoryUsageBytes(point_slots_) +
+      common::getMemoryUsageBytes(cell_sizes_) +
+      common::getMemoryUsageBytes(cell_weakest_point_indices_) +
+      common::getMemoryUsageBytes(cell_weakest_point_weights_);
+}
+
+template<typename PointType>
+size_t FixedCapacityOccupancyGrid<PointType>::getAllPointsInGrid(PointList* points) const {
+  CHECK_NOTNULL(points)->clear();
+  points->reserve(current_num_points_);
+  for (size_t cell_index = 0u; cell_index < cell_sizes_.size(); ++cell_index) {
+    const PointType* cell_points = getCellPoints(cell_index);
+    points->insert(points->end(), cell_points, cell_points + cell_sizes_[cell_index]);
+  }
+  CHECK_EQ(points->size(), current_num_points_);
+  return points->size();
+}
+
+template<typename PointType>
+size_t FixedCapacityOccupancyGrid<PointType>::getNumPointsInCell(
+    CoordinatesType u_rows, CoordinatesType v_cols) const {
+  return cell_sizes_[inputToCellIndex(u_rows, v_cols)];
+}
+
+template<typename PointType>
+const PointType& FixedCapacityOccupancyGrid<PointType>::getPointInCell(
+    CoordinatesType u_rows, CoordinatesType v_cols, size_t point_index) const {
+  const size_t cell_index = inputToCellIndex(u_rows, v_cols);
+  CHECK_LT(point_index, cell_sizes_[cell_index]);
+  return getCellPoints(cell_index)[point_index];
+}
+
+template<typename PointType>
+cv::Mat FixedCapacityOccupancyGrid<PointType>::getOccupancyMask(
+    CoordinatesType radius_mask_around_points) const {
+  CHECK_GT(radius_mask_around_points, static_cast<CoordinatesType>(0.0));
+  cv::Mat mask(static_cast<int>(std::floor(max_input_coordinate_rows_)),
+               static_cast<int>(std::floor(max_input_coordinate_cols_)),
+               CV_8UC1, cv::Scalar(255));
+
+  const int radius_px = static_cast<int>(radius_mask_around_points);
+  const std::vector<int> disk_half_widths = internal::computeDiskHalfWidths(radius_px);
+
+  for (size_t i_row = 0u; i_row < num_grid_rows_; ++i_row) {
+    for (size_t j_col = 0u; j_col < num_grid_cols_; ++j_col) {
+      const size_t cell_index = i_row * num_grid_cols_ + j_col;
+      const PointType* cell_points = getCellPoints(cell_index);
+      for (size_t point_index = 0u; point_index < cell_sizes_[cell_index]; ++point_index) {
+        const PointType& point = cell_points[point_index];
+        internal::stampDisk(static_cast<int>(point.u_rows), static_cast<int>(point.v_cols),
+                            disk_half_widths, &mask);
+      }
+
+      if (cell_sizes_[cell_index] >= max_points_per_cell_) {
+        internal::stampRectangle(
+            static_cast<int>(i_row * cell_size_rows_), static_cast<int>(j_col * cell_size_cols_),
+            static_cast<int>((i_row + 1) * cell_size_rows_ - 1),
+            static_cast<int>((j_col + 1) * cell_size_cols_ - 1), &mask);
+      }
+    }
+  }
+  return mask;
+}
+
+template<typename PointType>
+void FixedCapacityOccupancyGrid<PointType>::updateWeakestPointOfCell(size_t cell_index) {
+  const size_t cell_size = cell_sizes_[cell_index];
+  if (cell_size == 0u) {
+    return;
+  }
+  const PointType* cell_points = getCellPoints(cell_index);
+  size_t weakest_point_index = 0u;
+  for (size_t point_index = 1u; point_index < cell_size; ++point_index) {
+    if (cell_points[point_index].weight < cell_points[weakest_point_index].weight) {
+      weakest_point_index = point_index;
+    }
+  }
+  cell_weakest_point_indices_[cell_index] = weakest_point_index;
+  cell_weakest_point_weights_[cell_index] = cell_points[weakest_point_index].weight;
+}
+
+template<typename PointType>
+inline PointType* FixedCapacityOccupancyGrid<PointType>::getCellPoints(size_t cell_index) {
+  DCHECK_LT(cell_index, cell_sizes_.size());
+  return reinterpret_cast<PointType*>(point_slots_.data() + cell_index * max_points_per_cell_);
+}
+
+template<typename PointType>
+inline const PointType* FixedCapacityOccupancyGrid<PointType>::getCellPoints(
+    size_t cell_index) const {
+  DCHECK_LT(cell_index, cell_sizes_.size());
+  return reinterpret_cast<const PointType*>(
+      point_slots_.data() + cell_index * max_points_per_cell_);
+}
+
+template<typename PointType>
+inline size_t FixedCapacityOccupancyGrid<PointType>::inputToCellIndex(
+    CoordinatesType u_rows, CoordinatesType v_cols) const {
+  CHECK((u_rows >= static_cast<CoordinatesType>(0.0)) &&
+        (v_cols >= static_cast<CoordinatesType>(0.0)) &&
+        (u_rows < max_input_coordinate_rows_) && (v_cols < max_input_coordinate_cols_))
+      << "u_rows: " << u_rows << ", v_cols: " << v_cols;
+  const size_t grid_row = static_cast<size_t>(std::floor(u_rows / cell_size_rows_));
+  const size_t grid_col = static_cast<size_t>(std::floor(v_cols / cell_size_cols_));
+  return grid_row * num_grid_cols_ + grid_col;
+}
+
 }  // namespace common
 }  // namespace aslam
 
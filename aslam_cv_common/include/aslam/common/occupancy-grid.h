@@ -1,9 +1,11 @@
 #ifndef ASLAM_FEATURE_TRACKER_OCCUPANCY_GRID_H_
 #define ASLAM_FEATURE_TRACKER_OCCUPANCY_GRID_H_
 
+#include <type_traits>
 #include <vector>
 
 #include <aslam/common/macros.h>
+#include <aslam/common/memory-usage.h>
 #include <Eigen/Dense>
 #include <glog/logging.h>
 #include <opencv2/core/core.hpp>
@@ -101,6 +103,22 @@ class WeightedOccupancyGrid {
   cv::Mat getOccupancyMask(CoordinatesType radius_mask_around_points,
                            size_t max_points_per_cell) const;
 
+  /// Same as above but writes into the mask, which is only reallocated if it doesn't have the
+  /// size of the grid. Points are drawn with a precomputed disk stamp and points of full cells
+  /// whose disk doesn't leave the cell are skipped.
+  void getOccupancyMask(CoordinatesType radius_mask_around_points, size_t max_points_per_cell,
+                        cv::Mat* mask) const;
+
+  /// Coarse mask with one pixel per cell, 0 for the full cells and 255 otherwise. Lets detectors
+  /// skip full cells instead of filtering the keypoints afterwards.
+  void getCellOccupancyMask(size_t max_points_per_cell, cv::Mat* cell_mask) const;
+
+  size_t getNumGridRows() const { return num_grid_rows_; }
+  size_t getNumGridCols() const { return num_grid_cols_; }
+
+  /// Memory of the grid including the capacity of the cells.
+  size_t getMemoryUsageBytes() const;
+
  private:
   inline PointList& getGridCell(const GridCoordinates& grid_coordinates);
   inline const PointList& getGridCell(const GridCoordinates& grid_coordinates) const;
@@ -144,6 +162,94 @@ class WeightedOccupancyGrid {
   std::vector<std::vector<PointList>> grid_;
 };
 
+/// \class FixedCapacityOccupancyGrid
+/// \brief Occupancy grid with a fixed maximum number of points per cell.
+///
+/// All cells share one contiguous point array that is allocated once at construction, the
+/// cell i holds its points in the slots [i * max_points_per_cell, i * max_points_per_cell +
+/// cell size). Resetting the grid only clears the cell sizes and never frees memory, such that
+/// the grid can be reused for every frame. The weight of the weakest point of every cell is
+/// tracked to reject weaker points without touching the point array.
+template<typename PointType = WeightedKeypoint<double, double, int>>
+class FixedCapacityOccupancyGrid {
+ public:
+  typedef typename PointType::coordinate_type CoordinatesType;
+  typedef typename PointType::weight_type WeightType;
+  typedef typename PointType::id_type PointId;
+
+  typedef PointType Point;
+  typedef std::vector<PointType> PointList;
+
+  static_assert(std::is_trivially_copyable<PointType>::value &&
+                std::is_trivially_destructible<PointType>::value,
+                "The points are stored in uninitialized memory.");
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  ASLAM_POINTER_TYPEDEFS(FixedCapacityOccupancyGrid);
+
+  FixedCapacityOccupancyGrid(CoordinatesType max_input_coordinate_rows,
+                             CoordinatesType max_input_coordinate_cols,
+                             CoordinatesType cell_size_rows,
+                             CoordinatesType cell_size_cols,
+                             size_t max_points_per_cell);
+
+  /// Remove all points, runs in O(number of cells) and keeps the memory.
+  void reset();
+
+  /// Add a point to the grid and replace the weakest point in the same cell if the cell is full
+  /// and this point has a higher score.
+  bool addPointOrReplaceWeakestIfCellFull(const PointType& point);
+
+  /// Remove the weakest point from the fullest cells until the total number of
+  /// points in the grid is met.
+  void removePointsFromFullestCellsUntilSize(size_t max_total_num_points);
+
+  size_t getNumPoints() const { return current_num_points_; }
+  size_t getMaxPointsPerCell() const { return max_points_per_cell_; }
+  size_t getNumCells() const { return cell_sizes_.size(); }
+  /// Memory of the grid, which is allocated at construction.
+  size_t getMemoryUsageBytes() const;
+
+  /// Appends the points cell by cell, every cell is one contiguous block.
+  size_t getAllPointsInGrid(PointList* points) const;
+
+  size_t getNumPointsInCell(CoordinatesType u_rows, CoordinatesType v_cols) const;
+  /// Points of the cell in [0, getNumPointsInCell), in no particular order.
+  const PointType& getPointInCell(
+      CoordinatesType u_rows, CoordinatesType v_cols, size_t point_index) const;
+
+  /// Return a mask that covers a square of specified size around all points and the full
+  /// cells.
+  cv::Mat getOccupancyMask(CoordinatesType radius_mask_around_points) const;
+
+ private:
+  typedef typename std::aligned_storage<sizeof(PointType), alignof(PointType)>::type PointSlot;
+
+  inline size_t inputToCellIndex(CoordinatesType u_rows, CoordinatesType v_cols) const;
+  inline PointType* getCellPoints(size_t cell_index);
+  inline const PointType* getCellPoints(size_t cell_index) const;
+  /// Finds the weakest point of a cell after it was replaced or removed.
+  void updateWeakestPointOfCell(size_t cell_index);
+
+  /// Grid size definitions.
+  const CoordinatesType max_input_coordinate_rows_;
+  const CoordinatesType max_input_coordinate_cols_;
+  const CoordinatesType cell_size_rows_;
+  const CoordinatesType cell_size_cols_;
+  const size_t max_points_per_cell_;
+
+  size_t num_grid_rows_;
+  size_t num_grid_cols_;
+  size_t current_num_points_;
+
+  /// Point slots of all cells, the cells are stored row major.
+  std::vector<PointSlot> point_slots_;
+  std::vector<size_t> cell_sizes_;
+  /// Slot in the cell and weight of the weakest point of every non-empty cell.
+  std::vector<size_t> cell_weakest_point_indices_;
+  std::vector<WeightType> cell_weakest_point_weights_;
+};
+
 }  // namespace common
 }  // namespace aslam
 #include "./occupancy-grid-inl.h"
@@ -0,0 +1,53 @@
+#ifndef ASLAM_COMMON_PARALLEL_FOR_INL_H_
+#define ASLAM_COMMON_PARALLEL_FOR_INL_H_
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace aslam {
+namespace common {
+
+template <typename Function>
+void parallelFor(const IndexRange& range, size_t grain_size, const Function& function) {
+  CHECK_GT(grain_size, 0u);
+  const size_t num_indices = range.size();
+  const size_t num_chunks = (num_indices + grain_size - 1u) / grain_size;
+  if (num_chunks <= 1u) {
+    if (num_indices > 0u) {
+      function(range.begin, range.end);
+    }
+    return;
+  }
+  internal::parallelForChunks(num_chunks, [&](size_t chunk_idx) {
+    const size_t begin = range.begin + chunk_idx * grain_size;
+    function(begin, std::min(begin + grain_size, range.end));
+  });
+}
+
+template <typename ValueType, typename MapFunction, typename ReduceFunction>
+ValueType parallelReduce(const IndexRange& range, size_t grain_size, const ValueType& identity,
+                         const MapFunction& map, const ReduceFunction& reduce) {
+  static_assert(!std::is_same<ValueType, bool>::value,
+                "The chunk values are written concurrently, which std::vector<bool> does not "
+                "support. Reduce an int instead.");
+  CHECK_GT(grain_size, 0u);
+  const size_t num_indices = range.size();
+  const size_t num_chunks = (num_indices + grain_size - 1u) / grain_size;
+  std::vector<ValueType> chunk_values(num_chunks, identity);
+  parallelFor(range, grain_size, [&](size_t begin, size_t end) {
+    chunk_values[(begin - range.begin) / grain_size] = map(begin, end);
+  });
+  ValueType value = identity;
+  for (const ValueType& chunk_value : chunk_values) {
+    value = reduce(value, chunk_value);
+  }
+  return value;
+}
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_PARALLEL_FOR_INL_H_
@@ -0,0 +1,64 @@
+#ifndef ASLAM_COMMON_PARALLEL_FOR_H_
+#define ASLAM_COMMON_PARALLEL_FOR_H_
+
+#include <cstddef>
+#include <functional>
+
+#include <gflags/gflags.h>
+
+#include <aslam/common/thread-pool.h>
+
+DECLARE_int32(acv_parallel_for_num_threads);
+
+namespace aslam {
+namespace common {
+
+/// The half-open index range [begin, end).
+struct IndexRange {
+  IndexRange(size_t _begin, size_t _end) : begin(_begin), end(_end) {}
+  size_t size() const { return (end > begin) ? end - begin : 0u; }
+  size_t begin;
+  size_t end;
+};
+
+/// \brief The process-wide pool running the parallel loops, with
+///        FLAGS_acv_parallel_for_num_threads workers or one less than the number of hardware
+///        threads if 0, as the calling thread takes part in every loop.
+ThreadPool& getParallelForThreadPool();
+
+/// \brief Calls function(begin, end) for consecutive chunks of grain_size indices which cover
+///        the range, in parallel on the calling thread and the shared pool. Returns once all
+///        chunks are done.
+///
+/// The chunks are fixed by the range and the grain size. Every thread starts with a contiguous
+/// block of chunks and steals single chunks from the other blocks once its own block is done.
+/// Ranges of at most one chunk run serially on the calling thread, hence the grain size is
+/// also the threshold below which the loop is not worth distributing. The calling thread never
+/// waits for a helper task that did not start, so loops can be nested and can run from tasks of
+/// the shared pool. The function must be thread-safe across chunks and must not throw.
+/// Example, with a few hundred microseconds of work per chunk:
+///   parallelFor(IndexRange(0u, tracks.size()), 16u, [&](size_t begin, size_t end) {
+///     for (size_t i = begin; i < end; ++i) { triangulate(tracks[i], &landmarks[i]); }
+///   });
+template <typename Function>
+void parallelFor(const IndexRange& range, size_t grain_size, const Function& function);
+
+/// \brief Reduces the chunks of parallelFor: map(begin, end) computes the value of a chunk and
+///        the values are combined with reduce(lhs, rhs) serially in chunk order, starting with
+///        identity. Hence the result is deterministic, for any number of threads and also for
+///        reductions which are not associative in floating point.
+template <typename ValueType, typename MapFunction, typename ReduceFunction>
+ValueType parallelReduce(const IndexRange& range, size_t grain_size, const ValueType& identity,
+                         const MapFunction& map, const ReduceFunction& reduce);
+
+namespace internal {
+/// Runs process_chunk(chunk_idx) for all chunks, see parallelFor.
+void parallelForChunks(size_t num_chunks, const std::function<void(size_t)>& process_chunk);
+}  // namespace internal
+
+}  // namespace common
+}  // namespace aslam
+
+#include "aslam/common/parallel-for-inl.h"
+
+#endif  // ASLAM_COMMON_PARALLEL_FOR_H_
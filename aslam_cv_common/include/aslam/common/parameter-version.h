@@ -0,0 +1,111 @@
+#ifndef ASLAM_COMMON_PARAMETER_VERSION_H_
+#define ASLAM_COMMON_PARAMETER_VERSION_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace aslam {
+
+/// \brief Version of the parameters of a calibration object, e.g. a camera or a rig.
+///
+/// All versions are drawn from one global, monotonically increasing counter. An object takes a
+/// new version whenever its parameters change and copies keep the version of the original,
+/// hence equal versions imply equal parameters, also across objects. Zero is never returned
+/// and can be used as "not built yet".
+typedef uint64_t ParameterVersion;
+
+/// Returns a version larger than all versions returned before. This function is thread-safe.
+ParameterVersion getNextParameterVersion();
+
+/// \class ParameterVersionTracker
+/// \brief The version of the parameters of one object.
+///
+/// Setters call markChanged() after writing. Accessors that hand out a pointer to the parameters
+/// call markPendingWrite() instead: the caller writes after the accessor returned, hence the new
+/// version is only taken by the next get(), otherwise data derived from the old parameters could
+/// be cached under the new version. Writes through the pointer after that get() need another
+/// markChanged(). Copies resolve a pending write of the original first. get() may be called
+/// concurrently, writes to the parameters must not overlap with any call.
+class ParameterVersionTracker {
+ public:
+  ParameterVersionTracker() : version_(getNextParameterVersion()), has_pending_write_(false) {}
+  ParameterVersionTracker(const ParameterVersionTracker& other)
+      : version_(other.get()), has_pending_write_(false) {}
+  void operator=(const ParameterVersionTracker&) = delete;
+
+  ParameterVersion get() const {
+    if (has_pending_write_.exchange(false)) {
+      version_ = getNextParameterVersion();
+    }
+    return version_;
+  }
+
+  /// Takes a new version, the parameters were written.
+  void markChanged() {
+    has_pending_write_ = false;
+    version_ = getNextParameterVersion();
+  }
+
+  /// The parameters are about to be written, the next get() takes a new version.
+  void markPendingWrite() { has_pending_write_ = true; }
+
+ private:
+  mutable std::atomic<ParameterVersion> version_;
+  mutable std::atomic<bool> has_pending_write_;
+};
+
+/// \class DerivedCache
+/// \brief Holds data derived from versioned parameters, e.g. the lookup tables or frustums of a
+///        camera, and rebuilds it only if the parameters changed.
+///
+/// The value is an immutable snapshot: callers keep using their shared pointer while the cache
+/// is rebuilt for a newer version. The methods are thread-safe and the value is built under the
+/// lock, so concurrent queries for the same version build it once. Owners in const contexts
+/// store the cache as a mutable member.
+template <typename ValueType>
+class DerivedCache {
+ public:
+  DerivedCache() : version_(0u) {}
+  /// Copies start empty, the value is rebuilt on demand for the copied parameters.
+  DerivedCache(const DerivedCache&) : DerivedCache() {}
+  void operator=(const DerivedCache&) = delete;
+
+  /// \brief Returns the value for the parameter version, calls builder() to rebuild it if the
+  ///        cache is empty or was built for another version.
+  /// @param[in] version The current version of the parameters the value is derived from.
+  /// @param[in] builder Callable returning a std::shared_ptr<const ValueType>.
+  template <typename BuilderType>
+  std::shared_ptr<const ValueType> get(ParameterVersion version, const BuilderType& builder) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!value_ || version_ != version) {
+      value_ = builder();
+      version_ = version;
+    }
+    return value_;
+  }
+
+  /// Returns the value if it was built for the version, nullptr otherwise.
+  std::shared_ptr<const ValueType> getIfCurrent(ParameterVersion version) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return version_ == version ? value_ : std::shared_ptr<const ValueType>();
+  }
+
+  /// Drops the value.
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    value_.reset();
+    version_ = 0u;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::shared_ptr<const ValueType> value_;
+  /// The parameter version value_ was built for.
+  ParameterVersion version_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_PARAMETER_VERSION_H_
@@ -0,0 +1,48 @@
+#ifndef ASLAM_COMMON_POSE_BATCH_H_
+#define ASLAM_COMMON_POSE_BATCH_H_
+
+#include <Eigen/Core>
+
+#include <aslam/common/pose-types.h>
+
+namespace aslam {
+
+/// \brief Batch rigid-body transformations of 3D points.
+///
+/// The rotation is converted to a matrix once per batch and applied to the points with explicit
+/// SIMD: Blocks of points are loaded at once, transposed to one register per coordinate and
+/// transposed back on store (SSE2 for double and float, NEON for float). The remainder of a batch
+/// and other architectures use a scalar loop. The output may alias the input, i.e. the points can
+/// be transformed in place.
+///
+/// The float versions convert the rotation and the translation to float once, the points are
+/// transformed in single precision.
+
+/// A_points = R_A_B * B_points.
+void rotatePoints(const Eigen::Matrix3d& R_A_B, const Eigen::Matrix3Xd& B_points,
+                  Eigen::Matrix3Xd* A_points);
+void rotatePoints(const Quaternion& q_A_B, const Eigen::Matrix3Xd& B_points,
+                  Eigen::Matrix3Xd* A_points);
+void rotatePoints(const Eigen::Matrix3f& R_A_B, const Eigen::Matrix3Xf& B_points,
+                  Eigen::Matrix3Xf* A_points);
+void rotatePoints(const Quaternion& q_A_B, const Eigen::Matrix3Xf& B_points,
+                  Eigen::Matrix3Xf* A_points);
+
+/// A_points = T_A_B * B_points.
+void transformPoints(const Transformation& T_A_B, const Eigen::Matrix3Xd& B_points,
+                     Eigen::Matrix3Xd* A_points);
+void transformPoints(const Transformation& T_A_B, const Eigen::Matrix3Xf& B_points,
+                     Eigen::Matrix3Xf* A_points);
+
+namespace internal {
+/// \brief The kernels of the batch functions on column-major 3 x num_points buffers,
+///        A_points = R_A_B * B_points + A_t_A_B. The buffers may alias.
+void transformPointsKernel(const Eigen::Matrix3d& R_A_B, const Eigen::Vector3d& A_t_A_B,
+                           const double* B_points, int num_points, double* A_points);
+void transformPointsKernel(const Eigen::Matrix3f& R_A_B, const Eigen::Vector3f& A_t_A_B,
+                           const float* B_points, int num_points, float* A_points);
+}  // namespace internal
+
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_POSE_BATCH_H_
@@ -14,7 +14,7 @@ class ReaderWriterMutex {
   virtual ~ReaderWriterMutex();
 
   virtual void acquireReadLock();
-  void releaseReadLock();
+  virtual void releaseReadLock();
 
   virtual void acquireWriteLock();
   virtual void releaseWriteLock();
@@ -24,7 +24,7 @@ class ReaderWriterMutex {
 
   // Returns true if there are any active readers, writers, or threads that are waiting for read or
   // write access.
-  bool isInUse();
+  virtual bool isInUse();
 
  protected:
   ReaderWriterMutex(const ReaderWriterMutex&) = delete;
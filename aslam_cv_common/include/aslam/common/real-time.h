@@ -0,0 +1,74 @@
+#ifndef ASLAM_COMMON_REAL_TIME_H_
+#define ASLAM_COMMON_REAL_TIME_H_
+
+#include <cstddef>
+
+#include <gflags/gflags.h>
+
+#include <aslam/common/allocation-counter.h>
+#include <aslam/common/macros.h>
+
+DECLARE_bool(acv_abort_on_steady_state_allocation);
+
+namespace aslam {
+namespace common {
+
+/// \brief Lock all current and future pages of the process in RAM, such that they are never
+///        paged out. Needs CAP_IPC_LOCK or a sufficient RLIMIT_MEMLOCK.
+/// @return False if locking is not supported on this platform or failed.
+bool lockAllMemory();
+
+/// \brief Keep the memory freed by the process in its heap instead of returning it to the
+///        system, and serve large allocations from the heap as well. Memory that was allocated
+///        and pre-faulted once then stays resident and is reused by later allocations.
+/// @return False if this is not supported by the allocator of this platform.
+bool retainFreedHeapMemory();
+
+/// \brief Touch every page of the buffer, such that the page faults happen now instead of on
+///        the first access in the real-time loop. The content of the buffer is preserved.
+void prefaultMemory(void* data, size_t num_bytes);
+
+/// \brief Touch num_bytes of stack below the calling function, such that the stack of the
+///        calling thread does not fault later. Best combined with lockAllMemory().
+void prefaultStack(size_t num_bytes);
+
+/// \class SteadyStateScope
+/// \brief Marks the calling thread as being in the steady state of a real-time loop, in which
+///        heap allocations are considered a bug.
+///
+/// Heap allocations are only observed if the executable links the
+/// aslam_cv_common_allocation_hooks library, which replaces the global operator new. Every
+/// allocation made by a thread within a scope is counted and aborts if
+/// FLAGS_acv_abort_on_steady_state_allocation is set, which is the default for debug builds.
+/// Scopes can be nested and a disabled scope has no effect. Example:
+///   while (running) {
+///     aslam::common::SteadyStateScope steady_state;
+///     tracker.track(...);
+///   }
+class SteadyStateScope {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(SteadyStateScope);
+  explicit SteadyStateScope(bool is_enabled = true);
+  ~SteadyStateScope();
+
+  /// Is the calling thread within an enabled steady state scope.
+  static bool isActive();
+
+ private:
+  const bool is_enabled_;
+};
+
+/// Number of heap allocations within steady state scopes since the start or the last reset,
+/// summed over all threads.
+size_t getNumSteadyStateAllocations();
+void resetNumSteadyStateAllocations();
+
+namespace internal {
+/// Counts or aborts on a heap allocation of the calling thread in a steady state scope.
+void checkSteadyStateAllocation(size_t num_bytes);
+}  // namespace internal
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_REAL_TIME_H_
@@ -0,0 +1,58 @@
+#ifndef ASLAM_COMMON_SCALABLE_READER_WRITER_LOCK_H_
+#define ASLAM_COMMON_SCALABLE_READER_WRITER_LOCK_H_
+
+#include <atomic>
+
+#include "aslam/common/reader-writer-lock.h"
+
+namespace aslam {
+
+// A writer-preferring reader writer mutex for data that is read by many threads and rarely
+// written, e.g. maps or calibrations.
+//
+// Readers count themselves in one of several counters on separate cache lines, picked per
+// thread, and only check a flag announcing writers. Hence, uncontended read locks never take the
+// mutex and readers on different cores don't share cache lines. Writers announce themselves,
+// which sends new readers to wait on the mutex, and then wait for the counters to drain.
+//
+// Upgrades behave as in ReaderWriterMutex, except that an upgrade also fails if another writer
+// already owns the lock and waits for the readers.
+class ScalableReaderWriterMutex : public ReaderWriterMutex {
+ public:
+  ScalableReaderWriterMutex();
+  ~ScalableReaderWriterMutex();
+
+  virtual void acquireReadLock() override;
+  virtual void releaseReadLock() override;
+
+  virtual void acquireWriteLock() override;
+  virtual void releaseWriteLock() override;
+
+  virtual bool upgradeToWriteLock() override;
+
+  virtual bool isInUse() override;
+
+ private:
+  static constexpr size_t kNumReaderCounters = 16u;
+  static constexpr size_t kCacheLineSize = 64u;
+
+  struct ReaderCounter {
+    std::atomic<int> num_readers;
+    char padding[kCacheLineSize - sizeof(std::atomic<int>)];
+  };
+
+  std::atomic<int>& getThreadReaderCounter();
+  int getNumReaders() const;
+  // Requires mutex_ to be held.
+  void updateWritersAnnounced();
+  // Requires mutex_ to be held. Waits until num_readers readers are left.
+  void waitForReaders(std::unique_lock<std::mutex>* lock, int num_readers);
+
+  ReaderCounter reader_counters_[kNumReaderCounters];
+  // Set while a writer owns or waits for the lock, or an upgrade is pending.
+  std::atomic<bool> writers_announced_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_SCALABLE_READER_WRITER_LOCK_H_
@@ -0,0 +1,84 @@
+#ifndef ASLAM_COMMON_SPSC_QUEUE_H_
+#define ASLAM_COMMON_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <glog/logging.h>
+
+namespace aslam {
+namespace common {
+
+/// \class SpscQueue
+/// \brief A bounded lock-free FIFO queue for one producer and one consumer thread.
+///
+/// Several producers are allowed if they are serialized externally, e.g. by a mutex held while
+/// pushing. The same holds for the consumers.
+template <typename ValueType>
+class SpscQueue {
+ public:
+  ASLAM_POINTER_TYPEDEFS(SpscQueue);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(SpscQueue);
+
+  /// @param[in] capacity The maximum number of elements in the queue.
+  explicit SpscQueue(size_t capacity) : slots_(capacity + 1u), head_(0u), tail_(0u) {
+    CHECK_GT(capacity, 0u);
+  }
+
+  /// Append a value, returns false and leaves the value untouched if the queue is full.
+  bool tryPush(ValueType&& value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next_tail = increment(tail);
+    if (next_tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots_[tail] = std::move(value);
+    tail_.store(next_tail, std::memory_order_release);
+    return true;
+  }
+
+  /// Take the oldest value, returns false if the queue is empty.
+  bool tryPop(ValueType* value) {
+    CHECK_NOTNULL(value);
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *value = std::move(slots_[head]);
+    // Don't keep the moved-from value alive in the slot.
+    slots_[head] = ValueType();
+    head_.store(increment(head), std::memory_order_release);
+    return true;
+  }
+
+  /// Number of queued values. Only a snapshot if called concurrently with push or pop.
+  size_t size() const {
+    const size_t head = head_.load(std::memory_order_acquire);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    return (tail >= head) ? (tail - head) : (tail + slots_.size() - head);
+  }
+
+  bool empty() const { return size() == 0u; }
+
+  size_t capacity() const { return slots_.size() - 1u; }
+
+ private:
+  size_t increment(size_t index) const {
+    return (index + 1u == slots_.size()) ? 0u : index + 1u;
+  }
+
+  // One slot stays empty to distinguish a full from an empty queue.
+  std::vector<ValueType> slots_;
+  // Keep the indices of the consumer and producer on separate cache lines.
+  char padding_0_[64];
+  std::atomic<size_t> head_;
+  char padding_1_[64];
+  std::atomic<size_t> tail_;
+};
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_SPSC_QUEUE_H_
@@ -0,0 +1,86 @@
+#ifndef ASLAM_STATISTICS_HISTOGRAM_H_
+#define ASLAM_STATISTICS_HISTOGRAM_H_
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <ostream>  // NOLINT
+#include <string>
+
+namespace statistics {
+
+// A histogram with logarithmic buckets in the style of HdrHistogram.
+//
+// Values are counted in integer multiples of the resolution. Values below
+// kNumSubBuckets units have a bucket each, above that every power of two is
+// split into kNumSubBuckets / 2 buckets, such that quantiles have a relative
+// error below 1 / kNumSubBuckets over the whole 64bit range. Recording is
+// lock-free and can be called from any number of threads, histograms of the
+// same resolution can be merged.
+class LogHistogram {
+ public:
+  static constexpr int kNumSubBucketBits = 7;
+  static constexpr size_t kNumSubBuckets = 1u << kNumSubBucketBits;
+  static constexpr size_t kNumBuckets =
+      (64u - kNumSubBucketBits + 2u) * (kNumSubBuckets / 2u);
+
+  // The resolution is the smallest value that can be told apart from zero,
+  // e.g. 1e-9 to record seconds with nanosecond resolution.
+  explicit LogHistogram(double resolution = 1.0);
+  LogHistogram(const LogHistogram& other);
+  LogHistogram& operator=(const LogHistogram& other);
+
+  // Negative values are counted as zero.
+  void Record(double value);
+  void Merge(const LogHistogram& other);
+  void Reset();
+
+  double GetResolution() const {
+    return resolution_;
+  }
+  uint64_t GetCount() const;
+  double GetSum() const;
+  double GetMean() const;
+  double GetMin() const;
+  double GetMax() const;
+  // Smallest value that is larger than or equal to the given fraction of the
+  // recorded values, e.g. 0.99 for the 99th percentile. Returns 0 if the
+  // histogram is empty.
+  double GetPercentile(double fraction) const;
+
+  static size_t GetBucketIndex(uint64_t units);
+  // Smallest and largest number of units counted in the bucket.
+  static uint64_t GetBucketLowerBound(size_t bucket_index);
+  static uint64_t GetBucketUpperBound(size_t bucket_index);
+
+ private:
+  uint64_t ToUnits(double value) const;
+
+  double resolution_;
+  std::atomic<uint64_t> counts_[kNumBuckets];
+  std::atomic<uint64_t> total_count_;
+  std::atomic<uint64_t> sum_units_;
+  std::atomic<uint64_t> min_units_;
+  std::atomic<uint64_t> max_units_;
+};
+
+typedef std::map<std::string, LogHistogram> HistogramMap;
+
+// The percentiles written by the exporters.
+extern const double kExportedPercentiles[4];
+
+// Writes the histograms as a Prometheus summary, one series per tag, e.g.
+//   metric_name{tag="a",quantile="0.99"} 0.0042
+//   metric_name_sum{tag="a"} 1.3
+//   metric_name_count{tag="a"} 412
+void WritePrometheusSummary(const std::string& metric_name,
+                            const HistogramMap& histograms,
+                            std::ostream& out);  // NOLINT
+
+// Writes the histograms as a JSON object with one entry per tag, holding the
+// count, sum, mean, min, max and the exported percentiles.
+void WriteJson(const HistogramMap& histograms, std::ostream& out);  // NOLINT
+
+}  // namespace statistics
+
+#endif  // ASLAM_STATISTICS_HISTOGRAM_H_
@@ -1,13 +1,18 @@
 #ifndef ASLAM_STATISTICS_H_
 #define ASLAM_STATISTICS_H_
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
 
 #include "aslam/common/statistics/accumulator.h"
+#include "aslam/common/statistics/histogram.h"
 
 ///
 // Example usage:
@@ -34,14 +39,19 @@ struct StatisticsMapValue {
   }
 
   inline void AddValue(double sample) {
-    std::chrono::time_point<std::chrono::system_clock> now =
-        std::chrono::system_clock::now();
-    double dt = static_cast<double>(
-                    std::chrono::duration_cast<std::chrono::nanoseconds>(
-                        now - time_last_called_)
-                        .count()) *
-                kNumSecondsPerNanosecond;
-    time_last_called_ = now;
+    AddValue(sample, std::chrono::system_clock::now());
+  }
+  inline void AddValue(
+      double sample, const std::chrono::time_point<std::chrono::system_clock>& time) {
+    // Samples of different threads are merged in batches, a sample can be older than the
+    // previously merged one.
+    double dt = std::max(
+        static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                time - time_last_called_)
+                                .count()) *
+            kNumSecondsPerNanosecond,
+        0.0);
+    time_last_called_ = std::max(time_last_called_, time);
 
     values_.Add(sample);
     time_deltas_.Add(dt);
@@ -141,9 +151,67 @@ class StatsCollectorImpl {
   size_t handle_;
 };
 
-class Statistics {
+// The values of a set of tags, used by the Statistics and the Timing singletons.
+//
+// Samples are appended to a buffer of the calling thread and merged into the
+// values whenever the buffer is full and before values are read, threads adding
+// samples never contend on a shared lock. Every thread caches the handles of
+// the tags it used, only the first lookup of a tag in a thread locks the store.
+// The store has to outlive all threads that add samples to it. Optionally, the
+// distribution of the samples of every tag is kept in a LogHistogram.
+class SampleStore {
  public:
   typedef std::map<std::string, size_t> map_t;
+  // Number of buffered samples of a thread that triggers a merge.
+  static constexpr size_t kMaxNumBufferedSamples = 256u;
+
+  // Keeps histograms of the given resolution if it is positive.
+  explicit SampleStore(double histogram_resolution = 0.0);
+  ~SampleStore();
+
+  size_t GetHandle(std::string const& tag);
+  bool HasHandle(std::string const& tag) const;
+  std::string GetTag(size_t handle) const;
+  void AddSample(size_t handle, double sample);
+  // Merges the buffered samples of all threads and returns the values of the
+  // handle.
+  StatisticsMapValue GetValue(size_t handle);
+  // Requires histograms, merges the buffered samples like GetValue.
+  LogHistogram GetHistogram(size_t handle);
+  HistogramMap GetHistograms();
+  map_t GetTagMap() const;
+  size_t GetMaxTagLength() const;
+  // Removes all tags, handles obtained before are no longer printed.
+  void Reset();
+
+ private:
+  struct Sample;
+  struct ThreadBuffer;
+  struct ThreadState;
+  struct ThreadStates;
+
+  ThreadState& GetThreadState();
+  // Both require the lock of the store.
+  void MergeSamples(std::vector<Sample>* samples);
+  void MergeThreadBuffers();
+  void RemoveThreadBuffer(const std::shared_ptr<ThreadBuffer>& thread_buffer);
+
+  const size_t store_index_;
+  const double histogram_resolution_;
+  mutable std::mutex mutex_;
+  std::vector<statistics::StatisticsMapValue> values_;
+  // Empty if the store doesn't keep histograms, one per value otherwise.
+  std::vector<std::unique_ptr<LogHistogram>> histograms_;
+  map_t tag_map_;
+  size_t max_tag_length_;
+  std::vector<std::shared_ptr<ThreadBuffer>> thread_buffers_;
+  // Incremented by Reset() to invalidate the handles cached by the threads.
+  std::atomic<uint64_t> generation_;
+};
+
+class Statistics {
+ public:
+  typedef SampleStore::map_t map_t;
   friend class StatsCollectorImpl;
   // Definition of static functions to query the stats.
   static size_t GetHandle(std::string const& tag);
@@ -182,8 +250,8 @@ class Statistics {
   static std::string Print();
   static std::string SecondsToTimeString(double seconds);
   static void Reset();
-  static const map_t& GetStatsCollectors() {
-    return Instance().tag_map_;
+  static map_t GetStatsCollectors() {
+    return Instance().store_.GetTagMap();
   }
 
  private:
@@ -194,12 +262,7 @@ class Statistics {
   Statistics();
   ~Statistics();
 
-  typedef std::vector<statistics::StatisticsMapValue> list_t;
-
-  list_t stats_collectors_;
-  map_t tag_map_;
-  size_t max_tag_length_;
-  std::mutex mutex_;
+  SampleStore store_;
 };
 
 #if ENABLE_STATISTICS
@@ -2,6 +2,10 @@
 #define ASLAM_COMMON_STL_HELPERS_INL_H_
 
 #include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace aslam {
 namespace common {
@@ -108,63 +112,223 @@ size_t dynamicSize(
   return matrix.matrix->rows();
 }
 
+template <typename ScalarType, int Rows>
+void moveElement(
+    const int source, const int destination,
+    Eigen::Matrix<ScalarType, Rows, Eigen::Dynamic>* matrix) {
+  matrix->col(destination) = matrix->col(source);
+}
+template <typename ScalarType, int Cols>
+void moveElement(
+    const int source, const int destination,
+    Eigen::Matrix<ScalarType, Eigen::Dynamic, Cols>* matrix) {
+  matrix->row(destination) = matrix->row(source);
+}
+template <typename ScalarType>
+void moveElement(
+    const int source, const int destination,
+    OneDimensionAdapter<ScalarType, kColumns>* matrix) {
+  matrix->matrix->col(destination) = matrix->matrix->col(source);
+}
+template <typename ScalarType>
+void moveElement(
+    const int source, const int destination,
+    OneDimensionAdapter<ScalarType, kRows>* matrix) {
+  matrix->matrix->row(destination) = matrix->matrix->row(source);
+}
+template <typename ElementType, typename Allocator>
+void moveElement(
+    const int source, const int destination,
+    std::vector<ElementType, Allocator>* vector) {
+  (*vector)[destination] = std::move((*vector)[source]);
+}
+
+// Moves the elements [source, source + size) to [destination, destination + size), with
+// destination <= source. The ranges may overlap. Contiguous blocks of trivially copyable
+// elements are moved with a single memmove.
+template <typename ScalarType>
+void moveContiguousBlock(
+    const int source, const int destination, const int size, const int element_size,
+    ScalarType* data) {
+  static_assert(std::is_trivially_copyable<ScalarType>::value,
+                "Only trivially copyable scalars can be moved with memmove.");
+  DCHECK_LE(destination, source);
+  if (size > 0 && source != destination) {
+    std::memmove(data + static_cast<size_t>(destination) * element_size,
+                 data + static_cast<size_t>(source) * element_size,
+                 static_cast<size_t>(size) * element_size * sizeof(ScalarType));
+  }
+}
+template <typename ScalarType, int Rows>
+void moveBlock(
+    const int source, const int destination, const int size,
+    Eigen::Matrix<ScalarType, Rows, Eigen::Dynamic>* matrix) {
+  // The columns are contiguous, also for row vectors.
+  moveContiguousBlock(source, destination, size, static_cast<int>(matrix->rows()),
+                      matrix->data());
+}
+template <typename ScalarType, int Cols>
+void moveBlock(
+    const int source, const int destination, const int size,
+    Eigen::Matrix<ScalarType, Eigen::Dynamic, Cols>* matrix) {
+  if (Cols == 1) {
+    moveContiguousBlock(source, destination, size, 1, matrix->data());
+    return;
+  }
+  for (int i = 0; i < size; ++i) {
+    moveElement(source + i, destination + i, matrix);
+  }
+}
+template <typename ScalarType>
+void moveBlock(
+    const int source, const int destination, const int size,
+    OneDimensionAdapter<ScalarType, kColumns>* matrix) {
+  moveContiguousBlock(source, destination, size, static_cast<int>(matrix->matrix->rows()),
+                      matrix->matrix->data());
+}
+template <typename ScalarType>
+void moveBlock(
+    const int source, const int destination, const int size,
+    OneDimensionAdapter<ScalarType, kRows>* matrix) {
+  for (int i = 0; i < size; ++i) {
+    moveElement(source + i, destination + i, matrix);
+  }
+}
+template <typename ElementType, typename Allocator>
+void moveVectorBlock(
+    const int source, const int destination, const int size,
+    std::true_type /*is_trivially_copyable*/, std::vector<ElementType, Allocator>* vector) {
+  moveContiguousBlock(source, destination, size, 1, vector->data());
+}
+template <typename ElementType, typename Allocator>
+void moveVectorBlock(
+    const int source, const int destination, const int size,
+    std::false_type /*is_trivially_copyable*/, std::vector<ElementType, Allocator>* vector) {
+  std::move(vector->begin() + source, vector->begin() + source + size,
+            vector->begin() + destination);
+}
+template <typename ElementType, typename Allocator>
+void moveBlock(
+    const int source, const int destination, const int size,
+    std::vector<ElementType, Allocator>* vector) {
+  moveVectorBlock(
+      source, destination, size,
+      std::integral_constant<bool, std::is_trivially_copyable<ElementType>::value>(), vector);
+}
+
+template <typename ScalarType, int Rows>
+void shrinkDynamicDimension(
+    const int new_size, Eigen::Matrix<ScalarType, Rows, Eigen::Dynamic>* matrix) {
+  matrix->conservativeResize(Eigen::NoChange, new_size);
+}
+template <typename ScalarType, int Cols>
+void shrinkDynamicDimension(
+    const int new_size, Eigen::Matrix<ScalarType, Eigen::Dynamic, Cols>* matrix) {
+  matrix->conservativeResize(new_size, Eigen::NoChange);
+}
+template <typename ScalarType>
+void shrinkDynamicDimension(
+    const int new_size, OneDimensionAdapter<ScalarType, kColumns>* matrix) {
+  matrix->matrix->conservativeResize(Eigen::NoChange, new_size);
+}
+template <typename ScalarType>
+void shrinkDynamicDimension(
+    const int new_size, OneDimensionAdapter<ScalarType, kRows>* matrix) {
+  matrix->matrix->conservativeResize(new_size, Eigen::NoChange);
+}
+template <typename ElementType, typename Allocator>
+void shrinkDynamicDimension(
+    const int new_size, std::vector<ElementType, Allocator>* vector) {
+  // erase() of the tail keeps the capacity, resize() would require a default constructor.
+  vector->erase(vector->begin() + new_size, vector->end());
+}
+
+template <typename ElementType, typename Allocator>
+size_t dynamicSize(const std::vector<ElementType, Allocator>& vector) {
+  return vector.size();
+}
+
 }  // namespace internal
 
 template <typename ContainerType>
-void eraseIndicesFromContainer(
+void eraseIndicesInPlace(
     const std::vector<size_t>& ordered_indices_to_erase,
     const size_t expected_initial_count,
     ContainerType* container) {
   CHECK_NOTNULL(container);
   CHECK_EQ(internal::dynamicSize(*container), expected_initial_count);
-  CHECK_LT(ordered_indices_to_erase.back(), expected_initial_count);
-
   if (ordered_indices_to_erase.empty()) {
     return;
   }
+  CHECK_LT(ordered_indices_to_erase.back(), expected_initial_count);
 
-  const size_t erase_count = ordered_indices_to_erase.size();
-  CHECK_LE(erase_count, expected_initial_count);
-
-  LOG_IF(WARNING, erase_count == expected_initial_count)
-  << "All items will be removed!";
-
-  const size_t remaining_count = expected_initial_count - erase_count;
-  ContainerType result;
-  internal::resizeDynamicDimensionLike(remaining_count, *container, &result);
-
-  int result_fill_index = 0;
-  int container_block_start = 0;
+  // The blocks between the erased indices are moved down in one pass.
+  size_t destination = ordered_indices_to_erase.front();
   for (size_t i = 0u; i < ordered_indices_to_erase.size(); ++i) {
-    CHECK_GE(ordered_indices_to_erase[i], container_block_start);
-    const int block_size = ordered_indices_to_erase[i] - container_block_start;
-
-    internal::copyMiddle(container_block_start, result_fill_index, block_size,
-                         container, &result);
-
-    result_fill_index += block_size;
-    container_block_start = ordered_indices_to_erase[i] + 1;
+    const size_t block_begin = ordered_indices_to_erase[i] + 1u;
+    const size_t block_end = i + 1u < ordered_indices_to_erase.size() ?
+        ordered_indices_to_erase[i + 1u] : expected_initial_count;
+    CHECK_LE(block_begin, block_end) << "The indices must be strictly increasing.";
+    const size_t block_size = block_end - block_begin;
+    internal::moveBlock(static_cast<int>(block_begin), static_cast<int>(destination),
+                        static_cast<int>(block_size), container);
+    destination += block_size;
   }
-  const int last_block_size = expected_initial_count - container_block_start;
-  internal::copyMiddle(container_block_start, result_fill_index,
-                       last_block_size, container, &result);
-
-  container->swap(result);
+  CHECK_EQ(destination, expected_initial_count - ordered_indices_to_erase.size());
+  internal::shrinkDynamicDimension(static_cast<int>(destination), container);
 }
 
-template<typename ElementType, typename Allocator>
+template <typename ContainerType>
 void eraseIndicesFromContainer(
     const std::vector<size_t>& ordered_indices_to_erase,
     const size_t expected_initial_count,
-    std::vector<ElementType, Allocator>* container) {
+    ContainerType* container) {
+  CHECK_NOTNULL(container);
+  LOG_IF(WARNING, !ordered_indices_to_erase.empty() &&
+         ordered_indices_to_erase.size() == expected_initial_count)
+      << "All items will be removed!";
+  eraseIndicesInPlace(ordered_indices_to_erase, expected_initial_count, container);
+}
+
+template <typename KeepMask, typename ContainerType>
+size_t compactInPlace(
+    const KeepMask& keep_mask, const size_t expected_initial_count,
+    ContainerType* container) {
   CHECK_NOTNULL(container);
-  CHECK_EQ(expected_initial_count, container->size());
-  std::vector<ElementType, Allocator> result =
-      eraseIndicesFromVector(*container, ordered_indices_to_erase);
-  container->swap(result);
+  CHECK_EQ(internal::dynamicSize(*container), expected_initial_count);
+  // Runs of kept elements are moved as blocks.
+  size_t num_kept = 0u;
+  size_t i = 0u;
+  while (i < expected_initial_count) {
+    if (!keep_mask[i]) {
+      ++i;
+      continue;
+    }
+    const size_t run_begin = i;
+    while (i < expected_initial_count && keep_mask[i]) {
+      ++i;
+    }
+    const size_t run_size = i - run_begin;
+    internal::moveBlock(static_cast<int>(run_begin), static_cast<int>(num_kept),
+                        static_cast<int>(run_size), container);
+    num_kept += run_size;
+  }
+  if (num_kept != expected_initial_count) {
+    internal::shrinkDynamicDimension(static_cast<int>(num_kept), container);
+  }
+  return num_kept;
 }
 
 }  // namespace stl_helpers
+
+template <typename ElementType, typename Allocator>
+void eraseIndicesFromVectorInPlace(
+    const std::vector<size_t>& ordered_indices_to_erase,
+    std::vector<ElementType, Allocator>* data) {
+  CHECK_NOTNULL(data);
+  stl_helpers::eraseIndicesInPlace(ordered_indices_to_erase, data->size(), data);
+}
+
 }  // namespace common
 }  // namespace aslam
 
@@ -212,6 +212,14 @@ inline std::vector<ElementType, Allocator> eraseIndicesFromVector(
   return reduced_vector;
 }
 
+// In-place variant of eraseIndicesFromVector() for strictly increasing indices: the blocks
+// between the erased elements are moved down in a single pass, with memmove for trivially
+// copyable elements. The capacity of the vector is kept.
+template<typename ElementType, typename Allocator>
+void eraseIndicesFromVectorInPlace(
+    const std::vector<size_t>& ordered_indices_to_erase,
+    std::vector<ElementType, Allocator>* data);
+
 namespace stl_helpers {
 
 constexpr int kColumns = 0;
@@ -240,12 +248,33 @@ struct OneDimensionAdapter {
   }
 };
 
-// Different implementations are available in the inline header.
+// Stable in-place erasure of the strictly increasing indices from a std::vector, an Eigen
+// matrix with one dynamic dimension or a OneDimensionAdapter, in a single pass. Contiguous
+// blocks, e.g. the columns of a Matrix2Xd or of the descriptors, and blocks of trivially
+// copyable vector elements are moved with memmove. std::vectors keep their capacity, Eigen
+// matrices are shrunk with conservativeResize.
+template <typename ContainerType>
+void eraseIndicesInPlace(
+    const std::vector<size_t>& ordered_indices_to_erase,
+    const size_t expected_initial_count, ContainerType* container);
+
+// Same as eraseIndicesInPlace(), warns if all elements are erased.
 template <typename ContainerType>
 void eraseIndicesFromContainer(
     const std::vector<size_t>& ordered_indices_to_erase,
     const size_t expected_initial_count, ContainerType* container);
 
+// Stable in-place compaction: keeps the elements i for which keep_mask[i] is true, in their
+// order, and returns the number of kept elements. KeepMask can be any type with a bool
+// operator[](size_t), e.g. std::vector<bool>. Runs of kept elements are moved as blocks like in
+// eraseIndicesInPlace(). Neither a temporary copy of the container nor a new buffer is
+// allocated: std::vectors keep their capacity, Eigen matrices are shrunk with
+// conservativeResize, which reallocates the buffer in place.
+template <typename KeepMask, typename ContainerType>
+size_t compactInPlace(
+    const KeepMask& keep_mask, const size_t expected_initial_count,
+    ContainerType* container);
+
 }  // namespace stl_helpers
 }  // namespace common
 }  // namespace aslam
@@ -0,0 +1,115 @@
+#ifndef ASLAM_COMMON_TASK_GRAPH_H_
+#define ASLAM_COMMON_TASK_GRAPH_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/thread-pool.h>
+
+namespace aslam {
+
+/// \class TaskGraph
+/// \brief A directed acyclic graph of tasks which runs on a ThreadPool.
+///
+/// A node is enqueued as soon as all of its dependencies have finished, by the worker that
+/// finished the last of them. Hence no worker blocks on a future of a previous stage and the
+/// successors of a node preferably run on the same worker, see ThreadPool. The graph is built
+/// once and run many times, e.g. once per NFrame: the stages undistort, detect, describe,
+/// track, match and RANSAC form one chain of nodes per camera and the rig-level stages depend
+/// on the last node of every chain. Per-run inputs and outputs are passed through state
+/// captured by the tasks.
+///
+/// A run can be cancelled: nodes which have not started yet are skipped, running nodes finish.
+/// Long running tasks can poll isCancelled() to exit early.
+class TaskGraph {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(TaskGraph);
+  typedef size_t NodeId;
+  typedef std::function<void()> Task;
+  /// Called once per run after the last node, with false if the run was cancelled.
+  typedef std::function<void(bool)> CompletionCallback;
+
+  explicit TaskGraph(ThreadPool* thread_pool);
+  /// Waits for a running run.
+  ~TaskGraph();
+
+  /// \brief Adds a node. The graph must not be running.
+  /// @param[in] task         The work of the node. A task which throws cancels the run.
+  /// @param[in] dependencies The nodes that have to finish before this one starts.
+  /// @return The id of the node, the ids are consecutive starting at zero.
+  NodeId addNode(const Task& task, const std::vector<NodeId>& dependencies);
+  NodeId addNode(const Task& task) { return addNode(task, std::vector<NodeId>()); }
+
+  /// Lets node run after dependency. The graph must not be running.
+  void addDependency(NodeId node, NodeId dependency);
+
+  /// \brief Starts a run and returns immediately. The graph must not be running.
+  /// @param[in] completion_callback Optional, called by the worker which finished the last
+  ///                                node, e.g. to start the run of the next frame.
+  void start(const CompletionCallback& completion_callback);
+  void start() { start(CompletionCallback()); }
+
+  /// \brief Blocks until the current run, if any, has finished. Must not be called from a task
+  ///        of the thread pool, use a completion callback or a dependency instead.
+  /// @return False if the last run was cancelled.
+  bool wait();
+
+  /// Runs the graph and blocks until it has finished, see start and wait.
+  bool run() {
+    start();
+    return wait();
+  }
+
+  /// Skips all nodes of the current run which have not started yet. Thread-safe.
+  void cancel() { is_cancelled_ = true; }
+  /// Was the current or last run cancelled. Thread-safe.
+  bool isCancelled() const { return is_cancelled_; }
+
+  bool isRunning() const;
+  size_t getNumNodes() const { return nodes_.size(); }
+  /// Number of nodes whose task ran in the current or last run.
+  size_t getNumExecutedNodes() const { return num_executed_nodes_; }
+
+ private:
+  struct Node {
+    explicit Node(const Task& _task)
+        : task(_task), num_dependencies(0u), num_missing_dependencies(0u) {}
+    Task task;
+    std::vector<NodeId> successors;
+    size_t num_dependencies;
+    /// Dependencies which did not finish in the current run.
+    std::atomic<size_t> num_missing_dependencies;
+  };
+
+  /// The graph must be acyclic, otherwise a run would never complete.
+  void checkIsAcyclic() const;
+  void enqueueNode(NodeId node_id);
+  /// Runs the task unless the run was cancelled and enqueues the ready successors.
+  void runNode(NodeId node_id);
+  /// Completes the run after the last node.
+  void finishNode();
+
+  ThreadPool* const thread_pool_;
+  std::vector<std::unique_ptr<Node>> nodes_;
+  /// Roots of the graph, the nodes without dependencies.
+  std::vector<NodeId> root_nodes_;
+  bool is_checked_acyclic_;
+
+  CompletionCallback completion_callback_;
+  std::atomic<bool> is_cancelled_;
+  std::atomic<size_t> num_unfinished_nodes_;
+  std::atomic<size_t> num_executed_nodes_;
+  bool is_running_;
+  mutable std::mutex run_mutex_;
+  std::condition_variable run_finished_condition_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_TASK_GRAPH_H_
@@ -24,13 +24,15 @@
 //
 //   3. This notice may not be removed or altered from any source
 //   distribution.
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <future>
 #include <functional>
 #include <limits>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <stdexcept>
 #include <thread>
 #include <unordered_map>
@@ -38,10 +40,60 @@
 
 #include <glog/logging.h>
 
+#include <aslam/common/statistics/histogram.h>
+
 namespace aslam {
 
+/// \class ThreadPool
+/// \brief A work-stealing thread pool.
+///
+/// Every worker owns a task deque. Tasks enqueued from outside of the pool are distributed
+/// round-robin over the workers, tasks enqueued from a worker go to its own deque. Idle workers
+/// steal from the other deques, hence the workers only contend on a lock when they run out of
+/// local work. Tasks of an exclusivity group are kept in a separate per-group queue from which
+/// one task at a time is handed to the workers.
+///
+/// Every deque has one lane per priority. A worker always starts the oldest task of the highest
+/// non-empty priority, so latency-critical tasks overtake queued background work, e.g.
+/// visualization or log flushes. Running tasks are not interrupted. A task of a lower lane is
+/// promoted to just below kHigh once it waited longer than its deadline, such that these lanes
+/// don't starve, also if older tasks without a deadline are queued before it.
 class ThreadPool {
  public:
+  enum class Priority : size_t {
+    /// Latency-critical work, e.g. the frontend.
+    kHigh = 0u,
+    kNormal = 1u,
+    /// Work without latency requirements, e.g. visualization, serialization or maintenance.
+    kBackground = 2u
+  };
+  static constexpr size_t kNumPriorities = 3u;
+
+  /// Scheduling options of a task.
+  struct TaskOptions {
+    TaskOptions(Priority _priority = Priority::kNormal, int64_t _deadline_nanoseconds = -1)
+        : priority(_priority), deadline_nanoseconds(_deadline_nanoseconds) {}
+    Priority priority;
+    /// The task should start at most this long after it was enqueued, negative for none.
+    int64_t deadline_nanoseconds;
+  };
+
+  /// Queue and wait time metrics of the tasks of one priority, see getStatistics.
+  struct PriorityStatistics {
+    /// Tasks which are queued and were not started yet.
+    size_t num_queued_tasks;
+    size_t num_started_tasks;
+    /// Started tasks which waited longer than their deadline.
+    size_t num_missed_deadlines;
+    /// Time between enqueueing and starting the tasks, only measured for the tasks enqueued while
+    /// the metrics are enabled, see setMetricsEnabled. The percentiles have the resolution of
+    /// statistics::LogHistogram.
+    double mean_wait_nanoseconds;
+    int64_t max_wait_nanoseconds;
+    int64_t p50_wait_nanoseconds;
+    int64_t p99_wait_nanoseconds;
+  };
+
   /// \brief Create a thread pool.
   ///
   /// \param[in] numThreads The number of threads in the pool.
@@ -63,71 +115,262 @@ class ThreadPool {
   std::future<typename std::result_of<Function(Args...)>::type>
   enqueueOrdered(const size_t exclusivity_group_id, Function&& function,
                  Args&&... args);
-  /// Same as method enqueueOrdered but the group id is set to -1 per default
-  /// and all tasks are started in order but there is no guarantee on the result
-  /// order.
+  /// Same as method enqueueOrdered but the group id is set to -1 per default.
+  /// The tasks of a worker are started in order, but there is no guarantee on
+  /// the global start or result order.
   template<class Function, class... Args>
   std::future<typename std::result_of<Function(Args...)>::type>
   enqueue(Function&& function, Args&&... args);
 
+  /// Same as enqueueOrdered with a priority and an optional deadline. The order within an
+  /// exclusivity group is kept, the group is dispatched with the options of its oldest task.
+  template<class Function, class ... Args>
+  std::future<typename std::result_of<Function(Args...)>::type>
+  enqueueOrderedWithOptions(const TaskOptions& options, const size_t exclusivity_group_id,
+                            Function&& function, Args&&... args);
+  /// Same as enqueue with a priority and an optional deadline, e.g.
+  /// pool.enqueueWithOptions(ThreadPool::Priority::kBackground, &flushLogs);
+  template<class Function, class... Args>
+  std::future<typename std::result_of<Function(Args...)>::type>
+  enqueueWithOptions(const TaskOptions& options, Function&& function, Args&&... args);
+
+  /// \brief Restrict all workers to the given CPUs, e.g. to keep them on one cluster of a
+  ///        big.LITTLE system.
+  /// @return False if the affinity is not supported on this platform or could not be set.
+  bool setCpuAffinity(const std::vector<size_t>& cpu_ids);
+
+  /// \brief Undo setCpuAffinity(), the workers may run on the CPUs of the thread that
+  ///        constructed the pool again.
+  /// @return False if the affinity is not supported on this platform or could not be set.
+  bool resetCpuAffinity();
+
+  /// The CPUs any of the workers may run on, in increasing order. Empty if the affinity is not
+  /// supported on this platform.
+  std::vector<size_t> getCpuAffinity() const;
+
+  /// \brief Run all workers with the SCHED_FIFO real-time policy, such that they preempt all
+  ///        threads of the normal policy. Needs CAP_SYS_NICE or a sufficient RLIMIT_RTPRIO.
+  /// @param[in] priority The static priority, within [1, 99] on Linux.
+  /// @return False if the policy is not supported on this platform or could not be set.
+  bool setRealTimePriority(int priority);
+
   /// \brief Stop the thread pool. This method is non-blocking.
   void stop(){ stop_ = true; }
 
+  /// Number of worker threads.
+  size_t numThreads() const { return workers_.size(); }
+
+  /// \brief Park the workers beyond the given number, e.g. to save power at a low load.
+  ///
+  /// Parked workers finish their running task and then sleep until they are unparked, the tasks
+  /// left in their deques are stolen by the active workers. Tasks enqueued from outside of the
+  /// pool are distributed over the active workers only. All workers are active by default.
+  /// \param[in] num_active_threads The number of active workers, within [1, numThreads()].
+  void setNumActiveThreads(size_t num_active_threads);
+  size_t numActiveThreads() const { return num_active_workers_; }
   // Number of queued tasks.
   size_t numQueuedTasks() const;
+  /// Metrics of the tasks of a priority since the construction or the last reset.
+  PriorityStatistics getStatistics(Priority priority) const;
+  void resetStatistics();
+
+  /// Runtime metrics to tune the number of workers, recorded while enabled, see Metrics.
+  struct Metrics {
+    struct Worker {
+      /// Time spent running tasks and sleeping without tasks. The remainder is spent on
+      /// looking for tasks.
+      double busy_seconds;
+      double idle_seconds;
+      size_t num_executed_tasks;
+      /// Tasks taken from the deques of other workers.
+      size_t num_stolen_tasks;
+    };
+    std::vector<Worker> workers;
+    /// Time between enqueueing and starting the tasks of all priorities, in seconds. The same
+    /// samples as the wait time percentiles of getStatistics.
+    statistics::LogHistogram wait_time_histogram;
+    /// Execution times of the tasks of every exclusivity group, in seconds. The non-exclusive
+    /// tasks are under kGroupdIdNonExclusiveTask.
+    std::unordered_map<size_t, statistics::LogHistogram> execution_time_histograms;
+  };
+  /// \brief Enables recording the metrics and the wait times, disabled by default. While
+  ///        disabled, the clock is only read to check the deadlines of the tasks that have
+  ///        one, and the workers only test the flag.
+  void setMetricsEnabled(bool enabled);
+  bool areMetricsEnabled() const { return metrics_enabled_; }
+  /// A snapshot of the metrics recorded since the construction or the last reset.
+  Metrics getMetrics() const;
+  /// Also resets the wait time percentiles of getStatistics.
+  void resetMetrics();
   /// This method blocks until the queue is empty.
   void waitForEmptyQueue() const;
 
   static constexpr size_t kGroupdIdNonExclusiveTask =
       std::numeric_limits<size_t>::max();
+  /// \brief A process-wide unique exclusivity group id for the tasks of a component that may
+  ///        share a pool with others, e.g. a consumer callback.
+  ///
+  /// The ids count down from below kGroupdIdNonExclusiveTask, hence they don't collide with the
+  /// small group ids the callers pick themselves, e.g. the camera indices.
+  static size_t reserveExclusivityGroupId();
  private:
-  // This version is not threadsafe.
-  size_t numQueuedTasksImpl() const;
+  typedef std::function<void()> Task;
+
+  struct QueuedTask {
+    QueuedTask() : priority(Priority::kNormal), deadline_time_nanoseconds(-1) {}
+    QueuedTask(Task&& _task, Priority _priority, int64_t _deadline_time_nanoseconds)
+        : task(std::move(_task)), priority(_priority),
+          deadline_time_nanoseconds(_deadline_time_nanoseconds) {}
+    Task task;
+    Priority priority;
+    /// Absolute steady clock time, negative if the task has no deadline.
+    int64_t deadline_time_nanoseconds;
+  };
+
+  struct WorkerQueue {
+    WorkerQueue() {
+      for (size_t& num_tasks : num_tasks_with_deadline) {
+        num_tasks = 0u;
+      }
+    }
+    std::mutex mutex;
+    /// One lane per priority.
+    std::deque<QueuedTask> tasks[kNumPriorities];
+    /// Per lane, the tasks with a deadline, such that lanes without one are not searched.
+    size_t num_tasks_with_deadline[kNumPriorities];
+  };
+
+  struct ExclusivityGroup {
+    ExclusivityGroup() : is_scheduled(false) {}
+    std::deque<QueuedTask> tasks;
+    // True while a worker deque holds or runs the task of this group.
+    bool is_scheduled;
+  };
+
+  /// Metrics of one priority, see PriorityStatistics.
+  struct PriorityCounters {
+    PriorityCounters();
+    std::atomic<size_t> num_queued_tasks;
+    std::atomic<size_t> num_started_tasks;
+    std::atomic<size_t> num_missed_deadlines;
+    /// In seconds, only recorded for the tasks enqueued while the metrics are enabled.
+    statistics::LogHistogram wait_time_histogram;
+  };
+
+  /// Add a task of the given exclusivity group.
+  void enqueueTask(const TaskOptions& options, size_t exclusivity_group_id, Task&& task);
+  /// Push an internal task to a worker deque and wake up a worker if needed.
+  void pushTask(QueuedTask&& task);
+  /// Pop a task from the own deque or steal one from the other workers, see the class comment
+  /// for the order.
+  bool popTask(size_t worker_index, Task* task);
+  /// Pop the oldest task of a lane from the own deque or steal it.
+  bool popTaskFromLane(size_t worker_index, size_t lane, Task* task);
+  /// Pop an overdue task of a lane below kHigh, the oldest of its lane in the deque it is found
+  /// in. Tasks without a deadline queued before it don't block it.
+  bool popOverdueTask(size_t worker_index, Task* task);
+  /// Update the statistics when a user task starts. The enqueue time is negative if the clock
+  /// was not read.
+  void recordTaskStart(Priority priority, int64_t enqueue_time_nanoseconds,
+                       int64_t deadline_time_nanoseconds, bool record_wait_time);
+  /// Run a user task and record its execution time if the metrics are enabled.
+  void runUserTask(size_t exclusivity_group_id, const Task& task);
+
+  /// Resolution of the metric histograms.
+  static constexpr double kMetricsResolutionSeconds = 1e-9;
+  /// The metrics recorded by one worker, only the worker writes to them.
+  struct WorkerMetrics {
+    WorkerMetrics();
+    std::atomic<int64_t> busy_nanoseconds;
+    std::atomic<int64_t> idle_nanoseconds;
+    std::atomic<size_t> num_executed_tasks;
+    std::atomic<size_t> num_stolen_tasks;
+    /// Only contended by getMetrics and resetMetrics.
+    std::mutex execution_time_mutex;
+    std::unordered_map<size_t, statistics::LogHistogram> execution_time_histograms;
+  };
+  /// Run the next task of an exclusivity group and reschedule the group.
+  void runExclusivityGroup(size_t exclusivity_group_id);
+  /// Mark a user task as done.
+  void finishTask();
 
   /// \brief Run a single thread.
-  void run();
+  void run(size_t worker_index);
   /// Need to keep track of threads so we can join them.
   std::vector<std::thread> workers_;
+  // The CPUs the workers inherited from the constructing thread, see resetCpuAffinity().
+  std::vector<size_t> initial_cpu_ids_;
+  std::vector<std::unique_ptr<WorkerQueue>> worker_queues_;
+  // Round-robin counter for tasks enqueued from outside of the pool.
+  std::atomic<size_t> next_worker_queue_;
+  // Number of tasks in all worker deques.
+  std::atomic<size_t> num_tasks_in_worker_queues_;
+  // Number of tasks in the lanes of all worker deques, to skip empty lanes without locking.
+  std::atomic<size_t> num_tasks_in_lanes_[kNumPriorities];
+  // Number of tasks with a deadline in all worker deques.
+  std::atomic<size_t> num_tasks_with_deadline_;
+  PriorityCounters priority_counters_[kNumPriorities];
+  std::vector<std::unique_ptr<WorkerMetrics>> worker_metrics_;
+  std::atomic<bool> metrics_enabled_;
 
   // The group id is a size_t where the number kGroupdIdNonExclusiveTask
   // represents a non-exclusive task that needs no guarantees on its execution
   // order. All tasks with other group ids have guaranteed execution order that
-  // corresponds to order of enqueing the task.
-  typedef std::deque<std::pair<size_t, std::function<void()>>> TaskDeque;
-  TaskDeque groupid_tasks_;
-  // The guard map should never contain negative group ids.
-  typedef std::unordered_map<size_t, bool> GuardMap;
-  GuardMap groupid_exclusivity_guards_;
-  // Count the number of non-exclusive tasks in groupid_tasks_;
-  // where groupid == kGroupdIdNonExclusiveTask.
-  size_t num_queued_nonexclusive_tasks = 0u;
-
-  // A mutex to protect the list of tasks of the group list.
-  mutable std::mutex tasks_mutex_;
-
-  // A condition variable that signals a change in the task queue; either a
-  // removed or inserted element.
-  mutable std::condition_variable tasks_queue_change_;
-
-  // A counter of active threads
-  unsigned active_threads_;
+  // corresponds to order of enqueing the task. Groups without queued tasks are
+  // removed.
+  std::unordered_map<size_t, ExclusivityGroup> exclusivity_groups_;
+  std::mutex exclusivity_groups_mutex_;
+
+  // Idle workers sleep on this condition variable.
+  std::mutex idle_mutex_;
+  std::condition_variable idle_condition_;
+  std::atomic<size_t> num_sleeping_workers_;
+  // The workers with an index of at least the number of active workers sleep on the park
+  // condition variable, with the idle mutex.
+  std::condition_variable park_condition_;
+  std::atomic<size_t> num_active_workers_;
+
+  // User tasks that were not started yet.
+  std::atomic<size_t> num_queued_tasks_;
+  // User tasks that were not finished yet.
+  std::atomic<size_t> num_pending_tasks_;
+  mutable std::mutex completion_mutex_;
+  mutable std::condition_variable completion_condition_;
+
   // A signal to stop the threads.
-  volatile bool stop_;
+  std::atomic<bool> stop_;
 };
 
 // Add new work item to the pool.
 template<class Function, class... Args>
 std::future<typename std::result_of<Function(Args...)>::type>
 ThreadPool::enqueue(Function&& function, Args&&... args) {
-  return enqueueOrdered(kGroupdIdNonExclusiveTask, function,
-                        std::forward<Args>(args)...);
+  return enqueueOrderedWithOptions(TaskOptions(), kGroupdIdNonExclusiveTask, function,
+                                   std::forward<Args>(args)...);
 }
 
-// Add new work item to the pool.
 template<class Function, class... Args>
 std::future<typename std::result_of<Function(Args...)>::type>
 ThreadPool::enqueueOrdered(const size_t exclusivity_group_id,
                            Function&& function, Args&&... args) {
+  return enqueueOrderedWithOptions(TaskOptions(), exclusivity_group_id, function,
+                                   std::forward<Args>(args)...);
+}
+
+template<class Function, class... Args>
+std::future<typename std::result_of<Function(Args...)>::type>
+ThreadPool::enqueueWithOptions(const TaskOptions& options, Function&& function,
+                               Args&&... args) {
+  return enqueueOrderedWithOptions(options, kGroupdIdNonExclusiveTask, function,
+                                   std::forward<Args>(args)...);
+}
+
+// Add new work item to the pool.
+template<class Function, class... Args>
+std::future<typename std::result_of<Function(Args...)>::type>
+ThreadPool::enqueueOrderedWithOptions(const TaskOptions& options,
+                                      const size_t exclusivity_group_id,
+                                      Function&& function, Args&&... args) {
   typedef typename std::result_of<Function(Args...)>::type return_type;
   // Don't allow enqueueing after stopping the pool.
   if(stop_) {
@@ -139,19 +382,7 @@ ThreadPool::enqueueOrdered(const size_t exclusivity_group_id,
       std::bind(function, std::forward<Args>(args)...));
 
   std::future<return_type> res = task->get_future();
-  {
-    std::unique_lock<std::mutex> lock(tasks_mutex_);
-    groupid_tasks_.emplace_back(exclusivity_group_id, [task](){ (*task)();});
-
-    // Initialize a group id exclusivity guard.
-    if (exclusivity_group_id == kGroupdIdNonExclusiveTask) {
-      ++num_queued_nonexclusive_tasks;
-    } else if (groupid_exclusivity_guards_.count(
-        exclusivity_group_id) == 0u) {
-      groupid_exclusivity_guards_.emplace(exclusivity_group_id, false);
-    }
-  }
-  tasks_queue_change_.notify_one();
+  enqueueTask(options, exclusivity_group_id, [task](){ (*task)();});
   return res;
 }
 
@@ -32,17 +32,53 @@
 #define ASLAM_TIMING_TIMER_H_
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <limits>
 #include <map>
 #include <mutex>
 #include <string>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
 #include "aslam/common/statistics/statistics.h"
 
 namespace timing {
 
+// Reads the cycle counter of the CPU: the time stamp counter on x86 and the
+// virtual counter on ARMv8, the steady clock in nanoseconds elsewhere. Reading
+// the counter takes a few nanoseconds and doesn't enter the kernel. The x86
+// time stamp counter is assumed to be invariant, i.e. to tick at a constant
+// rate on all cores, which holds for all x86 CPUs of the last decade.
+class CycleClock {
+ public:
+  static inline uint64_t Now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+#endif
+  }
+
+  // The duration of a tick, calibrated against the steady clock on first use.
+  static double GetSecondsPerTick();
+
+  static inline double TicksToSeconds(uint64_t ticks) {
+    return static_cast<double>(ticks) * GetSecondsPerTick();
+  }
+};
+
 // A class that has the timer interface but does nothing. Swapping this in
 // place of the Timer class (say with a typedef) should allow one to disable
 // timing. Because all of the functions are inline, they should just disappear.
@@ -68,29 +104,34 @@ class DummyTimer {
   }
 };
 
+// Measures with the CycleClock. Timers of tags with a sampling interval of N
+// only measure every N-th Start() of a thread, see Timing::SetSamplingInterval.
 class TimerImpl {
  public:
   TimerImpl(const std::string& tag, bool construct_stopped = false);
+  // Skips the lookup of the tag, e.g. for timers in hot loops with a handle
+  // from Timing::GetHandle in a static variable.
+  TimerImpl(size_t handle, bool construct_stopped = false);
   ~TimerImpl();
 
   void Start();
-  // Returns the amount of time passed between Start() and Stop().
+  // Returns the amount of time passed between Start() and Stop(), 0 if this
+  // start was not sampled.
   double Stop();
   void Discard();
   bool IsTiming() const;
   size_t GetHandle() const;
 
  private:
-  std::chrono::time_point<std::chrono::system_clock> time_;
+  uint64_t start_ticks_;
 
   bool is_timing_;
   size_t handle_;
-  std::string tag_;
 };
 
 class Timing {
  public:
-  typedef std::map<std::string, size_t> map_t;
+  typedef statistics::SampleStore::map_t map_t;
   friend class TimerImpl;
   // Definition of static functions to query the timers.
   static size_t GetHandle(const std::string& tag);
@@ -109,28 +150,45 @@ class Timing {
   static double GetMaxSeconds(const std::string& tag);
   static double GetHz(size_t handle);
   static double GetHz(const std::string& tag);
+  // Only measure every N-th start of the timers of the tag in each thread. An
+  // interval of 1 measures every start, which is the default. The statistics
+  // describe the measured starts only, e.g. the number of samples and the
+  // total time are about 1/N of the unsampled ones.
+  static void SetSamplingInterval(const std::string& tag, uint32_t interval);
+  static uint32_t GetSamplingInterval(const std::string& tag);
+  // Percentiles of the timers from a histogram with nanosecond resolution,
+  // e.g. 0.99 for the 99th percentile.
+  static double GetPercentileSeconds(size_t handle, double fraction);
+  static double GetPercentileSeconds(const std::string& tag, double fraction);
+  static statistics::HistogramMap GetHistograms();
   static void Print(std::ostream& out);  // NOLINT
   static std::string Print();
+  // Export the percentiles of all timers, see statistics::WritePrometheusSummary
+  // and statistics::WriteJson.
+  static void WritePrometheus(std::ostream& out);  // NOLINT
+  static void WriteJson(std::ostream& out);  // NOLINT
   static std::string SecondsToTimeString(double seconds);
   static void Reset();
-  static const map_t& GetTimerImpls() {
-    return Instance().tag_map_;
+  static map_t GetTimerImpls() {
+    return Instance().store_.GetTagMap();
   }
 
  private:
   void AddTime(size_t handle, double seconds);
+  // Counts the start and returns whether it has to be measured.
+  bool ShouldSample(size_t handle);
 
   static Timing& Instance();
 
   Timing();
   ~Timing();
 
-  typedef std::vector<statistics::StatisticsMapValue> list_t;
+  statistics::SampleStore store_;
 
-  list_t timers_;
-  map_t tag_map_;
-  size_t max_tag_length_;
-  std::mutex mutex_;
+  std::mutex sampling_mutex_;
+  std::map<size_t, uint32_t> sampling_intervals_;
+  // Incremented whenever an interval changes, the threads then reload them.
+  std::atomic<uint64_t> sampling_generation_;
 };
 
 #if ENABLE_TIMING
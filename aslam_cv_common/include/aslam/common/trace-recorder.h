@@ -0,0 +1,215 @@
+#ifndef ASLAM_COMMON_TRACE_RECORDER_H_
+#define ASLAM_COMMON_TRACE_RECORDER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <gflags/gflags.h>
+
+DECLARE_bool(acv_pipeline_tracing);
+DECLARE_int32(acv_pipeline_trace_capacity);
+DECLARE_bool(acv_pipeline_trace_timers);
+
+namespace aslam {
+namespace common {
+
+/// The pipeline stages that are traced.
+enum class TraceStage : uint8_t {
+  /// An image was handed to the pipeline (instant).
+  kEnqueue,
+  /// A worker picked up an image, the duration is the time spent waiting in the queue.
+  kDequeue,
+  kUndistort,
+  kDetect,
+  kDescribe,
+  /// All frames of an nframe were received (instant).
+  kNFrameComplete,
+  /// An nframe was handed to the consumer (instant).
+  kConsume,
+  /// Frame to frame tracking of the consumer, e.g. GyroTracker::track.
+  kTrack,
+  /// Track id assignment of the consumer, e.g. TrackManager::applyMatchesToFrames.
+  kAssignTrackIds,
+  /// The scope of a timing::Timer, see TraceEvent::timer_handle.
+  kTimer,
+  /// Decoding of a compressed image. Appended, such that the values of the other stages in
+  /// recorded traces stay valid.
+  kDecode,
+  kNumStages
+};
+
+const char* getTraceStageName(TraceStage stage);
+
+struct TraceEvent {
+  TraceStage stage;
+  uint32_t camera_index;
+  /// Timestamp of the frame the event belongs to, identifies the frame across stages.
+  int64_t frame_timestamp_nanoseconds;
+  /// Steady clock time, see TraceRecorder::now().
+  int64_t start_nanoseconds;
+  int64_t end_nanoseconds;
+  uint32_t thread_id;
+  /// Handle of the timer tag of kTimer events, see timing::Timing::GetTag.
+  size_t timer_handle;
+};
+
+/// \class TraceRecorder
+/// \brief Records per-frame pipeline events into a fixed-capacity ring buffer.
+///
+/// Recording only costs a relaxed atomic load while the recorder is disabled. Otherwise a writer
+/// claims a slot with an atomic increment and never takes a lock, readers drop the slots that
+/// are written meanwhile. Once the buffer is full the oldest events are overwritten. The scopes
+/// of the timing::Timer can be recorded as well, attributed to the camera and frame of the
+/// thread. The events can be exported in the Chrome trace event format (chrome://tracing,
+/// Perfetto), on demand or on a signal, or summarized as per-stage duration percentiles.
+class TraceRecorder {
+ public:
+  ASLAM_POINTER_TYPEDEFS(TraceRecorder);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(TraceRecorder);
+
+  struct StageSummary {
+    size_t num_events;
+    double mean_nanoseconds;
+    double p50_nanoseconds;
+    double p99_nanoseconds;
+    double max_nanoseconds;
+  };
+
+  /// @param[in] capacity Maximum number of events kept in the buffer.
+  explicit TraceRecorder(size_t capacity);
+
+  ~TraceRecorder();
+
+  /// The recorder used by the pipelines and the timers. It is enabled and sized by
+  /// FLAGS_acv_pipeline_tracing and FLAGS_acv_pipeline_trace_capacity on first use, the timer
+  /// scopes are recorded if FLAGS_acv_pipeline_trace_timers is set.
+  static TraceRecorder& instance();
+
+  /// Current steady clock time in nanoseconds.
+  static int64_t now();
+
+  /// The camera index attributed to events of stages that don't know their camera, e.g. the
+  /// single camera pipelines. Set per thread by the caller, 0 by default.
+  static void setThreadCameraIndex(size_t camera_index);
+  static size_t getThreadCameraIndex();
+  /// The frame attributed to the timer scopes of the calling thread, -1 if unknown. Prefer
+  /// ScopedThreadTraceContext, which restores the previous frame.
+  static void setThreadFrameTimestamp(int64_t frame_timestamp_nanoseconds);
+  static int64_t getThreadFrameTimestamp();
+
+  void setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+  bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+  /// Whether the timer scopes are recorded while the recorder is enabled.
+  void setTimerScopesEnabled(bool enabled) {
+    are_timer_scopes_enabled_.store(enabled, std::memory_order_relaxed);
+  }
+  bool areTimerScopesEnabled() const {
+    return isEnabled() && are_timer_scopes_enabled_.load(std::memory_order_relaxed);
+  }
+
+  void record(TraceStage stage, size_t camera_index, int64_t frame_timestamp_nanoseconds,
+              int64_t start_nanoseconds, int64_t end_nanoseconds);
+  void recordInstant(TraceStage stage, size_t camera_index, int64_t frame_timestamp_nanoseconds);
+  /// Records the scope of a timer of the calling thread, in steady clock time.
+  void recordTimerScope(size_t timer_handle, int64_t start_nanoseconds, int64_t end_nanoseconds);
+
+  /// The buffered events, oldest first.
+  std::vector<TraceEvent> getEvents() const;
+  /// Number of events recorded since the last clear, including overwritten ones.
+  size_t getNumRecordedEvents() const;
+  size_t getCapacity() const { return capacity_; }
+  void clear();
+
+  /// Write the buffered events as Chrome trace JSON. Cameras are shown as separate processes,
+  /// timer scopes are named after their tag.
+  void exportChromeTraceJson(std::ostream& out) const;  // NOLINT
+  bool exportChromeTraceJsonToFile(const std::string& path) const;
+
+  /// Export the trace of instance() to the file whenever the process receives the signal, e.g.
+  /// SIGUSR1. The file is written by a background thread, the signal handler only sets a flag.
+  static void dumpOnSignal(int signal_number, const std::string& path);
+
+  /// Duration statistics of the buffered events of a stage.
+  StageSummary getStageSummary(TraceStage stage) const;
+  /// Print the percentiles of all stages with at least one buffered event.
+  void printSummary(std::ostream& out) const;  // NOLINT
+  /// Add the durations of the buffered events in seconds to the statistics under the tags
+  /// "trace/<stage>". The timer scopes are skipped, the timers collect them already.
+  void addToStatistics() const;
+
+ private:
+  struct Slot;
+
+  void writeEvent(const TraceEvent& event);
+
+  std::atomic<bool> enabled_;
+  std::atomic<bool> are_timer_scopes_enabled_;
+  const size_t capacity_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<uint64_t> num_recorded_events_;
+  /// Events before this index were cleared.
+  std::atomic<uint64_t> num_cleared_events_;
+};
+
+/// Attributes the timer scopes and the camera-less events of the calling thread to a camera
+/// and frame for the lifetime of this object, e.g. while a pooled worker processes an image.
+class ScopedThreadTraceContext {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(ScopedThreadTraceContext);
+
+  ScopedThreadTraceContext(size_t camera_index, int64_t frame_timestamp_nanoseconds)
+      : previous_camera_index_(TraceRecorder::getThreadCameraIndex()),
+        previous_frame_timestamp_nanoseconds_(TraceRecorder::getThreadFrameTimestamp()) {
+    TraceRecorder::setThreadCameraIndex(camera_index);
+    TraceRecorder::setThreadFrameTimestamp(frame_timestamp_nanoseconds);
+  }
+
+  ~ScopedThreadTraceContext() {
+    TraceRecorder::setThreadCameraIndex(previous_camera_index_);
+    TraceRecorder::setThreadFrameTimestamp(previous_frame_timestamp_nanoseconds_);
+  }
+
+ private:
+  const size_t previous_camera_index_;
+  const int64_t previous_frame_timestamp_nanoseconds_;
+};
+
+/// Records an event of the given stage covering the lifetime of this object.
+class ScopedTraceEvent {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(ScopedTraceEvent);
+
+  ScopedTraceEvent(TraceStage stage, size_t camera_index, int64_t frame_timestamp_nanoseconds)
+      : recorder_(TraceRecorder::instance()), stage_(stage), camera_index_(camera_index),
+        frame_timestamp_nanoseconds_(frame_timestamp_nanoseconds),
+        start_nanoseconds_(recorder_.isEnabled() ? TraceRecorder::now() : -1) {}
+
+  /// Attribute the event to the camera index of the calling thread.
+  ScopedTraceEvent(TraceStage stage, int64_t frame_timestamp_nanoseconds)
+      : ScopedTraceEvent(stage, TraceRecorder::getThreadCameraIndex(),
+                         frame_timestamp_nanoseconds) {}
+
+  ~ScopedTraceEvent() {
+    if (start_nanoseconds_ >= 0) {
+      recorder_.record(stage_, camera_index_, frame_timestamp_nanoseconds_, start_nanoseconds_,
+                       TraceRecorder::now());
+    }
+  }
+
+ private:
+  TraceRecorder& recorder_;
+  const TraceStage stage_;
+  const size_t camera_index_;
+  const int64_t frame_timestamp_nanoseconds_;
+  const int64_t start_nanoseconds_;
+};
+
+}  // namespace common
+}  // namespace aslam
+
+#endif  // ASLAM_COMMON_TRACE_RECORDER_H_
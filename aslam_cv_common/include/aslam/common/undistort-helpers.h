@@ -2,7 +2,10 @@
 #define ASLAM_UNDISTORT_HELPERS_H_
 
 #include <algorithm>
+#include <cmath>
+#include <vector>
 
+#include <aslam/common/parallel-for.h>
 #include <Eigen/Dense>
 #include <glog/logging.h>
 #include <opencv2/core/core.hpp>
@@ -154,7 +157,98 @@ Eigen::Matrix3d getOptimalNewCameraMatrix(const DerivedCameraType& input_camera,
   return output_camera_matrix;
 }
 
+/// \brief Returns the rectangle of the undistorted image that only contains valid pixels.
+///        This is the inscribed rectangle of \ref getUndistortRectangles mapped to the output
+///        image and clipped to its size.
+/// @param[in] input_camera Input camera geometry
+/// @param[in] output_camera_matrix Output camera matrix (see \ref getOptimalNewCameraMatrix)
+///  @param[in] undistort_to_pinhole Undistort image to a pinhole projection
+///                                  (remove distortion and projection effects)
+/// @param[in] output_size Size of the undistorted image.
+/// @return The valid rectangle in output image coordinates, empty if there is none.
+template<typename DerivedCameraType>
+cv::Rect getValidUndistortedRoi(const DerivedCameraType& input_camera,
+                                const Eigen::Matrix3d& output_camera_matrix,
+                                bool undistort_to_pinhole, const cv::Size& output_size) {
+  cv::Rect_<float> inner, outer;
+  getUndistortRectangles(input_camera, undistort_to_pinhole, inner, outer);
+
+  const double fx = output_camera_matrix(0, 0);
+  const double fy = output_camera_matrix(1, 1);
+  const double cx = output_camera_matrix(0, 2);
+  const double cy = output_camera_matrix(1, 2);
+  const int x0 = static_cast<int>(std::ceil(fx * inner.x + cx));
+  const int y0 = static_cast<int>(std::ceil(fy * inner.y + cy));
+  const int x1 = static_cast<int>(std::floor(fx * (inner.x + inner.width) + cx)) + 1;
+  const int y1 = static_cast<int>(std::floor(fy * (inner.y + inner.height) + cy)) + 1;
+  if (x1 <= x0 || y1 <= y0) {
+    return cv::Rect();
+  }
+  return cv::Rect(x0, y0, x1 - x0, y1 - y0) & cv::Rect(cv::Point(0, 0), output_size);
+}
+
+/// \brief Calculates the undistortion maps for a band of output image rows.
+///        (see \ref buildUndistortMap)
+template<typename InputDerivedCameraType, typename OutputDerivedCameraType>
+void buildUndistortMapRows(const InputDerivedCameraType& input_camera,
+                           const OutputDerivedCameraType& output_camera, int map_type,
+                           int row_begin, int row_end, cv::Mat* map_u, cv::Mat* map_v) {
+  CHECK_NOTNULL(map_u);
+  CHECK_NOTNULL(map_v);
+  const int width = map_u->cols;
+  const int num_rows = row_end - row_begin;
+  CHECK_GT(num_rows, 0);
+
+  // Convert the pixels on the output image plane to keypoints. (projection and distortion)
+  Eigen::Matrix2Xd keypoints(2, width * num_rows);
+  for (int i = 0; i < num_rows; ++i) {
+    for (int j = 0; j < width; ++j) {
+      keypoints(0, i * width + j) = j;
+      keypoints(1, i * width + j) = row_begin + i;
+    }
+  }
+  Eigen::Matrix3Xd points_3d;
+  std::vector<unsigned char> back_projection_success;
+  output_camera.backProject3Vectorized(keypoints, &points_3d, &back_projection_success);
+  const Eigen::RowVectorXd depths = points_3d.row(2);
+  points_3d.array().rowwise() /= depths.array();
+  Eigen::Matrix2Xd keypoints_distorted;
+  std::vector<ProjectionResult> projection_results;
+  input_camera.project3Vectorized(points_3d, &keypoints_distorted, &projection_results);
+
+  // Store in output format
+  for (int i = 0; i < num_rows; ++i) {
+    float* m1f = (float*) (map_u->data + map_u->step * (row_begin + i));
+    float* m2f = map_v->empty() ? nullptr : (float*) (map_v->data + map_v->step * (row_begin + i));
+    short* m1 = (short*) m1f;
+    ushort* m2 = (ushort*) m2f;
+
+    for (int j = 0; j < width; ++j) {
+      const double u = keypoints_distorted(0, i * width + j);
+      const double v = keypoints_distorted(1, i * width + j);
+
+      if (map_type == CV_16SC2) {
+        int iu = cv::saturate_cast<int>(u * cv::INTER_TAB_SIZE);
+        int iv = cv::saturate_cast<int>(v * cv::INTER_TAB_SIZE);
+        m1[j * 2] = (short) (iu >> cv::INTER_BITS);
+        m1[j * 2 + 1] = (short) (iv >> cv::INTER_BITS);
+        m2[j] = (ushort) ((iv & (cv::INTER_TAB_SIZE - 1)) * cv::INTER_TAB_SIZE
+            + (iu & (cv::INTER_TAB_SIZE - 1)));
+      } else if (map_type == CV_32FC1) {
+        m1f[j] = (float) u;
+        m2f[j] = (float) v;
+      } else {
+        m1f[j * 2] = (float) u;
+        m1f[j * 2 + 1] = (float) v;
+      }
+    }
+  }
+}
+
 /// \brief Calculates the undistortion maps for the given camera geometries.
+///
+/// The output image is split into bands of rows, each band is projected with the vectorized
+/// camera functions. The bands are distributed over the shared pool of common::parallelFor.
 /// @param[in] input_camera Input camera geometry
 /// @param[in] output_camera_matrix Desired output camera matrix (see \ref getOptimalNewCameraMatrix)
 /// @param[in] scale Output image size scaling parameter wrt. to input image size.
@@ -162,10 +256,11 @@ Eigen::Matrix3d getOptimalNewCameraMatrix(const DerivedCameraType& input_camera,
 ///                     Use cv::CV_16SC2 if you don't know what to choose. (fastest fixed-point)
 /// @param[out] map_u Map that transforms u-coordinates from distorted to undistorted image plane.
 /// @param[out] map_v Map that transforms v-coordinates from distorted to undistorted image plane.
+/// @param[in] num_threads 1 runs on the calling thread, any other value on the shared pool.
 template<typename InputDerivedCameraType, typename OutputDerivedCameraType>
 void buildUndistortMap(const InputDerivedCameraType& input_camera,
                        const OutputDerivedCameraType& output_camera, int map_type,
-                       cv::OutputArray map_u, cv::OutputArray map_v) {
+                       cv::OutputArray map_u, cv::OutputArray map_v, size_t num_threads = 0u) {
   // Output image size
   cv::Size output_size(output_camera.imageWidth(), output_camera.imageHeight());
 
@@ -178,43 +273,23 @@ void buildUndistortMap(const InputDerivedCameraType& input_camera,
     map2 = map_v.getMat();
   } else
     map_v.release();
+  if (output_size.area() == 0) {
+    return;
+  }
 
-  // Build the maps.
-  for (int i = 0; i < output_size.height; i++) {
-    float* m1f = (float*) (map1.data + map1.step * i);
-    float* m2f = (float*) (map2.data + map2.step * i);
-    short* m1 = (short*) m1f;
-    ushort* m2 = (ushort*) m2f;
-
-    for (int j = 0; j < output_size.width; j++) {
-      // Convert point on normalized image plane to keypoints. (projection and distortion)
-      const Eigen::Vector2d keypoint(j, i);
-      Eigen::Vector2d keypoint_dist;
-      Eigen::Vector3d point_3d;
-      output_camera.backProject3(keypoint, &point_3d);
-      point_3d /= point_3d[2];
-      input_camera.project3(point_3d, &keypoint_dist);
-
-      const double& u = keypoint_dist[0];
-      const double& v = keypoint_dist[1];
-
-      // Store in output format
-      if (map_type == CV_16SC2) {
-        int iu = cv::saturate_cast<int>(u * cv::INTER_TAB_SIZE);
-        int iv = cv::saturate_cast<int>(v * cv::INTER_TAB_SIZE);
-        m1[j * 2] = (short) (iu >> cv::INTER_BITS);
-        m1[j * 2 + 1] = (short) (iv >> cv::INTER_BITS);
-        m2[j] = (ushort) ((iv & (cv::INTER_TAB_SIZE - 1)) * cv::INTER_TAB_SIZE
-            + (iu & (cv::INTER_TAB_SIZE - 1)));
-      } else if (map_type == CV_32FC1) {
-        m1f[j] = (float) u;
-        m2f[j] = (float) v;
-      } else {
-        m1f[j * 2] = (float) u;
-        m1f[j * 2 + 1] = (float) v;
-      }
+  // Number of rows per band, bounds the size of the intermediate projection buffers.
+  constexpr int kNumRowsPerBand = 16;
+  const int num_bands = (output_size.height + kNumRowsPerBand - 1) / kNumRowsPerBand;
+  common::parallelFor(
+      common::IndexRange(0u, static_cast<size_t>(num_bands)),
+      num_threads == 1u ? static_cast<size_t>(num_bands) : 1u, [&](size_t begin, size_t end) {
+    for (size_t band_idx = begin; band_idx < end; ++band_idx) {
+      const int row_begin = static_cast<int>(band_idx) * kNumRowsPerBand;
+      const int row_end = std::min(row_begin + kNumRowsPerBand, output_size.height);
+      buildUndistortMapRows(input_camera, output_camera, map_type, row_begin, row_end, &map1,
+                            &map2);
     }
-  }
+  });
 }
 
 } //namespace common
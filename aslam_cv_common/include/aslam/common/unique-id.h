@@ -7,17 +7,24 @@
 #include <aslam/common/hash-id.h>
 
 namespace aslam {
-#define ASLAM_UNIQUE_ID(IdType)                   \
-  class IdType : public HashId {                  \
-   public:                                        \
-    inline static IdType Random() {               \
-      IdType generated;                           \
-      generated.randomize();                      \
-      return generated;                           \
-    }                                             \
-    IdType() = default;                           \
-  };                                              \
-  typedef std::vector<IdType> IdType##List;       \
+#define ASLAM_UNIQUE_ID(IdType)                                \
+  class IdType : public HashId {                               \
+   public:                                                     \
+    inline static IdType Random() {                            \
+      IdType generated;                                        \
+      generated.randomize();                                   \
+      return generated;                                        \
+    }                                                          \
+    inline static std::vector<IdType> Random(size_t num_ids) { \
+      static_assert(sizeof(IdType) == sizeof(HashId),          \
+                    "The ids are generated as HashId.");       \
+      std::vector<IdType> generated(num_ids);                  \
+      HashId::generateIds(num_ids, generated.data());          \
+      return generated;                                        \
+    }                                                          \
+    IdType() = default;                                        \
+  };                                                           \
+  typedef std::vector<IdType> IdType##List;                    \
   typedef std::unordered_set<IdType> IdType##Set
 
 ASLAM_UNIQUE_ID(FrameId);
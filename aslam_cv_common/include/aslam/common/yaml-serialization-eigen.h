@@ -1,11 +1,176 @@
 #ifndef ASLAM_CV_COMMON_EIGEN_YAML_SERIALIZATION_H_
 #define ASLAM_CV_COMMON_EIGEN_YAML_SERIALIZATION_H_
 
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include <Eigen/Core>
 #include <glog/logging.h>
 #include <yaml-cpp/yaml.h>
 
+#include <aslam/common/base64.h>
+
 namespace YAML {  // This has to be in the same namespace as the Emitter.
+namespace eigen_yaml_internal {
+// Tag of the binary encoding, the data is the base64 string of the raw little-endian buffer.
+constexpr char kBinaryEncoding[] = "base64";
+constexpr char kRowMajor[] = "row_major";
+constexpr char kColumnMajor[] = "column_major";
+
+// Type tags of the scalars supported by the binary encoding.
+template <typename Scalar>
+struct ScalarTypeTag;
+#define ASLAM_EIGEN_YAML_SCALAR_TYPE_TAG(Scalar, tag)  \
+  template <>                                          \
+  struct ScalarTypeTag<Scalar> {                       \
+    static const char* name() { return tag; }          \
+  };
+ASLAM_EIGEN_YAML_SCALAR_TYPE_TAG(double, "float64")
+ASLAM_EIGEN_YAML_SCALAR_TYPE_TAG(float, "float32")
+ASLAM_EIGEN_YAML_SCALAR_TYPE_TAG(int8_t, "int8")
+ASLAM_EIGEN_YAML_SCALAR_TYPE_TAG(uint8_t, "uint8")
+ASLAM_EIGEN_YAML_SCALAR_TYPE_TAG(int16_t, "int16")
+ASLAM_EIGEN_YAML_SCALAR_TYPE_TAG(uint16_t, "uint16")
+ASLAM_EIGEN_YAML_SCALAR_TYPE_TAG(int32_t, "int32")
+ASLAM_EIGEN_YAML_SCALAR_TYPE_TAG(uint32_t, "uint32")
+ASLAM_EIGEN_YAML_SCALAR_TYPE_TAG(int64_t, "int64")
+ASLAM_EIGEN_YAML_SCALAR_TYPE_TAG(uint64_t, "uint64")
+#undef ASLAM_EIGEN_YAML_SCALAR_TYPE_TAG
+
+inline bool isHostLittleEndian() {
+  const uint16_t value = 1u;
+  return *reinterpret_cast<const unsigned char*>(&value) == 1u;
+}
+
+// Converts between the host and the little-endian byte order of the binary encoding.
+template <typename Scalar>
+void swapBytesOnBigEndianHost(Scalar* data, size_t num_scalars) {
+  if (isHostLittleEndian()) {
+    return;
+  }
+  for (size_t i = 0u; i < num_scalars; ++i) {
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(data + i);
+    std::reverse(bytes, bytes + sizeof(Scalar));
+  }
+}
+
+template <class Scalar, int A, int B, int C, int D, int E>
+bool decodeMatrixBinaryData(const Node& node, Eigen::Matrix<Scalar, A, B, C, D, E>* M) {
+  CHECK_NOTNULL(M);
+  typedef Eigen::Matrix<Scalar, A, B, C, D, E> MatrixType;
+  if (node["encoding"].as<std::string>() != kBinaryEncoding) {
+    LOG(ERROR) << "Unknown matrix data encoding " << node["encoding"].as<std::string>() << ".";
+    return false;
+  }
+  const std::string type = node["type"] ? node["type"].as<std::string>() : "";
+  if (type != ScalarTypeTag<Scalar>::name()) {
+    LOG(ERROR) << "The matrix has the wrong scalar type. Wanted: "
+        << ScalarTypeTag<Scalar>::name() << ", got: " << type;
+    return false;
+  }
+  const std::string storage_order =
+      node["storage_order"] ? node["storage_order"].as<std::string>() : "";
+  if (storage_order != kRowMajor && storage_order != kColumnMajor) {
+    LOG(ERROR) << "Unknown matrix storage order " << storage_order << ".";
+    return false;
+  }
+  if (!node["data"].IsScalar()) {
+    LOG(ERROR) << "The binary matrix data is not a string.";
+    return false;
+  }
+  const std::string data = node["data"].as<std::string>();
+  const size_t num_bytes = static_cast<size_t>(M->size()) * sizeof(Scalar);
+  const bool is_stored_row_major = storage_order == kRowMajor;
+  if (is_stored_row_major == static_cast<bool>(MatrixType::IsRowMajor) ||
+      M->rows() == 1 || M->cols() == 1) {
+    // Same memory layout, decode straight into the matrix.
+    if (!aslam::common::decodeBase64(data, M->data(), num_bytes)) {
+      LOG(ERROR) << "Invalid base64 matrix data of " << data.size() << " characters for "
+          << num_bytes << " bytes.";
+      return false;
+    }
+    swapBytesOnBigEndianHost(M->data(), static_cast<size_t>(M->size()));
+    return true;
+  }
+  typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic,
+                        MatrixType::IsRowMajor ? Eigen::ColMajor : Eigen::RowMajor>
+      TransposedLayoutMatrix;
+  TransposedLayoutMatrix stored(M->rows(), M->cols());
+  if (!aslam::common::decodeBase64(data, stored.data(), num_bytes)) {
+    LOG(ERROR) << "Invalid base64 matrix data of " << data.size() << " characters for "
+        << num_bytes << " bytes.";
+    return false;
+  }
+  swapBytesOnBigEndianHost(stored.data(), static_cast<size_t>(stored.size()));
+  *M = stored;
+  return true;
+}
+
+// Reads the data of a matrix that has already the size given by the node.
+template <class Scalar, int A, int B, int C, int D, int E>
+bool decodeMatrixData(const Node& node, Eigen::Matrix<Scalar, A, B, C, D, E>* M) {
+  CHECK_NOTNULL(M);
+  if (node["encoding"]) {
+    return decodeMatrixBinaryData(node, M);
+  }
+  typedef typename Eigen::Matrix<Scalar, A, B, C, D, E>::Index IndexType;
+  size_t expected_size = M->rows() * M->cols();
+  if (!node["data"].IsSequence()) {
+    LOG(ERROR) << "The matrix data is not a sequence.";
+    return false;
+  }
+  if(node["data"].size() != expected_size) {
+    LOG(ERROR) << "The data sequence is the wrong size. Wanted: " << expected_size <<
+        ", got: " << node["data"].size();
+    return false;
+  }
+
+  YAML::const_iterator it = node["data"].begin();
+  YAML::const_iterator it_end = node["data"].end();
+  for (IndexType i = 0; i < M->rows(); ++i) {
+    for (IndexType j = 0; j < M->cols(); ++j) {
+      CHECK(it != it_end);
+      (*M)(i, j) = it->as<Scalar>();
+      ++it;
+    }
+  }
+  return true;
+}
+}  // namespace eigen_yaml_internal
+
+/// \brief Encode a matrix compactly: The raw little-endian buffer in the storage order of the
+///        matrix is stored as a base64 string, tagged with the shape, the scalar type and the
+///        storage order. Decoding reads the string straight into the matrix buffer, which makes
+///        loading large matrices like masks and lookup tables bound by the I/O instead of the
+///        parsing of every element. The default encoding of a matrix node is the text sequence,
+///        both are decoded by the converter below.
+///
+///    node["mask"] = YAML::encodeMatrixBinary(mask);
+///
+///        A matrix with 0 rows or columns is stored with an empty data string.
+template <class Scalar, int A, int B, int C, int D, int E>
+Node encodeMatrixBinary(const Eigen::Matrix<Scalar, A, B, C, D, E>& M) {
+  Node node;
+  node["rows"] = M.rows();
+  node["cols"] = M.cols();
+  node["type"] = eigen_yaml_internal::ScalarTypeTag<Scalar>::name();
+  node["storage_order"] = Eigen::Matrix<Scalar, A, B, C, D, E>::IsRowMajor ?
+      eigen_yaml_internal::kRowMajor : eigen_yaml_internal::kColumnMajor;
+  node["encoding"] = eigen_yaml_internal::kBinaryEncoding;
+  const size_t num_bytes = static_cast<size_t>(M.size()) * sizeof(Scalar);
+  if (eigen_yaml_internal::isHostLittleEndian()) {
+    node["data"] = aslam::common::encodeBase64(M.data(), num_bytes);
+  } else {
+    std::vector<Scalar> little_endian_data(M.data(), M.data() + M.size());
+    eigen_yaml_internal::swapBytesOnBigEndianHost(little_endian_data.data(),
+                                                  little_endian_data.size());
+    node["data"] = aslam::common::encodeBase64(little_endian_data.data(), num_bytes);
+  }
+  return node;
+}
+
 // yaml serialization helper function for the Eigen3 Matrix object.
 // The matrix is a base class for dense matrices.
 // http://eigen.tuxfamily.org/dox-devel/TutorialMatrixClass.html
@@ -47,29 +212,7 @@ struct convert<Eigen::Matrix<Scalar_, A_, B_, C_, D_, E_> > {
       return false;
     }
 
-    size_t expected_size = M.rows() * M.cols();
-    if (!node["data"].IsSequence()) {
-      LOG(ERROR) << "The matrix data is not a sequence.";
-      return false;
-    }
-    if(node["data"].size() != expected_size) {
-      LOG(ERROR) << "The data sequence is the wrong size. Wanted: " << expected_size <<
-          ", got: " << node["data"].size();
-      return false;
-    }
-
-    YAML::const_iterator it = node["data"].begin();
-    YAML::const_iterator it_end = node["data"].end();
-    if (rows > 0 && cols > 0) {
-      for (IndexType i = 0; i < rows; ++i) {
-        for (IndexType j = 0; j < cols; ++j) {
-          CHECK(it != it_end);
-          M(i, j) = it->as<Scalar>();
-          ++it;
-        }
-      }
-    }
-    return true;
+    return eigen_yaml_internal::decodeMatrixData(node, &M);
   }
 
   template <class Scalar, int B, int C, int D, int E>
@@ -93,29 +236,7 @@ struct convert<Eigen::Matrix<Scalar_, A_, B_, C_, D_, E_> > {
 
     M.resize(rows, Eigen::NoChange);
 
-    size_t expected_size = M.rows() * M.cols();
-    if (!node["data"].IsSequence()) {
-      LOG(ERROR) << "The matrix data is not a sequence.";
-      return false;
-    }
-    if(node["data"].size() != expected_size) {
-      LOG(ERROR) << "The data sequence is the wrong size. Wanted: " << expected_size <<
-          ", got: " << node["data"].size();
-      return false;
-    }
-
-    YAML::const_iterator it = node["data"].begin();
-    YAML::const_iterator it_end = node["data"].end();
-    if (rows > 0 && cols > 0) {
-      for (IndexType i = 0; i < rows; ++i) {
-        for (IndexType j = 0; j < cols; ++j) {
-          CHECK(it != it_end);
-          M(i, j) = it->as<Scalar>();
-          ++it;
-        }
-      }
-    }
-    return true;
+    return eigen_yaml_internal::decodeMatrixData(node, &M);
   }
 
   template <class Scalar, int A, int C, int D, int E>
@@ -139,29 +260,7 @@ struct convert<Eigen::Matrix<Scalar_, A_, B_, C_, D_, E_> > {
 
     M.resize(Eigen::NoChange, cols);
 
-    size_t expected_size = M.rows() * M.cols();
-    if (!node["data"].IsSequence()) {
-      LOG(ERROR) << "The matrix data is not a sequence.";
-      return false;
-    }
-    if(node["data"].size() != expected_size) {
-      LOG(ERROR) << "The data sequence is the wrong size. Wanted: " << expected_size <<
-          ", got: " << node["data"].size();
-      return false;
-    }
-
-    YAML::const_iterator it = node["data"].begin();
-    YAML::const_iterator it_end = node["data"].end();
-    if (rows > 0 && cols > 0) {
-      for (IndexType i = 0; i < rows; ++i) {
-        for (IndexType j = 0; j < cols; ++j) {
-          CHECK(it != it_end);
-          M(i, j) = it->as<Scalar>();
-          ++it;
-        }
-      }
-    }
-    return true;
+    return eigen_yaml_internal::decodeMatrixData(node, &M);
   }
 
   template <class Scalar, int C, int D, int E>
@@ -180,28 +279,7 @@ struct convert<Eigen::Matrix<Scalar_, A_, B_, C_, D_, E_> > {
 
     M.resize(rows, cols);
 
-    size_t expected_size = M.rows() * M.cols();
-    if (!node["data"].IsSequence()) {
-      LOG(ERROR) << "The matrix data is not a sequence.";
-      return false;
-    }
-    if(node["data"].size() != expected_size) {
-      LOG(ERROR) << "The data sequence is the wrong size. Wanted: " << expected_size <<
-          ", got: " << node["data"].size();
-      return false;
-    }
-    YAML::const_iterator it = node["data"].begin();
-    YAML::const_iterator it_end = node["data"].end();
-    if (rows > 0 && cols > 0) {
-      for (IndexType i = 0; i < rows; ++i) {
-        for (IndexType j = 0; j < cols; ++j) {
-          CHECK(it != it_end);
-          M(i, j) = it->as<Scalar>();
-          ++it;
-        }
-      }
-    }
-    return true;
+    return eigen_yaml_internal::decodeMatrixData(node, &M);
   }
 };
 }  // namespace YAML
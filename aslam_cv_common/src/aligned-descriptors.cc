@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include <aslam/common/aligned-descriptors.h>
+
+namespace aslam {
+namespace common {
+
+AlignedDescriptors::AlignedDescriptors()
+    : descriptor_size_bytes_(0u), stride_bytes_(0u), num_descriptors_(0u), capacity_bytes_(0u),
+      data_(nullptr) {}
+
+AlignedDescriptors::AlignedDescriptors(const DescriptorsT& descriptors)
+    : AlignedDescriptors() {
+  setDescriptors(descriptors);
+}
+
+size_t AlignedDescriptors::getStrideBytes(size_t descriptor_size_bytes) {
+  return (descriptor_size_bytes + kStrideAlignmentBytes - 1u) / kStrideAlignmentBytes *
+      kStrideAlignmentBytes;
+}
+
+void AlignedDescriptors::resize(size_t descriptor_size_bytes, size_t num_descriptors) {
+  const size_t stride_bytes = getStrideBytes(descriptor_size_bytes);
+  const size_t size_bytes = stride_bytes * num_descriptors;
+  if (size_bytes > capacity_bytes_ || !buffer_) {
+    buffer_.reset(new unsigned char[size_bytes + kBaseAlignmentBytes]);
+    capacity_bytes_ = size_bytes;
+    const uintptr_t address = reinterpret_cast<uintptr_t>(buffer_.get());
+    data_ = buffer_.get() +
+        (kBaseAlignmentBytes - address % kBaseAlignmentBytes) % kBaseAlignmentBytes;
+  }
+  descriptor_size_bytes_ = descriptor_size_bytes;
+  stride_bytes_ = stride_bytes;
+  num_descriptors_ = num_descriptors;
+  std::memset(data_, 0, size_bytes);
+}
+
+void AlignedDescriptors::setDescriptors(const DescriptorsT& descriptors) {
+  resize(static_cast<size_t>(descriptors.rows()), static_cast<size_t>(descriptors.cols()));
+  if (descriptor_size_bytes_ == 0u) {
+    return;
+  }
+  for (size_t i = 0u; i < num_descriptors_; ++i) {
+    std::memcpy(data_ + stride_bytes_ * i, descriptors.col(i).data(), descriptor_size_bytes_);
+  }
+}
+
+AlignedDescriptors::ConstDescriptorsMap AlignedDescriptors::getDescriptors() const {
+  return ConstDescriptorsMap(data_, descriptor_size_bytes_, num_descriptors_,
+                             Eigen::OuterStride<>(std::max<size_t>(stride_bytes_, 1u)));
+}
+
+AlignedDescriptors::DescriptorsMap AlignedDescriptors::getDescriptorsMutable() {
+  return DescriptorsMap(data_, descriptor_size_bytes_, num_descriptors_,
+                        Eigen::OuterStride<>(std::max<size_t>(stride_bytes_, 1u)));
+}
+
+void computeHammingDistancesBatch(
+    const unsigned char* query, const AlignedDescriptors& descriptors,
+    const std::vector<int>& candidate_indices, std::vector<Hamming::ResultType>* out_distances) {
+  CHECK_NOTNULL(out_distances)->resize(candidate_indices.size());
+  if (candidate_indices.empty()) {
+    return;
+  }
+  CHECK_NOTNULL(query);
+  for (const int candidate_index : candidate_indices) {
+    DCHECK_GE(candidate_index, 0);
+    DCHECK_LT(candidate_index, static_cast<int>(descriptors.size()));
+  }
+  const size_t stride_bytes = descriptors.getStrideBytes();
+  if (stride_bytes == 0u) {
+    std::fill(out_distances->begin(), out_distances->end(), 0);
+    return;
+  }
+  Hamming::evaluateBatch(
+      query, descriptors.data(), stride_bytes, candidate_indices.data(), candidate_indices.size(),
+      static_cast<int>(stride_bytes), out_distances->data());
+}
+
+void computeHammingDistancesBatchBounded(
+    const unsigned char* query, const AlignedDescriptors& descriptors,
+    const std::vector<int>& candidate_indices, const Hamming::ResultType max_distance,
+    std::vector<Hamming::ResultType>* out_distances,
+    const Hamming::FixedSizeBatchFunction fixed_size_function) {
+  CHECK_NOTNULL(out_distances)->resize(candidate_indices.size());
+  if (candidate_indices.empty()) {
+    return;
+  }
+  CHECK_NOTNULL(query);
+  for (const int candidate_index : candidate_indices) {
+    DCHECK_GE(candidate_index, 0);
+    DCHECK_LT(candidate_index, static_cast<int>(descriptors.size()));
+  }
+  const size_t stride_bytes = descriptors.getStrideBytes();
+  if (stride_bytes == 0u) {
+    std::fill(out_distances->begin(), out_distances->end(), 0);
+    return;
+  }
+  if (fixed_size_function != nullptr) {
+    fixed_size_function(query, descriptors.data(), stride_bytes, candidate_indices.data(),
+                        candidate_indices.size(), out_distances->data());
+    return;
+  }
+  Hamming::evaluateBatchBounded(
+      query, descriptors.data(), stride_bytes, candidate_indices.data(), candidate_indices.size(),
+      static_cast<int>(stride_bytes), max_distance, out_distances->data());
+}
+
+}  // namespace common
+}  // namespace aslam
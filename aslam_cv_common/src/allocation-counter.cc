@@ -0,0 +1,117 @@
+#include "aslam/common/allocation-counter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include <glog/logging.h>
+
+#include <aslam/common/real-time.h>
+
+namespace aslam {
+namespace common {
+namespace {
+// Plain old data, such that accessing it from within operator new never allocates.
+thread_local AllocationCounter* innermost_counter = nullptr;
+// Set while the counters update the statistics, whose allocations are not counted.
+thread_local bool is_recording_paused = false;
+std::atomic<bool> allocation_hooks_installed(false);
+std::atomic<size_t> num_process_heap_allocations(0u);
+
+// Keyed by the name pointer, such that updating a known subsystem does not allocate.
+typedef std::map<const char*, AllocationStatistics> SubsystemStatisticsMap;
+std::mutex& getStatisticsMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+SubsystemStatisticsMap& getSubsystemStatistics() {
+  static SubsystemStatisticsMap statistics;
+  return statistics;
+}
+}  // namespace
+
+AllocationCounter::AllocationCounter(const char* subsystem_name)
+    : subsystem_name_(subsystem_name), parent_(innermost_counter), num_allocations_(0u),
+      num_allocated_bytes_(0u), num_deallocations_(0u) {
+  innermost_counter = this;
+}
+
+AllocationCounter::~AllocationCounter() {
+  CHECK_EQ(innermost_counter, this) << "Allocation counters must be destroyed in reverse order "
+                                    << "on the thread that created them.";
+  innermost_counter = parent_;
+  if (subsystem_name_ == nullptr || !areAllocationHooksInstalled()) {
+    return;
+  }
+  is_recording_paused = true;
+  {
+    std::lock_guard<std::mutex> lock(getStatisticsMutex());
+    AllocationStatistics& statistics = getSubsystemStatistics()[subsystem_name_];
+    ++statistics.num_scopes;
+    statistics.num_allocations += num_allocations_;
+    statistics.num_allocated_bytes += num_allocated_bytes_;
+    statistics.max_num_allocations_per_scope =
+        std::max(statistics.max_num_allocations_per_scope, num_allocations_);
+  }
+  is_recording_paused = false;
+}
+
+std::map<std::string, AllocationStatistics> getAllocationStatistics() {
+  std::lock_guard<std::mutex> lock(getStatisticsMutex());
+  // Subsystems with the same name in different translation units are merged.
+  std::map<std::string, AllocationStatistics> statistics_by_name;
+  for (const SubsystemStatisticsMap::value_type& subsystem : getSubsystemStatistics()) {
+    AllocationStatistics& statistics = statistics_by_name[subsystem.first];
+    statistics.num_scopes += subsystem.second.num_scopes;
+    statistics.num_allocations += subsystem.second.num_allocations;
+    statistics.num_allocated_bytes += subsystem.second.num_allocated_bytes;
+    statistics.max_num_allocations_per_scope = std::max(
+        statistics.max_num_allocations_per_scope, subsystem.second.max_num_allocations_per_scope);
+  }
+  return statistics_by_name;
+}
+
+void resetAllocationStatistics() {
+  std::lock_guard<std::mutex> lock(getStatisticsMutex());
+  getSubsystemStatistics().clear();
+}
+
+bool areAllocationHooksInstalled() {
+  return allocation_hooks_installed;
+}
+
+size_t getNumProcessHeapAllocations() {
+  return num_process_heap_allocations.load(std::memory_order_relaxed);
+}
+
+namespace internal {
+void recordHeapAllocation(size_t num_bytes) {
+  num_process_heap_allocations.fetch_add(1u, std::memory_order_relaxed);
+  if (is_recording_paused) {
+    return;
+  }
+  for (AllocationCounter* counter = innermost_counter; counter != nullptr;
+       counter = counter->parent_) {
+    ++counter->num_allocations_;
+    counter->num_allocated_bytes_ += num_bytes;
+  }
+  checkSteadyStateAllocation(num_bytes);
+}
+
+void recordHeapDeallocation() {
+  if (is_recording_paused) {
+    return;
+  }
+  for (AllocationCounter* counter = innermost_counter; counter != nullptr;
+       counter = counter->parent_) {
+    ++counter->num_deallocations_;
+  }
+}
+
+void setAllocationHooksInstalled() {
+  allocation_hooks_installed = true;
+}
+}  // namespace internal
+
+}  // namespace common
+}  // namespace aslam
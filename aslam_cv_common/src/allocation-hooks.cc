@@ -0,0 +1,72 @@
+// Replaces the global operator new and delete to observe the heap allocations in allocation
+// counters and steady state scopes, see aslam/common/allocation-counter.h and
+// aslam/common/real-time.h. Built as a separate library such that only the
+// executables which link it are affected.
+#include <cstdlib>
+#include <new>
+
+#include <aslam/common/allocation-counter.h>
+
+namespace {
+void* allocate(size_t num_bytes) {
+  aslam::common::internal::recordHeapAllocation(num_bytes);
+  void* data = std::malloc(num_bytes == 0u ? 1u : num_bytes);
+  if (data == nullptr) {
+    throw std::bad_alloc();
+  }
+  return data;
+}
+
+void deallocate(void* data) {
+  if (data != nullptr) {
+    aslam::common::internal::recordHeapDeallocation();
+    std::free(data);
+  }
+}
+
+struct AllocationHooksInstaller {
+  AllocationHooksInstaller() { aslam::common::internal::setAllocationHooksInstalled(); }
+} allocation_hooks_installer;
+}  // namespace
+
+void* operator new(size_t num_bytes) {
+  return allocate(num_bytes);
+}
+
+void* operator new[](size_t num_bytes) {
+  return allocate(num_bytes);
+}
+
+void* operator new(size_t num_bytes, const std::nothrow_t&) noexcept {
+  aslam::common::internal::recordHeapAllocation(num_bytes);
+  return std::malloc(num_bytes == 0u ? 1u : num_bytes);
+}
+
+void* operator new[](size_t num_bytes, const std::nothrow_t&) noexcept {
+  aslam::common::internal::recordHeapAllocation(num_bytes);
+  return std::malloc(num_bytes == 0u ? 1u : num_bytes);
+}
+
+void operator delete(void* data) noexcept {
+  deallocate(data);
+}
+
+void operator delete[](void* data) noexcept {
+  deallocate(data);
+}
+
+void operator delete(void* data, size_t) noexcept {
+  deallocate(data);
+}
+
+void operator delete[](void* data, size_t) noexcept {
+  deallocate(data);
+}
+
+void operator delete(void* data, const std::nothrow_t&) noexcept {
+  deallocate(data);
+}
+
+void operator delete[](void* data, const std::nothrow_t&) noexcept {
+  deallocate(data);
+}
@@ -0,0 +1,100 @@
+#include "aslam/common/base64.h"
+
+#include <cstdint>
+
+namespace aslam {
+namespace common {
+namespace {
+constexpr char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+constexpr uint8_t kInvalid = 0xffu;
+
+// Reverse lookup of the alphabet, built once.
+struct DecodingTable {
+  DecodingTable() {
+    for (int i = 0; i < 256; ++i) {
+      values[i] = kInvalid;
+    }
+    for (uint8_t i = 0u; i < 64u; ++i) {
+      values[static_cast<unsigned char>(kAlphabet[i])] = i;
+    }
+  }
+  uint8_t values[256];
+};
+
+inline bool decodeQuad(const DecodingTable& table, const char* quad, uint32_t* bits) {
+  *bits = 0u;
+  for (int i = 0; i < 4; ++i) {
+    const uint8_t value = table.values[static_cast<unsigned char>(quad[i])];
+    if (value == kInvalid) {
+      return false;
+    }
+    *bits = (*bits << 6) | value;
+  }
+  return true;
+}
+}  // namespace
+
+std::string encodeBase64(const void* data, size_t num_bytes) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  std::string encoded(getBase64EncodedSize(num_bytes), '=');
+  char* out = &encoded[0];
+  size_t byte_idx = 0u;
+  for (; byte_idx + 3u <= num_bytes; byte_idx += 3u, out += 4) {
+    const uint32_t bits = (static_cast<uint32_t>(bytes[byte_idx]) << 16) |
+        (static_cast<uint32_t>(bytes[byte_idx + 1u]) << 8) | bytes[byte_idx + 2u];
+    out[0] = kAlphabet[(bits >> 18) & 0x3f];
+    out[1] = kAlphabet[(bits >> 12) & 0x3f];
+    out[2] = kAlphabet[(bits >> 6) & 0x3f];
+    out[3] = kAlphabet[bits & 0x3f];
+  }
+  const size_t num_remaining_bytes = num_bytes - byte_idx;
+  if (num_remaining_bytes > 0u) {
+    uint32_t bits = static_cast<uint32_t>(bytes[byte_idx]) << 16;
+    if (num_remaining_bytes == 2u) {
+      bits |= static_cast<uint32_t>(bytes[byte_idx + 1u]) << 8;
+    }
+    out[0] = kAlphabet[(bits >> 18) & 0x3f];
+    out[1] = kAlphabet[(bits >> 12) & 0x3f];
+    if (num_remaining_bytes == 2u) {
+      out[2] = kAlphabet[(bits >> 6) & 0x3f];
+    }
+  }
+  return encoded;
+}
+
+bool decodeBase64(const std::string& encoded, void* data, size_t num_bytes) {
+  if (encoded.size() != getBase64EncodedSize(num_bytes)) {
+    return false;
+  }
+  static const DecodingTable kTable;
+  unsigned char* bytes = static_cast<unsigned char*>(data);
+  const char* in = encoded.data();
+  size_t byte_idx = 0u;
+  uint32_t bits;
+  for (; byte_idx + 3u <= num_bytes; byte_idx += 3u, in += 4) {
+    if (!decodeQuad(kTable, in, &bits)) {
+      return false;
+    }
+    bytes[byte_idx] = static_cast<unsigned char>(bits >> 16);
+    bytes[byte_idx + 1u] = static_cast<unsigned char>(bits >> 8);
+    bytes[byte_idx + 2u] = static_cast<unsigned char>(bits);
+  }
+  const size_t num_remaining_bytes = num_bytes - byte_idx;
+  if (num_remaining_bytes > 0u) {
+    // Replace the padding by a valid character and check it separately.
+    char quad[4] = {in[0], in[1], num_remaining_bytes == 2u ? in[2] : 'A', 'A'};
+    if (in[3] != '=' || (num_remaining_bytes == 1u && in[2] != '=') ||
+        !decodeQuad(kTable, quad, &bits)) {
+      return false;
+    }
+    bytes[byte_idx] = static_cast<unsigned char>(bits >> 16);
+    if (num_remaining_bytes == 2u) {
+      bytes[byte_idx + 1u] = static_cast<unsigned char>(bits >> 8);
+    }
+  }
+  return true;
+}
+
+}  // namespace common
+}  // namespace aslam
@@ -0,0 +1,101 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <aslam/common/hamming.h>
+#include <aslam/common/memory.h>
+
+DEFINE_int32(num_descriptors, 2000,
+             "Number of descriptors every query is compared against.");
+DEFINE_int32(num_repetitions, 200, "Number of passes over the descriptors.");
+
+// Compares the available Hamming kernels on the common binary descriptor
+// sizes (48 byte BRISK/FREAK, 64 byte and 96 byte).
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+
+#ifdef __ARM_NEON__
+  LOG(INFO) << "Only the NEON kernel is available on this platform.";
+#else
+  typedef aslam::common::Hamming Hamming;
+  CHECK_GT(FLAGS_num_descriptors, 0);
+  CHECK_GT(FLAGS_num_repetitions, 0);
+
+  const Hamming::Implementation kImplementations[] = {
+      Hamming::Implementation::kSSSE3, Hamming::Implementation::kAVX2,
+      Hamming::Implementation::kAVX512};
+  const int kDescriptorSizesBytes[] = {48, 64, 96};
+
+  LOG(INFO) << "Runtime dispatch selected: "
+            << Hamming::getImplementationName(
+                   Hamming::getBestSupportedImplementation());
+
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> byte_distribution(0, 255);
+
+  for (const int descriptor_size : kDescriptorSizesBytes) {
+    // Eigen's aligned allocator guarantees the 16 byte alignment required by
+    // the SSSE3 kernel.
+    Aligned<std::vector, unsigned char> descriptors(
+        static_cast<size_t>(FLAGS_num_descriptors) * descriptor_size);
+    Aligned<std::vector, unsigned char> query(descriptor_size);
+    for (unsigned char& byte : descriptors) {
+      byte = static_cast<unsigned char>(byte_distribution(generator));
+    }
+    for (unsigned char& byte : query) {
+      byte = static_cast<unsigned char>(byte_distribution(generator));
+    }
+
+    int64_t reference_checksum = -1;
+    for (const Hamming::Implementation implementation : kImplementations) {
+      if (!Hamming::isImplementationSupported(implementation)) {
+        std::cout << std::setw(8) << descriptor_size << " bytes  "
+                  << std::setw(8) << Hamming::getImplementationName(
+                      implementation) << "  not supported" << std::endl;
+        continue;
+      }
+      const Hamming::PopcntFunction popcnt =
+          Hamming::getPopcntFunction(implementation);
+      const int num_words = descriptor_size / 16;
+
+      int64_t checksum = 0;
+      const std::chrono::steady_clock::time_point start =
+          std::chrono::steady_clock::now();
+      for (int repetition = 0; repetition < FLAGS_num_repetitions;
+           ++repetition) {
+        for (int i = 0; i < FLAGS_num_descriptors; ++i) {
+          checksum += popcnt(query.data(),
+                             descriptors.data() + i * descriptor_size,
+                             num_words);
+        }
+      }
+      const double elapsed_ns = std::chrono::duration<double, std::nano>(
+          std::chrono::steady_clock::now() - start).count();
+
+      if (reference_checksum < 0) {
+        reference_checksum = checksum;
+      }
+      CHECK_EQ(reference_checksum, checksum)
+          << Hamming::getImplementationName(implementation)
+          << " disagrees with the previous kernels.";
+
+      const double num_evaluations =
+          static_cast<double>(FLAGS_num_descriptors) * FLAGS_num_repetitions;
+      std::cout << std::setw(8) << descriptor_size << " bytes  "
+                << std::setw(8) << Hamming::getImplementationName(
+                    implementation) << "  " << std::fixed
+                << std::setprecision(2) << elapsed_ns / num_evaluations
+                << " ns/distance" << std::endl;
+    }
+  }
+#endif  // __ARM_NEON__
+  return 0;
+}
@@ -211,5 +211,155 @@ bool serializeToBuffer(const cv::Mat& image, char** buffer, size_t* size) {
   return success;
 }
 
+bool serializeToString(const std::vector<cv::Mat>& images, std::string* string) {
+  CHECK_NOTNULL(string);
+  const uint64_t num_images = images.size();
+  string->assign(reinterpret_cast<const char*>(&num_images), sizeof(num_images));
+  std::string image_string;
+  for (const cv::Mat& image : images) {
+    // Pyramid levels are usually views into padded images.
+    if (!serializeToString(image.isContinuous() ? image : image.clone(), &image_string)) {
+      return false;
+    }
+    const uint64_t image_size = image_string.size();
+    string->append(reinterpret_cast<const char*>(&image_size), sizeof(image_size));
+    string->append(image_string);
+  }
+  return true;
+}
+
+bool deSerializeFromString(const std::string& string, std::vector<cv::Mat>* images) {
+  CHECK_NOTNULL(images);
+  return deSerializeFromBuffer(string.data(), string.size(), images);
+}
+
+bool deSerializeFromBuffer(const char* const buffer, size_t size, std::vector<cv::Mat>* images) {
+  CHECK_NOTNULL(buffer);
+  CHECK_NOTNULL(images);
+  uint64_t num_images;
+  CHECK_GE(size, sizeof(num_images));
+  memcpy(&num_images, buffer, sizeof(num_images));
+  size_t offset = sizeof(num_images);
+  images->resize(num_images);
+  for (cv::Mat& image : *images) {
+    uint64_t image_size;
+    CHECK_GE(size, offset + sizeof(image_size));
+    memcpy(&image_size, buffer + offset, sizeof(image_size));
+    offset += sizeof(image_size);
+    CHECK_GE(size, offset + image_size);
+    if (!deSerializeFromBuffer(buffer + offset, image_size, &image)) {
+      return false;
+    }
+    offset += image_size;
+  }
+  CHECK_EQ(offset, size);
+  return true;
+}
+
+bool serializeToBuffer(const std::vector<cv::Mat>& images, char** buffer, size_t* size) {
+  CHECK_NOTNULL(buffer);
+  CHECK_NOTNULL(size);
+  std::string images_string;
+  if (!serializeToString(images, &images_string)) {
+    return false;
+  }
+  *size = images_string.size();
+  *buffer = new char[*size];
+  memcpy(*buffer, images_string.data(), *size);
+  return true;
+}
+
+bool serializeToSink(const cv::Mat& image, SerializationSink* sink) {
+  CHECK_NOTNULL(sink);
+  CHECK_EQ(image.dims, 2) << "This method only works for 2D arrays";
+  HeaderInformation header;
+  header.rows = image.rows;
+  header.cols = image.cols;
+  header.depth = image.depth();
+  header.channels = image.channels();
+  char header_buffer[sizeof(HeaderInformation)];
+  CHECK_LE(header.size(), sizeof(header_buffer));
+  if (!header.serializeToBuffer(header_buffer, 0) ||
+      !sink->write(header_buffer, header.size())) {
+    return false;
+  }
+  if (image.isContinuous()) {
+    return sink->writePersistent(reinterpret_cast<const char*>(image.data),
+                                 image.total() * image.elemSize());
+  }
+  const size_t row_size_bytes = image.cols * image.elemSize();
+  for (int row = 0; row < image.rows; ++row) {
+    if (!sink->writePersistent(image.ptr<char>(row), row_size_bytes)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool deSerializeFromSource(DeSerializationSource* source, size_t size, cv::Mat* image) {
+  CHECK_NOTNULL(source);
+  CHECK_NOTNULL(image);
+  HeaderInformation header;
+  CHECK_GE(size, header.size());
+  char header_buffer[sizeof(HeaderInformation)];
+  if (!source->read(header_buffer, header.size()) ||
+      !header.deSerializeFromBuffer(header_buffer, 0)) {
+    LOG(ERROR) << "Failed to deserialize the image header.";
+    return false;
+  }
+  CHECK_LE(header.depth, static_cast<uint32_t>(CV_64F)) << "cv::Mat depth " << header.depth
+      << " is not supported for serialization.";
+  // Create should only allocate if necessary.
+  image->create(header.rows, header.cols, CV_MAKETYPE(header.depth, header.channels));
+  const size_t image_size = image->total() * image->elemSize();
+  CHECK_EQ(size, image_size + header.size());
+  return source->read(reinterpret_cast<char*>(image->data), image_size);
+}
+
+bool serializeToSink(const std::vector<cv::Mat>& images, SerializationSink* sink) {
+  CHECK_NOTNULL(sink);
+  const uint64_t num_images = images.size();
+  if (!sink->write(reinterpret_cast<const char*>(&num_images), sizeof(num_images))) {
+    return false;
+  }
+  const size_t header_size = HeaderInformation().size();
+  for (const cv::Mat& image : images) {
+    const uint64_t image_size = header_size + image.total() * image.elemSize();
+    if (!sink->write(reinterpret_cast<const char*>(&image_size), sizeof(image_size)) ||
+        !serializeToSink(image, sink)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool deSerializeFromSource(DeSerializationSource* source, size_t size,
+                           std::vector<cv::Mat>* images) {
+  CHECK_NOTNULL(source);
+  CHECK_NOTNULL(images);
+  uint64_t num_images;
+  CHECK_GE(size, sizeof(num_images));
+  if (!source->read(reinterpret_cast<char*>(&num_images), sizeof(num_images))) {
+    return false;
+  }
+  size_t offset = sizeof(num_images);
+  images->resize(num_images);
+  for (cv::Mat& image : *images) {
+    uint64_t image_size;
+    CHECK_GE(size, offset + sizeof(image_size));
+    if (!source->read(reinterpret_cast<char*>(&image_size), sizeof(image_size))) {
+      return false;
+    }
+    offset += sizeof(image_size);
+    CHECK_GE(size, offset + image_size);
+    if (!deSerializeFromSource(source, image_size, &image)) {
+      return false;
+    }
+    offset += image_size;
+  }
+  CHECK_EQ(offset, size);
+  return true;
+}
+
 }  // namespace internal
 }  // namespace aslam
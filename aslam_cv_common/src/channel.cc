@@ -7,11 +7,90 @@
 namespace aslam {
 namespace channels {
 
+void ChannelBase::setLazyPayload(const aslam::internal::RawChannelData& raw_data,
+                                 const std::shared_ptr<const void>& buffer) {
+  CHECK(raw_data.size_bytes == 0u || raw_data.data != nullptr);
+  std::lock_guard<std::mutex> lock(m_lazy_payload_);
+  lazy_payload_.reset(new LazyPayload{raw_data, buffer});
+  has_lazy_payload_.store(true, std::memory_order_release);
+}
+
+void ChannelBase::load() const {
+  if (!has_lazy_payload_.load(std::memory_order_acquire)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_lazy_payload_);
+  if (!lazy_payload_) {
+    // Decoded by another thread while waiting for the lock.
+    return;
+  }
+  // Decoding only materializes the value the channel already represents, hence load() is const.
+  CHECK(const_cast<ChannelBase*>(this)->setValueFromRawData(lazy_payload_->raw_data))
+      << "The lazy payload of channel " << name() << " does not match the channel type.";
+  lazy_payload_.reset();
+  has_lazy_payload_.store(false, std::memory_order_release);
+}
+
+void ChannelBase::discardLazyPayload() {
+  if (!has_lazy_payload_.load(std::memory_order_acquire)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_lazy_payload_);
+  lazy_payload_.reset();
+  has_lazy_payload_.store(false, std::memory_order_release);
+}
+
+bool ChannelBase::getLazyRawData(aslam::internal::RawChannelData* raw_data) const {
+  CHECK_NOTNULL(raw_data);
+  if (!has_lazy_payload_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(m_lazy_payload_);
+  if (!lazy_payload_) {
+    return false;
+  }
+  *raw_data = lazy_payload_->raw_data;
+  return true;
+}
+
+bool ChannelBase::copyLazyPayloadFrom(const ChannelBase& other) {
+  if (!other.has_lazy_payload_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(other.m_lazy_payload_);
+  if (!other.lazy_payload_) {
+    return false;
+  }
+  setLazyPayload(other.lazy_payload_->raw_data, other.lazy_payload_->buffer);
+  return true;
+}
+
 template<>
 bool Channel<cv::Mat>::operator==(const Channel<cv::Mat>& other) {
+  load();
+  other.load();
   return cv::countNonZero(value_ != other.value_) == 0;
 }
 
+template<>
+bool Channel<std::vector<cv::Mat>>::operator==(const Channel<std::vector<cv::Mat>>& other) {
+  load();
+  other.load();
+  if (value_.size() != other.value_.size()) {
+    return false;
+  }
+  for (size_t i = 0u; i < value_.size(); ++i) {
+    if (value_[i].size() != other.value_[i].size() ||
+        value_[i].type() != other.value_[i].type()) {
+      return false;
+    }
+    if (!value_[i].empty() && cv::norm(value_[i], other.value_[i], cv::NORM_INF) != 0.0) {
+      return false;
+    }
+  }
+  return true;
+}
+
 ChannelGroup cloneChannelGroup(const ChannelGroup& channels) {
   std::lock_guard<std::mutex> lock(channels.m_channels_);
   ChannelGroup cloned_group;
@@ -23,6 +102,13 @@ ChannelGroup cloneChannelGroup(const ChannelGroup& channels) {
   return cloned_group;
 }
 
+ChannelGroup shareChannelGroup(const ChannelGroup& channels) {
+  std::lock_guard<std::mutex> lock(channels.m_channels_);
+  ChannelGroup shared_group;
+  shared_group.channels_ = channels.channels_;
+  return shared_group;
+}
+
 bool isChannelGroupEqual(const ChannelGroup& left_channels, const ChannelGroup& right_channels) {
   // Early exit if both groups are the same.
   if (&left_channels == &right_channels) {
@@ -39,12 +125,28 @@ bool isChannelGroupEqual(const ChannelGroup& left_channels, const ChannelGroup&
     if (it_right == right_channels.channels_.end()) {
       return false;
     }
-    if (!CHECK_NOTNULL(it_right->second.get())->compare(*left_channel_pair.second)) {
+    // Shared channels are equal without comparing the values.
+    if (it_right->second != left_channel_pair.second &&
+        !CHECK_NOTNULL(it_right->second.get())->compare(*left_channel_pair.second)) {
       return false;
     }
   }
   return true;
 }
 
+size_t getChannelGroupMemoryUsageBytes(const ChannelGroup& channels, const std::string& tag,
+                                       common::MemoryUsageReport* report) {
+  std::lock_guard<std::mutex> lock(channels.m_channels_);
+  size_t num_bytes = 0u;
+  for (const ChannelMap::value_type& channel : channels.channels_) {
+    const size_t num_channel_bytes = CHECK_NOTNULL(channel.second.get())->getMemoryUsageBytes();
+    if (report != nullptr) {
+      report->add(tag + "/" + channel.first, num_channel_bytes);
+    }
+    num_bytes += num_channel_bytes;
+  }
+  return num_bytes;
+}
+
 }  // namespace channels
 }  // namespace aslam
@@ -0,0 +1,164 @@
+#include "aslam/common/cpu.h"
+
+#include <atomic>
+
+DEFINE_string(aslam_force_isa, "",
+              "Use no kernels above this instruction set level, e.g. ssse3 or avx2. For testing "
+              "and benchmarking, empty selects the best level of the CPU.");
+
+// avx512vpopcntdq is only known to the CPU builtins of newer compilers.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ASLAM_CPU_X86
+#if (defined(__clang__) && __clang_major__ >= 7) || \
+    (!defined(__clang__) && __GNUC__ >= 8)
+#define ASLAM_CPU_WITH_AVX512_VPOPCNTDQ
+#endif
+#endif  // defined(__x86_64__) && defined(__GNUC__)
+
+namespace aslam {
+namespace common {
+namespace cpu {
+namespace {
+Features detectFeatures() {
+  Features features;
+#ifdef ASLAM_CPU_X86
+  __builtin_cpu_init();
+  features.ssse3 = __builtin_cpu_supports("ssse3");
+  features.popcnt = __builtin_cpu_supports("popcnt");
+  features.avx2 = __builtin_cpu_supports("avx2");
+  features.avx512f = __builtin_cpu_supports("avx512f");
+  features.avx512bw = __builtin_cpu_supports("avx512bw");
+#ifdef ASLAM_CPU_WITH_AVX512_VPOPCNTDQ
+  features.avx512vpopcntdq = __builtin_cpu_supports("avx512vpopcntdq");
+#endif  // ASLAM_CPU_WITH_AVX512_VPOPCNTDQ
+#endif  // ASLAM_CPU_X86
+#if defined(__ARM_NEON__) || defined(__ARM_NEON) || defined(__aarch64__)
+  features.neon = true;
+#endif
+  return features;
+}
+
+struct IsaName {
+  Isa isa;
+  const char* name;
+};
+const IsaName kIsaNames[] = {
+  {Isa::kGeneric, "generic"},
+  {Isa::kSSSE3, "ssse3"},
+  {Isa::kPopcnt, "popcnt"},
+  {Isa::kAVX2, "avx2"},
+  {Isa::kAVX512, "avx512"},
+  {Isa::kNEON, "neon"}
+};
+
+// The value of the forced level if no level is forced.
+constexpr int kNoForcedIsa = -1;
+
+int parseForcedIsaFlag() {
+  if (FLAGS_aslam_force_isa.empty()) {
+    return kNoForcedIsa;
+  }
+  Isa forced_isa;
+  CHECK(parseIsa(FLAGS_aslam_force_isa, &forced_isa))
+      << "Unknown instruction set level --aslam_force_isa=" << FLAGS_aslam_force_isa << ".";
+  CHECK(isIsaDetected(forced_isa)) << "The forced instruction set level "
+                                   << FLAGS_aslam_force_isa << " is not supported by the CPU.";
+  return static_cast<int>(forced_isa);
+}
+
+// The flag is parsed on first use.
+std::atomic<int>& getForcedIsaLevel() {
+  static std::atomic<int> forced_isa_level(parseForcedIsaFlag());
+  return forced_isa_level;
+}
+}  // namespace
+
+const Features& getFeatures() {
+  static const Features kFeatures = detectFeatures();
+  return kFeatures;
+}
+
+bool isIsaDetected(const Isa isa) {
+  const Features& features = getFeatures();
+  switch (isa) {
+    case Isa::kGeneric:
+      return true;
+    case Isa::kSSSE3:
+      return features.ssse3;
+    case Isa::kPopcnt:
+      return features.ssse3 && features.popcnt;
+    case Isa::kAVX2:
+      return features.popcnt && features.avx2;
+    case Isa::kAVX512:
+      return features.avx2 && features.avx512f && features.avx512bw &&
+          features.avx512vpopcntdq;
+    case Isa::kNEON:
+      return features.neon;
+    default:
+      LOG(FATAL) << "Unknown instruction set level: " << static_cast<int>(isa);
+  }
+  return false;
+}
+
+bool isIsaSupported(const Isa isa) {
+  if (!isIsaDetected(isa)) {
+    return false;
+  }
+  Isa forced_isa;
+  return !getForcedIsa(&forced_isa) || isa <= forced_isa;
+}
+
+bool getForcedIsa(Isa* isa) {
+  CHECK_NOTNULL(isa);
+  const int forced_isa_level = getForcedIsaLevel().load();
+  if (forced_isa_level == kNoForcedIsa) {
+    return false;
+  }
+  *isa = static_cast<Isa>(forced_isa_level);
+  return true;
+}
+
+void setForcedIsa(const Isa isa) {
+  CHECK(isIsaDetected(isa)) << "The forced instruction set level " << getIsaName(isa)
+                            << " is not supported by the CPU.";
+  getForcedIsaLevel().store(static_cast<int>(isa));
+}
+
+void clearForcedIsa() {
+  getForcedIsaLevel().store(kNoForcedIsa);
+}
+
+Isa getBestSupportedIsa() {
+  Isa best_isa = Isa::kGeneric;
+  for (const IsaName& isa_name : kIsaNames) {
+    if (isa_name.isa > best_isa && isIsaSupported(isa_name.isa)) {
+      best_isa = isa_name.isa;
+    }
+  }
+  return best_isa;
+}
+
+const char* getIsaName(const Isa isa) {
+  for (const IsaName& isa_name : kIsaNames) {
+    if (isa_name.isa == isa) {
+      return isa_name.name;
+    }
+  }
+  LOG(FATAL) << "Unknown instruction set level: " << static_cast<int>(isa);
+  return "unknown";
+}
+
+bool parseIsa(const std::string& name, Isa* isa) {
+  CHECK_NOTNULL(isa);
+  for (const IsaName& isa_name : kIsaNames) {
+    if (name == isa_name.name) {
+      *isa = isa_name.isa;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace cpu
+}  // namespace common
+}  // namespace aslam
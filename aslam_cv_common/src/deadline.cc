@@ -0,0 +1,97 @@
+#include "aslam/common/deadline.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <glog/logging.h>
+
+namespace aslam {
+namespace common {
+namespace {
+thread_local DeadlineScope* current_deadline_scope = nullptr;
+
+struct DegradationName {
+  Degradation degradation;
+  const char* name;
+};
+const DegradationName kDegradationNames[] = {
+    {Degradation::kCappedKeypoints, "capped_keypoints"},
+    {Degradation::kSkippedSubpixelRefinement, "skipped_subpixel_refinement"},
+    {Degradation::kShrunkSearchWindows, "shrunk_search_windows"},
+    {Degradation::kSkippedInferiorMatching, "skipped_inferior_matching"},
+    {Degradation::kSkippedLkTracking, "skipped_lk_tracking"},
+    {Degradation::kCutRansacIterations, "cut_ransac_iterations"}};
+}  // namespace
+
+constexpr int64_t Deadline::kUnboundedNanoseconds;
+
+std::string Degradations::toString() const {
+  std::string names;
+  for (const DegradationName& degradation_name : kDegradationNames) {
+    if (has(degradation_name.degradation)) {
+      names += (names.empty() ? "" : ",") + std::string(degradation_name.name);
+    }
+  }
+  return names.empty() ? "none" : names;
+}
+
+Deadline Deadline::fromStartTime(int64_t start_time_nanoseconds, int64_t budget_nanoseconds) {
+  CHECK_GE(budget_nanoseconds, 0);
+  CHECK_LT(budget_nanoseconds, kUnboundedNanoseconds - start_time_nanoseconds);
+  Deadline deadline;
+  deadline.deadline_time_nanoseconds_ = start_time_nanoseconds + budget_nanoseconds;
+  deadline.budget_nanoseconds_ = budget_nanoseconds;
+  return deadline;
+}
+
+int64_t Deadline::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t Deadline::getRemainingNanoseconds() const {
+  if (!isBounded()) {
+    return kUnboundedNanoseconds;
+  }
+  return std::max<int64_t>(deadline_time_nanoseconds_ - now(), 0);
+}
+
+double Deadline::getRemainingRatio() const {
+  if (!isBounded()) {
+    return 1.0;
+  }
+  if (budget_nanoseconds_ == 0) {
+    return 0.0;
+  }
+  return std::min(static_cast<double>(getRemainingNanoseconds()) / budget_nanoseconds_, 1.0);
+}
+
+DeadlineScope::DeadlineScope() : DeadlineScope(getCurrentDeadline()) {}
+
+DeadlineScope::DeadlineScope(const Deadline& deadline)
+    : deadline_(deadline), enclosing_scope_(current_deadline_scope) {
+  current_deadline_scope = this;
+}
+
+DeadlineScope::~DeadlineScope() {
+  CHECK_EQ(current_deadline_scope, this) << "The deadline scopes must be nested.";
+  current_deadline_scope = enclosing_scope_;
+  if (enclosing_scope_ != nullptr) {
+    enclosing_scope_->degradations_.add(degradations_);
+  }
+}
+
+const Deadline& DeadlineScope::getCurrentDeadline() {
+  static const Deadline kUnboundedDeadline;
+  return current_deadline_scope != nullptr ? current_deadline_scope->deadline_
+                                           : kUnboundedDeadline;
+}
+
+void DeadlineScope::addDegradation(Degradation degradation) {
+  if (current_deadline_scope != nullptr) {
+    current_deadline_scope->degradations_.add(degradation);
+  }
+}
+
+}  // namespace common
+}  // namespace aslam
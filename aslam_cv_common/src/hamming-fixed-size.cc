@@ -0,0 +1,82 @@
+#include <cstdint>
+#include <cstring>
+
+#include <glog/logging.h>
+#include <aslam/common/cpu.h>
+#include <aslam/common/hamming.h>
+
+// The kernels use the popcount instruction, which is not part of the SSSE3
+// baseline the library is built for. They are compiled with a function level
+// target attribute and only handed out if the CPU supports it.
+#if defined(__x86_64__) || defined(__i386__)
+#define ASLAM_POPCNT_TARGET __attribute__((target("popcnt")))
+#else
+#define ASLAM_POPCNT_TARGET
+#endif
+
+namespace aslam {
+namespace common {
+namespace {
+
+// Sums the popcounts of query_words ^ candidate over kNumWords 64 bit words.
+// The recursion is resolved at compile time, which unrolls the loop.
+template <int kNumWords>
+struct UnrolledXorPopcount {
+  ASLAM_POPCNT_TARGET static inline __attribute__((always_inline)) int compute(
+      const uint64_t* query_words, const unsigned char* candidate) {
+    uint64_t candidate_word;
+    std::memcpy(&candidate_word, candidate + 8 * (kNumWords - 1),
+                sizeof(candidate_word));
+    return __builtin_popcountll(query_words[kNumWords - 1] ^ candidate_word) +
+        UnrolledXorPopcount<kNumWords - 1>::compute(query_words, candidate);
+  }
+};
+
+template <>
+struct UnrolledXorPopcount<0> {
+  ASLAM_POPCNT_TARGET static inline __attribute__((always_inline)) int compute(
+      const uint64_t* /*query_words*/, const unsigned char* /*candidate*/) {
+    return 0;
+  }
+};
+
+template <int kSizeBytes>
+ASLAM_POPCNT_TARGET void FixedSizeBatchPopcntofXORed(
+    const unsigned char* query, const unsigned char* candidates,
+    const size_t candidate_stride_bytes, const int* candidate_indices,
+    const size_t num_candidates, Hamming::ResultType* distances) {
+  static_assert(kSizeBytes % 8 == 0, "Only whole 64 bit words are supported.");
+  constexpr int kNumWords = kSizeBytes / 8;
+  uint64_t query_words[kNumWords];
+  std::memcpy(query_words, query, kSizeBytes);
+  for (size_t i = 0u; i < num_candidates; ++i) {
+    distances[i] = UnrolledXorPopcount<kNumWords>::compute(
+        query_words,
+        candidates + candidate_stride_bytes * candidate_indices[i]);
+  }
+}
+}  // namespace
+
+Hamming::FixedSizeBatchFunction Hamming::getFixedSizeBatchFunction(
+    const int size) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (!cpu::isIsaSupported(cpu::Isa::kPopcnt)) {
+    return nullptr;
+  }
+#endif
+  switch (size) {
+    case 16:
+      return &FixedSizeBatchPopcntofXORed<16>;
+    case 32:
+      return &FixedSizeBatchPopcntofXORed<32>;
+    case 48:
+      return &FixedSizeBatchPopcntofXORed<48>;
+    case 64:
+      return &FixedSizeBatchPopcntofXORed<64>;
+    default:
+      return nullptr;
+  }
+}
+
+}  // namespace common
+}  // namespace aslam
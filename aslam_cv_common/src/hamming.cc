@@ -0,0 +1,420 @@
+#include <glog/logging.h>
+
+#include <aslam/common/cpu.h>
+#include <aslam/common/hamming.h>
+
+#ifndef __ARM_NEON__
+#include <immintrin.h>
+
+// The AVX kernels are compiled with function level target attributes, such
+// that the rest of the library keeps building with the baseline -mssse3.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ASLAM_HAMMING_WITH_AVX2
+#if (defined(__clang__) && __clang_major__ >= 7) || \
+    (!defined(__clang__) && __GNUC__ >= 8)
+#define ASLAM_HAMMING_WITH_AVX512
+#endif
+#endif  // defined(__x86_64__) && defined(__GNUC__)
+
+namespace aslam {
+namespace common {
+namespace {
+// Batched kernels keep the query in registers up to this size (1024 bits).
+constexpr int kMaxNumPreloaded128BitWords = 8;
+
+uint32_t SSSE3PopcntofXORedBytes(const unsigned char* signature1,
+                                 const unsigned char* signature2,
+                                 const int numberOf128BitWords) {
+  if (numberOf128BitWords <= 0) {
+    return 0u;
+  }
+  return Hamming::SSSE3PopcntofXORed(
+      reinterpret_cast<const __m128i*>(signature1),
+      reinterpret_cast<const __m128i*>(signature2), numberOf128BitWords);
+}
+
+void SSSE3BatchPopcntofXORed(const unsigned char* query,
+                             const unsigned char* candidates,
+                             const size_t candidate_stride_bytes,
+                             const int* candidate_indices,
+                             const size_t num_candidates,
+                             const int numberOf128BitWords,
+                             Hamming::ResultType* distances) {
+  for (size_t i = 0u; i < num_candidates; ++i) {
+    distances[i] = SSSE3PopcntofXORedBytes(
+        query, candidates + candidate_stride_bytes * candidate_indices[i],
+        numberOf128BitWords);
+  }
+}
+
+#ifdef ASLAM_HAMMING_WITH_AVX2
+// Per byte popcount using a nibble lookup table.
+__attribute__((target("avx2"))) inline __m256i AVX2PopcntBytes(
+    const __m256i value) {
+  const __m256i lookup = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  const __m256i low_nibbles = _mm256_and_si256(value, low_mask);
+  const __m256i high_nibbles =
+      _mm256_and_si256(_mm256_srli_epi16(value, 4), low_mask);
+  return _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low_nibbles),
+                         _mm256_shuffle_epi8(lookup, high_nibbles));
+}
+
+__attribute__((target("avx2"))) inline __m128i AVX2PopcntBytes128(
+    const __m128i value) {
+  const __m128i lookup = _mm_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m128i low_mask = _mm_set1_epi8(0x0f);
+  const __m128i low_nibbles = _mm_and_si128(value, low_mask);
+  const __m128i high_nibbles =
+      _mm_and_si128(_mm_srli_epi16(value, 4), low_mask);
+  return _mm_add_epi8(_mm_shuffle_epi8(lookup, low_nibbles),
+                      _mm_shuffle_epi8(lookup, high_nibbles));
+}
+
+// Sums up the bytes of the 256 bit word into four 64 bit counters.
+__attribute__((target("avx2"))) inline __m256i AVX2SumBytes(
+    const __m256i bytes) {
+  return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) inline uint32_t AVX2ReduceCounters(
+    const __m256i counters, const __m128i tail_counters) {
+  __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(counters),
+                              _mm256_extracti128_si256(counters, 1));
+  sum = _mm_add_epi64(sum, tail_counters);
+  sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+  return static_cast<uint32_t>(_mm_cvtsi128_si32(sum));
+}
+#endif  // ASLAM_HAMMING_WITH_AVX2
+
+#ifdef ASLAM_HAMMING_WITH_AVX512
+// Mask covering the first num_bytes bytes of a 512 bit word.
+inline __mmask64 getByteMask(const int num_bytes) {
+  return num_bytes >= 64 ? ~0ull : (1ull << num_bytes) - 1ull;
+}
+#endif  // ASLAM_HAMMING_WITH_AVX512
+}  // namespace
+
+#ifdef ASLAM_HAMMING_WITH_AVX2
+__attribute__((target("avx2")))
+uint32_t Hamming::AVX2PopcntofXORed(const unsigned char* signature1,
+                                    const unsigned char* signature2,
+                                    const int numberOf128BitWords) {
+  CHECK_NOTNULL(signature1);
+  CHECK_NOTNULL(signature2);
+
+  __m256i counters = _mm256_setzero_si256();
+  int word = 0;
+  for (; word + 2 <= numberOf128BitWords; word += 2) {
+    const __m256i xored = _mm256_xor_si256(
+        _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(signature1 + 16 * word)),
+        _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(signature2 + 16 * word)));
+    counters = _mm256_add_epi64(counters, AVX2SumBytes(AVX2PopcntBytes(xored)));
+  }
+
+  __m128i tail_counters = _mm_setzero_si128();
+  if (word < numberOf128BitWords) {
+    // Remaining 128 bit word, e.g. for 48 byte descriptors.
+    const __m128i xored = _mm_xor_si128(
+        _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(signature1 + 16 * word)),
+        _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(signature2 + 16 * word)));
+    tail_counters =
+        _mm_sad_epu8(AVX2PopcntBytes128(xored), _mm_setzero_si128());
+  }
+  return AVX2ReduceCounters(counters, tail_counters);
+}
+
+__attribute__((target("avx2")))
+void Hamming::AVX2BatchPopcntofXORed(const unsigned char* query,
+                                     const unsigned char* candidates,
+                                     const size_t candidate_stride_bytes,
+                                     const int* candidate_indices,
+                                     const size_t num_candidates,
+                                     const int numberOf128BitWords,
+                                     ResultType* distances) {
+  CHECK_NOTNULL(query);
+  CHECK_NOTNULL(candidates);
+  if (numberOf128BitWords > kMaxNumPreloaded128BitWords) {
+    for (size_t i = 0u; i < num_candidates; ++i) {
+      distances[i] = AVX2PopcntofXORed(
+          query, candidates + candidate_stride_bytes * candidate_indices[i],
+          numberOf128BitWords);
+    }
+    return;
+  }
+
+  const int num_256bit_words = numberOf128BitWords / 2;
+  const bool has_128bit_tail = (numberOf128BitWords % 2) != 0;
+  __m256i query_words[kMaxNumPreloaded128BitWords / 2];
+  for (int word = 0; word < num_256bit_words; ++word) {
+    query_words[word] = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(query + 32 * word));
+  }
+  const __m128i query_tail = has_128bit_tail ?
+      _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(query + 32 * num_256bit_words)) :
+      _mm_setzero_si128();
+
+  for (size_t i = 0u; i < num_candidates; ++i) {
+    const unsigned char* candidate =
+        candidates + candidate_stride_bytes * candidate_indices[i];
+    __m256i counters = _mm256_setzero_si256();
+    for (int word = 0; word < num_256bit_words; ++word) {
+      const __m256i xored = _mm256_xor_si256(
+          query_words[word], _mm256_loadu_si256(
+              reinterpret_cast<const __m256i*>(candidate + 32 * word)));
+      counters =
+          _mm256_add_epi64(counters, AVX2SumBytes(AVX2PopcntBytes(xored)));
+    }
+    __m128i tail_counters = _mm_setzero_si128();
+    if (has_128bit_tail) {
+      const __m128i xored = _mm_xor_si128(query_tail, _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(candidate + 32 * num_256bit_words)));
+      tail_counters =
+          _mm_sad_epu8(AVX2PopcntBytes128(xored), _mm_setzero_si128());
+    }
+    distances[i] = AVX2ReduceCounters(counters, tail_counters);
+  }
+}
+#else
+uint32_t Hamming::AVX2PopcntofXORed(const unsigned char* signature1,
+                                    const unsigned char* signature2,
+                                    const int numberOf128BitWords) {
+  LOG(FATAL) << "aslam_cv_common was built without the AVX2 Hamming kernel.";
+  return SSSE3PopcntofXORedBytes(signature1, signature2, numberOf128BitWords);
+}
+
+void Hamming::AVX2BatchPopcntofXORed(const unsigned char* query,
+                                     const unsigned char* candidates,
+                                     const size_t candidate_stride_bytes,
+                                     const int* candidate_indices,
+                                     const size_t num_candidates,
+                                     const int numberOf128BitWords,
+                                     ResultType* distances) {
+  LOG(FATAL) << "aslam_cv_common was built without the AVX2 Hamming kernel.";
+  SSSE3BatchPopcntofXORed(query, candidates, candidate_stride_bytes,
+                          candidate_indices, num_candidates,
+                          numberOf128BitWords, distances);
+}
+#endif  // ASLAM_HAMMING_WITH_AVX2
+
+#ifdef ASLAM_HAMMING_WITH_AVX512
+__attribute__((target("avx512f,avx512bw,avx512vpopcntdq")))
+uint32_t Hamming::AVX512PopcntofXORed(const unsigned char* signature1,
+                                      const unsigned char* signature2,
+                                      const int numberOf128BitWords) {
+  CHECK_NOTNULL(signature1);
+  CHECK_NOTNULL(signature2);
+
+  const int num_bytes = 16 * numberOf128BitWords;
+  __m512i accumulator = _mm512_setzero_si512();
+
+  for (int offset = 0; offset < num_bytes; offset += 64) {
+    // Masked loads do not touch the bytes past the end of the descriptor.
+    const __mmask64 mask = getByteMask(num_bytes - offset);
+    const __m512i xored = _mm512_xor_si512(
+        _mm512_maskz_loadu_epi8(mask, signature1 + offset),
+        _mm512_maskz_loadu_epi8(mask, signature2 + offset));
+    accumulator = _mm512_add_epi64(accumulator, _mm512_popcnt_epi64(xored));
+  }
+  return static_cast<uint32_t>(_mm512_reduce_add_epi64(accumulator));
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vpopcntdq")))
+void Hamming::AVX512BatchPopcntofXORed(const unsigned char* query,
+                                       const unsigned char* candidates,
+                                       const size_t candidate_stride_bytes,
+                                       const int* candidate_indices,
+                                       const size_t num_candidates,
+                                       const int numberOf128BitWords,
+                                       ResultType* distances) {
+  CHECK_NOTNULL(query);
+  CHECK_NOTNULL(candidates);
+  if (numberOf128BitWords > kMaxNumPreloaded128BitWords) {
+    for (size_t i = 0u; i < num_candidates; ++i) {
+      distances[i] = AVX512PopcntofXORed(
+          query, candidates + candidate_stride_bytes * candidate_indices[i],
+          numberOf128BitWords);
+    }
+    return;
+  }
+
+  const int num_bytes = 16 * numberOf128BitWords;
+  const int num_512bit_words = (num_bytes + 63) / 64;
+  __m512i query_words[kMaxNumPreloaded128BitWords / 4];
+  __mmask64 masks[kMaxNumPreloaded128BitWords / 4];
+  for (int word = 0; word < num_512bit_words; ++word) {
+    masks[word] = getByteMask(num_bytes - 64 * word);
+    query_words[word] = _mm512_maskz_loadu_epi8(masks[word], query + 64 * word);
+  }
+
+  for (size_t i = 0u; i < num_candidates; ++i) {
+    const unsigned char* candidate =
+        candidates + candidate_stride_bytes * candidate_indices[i];
+    __m512i accumulator = _mm512_setzero_si512();
+    for (int word = 0; word < num_512bit_words; ++word) {
+      const __m512i xored = _mm512_xor_si512(
+          query_words[word],
+          _mm512_maskz_loadu_epi8(masks[word], candidate + 64 * word));
+      accumulator = _mm512_add_epi64(accumulator, _mm512_popcnt_epi64(xored));
+    }
+    distances[i] = static_cast<ResultType>(
+        _mm512_reduce_add_epi64(accumulator));
+  }
+}
+#else
+uint32_t Hamming::AVX512PopcntofXORed(const unsigned char* signature1,
+                                      const unsigned char* signature2,
+                                      const int numberOf128BitWords) {
+  LOG(FATAL) << "aslam_cv_common was built without the AVX-512 Hamming "
+             << "kernel.";
+  return SSSE3PopcntofXORedBytes(signature1, signature2, numberOf128BitWords);
+}
+
+void Hamming::AVX512BatchPopcntofXORed(const unsigned char* query,
+                                       const unsigned char* candidates,
+                                       const size_t candidate_stride_bytes,
+                                       const int* candidate_indices,
+                                       const size_t num_candidates,
+                                       const int numberOf128BitWords,
+                                       ResultType* distances) {
+  LOG(FATAL) << "aslam_cv_common was built without the AVX-512 Hamming "
+             << "kernel.";
+  SSSE3BatchPopcntofXORed(query, candidates, candidate_stride_bytes,
+                          candidate_indices, num_candidates,
+                          numberOf128BitWords, distances);
+}
+#endif  // ASLAM_HAMMING_WITH_AVX512
+
+namespace {
+// The SSSE3 kernels are the baseline of the library build, hence registered as
+// the generic variant.
+cpu::Isa getIsa(const Hamming::Implementation implementation) {
+  switch (implementation) {
+    case Hamming::Implementation::kSSSE3:
+      return cpu::Isa::kGeneric;
+    case Hamming::Implementation::kAVX2:
+      return cpu::Isa::kAVX2;
+    case Hamming::Implementation::kAVX512:
+      return cpu::Isa::kAVX512;
+    default:
+      LOG(FATAL) << "Unknown Hamming implementation: "
+                 << static_cast<int>(implementation);
+  }
+  return cpu::Isa::kGeneric;
+}
+
+Hamming::Implementation getImplementation(const cpu::Isa isa) {
+  switch (isa) {
+    case cpu::Isa::kAVX2:
+      return Hamming::Implementation::kAVX2;
+    case cpu::Isa::kAVX512:
+      return Hamming::Implementation::kAVX512;
+    default:
+      return Hamming::Implementation::kSSSE3;
+  }
+}
+
+const cpu::KernelRegistry<Hamming::PopcntFunction>& getPopcntRegistry() {
+  static const cpu::KernelRegistry<Hamming::PopcntFunction> kRegistry = []() {
+    cpu::KernelRegistry<Hamming::PopcntFunction> registry("Hamming::Popcnt");
+    registry.add(cpu::Isa::kGeneric, &SSSE3PopcntofXORedBytes);
+#ifdef ASLAM_HAMMING_WITH_AVX2
+    registry.add(cpu::Isa::kAVX2, &Hamming::AVX2PopcntofXORed);
+#endif  // ASLAM_HAMMING_WITH_AVX2
+#ifdef ASLAM_HAMMING_WITH_AVX512
+    registry.add(cpu::Isa::kAVX512, &Hamming::AVX512PopcntofXORed);
+#endif  // ASLAM_HAMMING_WITH_AVX512
+    return registry;
+  }();
+  return kRegistry;
+}
+
+const cpu::KernelRegistry<Hamming::BatchPopcntFunction>&
+getBatchPopcntRegistry() {
+  static const cpu::KernelRegistry<Hamming::BatchPopcntFunction> kRegistry =
+      []() {
+    cpu::KernelRegistry<Hamming::BatchPopcntFunction> registry(
+        "Hamming::BatchPopcnt");
+    registry.add(cpu::Isa::kGeneric, &SSSE3BatchPopcntofXORed);
+#ifdef ASLAM_HAMMING_WITH_AVX2
+    registry.add(cpu::Isa::kAVX2, &Hamming::AVX2BatchPopcntofXORed);
+#endif  // ASLAM_HAMMING_WITH_AVX2
+#ifdef ASLAM_HAMMING_WITH_AVX512
+    registry.add(cpu::Isa::kAVX512, &Hamming::AVX512BatchPopcntofXORed);
+#endif  // ASLAM_HAMMING_WITH_AVX512
+    return registry;
+  }();
+  return kRegistry;
+}
+}  // namespace
+
+bool Hamming::isImplementationSupported(const Implementation implementation) {
+  switch (implementation) {
+    case Implementation::kSSSE3:
+      return true;
+    case Implementation::kAVX2:
+#ifdef ASLAM_HAMMING_WITH_AVX2
+      return cpu::isIsaSupported(cpu::Isa::kAVX2);
+#else
+      return false;
+#endif  // ASLAM_HAMMING_WITH_AVX2
+    case Implementation::kAVX512:
+#ifdef ASLAM_HAMMING_WITH_AVX512
+      return cpu::isIsaSupported(cpu::Isa::kAVX512);
+#else
+      return false;
+#endif  // ASLAM_HAMMING_WITH_AVX512
+    default:
+      LOG(FATAL) << "Unknown Hamming implementation: "
+                 << static_cast<int>(implementation);
+  }
+  return false;
+}
+
+Hamming::Implementation Hamming::getBestSupportedImplementation() {
+  cpu::Isa isa;
+  CHECK(getPopcntRegistry().getBestIsa(&isa));
+  return getImplementation(isa);
+}
+
+Hamming::PopcntFunction Hamming::getPopcntFunction(
+    const Implementation implementation) {
+  CHECK(isImplementationSupported(implementation))
+      << "The Hamming implementation " << getImplementationName(implementation)
+      << " is not supported on this machine.";
+  return getPopcntRegistry().get(getIsa(implementation));
+}
+
+Hamming::BatchPopcntFunction Hamming::getBatchPopcntFunction(
+    const Implementation implementation) {
+  CHECK(isImplementationSupported(implementation))
+      << "The Hamming implementation " << getImplementationName(implementation)
+      << " is not supported on this machine.";
+  return getBatchPopcntRegistry().get(getIsa(implementation));
+}
+
+const char* Hamming::getImplementationName(
+    const Implementation implementation) {
+  switch (implementation) {
+    case Implementation::kSSSE3:
+      return "SSSE3";
+    case Implementation::kAVX2:
+      return "AVX2";
+    case Implementation::kAVX512:
+      return "AVX-512";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace common
+}  // namespace aslam
+#endif  // __ARM_NEON__
@@ -1,7 +1,104 @@
 #include <aslam/common/hash-id.h>
 
+#include <atomic>
+#include <utility>
+
+#include <glog/logging.h>
+
 namespace aslam {
 
 const char HashId::kHexConversion[] = "0123456789abcdef";
 
+namespace {
+
+constexpr size_t kNumFeistelRounds = 4u;
+
+/**
+ * Time seed from nanoseconds. Covers 584 years if we assume no two agents
+ * initialize in the same nanosecond.
+ */
+inline int64_t time64() {
+  std::chrono::high_resolution_clock::duration current =
+      std::chrono::high_resolution_clock::now().time_since_epoch();
+  using std::chrono::duration_cast;
+  using std::chrono::nanoseconds;
+  // count() specified to return at least 64 bits
+  return duration_cast<nanoseconds>(current).count();
+}
+
+inline uint64_t splitMix64(uint64_t value) {
+  value += 0x9e3779b97f4a7c15ull;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+  return value ^ (value >> 31);
+}
+
+struct ProcessKey {
+  ProcessKey() {
+    std::random_device random_device;
+    uint64_t seed = static_cast<uint64_t>(time64()) ^
+        (static_cast<uint64_t>(random_device()) << 32) ^ random_device();
+    for (uint64_t& round_key : round_keys) {
+      seed = splitMix64(seed);
+      round_key = seed;
+    }
+  }
+  uint64_t round_keys[kNumFeistelRounds];
+};
+
+/**
+ * Generates the IDs of one thread. The IDs are a Feistel permutation of the
+ * thread index and the number of IDs the thread generated, keyed with the
+ * process key. A permutation maps distinct inputs to distinct IDs, hence the
+ * IDs of a process never collide, while the IDs of different processes
+ * collide as rarely as random IDs.
+ */
+class ThreadIdGenerator {
+ public:
+  ThreadIdGenerator()
+      : thread_index_(num_threads_.fetch_add(1u, std::memory_order_relaxed)),
+        num_generated_ids_(0u) {}
+
+  inline void generate(uint64_t id[2]) {
+    static const ProcessKey kProcessKey;
+    do {
+      uint64_t left = thread_index_;
+      uint64_t right = num_generated_ids_++;
+      for (const uint64_t round_key : kProcessKey.round_keys) {
+        left ^= splitMix64(right ^ round_key);
+        std::swap(left, right);
+      }
+      id[0] = left;
+      id[1] = right;
+      // One input maps to the invalid ID.
+    } while (id[0] == 0u && id[1] == 0u);
+  }
+
+ private:
+  static std::atomic<uint64_t> num_threads_;
+  const uint64_t thread_index_;
+  uint64_t num_generated_ids_;
+};
+
+std::atomic<uint64_t> ThreadIdGenerator::num_threads_(0u);
+
+inline ThreadIdGenerator& getThreadIdGenerator() {
+  static thread_local ThreadIdGenerator generator;
+  return generator;
+}
+
+}  // namespace
+
+void HashId::randomize() {
+  getThreadIdGenerator().generate(val_.u64);
+}
+
+void HashId::generateIds(size_t num_ids, HashId* ids) {
+  CHECK_NOTNULL(ids);
+  ThreadIdGenerator& generator = getThreadIdGenerator();
+  for (size_t i = 0u; i < num_ids; ++i) {
+    generator.generate(ids[i].val_.u64);
+  }
+}
+
 }  // namespace aslam
@@ -0,0 +1,259 @@
+#include "aslam/common/statistics/histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include <glog/logging.h>
+
+namespace statistics {
+
+constexpr int LogHistogram::kNumSubBucketBits;
+constexpr size_t LogHistogram::kNumSubBuckets;
+constexpr size_t LogHistogram::kNumBuckets;
+
+const double kExportedPercentiles[4] = {0.5, 0.9, 0.99, 0.999};
+
+namespace {
+constexpr size_t kNumHalfSubBuckets = LogHistogram::kNumSubBuckets / 2u;
+constexpr int kNumHalfSubBucketBits = LogHistogram::kNumSubBucketBits - 1;
+
+void UpdateMin(uint64_t units, std::atomic<uint64_t>* min_units) {
+  uint64_t current = min_units->load(std::memory_order_relaxed);
+  while (units < current &&
+         !min_units->compare_exchange_weak(current, units, std::memory_order_relaxed)) {
+  }
+}
+
+void UpdateMax(uint64_t units, std::atomic<uint64_t>* max_units) {
+  uint64_t current = max_units->load(std::memory_order_relaxed);
+  while (units > current &&
+         !max_units->compare_exchange_weak(current, units, std::memory_order_relaxed)) {
+  }
+}
+
+std::string EscapeLabelValue(const std::string& value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (const char character : value) {
+    if (character == '\\' || character == '"') {
+      escaped += '\\';
+      escaped += character;
+    } else if (character == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped += character;
+    }
+  }
+  return escaped;
+}
+
+std::string EscapeJsonString(const std::string& value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (const char character : value) {
+    if (character == '\\' || character == '"') {
+      escaped += '\\';
+      escaped += character;
+    } else if (static_cast<unsigned char>(character) < 0x20u) {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", character);
+      escaped += buffer;
+    } else {
+      escaped += character;
+    }
+  }
+  return escaped;
+}
+}  // namespace
+
+LogHistogram::LogHistogram(double resolution) : resolution_(resolution) {
+  CHECK_GT(resolution_, 0.0);
+  Reset();
+}
+
+LogHistogram::LogHistogram(const LogHistogram& other) : resolution_(other.resolution_) {
+  Reset();
+  Merge(other);
+}
+
+LogHistogram& LogHistogram::operator=(const LogHistogram& other) {
+  if (this != &other) {
+    resolution_ = other.resolution_;
+    Reset();
+    Merge(other);
+  }
+  return *this;
+}
+
+void LogHistogram::Reset() {
+  for (std::atomic<uint64_t>& count : counts_) {
+    count.store(0u, std::memory_order_relaxed);
+  }
+  total_count_.store(0u, std::memory_order_relaxed);
+  sum_units_.store(0u, std::memory_order_relaxed);
+  min_units_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+  max_units_.store(0u, std::memory_order_relaxed);
+}
+
+uint64_t LogHistogram::ToUnits(double value) const {
+  const double units = std::round(value / resolution_);
+  if (!(units > 0.0)) {
+    return 0u;
+  }
+  if (units >= static_cast<double>(std::numeric_limits<uint64_t>::max())) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  return static_cast<uint64_t>(units);
+}
+
+size_t LogHistogram::GetBucketIndex(uint64_t units) {
+  if (units < kNumSubBuckets) {
+    return static_cast<size_t>(units);
+  }
+  // The kNumSubBucketBits leading bits select the bucket within the power of
+  // two, the leading one is implicit.
+  const int most_significant_bit = 63 - __builtin_clzll(units);
+  const int shift = most_significant_bit - kNumHalfSubBucketBits;
+  return static_cast<size_t>(shift) * kNumHalfSubBuckets +
+         static_cast<size_t>(units >> shift);
+}
+
+uint64_t LogHistogram::GetBucketLowerBound(size_t bucket_index) {
+  CHECK_LT(bucket_index, kNumBuckets);
+  if (bucket_index < kNumSubBuckets) {
+    return bucket_index;
+  }
+  const size_t shift = bucket_index / kNumHalfSubBuckets - 1u;
+  const uint64_t mantissa = bucket_index - shift * kNumHalfSubBuckets;
+  return mantissa << shift;
+}
+
+uint64_t LogHistogram::GetBucketUpperBound(size_t bucket_index) {
+  CHECK_LT(bucket_index, kNumBuckets);
+  if (bucket_index < kNumSubBuckets) {
+    return bucket_index;
+  }
+  const size_t shift = bucket_index / kNumHalfSubBuckets - 1u;
+  return GetBucketLowerBound(bucket_index) + ((uint64_t{1} << shift) - 1u);
+}
+
+void LogHistogram::Record(double value) {
+  const uint64_t units = ToUnits(value);
+  counts_[GetBucketIndex(units)].fetch_add(1u, std::memory_order_relaxed);
+  total_count_.fetch_add(1u, std::memory_order_relaxed);
+  sum_units_.fetch_add(units, std::memory_order_relaxed);
+  UpdateMin(units, &min_units_);
+  UpdateMax(units, &max_units_);
+}
+
+void LogHistogram::Merge(const LogHistogram& other) {
+  CHECK_EQ(resolution_, other.resolution_)
+      << "Only histograms of the same resolution can be merged.";
+  for (size_t bucket_index = 0u; bucket_index < kNumBuckets; ++bucket_index) {
+    const uint64_t count = other.counts_[bucket_index].load(std::memory_order_relaxed);
+    if (count > 0u) {
+      counts_[bucket_index].fetch_add(count, std::memory_order_relaxed);
+    }
+  }
+  total_count_.fetch_add(other.total_count_.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+  sum_units_.fetch_add(other.sum_units_.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+  UpdateMin(other.min_units_.load(std::memory_order_relaxed), &min_units_);
+  UpdateMax(other.max_units_.load(std::memory_order_relaxed), &max_units_);
+}
+
+uint64_t LogHistogram::GetCount() const {
+  return total_count_.load(std::memory_order_relaxed);
+}
+
+double LogHistogram::GetSum() const {
+  return static_cast<double>(sum_units_.load(std::memory_order_relaxed)) * resolution_;
+}
+
+double LogHistogram::GetMean() const {
+  const uint64_t count = GetCount();
+  return count == 0u ? 0.0 : GetSum() / static_cast<double>(count);
+}
+
+double LogHistogram::GetMin() const {
+  if (GetCount() == 0u) {
+    return 0.0;
+  }
+  return static_cast<double>(min_units_.load(std::memory_order_relaxed)) * resolution_;
+}
+
+double LogHistogram::GetMax() const {
+  return static_cast<double>(max_units_.load(std::memory_order_relaxed)) * resolution_;
+}
+
+double LogHistogram::GetPercentile(double fraction) const {
+  CHECK_GE(fraction, 0.0);
+  CHECK_LE(fraction, 1.0);
+  const uint64_t count = GetCount();
+  if (count == 0u) {
+    return 0.0;
+  }
+  const uint64_t rank = std::min(
+      std::max(static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(count))),
+               uint64_t{1}),
+      count);
+
+  uint64_t cumulative_count = 0u;
+  for (size_t bucket_index = 0u; bucket_index < kNumBuckets; ++bucket_index) {
+    cumulative_count += counts_[bucket_index].load(std::memory_order_relaxed);
+    if (cumulative_count >= rank) {
+      // The middle of the bucket, within the recorded range.
+      const uint64_t lower_bound = GetBucketLowerBound(bucket_index);
+      const uint64_t middle =
+          lower_bound + (GetBucketUpperBound(bucket_index) - lower_bound) / 2u;
+      const uint64_t units = std::min(
+          std::max(middle, min_units_.load(std::memory_order_relaxed)),
+          max_units_.load(std::memory_order_relaxed));
+      return static_cast<double>(units) * resolution_;
+    }
+  }
+  // Only reached if values are recorded concurrently.
+  return GetMax();
+}
+
+void WritePrometheusSummary(const std::string& metric_name,
+                            const HistogramMap& histograms,
+                            std::ostream& out) {  // NOLINT
+  if (histograms.empty()) {
+    return;
+  }
+  out << "# TYPE " << metric_name << " summary\n";
+  for (const HistogramMap::value_type& tag_histogram : histograms) {
+    const std::string tag = EscapeLabelValue(tag_histogram.first);
+    const LogHistogram& histogram = tag_histogram.second;
+    for (const double percentile : kExportedPercentiles) {
+      out << metric_name << "{tag=\"" << tag << "\",quantile=\"" << percentile << "\"} "
+          << histogram.GetPercentile(percentile) << "\n";
+    }
+    out << metric_name << "_sum{tag=\"" << tag << "\"} " << histogram.GetSum() << "\n";
+    out << metric_name << "_count{tag=\"" << tag << "\"} " << histogram.GetCount() << "\n";
+  }
+}
+
+void WriteJson(const HistogramMap& histograms, std::ostream& out) {  // NOLINT
+  out << "{";
+  bool is_first = true;
+  for (const HistogramMap::value_type& tag_histogram : histograms) {
+    const LogHistogram& histogram = tag_histogram.second;
+    out << (is_first ? "" : ",") << "\n  \"" << EscapeJsonString(tag_histogram.first)
+        << "\": {\"count\": " << histogram.GetCount() << ", \"sum\": " << histogram.GetSum()
+        << ", \"mean\": " << histogram.GetMean() << ", \"min\": " << histogram.GetMin()
+        << ", \"max\": " << histogram.GetMax();
+    for (const double percentile : kExportedPercentiles) {
+      out << ", \"p" << percentile * 100.0 << "\": " << histogram.GetPercentile(percentile);
+    }
+    out << "}";
+    is_first = false;
+  }
+  out << (is_first ? "}" : "\n}") << "\n";
+}
+
+}  // namespace statistics
@@ -0,0 +1,104 @@
+#include <aslam/common/keypoint-grid.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace aslam {
+namespace common {
+
+KeypointGrid::KeypointGrid()
+    : num_cell_rows_(0u), num_cell_cols_(0u), inverse_cell_size_rows_(0.0),
+      inverse_cell_size_cols_(0.0), cell_offsets_(1u, 0u) {}
+
+KeypointGrid::KeypointGrid(size_t num_cell_rows, size_t num_cell_cols,
+                           double cell_size_rows, double cell_size_cols) {
+  initialize(num_cell_rows, num_cell_cols, cell_size_rows, cell_size_cols);
+}
+
+KeypointGrid KeypointGrid::createForImage(size_t image_width, size_t image_height,
+                                          double cell_size_pixels) {
+  CHECK_GT(cell_size_pixels, 0.0);
+  const size_t num_cell_rows = std::max<size_t>(
+      1u, static_cast<size_t>(std::ceil(image_height / cell_size_pixels)));
+  const size_t num_cell_cols = std::max<size_t>(
+      1u, static_cast<size_t>(std::ceil(image_width / cell_size_pixels)));
+  return KeypointGrid(num_cell_rows, num_cell_cols, cell_size_pixels, cell_size_pixels);
+}
+
+void KeypointGrid::initialize(size_t num_cell_rows, size_t num_cell_cols,
+                              double cell_size_rows, double cell_size_cols) {
+  CHECK_GT(num_cell_rows, 0u);
+  CHECK_GT(num_cell_cols, 0u);
+  CHECK_GT(cell_size_rows, 0.0);
+  CHECK_GT(cell_size_cols, 0.0);
+  num_cell_rows_ = num_cell_rows;
+  num_cell_cols_ = num_cell_cols;
+  inverse_cell_size_rows_ = 1.0 / cell_size_rows;
+  inverse_cell_size_cols_ = 1.0 / cell_size_cols;
+  clear();
+}
+
+void KeypointGrid::clear() {
+  cell_offsets_.assign(numCells() + 1u, 0u);
+  sorted_keypoint_indices_.clear();
+  sorted_keypoints_.resize(Eigen::NoChange, 0);
+}
+
+void KeypointGrid::build(const Eigen::Matrix2Xd& keypoints, const std::vector<bool>* is_valid) {
+  CHECK_GT(numCells(), 0u) << "The grid has not been initialized.";
+  const size_t num_keypoints = static_cast<size_t>(keypoints.cols());
+  if (is_valid != nullptr) {
+    CHECK_EQ(is_valid->size(), num_keypoints);
+  }
+
+  // Count the keypoints per cell, shifted by one to turn the counts into offsets in place.
+  cell_offsets_.assign(numCells() + 1u, 0u);
+  keypoint_cell_indices_.resize(num_keypoints);
+  size_t num_valid_keypoints = 0u;
+  for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints; ++keypoint_idx) {
+    if (is_valid != nullptr && !(*is_valid)[keypoint_idx]) {
+      continue;
+    }
+    const size_t cell_index = getCellIndex(getCellRow(keypoints(1, keypoint_idx)),
+                                           getCellCol(keypoints(0, keypoint_idx)));
+    keypoint_cell_indices_[keypoint_idx] = cell_index;
+    ++cell_offsets_[cell_index + 1u];
+    ++num_valid_keypoints;
+  }
+  for (size_t cell_index = 1u; cell_index < cell_offsets_.size(); ++cell_index) {
+    cell_offsets_[cell_index] += cell_offsets_[cell_index - 1u];
+  }
+  CHECK_EQ(cell_offsets_.back(), num_valid_keypoints);
+
+  // Scatter the keypoints into their cells, this keeps the original order within a cell.
+  sorted_keypoint_indices_.resize(num_valid_keypoints);
+  sorted_keypoints_.resize(Eigen::NoChange, num_valid_keypoints);
+  std::vector<size_t> insert_positions(cell_offsets_.begin(), cell_offsets_.end() - 1);
+  for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints; ++keypoint_idx) {
+    if (is_valid != nullptr && !(*is_valid)[keypoint_idx]) {
+      continue;
+    }
+    const size_t sorted_position = insert_positions[keypoint_cell_indices_[keypoint_idx]]++;
+    sorted_keypoint_indices_[sorted_position] = static_cast<int>(keypoint_idx);
+    sorted_keypoints_.col(sorted_position) = keypoints.col(keypoint_idx);
+  }
+}
+
+void KeypointGrid::getKeypointIndicesInRadius(const Eigen::Vector2d& center, double radius,
+                                              std::vector<int>* keypoint_indices) const {
+  CHECK_NOTNULL(keypoint_indices);
+  CHECK_GE(radius, 0.0);
+  const double squared_radius = radius * radius;
+  forEachRangeInWindow(
+      center(0) - radius, center(0) + radius, center(1) - radius, center(1) + radius,
+      [&](size_t begin, size_t end) {
+        for (size_t sorted_position = begin; sorted_position < end; ++sorted_position) {
+          if ((sorted_keypoints_.col(sorted_position) - center).squaredNorm() < squared_radius) {
+            keypoint_indices->push_back(sorted_keypoint_indices_[sorted_position]);
+          }
+        }
+      });
+}
+
+}  // namespace common
+}  // namespace aslam
@@ -0,0 +1,124 @@
+#include "aslam/common/mapped-file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace aslam {
+namespace common {
+
+namespace {
+void closePreservingErrno(int file_descriptor) {
+  const int error = errno;
+  ::close(file_descriptor);
+  errno = error;
+}
+
+void unlinkPreservingErrno(const std::string& name) {
+  const int error = errno;
+  ::shm_unlink(name.c_str());
+  errno = error;
+}
+}  // namespace
+
+MappedFile::MappedFile() : data_(nullptr), size_bytes_(0u), is_open_(false) {}
+
+MappedFile::MappedFile(MappedFile&& other)
+    : data_(other.data_), size_bytes_(other.size_bytes_), is_open_(other.is_open_) {
+  other.data_ = nullptr;
+  other.size_bytes_ = 0u;
+  other.is_open_ = false;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+  if (this != &other) {
+    close();
+    data_ = other.data_;
+    size_bytes_ = other.size_bytes_;
+    is_open_ = other.is_open_;
+    other.data_ = nullptr;
+    other.size_bytes_ = 0u;
+    other.is_open_ = false;
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+bool MappedFile::open(const std::string& path) {
+  close();
+  const int file_descriptor = ::open(path.c_str(), O_RDONLY);
+  if (file_descriptor < 0) {
+    return false;
+  }
+  struct stat file_status;
+  if (::fstat(file_descriptor, &file_status) != 0) {
+    closePreservingErrno(file_descriptor);
+    return false;
+  }
+  return map(file_descriptor, static_cast<size_t>(file_status.st_size), PROT_READ);
+}
+
+bool MappedFile::openSharedMemory(const std::string& name) {
+  close();
+  const int file_descriptor = ::shm_open(name.c_str(), O_RDWR, 0);
+  if (file_descriptor < 0) {
+    return false;
+  }
+  struct stat file_status;
+  if (::fstat(file_descriptor, &file_status) != 0) {
+    closePreservingErrno(file_descriptor);
+    return false;
+  }
+  return map(file_descriptor, static_cast<size_t>(file_status.st_size), PROT_READ | PROT_WRITE);
+}
+
+bool MappedFile::createSharedMemory(const std::string& name, size_t size_bytes) {
+  close();
+  const int file_descriptor = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (file_descriptor < 0) {
+    return false;
+  }
+  if (::ftruncate(file_descriptor, static_cast<off_t>(size_bytes)) != 0) {
+    closePreservingErrno(file_descriptor);
+    unlinkPreservingErrno(name);
+    return false;
+  }
+  if (!map(file_descriptor, size_bytes, PROT_READ | PROT_WRITE)) {
+    unlinkPreservingErrno(name);
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_ != nullptr) {
+    ::munmap(data_, size_bytes_);
+  }
+  data_ = nullptr;
+  size_bytes_ = 0u;
+  is_open_ = false;
+}
+
+bool MappedFile::map(int file_descriptor, size_t size_bytes, int protection) {
+  // mmap rejects empty mappings.
+  void* data = nullptr;
+  if (size_bytes > 0u) {
+    data = ::mmap(nullptr, size_bytes, protection, MAP_SHARED, file_descriptor, 0);
+  }
+  closePreservingErrno(file_descriptor);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  data_ = static_cast<char*>(data);
+  size_bytes_ = size_bytes;
+  is_open_ = true;
+  return true;
+}
+
+}  // namespace common
+}  // namespace aslam
@@ -0,0 +1,83 @@
+#include "aslam/common/memory-usage.h"
+
+#include <iomanip>
+
+#include <aslam/common/statistics/statistics.h>
+
+namespace aslam {
+namespace common {
+namespace {
+constexpr double kBytesToMegabytes = 1.0 / (1024.0 * 1024.0);
+}  // namespace
+
+void MemoryUsageReport::add(const std::string& tag, size_t num_bytes) {
+  entries_[tag] += num_bytes;
+}
+
+size_t MemoryUsageReport::getBytes(const std::string& tag) const {
+  if (tag.empty()) {
+    return getTotalBytes();
+  }
+  size_t num_bytes = 0u;
+  EntryMap::const_iterator it = entries_.find(tag);
+  if (it != entries_.end()) {
+    num_bytes += it->second;
+  }
+  // The sub-tags are sorted right after the prefix.
+  const std::string prefix = tag + "/";
+  for (it = entries_.lower_bound(prefix);
+       it != entries_.end() && it->first.compare(0u, prefix.size(), prefix) == 0; ++it) {
+    num_bytes += it->second;
+  }
+  return num_bytes;
+}
+
+size_t MemoryUsageReport::getTotalBytes() const {
+  size_t num_bytes = 0u;
+  for (const EntryMap::value_type& entry : entries_) {
+    num_bytes += entry.second;
+  }
+  return num_bytes;
+}
+
+bool MemoryUsageReport::isWithinBudgets(const EntryMap& budgets_bytes,
+                                        std::vector<std::string>* exceeded_tags) const {
+  if (exceeded_tags != nullptr) {
+    exceeded_tags->clear();
+  }
+  bool is_within_budgets = true;
+  for (const EntryMap::value_type& budget : budgets_bytes) {
+    const size_t num_bytes = getBytes(budget.first);
+    if (num_bytes > budget.second) {
+      is_within_budgets = false;
+      if (exceeded_tags != nullptr) {
+        exceeded_tags->push_back(budget.first);
+      }
+    }
+  }
+  return is_within_budgets;
+}
+
+void MemoryUsageReport::addToStatistics() const {
+  for (const EntryMap::value_type& entry : entries_) {
+    statistics::StatsCollector collector("memory/" + entry.first);
+    collector.AddSample(static_cast<double>(entry.second) * kBytesToMegabytes);
+  }
+  statistics::StatsCollector total_collector("memory/total");
+  total_collector.AddSample(static_cast<double>(getTotalBytes()) * kBytesToMegabytes);
+}
+
+void MemoryUsageReport::print(std::ostream& out) const {  // NOLINT
+  out << "Memory usage [MiB]:" << std::endl;
+  for (const EntryMap::value_type& entry : entries_) {
+    out << "  " << std::left << std::setw(40) << entry.first << std::right << std::fixed
+        << std::setprecision(3) << static_cast<double>(entry.second) * kBytesToMegabytes
+        << std::endl;
+  }
+  out << "  " << std::left << std::setw(40) << "total" << std::right << std::fixed
+      << std::setprecision(3) << static_cast<double>(getTotalBytes()) * kBytesToMegabytes
+      << std::endl;
+}
+
+}  // namespace common
+}  // namespace aslam
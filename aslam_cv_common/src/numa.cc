@@ -0,0 +1,130 @@
+#include "aslam/common/numa.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <glog/logging.h>
+
+namespace aslam {
+namespace common {
+namespace {
+#ifdef __linux__
+const char kNodeDirectory[] = "/sys/devices/system/node/node";
+
+// From linux/mempolicy.h, which would otherwise pull in libnuma for numaif.h.
+constexpr int kMpolBind = 2;
+constexpr unsigned kMpolMfMove = 1u << 1;
+
+bool readNodeCpuList(size_t node, std::string* cpu_list) {
+  CHECK_NOTNULL(cpu_list);
+  std::ifstream file(kNodeDirectory + std::to_string(node) + "/cpulist");
+  return static_cast<bool>(std::getline(file, *cpu_list));
+}
+#endif
+
+bool parseCpuId(const std::string& text, size_t* cpu_id) {
+  CHECK_NOTNULL(cpu_id);
+  if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  *cpu_id = static_cast<size_t>(std::strtoul(text.c_str(), nullptr, 10));
+  return true;
+}
+}  // namespace
+
+size_t getNumNumaNodes() {
+#ifdef __linux__
+  // The nodes are numbered consecutively, node0 always exists on NUMA kernels.
+  size_t num_nodes = 0u;
+  std::string cpu_list;
+  while (readNodeCpuList(num_nodes, &cpu_list)) {
+    ++num_nodes;
+  }
+  return num_nodes > 0u ? num_nodes : 1u;
+#else
+  return 1u;
+#endif
+}
+
+std::vector<size_t> getNumaNodeCpuIds(size_t node) {
+  std::vector<size_t> cpu_ids;
+#ifdef __linux__
+  std::string cpu_list;
+  if (!readNodeCpuList(node, &cpu_list) || !parseCpuList(cpu_list, &cpu_ids)) {
+    LOG(WARNING) << "Could not read the CPUs of the NUMA node " << node << ".";
+    cpu_ids.clear();
+  }
+#else
+  static_cast<void>(node);
+#endif
+  return cpu_ids;
+}
+
+bool parseCpuList(const std::string& cpu_list, std::vector<size_t>* cpu_ids) {
+  CHECK_NOTNULL(cpu_ids);
+  cpu_ids->clear();
+  std::stringstream stream(cpu_list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    // Trailing whitespace, e.g. the newline of the sysfs file.
+    range.erase(range.find_last_not_of(" \t\n") + 1u);
+    if (range.empty()) {
+      continue;
+    }
+    const size_t dash = range.find('-');
+    size_t first, last;
+    if (!parseCpuId(range.substr(0u, dash), &first)) {
+      return false;
+    }
+    if (dash == std::string::npos) {
+      last = first;
+    } else if (!parseCpuId(range.substr(dash + 1u), &last) || last < first) {
+      return false;
+    }
+    for (size_t cpu_id = first; cpu_id <= last; ++cpu_id) {
+      cpu_ids->push_back(cpu_id);
+    }
+  }
+  return true;
+}
+
+bool bindMemoryToNumaNode(void* data, size_t num_bytes, size_t node) {
+  if (num_bytes == 0u) {
+    return true;
+  }
+  CHECK_NOTNULL(data);
+#ifdef __linux__
+  constexpr size_t kNumBitsPerWord = 8u * sizeof(unsigned long);
+  CHECK_LT(node, 64u * kNumBitsPerWord);
+  std::vector<unsigned long> node_mask(node / kNumBitsPerWord + 1u, 0ul);
+  node_mask[node / kNumBitsPerWord] = 1ul << (node % kNumBitsPerWord);
+
+  // mbind() works on whole pages.
+  const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(data) & ~(page_size - 1u);
+  const uintptr_t end = reinterpret_cast<uintptr_t>(data) + num_bytes;
+  if (syscall(SYS_mbind, begin, end - begin, kMpolBind, node_mask.data(),
+              node_mask.size() * kNumBitsPerWord + 1u, kMpolMfMove) != 0) {
+    LOG(WARNING) << "Could not bind the memory to the NUMA node " << node << ": "
+                 << std::strerror(errno);
+    return false;
+  }
+  return true;
+#else
+  static_cast<void>(node);
+  LOG(WARNING) << "NUMA memory policies are not supported on this platform.";
+  return false;
+#endif
+}
+
+}  // namespace common
+}  // namespace aslam
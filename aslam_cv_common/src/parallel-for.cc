@@ -0,0 +1,100 @@
+#include "aslam/common/parallel-for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+DEFINE_int32(acv_parallel_for_num_threads, 0,
+             "Number of workers of the shared parallelFor pool, 0 uses one less than the "
+             "number of hardware threads.");
+
+namespace aslam {
+namespace common {
+namespace {
+
+/// The chunks of one loop, split into one contiguous block per thread.
+struct LoopState {
+  LoopState(size_t _num_chunks, size_t num_blocks,
+            const std::function<void(size_t)>* _process_chunk)
+      : num_chunks(_num_chunks), process_chunk(_process_chunk),
+        next_chunks(new std::atomic<size_t>[num_blocks]), block_ends(num_blocks),
+        num_finished_chunks(0u) {
+    for (size_t block_idx = 0u; block_idx < num_blocks; ++block_idx) {
+      next_chunks[block_idx] = block_idx * num_chunks / num_blocks;
+      block_ends[block_idx] = (block_idx + 1u) * num_chunks / num_blocks;
+    }
+  }
+
+  const size_t num_chunks;
+  /// Only valid while a chunk is unfinished, as the caller returns after the last chunk.
+  const std::function<void(size_t)>* const process_chunk;
+  /// Block b holds the chunks [next_chunks[b], block_ends[b]) which were not claimed yet.
+  std::unique_ptr<std::atomic<size_t>[]> next_chunks;
+  std::vector<size_t> block_ends;
+  std::atomic<size_t> num_finished_chunks;
+  std::mutex mutex;
+  std::condition_variable all_chunks_finished;
+};
+
+/// Processes the chunks of the own block, then steals chunks from the other blocks.
+void processBlocks(LoopState* state, size_t own_block_idx) {
+  CHECK_NOTNULL(state);
+  const size_t num_blocks = state->block_ends.size();
+  for (size_t offset = 0u; offset < num_blocks; ++offset) {
+    const size_t block_idx = (own_block_idx + offset) % num_blocks;
+    const size_t block_end = state->block_ends[block_idx];
+    while (state->next_chunks[block_idx] < block_end) {
+      const size_t chunk_idx = state->next_chunks[block_idx]++;
+      if (chunk_idx >= block_end) {
+        break;
+      }
+      (*state->process_chunk)(chunk_idx);
+      if (++state->num_finished_chunks == state->num_chunks) {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->all_chunks_finished.notify_all();
+      }
+    }
+  }
+}
+
+}  // namespace
+
+ThreadPool& getParallelForThreadPool() {
+  static ThreadPool thread_pool([]() -> size_t {
+    if (FLAGS_acv_parallel_for_num_threads > 0) {
+      return static_cast<size_t>(FLAGS_acv_parallel_for_num_threads);
+    }
+    return std::max(2u, std::thread::hardware_concurrency()) - 1u;
+  }());
+  return thread_pool;
+}
+
+namespace internal {
+
+void parallelForChunks(size_t num_chunks, const std::function<void(size_t)>& process_chunk) {
+  ThreadPool& thread_pool = getParallelForThreadPool();
+  const size_t num_threads = thread_pool.numThreads() + 1u;
+  const size_t num_blocks = std::min(num_chunks, num_threads);
+  std::shared_ptr<LoopState> state =
+      std::make_shared<LoopState>(num_chunks, num_blocks, &process_chunk);
+  // Helpers which start after all chunks were claimed return without touching process_chunk.
+  for (size_t block_idx = 1u; block_idx < num_blocks; ++block_idx) {
+    thread_pool.enqueue([state, block_idx]() { processBlocks(state.get(), block_idx); });
+  }
+  processBlocks(state.get(), 0u);
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  while (state->num_finished_chunks < num_chunks) {
+    state->all_chunks_finished.wait(lock);
+  }
+}
+
+}  // namespace internal
+}  // namespace common
+}  // namespace aslam
@@ -0,0 +1,13 @@
+#include "aslam/common/parameter-version.h"
+
+#include <atomic>
+
+namespace aslam {
+
+ParameterVersion getNextParameterVersion() {
+  // Starts at one, such that zero is never a valid version.
+  static std::atomic<ParameterVersion> next_version(1u);
+  return next_version.fetch_add(1u, std::memory_order_relaxed);
+}
+
+}  // namespace aslam
@@ -0,0 +1,189 @@
+#include "aslam/common/pose-batch.h"
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif  // __ARM_NEON__
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+
+#include <glog/logging.h>
+
+namespace aslam {
+namespace {
+template <typename Scalar>
+inline void transformPointScalar(const Eigen::Matrix<Scalar, 3, 3>& R_A_B,
+                                 const Eigen::Matrix<Scalar, 3, 1>& A_t_A_B,
+                                 const Scalar* B_point, Scalar* A_point) {
+  // Read the whole point before writing, the buffers may alias.
+  const Scalar x = B_point[0];
+  const Scalar y = B_point[1];
+  const Scalar z = B_point[2];
+  A_point[0] = R_A_B(0, 0) * x + R_A_B(0, 1) * y + R_A_B(0, 2) * z + A_t_A_B(0);
+  A_point[1] = R_A_B(1, 0) * x + R_A_B(1, 1) * y + R_A_B(1, 2) * z + A_t_A_B(1);
+  A_point[2] = R_A_B(2, 0) * x + R_A_B(2, 1) * y + R_A_B(2, 2) * z + A_t_A_B(2);
+}
+
+template <typename Scalar>
+void transformPointsImpl(const Eigen::Matrix<Scalar, 3, 3>& R_A_B,
+                         const Eigen::Matrix<Scalar, 3, 1>& A_t_A_B,
+                         const Eigen::Matrix<Scalar, 3, Eigen::Dynamic>& B_points,
+                         Eigen::Matrix<Scalar, 3, Eigen::Dynamic>* A_points) {
+  CHECK_NOTNULL(A_points);
+  if (A_points != &B_points) {
+    A_points->resize(Eigen::NoChange, B_points.cols());
+  }
+  internal::transformPointsKernel(R_A_B, A_t_A_B, B_points.data(),
+                                  static_cast<int>(B_points.cols()), A_points->data());
+}
+}  // namespace
+
+void rotatePoints(const Eigen::Matrix3d& R_A_B, const Eigen::Matrix3Xd& B_points,
+                  Eigen::Matrix3Xd* A_points) {
+  transformPointsImpl<double>(R_A_B, Eigen::Vector3d::Zero(), B_points, A_points);
+}
+
+void rotatePoints(const Quaternion& q_A_B, const Eigen::Matrix3Xd& B_points,
+                  Eigen::Matrix3Xd* A_points) {
+  transformPointsImpl<double>(q_A_B.getRotationMatrix(), Eigen::Vector3d::Zero(), B_points,
+                              A_points);
+}
+
+void rotatePoints(const Eigen::Matrix3f& R_A_B, const Eigen::Matrix3Xf& B_points,
+                  Eigen::Matrix3Xf* A_points) {
+  transformPointsImpl<float>(R_A_B, Eigen::Vector3f::Zero(), B_points, A_points);
+}
+
+void rotatePoints(const Quaternion& q_A_B, const Eigen::Matrix3Xf& B_points,
+                  Eigen::Matrix3Xf* A_points) {
+  transformPointsImpl<float>(q_A_B.getRotationMatrix().cast<float>(), Eigen::Vector3f::Zero(),
+                             B_points, A_points);
+}
+
+void transformPoints(const Transformation& T_A_B, const Eigen::Matrix3Xd& B_points,
+                     Eigen::Matrix3Xd* A_points) {
+  transformPointsImpl<double>(T_A_B.getRotationMatrix(), T_A_B.getPosition(), B_points,
+                              A_points);
+}
+
+void transformPoints(const Transformation& T_A_B, const Eigen::Matrix3Xf& B_points,
+                     Eigen::Matrix3Xf* A_points) {
+  transformPointsImpl<float>(T_A_B.getRotationMatrix().cast<float>(),
+                             T_A_B.getPosition().cast<float>(), B_points, A_points);
+}
+
+namespace internal {
+void transformPointsKernel(const Eigen::Matrix3d& R_A_B, const Eigen::Vector3d& A_t_A_B,
+                           const double* B_points, int num_points, double* A_points) {
+  CHECK_GE(num_points, 0);
+  int point_idx = 0;
+#ifdef __SSE2__
+  // Two points per iteration: The six coordinates x0 y0 | z0 x1 | y1 z1 are transposed to
+  // x0 x1 | y0 y1 | z0 z1 and back.
+  const __m128d r00 = _mm_set1_pd(R_A_B(0, 0)), r01 = _mm_set1_pd(R_A_B(0, 1));
+  const __m128d r02 = _mm_set1_pd(R_A_B(0, 2)), r10 = _mm_set1_pd(R_A_B(1, 0));
+  const __m128d r11 = _mm_set1_pd(R_A_B(1, 1)), r12 = _mm_set1_pd(R_A_B(1, 2));
+  const __m128d r20 = _mm_set1_pd(R_A_B(2, 0)), r21 = _mm_set1_pd(R_A_B(2, 1));
+  const __m128d r22 = _mm_set1_pd(R_A_B(2, 2));
+  const __m128d t0 = _mm_set1_pd(A_t_A_B(0)), t1 = _mm_set1_pd(A_t_A_B(1));
+  const __m128d t2 = _mm_set1_pd(A_t_A_B(2));
+  for (; point_idx + 2 <= num_points; point_idx += 2) {
+    const double* B_pair = B_points + 3 * point_idx;
+    const __m128d a = _mm_loadu_pd(B_pair);
+    const __m128d b = _mm_loadu_pd(B_pair + 2);
+    const __m128d c = _mm_loadu_pd(B_pair + 4);
+    const __m128d x = _mm_shuffle_pd(a, b, 2);
+    const __m128d y = _mm_shuffle_pd(a, c, 1);
+    const __m128d z = _mm_shuffle_pd(b, c, 2);
+
+    const __m128d A_x = _mm_add_pd(
+        _mm_add_pd(_mm_mul_pd(r00, x), _mm_mul_pd(r01, y)), _mm_add_pd(_mm_mul_pd(r02, z), t0));
+    const __m128d A_y = _mm_add_pd(
+        _mm_add_pd(_mm_mul_pd(r10, x), _mm_mul_pd(r11, y)), _mm_add_pd(_mm_mul_pd(r12, z), t1));
+    const __m128d A_z = _mm_add_pd(
+        _mm_add_pd(_mm_mul_pd(r20, x), _mm_mul_pd(r21, y)), _mm_add_pd(_mm_mul_pd(r22, z), t2));
+
+    double* A_pair = A_points + 3 * point_idx;
+    _mm_storeu_pd(A_pair, _mm_unpacklo_pd(A_x, A_y));
+    _mm_storeu_pd(A_pair + 2, _mm_shuffle_pd(A_z, A_x, 2));
+    _mm_storeu_pd(A_pair + 4, _mm_unpackhi_pd(A_y, A_z));
+  }
+#endif  // __SSE2__
+  for (; point_idx < num_points; ++point_idx) {
+    transformPointScalar(R_A_B, A_t_A_B, B_points + 3 * point_idx, A_points + 3 * point_idx);
+  }
+}
+
+void transformPointsKernel(const Eigen::Matrix3f& R_A_B, const Eigen::Vector3f& A_t_A_B,
+                           const float* B_points, int num_points, float* A_points) {
+  CHECK_GE(num_points, 0);
+  int point_idx = 0;
+#if defined(__ARM_NEON__)
+  // Four points per iteration, the interleaved loads and stores transpose the coordinates.
+  const float32x4_t t0 = vdupq_n_f32(A_t_A_B(0));
+  const float32x4_t t1 = vdupq_n_f32(A_t_A_B(1));
+  const float32x4_t t2 = vdupq_n_f32(A_t_A_B(2));
+  for (; point_idx + 4 <= num_points; point_idx += 4) {
+    const float32x4x3_t B_xyz = vld3q_f32(B_points + 3 * point_idx);
+    float32x4x3_t A_xyz;
+    A_xyz.val[0] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(t0, B_xyz.val[0], R_A_B(0, 0)),
+                                           B_xyz.val[1], R_A_B(0, 1)),
+                               B_xyz.val[2], R_A_B(0, 2));
+    A_xyz.val[1] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(t1, B_xyz.val[0], R_A_B(1, 0)),
+                                           B_xyz.val[1], R_A_B(1, 1)),
+                               B_xyz.val[2], R_A_B(1, 2));
+    A_xyz.val[2] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(t2, B_xyz.val[0], R_A_B(2, 0)),
+                                           B_xyz.val[1], R_A_B(2, 1)),
+                               B_xyz.val[2], R_A_B(2, 2));
+    vst3q_f32(A_points + 3 * point_idx, A_xyz);
+  }
+#elif defined(__SSE2__)
+  // Four points per iteration: The twelve coordinates x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+  // are transposed to x0..x3 | y0..y3 | z0..z3 and back.
+  const __m128 r00 = _mm_set1_ps(R_A_B(0, 0)), r01 = _mm_set1_ps(R_A_B(0, 1));
+  const __m128 r02 = _mm_set1_ps(R_A_B(0, 2)), r10 = _mm_set1_ps(R_A_B(1, 0));
+  const __m128 r11 = _mm_set1_ps(R_A_B(1, 1)), r12 = _mm_set1_ps(R_A_B(1, 2));
+  const __m128 r20 = _mm_set1_ps(R_A_B(2, 0)), r21 = _mm_set1_ps(R_A_B(2, 1));
+  const __m128 r22 = _mm_set1_ps(R_A_B(2, 2));
+  const __m128 t0 = _mm_set1_ps(A_t_A_B(0)), t1 = _mm_set1_ps(A_t_A_B(1));
+  const __m128 t2 = _mm_set1_ps(A_t_A_B(2));
+  for (; point_idx + 4 <= num_points; point_idx += 4) {
+    const float* B_quad = B_points + 3 * point_idx;
+    const __m128 a = _mm_loadu_ps(B_quad);
+    const __m128 b = _mm_loadu_ps(B_quad + 4);
+    const __m128 c = _mm_loadu_ps(B_quad + 8);
+    const __m128 x = _mm_shuffle_ps(
+        a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+    const __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                                    _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                                    _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                                    _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                                    _MM_SHUFFLE(2, 0, 2, 0));
+
+    const __m128 A_x = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(r00, x), _mm_mul_ps(r01, y)), _mm_add_ps(_mm_mul_ps(r02, z), t0));
+    const __m128 A_y = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(r10, x), _mm_mul_ps(r11, y)), _mm_add_ps(_mm_mul_ps(r12, z), t1));
+    const __m128 A_z = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(r20, x), _mm_mul_ps(r21, y)), _mm_add_ps(_mm_mul_ps(r22, z), t2));
+
+    float* A_quad = A_points + 3 * point_idx;
+    _mm_storeu_ps(A_quad, _mm_shuffle_ps(_mm_shuffle_ps(A_x, A_y, _MM_SHUFFLE(0, 0, 0, 0)),
+                                         _mm_shuffle_ps(A_z, A_x, _MM_SHUFFLE(1, 1, 0, 0)),
+                                         _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(A_quad + 4, _mm_shuffle_ps(_mm_shuffle_ps(A_y, A_z, _MM_SHUFFLE(1, 1, 1, 1)),
+                                             _mm_shuffle_ps(A_x, A_y, _MM_SHUFFLE(2, 2, 2, 2)),
+                                             _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(A_quad + 8, _mm_shuffle_ps(_mm_shuffle_ps(A_z, A_x, _MM_SHUFFLE(3, 3, 2, 2)),
+                                             _mm_shuffle_ps(A_y, A_z, _MM_SHUFFLE(3, 3, 3, 3)),
+                                             _MM_SHUFFLE(2, 0, 2, 0)));
+  }
+#endif  // __ARM_NEON__
+  for (; point_idx < num_points; ++point_idx) {
+    transformPointScalar(R_A_B, A_t_A_B, B_points + 3 * point_idx, A_points + 3 * point_idx);
+  }
+}
+}  // namespace internal
+
+}  // namespace aslam
@@ -0,0 +1,141 @@
+#include "aslam/common/real-time.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <glog/logging.h>
+
+#ifdef NDEBUG
+DEFINE_bool(acv_abort_on_steady_state_allocation, false,
+            "Abort on heap allocations within a steady state scope instead of only counting "
+            "them.");
+#else
+DEFINE_bool(acv_abort_on_steady_state_allocation, true,
+            "Abort on heap allocations within a steady state scope instead of only counting "
+            "them.");
+#endif
+
+namespace aslam {
+namespace common {
+namespace {
+// Plain old data, such that accessing it from within operator new never allocates.
+thread_local size_t steady_state_depth = 0u;
+std::atomic<size_t> num_steady_state_allocations(0u);
+
+constexpr size_t kStackPageSize = 4096u;
+
+size_t getPageSize() {
+#ifdef __linux__
+  const long page_size = sysconf(_SC_PAGESIZE);
+  if (page_size > 0) {
+    return static_cast<size_t>(page_size);
+  }
+#endif
+  return kStackPageSize;
+}
+
+__attribute__((noinline)) void prefaultStackPages(size_t num_pages) {
+  volatile char page[kStackPageSize];
+  page[0] = 0;
+  if (num_pages > 1u) {
+    prefaultStackPages(num_pages - 1u);
+  }
+  // Using the page after the recursion keeps the compiler from reusing the frame.
+  page[kStackPageSize - 1u] = page[0];
+}
+}  // namespace
+
+bool lockAllMemory() {
+#ifdef __linux__
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    LOG(WARNING) << "Could not lock the memory of the process: " << std::strerror(errno);
+    return false;
+  }
+  return true;
+#else
+  LOG(WARNING) << "Locking the memory is not supported on this platform.";
+  return false;
+#endif
+}
+
+bool retainFreedHeapMemory() {
+#ifdef __GLIBC__
+  // Never trim the top of the heap, and don't use mmap, whose chunks are unmapped when freed.
+  if (mallopt(M_TRIM_THRESHOLD, -1) == 0 || mallopt(M_MMAP_MAX, 0) == 0) {
+    LOG(WARNING) << "Could not configure the heap to retain the freed memory.";
+    return false;
+  }
+  return true;
+#else
+  LOG(WARNING) << "Retaining the freed heap memory is not supported on this platform.";
+  return false;
+#endif
+}
+
+void prefaultMemory(void* data, size_t num_bytes) {
+  if (num_bytes == 0u) {
+    return;
+  }
+  CHECK_NOTNULL(data);
+  volatile char* bytes = static_cast<volatile char*>(data);
+  const size_t page_size = getPageSize();
+  for (size_t offset = 0u; offset < num_bytes; offset += page_size) {
+    bytes[offset] = bytes[offset];
+  }
+  bytes[num_bytes - 1u] = bytes[num_bytes - 1u];
+}
+
+void prefaultStack(size_t num_bytes) {
+  prefaultStackPages((num_bytes + kStackPageSize - 1u) / kStackPageSize);
+}
+
+SteadyStateScope::SteadyStateScope(bool is_enabled) : is_enabled_(is_enabled) {
+  if (is_enabled_) {
+    ++steady_state_depth;
+  }
+}
+
+SteadyStateScope::~SteadyStateScope() {
+  if (is_enabled_) {
+    CHECK_GT(steady_state_depth, 0u);
+    --steady_state_depth;
+  }
+}
+
+bool SteadyStateScope::isActive() {
+  return steady_state_depth > 0u;
+}
+
+size_t getNumSteadyStateAllocations() {
+  return num_steady_state_allocations;
+}
+
+void resetNumSteadyStateAllocations() {
+  num_steady_state_allocations = 0u;
+}
+
+namespace internal {
+void checkSteadyStateAllocation(size_t num_bytes) {
+  if (steady_state_depth == 0u) {
+    return;
+  }
+  ++num_steady_state_allocations;
+  if (FLAGS_acv_abort_on_steady_state_allocation) {
+    // Logging allocates itself.
+    steady_state_depth = 0u;
+    LOG(FATAL) << "Heap allocation of " << num_bytes << " bytes in the steady state.";
+  }
+}
+}  // namespace internal
+
+}  // namespace common
+}  // namespace aslam
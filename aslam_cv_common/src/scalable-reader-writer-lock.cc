@@ -0,0 +1,118 @@
+#include "aslam/common/scalable-reader-writer-lock.h"
+
+namespace aslam {
+
+constexpr size_t ScalableReaderWriterMutex::kNumReaderCounters;
+constexpr size_t ScalableReaderWriterMutex::kCacheLineSize;
+
+ScalableReaderWriterMutex::ScalableReaderWriterMutex()
+    : ReaderWriterMutex(), writers_announced_(false) {
+  for (ReaderCounter& counter : reader_counters_) {
+    counter.num_readers.store(0);
+  }
+}
+
+ScalableReaderWriterMutex::~ScalableReaderWriterMutex() {}
+
+std::atomic<int>& ScalableReaderWriterMutex::getThreadReaderCounter() {
+  // The threads are spread over the counters in the order in which they first read.
+  static std::atomic<size_t> num_threads(0u);
+  static thread_local const size_t counter_index =
+      num_threads.fetch_add(1u, std::memory_order_relaxed) % kNumReaderCounters;
+  return reader_counters_[counter_index].num_readers;
+}
+
+int ScalableReaderWriterMutex::getNumReaders() const {
+  int num_readers = 0;
+  for (const ReaderCounter& counter : reader_counters_) {
+    num_readers += counter.num_readers.load();
+  }
+  return num_readers;
+}
+
+void ScalableReaderWriterMutex::updateWritersAnnounced() {
+  writers_announced_.store(num_pending_writers_ != 0u || current_writer_ || pending_upgrade_);
+}
+
+void ScalableReaderWriterMutex::waitForReaders(
+    std::unique_lock<std::mutex>* lock, int num_readers) {
+  while (getNumReaders() > num_readers) {
+    cv_readers_.wait(*lock);
+  }
+}
+
+void ScalableReaderWriterMutex::acquireReadLock() {
+  std::atomic<int>& counter = getThreadReaderCounter();
+  while (true) {
+    // The counter is incremented before checking for writers, and writers announce themselves
+    // before counting the readers, so at least one of the two sees the other.
+    counter.fetch_add(1);
+    if (!writers_announced_.load()) {
+      return;
+    }
+    counter.fetch_sub(1);
+    std::unique_lock<std::mutex> lock(mutex_);
+    // A writer may have counted this reader.
+    cv_readers_.notify_all();
+    ++pending_readers_;
+    while (writers_announced_.load()) {
+      cv_writer_finished_.wait(lock);
+    }
+    --pending_readers_;
+  }
+}
+
+void ScalableReaderWriterMutex::releaseReadLock() {
+  getThreadReaderCounter().fetch_sub(1);
+  if (writers_announced_.load()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cv_readers_.notify_all();
+  }
+}
+
+void ScalableReaderWriterMutex::acquireWriteLock() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  ++num_pending_writers_;
+  writers_announced_.store(true);
+  while (current_writer_ || pending_upgrade_) {
+    cv_writer_finished_.wait(lock);
+  }
+  --num_pending_writers_;
+  current_writer_ = true;
+  waitForReaders(&lock, 0);
+}
+
+void ScalableReaderWriterMutex::releaseWriteLock() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_writer_ = false;
+    updateWritersAnnounced();
+  }
+  cv_writer_finished_.notify_all();
+}
+
+// Attempt upgrade. If upgrade fails, relinquish read lock.
+bool ScalableReaderWriterMutex::upgradeToWriteLock() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (pending_upgrade_ || current_writer_) {
+    // Another thread waits for this reader to leave.
+    getThreadReaderCounter().fetch_sub(1);
+    cv_readers_.notify_all();
+    return false;
+  }
+  pending_upgrade_ = true;
+  writers_announced_.store(true);
+  waitForReaders(&lock, 1);
+  getThreadReaderCounter().fetch_sub(1);
+  pending_upgrade_ = false;
+  current_writer_ = true;
+  return true;
+}
+
+bool ScalableReaderWriterMutex::isInUse() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_readers_ > 0u || getNumReaders() > 0 || num_pending_writers_ > 0u ||
+      current_writer_ || pending_upgrade_;
+}
+
+}  // namespace aslam
@@ -4,51 +4,125 @@
 #include <fstream>  // NOLINT
 #include <ostream>  // NOLINT
 #include <sstream>
+#include <unordered_map>
+
+#include <glog/logging.h>
 
 namespace statistics {
 
-Statistics& Statistics::Instance() {
-  static Statistics instance;
-  return instance;
-}
+namespace {
+std::atomic<size_t> num_sample_stores(0u);
+}  // namespace
+
+struct SampleStore::Sample {
+  size_t handle;
+  double value;
+  std::chrono::time_point<std::chrono::system_clock> time;
+};
+
+struct SampleStore::ThreadBuffer {
+  std::mutex mutex;
+  std::vector<Sample> samples;
+};
+
+struct SampleStore::ThreadState {
+  explicit ThreadState(SampleStore* store)
+      : store(store), thread_buffer(new ThreadBuffer), generation(0u) {
+    thread_buffer->samples.reserve(kMaxNumBufferedSamples);
+    spare_samples.reserve(kMaxNumBufferedSamples);
+  }
 
-Statistics::Statistics() : max_tag_length_(0) {}
+  SampleStore* const store;
+  const std::shared_ptr<ThreadBuffer> thread_buffer;
+  // Swapped with the full buffer, such that merging doesn't allocate.
+  std::vector<Sample> spare_samples;
+  std::unordered_map<std::string, size_t> handles;
+  uint64_t generation;
+};
+
+// The states of a thread for all stores, indexed by the store index. Merges the
+// remaining samples when the thread exits.
+struct SampleStore::ThreadStates {
+  ~ThreadStates() {
+    for (const std::unique_ptr<ThreadState>& state : states) {
+      if (state) {
+        state->store->RemoveThreadBuffer(state->thread_buffer);
+      }
+    }
+  }
 
-Statistics::~Statistics() {}
+  std::vector<std::unique_ptr<ThreadState>> states;
+};
 
-// Static functions to query the stats collectors:
-size_t Statistics::GetHandle(std::string const& tag) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
+constexpr size_t SampleStore::kMaxNumBufferedSamples;
+
+SampleStore::SampleStore(double histogram_resolution)
+    : store_index_(num_sample_stores++),
+      histogram_resolution_(histogram_resolution),
+      max_tag_length_(0u),
+      generation_(0u) {}
+
+SampleStore::~SampleStore() {}
+
+SampleStore::ThreadState& SampleStore::GetThreadState() {
+  static thread_local ThreadStates thread_states;
+  if (thread_states.states.size() <= store_index_) {
+    thread_states.states.resize(store_index_ + 1u);
+  }
+  std::unique_ptr<ThreadState>& state = thread_states.states[store_index_];
+  if (!state) {
+    state.reset(new ThreadState(this));
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_buffers_.push_back(state->thread_buffer);
+  }
+  return *state;
+}
+
+size_t SampleStore::GetHandle(std::string const& tag) {
+  ThreadState& state = GetThreadState();
+  if (state.generation == generation_.load(std::memory_order_acquire)) {
+    std::unordered_map<std::string, size_t>::const_iterator it = state.handles.find(tag);
+    if (it != state.handles.end()) {
+      return it->second;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const uint64_t generation = generation_.load(std::memory_order_relaxed);
+  if (state.generation != generation) {
+    state.handles.clear();
+    state.generation = generation;
+  }
   // Search for an existing tag.
-  map_t::iterator i = Instance().tag_map_.find(tag);
-  if (i == Instance().tag_map_.end()) {
+  size_t handle;
+  map_t::iterator i = tag_map_.find(tag);
+  if (i == tag_map_.end()) {
     // If it is not there, create a tag.
-    size_t handle = Instance().stats_collectors_.size();
-    Instance().tag_map_[tag] = handle;
-    Instance().stats_collectors_.push_back(StatisticsMapValue());
+    handle = values_.size();
+    tag_map_[tag] = handle;
+    values_.push_back(StatisticsMapValue());
+    if (histogram_resolution_ > 0.0) {
+      histograms_.emplace_back(new LogHistogram(histogram_resolution_));
+    }
     // Track the maximum tag length to help printing a table of values later.
-    Instance().max_tag_length_ =
-        std::max(Instance().max_tag_length_, tag.size());
-    return handle;
+    max_tag_length_ = std::max(max_tag_length_, tag.size());
   } else {
-    return i->second;
+    handle = i->second;
   }
+  state.handles.emplace(tag, handle);
+  return handle;
 }
 
-// Return true if a handle has been initialized for a specific tag.
-// In contrast to GetHandle(), this allows testing for existence without
-// modifying the tag/handle map.
-bool Statistics::HasHandle(std::string const& tag) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  bool tag_found = Instance().tag_map_.count(tag);
-  return tag_found;
+bool SampleStore::HasHandle(std::string const& tag) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tag_map_.count(tag) > 0u;
 }
 
-std::string Statistics::GetTag(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
+std::string SampleStore::GetTag(size_t handle) const {
+  std::lock_guard<std::mutex> lock(mutex_);
   std::string tag;
   // Perform a linear search for the tag.
-  for (typename map_t::value_type current_tag : Instance().tag_map_) {
+  for (const map_t::value_type& current_tag : tag_map_) {
     if (current_tag.second == handle) {
       return current_tag.first;
     }
@@ -56,6 +130,120 @@ std::string Statistics::GetTag(size_t handle) {
   return tag;
 }
 
+void SampleStore::AddSample(size_t handle, double sample) {
+  ThreadState& state = GetThreadState();
+  {
+    std::lock_guard<std::mutex> lock(state.thread_buffer->mutex);
+    std::vector<Sample>& samples = state.thread_buffer->samples;
+    samples.push_back(Sample{handle, sample, std::chrono::system_clock::now()});
+    if (samples.size() < kMaxNumBufferedSamples) {
+      return;
+    }
+    samples.swap(state.spare_samples);
+  }
+  // The lock of the thread buffer is released, readers hold the lock of the
+  // store while they lock the buffers.
+  std::lock_guard<std::mutex> lock(mutex_);
+  MergeSamples(&state.spare_samples);
+}
+
+void SampleStore::MergeSamples(std::vector<Sample>* samples) {
+  CHECK_NOTNULL(samples);
+  for (const Sample& sample : *samples) {
+    CHECK_LT(sample.handle, values_.size());
+    values_[sample.handle].AddValue(sample.value, sample.time);
+    if (!histograms_.empty()) {
+      histograms_[sample.handle]->Record(sample.value);
+    }
+  }
+  samples->clear();
+}
+
+void SampleStore::MergeThreadBuffers() {
+  for (const std::shared_ptr<ThreadBuffer>& thread_buffer : thread_buffers_) {
+    std::lock_guard<std::mutex> lock(thread_buffer->mutex);
+    MergeSamples(&thread_buffer->samples);
+  }
+}
+
+void SampleStore::RemoveThreadBuffer(const std::shared_ptr<ThreadBuffer>& thread_buffer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  {
+    std::lock_guard<std::mutex> buffer_lock(thread_buffer->mutex);
+    MergeSamples(&thread_buffer->samples);
+  }
+  thread_buffers_.erase(
+      std::remove(thread_buffers_.begin(), thread_buffers_.end(), thread_buffer),
+      thread_buffers_.end());
+}
+
+StatisticsMapValue SampleStore::GetValue(size_t handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  MergeThreadBuffers();
+  CHECK_LT(handle, values_.size());
+  return values_[handle];
+}
+
+LogHistogram SampleStore::GetHistogram(size_t handle) {
+  CHECK_GT(histogram_resolution_, 0.0) << "The store doesn't keep histograms.";
+  std::lock_guard<std::mutex> lock(mutex_);
+  MergeThreadBuffers();
+  CHECK_LT(handle, histograms_.size());
+  return *histograms_[handle];
+}
+
+HistogramMap SampleStore::GetHistograms() {
+  CHECK_GT(histogram_resolution_, 0.0) << "The store doesn't keep histograms.";
+  std::lock_guard<std::mutex> lock(mutex_);
+  MergeThreadBuffers();
+  HistogramMap histograms;
+  for (const map_t::value_type& tag_handle : tag_map_) {
+    histograms.emplace(tag_handle.first, *histograms_[tag_handle.second]);
+  }
+  return histograms;
+}
+
+SampleStore::map_t SampleStore::GetTagMap() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return tag_map_;
+}
+
+size_t SampleStore::GetMaxTagLength() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return max_tag_length_;
+}
+
+void SampleStore::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tag_map_.clear();
+  generation_.fetch_add(1u, std::memory_order_release);
+}
+
+Statistics& Statistics::Instance() {
+  static Statistics instance;
+  return instance;
+}
+
+Statistics::Statistics() {}
+
+Statistics::~Statistics() {}
+
+// Static functions to query the stats collectors:
+size_t Statistics::GetHandle(std::string const& tag) {
+  return Instance().store_.GetHandle(tag);
+}
+
+// Return true if a handle has been initialized for a specific tag.
+// In contrast to GetHandle(), this allows testing for existence without
+// modifying the tag/handle map.
+bool Statistics::HasHandle(std::string const& tag) {
+  return Instance().store_.HasHandle(tag);
+}
+
+std::string Statistics::GetTag(size_t handle) {
+  return Instance().store_.GetTag(handle);
+}
+
 StatsCollectorImpl::StatsCollectorImpl(size_t handle) : handle_(handle) {}
 
 StatsCollectorImpl::StatsCollectorImpl(std::string const& tag)
@@ -71,61 +259,52 @@ void StatsCollectorImpl::IncrementOne() const {
   Statistics::Instance().AddSample(handle_, 1.0);
 }
 void Statistics::AddSample(size_t handle, double seconds) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  stats_collectors_[handle].AddValue(seconds);
+  store_.AddSample(handle, seconds);
 }
 double Statistics::GetLastValue(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].GetLastValue();
+  return Instance().store_.GetValue(handle).GetLastValue();
 }
 double Statistics::GetLastValue(std::string const& tag) {
   return GetLastValue(GetHandle(tag));
 }
 double Statistics::GetTotal(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].Sum();
+  return Instance().store_.GetValue(handle).Sum();
 }
 double Statistics::GetTotal(std::string const& tag) {
   return GetTotal(GetHandle(tag));
 }
 double Statistics::GetMean(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].Mean();
+  return Instance().store_.GetValue(handle).Mean();
 }
 double Statistics::GetMean(std::string const& tag) {
   return GetMean(GetHandle(tag));
 }
 size_t Statistics::GetNumSamples(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].TotalSamples();
+  return Instance().store_.GetValue(handle).TotalSamples();
 }
 size_t Statistics::GetNumSamples(std::string const& tag) {
   return GetNumSamples(GetHandle(tag));
 }
 double Statistics::GetVariance(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].LazyVariance();
+  return Instance().store_.GetValue(handle).LazyVariance();
 }
 double Statistics::GetVariance(std::string const& tag) {
   return GetVariance(GetHandle(tag));
 }
 double Statistics::GetMin(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].Min();
+  return Instance().store_.GetValue(handle).Min();
 }
 double Statistics::GetMin(std::string const& tag) {
   return GetMin(GetHandle(tag));
 }
 double Statistics::GetMax(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].Max();
+  return Instance().store_.GetValue(handle).Max();
 }
 double Statistics::GetMax(std::string const& tag) {
   return GetMax(GetHandle(tag));
 }
 double Statistics::GetHz(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].MeanCallsPerSec();
+  return Instance().store_.GetValue(handle).MeanCallsPerSec();
 }
 double Statistics::GetHz(std::string const& tag) {
   return GetHz(GetHandle(tag));
@@ -136,36 +315,31 @@ double Statistics::GetMeanDeltaTime(std::string const& tag) {
   return GetMeanDeltaTime(GetHandle(tag));
 }
 double Statistics::GetMeanDeltaTime(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].MeanDeltaTime();
+  return Instance().store_.GetValue(handle).MeanDeltaTime();
 }
 double Statistics::GetMaxDeltaTime(std::string const& tag) {
   return GetMaxDeltaTime(GetHandle(tag));
 }
 double Statistics::GetMaxDeltaTime(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].MaxDeltaTime();
+  return Instance().store_.GetValue(handle).MaxDeltaTime();
 }
 double Statistics::GetMinDeltaTime(std::string const& tag) {
   return GetMinDeltaTime(GetHandle(tag));
 }
 double Statistics::GetMinDeltaTime(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].MinDeltaTime();
+  return Instance().store_.GetValue(handle).MinDeltaTime();
 }
 double Statistics::GetLastDeltaTime(std::string const& tag) {
   return GetLastDeltaTime(GetHandle(tag));
 }
 double Statistics::GetLastDeltaTime(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].GetLastDeltaTime();
+  return Instance().store_.GetValue(handle).GetLastDeltaTime();
 }
 double Statistics::GetVarianceDeltaTime(std::string const& tag) {
   return GetVarianceDeltaTime(GetHandle(tag));
 }
 double Statistics::GetVarianceDeltaTime(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().stats_collectors_[handle].LazyVarianceDeltaTime();
+  return Instance().store_.GetValue(handle).LazyVarianceDeltaTime();
 }
 
 std::string Statistics::SecondsToTimeString(double seconds) {
@@ -195,7 +369,8 @@ std::string Statistics::SecondsToTimeString(double seconds) {
 }
 
 void Statistics::Print(std::ostream& out) {  // NOLINT
-  const map_t& tag_map = Instance().tag_map_;
+  const map_t tag_map = Instance().store_.GetTagMap();
+  const size_t max_tag_length = Instance().store_.GetMaxTagLength();
 
   if (tag_map.empty()) {
     return;
@@ -203,7 +378,7 @@ void Statistics::Print(std::ostream& out) {  // NOLINT
 
   out << "Statistics\n";
 
-  out.width((std::streamsize)Instance().max_tag_length_);
+  out.width((std::streamsize)max_tag_length);
   out.setf(std::ios::left, std::ios::adjustfield);
   out << "-----------";
   out.width(7);
@@ -215,7 +390,7 @@ void Statistics::Print(std::ostream& out) {  // NOLINT
 
   for (const typename map_t::value_type& t : tag_map) {
     size_t i = t.second;
-    out.width((std::streamsize)Instance().max_tag_length_);
+    out.width((std::streamsize)max_tag_length);
     out.setf(std::ios::left, std::ios::adjustfield);
     out << t.first << "\t";
     out.width(7);
@@ -239,7 +414,7 @@ void Statistics::Print(std::ostream& out) {  // NOLINT
 }
 
 void Statistics::WriteToYamlFile(std::string const& path) {
-  const map_t& tag_map = Instance().tag_map_;
+  const map_t tag_map = Instance().store_.GetTagMap();
 
   if (tag_map.empty()) {
     return;
@@ -282,8 +457,7 @@ std::string Statistics::Print() {
 }
 
 void Statistics::Reset() {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  Instance().tag_map_.clear();
+  Instance().store_.Reset();
 }
 
 }  // namespace statistics
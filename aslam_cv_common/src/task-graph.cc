@@ -0,0 +1,153 @@
+#include "aslam/common/task-graph.h"
+
+#include <algorithm>
+#include <exception>
+
+#include <glog/logging.h>
+
+namespace aslam {
+
+TaskGraph::TaskGraph(ThreadPool* thread_pool)
+    : thread_pool_(CHECK_NOTNULL(thread_pool)),
+      is_checked_acyclic_(true),
+      is_cancelled_(false),
+      num_unfinished_nodes_(0u),
+      num_executed_nodes_(0u),
+      is_running_(false) {}
+
+TaskGraph::~TaskGraph() {
+  wait();
+}
+
+TaskGraph::NodeId TaskGraph::addNode(const Task& task, const std::vector<NodeId>& dependencies) {
+  CHECK(task);
+  CHECK(!isRunning()) << "Can't change a running task graph.";
+  const NodeId node_id = nodes_.size();
+  nodes_.emplace_back(new Node(task));
+  root_nodes_.push_back(node_id);
+  for (const NodeId dependency : dependencies) {
+    addDependency(node_id, dependency);
+  }
+  return node_id;
+}
+
+void TaskGraph::addDependency(NodeId node, NodeId dependency) {
+  CHECK_LT(node, nodes_.size());
+  CHECK_LT(dependency, nodes_.size());
+  CHECK_NE(node, dependency);
+  CHECK(!isRunning()) << "Can't change a running task graph.";
+  nodes_[dependency]->successors.push_back(node);
+  if (nodes_[node]->num_dependencies++ == 0u) {
+    root_nodes_.erase(std::find(root_nodes_.begin(), root_nodes_.end(), node));
+  }
+  // Dependencies added after the node can close a cycle.
+  is_checked_acyclic_ = false;
+}
+
+void TaskGraph::checkIsAcyclic() const {
+  // Kahn's algorithm: all nodes are visited iff there is no cycle.
+  std::vector<size_t> num_missing_dependencies(nodes_.size());
+  for (size_t node_id = 0u; node_id < nodes_.size(); ++node_id) {
+    num_missing_dependencies[node_id] = nodes_[node_id]->num_dependencies;
+  }
+  std::vector<NodeId> ready_nodes(root_nodes_);
+  size_t num_visited_nodes = 0u;
+  while (!ready_nodes.empty()) {
+    const NodeId node_id = ready_nodes.back();
+    ready_nodes.pop_back();
+    ++num_visited_nodes;
+    for (const NodeId successor : nodes_[node_id]->successors) {
+      if (--num_missing_dependencies[successor] == 0u) {
+        ready_nodes.push_back(successor);
+      }
+    }
+  }
+  CHECK_EQ(num_visited_nodes, nodes_.size()) << "The task graph has a cycle.";
+}
+
+void TaskGraph::start(const CompletionCallback& completion_callback) {
+  {
+    std::unique_lock<std::mutex> lock(run_mutex_);
+    CHECK(!is_running_) << "The task graph is already running.";
+    is_running_ = true;
+  }
+  if (!is_checked_acyclic_) {
+    checkIsAcyclic();
+    is_checked_acyclic_ = true;
+  }
+  completion_callback_ = completion_callback;
+  is_cancelled_ = false;
+  num_executed_nodes_ = 0u;
+  for (const std::unique_ptr<Node>& node : nodes_) {
+    node->num_missing_dependencies = node->num_dependencies;
+  }
+
+  if (nodes_.empty()) {
+    num_unfinished_nodes_ = 1u;
+    finishNode();
+    return;
+  }
+  num_unfinished_nodes_ = nodes_.size();
+  for (const NodeId node_id : root_nodes_) {
+    enqueueNode(node_id);
+  }
+}
+
+bool TaskGraph::wait() {
+  std::unique_lock<std::mutex> lock(run_mutex_);
+  while (is_running_) {
+    run_finished_condition_.wait(lock);
+  }
+  return !is_cancelled_;
+}
+
+bool TaskGraph::isRunning() const {
+  std::unique_lock<std::mutex> lock(run_mutex_);
+  return is_running_;
+}
+
+void TaskGraph::enqueueNode(NodeId node_id) {
+  thread_pool_->enqueue([this, node_id]() { runNode(node_id); });
+}
+
+void TaskGraph::runNode(NodeId node_id) {
+  Node& node = *nodes_[node_id];
+  // The successors of skipped nodes are visited as well, such that the run completes.
+  if (!is_cancelled_) {
+    try {
+      node.task();
+      ++num_executed_nodes_;
+    } catch (const std::exception& exception) {
+      LOG(ERROR) << "Task graph node " << node_id << " failed, cancelling the run: "
+                 << exception.what();
+      cancel();
+    }
+  }
+  for (const NodeId successor : node.successors) {
+    if (--nodes_[successor]->num_missing_dependencies == 0u) {
+      enqueueNode(successor);
+    }
+  }
+  finishNode();
+}
+
+void TaskGraph::finishNode() {
+  if (--num_unfinished_nodes_ > 0u) {
+    return;
+  }
+  // The graph may be destroyed as soon as wait() returns, hence it is not touched after
+  // releasing the lock.
+  const CompletionCallback completion_callback = std::move(completion_callback_);
+  completion_callback_ = nullptr;
+  const bool success = !is_cancelled_;
+  {
+    std::unique_lock<std::mutex> lock(run_mutex_);
+    is_running_ = false;
+    run_finished_condition_.notify_all();
+  }
+  if (completion_callback) {
+    completion_callback(success);
+  }
+}
+
+}  // namespace aslam
@@ -1,132 +1,569 @@
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #include <aslam/common/thread-pool.h>
 
 namespace aslam {
 
+namespace {
+// The pool and index of the worker running on this thread, used to keep tasks enqueued from
+// within a task on the same worker.
+thread_local const ThreadPool* current_thread_pool = nullptr;
+thread_local size_t current_worker_index = 0u;
+
+inline int64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline size_t getLane(ThreadPool::Priority priority) {
+  return static_cast<size_t>(priority);
+}
+}  // namespace
+
+constexpr size_t ThreadPool::kGroupdIdNonExclusiveTask;
+constexpr size_t ThreadPool::kNumPriorities;
+constexpr double ThreadPool::kMetricsResolutionSeconds;
+
+ThreadPool::PriorityCounters::PriorityCounters()
+    : wait_time_histogram(kMetricsResolutionSeconds) {}
+
+ThreadPool::WorkerMetrics::WorkerMetrics()
+    : busy_nanoseconds(0),
+      idle_nanoseconds(0),
+      num_executed_tasks(0u),
+      num_stolen_tasks(0u) {}
+
 // The constructor just launches some amount of workers.
 ThreadPool::ThreadPool(const size_t threads)
-    : active_threads_(0),
+    : next_worker_queue_(0u),
+      num_tasks_in_worker_queues_(0u),
+      num_tasks_with_deadline_(0u),
+      metrics_enabled_(false),
+      num_sleeping_workers_(0u),
+      num_active_workers_(threads),
+      num_queued_tasks_(0u),
+      num_pending_tasks_(0u),
       stop_(false) {
+  for (size_t lane = 0u; lane < kNumPriorities; ++lane) {
+    num_tasks_in_lanes_[lane] = 0u;
+    priority_counters_[lane].num_queued_tasks = 0u;
+  }
+  resetStatistics();
+#ifdef __linux__
+  cpu_set_t cpu_set;
+  if (sched_getaffinity(0, sizeof(cpu_set_t), &cpu_set) == 0) {
+    for (size_t cpu_id = 0u; cpu_id < static_cast<size_t>(CPU_SETSIZE); ++cpu_id) {
+      if (CPU_ISSET(cpu_id, &cpu_set)) {
+        initial_cpu_ids_.push_back(cpu_id);
+      }
+    }
+  }
+#endif
+  for (size_t i = 0; i < threads; ++i) {
+    worker_queues_.emplace_back(new WorkerQueue);
+    worker_metrics_.emplace_back(new WorkerMetrics);
+  }
   for (size_t i = 0; i < threads; ++i)
-    workers_.emplace_back(std::bind(&ThreadPool::run, this));
+    workers_.emplace_back(std::bind(&ThreadPool::run, this, i));
 }
 
 // The destructor joins all threads.
 ThreadPool::~ThreadPool() {
   {
-    std::unique_lock<std::mutex> lock(tasks_mutex_);
+    std::unique_lock<std::mutex> lock(idle_mutex_);
     stop_ = true;
   }
-  tasks_queue_change_.notify_all();
+  idle_condition_.notify_all();
+  // The parked workers help to finish the pending tasks.
+  park_condition_.notify_all();
   for (size_t i = 0u; i < workers_.size(); ++i) {
     workers_[i].join();
   }
 }
 
-void ThreadPool::run() {
-  while (true) {
-    std::unique_lock<std::mutex> lock(this->tasks_mutex_);
-
-    // Here we need to select the next task from a queue that is not already
-    // serviced.
-    std::function<void()> task;
-    size_t group_id = kGroupdIdNonExclusiveTask;
-    while (true) {
-      const bool all_guards_active = std::all_of(
-          groupid_exclusivity_guards_.begin(),
-          groupid_exclusivity_guards_.end(),
-          [](const GuardMap::value_type& value) {
-            CHECK_NE(value.second, kGroupdIdNonExclusiveTask)
-              << "There should never be a guard for a non-exclusive task.";
-            return value.second;
-          });
+void ThreadPool::enqueueTask(const TaskOptions& options, size_t exclusivity_group_id,
+                             Task&& task) {
+  const Priority priority = options.priority;
+  CHECK_LT(getLane(priority), kNumPriorities);
+  // The clock is only read if the wait time is recorded or a deadline has to be checked.
+  const bool has_deadline = options.deadline_nanoseconds >= 0;
+  const int64_t enqueue_time_nanoseconds = (metrics_enabled_ || has_deadline) ? now() : -1;
+  const int64_t deadline_time_nanoseconds = has_deadline ?
+      enqueue_time_nanoseconds + options.deadline_nanoseconds : -1;
+  const bool record_wait_time = metrics_enabled_;
+  ++num_queued_tasks_;
+  ++num_pending_tasks_;
+  ++priority_counters_[getLane(priority)].num_queued_tasks;
+  Task user_task(std::move(task));
+  if (exclusivity_group_id == kGroupdIdNonExclusiveTask) {
+    pushTask(QueuedTask([this, user_task, priority, enqueue_time_nanoseconds,
+                         deadline_time_nanoseconds, record_wait_time]() mutable {
+      recordTaskStart(priority, enqueue_time_nanoseconds, deadline_time_nanoseconds,
+                      record_wait_time);
+      --num_queued_tasks_;
+      runUserTask(kGroupdIdNonExclusiveTask, user_task);
+      // Release the bound arguments before reporting the task as done.
+      user_task = nullptr;
+      finishTask();
+    }, priority, deadline_time_nanoseconds));
+    return;
+  }
+
+  // Only one task of a group is handed to the workers at a time, the next one is scheduled once
+  // it has finished.
+  bool schedule_group = false;
+  {
+    std::unique_lock<std::mutex> lock(exclusivity_groups_mutex_);
+    ExclusivityGroup& group = exclusivity_groups_[exclusivity_group_id];
+    group.tasks.emplace_back([this, user_task, exclusivity_group_id, priority,
+                              enqueue_time_nanoseconds, deadline_time_nanoseconds,
+                              record_wait_time]() {
+      recordTaskStart(priority, enqueue_time_nanoseconds, deadline_time_nanoseconds,
+                      record_wait_time);
+      runUserTask(exclusivity_group_id, user_task);
+    }, priority, deadline_time_nanoseconds);
+    schedule_group = !group.is_scheduled;
+    group.is_scheduled = true;
+  }
+  if (schedule_group) {
+    pushTask(QueuedTask([this, exclusivity_group_id]() {
+      runExclusivityGroup(exclusivity_group_id);
+    }, priority, deadline_time_nanoseconds));
+  }
+}
+
+void ThreadPool::pushTask(QueuedTask&& task) {
+  CHECK(!worker_queues_.empty()) << "Can't run tasks on a thread pool without threads.";
+  const size_t worker_index = (current_thread_pool == this) ?
+      current_worker_index : (next_worker_queue_++ % num_active_workers_);
+  WorkerQueue& worker_queue = *worker_queues_[worker_index];
+  const size_t lane = getLane(task.priority);
+  const bool has_deadline = task.deadline_time_nanoseconds >= 0;
+  {
+    std::unique_lock<std::mutex> lock(worker_queue.mutex);
+    worker_queue.tasks[lane].emplace_back(std::move(task));
+    if (has_deadline) {
+      ++worker_queue.num_tasks_with_deadline[lane];
+    }
+  }
+  ++num_tasks_in_lanes_[lane];
+  if (has_deadline) {
+    ++num_tasks_with_deadline_;
+  }
+  // A sleeping worker increments the sleeping count before it checks the task count. Together
+  // with the sequentially consistent atomics either the worker sees the new task or we see the
+  // sleeping worker.
+  ++num_tasks_in_worker_queues_;
+  if (num_sleeping_workers_ > 0u) {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_condition_.notify_one();
+  }
+}
 
-      if (!all_guards_active || num_queued_nonexclusive_tasks > 0u) {
-        // If not all guards are active, we select a task to process; otherwise
-        // we can go back to sleep until a thread reports back for work.
-        size_t index = 0u;
-        for (const TaskDeque::value_type& groupid_task : groupid_tasks_) {
-          // We have found a task to process if no thread is already working on
-          // this group id.
-          const bool is_exclusive_task =
-              groupid_task.first != kGroupdIdNonExclusiveTask;
-          bool guard_active = false;
-          if (is_exclusive_task) {
-            guard_active = groupid_exclusivity_guards_[groupid_task.first];
-          }
-
-          if (!(is_exclusive_task && guard_active)) {
-            group_id = groupid_task.first;
-            task = groupid_task.second;
-
-            groupid_tasks_.erase(groupid_tasks_.begin() + index);
-            if (!is_exclusive_task) {
-              --num_queued_nonexclusive_tasks;
-            }
-
-            // We jump out of the nested for-structure here, because we have
-            // found a task to process.
-            break;
-          }
-          ++index;
+bool ThreadPool::popTask(size_t worker_index, Task* task) {
+  CHECK_NOTNULL(task);
+  return popTaskFromLane(worker_index, getLane(Priority::kHigh), task) ||
+      popOverdueTask(worker_index, task) ||
+      popTaskFromLane(worker_index, getLane(Priority::kNormal), task) ||
+      popTaskFromLane(worker_index, getLane(Priority::kBackground), task);
+}
+
+bool ThreadPool::popTaskFromLane(size_t worker_index, size_t lane, Task* task) {
+  CHECK_NOTNULL(task);
+  if (num_tasks_in_lanes_[lane] == 0u) {
+    return false;
+  }
+  const size_t num_workers = worker_queues_.size();
+  // Start with the own deque, then try to steal from the others. Tasks are taken from the front
+  // in both cases which keeps the start order of every lane.
+  for (size_t offset = 0u; offset < num_workers; ++offset) {
+    WorkerQueue& worker_queue = *worker_queues_[(worker_index + offset) % num_workers];
+    std::unique_lock<std::mutex> lock(worker_queue.mutex);
+    std::deque<QueuedTask>& tasks = worker_queue.tasks[lane];
+    if (!tasks.empty()) {
+      if (tasks.front().deadline_time_nanoseconds >= 0) {
+        --worker_queue.num_tasks_with_deadline[lane];
+        --num_tasks_with_deadline_;
+      }
+      *task = std::move(tasks.front().task);
+      tasks.pop_front();
+      --num_tasks_in_lanes_[lane];
+      --num_tasks_in_worker_queues_;
+      if (offset > 0u && metrics_enabled_) {
+        ++worker_metrics_[worker_index]->num_stolen_tasks;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::popOverdueTask(size_t worker_index, Task* task) {
+  CHECK_NOTNULL(task);
+  if (num_tasks_with_deadline_ == 0u) {
+    return false;
+  }
+  const int64_t now_nanoseconds = now();
+  const size_t num_workers = worker_queues_.size();
+  for (size_t lane = getLane(Priority::kNormal); lane < kNumPriorities; ++lane) {
+    if (num_tasks_in_lanes_[lane] == 0u) {
+      continue;
+    }
+    for (size_t offset = 0u; offset < num_workers; ++offset) {
+      WorkerQueue& worker_queue = *worker_queues_[(worker_index + offset) % num_workers];
+      std::unique_lock<std::mutex> lock(worker_queue.mutex);
+      if (worker_queue.num_tasks_with_deadline[lane] == 0u) {
+        continue;
+      }
+      // Tasks without a deadline or with a later one may be queued before an overdue task.
+      std::deque<QueuedTask>& tasks = worker_queue.tasks[lane];
+      const std::deque<QueuedTask>::iterator overdue_task = std::find_if(
+          tasks.begin(), tasks.end(), [now_nanoseconds](const QueuedTask& queued_task) {
+            return queued_task.deadline_time_nanoseconds >= 0 &&
+                queued_task.deadline_time_nanoseconds <= now_nanoseconds;
+          });
+      if (overdue_task != tasks.end()) {
+        *task = std::move(overdue_task->task);
+        tasks.erase(overdue_task);
+        --worker_queue.num_tasks_with_deadline[lane];
+        --num_tasks_with_deadline_;
+        --num_tasks_in_lanes_[lane];
+        --num_tasks_in_worker_queues_;
+        if (offset > 0u && metrics_enabled_) {
+          ++worker_metrics_[worker_index]->num_stolen_tasks;
         }
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::recordTaskStart(Priority priority, int64_t enqueue_time_nanoseconds,
+                                 int64_t deadline_time_nanoseconds, bool record_wait_time) {
+  PriorityCounters& counters = priority_counters_[getLane(priority)];
+  --counters.num_queued_tasks;
+  ++counters.num_started_tasks;
+  if (enqueue_time_nanoseconds < 0) {
+    return;
+  }
+  const int64_t start_time_nanoseconds = now();
+  if (deadline_time_nanoseconds >= 0 && start_time_nanoseconds > deadline_time_nanoseconds) {
+    ++counters.num_missed_deadlines;
+  }
+  if (record_wait_time) {
+    counters.wait_time_histogram.Record(
+        std::max<int64_t>(0, start_time_nanoseconds - enqueue_time_nanoseconds) * 1e-9);
+  }
+}
+
+void ThreadPool::runUserTask(size_t exclusivity_group_id, const Task& task) {
+  if (!metrics_enabled_ || current_thread_pool != this) {
+    task();
+    return;
+  }
+  const int64_t start_time_nanoseconds = now();
+  task();
+  const double execution_time_seconds = (now() - start_time_nanoseconds) * 1e-9;
+  WorkerMetrics& worker_metrics = *worker_metrics_[current_worker_index];
+  ++worker_metrics.num_executed_tasks;
+  std::unique_lock<std::mutex> lock(worker_metrics.execution_time_mutex);
+  // The histograms are large, one is only created for the first task of a group on a worker.
+  std::unordered_map<size_t, statistics::LogHistogram>::iterator it =
+      worker_metrics.execution_time_histograms.find(exclusivity_group_id);
+  if (it == worker_metrics.execution_time_histograms.end()) {
+    it = worker_metrics.execution_time_histograms.emplace(
+        exclusivity_group_id, statistics::LogHistogram(kMetricsResolutionSeconds)).first;
+  }
+  it->second.Record(execution_time_seconds);
+}
+
+void ThreadPool::runExclusivityGroup(size_t exclusivity_group_id) {
+  Task task;
+  {
+    std::unique_lock<std::mutex> lock(exclusivity_groups_mutex_);
+    std::unordered_map<size_t, ExclusivityGroup>::iterator it =
+        exclusivity_groups_.find(exclusivity_group_id);
+    CHECK(it != exclusivity_groups_.end());
+    CHECK(it->second.is_scheduled);
+    CHECK(!it->second.tasks.empty());
+    task = std::move(it->second.tasks.front().task);
+    it->second.tasks.pop_front();
+  }
+  --num_queued_tasks_;
+  task();
+  task = nullptr;
+
+  bool reschedule_group = false;
+  // The group is dispatched with the options of its next task.
+  Priority priority = Priority::kNormal;
+  int64_t deadline_time_nanoseconds = -1;
+  {
+    std::unique_lock<std::mutex> lock(exclusivity_groups_mutex_);
+    std::unordered_map<size_t, ExclusivityGroup>::iterator it =
+        exclusivity_groups_.find(exclusivity_group_id);
+    CHECK(it != exclusivity_groups_.end());
+    if (it->second.tasks.empty()) {
+      exclusivity_groups_.erase(it);
+    } else {
+      reschedule_group = true;
+      priority = it->second.tasks.front().priority;
+      deadline_time_nanoseconds = it->second.tasks.front().deadline_time_nanoseconds;
+    }
+  }
+  if (reschedule_group) {
+    pushTask(QueuedTask([this, exclusivity_group_id]() {
+      runExclusivityGroup(exclusivity_group_id);
+    }, priority, deadline_time_nanoseconds));
+  }
+  finishTask();
+}
+
+void ThreadPool::finishTask() {
+  if (--num_pending_tasks_ == 0u) {
+    // This is the secret to making the waitForEmptyQueue() function work.
+    // After finishing the last task, notify that all work is done.
+    {
+      std::unique_lock<std::mutex> lock(completion_mutex_);
+    }
+    completion_condition_.notify_all();
+    if (stop_) {
+      std::unique_lock<std::mutex> lock(idle_mutex_);
+      idle_condition_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::run(size_t worker_index) {
+  current_thread_pool = this;
+  current_worker_index = worker_index;
+  while (true) {
+    if (worker_index >= num_active_workers_ && !stop_) {
+      std::unique_lock<std::mutex> lock(idle_mutex_);
+      // The wake-up which ended the idle sleep of this worker may have been meant for a new
+      // task, hence it is passed on to a sleeping active worker.
+      if (num_tasks_in_worker_queues_ > 0u && num_sleeping_workers_ > 0u) {
+        idle_condition_.notify_one();
       }
-      if (task) {
-        break;
+      while (worker_index >= num_active_workers_ && !stop_) {
+        park_condition_.wait(lock);
       }
+      continue;
+    }
 
-      // Wait until the queue has changed (addition/removal) before re-checking
-      // for new tasks to process.
-      if (this->stop_ && groupid_tasks_.size() == 0u) {
-        return;
+    Task task;
+    if (popTask(worker_index, &task)) {
+      if (metrics_enabled_) {
+        const int64_t start_time_nanoseconds = now();
+        task();
+        worker_metrics_[worker_index]->busy_nanoseconds += now() - start_time_nanoseconds;
+      } else {
+        task();
       }
+      continue;
+    }
+
+    // Go to sleep until new tasks arrive. The workers only exit once all tasks are done.
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    ++num_sleeping_workers_;
+    const int64_t sleep_time_nanoseconds = metrics_enabled_ ? now() : -1;
+    while (num_tasks_in_worker_queues_ == 0u && !(stop_ && num_pending_tasks_ == 0u) &&
+           worker_index < num_active_workers_) {
+      idle_condition_.wait(lock);
+    }
+    if (sleep_time_nanoseconds >= 0) {
+      worker_metrics_[worker_index]->idle_nanoseconds += now() - sleep_time_nanoseconds;
+    }
+    --num_sleeping_workers_;
+    if (num_tasks_in_worker_queues_ == 0u && stop_ && num_pending_tasks_ == 0u) {
+      return;
+    }
+  }
+}
 
-      this->tasks_queue_change_.wait(lock);
+bool ThreadPool::setCpuAffinity(const std::vector<size_t>& cpu_ids) {
+  CHECK(!cpu_ids.empty());
+#ifdef __linux__
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const size_t cpu_id : cpu_ids) {
+    CHECK_LT(cpu_id, static_cast<size_t>(CPU_SETSIZE));
+    CPU_SET(cpu_id, &cpu_set);
+  }
+  bool success = true;
+  for (std::thread& worker : workers_) {
+    const int result = pthread_setaffinity_np(worker.native_handle(), sizeof(cpu_set_t), &cpu_set);
+    if (result != 0) {
+      LOG(WARNING) << "Could not set the CPU affinity of a worker: " << std::strerror(result);
+      success = false;
     }
+  }
+  return success;
+#else
+  LOG(WARNING) << "Setting the CPU affinity is not supported on this platform.";
+  return false;
+#endif
+}
 
-    // We jump here if we found a task.
-    CHECK(task);
-    ++active_threads_;
+bool ThreadPool::resetCpuAffinity() {
+  if (initial_cpu_ids_.empty()) {
+    LOG(WARNING) << "The initial CPU affinity of the workers is not known.";
+    return false;
+  }
+  return setCpuAffinity(initial_cpu_ids_);
+}
 
-    // Make sure the no other thread is currently working on this exclusivity
-    // group.
-    if (group_id != kGroupdIdNonExclusiveTask) {
-      const GuardMap::iterator it_group_id_serviced =
-          groupid_exclusivity_guards_.find(group_id);
-      CHECK(it_group_id_serviced == groupid_exclusivity_guards_.end() ||
-            it_group_id_serviced->second == false);
-      it_group_id_serviced->second = true;
+std::vector<size_t> ThreadPool::getCpuAffinity() const {
+  std::vector<size_t> cpu_ids;
+#ifdef __linux__
+  cpu_set_t workers_cpu_set;
+  CPU_ZERO(&workers_cpu_set);
+  for (const std::thread& worker : workers_) {
+    cpu_set_t cpu_set;
+    // std::thread::native_handle() is not const, reading the affinity doesn't modify the thread.
+    const int result = pthread_getaffinity_np(
+        const_cast<std::thread&>(worker).native_handle(), sizeof(cpu_set_t), &cpu_set);
+    if (result != 0) {
+      LOG(WARNING) << "Could not get the CPU affinity of a worker: " << std::strerror(result);
+      continue;
     }
+    CPU_OR(&workers_cpu_set, &workers_cpu_set, &cpu_set);
+  }
+  for (size_t cpu_id = 0u; cpu_id < static_cast<size_t>(CPU_SETSIZE); ++cpu_id) {
+    if (CPU_ISSET(cpu_id, &workers_cpu_set)) {
+      cpu_ids.push_back(cpu_id);
+    }
+  }
+#endif
+  return cpu_ids;
+}
 
-    // Unlock the queue while we execute the task.
-    lock.unlock();
-    task();
-    lock.lock();
+bool ThreadPool::setRealTimePriority(int priority) {
+#ifdef __linux__
+  CHECK_GE(priority, sched_get_priority_min(SCHED_FIFO));
+  CHECK_LE(priority, sched_get_priority_max(SCHED_FIFO));
+  sched_param parameters;
+  parameters.sched_priority = priority;
+  bool success = true;
+  for (std::thread& worker : workers_) {
+    const int result = pthread_setschedparam(worker.native_handle(), SCHED_FIFO, &parameters);
+    if (result != 0) {
+      LOG(WARNING) << "Could not set the real-time priority of a worker: "
+                   << std::strerror(result);
+      success = false;
+    }
+  }
+  return success;
+#else
+  LOG(WARNING) << "Real-time priorities are not supported on this platform.";
+  return false;
+#endif
+}
+
+void ThreadPool::setNumActiveThreads(size_t num_active_threads) {
+  CHECK_GE(num_active_threads, 1u);
+  CHECK_LE(num_active_threads, workers_.size());
+  {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    num_active_workers_ = num_active_threads;
+  }
+  // Idle workers beyond the limit move on to park, unparked workers look for tasks.
+  idle_condition_.notify_all();
+  park_condition_.notify_all();
+}
+
+size_t ThreadPool::numQueuedTasks() const {
+  return num_queued_tasks_;
+}
 
-    // Release the group for other threads.
-    if (group_id != kGroupdIdNonExclusiveTask) {
-      const GuardMap::iterator it_group_id_servied =
-          groupid_exclusivity_guards_.find(group_id);
-      CHECK(it_group_id_servied != groupid_exclusivity_guards_.end() &&
-            it_group_id_servied->second == true);
-      it_group_id_servied->second = false;
+ThreadPool::PriorityStatistics ThreadPool::getStatistics(Priority priority) const {
+  CHECK_LT(getLane(priority), kNumPriorities);
+  const PriorityCounters& counters = priority_counters_[getLane(priority)];
+  PriorityStatistics statistics;
+  statistics.num_queued_tasks = counters.num_queued_tasks;
+  statistics.num_started_tasks = counters.num_started_tasks;
+  statistics.num_missed_deadlines = counters.num_missed_deadlines;
+  statistics.mean_wait_nanoseconds = counters.wait_time_histogram.GetMean() * 1e9;
+  statistics.max_wait_nanoseconds =
+      static_cast<int64_t>(std::round(counters.wait_time_histogram.GetMax() * 1e9));
+  statistics.p50_wait_nanoseconds =
+      static_cast<int64_t>(std::round(counters.wait_time_histogram.GetPercentile(0.5) * 1e9));
+  statistics.p99_wait_nanoseconds =
+      static_cast<int64_t>(std::round(counters.wait_time_histogram.GetPercentile(0.99) * 1e9));
+  return statistics;
+}
+
+void ThreadPool::setMetricsEnabled(bool enabled) {
+  metrics_enabled_ = enabled;
+}
+
+ThreadPool::Metrics ThreadPool::getMetrics() const {
+  Metrics metrics;
+  metrics.wait_time_histogram = statistics::LogHistogram(kMetricsResolutionSeconds);
+  for (const std::unique_ptr<WorkerMetrics>& worker_metrics : worker_metrics_) {
+    Metrics::Worker worker;
+    worker.busy_seconds = worker_metrics->busy_nanoseconds * 1e-9;
+    worker.idle_seconds = worker_metrics->idle_nanoseconds * 1e-9;
+    worker.num_executed_tasks = worker_metrics->num_executed_tasks;
+    worker.num_stolen_tasks = worker_metrics->num_stolen_tasks;
+    metrics.workers.push_back(worker);
+
+    std::unique_lock<std::mutex> lock(worker_metrics->execution_time_mutex);
+    for (const std::pair<const size_t, statistics::LogHistogram>& group_histogram :
+         worker_metrics->execution_time_histograms) {
+      metrics.execution_time_histograms.emplace(
+          group_histogram.first, statistics::LogHistogram(kMetricsResolutionSeconds))
+          .first->second.Merge(group_histogram.second);
     }
+  }
+  for (const PriorityCounters& counters : priority_counters_) {
+    metrics.wait_time_histogram.Merge(counters.wait_time_histogram);
+  }
+  return metrics;
+}
 
-    --active_threads_;
+void ThreadPool::resetMetrics() {
+  for (const std::unique_ptr<WorkerMetrics>& worker_metrics : worker_metrics_) {
+    worker_metrics->busy_nanoseconds = 0;
+    worker_metrics->idle_nanoseconds = 0;
+    worker_metrics->num_executed_tasks = 0u;
+    worker_metrics->num_stolen_tasks = 0u;
+    std::unique_lock<std::mutex> lock(worker_metrics->execution_time_mutex);
+    worker_metrics->execution_time_histograms.clear();
+  }
+  for (PriorityCounters& counters : priority_counters_) {
+    counters.wait_time_histogram.Reset();
+  }
+}
 
-    // This is the secret to making the waitForEmptyQueue() function work.
-    // After finishing a task, notify that this work is done.
-    tasks_queue_change_.notify_all();
+void ThreadPool::resetStatistics() {
+  // The queued tasks are the current state, not a statistic.
+  for (PriorityCounters& counters : priority_counters_) {
+    counters.num_started_tasks = 0u;
+    counters.num_missed_deadlines = 0u;
+    counters.wait_time_histogram.Reset();
   }
 }
 
 void ThreadPool::waitForEmptyQueue() const {
-  std::unique_lock<std::mutex> lock(this->tasks_mutex_);
+  std::unique_lock<std::mutex> lock(this->completion_mutex_);
   // Only exit if all tasks are complete by tracking the number of
-  // active threads.
-  while (active_threads_ > 0u || groupid_tasks_.size() > 0u) {
-    this->tasks_queue_change_.wait(lock);
+  // unfinished tasks.
+  while (num_pending_tasks_ > 0u) {
+    this->completion_condition_.wait(lock);
   }
 }
+
+size_t ThreadPool::reserveExclusivityGroupId() {
+  static std::atomic<size_t> next_group_id(kGroupdIdNonExclusiveTask - 1u);
+  return next_group_id.fetch_sub(1u);
+}
 }  // namespace aslam
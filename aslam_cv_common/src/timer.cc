@@ -6,56 +6,87 @@
 #include <sstream>
 #include <stdio.h>
 #include <string>
+#include <thread>
+
+#include <glog/logging.h>
+
+#include "aslam/common/trace-recorder.h"
 
 namespace timing {
 
 const double kNumSecondsPerNanosecond = 1.e-9;
 
+namespace {
+double CalibrateSecondsPerTick() {
+#if defined(__aarch64__)
+  uint64_t ticks_per_second;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(ticks_per_second));
+  CHECK_GT(ticks_per_second, 0u);
+  return 1.0 / static_cast<double>(ticks_per_second);
+#elif defined(__x86_64__) || defined(__i386__)
+  // Count the ticks during a few milliseconds of the steady clock.
+  const std::chrono::milliseconds kCalibrationDuration(10);
+  const std::chrono::steady_clock::time_point start_time =
+      std::chrono::steady_clock::now();
+  const uint64_t start_ticks = CycleClock::Now();
+  std::this_thread::sleep_for(kCalibrationDuration);
+  const uint64_t end_ticks = CycleClock::Now();
+  const double seconds =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start_time)
+          .count() *
+      kNumSecondsPerNanosecond;
+  CHECK_GT(end_ticks, start_ticks);
+  return seconds / static_cast<double>(end_ticks - start_ticks);
+#else
+  return kNumSecondsPerNanosecond;
+#endif
+}
+
+struct ThreadSamplingState {
+  ThreadSamplingState() : interval(1u), num_starts(0u) {}
+  uint32_t interval;
+  uint32_t num_starts;
+};
+}  // namespace
+
+double CycleClock::GetSecondsPerTick() {
+  static const double seconds_per_tick = CalibrateSecondsPerTick();
+  return seconds_per_tick;
+}
+
 Timing& Timing::Instance() {
   static Timing t;
   return t;
 }
 
-Timing::Timing() : max_tag_length_(0u) {}
+Timing::Timing()
+    : store_(kNumSecondsPerNanosecond), sampling_generation_(0u) {
+  // Calibrate before the first timer stops.
+  CycleClock::GetSecondsPerTick();
+}
 
 Timing::~Timing() {}
 
 // Static functions to query the timers:
 size_t Timing::GetHandle(const std::string& tag) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  // Search for an existing tag.
-  map_t::iterator tag_iterator = Instance().tag_map_.find(tag);
-  if (tag_iterator == Instance().tag_map_.end()) {
-    // If it is not there, create a tag.
-    size_t handle = Instance().timers_.size();
-    Instance().tag_map_[tag] = handle;
-    Instance().timers_.push_back(statistics::StatisticsMapValue());
-    // Track the maximum tag length to help printing a table of timing values
-    // later.
-    Instance().max_tag_length_ =
-        std::max(Instance().max_tag_length_, tag.size());
-    return handle;
-  } else {
-    return tag_iterator->second;
-  }
+  return Instance().store_.GetHandle(tag);
 }
 
 std::string Timing::GetTag(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  std::string tag;
-
-  // Perform a linear search for the tag.
-  for (const typename map_t::value_type& current_tag : Instance().tag_map_) {
-    if (current_tag.second == handle) {
-      return current_tag.first;
-    }
-  }
-  return tag;
+  return Instance().store_.GetTag(handle);
 }
 
 // Class functions used for timing.
 TimerImpl::TimerImpl(const std::string& tag, bool construct_stopped)
-    : is_timing_(false), handle_(Timing::GetHandle(tag)), tag_(tag) {
+    : is_timing_(false), handle_(Timing::GetHandle(tag)) {
+  if (!construct_stopped) {
+    Start();
+  }
+}
+
+TimerImpl::TimerImpl(size_t handle, bool construct_stopped)
+    : is_timing_(false), handle_(handle) {
   if (!construct_stopped) {
     Start();
   }
@@ -68,20 +99,24 @@ TimerImpl::~TimerImpl() {
 }
 
 void TimerImpl::Start() {
-  is_timing_ = true;
-  time_ = std::chrono::system_clock::now();
+  is_timing_ = Timing::Instance().ShouldSample(handle_);
+  if (is_timing_) {
+    start_ticks_ = CycleClock::Now();
+  }
 }
 
 double TimerImpl::Stop() {
   if (is_timing_) {
-    std::chrono::time_point<std::chrono::system_clock> now =
-        std::chrono::system_clock::now();
-    double dt =
-        static_cast<double>(
-            std::chrono::duration_cast<std::chrono::nanoseconds>(now - time_)
-                .count()) *
-        kNumSecondsPerNanosecond;
+    const uint64_t end_ticks = CycleClock::Now();
+    const double dt = CycleClock::TicksToSeconds(
+        end_ticks > start_ticks_ ? end_ticks - start_ticks_ : 0u);
     Timing::Instance().AddTime(handle_, dt);
+    aslam::common::TraceRecorder& trace_recorder = aslam::common::TraceRecorder::instance();
+    if (trace_recorder.areTimerScopesEnabled()) {
+      const int64_t end_nanoseconds = aslam::common::TraceRecorder::now();
+      trace_recorder.recordTimerScope(
+          handle_, end_nanoseconds - static_cast<int64_t>(dt * 1e9), end_nanoseconds);
+    }
     is_timing_ = false;
     return dt;
   }
@@ -101,13 +136,55 @@ size_t TimerImpl::GetHandle() const {
 }
 
 void Timing::AddTime(size_t handle, double seconds) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  timers_[handle].AddValue(seconds);
+  store_.AddSample(handle, seconds);
+}
+
+bool Timing::ShouldSample(size_t handle) {
+  // The intervals of the handles used by this thread, reloaded after changes.
+  static thread_local std::vector<ThreadSamplingState> thread_states;
+  static thread_local uint64_t thread_generation = 0u;
+  const uint64_t generation =
+      sampling_generation_.load(std::memory_order_acquire);
+  if (thread_generation != generation || handle >= thread_states.size()) {
+    std::lock_guard<std::mutex> lock(sampling_mutex_);
+    thread_generation = sampling_generation_.load(std::memory_order_relaxed);
+    thread_states.resize(std::max(thread_states.size(), handle + 1u));
+    for (size_t state_handle = 0u; state_handle < thread_states.size();
+         ++state_handle) {
+      std::map<size_t, uint32_t>::const_iterator it =
+          sampling_intervals_.find(state_handle);
+      thread_states[state_handle].interval =
+          it == sampling_intervals_.end() ? 1u : it->second;
+    }
+  }
+
+  ThreadSamplingState& state = thread_states[handle];
+  if (state.interval <= 1u) {
+    return true;
+  }
+  const bool is_sampled = state.num_starts == 0u;
+  state.num_starts = (state.num_starts + 1u) % state.interval;
+  return is_sampled;
+}
+
+void Timing::SetSamplingInterval(const std::string& tag, uint32_t interval) {
+  CHECK_GT(interval, 0u);
+  const size_t handle = GetHandle(tag);
+  std::lock_guard<std::mutex> lock(Instance().sampling_mutex_);
+  Instance().sampling_intervals_[handle] = interval;
+  Instance().sampling_generation_.fetch_add(1u, std::memory_order_release);
+}
+
+uint32_t Timing::GetSamplingInterval(const std::string& tag) {
+  const size_t handle = GetHandle(tag);
+  std::lock_guard<std::mutex> lock(Instance().sampling_mutex_);
+  std::map<size_t, uint32_t>::const_iterator it =
+      Instance().sampling_intervals_.find(handle);
+  return it == Instance().sampling_intervals_.end() ? 1u : it->second;
 }
 
 double Timing::GetTotalSeconds(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().timers_[handle].Sum();
+  return Instance().store_.GetValue(handle).Sum();
 }
 
 double Timing::GetTotalSeconds(const std::string& tag) {
@@ -115,8 +192,7 @@ double Timing::GetTotalSeconds(const std::string& tag) {
 }
 
 double Timing::GetMeanSeconds(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().timers_[handle].Mean();
+  return Instance().store_.GetValue(handle).Mean();
 }
 
 double Timing::GetMeanSeconds(const std::string& tag) {
@@ -124,8 +200,7 @@ double Timing::GetMeanSeconds(const std::string& tag) {
 }
 
 size_t Timing::GetNumSamples(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().timers_[handle].TotalSamples();
+  return Instance().store_.GetValue(handle).TotalSamples();
 }
 
 size_t Timing::GetNumSamples(const std::string& tag) {
@@ -133,8 +208,7 @@ size_t Timing::GetNumSamples(const std::string& tag) {
 }
 
 double Timing::GetVarianceSeconds(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().timers_[handle].LazyVariance();
+  return Instance().store_.GetValue(handle).LazyVariance();
 }
 
 double Timing::GetVarianceSeconds(const std::string& tag) {
@@ -142,8 +216,7 @@ double Timing::GetVarianceSeconds(const std::string& tag) {
 }
 
 double Timing::GetMinSeconds(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().timers_[handle].Min();
+  return Instance().store_.GetValue(handle).Min();
 }
 
 double Timing::GetMinSeconds(const std::string& tag) {
@@ -151,8 +224,7 @@ double Timing::GetMinSeconds(const std::string& tag) {
 }
 
 double Timing::GetMaxSeconds(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return Instance().timers_[handle].Max();
+  return Instance().store_.GetValue(handle).Max();
 }
 
 double Timing::GetMaxSeconds(const std::string& tag) {
@@ -160,14 +232,33 @@ double Timing::GetMaxSeconds(const std::string& tag) {
 }
 
 double Timing::GetHz(size_t handle) {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  return 1.0 / Instance().timers_[handle].RollingMean();
+  return 1.0 / Instance().store_.GetValue(handle).RollingMean();
 }
 
 double Timing::GetHz(const std::string& tag) {
   return GetHz(GetHandle(tag));
 }
 
+double Timing::GetPercentileSeconds(size_t handle, double fraction) {
+  return Instance().store_.GetHistogram(handle).GetPercentile(fraction);
+}
+
+double Timing::GetPercentileSeconds(const std::string& tag, double fraction) {
+  return GetPercentileSeconds(GetHandle(tag), fraction);
+}
+
+statistics::HistogramMap Timing::GetHistograms() {
+  return Instance().store_.GetHistograms();
+}
+
+void Timing::WritePrometheus(std::ostream& out) {  // NOLINT
+  statistics::WritePrometheusSummary("aslam_timing_seconds", GetHistograms(), out);
+}
+
+void Timing::WriteJson(std::ostream& out) {  // NOLINT
+  statistics::WriteJson(GetHistograms(), out);
+}
+
 std::string Timing::SecondsToTimeString(double seconds) {
   double secs = fmod(seconds, 60);
   int minutes = (seconds / 60);
@@ -185,11 +276,8 @@ std::string Timing::SecondsToTimeString(double seconds) {
 }
 
 void Timing::Print(std::ostream& out) {  // NOLINT
-  map_t tagMap;
-  {
-    std::lock_guard<std::mutex> lock(Instance().mutex_);
-    tagMap = Instance().tag_map_;
-  }
+  const map_t tagMap = Instance().store_.GetTagMap();
+  const size_t max_tag_length = Instance().store_.GetMaxTagLength();
 
   if (tagMap.empty()) {
     return;
@@ -199,7 +287,7 @@ void Timing::Print(std::ostream& out) {  // NOLINT
   out << "-----------\n";
   for (typename map_t::value_type t : tagMap) {
     size_t time_i = t.second;
-    out.width((std::streamsize)Instance().max_tag_length_);
+    out.width((std::streamsize)max_tag_length);
     out.setf(std::ios::left, std::ios::adjustfield);
     out << t.first << "\t";
     out.width(7);
@@ -231,8 +319,7 @@ std::string Timing::Print() {
 }
 
 void Timing::Reset() {
-  std::lock_guard<std::mutex> lock(Instance().mutex_);
-  Instance().tag_map_.clear();
+  Instance().store_.Reset();
 }
 
 }  // namespace timing
@@ -0,0 +1,395 @@
+#include "aslam/common/trace-recorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <glog/logging.h>
+
+#include "aslam/common/statistics/statistics.h"
+#include "aslam/common/timer.h"
+
+DEFINE_bool(acv_pipeline_tracing, false,
+            "Record per-frame trace events of the visual pipelines.");
+DEFINE_int32(acv_pipeline_trace_capacity, 1 << 16,
+             "Number of trace events kept by the pipeline trace recorder.");
+DEFINE_bool(acv_pipeline_trace_timers, false,
+            "Also record the scopes of all timers while the pipelines are traced.");
+
+namespace aslam {
+namespace common {
+namespace {
+
+thread_local size_t thread_camera_index = 0u;
+thread_local int64_t thread_frame_timestamp_nanoseconds = -1;
+
+std::atomic<bool> signal_received(false);
+std::mutex signal_dump_mutex;
+std::string signal_dump_path;
+bool is_signal_dumper_running = false;
+
+void setSignalReceived(int /*signal_number*/) {
+  signal_received.store(true, std::memory_order_relaxed);
+}
+
+void runSignalDumper() {
+  const std::chrono::milliseconds kPollingInterval(50);
+  while (true) {
+    std::this_thread::sleep_for(kPollingInterval);
+    if (!signal_received.exchange(false, std::memory_order_relaxed)) {
+      continue;
+    }
+    std::string path;
+    {
+      std::lock_guard<std::mutex> lock(signal_dump_mutex);
+      path = signal_dump_path;
+    }
+    if (TraceRecorder::instance().exportChromeTraceJsonToFile(path)) {
+      LOG(INFO) << "Wrote the pipeline trace to " << path << ".";
+    }
+  }
+}
+
+std::string escapeJsonString(const std::string& value) {
+  std::string escaped;
+  for (const char character : value) {
+    if (character == '\\' || character == '"') {
+      escaped += '\\';
+    }
+    escaped += character;
+  }
+  return escaped;
+}
+
+uint32_t getCurrentThreadId() {
+  return static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+}
+
+// Nearest-rank percentile of sorted values.
+double getPercentile(const std::vector<int64_t>& sorted_values, double percentile) {
+  CHECK(!sorted_values.empty());
+  const size_t rank = static_cast<size_t>(
+      std::ceil(percentile / 100.0 * static_cast<double>(sorted_values.size())));
+  return static_cast<double>(sorted_values[std::max<size_t>(rank, 1u) - 1u]);
+}
+
+}  // namespace
+
+const char* getTraceStageName(TraceStage stage) {
+  switch (stage) {
+    case TraceStage::kEnqueue: return "enqueue";
+    case TraceStage::kDequeue: return "dequeue";
+    case TraceStage::kUndistort: return "undistort";
+    case TraceStage::kDetect: return "detect";
+    case TraceStage::kDescribe: return "describe";
+    case TraceStage::kNFrameComplete: return "nframe-complete";
+    case TraceStage::kConsume: return "consume";
+    case TraceStage::kTrack: return "track";
+    case TraceStage::kAssignTrackIds: return "assign-track-ids";
+    case TraceStage::kTimer: return "timer";
+    case TraceStage::kDecode: return "decode";
+    default: LOG(FATAL) << "Unknown trace stage " << static_cast<int>(stage) << ".";
+  }
+  return "";
+}
+
+/// The fields are atomics such that readers can copy a slot while it is overwritten. The
+/// sequence is odd while the event of index (sequence - 1) / 2 is written and 2 * index + 2 once
+/// it is complete, readers keep the copies of complete slots whose sequence didn't change.
+struct TraceRecorder::Slot {
+  Slot() : sequence(0u) {}
+
+  std::atomic<uint64_t> sequence;
+  std::atomic<uint32_t> stage;
+  std::atomic<uint32_t> camera_index;
+  std::atomic<int64_t> frame_timestamp_nanoseconds;
+  std::atomic<int64_t> start_nanoseconds;
+  std::atomic<int64_t> end_nanoseconds;
+  std::atomic<uint32_t> thread_id;
+  std::atomic<uint64_t> timer_handle;
+};
+
+TraceRecorder::TraceRecorder(size_t capacity)
+    : enabled_(false), are_timer_scopes_enabled_(false), capacity_(capacity),
+      slots_(new Slot[capacity]), num_recorded_events_(0u), num_cleared_events_(0u) {
+  CHECK_GT(capacity, 0u);
+}
+
+TraceRecorder::~TraceRecorder() {}
+
+TraceRecorder& TraceRecorder::instance() {
+  static TraceRecorder* recorder = []() {
+    TraceRecorder* new_recorder = new TraceRecorder(
+        static_cast<size_t>(std::max(FLAGS_acv_pipeline_trace_capacity, 1)));
+    new_recorder->setEnabled(FLAGS_acv_pipeline_tracing);
+    new_recorder->setTimerScopesEnabled(FLAGS_acv_pipeline_trace_timers);
+    return new_recorder;
+  }();
+  return *recorder;
+}
+
+int64_t TraceRecorder::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TraceRecorder::setThreadCameraIndex(size_t camera_index) {
+  thread_camera_index = camera_index;
+}
+
+size_t TraceRecorder::getThreadCameraIndex() {
+  return thread_camera_index;
+}
+
+void TraceRecorder::setThreadFrameTimestamp(int64_t frame_timestamp_nanoseconds) {
+  thread_frame_timestamp_nanoseconds = frame_timestamp_nanoseconds;
+}
+
+int64_t TraceRecorder::getThreadFrameTimestamp() {
+  return thread_frame_timestamp_nanoseconds;
+}
+
+void TraceRecorder::record(TraceStage stage, size_t camera_index,
+                           int64_t frame_timestamp_nanoseconds, int64_t start_nanoseconds,
+                           int64_t end_nanoseconds) {
+  if (!isEnabled()) {
+    return;
+  }
+  TraceEvent event;
+  event.stage = stage;
+  event.camera_index = static_cast<uint32_t>(camera_index);
+  event.frame_timestamp_nanoseconds = frame_timestamp_nanoseconds;
+  event.start_nanoseconds = start_nanoseconds;
+  event.end_nanoseconds = end_nanoseconds;
+  event.thread_id = getCurrentThreadId();
+  event.timer_handle = 0u;
+  writeEvent(event);
+}
+
+void TraceRecorder::recordInstant(TraceStage stage, size_t camera_index,
+                                  int64_t frame_timestamp_nanoseconds) {
+  if (!isEnabled()) {
+    return;
+  }
+  const int64_t time_nanoseconds = now();
+  record(stage, camera_index, frame_timestamp_nanoseconds, time_nanoseconds, time_nanoseconds);
+}
+
+void TraceRecorder::recordTimerScope(size_t timer_handle, int64_t start_nanoseconds,
+                                     int64_t end_nanoseconds) {
+  if (!areTimerScopesEnabled()) {
+    return;
+  }
+  TraceEvent event;
+  event.stage = TraceStage::kTimer;
+  event.camera_index = static_cast<uint32_t>(thread_camera_index);
+  event.frame_timestamp_nanoseconds = thread_frame_timestamp_nanoseconds;
+  event.start_nanoseconds = start_nanoseconds;
+  event.end_nanoseconds = end_nanoseconds;
+  event.thread_id = getCurrentThreadId();
+  event.timer_handle = timer_handle;
+  writeEvent(event);
+}
+
+void TraceRecorder::writeEvent(const TraceEvent& event) {
+  const uint64_t index = num_recorded_events_.fetch_add(1u, std::memory_order_relaxed);
+  Slot& slot = slots_[index % capacity_];
+  // Only a writer that lapped the whole buffer during this write competes for the slot. The
+  // newer event wins, an older one is dropped.
+  uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+  while (true) {
+    if (sequence >= 2u * index + 1u) {
+      return;
+    }
+    if ((sequence & 1u) != 0u) {
+      std::this_thread::yield();
+      sequence = slot.sequence.load(std::memory_order_relaxed);
+      continue;
+    }
+    if (slot.sequence.compare_exchange_weak(sequence, 2u * index + 1u,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+      break;
+    }
+  }
+  slot.stage.store(static_cast<uint32_t>(event.stage), std::memory_order_relaxed);
+  slot.camera_index.store(event.camera_index, std::memory_order_relaxed);
+  slot.frame_timestamp_nanoseconds.store(event.frame_timestamp_nanoseconds,
+                                         std::memory_order_relaxed);
+  slot.start_nanoseconds.store(event.start_nanoseconds, std::memory_order_relaxed);
+  slot.end_nanoseconds.store(event.end_nanoseconds, std::memory_order_relaxed);
+  slot.thread_id.store(event.thread_id, std::memory_order_relaxed);
+  slot.timer_handle.store(event.timer_handle, std::memory_order_relaxed);
+  slot.sequence.store(2u * index + 2u, std::memory_order_release);
+}
+
+std::vector<TraceEvent> TraceRecorder::getEvents() const {
+  const uint64_t num_recorded_events = num_recorded_events_.load(std::memory_order_acquire);
+  const uint64_t begin = std::max<uint64_t>(
+      num_recorded_events > capacity_ ? num_recorded_events - capacity_ : 0u,
+      num_cleared_events_.load(std::memory_order_relaxed));
+  std::vector<TraceEvent> events;
+  events.reserve(static_cast<size_t>(num_recorded_events - std::min(begin, num_recorded_events)));
+  for (uint64_t index = begin; index < num_recorded_events; ++index) {
+    const Slot& slot = slots_[index % capacity_];
+    const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != 2u * index + 2u) {
+      // Still being written, or already overwritten.
+      continue;
+    }
+    TraceEvent event;
+    event.stage = static_cast<TraceStage>(slot.stage.load(std::memory_order_relaxed));
+    event.camera_index = slot.camera_index.load(std::memory_order_relaxed);
+    event.frame_timestamp_nanoseconds =
+        slot.frame_timestamp_nanoseconds.load(std::memory_order_relaxed);
+    event.start_nanoseconds = slot.start_nanoseconds.load(std::memory_order_relaxed);
+    event.end_nanoseconds = slot.end_nanoseconds.load(std::memory_order_relaxed);
+    event.thread_id = slot.thread_id.load(std::memory_order_relaxed);
+    event.timer_handle = static_cast<size_t>(slot.timer_handle.load(std::memory_order_relaxed));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+      events.push_back(event);
+    }
+  }
+  return events;
+}
+
+size_t TraceRecorder::getNumRecordedEvents() const {
+  const uint64_t num_recorded_events = num_recorded_events_.load(std::memory_order_relaxed);
+  const uint64_t num_cleared_events = num_cleared_events_.load(std::memory_order_relaxed);
+  return static_cast<size_t>(
+      num_recorded_events - std::min(num_cleared_events, num_recorded_events));
+}
+
+void TraceRecorder::clear() {
+  num_cleared_events_.store(num_recorded_events_.load(std::memory_order_acquire),
+                            std::memory_order_relaxed);
+}
+
+void TraceRecorder::exportChromeTraceJson(std::ostream& out) const {
+  const std::vector<TraceEvent> events = getEvents();
+  // Chrome expects microseconds, the first event defines the origin.
+  const int64_t origin_nanoseconds = events.empty() ? 0 : std::min_element(
+      events.begin(), events.end(), [](const TraceEvent& lhs, const TraceEvent& rhs) {
+        return lhs.start_nanoseconds < rhs.start_nanoseconds;
+      })->start_nanoseconds;
+  std::map<size_t, std::string> timer_tags;
+  for (const TraceEvent& event : events) {
+    if (event.stage == TraceStage::kTimer && timer_tags.count(event.timer_handle) == 0u) {
+      timer_tags.emplace(event.timer_handle,
+                         escapeJsonString(timing::Timing::GetTag(event.timer_handle)));
+    }
+  }
+  out << "{\"traceEvents\":[";
+  out << std::fixed << std::setprecision(3);
+  for (size_t i = 0u; i < events.size(); ++i) {
+    const TraceEvent& event = events[i];
+    const bool is_timer = event.stage == TraceStage::kTimer;
+    const bool is_instant = !is_timer && event.end_nanoseconds == event.start_nanoseconds;
+    out << (i == 0u ? "\n" : ",\n");
+    out << "{\"name\":\""
+        << (is_timer ? timer_tags[event.timer_handle] : getTraceStageName(event.stage))
+        << "\",\"cat\":\"" << (is_timer ? "timing" : "aslam") << "\",\"ph\":\""
+        << (is_instant ? "i" : "X") << "\",\"ts\":"
+        << static_cast<double>(event.start_nanoseconds - origin_nanoseconds) * 1e-3;
+    if (is_instant) {
+      out << ",\"s\":\"t\"";
+    } else {
+      out << ",\"dur\":"
+          << static_cast<double>(event.end_nanoseconds - event.start_nanoseconds) * 1e-3;
+    }
+    out << ",\"pid\":" << event.camera_index << ",\"tid\":" << event.thread_id
+        << ",\"args\":{\"frame_timestamp_ns\":" << event.frame_timestamp_nanoseconds << "}}";
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool TraceRecorder::exportChromeTraceJsonToFile(const std::string& path) const {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open " << path << " to write the pipeline trace.";
+    return false;
+  }
+  exportChromeTraceJson(file);
+  return file.good();
+}
+
+void TraceRecorder::dumpOnSignal(int signal_number, const std::string& path) {
+  CHECK(!path.empty());
+  std::lock_guard<std::mutex> lock(signal_dump_mutex);
+  signal_dump_path = path;
+  std::signal(signal_number, &setSignalReceived);
+  if (!is_signal_dumper_running) {
+    is_signal_dumper_running = true;
+    // The instance is never destroyed, hence the thread never has to be joined.
+    std::thread(&runSignalDumper).detach();
+  }
+}
+
+TraceRecorder::StageSummary TraceRecorder::getStageSummary(TraceStage stage) const {
+  std::vector<int64_t> durations;
+  for (const TraceEvent& event : getEvents()) {
+    if (event.stage == stage) {
+      durations.push_back(event.end_nanoseconds - event.start_nanoseconds);
+    }
+  }
+  StageSummary summary;
+  summary.num_events = durations.size();
+  if (durations.empty()) {
+    summary.mean_nanoseconds = summary.p50_nanoseconds = summary.p99_nanoseconds =
+        summary.max_nanoseconds = 0.0;
+    return summary;
+  }
+  std::sort(durations.begin(), durations.end());
+  double sum = 0.0;
+  for (const int64_t duration : durations) {
+    sum += static_cast<double>(duration);
+  }
+  summary.mean_nanoseconds = sum / static_cast<double>(durations.size());
+  summary.p50_nanoseconds = getPercentile(durations, 50.0);
+  summary.p99_nanoseconds = getPercentile(durations, 99.0);
+  summary.max_nanoseconds = static_cast<double>(durations.back());
+  return summary;
+}
+
+void TraceRecorder::printSummary(std::ostream& out) const {
+  out << "Pipeline trace (ms)\t#\tmean\tp50\tp99\tmax" << std::endl;
+  for (int i = 0; i < static_cast<int>(TraceStage::kNumStages); ++i) {
+    const TraceStage stage = static_cast<TraceStage>(i);
+    if (stage == TraceStage::kTimer) {
+      continue;
+    }
+    const StageSummary summary = getStageSummary(stage);
+    if (summary.num_events == 0u) {
+      continue;
+    }
+    out << std::left << std::setw(20) << getTraceStageName(stage) << std::right << "\t"
+        << summary.num_events << std::fixed << std::setprecision(3)
+        << "\t" << summary.mean_nanoseconds * 1e-6 << "\t" << summary.p50_nanoseconds * 1e-6
+        << "\t" << summary.p99_nanoseconds * 1e-6 << "\t" << summary.max_nanoseconds * 1e-6
+        << std::endl;
+  }
+}
+
+void TraceRecorder::addToStatistics() const {
+  for (const TraceEvent& event : getEvents()) {
+    if (event.stage == TraceStage::kTimer) {
+      continue;
+    }
+    statistics::StatsCollector collector(
+        std::string("trace/") + getTraceStageName(event.stage));
+    collector.AddSample(
+        static_cast<double>(event.end_nanoseconds - event.start_nanoseconds) * 1e-9);
+  }
+}
+
+}  // namespace common
+}  // namespace aslam
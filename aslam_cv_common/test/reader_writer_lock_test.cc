@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <thread>
@@ -13,33 +15,65 @@ constexpr int kNumThreads = 20;
 
 namespace aslam {
 
-TEST_F(ReaderWriterMutexFixture, ReaderWriterLock) {
-  aslam::ReaderWriterMutex mutex;
+typedef ::testing::Types<ReaderWriterMutex, ReaderFirstReaderWriterMutex,
+                         ScalableReaderWriterMutex> MutexTypes;
+TYPED_TEST_CASE(ReaderWriterMutexFixture, MutexTypes);
+
+TYPED_TEST(ReaderWriterMutexFixture, ReaderWriterLock) {
   std::vector<std::thread> threads;
   for (int i = 0; i < kNumThreads; ++i) {
-    threads.emplace_back([this]() { reader(); });
-    threads.emplace_back([this]() { writer(); });
+    threads.emplace_back([this]() { this->reader(); });
+    threads.emplace_back([this]() { this->writer(); });
   }
   for (std::thread& thread : threads) {
     thread.join();
   }
-  EXPECT_EQ(0, value() % kMagicNumber);
+  EXPECT_EQ(0, this->value() % kMagicNumber);
 }
 
-TEST_F(ReaderWriterMutexFixture, UpgradeReaderLock) {
+TYPED_TEST(ReaderWriterMutexFixture, UpgradeReaderLock) {
   std::vector<std::thread> threads;
   for (int i = 0; i < kNumThreads; ++i) {
-    threads.emplace_back([this]() { delayedReader(); });
-    threads.emplace_back([this]() { readerUpgrade(); });
+    threads.emplace_back([this]() { this->delayedReader(); });
+    threads.emplace_back([this]() { this->readerUpgrade(); });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  VLOG(3) << "Number of writes after upgrade: " << this->num_writes();
+  VLOG(3) << "Number of failed upgrades: " << this->num_upgrade_failures();
+  EXPECT_NE(0, this->value());
+  EXPECT_NE(0, this->num_writes());
+  EXPECT_EQ(this->value(), this->num_writes() * kMagicNumber);
+}
+
+// Mostly readers on all cores, with an occasional write. Logs the throughput to compare the
+// mutex types.
+TYPED_TEST(ReaderWriterMutexFixture, ReadContentionBenchmark) {
+  const int num_threads =
+      std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+  std::atomic<int> num_reads_failed(0);
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int thread_index = 0; thread_index < num_threads; ++thread_index) {
+    // One thread writes occasionally.
+    threads.emplace_back([this, thread_index, &num_reads_failed]() {
+      this->mostlyReader(thread_index == 0, &num_reads_failed);
+    });
   }
   for (std::thread& thread : threads) {
     thread.join();
   }
-  VLOG(3) << "Number of writes after upgrade: " << num_writes();
-  VLOG(3) << "Number of failed upgrades: " << num_upgrade_failures();
-  EXPECT_NE(0, value());
-  EXPECT_NE(0, num_writes());
-  EXPECT_EQ(value(), num_writes() * kMagicNumber);
+  const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  EXPECT_EQ(0, num_reads_failed.load());
+  EXPECT_EQ(kNumBenchmarkReadsPerThread / kNumBenchmarkReadsPerWrite * kMagicNumber,
+            this->value());
+  EXPECT_FALSE(this->value_mutex_.isInUse());
+  LOG(INFO) << ::testing::UnitTest::GetInstance()->current_test_info()->type_param() << ": "
+            << num_threads << " threads, "
+            << static_cast<double>(num_threads) * kNumBenchmarkReadsPerThread / seconds * 1e-6
+            << " million locks per second.";
 }
 
 }  // namespace aslam
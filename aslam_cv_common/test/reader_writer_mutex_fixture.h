@@ -5,13 +5,18 @@
 #include <atomic>
 
 #include <gtest/gtest.h>
+#include <aslam/common/reader-first-reader-writer-lock.h>
 #include <aslam/common/reader-writer-lock.h>
+#include <aslam/common/scalable-reader-writer-lock.h>
 
 constexpr int kMagicNumber = 29845;
 constexpr int kNumCycles = 1000;
+constexpr int kNumBenchmarkReadsPerThread = 100000;
+constexpr int kNumBenchmarkReadsPerWrite = 1000;
 
 namespace aslam {
 
+template <typename MutexType>
 class ReaderWriterMutexFixture : public ::testing::Test {
  private:
   int value_;
@@ -25,12 +30,14 @@ class ReaderWriterMutexFixture : public ::testing::Test {
   void writer();
   void delayedReader();
   void readerUpgrade();
+  // Counts the reads that saw a partial write.
+  void mostlyReader(bool is_writing, std::atomic<int>* num_reads_failed);
 
   int value() { return value_; }
   int num_writes() { return num_writes_; }
   int num_upgrade_failures() { return num_upgrade_failures_; }
 
-  ReaderWriterMutex value_mutex_;
+  MutexType value_mutex_;
 };
 
 }  // namespace aslam
@@ -0,0 +1,62 @@
+#include <cstdint>
+#include <vector>
+
+#include <eigen-checks/gtest.h>
+#include <gtest/gtest.h>
+
+#include <aslam/common/aligned-descriptors.h>
+#include <aslam/common/entrypoint.h>
+
+namespace aslam {
+namespace common {
+
+TEST(AlignedDescriptors, PaddedLayoutAndView) {
+  const AlignedDescriptors::DescriptorsT descriptors =
+      AlignedDescriptors::DescriptorsT::Random(20, 7);
+  AlignedDescriptors aligned(descriptors);
+  EXPECT_EQ(7u, aligned.size());
+  EXPECT_EQ(20u, aligned.getDescriptorSizeBytes());
+  EXPECT_EQ(32u, aligned.getStrideBytes());
+  EXPECT_EQ(64u, AlignedDescriptors::getStrideBytes(48u));
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(aligned.data()) %
+            AlignedDescriptors::kBaseAlignmentBytes);
+
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(descriptors, aligned.getDescriptors()));
+  EXPECT_EQ(aligned.data(), aligned.getDescriptors().data());
+  for (size_t i = 0u; i < aligned.size(); ++i) {
+    for (size_t byte = 20u; byte < aligned.getStrideBytes(); ++byte) {
+      EXPECT_EQ(0u, aligned.getDescriptor(i)[byte]);
+    }
+  }
+}
+
+TEST(AlignedDescriptors, BatchDistancesMatchReference) {
+  // 48 bytes leaves a 128 bit tail in the dense layout, 20 bytes is not a multiple of 16.
+  for (const int descriptor_size_bytes : {20, 48, 64}) {
+    const AlignedDescriptors::DescriptorsT descriptors =
+        AlignedDescriptors::DescriptorsT::Random(descriptor_size_bytes, 50);
+    const AlignedDescriptors aligned(descriptors);
+    std::vector<int> candidate_indices;
+    for (int i = 49; i >= 0; i -= 3) {
+      candidate_indices.push_back(i);
+    }
+
+    std::vector<Hamming::ResultType> distances;
+    computeHammingDistancesBatch(aligned.getDescriptor(4u), aligned, candidate_indices,
+                                 &distances);
+    ASSERT_EQ(candidate_indices.size(), distances.size());
+    for (size_t i = 0u; i < candidate_indices.size(); ++i) {
+      int expected_distance = 0;
+      for (int byte = 0; byte < descriptor_size_bytes; ++byte) {
+        expected_distance += __builtin_popcount(
+            descriptors(byte, 4) ^ descriptors(byte, candidate_indices[i]));
+      }
+      EXPECT_EQ(expected_distance, distances[i]);
+    }
+  }
+}
+
+}  // namespace common
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
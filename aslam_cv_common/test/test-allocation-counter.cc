@@ -0,0 +1,88 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest-spi.h>
+#include <gtest/gtest.h>
+
+#include <aslam/common/allocation-counter.h>
+#include <aslam/common/allocation-predicates.h>
+#include <aslam/common/entrypoint.h>
+
+TEST(AllocationCounterTests, CountsTheAllocationsOfTheThread) {
+  ASSERT_TRUE(aslam::common::areAllocationHooksInstalled());
+  aslam::common::AllocationCounter outer_counter;
+  std::unique_ptr<std::vector<double>> data;
+  {
+    aslam::common::AllocationCounter inner_counter;
+    data.reset(new std::vector<double>(100u));
+    EXPECT_EQ(2u, inner_counter.getNumAllocations());
+    EXPECT_GE(inner_counter.getNumAllocatedBytes(), 100u * sizeof(double));
+    data.reset();
+    EXPECT_EQ(2u, inner_counter.getNumDeallocations());
+  }
+  EXPECT_EQ(2u, outer_counter.getNumAllocations());
+
+  // Allocations of other threads are not counted.
+  std::atomic<bool> allocate(false);
+  std::thread thread([&allocate]() {
+    while (!allocate) {
+      std::this_thread::yield();
+    }
+    aslam::common::AllocationCounter thread_counter;
+    std::unique_ptr<int> value(new int(1));
+    EXPECT_EQ(1u, thread_counter.getNumAllocations());
+  });
+  const size_t num_allocations = outer_counter.getNumAllocations();
+  allocate = true;
+  thread.join();
+  EXPECT_EQ(num_allocations, outer_counter.getNumAllocations());
+}
+
+TEST(AllocationCounterTests, CountsTheAllocationsOfTheProcess) {
+  const size_t num_allocations_before = aslam::common::getNumProcessHeapAllocations();
+  const aslam::common::ProcessAllocationCounter process_counter;
+  EXPECT_EQ(0u, process_counter.getNumAllocations());
+  std::thread thread([]() {
+    std::unique_ptr<int> value(new int(1));
+  });
+  thread.join();
+  // The thread itself may allocate as well.
+  EXPECT_GE(aslam::common::getNumProcessHeapAllocations(), num_allocations_before + 1u);
+  EXPECT_GE(process_counter.getNumAllocations(), 1u);
+  EXPECT_EQ(aslam::common::getNumProcessHeapAllocations() - num_allocations_before,
+            process_counter.getNumAllocations());
+}
+
+TEST(AllocationCounterTests, SubsystemStatistics) {
+  aslam::common::resetAllocationStatistics();
+  std::vector<int> buffer;
+  for (size_t i = 0u; i < 3u; ++i) {
+    aslam::common::AllocationCounter counter("Buffer::fill");
+    buffer.assign(10u, 1);
+  }
+  const std::map<std::string, aslam::common::AllocationStatistics> statistics =
+      aslam::common::getAllocationStatistics();
+  ASSERT_EQ(1u, statistics.count("Buffer::fill"));
+  // Only the first fill allocates, the capacity is reused afterwards.
+  EXPECT_EQ(3u, statistics.at("Buffer::fill").num_scopes);
+  EXPECT_EQ(1u, statistics.at("Buffer::fill").num_allocations);
+  EXPECT_EQ(1u, statistics.at("Buffer::fill").max_num_allocations_per_scope);
+  EXPECT_EQ(10u * sizeof(int), statistics.at("Buffer::fill").num_allocated_bytes);
+}
+
+TEST(AllocationCounterTests, AllocationBudgets) {
+  std::vector<int> buffer;
+  buffer.reserve(100u);
+  EXPECT_MAX_ALLOCATIONS(0u, {
+    for (int i = 0; i < 100; ++i) {
+      buffer.push_back(i);
+    }
+  });
+  EXPECT_MAX_ALLOCATIONS(1u, buffer.push_back(100));
+  EXPECT_NONFATAL_FAILURE(EXPECT_MAX_ALLOCATIONS(0u, buffer.resize(10000u)),
+                          "Heap allocations of");
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
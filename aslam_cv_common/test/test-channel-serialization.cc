@@ -1,3 +1,6 @@
+#include <sstream>
+#include <string>
+
 #include <opencv2/core/core.hpp>
 #include <Eigen/Core>
 #include <eigen-checks/gtest.h>
@@ -144,6 +147,24 @@ TYPED_TEST(ChannelSerializationTest, SerializeDeserializeBuffer) {
   EXPECT_TRUE(EIGEN_MATRIX_NEAR(this->value_a.value_, this->value_b.value_, static_cast<Scalar>(1e-4)));
 }
 
+TYPED_TEST(ChannelSerializationTest, SerializeDeserializeStream) {
+  typedef typename TypeParam::Scalar Scalar;
+  std::string serialized_value;
+  EXPECT_TRUE(this->value_a.serializeToString(&serialized_value));
+  ASSERT_EQ(serialized_value.size(), this->value_a.getSerializedSize());
+
+  std::stringstream stream;
+  EXPECT_TRUE(this->value_a.serializeToStream(&stream));
+  EXPECT_EQ(serialized_value, stream.str());
+  EXPECT_TRUE(this->value_b.deSerializeFromStream(&stream, serialized_value.size()));
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(this->value_a.value_, this->value_b.value_, static_cast<Scalar>(1e-4)));
+
+  std::string buffer(serialized_value.size(), '\0');
+  EXPECT_FALSE(this->value_a.serializeToPreallocatedBuffer(&buffer[0], buffer.size() - 1u));
+  EXPECT_TRUE(this->value_a.serializeToPreallocatedBuffer(&buffer[0], buffer.size()));
+  EXPECT_EQ(serialized_value, buffer);
+}
+
 TEST(ChannelSerialization, HeaderInfoSize) {
   aslam::internal::HeaderInformation header_info;
   header_info.cols = 12;
@@ -217,6 +238,76 @@ TYPED_TEST(CvMatSerializationTest, SerializeDeserializeBuffer) {
   }
 }
 
+TEST(ChannelSerialization, SerializeDeserializeImagePyramid) {
+  aslam::channels::IMAGE_PYRAMID pyramid_a;
+  cv::Mat padded_image(24, 32, CV_8UC1);
+  cv::randu(padded_image, cv::Scalar(0), cv::Scalar(255));
+  // A view into a padded image as produced by cv::buildOpticalFlowPyramid.
+  pyramid_a.value_.push_back(padded_image(cv::Rect(4, 4, 24, 16)));
+  pyramid_a.value_.emplace_back(8, 12, CV_16SC2);
+  cv::randu(pyramid_a.value_.back(), cv::Scalar(-100, -100), cv::Scalar(100, 100));
+
+  std::string serialized_value;
+  EXPECT_TRUE(pyramid_a.serializeToString(&serialized_value));
+  aslam::channels::IMAGE_PYRAMID pyramid_b;
+  EXPECT_FALSE(pyramid_b == pyramid_a);
+  EXPECT_TRUE(pyramid_b.deSerializeFromString(serialized_value));
+  ASSERT_EQ(2u, pyramid_b.value_.size());
+  EXPECT_TRUE(pyramid_b == pyramid_a);
+
+  char* buffer;
+  size_t size;
+  EXPECT_TRUE(pyramid_a.serializeToBuffer(&buffer, &size));
+  aslam::channels::IMAGE_PYRAMID pyramid_c;
+  EXPECT_TRUE(pyramid_c.deSerializeFromBuffer(buffer, size));
+  delete[] buffer;
+  EXPECT_TRUE(pyramid_c == pyramid_a);
+  pyramid_c.value_[1].at<cv::Vec2s>(1, 1)[1] += 1;
+  EXPECT_FALSE(pyramid_c == pyramid_a);
+}
+
+TEST(ChannelSerialization, StreamImagePyramidWithoutCopies) {
+  aslam::channels::IMAGE_PYRAMID pyramid_a;
+  cv::Mat padded_image(24, 32, CV_8UC1);
+  cv::randu(padded_image, cv::Scalar(0), cv::Scalar(255));
+  pyramid_a.value_.push_back(padded_image(cv::Rect(4, 4, 24, 16)));
+  pyramid_a.value_.emplace_back(8, 12, CV_16SC2);
+  cv::randu(pyramid_a.value_.back(), cv::Scalar(-100, -100), cv::Scalar(100, 100));
+  std::string serialized_value;
+  EXPECT_TRUE(pyramid_a.serializeToString(&serialized_value));
+
+  // The iovecs of the images point into the images, also row by row into the view.
+  aslam::internal::IoVectorSerializationSink sink;
+  EXPECT_TRUE(pyramid_a.serializeToSink(&sink));
+  ASSERT_EQ(serialized_value.size(), sink.getNumBytes());
+  std::string gathered_value;
+  for (const iovec& io_vector : sink.getIoVectors()) {
+    gathered_value.append(static_cast<const char*>(io_vector.iov_base), io_vector.iov_len);
+  }
+  EXPECT_EQ(serialized_value, gathered_value);
+  EXPECT_EQ(pyramid_a.value_[0].ptr<char>(0), sink.getIoVectors()[3].iov_base);
+
+  aslam::channels::IMAGE_PYRAMID pyramid_b;
+  aslam::internal::BufferDeSerializationSource source(serialized_value.data(),
+                                                      serialized_value.size());
+  EXPECT_TRUE(pyramid_b.deSerializeFromSource(&source, serialized_value.size()));
+  EXPECT_EQ(serialized_value.size(), source.getNumBytesRead());
+  EXPECT_TRUE(pyramid_b == pyramid_a);
+}
+
+TEST(ChannelSerialization, StreamSimpleTypes) {
+  aslam::channels::Channel<int> value_a;
+  value_a.value_ = -4567;
+  std::string serialized_value;
+  EXPECT_TRUE(value_a.serializeToString(&serialized_value));
+  std::stringstream stream;
+  EXPECT_TRUE(value_a.serializeToStream(&stream));
+  EXPECT_EQ(serialized_value, stream.str());
+  aslam::channels::Channel<int> value_b;
+  EXPECT_TRUE(value_b.deSerializeFromStream(&stream, serialized_value.size()));
+  EXPECT_EQ(value_a.value_, value_b.value_);
+}
+
 TEST(SimpleSerializationTest, SerializeDeserializeSimpleTypes) {
   SimpleTypeTestHarness<int>(45678).test();
   SimpleTypeTestHarness<size_t>(10546548).test();
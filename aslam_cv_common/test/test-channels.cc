@@ -43,5 +43,48 @@ Eigen::Matrix2Xd& data3 = aslam::channels::get_TEST_Data(channels);
 EXPECT_TRUE(EIGEN_MATRIX_NEAR(data3, data2, 1e-8));
 }
 
+TEST(Channel, LazyChannelIsDecodedOnFirstAccess) {
+std::shared_ptr<Eigen::Matrix2Xd> buffer(new Eigen::Matrix2Xd(Eigen::Matrix2Xd::Random(2, 5)));
+const Eigen::Matrix2Xd expected_data = *buffer;
+aslam::internal::RawChannelData raw_data;
+ASSERT_TRUE(aslam::internal::getRawChannelData(*buffer, &raw_data));
+
+aslam::channels::ChannelGroup channels;
+aslam::channels::addLazyChannel<Eigen::Matrix2Xd>(aslam::channels::TEST_CHANNEL, raw_data,
+                                                  buffer, &channels);
+EXPECT_TRUE(aslam::channels::has_TEST_Channel(channels));
+const aslam::channels::ChannelBase& channel = *channels.channels_.begin()->second;
+EXPECT_TRUE(channel.hasLazyPayload());
+// The raw data of an undecoded channel still points into the buffer.
+aslam::internal::RawChannelData lazy_raw_data;
+ASSERT_TRUE(channel.getRawData(&lazy_raw_data));
+EXPECT_EQ(raw_data.data, lazy_raw_data.data);
+
+// A copy of the group shares the payload without decoding it.
+aslam::channels::ChannelGroup cloned_channels;
+cloned_channels = aslam::channels::cloneChannelGroup(channels);
+EXPECT_TRUE(channel.hasLazyPayload());
+
+EXPECT_TRUE(EIGEN_MATRIX_EQUAL(expected_data, aslam::channels::get_TEST_Data(channels)));
+EXPECT_FALSE(channel.hasLazyPayload());
+EXPECT_TRUE(EIGEN_MATRIX_EQUAL(expected_data,
+                               aslam::channels::get_TEST_DataMutable(&cloned_channels)));
+EXPECT_TRUE(aslam::channels::isChannelGroupEqual(channels, cloned_channels));
+
+// The decoded value owns its memory.
+buffer->setZero();
+EXPECT_TRUE(EIGEN_MATRIX_EQUAL(expected_data, aslam::channels::get_TEST_Data(channels)));
+}
+
+TEST(Channel, LazyChannelTypeMismatchDeath) {
+Eigen::VectorXi buffer = Eigen::VectorXi::Zero(4);
+aslam::internal::RawChannelData raw_data;
+ASSERT_TRUE(aslam::internal::getRawChannelData(buffer, &raw_data));
+aslam::channels::ChannelGroup channels;
+aslam::channels::addLazyChannel<Eigen::Matrix2Xd>(aslam::channels::TEST_CHANNEL, raw_data,
+                                                  nullptr, &channels);
+EXPECT_DEATH(aslam::channels::get_TEST_Data(channels), "^");
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
 
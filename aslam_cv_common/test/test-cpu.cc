@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <aslam/common/cpu.h>
+#include <aslam/common/entrypoint.h>
+
+namespace aslam {
+namespace common {
+namespace cpu {
+namespace {
+int genericKernel() {
+  return 1;
+}
+int ssse3Kernel() {
+  return 2;
+}
+int avx2Kernel() {
+  return 3;
+}
+typedef int (*KernelFunction)();
+
+// Restores the forced level at the end of a test.
+class ForcedIsa {
+ public:
+  explicit ForcedIsa(const Isa isa) {
+    had_forced_isa_ = getForcedIsa(&previous_isa_);
+    setForcedIsa(isa);
+  }
+  ~ForcedIsa() {
+    if (had_forced_isa_) {
+      setForcedIsa(previous_isa_);
+    } else {
+      clearForcedIsa();
+    }
+  }
+
+ private:
+  bool had_forced_isa_;
+  Isa previous_isa_;
+};
+}  // namespace
+
+TEST(CpuTest, DetectedLevelsAreConsistent) {
+  EXPECT_TRUE(isIsaDetected(Isa::kGeneric));
+  EXPECT_TRUE(isIsaSupported(Isa::kGeneric));
+  const Isa best_isa = getBestSupportedIsa();
+  EXPECT_TRUE(isIsaSupported(best_isa));
+  if (isIsaDetected(Isa::kAVX512)) {
+    EXPECT_TRUE(isIsaDetected(Isa::kAVX2));
+  }
+  if (isIsaDetected(Isa::kAVX2)) {
+    EXPECT_TRUE(isIsaDetected(Isa::kPopcnt));
+  }
+  if (isIsaDetected(Isa::kPopcnt)) {
+    EXPECT_TRUE(isIsaDetected(Isa::kSSSE3));
+  }
+}
+
+TEST(CpuTest, IsaNames) {
+  for (const Isa isa : {Isa::kGeneric, Isa::kSSSE3, Isa::kPopcnt, Isa::kAVX2, Isa::kAVX512,
+                        Isa::kNEON}) {
+    Isa parsed_isa = Isa::kGeneric;
+    ASSERT_TRUE(parseIsa(getIsaName(isa), &parsed_isa));
+    EXPECT_EQ(isa, parsed_isa);
+  }
+  Isa isa = Isa::kGeneric;
+  EXPECT_FALSE(parseIsa("sse9", &isa));
+}
+
+TEST(CpuTest, RegistryResolvesTheBestVariant) {
+  KernelRegistry<KernelFunction> registry("test");
+  EXPECT_EQ(nullptr, registry.getBest());
+  registry.add(Isa::kGeneric, &genericKernel);
+  registry.add(Isa::kSSSE3, &ssse3Kernel);
+  registry.add(Isa::kAVX2, &avx2Kernel);
+  EXPECT_TRUE(registry.hasVariant(Isa::kSSSE3));
+  EXPECT_FALSE(registry.hasVariant(Isa::kAVX512));
+
+  Isa best_isa = Isa::kGeneric;
+  ASSERT_TRUE(registry.getBestIsa(&best_isa));
+  if (isIsaSupported(Isa::kAVX2)) {
+    EXPECT_EQ(Isa::kAVX2, best_isa);
+    EXPECT_EQ(3, registry.getBest()());
+  } else if (isIsaSupported(Isa::kSSSE3)) {
+    EXPECT_EQ(Isa::kSSSE3, best_isa);
+    EXPECT_EQ(2, registry.getBest()());
+  } else {
+    EXPECT_EQ(Isa::kGeneric, best_isa);
+    EXPECT_EQ(1, registry.getBest()());
+  }
+}
+
+TEST(CpuTest, ForcedIsaCapsTheResolvedVariant) {
+  KernelRegistry<KernelFunction> registry("test");
+  registry.add(Isa::kGeneric, &genericKernel);
+  registry.add(Isa::kSSSE3, &ssse3Kernel);
+  registry.add(Isa::kAVX2, &avx2Kernel);
+  {
+    ForcedIsa forced_isa(Isa::kGeneric);
+    EXPECT_EQ(Isa::kGeneric, getBestSupportedIsa());
+    EXPECT_FALSE(isIsaSupported(Isa::kAVX2));
+    EXPECT_EQ(1, registry.getBest()());
+  }
+  if (isIsaDetected(Isa::kSSSE3)) {
+    ForcedIsa forced_isa(Isa::kSSSE3);
+    EXPECT_EQ(Isa::kSSSE3, getBestSupportedIsa());
+    EXPECT_FALSE(isIsaSupported(Isa::kPopcnt));
+    EXPECT_EQ(2, registry.getBest()());
+  }
+  // Without the override everything detected is supported again, unless the test runs with
+  // --aslam_force_isa.
+  Isa forced_isa;
+  if (!getForcedIsa(&forced_isa)) {
+    EXPECT_EQ(isIsaDetected(Isa::kAVX2), isIsaSupported(Isa::kAVX2));
+  }
+}
+
+}  // namespace cpu
+}  // namespace common
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
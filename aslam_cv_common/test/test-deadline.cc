@@ -0,0 +1,78 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/deadline.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/time.h>
+
+namespace aslam {
+namespace common {
+
+TEST(DeadlineTests, RemainingBudget) {
+  const Deadline unbounded_deadline;
+  EXPECT_FALSE(unbounded_deadline.isBounded());
+  EXPECT_FALSE(unbounded_deadline.hasExpired());
+  EXPECT_EQ(1.0, unbounded_deadline.getRemainingRatio());
+
+  const Deadline deadline = Deadline::fromNow(time::seconds(100));
+  EXPECT_TRUE(deadline.isBounded());
+  EXPECT_FALSE(deadline.hasExpired());
+  EXPECT_GT(deadline.getRemainingNanoseconds(), time::seconds(99));
+  EXPECT_LE(deadline.getRemainingNanoseconds(), time::seconds(100));
+  EXPECT_GT(deadline.getRemainingRatio(), 0.99);
+
+  const Deadline expired_deadline =
+      Deadline::fromStartTime(Deadline::now() - time::seconds(2), time::seconds(1));
+  EXPECT_TRUE(expired_deadline.hasExpired());
+  EXPECT_EQ(0, expired_deadline.getRemainingNanoseconds());
+  EXPECT_EQ(0.0, expired_deadline.getRemainingRatio());
+  EXPECT_TRUE(Deadline::fromNow(0).hasExpired());
+}
+
+TEST(DeadlineTests, DegradationNames) {
+  Degradations degradations;
+  EXPECT_TRUE(degradations.empty());
+  EXPECT_EQ("none", degradations.toString());
+  degradations.add(Degradation::kSkippedLkTracking);
+  degradations.add(Degradation::kCappedKeypoints);
+  EXPECT_TRUE(degradations.has(Degradation::kCappedKeypoints));
+  EXPECT_FALSE(degradations.has(Degradation::kShrunkSearchWindows));
+  EXPECT_EQ("capped_keypoints,skipped_lk_tracking", degradations.toString());
+  EXPECT_EQ(degradations, Degradations(degradations.getFlags()));
+}
+
+TEST(DeadlineTests, ScopesAreNestedPerThread) {
+  EXPECT_FALSE(DeadlineScope::getCurrentDeadline().isBounded());
+  // Without a scope the degradations are dropped.
+  DeadlineScope::addDegradation(Degradation::kCappedKeypoints);
+
+  DeadlineScope scope(Deadline::fromNow(time::seconds(100)));
+  EXPECT_EQ(scope.getDeadline().getDeadlineTimeNanoseconds(),
+            DeadlineScope::getCurrentDeadline().getDeadlineTimeNanoseconds());
+  {
+    DeadlineScope nested_scope;
+    EXPECT_EQ(scope.getDeadline().getDeadlineTimeNanoseconds(),
+              nested_scope.getDeadline().getDeadlineTimeNanoseconds());
+    DeadlineScope::addDegradation(Degradation::kShrunkSearchWindows);
+    EXPECT_TRUE(nested_scope.getDegradations().has(Degradation::kShrunkSearchWindows));
+    EXPECT_TRUE(scope.getDegradations().empty());
+
+    std::thread other_thread([]() {
+      EXPECT_FALSE(DeadlineScope::getCurrentDeadline().isBounded());
+    });
+    other_thread.join();
+  }
+  // The nested scope passed its degradations on.
+  EXPECT_EQ("shrunk_search_windows", scope.getDegradations().toString());
+  {
+    DeadlineScope nested_scope(Deadline::fromNow(0));
+    EXPECT_TRUE(DeadlineScope::getCurrentDeadline().hasExpired());
+  }
+  EXPECT_FALSE(DeadlineScope::getCurrentDeadline().hasExpired());
+}
+
+}  // namespace common
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 #include <aslam/common/entrypoint.h>
@@ -177,6 +179,202 @@ TEST(ViwlsGraph, DescriptorClosestToMedianTestThreeDescriptors) {
   EXPECT_EQ(2u, closest_to_median_descriptor_index);
 }
 
+TEST(ViwlsGraph, BitSumsMatchPerBitCount) {
+  // More descriptors than fit into one partial sum.
+  DescriptorsType descriptors(48, 600);
+  descriptors.setRandom();
+  descriptors.col(0).setConstant(255u);
+
+  std::vector<int> sums(48 * kBitsPerByte, 0);
+  internal::accumulateBitSums(descriptors, &sums);
+  for (size_t bit = 0u; bit < sums.size(); ++bit) {
+    int expected_sum = 0;
+    for (int i = 0; i < descriptors.cols(); ++i) {
+      if (getBit(bit, descriptors.col(i))) {
+        ++expected_sum;
+      }
+    }
+    EXPECT_EQ(expected_sum, sums[bit]);
+  }
+}
+
+TEST(ViwlsGraph, DescriptorClosestToMedianSampled) {
+  DescriptorsType descriptors(48, 3);
+  descriptors.setZero();
+  descriptors(0, 0) = 7;
+  descriptors(0, 1) = 3;
+  descriptors(0, 2) = 1;
+
+  // Exact with enough reference descriptors.
+  size_t closest_to_median_descriptor_index = 0u;
+  getIndexOfDescriptorClosestToMedianSampled(
+      descriptors, 3u, &closest_to_median_descriptor_index);
+  EXPECT_EQ(1u, closest_to_median_descriptor_index);
+
+  // Noisy copies of a descriptor, the copy with the fewest flipped bits is
+  // the median.
+  DescriptorType center(48, 1);
+  center.setRandom();
+  const int kNumDescriptors = 200;
+  DescriptorsType noisy_descriptors(48, kNumDescriptors);
+  for (int i = 0; i < kNumDescriptors; ++i) {
+    noisy_descriptors.col(i) = center;
+    const int num_flipped_bits = (i == 123) ? 1 : 20 + i % 10;
+    for (int flip = 0; flip < num_flipped_bits; ++flip) {
+      const int bit = (i * 37 + flip * 11) % (48 * kBitsPerByte);
+      noisy_descriptors(bit / kBitsPerByte, i) ^= (1 << (bit % kBitsPerByte));
+    }
+  }
+  size_t exact_index = 0u;
+  getIndexOfDescriptorClosestToMedian(noisy_descriptors, &exact_index);
+  size_t sampled_index = 0u;
+  getIndexOfDescriptorClosestToMedianSampled(
+      noisy_descriptors, 20u, &sampled_index);
+  EXPECT_EQ(123u, exact_index);
+  EXPECT_EQ(exact_index, sampled_index);
+}
+
+TEST(ViwlsGraph, BatchMatchesSingleSet) {
+  std::vector<DescriptorsType> descriptor_sets;
+  for (int i = 0; i < 50; ++i) {
+    descriptor_sets.emplace_back(48, 1 + i % 17);
+    descriptor_sets.back().setRandom();
+  }
+
+  std::vector<DescriptorType> medians;
+  descriptorMeansRoundedToBinaryValue(descriptor_sets, 4u, &medians);
+  std::vector<size_t> median_indices;
+  getIndicesOfDescriptorsClosestToMedian(
+      descriptor_sets, 0u, 0u, &median_indices);
+  std::vector<size_t> sampled_median_indices;
+  getIndicesOfDescriptorsClosestToMedian(
+      descriptor_sets, 8u, 3u, &sampled_median_indices);
+  ASSERT_EQ(descriptor_sets.size(), medians.size());
+  ASSERT_EQ(descriptor_sets.size(), median_indices.size());
+  ASSERT_EQ(descriptor_sets.size(), sampled_median_indices.size());
+  for (size_t i = 0u; i < descriptor_sets.size(); ++i) {
+    DescriptorType median;
+    descriptorMeanRoundedToBinaryValue(descriptor_sets[i], &median);
+    EXPECT_EQ(median, medians[i]);
+    size_t median_index = 0u;
+    getIndexOfDescriptorClosestToMedian(descriptor_sets[i], &median_index);
+    EXPECT_EQ(median_index, median_indices[i]);
+    size_t sampled_median_index = 0u;
+    getIndexOfDescriptorClosestToMedianSampled(
+        descriptor_sets[i], 8u, &sampled_median_index);
+    EXPECT_EQ(sampled_median_index, sampled_median_indices[i]);
+  }
+}
+
+TEST(ViwlsGraph, IncrementalRepresentativeMatchesFullComputation) {
+  const int kDescriptorSizeBytes = 48;
+  const int kNumDescriptors = 60;
+  DescriptorType center(kDescriptorSizeBytes, 1);
+  center.setRandom();
+  DescriptorsType all_descriptors(kDescriptorSizeBytes, kNumDescriptors);
+  for (int i = 0; i < kNumDescriptors; ++i) {
+    all_descriptors.col(i) = center;
+    for (int flip = 0; flip < 10 + i % 30; ++flip) {
+      const int bit = (i * 37 + flip * 11) % (kDescriptorSizeBytes * kBitsPerByte);
+      all_descriptors(bit / kBitsPerByte, i) ^= (1 << (bit % kBitsPerByte));
+    }
+  }
+
+  IncrementalRepresentativeDescriptor representative(kDescriptorSizeBytes);
+  // The descriptors of the representative, in the same order.
+  std::vector<int> descriptor_indices;
+  const auto expect_equal_to_full_computation = [&]() {
+    ASSERT_EQ(descriptor_indices.size(), representative.getNumDescriptors());
+    DescriptorsType descriptors(kDescriptorSizeBytes, descriptor_indices.size());
+    for (size_t i = 0u; i < descriptor_indices.size(); ++i) {
+      descriptors.col(i) = all_descriptors.col(descriptor_indices[i]);
+    }
+    DescriptorType expected_median, median;
+    descriptorMeanRoundedToBinaryValue(descriptors, &expected_median);
+    representative.getMeanRoundedToBinaryValue(&median);
+    EXPECT_EQ(expected_median, median);
+    size_t expected_index = 0u;
+    getIndexOfDescriptorClosestToMedian(descriptors, &expected_index);
+    EXPECT_EQ(expected_index, representative.getIndexOfDescriptorClosestToMedian());
+  };
+
+  for (int i = 0; i < kNumDescriptors; ++i) {
+    representative.addDescriptor(DescriptorType(all_descriptors.col(i)));
+    descriptor_indices.push_back(i);
+    if (i % 3 == 2) {
+      // Remove an older observation every third step.
+      const size_t removed_index = (i * 7) % descriptor_indices.size();
+      representative.removeDescriptor(removed_index);
+      descriptor_indices.erase(descriptor_indices.begin() + removed_index);
+    }
+    expect_equal_to_full_computation();
+  }
+  for (size_t i = 0u; i < descriptor_indices.size(); ++i) {
+    EXPECT_EQ(0, std::memcmp(representative.getDescriptor(i),
+                             all_descriptors.col(descriptor_indices[i]).data(),
+                             kDescriptorSizeBytes));
+  }
+
+  representative.clear();
+  EXPECT_EQ(0u, representative.getNumDescriptors());
+  representative.addDescriptor(center);
+  DescriptorType median;
+  representative.getMeanRoundedToBinaryValue(&median);
+  EXPECT_EQ(center, median);
+}
+
+TEST(ViwlsGraph, BitSelectionDropsConstantAndCorrelatedBits) {
+  // Bytes 16 to 31 are copies of the random bytes 0 to 15, bytes 32 to 47 are constant.
+  DescriptorsType descriptors(48, 2000);
+  descriptors.setRandom();
+  descriptors.middleRows(16, 16) = descriptors.topRows(16);
+  descriptors.bottomRows(16).setConstant(0x5a);
+
+  DescriptorBitSelection selection;
+  learnBitSelection(descriptors, 16u, 0.9, &selection);
+  ASSERT_TRUE(selection.isValid());
+  EXPECT_EQ(48u, selection.full_size_bytes);
+  EXPECT_EQ(16u, selection.getCompressedSizeBytes());
+  ASSERT_EQ(128u, selection.bits.size());
+  EXPECT_TRUE(std::is_sorted(selection.bits.begin(), selection.bits.end()));
+  // Exactly one bit of every copied pair.
+  std::vector<int> num_selected_of_pair(128, 0);
+  for (const int bit : selection.bits) {
+    ASSERT_LT(bit, 256);
+    ++num_selected_of_pair[bit % 128];
+  }
+  for (const int num_selected : num_selected_of_pair) {
+    EXPECT_EQ(1, num_selected);
+  }
+
+  // Without the decorrelation, only the constant bits are left out.
+  learnBitSelection(descriptors, 16u, 1.0, &selection);
+  ASSERT_EQ(128u, selection.bits.size());
+  EXPECT_LT(selection.bits.back(), 256);
+}
+
+TEST(ViwlsGraph, CompressedDescriptorsHoldTheSelectedBits) {
+  DescriptorsType descriptors(48, 700);
+  descriptors.setRandom();
+  DescriptorBitSelection selection;
+  selection.full_size_bytes = 48u;
+  for (int bit = 0; bit < 256; ++bit) {
+    selection.bits.push_back(bit * 3 / 2);
+  }
+
+  DescriptorsType compressed_descriptors;
+  compressDescriptors(descriptors, selection, 3u, &compressed_descriptors);
+  ASSERT_EQ(32, compressed_descriptors.rows());
+  ASSERT_EQ(descriptors.cols(), compressed_descriptors.cols());
+  for (int i = 0; i < descriptors.cols(); ++i) {
+    const DescriptorType descriptor = descriptors.col(i);
+    const DescriptorType compressed_descriptor = compressed_descriptors.col(i);
+    for (size_t bit = 0u; bit < selection.bits.size(); ++bit) {
+      EXPECT_EQ(getBit(selection.bits[bit], descriptor), getBit(bit, compressed_descriptor));
+    }
+  }
+}
+
 }  // namespace descriptor_utils
 }  // namespace common
 }  // namespace aslam
@@ -5,6 +5,7 @@
 #include <eigen-checks/gtest.h>
 #include <yaml-cpp/yaml.h>
 
+#include <aslam/common/base64.h>
 #include <aslam/common/yaml-serialization.h>
 #include <aslam/common/entrypoint.h>
 
@@ -99,6 +100,92 @@ TEST(EigenYamlSerialization, EigenYamlSerialization_DeathFromWrongMatrixType) {
   EXPECT_FALSE(YAML::Load(filename, &rhs));
 }
 
+TEST(EigenYamlSerialization, Base64MatchesTheRfcTestVectors) {
+  const std::string inputs[] = {"", "f", "fo", "foo", "foob", "fooba", "foobar"};
+  const std::string outputs[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy"};
+  for (size_t i = 0u; i < 7u; ++i) {
+    EXPECT_EQ(outputs[i], common::encodeBase64(inputs[i].data(), inputs[i].size()));
+    std::string decoded(inputs[i].size(), ' ');
+    EXPECT_TRUE(common::decodeBase64(outputs[i], &decoded[0], decoded.size()));
+    EXPECT_EQ(inputs[i], decoded);
+  }
+  char buffer[3];
+  EXPECT_FALSE(common::decodeBase64("Zm9", buffer, 2u));
+  EXPECT_FALSE(common::decodeBase64("Zm9!", buffer, 3u));
+  EXPECT_FALSE(common::decodeBase64("Zg=v", buffer, 2u));
+}
+
+TEST(EigenYamlSerialization, BinaryEncodingRoundTrips) {
+  Eigen::MatrixXd lhs(40, 17);
+  lhs.setRandom();
+  const std::string filename = "double_binary.yaml";
+  YAML::Node node;
+  node["matrix"] = YAML::encodeMatrixBinary(lhs);
+  std::ofstream ofs(filename);
+  ofs << node;
+  ofs.close();
+
+  const YAML::Node loaded_node = YAML::LoadFile(filename);
+  EXPECT_EQ("base64", loaded_node["matrix"]["encoding"].as<std::string>());
+  Eigen::MatrixXd rhs;
+  ASSERT_TRUE(YAML::convert<Eigen::MatrixXd>::decode(loaded_node["matrix"], rhs));
+  // The raw buffer is stored, the values are exact.
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(lhs, rhs));
+
+  typedef Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Mask;
+  Mask mask = (Eigen::MatrixXi::Random(48, 64).array() > 0).cast<uint8_t>();
+  Mask loaded_mask;
+  EXPECT_TRUE(YAML::convert<Mask>::decode(YAML::encodeMatrixBinary(mask), loaded_mask));
+  EXPECT_TRUE(mask == loaded_mask);
+}
+
+TEST(EigenYamlSerialization, BinaryEncodingDecodesIntoOtherLayouts) {
+  Eigen::Matrix<float, 4, 3> lhs;
+  lhs.setRandom();
+  const YAML::Node node = YAML::encodeMatrixBinary(lhs);
+  typedef Eigen::Matrix<float, 4, 3, Eigen::RowMajor> RowMajorMatrix;
+  RowMajorMatrix row_major;
+  EXPECT_TRUE(YAML::convert<RowMajorMatrix>::decode(node, row_major));
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(lhs, row_major));
+  typedef Eigen::Matrix<float, Eigen::Dynamic, 3> DynamicRowsMatrix;
+  DynamicRowsMatrix dynamic_rows;
+  EXPECT_TRUE(YAML::convert<DynamicRowsMatrix>::decode(node, dynamic_rows));
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(lhs, dynamic_rows));
+}
+
+TEST(EigenYamlSerialization, BinaryEncodingOfEmptyMatrices) {
+  for (const Eigen::MatrixXd& lhs : {Eigen::MatrixXd(0, 5), Eigen::MatrixXd(3, 0),
+                                     Eigen::MatrixXd()}) {
+    YAML::Emitter emitter;
+    emitter << YAML::encodeMatrixBinary(lhs);
+    const YAML::Node loaded_node = YAML::Load(emitter.c_str());
+    EXPECT_EQ("", loaded_node["data"].as<std::string>());
+    Eigen::MatrixXd rhs = Eigen::MatrixXd::Ones(2, 2);
+    ASSERT_TRUE(YAML::convert<Eigen::MatrixXd>::decode(loaded_node, rhs));
+    EXPECT_EQ(lhs.rows(), rhs.rows());
+    EXPECT_EQ(lhs.cols(), rhs.cols());
+  }
+  typedef Eigen::Matrix<float, 3, Eigen::Dynamic> FixedRowsMatrix;
+  FixedRowsMatrix fixed_rows(3, 0);
+  FixedRowsMatrix loaded_fixed_rows;
+  EXPECT_TRUE(YAML::convert<FixedRowsMatrix>::decode(
+      YAML::encodeMatrixBinary(fixed_rows), loaded_fixed_rows));
+  EXPECT_EQ(0, loaded_fixed_rows.cols());
+}
+
+TEST(EigenYamlSerialization, BinaryEncodingRejectsInvalidData) {
+  typedef Eigen::Matrix<double, 5, 4> DoubleMatrix;
+  typedef Eigen::Matrix<float, 5, 4> FloatMatrix;
+  DoubleMatrix lhs, rhs;
+  lhs.setRandom();
+  FloatMatrix rhs_float;
+  YAML::Node node = YAML::encodeMatrixBinary(lhs);
+  EXPECT_FALSE(YAML::convert<FloatMatrix>::decode(node, rhs_float));
+
+  node["data"] = node["data"].as<std::string>().substr(4);
+  EXPECT_FALSE(YAML::convert<DoubleMatrix>::decode(node, rhs));
+}
+
 }  // namespace aslam
 
 ASLAM_UNITTEST_ENTRYPOINT
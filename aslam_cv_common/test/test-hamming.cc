@@ -0,0 +1,219 @@
+#include <bitset>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/feature-descriptor-ref.h>
+#include <aslam/common/hamming.h>
+
+namespace aslam {
+namespace common {
+
+#ifndef __ARM_NEON__
+namespace {
+constexpr int kMaxDescriptorSizeBytes = 128;
+
+int referenceHamming(const unsigned char* a, const unsigned char* b,
+                     const int size) {
+  int distance = 0;
+  for (int i = 0; i < size; ++i) {
+    distance += std::bitset<8>(a[i] ^ b[i]).count();
+  }
+  return distance;
+}
+}  // namespace
+
+TEST(HammingTest, AllImplementationsAgreeWithReference) {
+  alignas(64) unsigned char a[kMaxDescriptorSizeBytes];
+  alignas(64) unsigned char b[kMaxDescriptorSizeBytes];
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> byte_distribution(0, 255);
+
+  const Hamming::Implementation kImplementations[] = {
+      Hamming::Implementation::kSSSE3, Hamming::Implementation::kAVX2,
+      Hamming::Implementation::kAVX512};
+
+  for (int trial = 0; trial < 100; ++trial) {
+    for (int i = 0; i < kMaxDescriptorSizeBytes; ++i) {
+      a[i] = static_cast<unsigned char>(byte_distribution(generator));
+      b[i] = static_cast<unsigned char>(byte_distribution(generator));
+    }
+    for (int size = 16; size <= kMaxDescriptorSizeBytes; size += 16) {
+      const int expected = referenceHamming(a, b, size);
+      EXPECT_EQ(expected, Hamming::evaluate(a, b, size));
+      for (const Hamming::Implementation implementation : kImplementations) {
+        if (!Hamming::isImplementationSupported(implementation)) {
+          continue;
+        }
+        EXPECT_EQ(expected, Hamming::evaluateWith(implementation, a, b, size))
+            << Hamming::getImplementationName(implementation) << ", "
+            << size << " bytes";
+      }
+    }
+  }
+}
+
+TEST(HammingTest, UnalignedInputForWideKernels) {
+  alignas(64) unsigned char a[kMaxDescriptorSizeBytes + 1];
+  alignas(64) unsigned char b[kMaxDescriptorSizeBytes + 1];
+  for (int i = 0; i <= kMaxDescriptorSizeBytes; ++i) {
+    a[i] = static_cast<unsigned char>(i * 37);
+    b[i] = static_cast<unsigned char>(255 - i);
+  }
+  for (const Hamming::Implementation implementation :
+       {Hamming::Implementation::kAVX2, Hamming::Implementation::kAVX512}) {
+    if (!Hamming::isImplementationSupported(implementation)) {
+      continue;
+    }
+    for (int size = 16; size <= kMaxDescriptorSizeBytes; size += 16) {
+      EXPECT_EQ(referenceHamming(a + 1, b + 1, size),
+                Hamming::evaluateWith(implementation, a + 1, b + 1, size));
+    }
+  }
+}
+
+TEST(HammingTest, BatchMatchesSingleEvaluation) {
+  const Hamming::Implementation kImplementations[] = {
+      Hamming::Implementation::kSSSE3, Hamming::Implementation::kAVX2,
+      Hamming::Implementation::kAVX512};
+  constexpr int kNumDescriptors = 50;
+  std::mt19937 generator(7);
+  std::uniform_int_distribution<int> index_distribution(
+      0, kNumDescriptors - 1);
+
+  for (int size = 16; size <= 2 * kMaxDescriptorSizeBytes; size += 16) {
+    Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> descriptors(
+        size, kNumDescriptors);
+    descriptors.setRandom();
+    Eigen::Matrix<unsigned char, Eigen::Dynamic, 1> query(size);
+    query.setRandom();
+    const FeatureDescriptorConstRef query_ref(query.data(), size);
+
+    std::vector<int> candidate_indices;
+    for (int i = 0; i < 2 * kNumDescriptors; ++i) {
+      candidate_indices.push_back(index_distribution(generator));
+    }
+
+    std::vector<Hamming::ResultType> distances;
+    computeHammingDistancesBatch(
+        query_ref, descriptors, candidate_indices, &distances);
+    ASSERT_EQ(candidate_indices.size(), distances.size());
+    for (size_t i = 0u; i < candidate_indices.size(); ++i) {
+      const FeatureDescriptorConstRef candidate_ref(
+          &descriptors.coeffRef(0, candidate_indices[i]), size);
+      EXPECT_EQ(GetNumBitsDifferent(query_ref, candidate_ref),
+                static_cast<size_t>(distances[i]));
+    }
+
+    for (const Hamming::Implementation implementation : kImplementations) {
+      if (!Hamming::isImplementationSupported(implementation)) {
+        continue;
+      }
+      std::vector<Hamming::ResultType> distances_implementation(
+          candidate_indices.size());
+      Hamming::evaluateBatchWith(
+          implementation, query.data(), descriptors.data(), size,
+          candidate_indices.data(), candidate_indices.size(), size,
+          distances_implementation.data());
+      EXPECT_EQ(distances, distances_implementation)
+          << Hamming::getImplementationName(implementation) << ", "
+          << size << " bytes";
+    }
+  }
+
+  // An empty batch leaves an empty result.
+  Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> descriptors(
+      48, 1);
+  descriptors.setZero();
+  std::vector<Hamming::ResultType> distances(3, -1);
+  computeHammingDistancesBatch(
+      FeatureDescriptorConstRef(descriptors.data(), 48), descriptors,
+      std::vector<int>(), &distances);
+  EXPECT_TRUE(distances.empty());
+}
+#endif  // __ARM_NEON__
+
+TEST(HammingTest, BoundedIsExactUpToTheBound) {
+  constexpr int kSize = 64;
+  constexpr int kNumDescriptors = 200;
+  Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> descriptors(
+      kSize, kNumDescriptors);
+  descriptors.setRandom();
+  // Half of the candidates are close to the query.
+  Eigen::Matrix<unsigned char, Eigen::Dynamic, 1> query = descriptors.col(0);
+  for (int i = 0; i < kNumDescriptors; i += 2) {
+    descriptors.col(i) = query;
+    descriptors(i % kSize, i) ^= static_cast<unsigned char>(i);
+  }
+  const FeatureDescriptorConstRef query_ref(query.data(), kSize);
+  std::vector<int> candidate_indices(kNumDescriptors);
+  for (int i = 0; i < kNumDescriptors; ++i) {
+    candidate_indices[i] = i;
+  }
+
+  for (const Hamming::ResultType max_distance : {0, 5, 100, 8 * kSize}) {
+    std::vector<Hamming::ResultType> distances;
+    computeHammingDistancesBatchBounded(
+        query_ref, descriptors, candidate_indices, max_distance, &distances);
+    ASSERT_EQ(candidate_indices.size(), distances.size());
+    for (int i = 0; i < kNumDescriptors; ++i) {
+      const FeatureDescriptorConstRef candidate_ref(
+          &descriptors.coeffRef(0, i), kSize);
+      const Hamming::ResultType exact_distance =
+          static_cast<Hamming::ResultType>(
+              GetNumBitsDifferent(query_ref, candidate_ref));
+      if (exact_distance <= max_distance) {
+        EXPECT_EQ(exact_distance, distances[i]);
+      } else {
+        EXPECT_GT(distances[i], max_distance);
+        EXPECT_LE(distances[i], exact_distance);
+      }
+      EXPECT_EQ(distances[i], Hamming::evaluateBounded(
+          query.data(), candidate_ref.data(), kSize, max_distance));
+    }
+  }
+}
+
+TEST(HammingTest, FixedSizeKernelsMatchTheGenericPath) {
+  constexpr int kNumDescriptors = 100;
+  std::mt19937 generator(11);
+  std::uniform_int_distribution<int> index_distribution(
+      0, kNumDescriptors - 1);
+  for (const int size : {16, 32, 48, 64}) {
+    const Hamming::FixedSizeBatchFunction fixed_size_function =
+        Hamming::getFixedSizeBatchFunction(size);
+    if (fixed_size_function == nullptr) {
+      LOG(WARNING) << "No popcount instruction, skipping " << size << " bytes.";
+      continue;
+    }
+    Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> descriptors(
+        size, kNumDescriptors);
+    descriptors.setRandom();
+    const FeatureDescriptorConstRef query_ref(&descriptors.coeffRef(0, 0),
+                                              size);
+    std::vector<int> candidate_indices;
+    for (int i = 0; i < kNumDescriptors; ++i) {
+      candidate_indices.push_back(index_distribution(generator));
+    }
+
+    std::vector<Hamming::ResultType> distances;
+    computeHammingDistancesBatch(
+        query_ref, descriptors, candidate_indices, &distances);
+    std::vector<Hamming::ResultType> fixed_size_distances;
+    computeHammingDistancesBatchBounded(
+        query_ref, descriptors, candidate_indices, 0, &fixed_size_distances,
+        fixed_size_function);
+    // The fixed size kernels are exact beyond the bound.
+    EXPECT_EQ(distances, fixed_size_distances) << size << " bytes";
+  }
+  // Other sizes take the generic path.
+  EXPECT_TRUE(Hamming::getFixedSizeBatchFunction(80) == nullptr);
+  EXPECT_TRUE(Hamming::getFixedSizeBatchFunction(40) == nullptr);
+}
+
+}  // namespace common
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -1,10 +1,13 @@
 #include <algorithm>
+#include <thread>
 #include <unordered_set>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include <aslam/common/entrypoint.h>
 #include <aslam/common/hash-id.h>
+#include <aslam/common/unique-id.h>
 
 using namespace aslam;
 
@@ -48,4 +51,61 @@ TEST(HashIdTest, StdHash) {
   EXPECT_EQ(*found, needle);
 }
 
+TEST(HashIdTest, GenerateIds) {
+  const size_t kNumIds = 1000u;
+  const std::vector<HashId> ids = HashId::generateIds(kNumIds);
+  ASSERT_EQ(kNumIds, ids.size());
+  std::unordered_set<HashId> unique_ids(ids.begin(), ids.end());
+  EXPECT_EQ(kNumIds, unique_ids.size());
+  for (const HashId& id : ids) {
+    EXPECT_TRUE(id.isValid());
+  }
+
+  const FrameIdList frame_ids = FrameId::Random(kNumIds);
+  ASSERT_EQ(kNumIds, frame_ids.size());
+  FrameIdSet unique_frame_ids(frame_ids.begin(), frame_ids.end());
+  EXPECT_EQ(kNumIds, unique_frame_ids.size());
+}
+
+TEST(HashIdTest, UniqueAcrossThreads) {
+  const size_t kNumThreads = 8u;
+  const size_t kNumIdsPerThread = 20000u;
+  std::vector<std::vector<HashId>> thread_ids(kNumThreads);
+  std::vector<std::thread> threads;
+  for (size_t thread_index = 0u; thread_index < kNumThreads; ++thread_index) {
+    threads.emplace_back([&thread_ids, thread_index, kNumIdsPerThread]() {
+      thread_ids[thread_index].reserve(kNumIdsPerThread);
+      for (size_t i = 0u; i < kNumIdsPerThread; ++i) {
+        thread_ids[thread_index].push_back(HashId::random());
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  std::unordered_set<HashId> unique_ids;
+  for (const std::vector<HashId>& ids : thread_ids) {
+    unique_ids.insert(ids.begin(), ids.end());
+  }
+  EXPECT_EQ(kNumThreads * kNumIdsPerThread, unique_ids.size());
+}
+
+TEST(HashIdTest, BitsAreBalanced) {
+  // Every bit of the generated ids should be set for about half of the ids.
+  const size_t kNumIds = 10000u;
+  const std::vector<HashId> ids = HashId::generateIds(kNumIds);
+  for (size_t word = 0u; word < 2u; ++word) {
+    for (size_t bit = 0u; bit < 64u; ++bit) {
+      size_t num_set = 0u;
+      for (const HashId& id : ids) {
+        uint64_t value[2];
+        id.toUint64(value);
+        num_set += (value[word] >> bit) & 1u;
+      }
+      EXPECT_NEAR(0.5, static_cast<double>(num_set) / kNumIds, 0.05)
+          << "Bit " << bit << " of word " << word;
+    }
+  }
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
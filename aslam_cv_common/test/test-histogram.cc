@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/statistics/histogram.h>
+#include <aslam/common/timer.h>
+
+using statistics::LogHistogram;
+
+TEST(HistogramTests, BucketsAreContiguous) {
+  EXPECT_EQ(LogHistogram::GetBucketLowerBound(0u), 0u);
+  for (size_t bucket_index = 1u; bucket_index < LogHistogram::kNumBuckets; ++bucket_index) {
+    const uint64_t lower_bound = LogHistogram::GetBucketLowerBound(bucket_index);
+    ASSERT_EQ(lower_bound, LogHistogram::GetBucketUpperBound(bucket_index - 1u) + 1u);
+    ASSERT_EQ(LogHistogram::GetBucketIndex(lower_bound), bucket_index);
+    ASSERT_EQ(LogHistogram::GetBucketIndex(LogHistogram::GetBucketUpperBound(bucket_index)),
+              bucket_index);
+  }
+  EXPECT_EQ(LogHistogram::GetBucketUpperBound(LogHistogram::kNumBuckets - 1u),
+            std::numeric_limits<uint64_t>::max());
+}
+
+TEST(HistogramTests, Percentiles) {
+  LogHistogram histogram(1e-3);
+  EXPECT_EQ(histogram.GetPercentile(0.5), 0.0);
+
+  const double kMaxRelativeError = 1.0 / LogHistogram::kNumSubBuckets;
+  std::mt19937 random_engine(42);
+  std::lognormal_distribution<double> distribution(0.0, 2.0);
+  std::vector<double> values;
+  for (size_t value_idx = 0u; value_idx < 100000u; ++value_idx) {
+    values.push_back(distribution(random_engine));
+    histogram.Record(values.back());
+  }
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(histogram.GetCount(), values.size());
+  EXPECT_NEAR(histogram.GetMin(), values.front(), 1e-3);
+  EXPECT_NEAR(histogram.GetMax(), values.back(), 1e-3);
+
+  for (const double fraction : {0.1, 0.5, 0.9, 0.99, 0.999}) {
+    const double expected_value =
+        values[static_cast<size_t>(std::ceil(fraction * values.size())) - 1u];
+    EXPECT_NEAR(histogram.GetPercentile(fraction), expected_value,
+                expected_value * kMaxRelativeError + 1e-3) << fraction;
+  }
+  EXPECT_DOUBLE_EQ(histogram.GetPercentile(1.0), histogram.GetMax());
+  EXPECT_DOUBLE_EQ(histogram.GetPercentile(0.0), histogram.GetMin());
+
+  histogram.Reset();
+  EXPECT_EQ(histogram.GetCount(), 0u);
+}
+
+TEST(HistogramTests, RecordFromManyThreadsAndMerge) {
+  const size_t kNumThreads = 4u;
+  const size_t kNumValuesPerThread = 10000u;
+  LogHistogram histogram;
+  std::vector<LogHistogram> thread_histograms(kNumThreads);
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&, thread_idx]() {
+      for (size_t value_idx = 0u; value_idx < kNumValuesPerThread; ++value_idx) {
+        histogram.Record(static_cast<double>(value_idx));
+        thread_histograms[thread_idx].Record(static_cast<double>(value_idx));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(histogram.GetCount(), kNumThreads * kNumValuesPerThread);
+  EXPECT_DOUBLE_EQ(histogram.GetSum(),
+                   kNumThreads * kNumValuesPerThread * (kNumValuesPerThread - 1.0) / 2.0);
+
+  LogHistogram merged_histogram;
+  for (const LogHistogram& thread_histogram : thread_histograms) {
+    merged_histogram.Merge(thread_histogram);
+  }
+  EXPECT_EQ(merged_histogram.GetCount(), histogram.GetCount());
+  EXPECT_EQ(merged_histogram.GetSum(), histogram.GetSum());
+  EXPECT_EQ(merged_histogram.GetMin(), 0.0);
+  EXPECT_EQ(merged_histogram.GetMax(), kNumValuesPerThread - 1.0);
+  for (const double fraction : {0.5, 0.99, 0.999}) {
+    EXPECT_EQ(merged_histogram.GetPercentile(fraction), histogram.GetPercentile(fraction));
+  }
+}
+
+TEST(HistogramTests, Export) {
+  statistics::HistogramMap histograms;
+  histograms.emplace("frame \"latency\"", LogHistogram(1e-3));
+  for (int value = 1; value <= 100; ++value) {
+    histograms.begin()->second.Record(value * 1e-3);
+  }
+
+  std::stringstream prometheus;
+  statistics::WritePrometheusSummary("aslam_latency_seconds", histograms, prometheus);
+  EXPECT_NE(prometheus.str().find("# TYPE aslam_latency_seconds summary\n"), std::string::npos);
+  EXPECT_NE(prometheus.str().find(
+      "aslam_latency_seconds{tag=\"frame \\\"latency\\\"\",quantile=\"0.99\"} 0.099\n"),
+      std::string::npos) << prometheus.str();
+  EXPECT_NE(prometheus.str().find(
+      "aslam_latency_seconds_count{tag=\"frame \\\"latency\\\"\"} 100\n"), std::string::npos);
+
+  std::stringstream json;
+  statistics::WriteJson(histograms, json);
+  EXPECT_NE(json.str().find("\"frame \\\"latency\\\"\": {\"count\": 100"), std::string::npos)
+      << json.str();
+  EXPECT_NE(json.str().find("\"p50\": 0.05"), std::string::npos) << json.str();
+  EXPECT_NE(json.str().find("\"p99.9\": 0.1}"), std::string::npos) << json.str();
+}
+
+TEST(HistogramTests, TimerPercentiles) {
+  for (size_t timer_idx = 0u; timer_idx < 20u; ++timer_idx) {
+    timing::TimerImpl timer("test/percentiles");
+    std::this_thread::sleep_for(std::chrono::microseconds(timer_idx < 19u ? 100 : 20000));
+  }
+  EXPECT_GT(timing::Timing::GetPercentileSeconds("test/percentiles", 0.5), 50e-6);
+  EXPECT_LT(timing::Timing::GetPercentileSeconds("test/percentiles", 0.5), 10e-3);
+  EXPECT_GE(timing::Timing::GetPercentileSeconds("test/percentiles", 1.0), 20e-3);
+
+  std::stringstream prometheus;
+  timing::Timing::WritePrometheus(prometheus);
+  EXPECT_NE(prometheus.str().find("aslam_timing_seconds_count{tag=\"test/percentiles\"} 20"),
+            std::string::npos);
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
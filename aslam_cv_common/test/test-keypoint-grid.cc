@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <aslam/common/entrypoint.h>
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+
+#include "aslam/common/keypoint-grid.h"
+
+namespace aslam {
+namespace common {
+
+TEST(KeypointGrid, CellsAreContiguousAndClamped) {
+  KeypointGrid grid = KeypointGrid::createForImage(40u, 20u, 10.0);
+  ASSERT_EQ(grid.numCellRows(), 2u);
+  ASSERT_EQ(grid.numCellCols(), 4u);
+
+  Eigen::Matrix2Xd keypoints(2, 5);
+  keypoints << 35.0, 1.0, 15.0, -5.0, 100.0,
+               15.0, 1.0,  2.0,  3.0, 100.0;
+  grid.build(keypoints, nullptr);
+  ASSERT_EQ(grid.numKeypoints(), 5u);
+
+  // Cell (0, 0) holds keypoint 1 and the clamped keypoint 3, in their original order.
+  const size_t cell_00 = grid.getCellIndex(0u, 0u);
+  ASSERT_EQ(grid.getCellOffset(cell_00 + 1u) - grid.getCellOffset(cell_00), 2u);
+  EXPECT_EQ(grid.getSortedKeypointIndex(grid.getCellOffset(cell_00)), 1);
+  EXPECT_EQ(grid.getSortedKeypointIndex(grid.getCellOffset(cell_00) + 1u), 3);
+
+  // Keypoint 4 is clamped into the last cell together with keypoint 0.
+  const size_t cell_13 = grid.getCellIndex(1u, 3u);
+  ASSERT_EQ(grid.getCellOffset(cell_13 + 1u) - grid.getCellOffset(cell_13), 2u);
+  EXPECT_EQ(grid.getSortedKeypointIndex(grid.getCellOffset(cell_13)), 0);
+  EXPECT_EQ(grid.getSortedKeypointIndex(grid.getCellOffset(cell_13) + 1u), 4);
+  EXPECT_EQ(grid.getCellOffset(grid.numCells()), grid.numKeypoints());
+
+  for (size_t sorted_position = 0u; sorted_position < grid.numKeypoints(); ++sorted_position) {
+    EXPECT_EQ(grid.getSortedKeypoints().col(sorted_position),
+              keypoints.col(grid.getSortedKeypointIndex(sorted_position)));
+  }
+}
+
+TEST(KeypointGrid, SkipsInvalidKeypoints) {
+  KeypointGrid grid = KeypointGrid::createForImage(100u, 100u, 10.0);
+  Eigen::Matrix2Xd keypoints(2, 3);
+  keypoints << 10.0, 11.0, 12.0,
+               10.0, 11.0, 12.0;
+  std::vector<bool> is_valid = {true, false, true};
+  grid.build(keypoints, &is_valid);
+  EXPECT_EQ(grid.numKeypoints(), 2u);
+
+  std::vector<int> indices;
+  grid.getKeypointIndicesInRadius(Eigen::Vector2d(11.0, 11.0), 5.0, &indices);
+  std::sort(indices.begin(), indices.end());
+  EXPECT_EQ(indices, std::vector<int>({0, 2}));
+
+  grid.clear();
+  EXPECT_EQ(grid.numKeypoints(), 0u);
+  indices.clear();
+  grid.getKeypointIndicesInRadius(Eigen::Vector2d(11.0, 11.0), 5.0, &indices);
+  EXPECT_TRUE(indices.empty());
+}
+
+TEST(KeypointGrid, RadiusQueryMatchesBruteForce) {
+  constexpr size_t kImageWidth = 640u;
+  constexpr size_t kImageHeight = 480u;
+  constexpr int kNumKeypoints = 2000;
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<double> x_distribution(0.0, kImageWidth - 1.0);
+  std::uniform_real_distribution<double> y_distribution(0.0, kImageHeight - 1.0);
+
+  Eigen::Matrix2Xd keypoints(2, kNumKeypoints);
+  for (int i = 0; i < kNumKeypoints; ++i) {
+    keypoints(0, i) = x_distribution(generator);
+    keypoints(1, i) = y_distribution(generator);
+  }
+
+  for (const double radius : {3.0, 10.0, 25.0}) {
+    KeypointGrid grid = KeypointGrid::createForImage(kImageWidth, kImageHeight, radius);
+    grid.build(keypoints, nullptr);
+    for (int query_idx = 0; query_idx < 100; ++query_idx) {
+      const Eigen::Vector2d center(x_distribution(generator), y_distribution(generator));
+      std::vector<int> indices;
+      grid.getKeypointIndicesInRadius(center, radius, &indices);
+      std::sort(indices.begin(), indices.end());
+
+      std::vector<int> expected_indices;
+      for (int i = 0; i < kNumKeypoints; ++i) {
+        if ((keypoints.col(i) - center).squaredNorm() < radius * radius) {
+          expected_indices.push_back(i);
+        }
+      }
+      EXPECT_EQ(expected_indices, indices);
+    }
+  }
+}
+
+}  // namespace common
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,123 @@
+#include <errno.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "aslam/common/entrypoint.h"
+#include "aslam/common/mapped-file.h"
+
+namespace aslam {
+namespace common {
+
+class MappedFileTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    char path[] = "/tmp/test-mapped-file-XXXXXX";
+    const int file_descriptor = mkstemp(path);
+    ASSERT_GE(file_descriptor, 0);
+    ::close(file_descriptor);
+    path_ = path;
+    shared_memory_name_ = "/test-mapped-file-" + std::to_string(::getpid());
+  }
+
+  virtual void TearDown() {
+    ::unlink(path_.c_str());
+    ::shm_unlink(shared_memory_name_.c_str());
+  }
+
+  void writeFile(const std::string& content) {
+    std::ofstream file(path_, std::ios::binary | std::ios::trunc);
+    file << content;
+  }
+
+  std::string path_;
+  std::string shared_memory_name_;
+};
+
+TEST_F(MappedFileTest, MapsTheFileContent) {
+  writeFile("mapped content");
+  MappedFile mapped_file;
+  EXPECT_FALSE(mapped_file.isOpen());
+  ASSERT_TRUE(mapped_file.open(path_));
+  EXPECT_TRUE(mapped_file.isOpen());
+  ASSERT_EQ(14u, mapped_file.sizeBytes());
+  EXPECT_EQ("mapped content", std::string(mapped_file.data(), mapped_file.sizeBytes()));
+
+  mapped_file.close();
+  EXPECT_FALSE(mapped_file.isOpen());
+  EXPECT_EQ(nullptr, mapped_file.data());
+  EXPECT_EQ(0u, mapped_file.sizeBytes());
+}
+
+TEST_F(MappedFileTest, OpensAnEmptyFile) {
+  MappedFile mapped_file;
+  ASSERT_TRUE(mapped_file.open(path_));
+  EXPECT_TRUE(mapped_file.isOpen());
+  EXPECT_EQ(nullptr, mapped_file.data());
+  EXPECT_EQ(0u, mapped_file.sizeBytes());
+}
+
+TEST_F(MappedFileTest, FailureLeavesErrnoSet) {
+  MappedFile mapped_file;
+  errno = 0;
+  EXPECT_FALSE(mapped_file.open(path_ + "-missing"));
+  EXPECT_EQ(ENOENT, errno);
+  EXPECT_FALSE(mapped_file.isOpen());
+  errno = 0;
+  EXPECT_FALSE(mapped_file.openSharedMemory(shared_memory_name_));
+  EXPECT_EQ(ENOENT, errno);
+}
+
+TEST_F(MappedFileTest, MoveTransfersTheMapping) {
+  writeFile("moved");
+  MappedFile mapped_file;
+  ASSERT_TRUE(mapped_file.open(path_));
+  const char* data = mapped_file.data();
+
+  MappedFile moved_file(std::move(mapped_file));
+  EXPECT_FALSE(mapped_file.isOpen());
+  EXPECT_EQ(nullptr, mapped_file.data());
+  ASSERT_TRUE(moved_file.isOpen());
+  EXPECT_EQ(data, moved_file.data());
+
+  MappedFile assigned_file;
+  assigned_file = std::move(moved_file);
+  EXPECT_FALSE(moved_file.isOpen());
+  EXPECT_EQ(data, assigned_file.data());
+  EXPECT_EQ("moved", std::string(assigned_file.data(), assigned_file.sizeBytes()));
+}
+
+TEST_F(MappedFileTest, SharesTheSharedMemoryObject) {
+  MappedFile writer;
+  ASSERT_TRUE(writer.createSharedMemory(shared_memory_name_, 4096u));
+  ASSERT_EQ(4096u, writer.sizeBytes());
+  // The object is zero-filled.
+  EXPECT_EQ(0, writer.data()[0]);
+  EXPECT_EQ(0, writer.data()[4095]);
+  std::strcpy(writer.data(), "shared");
+
+  MappedFile reader;
+  ASSERT_TRUE(reader.openSharedMemory(shared_memory_name_));
+  ASSERT_EQ(4096u, reader.sizeBytes());
+  EXPECT_STREQ("shared", reader.data());
+  reader.data()[0] = 'S';
+  EXPECT_STREQ("Shared", writer.data());
+
+  // The object exists already.
+  MappedFile other_writer;
+  errno = 0;
+  EXPECT_FALSE(other_writer.createSharedMemory(shared_memory_name_, 4096u));
+  EXPECT_EQ(EEXIST, errno);
+}
+
+}  // namespace common
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
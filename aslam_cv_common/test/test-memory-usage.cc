@@ -0,0 +1,118 @@
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+
+#include <aslam/common/channel-declaration.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/memory-usage.h>
+#include <aslam/common/object-pool.h>
+#include <aslam/common/occupancy-grid.h>
+
+DECLARE_CHANNEL(MEMORY_TEST, Eigen::Matrix2Xd)
+
+namespace aslam {
+namespace common {
+
+TEST(MemoryUsageTest, CountsTheDataOfValues) {
+  EXPECT_EQ(0u, getMemoryUsageBytes(3.0));
+  EXPECT_EQ(0u, getMemoryUsageBytes(Eigen::Matrix4d()));
+  EXPECT_EQ(2u * 10u * sizeof(double), getMemoryUsageBytes(Eigen::Matrix2Xd(2, 10)));
+  EXPECT_EQ(7u * sizeof(int), getMemoryUsageBytes(Eigen::VectorXi(7)));
+
+  std::vector<int> values;
+  values.reserve(16u);
+  values.resize(3u);
+  EXPECT_EQ(16u * sizeof(int), getMemoryUsageBytes(values));
+
+  std::vector<std::vector<float>> nested_values(2u, std::vector<float>(5u));
+  EXPECT_EQ(2u * sizeof(std::vector<float>) + 2u * 5u * sizeof(float),
+            getMemoryUsageBytes(nested_values));
+}
+
+TEST(MemoryUsageTest, ReportSumsTagsAndChecksBudgets) {
+  MemoryUsageReport report;
+  report.add("pipeline/completed", 100u);
+  report.add("pipeline/completed", 50u);
+  report.add("pipeline/processing", 20u);
+  EXPECT_EQ(150u, report.getBytes("pipeline/completed"));
+  EXPECT_EQ(0u, report.getBytes("pipeline/unknown"));
+  EXPECT_EQ(170u, report.getTotalBytes());
+
+  std::vector<std::string> exceeded_tags;
+  MemoryUsageReport::EntryMap budgets_bytes;
+  budgets_bytes["pipeline/completed"] = 150u;
+  budgets_bytes[""] = 200u;
+  EXPECT_TRUE(report.isWithinBudgets(budgets_bytes, &exceeded_tags));
+  EXPECT_TRUE(exceeded_tags.empty());
+
+  budgets_bytes["pipeline/processing"] = 10u;
+  budgets_bytes[""] = 100u;
+  EXPECT_FALSE(report.isWithinBudgets(budgets_bytes, &exceeded_tags));
+  ASSERT_EQ(2u, exceeded_tags.size());
+  EXPECT_EQ("", exceeded_tags[0]);
+  EXPECT_EQ("pipeline/processing", exceeded_tags[1]);
+  EXPECT_FALSE(report.isWithinBudgets(budgets_bytes, nullptr));
+}
+
+TEST(MemoryUsageTest, ReportSumsTheTagsBelowATag) {
+  MemoryUsageReport report;
+  report.add("pipeline", 5u);
+  report.add("pipeline/completed", 100u);
+  report.add("pipeline/completed/frame_0", 10u);
+  report.add("pipeline/processing", 20u);
+  // Neither a sub-tag nor the tag itself.
+  report.add("pipeline_other", 1000u);
+  report.add("pipelines/completed", 2000u);
+  EXPECT_EQ(135u, report.getBytes("pipeline"));
+  EXPECT_EQ(110u, report.getBytes("pipeline/completed"));
+  EXPECT_EQ(10u, report.getBytes("pipeline/completed/frame_0"));
+  EXPECT_EQ(0u, report.getBytes("pipeline/comp"));
+  EXPECT_EQ(report.getTotalBytes(), report.getBytes(""));
+
+  std::vector<std::string> exceeded_tags;
+  MemoryUsageReport::EntryMap budgets_bytes;
+  budgets_bytes["pipeline"] = 135u;
+  EXPECT_TRUE(report.isWithinBudgets(budgets_bytes, &exceeded_tags));
+  budgets_bytes["pipeline"] = 134u;
+  EXPECT_FALSE(report.isWithinBudgets(budgets_bytes, &exceeded_tags));
+  ASSERT_EQ(1u, exceeded_tags.size());
+  EXPECT_EQ("pipeline", exceeded_tags[0]);
+}
+
+TEST(MemoryUsageTest, CountsChannelsPoolsAndGrids) {
+  channels::ChannelGroup channels;
+  channels::add_MEMORY_TEST_Channel(&channels).resize(Eigen::NoChange, 100);
+  MemoryUsageReport report;
+  const size_t num_channel_bytes =
+      channels::getChannelGroupMemoryUsageBytes(channels, "frame", &report);
+  EXPECT_GE(num_channel_bytes, 2u * 100u * sizeof(double));
+  EXPECT_EQ(num_channel_bytes, report.getBytes("frame/MEMORY_TEST"));
+  EXPECT_EQ(num_channel_bytes, channels::getChannelGroupMemoryUsageBytes(channels, "", nullptr));
+
+  ObjectPool<std::vector<double>> pool(
+      2u, []() { return new std::vector<double>(); }, ObjectPool<std::vector<double>>::Recycler());
+  const auto get_vector_bytes = [](const std::vector<double>& values) {
+    return getMemoryUsageBytes(values);
+  };
+  EXPECT_EQ(0u, pool.getPooledMemoryUsageBytes(get_vector_bytes));
+  pool.preallocate(2u, [](std::vector<double>* values) { values->reserve(10u); });
+  EXPECT_GE(pool.getPooledMemoryUsageBytes(get_vector_bytes), 2u * 10u * sizeof(double));
+
+  FixedCapacityOccupancyGrid<> grid(100.0, 100.0, 10.0, 10.0, 4u);
+  EXPECT_GE(grid.getMemoryUsageBytes(),
+            100u * 4u * sizeof(FixedCapacityOccupancyGrid<>::Point));
+  WeightedOccupancyGrid<> weighted_grid(100.0, 100.0, 10.0, 10.0);
+  const size_t num_empty_grid_bytes = weighted_grid.getMemoryUsageBytes();
+  for (int i = 0; i < 50; ++i) {
+    weighted_grid.addPointUnconditional(WeightedOccupancyGrid<>::Point(5.0, 5.0, 1.0, i));
+  }
+  EXPECT_GE(weighted_grid.getMemoryUsageBytes(),
+            num_empty_grid_bytes + 50u * sizeof(WeightedOccupancyGrid<>::Point));
+}
+
+}  // namespace common
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,120 @@
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/memory.h>
+
+namespace aslam {
+namespace common {
+
+namespace {
+bool isAligned(const void* pointer, size_t alignment) {
+  return reinterpret_cast<uintptr_t>(pointer) % alignment == 0u;
+}
+
+struct CountedObject {
+  explicit CountedObject(int* num_alive) : num_alive(num_alive), position(Eigen::Vector4d::Ones()) {
+    ++(*num_alive);
+  }
+  ~CountedObject() {
+    --(*num_alive);
+  }
+  int* num_alive;
+  Eigen::Vector4d position;
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+}  // namespace
+
+TEST(MemoryTest, ArenaAlignsAndGrows) {
+  MonotonicArena arena(128u);
+  EXPECT_EQ(128u, arena.getCapacity());
+  unsigned char* byte = arena.allocateArray<unsigned char>(1u);
+  ASSERT_NE(nullptr, byte);
+  void* aligned = arena.allocate(24u, 64u);
+  EXPECT_TRUE(isAligned(aligned, 64u));
+  Eigen::Vector4d* vectors = arena.allocateArray<Eigen::Vector4d>(10u);
+  EXPECT_TRUE(isAligned(vectors, kEigenAlignmentBytes));
+  EXPECT_GT(arena.getNumBlocks(), 1u);
+  EXPECT_EQ(1u + 24u + 10u * sizeof(Eigen::Vector4d), arena.getNumBytesUsed());
+
+  // The blocks are merged, the same allocations then fit into one block.
+  const size_t capacity = arena.getCapacity();
+  arena.reset();
+  EXPECT_EQ(0u, arena.getNumBytesUsed());
+  EXPECT_EQ(1u, arena.getNumBlocks());
+  EXPECT_EQ(capacity, arena.getCapacity());
+  arena.allocateArray<unsigned char>(1u);
+  arena.allocate(24u, 64u);
+  arena.allocateArray<Eigen::Vector4d>(10u);
+  EXPECT_EQ(1u, arena.getNumBlocks());
+  EXPECT_EQ(capacity, arena.getCapacity());
+
+  const Eigen::Vector2d* created = arena.create<Eigen::Vector2d>(1.0, 2.0);
+  EXPECT_EQ(Eigen::Vector2d(1.0, 2.0), *created);
+}
+
+TEST(MemoryTest, ArenaVector) {
+  MonotonicArena arena(256u);
+  ArenaVector<Eigen::Vector4d> vectors{ArenaAllocator<Eigen::Vector4d>(&arena)};
+  for (int i = 0; i < 100; ++i) {
+    vectors.emplace_back(Eigen::Vector4d::Constant(i));
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(Eigen::Vector4d::Constant(i), vectors[i]);
+    EXPECT_TRUE(isAligned(&vectors[i], kEigenAlignmentBytes));
+  }
+  EXPECT_GE(arena.getNumBytesUsed(), 100u * sizeof(Eigen::Vector4d));
+
+  ArenaAllocator<int> int_allocator(vectors.get_allocator());
+  EXPECT_TRUE(int_allocator == vectors.get_allocator());
+  MonotonicArena other_arena;
+  EXPECT_TRUE(int_allocator != ArenaAllocator<int>(&other_arena));
+}
+
+TEST(MemoryTest, ThreadLocalArena) {
+  MonotonicArena& arena = getThreadLocalArena();
+  EXPECT_EQ(&arena, &getThreadLocalArena());
+  arena.allocate(10u);
+  arena.reset();
+  EXPECT_EQ(0u, arena.getNumBytesUsed());
+}
+
+TEST(MemoryTest, TypedObjectPoolRecyclesSlots) {
+  int num_alive = 0;
+  TypedObjectPool<CountedObject> pool(4u);
+  std::vector<CountedObject*> objects;
+  for (int i = 0; i < 6; ++i) {
+    objects.push_back(pool.create(&num_alive));
+    EXPECT_TRUE(isAligned(objects.back(), kEigenAlignmentBytes));
+  }
+  EXPECT_EQ(6, num_alive);
+  EXPECT_EQ(6u, pool.getNumObjectsInUse());
+  EXPECT_EQ(8u, pool.getCapacity());
+
+  for (CountedObject* object : objects) {
+    pool.destroy(object);
+  }
+  EXPECT_EQ(0, num_alive);
+  EXPECT_EQ(0u, pool.getNumObjectsInUse());
+
+  // Steady state, no new chunk.
+  for (int round = 0; round < 10; ++round) {
+    for (size_t i = 0u; i < objects.size(); ++i) {
+      objects[i] = pool.create(&num_alive);
+      EXPECT_EQ(Eigen::Vector4d::Ones(), objects[i]->position);
+    }
+    for (CountedObject* object : objects) {
+      pool.destroy(object);
+    }
+  }
+  EXPECT_EQ(8u, pool.getCapacity());
+  EXPECT_EQ(0, num_alive);
+}
+
+}  // namespace common
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,38 @@
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/numa.h>
+
+TEST(NumaTests, ParseCpuList) {
+  std::vector<size_t> cpu_ids;
+  ASSERT_TRUE(aslam::common::parseCpuList("0-3,8,10-11\n", &cpu_ids));
+  EXPECT_EQ((std::vector<size_t>{0u, 1u, 2u, 3u, 8u, 10u, 11u}), cpu_ids);
+  ASSERT_TRUE(aslam::common::parseCpuList("5", &cpu_ids));
+  EXPECT_EQ(std::vector<size_t>{5u}, cpu_ids);
+  // Nodes without CPUs, e.g. memory-only nodes, have an empty list.
+  ASSERT_TRUE(aslam::common::parseCpuList("\n", &cpu_ids));
+  EXPECT_TRUE(cpu_ids.empty());
+
+  EXPECT_FALSE(aslam::common::parseCpuList("3-1", &cpu_ids));
+  EXPECT_FALSE(aslam::common::parseCpuList("0-", &cpu_ids));
+  EXPECT_FALSE(aslam::common::parseCpuList("a,1", &cpu_ids));
+}
+
+TEST(NumaTests, BindingKeepsTheContent) {
+  ASSERT_GE(aslam::common::getNumNumaNodes(), 1u);
+  std::vector<unsigned char> buffer(100000u);
+  for (size_t i = 0u; i < buffer.size(); ++i) {
+    buffer[i] = static_cast<unsigned char>(i);
+  }
+  // Binding needs a NUMA kernel which the test machine may not have, hence only the content is
+  // checked.
+  aslam::common::bindMemoryToNumaNode(buffer.data(), buffer.size(), 0u);
+  for (size_t i = 0u; i < buffer.size(); ++i) {
+    ASSERT_EQ(static_cast<unsigned char>(i), buffer[i]);
+  }
+  EXPECT_TRUE(aslam::common::bindMemoryToNumaNode(nullptr, 0u, 0u));
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,94 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/object-pool.h>
+
+namespace {
+struct PooledBuffer {
+  std::vector<int> data;
+};
+}  // namespace
+
+TEST(ObjectPoolTests, ReleasedObjectsAreReused) {
+  size_t num_created = 0u;
+  aslam::common::ObjectPool<PooledBuffer> pool(
+      1u, [&num_created]() { ++num_created; return new PooledBuffer; },
+      [](PooledBuffer* buffer) { buffer->data.clear(); });
+
+  std::shared_ptr<PooledBuffer> buffer = pool.acquire();
+  buffer->data.resize(1000u, 1);
+  const int* data = buffer->data.data();
+  buffer.reset();
+  EXPECT_EQ(1u, pool.numPooledObjects());
+
+  // The recycled object keeps its capacity.
+  buffer = pool.acquire();
+  EXPECT_EQ(1u, num_created);
+  EXPECT_TRUE(buffer->data.empty());
+  EXPECT_GE(buffer->data.capacity(), 1000u);
+  buffer->data.resize(1000u);
+  EXPECT_EQ(data, buffer->data.data());
+
+  // Objects beyond the maximum pool size are deleted.
+  std::shared_ptr<PooledBuffer> other_buffer = pool.acquire();
+  EXPECT_EQ(2u, num_created);
+  buffer.reset();
+  other_buffer.reset();
+  EXPECT_EQ(1u, pool.numPooledObjects());
+}
+
+TEST(ObjectPoolTests, ObjectsOutliveThePool) {
+  std::shared_ptr<PooledBuffer> buffer;
+  {
+    aslam::common::ObjectPool<PooledBuffer> pool(
+        4u, []() { return new PooledBuffer; }, nullptr);
+    buffer = pool.acquire();
+  }
+  buffer->data.push_back(1);
+  buffer.reset();
+}
+
+TEST(ObjectPoolTests, PreallocatedObjectsAreHandedOut) {
+  size_t num_created = 0u;
+  aslam::common::ObjectPool<PooledBuffer> pool(
+      4u, [&num_created]() { ++num_created; return new PooledBuffer; }, nullptr);
+  pool.preallocate(3u, [](PooledBuffer* buffer) { buffer->data.reserve(100u); });
+  EXPECT_EQ(3u, num_created);
+  EXPECT_EQ(3u, pool.numPooledObjects());
+  // Preallocating again only tops up the pool.
+  pool.preallocate(3u, nullptr);
+  EXPECT_EQ(3u, num_created);
+
+  std::shared_ptr<PooledBuffer> buffer = pool.acquire();
+  EXPECT_EQ(3u, num_created);
+  EXPECT_GE(buffer->data.capacity(), 100u);
+}
+
+TEST(ObjectPoolTests, ConcurrentAcquireAndRelease) {
+  std::atomic<size_t> num_created(0u);
+  aslam::common::ObjectPool<PooledBuffer> pool(
+      8u, [&num_created]() { ++num_created; return new PooledBuffer; }, nullptr);
+
+  constexpr size_t kNumThreads = 8u;
+  constexpr size_t kNumIterations = 1000u;
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&pool]() {
+      for (size_t i = 0u; i < kNumIterations; ++i) {
+        std::shared_ptr<PooledBuffer> buffer = pool.acquire();
+        buffer->data.push_back(static_cast<int>(i));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_LE(num_created, kNumThreads);
+  EXPECT_EQ(num_created, pool.numPooledObjects());
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
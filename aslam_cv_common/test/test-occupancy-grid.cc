@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstdlib>
+
 #include <aslam/common/entrypoint.h>
 #include <eigen-checks/gtest.h>
 #include <Eigen/Core>
@@ -8,6 +11,7 @@
 
 typedef aslam::common::WeightedKeypoint<double, double, size_t> Point;
 typedef aslam::common::WeightedOccupancyGrid<Point> WeightedOccupancyGrid;
+typedef aslam::common::FixedCapacityOccupancyGrid<Point> FixedCapacityOccupancyGrid;
 
 TEST(OccupancyGrid, addPointOrReplaceWeakestIfCellFull) {
   WeightedOccupancyGrid grid(2.0, 2.0, 1.0, 1.0);
@@ -282,6 +286,65 @@ TEST(OccupancyGrid, GetOccupancyMask) {
   EXPECT_EQ(mask.at<unsigned char>(75, 75 - kMaskRadiusAroundPointsPx - 1), 255);
 }
 
+TEST(OccupancyGrid, GetOccupancyMaskIntoBuffer) {
+  const double kGridSize = 100.0;
+  const double kCellSize = 25.0;
+  const size_t kMaxPointsPerCell = 2u;
+  WeightedOccupancyGrid grid(kGridSize, kGridSize, kCellSize, kCellSize);
+  grid.addPointUnconditional(Point(37, 37, 1.0, 0));
+  grid.addPointUnconditional(Point(30, 30, 1.0, 1));
+  grid.addPointUnconditional(Point(75, 98, 1.0, 2));
+
+  cv::Mat mask;
+  grid.getOccupancyMask(5.0, kMaxPointsPerCell, &mask);
+  ASSERT_EQ(mask.rows, 100);
+  ASSERT_EQ(mask.cols, 100);
+  const unsigned char* mask_data = mask.data;
+  // The returned mask and the mask written into the buffer are the same.
+  const cv::Mat returned_mask = grid.getOccupancyMask(5.0, kMaxPointsPerCell);
+  EXPECT_EQ(cv::countNonZero(mask != returned_mask), 0);
+
+  // The full cell is masked.
+  EXPECT_EQ(mask.at<unsigned char>(25, 25), 0);
+  EXPECT_EQ(mask.at<unsigned char>(49, 49), 0);
+  EXPECT_EQ(mask.at<unsigned char>(24, 24), 255);
+  EXPECT_EQ(mask.at<unsigned char>(50, 50), 255);
+  // The disk of the point at the border is clipped to the mask.
+  EXPECT_EQ(mask.at<unsigned char>(75, 99), 0);
+  EXPECT_EQ(mask.at<unsigned char>(75, 93), 0);
+  EXPECT_EQ(mask.at<unsigned char>(75, 92), 255);
+  EXPECT_EQ(mask.at<unsigned char>(70, 98), 0);
+  EXPECT_EQ(mask.at<unsigned char>(69, 98), 255);
+  // Rounded off corners of the disk.
+  EXPECT_EQ(mask.at<unsigned char>(71, 94), 255);
+
+  // The buffer is reused and fully rewritten.
+  grid.reset();
+  grid.getOccupancyMask(5.0, kMaxPointsPerCell, &mask);
+  EXPECT_EQ(mask.data, mask_data);
+  EXPECT_EQ(cv::countNonZero(mask), 100 * 100);
+}
+
+TEST(OccupancyGrid, GetCellOccupancyMask) {
+  WeightedOccupancyGrid grid(100.0, 150.0, 50.0, 50.0);
+  grid.addPointUnconditional(Point(10, 10, 1.0, 0));
+  grid.addPointUnconditional(Point(60, 120, 1.0, 1));
+  grid.addPointUnconditional(Point(70, 110, 1.0, 2));
+  ASSERT_EQ(grid.getNumGridRows(), 2u);
+  ASSERT_EQ(grid.getNumGridCols(), 3u);
+
+  cv::Mat cell_mask;
+  grid.getCellOccupancyMask(2u, &cell_mask);
+  ASSERT_EQ(cell_mask.rows, 2);
+  ASSERT_EQ(cell_mask.cols, 3);
+  EXPECT_EQ(cv::countNonZero(cell_mask), 5);
+  EXPECT_EQ(cell_mask.at<unsigned char>(1, 2), 0);
+
+  grid.getCellOccupancyMask(1u, &cell_mask);
+  EXPECT_EQ(cv::countNonZero(cell_mask), 4);
+  EXPECT_EQ(cell_mask.at<unsigned char>(0, 0), 0);
+}
+
 TEST(OccupancyGrid, InvalidGridParameters) {
   // Zero sized grid.
   EXPECT_DEATH(WeightedOccupancyGrid(0.0, 1.0, 1.0, 1.0), "^");
@@ -294,4 +357,98 @@ TEST(OccupancyGrid, InvalidGridParameters) {
   EXPECT_DEATH(WeightedOccupancyGrid(1.0, 1.0, 2.0, 2.0), "^");
 }
 
+TEST(FixedCapacityOccupancyGrid, addPointOrReplaceWeakestIfCellFull) {
+  static constexpr size_t kMaxNumPointsPerCell = 2u;
+  FixedCapacityOccupancyGrid grid(2.0, 2.0, 1.0, 1.0, kMaxNumPointsPerCell);
+  EXPECT_EQ(grid.getNumCells(), 4u);
+
+  EXPECT_TRUE(grid.addPointOrReplaceWeakestIfCellFull(Point(0.5, 0.0, 0.9, 0)));
+  EXPECT_TRUE(grid.addPointOrReplaceWeakestIfCellFull(Point(0.5, 0.0, 1.0, 1)));
+  EXPECT_FALSE(grid.addPointOrReplaceWeakestIfCellFull(Point(0.5, 0.0, 0.8, 2)));
+  // Higher weight replaces point.
+  EXPECT_TRUE(grid.addPointOrReplaceWeakestIfCellFull(Point(0.5, 0.0, 1.1, 3)));
+  // Both remaining points are stronger than the new one.
+  EXPECT_FALSE(grid.addPointOrReplaceWeakestIfCellFull(Point(0.5, 0.0, 0.95, 4)));
+  ASSERT_EQ(grid.getNumPointsInCell(0.5, 0.0), 2u);
+  EXPECT_EQ(grid.getPointInCell(0.5, 0.0, 0).id, 3u);
+  EXPECT_EQ(grid.getPointInCell(0.5, 0.0, 1).id, 1u);
+  EXPECT_EQ(grid.getNumPoints(), 2u);
+
+  EXPECT_EQ(grid.getNumPointsInCell(0.0, 1.5), 0u);
+  EXPECT_EQ(grid.getNumPointsInCell(1.5, 1.5), 0u);
+  EXPECT_EQ(grid.getNumPointsInCell(1.5, 0.0), 0u);
+
+  // The grid can be reused after a reset.
+  grid.reset();
+  EXPECT_EQ(grid.getNumPoints(), 0u);
+  EXPECT_EQ(grid.getNumPointsInCell(0.5, 0.0), 0u);
+  EXPECT_TRUE(grid.addPointOrReplaceWeakestIfCellFull(Point(0.5, 0.0, 0.1, 5)));
+  EXPECT_TRUE(grid.addPointOrReplaceWeakestIfCellFull(Point(0.5, 0.0, 0.2, 6)));
+  EXPECT_TRUE(grid.addPointOrReplaceWeakestIfCellFull(Point(0.5, 0.0, 0.3, 7)));
+  ASSERT_EQ(grid.getNumPointsInCell(0.5, 0.0), 2u);
+  EXPECT_EQ(grid.getPointInCell(0.5, 0.0, 0).id, 7u);
+  EXPECT_EQ(grid.getPointInCell(0.5, 0.0, 1).id, 6u);
+}
+
+TEST(FixedCapacityOccupancyGrid, RemovePointsFromFullestCellsUntilSize) {
+  FixedCapacityOccupancyGrid grid(2.0, 2.0, 1.0, 1.0, 3u);
+  grid.addPointOrReplaceWeakestIfCellFull(Point(0.5, 0.5, 0.3, 0));
+  grid.addPointOrReplaceWeakestIfCellFull(Point(0.5, 0.5, 0.2, 1));
+  grid.addPointOrReplaceWeakestIfCellFull(Point(0.5, 0.5, 0.4, 2));
+  grid.addPointOrReplaceWeakestIfCellFull(Point(1.5, 1.5, 0.1, 3));
+  ASSERT_EQ(grid.getNumPoints(), 4u);
+
+  grid.removePointsFromFullestCellsUntilSize(2u);
+  FixedCapacityOccupancyGrid::PointList points;
+  EXPECT_EQ(grid.getAllPointsInGrid(&points), 2u);
+  ASSERT_EQ(points.size(), 2u);
+  EXPECT_EQ(points[0].id, 2u);
+  EXPECT_EQ(points[1].id, 3u);
+}
+
+TEST(FixedCapacityOccupancyGrid, KeepsSamePointsAsWeightedOccupancyGrid) {
+  const double kHeight = 480.0;
+  const double kWidth = 752.0;
+  const double kCellSize = 50.0;
+  const size_t kMaxNumPointsPerCell = 3u;
+  const size_t kNumPoints = 5000u;
+  WeightedOccupancyGrid grid(kHeight, kWidth, kCellSize, kCellSize);
+  FixedCapacityOccupancyGrid fixed_capacity_grid(
+      kHeight, kWidth, kCellSize, kCellSize, kMaxNumPointsPerCell);
+
+  std::srand(42);
+  for (int repetition = 0; repetition < 2; ++repetition) {
+    grid.reset();
+    fixed_capacity_grid.reset();
+    for (size_t point_idx = 0u; point_idx < kNumPoints; ++point_idx) {
+      const Point point(kHeight * std::rand() / (RAND_MAX + 1.0),
+                        kWidth * std::rand() / (RAND_MAX + 1.0),
+                        static_cast<double>(std::rand()) / RAND_MAX, point_idx);
+      EXPECT_EQ(grid.addPointOrReplaceWeakestIfCellFull(point, kMaxNumPointsPerCell),
+                fixed_capacity_grid.addPointOrReplaceWeakestIfCellFull(point));
+    }
+    ASSERT_EQ(fixed_capacity_grid.getNumPoints(), grid.getNumPoints());
+
+    grid.removePointsFromFullestCellsUntilSize(300u);
+    fixed_capacity_grid.removePointsFromFullestCellsUntilSize(300u);
+    WeightedOccupancyGrid::PointList points, fixed_capacity_points;
+    grid.getAllPointsInGrid(&points);
+    fixed_capacity_grid.getAllPointsInGrid(&fixed_capacity_points);
+    ASSERT_EQ(fixed_capacity_points.size(), points.size());
+
+    const auto by_id = [](const Point& lhs, const Point& rhs) { return lhs.id < rhs.id; };
+    std::sort(points.begin(), points.end(), by_id);
+    std::sort(fixed_capacity_points.begin(), fixed_capacity_points.end(), by_id);
+    for (size_t point_idx = 0u; point_idx < points.size(); ++point_idx) {
+      EXPECT_EQ(fixed_capacity_points[point_idx].id, points[point_idx].id);
+    }
+  }
+}
+
+TEST(FixedCapacityOccupancyGrid, InvalidGridParameters) {
+  EXPECT_DEATH(FixedCapacityOccupancyGrid(0.0, 1.0, 1.0, 1.0, 1u), "^");
+  EXPECT_DEATH(FixedCapacityOccupancyGrid(1.0, 1.0, 2.0, 0.5, 1u), "^");
+  EXPECT_DEATH(FixedCapacityOccupancyGrid(1.0, 1.0, 1.0, 1.0, 0u), "^");
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <future>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/parallel-for.h>
+
+TEST(ParallelForTests, EveryIndexIsVisitedOnce) {
+  constexpr size_t kNumIndices = 10007u;
+  for (const size_t grain_size : {1u, 7u, 64u, 20000u}) {
+    std::vector<std::atomic<int>> visits(kNumIndices);
+    for (std::atomic<int>& visit : visits) {
+      visit = 0;
+    }
+    std::atomic<size_t> num_chunks(0u);
+    aslam::common::parallelFor(aslam::common::IndexRange(3u, kNumIndices), grain_size,
+                               [&](size_t begin, size_t end) {
+      EXPECT_LE(end - begin, grain_size);
+      // The chunks are aligned to the grain size.
+      EXPECT_EQ(0u, (begin - 3u) % grain_size);
+      for (size_t i = begin; i < end; ++i) {
+        ++visits[i];
+      }
+      ++num_chunks;
+    });
+    for (size_t i = 0u; i < kNumIndices; ++i) {
+      EXPECT_EQ(i < 3u ? 0 : 1, visits[i].load()) << i;
+    }
+    EXPECT_EQ((kNumIndices - 3u + grain_size - 1u) / grain_size, num_chunks.load());
+  }
+}
+
+TEST(ParallelForTests, EmptyRange) {
+  bool called = false;
+  aslam::common::parallelFor(aslam::common::IndexRange(5u, 5u), 4u,
+                             [&called](size_t, size_t) { called = true; });
+  EXPECT_FALSE(called);
+}
+
+TEST(ParallelForTests, ReductionIsDeterministic) {
+  constexpr size_t kNumIndices = 100000u;
+  std::vector<double> values(kNumIndices);
+  for (size_t i = 0u; i < kNumIndices; ++i) {
+    values[i] = std::sin(static_cast<double>(i)) * 1e8 + 1e-8 * i;
+  }
+  auto sum = [&values]() {
+    return aslam::common::parallelReduce(
+        aslam::common::IndexRange(0u, values.size()), 128u, 0.0,
+        [&values](size_t begin, size_t end) {
+          double chunk_sum = 0.0;
+          for (size_t i = begin; i < end; ++i) {
+            chunk_sum += values[i];
+          }
+          return chunk_sum;
+        },
+        [](double lhs, double rhs) { return lhs + rhs; });
+  };
+  // The same chunks in the same order as a serial reduction.
+  double expected_sum = 0.0;
+  for (size_t begin = 0u; begin < kNumIndices; begin += 128u) {
+    double chunk_sum = 0.0;
+    for (size_t i = begin; i < std::min(begin + 128u, kNumIndices); ++i) {
+      chunk_sum += values[i];
+    }
+    expected_sum += chunk_sum;
+  }
+  for (int repetition = 0; repetition < 10; ++repetition) {
+    EXPECT_EQ(expected_sum, sum());
+  }
+}
+
+TEST(ParallelForTests, NestedLoopsOnPoolThreads) {
+  std::atomic<size_t> num_visits(0u);
+  aslam::common::parallelFor(aslam::common::IndexRange(0u, 64u), 1u, [&](size_t, size_t) {
+    aslam::common::parallelFor(aslam::common::IndexRange(0u, 100u), 10u,
+                               [&num_visits](size_t begin, size_t end) {
+      num_visits += end - begin;
+    });
+  });
+  EXPECT_EQ(64u * 100u, num_visits.load());
+
+  // From a task of the shared pool itself.
+  std::future<size_t> result = aslam::common::getParallelForThreadPool().enqueue([]() {
+    return aslam::common::parallelReduce(
+        aslam::common::IndexRange(0u, 1000u), 10u, size_t{0u},
+        [](size_t begin, size_t end) { return end - begin; },
+        [](size_t lhs, size_t rhs) { return lhs + rhs; });
+  });
+  EXPECT_EQ(1000u, result.get());
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,88 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/parameter-version.h>
+
+TEST(ParameterVersionTests, VersionsIncrease) {
+  const aslam::ParameterVersion first = aslam::getNextParameterVersion();
+  EXPECT_GT(first, 0u);
+  EXPECT_GT(aslam::getNextParameterVersion(), first);
+}
+
+TEST(ParameterVersionTests, PendingWritesTakeAVersionOnTheNextRead) {
+  aslam::ParameterVersionTracker tracker;
+  const aslam::ParameterVersion version = tracker.get();
+  EXPECT_GT(version, 0u);
+  EXPECT_EQ(version, tracker.get());
+
+  // The version doesn't change until the parameters are read after the write.
+  const aslam::ParameterVersion version_before_write = aslam::getNextParameterVersion();
+  tracker.markPendingWrite();
+  const aslam::ParameterVersion version_after_write = tracker.get();
+  EXPECT_GT(version_after_write, version_before_write);
+  EXPECT_EQ(version_after_write, tracker.get());
+
+  tracker.markChanged();
+  EXPECT_GT(tracker.get(), version_after_write);
+
+  // The copy takes the version of the pending write.
+  tracker.markPendingWrite();
+  aslam::ParameterVersionTracker copy(tracker);
+  EXPECT_GT(copy.get(), version_after_write);
+  EXPECT_EQ(copy.get(), tracker.get());
+}
+
+TEST(ParameterVersionTests, CacheRebuildsOnlyForNewVersions) {
+  aslam::DerivedCache<int> cache;
+  int num_builds = 0;
+  auto builder = [&num_builds]() { return std::make_shared<const int>(++num_builds); };
+
+  const aslam::ParameterVersion version = aslam::getNextParameterVersion();
+  EXPECT_EQ(nullptr, cache.getIfCurrent(version));
+  std::shared_ptr<const int> value = cache.get(version, builder);
+  EXPECT_EQ(1, *value);
+  EXPECT_EQ(value, cache.get(version, builder));
+  EXPECT_EQ(value, cache.getIfCurrent(version));
+  EXPECT_EQ(1, num_builds);
+
+  const aslam::ParameterVersion new_version = aslam::getNextParameterVersion();
+  EXPECT_EQ(nullptr, cache.getIfCurrent(new_version));
+  EXPECT_EQ(2, *cache.get(new_version, builder));
+  // The old snapshot is still valid.
+  EXPECT_EQ(1, *value);
+
+  cache.clear();
+  EXPECT_EQ(nullptr, cache.getIfCurrent(new_version));
+  EXPECT_EQ(3, *cache.get(new_version, builder));
+
+  // Copies are empty.
+  aslam::DerivedCache<int> copy(cache);
+  EXPECT_EQ(nullptr, copy.getIfCurrent(new_version));
+}
+
+TEST(ParameterVersionTests, ConcurrentQueriesBuildOnce) {
+  aslam::DerivedCache<int> cache;
+  std::atomic<int> num_builds(0);
+  const aslam::ParameterVersion version = aslam::getNextParameterVersion();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&cache, &num_builds, version]() {
+      for (int j = 0; j < 100; ++j) {
+        cache.get(version, [&num_builds]() {
+          return std::make_shared<const int>(++num_builds);
+        });
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(1, num_builds.load());
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
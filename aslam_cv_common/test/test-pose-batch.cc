@@ -0,0 +1,69 @@
+#include <Eigen/Core>
+#include <eigen-checks/gtest.h>
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-batch.h>
+#include <aslam/common/pose-types.h>
+
+namespace aslam {
+namespace {
+Transformation createTestTransformation() {
+  return Transformation(Quaternion(AngleAxis(0.7, Eigen::Vector3d(0.3, -1.0, 0.5).normalized())),
+                        Position3D(1.5, -0.2, 3.0));
+}
+}  // namespace
+
+TEST(PoseBatch, TransformsLikeTheTransformation) {
+  const Transformation T_A_B = createTestTransformation();
+  Eigen::Matrix3Xd empty_points(3, 0), A_empty_points;
+  transformPoints(T_A_B, empty_points, &A_empty_points);
+  EXPECT_EQ(0, A_empty_points.cols());
+
+  // All remainders of the SIMD blocks.
+  for (int num_points = 1; num_points < 11; ++num_points) {
+    const Eigen::Matrix3Xd B_points = 10.0 * Eigen::Matrix3Xd::Random(3, num_points);
+    const Eigen::Matrix3Xd expected_A_points = T_A_B.transformVectorized(B_points);
+    const Eigen::Matrix3Xd expected_A_rays = T_A_B.getRotationMatrix() * B_points;
+
+    Eigen::Matrix3Xd A_points;
+    transformPoints(T_A_B, B_points, &A_points);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(expected_A_points, A_points, 1e-12));
+    rotatePoints(T_A_B.getRotation(), B_points, &A_points);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(expected_A_rays, A_points, 1e-12));
+    rotatePoints(T_A_B.getRotationMatrix(), B_points, &A_points);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(expected_A_rays, A_points, 1e-12));
+
+    // In place.
+    A_points = B_points;
+    transformPoints(T_A_B, A_points, &A_points);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(expected_A_points, A_points, 1e-12));
+  }
+}
+
+TEST(PoseBatch, TransformsFloatPoints) {
+  const Transformation T_A_B = createTestTransformation();
+  for (int num_points = 1; num_points < 11; ++num_points) {
+    const Eigen::Matrix3Xf B_points = 10.0f * Eigen::Matrix3Xf::Random(3, num_points);
+    const Eigen::Matrix3Xf expected_A_points =
+        T_A_B.transformVectorized(B_points.cast<double>()).cast<float>();
+    const Eigen::Matrix3Xf expected_A_rays =
+        (T_A_B.getRotationMatrix() * B_points.cast<double>()).cast<float>();
+
+    Eigen::Matrix3Xf A_points;
+    transformPoints(T_A_B, B_points, &A_points);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(expected_A_points, A_points, 1e-4));
+    rotatePoints(T_A_B.getRotation(), B_points, &A_points);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(expected_A_rays, A_points, 1e-4));
+    rotatePoints(Eigen::Matrix3f(T_A_B.getRotationMatrix().cast<float>()), B_points, &A_points);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(expected_A_rays, A_points, 1e-4));
+
+    A_points = B_points;
+    rotatePoints(T_A_B.getRotation(), A_points, &A_points);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(expected_A_rays, A_points, 1e-4));
+  }
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
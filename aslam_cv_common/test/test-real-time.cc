@@ -0,0 +1,88 @@
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/real-time.h>
+#include <aslam/common/thread-pool.h>
+
+TEST(RealTimeTests, PrefaultingKeepsTheContent) {
+  std::vector<unsigned char> buffer(100000u);
+  for (size_t i = 0u; i < buffer.size(); ++i) {
+    buffer[i] = static_cast<unsigned char>(i);
+  }
+  aslam::common::prefaultMemory(buffer.data(), buffer.size());
+  for (size_t i = 0u; i < buffer.size(); ++i) {
+    ASSERT_EQ(static_cast<unsigned char>(i), buffer[i]);
+  }
+  aslam::common::prefaultMemory(nullptr, 0u);
+  aslam::common::prefaultStack(64u * 1024u);
+}
+
+#ifdef __GLIBC__
+TEST(RealTimeTests, FreedHeapMemoryIsReused) {
+  ASSERT_TRUE(aslam::common::retainFreedHeapMemory());
+  // Above the default mmap threshold, the block would be unmapped when freed otherwise.
+  const size_t kNumBytes = 1u << 20;
+  void* block = std::malloc(kNumBytes);
+  ASSERT_TRUE(block != nullptr);
+  aslam::common::prefaultMemory(block, kNumBytes);
+  std::free(block);
+  void* reused_block = std::malloc(kNumBytes);
+  EXPECT_EQ(block, reused_block);
+  std::free(reused_block);
+}
+#endif
+
+TEST(RealTimeTests, SteadyStateAllocationsAreCounted) {
+  ASSERT_TRUE(aslam::common::areAllocationHooksInstalled());
+  FLAGS_acv_abort_on_steady_state_allocation = false;
+  aslam::common::resetNumSteadyStateAllocations();
+
+  // Allocations outside of a scope are not counted.
+  std::unique_ptr<std::vector<int>> data(new std::vector<int>(10u));
+  EXPECT_EQ(0u, aslam::common::getNumSteadyStateAllocations());
+  {
+    aslam::common::SteadyStateScope steady_state;
+    EXPECT_TRUE(aslam::common::SteadyStateScope::isActive());
+    // Working on preallocated memory does not allocate.
+    for (int& value : *data) {
+      value = 1;
+    }
+    EXPECT_EQ(0u, aslam::common::getNumSteadyStateAllocations());
+    {
+      aslam::common::SteadyStateScope nested_steady_state;
+      data->resize(1000u);
+    }
+    EXPECT_TRUE(aslam::common::SteadyStateScope::isActive());
+    EXPECT_EQ(1u, aslam::common::getNumSteadyStateAllocations());
+  }
+  EXPECT_FALSE(aslam::common::SteadyStateScope::isActive());
+  data.reset(new std::vector<int>(10u));
+  {
+    aslam::common::SteadyStateScope disabled_steady_state(false);
+    EXPECT_FALSE(aslam::common::SteadyStateScope::isActive());
+    data->resize(2000u);
+  }
+  EXPECT_EQ(1u, aslam::common::getNumSteadyStateAllocations());
+}
+
+TEST(RealTimeTests, SteadyStateAllocationsAbort) {
+  FLAGS_acv_abort_on_steady_state_allocation = true;
+  EXPECT_DEATH({
+    aslam::common::SteadyStateScope steady_state;
+    std::unique_ptr<int> value(new int(1));
+  }, "steady state");
+}
+
+TEST(RealTimeTests, WorkerPriorities) {
+  aslam::ThreadPool pool(2u);
+  // Real-time priorities need privileges which the test may not have, hence only the tasks are
+  // checked to still run.
+  pool.setRealTimePriority(10);
+  EXPECT_EQ(1, pool.enqueue([]() { return 1; }).get());
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
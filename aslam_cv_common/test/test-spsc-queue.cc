@@ -0,0 +1,66 @@
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/spsc-queue.h>
+
+TEST(SpscQueueTests, PushPopInOrderUntilFull) {
+  aslam::common::SpscQueue<int> queue(3u);
+  EXPECT_TRUE(queue.empty());
+  int value = 0;
+  EXPECT_FALSE(queue.tryPop(&value));
+
+  // Wrap around the slots a few times.
+  for (int round = 0; round < 5; ++round) {
+    EXPECT_TRUE(queue.tryPush(round * 10 + 1));
+    EXPECT_TRUE(queue.tryPush(round * 10 + 2));
+    EXPECT_TRUE(queue.tryPush(round * 10 + 3));
+    EXPECT_FALSE(queue.tryPush(100));
+    EXPECT_EQ(3u, queue.size());
+    for (int i = 1; i <= 3; ++i) {
+      ASSERT_TRUE(queue.tryPop(&value));
+      EXPECT_EQ(round * 10 + i, value);
+    }
+    EXPECT_TRUE(queue.empty());
+  }
+}
+
+TEST(SpscQueueTests, PoppedValuesAreReleased) {
+  aslam::common::SpscQueue<std::shared_ptr<int>> queue(2u);
+  std::shared_ptr<int> value = std::make_shared<int>(1);
+  std::weak_ptr<int> weak_value = value;
+  EXPECT_TRUE(queue.tryPush(std::move(value)));
+  EXPECT_FALSE(weak_value.expired());
+  std::shared_ptr<int> popped;
+  ASSERT_TRUE(queue.tryPop(&popped));
+  popped.reset();
+  EXPECT_TRUE(weak_value.expired());
+}
+
+TEST(SpscQueueTests, ConcurrentProducerAndConsumer) {
+  const size_t kNumValues = 10000u;
+  aslam::common::SpscQueue<size_t> queue(16u);
+  std::thread producer([&queue, kNumValues]() {
+    for (size_t i = 0u; i < kNumValues; ++i) {
+      size_t value = i;
+      while (!queue.tryPush(std::move(value))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  size_t expected_value = 0u;
+  while (expected_value < kNumValues) {
+    size_t value;
+    if (queue.tryPop(&value)) {
+      ASSERT_EQ(expected_value, value);
+      ++expected_value;
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(queue.empty());
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
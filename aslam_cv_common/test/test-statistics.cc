@@ -0,0 +1,140 @@
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/statistics/statistics.h>
+#include <aslam/common/timer.h>
+
+TEST(StatisticsTests, SamplesOfAllThreadsAreMerged) {
+  const size_t kNumThreads = 4u;
+  // Not a multiple of the buffer size, some samples are only merged when read.
+  const size_t kNumSamplesPerThread = 1000u;
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([thread_idx, kNumSamplesPerThread]() {
+      statistics::StatsCollectorImpl collector("test/merged");
+      for (size_t sample_idx = 0u; sample_idx < kNumSamplesPerThread; ++sample_idx) {
+        collector.AddSample(static_cast<double>(thread_idx));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(statistics::Statistics::GetNumSamples("test/merged"),
+            kNumThreads * kNumSamplesPerThread);
+  EXPECT_DOUBLE_EQ(statistics::Statistics::GetTotal("test/merged"),
+                   kNumSamplesPerThread * (kNumThreads * (kNumThreads - 1u) / 2u));
+  EXPECT_DOUBLE_EQ(statistics::Statistics::GetMin("test/merged"), 0.0);
+  EXPECT_DOUBLE_EQ(statistics::Statistics::GetMax("test/merged"), kNumThreads - 1.0);
+}
+
+TEST(StatisticsTests, BufferedSamplesAreVisibleToTheAddingThread) {
+  statistics::StatsCollectorImpl collector("test/buffered");
+  collector.AddSample(2.0);
+  collector.IncrementOne();
+  EXPECT_EQ(statistics::Statistics::GetNumSamples(collector.GetHandle()), 2u);
+  EXPECT_DOUBLE_EQ(statistics::Statistics::GetLastValue(collector.GetHandle()), 1.0);
+  EXPECT_DOUBLE_EQ(statistics::Statistics::GetMean(collector.GetHandle()), 1.5);
+
+  // Samples of a running thread are merged at print time.
+  std::thread thread([]() {
+    statistics::StatsCollectorImpl other_collector("test/buffered");
+    other_collector.AddSample(3.0);
+    EXPECT_EQ(statistics::Statistics::GetNumSamples("test/buffered"), 3u);
+  });
+  thread.join();
+  EXPECT_NE(statistics::Statistics::Print().find("test/buffered"), std::string::npos);
+}
+
+TEST(StatisticsTests, HandlesAreStable) {
+  const size_t handle = statistics::Statistics::GetHandle("test/handle");
+  EXPECT_EQ(statistics::Statistics::GetHandle("test/handle"), handle);
+  EXPECT_EQ(statistics::Statistics::GetTag(handle), "test/handle");
+  EXPECT_TRUE(statistics::Statistics::HasHandle("test/handle"));
+
+  size_t other_thread_handle = 0u;
+  std::thread thread([&other_thread_handle]() {
+    other_thread_handle = statistics::Statistics::GetHandle("test/handle");
+  });
+  thread.join();
+  EXPECT_EQ(other_thread_handle, handle);
+
+  // Handles cached before the reset are not reused.
+  statistics::Statistics::Reset();
+  EXPECT_FALSE(statistics::Statistics::HasHandle("test/handle"));
+  EXPECT_NE(statistics::Statistics::GetHandle("test/handle"), handle);
+  EXPECT_TRUE(statistics::Statistics::HasHandle("test/handle"));
+}
+
+TEST(TimingTests, TimersOfAllThreadsAreMerged) {
+  const size_t kNumThreads = 4u;
+  const size_t kNumTimersPerThread = 300u;
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([kNumTimersPerThread]() {
+      for (size_t timer_idx = 0u; timer_idx < kNumTimersPerThread; ++timer_idx) {
+        timing::TimerImpl timer("test/timer");
+        EXPECT_GE(timer.Stop(), 0.0);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(timing::Timing::GetNumSamples("test/timer"), kNumThreads * kNumTimersPerThread);
+  EXPECT_GE(timing::Timing::GetMinSeconds("test/timer"), 0.0);
+  EXPECT_NE(timing::Timing::Print().find("test/timer"), std::string::npos);
+}
+
+TEST(TimingTests, CycleClockIsCalibrated) {
+  const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+  const uint64_t start_ticks = timing::CycleClock::Now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  const uint64_t end_ticks = timing::CycleClock::Now();
+  const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start_time).count();
+  ASSERT_GT(end_ticks, start_ticks);
+  EXPECT_NEAR(timing::CycleClock::TicksToSeconds(end_ticks - start_ticks), seconds,
+              0.1 * seconds);
+}
+
+TEST(TimingTests, SamplingInterval) {
+  const size_t kNumStarts = 1000u;
+  const uint32_t kSamplingInterval = 16u;
+  EXPECT_EQ(timing::Timing::GetSamplingInterval("test/sampled"), 1u);
+  timing::Timing::SetSamplingInterval("test/sampled", kSamplingInterval);
+  EXPECT_EQ(timing::Timing::GetSamplingInterval("test/sampled"), kSamplingInterval);
+
+  const size_t handle = timing::Timing::GetHandle("test/sampled");
+  size_t num_measured = 0u;
+  for (size_t start_idx = 0u; start_idx < kNumStarts; ++start_idx) {
+    timing::TimerImpl timer(handle);
+    if (timer.IsTiming()) {
+      ++num_measured;
+    }
+  }
+  const size_t kExpectedNumSamples = (kNumStarts + kSamplingInterval - 1u) / kSamplingInterval;
+  EXPECT_EQ(num_measured, kExpectedNumSamples);
+  EXPECT_EQ(timing::Timing::GetNumSamples(handle), kExpectedNumSamples);
+
+  // Other tags are not sampled.
+  for (size_t start_idx = 0u; start_idx < 10u; ++start_idx) {
+    timing::TimerImpl timer("test/unsampled");
+  }
+  EXPECT_EQ(timing::Timing::GetNumSamples("test/unsampled"), 10u);
+
+  timing::Timing::SetSamplingInterval("test/sampled", 1u);
+  {
+    timing::TimerImpl timer(handle);
+    EXPECT_TRUE(timer.IsTiming());
+  }
+  EXPECT_EQ(timing::Timing::GetNumSamples(handle), kExpectedNumSamples + 1u);
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -1,3 +1,4 @@
+#include <string>
 #include <vector>
 
 #include <aslam/common/entrypoint.h>
@@ -87,4 +88,94 @@ TEST(StdHelpers, CountNestedListElements) {
            kArbitraryNumElementsOfList *  kArbitraryNumElementsOfNestedList);
 }
 
+TEST(StlHelpers, CompactInPlace) {
+  const std::vector<bool> keep_mask = {true, false, false, true, true, false};
+
+  std::vector<int> test_vector = {0, 1, 2, 3, 4, 5};
+  const size_t capacity = test_vector.capacity();
+  EXPECT_EQ(3u, common::stl_helpers::compactInPlace(keep_mask, 6u, &test_vector));
+  EXPECT_EQ(std::vector<int>({0, 3, 4}), test_vector);
+  EXPECT_EQ(capacity, test_vector.capacity());
+
+  Eigen::Matrix2Xd keypoints(2, 6);
+  keypoints << 0, 1, 2, 3, 4, 5,
+               6, 7, 8, 9, 10, 11;
+  common::stl_helpers::compactInPlace(keep_mask, 6u, &keypoints);
+  Eigen::Matrix2Xd expected_keypoints(2, 3);
+  expected_keypoints << 0, 3, 4,
+                        6, 9, 10;
+  EXPECT_TRUE(keypoints == expected_keypoints);
+
+  Eigen::VectorXi track_ids(6);
+  track_ids << 10, 11, 12, 13, 14, 15;
+  common::stl_helpers::compactInPlace(keep_mask, 6u, &track_ids);
+  EXPECT_TRUE(track_ids == Eigen::Vector3i(10, 13, 14));
+
+  Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> descriptors(3, 6);
+  for (int i = 0; i < 6; ++i) {
+    descriptors.col(i).setConstant(i);
+  }
+  common::stl_helpers::OneDimensionAdapter<unsigned char, common::stl_helpers::kColumns>
+      adapter(&descriptors);
+  common::stl_helpers::compactInPlace(keep_mask, 6u, &adapter);
+  ASSERT_EQ(3, descriptors.rows());
+  ASSERT_EQ(3, descriptors.cols());
+  EXPECT_EQ(3, descriptors(2, 1));
+  EXPECT_EQ(4, descriptors(0, 2));
+}
+
+TEST(StlHelpers, EraseIndicesInPlace) {
+  const std::vector<size_t> indices_to_erase = {0, 2, 3, 5};
+
+  std::vector<int> test_vector = {0, 1, 2, 3, 4, 5, 6};
+  const size_t capacity = test_vector.capacity();
+  common::eraseIndicesFromVectorInPlace(indices_to_erase, &test_vector);
+  EXPECT_EQ(std::vector<int>({1, 4, 6}), test_vector);
+  EXPECT_EQ(capacity, test_vector.capacity());
+
+  // Elements that are not trivially copyable are moved.
+  std::vector<std::string> strings = {"a", "b", "c", "d", "e", "f", "g"};
+  common::eraseIndicesFromVectorInPlace(indices_to_erase, &strings);
+  EXPECT_EQ(std::vector<std::string>({"b", "e", "g"}), strings);
+
+  Eigen::Matrix2Xd keypoints(2, 7);
+  keypoints << 0, 1, 2, 3, 4, 5, 6,
+               7, 8, 9, 10, 11, 12, 13;
+  common::stl_helpers::eraseIndicesInPlace(indices_to_erase, 7u, &keypoints);
+  Eigen::Matrix2Xd expected_keypoints(2, 3);
+  expected_keypoints << 1, 4, 6,
+                        8, 11, 13;
+  EXPECT_TRUE(keypoints == expected_keypoints);
+
+  Eigen::VectorXd scores(7);
+  scores << 0, 1, 2, 3, 4, 5, 6;
+  common::stl_helpers::eraseIndicesInPlace(indices_to_erase, 7u, &scores);
+  EXPECT_TRUE(scores == Eigen::Vector3d(1, 4, 6));
+
+  Eigen::Matrix<double, Eigen::Dynamic, 2> rows(7, 2);
+  rows.col(0) << 0, 1, 2, 3, 4, 5, 6;
+  rows.col(1) = -rows.col(0);
+  common::stl_helpers::eraseIndicesInPlace(indices_to_erase, 7u, &rows);
+  ASSERT_EQ(3, rows.rows());
+  EXPECT_TRUE(rows.col(0) == Eigen::Vector3d(1, 4, 6));
+  EXPECT_TRUE(rows.col(1) == Eigen::Vector3d(-1, -4, -6));
+
+  Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> descriptors(3, 7);
+  for (int i = 0; i < 7; ++i) {
+    descriptors.col(i).setConstant(i);
+  }
+  common::stl_helpers::OneDimensionAdapter<unsigned char, common::stl_helpers::kColumns>
+      adapter(&descriptors);
+  common::stl_helpers::eraseIndicesInPlace(indices_to_erase, 7u, &adapter);
+  ASSERT_EQ(3, descriptors.rows());
+  ASSERT_EQ(3, descriptors.cols());
+  EXPECT_EQ(1, descriptors(2, 0));
+  EXPECT_EQ(4, descriptors(0, 1));
+  EXPECT_EQ(6, descriptors(1, 2));
+
+  // Nothing to erase.
+  common::stl_helpers::eraseIndicesInPlace(std::vector<size_t>(), 3u, &test_vector);
+  EXPECT_EQ(std::vector<int>({1, 4, 6}), test_vector);
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
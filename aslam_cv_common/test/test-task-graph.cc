@@ -0,0 +1,145 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/task-graph.h>
+#include <aslam/common/thread-pool.h>
+
+namespace {
+constexpr size_t kNumCameras = 4u;
+constexpr size_t kNumStages = 6u;
+}  // namespace
+
+TEST(TaskGraphTests, DependenciesAreRespected) {
+  aslam::ThreadPool pool(4u);
+  aslam::TaskGraph graph(&pool);
+
+  // One chain of stages per camera and a rig-level stage after all chains.
+  std::atomic<size_t> stages[kNumCameras];
+  std::vector<aslam::TaskGraph::NodeId> last_nodes;
+  std::atomic<int> num_order_violations(0);
+  for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+    stages[camera_idx] = 0u;
+    aslam::TaskGraph::NodeId node = 0u;
+    for (size_t stage = 0u; stage < kNumStages; ++stage) {
+      const aslam::TaskGraph::Task task = [&stages, &num_order_violations, camera_idx, stage]() {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        if (stages[camera_idx]++ != stage) {
+          ++num_order_violations;
+        }
+      };
+      node = (stage == 0u) ? graph.addNode(task) : graph.addNode(task, {node});
+    }
+    last_nodes.push_back(node);
+  }
+  std::atomic<size_t> num_rig_runs(0u);
+  graph.addNode([&]() {
+    for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+      if (stages[camera_idx] != kNumStages) {
+        ++num_order_violations;
+      }
+    }
+    ++num_rig_runs;
+  }, last_nodes);
+  EXPECT_EQ(kNumCameras * kNumStages + 1u, graph.getNumNodes());
+
+  // The graph is reused for every frame.
+  constexpr size_t kNumFrames = 20u;
+  for (size_t frame_idx = 0u; frame_idx < kNumFrames; ++frame_idx) {
+    for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+      stages[camera_idx] = 0u;
+    }
+    EXPECT_TRUE(graph.run());
+    EXPECT_FALSE(graph.isRunning());
+    EXPECT_EQ(graph.getNumNodes(), graph.getNumExecutedNodes());
+  }
+  EXPECT_EQ(0, num_order_violations.load());
+  EXPECT_EQ(kNumFrames, num_rig_runs.load());
+}
+
+TEST(TaskGraphTests, CompletionCallbackStartsTheNextRun) {
+  aslam::ThreadPool pool(2u);
+  aslam::TaskGraph graph(&pool);
+  std::atomic<size_t> num_executions(0u);
+  const aslam::TaskGraph::NodeId first = graph.addNode([&num_executions]() { ++num_executions; });
+  graph.addNode([&num_executions]() { ++num_executions; }, {first});
+
+  constexpr size_t kNumRuns = 10u;
+  std::mutex mutex;
+  std::condition_variable condition;
+  size_t num_finished_runs = 0u;
+  aslam::TaskGraph::CompletionCallback callback = [&](bool success) {
+    EXPECT_TRUE(success);
+    std::unique_lock<std::mutex> lock(mutex);
+    if (++num_finished_runs < kNumRuns) {
+      graph.start(callback);
+    }
+    condition.notify_all();
+  };
+  graph.start(callback);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&]() { return num_finished_runs == kNumRuns; });
+  }
+  graph.wait();
+  EXPECT_EQ(2u * kNumRuns, num_executions.load());
+}
+
+TEST(TaskGraphTests, CancellationSkipsPendingNodes) {
+  aslam::ThreadPool pool(2u);
+  aslam::TaskGraph graph(&pool);
+  std::atomic<size_t> num_executions(0u);
+  aslam::TaskGraph::NodeId node = graph.addNode([&]() {
+    ++num_executions;
+    graph.cancel();
+  });
+  for (size_t i = 0u; i < 5u; ++i) {
+    node = graph.addNode([&num_executions]() { ++num_executions; }, {node});
+  }
+  EXPECT_FALSE(graph.run());
+  EXPECT_TRUE(graph.isCancelled());
+  EXPECT_EQ(1u, num_executions.load());
+  EXPECT_EQ(1u, graph.getNumExecutedNodes());
+}
+
+TEST(TaskGraphTests, ThrowingNodeSkipsItsDependents) {
+  aslam::ThreadPool pool(2u);
+  aslam::TaskGraph graph(&pool);
+  std::atomic<size_t> num_executions(0u);
+  const aslam::TaskGraph::NodeId root =
+      graph.addNode([]() { throw std::runtime_error("failure"); });
+  const aslam::TaskGraph::NodeId first = graph.addNode(
+      [&num_executions]() { ++num_executions; }, {root});
+  const aslam::TaskGraph::NodeId second = graph.addNode(
+      [&num_executions]() { ++num_executions; }, {root});
+  graph.addNode([&num_executions]() { ++num_executions; }, {first, second});
+  EXPECT_FALSE(graph.run());
+  EXPECT_TRUE(graph.isCancelled());
+  EXPECT_EQ(0u, num_executions.load());
+  EXPECT_EQ(0u, graph.getNumExecutedNodes());
+}
+
+TEST(TaskGraphTests, EmptyGraphCompletes) {
+  aslam::ThreadPool pool(1u);
+  aslam::TaskGraph graph(&pool);
+  EXPECT_TRUE(graph.run());
+  EXPECT_EQ(0u, graph.getNumExecutedNodes());
+}
+
+TEST(TaskGraphTests, CyclesAreRejected) {
+  aslam::ThreadPool pool(1u);
+  aslam::TaskGraph graph(&pool);
+  const aslam::TaskGraph::NodeId first = graph.addNode([]() {});
+  const aslam::TaskGraph::NodeId second = graph.addNode([]() {}, {first});
+  graph.addDependency(first, second);
+  EXPECT_DEATH(graph.start(), "cycle");
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -1,8 +1,22 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <aslam/common/entrypoint.h>
 #include <aslam/common/thread-pool.h>
 
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 int increment(int a){
   std::chrono::milliseconds dura(a);
   std::this_thread::sleep_for(dura);
@@ -81,4 +95,269 @@ TEST(ThreadPoolTests, ExecutionOrdering) {
   }
 }
 
+TEST(ThreadPoolTests, TasksEnqueuedFromTasks) {
+  constexpr size_t kNumThreads = 4u;
+  aslam::ThreadPool pool(kNumThreads);
+
+  constexpr size_t kNumOuterTasks = 100u;
+  constexpr size_t kNumInnerTasks = 50u;
+  std::atomic<size_t> num_executed_tasks(0u);
+  for (size_t i = 0u; i < kNumOuterTasks; ++i) {
+    pool.enqueue([&]() {
+      for (size_t j = 0u; j < kNumInnerTasks; ++j) {
+        pool.enqueue([&]() { ++num_executed_tasks; });
+      }
+      ++num_executed_tasks;
+    });
+  }
+  pool.waitForEmptyQueue();
+  EXPECT_EQ(num_executed_tasks, kNumOuterTasks * (kNumInnerTasks + 1u));
+  EXPECT_EQ(pool.numQueuedTasks(), 0u);
+}
+
+TEST(ThreadPoolTests, MixedExclusiveAndNonExclusiveTasks) {
+  constexpr size_t kNumThreads = 8u;
+  aslam::ThreadPool pool(kNumThreads);
+
+  constexpr size_t kNumGroups = 4u;
+  constexpr size_t kNumTasksPerGroup = 2000u;
+  std::vector<size_t> group_counters(kNumGroups, 0u);
+  std::vector<std::atomic<int>> num_active_group_tasks(kNumGroups);
+  for (std::atomic<int>& num_active : num_active_group_tasks) {
+    num_active = 0;
+  }
+  std::atomic<bool> exclusivity_violated(false);
+  std::atomic<size_t> num_nonexclusive_tasks(0u);
+
+  for (size_t number = 0u; number < kNumTasksPerGroup; ++number) {
+    for (size_t group_id = 0u; group_id < kNumGroups; ++group_id) {
+      pool.enqueueOrdered(group_id, [&, group_id, number]() {
+        if (++num_active_group_tasks[group_id] != 1) {
+          exclusivity_violated = true;
+        }
+        // The counter is not protected, the group exclusivity serializes the accesses.
+        if (group_counters[group_id] != number) {
+          exclusivity_violated = true;
+        }
+        ++group_counters[group_id];
+        --num_active_group_tasks[group_id];
+      });
+    }
+    pool.enqueue([&]() { ++num_nonexclusive_tasks; });
+  }
+  pool.waitForEmptyQueue();
+
+  EXPECT_FALSE(exclusivity_violated);
+  for (size_t group_id = 0u; group_id < kNumGroups; ++group_id) {
+    EXPECT_EQ(group_counters[group_id], kNumTasksPerGroup);
+  }
+  EXPECT_EQ(num_nonexclusive_tasks, kNumTasksPerGroup);
+}
+
+TEST(ThreadPoolTests, PriorityLanes) {
+  aslam::ThreadPool pool(1u);
+  // The wait time percentiles are only recorded with the metrics.
+  pool.setMetricsEnabled(true);
+  // Block the only worker until all tasks are queued.
+  std::promise<void> release_worker;
+  std::shared_future<void> worker_released(release_worker.get_future());
+  pool.enqueue([worker_released]() { worker_released.wait(); });
+
+  std::mutex order_mutex;
+  std::vector<int> order;
+  auto record = [&order_mutex, &order](int task_id) {
+    std::unique_lock<std::mutex> lock(order_mutex);
+    order.push_back(task_id);
+  };
+  typedef aslam::ThreadPool::Priority Priority;
+  pool.enqueueWithOptions(Priority::kBackground, record, 0);
+  pool.enqueueWithOptions(Priority::kBackground, record, 1);
+  pool.enqueue(record, 2);
+  pool.enqueueWithOptions(Priority::kHigh, record, 3);
+  pool.enqueueOrderedWithOptions(Priority::kHigh, 0u, record, 4);
+  pool.enqueueOrderedWithOptions(Priority::kHigh, 0u, record, 5);
+  // Overdue immediately, overtakes the normal lane but not the high lane.
+  pool.enqueueWithOptions(aslam::ThreadPool::TaskOptions(Priority::kBackground, 0), record, 6);
+  EXPECT_EQ(3u, pool.getStatistics(Priority::kBackground).num_queued_tasks);
+  EXPECT_EQ(3u, pool.getStatistics(Priority::kHigh).num_queued_tasks);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  release_worker.set_value();
+  pool.waitForEmptyQueue();
+  // The overdue task is promoted although tasks 0 and 1 were queued before it in its lane.
+  EXPECT_EQ(std::vector<int>({3, 4, 5, 6, 2, 0, 1}), order);
+
+  const aslam::ThreadPool::PriorityStatistics background_statistics =
+      pool.getStatistics(Priority::kBackground);
+  EXPECT_EQ(0u, background_statistics.num_queued_tasks);
+  EXPECT_EQ(3u, background_statistics.num_started_tasks);
+  EXPECT_EQ(1u, background_statistics.num_missed_deadlines);
+  EXPECT_GE(background_statistics.max_wait_nanoseconds, 1000000);
+  EXPECT_GE(background_statistics.p99_wait_nanoseconds, 1000000);
+  EXPECT_LE(background_statistics.p50_wait_nanoseconds,
+            background_statistics.p99_wait_nanoseconds);
+  EXPECT_EQ(3u, pool.getStatistics(Priority::kHigh).num_started_tasks);
+  EXPECT_EQ(2u, pool.getStatistics(Priority::kNormal).num_started_tasks);
+
+  pool.resetStatistics();
+  EXPECT_EQ(0u, pool.getStatistics(Priority::kBackground).num_started_tasks);
+  EXPECT_EQ(0, pool.getStatistics(Priority::kBackground).p99_wait_nanoseconds);
+}
+
+TEST(ThreadPoolTests, OverdueTasksAreNotStarved) {
+  aslam::ThreadPool pool(1u);
+  std::promise<void> release_worker;
+  std::shared_future<void> worker_released(release_worker.get_future());
+  pool.enqueue([worker_released]() { worker_released.wait(); });
+
+  std::atomic<bool> background_task_done(false);
+  std::atomic<size_t> num_normal_tasks_before(0u);
+  std::atomic<size_t> num_normal_tasks(0u);
+  pool.enqueueWithOptions(aslam::ThreadPool::TaskOptions(
+      aslam::ThreadPool::Priority::kBackground, 0), [&]() {
+    num_normal_tasks_before = num_normal_tasks.load();
+    background_task_done = true;
+  });
+  for (size_t i = 0u; i < 100u; ++i) {
+    pool.enqueue([&num_normal_tasks]() { ++num_normal_tasks; });
+  }
+  release_worker.set_value();
+  pool.waitForEmptyQueue();
+  EXPECT_TRUE(background_task_done);
+  EXPECT_EQ(0u, num_normal_tasks_before.load());
+}
+
+TEST(ThreadPoolTests, Metrics) {
+  constexpr size_t kNumThreads = 4u;
+  aslam::ThreadPool pool(kNumThreads);
+  EXPECT_FALSE(pool.areMetricsEnabled());
+  pool.enqueue([]() {});
+  pool.waitForEmptyQueue();
+  aslam::ThreadPool::Metrics metrics = pool.getMetrics();
+  ASSERT_EQ(kNumThreads, metrics.workers.size());
+  EXPECT_EQ(0u, metrics.wait_time_histogram.GetCount());
+  EXPECT_TRUE(metrics.execution_time_histograms.empty());
+
+  pool.setMetricsEnabled(true);
+  constexpr size_t kNumTasks = 200u;
+  constexpr size_t kGroupId = 3u;
+  for (size_t i = 0u; i < kNumTasks; ++i) {
+    pool.enqueue([]() { std::this_thread::sleep_for(std::chrono::microseconds(200)); });
+    pool.enqueueOrdered(kGroupId, []() {});
+  }
+  pool.waitForEmptyQueue();
+  metrics = pool.getMetrics();
+  size_t num_executed_tasks = 0u;
+  double busy_seconds = 0.0;
+  for (const aslam::ThreadPool::Metrics::Worker& worker : metrics.workers) {
+    num_executed_tasks += worker.num_executed_tasks;
+    busy_seconds += worker.busy_seconds;
+    EXPECT_GE(worker.idle_seconds, 0.0);
+  }
+  EXPECT_EQ(2u * kNumTasks, num_executed_tasks);
+  EXPECT_GE(busy_seconds, kNumTasks * 200e-6);
+  EXPECT_EQ(2u * kNumTasks, metrics.wait_time_histogram.GetCount());
+  ASSERT_EQ(2u, metrics.execution_time_histograms.size());
+  const statistics::LogHistogram& sleeping_tasks =
+      metrics.execution_time_histograms.at(aslam::ThreadPool::kGroupdIdNonExclusiveTask);
+  EXPECT_EQ(kNumTasks, sleeping_tasks.GetCount());
+  EXPECT_GE(sleeping_tasks.GetPercentile(0.5), 200e-6);
+  EXPECT_EQ(kNumTasks, metrics.execution_time_histograms.at(kGroupId).GetCount());
+
+  pool.resetMetrics();
+  metrics = pool.getMetrics();
+  EXPECT_EQ(0u, metrics.wait_time_histogram.GetCount());
+  EXPECT_TRUE(metrics.execution_time_histograms.empty());
+}
+
+TEST(ThreadPoolTests, StealCounts) {
+  aslam::ThreadPool pool(4u);
+  pool.setMetricsEnabled(true);
+  // All tasks are enqueued from one worker, hence the other workers have to steal them.
+  pool.enqueue([&pool]() {
+    for (size_t i = 0u; i < 100u; ++i) {
+      pool.enqueue([]() { std::this_thread::sleep_for(std::chrono::microseconds(100)); });
+    }
+  });
+  pool.waitForEmptyQueue();
+  size_t num_stolen_tasks = 0u;
+  for (const aslam::ThreadPool::Metrics::Worker& worker : pool.getMetrics().workers) {
+    num_stolen_tasks += worker.num_stolen_tasks;
+  }
+  EXPECT_GT(num_stolen_tasks, 0u);
+}
+
+TEST(ThreadPoolTests, ParkedWorkersDontRunTasks) {
+  aslam::ThreadPool pool(4u);
+  std::mutex mutex;
+  std::set<std::thread::id> thread_ids;
+  const auto record_thread = [&]() {
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    std::lock_guard<std::mutex> lock(mutex);
+    thread_ids.insert(std::this_thread::get_id());
+  };
+
+  pool.setNumActiveThreads(1u);
+  EXPECT_EQ(1u, pool.numActiveThreads());
+  for (size_t i = 0u; i < 50u; ++i) {
+    pool.enqueue(record_thread);
+  }
+  pool.waitForEmptyQueue();
+  EXPECT_EQ(1u, thread_ids.size());
+
+  // Tasks enqueued from the active worker are stolen by the unparked workers.
+  thread_ids.clear();
+  pool.setNumActiveThreads(4u);
+  pool.enqueue([&]() {
+    for (size_t i = 0u; i < 50u; ++i) {
+      pool.enqueue(record_thread);
+    }
+  });
+  pool.waitForEmptyQueue();
+  EXPECT_GT(thread_ids.size(), 1u);
+}
+
+TEST(ThreadPoolTests, ReservedGroupIdsAreUnique) {
+  const size_t first_group_id = aslam::ThreadPool::reserveExclusivityGroupId();
+  const size_t second_group_id = aslam::ThreadPool::reserveExclusivityGroupId();
+  EXPECT_NE(first_group_id, second_group_id);
+  EXPECT_NE(aslam::ThreadPool::kGroupdIdNonExclusiveTask, first_group_id);
+  EXPECT_GT(first_group_id, std::numeric_limits<uint32_t>::max());
+}
+
+#ifdef __linux__
+TEST(ThreadPoolTests, CpuAffinity) {
+  // Pin the workers to the first CPU this process may run on.
+  cpu_set_t allowed_cpus;
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(cpu_set_t), &allowed_cpus));
+  std::vector<size_t> allowed_cpu_ids;
+  for (size_t cpu_id = 0u; cpu_id < static_cast<size_t>(CPU_SETSIZE); ++cpu_id) {
+    if (CPU_ISSET(cpu_id, &allowed_cpus)) {
+      allowed_cpu_ids.push_back(cpu_id);
+    }
+  }
+  ASSERT_FALSE(allowed_cpu_ids.empty());
+  const size_t cpu_id = allowed_cpu_ids.front();
+  const size_t kNumThreads = 2u;
+  aslam::ThreadPool pool(kNumThreads);
+  EXPECT_EQ(allowed_cpu_ids, pool.getCpuAffinity());
+  EXPECT_TRUE(pool.setCpuAffinity({cpu_id}));
+  EXPECT_EQ(std::vector<size_t>{cpu_id}, pool.getCpuAffinity());
+
+  std::atomic<size_t> num_tasks_on_cpu(0u);
+  for (size_t i = 0u; i < 10u; ++i) {
+    pool.enqueue([&]() {
+      if (static_cast<size_t>(sched_getcpu()) == cpu_id) {
+        ++num_tasks_on_cpu;
+      }
+    });
+  }
+  pool.waitForEmptyQueue();
+  EXPECT_EQ(10u, num_tasks_on_cpu);
+
+  EXPECT_TRUE(pool.resetCpuAffinity());
+  EXPECT_EQ(allowed_cpu_ids, pool.getCpuAffinity());
+}
+#endif
+
 ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,184 @@
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/timer.h>
+#include <aslam/common/trace-recorder.h>
+
+using aslam::common::ScopedThreadTraceContext;
+using aslam::common::TraceEvent;
+using aslam::common::TraceRecorder;
+using aslam::common::TraceStage;
+
+TEST(TraceRecorderTests, DisabledRecorderDropsEvents) {
+  TraceRecorder recorder(10u);
+  recorder.record(TraceStage::kDetect, 0u, 1, 10, 20);
+  EXPECT_EQ(0u, recorder.getNumRecordedEvents());
+  EXPECT_TRUE(recorder.getEvents().empty());
+}
+
+TEST(TraceRecorderTests, RingBufferKeepsNewestEvents) {
+  TraceRecorder recorder(4u);
+  recorder.setEnabled(true);
+  for (int64_t i = 0; i < 6; ++i) {
+    recorder.record(TraceStage::kDetect, 0u, i, i, i + 1);
+  }
+  EXPECT_EQ(6u, recorder.getNumRecordedEvents());
+  const std::vector<TraceEvent> events = recorder.getEvents();
+  ASSERT_EQ(4u, events.size());
+  for (size_t i = 0u; i < events.size(); ++i) {
+    EXPECT_EQ(static_cast<int64_t>(i) + 2, events[i].frame_timestamp_nanoseconds);
+  }
+  recorder.clear();
+  EXPECT_TRUE(recorder.getEvents().empty());
+}
+
+TEST(TraceRecorderTests, StageSummaryPercentiles) {
+  TraceRecorder recorder(1000u);
+  recorder.setEnabled(true);
+  // Durations of 1..100ns for the detector, one long undistortion.
+  for (int64_t i = 1; i <= 100; ++i) {
+    recorder.record(TraceStage::kDetect, 0u, i, 0, i);
+  }
+  recorder.record(TraceStage::kUndistort, 1u, 0, 0, 1000);
+
+  const TraceRecorder::StageSummary detect = recorder.getStageSummary(TraceStage::kDetect);
+  EXPECT_EQ(100u, detect.num_events);
+  EXPECT_DOUBLE_EQ(50.5, detect.mean_nanoseconds);
+  EXPECT_DOUBLE_EQ(50.0, detect.p50_nanoseconds);
+  EXPECT_DOUBLE_EQ(99.0, detect.p99_nanoseconds);
+  EXPECT_DOUBLE_EQ(100.0, detect.max_nanoseconds);
+
+  const TraceRecorder::StageSummary undistort = recorder.getStageSummary(TraceStage::kUndistort);
+  EXPECT_EQ(1u, undistort.num_events);
+  EXPECT_DOUBLE_EQ(1000.0, undistort.p99_nanoseconds);
+  EXPECT_EQ(0u, recorder.getStageSummary(TraceStage::kConsume).num_events);
+}
+
+TEST(TraceRecorderTests, ChromeTraceExport) {
+  TraceRecorder recorder(10u);
+  recorder.setEnabled(true);
+  recorder.record(TraceStage::kDescribe, 2u, 42, 1000, 3000);
+  recorder.recordInstant(TraceStage::kConsume, 0u, 42);
+
+  std::ostringstream out;
+  recorder.exportChromeTraceJson(out);
+  const std::string json = out.str();
+  EXPECT_EQ(0u, json.find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, json.find("\"name\":\"describe\""));
+  EXPECT_NE(std::string::npos, json.find("\"ph\":\"X\""));
+  EXPECT_NE(std::string::npos, json.find("\"dur\":2.000"));
+  EXPECT_NE(std::string::npos, json.find("\"pid\":2"));
+  EXPECT_NE(std::string::npos, json.find("\"name\":\"consume\""));
+  EXPECT_NE(std::string::npos, json.find("\"ph\":\"i\""));
+  EXPECT_NE(std::string::npos, json.find("\"frame_timestamp_ns\":42"));
+}
+
+TEST(TraceRecorderTests, ConcurrentRecording) {
+  TraceRecorder recorder(100u);
+  recorder.setEnabled(true);
+  const size_t kNumThreads = 4u;
+  const size_t kNumEventsPerThread = 1000u;
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&recorder, thread_idx, kNumEventsPerThread]() {
+      for (size_t i = 0u; i < kNumEventsPerThread; ++i) {
+        recorder.recordInstant(TraceStage::kEnqueue, thread_idx, i);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(kNumThreads * kNumEventsPerThread, recorder.getNumRecordedEvents());
+  EXPECT_EQ(100u, recorder.getEvents().size());
+}
+
+TEST(TraceRecorderTests, ConcurrentReadsSkipIncompleteEvents) {
+  TraceRecorder recorder(16u);
+  recorder.setEnabled(true);
+  std::atomic<bool> is_recording(true);
+  std::thread writer([&recorder, &is_recording]() {
+    for (int64_t i = 0; i < 100000; ++i) {
+      recorder.record(TraceStage::kDetect, 1u, i, i, 2 * i);
+    }
+    is_recording = false;
+  });
+  while (is_recording) {
+    for (const TraceEvent& event : recorder.getEvents()) {
+      // A torn event would mix the fields of two events.
+      EXPECT_EQ(event.frame_timestamp_nanoseconds, event.start_nanoseconds);
+      EXPECT_EQ(2 * event.start_nanoseconds, event.end_nanoseconds);
+    }
+  }
+  writer.join();
+  EXPECT_EQ(16u, recorder.getEvents().size());
+}
+
+class TimerScopeTracingTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    TraceRecorder::instance().clear();
+    TraceRecorder::instance().setEnabled(true);
+    TraceRecorder::instance().setTimerScopesEnabled(true);
+  }
+  void TearDown() override {
+    TraceRecorder::instance().setEnabled(false);
+    TraceRecorder::instance().setTimerScopesEnabled(false);
+    TraceRecorder::instance().clear();
+  }
+};
+
+TEST_F(TimerScopeTracingTest, TimerScopesAreRecordedWithTheThreadContext) {
+  {
+    ScopedThreadTraceContext trace_context(3u, 42);
+    timing::TimerImpl timer("trace_outer");
+    timing::TimerImpl inner_timer("trace_inner");
+  }
+  // The context is restored, later scopes don't belong to the frame.
+  EXPECT_EQ(-1, TraceRecorder::getThreadFrameTimestamp());
+  EXPECT_EQ(0u, TraceRecorder::getThreadCameraIndex());
+
+  const std::vector<TraceEvent> events = TraceRecorder::instance().getEvents();
+  ASSERT_EQ(2u, events.size());
+  // Recorded when stopped, the inner scope first.
+  EXPECT_EQ("trace_inner", timing::Timing::GetTag(events[0].timer_handle));
+  EXPECT_EQ("trace_outer", timing::Timing::GetTag(events[1].timer_handle));
+  EXPECT_GE(events[0].start_nanoseconds, events[1].start_nanoseconds);
+  EXPECT_LE(events[0].end_nanoseconds, events[1].end_nanoseconds);
+  for (const TraceEvent& event : events) {
+    EXPECT_EQ(TraceStage::kTimer, event.stage);
+    EXPECT_EQ(3u, event.camera_index);
+    EXPECT_EQ(42, event.frame_timestamp_nanoseconds);
+  }
+  EXPECT_EQ(0u, TraceRecorder::instance().getStageSummary(TraceStage::kDetect).num_events);
+}
+
+TEST_F(TimerScopeTracingTest, TimerScopesCanBeDisabled) {
+  TraceRecorder::instance().setTimerScopesEnabled(false);
+  {
+    timing::TimerImpl timer("trace_disabled");
+  }
+  EXPECT_TRUE(TraceRecorder::instance().getEvents().empty());
+}
+
+TEST_F(TimerScopeTracingTest, ChromeTraceExportNamesTimerScopesAfterTheirTag) {
+  {
+    ScopedThreadTraceContext trace_context(1u, 7);
+    timing::TimerImpl timer("trace_\"quoted\"");
+  }
+  std::ostringstream out;
+  TraceRecorder::instance().exportChromeTraceJson(out);
+  const std::string json = out.str();
+  EXPECT_NE(std::string::npos, json.find("\"name\":\"trace_\\\"quoted\\\"\""));
+  EXPECT_NE(std::string::npos, json.find("\"cat\":\"timing\",\"ph\":\"X\""));
+  EXPECT_NE(std::string::npos, json.find("\"pid\":1"));
+  EXPECT_NE(std::string::npos, json.find("\"frame_timestamp_ns\":7"));
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
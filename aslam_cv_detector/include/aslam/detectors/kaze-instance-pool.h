@@ -0,0 +1,54 @@
+#ifndef ASLAM_CV_DETECTORS_KAZE_INSTANCE_POOL_H_
+#define ASLAM_CV_DETECTORS_KAZE_INSTANCE_POOL_H_
+
+#include <memory>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/object-pool.h>
+#include <kaze/KAZE.h>
+
+namespace aslam {
+
+/// \class KazeInstancePool
+/// \brief A pool of KAZE objects that are reused across images.
+///
+/// A KAZE object owns the buffers of its nonlinear scale space, which amount to several
+/// images per octave and sublevel, and must not be used concurrently. acquire() hands out an
+/// object for the exclusive use of the caller that returns to the pool once it is released, so
+/// a stream of images of the same size is processed without reallocating the scale space.
+/// Released objects beyond the pool capacity are deleted, such that the pool doesn't grow with
+/// the number of threads that ever processed an image.
+class KazeInstancePool {
+ public:
+  ASLAM_POINTER_TYPEDEFS(KazeInstancePool);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(KazeInstancePool);
+
+  /// \param[in] options Options of all instances, the image size is set per call.
+  /// \param[in] max_num_pooled_instances Number of released instances that are kept.
+  KazeInstancePool(const KAZEOptions& options, size_t max_num_pooled_instances);
+  ~KazeInstancePool();
+
+  /// \brief Get an instance prepared for images of the given size.
+  ///
+  /// The scale space is only reallocated if the instance was last used for another image size.
+  /// The instance returns to the pool once the last copy of the pointer is released, which may
+  /// happen after the pool is destroyed.
+  std::shared_ptr<libKAZE::KAZE> acquire(int image_width, int image_height);
+
+  /// Number of released instances that are ready for reuse.
+  size_t getNumPooledInstances() const;
+
+ private:
+  // The KAZE constructor needs the image size, hence the pool creates empty slots that get
+  // their object on the first acquire().
+  struct Instance {
+    std::unique_ptr<libKAZE::KAZE> kaze;
+  };
+
+  const KAZEOptions options_;
+  common::ObjectPool<Instance> instance_pool_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_CV_DETECTORS_KAZE_INSTANCE_POOL_H_
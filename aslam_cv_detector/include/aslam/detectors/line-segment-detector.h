@@ -2,6 +2,7 @@
 #define ASLAM_CV_DETECTORS_LSD
 
 #include <memory>
+#include <vector>
 
 #include <aslam/common/macros.h>
 #include <Eigen/Core>
@@ -10,6 +11,7 @@
 #include "aslam/detectors/line.h"
 
 namespace aslam {
+class ThreadPool;
 
 class LineSegmentDetector {
  public:
@@ -17,21 +19,50 @@ class LineSegmentDetector {
 
   struct Options {
     size_t min_segment_length_px;
+
+    /// Tiled mode: the image is split into square tiles of this size, which are processed in
+    /// parallel. Every tile is extended by tile_overlap_px on all sides, segments that cross a
+    /// tile border are merged afterwards. 0 detects on the whole image at once.
+    size_t tile_size_px;
+    size_t tile_overlap_px;
+    /// Number of threads of the tiled mode. 0 uses one thread per core.
+    size_t num_threads;
+
+    /// Segments of neighboring tiles are merged if they have the same orientation up to
+    /// this angle and if the endpoints of the shorter one are this close to the longer one.
+    double merge_max_angle_rad;
+    double merge_max_distance_px;
+
     Options() :
-      min_segment_length_px(20u) {};
+      min_segment_length_px(20u),
+      tile_size_px(0u),
+      tile_overlap_px(32u),
+      num_threads(0u),
+      merge_max_angle_rad(0.05),
+      merge_max_distance_px(2.0) {};
   };
 
   LineSegmentDetector(const Options& options);
   ~LineSegmentDetector();
 
+  /// Detect the segments of a grayscale image. Not thread-safe, the tiled mode runs on the
+  /// internal threads.
   void detect(const cv::Mat& image, Lines* lines);
 
   /// Draw a list of lines onto a color(!) image.
   void drawLines(const Lines& lines, cv::Mat* image);
 
  private:
+  void detectTiled(const cv::Mat& image, Lines* lines);
+
   cv::Ptr<aslamcv::LineSegmentDetector> line_detector_;
   const Options options_;
+
+  /// Tiled mode. Every thread owns a detector, which keeps its workspaces between the tiles
+  /// and frames. The first detector runs on the calling thread.
+  std::vector<cv::Ptr<aslamcv::LineSegmentDetector>> tile_detectors_;
+  std::unique_ptr<ThreadPool> thread_pool_;
+  std::vector<std::vector<cv::Vec4i>> tile_lines_;
 };
 
 }  // namespace aslam
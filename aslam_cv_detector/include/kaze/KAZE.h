@@ -39,16 +39,27 @@ namespace libKAZE {
     double descriptor;      ///< Descriptors computation time in ms
   };
 
+  class Descriptors_Invoker;
+  class Extremum_Invoker;
+  class KazeTest;
+
   /// KAZE Class Declaration
   class KAZE {
 
+    friend class Descriptors_Invoker;
+    friend class Extremum_Invoker;
+    /// The tests compare the parallel paths with the per-keypoint computations
+    friend class KazeTest;
+
   private:
 
     KAZEOptions options_;                ///< Configuration options for AKAZE
     std::vector<TEvolution> evolution_;	/// Vector for nonlinear diffusion evolution
 
-    /// Vector of keypoint vectors for finding extrema in multiple threads
+    /// Vector of keypoint vectors for finding extrema in multiple threads, one per block of rows
+    /// of a level. The capacities are kept for the next images
     std::vector<std::vector<cv::KeyPoint> > kpts_par_;
+    cv::Mat kpts_max_;    ///< Maxima of the neighbourhoods of a row, one row per block of rows
 
     /// FED parameters
     int ncycles_;                  ///< Number of cycles
@@ -58,6 +69,9 @@ namespace libKAZE {
 
     /// Some auxiliary variables used in the AOS step
     cv::Mat Ltx_, Lty_, px_, py_, ax_, ay_, bx_, by_, qr_, qc_;
+    cv::Mat mx_, my_;     ///< Diagonals of the LU decompositions of the column and row systems
+    cv::Mat Ldprevt_;     ///< Transposed image of the previous evolution step
+    cv::Mat Lstep_;       ///< Update of an explicit FED step
 
     /// Computation times variables in ms
     KAZETiming timing_;
@@ -75,6 +89,22 @@ namespace libKAZE {
     /// Allocates the memory for the nonlinear scale space
     void Allocate_Memory_Evolution();
 
+    /// Prepares the object for the next images, which have the size given in the options
+    /// @param options KAZE configuration options
+    /// @note The nonlinear scale space is only reallocated if the image size, the number of
+    /// octaves or sublevels, the scale offset or the diffusion scheme changed. Consecutive
+    /// images of the same size reuse all buffers. An object must not be used by several
+    /// threads at the same time
+    void Reset(const KAZEOptions& options);
+
+    /// Returns true if the allocated scale space fits the options
+    bool Has_Same_Layout(const KAZEOptions& options) const;
+
+    /// Returns the current configuration options
+    const KAZEOptions& Get_Options() const {
+      return options_;
+    }
+
     /// This method creates the nonlinear scale space for a given image
     /// @param img Input image for which the nonlinear scale space needs to be created
     /// @return 0 if the nonlinear scale space was created successfully. -1 otherwise
@@ -89,6 +119,16 @@ namespace libKAZE {
     /// @param desc Matrix with the feature descriptors
     void Compute_Descriptors(std::vector<cv::KeyPoint>& kpts, cv::Mat& desc);
 
+    /// Same as above, writes the descriptors to a caller-provided buffer
+    /// @param kpts Vector of keypoints, gets the orientations of rotation invariant descriptors
+    /// @param desc Buffer of kpts.size()*Get_Descriptor_Size() floats, descriptor i starts at
+    /// desc + i*Get_Descriptor_Size(). This is the layout of VisualFrame::FloatDescriptorsT
+    /// @note Blocks of keypoints are described in parallel
+    void Compute_Descriptors(std::vector<cv::KeyPoint>& kpts, float* desc);
+
+    /// Returns the number of floats of a descriptor of the configured type, 64 or 128
+    int Get_Descriptor_Size() const;
+
     /// This method saves the nonlinear scale space into jpg images for visualization or debugging purposes
     void Save_Scale_Space();
 
@@ -111,12 +151,15 @@ namespace libKAZE {
 
     /// This method performs the detection of keypoints by using the normalized score of the Hessian determinant
     /// @param kpts Vector of keypoints
-    /// @note We compute features for each of the nonlinear scale space level in a different processing thread
+    /// @note Blocks of rows of all nonlinear scale space levels are searched in parallel
     void Determinant_Hessian_Parallel(std::vector<cv::KeyPoint>& kpts);
 
-    /// This method is called by the thread which is responsible of finding extrema at a given nonlinear scale level
+    /// Finds the extrema in the rows [row_begin, row_end) of a nonlinear scale space level
     /// @param level Index in the nonlinear scale space evolution
-    void Find_Extremum_Threading(const int level);
+    /// @param kpts Vector the extrema are appended to, in row-major order
+    /// @param max_row Scratch buffer of img_width floats
+    void Find_Extremum_Rows(const int level, const int row_begin, const int row_end,
+                            std::vector<cv::KeyPoint>& kpts, float* max_row);
 
     /// This method performs subpixel refinement of the detected keypoints
     /// @param kpts Vector of detected keypoints
@@ -145,8 +188,14 @@ namespace libKAZE {
     void AOS_Columns(const cv::Mat& Ldprev, const cv::Mat& c, const float stepsize);
 
     /// This method does the Thomas algorithm for solving a tridiagonal linear system
+    /// @param m Scratch matrix, reallocated only if its size doesn't match a
     /// @note The matrix A must be strictly diagonally dominant for a stable solution
-    void Thomas(const cv::Mat& a, const cv::Mat& b, const cv::Mat& Ld, cv::Mat& x);
+    /// Every column of the matrices is an independent system, blocks of columns are solved in parallel
+    void Thomas(const cv::Mat& a, const cv::Mat& b, const cv::Mat& Ld, cv::Mat& m, cv::Mat& x);
+
+    /// Computes the orientation, if the descriptor is rotation invariant, and the descriptor of a
+    /// keypoint. Thread-safe for different keypoints
+    void Compute_Descriptor(cv::KeyPoint& kpt, float* desc);
 
     /// Compute the main orientation for a given keypoint
     /// @param kpt Input keypoint
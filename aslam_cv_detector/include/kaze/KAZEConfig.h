@@ -96,6 +96,7 @@ struct TEvolution {
   cv::Mat Lt;               ///< Evolution image
   cv::Mat Lsmooth;          ///< Smoothed image
   cv::Mat Ldet;             ///< Detector response
+  cv::Mat Lflow;            ///< Diffusivity of the evolution step
   float etime;              ///< Evolution time
   float esigma;             ///< Evolution sigma. For linear diffusion t = sigma^2 / 2
   int octave;               ///< Image octave
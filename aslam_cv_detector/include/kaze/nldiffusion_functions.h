@@ -78,6 +78,15 @@ void charbonnier_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst,
 float compute_k_percentile(const cv::Mat& img, float perc, float gscale,
                            size_t nbins, size_t ksize_x, size_t ksize_y);
 
+/// Same as above, with caller-provided buffers for the intermediate images
+/// @param gaussian Buffer for the smoothed image and the gradient magnitudes
+/// @param Lx Buffer for the image derivative in X-direction (horizontal)
+/// @param Ly Buffer for the image derivative in Y-direction (vertical)
+/// @note The buffers are only reallocated if their size doesn't match the image
+float compute_k_percentile(const cv::Mat& img, float perc, float gscale,
+                           size_t nbins, size_t ksize_x, size_t ksize_y,
+                           cv::Mat& gaussian, cv::Mat& Lx, cv::Mat& Ly);
+
 /// This function computes Scharr image derivatives
 /// @param src Input image
 /// @param dst Output image
@@ -158,6 +158,16 @@ public:
  */
     CV_WRAP virtual bool intersection(InputArray line1, InputArray line2, Point& P) = 0;
 
+/*
+ * Set the size of the image that the number of tests of the NFA is computed for.
+ * Detecting on tiles of a large image then applies the same detection threshold as
+ * detecting on the whole image.
+ *
+ * @param size          Size of the full image. An empty size, the default, uses the size
+ *                      of the image passed to detect.
+ */
+    virtual void setNfaImageSize(const Size& size) = 0;
+
     virtual ~LineSegmentDetector() {};
 };
 
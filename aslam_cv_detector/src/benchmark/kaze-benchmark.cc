@@ -0,0 +1,268 @@
+// Timing of the KAZE nonlinear diffusion kernels and of the complete detector on one image.
+//
+// The diffusivities and the contrast factor are compared against the scalar implementations
+// they replaced, which are kept here as a reference. The benchmark doubles as a regression
+// check: it returns 1 if a kernel disagrees with its reference.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <kaze/KAZE.h>
+#include <kaze/nldiffusion_functions.h>
+
+DEFINE_string(benchmark_image, "",
+              "Grayscale image to run on. A synthetic image is used if empty.");
+DEFINE_int32(benchmark_image_width, 752, "Width of the synthetic image.");
+DEFINE_int32(benchmark_image_height, 480, "Height of the synthetic image.");
+DEFINE_int32(benchmark_num_repetitions, 20, "Number of timed repetitions per kernel.");
+
+namespace {
+
+/// The kernels evaluate the same expressions in single instead of double precision.
+const float kDiffusivityTolerance = 1e-5f;
+const float kContrastTolerance = 1e-6f;
+
+/* ************************************************************************* */
+// Reference implementations, before the kernels were vectorized.
+void reference_pm_g2(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
+  cv::Size sz = Lx.size();
+  dst = cv::Mat::zeros(sz, CV_32F);
+  float inv_k = 1.0 / (k*k);
+  for (int y = 0; y < sz.height; y++) {
+    const float* Lx_row = Lx.ptr<float>(y);
+    const float* Ly_row = Ly.ptr<float>(y);
+    float* dst_row = dst.ptr<float>(y);
+    for (int x = 0; x < sz.width; x++)
+      dst_row[x] = 1.0 / (1.0+inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
+  }
+}
+
+void reference_weickert_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst,
+                                    const float k) {
+  cv::Size sz = Lx.size();
+  dst = cv::Mat::zeros(sz, CV_32F);
+  float inv_k = 1.0 / (k*k);
+  for (int y = 0; y < sz.height; y++) {
+    const float* Lx_row = Lx.ptr<float>(y);
+    const float* Ly_row = Ly.ptr<float>(y);
+    float* dst_row = dst.ptr<float>(y);
+    for (int x = 0; x < sz.width; x++) {
+      float dL = inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]);
+      dst_row[x] = -3.315/(dL*dL*dL*dL);
+    }
+  }
+  cv::exp(dst, dst);
+  dst = 1.0 - dst;
+}
+
+void reference_charbonnier_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst,
+                                       const float k) {
+  cv::Size sz = Lx.size();
+  dst = cv::Mat::zeros(sz, CV_32F);
+  float inv_k = 1.0 / (k*k);
+  for (int y = 0; y < sz.height; y++) {
+    const float* Lx_row = Lx.ptr<float>(y);
+    const float* Ly_row = Ly.ptr<float>(y);
+    float* dst_row = dst.ptr<float>(y);
+    for (int x = 0; x < sz.width; x++)
+      dst_row[x] = 1.0 / sqrt(1.0+inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
+  }
+}
+
+float reference_compute_k_percentile(const cv::Mat& img, float perc, float gscale,
+                                     size_t nbins) {
+  std::vector<float> hist(nbins, 0.0f);
+  cv::Mat gaussian = cv::Mat::zeros(img.rows, img.cols, CV_32F);
+  cv::Mat Lx = cv::Mat::zeros(img.rows, img.cols, CV_32F);
+  cv::Mat Ly = cv::Mat::zeros(img.rows, img.cols, CV_32F);
+  gaussian_2D_convolution(img, gaussian, 0, 0, gscale);
+  image_derivatives_scharr(gaussian, Lx, 1, 0);
+  image_derivatives_scharr(gaussian, Ly, 0, 1);
+
+  float hmax = 0.0f;
+  for (int y = 1; y < gaussian.rows-1; y++) {
+    for (int x = 1; x < gaussian.cols-1; x++) {
+      const float lx = Lx.at<float>(y, x);
+      const float ly = Ly.at<float>(y, x);
+      hmax = std::max(hmax, std::sqrt(lx*lx + ly*ly));
+    }
+  }
+  float npoints = 0.0f;
+  for (int y = 1; y < gaussian.rows-1; y++) {
+    for (int x = 1; x < gaussian.cols-1; x++) {
+      const float lx = Lx.at<float>(y, x);
+      const float ly = Ly.at<float>(y, x);
+      const float modg = std::sqrt(lx*lx + ly*ly);
+      if (modg != 0.0) {
+        size_t nbin = std::floor(nbins*(modg/hmax));
+        if (nbin == nbins) {
+          nbin--;
+        }
+        hist[nbin]++;
+        npoints++;
+      }
+    }
+  }
+  const size_t nthreshold = static_cast<size_t>(npoints*perc);
+  size_t nelements = 0, k = 0;
+  for (k = 0; nelements < nthreshold && k < nbins; k++)
+    nelements = nelements + hist[k];
+  return (nelements < nthreshold) ? 0.03f : hmax*(static_cast<float>(k)/nbins);
+}
+
+/* ************************************************************************* */
+double timeMs(const std::function<void()>& function) {
+  function();  // Warm up, allocates the output buffers.
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < FLAGS_benchmark_num_repetitions; ++i) {
+    function();
+  }
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count() / FLAGS_benchmark_num_repetitions;
+}
+
+void printRow(const std::string& name, double reference_ms, double ms, double error) {
+  std::cout << std::setw(24) << std::left << name << std::right << std::fixed
+            << std::setprecision(3) << std::setw(10) << reference_ms << " ms"
+            << std::setw(10) << ms << " ms" << std::setw(8) << std::setprecision(2)
+            << reference_ms / ms << "x" << std::scientific << std::setprecision(2)
+            << std::setw(12) << error << std::endl;
+}
+
+cv::Mat loadImage() {
+  cv::Mat image_8u;
+  if (!FLAGS_benchmark_image.empty()) {
+    image_8u = cv::imread(FLAGS_benchmark_image, cv::IMREAD_GRAYSCALE);
+    CHECK(!image_8u.empty()) << "Could not read " << FLAGS_benchmark_image;
+  } else {
+    CHECK_GT(FLAGS_benchmark_image_width, 0);
+    CHECK_GT(FLAGS_benchmark_image_height, 0);
+    // Smoothed noise has corners and edges at all scales.
+    image_8u.create(FLAGS_benchmark_image_height, FLAGS_benchmark_image_width, CV_8UC1);
+    cv::theRNG().state = 42;
+    cv::randu(image_8u, 0, 255);
+    cv::GaussianBlur(image_8u, image_8u, cv::Size(0, 0), 3.0);
+  }
+  cv::Mat image;
+  image_8u.convertTo(image, CV_32F, 1.0 / 255.0, 0);
+  return image;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  CHECK_GT(FLAGS_benchmark_num_repetitions, 0);
+
+  const cv::Mat image = loadImage();
+  cv::Mat smoothed, Lx, Ly;
+  gaussian_2D_convolution(image, smoothed, 0, 0, 1.0f);
+  cv::Scharr(smoothed, Lx, CV_32F, 1, 0, 1, 0, cv::BORDER_DEFAULT);
+  cv::Scharr(smoothed, Ly, CV_32F, 0, 1, 1, 0, cv::BORDER_DEFAULT);
+
+  KAZEOptions options;
+  options.img_width = image.cols;
+  options.img_height = image.rows;
+  const float kcontrast = compute_k_percentile(
+      image, options.kcontrast_percentile, options.sderivatives, options.kcontrast_nbins, 0, 0);
+
+  std::cout << "Image " << image.cols << "x" << image.rows << ", kcontrast " << kcontrast
+            << std::endl;
+  std::cout << std::setw(24) << std::left << "kernel" << std::right << std::setw(13)
+            << "before" << std::setw(13) << "after" << std::setw(9) << "speedup"
+            << std::setw(12) << "max. error" << std::endl;
+
+  typedef void (*Diffusivity)(const cv::Mat&, const cv::Mat&, cv::Mat&, const float);
+  struct DiffusivityKernel {
+    const char* name;
+    Diffusivity reference;
+    Diffusivity kernel;
+  };
+  const DiffusivityKernel kDiffusivities[] = {
+      {"pm_g2", &reference_pm_g2, &pm_g2},
+      {"weickert_diffusivity", &reference_weickert_diffusivity, &weickert_diffusivity},
+      {"charbonnier_diffusivity", &reference_charbonnier_diffusivity,
+       &charbonnier_diffusivity}};
+
+  bool all_agree = true;
+  for (const DiffusivityKernel& diffusivity : kDiffusivities) {
+    cv::Mat reference_dst, dst;
+    const double reference_ms = timeMs([&]() {
+      diffusivity.reference(Lx, Ly, reference_dst, kcontrast);
+    });
+    const double ms = timeMs([&]() { diffusivity.kernel(Lx, Ly, dst, kcontrast); });
+    const double error = cv::norm(reference_dst, dst, cv::NORM_INF);
+    printRow(diffusivity.name, reference_ms, ms, error);
+    if (!(error <= kDiffusivityTolerance)) {
+      LOG(ERROR) << diffusivity.name << " disagrees with the reference.";
+      all_agree = false;
+    }
+  }
+
+  float reference_kcontrast = 0.0f;
+  const double reference_percentile_ms = timeMs([&]() {
+    reference_kcontrast = reference_compute_k_percentile(
+        image, options.kcontrast_percentile, options.sderivatives, options.kcontrast_nbins);
+  });
+  cv::Mat gaussian, Lx_buffer, Ly_buffer;
+  float percentile_kcontrast = 0.0f;
+  const double percentile_ms = timeMs([&]() {
+    percentile_kcontrast = compute_k_percentile(
+        image, options.kcontrast_percentile, options.sderivatives, options.kcontrast_nbins, 0, 0,
+        gaussian, Lx_buffer, Ly_buffer);
+  });
+  const double percentile_error = std::abs(reference_kcontrast - percentile_kcontrast);
+  printRow("compute_k_percentile", reference_percentile_ms, percentile_ms, percentile_error);
+  if (!(percentile_error <= kContrastTolerance)) {
+    LOG(ERROR) << "compute_k_percentile disagrees with the reference.";
+    all_agree = false;
+  }
+
+  // The complete detector, reusing the allocated scale space.
+  libKAZE::KAZE kaze(options);
+  std::vector<cv::KeyPoint> keypoints;
+  libKAZE::KAZETiming timing;
+  const double detector_ms = timeMs([&]() {
+    kaze.Create_Nonlinear_Scale_Space(image);
+    keypoints.clear();
+    kaze.Feature_Detection(keypoints);
+    timing = kaze.Get_Computation_Times();
+  });
+  std::cout << std::endl << "KAZE detector: " << std::fixed << std::setprecision(2)
+            << detector_ms << " ms, " << keypoints.size() << " keypoints" << std::endl
+            << "  kcontrast   " << timing.kcontrast << " ms" << std::endl
+            << "  scale space " << timing.scale << " ms" << std::endl
+            << "  derivatives " << timing.derivatives << " ms" << std::endl
+            << "  detector    " << timing.detector << " ms" << std::endl;
+
+  // The descriptors are computed in parallel, all of them have to be normalized.
+  cv::Mat descriptors;
+  const double descriptor_ms = timeMs([&]() { kaze.Compute_Descriptors(keypoints, descriptors); });
+  std::cout << "KAZE descriptors: " << descriptor_ms << " ms, "
+            << (descriptor_ms / std::max<size_t>(keypoints.size(), 1u)) * 1e3
+            << " us per keypoint" << std::endl;
+  const double kDescriptorNormTolerance = 1e-4;
+  for (int i = 0; i < descriptors.rows; ++i) {
+    const double norm = cv::norm(descriptors.row(i), cv::NORM_L2);
+    if (!(std::abs(norm - 1.0) <= kDescriptorNormTolerance)) {
+      LOG(ERROR) << "Descriptor " << i << " has the norm " << norm << ".";
+      all_agree = false;
+      break;
+    }
+  }
+  return all_agree ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#include "aslam/detectors/kaze-instance-pool.h"
+
+#include <glog/logging.h>
+
+namespace aslam {
+
+KazeInstancePool::KazeInstancePool(
+    const KAZEOptions& options, size_t max_num_pooled_instances)
+    : options_(options),
+      instance_pool_(
+          max_num_pooled_instances, []() { return new Instance; },
+          common::ObjectPool<Instance>::Recycler()) {}
+
+KazeInstancePool::~KazeInstancePool() {}
+
+std::shared_ptr<libKAZE::KAZE> KazeInstancePool::acquire(int image_width, int image_height) {
+  CHECK_GT(image_width, 0);
+  CHECK_GT(image_height, 0);
+  KAZEOptions options = options_;
+  options.img_width = image_width;
+  options.img_height = image_height;
+
+  const std::shared_ptr<Instance> instance = instance_pool_.acquire();
+  if (!instance->kaze) {
+    instance->kaze.reset(new libKAZE::KAZE(options));
+  } else {
+    instance->kaze->Reset(options);
+  }
+  // Shares the ownership of the pooled slot, which returns to the pool with the last pointer.
+  return std::shared_ptr<libKAZE::KAZE>(instance, instance->kaze.get());
+}
+
+size_t KazeInstancePool::getNumPooledInstances() const {
+  return instance_pool_.numPooledObjects();
+}
+
+}  // namespace aslam
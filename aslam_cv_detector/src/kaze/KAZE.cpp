@@ -20,9 +20,171 @@
 
 #include "kaze/KAZE.h"
 
+#include <algorithm>
+
 using namespace std;
 using namespace libKAZE;
 
+/* ************************************************************************* */
+namespace {
+
+/// Number of tridiagonal systems that are solved together by one task. The systems are stored
+/// in the columns of the matrices, each sweep of the Thomas algorithm processes this many
+/// contiguous floats per row, which the compiler vectorizes.
+const int kThomasBlockCols = 64;
+
+/// Solves the tridiagonal systems in the columns [col_begin, col_end) of the matrices
+/// @param m Scratch matrix of the size of a for the diagonal of the LU decomposition
+/// @param x Solution, also holds the intermediate forward substitution
+void Thomas_Block(const cv::Mat& a, const cv::Mat& b, const cv::Mat& Ld, cv::Mat& m, cv::Mat& x,
+                  const int col_begin, const int col_end) {
+
+  const int n = a.rows;
+  std::copy(a.ptr<float>(0)+col_begin, a.ptr<float>(0)+col_end, m.ptr<float>(0)+col_begin);
+  std::copy(Ld.ptr<float>(0)+col_begin, Ld.ptr<float>(0)+col_end, x.ptr<float>(0)+col_begin);
+
+  // 1. Forward substitution L*y = d for y, y is stored in x
+  for (int k = 1; k < n; k++) {
+    const float* a_row = a.ptr<float>(k);
+    const float* b_row_m = b.ptr<float>(k-1);
+    const float* Ld_row = Ld.ptr<float>(k);
+    const float* m_row_m = m.ptr<float>(k-1);
+    const float* y_row_m = x.ptr<float>(k-1);
+    float* m_row = m.ptr<float>(k);
+    float* y_row = x.ptr<float>(k);
+    for (int j = col_begin; j < col_end; j++) {
+      const float l = b_row_m[j] / m_row_m[j];
+      m_row[j] = a_row[j] - l*b_row_m[j];
+      y_row[j] = Ld_row[j] - l*y_row_m[j];
+    }
+  }
+
+  // 2. Backward substitution U*x = y
+  float* x_row_last = x.ptr<float>(n-1);
+  const float* m_row_last = m.ptr<float>(n-1);
+  for (int j = col_begin; j < col_end; j++) {
+    x_row_last[j] = x_row_last[j] / m_row_last[j];
+  }
+
+  for (int i = n-2; i >= 0; i--) {
+    const float* b_row = b.ptr<float>(i);
+    const float* m_row = m.ptr<float>(i);
+    const float* x_row_p = x.ptr<float>(i+1);
+    float* x_row = x.ptr<float>(i);
+    for (int j = col_begin; j < col_end; j++) {
+      x_row[j] = (x_row[j] - b_row[j]*x_row_p[j]) / m_row[j];
+    }
+  }
+}
+
+/// Solves blocks of tridiagonal systems in parallel
+class Thomas_Invoker : public cv::ParallelLoopBody {
+
+public:
+  Thomas_Invoker(const cv::Mat& a, const cv::Mat& b, const cv::Mat& Ld, cv::Mat& m, cv::Mat& x)
+    : a_(a), b_(b), Ld_(Ld), m_(m), x_(x) {}
+
+  void operator()(const cv::Range& range) const {
+    Thomas_Block(a_, b_, Ld_, m_, x_, range.start*kThomasBlockCols,
+                 std::min(range.end*kThomasBlockCols, a_.cols));
+  }
+
+private:
+  const cv::Mat& a_;
+  const cv::Mat& b_;
+  const cv::Mat& Ld_;
+  cv::Mat& m_;
+  cv::Mat& x_;
+};
+
+/// Number of keypoints that are described together by one task
+const int kDescriptorBlockSize = 16;
+
+/// Number of rows of a level that are searched for extrema by one task
+const int kExtremumBlockRows = 32;
+
+/// Gaussian weights of the M-SURF descriptors, which only depend on the position of a sample
+/// within its subregion and on the subregion, the scale of the keypoint cancels out
+struct MSURF_Weights {
+  /// Weight of the sample (k, l) of the 9x9 samples of a subregion, sigma of 2.5 scales around
+  /// the sample (5, 5) of the subregion. Like the distances, it is independent of the rotation
+  float sample[9][9];
+  /// Weight of the subregion (i, j) of the 4x4 subregions, sigma of 1.5 subregions around the
+  /// center of the pattern
+  float subregion[4][4];
+};
+
+const MSURF_Weights& Get_MSURF_Weights() {
+  static const MSURF_Weights weights = []() {
+    MSURF_Weights w;
+    const float kSubregionCenter = 5.0f, kSampleSigma = 2.5f;
+    for (int k = 0; k < 9; k++) {
+      for (int l = 0; l < 9; l++) {
+        w.sample[k][l] = gaussian(kSubregionCenter-l, kSubregionCenter-k, kSampleSigma);
+      }
+    }
+    const float kPatternCenter = 2.0f, kSubregionSigma = 1.5f;
+    for (int i = 0; i < 4; i++) {
+      for (int j = 0; j < 4; j++) {
+        w.subregion[i][j] = gaussian(i+0.5f-kPatternCenter, j+0.5f-kPatternCenter,
+                                     kSubregionSigma);
+      }
+    }
+    return w;
+  }();
+  return weights;
+}
+
+}  // namespace
+
+/* ************************************************************************* */
+namespace libKAZE {
+
+/// Describes blocks of keypoints in parallel
+class Descriptors_Invoker : public cv::ParallelLoopBody {
+
+public:
+  Descriptors_Invoker(KAZE* kaze, std::vector<cv::KeyPoint>& kpts, float* desc)
+    : kaze_(kaze), kpts_(kpts), desc_(desc), dsize_(kaze->Get_Descriptor_Size()) {}
+
+  void operator()(const cv::Range& range) const {
+    const int end = std::min(range.end*kDescriptorBlockSize, (int)kpts_.size());
+    for (int i = range.start*kDescriptorBlockSize; i < end; i++)
+      kaze_->Compute_Descriptor(kpts_[i], desc_ + i*dsize_);
+  }
+
+private:
+  KAZE* kaze_;
+  std::vector<cv::KeyPoint>& kpts_;
+  float* desc_;
+  const int dsize_;
+};
+
+/// Searches blocks of rows of all levels for extrema in parallel, task i searches the block
+/// i % nblocks of the level i / nblocks + 1
+class Extremum_Invoker : public cv::ParallelLoopBody {
+
+public:
+  Extremum_Invoker(KAZE* kaze, const int nblocks) : kaze_(kaze), nblocks_(nblocks) {}
+
+  void operator()(const cv::Range& range) const {
+    for (int i = range.start; i < range.end; i++) {
+      const int level = i / nblocks_ + 1;
+      const int row_begin = std::max((i % nblocks_)*kExtremumBlockRows, 1);
+      const int row_end = std::min((i % nblocks_ + 1)*kExtremumBlockRows,
+                                   kaze_->options_.img_height-1);
+      kaze_->Find_Extremum_Rows(level, row_begin, row_end, kaze_->kpts_par_[i],
+                                kaze_->kpts_max_.ptr<float>(i));
+    }
+  }
+
+private:
+  KAZE* kaze_;
+  const int nblocks_;
+};
+
+}  // namespace libKAZE
+
 /* ************************************************************************* */
 KAZE::KAZE(KAZEOptions& options) : options_(options) {
 
@@ -45,6 +207,12 @@ void KAZE::Allocate_Memory_Evolution() {
 
   cv::Size size(options_.img_width, options_.img_height);
 
+  // Release a previous evolution, the method may be called again after a reset
+  evolution_.clear();
+  nsteps_.clear();
+  tsteps_.clear();
+  ncycles_ = 0;
+
   // Allocate the dimension of the matrices for the evolution
   for (int i = 0; i <= options_.omax-1; i++) {
     for (int j = 0; j <= options_.nsublevels-1; j++) {
@@ -58,6 +226,7 @@ void KAZE::Allocate_Memory_Evolution() {
       step.Lt.create(size, CV_32F);
       step.Lsmooth.create(size, CV_32F);
       step.Ldet.create(size, CV_32F);
+      step.Lflow.create(size, CV_32F);
       step.esigma = options_.soffset*pow((float)2.0,(float)(j)/(float)(options_.nsublevels) + i);
       step.etime = 0.5*(step.esigma*step.esigma);
       step.sigma_size = fRound(step.esigma);
@@ -79,22 +248,52 @@ void KAZE::Allocate_Memory_Evolution() {
       tsteps_.push_back(tau);
       ncycles_++;
     }
+    Lstep_.create(size, CV_32F);
   }
   // Allocate memory for the auxiliary variables that are used in the AOS scheme
   else {
-    Ltx_.create(size, CV_32F);
+    // The systems of the columns are solved on the transposed images
+    cv::Size tsize(options_.img_height, options_.img_width);
+    Ltx_.create(tsize, CV_32F);
     Lty_.create(size, CV_32F);
     px_.create(size, CV_32F);
     py_.create(size, CV_32F);
-    ax_.create(size, CV_32F);
+    ax_.create(tsize, CV_32F);
     ay_.create(size, CV_32F);
-    bx_ = cv::Mat::zeros(options_.img_height-1, options_.img_width, CV_32F);
+    mx_.create(tsize, CV_32F);
+    my_.create(size, CV_32F);
+    Ldprevt_.create(tsize, CV_32F);
+    bx_ = cv::Mat::zeros(options_.img_width-1, options_.img_height, CV_32F);
     by_ = cv::Mat::zeros(options_.img_height-1, options_.img_width, CV_32F);
     qr_ = cv::Mat::zeros(options_.img_height-1, options_.img_width, CV_32F);
     qc_ = cv::Mat::zeros(options_.img_height, options_.img_width-1, CV_32F);
   }
 }
 
+/* ************************************************************************* */
+/**
+ * @brief This method prepares the object for images with the given options
+ * @note The evolution is only reallocated if the image size or the layout of the
+ * scale space changed. All other options take effect immediately
+*/
+void KAZE::Reset(const KAZEOptions& options) {
+
+  const bool same_layout = Has_Same_Layout(options);
+  options_ = options;
+  timing_ = KAZETiming();
+  if (!same_layout)
+    Allocate_Memory_Evolution();
+}
+
+/* ************************************************************************* */
+bool KAZE::Has_Same_Layout(const KAZEOptions& options) const {
+
+  return !evolution_.empty() &&
+      options.img_width == options_.img_width && options.img_height == options_.img_height &&
+      options.omax == options_.omax && options.nsublevels == options_.nsublevels &&
+      options.soffset == options_.soffset && options.use_fed == options_.use_fed;
+}
+
 /* ************************************************************************* */
 int KAZE::Create_Nonlinear_Scale_Space(const cv::Mat& img) {
 
@@ -113,10 +312,6 @@ int KAZE::Create_Nonlinear_Scale_Space(const cv::Mat& img) {
   gaussian_2D_convolution(evolution_[0].Lt, evolution_[0].Lt, 0, 0, options_.soffset);
   gaussian_2D_convolution(evolution_[0].Lt, evolution_[0].Lsmooth, 0, 0, options_.sderivatives);
 
-  // Allocate memory for the flow and step images
-  cv::Mat Lflow = cv::Mat::zeros(evolution_[0].Lt.rows, evolution_[0].Lt.cols, CV_32F);
-  cv::Mat Lstep = cv::Mat::zeros(evolution_[0].Lt.rows, evolution_[0].Lt.cols, CV_32F);
-
   // Firstly compute the kcontrast factor
   Compute_KContrast(img);
 
@@ -139,6 +334,7 @@ int KAZE::Create_Nonlinear_Scale_Space(const cv::Mat& img) {
     cv::Scharr(evolution_[i].Lsmooth, evolution_[i].Ly, CV_32F, 0, 1, 1, 0, cv::BORDER_DEFAULT);
 
     // Compute the conductivity equation
+    cv::Mat& Lflow = evolution_[i].Lflow;
     switch (options_.diffusivity) {
       case PM_G1:
         pm_g1(evolution_[i].Lx, evolution_[i].Ly, Lflow, options_.kcontrast);
@@ -159,7 +355,7 @@ int KAZE::Create_Nonlinear_Scale_Space(const cv::Mat& img) {
     // Perform FED n inner steps
     if (options_.use_fed) {
       for (int j = 0; j < nsteps_[i-1]; j++)
-        nld_step_scalar(evolution_[i].Lt, Lflow, Lstep, tsteps_[i-1][j]);
+        nld_step_scalar(evolution_[i].Lt, Lflow, Lstep_, tsteps_[i-1][j]);
     }
     // Perform the evolution step with AOS
     else
@@ -184,8 +380,11 @@ void KAZE::Compute_KContrast(const cv::Mat& img) {
     cout << "Computing Kcontrast factor." << endl;
   }
 
+  // The derivative and detector images of the first level are only computed after the scale
+  // space, they serve as buffers here
   options_.kcontrast = compute_k_percentile(img,options_.kcontrast_percentile,
-                                            options_.sderivatives,options_.kcontrast_nbins,0,0);
+                                            options_.sderivatives,options_.kcontrast_nbins,0,0,
+                                            evolution_[0].Ldet,evolution_[0].Lx,evolution_[0].Ly);
 
   if (options_.verbosity == true) {
     cout << "kcontrast = " << options_.kcontrast << endl;
@@ -275,28 +474,23 @@ void KAZE::Determinant_Hessian_Parallel(std::vector<cv::KeyPoint>& kpts) {
   int left_x = 0, right_x = 0, up_y = 0, down_y = 0;
   bool is_extremum = false, is_repeated = false, is_out = false;
 
-  // Delete the memory of the vector of keypoints vectors
-  // In case we use the same kaze object for multiple images
+  // Empty the vector of keypoints vectors of the previous image
+  // The capacity is kept, the same kaze object is reused for multiple images
+  const int nlevels = evolution_.size() > 2 ? evolution_.size()-2 : 0;
+  const int nblocks = (options_.img_height + kExtremumBlockRows - 1) / kExtremumBlockRows;
+  kpts_par_.resize(nlevels*nblocks);
   for (size_t i = 0; i < kpts_par_.size(); i++)
-    vector<cv::KeyPoint>().swap(kpts_par_[i]);
+    kpts_par_[i].clear();
+  if (kpts_max_.rows < nlevels*nblocks || kpts_max_.cols != options_.img_width)
+    kpts_max_.create(nlevels*nblocks, options_.img_width, CV_32FC1);
 
-  kpts_par_.clear();
-  vector<cv::KeyPoint> aux;
-
-  // Allocate memory for the vector of vectors
-  for (size_t i = 1; i < evolution_.size()-1; i++)
-    kpts_par_.push_back(aux);
-
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-  for (size_t i = 1; i < evolution_.size()-1; i++)
-    Find_Extremum_Threading(i);
+  cv::parallel_for_(cv::Range(0, nlevels*nblocks), Extremum_Invoker(this, nblocks));
 
   // Now fill the vector of keypoints!!!
+  // The blocks are merged in the order of the levels and rows, like a sequential search
   for (size_t i = 0; i < kpts_par_.size(); i++) {
     for (size_t j = 0; j < kpts_par_[i].size(); j++) {
-      level = i+1;
+      level = i/nblocks+1;
       is_extremum = true;
       is_repeated = false;
       is_out = false;
@@ -351,48 +545,53 @@ void KAZE::Determinant_Hessian_Parallel(std::vector<cv::KeyPoint>& kpts) {
 }
 
 /* ************************************************************************* */
-void KAZE::Find_Extremum_Threading(const int level) {
+void KAZE::Find_Extremum_Rows(const int level, const int row_begin, const int row_end,
+                              std::vector<cv::KeyPoint>& kpts, float* max_row) {
 
-  float value = 0.0;
-  bool is_extremum = false;
+  const int width = options_.img_width;
 
-  for (int ix = 1; ix < options_.img_height-1; ix++) {
-    for (int jx = 1; jx < options_.img_width-1; jx++) {
+  for (int ix = row_begin; ix < row_end; ix++) {
 
-      is_extremum = false;
-      value = *(evolution_[level].Ldet.ptr<float>(ix)+jx);
+    // Maximum of the three rows around ix of the lower, the same and the upper scale. The
+    // loops run over contiguous floats, which the compiler vectorizes
+    const float* rows[9];
+    for (int k = 0; k < 3; k++) {
+      const cv::Mat& Ldet = evolution_[level-1+k].Ldet;
+      rows[3*k] = Ldet.ptr<float>(ix-1);
+      rows[3*k+1] = Ldet.ptr<float>(ix);
+      rows[3*k+2] = Ldet.ptr<float>(ix+1);
+    }
+    for (int jx = 0; jx < width; jx++) {
+      float m = rows[0][jx];
+      for (int k = 1; k < 9; k++)
+        m = std::max(m, rows[k][jx]);
+      max_row[jx] = m;
+    }
 
+    // A point is an extremum if no value of its 3x3x3 neighbourhood is larger, the
+    // neighbourhood includes the point, so its maximum is the value of the point
+    const float* Ldet_row = evolution_[level].Ldet.ptr<float>(ix);
+    for (int jx = 1; jx < width-1; jx++) {
+      const float value = Ldet_row[jx];
       // Filter the points with the detector threshold
-      if (value > options_.dthreshold && value >= 0.00001) {
-        if (value >= *(evolution_[level].Ldet.ptr<float>(ix)+jx-1)) {
-          // First check on the same scale
-          if (check_maximum_neighbourhood(evolution_[level].Ldet,1,value,ix,jx,1)) {
-            // Now check on the lower scale
-            if (check_maximum_neighbourhood(evolution_[level-1].Ldet,1,value,ix,jx,0)) {
-              // Now check on the upper scale
-              if (check_maximum_neighbourhood(evolution_[level+1].Ldet,1,value,ix,jx,0)) {
-                is_extremum = true;
-              }
-            }
-          }
-        }
-      }
+      if (!(value > options_.dthreshold && value >= 0.00001f))
+        continue;
+      if (value < std::max(std::max(max_row[jx-1], max_row[jx]), max_row[jx+1]))
+        continue;
 
       // Add the point of interest!!
-      if (is_extremum == true) {
-        cv::KeyPoint point;
-        point.pt.x = jx;
-        point.pt.y = ix;
-        point.response = fabs(value);
-        point.size = evolution_[level].esigma;
-        point.octave = evolution_[level].octave;
-        point.class_id = level;
-
-        // We use the angle field for the sublevel value
-        // Then, we will replace this angle field with the main orientation
-        point.angle = evolution_[level].sublevel;
-        kpts_par_[level-1].push_back(point);
-      }
+      cv::KeyPoint point;
+      point.pt.x = jx;
+      point.pt.y = ix;
+      point.response = fabs(value);
+      point.size = evolution_[level].esigma;
+      point.octave = evolution_[level].octave;
+      point.class_id = level;
+
+      // We use the angle field for the sublevel value
+      // Then, we will replace this angle field with the main orientation
+      point.angle = evolution_[level].sublevel;
+      kpts.push_back(point);
     }
   }
 }
@@ -497,150 +696,89 @@ void KAZE::Do_Subpixel_Refinement(std::vector<cv::KeyPoint>& kpts) {
 /* ************************************************************************* */
 void KAZE::Compute_Descriptors(std::vector<cv::KeyPoint> &kpts, cv::Mat &desc) {
 
+  // Allocate memory for the matrix of descriptors
+  desc = cv::Mat::zeros(kpts.size(), Get_Descriptor_Size(), CV_32FC1);
+  if (!kpts.empty())
+    Compute_Descriptors(kpts, desc.ptr<float>(0));
+}
+
+/* ************************************************************************* */
+void KAZE::Compute_Descriptors(std::vector<cv::KeyPoint> &kpts, float* desc) {
+
   double t2 = 0.0, t1 = 0.0;
   t1 = cv::getTickCount();
 
-  // Allocate memory for the matrix of descriptors
+  // Every descriptor only reads the scale space and writes its own keypoint and row
+  const int nblocks = (kpts.size() + kDescriptorBlockSize - 1) / kDescriptorBlockSize;
+  cv::parallel_for_(cv::Range(0, nblocks), Descriptors_Invoker(this, kpts, desc));
+
+  t2 = cv::getTickCount();
+  timing_.descriptor = 1000.0*(t2-t1) / cv::getTickFrequency();
+}
+
+/* ************************************************************************* */
+int KAZE::Get_Descriptor_Size() const {
+
   if (options_.descriptor == SURF_EXTENDED ||
       options_.descriptor == SURF_EXTENDED_UPRIGHT ||
       options_.descriptor == MSURF_EXTENDED ||
       options_.descriptor == MSURF_EXTENDED_UPRIGHT ||
       options_.descriptor == GSURF_EXTENDED ||
       options_.descriptor == GSURF_EXTENDED_UPRIGHT) {
-    desc = cv::Mat::zeros(kpts.size(), 128, CV_32FC1);
-  }
-  else {
-    desc = cv::Mat::zeros(kpts.size(), 64, CV_32FC1);
+    return 128;
   }
+  return 64;
+}
 
-  switch (options_.descriptor) {
+/* ************************************************************************* */
+void KAZE::Compute_Descriptor(cv::KeyPoint& kpt, float* desc) {
 
+  switch (options_.descriptor) {
     case SURF_UPRIGHT :
-    {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++)
-        Get_SURF_Upright_Descriptor_64(kpts[i],desc.ptr<float>(i));
-    }
-    break;
+      Get_SURF_Upright_Descriptor_64(kpt, desc);
+      break;
     case SURF :
-    {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
-        Compute_Main_Orientation(kpts[i]);
-        Get_SURF_Descriptor_64(kpts[i],desc.ptr<float>(i));
-      }
-    }
-    break;
+      Compute_Main_Orientation(kpt);
+      Get_SURF_Descriptor_64(kpt, desc);
+      break;
     case SURF_EXTENDED :
-    {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
-        Compute_Main_Orientation(kpts[i]);
-        Get_SURF_Descriptor_128(kpts[i],desc.ptr<float>(i));
-      }
-    }
-    break;
+      Compute_Main_Orientation(kpt);
+      Get_SURF_Descriptor_128(kpt, desc);
+      break;
     case SURF_EXTENDED_UPRIGHT :
-    {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++)
-        Get_SURF_Upright_Descriptor_128(kpts[i],desc.ptr<float>(i));
-    }
-    break;
+      Get_SURF_Upright_Descriptor_128(kpt, desc);
+      break;
 
     case MSURF_UPRIGHT :
-    {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++)
-        Get_MSURF_Upright_Descriptor_64(kpts[i],desc.ptr<float>(i));
-    }
-    break;
+      Get_MSURF_Upright_Descriptor_64(kpt, desc);
+      break;
     case MSURF :
-    {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
-        Compute_Main_Orientation(kpts[i]);
-        Get_MSURF_Descriptor_64(kpts[i],desc.ptr<float>(i));
-      }
-    }
-    break;
+      Compute_Main_Orientation(kpt);
+      Get_MSURF_Descriptor_64(kpt, desc);
+      break;
     case MSURF_EXTENDED :
-    {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
-        Compute_Main_Orientation(kpts[i]);
-        Get_MSURF_Descriptor_128(kpts[i],desc.ptr<float>(i));
-      }
-    }
-    break;
+      Compute_Main_Orientation(kpt);
+      Get_MSURF_Descriptor_128(kpt, desc);
+      break;
     case MSURF_EXTENDED_UPRIGHT :
-    {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++)
-        Get_MSURF_Upright_Descriptor_128(kpts[i],desc.ptr<float>(i));
-    }
-    break;
+      Get_MSURF_Upright_Descriptor_128(kpt, desc);
+      break;
 
     case GSURF_UPRIGHT :
-    {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++)
-        Get_GSURF_Upright_Descriptor_64(kpts[i],desc.ptr<float>(i));
-    }
-    break;
+      Get_GSURF_Upright_Descriptor_64(kpt, desc);
+      break;
     case GSURF :
-    {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
-        Compute_Main_Orientation(kpts[i]);
-        Get_GSURF_Descriptor_64(kpts[i],desc.ptr<float>(i));
-      }
-    }
-    break;
+      Compute_Main_Orientation(kpt);
+      Get_GSURF_Descriptor_64(kpt, desc);
+      break;
     case GSURF_EXTENDED :
-    {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++) {
-        Compute_Main_Orientation(kpts[i]);
-        Get_GSURF_Descriptor_128(kpts[i],desc.ptr<float>(i));
-      }
-    }
-    break;
+      Compute_Main_Orientation(kpt);
+      Get_GSURF_Descriptor_128(kpt, desc);
+      break;
     case GSURF_EXTENDED_UPRIGHT :
-    {
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-      for (int i = 0; i < (int)(kpts.size()); i++)
-        Get_GSURF_Upright_Descriptor_128(kpts[i],desc.ptr<float>(i));
-    }
-    break;
+      Get_GSURF_Upright_Descriptor_128(kpt, desc);
+      break;
   }
-
-  t2 = cv::getTickCount();
-  timing_.descriptor = 1000.0*(t2-t1) / cv::getTickFrequency();
 }
 
 /* ************************************************************************* */
@@ -648,7 +786,9 @@ void KAZE::Compute_Main_Orientation(cv::KeyPoint& kpt) {
 
   int ix = 0, iy = 0, idx = 0, s = 0, level = 0;
   float xf = 0.0, yf = 0.0, gweight = 0.0;
-  vector<float> resX(109), resY(109), Ang(109);
+  // The 109 samples within the radius, on the stack as every keypoint needs them
+  const int kNumSamples = 109;
+  float resX[kNumSamples], resY[kNumSamples], Ang[kNumSamples];
 
   // Variables for computing the dominant direction
   float sumX = 0.0, sumY = 0.0, max = 0.0, ang1 = 0.0, ang2 = 0.0;
@@ -687,7 +827,7 @@ void KAZE::Compute_Main_Orientation(cv::KeyPoint& kpt) {
     ang2 =(ang1+CV_PI/3.0f > 2.0*CV_PI ? ang1-5.0f*CV_PI/3.0f : ang1+CV_PI/3.0f);
     sumX = sumY = 0.f;
 
-    for (size_t k = 0; k < Ang.size(); ++k) {
+    for (int k = 0; k < kNumSamples; ++k) {
       // Get angle from the x-axis of the sample point
       const float& ang = Ang[k];
 
@@ -889,20 +1029,21 @@ void KAZE::Get_SURF_Descriptor_64(const cv::KeyPoint &kpt, float *desc) {
 /* ************************************************************************* */
 void KAZE::Get_MSURF_Upright_Descriptor_64(const cv::KeyPoint& kpt, float* desc) {
 
+  const MSURF_Weights& weights = Get_MSURF_Weights();
+
   float dx = 0.0, dy = 0.0, mdx = 0.0, mdy = 0.0, gauss_s1 = 0.0, gauss_s2 = 0.0;
-  float rx = 0.0, ry = 0.0, len = 0.0, xf = 0.0, yf = 0.0, ys = 0.0, xs = 0.0;
+  float rx = 0.0, ry = 0.0, len = 0.0, xf = 0.0, yf = 0.0;
   float sample_x = 0.0, sample_y = 0.0;
-  int x1 = 0, y1 = 0, sample_step = 0, pattern_size = 0;
-  int x2 = 0, y2 = 0, kx = 0, ky = 0, i = 0, j = 0, dcount = 0;
+  int x1 = 0, y1 = 0, pattern_size = 0;
+  int x2 = 0, y2 = 0, i = 0, j = 0, dcount = 0;
   float fx = 0.0, fy = 0.0, res1 = 0.0, res2 = 0.0, res3 = 0.0, res4 = 0.0;
   int dsize = 0, scale = 0, level = 0;
 
   // Subregion centers for the 4x4 gaussian weighting
   float cx = -0.5, cy = 0.5;
 
-  // Set the descriptor size and the sample and pattern sizes
+  // Set the descriptor size and the pattern size
   dsize = 64;
-  sample_step = 5;
   pattern_size = 12;
 
   // Get the information from the keypoint
@@ -928,12 +1069,6 @@ void KAZE::Get_MSURF_Upright_Descriptor_64(const cv::KeyPoint& kpt, float* desc)
       cy += 1.0;
       j = j-4;
 
-      ky = i + sample_step;
-      kx = j + sample_step;
-
-      ys = yf + (ky*scale);
-      xs = xf + (kx*scale);
-
       for (int k = i; k < i+9; k++) {
         for (int l = j; l < j+9; l++) {
 
@@ -941,7 +1076,7 @@ void KAZE::Get_MSURF_Upright_Descriptor_64(const cv::KeyPoint& kpt, float* desc)
           sample_x = l*scale + xf;
 
           //Get the gaussian weighted x and y responses
-          gauss_s1 = gaussian(xs-sample_x,ys-sample_y,2.5*scale);
+          gauss_s1 = weights.sample[k-i][l-j];
 
           y1 = (int)(sample_y-.5);
           x1 = (int)(sample_x-.5);
@@ -980,7 +1115,7 @@ void KAZE::Get_MSURF_Upright_Descriptor_64(const cv::KeyPoint& kpt, float* desc)
       }
 
       // Add the values to the descriptor vector
-      gauss_s2 = gaussian(cx-2.0f,cy-2.0f,1.5f);
+      gauss_s2 = weights.subregion[(int)cx][(int)cy];
 
       desc[dcount++] = dx*gauss_s2;
       desc[dcount++] = dy*gauss_s2;
@@ -1005,20 +1140,21 @@ void KAZE::Get_MSURF_Upright_Descriptor_64(const cv::KeyPoint& kpt, float* desc)
 /* ************************************************************************* */
 void KAZE::Get_MSURF_Descriptor_64(const cv::KeyPoint& kpt, float* desc) {
 
+  const MSURF_Weights& weights = Get_MSURF_Weights();
+
   float dx = 0.0, dy = 0.0, mdx = 0.0, mdy = 0.0, gauss_s1 = 0.0, gauss_s2 = 0.0;
-  float rx = 0.0, ry = 0.0, rrx = 0.0, rry = 0.0, len = 0.0, xf = 0.0, yf = 0.0, ys = 0.0, xs = 0.0;
+  float rx = 0.0, ry = 0.0, rrx = 0.0, rry = 0.0, len = 0.0, xf = 0.0, yf = 0.0;
   float sample_x = 0.0, sample_y = 0.0, co = 0.0, si = 0.0, angle = 0.0;
   float fx = 0.0, fy = 0.0, res1 = 0.0, res2 = 0.0, res3 = 0.0, res4 = 0.0;
-  int x1 = 0, y1 = 0, x2 = 0, y2 = 0, sample_step = 0, pattern_size = 0;
-  int kx = 0, ky = 0, i = 0, j = 0, dcount = 0;
+  int x1 = 0, y1 = 0, x2 = 0, y2 = 0, pattern_size = 0;
+  int i = 0, j = 0, dcount = 0;
   int dsize = 0, scale = 0, level = 0;
 
   // Subregion centers for the 4x4 gaussian weighting
   float cx = -0.5, cy = 0.5;
 
-  // Set the descriptor size and the sample and pattern sizes
+  // Set the descriptor size and the pattern size
   dsize = 64;
-  sample_step = 5;
   pattern_size = 12;
 
   // Get the information from the keypoint
@@ -1048,12 +1184,6 @@ void KAZE::Get_MSURF_Descriptor_64(const cv::KeyPoint& kpt, float* desc) {
       cy += 1.0;
       j = j - 4;
 
-      ky = i + sample_step;
-      kx = j + sample_step;
-
-      xs = xf + (-kx*scale*si + ky*scale*co);
-      ys = yf + (kx*scale*co + ky*scale*si);
-
       for (int k = i; k < i + 9; ++k) {
         for (int l = j; l < j + 9; ++l) {
 
@@ -1062,7 +1192,7 @@ void KAZE::Get_MSURF_Descriptor_64(const cv::KeyPoint& kpt, float* desc) {
           sample_x = xf + (-l*scale*si + k*scale*co);
 
           // Get the gaussian weighted x and y responses
-          gauss_s1 = gaussian(xs-sample_x,ys-sample_y,2.5*scale);
+          gauss_s1 = weights.sample[k-i][l-j];
           y1 = fRound(sample_y-.5);
           x1 = fRound(sample_x-.5);
 
@@ -1101,7 +1231,7 @@ void KAZE::Get_MSURF_Descriptor_64(const cv::KeyPoint& kpt, float* desc) {
       }
 
       // Add the values to the descriptor vector
-      gauss_s2 = gaussian(cx-2.0f,cy-2.0f,1.5f);
+      gauss_s2 = weights.subregion[(int)cx][(int)cy];
       desc[dcount++] = dx*gauss_s2;
       desc[dcount++] = dy*gauss_s2;
       desc[dcount++] = mdx*gauss_s2;
@@ -1578,11 +1708,13 @@ void KAZE::Get_SURF_Descriptor_128(const cv::KeyPoint& kpt, float* desc) {
 /* ************************************************************************* */
 void KAZE::Get_MSURF_Upright_Descriptor_128(const cv::KeyPoint& kpt, float* desc) {
 
+  const MSURF_Weights& weights = Get_MSURF_Weights();
+
   float gauss_s1 = 0.0, gauss_s2 = 0.0;
-  float rx = 0.0, ry = 0.0, len = 0.0, xf = 0.0, yf = 0.0, ys = 0.0, xs = 0.0;
+  float rx = 0.0, ry = 0.0, len = 0.0, xf = 0.0, yf = 0.0;
   float sample_x = 0.0, sample_y = 0.0;
-  int x1 = 0, y1 = 0, sample_step = 0, pattern_size = 0;
-  int x2 = 0, y2 = 0, kx = 0, ky = 0, i = 0, j = 0, dcount = 0;
+  int x1 = 0, y1 = 0, pattern_size = 0;
+  int x2 = 0, y2 = 0, i = 0, j = 0, dcount = 0;
   float fx = 0.0, fy = 0.0, res1 = 0.0, res2 = 0.0, res3 = 0.0, res4 = 0.0;
   float dxp = 0.0, dyp = 0.0, mdxp = 0.0, mdyp = 0.0;
   float dxn = 0.0, dyn = 0.0, mdxn = 0.0, mdyn = 0.0;
@@ -1591,9 +1723,8 @@ void KAZE::Get_MSURF_Upright_Descriptor_128(const cv::KeyPoint& kpt, float* desc
   // Subregion centers for the 4x4 gaussian weighting
   float cx = -0.5, cy = 0.5;
 
-  // Set the descriptor size and the sample and pattern sizes
+  // Set the descriptor size and the pattern size
   dsize = 128;
-  sample_step = 5;
   pattern_size = 12;
 
   // Get the information from the keypoint
@@ -1622,12 +1753,6 @@ void KAZE::Get_MSURF_Upright_Descriptor_128(const cv::KeyPoint& kpt, float* desc
       cy += 1.0;
       j = j-4;
 
-      ky = i + sample_step;
-      kx = j + sample_step;
-
-      ys = yf + (ky*scale);
-      xs = xf + (kx*scale);
-
       for (int k = i; k < i+9; k++) {
         for (int l = j; l < j+9; l++) {
 
@@ -1635,7 +1760,7 @@ void KAZE::Get_MSURF_Upright_Descriptor_128(const cv::KeyPoint& kpt, float* desc
           sample_x = l*scale + xf;
 
           //Get the gaussian weighted x and y responses
-          gauss_s1 = gaussian(xs-sample_x,ys-sample_y,2.50*scale);
+          gauss_s1 = weights.sample[k-i][l-j];
 
           y1 = (int)(sample_y-.5);
           x1 = (int)(sample_x-.5);
@@ -1687,7 +1812,7 @@ void KAZE::Get_MSURF_Upright_Descriptor_128(const cv::KeyPoint& kpt, float* desc
       }
 
       // Add the values to the descriptor vector
-      gauss_s2 = gaussian(cx-2.0f,cy-2.0f,1.5f);
+      gauss_s2 = weights.subregion[(int)cx][(int)cy];
 
       desc[dcount++] = dxp*gauss_s2;
       desc[dcount++] = dxn*gauss_s2;
@@ -1718,22 +1843,23 @@ void KAZE::Get_MSURF_Upright_Descriptor_128(const cv::KeyPoint& kpt, float* desc
 /* ************************************************************************* */
 void KAZE::Get_MSURF_Descriptor_128(const cv::KeyPoint& kpt, float* desc) {
 
+  const MSURF_Weights& weights = Get_MSURF_Weights();
+
   float gauss_s1 = 0.0, gauss_s2 = 0.0;
-  float rx = 0.0, ry = 0.0, rrx = 0.0, rry = 0.0, len = 0.0, xf = 0.0, yf = 0.0, ys = 0.0, xs = 0.0;
+  float rx = 0.0, ry = 0.0, rrx = 0.0, rry = 0.0, len = 0.0, xf = 0.0, yf = 0.0;
   float sample_x = 0.0, sample_y = 0.0, co = 0.0, si = 0.0, angle = 0.0;
   float fx = 0.0, fy = 0.0, res1 = 0.0, res2 = 0.0, res3 = 0.0, res4 = 0.0;
   float dxp = 0.0, dyp = 0.0, mdxp = 0.0, mdyp = 0.0;
   float dxn = 0.0, dyn = 0.0, mdxn = 0.0, mdyn = 0.0;
-  int x1 = 0, y1 = 0, x2 = 0, y2 = 0, sample_step = 0, pattern_size = 0;
-  int kx = 0, ky = 0, i = 0, j = 0, dcount = 0;
+  int x1 = 0, y1 = 0, x2 = 0, y2 = 0, pattern_size = 0;
+  int i = 0, j = 0, dcount = 0;
   int dsize = 0, scale = 0, level = 0;
 
   // Subregion centers for the 4x4 gaussian weighting
   float cx = -0.5, cy = 0.5;
 
-  // Set the descriptor size and the sample and pattern sizes
+  // Set the descriptor size and the pattern size
   dsize = 128;
-  sample_step = 5;
   pattern_size = 12;
 
   // Get the information from the keypoint
@@ -1765,12 +1891,6 @@ void KAZE::Get_MSURF_Descriptor_128(const cv::KeyPoint& kpt, float* desc) {
       cy += 1.0f;
       j = j - 4;
 
-      ky = i + sample_step;
-      kx = j + sample_step;
-
-      xs = xf + (-kx*scale*si + ky*scale*co);
-      ys = yf + (kx*scale*co + ky*scale*si);
-
       for (int k = i; k < i + 9; ++k) {
         for (int l = j; l < j + 9; ++l) {
 
@@ -1779,7 +1899,7 @@ void KAZE::Get_MSURF_Descriptor_128(const cv::KeyPoint& kpt, float* desc) {
           sample_x = xf + (-l*scale*si + k*scale*co);
 
           // Get the gaussian weighted x and y responses
-          gauss_s1 = gaussian(xs-sample_x,ys-sample_y,2.5*scale);
+          gauss_s1 = weights.sample[k-i][l-j];
 
           y1 = fRound(sample_y-.5);
           x1 = fRound(sample_x-.5);
@@ -1832,7 +1952,7 @@ void KAZE::Get_MSURF_Descriptor_128(const cv::KeyPoint& kpt, float* desc) {
       }
 
       // Add the values to the descriptor vector
-      gauss_s2 = gaussian(cx-2.0f,cy-2.0f,1.5f);
+      gauss_s2 = weights.subregion[(int)cx][(int)cy];
 
       desc[dcount++] = dxp*gauss_s2;
       desc[dcount++] = dxn*gauss_s2;
@@ -2142,22 +2262,9 @@ void KAZE::Get_GSURF_Descriptor_128(const cv::KeyPoint& kpt, float* desc) {
 /* ************************************************************************* */
 void KAZE::AOS_Step_Scalar(cv::Mat& Ld, const cv::Mat& Ldprev, const cv::Mat& c, const float stepsize) {
 
-#ifdef _OPENMP
-#pragma omp sections
-  {
-#pragma omp section
-    {
-      AOS_Rows(Ldprev,c,stepsize);
-    }
-#pragma omp section
-    {
-      AOS_Columns(Ldprev,c,stepsize);
-    }
-  }
-#else
+  // The rows and the columns are solved one after the other, each of them in parallel
   AOS_Rows(Ldprev, c, stepsize);
   AOS_Columns(Ldprev, c, stepsize);
-#endif
 
   Ld = 0.5*(Lty_+Ltx_.t());
 }
@@ -2188,11 +2295,11 @@ void KAZE::AOS_Rows(const cv::Mat& Ldprev, const cv::Mat& c, const float stepsiz
 
   // a = 1 + t.*p; (p is -1*p)
   // b = -t.*q;
-  ay_ = 1.0 + stepsize*py_; // p is -1*p
-  by_ = -stepsize*qr_;
+  py_.convertTo(ay_, CV_32F, stepsize, 1.0); // p is -1*p
+  qr_.convertTo(by_, CV_32F, -stepsize);
 
   // Do Thomas algorithm to solve the linear system of equations
-  Thomas(ay_,by_,Ldprev,Lty_);
+  Thomas(ay_,by_,Ldprev,my_,Lty_);
 }
 
 /* ************************************************************************* */
@@ -2220,26 +2327,22 @@ void KAZE::AOS_Columns(const cv::Mat& Ldprev, const cv::Mat& c, const float step
   }
 
   // a = 1 + t.*p';
-  ax_ = 1.0 + stepsize*px_.t();
+  cv::transpose(px_, ax_);
+  ax_.convertTo(ax_, CV_32F, stepsize, 1.0);
 
   // b = -t.*q';
-  bx_ = -stepsize*qc_.t();
+  cv::transpose(qc_, bx_);
+  bx_.convertTo(bx_, CV_32F, -stepsize);
 
   // But take care since we need to transpose the solution!!
-  cv::Mat Ldprevt = Ldprev.t();
+  cv::transpose(Ldprev, Ldprevt_);
 
   // Do Thomas algorithm to solve the linear system of equations
-  Thomas(ax_,bx_,Ldprevt,Ltx_);
+  Thomas(ax_,bx_,Ldprevt_,mx_,Ltx_);
 }
 
 /* ************************************************************************* */
-void KAZE::Thomas(const cv::Mat& a, const cv::Mat &b, const cv::Mat &Ld, cv::Mat &x) {
-
-  // Auxiliary variables
-  int n = a.rows;
-  cv::Mat m = cv::Mat::zeros(a.rows, a.cols,CV_32F);
-  cv::Mat l = cv::Mat::zeros(b.rows, b.cols,CV_32F);
-  cv::Mat y = cv::Mat::zeros(Ld.rows, Ld.cols,CV_32F);
+void KAZE::Thomas(const cv::Mat& a, const cv::Mat &b, const cv::Mat &Ld, cv::Mat& m, cv::Mat &x) {
 
   /** A*x = d;																		   	   */
   /**	/ a1 b1  0  0 0  ...    0 \  / x1 \ = / d1 \										   */
@@ -2254,39 +2357,14 @@ void KAZE::Thomas(const cv::Mat& a, const cv::Mat &b, const cv::Mat &Ld, cv::Mat
    /     |    l2 1          |			|		m3 r3	   |
    /	  |     : : :        |			|       :  :  :	   |
    /	  \           ln-1 1 /			\				mn /	*/
-  for (int j = 0; j < m.cols; j++) {
-    *(m.ptr<float>(0)+j) = *(a.ptr<float>(0)+j);
-  }
-
-  for (int j = 0; j < y.cols; j++) {
-    *(y.ptr<float>(0)+j) = *(Ld.ptr<float>(0)+j);
-  }
-
-  // 1. Forward substitution L*y = d for y
-  for (int k = 1; k < n; k++) {
-    for (int j=0; j < l.cols; j++) {
-      *(l.ptr<float>(k-1)+j) = *(b.ptr<float>(k-1)+j) / *(m.ptr<float>(k-1)+j);
-    }
-
-    for (int j=0; j < m.cols; j++) {
-      *(m.ptr<float>(k)+j) = *(a.ptr<float>(k)+j) - *(l.ptr<float>(k-1)+j)*(*(b.ptr<float>(k-1)+j));
-    }
-
-    for (int j=0; j < y.cols; j++) {
-      *(y.ptr<float>(k)+j) = *(Ld.ptr<float>(k)+j) - *(l.ptr<float>(k-1)+j)*(*(y.ptr<float>(k-1)+j));
-    }
-  }
 
-  // 2. Backward substitution U*x = y
-  for (int j=0; j < y.cols; j++) {
-    *(x.ptr<float>(n-1)+j) = (*(y.ptr<float>(n-1)+j))/(*(m.ptr<float>(n-1)+j));
-  }
+  m.create(a.rows, a.cols, CV_32F);
+  x.create(a.rows, a.cols, CV_32F);
 
-  for (int i = n-2; i >= 0; i--) {
-    for(int j = 0; j < x.cols; j++) {
-      *(x.ptr<float>(i)+j) = (*(y.ptr<float>(i)+j) - (*(b.ptr<float>(i)+j))*(*(x.ptr<float>(i+1)+j)))/(*(m.ptr<float>(i)+j));
-    }
-  }
+  // The systems of all columns are independent, the columns are split into blocks that are
+  // solved in parallel
+  const int nblocks = (a.cols + kThomasBlockCols - 1) / kThomasBlockCols;
+  cv::parallel_for_(cv::Range(0, nblocks), Thomas_Invoker(a, b, Ld, m, x));
 }
 
 /* ************************************************************************* */
@@ -25,6 +25,13 @@
 // OpenCV
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <algorithm>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 /* ************************************************************************* */
@@ -55,88 +62,148 @@ void image_derivatives_scharr(const cv::Mat& src, cv::Mat& dst,
 }
 
 /* ************************************************************************* */
-void pm_g1(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
+namespace {
+
+/// The diffusivities are functions of the normalized squared gradient g = |dL|^2 / k^2. The
+/// functors evaluate them for one value and, with SSE2, for four values at once.
+struct PM_G1_Exponent {
+  float operator()(const float g) const { return -g; }
+#ifdef __SSE2__
+  __m128 operator()(const __m128 g) const { return _mm_sub_ps(_mm_setzero_ps(), g); }
+#endif
+};
+
+struct PM_G2_Diffusivity {
+  float operator()(const float g) const { return 1.0f / (1.0f + g); }
+#ifdef __SSE2__
+  __m128 operator()(const __m128 g) const {
+    const __m128 one = _mm_set1_ps(1.0f);
+    return _mm_div_ps(one, _mm_add_ps(one, g));
+  }
+#endif
+};
+
+struct Weickert_Exponent {
+  float operator()(const float g) const { return -3.315f / (g*g*g*g); }
+#ifdef __SSE2__
+  __m128 operator()(const __m128 g) const {
+    const __m128 g2 = _mm_mul_ps(g, g);
+    return _mm_div_ps(_mm_set1_ps(-3.315f), _mm_mul_ps(g2, g2));
+  }
+#endif
+};
+
+struct Charbonnier_Diffusivity {
+  float operator()(const float g) const { return 1.0f / sqrt(1.0f + g); }
+#ifdef __SSE2__
+  __m128 operator()(const __m128 g) const {
+    const __m128 one = _mm_set1_ps(1.0f);
+    return _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(one, g)));
+  }
+#endif
+};
 
-  cv::Size sz = Lx.size();
-  float inv_k = 1.0 / (k*k);
-  for (int y = 0; y < sz.height; y++) {
+/// Evaluates the function for the normalized squared gradient of all pixels
+/// @param dst Output image, only reallocated if it doesn't match the size of Lx
+template <typename Function>
+void compute_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k,
+                         const Function& function) {
+
+  dst.create(Lx.size(), CV_32F);
+  const float inv_k = 1.0f / (k*k);
+  for (int y = 0; y < Lx.rows; y++) {
     const float* Lx_row = Lx.ptr<float>(y);
     const float* Ly_row = Ly.ptr<float>(y);
     float* dst_row = dst.ptr<float>(y);
-    for (int x = 0; x < sz.width; x++)
-      dst_row[x] = (-inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
+    int x = 0;
+#ifdef __SSE2__
+    const __m128 inv_k4 = _mm_set1_ps(inv_k);
+    for (; x + 4 <= Lx.cols; x += 4) {
+      const __m128 lx = _mm_loadu_ps(Lx_row+x);
+      const __m128 ly = _mm_loadu_ps(Ly_row+x);
+      const __m128 g = _mm_mul_ps(inv_k4, _mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)));
+      _mm_storeu_ps(dst_row+x, function(g));
+    }
+#endif
+    for (; x < Lx.cols; x++)
+      dst_row[x] = function(inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
+  }
+}
+
+/// Computes the gradient magnitude of a row and returns its maximum
+float compute_gradient_magnitude_row(const float* Lx_row, const float* Ly_row, float* dst_row,
+                                     const int ncols) {
+
+  float hmax = 0.0f;
+  int x = 0;
+#ifdef __SSE2__
+  __m128 hmax4 = _mm_setzero_ps();
+  for (; x + 4 <= ncols; x += 4) {
+    const __m128 lx = _mm_loadu_ps(Lx_row+x);
+    const __m128 ly = _mm_loadu_ps(Ly_row+x);
+    const __m128 modg = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)));
+    hmax4 = _mm_max_ps(hmax4, modg);
+    _mm_storeu_ps(dst_row+x, modg);
   }
+  float hmax_lanes[4];
+  _mm_storeu_ps(hmax_lanes, hmax4);
+  hmax = max(max(hmax_lanes[0], hmax_lanes[1]), max(hmax_lanes[2], hmax_lanes[3]));
+#endif
+  for (; x < ncols; x++) {
+    dst_row[x] = sqrt(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]);
+    hmax = max(hmax, dst_row[x]);
+  }
+  return hmax;
+}
 
+}  // namespace
+
+/* ************************************************************************* */
+void pm_g1(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
+
+  compute_diffusivity(Lx, Ly, dst, k, PM_G1_Exponent());
   cv::exp(dst, dst);
 }
 
 /* ************************************************************************* */
 void pm_g2(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
 
-  cv::Size sz = Lx.size();
-  float inv_k = 1.0 / (k*k);
-  for (int y = 0; y < sz.height; y++) {
-    const float* Lx_row = Lx.ptr<float>(y);
-    const float* Ly_row = Ly.ptr<float>(y);
-    float* dst_row = dst.ptr<float>(y);
-    for (int x = 0; x < sz.width; x++)
-      dst_row[x] = 1.0 / (1.0+inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
-  }
+  compute_diffusivity(Lx, Ly, dst, k, PM_G2_Diffusivity());
 }
 
 /* ************************************************************************* */
 void weickert_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
 
-  cv::Size sz = Lx.size();
-  float inv_k = 1.0 / (k*k);
-  for (int y = 0; y < sz.height; y++) {
-    const float* Lx_row = Lx.ptr<float>(y);
-    const float* Ly_row = Ly.ptr<float>(y);
-    float* dst_row = dst.ptr<float>(y);
-    for (int x = 0; x < sz.width; x++) {
-      float dL = inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]);
-      dst_row[x] = -3.315/(dL*dL*dL*dL);
-    }
-  }
-
+  compute_diffusivity(Lx, Ly, dst, k, Weickert_Exponent());
   cv::exp(dst, dst);
-  dst = 1.0 - dst;
+  // dst = 1 - dst, in place
+  dst.convertTo(dst, CV_32F, -1.0, 1.0);
 }
 
 /* ************************************************************************* */
 void charbonnier_diffusivity(const cv::Mat& Lx, const cv::Mat& Ly, cv::Mat& dst, const float k) {
 
-  cv::Size sz = Lx.size();
-  float inv_k = 1.0 / (k*k);
-  for (int y = 0; y < sz.height; y++) {
-    const float* Lx_row = Lx.ptr<float>(y);
-    const float* Ly_row = Ly.ptr<float>(y);
-    float* dst_row = dst.ptr<float>(y);
-    for (int x = 0; x < sz.width; x++) {
-      float den = sqrt(1.0+inv_k*(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]));
-      dst_row[x] = 1.0 / den;
-    }
-  }
+  compute_diffusivity(Lx, Ly, dst, k, Charbonnier_Diffusivity());
 }
 
 /* ************************************************************************* */
 float compute_k_percentile(const cv::Mat& img, float perc, float gscale,
                            size_t nbins, size_t ksize_x, size_t ksize_y) {
 
-  size_t nbin = 0, nelements = 0, nthreshold = 0, k = 0;
-  float kperc = 0.0, modg = 0.0, npoints = 0.0, hmax = 0.0;
+  cv::Mat gaussian, Lx, Ly;
+  return compute_k_percentile(img, perc, gscale, nbins, ksize_x, ksize_y, gaussian, Lx, Ly);
+}
 
-  // Create the array for the histogram
-  float* hist = new float[nbins];
+/* ************************************************************************* */
+float compute_k_percentile(const cv::Mat& img, float perc, float gscale,
+                           size_t nbins, size_t ksize_x, size_t ksize_y,
+                           cv::Mat& gaussian, cv::Mat& Lx, cv::Mat& Ly) {
 
-  // Create the matrices
-  cv::Mat gaussian = cv::Mat::zeros(img.rows, img.cols, CV_32F);
-  cv::Mat Lx = cv::Mat::zeros(img.rows, img.cols, CV_32F);
-  cv::Mat Ly = cv::Mat::zeros(img.rows, img.cols, CV_32F);
+  size_t nbin = 0, nelements = 0, nthreshold = 0, k = 0, npoints = 0;
+  float kperc = 0.0, hmax = 0.0;
 
-  // Set the histogram to zero
-  for (size_t i = 0; i < nbins; i++)
-    hist[i] = 0.0;
+  // Create the array for the histogram
+  vector<size_t> hist(nbins, 0);
 
   // Perform the Gaussian convolution
   gaussian_2D_convolution(img, gaussian, ksize_x, ksize_y, gscale);
@@ -145,35 +212,24 @@ float compute_k_percentile(const cv::Mat& img, float perc, float gscale,
   image_derivatives_scharr(gaussian, Lx, 1, 0);
   image_derivatives_scharr(gaussian, Ly, 0, 1);
 
-  // Skip the borders for computing the histogram
-  for (int y = 1; y < gaussian.rows-1; y++) {
-
-    const float* Lx_row = Lx.ptr<float>(y);
-    const float* Ly_row = Ly.ptr<float>(y);
-
-    for (int x = 1; x < gaussian.cols-1; x++) {
-
-      modg = sqrt(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]);
-
-      // Get the maximum
-      if (modg > hmax)
-        hmax = modg;
-    }
+  // The smoothed image is not needed anymore, it holds the gradient magnitudes to compute the
+  // square roots only once. Skip the borders for computing the histogram
+  cv::Mat& modg = gaussian;
+  modg.create(Lx.size(), CV_32F);
+  for (int y = 1; y < Lx.rows-1; y++) {
+    hmax = max(hmax, compute_gradient_magnitude_row(Lx.ptr<float>(y)+1, Ly.ptr<float>(y)+1,
+                                                    modg.ptr<float>(y)+1, Lx.cols-2));
   }
 
-  // Skip the borders for computing the histogram
-  for (int y = 1; y < gaussian.rows-1; y++) {
+  // Find the correspondent bins
+  for (int y = 1; y < modg.rows-1; y++) {
 
-    const float* Lx_row = Lx.ptr<float>(y);
-    const float* Ly_row = Ly.ptr<float>(y);
-
-    for (int x = 1; x < gaussian.cols-1; x++) {
+    const float* modg_row = modg.ptr<float>(y);
 
-      modg = sqrt(Lx_row[x]*Lx_row[x] + Ly_row[x]*Ly_row[x]);
+    for (int x = 1; x < modg.cols-1; x++) {
 
-      // Find the correspondent bin
-      if (modg != 0.0) {
-        nbin = floor(nbins*(modg/hmax));
+      if (modg_row[x] != 0.0) {
+        nbin = floor(nbins*(modg_row[x]/hmax));
 
         if (nbin == nbins) {
           nbin--;
@@ -196,7 +252,6 @@ float compute_k_percentile(const cv::Mat& img, float perc, float gscale,
   else
     kperc = hmax*((float)(k)/(float)nbins);
 
-  delete [] hist;
   return kperc;
 }
 
@@ -254,33 +309,52 @@ void compute_derivative_kernels(cv::OutputArray kx_, cv::OutputArray ky_,
 }
 
 /* ************************************************************************* */
-void nld_step_scalar(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize) {
+namespace {
+
+/// Computes the diffusion step of the interior image rows in parallel
+class NLD_Step_Invoker : public cv::ParallelLoopBody {
+
+public:
+  NLD_Step_Invoker(const cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize)
+    : Ld_(Ld), c_(c), Lstep_(Lstep), stepsize_(stepsize) {}
+
+  void operator()(const cv::Range& range) const {
+    for (int y = range.start; y < range.end; y++) {
+      const float* c_row = c_.ptr<float>(y);
+      const float* c_row_p = c_.ptr<float>(y+1);
+      const float* c_row_m = c_.ptr<float>(y-1);
+
+      const float* Ld_row = Ld_.ptr<float>(y);
+      const float* Ld_row_p = Ld_.ptr<float>(y+1);
+      const float* Ld_row_m = Ld_.ptr<float>(y-1);
+      float* Lstep_row = Lstep_.ptr<float>(y);
+
+      for (int x = 1; x < Lstep_.cols-1; x++) {
+        float xpos =  (c_row[x]+c_row[x+1])*(Ld_row[x+1]-Ld_row[x]);
+        float xneg =  (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
+        float ypos =  (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
+        float yneg =  (c_row_m[x]+c_row[x])*(Ld_row[x]-Ld_row_m[x]);
+        Lstep_row[x] = 0.5*stepsize_*(xpos-xneg + ypos-yneg);
+      }
+    }
+  }
 
-  Lstep = cv::Scalar(0);
+private:
+  const cv::Mat& Ld_;
+  const cv::Mat& c_;
+  cv::Mat& Lstep_;
+  const float stepsize_;
+};
 
-  // Diffusion all the image except borders
-#ifdef _OPENMP
-  omp_set_num_threads(OMP_MAX_THREADS);
-#pragma omp parallel for schedule(dynamic)
-#endif
-  for (int y = 1; y < Lstep.rows-1; y++) {
-    const float* c_row = c.ptr<float>(y);
-    const float* c_row_p = c.ptr<float>(y+1);
-    const float* c_row_m = c.ptr<float>(y-1);
+}  // namespace
 
-    float* Ld_row = Ld.ptr<float>(y);
-    float* Ld_row_p = Ld.ptr<float>(y+1);
-    float* Ld_row_m = Ld.ptr<float>(y-1);
-    float* Lstep_row = Lstep.ptr<float>(y);
+/* ************************************************************************* */
+void nld_step_scalar(cv::Mat& Ld, const cv::Mat& c, cv::Mat& Lstep, const float stepsize) {
 
-    for (int x = 1; x < Lstep.cols-1; x++) {
-      float xpos =  (c_row[x]+c_row[x+1])*(Ld_row[x+1]-Ld_row[x]);
-      float xneg =  (c_row[x-1]+c_row[x])*(Ld_row[x]-Ld_row[x-1]);
-      float ypos =  (c_row[x]+c_row_p[x])*(Ld_row_p[x]-Ld_row[x]);
-      float yneg =  (c_row_m[x]+c_row[x])*(Ld_row[x]-Ld_row_m[x]);
-      Lstep_row[x] = 0.5*stepsize*(xpos-xneg + ypos-yneg);
-    }
-  }
+  Lstep = cv::Scalar(0);
+
+  // Diffusion all the image except borders, the rows are split between the OpenCV threads
+  cv::parallel_for_(cv::Range(1, Lstep.rows-1), NLD_Step_Invoker(Ld, c, Lstep, stepsize));
 
   // First row
   const float* c_row = c.ptr<float>(0);
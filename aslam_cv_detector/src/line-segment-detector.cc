@@ -1,18 +1,182 @@
 #include "aslam/detectors/line-segment-detector.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <future>
 #include <memory>
+#include <thread>
+#include <vector>
 
+#include <aslam/common/thread-pool.h>
 #include <Eigen/Core>
+#include <glog/logging.h>
 #include <lsd/lsd-opencv.h>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
 namespace aslam {
+namespace {
+cv::Ptr<aslamcv::LineSegmentDetector> createDetector() {
+  return aslamcv::createLineSegmentDetectorPtr(
+      cv::LSD_REFINE_STD, 0.8, 0.6, 2.0, 16.5, 0.0, 0.65, 1024);
+}
+
+/// Is the point within the distance of a border between two tiles.
+bool isNextToTileBorder(const Line::PointType& point, int tile_size_px, double distance_px,
+                        const cv::Size& image_size) {
+  const double x_border = std::round(point(0) / tile_size_px) * tile_size_px;
+  const double y_border = std::round(point(1) / tile_size_px) * tile_size_px;
+  return (x_border > 0.0 && x_border < image_size.width &&
+          std::abs(point(0) - x_border) <= distance_px) ||
+         (y_border > 0.0 && y_border < image_size.height &&
+          std::abs(point(1) - y_border) <= distance_px);
+}
+
+/// Merges the segments if they lie on the same line, with the same orientation, and touch or
+/// overlap up to the gap. The merged segment lies on the longer one.
+bool mergeSegments(const Line& segment_a, const Line& segment_b,
+                   const LineSegmentDetector::Options& options, double max_gap_px,
+                   Line* merged) {
+  CHECK_NOTNULL(merged);
+  const Line::PointType direction_a = segment_a.end_point - segment_a.start_point;
+  const Line::PointType direction_b = segment_b.end_point - segment_b.start_point;
+  const bool a_is_longer = direction_a.squaredNorm() >= direction_b.squaredNorm();
+  const Line& longer = a_is_longer ? segment_a : segment_b;
+  const Line& shorter = a_is_longer ? segment_b : segment_a;
+  const double length = (longer.end_point - longer.start_point).norm();
+  const double shorter_length = (shorter.end_point - shorter.start_point).norm();
+  if (length == 0.0 || shorter_length == 0.0) {
+    return false;
+  }
+  const Line::PointType direction = (longer.end_point - longer.start_point) / length;
+  const Line::PointType shorter_direction =
+      (shorter.end_point - shorter.start_point) / shorter_length;
+  if (direction.dot(shorter_direction) < std::cos(options.merge_max_angle_rad)) {
+    return false;
+  }
+
+  // Distances of the endpoints of the shorter segment from the line through the longer one.
+  const Line::PointType normal(-direction(1), direction(0));
+  if (std::abs(normal.dot(shorter.start_point - longer.start_point)) >
+          options.merge_max_distance_px ||
+      std::abs(normal.dot(shorter.end_point - longer.start_point)) >
+          options.merge_max_distance_px) {
+    return false;
+  }
+
+  // Positions along the longer segment, which spans [0, length].
+  const double shorter_begin = direction.dot(shorter.start_point - longer.start_point);
+  const double shorter_end = direction.dot(shorter.end_point - longer.start_point);
+  if (shorter_begin > length + max_gap_px || shorter_end < -max_gap_px) {
+    return false;
+  }
+  const double begin = std::min(0.0, shorter_begin);
+  const double end = std::max(length, shorter_end);
+  merged->start_point = longer.start_point + begin * direction;
+  merged->end_point = longer.start_point + end * direction;
+  return true;
+}
+
+/// Joins the parts of the segments that were split by the tile borders.
+void mergeSegmentsAtTileBorders(const LineSegmentDetector::Options& options,
+                                const cv::Size& image_size, Lines* lines) {
+  CHECK_NOTNULL(lines);
+  const int tile_size_px = static_cast<int>(options.tile_size_px);
+  const double border_distance_px = static_cast<double>(options.tile_overlap_px) +
+      options.merge_max_distance_px;
+
+  // Only segments that end next to a tile border can have been split.
+  Lines candidates;
+  Lines merged_lines;
+  merged_lines.reserve(lines->size());
+  for (const Line& line : *lines) {
+    if (isNextToTileBorder(line.start_point, tile_size_px, border_distance_px, image_size) ||
+        isNextToTileBorder(line.end_point, tile_size_px, border_distance_px, image_size)) {
+      candidates.emplace_back(line);
+    } else {
+      merged_lines.emplace_back(line);
+    }
+  }
+
+  // Only segments of about the same orientation can be merged, hence the candidates are sorted
+  // by orientation and every candidate is compared with its successors within the max. merge
+  // angle, wrapping around at +-pi. A segment may cross several tiles, so the passes repeat until
+  // no pair can be merged anymore.
+  bool has_merged = true;
+  while (has_merged) {
+    has_merged = false;
+    const size_t num_candidates = candidates.size();
+    std::vector<double> orientations(num_candidates);
+    std::vector<size_t> sorted_indices(num_candidates);
+    for (size_t i = 0u; i < num_candidates; ++i) {
+      const Line::PointType direction = candidates[i].end_point - candidates[i].start_point;
+      orientations[i] = std::atan2(direction(1), direction(0));
+      sorted_indices[i] = i;
+    }
+    std::sort(sorted_indices.begin(), sorted_indices.end(),
+              [&orientations](size_t lhs, size_t rhs) {
+      return orientations[lhs] < orientations[rhs];
+    });
+
+    std::vector<bool> is_merged_away(num_candidates, false);
+    for (size_t rank = 0u; rank < num_candidates; ++rank) {
+      const size_t i = sorted_indices[rank];
+      if (is_merged_away[i]) {
+        continue;
+      }
+      for (size_t offset = 1u; offset < num_candidates; ++offset) {
+        const size_t j = sorted_indices[(rank + offset) % num_candidates];
+        double orientation_difference = orientations[j] - orientations[i];
+        if (orientation_difference < 0.0) {
+          orientation_difference += 2.0 * M_PI;
+        }
+        if (orientation_difference > options.merge_max_angle_rad) {
+          break;
+        }
+        Line merged;
+        if (!is_merged_away[j] &&
+            mergeSegments(candidates[i], candidates[j], options,
+                          static_cast<double>(options.tile_overlap_px), &merged)) {
+          candidates[i] = merged;
+          is_merged_away[j] = true;
+          has_merged = true;
+        }
+      }
+    }
+
+    size_t num_remaining = 0u;
+    for (size_t i = 0u; i < num_candidates; ++i) {
+      if (!is_merged_away[i]) {
+        candidates[num_remaining++] = candidates[i];
+      }
+    }
+    candidates.resize(num_remaining);
+  }
+  merged_lines.insert(merged_lines.end(), candidates.begin(), candidates.end());
+  lines->swap(merged_lines);
+}
+}  // namespace
 
 LineSegmentDetector::LineSegmentDetector(const Options& options)
     : options_(options) {
-  line_detector_ = aslamcv::createLineSegmentDetectorPtr(
-      cv::LSD_REFINE_STD, 0.8, 0.6, 2.0, 16.5, 0.0, 0.65, 1024);
+  line_detector_ = createDetector();
+
+  if (options_.tile_size_px > 0u) {
+    CHECK_GT(options_.tile_size_px, options_.tile_overlap_px);
+    size_t num_threads = options_.num_threads;
+    if (num_threads == 0u) {
+      num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t thread_idx = 0u; thread_idx < num_threads; ++thread_idx) {
+      tile_detectors_.emplace_back(createDetector());
+    }
+    // The calling thread processes tiles as well.
+    if (num_threads > 1u) {
+      thread_pool_.reset(new ThreadPool(num_threads - 1u));
+    }
+  }
 }
 
 LineSegmentDetector::~LineSegmentDetector() {}
@@ -21,6 +185,12 @@ void LineSegmentDetector::detect(const cv::Mat& image, Lines* lines) {
   CHECK_NOTNULL(lines)->clear();
   CHECK(!line_detector_.empty());
 
+  const int tile_size_px = static_cast<int>(options_.tile_size_px);
+  if (tile_size_px > 0 && (image.cols > tile_size_px || image.rows > tile_size_px)) {
+    detectTiled(image, lines);
+    return;
+  }
+
   std::vector<cv::Vec4i> raw_lines;
   line_detector_->detect(image, raw_lines);
   line_detector_->filterSize(raw_lines, raw_lines, options_.min_segment_length_px);
@@ -34,6 +204,75 @@ void LineSegmentDetector::detect(const cv::Mat& image, Lines* lines) {
   }
 }
 
+void LineSegmentDetector::detectTiled(const cv::Mat& image, Lines* lines) {
+  CHECK_NOTNULL(lines);
+  CHECK(!tile_detectors_.empty());
+  const int tile_size_px = static_cast<int>(options_.tile_size_px);
+  const int overlap_px = static_cast<int>(options_.tile_overlap_px);
+  const int num_tiles_x = (image.cols + tile_size_px - 1) / tile_size_px;
+  const int num_tiles_y = (image.rows + tile_size_px - 1) / tile_size_px;
+  const size_t num_tiles = static_cast<size_t>(num_tiles_x * num_tiles_y);
+  tile_lines_.resize(num_tiles);
+
+  std::atomic<size_t> next_tile_idx(0u);
+  std::function<void(size_t)> process_tiles = [&](size_t thread_idx) {
+    CHECK_LT(thread_idx, tile_detectors_.size());
+    aslamcv::LineSegmentDetector& detector = *tile_detectors_[thread_idx];
+    // Apply the detection threshold of the whole image to all tiles.
+    detector.setNfaImageSize(image.size());
+    for (size_t tile_idx = next_tile_idx++; tile_idx < num_tiles; tile_idx = next_tile_idx++) {
+      const int tile_x = static_cast<int>(tile_idx) % num_tiles_x;
+      const int tile_y = static_cast<int>(tile_idx) / num_tiles_x;
+      const cv::Rect core(tile_x * tile_size_px, tile_y * tile_size_px,
+                          std::min(tile_size_px, image.cols - tile_x * tile_size_px),
+                          std::min(tile_size_px, image.rows - tile_y * tile_size_px));
+      const cv::Rect roi = cv::Rect(core.x - overlap_px, core.y - overlap_px,
+                                    core.width + 2 * overlap_px, core.height + 2 * overlap_px) &
+          cv::Rect(0, 0, image.cols, image.rows);
+
+      std::vector<cv::Vec4i>& tile_lines = tile_lines_[tile_idx];
+      tile_lines.clear();
+      detector.detect(image(roi), tile_lines);
+      // Segments within the overlap are found by both tiles, keep them in the tile that
+      // contains their center.
+      size_t num_kept = 0u;
+      for (cv::Vec4i& line : tile_lines) {
+        line += cv::Vec4i(roi.x, roi.y, roi.x, roi.y);
+        const cv::Point center((line(0) + line(2)) / 2, (line(1) + line(3)) / 2);
+        if (core.contains(center)) {
+          tile_lines[num_kept++] = line;
+        }
+      }
+      tile_lines.resize(num_kept);
+    }
+  };
+
+  std::vector<std::future<void>> futures;
+  for (size_t thread_idx = 1u; thread_idx < tile_detectors_.size(); ++thread_idx) {
+    CHECK(thread_pool_);
+    futures.emplace_back(thread_pool_->enqueue(process_tiles, thread_idx));
+  }
+  process_tiles(0u);
+  for (std::future<void>& future : futures) {
+    CHECK(future.valid());
+    future.get();
+  }
+
+  for (const std::vector<cv::Vec4i>& tile_lines : tile_lines_) {
+    for (const cv::Vec4i& line : tile_lines) {
+      lines->emplace_back(static_cast<double>(line(0)), static_cast<double>(line(1)),
+                          static_cast<double>(line(2)), static_cast<double>(line(3)));
+    }
+  }
+  mergeSegmentsAtTileBorders(options_, image.size(), lines);
+
+  // Filter after merging, the parts of a long segment may be short.
+  const double min_length_px = static_cast<double>(options_.min_segment_length_px);
+  lines->erase(std::remove_if(lines->begin(), lines->end(), [min_length_px](const Line& line) {
+    return (line.end_point - line.start_point).norm() < min_length_px;
+  }), lines->end());
+}
+
 void LineSegmentDetector::drawLines(const Lines& lines, cv::Mat* image) {
   CHECK_NOTNULL(image);
   CHECK_EQ(image->channels(), 3) << "Color image required.";
@@ -322,8 +322,17 @@ public:
  */
     bool intersection(InputArray line1, InputArray line2, Point& P);
 
+/**
+ * Set the size of the image that the number of tests of the NFA is computed for.
+ *
+ * @param size      Size of the full image if only a part of it is passed to detect. An empty
+ *                  size uses the size of the image passed to detect.
+ */
+    void setNfaImageSize(const Size& size);
+
 private:
     Mat image;
+    Mat gaussian_img;
     Mat_<double> scaled_image;
     double *scaled_image_data;
     Mat_<double> angles;     // in rads
@@ -331,6 +340,7 @@ private:
     Mat_<double> modgrad;
     double *modgrad_data;
     Mat_<uchar> used;
+    Size nfa_image_size;
 
     int img_width;
     int img_height;
@@ -358,11 +368,11 @@ private:
     };
 
 
-    struct coorlist
-    {
-        Point2i p;
-        struct coorlist* next;
-    };
+    // Workspaces sized to the image. They are kept between the calls and only grow, such
+    // that detecting on images of the same size doesn't allocate.
+    std::vector<Point2i> ordered_points;      // pixels with defined angle, by decreasing gradient
+    std::vector<unsigned int> bin_offsets;    // start of every gradient bin in ordered_points
+    std::vector<RegionPoint> reg;
 
     struct rect
     {
@@ -404,10 +414,11 @@ private:
  *
  * @param threshold The minimum value of the angle that is considered defined, otherwise NOTDEF
  * @param n_bins    The number of bins with which gradients are ordered by, using bucket sort.
- * @param list      Return: Vector of coordinate points that are pseudo ordered by magnitude.
- *                  Pixels would be ordered by norm value, up to a precision given by max_grad/n_bins.
+ * @note            The pixels with defined angle are stored in ordered_points, by decreasing
+ *                  norm value up to a precision given by max_grad/n_bins. Pixels of the same
+ *                  bin keep the row-major order. The bucket sort takes linear time.
  */
-    void ll_angle(const double& threshold, const unsigned int& n_bins, std::vector<coorlist>& list);
+    void ll_angle(const double& threshold, const unsigned int& n_bins);
 
 /**
  * Grow a region starting from point s with a defined precision,
@@ -521,7 +532,7 @@ LineSegmentDetectorImpl::LineSegmentDetectorImpl(int _refine, double _scale, dou
 void LineSegmentDetectorImpl::detect(const InputArray _image, OutputArray _lines,
                 OutputArray _width, OutputArray _prec, OutputArray _nfa)
 {
-    Mat_<double> img = _image.getMat();
+    Mat img = _image.getMat();
     CV_Assert(!img.empty() && img.channels() == 1);
 
     // Convert image to double
@@ -553,10 +564,8 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4i>& lines,
     const double p = ANG_TH / 180;
     const double rho = QUANT / sin(prec);    // gradient magnitude threshold
 
-    std::vector<coorlist> list;
     if(SCALE != 1)
     {
-        Mat gaussian_img;
         const double sigma = (SCALE < 1)?(SIGMA_SCALE / SCALE):(SIGMA_SCALE);
         const double sprec = 3;
         const unsigned int h =  (unsigned int)(ceil(sigma * sqrt(2 * sprec * log(10.0))));
@@ -564,33 +573,41 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4i>& lines,
         GaussianBlur(image, gaussian_img, ksize, sigma);
         // Scale image to needed size
         resize(gaussian_img, scaled_image, Size(), SCALE, SCALE);
-        ll_angle(rho, N_BINS, list);
+        ll_angle(rho, N_BINS);
     }
     else
     {
         scaled_image = image;
-        ll_angle(rho, N_BINS, list);
+        ll_angle(rho, N_BINS);
     }
 
-    LOG_NT = 5 * (log10(double(img_width)) + log10(double(img_height))) / 2 + log10(11.0);
+    double nt_width = img_width, nt_height = img_height;
+    if(nfa_image_size.area() > 0)
+    {
+        nt_width = nfa_image_size.width * SCALE;
+        nt_height = nfa_image_size.height * SCALE;
+    }
+    LOG_NT = 5 * (log10(nt_width) + log10(nt_height)) / 2 + log10(11.0);
     const int min_reg_size = int(-LOG_NT/log10(p)); // minimal number of points in region that can give a meaningful event
 
     // // Initialize region only when needed
     // Mat region = Mat::zeros(scaled_image.size(), CV_8UC1);
-    used = Mat_<uchar>::zeros(scaled_image.size()); // zeros = NOTUSED
-    std::vector<RegionPoint> reg(img_width * img_height);
+    used.create(scaled_image.size());
+    used.setTo(NOTUSED);
+    if(reg.size() < size_t(img_width * img_height)) reg.resize(img_width * img_height);
 
     // Search for line segments
     unsigned int ls_count = 0;
-    unsigned int list_size = list.size();
+    unsigned int list_size = ordered_points.size();
     for(unsigned int i = 0; i < list_size; ++i)
     {
-        unsigned int adx = list[i].p.x + list[i].p.y * img_width;
-        if((used.data[adx] == NOTUSED) && (angles_data[adx] != NOTDEF))
+        const Point2i& point = ordered_points[i];
+        unsigned int adx = point.x + point.y * img_width;
+        if(used.data[adx] == NOTUSED)
         {
             int reg_size;
             double reg_angle;
-            region_grow(list[i].p, reg, reg_size, reg_angle, prec);
+            region_grow(point, reg, reg_size, reg_angle, prec);
 
             // Ignore small regions
             if(reg_size < min_reg_size) { continue; }
@@ -644,12 +661,11 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4i>& lines,
 }
 
 void LineSegmentDetectorImpl::ll_angle(const double& threshold,
-                                   const unsigned int& n_bins,
-                                   std::vector<coorlist>& list)
+                                   const unsigned int& n_bins)
 {
     //Initialize data
-    angles = Mat_<double>(scaled_image.size());
-    modgrad = Mat_<double>(scaled_image.size());
+    angles.create(scaled_image.size());
+    modgrad.create(scaled_image.size());
 
     angles_data = angles.ptr<double>(0);
     modgrad_data = modgrad.ptr<double>(0);
@@ -694,50 +710,41 @@ void LineSegmentDetectorImpl::ll_angle(const double& threshold,
     }
 
     // Compute histogram of gradient values
-    list = std::vector<coorlist>(img_width * img_height);
-    std::vector<coorlist*> range_s(n_bins);
-    std::vector<coorlist*> range_e(n_bins);
-    unsigned int count = 0;
+    bin_offsets.assign(n_bins + 1, 0);
     double bin_coef = (max_grad > 0) ? double(n_bins - 1) / max_grad : 0; // If all image is smooth, max_grad <= 0
 
+    // The bins are stored in decreasing order, bin i counts into bin_offsets[n_bins - i]
+    unsigned int count = 0;
     for(int y = 0; y < img_height - 1; ++y)
     {
-        const double* norm = modgrad_data + y * img_width;
-        for(int x = 0; x < img_width - 1; ++x, ++norm)
+        const int row = y * img_width;
+        for(int x = 0; x < img_width - 1; ++x)
         {
-            // Store the point in the right bin according to its norm
-            int i = int((*norm) * bin_coef);
-            if(!range_e[i])
-            {
-                range_e[i] = range_s[i] = &list[count];
-                ++count;
-            }
-            else
-            {
-                range_e[i]->next = &list[count];
-                range_e[i] = &list[count];
-                ++count;
-            }
-            range_e[i]->p = Point(x, y);
-            range_e[i]->next = 0;
+            if(angles_data[row + x] == NOTDEF) continue;
+            ++bin_offsets[n_bins - int(modgrad_data[row + x] * bin_coef)];
+            ++count;
         }
     }
 
+    // Exclusive prefix sum, bin_offsets[n_bins - i] becomes the start of bin i
+    unsigned int offset = 0;
+    for(unsigned int k = 0; k <= n_bins; ++k)
+    {
+        const unsigned int bin_size = bin_offsets[k];
+        bin_offsets[k] = offset;
+        offset += bin_size;
+    }
+
     // Sort
-    int idx = n_bins - 1;
-    for(;idx > 0 && !range_s[idx]; --idx);
-    coorlist* start = range_s[idx];
-    coorlist* end = range_e[idx];
-    if(start)
+    ordered_points.resize(count);
+    for(int y = 0; y < img_height - 1; ++y)
     {
-        while(idx > 0)
+        const int row = y * img_width;
+        for(int x = 0; x < img_width - 1; ++x)
         {
-            --idx;
-            if(range_s[idx])
-            {
-                end->next = range_s[idx];
-                end = range_e[idx];
-            }
+            if(angles_data[row + x] == NOTDEF) continue;
+            const int bin = n_bins - int(modgrad_data[row + x] * bin_coef);
+            ordered_points[bin_offsets[bin]++] = Point(x, y);
         }
     }
 }
@@ -1433,6 +1440,11 @@ int LineSegmentDetectorImpl::filterSize(InputArray lines, OutputArray filtered,
     return num_filtered;
 }
 
+void LineSegmentDetectorImpl::setNfaImageSize(const Size& size)
+{
+    nfa_image_size = size;
+}
+
 void LineSegmentDetectorImpl::find_eq_params(const Vec4i& line, float& a, float& b, float& c) const
 {
     a = line[3] - line[1];
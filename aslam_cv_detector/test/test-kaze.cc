@@ -0,0 +1,380 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <aslam/common/entrypoint.h>
+
+#include "kaze/KAZE.h"
+#include "kaze/nldiffusion_functions.h"
+
+namespace libKAZE {
+
+class KazeTest : public ::testing::Test {
+ protected:
+  static constexpr int kImageWidth = 320;
+  static constexpr int kImageHeight = 240;
+
+  virtual void SetUp() {
+    cv::theRNG().state = 5u;
+    cv::Mat image(kImageHeight, kImageWidth, CV_8UC1);
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::GaussianBlur(image, image, cv::Size(9, 9), 3.0);
+    // KAZE runs on float images in [0, 1].
+    image.convertTo(image_, CV_32F, 1.0 / 255.0);
+  }
+
+  /// A KAZE instance with the scale space of the image and its detected keypoints.
+  std::unique_ptr<KAZE> createKaze(DESCRIPTOR_TYPE descriptor,
+                                   std::vector<cv::KeyPoint>* keypoints) const {
+    KAZEOptions options;
+    options.img_width = kImageWidth;
+    options.img_height = kImageHeight;
+    options.descriptor = descriptor;
+    std::unique_ptr<KAZE> kaze(new KAZE(options));
+    EXPECT_EQ(0, kaze->Create_Nonlinear_Scale_Space(image_));
+    kaze->Feature_Detection(*keypoints);
+    return kaze;
+  }
+
+  static void computeDescriptor(KAZE* kaze, cv::KeyPoint* keypoint, float* descriptor) {
+    kaze->Compute_Descriptor(*keypoint, descriptor);
+  }
+
+  static std::vector<TEvolution>& getEvolution(KAZE* kaze) {
+    return kaze->evolution_;
+  }
+
+  /// The extrema of the rows [row_begin, row_end) of a level.
+  static std::vector<cv::KeyPoint> findExtremumRows(KAZE* kaze, int level, int row_begin,
+                                                    int row_end) {
+    std::vector<cv::KeyPoint> keypoints;
+    std::vector<float> max_row(kImageWidth);
+    kaze->Find_Extremum_Rows(level, row_begin, row_end, keypoints, max_row.data());
+    return keypoints;
+  }
+
+  /// The extrema of a level as found before the row-wise maxima, with a neighbourhood check
+  /// per point and scale.
+  static std::vector<Eigen::Vector2i> findReferenceExtrema(const KAZE& kaze, int level) {
+    const std::vector<TEvolution>& evolution = kaze.evolution_;
+    const float detector_threshold = kaze.options_.dthreshold;
+    std::vector<Eigen::Vector2i> extrema;
+    for (int ix = 1; ix < kImageHeight - 1; ++ix) {
+      for (int jx = 1; jx < kImageWidth - 1; ++jx) {
+        const float value = evolution[level].Ldet.at<float>(ix, jx);
+        if (value > detector_threshold && value >= 0.00001 &&
+            value >= evolution[level].Ldet.at<float>(ix, jx - 1) &&
+            check_maximum_neighbourhood(evolution[level].Ldet, 1, value, ix, jx, true) &&
+            check_maximum_neighbourhood(evolution[level - 1].Ldet, 1, value, ix, jx, false) &&
+            check_maximum_neighbourhood(evolution[level + 1].Ldet, 1, value, ix, jx, false)) {
+          extrema.emplace_back(jx, ix);
+        }
+      }
+    }
+    return extrema;
+  }
+
+  /// Expects the keypoints at the reference extrema, in the same order.
+  static void expectExtremaEqual(const KAZE& kaze, int level,
+                                 const std::vector<Eigen::Vector2i>& expected_extrema,
+                                 const std::vector<cv::KeyPoint>& keypoints) {
+    const TEvolution& evolution = kaze.evolution_[level];
+    ASSERT_EQ(expected_extrema.size(), keypoints.size());
+    for (size_t i = 0u; i < keypoints.size(); ++i) {
+      EXPECT_EQ(expected_extrema[i].x(), keypoints[i].pt.x) << "Keypoint " << i;
+      EXPECT_EQ(expected_extrema[i].y(), keypoints[i].pt.y) << "Keypoint " << i;
+      EXPECT_EQ(std::fabs(evolution.Ldet.at<float>(expected_extrema[i].y(),
+                                                   expected_extrema[i].x())),
+                keypoints[i].response) << "Keypoint " << i;
+      EXPECT_EQ(evolution.esigma, keypoints[i].size);
+      EXPECT_EQ(evolution.octave, keypoints[i].octave);
+      EXPECT_EQ(level, keypoints[i].class_id);
+      EXPECT_EQ(static_cast<float>(evolution.sublevel), keypoints[i].angle);
+    }
+  }
+
+  /// The upright M-SURF descriptor as computed before the weight tables, with a Gaussian
+  /// evaluated per sample and per subregion.
+  static void computeReferenceMsurfUprightDescriptor64(const KAZE& kaze,
+                                                       const cv::KeyPoint& keypoint,
+                                                       float* descriptor) {
+    auto gaussian = [](float x, float y, float sigma) {
+      return std::exp(-(x * x + y * y) / (2.0f * sigma * sigma));
+    };
+    auto clamp_to_image = [](int* x, int* y) {
+      *x = std::min(std::max(*x, 0), kImageWidth - 1);
+      *y = std::min(std::max(*y, 0), kImageHeight - 1);
+    };
+    const TEvolution& evolution = kaze.evolution_[keypoint.class_id];
+    const float yf = keypoint.pt.y;
+    const float xf = keypoint.pt.x;
+    const int scale = static_cast<int>(keypoint.size / 2.0f + 0.5f);
+    float length = 0.0f;
+    int dcount = 0;
+    float cx = -0.5f;
+    // 4x4 subregions of 9x9 samples, which overlap by 4 samples.
+    for (int subregion_i = 0; subregion_i < 4; ++subregion_i) {
+      const int i = -12 + 5 * subregion_i;
+      cx += 1.0f;
+      float cy = -0.5f;
+      for (int subregion_j = 0; subregion_j < 4; ++subregion_j) {
+        const int j = -12 + 5 * subregion_j;
+        cy += 1.0f;
+        const float ys = yf + (i + 5) * scale;
+        const float xs = xf + (j + 5) * scale;
+        float dx = 0.0f, dy = 0.0f, mdx = 0.0f, mdy = 0.0f;
+        for (int k = i; k < i + 9; ++k) {
+          for (int l = j; l < j + 9; ++l) {
+            const float sample_y = k * scale + yf;
+            const float sample_x = l * scale + xf;
+            const float gauss_s1 = gaussian(xs - sample_x, ys - sample_y, 2.5f * scale);
+            int y1 = static_cast<int>(sample_y - 0.5f), x1 = static_cast<int>(sample_x - 0.5f);
+            clamp_to_image(&x1, &y1);
+            int y2 = static_cast<int>(sample_y + 0.5f), x2 = static_cast<int>(sample_x + 0.5f);
+            clamp_to_image(&x2, &y2);
+            const float fx = sample_x - x1;
+            const float fy = sample_y - y1;
+            auto interpolate = [&](const cv::Mat& L) {
+              return (1.0f - fx) * (1.0f - fy) * L.at<float>(y1, x1) +
+                  fx * (1.0f - fy) * L.at<float>(y1, x2) + (1.0f - fx) * fy * L.at<float>(y2, x1) +
+                  fx * fy * L.at<float>(y2, x2);
+            };
+            const float rx = gauss_s1 * interpolate(evolution.Lx);
+            const float ry = gauss_s1 * interpolate(evolution.Ly);
+            dx += rx;
+            dy += ry;
+            mdx += std::fabs(rx);
+            mdy += std::fabs(ry);
+          }
+        }
+        const float gauss_s2 = gaussian(cx - 2.0f, cy - 2.0f, 1.5f);
+        descriptor[dcount++] = dx * gauss_s2;
+        descriptor[dcount++] = dy * gauss_s2;
+        descriptor[dcount++] = mdx * gauss_s2;
+        descriptor[dcount++] = mdy * gauss_s2;
+        length += (dx * dx + dy * dy + mdx * mdx + mdy * mdy) * gauss_s2 * gauss_s2;
+      }
+    }
+    length = std::sqrt(length);
+    for (int i = 0; i < 64; ++i) {
+      descriptor[i] /= length;
+    }
+  }
+
+  cv::Mat image_;
+};
+
+constexpr int KazeTest::kImageWidth;
+constexpr int KazeTest::kImageHeight;
+
+TEST_F(KazeTest, DiffusivitiesEqualTheScalarDiffusivities) {
+  cv::Mat smoothed, Lx, Ly;
+  gaussian_2D_convolution(image_, smoothed, 0, 0, 1.0f);
+  image_derivatives_scharr(smoothed, Lx, 1, 0);
+  image_derivatives_scharr(smoothed, Ly, 0, 1);
+  const float k = compute_k_percentile(image_, 0.7f, 1.0f, 300u, 0u, 0u);
+  ASSERT_GT(k, 0.0f);
+  const float inv_k = 1.0f / (k * k);
+
+  // The scalar expressions the kernels replaced, of the normalized squared gradient.
+  typedef void (*Diffusivity)(const cv::Mat&, const cv::Mat&, cv::Mat&, const float);
+  typedef float (*ScalarDiffusivity)(const float);
+  const std::vector<std::pair<Diffusivity, ScalarDiffusivity>> diffusivities = {
+      {&pm_g1, [](const float g) { return static_cast<float>(std::exp(-g)); }},
+      {&pm_g2, [](const float g) { return static_cast<float>(1.0 / (1.0 + g)); }},
+      {&weickert_diffusivity,
+       [](const float g) { return static_cast<float>(1.0 - std::exp(-3.315 / (g * g * g * g))); }},
+      {&charbonnier_diffusivity,
+       [](const float g) { return static_cast<float>(1.0 / std::sqrt(1.0 + g)); }}};
+
+  // A width that isn't a multiple of the vector width also runs the scalar tail.
+  const cv::Rect roi(0, 0, kImageWidth - 3, kImageHeight);
+  for (size_t function_idx = 0u; function_idx < diffusivities.size(); ++function_idx) {
+    SCOPED_TRACE(::testing::Message() << "Diffusivity " << function_idx);
+    for (const cv::Rect& rect : {cv::Rect(0, 0, kImageWidth, kImageHeight), roi}) {
+      const cv::Mat Lx_rect = Lx(rect);
+      const cv::Mat Ly_rect = Ly(rect);
+      cv::Mat dst;
+      diffusivities[function_idx].first(Lx_rect, Ly_rect, dst, k);
+      ASSERT_EQ(rect.size(), dst.size());
+      ASSERT_EQ(CV_32F, dst.type());
+      for (int y = 0; y < dst.rows; ++y) {
+        for (int x = 0; x < dst.cols; ++x) {
+          const float lx = Lx_rect.at<float>(y, x);
+          const float ly = Ly_rect.at<float>(y, x);
+          ASSERT_NEAR(diffusivities[function_idx].second(inv_k * (lx * lx + ly * ly)),
+                      dst.at<float>(y, x), 1e-5f) << "Pixel " << x << ", " << y;
+        }
+      }
+
+      // An output of the right size is reused.
+      const uchar* dst_data = dst.data;
+      diffusivities[function_idx].first(Lx_rect, Ly_rect, dst, k);
+      EXPECT_EQ(dst_data, dst.data);
+    }
+  }
+}
+
+TEST_F(KazeTest, ContrastFactorEqualsTheHistogramPercentile) {
+  const float kPercentile = 0.7f;
+  const float kGradientScale = 1.0f;
+  const size_t kNumBins = 300u;
+  cv::Mat gaussian, Lx, Ly;
+  gaussian_2D_convolution(image_, gaussian, 0, 0, kGradientScale);
+  image_derivatives_scharr(gaussian, Lx, 1, 0);
+  image_derivatives_scharr(gaussian, Ly, 0, 1);
+
+  // The histogram of the gradient magnitudes without the image border.
+  float hmax = 0.0f;
+  for (int y = 1; y < kImageHeight - 1; ++y) {
+    for (int x = 1; x < kImageWidth - 1; ++x) {
+      hmax = std::max(hmax, std::sqrt(Lx.at<float>(y, x) * Lx.at<float>(y, x) +
+                                      Ly.at<float>(y, x) * Ly.at<float>(y, x)));
+    }
+  }
+  ASSERT_GT(hmax, 0.0f);
+  std::vector<size_t> histogram(kNumBins, 0u);
+  size_t num_points = 0u;
+  for (int y = 1; y < kImageHeight - 1; ++y) {
+    for (int x = 1; x < kImageWidth - 1; ++x) {
+      const float modg = std::sqrt(Lx.at<float>(y, x) * Lx.at<float>(y, x) +
+                                   Ly.at<float>(y, x) * Ly.at<float>(y, x));
+      if (modg != 0.0f) {
+        const size_t bin = std::min(static_cast<size_t>(std::floor(kNumBins * (modg / hmax))),
+                                    kNumBins - 1u);
+        ++histogram[bin];
+        ++num_points;
+      }
+    }
+  }
+  const size_t threshold = static_cast<size_t>(static_cast<float>(num_points) * kPercentile);
+  size_t num_elements = 0u, bin = 0u;
+  for (; num_elements < threshold && bin < kNumBins; ++bin) {
+    num_elements += histogram[bin];
+  }
+  const float expected_k = hmax * (static_cast<float>(bin) / kNumBins);
+
+  EXPECT_EQ(expected_k,
+            compute_k_percentile(image_, kPercentile, kGradientScale, kNumBins, 0u, 0u));
+  // The caller buffers are reused by the next image.
+  cv::Mat gaussian_buffer, Lx_buffer, Ly_buffer;
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(expected_k, compute_k_percentile(image_, kPercentile, kGradientScale, kNumBins, 0u,
+                                               0u, gaussian_buffer, Lx_buffer, Ly_buffer));
+  }
+}
+
+TEST_F(KazeTest, ParallelDescriptorsEqualSerialDescriptors) {
+  // Each family, with and without orientation and of both lengths.
+  const std::vector<DESCRIPTOR_TYPE> descriptor_types = {
+      SURF, SURF_EXTENDED_UPRIGHT, MSURF, MSURF_EXTENDED, GSURF_UPRIGHT, GSURF_EXTENDED};
+  for (const DESCRIPTOR_TYPE descriptor_type : descriptor_types) {
+    SCOPED_TRACE(::testing::Message() << "Descriptor type " << descriptor_type);
+    std::vector<cv::KeyPoint> keypoints;
+    std::unique_ptr<KAZE> kaze = createKaze(descriptor_type, &keypoints);
+    // Several blocks of keypoints, the last one partially filled.
+    ASSERT_GT(keypoints.size(), 50u);
+    const int descriptor_size = kaze->Get_Descriptor_Size();
+
+    std::vector<cv::KeyPoint> serial_keypoints = keypoints;
+    std::vector<float> serial_descriptors(keypoints.size() * descriptor_size);
+    for (size_t i = 0u; i < serial_keypoints.size(); ++i) {
+      computeDescriptor(kaze.get(), &serial_keypoints[i],
+                        serial_descriptors.data() + i * descriptor_size);
+    }
+
+    std::vector<cv::KeyPoint> parallel_keypoints = keypoints;
+    std::vector<float> parallel_descriptors(keypoints.size() * descriptor_size);
+    kaze->Compute_Descriptors(parallel_keypoints, parallel_descriptors.data());
+    EXPECT_EQ(serial_descriptors, parallel_descriptors);
+    // Including the orientations of the rotation invariant descriptors.
+    for (size_t i = 0u; i < keypoints.size(); ++i) {
+      EXPECT_EQ(serial_keypoints[i].angle, parallel_keypoints[i].angle) << "Keypoint " << i;
+    }
+
+    // The matrix overload has a descriptor per row.
+    std::vector<cv::KeyPoint> matrix_keypoints = keypoints;
+    cv::Mat matrix_descriptors;
+    kaze->Compute_Descriptors(matrix_keypoints, matrix_descriptors);
+    ASSERT_EQ(static_cast<int>(keypoints.size()), matrix_descriptors.rows);
+    ASSERT_EQ(descriptor_size, matrix_descriptors.cols);
+    ASSERT_TRUE(matrix_descriptors.isContinuous());
+    EXPECT_EQ(serial_descriptors, std::vector<float>(
+        matrix_descriptors.ptr<float>(0),
+        matrix_descriptors.ptr<float>(0) + serial_descriptors.size()));
+  }
+}
+
+TEST_F(KazeTest, MsurfWeightTablesEqualTheGaussians) {
+  std::vector<cv::KeyPoint> keypoints;
+  std::unique_ptr<KAZE> kaze = createKaze(MSURF_UPRIGHT, &keypoints);
+  ASSERT_FALSE(keypoints.empty());
+  ASSERT_EQ(64, kaze->Get_Descriptor_Size());
+  cv::Mat descriptors;
+  kaze->Compute_Descriptors(keypoints, descriptors);
+
+  // The keypoints cover several scales, the tables are independent of it.
+  float reference_descriptor[64];
+  for (size_t i = 0u; i < keypoints.size(); ++i) {
+    computeReferenceMsurfUprightDescriptor64(*kaze, keypoints[i], reference_descriptor);
+    const float* descriptor = descriptors.ptr<float>(i);
+    for (int d = 0; d < 64; ++d) {
+      EXPECT_NEAR(reference_descriptor[d], descriptor[d], 1e-5f)
+          << "Keypoint " << i << ", entry " << d;
+    }
+  }
+}
+
+TEST_F(KazeTest, RowwiseMaximaFindTheNeighbourhoodMaxima) {
+  std::vector<cv::KeyPoint> keypoints;
+  std::unique_ptr<KAZE> kaze = createKaze(MSURF, &keypoints);
+  ASSERT_FALSE(keypoints.empty());
+  std::vector<TEvolution>& evolution = getEvolution(kaze.get());
+  ASSERT_GT(evolution.size(), 2u);
+
+  for (int level = 1; level + 1 < static_cast<int>(evolution.size()); ++level) {
+    SCOPED_TRACE(::testing::Message() << "Level " << level);
+    const std::vector<Eigen::Vector2i> expected_extrema = findReferenceExtrema(*kaze, level);
+    expectExtremaEqual(*kaze, level, expected_extrema,
+                       findExtremumRows(kaze.get(), level, 1, kImageHeight - 1));
+
+    // Blocks of rows append the extrema in row-major order, like the whole image.
+    std::vector<cv::KeyPoint> block_keypoints;
+    for (int row_begin = 1; row_begin < kImageHeight - 1; row_begin += 7) {
+      const std::vector<cv::KeyPoint> block = findExtremumRows(
+          kaze.get(), level, row_begin, std::min(row_begin + 7, kImageHeight - 1));
+      block_keypoints.insert(block_keypoints.end(), block.begin(), block.end());
+    }
+    expectExtremaEqual(*kaze, level, expected_extrema, block_keypoints);
+  }
+
+  // Quantized responses have plateaus, where equal neighbours don't prevent an extremum.
+  cv::RNG rng(3);
+  for (TEvolution& level_evolution : evolution) {
+    for (int ix = 0; ix < kImageHeight; ++ix) {
+      for (int jx = 0; jx < kImageWidth; ++jx) {
+        level_evolution.Ldet.at<float>(ix, jx) = 0.01f * rng.uniform(0, 4);
+      }
+    }
+  }
+  size_t num_extrema = 0u;
+  for (int level = 1; level + 1 < static_cast<int>(evolution.size()); ++level) {
+    SCOPED_TRACE(::testing::Message() << "Quantized level " << level);
+    const std::vector<Eigen::Vector2i> expected_extrema = findReferenceExtrema(*kaze, level);
+    num_extrema += expected_extrema.size();
+    expectExtremaEqual(*kaze, level, expected_extrema,
+                       findExtremumRows(kaze.get(), level, 1, kImageHeight - 1));
+  }
+  EXPECT_GT(num_extrema, 0u);
+}
+
+}  // namespace libKAZE
+
+ASLAM_UNITTEST_ENTRYPOINT
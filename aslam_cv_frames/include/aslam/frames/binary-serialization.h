@@ -0,0 +1,222 @@
+#ifndef ASLAM_FRAMES_BINARY_SERIALIZATION_H_
+#define ASLAM_FRAMES_BINARY_SERIALIZATION_H_
+
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/unique-id.h>
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <opencv2/core/core.hpp>
+
+/// \file
+/// Versioned binary format for VisualFrames and VisualNFrames that is written without copying
+/// the channel data and read back as views over (memory mapped) buffers.
+///
+/// An nframe consists of a 64 byte BinaryNFrameHeader, a table of num_frames uint64 frame
+/// offsets (0 for unset frames) and the frames. A frame consists of a 64 byte BinaryFrameHeader,
+/// a table of num_channels 96 byte BinaryChannelEntries and the raw channel payloads. All
+/// offsets are relative to the start of the enclosing record and all sections start on a 64 byte
+/// boundary, hence the payloads of a 64 byte aligned buffer can be mapped directly.
+/// Eigen matrices are stored column-major, images row-major. All values have host byte order.
+/// Channels without contiguous storage (e.g. the image pyramid) are not written. Version 2 widened
+/// the channel names from 31 to 63 characters.
+
+namespace aslam {
+class VisualFrame;
+class VisualNFrame;
+namespace internal {
+class SerializationSink;
+}  // namespace internal
+
+namespace binary_serialization {
+constexpr uint32_t kFrameMagic = 0x46564341u;  // "ACVF"
+constexpr uint32_t kNFrameMagic = 0x4e564341u;  // "ACVN"
+constexpr uint16_t kFormatVersion = 2u;
+constexpr size_t kAlignmentBytes = 64u;
+constexpr size_t kMaxChannelNameLength = 63u;
+
+struct BinaryFrameHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size_bytes;
+  uint32_t num_channels;
+  uint32_t is_valid;
+  uint64_t total_size_bytes;
+  int64_t timestamp_nanoseconds;
+  uint64_t frame_id[2];
+  uint64_t camera_id[2];
+};
+static_assert(sizeof(BinaryFrameHeader) == kAlignmentBytes, "Unexpected frame header padding.");
+
+struct BinaryChannelEntry {
+  char name[kMaxChannelNameLength + 1u];
+  uint64_t offset;
+  uint64_t size_bytes;
+  uint32_t rows;
+  uint32_t cols;
+  uint16_t depth;
+  uint8_t channels;
+  uint8_t column_major;
+  uint32_t reserved;
+};
+static_assert(sizeof(BinaryChannelEntry) == kMaxChannelNameLength + 1u + 32u,
+              "Unexpected channel entry padding.");
+
+struct BinaryNFrameHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size_bytes;
+  uint32_t num_frames;
+  uint32_t reserved_0;
+  uint64_t total_size_bytes;
+  uint64_t nframe_id[2];
+  uint64_t reserved_1[3];
+};
+static_assert(sizeof(BinaryNFrameHeader) == kAlignmentBytes, "Unexpected nframe header padding.");
+
+inline size_t alignSize(size_t size_bytes) {
+  return (size_bytes + kAlignmentBytes - 1u) / kAlignmentBytes * kAlignmentBytes;
+}
+}  // namespace binary_serialization
+
+/// \class BinaryFrameSerializer
+/// \brief Lays out a frame or nframe in the binary format as a list of iovecs.
+///
+/// Only the headers are written into buffers owned by the serializer, the iovecs of the payloads
+/// point directly at the channel data. The serialized frames must therefore stay alive and
+/// unmodified until the iovecs have been written. A compressed raw image is written as the decoded
+/// raw image channel, which the frame keeps until releaseDecompressedRawImage(). The serializer
+/// can be reused to avoid reallocating the header buffers.
+class BinaryFrameSerializer {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(BinaryFrameSerializer);
+  BinaryFrameSerializer() : num_used_header_buffers_(0u), total_size_bytes_(0u) {}
+
+  void serializeVisualFrame(const VisualFrame& frame);
+  void serializeVisualNFrame(const VisualNFrame& nframe);
+
+  const std::vector<iovec>& getIoVectors() const { return io_vectors_; }
+  size_t getTotalSizeBytes() const { return total_size_bytes_; }
+
+  /// Write all iovecs with writev, handling partial writes. Returns false on an IO error.
+  bool writeToFileDescriptor(int file_descriptor) const;
+  /// Stream the serialized record into a channel serialization sink. The payloads are passed
+  /// as persistent data, hence the sink must not outlive the serialized frames if it references
+  /// them. Returns false if the sink fails, e.g. if a buffer sink is too small.
+  bool writeToSink(internal::SerializationSink* sink) const;
+  bool writeToStream(std::ostream* stream) const;
+  /// Copy the serialized record into a buffer of getTotalSizeBytes().
+  void copyToBuffer(char* buffer) const;
+
+ private:
+  void reset();
+  void appendVisualFrame(const VisualFrame& frame);
+  void appendIoVector(const void* data, size_t size_bytes);
+  void appendPadding(size_t size_bytes);
+  std::vector<char>* newHeaderBuffer(size_t size_bytes);
+
+  /// A deque keeps the buffers in place while new ones are added.
+  std::deque<std::vector<char>> header_buffers_;
+  size_t num_used_header_buffers_;
+  std::vector<iovec> io_vectors_;
+  size_t total_size_bytes_;
+};
+
+/// \class BinaryVisualFrameView
+/// \brief Read-only access to a serialized frame without copying the payloads.
+///
+/// The view does not own the buffer; its maps and images are valid as long as the buffer is.
+class BinaryVisualFrameView {
+ public:
+  BinaryVisualFrameView() : data_(nullptr), size_bytes_(0u) {}
+
+  /// Check the header and the channel table, returns false if the buffer is malformed, e.g. if
+  /// the size of a payload does not match its dimensions and type.
+  bool init(const char* data, size_t size_bytes);
+
+  int64_t getTimestampNanoseconds() const { return getHeader().timestamp_nanoseconds; }
+  aslam::FrameId getId() const;
+  aslam::CameraId getCameraId() const;
+  bool isValid() const { return getHeader().is_valid != 0u; }
+  size_t getTotalSizeBytes() const { return getHeader().total_size_bytes; }
+
+  size_t getNumChannels() const { return getHeader().num_channels; }
+  std::string getChannelName(size_t channel_index) const;
+  bool hasChannel(const std::string& name) const;
+
+  /// Map a column-major matrix channel of the given scalar type.
+  template <typename Scalar>
+  Eigen::Map<const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>> getMatrixChannel(
+      const std::string& name) const;
+
+  /// Get an image channel as cv::Mat header over the buffer. The image must not be modified.
+  cv::Mat getImageChannel(const std::string& name) const;
+
+  /// Copy the built-in channels into a frame that owns its data. The camera geometry has to be
+  /// set by the caller, e.g. from the camera id.
+  void copyToVisualFrame(VisualFrame* frame) const;
+
+  /// \brief Add the built-in channels to an empty frame without decoding them.
+  ///
+  /// Only the channel table is parsed; a channel is copied out of the buffer when the frame first
+  /// accesses it, and re-serializing the frame writes the undecoded channels straight from the
+  /// buffer. The frame shares the ownership of the buffer, which must outlive the view and stay
+  /// unmodified while any channel is undecoded. The camera geometry has to be set by the caller.
+  void createLazyVisualFrame(const std::shared_ptr<const void>& buffer, VisualFrame* frame) const;
+
+ private:
+  const binary_serialization::BinaryFrameHeader& getHeader() const;
+  const binary_serialization::BinaryChannelEntry* findChannel(const std::string& name) const;
+  template <typename CHANNEL_DATA_TYPE>
+  void addLazyChannel(const std::string& name, const std::shared_ptr<const void>& buffer,
+                      VisualFrame* frame) const;
+
+  const char* data_;
+  size_t size_bytes_;
+};
+
+/// \class BinaryVisualNFrameView
+/// \brief Read-only access to a serialized nframe without copying the payloads.
+class BinaryVisualNFrameView {
+ public:
+  BinaryVisualNFrameView() : data_(nullptr), size_bytes_(0u) {}
+
+  /// Check the header and all frames, returns false if the buffer is malformed.
+  bool init(const char* data, size_t size_bytes);
+
+  aslam::NFramesId getId() const;
+  size_t getNumFrames() const;
+  size_t getTotalSizeBytes() const;
+  bool isFrameSet(size_t frame_index) const;
+  const BinaryVisualFrameView& getFrame(size_t frame_index) const;
+
+ private:
+  const char* data_;
+  size_t size_bytes_;
+  std::vector<BinaryVisualFrameView> frames_;
+};
+
+template <typename Scalar>
+Eigen::Map<const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>>
+BinaryVisualFrameView::getMatrixChannel(const std::string& name) const {
+  const binary_serialization::BinaryChannelEntry* entry = findChannel(name);
+  CHECK(entry != nullptr) << "The frame has no channel " << name << ".";
+  CHECK_EQ(static_cast<int>(entry->depth), cv::DataType<Scalar>::depth)
+      << "Scalar type mismatch of channel " << name << ".";
+  CHECK_EQ(entry->channels, 1u);
+  CHECK(entry->column_major) << "Channel " << name << " is not a column-major matrix.";
+  return Eigen::Map<const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>>(
+      reinterpret_cast<const Scalar*>(data_ + entry->offset), entry->rows, entry->cols);
+}
+
+}  // namespace aslam
+
+#endif  // ASLAM_FRAMES_BINARY_SERIALIZATION_H_
@@ -0,0 +1,144 @@
+#ifndef ASLAM_COMPACT_FEATURE_TRACKS_H_
+#define ASLAM_COMPACT_FEATURE_TRACKS_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+#include <aslam/common/macros.h>
+#include <aslam/frames/feature-track.h>
+#include <aslam/frames/visual-nframe.h>
+
+namespace aslam {
+
+/// \brief Reference to a keypoint observation by the index of its nframe in a VisualNFramePool.
+///        Unlike KeypointIdentifier it doesn't own the nframe.
+struct CompactKeypointIdentifier {
+  uint32_t nframe_index;
+  /// Frame index in the VisualNFrame. Corresponds to the NCamera index.
+  uint32_t frame_index;
+  uint32_t keypoint_index;
+};
+
+/// \class VisualNFramePool
+/// \brief Keeps the shared ownership of a sliding window of nframes, once per nframe. The nframes
+///        are addressed by a stable index that increases with every added nframe.
+class VisualNFramePool {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(VisualNFramePool);
+  VisualNFramePool() : first_index_(0u) {}
+
+  /// Returns the index of the added nframe.
+  size_t addNFrame(const std::shared_ptr<const VisualNFrame>& nframe);
+
+  /// Release the nframes with an index below the given one, e.g. when they leave the window.
+  void releaseNFramesBefore(size_t nframe_index);
+
+  inline bool hasNFrame(size_t nframe_index) const {
+    return nframe_index >= first_index_ && nframe_index < getEndIndex();
+  }
+  inline const std::shared_ptr<const VisualNFrame>& getNFrameShared(size_t nframe_index) const {
+    CHECK(hasNFrame(nframe_index)) << "The nframe " << nframe_index << " is not in the pool.";
+    return nframes_[nframe_index - first_index_];
+  }
+  inline const VisualNFrame& getNFrame(size_t nframe_index) const {
+    return *getNFrameShared(nframe_index);
+  }
+
+  /// Index of the oldest nframe in the pool and one past the newest one.
+  inline size_t getFirstIndex() const { return first_index_; }
+  inline size_t getEndIndex() const { return first_index_ + nframes_.size(); }
+  inline size_t size() const { return nframes_.size(); }
+
+  inline const Eigen::Block<Eigen::Matrix2Xd, 2, 1> getKeypointMeasurement(
+      const CompactKeypointIdentifier& keypoint) const {
+    return getNFrame(keypoint.nframe_index).getFrame(keypoint.frame_index).getKeypointMeasurement(
+        keypoint.keypoint_index);
+  }
+
+ private:
+  std::deque<std::shared_ptr<const VisualNFrame>> nframes_;
+  size_t first_index_;
+};
+
+/// \class CompactFeatureTracks
+/// \brief Feature tracks stored one after the other in a single contiguous arena of
+///        CompactKeypointIdentifiers. Building and copying the tracks touches no reference counts
+///        and clear() keeps the allocated memory for the next batch of tracks.
+///
+///        Tracks are built one at a time: beginTrack() starts a track at the end of the arena and
+///        addObservationToLastTrack() appends to it.
+class CompactFeatureTracks {
+ public:
+  CompactFeatureTracks() = default;
+
+  void reserve(size_t num_tracks, size_t num_observations) {
+    tracks_.reserve(num_tracks);
+    observations_.reserve(num_observations);
+  }
+
+  /// Returns the index of the new track.
+  inline size_t beginTrack(size_t track_id) {
+    TrackRange track;
+    track.track_id = track_id;
+    track.begin = observations_.size();
+    track.length = 0u;
+    tracks_.push_back(track);
+    return tracks_.size() - 1u;
+  }
+
+  inline void addObservationToLastTrack(size_t nframe_index, size_t frame_index,
+                                        size_t keypoint_index) {
+    CHECK(!tracks_.empty()) << "Call beginTrack() first.";
+    CompactKeypointIdentifier keypoint;
+    keypoint.nframe_index = static_cast<uint32_t>(nframe_index);
+    keypoint.frame_index = static_cast<uint32_t>(frame_index);
+    keypoint.keypoint_index = static_cast<uint32_t>(keypoint_index);
+    observations_.push_back(keypoint);
+    ++tracks_.back().length;
+  }
+
+  /// Remove all tracks, the memory is kept.
+  inline void clear() {
+    tracks_.clear();
+    observations_.clear();
+  }
+
+  inline size_t getNumTracks() const { return tracks_.size(); }
+  inline size_t getNumObservations() const { return observations_.size(); }
+  inline size_t getTrackId(size_t track_index) const { return getTrack(track_index).track_id; }
+  inline size_t getTrackLength(size_t track_index) const {
+    return getTrack(track_index).length;
+  }
+
+  /// The getTrackLength(track_index) observations of a track, oldest first.
+  inline const CompactKeypointIdentifier* getObservations(size_t track_index) const {
+    return observations_.data() + getTrack(track_index).begin;
+  }
+
+  /// Expand a track to a FeatureTrack. All nframes of the track must still be in the pool.
+  FeatureTrack getFeatureTrack(size_t track_index, const VisualNFramePool& nframe_pool) const;
+
+ private:
+  struct TrackRange {
+    size_t track_id;
+    size_t begin;
+    size_t length;
+  };
+
+  inline const TrackRange& getTrack(size_t track_index) const {
+    CHECK_LT(track_index, tracks_.size());
+    return tracks_[track_index];
+  }
+
+  std::vector<TrackRange> tracks_;
+  std::vector<CompactKeypointIdentifier> observations_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_COMPACT_FEATURE_TRACKS_H_
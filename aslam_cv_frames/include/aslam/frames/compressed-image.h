@@ -0,0 +1,76 @@
+#ifndef ASLAM_FRAMES_COMPRESSED_IMAGE_H_
+#define ASLAM_FRAMES_COMPRESSED_IMAGE_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <opencv2/core/core.hpp>
+
+namespace aslam {
+
+/// \class CompressedImage
+/// \brief An image kept in memory as losslessly compressed horizontal strips.
+///
+/// The image is encoded as PNG, whose row filters delta-code the pixels, in strips of a fixed
+/// height. A patch only decodes the strips it overlaps, the full image is decoded on the first
+/// request and kept until releaseDecodedImage(). Until compress() has run, the image is served
+/// from the uncompressed source, such that compress() can run asynchronously. Thread-safe.
+class CompressedImage {
+ public:
+  ASLAM_POINTER_TYPEDEFS(CompressedImage);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(CompressedImage);
+
+  struct Options {
+    Options() : png_compression_level(1), strip_height_px(64u) {}
+    /// zlib level in [0, 9]. The low levels are fast and already take most of the gain on
+    /// camera images.
+    int png_compression_level;
+    /// Height of the independently decodable strips.
+    size_t strip_height_px;
+  };
+
+  /// Keeps a shallow copy of the image until compress() is called.
+  CompressedImage(const cv::Mat& image, const Options& options);
+
+  /// Encode the image and drop the source. Calls after the first one have no effect.
+  void compress();
+  bool isCompressed() const;
+
+  /// The full image, decoded on the first call. The reference stays valid until
+  /// releaseDecodedImage().
+  const cv::Mat& getImage() const;
+  /// Drop the decoded image, the next getImage() decodes it again.
+  void releaseDecodedImage();
+
+  /// Copy the part of the image within the region of interest, which is clipped to the image.
+  /// Returns the clipped region of interest.
+  cv::Rect getPatch(const cv::Rect& roi, cv::Mat* patch) const;
+
+  cv::Size size() const { return size_; }
+  int type() const { return type_; }
+  /// Size of the encoded strips, 0 before compression.
+  size_t getCompressedSizeBytes() const;
+  /// Memory of the source image, the decoded image and the encoded strips.
+  size_t getMemoryUsageBytes() const;
+
+ private:
+  void decodeStrip(size_t strip_idx, cv::Mat* strip) const;
+
+  const Options options_;
+  const cv::Size size_;
+  const int type_;
+
+  mutable std::mutex m_image_;
+  /// The image to compress, released by compress().
+  cv::Mat source_image_;
+  mutable cv::Mat decoded_image_;
+  std::vector<std::vector<uchar>> strips_;
+  bool is_compressed_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_FRAMES_COMPRESSED_IMAGE_H_
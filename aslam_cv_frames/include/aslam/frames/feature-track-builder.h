@@ -0,0 +1,69 @@
+#ifndef ASLAM_FEATURE_TRACK_BUILDER_H_
+#define ASLAM_FEATURE_TRACK_BUILDER_H_
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <aslam/frames/compact-feature-tracks.h>
+#include <aslam/frames/feature-track.h>
+#include <aslam/frames/visual-nframe.h>
+
+namespace aslam {
+
+/// \class FeatureTrackBuilder
+/// \brief Builds feature tracks incrementally from the track id channels of streamed nframes.
+///
+/// Every nframe is scanned once: the observations are appended to the live track of their track
+/// id through a hash map per camera. A live track that is not continued by an nframe is
+/// terminated and emitted. The builder keeps the nframes referenced by live tracks in a
+/// VisualNFramePool and releases them once no live track refers to them anymore. The slots of
+/// terminated tracks are reused with their memory. Not thread-safe.
+class FeatureTrackBuilder {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(FeatureTrackBuilder);
+  FeatureTrackBuilder() : num_cameras_(0u) {}
+
+  /// \brief Append the observations of the nframe to the live tracks.
+  /// @param[in]  nframe                The next nframe, all frames must be set and have track ids.
+  ///                                   Must have the same number of cameras as earlier nframes.
+  /// @param[out] terminated_tracks     The tracks that were not continued by this nframe, one
+  ///                                   FeatureTracks per camera.
+  void addNFrame(const std::shared_ptr<const VisualNFrame>& nframe,
+                 std::vector<FeatureTracks>* terminated_tracks);
+
+  /// \brief Terminate all live tracks, e.g. at the end of a sequence.
+  void terminateAllTracks(std::vector<FeatureTracks>* terminated_tracks);
+
+  size_t getNumLiveTracks() const { return live_slots_.size(); }
+  /// Number of nframes that are kept for the live tracks.
+  size_t getNumNFramesInWindow() const { return nframe_pool_.size(); }
+
+ private:
+  struct TrackSlot {
+    int track_id;
+    size_t camera_index;
+    /// Index of the last nframe that continued the track.
+    size_t last_nframe_index;
+    std::vector<CompactKeypointIdentifier> observations;
+  };
+  typedef std::unordered_map<int, size_t> TrackIdToSlotMap;
+
+  size_t acquireSlot(int track_id, size_t camera_index);
+  void emitTrack(const TrackSlot& slot, std::vector<FeatureTracks>* terminated_tracks) const;
+  void prepareOutput(std::vector<FeatureTracks>* terminated_tracks) const;
+
+  size_t num_cameras_;
+  VisualNFramePool nframe_pool_;
+
+  std::vector<TrackSlot> slots_;
+  std::vector<size_t> free_slots_;
+  std::vector<size_t> live_slots_;
+  /// One map per camera.
+  std::vector<TrackIdToSlotMap> track_id_to_slot_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_FEATURE_TRACK_BUILDER_H_
@@ -0,0 +1,134 @@
+#ifndef ASLAM_FRAMES_KEYPOINT_BLOCK_H_
+#define ASLAM_FRAMES_KEYPOINT_BLOCK_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <Eigen/Core>
+
+namespace aslam {
+class VisualFrame;
+
+/// \class KeypointBlock
+/// \brief Structure-of-arrays storage of the keypoint attributes of a frame in one allocation.
+///
+/// The measurements, uncertainties, orientations, scores, scales, track ids and descriptors are
+/// stored in column blocks of a single buffer. Every block starts on a cache line and has room
+/// for capacity() keypoints, the buffer grows geometrically. The attributes are accessed as
+/// Eigen::Map views with the layout of the corresponding VisualFrame channels; the views are
+/// invalidated by any call that changes the capacity.
+class KeypointBlock {
+ public:
+  ASLAM_POINTER_TYPEDEFS(KeypointBlock);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(KeypointBlock);
+
+  typedef Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> DescriptorsT;
+  typedef Eigen::Map<Eigen::Matrix2Xd> MeasurementsMap;
+  typedef Eigen::Map<const Eigen::Matrix2Xd> ConstMeasurementsMap;
+  typedef Eigen::Map<Eigen::VectorXd> VectorMap;
+  typedef Eigen::Map<const Eigen::VectorXd> ConstVectorMap;
+  typedef Eigen::Map<Eigen::VectorXi> TrackIdsMap;
+  typedef Eigen::Map<const Eigen::VectorXi> ConstTrackIdsMap;
+  typedef Eigen::Map<DescriptorsT> DescriptorsMap;
+  typedef Eigen::Map<const DescriptorsT> ConstDescriptorsMap;
+
+  /// Cache line size the attribute blocks are aligned to.
+  static constexpr size_t kBlockAlignmentBytes = 64u;
+
+  /// @param[in] descriptor_size_bytes Number of bytes per descriptor, may be zero.
+  explicit KeypointBlock(size_t descriptor_size_bytes);
+  ~KeypointBlock();
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  bool empty() const { return size_ == 0u; }
+  size_t getDescriptorSizeBytes() const { return descriptor_size_bytes_; }
+
+  /// Reserve room for at least num_keypoints keypoints.
+  void reserve(size_t num_keypoints);
+  /// Resize, growing by at least a factor of two. New keypoints have zero attributes, a zero
+  /// descriptor and an invalid track id (-1).
+  void resize(size_t num_keypoints);
+  void clear() { size_ = 0u; }
+
+  /// Append a keypoint with an invalid track id. The descriptor may be null if the block has no
+  /// descriptors. Returns the index of the new keypoint.
+  size_t appendKeypoint(const Eigen::Vector2d& measurement, double uncertainty,
+                        double orientation, double score, double scale,
+                        const unsigned char* descriptor);
+
+  /// Remove all keypoints whose mask entry is false, keeping the order of the others. The
+  /// compaction happens in place without reallocating. Returns the number of removed keypoints.
+  size_t eraseByMask(const std::vector<bool>& keep_mask);
+
+  /// Remove the keypoints with an invalid track id, see VisualFrame::discardUntrackedObservations.
+  void discardUntrackedObservations(std::vector<size_t>* discarded_indices);
+
+  /// \name Attribute views over the first size() keypoints.
+  /// @{
+  MeasurementsMap getKeypointMeasurementsMutable();
+  ConstMeasurementsMap getKeypointMeasurements() const;
+  VectorMap getKeypointMeasurementUncertaintiesMutable();
+  ConstVectorMap getKeypointMeasurementUncertainties() const;
+  VectorMap getKeypointOrientationsMutable();
+  ConstVectorMap getKeypointOrientations() const;
+  VectorMap getKeypointScoresMutable();
+  ConstVectorMap getKeypointScores() const;
+  VectorMap getKeypointScalesMutable();
+  ConstVectorMap getKeypointScales() const;
+  TrackIdsMap getTrackIdsMutable();
+  ConstTrackIdsMap getTrackIds() const;
+  DescriptorsMap getDescriptorsMutable();
+  ConstDescriptorsMap getDescriptors() const;
+  /// @}
+
+  /// Copy the keypoint channels of a frame into the block. The frame must have keypoint
+  /// measurements; missing channels are filled as in resize().
+  void copyFromVisualFrame(const VisualFrame& frame);
+  /// Write all keypoint channels of the frame from the block, adding missing channels.
+  void copyToVisualFrame(VisualFrame* frame) const;
+
+ private:
+  enum Attribute {
+    kMeasurements,
+    kUncertainties,
+    kOrientations,
+    kScores,
+    kScales,
+    kTrackIds,
+    kDescriptors,
+    kNumAttributes
+  };
+
+  size_t getAttributeSizeBytes(Attribute attribute) const;
+  /// Compute the block offsets for the given capacity, returns the total buffer size.
+  size_t computeOffsets(size_t capacity, size_t* offsets) const;
+  void reallocate(size_t capacity);
+  void fillDefaults(size_t begin, size_t end);
+
+  template <typename ScalarType>
+  ScalarType* getBlock(Attribute attribute) {
+    return reinterpret_cast<ScalarType*>(data_ + offsets_[attribute]);
+  }
+  template <typename ScalarType>
+  const ScalarType* getBlock(Attribute attribute) const {
+    return reinterpret_cast<const ScalarType*>(data_ + offsets_[attribute]);
+  }
+
+  const size_t descriptor_size_bytes_;
+  size_t size_;
+  size_t capacity_;
+
+  /// The allocation and its first cache line aligned byte.
+  std::unique_ptr<unsigned char[]> buffer_;
+  unsigned char* data_;
+  size_t offsets_[kNumAttributes];
+
+  static constexpr size_t kMinCapacity = 64u;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_FRAMES_KEYPOINT_BLOCK_H_
@@ -2,18 +2,24 @@
 #define ASLAM_FRAMES_VISUAL_FRAME_H_
 
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <cstdint>
+#include <vector>
 
 #include <aslam/cameras/camera.h>
 #include <aslam/common/channel.h>
 #include <aslam/common/channel-declaration.h>
+#include <aslam/common/deadline.h>
 #include <aslam/common/macros.h>
 #include <aslam/common/unique-id.h>
 #include <Eigen/Dense>
 
+#include "aslam/frames/compressed-image.h"
+
 namespace aslam {
 class Camera;
+class ThreadPool;
 
 /// \class VisualFrame
 /// \brief An image and keypoints from a single camera.
@@ -38,6 +44,9 @@ class VisualFrame  {
   /// \brief The descriptor matrix stores descriptors in columns, i.e. the descriptor matrix
   ///        has num_bytes_per_descriptor rows and num_descriptors columns.
   typedef Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> DescriptorsT;
+  /// \brief Floating point descriptors in columns, e.g. of KAZE, with num_floats_per_descriptor
+  ///        rows and num_descriptors columns.
+  typedef Eigen::MatrixXf FloatDescriptorsT;
   typedef Eigen::VectorXd KeypointScoresT;
 
   ASLAM_POINTER_TYPEDEFS(VisualFrame);
@@ -50,6 +59,9 @@ class VisualFrame  {
   virtual ~VisualFrame() {};
 
   /// Copy constructor for clone operation. (Cameras are not cloned!)
+  /// The copy shares the channels with the original, a channel is copied when either frame
+  /// accesses it through a *Mutable(), set*() or swap*() method. Pointers returned by *Mutable()
+  /// before the copy must therefore not be used to modify the frame afterwards.
   VisualFrame(const VisualFrame& other);
   VisualFrame& operator=(const VisualFrame& other);
 
@@ -63,6 +75,15 @@ class VisualFrame  {
     aslam::channels::addChannel<CHANNEL_DATA_TYPE>(channel, &channels_);
   }
 
+  /// Add a channel that is only decoded from the raw data when it is first accessed. The buffer
+  /// owns the memory of the raw data, see ChannelBase::setLazyPayload.
+  template<typename CHANNEL_DATA_TYPE>
+  void addLazyChannel(const std::string& channel,
+                      const aslam::internal::RawChannelData& raw_data,
+                      const std::shared_ptr<const void>& buffer) {
+    aslam::channels::addLazyChannel<CHANNEL_DATA_TYPE>(channel, raw_data, buffer, &channels_);
+  }
+
   /// Are there keypoint measurements stored in this frame?
   bool hasKeypointMeasurements() const;
 
@@ -81,19 +102,35 @@ class VisualFrame  {
   /// Are there descriptors stored in this frame?
   bool hasDescriptors() const;
 
+  /// Are there floating point descriptors stored in this frame?
+  bool hasFloatDescriptors() const;
+
   /// Are there track ids stored in this frame?
   bool hasTrackIds() const;
 
-  /// Is there a raw image stored in this frame?
+  /// Is there a raw image stored in this frame, compressed or not?
   bool hasRawImage() const;
 
+  /// Is the raw image stored compressed?
+  bool hasCompressedRawImage() const;
+
+  /// Is there an image pyramid stored in this frame?
+  bool hasImagePyramid() const;
+
+  /// Are there line segments stored in this frame?
+  bool hasLineSegments() const;
+
+  /// Are there line segment scores stored in this frame?
+  bool hasLineSegmentScores() const;
+
   /// Is a certain channel stored in this frame?
   bool hasChannel(const std::string& channel) const {
     return aslam::channels::hasChannel(channel, channels_);
   }
 
   /// Clears the following channels: KeypointMeasurements, KeypointMeasurementUncertainties,
-  /// KeypointOrientations, KeypointScores, KeypointScales, Descriptors, TrackIds
+  /// KeypointOrientations, KeypointScores, KeypointScales, Descriptors, TrackIds and
+  /// FloatDescriptors if the frame has them
   void clearKeypointChannels();
 
   /// The keypoint measurements stored in a frame.
@@ -119,15 +156,62 @@ class VisualFrame  {
   /// The descriptors stored in a frame.
   const DescriptorsT& getDescriptors() const;
 
+  /// The floating point descriptors stored in a frame.
+  const FloatDescriptorsT& getFloatDescriptors() const;
+
   /// The track ids stored in this frame.
   const Eigen::VectorXi& getTrackIds() const;
 
-  /// The raw image stored in a frame.
+  /// The line segments stored in this frame, every column holds start and end point.
+  const Eigen::Matrix4Xd& getLineSegments() const;
+
+  /// Get the number of line segments stored in this frame.
+  inline size_t getNumLineSegments() const {
+    return static_cast<size_t>(getLineSegments().cols());
+  }
+
+  /// The line segment scores stored in this frame.
+  const Eigen::VectorXd& getLineSegmentScores() const;
+
+  /// The raw image stored in a frame. A compressed raw image is decoded on the first call and
+  /// kept until releaseDecompressedRawImage().
   const cv::Mat& getRawImage() const;
 
+  /// Copy the part of the raw image within the region of interest, which is clipped to the
+  /// image. Of a compressed raw image only the overlapping strips are decoded.
+  /// @return The clipped region of interest.
+  cv::Rect getRawImagePatch(const cv::Rect& roi, cv::Mat* patch) const;
+
   /// Release the raw image. Only if the cv::Mat reference count is 1 the memory will be freed.
   void releaseRawImage();
 
+  /// Keep the raw image losslessly compressed instead of as cv::Mat. If a thread pool is given,
+  /// the image is compressed asynchronously and served uncompressed until then. The compressed
+  /// image is shared with copies of the frame. It is not a channel, hence it is not compared. The
+  /// binary serialization writes it decoded as the raw image channel.
+  void compressRawImage(const CompressedImage::Options& options, ThreadPool* thread_pool);
+  void compressRawImage() { compressRawImage(CompressedImage::Options(), nullptr); }
+
+  /// Drop the decoded copy of a compressed raw image, e.g. after visualizing the frame. This
+  /// invalidates the references returned by getRawImage() of all copies of the frame.
+  void releaseDecompressedRawImage();
+
+  /// The image pyramid stored in a frame, as built by cv::buildOpticalFlowPyramid.
+  const std::vector<cv::Mat>& getImagePyramid() const;
+
+  /// Release the image pyramid.
+  void releaseImagePyramid();
+
+  /// Release the descriptors, the keypoints are kept.
+  void releaseDescriptors();
+
+  /// Remove the channels with one entry per keypoint: KeypointMeasurements,
+  /// KeypointMeasurementUncertainties, KeypointOrientations, KeypointScores, KeypointScales,
+  /// Descriptors, FloatDescriptors and TrackIds. In contrast to clearKeypointChannels() the
+  /// channels are absent afterwards, e.g. such that the tracker creates the track ids of a
+  /// recycled frame anew.
+  void releaseKeypointChannels();
+
   template<typename CHANNEL_DATA_TYPE>
   const CHANNEL_DATA_TYPE& getChannelData(const std::string& channel) const {
     return aslam::channels::getChannelData<CHANNEL_DATA_TYPE>(channel, channels_);
@@ -151,17 +235,26 @@ class VisualFrame  {
   /// A pointer to the descriptors, can be used to swap in new data.
   DescriptorsT* getDescriptorsMutable();
 
+  /// A pointer to the floating point descriptors, can be used to swap in new data.
+  FloatDescriptorsT* getFloatDescriptorsMutable();
+
   /// A pointer to the track ids, can be used to swap in new data.
   Eigen::VectorXi* getTrackIdsMutable();
 
-  /// A pointer to the raw image, can be used to swap in new data.
+  /// A pointer to the raw image, can be used to swap in new data. A compressed raw image is
+  /// decompressed back into the frame.
   cv::Mat* getRawImageMutable();
 
+  /// A pointer to the image pyramid, can be used to swap in new data.
+  std::vector<cv::Mat>* getImagePyramidMutable();
+
   template<typename CHANNEL_DATA_TYPE>
   CHANNEL_DATA_TYPE* getChannelDataMutable(const std::string& channel) const {
+    // The channel map is only modified to detach a shared channel, which is not observable
+    // through the const interface.
     CHANNEL_DATA_TYPE& data =
-        aslam::channels::getChannelData<CHANNEL_DATA_TYPE>(channel,
-                                                           channels_);
+        aslam::channels::getChannelDataMutable<CHANNEL_DATA_TYPE>(
+            channel, const_cast<aslam::channels::ChannelGroup*>(&channels_));
     return &data;
   }
 
@@ -208,22 +301,34 @@ class VisualFrame  {
   /// Replace (copy) the internal descriptors by the passed ones.
   void setDescriptors(const Eigen::Map<const DescriptorsT>& descriptors);
 
+  /// Replace (copy) the internal floating point descriptors by the passed ones.
+  void setFloatDescriptors(const FloatDescriptorsT& descriptors);
+
   /// Replace (copy) the internal track ids by the passed ones.
   void setTrackIds(const Eigen::VectorXi& track_ids);
 
+  /// Replace (copy) the internal line segments by the passed ones.
+  void setLineSegments(const Eigen::Matrix4Xd& line_segments);
+
+  /// Replace (copy) the internal line segment scores by the passed ones.
+  void setLineSegmentScores(const Eigen::VectorXd& scores);
+
   /// Replace (copy) the internal raw image by the passed ones.
   ///        This is a shallow copy by default. Please clone the image if it
   ///        should be owned by the VisualFrame.
   void setRawImage(const cv::Mat& image);
 
+  /// Replace (shallow copy) the internal image pyramid by the passed one.
+  void setImagePyramid(const std::vector<cv::Mat>& image_pyramid);
+
   template<typename CHANNEL_DATA_TYPE>
   void setChannelData(const std::string& channel,
                       const CHANNEL_DATA_TYPE& data_new) {
     if (!aslam::channels::hasChannel(channel, channels_)) {
       aslam::channels::addChannel<CHANNEL_DATA_TYPE>(channel, &channels_);
     }
-    CHANNEL_DATA_TYPE& data =
-        aslam::channels::getChannelData<CHANNEL_DATA_TYPE>(channel, channels_);
+    CHANNEL_DATA_TYPE& data = aslam::channels::getChannelDataMutable<CHANNEL_DATA_TYPE>(
+        channel, &channels_, false);
     data = data_new;
   }
 
@@ -247,9 +352,20 @@ class VisualFrame  {
   /// Replace (swap) the internal descriptors by the passed ones.
   void swapDescriptors(DescriptorsT* descriptors);
 
+  /// Replace (swap) the internal floating point descriptors by the passed ones.
+  void swapFloatDescriptors(FloatDescriptorsT* descriptors);
+
   /// Replace (swap) the internal track ids by the passed ones.
   void swapTrackIds(Eigen::VectorXi* track_ids);
 
+  /// Replace (swap) the internal line segments by the passed ones.
+  /// This method creates the channel if it doesn't exist
+  void swapLineSegments(Eigen::Matrix4Xd* line_segments);
+
+  /// Replace (swap) the internal line segment scores by the passed ones.
+  /// This method creates the channel if it doesn't exist
+  void swapLineSegmentScores(Eigen::VectorXd* scores);
+
   /// Swap channel data with the data passed in. This will only work
   /// if the channel data type has a swap() method.
   template<typename CHANNEL_DATA_TYPE>
@@ -260,7 +376,7 @@ class VisualFrame  {
       aslam::channels::addChannel<CHANNEL_DATA_TYPE>(channel, &channels_);
     }
     CHANNEL_DATA_TYPE& data =
-        aslam::channels::getChannelData<CHANNEL_DATA_TYPE>(channel, channels_);
+        aslam::channels::getChannelDataMutable<CHANNEL_DATA_TYPE>(channel, &channels_);
     data.swap(*data_new);
   }
 
@@ -312,6 +428,16 @@ class VisualFrame  {
       const std::vector<size_t>& keypoint_indices,
       std::vector<unsigned char>* backprojection_success) const;
 
+  /// The normalized bearing vectors of all keypoints. They are computed once with the vectorized
+  /// back-projection and cached until the keypoint measurements or the camera geometry are
+  /// replaced or accessed mutably. Writes through a pointer returned by
+  /// getKeypointMeasurementsMutable() before the bearing vectors were computed are not
+  /// detected; call invalidateNormalizedBearingVectors() after such writes.
+  const Eigen::Matrix3Xd& getNormalizedBearingVectors() const;
+  /// The back-projection success flags of getNormalizedBearingVectors().
+  const std::vector<unsigned char>& getBearingVectorBackprojectionSuccess() const;
+  void invalidateNormalizedBearingVectors();
+
   /// Get the frame id.
   inline const aslam::FrameId& getId() const { return id_; }
 
@@ -338,9 +464,28 @@ class VisualFrame  {
   /// Set the validity flag.
   void setValid(bool is_valid) { is_valid_ = is_valid; }
 
+  /// \brief The shortcuts the pipeline and the tracker took to meet the deadline of the frame,
+  ///        see common::DeadlineScope. Empty if the frame was fully processed. Not compared or
+  ///        serialized.
+  const common::Degradations& getDegradations() const { return degradations_; }
+  void setDegradations(const common::Degradations& degradations) {
+    degradations_ = degradations;
+  }
+  void addDegradations(const common::Degradations& degradations) {
+    degradations_.add(degradations);
+  }
+
   /// Print out a human-readable version of this frame
   void print(std::ostream& out, const std::string& label) const;
 
+  /// \brief Memory of the frame: the channels, the compressed raw image and the cached bearing
+  ///        vectors. The camera geometries are shared and not counted.
+  /// @param[in]  tag    Prefix of the report entries, the channels are added as
+  ///                    "<tag>/<channel name>" and the rest of the frame as "<tag>/other".
+  /// @param[out] report Can be null.
+  size_t getMemoryUsageBytes(const std::string& tag, common::MemoryUsageReport* report) const;
+  size_t getMemoryUsageBytes() const { return getMemoryUsageBytes(std::string(), nullptr); }
+
   /// \brief Creates an empty frame. The following channels are added without any data attached:
   ///        {KeypointMeasurements, KeypointMeasurementUncertainties, Descriptors}
   /// @param[in]  camera                  Camera which will be assigned to the frame.
@@ -349,8 +494,17 @@ class VisualFrame  {
   static VisualFrame::Ptr createEmptyTestVisualFrame(const aslam::Camera::ConstPtr& camera,
                                                      int64_t timestamp_nanoseconds);
 
+  /// Remove the keypoints with an invalid track id (< 0) from all keypoint channels. The
+  /// channels are compacted in place without temporary copies.
   void discardUntrackedObservations(std::vector<size_t>* discarded_indices);
 
+  /// Stable in-place compaction of all keypoint channels: keeps the keypoints whose
+  /// keep_mask entry is true, in their order.
+  void compactKeypointChannels(const std::vector<bool>& keep_mask);
+
+  /// Access all channels, e.g. for serialization. Hold ChannelGroup::m_channels_ while iterating.
+  const aslam::channels::ChannelGroup& getChannelGroup() const { return channels_; }
+
  private:
   /// Timestamp in nanoseconds.
   int64_t timestamp_nanoseconds_;
@@ -359,11 +513,26 @@ class VisualFrame  {
   aslam::channels::ChannelGroup channels_;
   Camera::ConstPtr camera_geometry_;
   Camera::ConstPtr raw_camera_geometry_;
+  /// The raw image if it is kept compressed, it is not a channel then.
+  CompressedImage::Ptr compressed_raw_image_;
 
   /// Validity flag: can be used by an external algorithm to flag frames that should
   /// be excluded/included when processing a list of frames. Does not have any internal
   /// effect on the frame.
   bool is_valid_;
+
+  /// The degradations applied while processing the frame.
+  common::Degradations degradations_;
+
+  struct NormalizedBearingVectors {
+    Eigen::Matrix3Xd bearing_vectors;
+    std::vector<unsigned char> backprojection_success;
+  };
+  /// Lazily computed bearing vectors, shared with copies of the frame until invalidated. Not a
+  /// channel, as it must not take part in comparisons and serialization.
+  std::shared_ptr<const NormalizedBearingVectors> getOrComputeNormalizedBearingVectors() const;
+  mutable std::shared_ptr<const NormalizedBearingVectors> normalized_bearing_vectors_;
+  mutable std::mutex m_normalized_bearing_vectors_;
 };
 
 inline std::ostream& operator<<(std::ostream& out, const VisualFrame& rhs) {
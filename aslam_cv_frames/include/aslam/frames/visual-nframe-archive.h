@@ -0,0 +1,150 @@
+#ifndef ASLAM_FRAMES_VISUAL_NFRAME_ARCHIVE_H_
+#define ASLAM_FRAMES_VISUAL_NFRAME_ARCHIVE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/mapped-file.h>
+#include <aslam/common/unique-id.h>
+#include <aslam/frames/binary-serialization.h>
+
+/// \file
+/// Append-only on-disk archive of VisualNFrames in the binary format of binary-serialization.h.
+///
+/// The archive file <path> starts with a 64 byte header followed by the nframe records in append
+/// order. On close the writer stores the index in <path>.index: a 64 byte header and one
+/// ArchiveIndexEntry per nframe. If the index is missing or stale (e.g. after a crash) the reader
+/// rebuilds it by hopping over the record headers, which does not touch the payloads.
+
+namespace aslam {
+class VisualNFrame;
+
+namespace binary_serialization {
+constexpr uint32_t kArchiveMagic = 0x41564341u;  // "ACVA"
+constexpr uint32_t kArchiveIndexMagic = 0x49564341u;  // "ACVI"
+
+struct ArchiveHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size_bytes;
+  uint64_t reserved[7];
+};
+static_assert(sizeof(ArchiveHeader) == kAlignmentBytes, "Unexpected archive header padding.");
+
+struct ArchiveIndexHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size_bytes;
+  uint64_t num_entries;
+  /// Size of the archive file the index was written for.
+  uint64_t archive_size_bytes;
+  uint64_t reserved[5];
+};
+static_assert(sizeof(ArchiveIndexHeader) == kAlignmentBytes, "Unexpected index header padding.");
+
+struct ArchiveIndexEntry {
+  /// Minimal frame timestamp of the nframe.
+  int64_t timestamp_nanoseconds;
+  uint64_t offset;
+  uint64_t nframe_id[2];
+};
+}  // namespace binary_serialization
+
+/// \class VisualNFrameArchiveWriter
+/// \brief Appends nframes to an archive through a write buffer.
+///
+/// Records are copied into the buffer and written in large sequential chunks; records larger than
+/// the buffer are written directly from the frame memory. Not thread-safe.
+class VisualNFrameArchiveWriter {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(VisualNFrameArchiveWriter);
+  static constexpr size_t kDefaultBufferSizeBytes = 8u * 1024u * 1024u;
+
+  explicit VisualNFrameArchiveWriter(size_t buffer_size_bytes = kDefaultBufferSizeBytes);
+  /// Closes the archive if it is still open.
+  ~VisualNFrameArchiveWriter();
+
+  /// Create or truncate the archive at path. Returns false on an IO error.
+  bool open(const std::string& path);
+  bool isOpen() const { return file_descriptor_ >= 0; }
+
+  /// Append an nframe with at least one frame set. Returns false on an IO error.
+  bool append(const VisualNFrame& nframe);
+  /// Write the buffered records to the file.
+  bool flush();
+  /// Flush, write the index file and close the archive.
+  bool close();
+
+  size_t getNumNFrames() const { return index_.size(); }
+
+ private:
+  bool writeAll(const char* data, size_t size_bytes);
+
+  std::string path_;
+  int file_descriptor_;
+  uint64_t file_size_bytes_;
+
+  std::vector<char> buffer_;
+  size_t buffer_used_bytes_;
+
+  BinaryFrameSerializer serializer_;
+  std::vector<binary_serialization::ArchiveIndexEntry> index_;
+};
+
+/// \class VisualNFrameArchive
+/// \brief Read-only memory mapped access to an archive.
+///
+/// Lookups by id and timestamp are binary searches in the index. The returned views point into
+/// the mapping and are valid until the archive is closed or updated.
+class VisualNFrameArchive {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(VisualNFrameArchive);
+  VisualNFrameArchive();
+  ~VisualNFrameArchive();
+
+  /// Map the archive and load or rebuild its index. Returns false if the file is malformed.
+  bool open(const std::string& path);
+  /// \brief Map the records appended since the archive was opened or last updated, e.g. by a
+  ///        writer that flushed them. Only the headers of the new records are read. Returns
+  ///        false if the file shrank or can't be mapped, the archive is unchanged then.
+  bool update();
+  void close();
+  bool isOpen() const { return mapped_file_.isOpen(); }
+
+  /// Number of nframes, indexed in order of increasing timestamp.
+  size_t getNumNFrames() const { return entries_.size(); }
+  int64_t getTimestampNanoseconds(size_t index) const;
+  aslam::NFramesId getNFrameId(size_t index) const;
+  /// Get the view of the nframe at the given position in timestamp order.
+  void getNFrame(size_t index, BinaryVisualNFrameView* nframe) const;
+
+  /// Returns false if no nframe has the given id. Of several records of the id the last
+  /// appended one is returned.
+  bool findNFrame(const aslam::NFramesId& nframe_id, BinaryVisualNFrameView* nframe) const;
+  /// Position of the first nframe with a timestamp not before the given one, getNumNFrames() if
+  /// there is none.
+  size_t findFirstNFrameNotBefore(int64_t timestamp_nanoseconds) const;
+  /// Position of the nframe with the closest timestamp, the archive must not be empty.
+  size_t findClosestNFrame(int64_t timestamp_nanoseconds) const;
+
+ private:
+  bool loadIndex(const std::string& index_path);
+  /// Index the records from indexed_size_bytes_ to the end of the mapping.
+  void indexRecords();
+  /// Sort the entries after the first num_sorted_entries and merge them into the sorted ones.
+  void sortIndex(size_t num_sorted_entries);
+
+  std::string path_;
+  common::MappedFile mapped_file_;
+  /// The end of the last indexed record.
+  size_t indexed_size_bytes_;
+  /// Entries in timestamp order and positions into entries_ in id order.
+  std::vector<binary_serialization::ArchiveIndexEntry> entries_;
+  std::vector<size_t> entries_by_id_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_FRAMES_VISUAL_NFRAME_ARCHIVE_H_
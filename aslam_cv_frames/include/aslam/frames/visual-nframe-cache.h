@@ -0,0 +1,124 @@
+#ifndef ASLAM_FRAMES_VISUAL_NFRAME_CACHE_H_
+#define ASLAM_FRAMES_VISUAL_NFRAME_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/macros.h>
+#include <aslam/common/unique-id.h>
+#include <aslam/frames/visual-nframe-archive.h>
+#include <aslam/frames/visual-nframe.h>
+
+namespace aslam {
+
+/// \class VisualNFrameCache
+/// \brief Keeps the recently used nframes within a memory budget, with lookups by id and by
+///        timestamp.
+///
+/// The memory of an nframe is taken from VisualNFrame::getMemoryUsageBytes() when it is inserted.
+/// Once the budget is exceeded, the least recently used nframes are stripped first: a copy
+/// without the raw images, the image pyramids and the descriptors replaces them in the cache. The
+/// copy shares the keypoint channels with the original, and the nframes held by the callers are
+/// not modified. Only if all nframes are stripped, the least recently used ones are evicted.
+///
+/// If a spill archive is set, the nframes are appended to it with all their payloads before they
+/// are stripped. getNFrame() then reloads evicted nframes from the archive and getFullNFrame()
+/// restores the payloads of stripped ones. The lookups by timestamp only cover the nframes in
+/// memory. The lookup by id is O(1) and by timestamp O(log n). Thread-safe.
+class VisualNFrameCache {
+ public:
+  ASLAM_POINTER_TYPEDEFS(VisualNFrameCache);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(VisualNFrameCache);
+
+  struct Options {
+    Options() : max_memory_usage_bytes(512u * 1024u * 1024u) {}
+    /// The budget of the cached nframes.
+    size_t max_memory_usage_bytes;
+    /// The archive the nframes spill to, empty to drop the evicted payloads. The archive is
+    /// truncated and only valid for the lifetime of the cache.
+    std::string spill_archive_path;
+  };
+
+  explicit VisualNFrameCache(const Options& options);
+  ~VisualNFrameCache();
+
+  /// \brief Insert an nframe as the most recently used one, replacing an nframe of the same id.
+  ///        The nframe must not be modified while it is cached.
+  void insert(const std::shared_ptr<const VisualNFrame>& nframe);
+
+  /// \brief Get an nframe and mark it as the most recently used one.
+  /// @return The nframe, possibly stripped, or an nframe reloaded from the spill archive. Null if
+  ///         the nframe is not known.
+  std::shared_ptr<const VisualNFrame> getNFrame(const NFramesId& nframe_id);
+
+  /// Same as getNFrame(), and restores the payloads from the spill archive if stripped.
+  std::shared_ptr<const VisualNFrame> getFullNFrame(const NFramesId& nframe_id);
+
+  /// \brief The cached nframe with the minimal frame timestamp closest to the given one, as
+  ///        used by the archive index. Null if the cache is empty.
+  std::shared_ptr<const VisualNFrame> getClosestNFrame(int64_t timestamp_nanoseconds);
+
+  /// The cached nframes with a minimal frame timestamp in [begin, end), in timestamp order.
+  void getNFramesInRange(int64_t begin_timestamp_nanoseconds, int64_t end_timestamp_nanoseconds,
+                         std::vector<std::shared_ptr<const VisualNFrame>>* nframes);
+
+  /// Whether the nframe is in memory.
+  bool hasNFrame(const NFramesId& nframe_id) const;
+  /// Remove the nframe, it is not reloaded from the spill archive afterwards.
+  void erase(const NFramesId& nframe_id);
+  /// Remove all nframes, also from the spill archive.
+  void clear();
+
+  size_t size() const;
+  size_t getNumStrippedNFrames() const;
+  /// The memory of the cached nframes, within the budget after every call.
+  size_t getMemoryUsageBytes() const;
+
+ private:
+  typedef std::list<NFramesId> LruList;
+  typedef std::multimap<int64_t, NFramesId> TimestampIndex;
+  struct Entry {
+    std::shared_ptr<const VisualNFrame> nframe;
+    size_t memory_usage_bytes;
+    bool is_stripped;
+    /// Position in the list of full or stripped nframes, the most recently used first.
+    LruList::iterator lru_position;
+    TimestampIndex::iterator timestamp_position;
+  };
+  typedef std::unordered_map<NFramesId, Entry> EntryMap;
+
+  void insertLocked(const std::shared_ptr<const VisualNFrame>& nframe);
+  void eraseLocked(EntryMap::iterator it);
+  void touchLocked(Entry* entry);
+  void enforceBudgetLocked();
+  void stripLocked(Entry* entry);
+  /// Get the spilled nframe with its payloads, null if it is not in the spill archive.
+  std::shared_ptr<const VisualNFrame> reloadLocked(const NFramesId& nframe_id);
+
+  const Options options_;
+
+  mutable std::mutex mutex_;
+  EntryMap entries_;
+  LruList full_lru_;
+  LruList stripped_lru_;
+  TimestampIndex timestamp_index_;
+  size_t memory_usage_bytes_;
+
+  /// The spilled nframes and their camera rigs, which are not serialized.
+  std::unordered_map<NFramesId, std::shared_ptr<NCamera>> spilled_camera_rigs_;
+  VisualNFrameArchiveWriter spill_writer_;
+  VisualNFrameArchive spill_archive_;
+  /// Whether nframes were spilled since the archive was mapped or updated.
+  bool is_spill_archive_stale_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_FRAMES_VISUAL_NFRAME_CACHE_H_
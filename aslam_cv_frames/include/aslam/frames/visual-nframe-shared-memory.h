@@ -0,0 +1,182 @@
+#ifndef ASLAM_FRAMES_VISUAL_NFRAME_SHARED_MEMORY_H_
+#define ASLAM_FRAMES_VISUAL_NFRAME_SHARED_MEMORY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/mapped-file.h>
+#include <aslam/frames/binary-serialization.h>
+
+/// \file
+/// Publication of VisualNFrames to other processes through a ring of slots in POSIX shared
+/// memory, in the binary format of binary-serialization.h.
+///
+/// The shared memory object starts with a 64 byte ring header followed by num_slots slots. A slot
+/// is a 64 byte slot header and slot_size_bytes of payload holding one nframe record. The n-th
+/// published nframe (starting at 1) goes to slot n % num_slots. Readers pin a slot by
+/// incrementing its reader count, the publisher only overwrites slots without readers and drops
+/// the nframe otherwise. A reader that dies while holding a slot leaves it pinned until the
+/// publisher recreates the ring.
+
+namespace aslam {
+class VisualNFrame;
+
+namespace shared_memory {
+constexpr uint32_t kRingMagic = 0x52564341u;  // "ACVR"
+constexpr uint16_t kRingFormatVersion = 1u;
+/// Set in the reader count of a slot while the publisher writes it.
+constexpr uint32_t kSlotWriterBit = 0x80000000u;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "The atomics shared between processes must be lock-free.");
+
+struct RingHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size_bytes;
+  uint32_t num_slots;
+  uint32_t reserved_0;
+  uint64_t slot_size_bytes;
+  /// Sequence number of the latest published nframe, 0 if none was published yet.
+  std::atomic<uint64_t> latest_sequence;
+  uint64_t reserved_1[4];
+};
+static_assert(sizeof(RingHeader) == binary_serialization::kAlignmentBytes,
+              "Unexpected ring header padding.");
+
+struct SlotHeader {
+  /// Sequence number of the nframe in the slot, 0 while empty or being written.
+  std::atomic<uint64_t> sequence;
+  /// Number of readers holding the slot, kSlotWriterBit while the publisher writes it.
+  std::atomic<uint32_t> reader_count;
+  uint32_t reserved_0;
+  uint64_t record_size_bytes;
+  uint64_t reserved_1[5];
+};
+static_assert(sizeof(SlotHeader) == binary_serialization::kAlignmentBytes,
+              "Unexpected slot header padding.");
+
+inline size_t getSharedMemorySizeBytes(size_t num_slots, size_t slot_size_bytes) {
+  return sizeof(RingHeader) + num_slots * (sizeof(SlotHeader) + slot_size_bytes);
+}
+}  // namespace shared_memory
+
+/// \class VisualNFrameSharedMemoryPublisher
+/// \brief Creates the ring and publishes nframes into it. Only one publisher per ring, not
+///        thread-safe.
+class VisualNFrameSharedMemoryPublisher {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(VisualNFrameSharedMemoryPublisher);
+
+  VisualNFrameSharedMemoryPublisher();
+  /// Closes the ring if it is still open.
+  ~VisualNFrameSharedMemoryPublisher();
+
+  /// Create or replace the shared memory object of the given name (e.g. "/aslam_nframes").
+  /// Returns false on an error.
+  /// \param[in] num_slots       The number of nframes readers can access at the same time.
+  /// \param[in] slot_size_bytes The max. size of a serialized nframe, rounded up to 64 bytes.
+  bool create(const std::string& name, size_t num_slots, size_t slot_size_bytes);
+  /// Unmap and unlink the ring, mapped subscribers keep their mapping.
+  void close();
+  bool isOpen() const { return mapped_file_.isOpen(); }
+
+  /// Copy the nframe into the next slot. Returns false and drops the nframe if it exceeds the
+  /// slot size or if the slot is still held by a reader.
+  bool publish(const VisualNFrame& nframe);
+
+  uint64_t getNumPublished() const { return num_published_; }
+  uint64_t getNumDropped() const { return num_dropped_; }
+
+ private:
+  std::string name_;
+  common::MappedFile mapped_file_;
+  uint64_t next_sequence_;
+  uint64_t num_published_;
+  uint64_t num_dropped_;
+  BinaryFrameSerializer serializer_;
+};
+
+/// \class SharedVisualNFrame
+/// \brief A nframe pinned in a slot of the ring, released on destruction. Movable only.
+///
+/// The views point directly into the shared memory and are valid while the nframe is held.
+class SharedVisualNFrame {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(SharedVisualNFrame);
+  SharedVisualNFrame() : slot_(nullptr), sequence_(0u) {}
+  SharedVisualNFrame(SharedVisualNFrame&& other);
+  SharedVisualNFrame& operator=(SharedVisualNFrame&& other);
+  ~SharedVisualNFrame() { release(); }
+
+  bool isValid() const { return slot_ != nullptr; }
+  /// Unpin the slot, the views must not be used afterwards.
+  void release();
+
+  uint64_t getSequence() const { return sequence_; }
+  const BinaryVisualNFrameView& getNFrame() const {
+    CHECK(isValid());
+    return nframe_;
+  }
+
+ private:
+  friend class VisualNFrameSharedMemorySubscriber;
+
+  shared_memory::SlotHeader* slot_;
+  uint64_t sequence_;
+  BinaryVisualNFrameView nframe_;
+};
+
+/// \class VisualNFrameSharedMemorySubscriber
+/// \brief Maps a ring and reads the published nframes without copying them. Not thread-safe,
+///        use one subscriber per thread.
+class VisualNFrameSharedMemorySubscriber {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(VisualNFrameSharedMemorySubscriber);
+
+  VisualNFrameSharedMemorySubscriber();
+  ~VisualNFrameSharedMemorySubscriber();
+
+  /// Map the ring of the given name. Returns false if it does not exist or is malformed. The
+  /// subscriber starts after the latest nframe published so far.
+  bool open(const std::string& name);
+  /// The held nframes must be released before closing.
+  void close();
+  bool isOpen() const { return mapped_file_.isOpen(); }
+
+  /// Sequence number of the latest published nframe, 0 if there is none.
+  uint64_t getLatestSequence() const;
+
+  /// Get the oldest nframe that was not read yet. Returns false if there is none. Nframes that
+  /// were overwritten before they were read are skipped and counted as missed.
+  bool getNext(SharedVisualNFrame* nframe);
+  /// Get the latest nframe and skip all older ones. Returns false if no new nframe was published
+  /// or if the latest one is malformed, which is skipped and counted as missed.
+  bool getLatest(SharedVisualNFrame* nframe);
+
+  uint64_t getNumMissed() const { return num_missed_; }
+
+ private:
+  enum class AcquireResult {
+    kAcquired,
+    /// The slot holds another nframe or is being written.
+    kBusy,
+    /// The record in the slot is malformed, retrying won't help.
+    kMalformed
+  };
+  /// Pin the slot of the sequence number.
+  AcquireResult acquire(uint64_t sequence, SharedVisualNFrame* nframe) const;
+
+  shared_memory::RingHeader* getRingHeader() const;
+  shared_memory::SlotHeader* getSlotHeader(uint64_t sequence) const;
+
+  common::MappedFile mapped_file_;
+  uint64_t next_sequence_;
+  uint64_t num_missed_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_FRAMES_VISUAL_NFRAME_SHARED_MEMORY_H_
@@ -2,8 +2,10 @@
 #define ASLAM_VISUAL_MULTI_FRAME_H
 
 #include <memory>
+#include <string>
 #include <vector>
 
+#include <aslam/common/channel.h>
 #include <aslam/common/macros.h>
 #include <aslam/common/pose-types.h>
 #include <aslam/common/unique-id.h>
@@ -165,9 +167,35 @@ class VisualNFrame {
 
   /// \brief Iterates over all frames and resets all keypoint channels
   ///        (keypoints, keypoint_uncertainties, track_ids, keypoint_scales, ...)
-  ///        to vectors of length zero.
+  ///        to vectors of length zero. The intra-rig matches are cleared as well.
   void clearKeypointChannelsOfAllFrames();
 
+  /// \brief Are there matches between the keypoints of the cameras of this nframe?
+  bool hasIntraRigMatches() const;
+
+  /// \brief The matches between the keypoints of the cameras of this nframe. One match per
+  ///        column: camera index and keypoint index of the apple, camera index and keypoint
+  ///        index of the banana.
+  const Eigen::Matrix4Xi& getIntraRigMatches() const;
+
+  /// \brief The intra-rig matches, mutable.
+  Eigen::Matrix4Xi* getIntraRigMatchesMutable();
+
+  /// \brief Replace (copy) the intra-rig matches.
+  void setIntraRigMatches(const Eigen::Matrix4Xi& intra_rig_matches);
+
+  /// \brief Remove the intra-rig matches, e.g. when the frames they refer to are unset.
+  void releaseIntraRigMatches();
+
+  /// \brief Memory of the nframe and its frames. Frames shared with other nframes are counted
+  ///        by all of them, the camera system is shared and not counted.
+  /// @param[in]  tag    Prefix of the report entries, the frames are added as "<tag>/frame_<i>"
+  ///                    (see VisualFrame::getMemoryUsageBytes), the channels of the nframe as
+  ///                    "<tag>/<channel name>" and the rest as "<tag>/other".
+  /// @param[out] report Can be null.
+  size_t getMemoryUsageBytes(const std::string& tag, common::MemoryUsageReport* report) const;
+  size_t getMemoryUsageBytes() const { return getMemoryUsageBytes(std::string(), nullptr); }
+
  private:
   /// \brief The unique frame id.
   NFramesId id_;
@@ -177,6 +205,9 @@ class VisualNFrame {
 
   /// \brief The list of individual image frames.
   std::vector<std::shared_ptr<VisualFrame>> frames_;
+
+  /// \brief The data attached to the nframe as a whole, e.g. the intra-rig matches.
+  aslam::channels::ChannelGroup channels_;
 };
 
 } // namespace aslam
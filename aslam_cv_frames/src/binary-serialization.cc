@@ -0,0 +1,467 @@
+#include "aslam/frames/binary-serialization.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include <aslam/common/channel-serialization.h>
+#include <aslam/common/channel.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+
+namespace aslam {
+using namespace binary_serialization;  // NOLINT
+
+namespace {
+const char kZeroPadding[kAlignmentBytes] = {0};
+
+bool isAligned(size_t offset) {
+  return offset % kAlignmentBytes == 0u;
+}
+
+/// Whether the payload size of a channel matches its dimensions and element type.
+bool hasConsistentSize(const BinaryChannelEntry& entry) {
+  if (entry.depth > CV_64F || entry.channels == 0u || entry.channels > CV_CN_MAX) {
+    return false;
+  }
+  const uint64_t element_size_bytes =
+      CV_ELEM_SIZE(CV_MAKETYPE(static_cast<int>(entry.depth), static_cast<int>(entry.channels)));
+  return static_cast<uint64_t>(entry.rows) * entry.cols * element_size_bytes == entry.size_bytes;
+}
+}  // namespace
+
+void BinaryFrameSerializer::reset() {
+  num_used_header_buffers_ = 0u;
+  io_vectors_.clear();
+  total_size_bytes_ = 0u;
+}
+
+std::vector<char>* BinaryFrameSerializer::newHeaderBuffer(size_t size_bytes) {
+  if (num_used_header_buffers_ == header_buffers_.size()) {
+    header_buffers_.emplace_back();
+  }
+  std::vector<char>* buffer = &header_buffers_[num_used_header_buffers_++];
+  buffer->assign(size_bytes, 0);
+  return buffer;
+}
+
+void BinaryFrameSerializer::appendIoVector(const void* data, size_t size_bytes) {
+  if (size_bytes == 0u) {
+    return;
+  }
+  iovec io_vector;
+  io_vector.iov_base = const_cast<void*>(data);
+  io_vector.iov_len = size_bytes;
+  io_vectors_.push_back(io_vector);
+  total_size_bytes_ += size_bytes;
+}
+
+void BinaryFrameSerializer::appendPadding(size_t size_bytes) {
+  CHECK_LT(size_bytes, kAlignmentBytes);
+  appendIoVector(kZeroPadding, size_bytes);
+}
+
+void BinaryFrameSerializer::serializeVisualFrame(const VisualFrame& frame) {
+  reset();
+  appendVisualFrame(frame);
+}
+
+void BinaryFrameSerializer::appendVisualFrame(const VisualFrame& frame) {
+  const size_t frame_begin = total_size_bytes_;
+  CHECK(isAligned(frame_begin));
+  const channels::ChannelGroup& channel_group = frame.getChannelGroup();
+  std::lock_guard<std::mutex> lock(channel_group.m_channels_);
+
+  struct ChannelPayload {
+    std::string name;
+    internal::RawChannelData raw_data;
+  };
+  std::vector<ChannelPayload> payloads;
+  payloads.reserve(channel_group.channels_.size());
+  for (const channels::ChannelMap::value_type& name_and_channel : channel_group.channels_) {
+    ChannelPayload payload;
+    payload.name = name_and_channel.first;
+    if (!CHECK_NOTNULL(name_and_channel.second.get())->getRawData(&payload.raw_data)) {
+      VLOG(3) << "Skipping channel " << payload.name << " without contiguous storage.";
+      continue;
+    }
+    CHECK_LE(payload.name.size(), kMaxChannelNameLength)
+        << "The name of channel " << payload.name << " is too long for the binary format.";
+    payloads.push_back(payload);
+  }
+  // A compressed raw image is not a channel. It is written decoded as the raw image channel,
+  // hence the record reads back like the frame before compressRawImage().
+  if (frame.hasCompressedRawImage() &&
+      channel_group.channels_.count(channels::RAW_IMAGE_CHANNEL) == 0u) {
+    ChannelPayload payload;
+    payload.name = channels::RAW_IMAGE_CHANNEL;
+    if (internal::getRawChannelData(frame.getRawImage(), &payload.raw_data)) {
+      payloads.push_back(payload);
+    } else {
+      VLOG(3) << "Skipping the compressed raw image, its source has no contiguous storage.";
+    }
+  }
+  // Sort for a deterministic layout independent of the hash map order.
+  std::sort(payloads.begin(), payloads.end(),
+            [](const ChannelPayload& lhs, const ChannelPayload& rhs) {
+    return lhs.name < rhs.name;
+  });
+
+  const size_t header_size_bytes =
+      sizeof(BinaryFrameHeader) + payloads.size() * sizeof(BinaryChannelEntry);
+  std::vector<char>* header_buffer = newHeaderBuffer(header_size_bytes);
+  BinaryFrameHeader* header = reinterpret_cast<BinaryFrameHeader*>(header_buffer->data());
+  BinaryChannelEntry* entries =
+      reinterpret_cast<BinaryChannelEntry*>(header_buffer->data() + sizeof(BinaryFrameHeader));
+
+  header->magic = kFrameMagic;
+  header->version = kFormatVersion;
+  header->header_size_bytes = static_cast<uint16_t>(sizeof(BinaryFrameHeader));
+  header->num_channels = static_cast<uint32_t>(payloads.size());
+  header->is_valid = frame.isValid() ? 1u : 0u;
+  header->timestamp_nanoseconds = frame.getTimestampNanoseconds();
+  frame.getId().toUint64(header->frame_id);
+  if (frame.getCameraGeometry()) {
+    frame.getCameraGeometry()->getId().toUint64(header->camera_id);
+  }
+  appendIoVector(header_buffer->data(), header_size_bytes);
+
+  size_t offset = header_size_bytes;
+  for (size_t i = 0u; i < payloads.size(); ++i) {
+    const internal::RawChannelData& raw_data = payloads[i].raw_data;
+    BinaryChannelEntry& entry = entries[i];
+    std::strncpy(entry.name, payloads[i].name.c_str(), kMaxChannelNameLength);
+    entry.offset = alignSize(offset);
+    entry.size_bytes = raw_data.size_bytes;
+    entry.rows = raw_data.rows;
+    entry.cols = raw_data.cols;
+    entry.depth = static_cast<uint16_t>(raw_data.depth);
+    entry.channels = static_cast<uint8_t>(raw_data.channels);
+    entry.column_major = raw_data.column_major ? 1u : 0u;
+
+    appendPadding(entry.offset - offset);
+    appendIoVector(raw_data.data, raw_data.size_bytes);
+    offset = entry.offset + raw_data.size_bytes;
+  }
+  const size_t frame_size_bytes = alignSize(offset);
+  appendPadding(frame_size_bytes - offset);
+  header->total_size_bytes = frame_size_bytes;
+  CHECK_EQ(total_size_bytes_ - frame_begin, frame_size_bytes);
+}
+
+void BinaryFrameSerializer::serializeVisualNFrame(const VisualNFrame& nframe) {
+  reset();
+  const size_t num_frames = nframe.getNumFrames();
+  const size_t header_size_bytes =
+      alignSize(sizeof(BinaryNFrameHeader) + num_frames * sizeof(uint64_t));
+  std::vector<char>* header_buffer = newHeaderBuffer(header_size_bytes);
+  BinaryNFrameHeader* header = reinterpret_cast<BinaryNFrameHeader*>(header_buffer->data());
+  uint64_t* frame_offsets =
+      reinterpret_cast<uint64_t*>(header_buffer->data() + sizeof(BinaryNFrameHeader));
+  header->magic = kNFrameMagic;
+  header->version = kFormatVersion;
+  header->header_size_bytes = static_cast<uint16_t>(sizeof(BinaryNFrameHeader));
+  header->num_frames = static_cast<uint32_t>(num_frames);
+  nframe.getId().toUint64(header->nframe_id);
+  appendIoVector(header_buffer->data(), header_size_bytes);
+
+  for (size_t i = 0u; i < num_frames; ++i) {
+    if (!nframe.isFrameSet(i)) {
+      frame_offsets[i] = 0u;
+      continue;
+    }
+    frame_offsets[i] = total_size_bytes_;
+    appendVisualFrame(nframe.getFrame(i));
+  }
+  header->total_size_bytes = total_size_bytes_;
+}
+
+bool BinaryFrameSerializer::writeToFileDescriptor(int file_descriptor) const {
+  CHECK_GE(file_descriptor, 0);
+  // Work on a copy as partial writes advance the iovecs.
+  std::vector<iovec> remaining(io_vectors_);
+  size_t first = 0u;
+  while (first < remaining.size()) {
+    const int num_io_vectors = static_cast<int>(std::min<size_t>(remaining.size() - first,
+                                                                 IOV_MAX));
+    const ssize_t num_written = ::writev(file_descriptor, &remaining[first], num_io_vectors);
+    if (num_written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(ERROR) << "writev failed: " << std::strerror(errno);
+      return false;
+    }
+    size_t num_bytes = static_cast<size_t>(num_written);
+    while (first < remaining.size() && num_bytes >= remaining[first].iov_len) {
+      num_bytes -= remaining[first].iov_len;
+      ++first;
+    }
+    if (num_bytes > 0u) {
+      remaining[first].iov_base = static_cast<char*>(remaining[first].iov_base) + num_bytes;
+      remaining[first].iov_len -= num_bytes;
+    }
+  }
+  return true;
+}
+
+bool BinaryFrameSerializer::writeToSink(internal::SerializationSink* sink) const {
+  CHECK_NOTNULL(sink);
+  for (const iovec& io_vector : io_vectors_) {
+    if (!sink->writePersistent(static_cast<const char*>(io_vector.iov_base),
+                               io_vector.iov_len)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool BinaryFrameSerializer::writeToStream(std::ostream* stream) const {
+  internal::StreamSerializationSink sink(stream);
+  return writeToSink(&sink);
+}
+
+void BinaryFrameSerializer::copyToBuffer(char* buffer) const {
+  internal::BufferSerializationSink sink(buffer, total_size_bytes_);
+  CHECK(writeToSink(&sink));
+}
+
+bool BinaryVisualFrameView::init(const char* data, size_t size_bytes) {
+  CHECK_NOTNULL(data);
+  data_ = nullptr;
+  size_bytes_ = 0u;
+  if (size_bytes < sizeof(BinaryFrameHeader)) {
+    LOG(ERROR) << "Buffer too small for a frame header.";
+    return false;
+  }
+  const BinaryFrameHeader* header = reinterpret_cast<const BinaryFrameHeader*>(data);
+  if (header->magic != kFrameMagic || header->version != kFormatVersion ||
+      header->header_size_bytes != sizeof(BinaryFrameHeader)) {
+    LOG(ERROR) << "Not a frame of binary format version " << kFormatVersion << ".";
+    return false;
+  }
+  if (header->total_size_bytes > size_bytes ||
+      sizeof(BinaryFrameHeader) + header->num_channels * sizeof(BinaryChannelEntry) >
+      header->total_size_bytes) {
+    LOG(ERROR) << "Truncated frame.";
+    return false;
+  }
+  const BinaryChannelEntry* entries =
+      reinterpret_cast<const BinaryChannelEntry*>(data + sizeof(BinaryFrameHeader));
+  for (size_t i = 0u; i < header->num_channels; ++i) {
+    const BinaryChannelEntry& entry = entries[i];
+    if (entry.name[kMaxChannelNameLength] != '\0' || !isAligned(entry.offset) ||
+        entry.offset > header->total_size_bytes ||
+        entry.size_bytes > header->total_size_bytes - entry.offset ||
+        !hasConsistentSize(entry)) {
+      LOG(ERROR) << "Malformed channel entry " << i << ".";
+      return false;
+    }
+  }
+  data_ = data;
+  size_bytes_ = header->total_size_bytes;
+  return true;
+}
+
+const BinaryFrameHeader& BinaryVisualFrameView::getHeader() const {
+  CHECK_NOTNULL(data_);
+  return *reinterpret_cast<const BinaryFrameHeader*>(data_);
+}
+
+aslam::FrameId BinaryVisualFrameView::getId() const {
+  aslam::FrameId id;
+  id.fromUint64(getHeader().frame_id);
+  return id;
+}
+
+aslam::CameraId BinaryVisualFrameView::getCameraId() const {
+  aslam::CameraId id;
+  id.fromUint64(getHeader().camera_id);
+  return id;
+}
+
+std::string BinaryVisualFrameView::getChannelName(size_t channel_index) const {
+  CHECK_LT(channel_index, getNumChannels());
+  const BinaryChannelEntry* entries =
+      reinterpret_cast<const BinaryChannelEntry*>(data_ + sizeof(BinaryFrameHeader));
+  return std::string(entries[channel_index].name);
+}
+
+const BinaryChannelEntry* BinaryVisualFrameView::findChannel(const std::string& name) const {
+  const BinaryChannelEntry* entries =
+      reinterpret_cast<const BinaryChannelEntry*>(data_ + sizeof(BinaryFrameHeader));
+  for (size_t i = 0u; i < getNumChannels(); ++i) {
+    if (name == entries[i].name) {
+      return &entries[i];
+    }
+  }
+  return nullptr;
+}
+
+bool BinaryVisualFrameView::hasChannel(const std::string& name) const {
+  return findChannel(name) != nullptr;
+}
+
+cv::Mat BinaryVisualFrameView::getImageChannel(const std::string& name) const {
+  const BinaryChannelEntry* entry = findChannel(name);
+  CHECK(entry != nullptr) << "The frame has no channel " << name << ".";
+  CHECK(!entry->column_major) << "Channel " << name << " is not an image.";
+  if (entry->size_bytes == 0u) {
+    return cv::Mat();
+  }
+  return cv::Mat(entry->rows, entry->cols, CV_MAKETYPE(entry->depth, entry->channels),
+                 const_cast<char*>(data_ + entry->offset));
+}
+
+void BinaryVisualFrameView::copyToVisualFrame(VisualFrame* frame) const {
+  CHECK_NOTNULL(frame);
+  frame->setId(getId());
+  frame->setTimestampNanoseconds(getTimestampNanoseconds());
+  frame->setValid(isValid());
+  if (hasChannel("VISUAL_KEYPOINT_MEASUREMENTS")) {
+    frame->setKeypointMeasurements(getMatrixChannel<double>("VISUAL_KEYPOINT_MEASUREMENTS"));
+  }
+  if (hasChannel("VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES")) {
+    frame->setKeypointMeasurementUncertainties(
+        getMatrixChannel<double>("VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES"));
+  }
+  if (hasChannel("VISUAL_KEYPOINT_ORIENTATIONS")) {
+    frame->setKeypointOrientations(getMatrixChannel<double>("VISUAL_KEYPOINT_ORIENTATIONS"));
+  }
+  if (hasChannel("VISUAL_KEYPOINT_SCORES")) {
+    frame->setKeypointScores(getMatrixChannel<double>("VISUAL_KEYPOINT_SCORES"));
+  }
+  if (hasChannel("VISUAL_KEYPOINT_SCALES")) {
+    frame->setKeypointScales(getMatrixChannel<double>("VISUAL_KEYPOINT_SCALES"));
+  }
+  if (hasChannel("DESCRIPTORS")) {
+    frame->setDescriptors(getMatrixChannel<unsigned char>("DESCRIPTORS"));
+  }
+  if (hasChannel("FLOAT_DESCRIPTORS")) {
+    frame->setFloatDescriptors(getMatrixChannel<float>("FLOAT_DESCRIPTORS"));
+  }
+  if (hasChannel("TRACK_IDS")) {
+    frame->setTrackIds(getMatrixChannel<int>("TRACK_IDS"));
+  }
+  if (hasChannel("VISUAL_LINE_SEGMENTS")) {
+    frame->setLineSegments(getMatrixChannel<double>("VISUAL_LINE_SEGMENTS"));
+  }
+  if (hasChannel("VISUAL_LINE_SEGMENT_SCORES")) {
+    frame->setLineSegmentScores(getMatrixChannel<double>("VISUAL_LINE_SEGMENT_SCORES"));
+  }
+  if (hasChannel("RAW_IMAGE")) {
+    frame->setRawImage(getImageChannel("RAW_IMAGE").clone());
+  }
+}
+
+template <typename CHANNEL_DATA_TYPE>
+void BinaryVisualFrameView::addLazyChannel(const std::string& name,
+                                           const std::shared_ptr<const void>& buffer,
+                                           VisualFrame* frame) const {
+  const BinaryChannelEntry* entry = findChannel(name);
+  if (entry == nullptr) {
+    return;
+  }
+  internal::RawChannelData raw_data;
+  raw_data.data = data_ + entry->offset;
+  raw_data.size_bytes = entry->size_bytes;
+  raw_data.rows = entry->rows;
+  raw_data.cols = entry->cols;
+  raw_data.depth = entry->depth;
+  raw_data.channels = entry->channels;
+  raw_data.column_major = entry->column_major != 0u;
+  frame->addLazyChannel<CHANNEL_DATA_TYPE>(name, raw_data, buffer);
+}
+
+void BinaryVisualFrameView::createLazyVisualFrame(const std::shared_ptr<const void>& buffer,
+                                                  VisualFrame* frame) const {
+  CHECK(buffer);
+  CHECK_NOTNULL(frame);
+  frame->setId(getId());
+  frame->setTimestampNanoseconds(getTimestampNanoseconds());
+  frame->setValid(isValid());
+  addLazyChannel<Eigen::Matrix2Xd>("VISUAL_KEYPOINT_MEASUREMENTS", buffer, frame);
+  addLazyChannel<Eigen::VectorXd>("VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES", buffer, frame);
+  addLazyChannel<Eigen::VectorXd>("VISUAL_KEYPOINT_ORIENTATIONS", buffer, frame);
+  addLazyChannel<Eigen::VectorXd>("VISUAL_KEYPOINT_SCORES", buffer, frame);
+  addLazyChannel<Eigen::VectorXd>("VISUAL_KEYPOINT_SCALES", buffer, frame);
+  addLazyChannel<VisualFrame::DescriptorsT>("DESCRIPTORS", buffer, frame);
+  addLazyChannel<VisualFrame::FloatDescriptorsT>("FLOAT_DESCRIPTORS", buffer, frame);
+  addLazyChannel<Eigen::VectorXi>("TRACK_IDS", buffer, frame);
+  addLazyChannel<Eigen::Matrix4Xd>("VISUAL_LINE_SEGMENTS", buffer, frame);
+  addLazyChannel<Eigen::VectorXd>("VISUAL_LINE_SEGMENT_SCORES", buffer, frame);
+  addLazyChannel<cv::Mat>("RAW_IMAGE", buffer, frame);
+}
+
+bool BinaryVisualNFrameView::init(const char* data, size_t size_bytes) {
+  CHECK_NOTNULL(data);
+  data_ = nullptr;
+  size_bytes_ = 0u;
+  frames_.clear();
+  if (size_bytes < sizeof(BinaryNFrameHeader)) {
+    LOG(ERROR) << "Buffer too small for an nframe header.";
+    return false;
+  }
+  const BinaryNFrameHeader* header = reinterpret_cast<const BinaryNFrameHeader*>(data);
+  if (header->magic != kNFrameMagic || header->version != kFormatVersion ||
+      header->header_size_bytes != sizeof(BinaryNFrameHeader)) {
+    LOG(ERROR) << "Not an nframe of binary format version " << kFormatVersion << ".";
+    return false;
+  }
+  if (header->total_size_bytes > size_bytes ||
+      sizeof(BinaryNFrameHeader) + header->num_frames * sizeof(uint64_t) >
+      header->total_size_bytes) {
+    LOG(ERROR) << "Truncated nframe.";
+    return false;
+  }
+  const uint64_t* frame_offsets =
+      reinterpret_cast<const uint64_t*>(data + sizeof(BinaryNFrameHeader));
+  frames_.resize(header->num_frames);
+  for (size_t i = 0u; i < header->num_frames; ++i) {
+    if (frame_offsets[i] == 0u) {
+      continue;
+    }
+    if (!isAligned(frame_offsets[i]) || frame_offsets[i] >= header->total_size_bytes ||
+        !frames_[i].init(data + frame_offsets[i], header->total_size_bytes - frame_offsets[i])) {
+      LOG(ERROR) << "Malformed frame " << i << ".";
+      frames_.clear();
+      return false;
+    }
+  }
+  data_ = data;
+  size_bytes_ = header->total_size_bytes;
+  return true;
+}
+
+aslam::NFramesId BinaryVisualNFrameView::getId() const {
+  CHECK_NOTNULL(data_);
+  aslam::NFramesId id;
+  id.fromUint64(reinterpret_cast<const BinaryNFrameHeader*>(data_)->nframe_id);
+  return id;
+}
+
+size_t BinaryVisualNFrameView::getNumFrames() const {
+  return frames_.size();
+}
+
+size_t BinaryVisualNFrameView::getTotalSizeBytes() const {
+  return size_bytes_;
+}
+
+bool BinaryVisualNFrameView::isFrameSet(size_t frame_index) const {
+  CHECK_LT(frame_index, frames_.size());
+  const uint64_t* frame_offsets =
+      reinterpret_cast<const uint64_t*>(data_ + sizeof(BinaryNFrameHeader));
+  return frame_offsets[frame_index] != 0u;
+}
+
+const BinaryVisualFrameView& BinaryVisualNFrameView::getFrame(size_t frame_index) const {
+  CHECK(isFrameSet(frame_index)) << "Frame " << frame_index << " is not set.";
+  return frames_[frame_index];
+}
+
+}  // namespace aslam
@@ -0,0 +1,31 @@
+#include "aslam/frames/compact-feature-tracks.h"
+
+namespace aslam {
+
+size_t VisualNFramePool::addNFrame(const std::shared_ptr<const VisualNFrame>& nframe) {
+  CHECK(nframe);
+  nframes_.push_back(nframe);
+  return getEndIndex() - 1u;
+}
+
+void VisualNFramePool::releaseNFramesBefore(size_t nframe_index) {
+  while (!nframes_.empty() && first_index_ < nframe_index) {
+    nframes_.pop_front();
+    ++first_index_;
+  }
+}
+
+FeatureTrack CompactFeatureTracks::getFeatureTrack(
+    size_t track_index, const VisualNFramePool& nframe_pool) const {
+  const TrackRange& track = getTrack(track_index);
+  FeatureTrack feature_track(track.track_id, track.length);
+  const CompactKeypointIdentifier* observations = observations_.data() + track.begin;
+  for (size_t i = 0u; i < track.length; ++i) {
+    feature_track.addKeypointObservationAtBack(
+        nframe_pool.getNFrameShared(observations[i].nframe_index),
+        observations[i].frame_index, observations[i].keypoint_index);
+  }
+  return feature_track;
+}
+
+}  // namespace aslam
@@ -0,0 +1,145 @@
+#include "aslam/frames/compressed-image.h"
+
+#include <algorithm>
+
+#include <aslam/common/memory-usage.h>
+#include <glog/logging.h>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+
+namespace aslam {
+
+CompressedImage::CompressedImage(const cv::Mat& image, const Options& options)
+    : options_(options), size_(image.size()), type_(image.type()), source_image_(image),
+      is_compressed_(false) {
+  CHECK(!image.empty());
+  CHECK(image.depth() == CV_8U || image.depth() == CV_16U)
+      << "Only 8 and 16 bit images can be compressed.";
+  CHECK(image.channels() == 1 || image.channels() == 3 || image.channels() == 4);
+  CHECK_GE(options_.png_compression_level, 0);
+  CHECK_LE(options_.png_compression_level, 9);
+  CHECK_GT(options_.strip_height_px, 0u);
+}
+
+void CompressedImage::compress() {
+  cv::Mat source_image;
+  {
+    std::lock_guard<std::mutex> lock(m_image_);
+    if (is_compressed_) {
+      return;
+    }
+    source_image = source_image_;
+  }
+
+  // The source is immutable, hence it is encoded without holding the lock.
+  const std::vector<int> parameters = {cv::IMWRITE_PNG_COMPRESSION,
+                                       options_.png_compression_level};
+  const int strip_height_px = static_cast<int>(options_.strip_height_px);
+  std::vector<std::vector<uchar>> strips;
+  strips.reserve((size_.height + strip_height_px - 1) / strip_height_px);
+  for (int row = 0; row < size_.height; row += strip_height_px) {
+    const cv::Mat strip = source_image.rowRange(row, std::min(row + strip_height_px, size_.height));
+    strips.emplace_back();
+    CHECK(cv::imencode(".png", strip, strips.back(), parameters));
+  }
+
+  std::lock_guard<std::mutex> lock(m_image_);
+  if (is_compressed_) {
+    return;
+  }
+  strips_.swap(strips);
+  is_compressed_ = true;
+  // The memory is only freed if no decoded image or other frame shares it.
+  source_image_.release();
+}
+
+bool CompressedImage::isCompressed() const {
+  std::lock_guard<std::mutex> lock(m_image_);
+  return is_compressed_;
+}
+
+const cv::Mat& CompressedImage::getImage() const {
+  std::lock_guard<std::mutex> lock(m_image_);
+  if (decoded_image_.empty()) {
+    if (!is_compressed_) {
+      decoded_image_ = source_image_;
+    } else {
+      decoded_image_.create(size_, type_);
+      for (size_t strip_idx = 0u; strip_idx < strips_.size(); ++strip_idx) {
+        const int row = static_cast<int>(strip_idx * options_.strip_height_px);
+        cv::Mat strip = decoded_image_.rowRange(
+            row, std::min(row + static_cast<int>(options_.strip_height_px), size_.height));
+        decodeStrip(strip_idx, &strip);
+      }
+    }
+  }
+  return decoded_image_;
+}
+
+void CompressedImage::releaseDecodedImage() {
+  std::lock_guard<std::mutex> lock(m_image_);
+  decoded_image_.release();
+}
+
+cv::Rect CompressedImage::getPatch(const cv::Rect& roi, cv::Mat* patch) const {
+  CHECK_NOTNULL(patch);
+  const cv::Rect clipped_roi = roi & cv::Rect(cv::Point(0, 0), size_);
+  if (clipped_roi.area() == 0) {
+    patch->release();
+    return clipped_roi;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_image_);
+    if (!decoded_image_.empty()) {
+      decoded_image_(clipped_roi).copyTo(*patch);
+      return clipped_roi;
+    }
+    if (!is_compressed_) {
+      source_image_(clipped_roi).copyTo(*patch);
+      return clipped_roi;
+    }
+  }
+
+  // The strips don't change after compression, only the ones overlapping the patch are decoded.
+  patch->create(clipped_roi.size(), type_);
+  const int strip_height_px = static_cast<int>(options_.strip_height_px);
+  const size_t first_strip_idx = clipped_roi.y / strip_height_px;
+  const size_t last_strip_idx = (clipped_roi.br().y - 1) / strip_height_px;
+  for (size_t strip_idx = first_strip_idx; strip_idx <= last_strip_idx; ++strip_idx) {
+    cv::Mat strip;
+    decodeStrip(strip_idx, &strip);
+    const int strip_row = static_cast<int>(strip_idx) * strip_height_px;
+    const int begin_row = std::max(clipped_roi.y, strip_row);
+    const int end_row = std::min(clipped_roi.br().y, strip_row + strip.rows);
+    strip(cv::Rect(clipped_roi.x, begin_row - strip_row, clipped_roi.width, end_row - begin_row))
+        .copyTo(patch->rowRange(begin_row - clipped_roi.y, end_row - clipped_roi.y));
+  }
+  return clipped_roi;
+}
+
+size_t CompressedImage::getCompressedSizeBytes() const {
+  std::lock_guard<std::mutex> lock(m_image_);
+  size_t size_bytes = 0u;
+  for (const std::vector<uchar>& strip : strips_) {
+    size_bytes += strip.size();
+  }
+  return size_bytes;
+}
+
+size_t CompressedImage::getMemoryUsageBytes() const {
+  std::lock_guard<std::mutex> lock(m_image_);
+  return sizeof(*this) + common::getMemoryUsageBytes(source_image_) +
+      common::getMemoryUsageBytes(decoded_image_) + common::getMemoryUsageBytes(strips_);
+}
+
+void CompressedImage::decodeStrip(size_t strip_idx, cv::Mat* strip) const {
+  CHECK_NOTNULL(strip);
+  CHECK_LT(strip_idx, strips_.size());
+  const uchar* strip_data = strip->data;
+  // Decodes in place if the strip has the size and type of the encoded one.
+  cv::imdecode(strips_[strip_idx], cv::IMREAD_UNCHANGED, strip);
+  CHECK_EQ(strip->type(), type_);
+  CHECK_EQ(strip->cols, size_.width);
+  CHECK(strip_data == nullptr || strip->data == strip_data) << "The strip was reallocated.";
+}
+
+}  // namespace aslam
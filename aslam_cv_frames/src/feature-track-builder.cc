@@ -0,0 +1,129 @@
+#include "aslam/frames/feature-track-builder.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <glog/logging.h>
+
+namespace aslam {
+
+void FeatureTrackBuilder::addNFrame(const std::shared_ptr<const VisualNFrame>& nframe,
+                                    std::vector<FeatureTracks>* terminated_tracks) {
+  CHECK(nframe);
+  CHECK_NOTNULL(terminated_tracks);
+  if (num_cameras_ == 0u) {
+    num_cameras_ = nframe->getNumCameras();
+    track_id_to_slot_.resize(num_cameras_);
+  }
+  CHECK_EQ(num_cameras_, nframe->getNumCameras());
+  prepareOutput(terminated_tracks);
+
+  const size_t nframe_index = nframe_pool_.addNFrame(nframe);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras_; ++camera_idx) {
+    CHECK(nframe->isFrameSet(camera_idx));
+    const VisualFrame& frame = nframe->getFrame(camera_idx);
+    CHECK(frame.hasTrackIds());
+    const Eigen::VectorXi& track_ids = frame.getTrackIds();
+    TrackIdToSlotMap& track_id_to_slot = track_id_to_slot_[camera_idx];
+
+    for (int keypoint_idx = 0; keypoint_idx < track_ids.rows(); ++keypoint_idx) {
+      const int track_id = track_ids(keypoint_idx);
+      // Skip unassociated keypoints.
+      if (track_id < 0) {
+        continue;
+      }
+      size_t slot_idx;
+      TrackIdToSlotMap::const_iterator it = track_id_to_slot.find(track_id);
+      if (it == track_id_to_slot.end()) {
+        slot_idx = acquireSlot(track_id, camera_idx);
+        track_id_to_slot.emplace(track_id, slot_idx);
+        live_slots_.push_back(slot_idx);
+      } else {
+        slot_idx = it->second;
+      }
+
+      TrackSlot& slot = slots_[slot_idx];
+      CHECK_NE(slot.last_nframe_index, nframe_index) << "The track id " << track_id
+          << " appears more than once in camera " << camera_idx << ".";
+      CompactKeypointIdentifier keypoint;
+      keypoint.nframe_index = static_cast<uint32_t>(nframe_index);
+      keypoint.frame_index = static_cast<uint32_t>(camera_idx);
+      keypoint.keypoint_index = static_cast<uint32_t>(keypoint_idx);
+      slot.observations.push_back(keypoint);
+      slot.last_nframe_index = nframe_index;
+    }
+  }
+
+  // Emit the tracks that were not continued and find the oldest nframe still in use.
+  size_t oldest_nframe_index_in_use = nframe_index;
+  size_t num_live_slots = 0u;
+  for (const size_t slot_idx : live_slots_) {
+    const TrackSlot& slot = slots_[slot_idx];
+    if (slot.last_nframe_index == nframe_index) {
+      live_slots_[num_live_slots++] = slot_idx;
+      oldest_nframe_index_in_use = std::min<size_t>(
+          oldest_nframe_index_in_use, slot.observations.front().nframe_index);
+    } else {
+      emitTrack(slot, terminated_tracks);
+      track_id_to_slot_[slot.camera_index].erase(slot.track_id);
+      free_slots_.push_back(slot_idx);
+    }
+  }
+  live_slots_.resize(num_live_slots);
+  nframe_pool_.releaseNFramesBefore(oldest_nframe_index_in_use);
+}
+
+void FeatureTrackBuilder::terminateAllTracks(std::vector<FeatureTracks>* terminated_tracks) {
+  CHECK_NOTNULL(terminated_tracks);
+  prepareOutput(terminated_tracks);
+  for (const size_t slot_idx : live_slots_) {
+    emitTrack(slots_[slot_idx], terminated_tracks);
+    free_slots_.push_back(slot_idx);
+  }
+  live_slots_.clear();
+  for (TrackIdToSlotMap& track_id_to_slot : track_id_to_slot_) {
+    track_id_to_slot.clear();
+  }
+  nframe_pool_.releaseNFramesBefore(nframe_pool_.getEndIndex());
+}
+
+size_t FeatureTrackBuilder::acquireSlot(int track_id, size_t camera_index) {
+  size_t slot_idx;
+  if (free_slots_.empty()) {
+    slot_idx = slots_.size();
+    slots_.emplace_back();
+  } else {
+    // Reuse the memory of a terminated track.
+    slot_idx = free_slots_.back();
+    free_slots_.pop_back();
+  }
+  TrackSlot& slot = slots_[slot_idx];
+  slot.track_id = track_id;
+  slot.camera_index = camera_index;
+  slot.last_nframe_index = std::numeric_limits<size_t>::max();
+  slot.observations.clear();
+  return slot_idx;
+}
+
+void FeatureTrackBuilder::emitTrack(
+    const TrackSlot& slot, std::vector<FeatureTracks>* terminated_tracks) const {
+  CHECK_NOTNULL(terminated_tracks);
+  CHECK_LT(slot.camera_index, terminated_tracks->size());
+  FeatureTracks& camera_tracks = (*terminated_tracks)[slot.camera_index];
+  camera_tracks.emplace_back(static_cast<size_t>(slot.track_id), slot.observations.size());
+  FeatureTrack& track = camera_tracks.back();
+  for (const CompactKeypointIdentifier& keypoint : slot.observations) {
+    track.addKeypointObservationAtBack(nframe_pool_.getNFrameShared(keypoint.nframe_index),
+                                       keypoint.frame_index, keypoint.keypoint_index);
+  }
+}
+
+void FeatureTrackBuilder::prepareOutput(std::vector<FeatureTracks>* terminated_tracks) const {
+  CHECK_NOTNULL(terminated_tracks);
+  terminated_tracks->resize(num_cameras_);
+  for (FeatureTracks& camera_tracks : *terminated_tracks) {
+    camera_tracks.clear();
+  }
+}
+
+}  // namespace aslam
@@ -0,0 +1,243 @@
+#include "aslam/frames/keypoint-block.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <aslam/frames/visual-frame.h>
+#include <glog/logging.h>
+
+namespace aslam {
+
+constexpr size_t KeypointBlock::kBlockAlignmentBytes;
+constexpr size_t KeypointBlock::kMinCapacity;
+
+KeypointBlock::KeypointBlock(size_t descriptor_size_bytes)
+    : descriptor_size_bytes_(descriptor_size_bytes), size_(0u), capacity_(0u), data_(nullptr) {
+  std::fill(offsets_, offsets_ + kNumAttributes, 0u);
+}
+
+KeypointBlock::~KeypointBlock() {}
+
+size_t KeypointBlock::getAttributeSizeBytes(Attribute attribute) const {
+  switch (attribute) {
+    case kMeasurements: return 2u * sizeof(double);
+    case kUncertainties:
+    case kOrientations:
+    case kScores:
+    case kScales: return sizeof(double);
+    case kTrackIds: return sizeof(int);
+    case kDescriptors: return descriptor_size_bytes_;
+    default: LOG(FATAL) << "Unknown attribute " << attribute << ".";
+  }
+  return 0u;
+}
+
+size_t KeypointBlock::computeOffsets(size_t capacity, size_t* offsets) const {
+  CHECK_NOTNULL(offsets);
+  size_t offset = 0u;
+  for (int i = 0; i < kNumAttributes; ++i) {
+    offsets[i] = offset;
+    const size_t block_size_bytes = getAttributeSizeBytes(static_cast<Attribute>(i)) * capacity;
+    offset += (block_size_bytes + kBlockAlignmentBytes - 1u) / kBlockAlignmentBytes *
+        kBlockAlignmentBytes;
+  }
+  return offset;
+}
+
+void KeypointBlock::reallocate(size_t capacity) {
+  CHECK_GE(capacity, size_);
+  size_t new_offsets[kNumAttributes];
+  const size_t buffer_size_bytes = computeOffsets(capacity, new_offsets);
+  std::unique_ptr<unsigned char[]> new_buffer(
+      new unsigned char[buffer_size_bytes + kBlockAlignmentBytes]);
+  const uintptr_t address = reinterpret_cast<uintptr_t>(new_buffer.get());
+  unsigned char* new_data = new_buffer.get() +
+      (kBlockAlignmentBytes - address % kBlockAlignmentBytes) % kBlockAlignmentBytes;
+
+  for (int i = 0; i < kNumAttributes; ++i) {
+    const size_t num_bytes = getAttributeSizeBytes(static_cast<Attribute>(i)) * size_;
+    if (num_bytes > 0u) {
+      std::memcpy(new_data + new_offsets[i], data_ + offsets_[i], num_bytes);
+    }
+  }
+  buffer_.swap(new_buffer);
+  data_ = new_data;
+  std::copy(new_offsets, new_offsets + kNumAttributes, offsets_);
+  capacity_ = capacity;
+}
+
+void KeypointBlock::reserve(size_t num_keypoints) {
+  if (num_keypoints <= capacity_) {
+    return;
+  }
+  reallocate(std::max(std::max(num_keypoints, 2u * capacity_), kMinCapacity));
+}
+
+void KeypointBlock::fillDefaults(size_t begin, size_t end) {
+  CHECK_LE(begin, end);
+  CHECK_LE(end, capacity_);
+  const size_t num_keypoints = end - begin;
+  for (int i = 0; i < kNumAttributes; ++i) {
+    const Attribute attribute = static_cast<Attribute>(i);
+    if (attribute == kTrackIds) {
+      std::fill_n(getBlock<int>(kTrackIds) + begin, num_keypoints, -1);
+      continue;
+    }
+    const size_t num_bytes = getAttributeSizeBytes(attribute);
+    if (num_bytes > 0u) {
+      std::memset(data_ + offsets_[i] + begin * num_bytes, 0, num_keypoints * num_bytes);
+    }
+  }
+}
+
+void KeypointBlock::resize(size_t num_keypoints) {
+  reserve(num_keypoints);
+  if (num_keypoints > size_) {
+    fillDefaults(size_, num_keypoints);
+  }
+  size_ = num_keypoints;
+}
+
+size_t KeypointBlock::appendKeypoint(
+    const Eigen::Vector2d& measurement, double uncertainty, double orientation, double score,
+    double scale, const unsigned char* descriptor) {
+  CHECK(descriptor != nullptr || descriptor_size_bytes_ == 0u);
+  reserve(size_ + 1u);
+  const size_t index = size_++;
+  double* measurements = getBlock<double>(kMeasurements);
+  measurements[2u * index] = measurement(0);
+  measurements[2u * index + 1u] = measurement(1);
+  getBlock<double>(kUncertainties)[index] = uncertainty;
+  getBlock<double>(kOrientations)[index] = orientation;
+  getBlock<double>(kScores)[index] = score;
+  getBlock<double>(kScales)[index] = scale;
+  getBlock<int>(kTrackIds)[index] = -1;
+  if (descriptor_size_bytes_ > 0u) {
+    std::memcpy(getBlock<unsigned char>(kDescriptors) + index * descriptor_size_bytes_,
+                descriptor, descriptor_size_bytes_);
+  }
+  return index;
+}
+
+size_t KeypointBlock::eraseByMask(const std::vector<bool>& keep_mask) {
+  CHECK_EQ(keep_mask.size(), size_);
+  size_t num_kept = 0u;
+  for (size_t index = 0u; index < size_; ++index) {
+    if (!keep_mask[index]) {
+      continue;
+    }
+    if (num_kept != index) {
+      for (int i = 0; i < kNumAttributes; ++i) {
+        const size_t num_bytes = getAttributeSizeBytes(static_cast<Attribute>(i));
+        unsigned char* block = data_ + offsets_[i];
+        std::memcpy(block + num_kept * num_bytes, block + index * num_bytes, num_bytes);
+      }
+    }
+    ++num_kept;
+  }
+  const size_t num_removed = size_ - num_kept;
+  size_ = num_kept;
+  return num_removed;
+}
+
+void KeypointBlock::discardUntrackedObservations(std::vector<size_t>* discarded_indices) {
+  CHECK_NOTNULL(discarded_indices)->clear();
+  std::vector<bool> keep_mask(size_);
+  const int* track_ids = getBlock<int>(kTrackIds);
+  for (size_t index = 0u; index < size_; ++index) {
+    keep_mask[index] = track_ids[index] >= 0;
+    if (!keep_mask[index]) {
+      discarded_indices->emplace_back(index);
+    }
+  }
+  if (!discarded_indices->empty()) {
+    eraseByMask(keep_mask);
+  }
+}
+
+KeypointBlock::MeasurementsMap KeypointBlock::getKeypointMeasurementsMutable() {
+  return MeasurementsMap(getBlock<double>(kMeasurements), 2, size_);
+}
+KeypointBlock::ConstMeasurementsMap KeypointBlock::getKeypointMeasurements() const {
+  return ConstMeasurementsMap(getBlock<double>(kMeasurements), 2, size_);
+}
+KeypointBlock::VectorMap KeypointBlock::getKeypointMeasurementUncertaintiesMutable() {
+  return VectorMap(getBlock<double>(kUncertainties), size_);
+}
+KeypointBlock::ConstVectorMap KeypointBlock::getKeypointMeasurementUncertainties() const {
+  return ConstVectorMap(getBlock<double>(kUncertainties), size_);
+}
+KeypointBlock::VectorMap KeypointBlock::getKeypointOrientationsMutable() {
+  return VectorMap(getBlock<double>(kOrientations), size_);
+}
+KeypointBlock::ConstVectorMap KeypointBlock::getKeypointOrientations() const {
+  return ConstVectorMap(getBlock<double>(kOrientations), size_);
+}
+KeypointBlock::VectorMap KeypointBlock::getKeypointScoresMutable() {
+  return VectorMap(getBlock<double>(kScores), size_);
+}
+KeypointBlock::ConstVectorMap KeypointBlock::getKeypointScores() const {
+  return ConstVectorMap(getBlock<double>(kScores), size_);
+}
+KeypointBlock::VectorMap KeypointBlock::getKeypointScalesMutable() {
+  return VectorMap(getBlock<double>(kScales), size_);
+}
+KeypointBlock::ConstVectorMap KeypointBlock::getKeypointScales() const {
+  return ConstVectorMap(getBlock<double>(kScales), size_);
+}
+KeypointBlock::TrackIdsMap KeypointBlock::getTrackIdsMutable() {
+  return TrackIdsMap(getBlock<int>(kTrackIds), size_);
+}
+KeypointBlock::ConstTrackIdsMap KeypointBlock::getTrackIds() const {
+  return ConstTrackIdsMap(getBlock<int>(kTrackIds), size_);
+}
+KeypointBlock::DescriptorsMap KeypointBlock::getDescriptorsMutable() {
+  return DescriptorsMap(getBlock<unsigned char>(kDescriptors), descriptor_size_bytes_, size_);
+}
+KeypointBlock::ConstDescriptorsMap KeypointBlock::getDescriptors() const {
+  return ConstDescriptorsMap(
+      getBlock<unsigned char>(kDescriptors), descriptor_size_bytes_, size_);
+}
+
+void KeypointBlock::copyFromVisualFrame(const VisualFrame& frame) {
+  CHECK(frame.hasKeypointMeasurements());
+  const size_t num_keypoints = frame.getNumKeypointMeasurements();
+  clear();
+  resize(num_keypoints);
+  if (num_keypoints == 0u) {
+    return;
+  }
+  getKeypointMeasurementsMutable() = frame.getKeypointMeasurements();
+  if (frame.hasKeypointMeasurementUncertainties()) {
+    getKeypointMeasurementUncertaintiesMutable() = frame.getKeypointMeasurementUncertainties();
+  }
+  if (frame.hasKeypointOrientations()) {
+    getKeypointOrientationsMutable() = frame.getKeypointOrientations();
+  }
+  if (frame.hasKeypointScores()) {
+    getKeypointScoresMutable() = frame.getKeypointScores();
+  }
+  if (frame.hasKeypointScales()) {
+    getKeypointScalesMutable() = frame.getKeypointScales();
+  }
+  if (frame.hasTrackIds()) {
+    getTrackIdsMutable() = frame.getTrackIds();
+  }
+  if (frame.hasDescriptors() && descriptor_size_bytes_ > 0u) {
+    CHECK_EQ(static_cast<size_t>(frame.getDescriptors().rows()), descriptor_size_bytes_);
+    getDescriptorsMutable() = frame.getDescriptors();
+  }
+}
+
+void KeypointBlock::copyToVisualFrame(VisualFrame* frame) const {
+  CHECK_NOTNULL(frame);
+  frame->setKeypointMeasurements(getKeypointMeasurements());
+  frame->setKeypointMeasurementUncertainties(getKeypointMeasurementUncertainties());
+  frame->setKeypointOrientations(getKeypointOrientations());
+  frame->setKeypointScores(getKeypointScores());
+  frame->setKeypointScales(getKeypointScales());
+  frame->setTrackIds(getTrackIds());
+  frame->setDescriptors(getDescriptors());
+}
+
+}  // namespace aslam
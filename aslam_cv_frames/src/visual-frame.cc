@@ -2,7 +2,9 @@
 
 #include <memory>
 #include <aslam/common/channel-definitions.h>
+#include <aslam/common/memory-usage.h>
 #include <aslam/common/stl-helpers.h>
+#include <aslam/common/thread-pool.h>
 #include <aslam/common/time.h>
 
 namespace aslam {
@@ -19,9 +21,22 @@ VisualFrame& VisualFrame::operator=(const VisualFrame& other) {
   id_ = other.id_;
   camera_geometry_ = other.camera_geometry_;
   raw_camera_geometry_ = other.raw_camera_geometry_;
+  compressed_raw_image_ = other.compressed_raw_image_;
 
-  channels_ = channels::cloneChannelGroup(other.channels_);
+  // The channels are shared and only copied when one of the frames modifies them.
+  channels_ = channels::shareChannelGroup(other.channels_);
   is_valid_ = other.is_valid_;
+  degradations_ = other.degradations_;
+  // The cached bearing vectors are shared as the keypoints and the camera are the same.
+  std::shared_ptr<const NormalizedBearingVectors> other_bearing_vectors;
+  {
+    std::lock_guard<std::mutex> lock(other.m_normalized_bearing_vectors_);
+    other_bearing_vectors = other.normalized_bearing_vectors_;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_normalized_bearing_vectors_);
+    normalized_bearing_vectors_ = other_bearing_vectors;
+  }
   return *this;
 }
 
@@ -65,11 +80,23 @@ bool VisualFrame::hasKeypointScales() const{
 bool VisualFrame::hasDescriptors() const{
   return aslam::channels::has_DESCRIPTORS_Channel(channels_);
 }
+bool VisualFrame::hasFloatDescriptors() const {
+  return aslam::channels::has_FLOAT_DESCRIPTORS_Channel(channels_);
+}
 bool VisualFrame::hasTrackIds() const {
   return aslam::channels::has_TRACK_IDS_Channel(channels_);
 }
+bool VisualFrame::hasLineSegments() const {
+  return aslam::channels::has_VISUAL_LINE_SEGMENTS_Channel(channels_);
+}
+bool VisualFrame::hasLineSegmentScores() const {
+  return aslam::channels::has_VISUAL_LINE_SEGMENT_SCORES_Channel(channels_);
+}
 bool VisualFrame::hasRawImage() const {
-  return aslam::channels::has_RAW_IMAGE_Channel(channels_);
+  return hasCompressedRawImage() || aslam::channels::has_RAW_IMAGE_Channel(channels_);
+}
+bool VisualFrame::hasCompressedRawImage() const {
+  return static_cast<bool>(compressed_raw_image_);
 }
 
 const Eigen::Matrix2Xd& VisualFrame::getKeypointMeasurements() const {
@@ -90,57 +117,173 @@ const Eigen::VectorXd& VisualFrame::getKeypointScores() const {
 const VisualFrame::DescriptorsT& VisualFrame::getDescriptors() const {
   return aslam::channels::get_DESCRIPTORS_Data(channels_);
 }
+const VisualFrame::FloatDescriptorsT& VisualFrame::getFloatDescriptors() const {
+  return aslam::channels::get_FLOAT_DESCRIPTORS_Data(channels_);
+}
 const Eigen::VectorXi& VisualFrame::getTrackIds() const {
   return aslam::channels::get_TRACK_IDS_Data(channels_);
 }
+const Eigen::Matrix4Xd& VisualFrame::getLineSegments() const {
+  return aslam::channels::get_VISUAL_LINE_SEGMENTS_Data(channels_);
+}
+const Eigen::VectorXd& VisualFrame::getLineSegmentScores() const {
+  return aslam::channels::get_VISUAL_LINE_SEGMENT_SCORES_Data(channels_);
+}
 const cv::Mat& VisualFrame::getRawImage() const {
+  if (compressed_raw_image_) {
+    return compressed_raw_image_->getImage();
+  }
   return aslam::channels::get_RAW_IMAGE_Data(channels_);
 }
 
+cv::Rect VisualFrame::getRawImagePatch(const cv::Rect& roi, cv::Mat* patch) const {
+  CHECK_NOTNULL(patch);
+  if (compressed_raw_image_) {
+    return compressed_raw_image_->getPatch(roi, patch);
+  }
+  const cv::Mat& image = aslam::channels::get_RAW_IMAGE_Data(channels_);
+  const cv::Rect clipped_roi = roi & cv::Rect(0, 0, image.cols, image.rows);
+  if (clipped_roi.area() == 0) {
+    patch->release();
+  } else {
+    image(clipped_roi).copyTo(*patch);
+  }
+  return clipped_roi;
+}
+
 void VisualFrame::releaseRawImage() {
+  if (compressed_raw_image_) {
+    compressed_raw_image_.reset();
+    return;
+  }
   aslam::channels::remove_RAW_IMAGE_Channel(&channels_);
 }
 
+void VisualFrame::compressRawImage(
+    const CompressedImage::Options& options, ThreadPool* thread_pool) {
+  if (compressed_raw_image_) {
+    return;
+  }
+  CHECK(aslam::channels::has_RAW_IMAGE_Channel(channels_)) << "The frame has no raw image.";
+  compressed_raw_image_.reset(
+      new CompressedImage(aslam::channels::get_RAW_IMAGE_Data(channels_), options));
+  aslam::channels::remove_RAW_IMAGE_Channel(&channels_);
+  if (thread_pool == nullptr) {
+    compressed_raw_image_->compress();
+  } else {
+    // The task keeps the image alive if the frame is destroyed first.
+    CompressedImage::Ptr compressed_raw_image = compressed_raw_image_;
+    thread_pool->enqueue([compressed_raw_image]() { compressed_raw_image->compress(); });
+  }
+}
+
+void VisualFrame::releaseDecompressedRawImage() {
+  if (compressed_raw_image_) {
+    compressed_raw_image_->releaseDecodedImage();
+  }
+}
+
+bool VisualFrame::hasImagePyramid() const {
+  return aslam::channels::has_IMAGE_PYRAMID_Channel(channels_);
+}
+
+const std::vector<cv::Mat>& VisualFrame::getImagePyramid() const {
+  return aslam::channels::get_IMAGE_PYRAMID_Data(channels_);
+}
+
+void VisualFrame::releaseImagePyramid() {
+  aslam::channels::remove_IMAGE_PYRAMID_Channel(&channels_);
+}
+
+void VisualFrame::releaseDescriptors() {
+  aslam::channels::remove_DESCRIPTORS_Channel(&channels_);
+}
+
+void VisualFrame::releaseKeypointChannels() {
+  invalidateNormalizedBearingVectors();
+  if (hasKeypointMeasurements()) {
+    aslam::channels::remove_VISUAL_KEYPOINT_MEASUREMENTS_Channel(&channels_);
+  }
+  if (hasKeypointMeasurementUncertainties()) {
+    aslam::channels::remove_VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES_Channel(&channels_);
+  }
+  if (hasKeypointOrientations()) {
+    aslam::channels::remove_VISUAL_KEYPOINT_ORIENTATIONS_Channel(&channels_);
+  }
+  if (hasKeypointScores()) {
+    aslam::channels::remove_VISUAL_KEYPOINT_SCORES_Channel(&channels_);
+  }
+  if (hasKeypointScales()) {
+    aslam::channels::remove_VISUAL_KEYPOINT_SCALES_Channel(&channels_);
+  }
+  if (hasDescriptors()) {
+    aslam::channels::remove_DESCRIPTORS_Channel(&channels_);
+  }
+  if (hasFloatDescriptors()) {
+    aslam::channels::remove_FLOAT_DESCRIPTORS_Channel(&channels_);
+  }
+  if (hasTrackIds()) {
+    aslam::channels::remove_TRACK_IDS_Channel(&channels_);
+  }
+}
+
 Eigen::Matrix2Xd* VisualFrame::getKeypointMeasurementsMutable() {
+  invalidateNormalizedBearingVectors();
   Eigen::Matrix2Xd& keypoints =
-      aslam::channels::get_VISUAL_KEYPOINT_MEASUREMENTS_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_MEASUREMENTS_DataMutable(&channels_);
     return &keypoints;
 }
 Eigen::VectorXd* VisualFrame::getKeypointMeasurementUncertaintiesMutable() {
   Eigen::VectorXd& uncertainties =
-      aslam::channels::get_VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES_DataMutable(&channels_);
     return &uncertainties;
 }
 Eigen::VectorXd* VisualFrame::getKeypointScalesMutable() {
   Eigen::VectorXd& scales =
-      aslam::channels::get_VISUAL_KEYPOINT_SCALES_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_SCALES_DataMutable(&channels_);
     return &scales;
 }
 Eigen::VectorXd* VisualFrame::getKeypointOrientationsMutable() {
   Eigen::VectorXd& orientations =
-      aslam::channels::get_VISUAL_KEYPOINT_ORIENTATIONS_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_ORIENTATIONS_DataMutable(&channels_);
     return &orientations;
 }
 Eigen::VectorXd* VisualFrame::getKeypointScoresMutable() {
   Eigen::VectorXd& scores =
-      aslam::channels::get_VISUAL_KEYPOINT_SCORES_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_SCORES_DataMutable(&channels_);
     return &scores;
 }
 VisualFrame::DescriptorsT* VisualFrame::getDescriptorsMutable() {
   VisualFrame::DescriptorsT& descriptors =
-      aslam::channels::get_DESCRIPTORS_Data(channels_);
+      aslam::channels::get_DESCRIPTORS_DataMutable(&channels_);
+  return &descriptors;
+}
+VisualFrame::FloatDescriptorsT* VisualFrame::getFloatDescriptorsMutable() {
+  VisualFrame::FloatDescriptorsT& descriptors =
+      aslam::channels::get_FLOAT_DESCRIPTORS_DataMutable(&channels_);
   return &descriptors;
 }
 Eigen::VectorXi* VisualFrame::getTrackIdsMutable() {
   Eigen::VectorXi& track_ids =
-      aslam::channels::get_TRACK_IDS_Data(channels_);
+      aslam::channels::get_TRACK_IDS_DataMutable(&channels_);
   return &track_ids;
 }
 cv::Mat* VisualFrame::getRawImageMutable() {
+  if (compressed_raw_image_) {
+    // Copies of the frame share the compressed image, hence the decoded image is cloned.
+    const cv::Mat image = compressed_raw_image_->getImage().clone();
+    compressed_raw_image_.reset();
+    setRawImage(image);
+  }
   cv::Mat& image =
-      aslam::channels::get_RAW_IMAGE_Data(channels_);
+      aslam::channels::get_RAW_IMAGE_DataMutable(&channels_);
   return &image;
 }
+std::vector<cv::Mat>* VisualFrame::getImagePyramidMutable() {
+  std::vector<cv::Mat>& image_pyramid =
+      aslam::channels::get_IMAGE_PYRAMID_DataMutable(&channels_);
+  return &image_pyramid;
+}
 
 const Eigen::Block<Eigen::Matrix2Xd, 2, 1>
 VisualFrame::getKeypointMeasurement(size_t index) const {
@@ -188,11 +331,12 @@ int VisualFrame::getTrackId(size_t index) const {
 
 void VisualFrame::setKeypointMeasurements(
     const Eigen::Matrix2Xd& keypoints_new) {
+  invalidateNormalizedBearingVectors();
   if (!aslam::channels::has_VISUAL_KEYPOINT_MEASUREMENTS_Channel(channels_)) {
     aslam::channels::add_VISUAL_KEYPOINT_MEASUREMENTS_Channel(&channels_);
   }
   Eigen::Matrix2Xd& keypoints =
-      aslam::channels::get_VISUAL_KEYPOINT_MEASUREMENTS_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_MEASUREMENTS_DataMutable(&channels_, false);
   keypoints = keypoints_new;
 }
 void VisualFrame::setKeypointMeasurementUncertainties(
@@ -201,7 +345,7 @@ void VisualFrame::setKeypointMeasurementUncertainties(
     aslam::channels::add_VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES_Channel(&channels_);
   }
   Eigen::VectorXd& data =
-      aslam::channels::get_VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES_DataMutable(&channels_, false);
   data = uncertainties_new;
 }
 void VisualFrame::setKeypointScales(
@@ -210,7 +354,7 @@ void VisualFrame::setKeypointScales(
     aslam::channels::add_VISUAL_KEYPOINT_SCALES_Channel(&channels_);
   }
   Eigen::VectorXd& data =
-      aslam::channels::get_VISUAL_KEYPOINT_SCALES_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_SCALES_DataMutable(&channels_, false);
   data = scales_new;
 }
 void VisualFrame::setKeypointOrientations(
@@ -219,7 +363,7 @@ void VisualFrame::setKeypointOrientations(
     aslam::channels::add_VISUAL_KEYPOINT_ORIENTATIONS_Channel(&channels_);
   }
   Eigen::VectorXd& data =
-      aslam::channels::get_VISUAL_KEYPOINT_ORIENTATIONS_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_ORIENTATIONS_DataMutable(&channels_, false);
   data = orientations_new;
 }
 void VisualFrame::setKeypointScores(
@@ -228,7 +372,7 @@ void VisualFrame::setKeypointScores(
     aslam::channels::add_VISUAL_KEYPOINT_SCORES_Channel(&channels_);
   }
   Eigen::VectorXd& data =
-      aslam::channels::get_VISUAL_KEYPOINT_SCORES_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_SCORES_DataMutable(&channels_, false);
   data = scores_new;
 }
 void VisualFrame::setDescriptors(
@@ -237,7 +381,7 @@ void VisualFrame::setDescriptors(
     aslam::channels::add_DESCRIPTORS_Channel(&channels_);
   }
   VisualFrame::DescriptorsT& descriptors =
-      aslam::channels::get_DESCRIPTORS_Data(channels_);
+      aslam::channels::get_DESCRIPTORS_DataMutable(&channels_, false);
   descriptors = descriptors_new;
 }
 void VisualFrame::setDescriptors(
@@ -246,7 +390,15 @@ void VisualFrame::setDescriptors(
     aslam::channels::add_DESCRIPTORS_Channel(&channels_);
   }
   VisualFrame::DescriptorsT& descriptors =
-      aslam::channels::get_DESCRIPTORS_Data(channels_);
+      aslam::channels::get_DESCRIPTORS_DataMutable(&channels_, false);
+  descriptors = descriptors_new;
+}
+void VisualFrame::setFloatDescriptors(const FloatDescriptorsT& descriptors_new) {
+  if (!aslam::channels::has_FLOAT_DESCRIPTORS_Channel(channels_)) {
+    aslam::channels::add_FLOAT_DESCRIPTORS_Channel(&channels_);
+  }
+  VisualFrame::FloatDescriptorsT& descriptors =
+      aslam::channels::get_FLOAT_DESCRIPTORS_DataMutable(&channels_, false);
   descriptors = descriptors_new;
 }
 void VisualFrame::setTrackIds(const Eigen::VectorXi& track_ids_new) {
@@ -254,25 +406,52 @@ void VisualFrame::setTrackIds(const Eigen::VectorXi& track_ids_new) {
     aslam::channels::add_TRACK_IDS_Channel(&channels_);
   }
   Eigen::VectorXi& data =
-      aslam::channels::get_TRACK_IDS_Data(channels_);
+      aslam::channels::get_TRACK_IDS_DataMutable(&channels_, false);
   data = track_ids_new;
 }
+void VisualFrame::setLineSegments(const Eigen::Matrix4Xd& line_segments_new) {
+  if (!aslam::channels::has_VISUAL_LINE_SEGMENTS_Channel(channels_)) {
+    aslam::channels::add_VISUAL_LINE_SEGMENTS_Channel(&channels_);
+  }
+  Eigen::Matrix4Xd& data =
+      aslam::channels::get_VISUAL_LINE_SEGMENTS_DataMutable(&channels_, false);
+  data = line_segments_new;
+}
+void VisualFrame::setLineSegmentScores(const Eigen::VectorXd& scores_new) {
+  if (!aslam::channels::has_VISUAL_LINE_SEGMENT_SCORES_Channel(channels_)) {
+    aslam::channels::add_VISUAL_LINE_SEGMENT_SCORES_Channel(&channels_);
+  }
+  Eigen::VectorXd& data =
+      aslam::channels::get_VISUAL_LINE_SEGMENT_SCORES_DataMutable(&channels_, false);
+  data = scores_new;
+}
 
 void VisualFrame::setRawImage(const cv::Mat& image_new) {
+  compressed_raw_image_.reset();
   if (!aslam::channels::has_RAW_IMAGE_Channel(channels_)) {
     aslam::channels::add_RAW_IMAGE_Channel(&channels_);
   }
   cv::Mat& image =
-      aslam::channels::get_RAW_IMAGE_Data(channels_);
+      aslam::channels::get_RAW_IMAGE_DataMutable(&channels_, false);
   image = image_new;
 }
 
+void VisualFrame::setImagePyramid(const std::vector<cv::Mat>& image_pyramid_new) {
+  if (!aslam::channels::has_IMAGE_PYRAMID_Channel(channels_)) {
+    aslam::channels::add_IMAGE_PYRAMID_Channel(&channels_);
+  }
+  std::vector<cv::Mat>& image_pyramid =
+      aslam::channels::get_IMAGE_PYRAMID_DataMutable(&channels_, false);
+  image_pyramid = image_pyramid_new;
+}
+
 void VisualFrame::swapKeypointMeasurements(Eigen::Matrix2Xd* keypoints_new) {
+  invalidateNormalizedBearingVectors();
   if (!aslam::channels::has_VISUAL_KEYPOINT_MEASUREMENTS_Channel(channels_)) {
     aslam::channels::add_VISUAL_KEYPOINT_MEASUREMENTS_Channel(&channels_);
   }
   Eigen::Matrix2Xd& keypoints =
-      aslam::channels::get_VISUAL_KEYPOINT_MEASUREMENTS_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_MEASUREMENTS_DataMutable(&channels_);
   keypoints.swap(*keypoints_new);
 }
 void VisualFrame::swapKeypointMeasurementUncertainties(Eigen::VectorXd* uncertainties_new) {
@@ -280,7 +459,7 @@ void VisualFrame::swapKeypointMeasurementUncertainties(Eigen::VectorXd* uncertai
     aslam::channels::add_VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES_Channel(&channels_);
   }
   Eigen::VectorXd& data =
-      aslam::channels::get_VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES_DataMutable(&channels_);
   data.swap(*uncertainties_new);
 }
 void VisualFrame::swapKeypointScales(Eigen::VectorXd* scales_new) {
@@ -288,7 +467,7 @@ void VisualFrame::swapKeypointScales(Eigen::VectorXd* scales_new) {
     aslam::channels::add_VISUAL_KEYPOINT_SCALES_Channel(&channels_);
   }
   Eigen::VectorXd& data =
-      aslam::channels::get_VISUAL_KEYPOINT_SCALES_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_SCALES_DataMutable(&channels_);
   data.swap(*scales_new);
 }
 void VisualFrame::swapKeypointOrientations(Eigen::VectorXd* orientations_new) {
@@ -296,7 +475,7 @@ void VisualFrame::swapKeypointOrientations(Eigen::VectorXd* orientations_new) {
     aslam::channels::add_VISUAL_KEYPOINT_ORIENTATIONS_Channel(&channels_);
   }
   Eigen::VectorXd& data =
-      aslam::channels::get_VISUAL_KEYPOINT_ORIENTATIONS_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_ORIENTATIONS_DataMutable(&channels_);
   data.swap(*orientations_new);
 }
 void VisualFrame::swapKeypointScores(Eigen::VectorXd* scores_new) {
@@ -304,7 +483,7 @@ void VisualFrame::swapKeypointScores(Eigen::VectorXd* scores_new) {
     aslam::channels::add_VISUAL_KEYPOINT_SCORES_Channel(&channels_);
   }
   Eigen::VectorXd& data =
-      aslam::channels::get_VISUAL_KEYPOINT_SCORES_Data(channels_);
+      aslam::channels::get_VISUAL_KEYPOINT_SCORES_DataMutable(&channels_);
   data.swap(*scores_new);
 }
 void VisualFrame::swapDescriptors(DescriptorsT* descriptors_new) {
@@ -312,7 +491,16 @@ void VisualFrame::swapDescriptors(DescriptorsT* descriptors_new) {
     aslam::channels::add_DESCRIPTORS_Channel(&channels_);
   }
   VisualFrame::DescriptorsT& descriptors =
-      aslam::channels::get_DESCRIPTORS_Data(channels_);
+      aslam::channels::get_DESCRIPTORS_DataMutable(&channels_);
+  descriptors.swap(*descriptors_new);
+}
+void VisualFrame::swapFloatDescriptors(FloatDescriptorsT* descriptors_new) {
+  CHECK_NOTNULL(descriptors_new);
+  if (!aslam::channels::has_FLOAT_DESCRIPTORS_Channel(channels_)) {
+    aslam::channels::add_FLOAT_DESCRIPTORS_Channel(&channels_);
+  }
+  VisualFrame::FloatDescriptorsT& descriptors =
+      aslam::channels::get_FLOAT_DESCRIPTORS_DataMutable(&channels_);
   descriptors.swap(*descriptors_new);
 }
 
@@ -320,10 +508,29 @@ void VisualFrame::swapTrackIds(Eigen::VectorXi* track_ids_new) {
   if (!aslam::channels::has_TRACK_IDS_Channel(channels_)) {
     aslam::channels::add_TRACK_IDS_Channel(&channels_);
   }
-  Eigen::VectorXi& track_ids = aslam::channels::get_TRACK_IDS_Data(channels_);
+  Eigen::VectorXi& track_ids = aslam::channels::get_TRACK_IDS_DataMutable(&channels_);
   track_ids.swap(*track_ids_new);
 }
 
+void VisualFrame::swapLineSegments(Eigen::Matrix4Xd* line_segments_new) {
+  CHECK_NOTNULL(line_segments_new);
+  if (!aslam::channels::has_VISUAL_LINE_SEGMENTS_Channel(channels_)) {
+    aslam::channels::add_VISUAL_LINE_SEGMENTS_Channel(&channels_);
+  }
+  Eigen::Matrix4Xd& line_segments =
+      aslam::channels::get_VISUAL_LINE_SEGMENTS_DataMutable(&channels_);
+  line_segments.swap(*line_segments_new);
+}
+void VisualFrame::swapLineSegmentScores(Eigen::VectorXd* scores_new) {
+  CHECK_NOTNULL(scores_new);
+  if (!aslam::channels::has_VISUAL_LINE_SEGMENT_SCORES_Channel(channels_)) {
+    aslam::channels::add_VISUAL_LINE_SEGMENT_SCORES_Channel(&channels_);
+  }
+  Eigen::VectorXd& scores =
+      aslam::channels::get_VISUAL_LINE_SEGMENT_SCORES_DataMutable(&channels_);
+  scores.swap(*scores_new);
+}
+
 void VisualFrame::clearKeypointChannels() {
   Eigen::Matrix2Xd zero_keypoints;
   setKeypointMeasurements(zero_keypoints);
@@ -337,6 +544,9 @@ void VisualFrame::clearKeypointChannels() {
   setKeypointScores(zero_vector_double);
   setKeypointScales(zero_vector_double);
   setDescriptors(aslam::VisualFrame::DescriptorsT());
+  if (hasFloatDescriptors()) {
+    setFloatDescriptors(aslam::VisualFrame::FloatDescriptorsT());
+  }
 }
 
 const Camera::ConstPtr VisualFrame::getCameraGeometry() const {
@@ -344,6 +554,7 @@ const Camera::ConstPtr VisualFrame::getCameraGeometry() const {
 }
 
 void VisualFrame::setCameraGeometry(const Camera::ConstPtr& camera) {
+  invalidateNormalizedBearingVectors();
   camera_geometry_ = camera;
 }
 
@@ -361,6 +572,9 @@ void VisualFrame::print(std::ostream& out, const std::string& label) const {
   }
   out << "VisualFrame(" << this->id_ << ")" << std::endl;
   out << "  timestamp:          " << this->timestamp_nanoseconds_ << std::endl;
+  if (!degradations_.empty()) {
+    out << "  degradations:       " << degradations_.toString() << std::endl;
+  }
   if(camera_geometry_) {
     camera_geometry_->printParameters(out, "  VisualFrame::camera");
   } else {
@@ -369,6 +583,26 @@ void VisualFrame::print(std::ostream& out, const std::string& label) const {
   channels_.printParameters(out);
 }
 
+size_t VisualFrame::getMemoryUsageBytes(const std::string& tag,
+                                        common::MemoryUsageReport* report) const {
+  size_t other_bytes = sizeof(*this);
+  if (compressed_raw_image_) {
+    other_bytes += compressed_raw_image_->getMemoryUsageBytes();
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_normalized_bearing_vectors_);
+    if (normalized_bearing_vectors_) {
+      other_bytes += sizeof(NormalizedBearingVectors) +
+          common::getMemoryUsageBytes(normalized_bearing_vectors_->bearing_vectors) +
+          common::getMemoryUsageBytes(normalized_bearing_vectors_->backprojection_success);
+    }
+  }
+  if (report != nullptr) {
+    report->add(tag + "/other", other_bytes);
+  }
+  return other_bytes + aslam::channels::getChannelGroupMemoryUsageBytes(channels_, tag, report);
+}
+
 aslam::ProjectionResult VisualFrame::getKeypointInRawImageCoordinates(
     size_t keypoint_idx, Eigen::Vector2d* keypoint_raw_coordinates) const {
   CHECK_NOTNULL(keypoint_raw_coordinates);
@@ -419,22 +653,45 @@ Eigen::Matrix3Xd VisualFrame::getNormalizedBearingVectors(
     return Eigen::Matrix3Xd(3, 0);
   }
 
-  const aslam::Camera& camera = *CHECK_NOTNULL(getCameraGeometry().get());
-  const Eigen::Matrix2Xd& keypoints = getKeypointMeasurements();
-  const size_t num_keypoints = getNumKeypointMeasurements();
-
-  Eigen::Matrix2Xd keypoints_reduced;
-  keypoints_reduced.resize(Eigen::NoChange, keypoint_indices.size());
-
+  std::shared_ptr<const NormalizedBearingVectors> cache = getOrComputeNormalizedBearingVectors();
+  const size_t num_keypoints = static_cast<size_t>(cache->bearing_vectors.cols());
+  Eigen::Matrix3Xd bearing_vectors(3, keypoint_indices.size());
+  backprojection_success->resize(keypoint_indices.size());
   size_t list_idx = 0;
   for (const size_t keypoint_idx : keypoint_indices) {
-    CHECK_LE(keypoint_idx, num_keypoints);
-    keypoints_reduced.col(list_idx++) = keypoints.col(keypoint_idx);
+    CHECK_LT(keypoint_idx, num_keypoints);
+    bearing_vectors.col(list_idx) = cache->bearing_vectors.col(keypoint_idx);
+    (*backprojection_success)[list_idx] = cache->backprojection_success[keypoint_idx];
+    ++list_idx;
   }
+  return bearing_vectors;
+}
+
+std::shared_ptr<const VisualFrame::NormalizedBearingVectors>
+VisualFrame::getOrComputeNormalizedBearingVectors() const {
+  std::lock_guard<std::mutex> lock(m_normalized_bearing_vectors_);
+  if (!normalized_bearing_vectors_) {
+    const aslam::Camera& camera = *CHECK_NOTNULL(getCameraGeometry().get());
+    std::shared_ptr<NormalizedBearingVectors> cache(new NormalizedBearingVectors);
+    camera.backProject3Vectorized(
+        getKeypointMeasurements(), &cache->bearing_vectors, &cache->backprojection_success);
+    cache->bearing_vectors.colwise().normalize();
+    normalized_bearing_vectors_ = cache;
+  }
+  return normalized_bearing_vectors_;
+}
+
+const Eigen::Matrix3Xd& VisualFrame::getNormalizedBearingVectors() const {
+  return getOrComputeNormalizedBearingVectors()->bearing_vectors;
+}
+
+const std::vector<unsigned char>& VisualFrame::getBearingVectorBackprojectionSuccess() const {
+  return getOrComputeNormalizedBearingVectors()->backprojection_success;
+}
 
-  Eigen::Matrix3Xd points_3d;
-  camera.backProject3Vectorized(keypoints_reduced, &points_3d, backprojection_success);
-  return points_3d.colwise().normalized();
+void VisualFrame::invalidateNormalizedBearingVectors() {
+  std::lock_guard<std::mutex> lock(m_normalized_bearing_vectors_);
+  normalized_bearing_vectors_.reset();
 }
 
 VisualFrame::Ptr VisualFrame::createEmptyTestVisualFrame(const aslam::Camera::ConstPtr& camera,
@@ -454,6 +711,59 @@ VisualFrame::Ptr VisualFrame::createEmptyTestVisualFrame(const aslam::Camera::Co
   return frame;
 }
 
+namespace {
+/// Keep mask over the current track ids, avoids materializing a mask for every frame.
+struct IsTracked {
+  explicit IsTracked(const Eigen::VectorXi& _track_ids) : track_ids(_track_ids) {}
+  bool operator[](size_t index) const { return track_ids(index) >= 0; }
+  const Eigen::VectorXi& track_ids;
+};
+
+template <typename KeepMask>
+void compactKeypointChannelsInPlace(
+    const KeepMask& keep_mask, const size_t num_keypoints, VisualFrame* frame) {
+  CHECK_NOTNULL(frame);
+  using common::stl_helpers::compactInPlace;
+  if (frame->hasKeypointMeasurements()) {
+    compactInPlace(keep_mask, num_keypoints, frame->getKeypointMeasurementsMutable());
+  }
+  if (frame->hasKeypointMeasurementUncertainties()) {
+    compactInPlace(keep_mask, num_keypoints,
+                   frame->getKeypointMeasurementUncertaintiesMutable());
+  }
+  if (frame->hasKeypointOrientations()) {
+    compactInPlace(keep_mask, num_keypoints, frame->getKeypointOrientationsMutable());
+  }
+  if (frame->hasKeypointScores()) {
+    compactInPlace(keep_mask, num_keypoints, frame->getKeypointScoresMutable());
+  }
+  if (frame->hasKeypointScales()) {
+    compactInPlace(keep_mask, num_keypoints, frame->getKeypointScalesMutable());
+  }
+  if (frame->hasDescriptors()) {
+    common::stl_helpers::OneDimensionAdapter<unsigned char, common::stl_helpers::kColumns>
+        adapter(frame->getDescriptorsMutable());
+    compactInPlace(keep_mask, num_keypoints, &adapter);
+  }
+  if (frame->hasFloatDescriptors()) {
+    common::stl_helpers::OneDimensionAdapter<float, common::stl_helpers::kColumns>
+        adapter(frame->getFloatDescriptorsMutable());
+    compactInPlace(keep_mask, num_keypoints, &adapter);
+  }
+  // Last, as the mask may be computed from the track ids. An element is only overwritten after
+  // its mask entry was read.
+  if (frame->hasTrackIds()) {
+    compactInPlace(keep_mask, num_keypoints, frame->getTrackIdsMutable());
+  }
+}
+}  // namespace
+
+void VisualFrame::compactKeypointChannels(const std::vector<bool>& keep_mask) {
+  CHECK(hasKeypointMeasurements());
+  CHECK_EQ(keep_mask.size(), getNumKeypointMeasurements());
+  compactKeypointChannelsInPlace(keep_mask, keep_mask.size(), this);
+}
+
 void VisualFrame::discardUntrackedObservations(
     std::vector<size_t>* discarded_indices) {
   CHECK_NOTNULL(discarded_indices)->clear();
@@ -469,36 +779,8 @@ void VisualFrame::discardUntrackedObservations(
   if (discarded_indices->empty()) {
     return;
   }
-
-  if (hasKeypointMeasurements()) {
-    common::stl_helpers::eraseIndicesFromContainer(
-        *discarded_indices, original_count, getKeypointMeasurementsMutable());
-  }
-  if (hasKeypointMeasurementUncertainties()) {
-    common::stl_helpers::eraseIndicesFromContainer(
-        *discarded_indices, original_count,
-        getKeypointMeasurementUncertaintiesMutable());
-  }
-  if (hasKeypointOrientations()) {
-    common::stl_helpers::eraseIndicesFromContainer(
-        *discarded_indices, original_count, getKeypointOrientationsMutable());
-  }
-  if (hasKeypointScores()) {
-    common::stl_helpers::eraseIndicesFromContainer(
-        *discarded_indices, original_count, getKeypointScoresMutable());
-  }
-  if (hasKeypointScales()) {
-    common::stl_helpers::eraseIndicesFromContainer(
-        *discarded_indices, original_count, getKeypointScalesMutable());
-  }
-  if (hasDescriptors()) {
-    common::stl_helpers::OneDimensionAdapter<unsigned char,
-    common::stl_helpers::kColumns> adapter(getDescriptorsMutable());
-    common::stl_helpers::eraseIndicesFromContainer(
-        *discarded_indices, original_count, &adapter);
-  }
-  common::stl_helpers::eraseIndicesFromContainer(
-      *discarded_indices, original_count, getTrackIdsMutable());
+  // The mutable accessor detaches a shared track id channel before the mask refers to it.
+  compactKeypointChannelsInPlace(IsTracked(*getTrackIdsMutable()), original_count, this);
 }
 
 }  // namespace aslam
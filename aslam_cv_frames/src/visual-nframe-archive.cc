@@ -0,0 +1,347 @@
+#include "aslam/frames/visual-nframe-archive.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <utility>
+
+#include <aslam/common/channel-serialization.h>
+#include <aslam/frames/visual-nframe.h>
+#include <glog/logging.h>
+
+namespace aslam {
+using namespace binary_serialization;  // NOLINT
+
+namespace {
+std::string getIndexPath(const std::string& archive_path) {
+  return archive_path + ".index";
+}
+
+aslam::NFramesId getEntryId(const ArchiveIndexEntry& entry) {
+  aslam::NFramesId id;
+  id.fromUint64(entry.nframe_id);
+  return id;
+}
+}  // namespace
+
+constexpr size_t VisualNFrameArchiveWriter::kDefaultBufferSizeBytes;
+
+VisualNFrameArchiveWriter::VisualNFrameArchiveWriter(size_t buffer_size_bytes)
+    : file_descriptor_(-1), file_size_bytes_(0u), buffer_(buffer_size_bytes),
+      buffer_used_bytes_(0u) {
+  CHECK_GT(buffer_size_bytes, 0u);
+}
+
+VisualNFrameArchiveWriter::~VisualNFrameArchiveWriter() {
+  if (isOpen()) {
+    close();
+  }
+}
+
+bool VisualNFrameArchiveWriter::open(const std::string& path) {
+  CHECK(!isOpen()) << "The archive " << path_ << " is still open.";
+  file_descriptor_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (file_descriptor_ < 0) {
+    LOG(ERROR) << "Could not open " << path << ": " << std::strerror(errno);
+    return false;
+  }
+  path_ = path;
+  file_size_bytes_ = 0u;
+  buffer_used_bytes_ = 0u;
+  index_.clear();
+  // A stale index of a previous archive must not be picked up by the reader.
+  ::unlink(getIndexPath(path_).c_str());
+
+  ArchiveHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kArchiveMagic;
+  header.version = kFormatVersion;
+  header.header_size_bytes = static_cast<uint16_t>(sizeof(ArchiveHeader));
+  std::memcpy(buffer_.data(), &header, sizeof(header));
+  buffer_used_bytes_ = sizeof(header);
+  file_size_bytes_ = sizeof(header);
+  return true;
+}
+
+bool VisualNFrameArchiveWriter::writeAll(const char* data, size_t size_bytes) {
+  while (size_bytes > 0u) {
+    const ssize_t num_written = ::write(file_descriptor_, data, size_bytes);
+    if (num_written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(ERROR) << "Writing to " << path_ << " failed: " << std::strerror(errno);
+      return false;
+    }
+    data += num_written;
+    size_bytes -= static_cast<size_t>(num_written);
+  }
+  return true;
+}
+
+bool VisualNFrameArchiveWriter::append(const VisualNFrame& nframe) {
+  CHECK(isOpen());
+  serializer_.serializeVisualNFrame(nframe);
+  const size_t record_size_bytes = serializer_.getTotalSizeBytes();
+
+  ArchiveIndexEntry entry;
+  entry.timestamp_nanoseconds = nframe.getMinTimestampNanoseconds();
+  entry.offset = file_size_bytes_;
+  nframe.getId().toUint64(entry.nframe_id);
+
+  if (buffer_used_bytes_ + record_size_bytes > buffer_.size() && !flush()) {
+    return false;
+  }
+  if (record_size_bytes > buffer_.size()) {
+    if (!serializer_.writeToFileDescriptor(file_descriptor_)) {
+      LOG(ERROR) << "Writing to " << path_ << " failed.";
+      return false;
+    }
+  } else {
+    internal::BufferSerializationSink sink(buffer_.data() + buffer_used_bytes_,
+                                           buffer_.size() - buffer_used_bytes_);
+    CHECK(serializer_.writeToSink(&sink));
+    buffer_used_bytes_ += sink.getNumBytesWritten();
+  }
+  file_size_bytes_ += record_size_bytes;
+  index_.push_back(entry);
+  return true;
+}
+
+bool VisualNFrameArchiveWriter::flush() {
+  CHECK(isOpen());
+  if (!writeAll(buffer_.data(), buffer_used_bytes_)) {
+    return false;
+  }
+  buffer_used_bytes_ = 0u;
+  return true;
+}
+
+bool VisualNFrameArchiveWriter::close() {
+  CHECK(isOpen());
+  bool success = flush();
+  success &= ::close(file_descriptor_) == 0;
+  file_descriptor_ = -1;
+  if (!success) {
+    LOG(ERROR) << "Closing " << path_ << " failed, the index is not written.";
+    return false;
+  }
+
+  ArchiveIndexHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = kArchiveIndexMagic;
+  header.version = kFormatVersion;
+  header.header_size_bytes = static_cast<uint16_t>(sizeof(ArchiveIndexHeader));
+  header.num_entries = index_.size();
+  header.archive_size_bytes = file_size_bytes_;
+  std::ofstream index_file(getIndexPath(path_), std::ios::binary | std::ios::trunc);
+  index_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  index_file.write(reinterpret_cast<const char*>(index_.data()),
+                   index_.size() * sizeof(ArchiveIndexEntry));
+  if (!index_file.good()) {
+    LOG(ERROR) << "Writing the index of " << path_ << " failed.";
+    return false;
+  }
+  return true;
+}
+
+VisualNFrameArchive::VisualNFrameArchive() : indexed_size_bytes_(0u) {}
+
+VisualNFrameArchive::~VisualNFrameArchive() {
+  close();
+}
+
+bool VisualNFrameArchive::open(const std::string& path) {
+  close();
+  if (!mapped_file_.open(path)) {
+    LOG(ERROR) << "Could not open " << path << ": " << std::strerror(errno);
+    return false;
+  }
+  if (mapped_file_.sizeBytes() < sizeof(ArchiveHeader)) {
+    LOG(ERROR) << path << " is not an archive.";
+    close();
+    return false;
+  }
+
+  const ArchiveHeader* header = reinterpret_cast<const ArchiveHeader*>(mapped_file_.data());
+  if (header->magic != kArchiveMagic || header->version != kFormatVersion ||
+      header->header_size_bytes != sizeof(ArchiveHeader)) {
+    LOG(ERROR) << path << " is not an archive of format version " << kFormatVersion << ".";
+    close();
+    return false;
+  }
+  path_ = path;
+  if (loadIndex(getIndexPath(path))) {
+    indexed_size_bytes_ = mapped_file_.sizeBytes();
+  } else {
+    LOG(WARNING) << "Rebuilding the missing or stale index of " << path << ".";
+    indexed_size_bytes_ = sizeof(ArchiveHeader);
+    indexRecords();
+  }
+  sortIndex(0u);
+  return true;
+}
+
+bool VisualNFrameArchive::update() {
+  CHECK(isOpen());
+  common::MappedFile mapped_file;
+  if (!mapped_file.open(path_)) {
+    LOG(ERROR) << "Could not open " << path_ << ": " << std::strerror(errno);
+    return false;
+  }
+  if (mapped_file.sizeBytes() < mapped_file_.sizeBytes()) {
+    LOG(ERROR) << path_ << " was truncated.";
+    return false;
+  }
+  // The records are append-only, hence the entries of the previous mapping stay valid.
+  mapped_file_ = std::move(mapped_file);
+  const size_t num_sorted_entries = entries_.size();
+  indexRecords();
+  sortIndex(num_sorted_entries);
+  return true;
+}
+
+void VisualNFrameArchive::close() {
+  mapped_file_.close();
+  path_.clear();
+  indexed_size_bytes_ = 0u;
+  entries_.clear();
+  entries_by_id_.clear();
+}
+
+bool VisualNFrameArchive::loadIndex(const std::string& index_path) {
+  std::ifstream index_file(index_path, std::ios::binary);
+  if (!index_file.is_open()) {
+    return false;
+  }
+  ArchiveIndexHeader header;
+  index_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!index_file.good() || header.magic != kArchiveIndexMagic ||
+      header.version != kFormatVersion || header.archive_size_bytes != mapped_file_.sizeBytes()) {
+    return false;
+  }
+  entries_.resize(header.num_entries);
+  index_file.read(reinterpret_cast<char*>(entries_.data()),
+                  entries_.size() * sizeof(ArchiveIndexEntry));
+  if (!index_file.good()) {
+    entries_.clear();
+    return false;
+  }
+  for (const ArchiveIndexEntry& entry : entries_) {
+    if (entry.offset < sizeof(ArchiveHeader) || entry.offset >= mapped_file_.sizeBytes()) {
+      entries_.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+void VisualNFrameArchive::indexRecords() {
+  const size_t size_bytes = mapped_file_.sizeBytes();
+  size_t offset = indexed_size_bytes_;
+  BinaryVisualNFrameView nframe;
+  while (offset < size_bytes) {
+    if (!nframe.init(mapped_file_.data() + offset, size_bytes - offset)) {
+      // A truncated last record is expected after a crash while writing. It is indexed by the
+      // next update if it was completed.
+      LOG(WARNING) << "Ignoring " << size_bytes - offset << " bytes after the last valid record.";
+      break;
+    }
+    ArchiveIndexEntry entry;
+    entry.timestamp_nanoseconds = std::numeric_limits<int64_t>::max();
+    for (size_t frame_idx = 0u; frame_idx < nframe.getNumFrames(); ++frame_idx) {
+      if (nframe.isFrameSet(frame_idx)) {
+        entry.timestamp_nanoseconds = std::min(
+            entry.timestamp_nanoseconds, nframe.getFrame(frame_idx).getTimestampNanoseconds());
+      }
+    }
+    entry.offset = offset;
+    nframe.getId().toUint64(entry.nframe_id);
+    entries_.push_back(entry);
+    offset += nframe.getTotalSizeBytes();
+  }
+  indexed_size_bytes_ = offset;
+}
+
+void VisualNFrameArchive::sortIndex(size_t num_sorted_entries) {
+  CHECK_LE(num_sorted_entries, entries_.size());
+  const auto is_earlier = [](const ArchiveIndexEntry& lhs, const ArchiveIndexEntry& rhs) {
+    return lhs.timestamp_nanoseconds < rhs.timestamp_nanoseconds;
+  };
+  const std::vector<ArchiveIndexEntry>::iterator first_unsorted =
+      entries_.begin() + num_sorted_entries;
+  std::stable_sort(first_unsorted, entries_.end(), is_earlier);
+  std::inplace_merge(entries_.begin(), first_unsorted, entries_.end(), is_earlier);
+  entries_by_id_.resize(entries_.size());
+  for (size_t i = 0u; i < entries_.size(); ++i) {
+    entries_by_id_[i] = i;
+  }
+  // Records of the same id are ordered by their offset, such that the last one is found.
+  std::sort(entries_by_id_.begin(), entries_by_id_.end(), [this](size_t lhs, size_t rhs) {
+    const aslam::NFramesId lhs_id = getEntryId(entries_[lhs]);
+    const aslam::NFramesId rhs_id = getEntryId(entries_[rhs]);
+    return lhs_id < rhs_id || (lhs_id == rhs_id && entries_[lhs].offset < entries_[rhs].offset);
+  });
+}
+
+int64_t VisualNFrameArchive::getTimestampNanoseconds(size_t index) const {
+  CHECK_LT(index, entries_.size());
+  return entries_[index].timestamp_nanoseconds;
+}
+
+aslam::NFramesId VisualNFrameArchive::getNFrameId(size_t index) const {
+  CHECK_LT(index, entries_.size());
+  return getEntryId(entries_[index]);
+}
+
+void VisualNFrameArchive::getNFrame(size_t index, BinaryVisualNFrameView* nframe) const {
+  CHECK_NOTNULL(nframe);
+  CHECK_LT(index, entries_.size());
+  const size_t offset = entries_[index].offset;
+  CHECK(nframe->init(mapped_file_.data() + offset, mapped_file_.sizeBytes() - offset))
+      << "Malformed record at offset " << offset << ".";
+}
+
+bool VisualNFrameArchive::findNFrame(
+    const aslam::NFramesId& nframe_id, BinaryVisualNFrameView* nframe) const {
+  CHECK_NOTNULL(nframe);
+  std::vector<size_t>::const_iterator it = std::upper_bound(
+      entries_by_id_.begin(), entries_by_id_.end(), nframe_id,
+      [this](const aslam::NFramesId& id, size_t index) {
+    return id < getEntryId(entries_[index]);
+  });
+  if (it == entries_by_id_.begin() || getEntryId(entries_[*(it - 1)]) != nframe_id) {
+    return false;
+  }
+  getNFrame(*(it - 1), nframe);
+  return true;
+}
+
+size_t VisualNFrameArchive::findFirstNFrameNotBefore(int64_t timestamp_nanoseconds) const {
+  return std::lower_bound(entries_.begin(), entries_.end(), timestamp_nanoseconds,
+                          [](const ArchiveIndexEntry& entry, int64_t timestamp) {
+    return entry.timestamp_nanoseconds < timestamp;
+  }) - entries_.begin();
+}
+
+size_t VisualNFrameArchive::findClosestNFrame(int64_t timestamp_nanoseconds) const {
+  CHECK(!entries_.empty());
+  const size_t next = findFirstNFrameNotBefore(timestamp_nanoseconds);
+  if (next == entries_.size()) {
+    return next - 1u;
+  }
+  if (next == 0u) {
+    return 0u;
+  }
+  const int64_t time_to_next = entries_[next].timestamp_nanoseconds - timestamp_nanoseconds;
+  const int64_t time_to_previous =
+      timestamp_nanoseconds - entries_[next - 1u].timestamp_nanoseconds;
+  return time_to_previous <= time_to_next ? next - 1u : next;
+}
+
+}  // namespace aslam
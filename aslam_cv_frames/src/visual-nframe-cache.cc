@@ -0,0 +1,272 @@
+#include "aslam/frames/visual-nframe-cache.h"
+
+#include <iterator>
+
+#include <aslam/frames/binary-serialization.h>
+#include <aslam/frames/visual-frame.h>
+#include <glog/logging.h>
+
+namespace aslam {
+namespace {
+// A copy of the nframe without the payloads that are cheap to restore or rarely used later.
+std::shared_ptr<const VisualNFrame> createStrippedNFrame(const VisualNFrame& nframe) {
+  // The frames of the copy share the channels until they are removed from the copy.
+  std::shared_ptr<VisualNFrame> stripped_nframe(new VisualNFrame(nframe));
+  for (size_t frame_idx = 0u; frame_idx < stripped_nframe->getNumFrames(); ++frame_idx) {
+    if (!stripped_nframe->isFrameSet(frame_idx)) {
+      continue;
+    }
+    const VisualFrame::Ptr frame = stripped_nframe->getFrameShared(frame_idx);
+    // Also drops a compressed raw image, which the copy shares with the original.
+    if (frame->hasRawImage()) {
+      frame->releaseRawImage();
+    }
+    if (frame->hasImagePyramid()) {
+      frame->releaseImagePyramid();
+    }
+    if (frame->hasDescriptors()) {
+      frame->releaseDescriptors();
+    }
+  }
+  return stripped_nframe;
+}
+}  // namespace
+
+VisualNFrameCache::VisualNFrameCache(const Options& options)
+    : options_(options), memory_usage_bytes_(0u), is_spill_archive_stale_(false) {
+  if (!options_.spill_archive_path.empty()) {
+    CHECK(spill_writer_.open(options_.spill_archive_path))
+        << "Could not open the spill archive " << options_.spill_archive_path << ".";
+  }
+}
+
+VisualNFrameCache::~VisualNFrameCache() {
+  spill_archive_.close();
+  if (spill_writer_.isOpen()) {
+    spill_writer_.close();
+  }
+}
+
+void VisualNFrameCache::insert(const std::shared_ptr<const VisualNFrame>& nframe) {
+  CHECK(nframe);
+  std::lock_guard<std::mutex> lock(mutex_);
+  // A spilled nframe of the same id is outdated, the new one is spilled once it is stripped.
+  spilled_camera_rigs_.erase(nframe->getId());
+  insertLocked(nframe);
+  enforceBudgetLocked();
+}
+
+std::shared_ptr<const VisualNFrame> VisualNFrameCache::getNFrame(const NFramesId& nframe_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const EntryMap::iterator it = entries_.find(nframe_id);
+  if (it != entries_.end()) {
+    touchLocked(&it->second);
+    return it->second.nframe;
+  }
+  std::shared_ptr<const VisualNFrame> nframe = reloadLocked(nframe_id);
+  if (nframe) {
+    insertLocked(nframe);
+    enforceBudgetLocked();
+  }
+  return nframe;
+}
+
+std::shared_ptr<const VisualNFrame> VisualNFrameCache::getFullNFrame(
+    const NFramesId& nframe_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const EntryMap::iterator it = entries_.find(nframe_id);
+  if (it != entries_.end() && !it->second.is_stripped) {
+    touchLocked(&it->second);
+    return it->second.nframe;
+  }
+  std::shared_ptr<const VisualNFrame> nframe = reloadLocked(nframe_id);
+  if (nframe) {
+    insertLocked(nframe);
+    enforceBudgetLocked();
+  } else if (it != entries_.end()) {
+    // Without a spill archive the payloads are gone.
+    touchLocked(&it->second);
+    nframe = it->second.nframe;
+  }
+  return nframe;
+}
+
+std::shared_ptr<const VisualNFrame> VisualNFrameCache::getClosestNFrame(
+    int64_t timestamp_nanoseconds) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (timestamp_index_.empty()) {
+    return std::shared_ptr<const VisualNFrame>();
+  }
+  TimestampIndex::iterator closest = timestamp_index_.lower_bound(timestamp_nanoseconds);
+  if (closest == timestamp_index_.end()) {
+    --closest;
+  } else if (closest != timestamp_index_.begin()) {
+    const TimestampIndex::iterator previous = std::prev(closest);
+    // Compared as differences to the neighbours, which don't overflow for valid times.
+    if (timestamp_nanoseconds - previous->first <= closest->first - timestamp_nanoseconds) {
+      closest = previous;
+    }
+  }
+  Entry& entry = entries_.at(closest->second);
+  touchLocked(&entry);
+  return entry.nframe;
+}
+
+void VisualNFrameCache::getNFramesInRange(
+    int64_t begin_timestamp_nanoseconds, int64_t end_timestamp_nanoseconds,
+    std::vector<std::shared_ptr<const VisualNFrame>>* nframes) {
+  CHECK_NOTNULL(nframes)->clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (TimestampIndex::iterator it = timestamp_index_.lower_bound(begin_timestamp_nanoseconds);
+       it != timestamp_index_.end() && it->first < end_timestamp_nanoseconds; ++it) {
+    Entry& entry = entries_.at(it->second);
+    touchLocked(&entry);
+    nframes->push_back(entry.nframe);
+  }
+}
+
+bool VisualNFrameCache::hasNFrame(const NFramesId& nframe_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.count(nframe_id) > 0u;
+}
+
+void VisualNFrameCache::erase(const NFramesId& nframe_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const EntryMap::iterator it = entries_.find(nframe_id);
+  if (it != entries_.end()) {
+    eraseLocked(it);
+  }
+  // The record stays in the append-only archive, but is no longer reloaded.
+  spilled_camera_rigs_.erase(nframe_id);
+}
+
+void VisualNFrameCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  spilled_camera_rigs_.clear();
+  entries_.clear();
+  full_lru_.clear();
+  stripped_lru_.clear();
+  timestamp_index_.clear();
+  memory_usage_bytes_ = 0u;
+}
+
+size_t VisualNFrameCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+size_t VisualNFrameCache::getNumStrippedNFrames() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stripped_lru_.size();
+}
+
+size_t VisualNFrameCache::getMemoryUsageBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return memory_usage_bytes_;
+}
+
+void VisualNFrameCache::insertLocked(const std::shared_ptr<const VisualNFrame>& nframe) {
+  CHECK(nframe);
+  const EntryMap::iterator existing = entries_.find(nframe->getId());
+  if (existing != entries_.end()) {
+    eraseLocked(existing);
+  }
+  Entry& entry = entries_[nframe->getId()];
+  entry.nframe = nframe;
+  entry.memory_usage_bytes = nframe->getMemoryUsageBytes();
+  entry.is_stripped = false;
+  entry.lru_position = full_lru_.insert(full_lru_.begin(), nframe->getId());
+  entry.timestamp_position =
+      timestamp_index_.emplace(nframe->getMinTimestampNanoseconds(), nframe->getId());
+  memory_usage_bytes_ += entry.memory_usage_bytes;
+}
+
+void VisualNFrameCache::eraseLocked(EntryMap::iterator it) {
+  CHECK(it != entries_.end());
+  Entry& entry = it->second;
+  (entry.is_stripped ? stripped_lru_ : full_lru_).erase(entry.lru_position);
+  timestamp_index_.erase(entry.timestamp_position);
+  CHECK_GE(memory_usage_bytes_, entry.memory_usage_bytes);
+  memory_usage_bytes_ -= entry.memory_usage_bytes;
+  entries_.erase(it);
+}
+
+void VisualNFrameCache::touchLocked(Entry* entry) {
+  CHECK_NOTNULL(entry);
+  LruList& lru = entry->is_stripped ? stripped_lru_ : full_lru_;
+  lru.splice(lru.begin(), lru, entry->lru_position);
+}
+
+void VisualNFrameCache::enforceBudgetLocked() {
+  while (memory_usage_bytes_ > options_.max_memory_usage_bytes && !full_lru_.empty()) {
+    stripLocked(&entries_.at(full_lru_.back()));
+  }
+  while (memory_usage_bytes_ > options_.max_memory_usage_bytes && !stripped_lru_.empty()) {
+    eraseLocked(entries_.find(stripped_lru_.back()));
+  }
+}
+
+void VisualNFrameCache::stripLocked(Entry* entry) {
+  CHECK_NOTNULL(entry);
+  CHECK(!entry->is_stripped);
+  const NFramesId nframe_id = entry->nframe->getId();
+  if (spill_writer_.isOpen() && spilled_camera_rigs_.count(nframe_id) == 0u) {
+    if (spill_writer_.append(*entry->nframe)) {
+      spilled_camera_rigs_.emplace(
+          nframe_id, std::const_pointer_cast<NCamera>(entry->nframe->getNCameraShared()));
+      is_spill_archive_stale_ = true;
+    } else {
+      LOG(WARNING) << "Could not spill the nframe " << nframe_id << ", its payloads are dropped.";
+    }
+  }
+  entry->nframe = createStrippedNFrame(*entry->nframe);
+  CHECK_GE(memory_usage_bytes_, entry->memory_usage_bytes);
+  memory_usage_bytes_ -= entry->memory_usage_bytes;
+  entry->memory_usage_bytes = entry->nframe->getMemoryUsageBytes();
+  memory_usage_bytes_ += entry->memory_usage_bytes;
+  // The stripped nframes are evicted in the order they were last used as full nframes.
+  full_lru_.erase(entry->lru_position);
+  entry->lru_position = stripped_lru_.insert(stripped_lru_.begin(), nframe_id);
+  entry->is_stripped = true;
+}
+
+std::shared_ptr<const VisualNFrame> VisualNFrameCache::reloadLocked(const NFramesId& nframe_id) {
+  const std::unordered_map<NFramesId, std::shared_ptr<NCamera>>::const_iterator camera_rig =
+      spilled_camera_rigs_.find(nframe_id);
+  if (camera_rig == spilled_camera_rigs_.end()) {
+    return std::shared_ptr<const VisualNFrame>();
+  }
+  if (is_spill_archive_stale_) {
+    // The archive stays open, only the records appended since the last reload are indexed.
+    if (!spill_writer_.flush() || !(spill_archive_.isOpen() ? spill_archive_.update() :
+        spill_archive_.open(options_.spill_archive_path))) {
+      LOG(ERROR) << "Could not read the spill archive " << options_.spill_archive_path << ".";
+      return std::shared_ptr<const VisualNFrame>();
+    }
+    is_spill_archive_stale_ = false;
+  }
+  BinaryVisualNFrameView nframe_view;
+  CHECK(spill_archive_.findNFrame(nframe_id, &nframe_view))
+      << "The nframe " << nframe_id << " is missing in the spill archive.";
+  std::shared_ptr<VisualNFrame> nframe;
+  if (camera_rig->second) {
+    nframe.reset(new VisualNFrame(nframe_id, camera_rig->second));
+    CHECK_EQ(nframe->getNumFrames(), nframe_view.getNumFrames());
+  } else {
+    nframe.reset(new VisualNFrame(nframe_id, nframe_view.getNumFrames()));
+  }
+  for (size_t frame_idx = 0u; frame_idx < nframe_view.getNumFrames(); ++frame_idx) {
+    if (!nframe_view.isFrameSet(frame_idx)) {
+      continue;
+    }
+    VisualFrame::Ptr frame(new VisualFrame);
+    nframe_view.getFrame(frame_idx).copyToVisualFrame(frame.get());
+    if (camera_rig->second) {
+      frame->setCameraGeometry(camera_rig->second->getCameraShared(frame_idx));
+    }
+    nframe->setFrame(frame_idx, frame);
+  }
+  return nframe;
+}
+
+}  // namespace aslam
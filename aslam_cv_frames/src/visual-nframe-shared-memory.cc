@@ -0,0 +1,277 @@
+#include "aslam/frames/visual-nframe-shared-memory.h"
+
+#include <errno.h>
+#include <sys/mman.h>
+
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include <aslam/frames/visual-nframe.h>
+#include <glog/logging.h>
+
+namespace aslam {
+using namespace shared_memory;  // NOLINT
+
+namespace {
+SlotHeader* getSlot(char* data, const RingHeader& ring_header, uint64_t sequence) {
+  const size_t slot_idx = static_cast<size_t>(sequence % ring_header.num_slots);
+  return reinterpret_cast<SlotHeader*>(
+      data + sizeof(RingHeader) + slot_idx * (sizeof(SlotHeader) + ring_header.slot_size_bytes));
+}
+
+char* getSlotPayload(SlotHeader* slot) {
+  return reinterpret_cast<char*>(slot) + sizeof(SlotHeader);
+}
+}  // namespace
+
+VisualNFrameSharedMemoryPublisher::VisualNFrameSharedMemoryPublisher()
+    : next_sequence_(1u), num_published_(0u), num_dropped_(0u) {}
+
+VisualNFrameSharedMemoryPublisher::~VisualNFrameSharedMemoryPublisher() {
+  if (isOpen()) {
+    close();
+  }
+}
+
+bool VisualNFrameSharedMemoryPublisher::create(
+    const std::string& name, size_t num_slots, size_t slot_size_bytes) {
+  CHECK(!isOpen()) << "The ring " << name_ << " is still open.";
+  CHECK_GT(num_slots, 0u);
+  CHECK_GT(slot_size_bytes, 0u);
+  slot_size_bytes = binary_serialization::alignSize(slot_size_bytes);
+  const size_t size_bytes = getSharedMemorySizeBytes(num_slots, slot_size_bytes);
+
+  // Subscribers of a previous ring keep their mapping of the unlinked object.
+  ::shm_unlink(name.c_str());
+  if (!mapped_file_.createSharedMemory(name, size_bytes)) {
+    LOG(ERROR) << "Could not create " << name << ": " << std::strerror(errno);
+    return false;
+  }
+  name_ = name;
+  next_sequence_ = 1u;
+  num_published_ = 0u;
+  num_dropped_ = 0u;
+
+  // The object is zero-filled, the atomics are constructed in place.
+  RingHeader* ring_header = reinterpret_cast<RingHeader*>(mapped_file_.data());
+  ring_header->version = kRingFormatVersion;
+  ring_header->header_size_bytes = static_cast<uint16_t>(sizeof(RingHeader));
+  ring_header->num_slots = static_cast<uint32_t>(num_slots);
+  ring_header->slot_size_bytes = slot_size_bytes;
+  new (&ring_header->latest_sequence) std::atomic<uint64_t>(0u);
+  for (uint64_t slot_idx = 0u; slot_idx < num_slots; ++slot_idx) {
+    SlotHeader* slot = getSlot(mapped_file_.data(), *ring_header, slot_idx);
+    new (&slot->sequence) std::atomic<uint64_t>(0u);
+    new (&slot->reader_count) std::atomic<uint32_t>(0u);
+    slot->record_size_bytes = 0u;
+  }
+  // Subscribers check the magic first, hence it is written last.
+  std::atomic_thread_fence(std::memory_order_release);
+  ring_header->magic = kRingMagic;
+  return true;
+}
+
+void VisualNFrameSharedMemoryPublisher::close() {
+  CHECK(isOpen());
+  mapped_file_.close();
+  ::shm_unlink(name_.c_str());
+}
+
+bool VisualNFrameSharedMemoryPublisher::publish(const VisualNFrame& nframe) {
+  CHECK(isOpen());
+  RingHeader* ring_header = reinterpret_cast<RingHeader*>(mapped_file_.data());
+  serializer_.serializeVisualNFrame(nframe);
+  const size_t record_size_bytes = serializer_.getTotalSizeBytes();
+  if (record_size_bytes > ring_header->slot_size_bytes) {
+    LOG(WARNING) << "Dropping nframe " << nframe.getId().hexString() << " of "
+                 << record_size_bytes << " bytes, the slots of " << name_ << " hold "
+                 << ring_header->slot_size_bytes << " bytes.";
+    ++num_dropped_;
+    return false;
+  }
+
+  // A dropped nframe still uses up its sequence number, such that a slot pinned by a reader only
+  // loses its own turns instead of stalling the ring.
+  const uint64_t sequence = next_sequence_++;
+  SlotHeader* slot = getSlot(mapped_file_.data(), *ring_header, sequence);
+  uint32_t expected_reader_count = 0u;
+  if (!slot->reader_count.compare_exchange_strong(
+          expected_reader_count, kSlotWriterBit, std::memory_order_acq_rel)) {
+    ++num_dropped_;
+    return false;
+  }
+  slot->sequence.store(0u, std::memory_order_relaxed);
+  serializer_.copyToBuffer(getSlotPayload(slot));
+  slot->record_size_bytes = record_size_bytes;
+  slot->sequence.store(sequence, std::memory_order_relaxed);
+  slot->reader_count.store(0u, std::memory_order_release);
+  ring_header->latest_sequence.store(sequence, std::memory_order_release);
+  ++num_published_;
+  return true;
+}
+
+SharedVisualNFrame::SharedVisualNFrame(SharedVisualNFrame&& other)
+    : slot_(other.slot_), sequence_(other.sequence_), nframe_(std::move(other.nframe_)) {
+  other.slot_ = nullptr;
+  other.sequence_ = 0u;
+}
+
+SharedVisualNFrame& SharedVisualNFrame::operator=(SharedVisualNFrame&& other) {
+  if (this != &other) {
+    release();
+    slot_ = other.slot_;
+    sequence_ = other.sequence_;
+    nframe_ = std::move(other.nframe_);
+    other.slot_ = nullptr;
+    other.sequence_ = 0u;
+  }
+  return *this;
+}
+
+void SharedVisualNFrame::release() {
+  if (slot_ != nullptr) {
+    slot_->reader_count.fetch_sub(1u, std::memory_order_release);
+    slot_ = nullptr;
+    sequence_ = 0u;
+    nframe_ = BinaryVisualNFrameView();
+  }
+}
+
+VisualNFrameSharedMemorySubscriber::VisualNFrameSharedMemorySubscriber()
+    : next_sequence_(1u), num_missed_(0u) {}
+
+VisualNFrameSharedMemorySubscriber::~VisualNFrameSharedMemorySubscriber() {
+  if (isOpen()) {
+    close();
+  }
+}
+
+bool VisualNFrameSharedMemorySubscriber::open(const std::string& name) {
+  CHECK(!isOpen());
+  // The mapping is writable as the readers pin the slots in the shared memory.
+  common::MappedFile mapped_file;
+  if (!mapped_file.openSharedMemory(name)) {
+    LOG(ERROR) << "Could not open " << name << ": " << std::strerror(errno);
+    return false;
+  }
+  const size_t size_bytes = mapped_file.sizeBytes();
+  if (size_bytes < sizeof(RingHeader)) {
+    LOG(ERROR) << name << " is not a nframe ring.";
+    return false;
+  }
+
+  const RingHeader* ring_header = reinterpret_cast<const RingHeader*>(mapped_file.data());
+  const bool is_valid = ring_header->magic == kRingMagic;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (!is_valid || ring_header->version != kRingFormatVersion ||
+      ring_header->header_size_bytes != sizeof(RingHeader) || ring_header->num_slots == 0u ||
+      ring_header->slot_size_bytes % binary_serialization::kAlignmentBytes != 0u ||
+      getSharedMemorySizeBytes(ring_header->num_slots, ring_header->slot_size_bytes) !=
+          size_bytes) {
+    LOG(ERROR) << name << " is not a nframe ring of version " << kRingFormatVersion << ".";
+    return false;
+  }
+  mapped_file_ = std::move(mapped_file);
+  next_sequence_ = getLatestSequence() + 1u;
+  num_missed_ = 0u;
+  return true;
+}
+
+void VisualNFrameSharedMemorySubscriber::close() {
+  CHECK(isOpen());
+  mapped_file_.close();
+}
+
+uint64_t VisualNFrameSharedMemorySubscriber::getLatestSequence() const {
+  CHECK(isOpen());
+  return getRingHeader()->latest_sequence.load(std::memory_order_acquire);
+}
+
+bool VisualNFrameSharedMemorySubscriber::getNext(SharedVisualNFrame* nframe) {
+  CHECK_NOTNULL(nframe);
+  const uint64_t latest_sequence = getLatestSequence();
+  const uint64_t num_slots = getRingHeader()->num_slots;
+  if (next_sequence_ + num_slots <= latest_sequence) {
+    // The slots of the older nframes were overwritten already.
+    const uint64_t oldest_sequence = latest_sequence - num_slots + 1u;
+    num_missed_ += oldest_sequence - next_sequence_;
+    next_sequence_ = oldest_sequence;
+  }
+  while (next_sequence_ <= latest_sequence) {
+    const uint64_t sequence = next_sequence_++;
+    if (acquire(sequence, nframe) == AcquireResult::kAcquired) {
+      return true;
+    }
+    // Dropped by the publisher, overwritten while we were behind or malformed.
+    ++num_missed_;
+  }
+  return false;
+}
+
+bool VisualNFrameSharedMemorySubscriber::getLatest(SharedVisualNFrame* nframe) {
+  CHECK_NOTNULL(nframe);
+  while (true) {
+    const uint64_t latest_sequence = getLatestSequence();
+    if (latest_sequence < next_sequence_) {
+      return false;
+    }
+    const AcquireResult result = acquire(latest_sequence, nframe);
+    if (result == AcquireResult::kAcquired) {
+      num_missed_ += latest_sequence - next_sequence_;
+      next_sequence_ = latest_sequence + 1u;
+      return true;
+    }
+    if (result == AcquireResult::kMalformed) {
+      num_missed_ += latest_sequence - next_sequence_ + 1u;
+      next_sequence_ = latest_sequence + 1u;
+      return false;
+    }
+    // The publisher is overwriting the slot with a newer nframe.
+  }
+}
+
+VisualNFrameSharedMemorySubscriber::AcquireResult VisualNFrameSharedMemorySubscriber::acquire(
+    uint64_t sequence, SharedVisualNFrame* nframe) const {
+  CHECK_NOTNULL(nframe);
+  SlotHeader* slot = getSlotHeader(sequence);
+  uint32_t reader_count = slot->reader_count.load(std::memory_order_relaxed);
+  do {
+    if ((reader_count & kSlotWriterBit) != 0u) {
+      return AcquireResult::kBusy;
+    }
+  } while (!slot->reader_count.compare_exchange_weak(
+      reader_count, reader_count + 1u, std::memory_order_acquire, std::memory_order_relaxed));
+
+  // The slot can't be overwritten while it is pinned.
+  if (slot->sequence.load(std::memory_order_relaxed) != sequence) {
+    slot->reader_count.fetch_sub(1u, std::memory_order_release);
+    return AcquireResult::kBusy;
+  }
+  // The length is checked against the slot before the view reads the record.
+  BinaryVisualNFrameView view;
+  if (slot->record_size_bytes > getRingHeader()->slot_size_bytes ||
+      !view.init(getSlotPayload(slot), slot->record_size_bytes)) {
+    LOG(ERROR) << "The nframe " << sequence << " in the ring is malformed, its record has "
+               << slot->record_size_bytes << " bytes.";
+    slot->reader_count.fetch_sub(1u, std::memory_order_release);
+    return AcquireResult::kMalformed;
+  }
+  nframe->release();
+  nframe->slot_ = slot;
+  nframe->sequence_ = sequence;
+  nframe->nframe_ = std::move(view);
+  return AcquireResult::kAcquired;
+}
+
+RingHeader* VisualNFrameSharedMemorySubscriber::getRingHeader() const {
+  // The mapping is writable, the readers pin the slots through it.
+  return reinterpret_cast<RingHeader*>(const_cast<char*>(mapped_file_.data()));
+}
+
+SlotHeader* VisualNFrameSharedMemorySubscriber::getSlotHeader(uint64_t sequence) const {
+  RingHeader* ring_header = getRingHeader();
+  return getSlot(reinterpret_cast<char*>(ring_header), *ring_header, sequence);
+}
+
+}  // namespace aslam
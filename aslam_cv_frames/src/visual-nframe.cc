@@ -1,9 +1,11 @@
 #include <limits>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <aslam/cameras/camera.h>
 #include <aslam/cameras/ncamera.h>
+#include <aslam/common/channel-definitions.h>
 #include <aslam/common/memory.h>
 #include <aslam/common/pose-types.h>
 #include <aslam/common/predicates.h>
@@ -50,6 +52,7 @@ VisualNFrame& VisualNFrame::operator=(const VisualNFrame& other) {
       frames_.emplace_back(nullptr);
     }
   }
+  channels_ = channels::shareChannelGroup(other.channels_);
   return *this;
 }
 
@@ -197,6 +200,7 @@ bool VisualNFrame::operator==(const VisualNFrame& other) const {
   same &= id_ == other.id_;
   same &= aslam::checkSharedEqual(camera_rig_, other.camera_rig_);
   same &= frames_.size() == other.frames_.size();
+  same &= channels::isChannelGroupEqual(channels_, other.channels_);
   if(same) {
     for(size_t i = 0; i < frames_.size(); ++i) {
       same &= *CHECK_NOTNULL(frames_[i].get()) == *CHECK_NOTNULL(other.frames_[i].get());
@@ -209,6 +213,7 @@ bool VisualNFrame::compareWithoutCameraSystem(const VisualNFrame& other) const {
   bool same = true;
   same &= id_ == other.id_;
   same &= frames_.size() == other.frames_.size();
+  same &= channels::isChannelGroupEqual(channels_, other.channels_);
   if(same) {
     for(size_t i = 0; i < frames_.size(); ++i) {
       same &= CHECK_NOTNULL(frames_[i].get())->compareWithoutCameraGeometry(
@@ -256,6 +261,57 @@ void VisualNFrame::clearKeypointChannelsOfAllFrames() {
     CHECK(frame);
     frame->clearKeypointChannels();
   }
+  // The matches refer to the cleared keypoints.
+  if (hasIntraRigMatches()) {
+    getIntraRigMatchesMutable()->resize(Eigen::NoChange, 0);
+  }
+}
+
+bool VisualNFrame::hasIntraRigMatches() const {
+  return aslam::channels::has_INTRA_RIG_MATCHES_Channel(channels_);
+}
+
+const Eigen::Matrix4Xi& VisualNFrame::getIntraRigMatches() const {
+  return aslam::channels::get_INTRA_RIG_MATCHES_Data(channels_);
+}
+
+Eigen::Matrix4Xi* VisualNFrame::getIntraRigMatchesMutable() {
+  Eigen::Matrix4Xi& intra_rig_matches =
+      aslam::channels::get_INTRA_RIG_MATCHES_DataMutable(&channels_);
+  return &intra_rig_matches;
+}
+
+void VisualNFrame::setIntraRigMatches(const Eigen::Matrix4Xi& intra_rig_matches) {
+  if (!aslam::channels::has_INTRA_RIG_MATCHES_Channel(channels_)) {
+    aslam::channels::add_INTRA_RIG_MATCHES_Channel(&channels_);
+  }
+  Eigen::Matrix4Xi& data =
+      aslam::channels::get_INTRA_RIG_MATCHES_DataMutable(&channels_, false);
+  data = intra_rig_matches;
+}
+
+void VisualNFrame::releaseIntraRigMatches() {
+  if (aslam::channels::has_INTRA_RIG_MATCHES_Channel(channels_)) {
+    aslam::channels::remove_INTRA_RIG_MATCHES_Channel(&channels_);
+  }
+}
+
+size_t VisualNFrame::getMemoryUsageBytes(const std::string& tag,
+                                         common::MemoryUsageReport* report) const {
+  const size_t other_bytes =
+      sizeof(*this) + frames_.capacity() * sizeof(std::shared_ptr<VisualFrame>);
+  if (report != nullptr) {
+    report->add(tag + "/other", other_bytes);
+  }
+  size_t num_bytes =
+      other_bytes + aslam::channels::getChannelGroupMemoryUsageBytes(channels_, tag, report);
+  for (size_t frame_idx = 0u; frame_idx < frames_.size(); ++frame_idx) {
+    if (frames_[frame_idx]) {
+      num_bytes += frames_[frame_idx]->getMemoryUsageBytes(
+          tag + "/frame_" + std::to_string(frame_idx), report);
+    }
+  }
+  return num_bytes;
 }
 
 } // namespace aslam
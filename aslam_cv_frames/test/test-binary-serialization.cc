@@ -0,0 +1,325 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <eigen-checks/gtest.h>
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/channel-serialization.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/opencv-predicates.h>
+#include <aslam/frames/binary-serialization.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+
+namespace aslam {
+
+VisualFrame::Ptr createTestFrame(const Camera::ConstPtr& camera, int64_t timestamp_nanoseconds,
+                                 size_t num_keypoints) {
+  VisualFrame::Ptr frame(new VisualFrame);
+  FrameId frame_id;
+  frame_id.randomize();
+  frame->setId(frame_id);
+  frame->setCameraGeometry(camera);
+  frame->setTimestampNanoseconds(timestamp_nanoseconds);
+  frame->setKeypointMeasurements(Eigen::Matrix2Xd::Random(2, num_keypoints));
+  frame->setKeypointScores(Eigen::VectorXd::Random(num_keypoints));
+  frame->setDescriptors(
+      VisualFrame::DescriptorsT::Constant(48, num_keypoints, static_cast<unsigned char>(7)));
+  frame->setTrackIds(Eigen::VectorXi::LinSpaced(num_keypoints, 0, num_keypoints - 1));
+  cv::Mat image(31, 17, CV_8UC1);
+  cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+  frame->setRawImage(image);
+  return frame;
+}
+
+/// Copy the serialized record into a buffer aligned like a memory mapped file.
+const char* copyToAlignedBuffer(const BinaryFrameSerializer& serializer,
+                                std::vector<uint64_t>* storage) {
+  CHECK_NOTNULL(storage)->resize((serializer.getTotalSizeBytes() + 63u) / sizeof(uint64_t));
+  char* buffer = reinterpret_cast<char*>(storage->data());
+  // std::vector<uint64_t> is only 8 byte aligned.
+  buffer += (64u - reinterpret_cast<uintptr_t>(buffer) % 64u) % 64u;
+  serializer.copyToBuffer(buffer);
+  return buffer;
+}
+
+TEST(BinarySerialization, FrameRoundTripWithoutCopies) {
+  NCamera::Ptr ncamera = NCamera::createTestNCamera(1);
+  VisualFrame::Ptr frame = createTestFrame(ncamera->getCameraShared(0), 12345, 100u);
+
+  BinaryFrameSerializer serializer;
+  serializer.serializeVisualFrame(*frame);
+  EXPECT_EQ(0u, serializer.getTotalSizeBytes() % binary_serialization::kAlignmentBytes);
+  // The payload iovecs point into the frame instead of into copies.
+  bool found_keypoint_memory = false;
+  for (const iovec& io_vector : serializer.getIoVectors()) {
+    found_keypoint_memory |= io_vector.iov_base == frame->getKeypointMeasurements().data();
+  }
+  EXPECT_TRUE(found_keypoint_memory);
+
+  std::vector<uint64_t> storage;
+  const char* buffer = copyToAlignedBuffer(serializer, &storage);
+  BinaryVisualFrameView view;
+  ASSERT_TRUE(view.init(buffer, serializer.getTotalSizeBytes()));
+  EXPECT_EQ(12345, view.getTimestampNanoseconds());
+  EXPECT_EQ(frame->getId(), view.getId());
+  EXPECT_EQ(ncamera->getCameraShared(0)->getId(), view.getCameraId());
+  EXPECT_EQ(5u, view.getNumChannels());
+
+  Eigen::Map<const Eigen::MatrixXd> keypoints =
+      view.getMatrixChannel<double>("VISUAL_KEYPOINT_MEASUREMENTS");
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(keypoints.data()) % 64u);
+  EXPECT_GE(reinterpret_cast<const char*>(keypoints.data()), buffer);
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(frame->getKeypointMeasurements(), keypoints));
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(frame->getDescriptors(),
+                                 view.getMatrixChannel<unsigned char>("DESCRIPTORS")));
+  EXPECT_TRUE(gtest_catkin::ImagesEqual(frame->getRawImage(), view.getImageChannel("RAW_IMAGE")));
+
+  VisualFrame frame_copy;
+  view.copyToVisualFrame(&frame_copy);
+  frame_copy.setCameraGeometry(frame->getCameraGeometry());
+  EXPECT_EQ(*frame, frame_copy);
+}
+
+TEST(BinarySerialization, CompressedRawImageIsWrittenDecoded) {
+  NCamera::Ptr ncamera = NCamera::createTestNCamera(1);
+  VisualFrame::Ptr frame = createTestFrame(ncamera->getCameraShared(0), 12345, 100u);
+  const cv::Mat image = frame->getRawImage().clone();
+  BinaryFrameSerializer serializer;
+  serializer.serializeVisualFrame(*frame);
+  const size_t size_bytes = serializer.getTotalSizeBytes();
+
+  frame->compressRawImage();
+  ASSERT_TRUE(frame->hasCompressedRawImage());
+  frame->releaseDecompressedRawImage();
+  BinaryFrameSerializer compressed_serializer;
+  compressed_serializer.serializeVisualFrame(*frame);
+  EXPECT_EQ(size_bytes, compressed_serializer.getTotalSizeBytes());
+
+  std::vector<uint64_t> storage;
+  const char* buffer = copyToAlignedBuffer(compressed_serializer, &storage);
+  BinaryVisualFrameView view;
+  ASSERT_TRUE(view.init(buffer, compressed_serializer.getTotalSizeBytes()));
+  EXPECT_EQ(5u, view.getNumChannels());
+  EXPECT_TRUE(gtest_catkin::ImagesEqual(image, view.getImageChannel("RAW_IMAGE")));
+
+  VisualFrame frame_copy;
+  view.copyToVisualFrame(&frame_copy);
+  EXPECT_FALSE(frame_copy.hasCompressedRawImage());
+  EXPECT_TRUE(gtest_catkin::ImagesEqual(image, frame_copy.getRawImage()));
+}
+
+TEST(BinarySerialization, SerializerWritesIntoChannelSinks) {
+  NCamera::Ptr ncamera = NCamera::createTestNCamera(1);
+  VisualFrame::Ptr frame = createTestFrame(ncamera->getCameraShared(0), 12345, 100u);
+  BinaryFrameSerializer serializer;
+  serializer.serializeVisualFrame(*frame);
+  const size_t size_bytes = serializer.getTotalSizeBytes();
+  std::vector<char> expected_record(size_bytes);
+  serializer.copyToBuffer(expected_record.data());
+
+  // The iovec sink references the same memory as the serializer.
+  internal::IoVectorSerializationSink io_vector_sink;
+  ASSERT_TRUE(serializer.writeToSink(&io_vector_sink));
+  EXPECT_EQ(size_bytes, io_vector_sink.getNumBytes());
+  ASSERT_EQ(serializer.getIoVectors().size(), io_vector_sink.getIoVectors().size());
+  for (size_t i = 0u; i < serializer.getIoVectors().size(); ++i) {
+    EXPECT_EQ(serializer.getIoVectors()[i].iov_base, io_vector_sink.getIoVectors()[i].iov_base);
+  }
+
+  std::ostringstream stream;
+  ASSERT_TRUE(serializer.writeToStream(&stream));
+  EXPECT_EQ(std::string(expected_record.begin(), expected_record.end()), stream.str());
+
+  std::vector<char> short_buffer(size_bytes - 1u);
+  internal::BufferSerializationSink short_buffer_sink(short_buffer.data(), short_buffer.size());
+  EXPECT_FALSE(serializer.writeToSink(&short_buffer_sink));
+}
+
+TEST(BinarySerialization, LazyFrameDecodesChannelsOnAccess) {
+  NCamera::Ptr ncamera = NCamera::createTestNCamera(1);
+  VisualFrame::Ptr frame = createTestFrame(ncamera->getCameraShared(0), 12345, 100u);
+
+  BinaryFrameSerializer serializer;
+  serializer.serializeVisualFrame(*frame);
+  std::shared_ptr<std::vector<uint64_t>> storage(new std::vector<uint64_t>);
+  const char* buffer = copyToAlignedBuffer(serializer, storage.get());
+  BinaryVisualFrameView view;
+  ASSERT_TRUE(view.init(buffer, serializer.getTotalSizeBytes()));
+
+  VisualFrame lazy_frame;
+  view.createLazyVisualFrame(storage, &lazy_frame);
+  lazy_frame.setCameraGeometry(frame->getCameraGeometry());
+  EXPECT_TRUE(lazy_frame.hasKeypointMeasurements());
+  EXPECT_TRUE(lazy_frame.hasRawImage());
+
+  // Re-serializing writes the undecoded payloads straight from the buffer.
+  BinaryFrameSerializer lazy_serializer;
+  lazy_serializer.serializeVisualFrame(lazy_frame);
+  ASSERT_EQ(serializer.getTotalSizeBytes(), lazy_serializer.getTotalSizeBytes());
+  bool found_buffer_memory = false;
+  for (const iovec& io_vector : lazy_serializer.getIoVectors()) {
+    found_buffer_memory |= io_vector.iov_base ==
+        view.getMatrixChannel<double>("VISUAL_KEYPOINT_MEASUREMENTS").data();
+  }
+  EXPECT_TRUE(found_buffer_memory);
+
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(frame->getKeypointMeasurements(),
+                                 lazy_frame.getKeypointMeasurements()));
+  EXPECT_NE(view.getMatrixChannel<double>("VISUAL_KEYPOINT_MEASUREMENTS").data(),
+            lazy_frame.getKeypointMeasurements().data());
+  EXPECT_EQ(*frame, lazy_frame);
+
+  // The decoded channels own their memory.
+  storage.reset();
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(frame->getDescriptors(), lazy_frame.getDescriptors()));
+  EXPECT_TRUE(gtest_catkin::ImagesEqual(frame->getRawImage(), lazy_frame.getRawImage()));
+}
+
+TEST(BinarySerialization, FrameWithLineSegments) {
+  NCamera::Ptr ncamera = NCamera::createTestNCamera(1);
+  VisualFrame::Ptr frame = createTestFrame(ncamera->getCameraShared(0), 123, 10u);
+  const size_t kNumLineSegments = 23u;
+  Eigen::Matrix4Xd line_segments = Eigen::Matrix4Xd::Random(4, kNumLineSegments);
+  Eigen::VectorXd line_segment_scores = Eigen::VectorXd::Random(kNumLineSegments);
+  frame->swapLineSegments(&line_segments);
+  frame->swapLineSegmentScores(&line_segment_scores);
+  ASSERT_TRUE(frame->hasLineSegments());
+  ASSERT_TRUE(frame->hasLineSegmentScores());
+  EXPECT_EQ(kNumLineSegments, frame->getNumLineSegments());
+
+  BinaryFrameSerializer serializer;
+  serializer.serializeVisualFrame(*frame);
+  std::vector<uint64_t> storage;
+  const char* buffer = copyToAlignedBuffer(serializer, &storage);
+  BinaryVisualFrameView view;
+  ASSERT_TRUE(view.init(buffer, serializer.getTotalSizeBytes()));
+  EXPECT_EQ(7u, view.getNumChannels());
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(frame->getLineSegments(),
+                                 view.getMatrixChannel<double>("VISUAL_LINE_SEGMENTS")));
+
+  VisualFrame frame_copy;
+  view.copyToVisualFrame(&frame_copy);
+  frame_copy.setCameraGeometry(frame->getCameraGeometry());
+  ASSERT_TRUE(frame_copy.hasLineSegments());
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(frame->getLineSegments(), frame_copy.getLineSegments()));
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(frame->getLineSegmentScores(),
+                                 frame_copy.getLineSegmentScores()));
+  EXPECT_EQ(*frame, frame_copy);
+}
+
+TEST(BinarySerialization, FrameRoundTripOfAllStandardChannels) {
+  NCamera::Ptr ncamera = NCamera::createTestNCamera(1);
+  const size_t kNumKeypoints = 20u;
+  VisualFrame::Ptr frame = createTestFrame(ncamera->getCameraShared(0), 123, kNumKeypoints);
+  frame->setKeypointMeasurementUncertainties(Eigen::VectorXd::Random(kNumKeypoints));
+  frame->setKeypointOrientations(Eigen::VectorXd::Random(kNumKeypoints));
+  frame->setKeypointScales(Eigen::VectorXd::Random(kNumKeypoints));
+  Eigen::Matrix4Xd line_segments = Eigen::Matrix4Xd::Random(4, 3);
+  Eigen::VectorXd line_segment_scores = Eigen::VectorXd::Random(3);
+  frame->swapLineSegments(&line_segments);
+  frame->swapLineSegmentScores(&line_segment_scores);
+
+  BinaryFrameSerializer serializer;
+  serializer.serializeVisualFrame(*frame);
+  std::vector<uint64_t> storage;
+  const char* buffer = copyToAlignedBuffer(serializer, &storage);
+  BinaryVisualFrameView view;
+  ASSERT_TRUE(view.init(buffer, serializer.getTotalSizeBytes()));
+  // No channel is dropped, including the one with the longest name.
+  EXPECT_EQ(10u, view.getNumChannels());
+  EXPECT_TRUE(view.hasChannel("VISUAL_KEYPOINT_MEASUREMENT_UNCERTAINTIES"));
+
+  VisualFrame frame_copy;
+  view.copyToVisualFrame(&frame_copy);
+  frame_copy.setCameraGeometry(frame->getCameraGeometry());
+  ASSERT_TRUE(frame_copy.hasKeypointMeasurementUncertainties());
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(frame->getKeypointMeasurementUncertainties(),
+                                 frame_copy.getKeypointMeasurementUncertainties()));
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(frame->getKeypointOrientations(),
+                                 frame_copy.getKeypointOrientations()));
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(frame->getKeypointScales(), frame_copy.getKeypointScales()));
+  EXPECT_EQ(*frame, frame_copy);
+
+  VisualFrame lazy_frame;
+  std::shared_ptr<const void> unowned_buffer(buffer, [](const void*) {});
+  view.createLazyVisualFrame(unowned_buffer, &lazy_frame);
+  lazy_frame.setCameraGeometry(frame->getCameraGeometry());
+  EXPECT_EQ(*frame, lazy_frame);
+}
+
+TEST(BinarySerialization, RejectsChannelsWithInconsistentSize) {
+  NCamera::Ptr ncamera = NCamera::createTestNCamera(1);
+  VisualFrame::Ptr frame = createTestFrame(ncamera->getCameraShared(0), 123, 10u);
+  BinaryFrameSerializer serializer;
+  serializer.serializeVisualFrame(*frame);
+  std::vector<uint64_t> storage;
+  char* buffer = const_cast<char*>(copyToAlignedBuffer(serializer, &storage));
+  BinaryVisualFrameView view;
+  ASSERT_TRUE(view.init(buffer, serializer.getTotalSizeBytes()));
+
+  binary_serialization::BinaryChannelEntry* entries =
+      reinterpret_cast<binary_serialization::BinaryChannelEntry*>(
+          buffer + sizeof(binary_serialization::BinaryFrameHeader));
+  // The dimensions claim more data than the payload holds.
+  ++entries[0].cols;
+  EXPECT_FALSE(view.init(buffer, serializer.getTotalSizeBytes()));
+  --entries[0].cols;
+  entries[0].depth = 42u;
+  EXPECT_FALSE(view.init(buffer, serializer.getTotalSizeBytes()));
+}
+
+TEST(BinarySerialization, NFrameRoundTripThroughFile) {
+  NCamera::Ptr ncamera = NCamera::createTestNCamera(3);
+  NFramesId nframe_id;
+  nframe_id.randomize();
+  VisualNFrame nframe(nframe_id, ncamera);
+  nframe.setFrame(0, createTestFrame(ncamera->getCameraShared(0), 10, 50u));
+  nframe.setFrame(2, createTestFrame(ncamera->getCameraShared(2), 20, 0u));
+
+  char file_name[] = "/tmp/test-binary-serialization-XXXXXX";
+  const int file_descriptor = mkstemp(file_name);
+  ASSERT_GE(file_descriptor, 0);
+  BinaryFrameSerializer serializer;
+  serializer.serializeVisualNFrame(nframe);
+  ASSERT_TRUE(serializer.writeToFileDescriptor(file_descriptor));
+  struct stat file_stat;
+  ASSERT_EQ(0, fstat(file_descriptor, &file_stat));
+  ASSERT_EQ(serializer.getTotalSizeBytes(), static_cast<size_t>(file_stat.st_size));
+
+  void* mapped = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+  ASSERT_NE(MAP_FAILED, mapped);
+  BinaryVisualNFrameView view;
+  ASSERT_TRUE(view.init(static_cast<const char*>(mapped), file_stat.st_size));
+  EXPECT_EQ(nframe_id, view.getId());
+  ASSERT_EQ(3u, view.getNumFrames());
+  EXPECT_TRUE(view.isFrameSet(0));
+  EXPECT_FALSE(view.isFrameSet(1));
+  EXPECT_TRUE(view.isFrameSet(2));
+  EXPECT_EQ(20, view.getFrame(2).getTimestampNanoseconds());
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(
+      nframe.getFrame(0).getKeypointMeasurements(),
+      view.getFrame(0).getMatrixChannel<double>("VISUAL_KEYPOINT_MEASUREMENTS")));
+  EXPECT_EQ(0, view.getFrame(2).getMatrixChannel<double>("VISUAL_KEYPOINT_MEASUREMENTS").cols());
+
+  // A truncated buffer is rejected.
+  EXPECT_FALSE(view.init(static_cast<const char*>(mapped), file_stat.st_size - 64));
+
+  munmap(mapped, file_stat.st_size);
+  close(file_descriptor);
+  unlink(file_name);
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
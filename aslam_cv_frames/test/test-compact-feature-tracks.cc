@@ -0,0 +1,95 @@
+#include <eigen-checks/gtest.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/compact-feature-tracks.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+
+namespace aslam {
+constexpr size_t kNumNFrames = 5u;
+constexpr size_t kNumKeypoints = 10u;
+
+class CompactFeatureTracksTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ncamera_ = NCamera::createTestNCamera(2);
+    for (size_t i = 0u; i < kNumNFrames; ++i) {
+      VisualNFrame::Ptr nframe = VisualNFrame::createEmptyTestVisualNFrame(ncamera_, i + 1u);
+      for (size_t frame_idx = 0u; frame_idx < nframe->getNumFrames(); ++frame_idx) {
+        nframe->getFrameShared(frame_idx)->setKeypointMeasurements(
+            Eigen::Matrix2Xd::Random(2, kNumKeypoints));
+      }
+      EXPECT_EQ(i, nframe_pool_.addNFrame(nframe));
+      nframes_.push_back(nframe);
+    }
+  }
+
+  NCamera::Ptr ncamera_;
+  std::vector<VisualNFrame::Ptr> nframes_;
+  VisualNFramePool nframe_pool_;
+};
+
+TEST_F(CompactFeatureTracksTest, BuildAndExpandTracks) {
+  CompactFeatureTracks tracks;
+  tracks.reserve(2u, 2u * kNumNFrames);
+  EXPECT_EQ(0u, tracks.beginTrack(7u));
+  for (size_t i = 0u; i < kNumNFrames; ++i) {
+    tracks.addObservationToLastTrack(i, 0u, i);
+  }
+  EXPECT_EQ(1u, tracks.beginTrack(9u));
+  tracks.addObservationToLastTrack(3u, 1u, 2u);
+  tracks.addObservationToLastTrack(4u, 1u, 5u);
+
+  ASSERT_EQ(2u, tracks.getNumTracks());
+  EXPECT_EQ(kNumNFrames + 2u, tracks.getNumObservations());
+  EXPECT_EQ(7u, tracks.getTrackId(0u));
+  EXPECT_EQ(kNumNFrames, tracks.getTrackLength(0u));
+  EXPECT_EQ(9u, tracks.getTrackId(1u));
+  ASSERT_EQ(2u, tracks.getTrackLength(1u));
+
+  const CompactKeypointIdentifier* observations = tracks.getObservations(1u);
+  EXPECT_EQ(4u, observations[1].nframe_index);
+  EXPECT_EQ(1u, observations[1].frame_index);
+  EXPECT_EQ(5u, observations[1].keypoint_index);
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(
+      nframes_[4]->getFrame(1).getKeypointMeasurement(5),
+      nframe_pool_.getKeypointMeasurement(observations[1])));
+
+  const FeatureTrack feature_track = tracks.getFeatureTrack(0u, nframe_pool_);
+  EXPECT_EQ(7u, feature_track.getTrackId());
+  ASSERT_EQ(kNumNFrames, feature_track.getTrackLength());
+  for (size_t i = 0u; i < kNumNFrames; ++i) {
+    const KeypointIdentifier& keypoint = feature_track.getKeypointIdentifiers()[i];
+    EXPECT_EQ(nframes_[i]->getId(), keypoint.getNFrameId());
+    EXPECT_EQ(0u, keypoint.getFrameIndex());
+    EXPECT_EQ(i, keypoint.getKeypointIndex());
+  }
+
+  tracks.clear();
+  EXPECT_EQ(0u, tracks.getNumTracks());
+  EXPECT_EQ(0u, tracks.getNumObservations());
+}
+
+TEST_F(CompactFeatureTracksTest, SlidingWindow) {
+  std::weak_ptr<VisualNFrame> oldest_nframe_weak = nframes_[0];
+  nframes_.clear();
+
+  nframe_pool_.releaseNFramesBefore(2u);
+  EXPECT_TRUE(oldest_nframe_weak.expired());
+  EXPECT_EQ(2u, nframe_pool_.getFirstIndex());
+  EXPECT_EQ(kNumNFrames, nframe_pool_.getEndIndex());
+  EXPECT_EQ(kNumNFrames - 2u, nframe_pool_.size());
+  EXPECT_FALSE(nframe_pool_.hasNFrame(1u));
+  EXPECT_TRUE(nframe_pool_.hasNFrame(2u));
+
+  // Indices stay stable.
+  VisualNFrame::Ptr nframe = VisualNFrame::createEmptyTestVisualNFrame(ncamera_, 100);
+  EXPECT_EQ(kNumNFrames, nframe_pool_.addNFrame(nframe));
+  EXPECT_EQ(nframe.get(), &nframe_pool_.getNFrame(kNumNFrames));
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/opencv-predicates.h>
+#include <aslam/common/thread-pool.h>
+#include <aslam/frames/compressed-image.h>
+#include <aslam/frames/visual-frame.h>
+
+namespace aslam {
+
+namespace {
+/// A smooth gradient with noise, compressible like a camera image.
+cv::Mat createTestImage(int type) {
+  cv::Mat image(150, 200, type);
+  cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(8));
+  cv::Mat gradient(image.size(), type);
+  for (int row = 0; row < gradient.rows; ++row) {
+    gradient.row(row).setTo(cv::Scalar::all(row));
+  }
+  image += gradient;
+  return image;
+}
+}  // namespace
+
+TEST(CompressedImage, LosslessRoundTrip) {
+  for (int type : {CV_8UC1, CV_8UC3, CV_16UC1}) {
+    const cv::Mat image = createTestImage(type);
+    CompressedImage::Options options;
+    options.strip_height_px = 32u;
+    CompressedImage compressed_image(image, options);
+    EXPECT_FALSE(compressed_image.isCompressed());
+    compressed_image.compress();
+    ASSERT_TRUE(compressed_image.isCompressed());
+    EXPECT_GT(compressed_image.getCompressedSizeBytes(), 0u);
+    EXPECT_LT(compressed_image.getCompressedSizeBytes(), image.total() * image.elemSize());
+
+    EXPECT_EQ(image.size(), compressed_image.size());
+    EXPECT_EQ(type, compressed_image.type());
+    const cv::Mat& decoded_image = compressed_image.getImage();
+    EXPECT_TRUE(gtest_catkin::ImagesEqual(image, decoded_image));
+    // The decoded image is kept.
+    EXPECT_EQ(decoded_image.data, compressed_image.getImage().data);
+  }
+}
+
+TEST(CompressedImage, PatchesSpanningStrips) {
+  const cv::Mat image = createTestImage(CV_8UC1);
+  CompressedImage::Options options;
+  options.strip_height_px = 16u;
+  CompressedImage compressed_image(image, options);
+  compressed_image.compress();
+
+  for (const cv::Rect& roi : {cv::Rect(10, 5, 20, 8), cv::Rect(30, 10, 40, 50),
+                              cv::Rect(180, 140, 40, 40), cv::Rect(-5, -5, 10, 10)}) {
+    cv::Mat patch;
+    const cv::Rect clipped_roi = compressed_image.getPatch(roi, &patch);
+    EXPECT_EQ(roi & cv::Rect(0, 0, image.cols, image.rows), clipped_roi);
+    EXPECT_TRUE(gtest_catkin::ImagesEqual(image(clipped_roi), patch));
+  }
+  cv::Mat patch;
+  EXPECT_EQ(0, compressed_image.getPatch(cv::Rect(300, 300, 10, 10), &patch).area());
+  EXPECT_TRUE(patch.empty());
+}
+
+TEST(CompressedImage, VisualFrameRawImage) {
+  const cv::Mat image = createTestImage(CV_8UC1);
+  VisualFrame frame;
+  frame.setRawImage(image.clone());
+
+  ThreadPool thread_pool(1u);
+  frame.compressRawImage(CompressedImage::Options(), &thread_pool);
+  EXPECT_TRUE(frame.hasRawImage());
+  EXPECT_TRUE(frame.hasCompressedRawImage());
+  // Valid both before and after the asynchronous compression finished.
+  EXPECT_TRUE(gtest_catkin::ImagesEqual(image, frame.getRawImage()));
+  thread_pool.waitForEmptyQueue();
+  frame.releaseDecompressedRawImage();
+
+  cv::Mat patch;
+  const cv::Rect roi(50, 60, 30, 30);
+  EXPECT_EQ(roi, frame.getRawImagePatch(roi, &patch));
+  EXPECT_TRUE(gtest_catkin::ImagesEqual(image(roi), patch));
+  EXPECT_TRUE(gtest_catkin::ImagesEqual(image, frame.getRawImage()));
+
+  // Copies share the compressed image, a mutable access decompresses it into the frame.
+  VisualFrame frame_copy(frame);
+  EXPECT_TRUE(frame_copy.hasCompressedRawImage());
+  frame_copy.getRawImageMutable()->setTo(0);
+  EXPECT_FALSE(frame_copy.hasCompressedRawImage());
+  EXPECT_TRUE(gtest_catkin::ImagesEqual(image, frame.getRawImage()));
+
+  frame.releaseRawImage();
+  EXPECT_FALSE(frame.hasRawImage());
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
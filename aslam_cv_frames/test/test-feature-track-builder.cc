@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/feature-track-builder.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+
+namespace aslam {
+
+class FeatureTrackBuilderTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ncamera_ = NCamera::createTestNCamera(1);
+  }
+
+  VisualNFrame::Ptr createNFrame(const std::vector<int>& track_ids) {
+    VisualNFrame::Ptr nframe =
+        VisualNFrame::createEmptyTestVisualNFrame(ncamera_, nframes_.size() + 1);
+    VisualFrame::Ptr frame = nframe->getFrameShared(0);
+    frame->setKeypointMeasurements(Eigen::Matrix2Xd::Random(2, track_ids.size()));
+    frame->setTrackIds(Eigen::Map<const Eigen::VectorXi>(track_ids.data(), track_ids.size()));
+    nframes_.push_back(nframe);
+    return nframe;
+  }
+
+  void expectTrack(const FeatureTrack& track, size_t track_id,
+                   const std::vector<std::pair<size_t, size_t>>& nframe_keypoint_indices) {
+    EXPECT_EQ(track_id, track.getTrackId());
+    ASSERT_EQ(nframe_keypoint_indices.size(), track.getTrackLength());
+    for (size_t i = 0u; i < nframe_keypoint_indices.size(); ++i) {
+      const KeypointIdentifier& keypoint = track.getKeypointIdentifiers()[i];
+      EXPECT_EQ(nframes_[nframe_keypoint_indices[i].first]->getId(), keypoint.getNFrameId());
+      EXPECT_EQ(0u, keypoint.getFrameIndex());
+      EXPECT_EQ(nframe_keypoint_indices[i].second, keypoint.getKeypointIndex());
+    }
+  }
+
+  NCamera::Ptr ncamera_;
+  std::vector<VisualNFrame::Ptr> nframes_;
+};
+
+TEST_F(FeatureTrackBuilderTest, BuildsAndTerminatesTracks) {
+  FeatureTrackBuilder builder;
+  std::vector<FeatureTracks> terminated_tracks;
+
+  builder.addNFrame(createNFrame({0, 1, -1}), &terminated_tracks);
+  ASSERT_EQ(1u, terminated_tracks.size());
+  EXPECT_TRUE(terminated_tracks[0].empty());
+  EXPECT_EQ(2u, builder.getNumLiveTracks());
+
+  builder.addNFrame(createNFrame({1, 0, 2}), &terminated_tracks);
+  EXPECT_TRUE(terminated_tracks[0].empty());
+  EXPECT_EQ(3u, builder.getNumLiveTracks());
+
+  // Tracks 0 and 1 are not continued.
+  builder.addNFrame(createNFrame({2, -1, 3}), &terminated_tracks);
+  ASSERT_EQ(2u, terminated_tracks[0].size());
+  std::sort(terminated_tracks[0].begin(), terminated_tracks[0].end(),
+            [](const FeatureTrack& lhs, const FeatureTrack& rhs) {
+    return lhs.getTrackId() < rhs.getTrackId();
+  });
+  expectTrack(terminated_tracks[0][0], 0u, {{0u, 0u}, {1u, 1u}});
+  expectTrack(terminated_tracks[0][1], 1u, {{0u, 1u}, {1u, 0u}});
+  EXPECT_EQ(2u, builder.getNumLiveTracks());
+  // The first nframe is not referenced by a live track anymore.
+  EXPECT_EQ(2u, builder.getNumNFramesInWindow());
+
+  builder.terminateAllTracks(&terminated_tracks);
+  ASSERT_EQ(2u, terminated_tracks[0].size());
+  std::sort(terminated_tracks[0].begin(), terminated_tracks[0].end(),
+            [](const FeatureTrack& lhs, const FeatureTrack& rhs) {
+    return lhs.getTrackId() < rhs.getTrackId();
+  });
+  expectTrack(terminated_tracks[0][0], 2u, {{1u, 2u}, {2u, 0u}});
+  expectTrack(terminated_tracks[0][1], 3u, {{2u, 2u}});
+  EXPECT_EQ(0u, builder.getNumLiveTracks());
+  EXPECT_EQ(0u, builder.getNumNFramesInWindow());
+
+  // Track ids of terminated tracks start new tracks.
+  builder.addNFrame(createNFrame({0}), &terminated_tracks);
+  EXPECT_TRUE(terminated_tracks[0].empty());
+  EXPECT_EQ(1u, builder.getNumLiveTracks());
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,118 @@
+#include <cstdint>
+#include <vector>
+
+#include <eigen-checks/gtest.h>
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/keypoint-block.h>
+#include <aslam/frames/visual-frame.h>
+
+namespace aslam {
+
+void appendTestKeypoints(size_t num_keypoints, KeypointBlock* block) {
+  CHECK_NOTNULL(block);
+  std::vector<unsigned char> descriptor(block->getDescriptorSizeBytes());
+  for (size_t i = 0u; i < num_keypoints; ++i) {
+    const size_t index = block->size();
+    std::fill(descriptor.begin(), descriptor.end(), static_cast<unsigned char>(index));
+    block->appendKeypoint(Eigen::Vector2d(index, 2.0 * index), 0.5, 10.0 * index,
+                          static_cast<double>(index), 3.0, descriptor.data());
+  }
+}
+
+TEST(KeypointBlock, AppendAndGrow) {
+  const size_t kDescriptorSizeBytes = 48u;
+  const size_t kNumKeypoints = 1000u;
+  KeypointBlock block(kDescriptorSizeBytes);
+  EXPECT_TRUE(block.empty());
+  appendTestKeypoints(kNumKeypoints, &block);
+  ASSERT_EQ(kNumKeypoints, block.size());
+  EXPECT_GE(block.capacity(), kNumKeypoints);
+  // Growth is geometric, not one allocation per keypoint.
+  EXPECT_LT(block.capacity(), 4u * kNumKeypoints);
+
+  const KeypointBlock& const_block = block;
+  for (size_t i = 0u; i < kNumKeypoints; ++i) {
+    EXPECT_EQ(static_cast<double>(i), const_block.getKeypointMeasurements()(0, i));
+    EXPECT_EQ(2.0 * i, const_block.getKeypointMeasurements()(1, i));
+    EXPECT_EQ(10.0 * i, const_block.getKeypointOrientations()(i));
+    EXPECT_EQ(static_cast<double>(i), const_block.getKeypointScores()(i));
+    EXPECT_EQ(-1, const_block.getTrackIds()(i));
+    EXPECT_EQ(static_cast<unsigned char>(i), const_block.getDescriptors()(17, i));
+  }
+
+  // All attribute blocks start on a cache line.
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(block.getKeypointMeasurements().data()) %
+                KeypointBlock::kBlockAlignmentBytes);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(block.getKeypointScales().data()) %
+                KeypointBlock::kBlockAlignmentBytes);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(block.getTrackIds().data()) %
+                KeypointBlock::kBlockAlignmentBytes);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(block.getDescriptors().data()) %
+                KeypointBlock::kBlockAlignmentBytes);
+}
+
+TEST(KeypointBlock, EraseByMaskCompactsInPlace) {
+  KeypointBlock block(16u);
+  appendTestKeypoints(10u, &block);
+  const size_t capacity = block.capacity();
+  const double* measurements = block.getKeypointMeasurements().data();
+
+  std::vector<bool> keep_mask(10u, false);
+  keep_mask[1] = keep_mask[4] = keep_mask[9] = true;
+  EXPECT_EQ(7u, block.eraseByMask(keep_mask));
+  ASSERT_EQ(3u, block.size());
+  EXPECT_EQ(capacity, block.capacity());
+  EXPECT_EQ(measurements, block.getKeypointMeasurements().data());
+
+  const std::vector<size_t> kExpectedIndices = {1u, 4u, 9u};
+  for (size_t i = 0u; i < kExpectedIndices.size(); ++i) {
+    const double original_index = static_cast<double>(kExpectedIndices[i]);
+    EXPECT_EQ(original_index, block.getKeypointMeasurements()(0, i));
+    EXPECT_EQ(original_index, block.getKeypointScores()(i));
+    EXPECT_EQ(static_cast<unsigned char>(kExpectedIndices[i]), block.getDescriptors()(0, i));
+  }
+}
+
+TEST(KeypointBlock, DiscardUntrackedObservations) {
+  KeypointBlock block(0u);
+  for (int i = 0; i < 6; ++i) {
+    block.appendKeypoint(Eigen::Vector2d(i, i), 1.0, 0.0, i, 1.0, nullptr);
+  }
+  block.getTrackIdsMutable() << 3, -1, 5, -1, -1, 8;
+
+  std::vector<size_t> discarded_indices;
+  block.discardUntrackedObservations(&discarded_indices);
+  EXPECT_EQ(std::vector<size_t>({1u, 3u, 4u}), discarded_indices);
+  ASSERT_EQ(3u, block.size());
+  Eigen::VectorXi expected_track_ids(3);
+  expected_track_ids << 3, 5, 8;
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(expected_track_ids, block.getTrackIds()));
+  EXPECT_EQ(5.0, block.getKeypointScores()(2));
+}
+
+TEST(KeypointBlock, VisualFrameRoundTrip) {
+  const size_t kDescriptorSizeBytes = 48u;
+  KeypointBlock block(kDescriptorSizeBytes);
+  appendTestKeypoints(20u, &block);
+  block.getTrackIdsMutable().setLinSpaced(0, 19);
+
+  VisualFrame frame;
+  block.copyToVisualFrame(&frame);
+  ASSERT_EQ(20u, frame.getNumKeypointMeasurements());
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(block.getKeypointMeasurements(),
+                                 frame.getKeypointMeasurements()));
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(block.getDescriptors(), frame.getDescriptors()));
+
+  KeypointBlock block_from_frame(kDescriptorSizeBytes);
+  block_from_frame.copyFromVisualFrame(frame);
+  ASSERT_EQ(block.size(), block_from_frame.size());
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(block.getTrackIds(), block_from_frame.getTrackIds()));
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(block.getKeypointScales(), block_from_frame.getKeypointScales()));
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(block.getDescriptors(), block_from_frame.getDescriptors()));
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -141,6 +141,27 @@ TEST(Frame, NamedChannel) {
   EXPECT_TRUE(EIGEN_MATRIX_NEAR(data, data_2, 1e-6));
 }
 
+TEST(Frame, BuiltinChannelSlotsFollowChannelChanges) {
+  aslam::VisualFrame frame;
+  EXPECT_FALSE(frame.hasKeypointMeasurements());
+  Eigen::Matrix2Xd keypoints = Eigen::Matrix2Xd::Random(2, 5);
+  frame.setKeypointMeasurements(keypoints);
+  ASSERT_TRUE(frame.hasKeypointMeasurements());
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(keypoints, frame.getKeypointMeasurements()));
+
+  // The copy has its own channels, the cached slots must not alias the original ones.
+  aslam::VisualFrame frame_copy(frame);
+  frame_copy.getKeypointMeasurementsMutable()->setZero();
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(keypoints, frame.getKeypointMeasurements()));
+  EXPECT_TRUE(frame_copy.getKeypointMeasurements().isZero());
+
+  // Built-in channels added by name are found by the slot accessors.
+  aslam::VisualFrame named_frame;
+  named_frame.addChannel<Eigen::VectorXi>("TRACK_IDS");
+  EXPECT_TRUE(named_frame.hasTrackIds());
+  EXPECT_EQ(0, named_frame.getTrackIds().size());
+}
+
 TEST(Frame, SetGetImage) {
   aslam::VisualFrame frame;
   cv::Mat data(10,10,CV_8SC3,uint8_t(7));
@@ -150,6 +171,23 @@ TEST(Frame, SetGetImage) {
   EXPECT_TRUE(gtest_catkin::ImagesEqual(data, data_2));
 }
 
+TEST(Frame, SetGetReleaseImagePyramid) {
+  aslam::VisualFrame frame;
+  EXPECT_FALSE(frame.hasImagePyramid());
+  std::vector<cv::Mat> pyramid;
+  pyramid.emplace_back(20, 20, CV_8UC1, uint8_t(3));
+  pyramid.emplace_back(10, 10, CV_8UC1, uint8_t(5));
+
+  frame.setImagePyramid(pyramid);
+  ASSERT_TRUE(frame.hasImagePyramid());
+  ASSERT_EQ(2u, frame.getImagePyramid().size());
+  // The levels are shallow copies.
+  EXPECT_EQ(pyramid[1].data, frame.getImagePyramid()[1].data);
+
+  frame.releaseImagePyramid();
+  EXPECT_FALSE(frame.hasImagePyramid());
+}
+
 TEST(Frame, CopyConstructor) {
   aslam::Camera::Ptr camera = aslam::PinholeCamera::createTestCamera();
   aslam::VisualFrame frame;
@@ -201,6 +239,75 @@ TEST(Frame, CopyConstructor) {
   EXPECT_TRUE(frame == frame_cloned);
 }
 
+TEST(Frame, CopyOnWriteChannels) {
+  constexpr size_t kNumKeypoints = 10;
+  aslam::VisualFrame frame;
+  frame.setKeypointMeasurements(Eigen::Matrix2Xd::Random(2, kNumKeypoints));
+  frame.setDescriptors(aslam::VisualFrame::DescriptorsT::Random(48, kNumKeypoints));
+  frame.setTrackIds(Eigen::VectorXi::Constant(kNumKeypoints, -1));
+
+  // The copy shares the channel memory with the original.
+  aslam::VisualFrame frame_cloned(frame);
+  EXPECT_EQ(frame.getKeypointMeasurements().data(),
+            frame_cloned.getKeypointMeasurements().data());
+  EXPECT_EQ(frame.getTrackIds().data(), frame_cloned.getTrackIds().data());
+
+  // Modifying a channel of the copy detaches only that channel.
+  const int* original_track_ids = frame.getTrackIds().data();
+  frame_cloned.getTrackIdsMutable()->setConstant(5);
+  EXPECT_NE(original_track_ids, frame_cloned.getTrackIds().data());
+  EXPECT_EQ(original_track_ids, frame.getTrackIds().data());
+  EXPECT_EQ(-1, frame.getTrackId(0));
+  EXPECT_EQ(5, frame_cloned.getTrackId(0));
+  EXPECT_EQ(frame.getDescriptors().data(), frame_cloned.getDescriptors().data());
+
+  // Setting a channel of the original does not touch the copy.
+  frame.setKeypointMeasurements(Eigen::Matrix2Xd::Zero(2, kNumKeypoints));
+  EXPECT_NE(frame.getKeypointMeasurements().data(),
+            frame_cloned.getKeypointMeasurements().data());
+  EXPECT_FALSE(frame_cloned.getKeypointMeasurements().isZero());
+
+  // An unshared channel is modified in place.
+  const int* cloned_track_ids = frame_cloned.getTrackIds().data();
+  frame_cloned.getTrackIdsMutable()->setConstant(6);
+  EXPECT_EQ(cloned_track_ids, frame_cloned.getTrackIds().data());
+}
+
+TEST(Frame, DiscardUntrackedObservationsInPlace) {
+  constexpr size_t kNumKeypoints = 6;
+  aslam::VisualFrame frame;
+  Eigen::Matrix2Xd keypoints = Eigen::Matrix2Xd::Random(2, kNumKeypoints);
+  frame.setKeypointMeasurements(keypoints);
+  Eigen::VectorXd scores = Eigen::VectorXd::Random(kNumKeypoints);
+  frame.setKeypointScores(scores);
+  aslam::VisualFrame::DescriptorsT descriptors =
+      aslam::VisualFrame::DescriptorsT::Random(48, kNumKeypoints);
+  frame.setDescriptors(descriptors);
+  Eigen::VectorXi track_ids(kNumKeypoints);
+  track_ids << 3, -1, 5, -1, -1, 8;
+  frame.setTrackIds(track_ids);
+
+  std::vector<size_t> discarded_indices;
+  frame.discardUntrackedObservations(&discarded_indices);
+  EXPECT_EQ(std::vector<size_t>({1u, 3u, 4u}), discarded_indices);
+  ASSERT_EQ(3u, frame.getNumKeypointMeasurements());
+  const std::vector<int> kKeptIndices = {0, 2, 5};
+  for (size_t i = 0u; i < kKeptIndices.size(); ++i) {
+    EXPECT_EQ(track_ids(kKeptIndices[i]), frame.getTrackId(i));
+    EXPECT_EQ(scores(kKeptIndices[i]), frame.getKeypointScore(i));
+    EXPECT_TRUE(EIGEN_MATRIX_EQUAL(keypoints.col(kKeptIndices[i]),
+                                   frame.getKeypointMeasurement(i)));
+    EXPECT_TRUE(EIGEN_MATRIX_EQUAL(descriptors.col(kKeptIndices[i]),
+                                   frame.getDescriptors().col(i)));
+  }
+
+  std::vector<bool> keep_mask = {false, true, true};
+  frame.compactKeypointChannels(keep_mask);
+  ASSERT_EQ(2u, frame.getNumKeypointMeasurements());
+  EXPECT_EQ(5, frame.getTrackId(0));
+  EXPECT_EQ(2, frame.getDescriptors().cols());
+}
+
 TEST(Frame, getNormalizedBearingVectors) {
   // Create a test nframe with some keypoints.
   aslam::UnifiedProjectionCamera::Ptr camera = aslam::UnifiedProjectionCamera::createTestCamera();
@@ -245,4 +352,54 @@ TEST(Frame, getNormalizedBearingVectors) {
   }
 }
 
+TEST(Frame, CachedNormalizedBearingVectors) {
+  aslam::Camera::Ptr camera = aslam::PinholeCamera::createTestCamera();
+  aslam::VisualFrame frame;
+  frame.setCameraGeometry(camera);
+  Eigen::Matrix2Xd random_keypoints(2, 10);
+  for (int i = 0; i < random_keypoints.cols(); ++i) {
+    random_keypoints.col(i) = camera->createRandomKeypoint();
+  }
+  frame.setKeypointMeasurements(random_keypoints);
+
+  const Eigen::Matrix3Xd& bearing_vectors = frame.getNormalizedBearingVectors();
+  ASSERT_EQ(10, bearing_vectors.cols());
+  EXPECT_EQ(10u, frame.getBearingVectorBackprojectionSuccess().size());
+  // Repeated calls and copies of the frame reuse the cache.
+  EXPECT_EQ(bearing_vectors.data(), frame.getNormalizedBearingVectors().data());
+  aslam::VisualFrame frame_copy(frame);
+  EXPECT_EQ(bearing_vectors.data(), frame_copy.getNormalizedBearingVectors().data());
+
+  // Replacing the keypoints of the copy recomputes its bearing vectors only.
+  Eigen::Matrix2Xd keypoints = frame.getKeypointMeasurements().leftCols(5);
+  frame_copy.setKeypointMeasurements(keypoints);
+  EXPECT_EQ(5, frame_copy.getNormalizedBearingVectors().cols());
+  EXPECT_EQ(10, frame.getNormalizedBearingVectors().cols());
+
+  Eigen::Vector3d point_3d;
+  camera->backProject3(keypoints.col(2), &point_3d);
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(point_3d.normalized(),
+                                frame_copy.getNormalizedBearingVectors().col(2), 1e-12));
+
+  // Mutable access invalidates the cache.
+  frame_copy.getKeypointMeasurementsMutable()->col(2) = frame.getKeypointMeasurements().col(7);
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(frame.getNormalizedBearingVectors().col(7),
+                                frame_copy.getNormalizedBearingVectors().col(2), 1e-12));
+}
+
+TEST(Frame, MemoryUsagePerChannel) {
+  aslam::VisualFrame frame;
+  const size_t num_empty_frame_bytes = frame.getMemoryUsageBytes();
+  frame.setKeypointMeasurements(Eigen::Matrix2Xd::Random(2, 100));
+  frame.setDescriptors(aslam::VisualFrame::DescriptorsT::Zero(48, 100));
+
+  aslam::common::MemoryUsageReport report;
+  const size_t num_frame_bytes = frame.getMemoryUsageBytes("frame", &report);
+  EXPECT_EQ(num_frame_bytes, frame.getMemoryUsageBytes());
+  EXPECT_EQ(num_frame_bytes, report.getTotalBytes());
+  EXPECT_EQ(num_empty_frame_bytes, report.getBytes("frame/other"));
+  EXPECT_GE(report.getBytes("frame/VISUAL_KEYPOINT_MEASUREMENTS"), 2u * 100u * sizeof(double));
+  EXPECT_GE(report.getBytes("frame/DESCRIPTORS"), 48u * 100u);
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,154 @@
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <eigen-checks/gtest.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe-archive.h>
+#include <aslam/frames/visual-nframe.h>
+
+namespace aslam {
+
+class VisualNFrameArchiveTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    char path[] = "/tmp/test-visual-nframe-archive-XXXXXX";
+    const int file_descriptor = mkstemp(path);
+    ASSERT_GE(file_descriptor, 0);
+    ::close(file_descriptor);
+    path_ = path;
+    ncamera_ = NCamera::createTestNCamera(2);
+  }
+
+  virtual void TearDown() {
+    ::unlink(path_.c_str());
+    ::unlink((path_ + ".index").c_str());
+  }
+
+  /// Write nframes with out-of-order timestamps 1000 * (i ^ 1) through a small buffer.
+  void writeArchive(size_t num_nframes) {
+    VisualNFrameArchiveWriter writer(4096u);
+    ASSERT_TRUE(writer.open(path_));
+    for (size_t i = 0u; i < num_nframes; ++i) {
+      NFramesId nframe_id;
+      nframe_id.randomize();
+      VisualNFrame nframe(nframe_id, ncamera_);
+      for (size_t camera_idx = 0u; camera_idx < 2u; ++camera_idx) {
+        VisualFrame::Ptr frame(new VisualFrame);
+        frame->setCameraGeometry(ncamera_->getCameraShared(camera_idx));
+        frame->setTimestampNanoseconds(1000 * static_cast<int64_t>(i ^ 1u) + camera_idx);
+        // Some records exceed the write buffer.
+        frame->setKeypointMeasurements(Eigen::Matrix2Xd::Random(2, 50 * (i % 4)));
+        nframe.setFrame(camera_idx, frame);
+      }
+      ASSERT_TRUE(writer.append(nframe));
+      nframe_ids_.push_back(nframe_id);
+      keypoints_.push_back(nframe.getFrame(0).getKeypointMeasurements());
+    }
+    EXPECT_EQ(num_nframes, writer.getNumNFrames());
+    ASSERT_TRUE(writer.close());
+  }
+
+  void checkArchive(const VisualNFrameArchive& archive) {
+    ASSERT_EQ(nframe_ids_.size(), archive.getNumNFrames());
+    for (size_t i = 1u; i < archive.getNumNFrames(); ++i) {
+      EXPECT_LT(archive.getTimestampNanoseconds(i - 1u), archive.getTimestampNanoseconds(i));
+    }
+    for (size_t i = 0u; i < nframe_ids_.size(); ++i) {
+      BinaryVisualNFrameView nframe;
+      ASSERT_TRUE(archive.findNFrame(nframe_ids_[i], &nframe));
+      EXPECT_EQ(nframe_ids_[i], nframe.getId());
+      EXPECT_TRUE(EIGEN_MATRIX_EQUAL(
+          keypoints_[i], nframe.getFrame(0).getMatrixChannel<double>(
+              "VISUAL_KEYPOINT_MEASUREMENTS")));
+
+      const size_t index = archive.findFirstNFrameNotBefore(1000 * static_cast<int64_t>(i));
+      EXPECT_EQ(i, index);
+      EXPECT_EQ(nframe_ids_[i ^ 1u], archive.getNFrameId(index));
+      EXPECT_EQ(i, archive.findClosestNFrame(1000 * static_cast<int64_t>(i) + 400));
+    }
+    EXPECT_EQ(archive.getNumNFrames(), archive.findFirstNFrameNotBefore(1000000));
+
+    NFramesId unknown_id;
+    unknown_id.randomize();
+    BinaryVisualNFrameView nframe;
+    EXPECT_FALSE(archive.findNFrame(unknown_id, &nframe));
+  }
+
+  std::string path_;
+  NCamera::Ptr ncamera_;
+  std::vector<NFramesId> nframe_ids_;
+  std::vector<Eigen::Matrix2Xd> keypoints_;
+};
+
+TEST_F(VisualNFrameArchiveTest, LookupWithIndex) {
+  writeArchive(20u);
+  VisualNFrameArchive archive;
+  ASSERT_TRUE(archive.open(path_));
+  checkArchive(archive);
+}
+
+TEST_F(VisualNFrameArchiveTest, RebuildsMissingIndex) {
+  writeArchive(20u);
+  ASSERT_EQ(0, ::unlink((path_ + ".index").c_str()));
+  VisualNFrameArchive archive;
+  ASSERT_TRUE(archive.open(path_));
+  checkArchive(archive);
+}
+
+TEST_F(VisualNFrameArchiveTest, UpdateIndexesAppendedRecords) {
+  const auto create_nframe = [this](const NFramesId& nframe_id, int64_t timestamp_nanoseconds,
+                                    int num_keypoints) {
+    VisualNFrame nframe(nframe_id, ncamera_);
+    VisualFrame::Ptr frame(new VisualFrame);
+    frame->setCameraGeometry(ncamera_->getCameraShared(0u));
+    frame->setTimestampNanoseconds(timestamp_nanoseconds);
+    frame->setKeypointMeasurements(Eigen::Matrix2Xd::Random(2, num_keypoints));
+    nframe.setFrame(0u, frame);
+    return nframe;
+  };
+  const auto get_num_keypoints = [](const BinaryVisualNFrameView& nframe) {
+    return nframe.getFrame(0).getMatrixChannel<double>("VISUAL_KEYPOINT_MEASUREMENTS").cols();
+  };
+  VisualNFrameArchiveWriter writer(4096u);
+  ASSERT_TRUE(writer.open(path_));
+  const NFramesId first_id = NFramesId::Random();
+  ASSERT_TRUE(writer.append(create_nframe(first_id, 2000, 10)));
+  ASSERT_TRUE(writer.flush());
+  VisualNFrameArchive archive;
+  ASSERT_TRUE(archive.open(path_));
+  ASSERT_EQ(1u, archive.getNumNFrames());
+
+  // An earlier nframe and a second record of the first nframe.
+  const NFramesId second_id = NFramesId::Random();
+  ASSERT_TRUE(writer.append(create_nframe(second_id, 1000, 20)));
+  ASSERT_TRUE(writer.append(create_nframe(first_id, 3000, 30)));
+  EXPECT_EQ(1u, archive.getNumNFrames());
+  ASSERT_TRUE(writer.flush());
+  ASSERT_TRUE(archive.update());
+  ASSERT_EQ(3u, archive.getNumNFrames());
+  EXPECT_EQ(second_id, archive.getNFrameId(0u));
+  EXPECT_EQ(1000, archive.getTimestampNanoseconds(0u));
+  EXPECT_EQ(2000, archive.getTimestampNanoseconds(1u));
+  EXPECT_EQ(3000, archive.getTimestampNanoseconds(2u));
+  BinaryVisualNFrameView nframe;
+  ASSERT_TRUE(archive.findNFrame(second_id, &nframe));
+  EXPECT_EQ(20, get_num_keypoints(nframe));
+  ASSERT_TRUE(archive.findNFrame(first_id, &nframe));
+  EXPECT_EQ(30, get_num_keypoints(nframe));
+
+  // Nothing new.
+  ASSERT_TRUE(archive.update());
+  EXPECT_EQ(3u, archive.getNumNFrames());
+  ASSERT_TRUE(writer.close());
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
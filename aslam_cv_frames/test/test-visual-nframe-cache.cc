@@ -0,0 +1,251 @@
+#include <unistd.h>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <eigen-checks/gtest.h>
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe-cache.h>
+#include <aslam/frames/visual-nframe.h>
+
+namespace aslam {
+
+class VisualNFrameCacheTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ncamera_ = NCamera::createTestNCamera(2);
+    for (size_t i = 0u; i < 5u; ++i) {
+      nframes_.push_back(createNFrame(1000 * static_cast<int64_t>(i)));
+    }
+    full_size_bytes_ = nframes_[0]->getMemoryUsageBytes();
+    VisualNFrame stripped_nframe(*nframes_[0]);
+    for (size_t frame_idx = 0u; frame_idx < 2u; ++frame_idx) {
+      stripped_nframe.getFrameShared(frame_idx)->releaseRawImage();
+      stripped_nframe.getFrameShared(frame_idx)->releaseDescriptors();
+    }
+    stripped_size_bytes_ = stripped_nframe.getMemoryUsageBytes();
+    ASSERT_LT(stripped_size_bytes_, full_size_bytes_);
+  }
+
+  virtual void TearDown() {
+    if (!spill_path_.empty()) {
+      ::unlink(spill_path_.c_str());
+      ::unlink((spill_path_ + ".index").c_str());
+    }
+  }
+
+  std::shared_ptr<const VisualNFrame> createNFrame(int64_t timestamp_nanoseconds) {
+    std::shared_ptr<VisualNFrame> nframe(new VisualNFrame(NFramesId::Random(), ncamera_));
+    for (size_t frame_idx = 0u; frame_idx < 2u; ++frame_idx) {
+      VisualFrame::Ptr frame(new VisualFrame);
+      frame->setCameraGeometry(ncamera_->getCameraShared(frame_idx));
+      frame->setTimestampNanoseconds(timestamp_nanoseconds + static_cast<int64_t>(frame_idx));
+      frame->setKeypointMeasurements(Eigen::Matrix2Xd::Random(2, 20));
+      frame->setDescriptors(VisualFrame::DescriptorsT::Constant(48, 20, 7u));
+      frame->setRawImage(cv::Mat(100, 100, CV_8UC1, cv::Scalar(frame_idx)));
+      nframe->setFrame(frame_idx, frame);
+    }
+    return nframe;
+  }
+
+  std::string createSpillPath() {
+    char path[] = "/tmp/test-visual-nframe-cache-XXXXXX";
+    const int file_descriptor = mkstemp(path);
+    CHECK_GE(file_descriptor, 0);
+    ::close(file_descriptor);
+    spill_path_ = path;
+    return spill_path_;
+  }
+
+  NCamera::Ptr ncamera_;
+  std::vector<std::shared_ptr<const VisualNFrame>> nframes_;
+  size_t full_size_bytes_;
+  size_t stripped_size_bytes_;
+  std::string spill_path_;
+};
+
+TEST_F(VisualNFrameCacheTest, LookupByIdAndTimestamp) {
+  VisualNFrameCache cache((VisualNFrameCache::Options()));
+  for (const std::shared_ptr<const VisualNFrame>& nframe : nframes_) {
+    cache.insert(nframe);
+  }
+  EXPECT_EQ(5u, cache.size());
+  EXPECT_EQ(5u * full_size_bytes_, cache.getMemoryUsageBytes());
+  for (const std::shared_ptr<const VisualNFrame>& nframe : nframes_) {
+    EXPECT_EQ(nframe, cache.getNFrame(nframe->getId()));
+  }
+  EXPECT_FALSE(cache.getNFrame(NFramesId::Random()));
+
+  EXPECT_EQ(nframes_[2], cache.getClosestNFrame(2400));
+  EXPECT_EQ(nframes_[3], cache.getClosestNFrame(2600));
+  EXPECT_EQ(nframes_[0], cache.getClosestNFrame(-100));
+  EXPECT_EQ(nframes_[4], cache.getClosestNFrame(100000));
+  std::vector<std::shared_ptr<const VisualNFrame>> nframes;
+  cache.getNFramesInRange(1000, 3000, &nframes);
+  ASSERT_EQ(2u, nframes.size());
+  EXPECT_EQ(nframes_[1], nframes[0]);
+  EXPECT_EQ(nframes_[2], nframes[1]);
+
+  // Inserting the same nframe again replaces it.
+  cache.insert(nframes_[1]);
+  EXPECT_EQ(5u, cache.size());
+  cache.erase(nframes_[1]->getId());
+  EXPECT_FALSE(cache.hasNFrame(nframes_[1]->getId()));
+  EXPECT_EQ(nframes_[2], cache.getClosestNFrame(1000));
+  EXPECT_EQ(4u * full_size_bytes_, cache.getMemoryUsageBytes());
+  cache.clear();
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_FALSE(cache.getClosestNFrame(0));
+}
+
+TEST_F(VisualNFrameCacheTest, PayloadsAreEvictedBeforeKeypoints) {
+  VisualNFrameCache::Options options;
+  options.max_memory_usage_bytes = 2u * full_size_bytes_ + 2u * stripped_size_bytes_;
+  VisualNFrameCache cache(options);
+  for (size_t i = 0u; i < 4u; ++i) {
+    cache.insert(nframes_[i]);
+    EXPECT_LE(cache.getMemoryUsageBytes(), options.max_memory_usage_bytes);
+  }
+  // The two least recently used nframes lost their payloads.
+  EXPECT_EQ(4u, cache.size());
+  EXPECT_EQ(2u, cache.getNumStrippedNFrames());
+  const std::shared_ptr<const VisualNFrame> stripped_nframe = cache.getNFrame(nframes_[0]->getId());
+  ASSERT_TRUE(stripped_nframe);
+  EXPECT_NE(nframes_[0], stripped_nframe);
+  for (size_t frame_idx = 0u; frame_idx < 2u; ++frame_idx) {
+    const VisualFrame& frame = stripped_nframe->getFrame(frame_idx);
+    EXPECT_FALSE(frame.hasRawImage());
+    EXPECT_FALSE(frame.hasDescriptors());
+    EXPECT_TRUE(EIGEN_MATRIX_EQUAL(nframes_[0]->getFrame(frame_idx).getKeypointMeasurements(),
+                                   frame.getKeypointMeasurements()));
+    // The nframes of the callers keep their payloads.
+    EXPECT_TRUE(nframes_[0]->getFrame(frame_idx).hasRawImage());
+  }
+  EXPECT_EQ(nframes_[3], cache.getNFrame(nframes_[3]->getId()));
+
+  // Nframe 0 was used more recently than nframe 1, which is evicted.
+  cache.insert(nframes_[4]);
+  EXPECT_EQ(4u, cache.size());
+  EXPECT_FALSE(cache.hasNFrame(nframes_[1]->getId()));
+  EXPECT_TRUE(cache.hasNFrame(nframes_[0]->getId()));
+  EXPECT_FALSE(cache.getNFrame(nframes_[1]->getId()));
+  // Without a spill archive the payloads can't be restored.
+  EXPECT_EQ(stripped_nframe, cache.getFullNFrame(nframes_[0]->getId()));
+}
+
+TEST_F(VisualNFrameCacheTest, StrippingDropsCompressedRawImages) {
+  std::shared_ptr<VisualNFrame> compressed_nframe(new VisualNFrame(*nframes_[0]));
+  for (size_t frame_idx = 0u; frame_idx < 2u; ++frame_idx) {
+    compressed_nframe->getFrameShared(frame_idx)->compressRawImage();
+  }
+  VisualNFrameCache::Options options;
+  options.max_memory_usage_bytes = compressed_nframe->getMemoryUsageBytes() - 1u;
+  VisualNFrameCache cache(options);
+  cache.insert(compressed_nframe);
+  ASSERT_EQ(1u, cache.getNumStrippedNFrames());
+  const std::shared_ptr<const VisualNFrame> stripped_nframe =
+      cache.getNFrame(compressed_nframe->getId());
+  ASSERT_TRUE(stripped_nframe);
+  for (size_t frame_idx = 0u; frame_idx < 2u; ++frame_idx) {
+    EXPECT_FALSE(stripped_nframe->getFrame(frame_idx).hasRawImage());
+    EXPECT_FALSE(stripped_nframe->getFrame(frame_idx).hasCompressedRawImage());
+    EXPECT_TRUE(compressed_nframe->getFrame(frame_idx).hasCompressedRawImage());
+  }
+}
+
+TEST_F(VisualNFrameCacheTest, EvictedNFramesAreReloadedFromTheSpillArchive) {
+  VisualNFrameCache::Options options;
+  options.max_memory_usage_bytes = full_size_bytes_ + stripped_size_bytes_;
+  options.spill_archive_path = createSpillPath();
+  VisualNFrameCache cache(options);
+  for (size_t i = 0u; i < 3u; ++i) {
+    cache.insert(nframes_[i]);
+  }
+  EXPECT_EQ(2u, cache.size());
+  ASSERT_FALSE(cache.hasNFrame(nframes_[0]->getId()));
+
+  const std::shared_ptr<const VisualNFrame> reloaded_nframe =
+      cache.getNFrame(nframes_[0]->getId());
+  ASSERT_TRUE(reloaded_nframe);
+  EXPECT_TRUE(cache.hasNFrame(nframes_[0]->getId()));
+  EXPECT_LE(cache.getMemoryUsageBytes(), options.max_memory_usage_bytes);
+  for (size_t frame_idx = 0u; frame_idx < 2u; ++frame_idx) {
+    const VisualFrame& frame = reloaded_nframe->getFrame(frame_idx);
+    const VisualFrame& expected_frame = nframes_[0]->getFrame(frame_idx);
+    EXPECT_EQ(expected_frame.getTimestampNanoseconds(), frame.getTimestampNanoseconds());
+    EXPECT_EQ(expected_frame.getCameraGeometry(), frame.getCameraGeometry());
+    EXPECT_TRUE(EIGEN_MATRIX_EQUAL(expected_frame.getKeypointMeasurements(),
+                                   frame.getKeypointMeasurements()));
+    EXPECT_TRUE(EIGEN_MATRIX_EQUAL(expected_frame.getDescriptors(), frame.getDescriptors()));
+    EXPECT_EQ(100, frame.getRawImage().rows);
+  }
+
+  // Nframe 2 is stripped by the reload and gets its payloads back.
+  ASSERT_TRUE(cache.hasNFrame(nframes_[2]->getId()));
+  EXPECT_FALSE(cache.getNFrame(nframes_[2]->getId())->getFrame(0).hasRawImage());
+  const std::shared_ptr<const VisualNFrame> full_nframe =
+      cache.getFullNFrame(nframes_[2]->getId());
+  ASSERT_TRUE(full_nframe);
+  EXPECT_TRUE(full_nframe->getFrame(0).hasRawImage());
+  EXPECT_TRUE(full_nframe->getFrame(1).hasDescriptors());
+
+  // Spills after a reload are appended to the open archive.
+  cache.insert(nframes_[3]);
+  cache.insert(nframes_[4]);
+  for (size_t i = 0u; i < 5u; ++i) {
+    const std::shared_ptr<const VisualNFrame> nframe = cache.getFullNFrame(nframes_[i]->getId());
+    ASSERT_TRUE(nframe);
+    EXPECT_TRUE(nframe->getFrame(0).hasRawImage());
+    EXPECT_TRUE(EIGEN_MATRIX_EQUAL(nframes_[i]->getFrame(1).getKeypointMeasurements(),
+                                   nframe->getFrame(1).getKeypointMeasurements()));
+  }
+}
+
+TEST_F(VisualNFrameCacheTest, ErasedAndReplacedNFramesAreNotReloaded) {
+  VisualNFrameCache::Options options;
+  options.max_memory_usage_bytes = full_size_bytes_ + stripped_size_bytes_;
+  options.spill_archive_path = createSpillPath();
+  VisualNFrameCache cache(options);
+  for (size_t i = 0u; i < 3u; ++i) {
+    cache.insert(nframes_[i]);
+  }
+  ASSERT_FALSE(cache.hasNFrame(nframes_[0]->getId()));
+  cache.erase(nframes_[0]->getId());
+  EXPECT_FALSE(cache.getNFrame(nframes_[0]->getId()));
+  // Nframe 1 is stripped and spilled.
+  ASSERT_TRUE(cache.hasNFrame(nframes_[1]->getId()));
+  cache.erase(nframes_[1]->getId());
+  EXPECT_FALSE(cache.getFullNFrame(nframes_[1]->getId()));
+
+  // The replacement of a spilled nframe is spilled anew.
+  std::shared_ptr<VisualNFrame> replacement(new VisualNFrame(
+      nframes_[2]->getId(), ncamera_));
+  const std::shared_ptr<const VisualNFrame> other_nframe = createNFrame(2000);
+  for (size_t frame_idx = 0u; frame_idx < 2u; ++frame_idx) {
+    replacement->setFrame(frame_idx, VisualFrame::Ptr(
+        new VisualFrame(other_nframe->getFrame(frame_idx))));
+  }
+  cache.insert(nframes_[3]);
+  cache.insert(nframes_[4]);
+  ASSERT_FALSE(cache.hasNFrame(nframes_[2]->getId()));
+  cache.insert(replacement);
+  cache.insert(nframes_[3]);
+  cache.insert(nframes_[4]);
+  ASSERT_FALSE(cache.hasNFrame(nframes_[2]->getId()));
+  const std::shared_ptr<const VisualNFrame> reloaded_nframe =
+      cache.getFullNFrame(nframes_[2]->getId());
+  ASSERT_TRUE(reloaded_nframe);
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(other_nframe->getFrame(0).getKeypointMeasurements(),
+                                 reloaded_nframe->getFrame(0).getKeypointMeasurements()));
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,186 @@
+#include <unistd.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <eigen-checks/gtest.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/mapped-file.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe-shared-memory.h>
+#include <aslam/frames/visual-nframe.h>
+
+namespace aslam {
+
+class VisualNFrameSharedMemoryTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kNumSlots = 3u;
+  static constexpr size_t kSlotSizeBytes = 8192u;
+
+  virtual void SetUp() {
+    name_ = "/test-visual-nframe-shared-memory-" + std::to_string(::getpid()) + "-" +
+        ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    ncamera_ = NCamera::createTestNCamera(2);
+    ASSERT_TRUE(publisher_.create(name_, kNumSlots, kSlotSizeBytes));
+    ASSERT_TRUE(subscriber_.open(name_));
+  }
+
+  /// Publish an nframe with num_keypoints random keypoints in each frame.
+  bool publish(size_t num_keypoints) {
+    VisualNFrame nframe(ncamera_);
+    for (size_t camera_idx = 0u; camera_idx < 2u; ++camera_idx) {
+      VisualFrame::Ptr frame(new VisualFrame);
+      frame->setCameraGeometry(ncamera_->getCameraShared(camera_idx));
+      frame->setTimestampNanoseconds(1000 * static_cast<int64_t>(nframe_ids_.size()));
+      frame->setKeypointMeasurements(Eigen::Matrix2Xd::Random(2, num_keypoints));
+      nframe.setFrame(camera_idx, frame);
+    }
+    nframe_ids_.push_back(nframe.getId());
+    keypoints_.push_back(nframe.getFrame(0).getKeypointMeasurements());
+    return publisher_.publish(nframe);
+  }
+
+  /// Overwrite the record size in the slot of the sequence number through another mapping.
+  void setRecordSizeBytes(uint64_t sequence, uint64_t record_size_bytes) {
+    common::MappedFile mapped_file;
+    ASSERT_TRUE(mapped_file.openSharedMemory(name_));
+    const size_t slot_idx = static_cast<size_t>(sequence % kNumSlots);
+    shared_memory::SlotHeader* slot = reinterpret_cast<shared_memory::SlotHeader*>(
+        mapped_file.data() + sizeof(shared_memory::RingHeader) +
+        slot_idx * (sizeof(shared_memory::SlotHeader) + kSlotSizeBytes));
+    ASSERT_EQ(sequence, slot->sequence.load());
+    slot->record_size_bytes = record_size_bytes;
+  }
+
+  /// Check that the shared nframe is the published one with the sequence number.
+  void expectNFrame(uint64_t sequence, const SharedVisualNFrame& nframe) const {
+    ASSERT_TRUE(nframe.isValid());
+    EXPECT_EQ(sequence, nframe.getSequence());
+    const BinaryVisualNFrameView& view = nframe.getNFrame();
+    EXPECT_EQ(nframe_ids_[sequence - 1u], view.getId());
+    ASSERT_EQ(2u, view.getNumFrames());
+    ASSERT_TRUE(view.isFrameSet(0u));
+    EXPECT_TRUE(EIGEN_MATRIX_EQUAL(
+        keypoints_[sequence - 1u],
+        view.getFrame(0u).getMatrixChannel<double>("VISUAL_KEYPOINT_MEASUREMENTS")));
+  }
+
+  std::string name_;
+  NCamera::Ptr ncamera_;
+  VisualNFrameSharedMemoryPublisher publisher_;
+  VisualNFrameSharedMemorySubscriber subscriber_;
+  std::vector<NFramesId> nframe_ids_;
+  std::vector<Eigen::Matrix2Xd> keypoints_;
+};
+
+constexpr size_t VisualNFrameSharedMemoryTest::kNumSlots;
+constexpr size_t VisualNFrameSharedMemoryTest::kSlotSizeBytes;
+
+TEST_F(VisualNFrameSharedMemoryTest, ReadInOrder) {
+  SharedVisualNFrame nframe;
+  EXPECT_FALSE(subscriber_.getNext(&nframe));
+  EXPECT_FALSE(nframe.isValid());
+
+  ASSERT_TRUE(publish(10u));
+  ASSERT_TRUE(publish(20u));
+  EXPECT_EQ(2u, subscriber_.getLatestSequence());
+  ASSERT_TRUE(subscriber_.getNext(&nframe));
+  expectNFrame(1u, nframe);
+  ASSERT_TRUE(subscriber_.getNext(&nframe));
+  expectNFrame(2u, nframe);
+  EXPECT_FALSE(subscriber_.getNext(&nframe));
+  EXPECT_EQ(0u, subscriber_.getNumMissed());
+}
+
+TEST_F(VisualNFrameSharedMemoryTest, SkipOverwrittenNFrames) {
+  for (size_t i = 0u; i < 2u * kNumSlots; ++i) {
+    ASSERT_TRUE(publish(10u));
+  }
+  SharedVisualNFrame nframe;
+  ASSERT_TRUE(subscriber_.getNext(&nframe));
+  expectNFrame(kNumSlots + 1u, nframe);
+  EXPECT_EQ(kNumSlots, subscriber_.getNumMissed());
+
+  nframe.release();
+  ASSERT_TRUE(publish(10u));
+  ASSERT_TRUE(subscriber_.getLatest(&nframe));
+  expectNFrame(2u * kNumSlots + 1u, nframe);
+  EXPECT_EQ(2u * kNumSlots - 1u, subscriber_.getNumMissed());
+  EXPECT_FALSE(subscriber_.getLatest(&nframe));
+}
+
+TEST_F(VisualNFrameSharedMemoryTest, DropWhileSlotIsHeld) {
+  ASSERT_TRUE(publish(10u));
+  SharedVisualNFrame held_nframe;
+  ASSERT_TRUE(subscriber_.getNext(&held_nframe));
+
+  // The slot of the held nframe is skipped once, its content stays intact.
+  for (size_t i = 1u; i < kNumSlots; ++i) {
+    ASSERT_TRUE(publish(10u));
+  }
+  EXPECT_FALSE(publish(10u));
+  EXPECT_EQ(1u, publisher_.getNumDropped());
+  expectNFrame(1u, held_nframe);
+
+  // Moving the handle keeps the slot pinned.
+  SharedVisualNFrame moved_nframe(std::move(held_nframe));
+  EXPECT_FALSE(held_nframe.isValid());
+  for (size_t i = 1u; i < kNumSlots; ++i) {
+    ASSERT_TRUE(publish(10u));
+  }
+  EXPECT_FALSE(publish(10u));
+  EXPECT_EQ(2u, publisher_.getNumDropped());
+  expectNFrame(1u, moved_nframe);
+
+  moved_nframe.release();
+  for (size_t i = 1u; i < kNumSlots; ++i) {
+    ASSERT_TRUE(publish(10u));
+  }
+  EXPECT_TRUE(publish(10u));
+  EXPECT_EQ(3u * kNumSlots + 1u, subscriber_.getLatestSequence());
+}
+
+TEST_F(VisualNFrameSharedMemoryTest, DropOversizedNFrame) {
+  EXPECT_FALSE(publish(1000u));
+  EXPECT_EQ(1u, publisher_.getNumDropped());
+  EXPECT_EQ(0u, subscriber_.getLatestSequence());
+}
+
+TEST_F(VisualNFrameSharedMemoryTest, SkipMalformedNFrames) {
+  // A record length beyond the slot and a truncated record are both skipped.
+  SharedVisualNFrame nframe;
+  ASSERT_TRUE(publish(10u));
+  setRecordSizeBytes(1u, 2u * kSlotSizeBytes);
+  EXPECT_FALSE(subscriber_.getLatest(&nframe));
+  EXPECT_FALSE(nframe.isValid());
+  EXPECT_EQ(1u, subscriber_.getNumMissed());
+
+  ASSERT_TRUE(publish(10u));
+  setRecordSizeBytes(2u, 8u);
+  EXPECT_FALSE(subscriber_.getLatest(&nframe));
+  EXPECT_EQ(2u, subscriber_.getNumMissed());
+
+  ASSERT_TRUE(publish(10u));
+  setRecordSizeBytes(3u, 2u * kSlotSizeBytes);
+  ASSERT_TRUE(publish(10u));
+  ASSERT_TRUE(subscriber_.getNext(&nframe));
+  expectNFrame(4u, nframe);
+  EXPECT_EQ(3u, subscriber_.getNumMissed());
+  ASSERT_TRUE(publish(10u));
+  ASSERT_TRUE(subscriber_.getLatest(&nframe));
+  expectNFrame(5u, nframe);
+}
+
+TEST_F(VisualNFrameSharedMemoryTest, RejectMissingRing) {
+  VisualNFrameSharedMemorySubscriber subscriber;
+  EXPECT_FALSE(subscriber.open(name_ + "-missing"));
+  EXPECT_FALSE(subscriber.isOpen());
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -64,4 +64,25 @@ TEST(NFrame, CopyConstructor) {
   EXPECT_TRUE(nframe == nframe_cloned);
 }
 
+TEST(NFrame, IntraRigMatches) {
+  aslam::NCamera::Ptr ncamera = aslam::NCamera::createTestNCamera(2);
+  aslam::VisualNFrame::Ptr nframe = aslam::VisualNFrame::createEmptyTestVisualNFrame(ncamera, 0);
+  EXPECT_FALSE(nframe->hasIntraRigMatches());
+  Eigen::Matrix4Xi matches(4, 2);
+  matches << 0, 0, 3, 4, 1, 1, 5, 2;
+  nframe->setIntraRigMatches(matches);
+  ASSERT_TRUE(nframe->hasIntraRigMatches());
+  EIGEN_MATRIX_EQUAL(matches, nframe->getIntraRigMatches());
+
+  // Copies share the matches until either is modified.
+  aslam::VisualNFrame nframe_cloned(*nframe);
+  EXPECT_TRUE(*nframe == nframe_cloned);
+  (*nframe_cloned.getIntraRigMatchesMutable())(1, 0) = 7;
+  EIGEN_MATRIX_EQUAL(matches, nframe->getIntraRigMatches());
+  EXPECT_FALSE(*nframe == nframe_cloned);
+
+  nframe->clearKeypointChannelsOfAllFrames();
+  EXPECT_EQ(0, nframe->getIntraRigMatches().cols());
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,51 @@
+#ifndef ASLAM_MATCH_OUTLIER_REJECTION_NONCENTRAL_H_
+#define ASLAM_MATCH_OUTLIER_REJECTION_NONCENTRAL_H_
+
+#include <aslam/common/pose-types.h>
+#include <aslam/matcher/match.h>
+
+#include "aslam/geometric-vision/parallel-noncentral-relative-pose-ransac.h"
+
+namespace aslam {
+class VisualNFrame;
+
+namespace geometric_vision {
+
+/// \brief Separates rig-level matches between two nframes into out-/inliers with a single
+///        non-central relative pose RANSAC over all cameras of the rig, instead of one weaker
+///        RANSAC per camera that does not share the inliers.
+///
+/// The matches index the keypoints of all frames of an nframe camera after camera, as in
+/// MatchingProblemNFrameToNFrame, and may pair keypoints of different cameras. The apples are
+/// the keypoints of nframe_kp1. Both nframes must observe the same NCamera, whose extrinsics
+/// T_C_B place the bearing vectors in the body frames. Matches whose keypoints could not be
+/// back-projected are outliers. See ParallelNoncentralRelativePoseRansac for the algorithms.
+/// @param[in]  nframe_kp1        Current nframe.
+/// @param[in]  nframe_k          Previous nframe.
+/// @param[in]  q_Bkp1_Bk         Rotation taking vectors from the body frame k to the body
+///                               frame k+1, e.g. from the gyro. The rotation of kGivenRotation
+///                               and the prior of the other algorithms.
+/// @param[in]  matches_kp1_k     The rig-level matches between the nframes.
+/// @param[in]  algorithm         Minimal solver of the hypotheses.
+/// @param[in]  fix_random_seed   Use a fixed random seed for RANSAC.
+/// @param[in]  ransac_threshold  Threshold on the sum of 1 - cos of the reprojection angles
+///                               in both nframes to consider a match an inlier.
+/// @param[in]  ransac_max_iterations Max. RANSAC iterations.
+/// @param[in]  num_threads       Threads generating and scoring the hypotheses.
+/// @param[out] T_Bkp1_Bk         The relative pose of the best model, with metric scale.
+/// @param[out] inlier_matches_kp1_k  The list of inlier matches.
+/// @param[out] outlier_matches_kp1_k The list of outlier matches.
+/// @return RANSAC successful?
+bool rejectOutlierNFrameMatchesNoncentralRelativePoseSAC(
+    const aslam::VisualNFrame& nframe_kp1, const aslam::VisualNFrame& nframe_k,
+    const aslam::Quaternion& q_Bkp1_Bk,
+    const aslam::NFrameToNFrameMatchesWithScore& matches_kp1_k,
+    ParallelNoncentralRelativePoseRansac::Algorithm algorithm, bool fix_random_seed,
+    double ransac_threshold, size_t ransac_max_iterations, size_t num_threads,
+    aslam::Transformation* T_Bkp1_Bk,
+    aslam::NFrameToNFrameMatchesWithScore* inlier_matches_kp1_k,
+    aslam::NFrameToNFrameMatchesWithScore* outlier_matches_kp1_k);
+
+}  // namespace geometric_vision
+}  // namespace aslam
+#endif  // ASLAM_MATCH_OUTLIER_REJECTION_NONCENTRAL_H_
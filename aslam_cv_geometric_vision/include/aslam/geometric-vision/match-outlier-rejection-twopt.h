@@ -34,6 +34,49 @@ bool rejectOutlierFeatureMatchesTranslationRotationSAC(
     aslam::FrameToFrameMatchesWithScore* inlier_matches_kp1_k,
     aslam::FrameToFrameMatchesWithScore* outlier_matches_kp1_k);
 
+/// \brief Same as above, but both RANSAC schemes sample the matches with the highest match
+///        scores first (PROSAC), which needs far fewer iterations if the scores predict the
+///        inliers.
+bool rejectOutlierFeatureMatchesTranslationRotationProsac(
+    const aslam::VisualFrame& frame_kp1, const aslam::VisualFrame& frame_k,
+    const aslam::Quaternion& q_Ckp1_Ck,
+    const aslam::FrameToFrameMatchesWithScore& matches_kp1_k, bool fix_random_seed,
+    double ransac_threshold, size_t ransac_max_iterations,
+    aslam::FrameToFrameMatchesWithScore* inlier_matches_kp1_k,
+    aslam::FrameToFrameMatchesWithScore* outlier_matches_kp1_k);
+
+/// \brief Same classification as rejectOutlierFeatureMatchesTranslationRotationSAC() in a
+///        single RANSAC loop that generates one rotation-only and one translation-only
+///        hypothesis per iteration. The bearing vectors are taken from the cache of the frames
+///        and both models are scored with vectorized passes over all matches. Each model stops
+///        once an all-inlier sample has been drawn with high probability or its inlier ratio
+///        reaches early_exit_inlier_ratio. Matches whose keypoints could not be back-projected
+///        are outliers.
+/// @param[in]  early_exit_inlier_ratio  Inlier ratio at which a model stops, 1 disables the
+///                                      early exit.
+bool rejectOutlierFeatureMatchesTranslationRotationSinglePass(
+    const aslam::VisualFrame& frame_kp1, const aslam::VisualFrame& frame_k,
+    const aslam::Quaternion& q_Ckp1_Ck,
+    const aslam::FrameToFrameMatchesWithScore& matches_kp1_k, bool fix_random_seed,
+    double ransac_threshold, size_t ransac_max_iterations, double early_exit_inlier_ratio,
+    aslam::FrameToFrameMatchesWithScore* inlier_matches_kp1_k,
+    aslam::FrameToFrameMatchesWithScore* outlier_matches_kp1_k);
+
+/// \brief Same classification as rejectOutlierFeatureMatchesTranslationRotationSAC(), but
+///        q_Ckp1_Ck is trusted as a prior, e.g. from the gyro: the rays are derotated once,
+///        the rotation-only inliers are the matches consistent with the prior and only the
+///        translation-only model is estimated by RANSAC (two-ray samples on the derotated
+///        rays), which needs tens instead of hundreds of hypotheses.
+/// @param[in]  refine_rotation  Refit the rotation to the matches consistent with the prior
+///                              before the classification, absorbs e.g. the gyro bias.
+bool rejectOutlierFeatureMatchesGyroPriorSAC(
+    const aslam::VisualFrame& frame_kp1, const aslam::VisualFrame& frame_k,
+    const aslam::Quaternion& q_Ckp1_Ck,
+    const aslam::FrameToFrameMatchesWithScore& matches_kp1_k, bool fix_random_seed,
+    double ransac_threshold, size_t ransac_max_iterations, bool refine_rotation,
+    aslam::FrameToFrameMatchesWithScore* inlier_matches_kp1_k,
+    aslam::FrameToFrameMatchesWithScore* outlier_matches_kp1_k);
+
 }  // namespace geometric_vision
 
 }  // namespace aslam
@@ -0,0 +1,159 @@
+#ifndef GEOMETRIC_VISION_OPENGV_EIGEN_ADAPTERS_H_
+#define GEOMETRIC_VISION_OPENGV_EIGEN_ADAPTERS_H_
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <opengv/absolute_pose/AbsoluteAdapterBase.hpp>
+#include <opengv/relative_pose/RelativeAdapterBase.hpp>
+#include <opengv/types.hpp>
+
+namespace aslam {
+namespace geometric_vision {
+
+/// \file opengv-eigen-adapters.h
+/// \brief OpenGV adapters that read the correspondences directly from Eigen column matrices,
+///        e.g. the cached normalized bearing vectors of a VisualFrame and landmark arrays, instead
+///        of copying them into opengv::bearingVectors_t / points_t before every solve.
+///
+/// Correspondence i is column indices[i] of a matrix if an index list is given and column i
+/// otherwise. The adapters only keep references: the matrices and index lists have to outlive
+/// the adapter. The bearing vectors have to be normalized.
+
+/// Central absolute pose adapter, see opengv::absolute_pose::CentralAbsoluteAdapter.
+class EigenCentralAbsoluteAdapter : public opengv::absolute_pose::AbsoluteAdapterBase {
+ public:
+  /// @param[in] bearing_vectors         Bearing vectors in the camera frame, one per column.
+  /// @param[in] bearing_vector_indices  Bearing vector column per correspondence, or null.
+  /// @param[in] points                  The points in the world frame, one per column.
+  /// @param[in] point_indices           Point column per correspondence, or null.
+  EigenCentralAbsoluteAdapter(const Eigen::Matrix3Xd& bearing_vectors,
+                              const std::vector<size_t>* bearing_vector_indices,
+                              const Eigen::Matrix3Xd& points,
+                              const std::vector<size_t>* point_indices);
+  virtual ~EigenCentralAbsoluteAdapter() {}
+
+  virtual opengv::bearingVector_t getBearingVector(size_t index) const {
+    return bearing_vectors_.col(getColumn(bearing_vector_indices_, index));
+  }
+  virtual double getWeight(size_t /*index*/) const {
+    return 1.0;
+  }
+  virtual opengv::translation_t getCamOffset(size_t /*index*/) const {
+    return Eigen::Vector3d::Zero();
+  }
+  virtual opengv::rotation_t getCamRotation(size_t /*index*/) const {
+    return Eigen::Matrix3d::Identity();
+  }
+  virtual opengv::point_t getPoint(size_t index) const {
+    return points_.col(getColumn(point_indices_, index));
+  }
+  virtual size_t getNumberCorrespondences() const {
+    return num_correspondences_;
+  }
+
+ private:
+  static inline size_t getColumn(const std::vector<size_t>* indices, size_t index) {
+    return indices == nullptr ? index : (*indices)[index];
+  }
+
+  const Eigen::Matrix3Xd& bearing_vectors_;
+  const std::vector<size_t>* bearing_vector_indices_;
+  const Eigen::Matrix3Xd& points_;
+  const std::vector<size_t>* point_indices_;
+  size_t num_correspondences_;
+};
+
+/// Non-central absolute pose adapter, see opengv::absolute_pose::NoncentralAbsoluteAdapter.
+/// Correspondence i is observed by camera camera_indices[i], whose pose in the body frame is
+/// (camera_rotations, camera_offsets)[camera_indices[i]].
+class EigenNoncentralAbsoluteAdapter : public opengv::absolute_pose::AbsoluteAdapterBase {
+ public:
+  EigenNoncentralAbsoluteAdapter(const Eigen::Matrix3Xd& bearing_vectors,
+                                 const std::vector<int>& camera_indices,
+                                 const Eigen::Matrix3Xd& points,
+                                 const opengv::translations_t& camera_offsets,
+                                 const opengv::rotations_t& camera_rotations);
+  virtual ~EigenNoncentralAbsoluteAdapter() {}
+
+  virtual opengv::bearingVector_t getBearingVector(size_t index) const {
+    return bearing_vectors_.col(index);
+  }
+  virtual double getWeight(size_t /*index*/) const {
+    return 1.0;
+  }
+  virtual opengv::translation_t getCamOffset(size_t index) const {
+    return camera_offsets_[camera_indices_[index]];
+  }
+  virtual opengv::rotation_t getCamRotation(size_t index) const {
+    return camera_rotations_[camera_indices_[index]];
+  }
+  virtual opengv::point_t getPoint(size_t index) const {
+    return points_.col(index);
+  }
+  virtual size_t getNumberCorrespondences() const {
+    return static_cast<size_t>(bearing_vectors_.cols());
+  }
+
+ private:
+  const Eigen::Matrix3Xd& bearing_vectors_;
+  const std::vector<int>& camera_indices_;
+  const Eigen::Matrix3Xd& points_;
+  const opengv::translations_t& camera_offsets_;
+  const opengv::rotations_t& camera_rotations_;
+};
+
+/// Central relative pose adapter, see opengv::relative_pose::CentralRelativeAdapter. With the
+/// index lists, e.g. the keypoint indices of frame-to-frame matches, the cached bearing vectors
+/// of both frames are used in place.
+class EigenCentralRelativeAdapter : public opengv::relative_pose::RelativeAdapterBase {
+ public:
+  /// @param[in] R12  Prior rotation taking vectors from viewpoint 2 into viewpoint 1.
+  EigenCentralRelativeAdapter(const Eigen::Matrix3Xd& bearing_vectors_1,
+                              const std::vector<size_t>* bearing_vector_indices_1,
+                              const Eigen::Matrix3Xd& bearing_vectors_2,
+                              const std::vector<size_t>* bearing_vector_indices_2,
+                              const opengv::rotation_t& R12);
+  virtual ~EigenCentralRelativeAdapter() {}
+
+  virtual opengv::bearingVector_t getBearingVector1(size_t index) const {
+    return bearing_vectors_1_.col(getColumn(bearing_vector_indices_1_, index));
+  }
+  virtual opengv::bearingVector_t getBearingVector2(size_t index) const {
+    return bearing_vectors_2_.col(getColumn(bearing_vector_indices_2_, index));
+  }
+  virtual double getWeight(size_t /*index*/) const {
+    return 1.0;
+  }
+  virtual opengv::translation_t getCamOffset1(size_t /*index*/) const {
+    return Eigen::Vector3d::Zero();
+  }
+  virtual opengv::rotation_t getCamRotation1(size_t /*index*/) const {
+    return Eigen::Matrix3d::Identity();
+  }
+  virtual opengv::translation_t getCamOffset2(size_t /*index*/) const {
+    return Eigen::Vector3d::Zero();
+  }
+  virtual opengv::rotation_t getCamRotation2(size_t /*index*/) const {
+    return Eigen::Matrix3d::Identity();
+  }
+  virtual size_t getNumberCorrespondences() const {
+    return num_correspondences_;
+  }
+
+ private:
+  static inline size_t getColumn(const std::vector<size_t>* indices, size_t index) {
+    return indices == nullptr ? index : (*indices)[index];
+  }
+
+  const Eigen::Matrix3Xd& bearing_vectors_1_;
+  const std::vector<size_t>* bearing_vector_indices_1_;
+  const Eigen::Matrix3Xd& bearing_vectors_2_;
+  const std::vector<size_t>* bearing_vector_indices_2_;
+  size_t num_correspondences_;
+};
+
+}  // namespace geometric_vision
+}  // namespace aslam
+
+#endif  // GEOMETRIC_VISION_OPENGV_EIGEN_ADAPTERS_H_
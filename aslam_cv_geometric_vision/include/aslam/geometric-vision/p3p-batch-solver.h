@@ -0,0 +1,51 @@
+#ifndef GEOMETRIC_VISION_P3P_BATCH_SOLVER_H_
+#define GEOMETRIC_VISION_P3P_BATCH_SOLVER_H_
+
+#include <Eigen/Core>
+
+namespace aslam {
+namespace geometric_vision {
+
+/// \class P3pBatchSolver
+/// \brief Central P3P solver that solves kNumLanes independent problems at once.
+///
+/// Every problem occupies one lane of fixed-size Eigen arrays, such that the polynomial setup,
+/// the quartic roots and the back-substitution are evaluated for all lanes with the same packed
+/// instructions instead of one scalar solve per RANSAC hypothesis. Branches of the scalar
+/// solver are replaced by per-lane masks.
+///
+/// Follows Grunert's formulation as reviewed by Haralick et al., "Review and Analysis of
+/// Solutions of the Three Point Perspective Pose Estimation Problem", IJCV 1994: the quartic in
+/// the ratio of two point depths is solved with Ferrari's method, polished with Newton steps,
+/// and the pose is aligned from the triangles of the points in the camera and world frame.
+class P3pBatchSolver {
+ public:
+  /// Problems solved at once, the number of doubles in an AVX register.
+  static constexpr int kNumLanes = 4;
+  /// Max. number of solutions of a P3P problem.
+  static constexpr int kMaxNumSolutions = 4;
+
+  /// Per lane, correspondence i is stored in the columns 3i to 3i+2, such that every column
+  /// holds one coordinate of all lanes.
+  typedef Eigen::Matrix<double, kNumLanes, 9> LaneCorrespondences;
+
+  /// Solutions of all lanes, to be allocated on the stack by the caller.
+  struct Solutions {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    /// Model [R_W_C | p_W_C] of solution j of lane l.
+    Eigen::Matrix<double, 3, 4> models[kNumLanes][kMaxNumSolutions];
+    int num_solutions[kNumLanes];
+  };
+
+  /// @param[in]  bearing_vectors Normalized bearing vectors in the camera frame.
+  /// @param[in]  points          Corresponding points in the world frame.
+  /// @param[out] solutions       Real solutions with the points in front of the camera. Lanes
+  ///                             with degenerate configurations have no solutions.
+  static void solve(const LaneCorrespondences& bearing_vectors,
+                    const LaneCorrespondences& points, Solutions* solutions);
+};
+
+}  // namespace geometric_vision
+}  // namespace aslam
+
+#endif  // GEOMETRIC_VISION_P3P_BATCH_SOLVER_H_
@@ -0,0 +1,192 @@
+#ifndef GEOMETRIC_VISION_PARALLEL_ABSOLUTE_POSE_RANSAC_H_
+#define GEOMETRIC_VISION_PARALLEL_ABSOLUTE_POSE_RANSAC_H_
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gflags/gflags.h>
+#include <aslam/common/macros.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/thread-pool.h>
+#include <opengv/absolute_pose/AbsoluteAdapterBase.hpp>
+#include <opengv/types.hpp>
+
+DECLARE_int32(acv_ransac_fixed_seed);
+
+namespace aslam {
+namespace geometric_vision {
+
+/// \class ParallelAbsolutePoseRansac
+/// \brief RANSAC for the absolute pose of a central or non-central camera that generates and
+///        scores the hypotheses on several threads.
+///
+/// The hypotheses are generated in rounds. In every round each thread draws a fixed batch of
+/// samples from its own RNG, solves the minimal problem and scores the solutions. After the
+/// round the best hypothesis is merged and the number of required iterations is updated from
+/// its inlier ratio (adaptive stopping), hence the result only depends on the seed and the
+/// number of threads and not on the thread timing.
+///
+/// The scores follow opengv::sac_problems::absolute_pose::AbsolutePoseSacProblem: the distance
+/// of a correspondence is 1 - cos of the angle between the bearing vector and the ray to the
+/// transformed point, and correspondences with a distance below the threshold are inliers. The
+/// bearing vectors are rotated into the body frame once, such that scoring a hypothesis is one
+/// vectorized pass over all correspondences.
+///
+/// The central kKneip hypotheses are solved P3pBatchSolver::kNumLanes at a time with the
+/// vectorized P3pBatchSolver instead of one opengv::absolute_pose::p3p_kneip call each.
+///
+/// With correspondence scores, the samples are drawn with PROSAC (see ProsacSampler) on the
+/// calling thread and only solved and scored on the worker threads.
+///
+/// With local optimization (LO-RANSAC), every round that improves the best hypothesis refines it
+/// on its inlier set, see setLocalOptimization(). The refined inlier ratio is usually close to
+/// the true one, which tightens the stopping criterion much earlier than the minimal samples do.
+///
+/// Within a common::DeadlineScope, no further rounds are started once the deadline expired and
+/// a model was found. The best model so far is returned and the degradation
+/// common::Degradation::kCutRansacIterations is recorded.
+class ParallelAbsolutePoseRansac {
+ public:
+  ASLAM_POINTER_TYPEDEFS(ParallelAbsolutePoseRansac);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(ParallelAbsolutePoseRansac);
+
+  /// Minimal solver of the hypotheses, both use three correspondences and a fourth one to pick
+  /// one of the up to four solutions.
+  enum class Algorithm {
+    /// Central P3P, batched with P3pBatchSolver. Falls back to the solver of Kneip et al. if
+    /// the adapter has camera offsets.
+    kKneip,
+    /// Generalized P3P for non-central cameras.
+    kGp3p
+  };
+
+  /// @param[in] num_threads Number of threads generating hypotheses, 1 runs on the caller.
+  /// @param[in] random_seed Seed the RNGs from std::random_device. If false, the seed is
+  ///                        --acv_ransac_fixed_seed and the result is deterministic for a given
+  ///                        seed and number of threads.
+  ParallelAbsolutePoseRansac(size_t num_threads, bool random_seed);
+  ~ParallelAbsolutePoseRansac();
+
+  /// \brief Runs RANSAC until a sample of inliers has been drawn with the configured
+  ///        probability or max_iterations hypotheses have been tried.
+  ///
+  /// @param[in]  adapter         Correspondences, camera offsets and rotations for kGp3p.
+  /// @param[in]  algorithm       Minimal solver.
+  /// @param[in]  threshold       Inlier threshold on 1 - cos(angle).
+  /// @param[in]  max_iterations  Max number of hypotheses.
+  /// @param[out] model           Best model [R_G_B | p_G_B].
+  /// @param[out] inliers         Inlier indices of the best model.
+  /// @param[out] inlier_distances_to_model  Distances of the inliers.
+  /// @param[out] num_iterations  Number of generated hypotheses.
+  /// @return True if a model was found.
+  bool computeModel(const opengv::absolute_pose::AbsoluteAdapterBase& adapter,
+                    Algorithm algorithm, double threshold, int max_iterations,
+                    Eigen::Matrix<double, 3, 4>* model, std::vector<int>* inliers,
+                    std::vector<double>* inlier_distances_to_model, int* num_iterations);
+
+  /// \brief Same as above, but the correspondences with the highest scores, e.g. the match
+  ///        scores, are sampled first. The stopping criterion additionally uses the inlier
+  ///        ratio within the current PROSAC sampling set, which ends the search much earlier if
+  ///        the scores predict the inliers.
+  bool computeModel(const opengv::absolute_pose::AbsoluteAdapterBase& adapter,
+                    const std::vector<double>& correspondence_scores, Algorithm algorithm,
+                    double threshold, int max_iterations, Eigen::Matrix<double, 3, 4>* model,
+                    std::vector<int>* inliers, std::vector<double>* inlier_distances_to_model,
+                    int* num_iterations);
+
+  /// Probability of having drawn at least one sample of inliers when stopping.
+  void setProbability(double probability);
+  double getProbability() const { return probability_; }
+
+  /// \brief Enables the local optimization of new best hypotheses.
+  ///
+  /// Every refinement runs a few Gauss-Newton steps on the chordal bearing vector error of the
+  /// current inliers, re-collects the inliers and repeats while their number grows. The refined
+  /// model replaces the hypothesis if it has at least as many inliers.
+  /// @param[in] max_num_local_optimizations Max. refinements per computeModel, 0 disables them.
+  void setLocalOptimization(int max_num_local_optimizations);
+  int getMaxNumLocalOptimizations() const { return max_num_local_optimizations_; }
+  size_t getNumThreads() const { return num_threads_; }
+
+ private:
+  /// Correspondences per hypothesis, three for the solver and one to disambiguate.
+  static constexpr int kSampleSize = 4;
+
+  /// Per-thread RNG, scratch buffers and best hypothesis of the current round.
+  struct ThreadState {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    std::mt19937 rng;
+    /// Samples of the current round, kSampleSize indices per hypothesis.
+    std::vector<int> samples;
+    /// Minimal sample passed to the scalar solvers.
+    std::vector<int> sample;
+    Eigen::Matrix3Xd points_B;
+    Eigen::ArrayXd distances;
+    Eigen::Matrix<double, 3, 4> best_model;
+    int best_num_inliers;
+  };
+
+  /// Uniform sampling on the worker threads if correspondence_scores is null, PROSAC otherwise.
+  bool computeModelImpl(const opengv::absolute_pose::AbsoluteAdapterBase& adapter,
+                        const std::vector<double>* correspondence_scores, Algorithm algorithm,
+                        double threshold, int max_iterations,
+                        Eigen::Matrix<double, 3, 4>* model, std::vector<int>* inliers,
+                        std::vector<double>* inlier_distances_to_model, int* num_iterations);
+
+  /// Copies the correspondences of the adapter into the column-major scoring layout.
+  void setCorrespondences(const opengv::absolute_pose::AbsoluteAdapterBase& adapter);
+
+  /// Scores num_hypotheses hypotheses, keeping the best one in the thread state. The samples
+  /// are drawn from the thread RNG if samples is null and read from samples otherwise.
+  void runHypotheses(const opengv::absolute_pose::AbsoluteAdapterBase& adapter,
+                     Algorithm algorithm, double threshold, int num_hypotheses,
+                     const int* samples, ThreadState* state) const;
+
+  /// Picks the solution of a minimal sample that best explains the disambiguation
+  /// correspondence and keeps it in the thread state if it has the most inliers so far.
+  void scoreHypothesis(const opengv::transformation_t* solutions, size_t num_solutions,
+                       int disambiguation_index, double threshold, ThreadState* state) const;
+
+  /// Distances of all correspondences to the model, using the buffers of the thread state.
+  void computeDistances(const Eigen::Matrix<double, 3, 4>& model, ThreadState* state) const;
+
+  /// Refines the model on its inliers, see setLocalOptimization(). Updates the model and
+  /// num_inliers if the refinement does not lose inliers.
+  void optimizeLocally(double threshold, Eigen::Matrix<double, 3, 4>* model, int* num_inliers,
+                       ThreadState* state) const;
+
+  /// Gauss-Newton steps on the chordal error of the correspondences with a distance below the
+  /// threshold in state->distances.
+  void refineModel(double threshold, const ThreadState& state,
+                   Eigen::Matrix<double, 3, 4>* model) const;
+
+  /// Number of iterations after which a sample of inliers has been drawn with probability_
+  /// from a set with the given inlier ratio.
+  double getRequiredIterations(double inlier_ratio) const;
+
+  const size_t num_threads_;
+  const bool random_seed_;
+  double probability_;
+  int max_num_local_optimizations_;
+
+  /// Bearing vectors rotated into the body frame, camera offsets in the body frame and the
+  /// landmark positions, all column-wise.
+  Eigen::Matrix3Xd bearing_vectors_B_;
+  Eigen::Matrix3Xd camera_offsets_B_;
+  Eigen::Matrix3Xd points_G_;
+  bool has_camera_offsets_;
+
+  Aligned<std::vector, ThreadState> thread_states_;
+  /// PROSAC samples of the current round, kSampleSize indices per hypothesis.
+  std::vector<int> round_samples_;
+  std::vector<int> sample_buffer_;
+  /// Created lazily on the first parallel call and reused for subsequent calls.
+  std::unique_ptr<ThreadPool> thread_pool_;
+};
+
+}  // namespace geometric_vision
+}  // namespace aslam
+
+#endif  // GEOMETRIC_VISION_PARALLEL_ABSOLUTE_POSE_RANSAC_H_
@@ -0,0 +1,139 @@
+#ifndef GEOMETRIC_VISION_PARALLEL_NONCENTRAL_RELATIVE_POSE_RANSAC_H_
+#define GEOMETRIC_VISION_PARALLEL_NONCENTRAL_RELATIVE_POSE_RANSAC_H_
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/macros.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/thread-pool.h>
+#include <opengv/relative_pose/RelativeAdapterBase.hpp>
+
+namespace aslam {
+namespace geometric_vision {
+
+/// \class ParallelNoncentralRelativePoseRansac
+/// \brief RANSAC for the relative pose of a non-central camera (a multi-camera rig) between two
+///        viewpoints that generates and scores the hypotheses on several threads.
+///
+/// The rounds, the per-thread RNGs and the adaptive stopping follow ParallelAbsolutePoseRansac,
+/// hence the result only depends on the seed and the number of threads. The model is
+/// [R_12 | t_12], taking points from viewpoint 2 into viewpoint 1, as in opengv. The bearing
+/// vectors are rotated into the body frames and the camera offsets are read once. A hypothesis
+/// is scored by triangulating all correspondences (midpoint) in one vectorized pass; the
+/// distance of a correspondence is the sum of 1 - cos of the angles between its two bearing
+/// vectors and the rays to the triangulated point. Nearly parallel rays are scored by 1 - cos
+/// of the angle between them, i.e. as points at infinity.
+///
+/// Opposed to a central camera, the translation of a non-central camera is observable with
+/// scale. Given the rotation, the generalized epipolar constraint is linear in the translation,
+/// which kGivenRotation solves from three correspondences.
+class ParallelNoncentralRelativePoseRansac {
+ public:
+  ASLAM_POINTER_TYPEDEFS(ParallelNoncentralRelativePoseRansac);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(ParallelNoncentralRelativePoseRansac);
+
+  enum class Algorithm {
+    /// The rotation of the adapter (getR12()) is trusted, e.g. from the gyro, and only the
+    /// translation is estimated from three correspondences.
+    kGivenRotation,
+    /// Six-point solver of Stewenius et al., the translation of each of the up to 64 rotations
+    /// is solved from the same six correspondences and a seventh one picks the solution.
+    kSixPoint,
+    /// Linear seventeen-point solver of Li et al.
+    kSeventeenPoint
+  };
+
+  /// @param[in] num_threads Number of threads generating hypotheses, 1 runs on the caller.
+  /// @param[in] random_seed Seed the RNGs from std::random_device. If false, a fixed seed is
+  ///                        used and the result is deterministic for a given number of threads.
+  ParallelNoncentralRelativePoseRansac(size_t num_threads, bool random_seed);
+  ~ParallelNoncentralRelativePoseRansac();
+
+  /// \brief Runs RANSAC until a sample of inliers has been drawn with the configured
+  ///        probability or max_iterations hypotheses have been tried.
+  ///
+  /// @param[in]  adapter         Correspondences, camera offsets and rotations of both
+  ///                             viewpoints and the rotation prior R_12.
+  /// @param[in]  algorithm       Minimal solver.
+  /// @param[in]  threshold       Inlier threshold on the distance of a correspondence.
+  /// @param[in]  max_iterations  Max number of hypotheses.
+  /// @param[out] model           Best model [R_12 | t_12].
+  /// @param[out] inliers         Inlier indices of the best model.
+  /// @param[out] num_iterations  Number of generated hypotheses.
+  /// @return True if a model was found.
+  bool computeModel(const opengv::relative_pose::RelativeAdapterBase& adapter,
+                    Algorithm algorithm, double threshold, int max_iterations,
+                    Eigen::Matrix<double, 3, 4>* model, std::vector<int>* inliers,
+                    int* num_iterations);
+
+  /// Probability of having drawn at least one sample of inliers when stopping.
+  void setProbability(double probability);
+  double getProbability() const { return probability_; }
+  /// Hypotheses of kSixPoint and kSeventeenPoint whose rotation deviates by more than this
+  /// angle from the rotation of the adapter are dropped without scoring. Disabled by default.
+  void setMaxRotationDeviationFromPrior(double max_angle_rad);
+  size_t getNumThreads() const { return num_threads_; }
+
+  /// Number of correspondences a hypothesis of the algorithm is generated from.
+  static int getSampleSize(Algorithm algorithm);
+
+ private:
+  /// Per-thread RNG, scratch buffers and best hypothesis of the current round.
+  struct ThreadState {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    std::mt19937 rng;
+    std::vector<int> sample;
+    Eigen::Matrix3Xd rays_2_in_1;
+    Eigen::Matrix3Xd origins_2_in_1;
+    Eigen::Matrix3Xd points_1;
+    Eigen::ArrayXd distances;
+    Eigen::Matrix<double, 3, 4> best_model;
+    int best_num_inliers;
+  };
+
+  /// Copies the correspondences of the adapter into the column-major scoring layout.
+  void setCorrespondences(const opengv::relative_pose::RelativeAdapterBase& adapter);
+
+  /// Scores num_hypotheses hypotheses drawn from the thread RNG, keeping the best one in the
+  /// thread state.
+  void runHypotheses(const opengv::relative_pose::RelativeAdapterBase& adapter,
+                     Algorithm algorithm, double threshold, int num_hypotheses,
+                     ThreadState* state) const;
+
+  /// Least-squares translation of the given correspondences for the rotation R_12. Returns
+  /// false if the correspondences do not constrain the translation.
+  bool solveTranslation(const Eigen::Matrix3d& R_12, const std::vector<int>& indices,
+                        Eigen::Vector3d* t_12) const;
+
+  /// Distances of all correspondences to the model, using the buffers of the thread state.
+  void computeDistances(const Eigen::Matrix<double, 3, 4>& model, ThreadState* state) const;
+
+  /// Number of iterations after which a sample of inliers has been drawn with probability_
+  /// from a set with the given inlier ratio.
+  double getRequiredIterations(double inlier_ratio, int sample_size) const;
+
+  const size_t num_threads_;
+  const bool random_seed_;
+  double probability_;
+  double min_cos_rotation_deviation_from_prior_;
+
+  /// Bearing vectors rotated into the body frames and camera offsets in the body frames of
+  /// both viewpoints, all column-wise, and the rotation prior.
+  Eigen::Matrix3Xd bearing_vectors_1_;
+  Eigen::Matrix3Xd camera_offsets_1_;
+  Eigen::Matrix3Xd bearing_vectors_2_;
+  Eigen::Matrix3Xd camera_offsets_2_;
+  Eigen::Matrix3d R_12_prior_;
+
+  Aligned<std::vector, ThreadState> thread_states_;
+  /// Created lazily on the first parallel call and reused for subsequent calls.
+  std::unique_ptr<ThreadPool> thread_pool_;
+};
+
+}  // namespace geometric_vision
+}  // namespace aslam
+
+#endif  // GEOMETRIC_VISION_PARALLEL_NONCENTRAL_RELATIVE_POSE_RANSAC_H_
@@ -6,24 +6,49 @@
 
 #include <Eigen/Core>
 #include <glog/logging.h>
+#include <opengv/absolute_pose/AbsoluteAdapterBase.hpp>
 
 #include <aslam/cameras/camera.h>
 #include <aslam/cameras/ncamera.h>
 #include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+
+#include "aslam/geometric-vision/parallel-absolute-pose-ransac.h"
 
 namespace aslam {
 namespace geometric_vision {
 
+/// The RANSAC variants run ParallelAbsolutePoseRansac, which stops as soon as
+/// enough hypotheses have been tried for the inlier ratio of the best model.
+/// The returned num_iters is the number of generated hypotheses.
 class PnpPoseEstimator {
  public:
   explicit PnpPoseEstimator(bool run_nonlinear_refinement)
       : random_seed_(true),
-        run_nonlinear_refinement_(run_nonlinear_refinement) {}
-  /// This constructor should be used for when a deterministic seed (set from
-  /// outside) is necessary, such as for testing.
+        run_nonlinear_refinement_(run_nonlinear_refinement),
+        ransac_(1u, random_seed_) {}
+  /// This constructor should be used for when a deterministic seed is
+  /// necessary, such as for testing.
   PnpPoseEstimator(bool run_nonlinear_refinement, bool random_seed)
       : random_seed_(random_seed),
-        run_nonlinear_refinement_(run_nonlinear_refinement) {}
+        run_nonlinear_refinement_(run_nonlinear_refinement),
+        ransac_(1u, random_seed_) {}
+  /// Generates and scores the RANSAC hypotheses on num_ransac_threads
+  /// threads. With a deterministic seed, the result depends on the number of
+  /// threads but not on their timing.
+  PnpPoseEstimator(bool run_nonlinear_refinement, bool random_seed,
+                   size_t num_ransac_threads)
+      : random_seed_(random_seed),
+        run_nonlinear_refinement_(run_nonlinear_refinement),
+        ransac_(num_ransac_threads, random_seed_) {}
+
+  /// Locally optimized RANSAC: refines up to max_num_local_optimizations new
+  /// best hypotheses on their inliers while sampling, which tightens the
+  /// stopping criterion. 0 (the default) disables it. Independent of
+  /// run_nonlinear_refinement, which only refines the final model.
+  void setLocalOptimization(int max_num_local_optimizations) {
+    ransac_.setLocalOptimization(max_num_local_optimizations);
+  }
 
   /// The pinhole variants of these methods are wrappers that determine an
   /// appropriate ransac_threshold from pixel_sigma and camera focal lengths
@@ -55,6 +80,27 @@ class PnpPoseEstimator {
                           aslam::Transformation* T_G_C,
                           std::vector<int>* inliers, int* num_iters);
 
+  /// Same as above, but the measurements with the highest correspondence_scores
+  /// (e.g. match scores) are sampled first (PROSAC). If the scores predict the
+  /// inliers, far fewer iterations are needed.
+  bool absolutePoseRansac(const Eigen::Matrix2Xd& measurements,
+                          const Eigen::Matrix3Xd& G_landmark_positions,
+                          const std::vector<double>& correspondence_scores,
+                          double ransac_threshold, int max_ransac_iters,
+                          aslam::Camera::ConstPtr camera_ptr,
+                          aslam::Transformation* T_G_C,
+                          std::vector<int>* inliers, int* num_iters);
+
+  /// Same as above for the keypoints keypoint_indices of a frame, using the normalized bearing
+  /// vectors cached in the frame instead of back-projecting the measurements again. Keypoints
+  /// whose back-projection failed must not be passed.
+  bool absolutePoseRansac(const aslam::VisualFrame& frame,
+                          const std::vector<size_t>& keypoint_indices,
+                          const Eigen::Matrix3Xd& G_landmark_positions,
+                          double ransac_threshold, int max_ransac_iters,
+                          aslam::Transformation* T_G_C,
+                          std::vector<int>* inliers, int* num_iters);
+
   /// Same as the above functions, but supports multiple cameras. Only additional
   /// information is the NCamera (instead of Camera) pointer and a vector,
   /// measurement_camera_indices, of the same length as measurements
@@ -73,15 +119,49 @@ class PnpPoseEstimator {
       int max_ransac_iters, aslam::NCamera::ConstPtr ncamera_ptr,
       aslam::Transformation* T_G_I, std::vector<int>* inliers,
       std::vector<double>* inlier_distances_to_model, int* num_iters);
-
+  /// Multi-camera variant with PROSAC sampling by correspondence_scores.
+  bool absoluteMultiPoseRansac(
+      const Eigen::Matrix2Xd& measurements,
+      const std::vector<int>& measurement_camera_indices,
+      const Eigen::Matrix3Xd& G_landmark_positions,
+      const std::vector<double>& correspondence_scores, double ransac_threshold,
+      int max_ransac_iters, aslam::NCamera::ConstPtr ncamera_ptr,
+      aslam::Transformation* T_G_I, std::vector<int>* inliers,
+      std::vector<double>* inlier_distances_to_model, int* num_iters);
 
  private:
-  /// Whether to let RANSAC pick a timestamp-based random seed or not. If false,
-  /// a seed can be set with srand().
+  /// Uniform sampling if correspondence_scores is null, PROSAC otherwise.
+  bool absolutePoseRansac(const opengv::absolute_pose::AbsoluteAdapterBase& adapter,
+                          const std::vector<double>* correspondence_scores,
+                          double ransac_threshold, int max_ransac_iters,
+                          aslam::Transformation* T_G_C,
+                          std::vector<int>* inliers, int* num_iters);
+  bool absoluteMultiPoseRansac(
+      const Eigen::Matrix2Xd& measurements,
+      const std::vector<int>& measurement_camera_indices,
+      const Eigen::Matrix3Xd& G_landmark_positions,
+      const std::vector<double>* correspondence_scores, double ransac_threshold,
+      int max_ransac_iters, aslam::NCamera::ConstPtr ncamera_ptr,
+      aslam::Transformation* T_G_I, std::vector<int>* inliers,
+      std::vector<double>* inlier_distances_to_model, int* num_iters);
+
+  /// Whether to let RANSAC pick a random seed or not. If false, the seed is
+  /// --acv_ransac_fixed_seed.
   const bool random_seed_;
 
   /// Run nonlinear refinement over all inliers.
   const bool run_nonlinear_refinement_;
+
+  /// Back-projects the measurements into the normalized bearing_vectors_.
+  void backProjectMeasurements(const Eigen::Matrix2Xd& measurements,
+                               const aslam::Camera& camera);
+
+  /// Reused across calls, such that the thread pool and buffers persist.
+  ParallelAbsolutePoseRansac ransac_;
+
+  /// Back-projected measurements, read in place by the adapters and reused across calls.
+  Eigen::Matrix3Xd bearing_vectors_;
+  std::vector<unsigned char> backprojection_success_;
 };
 
 }  // namespace geometric_vision
@@ -0,0 +1,52 @@
+#ifndef GEOMETRIC_VISION_PROSAC_SAMPLER_H_
+#define GEOMETRIC_VISION_PROSAC_SAMPLER_H_
+
+#include <random>
+#include <vector>
+
+namespace aslam {
+namespace geometric_vision {
+
+/// \class ProsacSampler
+/// \brief Progressive sample consensus (PROSAC) sampling.
+///
+/// The correspondences are sorted by decreasing quality score. The samples are drawn from a
+/// sampling set of the best n correspondences that grows with the number of drawn samples,
+/// following the growth function of Chum and Matas, "Matching with PROSAC - Progressive Sample
+/// Consensus", CVPR 2005. After max_iterations samples the sampling set contains all
+/// correspondences and the sampling equals uniform RANSAC sampling.
+class ProsacSampler {
+ public:
+  /// @param[in] scores         Quality score per correspondence, higher is more likely inlier.
+  /// @param[in] sample_size    Number of correspondences per sample.
+  /// @param[in] max_iterations Number of samples after which all correspondences are sampled.
+  ProsacSampler(const std::vector<double>& scores, int sample_size, int max_iterations);
+
+  /// Draws the next sample of sample_size distinct correspondence indices.
+  void drawSample(std::mt19937* rng, std::vector<int>* sample);
+
+  /// Number of best correspondences the samples are currently drawn from.
+  int getSamplingSetSize() const { return sampling_set_size_; }
+  int getNumDrawnSamples() const { return num_drawn_samples_; }
+  /// Correspondence indices sorted by decreasing score.
+  const std::vector<int>& getSortedIndices() const { return sorted_indices_; }
+
+ private:
+  /// Appends a correspondence of the best num_candidates which is not part of the sample yet.
+  void drawDistinct(int num_candidates, std::mt19937* rng, std::vector<int>* sample) const;
+
+  const int sample_size_;
+  std::vector<int> sorted_indices_;
+
+  int num_drawn_samples_;
+  int sampling_set_size_;
+  /// Expected number of samples drawn from the current sampling set in uniform sampling, T_n.
+  double expected_num_samples_;
+  /// Number of drawn samples at which the sampling set grows, T'_n.
+  int growth_num_samples_;
+};
+
+}  // namespace geometric_vision
+}  // namespace aslam
+
+#endif  // GEOMETRIC_VISION_PROSAC_SAMPLER_H_
@@ -0,0 +1,61 @@
+#ifndef GEOMETRIC_VISION_REPROJECTION_ERRORS_H_
+#define GEOMETRIC_VISION_REPROJECTION_ERRORS_H_
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/pose-types.h>
+
+namespace aslam {
+namespace geometric_vision {
+
+/// \brief Observations of points by the cameras of a rig at several body poses, one entry per
+///        observation in every member.
+struct ReprojectionObservations {
+  /// Index of the observed point.
+  std::vector<size_t> point_indices;
+  /// Index of the body pose of the observation.
+  std::vector<size_t> pose_indices;
+  /// Index of the observing camera in the rig.
+  std::vector<size_t> camera_indices;
+  /// Keypoint measurements in image coordinates, one column per observation.
+  Eigen::Matrix2Xd measurements;
+
+  size_t size() const { return point_indices.size(); }
+};
+
+/// \brief Computes the reprojection errors of all observations.
+///
+/// The observations are grouped by camera and every group is projected in blocks with
+/// Camera::project3Vectorized, hence there is one virtual call per block instead of one per
+/// observation. The blocks run on the shared pool of common::parallelFor.
+///
+/// @param[in]  ncamera            Camera rig, the camera indices refer to its cameras.
+/// @param[in]  G_points           Points in the global frame, one column per point.
+/// @param[in]  T_G_Bs             Body poses the pose indices refer to.
+/// @param[in]  observations       The observations.
+/// @param[in]  keypoint_sigma_px  Isotropic standard deviation of the keypoints in pixels.
+/// @param[in]  num_threads        1 runs on the calling thread, any other value on the shared
+///                                pool.
+/// @param[out] residuals          Measurement minus projection per observation in pixels.
+/// @param[out] chi2               Squared residual norm over the keypoint variance. Observations
+///                                with a point behind the camera or an invalid projection have
+///                                zero residuals and an infinite chi2.
+/// @param[out] projection_results Optional, projection result per observation.
+void computeReprojectionErrors(
+    const aslam::NCamera& ncamera, const Eigen::Matrix3Xd& G_points,
+    const aslam::TransformationVector& T_G_Bs, const ReprojectionObservations& observations,
+    double keypoint_sigma_px, size_t num_threads, Eigen::Matrix2Xd* residuals,
+    Eigen::VectorXd* chi2, std::vector<ProjectionResult>* projection_results);
+
+/// \brief Marks the observations whose chi2 is below the threshold as inliers, e.g. 5.991 for
+///        the 95% quantile of the chi2 distribution with two degrees of freedom.
+void getReprojectionInliers(const Eigen::VectorXd& chi2, double chi2_threshold,
+                            std::vector<size_t>* inlier_indices);
+
+}  // namespace geometric_vision
+}  // namespace aslam
+
+#endif  // GEOMETRIC_VISION_REPROJECTION_ERRORS_H_
@@ -0,0 +1,134 @@
+#include <vector>
+
+#include <Eigen/Dense>
+#include <aslam/cameras/ncamera.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <glog/logging.h>
+#include <opengv/relative_pose/NoncentralRelativeAdapter.hpp>
+
+#include "aslam/geometric-vision/match-outlier-rejection-noncentral.h"
+
+namespace aslam {
+namespace geometric_vision {
+namespace {
+/// Camera and keypoint index of every rig-level keypoint index of the nframe, camera after
+/// camera.
+void getRigKeypoints(const aslam::VisualNFrame& nframe, std::vector<int>* camera_indices,
+                     std::vector<int>* keypoint_indices) {
+  CHECK_NOTNULL(camera_indices)->clear();
+  CHECK_NOTNULL(keypoint_indices)->clear();
+  for (size_t camera_idx = 0u; camera_idx < nframe.getNumFrames(); ++camera_idx) {
+    const int num_keypoints = nframe.getFrame(camera_idx).getNumKeypointMeasurements();
+    camera_indices->insert(camera_indices->end(), num_keypoints, static_cast<int>(camera_idx));
+    for (int keypoint_idx = 0; keypoint_idx < num_keypoints; ++keypoint_idx) {
+      keypoint_indices->push_back(keypoint_idx);
+    }
+  }
+}
+}  // namespace
+
+bool rejectOutlierNFrameMatchesNoncentralRelativePoseSAC(
+    const aslam::VisualNFrame& nframe_kp1, const aslam::VisualNFrame& nframe_k,
+    const aslam::Quaternion& q_Bkp1_Bk,
+    const aslam::NFrameToNFrameMatchesWithScore& matches_kp1_k,
+    ParallelNoncentralRelativePoseRansac::Algorithm algorithm, bool fix_random_seed,
+    double ransac_threshold, size_t ransac_max_iterations, size_t num_threads,
+    aslam::Transformation* T_Bkp1_Bk,
+    aslam::NFrameToNFrameMatchesWithScore* inlier_matches_kp1_k,
+    aslam::NFrameToNFrameMatchesWithScore* outlier_matches_kp1_k) {
+  CHECK_NOTNULL(T_Bkp1_Bk);
+  CHECK_NOTNULL(inlier_matches_kp1_k)->clear();
+  CHECK_NOTNULL(outlier_matches_kp1_k)->clear();
+  CHECK_GT(ransac_threshold, 0.0);
+  CHECK_GT(ransac_max_iterations, 0u);
+  const aslam::NCamera& ncamera = nframe_kp1.getNCamera();
+  CHECK(ncamera.getId() == nframe_k.getNCamera().getId())
+      << "The nframes need to observe the same NCamera.";
+  CHECK_EQ(nframe_kp1.getNumFrames(), ncamera.getNumCameras());
+  CHECK_EQ(nframe_k.getNumFrames(), ncamera.getNumCameras());
+
+  // opengv needs the camera poses in the body frame.
+  opengv::translations_t camera_offsets(ncamera.getNumCameras());
+  opengv::rotations_t camera_rotations(ncamera.getNumCameras());
+  for (size_t camera_idx = 0u; camera_idx < ncamera.getNumCameras(); ++camera_idx) {
+    const aslam::Transformation T_B_C = ncamera.get_T_C_B(camera_idx).inverse();
+    camera_offsets[camera_idx] = T_B_C.getPosition();
+    camera_rotations[camera_idx] = T_B_C.getRotationMatrix();
+  }
+
+  // Gather the cached bearing vectors of the matches whose back-projection succeeded.
+  std::vector<int> camera_indices_kp1, keypoint_indices_kp1;
+  std::vector<int> camera_indices_k, keypoint_indices_k;
+  getRigKeypoints(nframe_kp1, &camera_indices_kp1, &keypoint_indices_kp1);
+  getRigKeypoints(nframe_k, &camera_indices_k, &keypoint_indices_k);
+  opengv::bearingVectors_t bearing_vectors_kp1, bearing_vectors_k;
+  std::vector<int> correspondence_cameras_kp1, correspondence_cameras_k;
+  std::vector<int> match_indices;
+  match_indices.reserve(matches_kp1_k.size());
+  for (size_t match_idx = 0u; match_idx < matches_kp1_k.size(); ++match_idx) {
+    const int index_kp1 = matches_kp1_k[match_idx].getKeypointIndexAppleNFrame();
+    const int index_k = matches_kp1_k[match_idx].getKeypointIndexBananaNFrame();
+    CHECK_LT(index_kp1, static_cast<int>(camera_indices_kp1.size()));
+    CHECK_LT(index_k, static_cast<int>(camera_indices_k.size()));
+    const aslam::VisualFrame& frame_kp1 = nframe_kp1.getFrame(camera_indices_kp1[index_kp1]);
+    const aslam::VisualFrame& frame_k = nframe_k.getFrame(camera_indices_k[index_k]);
+    const int keypoint_idx_kp1 = keypoint_indices_kp1[index_kp1];
+    const int keypoint_idx_k = keypoint_indices_k[index_k];
+    if (frame_kp1.getBearingVectorBackprojectionSuccess()[keypoint_idx_kp1] &&
+        frame_k.getBearingVectorBackprojectionSuccess()[keypoint_idx_k]) {
+      bearing_vectors_kp1.push_back(
+          frame_kp1.getNormalizedBearingVectors().col(keypoint_idx_kp1));
+      bearing_vectors_k.push_back(frame_k.getNormalizedBearingVectors().col(keypoint_idx_k));
+      correspondence_cameras_kp1.push_back(camera_indices_kp1[index_kp1]);
+      correspondence_cameras_k.push_back(camera_indices_k[index_k]);
+      match_indices.push_back(static_cast<int>(match_idx));
+    }
+  }
+
+  // Handle the case with too few matches to distinguish between out-/inliers.
+  const size_t min_keypoint_correspondences = 2u *
+      static_cast<size_t>(ParallelNoncentralRelativePoseRansac::getSampleSize(algorithm));
+  if (match_indices.size() < min_keypoint_correspondences) {
+    VLOG(1) << "Too few matches to run RANSAC.";
+    *outlier_matches_kp1_k = matches_kp1_k;
+    return false;
+  }
+
+  // Viewpoint 1 is the body frame k+1, hence R_12 = R_Bkp1_Bk.
+  opengv::relative_pose::NoncentralRelativeAdapter adapter(
+      bearing_vectors_kp1, bearing_vectors_k, correspondence_cameras_kp1,
+      correspondence_cameras_k, camera_offsets, camera_rotations,
+      q_Bkp1_Bk.getRotationMatrix());
+  ParallelNoncentralRelativePoseRansac ransac(num_threads, !fix_random_seed);
+  Eigen::Matrix<double, 3, 4> model;
+  std::vector<int> inliers;
+  int num_iterations = 0;
+  if (!ransac.computeModel(adapter, algorithm, ransac_threshold,
+                           static_cast<int>(ransac_max_iterations), &model, &inliers,
+                           &num_iterations) ||
+      inliers.size() < min_keypoint_correspondences) {
+    VLOG(1) << "Too few inliers to reliably classify outlier matches.";
+    *outlier_matches_kp1_k = matches_kp1_k;
+    return false;
+  }
+  const Eigen::Matrix3d R_Bkp1_Bk = model.leftCols<3>();
+  *T_Bkp1_Bk = aslam::Transformation(aslam::Quaternion(R_Bkp1_Bk), model.col(3));
+
+  std::vector<unsigned char> is_inlier_match(matches_kp1_k.size(), 0u);
+  for (const int inlier : inliers) {
+    is_inlier_match[match_indices[inlier]] = 1u;
+  }
+  for (size_t match_idx = 0u; match_idx < matches_kp1_k.size(); ++match_idx) {
+    if (is_inlier_match[match_idx]) {
+      inlier_matches_kp1_k->emplace_back(matches_kp1_k[match_idx]);
+    } else {
+      outlier_matches_kp1_k->emplace_back(matches_kp1_k[match_idx]);
+    }
+  }
+  CHECK_EQ(inlier_matches_kp1_k->size() + outlier_matches_kp1_k->size(), matches_kp1_k.size());
+  return true;
+}
+
+}  // namespace geometric_vision
+}  // namespace aslam
@@ -1,23 +1,65 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <memory>
+#include <random>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include <Eigen/Dense>
 #include <aslam/common/pose-types.h>
 #include <aslam/frames/visual-frame.h>
-#include <aslam/matcher/match-helpers.h>
-#include <opengv/relative_pose/CentralRelativeAdapter.hpp>
 #include <opengv/relative_pose/methods.hpp>
 #include <opengv/sac/Ransac.hpp>
 #include <opengv/sac_problems/relative_pose/RotationOnlySacProblem.hpp>
 #include <opengv/sac_problems/relative_pose/TranslationOnlySacProblem.hpp>
 
+#include "aslam/geometric-vision/match-outlier-rejection-twopt.h"
+#include "aslam/geometric-vision/opengv-eigen-adapters.h"
+#include "aslam/geometric-vision/prosac-sampler.h"
+
 namespace aslam {
 namespace geometric_vision {
+namespace {
+/// An opengv sample consensus problem that draws its samples with PROSAC.
+template<typename SacProblem>
+class ProsacSacProblem : public SacProblem {
+ public:
+  template<typename... SacProblemArguments>
+  ProsacSacProblem(const std::vector<double>& scores, int max_iterations, bool random_seed,
+                   SacProblemArguments&&... sac_problem_arguments)
+      : SacProblem(std::forward<SacProblemArguments>(sac_problem_arguments)...),
+        sampler_(scores, this->getSampleSize(), max_iterations) {
+    if (random_seed) {
+      rng_.seed(std::random_device()());
+    }
+  }
+  virtual ~ProsacSacProblem() {}
 
-bool rejectOutlierFeatureMatchesTranslationRotationSAC(
+  virtual void getSamples(int& /*iterations*/, std::vector<int>& samples) {
+    // Same number of attempts to find a non-degenerate sample as opengv.
+    constexpr int kMaxSampleChecks = 10;
+    for (int check = 0; check < kMaxSampleChecks; ++check) {
+      sampler_.drawSample(&rng_, &samples);
+      if (this->isSampleGood(samples)) {
+        return;
+      }
+    }
+    // An empty sample stops opengv::sac::Ransac.
+    samples.clear();
+  }
+
+ private:
+  ProsacSampler sampler_;
+  std::mt19937 rng_;
+};
+
+bool rejectOutlierFeatureMatchesTranslationRotation(
     const aslam::VisualFrame& frame_kp1, const aslam::VisualFrame& frame_k,
     const aslam::Quaternion& q_Ckp1_Ck,
     const aslam::FrameToFrameMatchesWithScore& matches_kp1_k, bool fix_random_seed,
-    double ransac_threshold, size_t ransac_max_iterations,
+    double ransac_threshold, size_t ransac_max_iterations, bool use_prosac,
     aslam::FrameToFrameMatchesWithScore* inlier_matches_kp1_k,
     aslam::FrameToFrameMatchesWithScore* outlier_matches_kp1_k) {
   CHECK_GT(ransac_threshold, 0.0);
@@ -33,22 +75,33 @@ bool rejectOutlierFeatureMatchesTranslationRotationSAC(
     return false;
   }
 
-  opengv::bearingVectors_t bearing_vectors_kp1;
-  opengv::bearingVectors_t bearing_vectors_k;
+  // The cached bearing vectors of both frames are read in place.
+  std::vector<size_t> keypoint_indices_kp1;
+  std::vector<size_t> keypoint_indices_k;
+  keypoint_indices_kp1.reserve(matches_kp1_k.size());
+  keypoint_indices_k.reserve(matches_kp1_k.size());
+  for (const aslam::FrameToFrameMatchWithScore& match : matches_kp1_k) {
+    keypoint_indices_kp1.push_back(static_cast<size_t>(match.getKeypointIndexAppleFrame()));
+    keypoint_indices_k.push_back(static_cast<size_t>(match.getKeypointIndexBananaFrame()));
+  }
+  EigenCentralRelativeAdapter adapter(
+      frame_kp1.getNormalizedBearingVectors(), &keypoint_indices_kp1,
+      frame_k.getNormalizedBearingVectors(), &keypoint_indices_k, q_Ckp1_Ck.getRotationMatrix());
 
-  aslam::FrameToFrameMatches matches_without_score_kp1_k;
-  aslam::convertMatchesWithScoreToMatches<aslam::FrameToFrameMatchWithScore,
-                                          aslam::FrameToFrameMatch>(
-                                              matches_kp1_k, &matches_without_score_kp1_k);
-  aslam::getBearingVectorsFromMatches(frame_kp1, frame_k, matches_without_score_kp1_k,
-                                      &bearing_vectors_kp1, &bearing_vectors_k);
-  using opengv::relative_pose::CentralRelativeAdapter;
-  CentralRelativeAdapter adapter(bearing_vectors_kp1, bearing_vectors_k,
-                                 q_Ckp1_Ck.getRotationMatrix());
+  std::vector<double> match_scores;
+  if (use_prosac) {
+    match_scores.reserve(matches_kp1_k.size());
+    for (const aslam::FrameToFrameMatchWithScore& match : matches_kp1_k) {
+      match_scores.push_back(match.getScore());
+    }
+  }
+  const int max_iterations = static_cast<int>(ransac_max_iterations);
 
   typedef opengv::sac_problems::relative_pose::RotationOnlySacProblem
       RotationOnlySacProblem;
-  std::shared_ptr<RotationOnlySacProblem> rotation_sac_problem(
+  std::shared_ptr<RotationOnlySacProblem> rotation_sac_problem(use_prosac ?
+      new ProsacSacProblem<RotationOnlySacProblem>(
+          match_scores, max_iterations, !fix_random_seed, adapter, !fix_random_seed) :
       new RotationOnlySacProblem(adapter, !fix_random_seed));
 
   opengv::sac::Ransac<RotationOnlySacProblem> rotation_ransac;
@@ -59,9 +112,10 @@ bool rejectOutlierFeatureMatchesTranslationRotationSAC(
 
   typedef opengv::sac_problems::relative_pose::TranslationOnlySacProblem
       TranslationOnlySacProblem;
-  std::shared_ptr<TranslationOnlySacProblem> translation_sac_problem(
-      new TranslationOnlySacProblem(
-          adapter, !fix_random_seed));
+  std::shared_ptr<TranslationOnlySacProblem> translation_sac_problem(use_prosac ?
+      new ProsacSacProblem<TranslationOnlySacProblem>(
+          match_scores, max_iterations, !fix_random_seed, adapter, !fix_random_seed) :
+      new TranslationOnlySacProblem(adapter, !fix_random_seed));
   opengv::sac::Ransac<TranslationOnlySacProblem> translation_ransac;
   translation_ransac.sac_model_ = translation_sac_problem;
   translation_ransac.threshold_ = ransac_threshold;
@@ -97,6 +151,393 @@ bool rejectOutlierFeatureMatchesTranslationRotationSAC(
   CHECK_EQ(inlier_matches_kp1_k->size() + outlier_matches_kp1_k->size(), matches_kp1_k.size());
   return true;
 }
+}  // namespace
+
+bool rejectOutlierFeatureMatchesTranslationRotationSAC(
+    const aslam::VisualFrame& frame_kp1, const aslam::VisualFrame& frame_k,
+    const aslam::Quaternion& q_Ckp1_Ck,
+    const aslam::FrameToFrameMatchesWithScore& matches_kp1_k, bool fix_random_seed,
+    double ransac_threshold, size_t ransac_max_iterations,
+    aslam::FrameToFrameMatchesWithScore* inlier_matches_kp1_k,
+    aslam::FrameToFrameMatchesWithScore* outlier_matches_kp1_k) {
+  constexpr bool kUseProsac = false;
+  return rejectOutlierFeatureMatchesTranslationRotation(
+      frame_kp1, frame_k, q_Ckp1_Ck, matches_kp1_k, fix_random_seed, ransac_threshold,
+      ransac_max_iterations, kUseProsac, inlier_matches_kp1_k, outlier_matches_kp1_k);
+}
+
+bool rejectOutlierFeatureMatchesTranslationRotationProsac(
+    const aslam::VisualFrame& frame_kp1, const aslam::VisualFrame& frame_k,
+    const aslam::Quaternion& q_Ckp1_Ck,
+    const aslam::FrameToFrameMatchesWithScore& matches_kp1_k, bool fix_random_seed,
+    double ransac_threshold, size_t ransac_max_iterations,
+    aslam::FrameToFrameMatchesWithScore* inlier_matches_kp1_k,
+    aslam::FrameToFrameMatchesWithScore* outlier_matches_kp1_k) {
+  constexpr bool kUseProsac = true;
+  return rejectOutlierFeatureMatchesTranslationRotation(
+      frame_kp1, frame_k, q_Ckp1_Ck, matches_kp1_k, fix_random_seed, ransac_threshold,
+      ransac_max_iterations, kUseProsac, inlier_matches_kp1_k, outlier_matches_kp1_k);
+}
+
+namespace {
+// Minimal sample sizes of the rotation-only and the translation-only model.
+constexpr int kRotationSampleSize = 3;
+constexpr int kTranslationSampleSize = 2;
+// Confidence of having drawn an all-inlier sample when a model stops early.
+constexpr double kRansacProbability = 0.99;
+
+void drawDistinctSample(int num_correspondences, int sample_size, std::mt19937* rng,
+                        std::vector<int>* sample) {
+  CHECK_NOTNULL(rng);
+  CHECK_NOTNULL(sample)->clear();
+  std::uniform_int_distribution<int> distribution(0, num_correspondences - 1);
+  while (static_cast<int>(sample->size()) < sample_size) {
+    const int index = distribution(*rng);
+    if (std::find(sample->begin(), sample->end(), index) == sample->end()) {
+      sample->push_back(index);
+    }
+  }
+}
+
+double getRequiredIterations(int num_inliers, int num_correspondences, int sample_size) {
+  const double probability_good_sample = std::pow(
+      static_cast<double>(num_inliers) / static_cast<double>(num_correspondences), sample_size);
+  if (probability_good_sample >= 1.0) {
+    return 1.0;
+  }
+  if (probability_good_sample <= std::numeric_limits<double>::epsilon()) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return std::log(1.0 - kRansacProbability) / std::log(1.0 - probability_good_sample);
+}
+
+/// Best hypothesis of one of the two models.
+struct ModelSearch {
+  explicit ModelSearch(int num_correspondences)
+      : best_num_inliers(-1), is_done(false), best_inliers(num_correspondences) {
+    best_inliers.setConstant(false);
+  }
+  void update(const Eigen::ArrayXd& distances, double threshold) {
+    const int num_inliers = static_cast<int>((distances < threshold).count());
+    if (num_inliers > best_num_inliers) {
+      best_num_inliers = num_inliers;
+      best_inliers = distances < threshold;
+    }
+  }
+  int best_num_inliers;
+  bool is_done;
+  Eigen::Array<bool, Eigen::Dynamic, 1> best_inliers;
+};
+
+/// Gathers the cached bearing vectors of the matches whose keypoints were back-projected in
+/// both frames, together with the index of their match. The other matches are outliers.
+void getBackProjectedBearingVectors(
+    const aslam::VisualFrame& frame_kp1, const aslam::VisualFrame& frame_k,
+    const aslam::FrameToFrameMatchesWithScore& matches_kp1_k, Eigen::Matrix3Xd* f_kp1,
+    Eigen::Matrix3Xd* f_k, std::vector<int>* match_indices) {
+  CHECK_NOTNULL(f_kp1);
+  CHECK_NOTNULL(f_k);
+  CHECK_NOTNULL(match_indices)->clear();
+  const Eigen::Matrix3Xd& frame_bearing_vectors_kp1 = frame_kp1.getNormalizedBearingVectors();
+  const Eigen::Matrix3Xd& frame_bearing_vectors_k = frame_k.getNormalizedBearingVectors();
+  const std::vector<unsigned char>& success_kp1 =
+      frame_kp1.getBearingVectorBackprojectionSuccess();
+  const std::vector<unsigned char>& success_k = frame_k.getBearingVectorBackprojectionSuccess();
+  match_indices->reserve(matches_kp1_k.size());
+  for (size_t match_idx = 0u; match_idx < matches_kp1_k.size(); ++match_idx) {
+    const int keypoint_idx_kp1 = matches_kp1_k[match_idx].getKeypointIndexAppleFrame();
+    const int keypoint_idx_k = matches_kp1_k[match_idx].getKeypointIndexBananaFrame();
+    CHECK_LT(keypoint_idx_kp1, frame_bearing_vectors_kp1.cols());
+    CHECK_LT(keypoint_idx_k, frame_bearing_vectors_k.cols());
+    if (success_kp1[keypoint_idx_kp1] && success_k[keypoint_idx_k]) {
+      match_indices->push_back(static_cast<int>(match_idx));
+    }
+  }
+  f_kp1->resize(3, match_indices->size());
+  f_k->resize(3, match_indices->size());
+  for (size_t i = 0u; i < match_indices->size(); ++i) {
+    const aslam::FrameToFrameMatchWithScore& match = matches_kp1_k[(*match_indices)[i]];
+    f_kp1->col(i) = frame_bearing_vectors_kp1.col(match.getKeypointIndexAppleFrame());
+    f_k->col(i) = frame_bearing_vectors_k.col(match.getKeypointIndexBananaFrame());
+  }
+}
+
+/// Rotation R minimizing sum ||f_kp1 - R * f_k||^2 over the given rays (Kabsch).
+template<typename Indices>
+Eigen::Matrix3d computeRotationKabsch(const Eigen::Matrix3Xd& f_kp1, const Eigen::Matrix3Xd& f_k,
+                                      const Indices& indices) {
+  Eigen::Matrix3d H = Eigen::Matrix3d::Zero();
+  for (const int index : indices) {
+    H += f_k.col(index) * f_kp1.col(index).transpose();
+  }
+  const Eigen::JacobiSVD<Eigen::Matrix3d> svd(H, Eigen::ComputeFullU | Eigen::ComputeFullV);
+  Eigen::Matrix3d correction = Eigen::Matrix3d::Identity();
+  correction(2, 2) = (svd.matrixV() * svd.matrixU().transpose()).determinant() < 0.0 ?
+      -1.0 : 1.0;
+  return svd.matrixV() * correction * svd.matrixU().transpose();
+}
+
+/// Scores translation directions given the rotation, i.e. on the derotated rays
+/// f_k_rotated = R_kp1_k * f_k. The scratch buffers are reused across hypotheses.
+class TranslationOnlyScorer {
+ public:
+  TranslationOnlyScorer(const Eigen::Matrix3Xd& f_kp1, const Eigen::Matrix3Xd& f_k_rotated)
+      : f_kp1_(f_kp1), f_k_rotated_(f_k_rotated) {
+    CHECK_EQ(f_kp1_.cols(), f_k_rotated_.cols());
+    const int num_correspondences = static_cast<int>(f_kp1_.cols());
+    // cos of the angle between the rays, which the scoring needs for every hypothesis.
+    cos_kp1_k_rotated_ = f_kp1_.cwiseProduct(f_k_rotated_).colwise().sum().array().transpose();
+    b_kp1_.resize(num_correspondences);
+    b_k_.resize(num_correspondences);
+    lambda_kp1_.resize(num_correspondences);
+    lambda_k_.resize(num_correspondences);
+    points_kp1_.resize(3, num_correspondences);
+    points_k_.resize(3, num_correspondences);
+  }
+
+  /// The translation direction from two rays: both epipolar planes contain the translation.
+  /// Returns false for a degenerate sample.
+  bool score(int sample_0, int sample_1, Eigen::ArrayXd* distances) {
+    CHECK_NOTNULL(distances);
+    const Eigen::Vector3d normal_0 = f_k_rotated_.col(sample_0).cross(f_kp1_.col(sample_0));
+    const Eigen::Vector3d normal_1 = f_k_rotated_.col(sample_1).cross(f_kp1_.col(sample_1));
+    Eigen::Vector3d t = normal_0.cross(normal_1);
+    const double t_norm = t.norm();
+    if (t_norm <= std::numeric_limits<double>::epsilon()) {
+      return false;
+    }
+    t /= t_norm;
+    // Triangulate the rays as opengv::triangulation::triangulate2 and score the sum of
+    // 1 - cos of the reprojection errors in both frames. The sign of the translation is
+    // chosen such that the first sample lies in front of the camera.
+    b_kp1_ = (t.transpose() * f_kp1_).array().transpose();
+    b_k_ = (t.transpose() * f_k_rotated_).array().transpose();
+    const Eigen::ArrayXd determinant = cos_kp1_k_rotated_.square() - 1.0;
+    lambda_kp1_ = (cos_kp1_k_rotated_ * b_k_ - b_kp1_) / determinant;
+    if (lambda_kp1_(sample_0) < 0.0) {
+      t = -t;
+      b_kp1_ = -b_kp1_;
+      b_k_ = -b_k_;
+      lambda_kp1_ = -lambda_kp1_;
+    }
+    lambda_k_ = (b_k_ - cos_kp1_k_rotated_ * b_kp1_) / determinant;
+    points_kp1_ = 0.5 * (f_kp1_.array().rowwise() * lambda_kp1_.transpose() +
+        f_k_rotated_.array().rowwise() * lambda_k_.transpose()).matrix();
+    points_kp1_.colwise() += 0.5 * t;
+    points_k_ = points_kp1_.colwise() - t;
+    *distances = 2.0 -
+        f_kp1_.cwiseProduct(points_kp1_).colwise().sum().array().transpose() /
+            points_kp1_.colwise().norm().array().transpose() -
+        f_k_rotated_.cwiseProduct(points_k_).colwise().sum().array().transpose() /
+            points_k_.colwise().norm().array().transpose();
+    return true;
+  }
+
+ private:
+  const Eigen::Matrix3Xd& f_kp1_;
+  const Eigen::Matrix3Xd& f_k_rotated_;
+  Eigen::ArrayXd cos_kp1_k_rotated_;
+  Eigen::ArrayXd b_kp1_;
+  Eigen::ArrayXd b_k_;
+  Eigen::ArrayXd lambda_kp1_;
+  Eigen::ArrayXd lambda_k_;
+  Eigen::Matrix3Xd points_kp1_;
+  Eigen::Matrix3Xd points_k_;
+};
+
+/// Splits the matches into in- and outliers, is_inlier holds the classification of the
+/// matches in match_indices, all other matches are outliers.
+void splitMatchesByInlierFlag(
+    const aslam::FrameToFrameMatchesWithScore& matches_kp1_k, const std::vector<int>& match_indices,
+    const Eigen::Array<bool, Eigen::Dynamic, 1>& is_inlier,
+    aslam::FrameToFrameMatchesWithScore* inlier_matches_kp1_k,
+    aslam::FrameToFrameMatchesWithScore* outlier_matches_kp1_k) {
+  CHECK_NOTNULL(inlier_matches_kp1_k);
+  CHECK_NOTNULL(outlier_matches_kp1_k);
+  CHECK_EQ(static_cast<int>(match_indices.size()), is_inlier.size());
+  std::vector<unsigned char> is_inlier_match(matches_kp1_k.size(), 0u);
+  for (size_t i = 0u; i < match_indices.size(); ++i) {
+    is_inlier_match[match_indices[i]] = is_inlier(i) ? 1u : 0u;
+  }
+  for (size_t match_idx = 0u; match_idx < matches_kp1_k.size(); ++match_idx) {
+    if (is_inlier_match[match_idx]) {
+      inlier_matches_kp1_k->emplace_back(matches_kp1_k[match_idx]);
+    } else {
+      outlier_matches_kp1_k->emplace_back(matches_kp1_k[match_idx]);
+    }
+  }
+  CHECK_EQ(inlier_matches_kp1_k->size() + outlier_matches_kp1_k->size(), matches_kp1_k.size());
+}
+
+// Handle the case with too few matches to distinguish between out-/inliers.
+constexpr int kMinKeypointCorrespondences = 6;
+}  // namespace
+
+bool rejectOutlierFeatureMatchesTranslationRotationSinglePass(
+    const aslam::VisualFrame& frame_kp1, const aslam::VisualFrame& frame_k,
+    const aslam::Quaternion& q_Ckp1_Ck,
+    const aslam::FrameToFrameMatchesWithScore& matches_kp1_k, bool fix_random_seed,
+    double ransac_threshold, size_t ransac_max_iterations, double early_exit_inlier_ratio,
+    aslam::FrameToFrameMatchesWithScore* inlier_matches_kp1_k,
+    aslam::FrameToFrameMatchesWithScore* outlier_matches_kp1_k) {
+  CHECK_NOTNULL(inlier_matches_kp1_k)->clear();
+  CHECK_NOTNULL(outlier_matches_kp1_k)->clear();
+  CHECK_GT(ransac_threshold, 0.0);
+  CHECK_GT(ransac_max_iterations, 0u);
+  CHECK_GT(early_exit_inlier_ratio, 0.0);
+
+  Eigen::Matrix3Xd f_kp1;
+  Eigen::Matrix3Xd f_k;
+  std::vector<int> match_indices;
+  getBackProjectedBearingVectors(frame_kp1, frame_k, matches_kp1_k, &f_kp1, &f_k, &match_indices);
+  const int num_correspondences = static_cast<int>(match_indices.size());
+  if (num_correspondences < kMinKeypointCorrespondences) {
+    VLOG(1) << "Too few matches to run RANSAC.";
+    *outlier_matches_kp1_k = matches_kp1_k;
+    return false;
+  }
+
+  // f_kp1 = R_kp1_k * f_k for a pure rotation, f_k_rotated holds the prior rotation applied.
+  const Eigen::Matrix3Xd f_k_rotated = q_Ckp1_Ck.getRotationMatrix() * f_k;
+  TranslationOnlyScorer translation_scorer(f_kp1, f_k_rotated);
+
+  std::mt19937 rng(fix_random_seed ? 42u : std::random_device()());
+  ModelSearch rotation_search(num_correspondences);
+  ModelSearch translation_search(num_correspondences);
+  std::vector<int> sample;
+  Eigen::Matrix3Xd rotated_f_k(3, num_correspondences);
+  Eigen::ArrayXd distances(num_correspondences);
+
+  int iteration = 0;
+  for (; iteration < static_cast<int>(ransac_max_iterations) &&
+      !(rotation_search.is_done && translation_search.is_done); ++iteration) {
+    if (!rotation_search.is_done) {
+      // Rotation from three rays, scored by 1 - cos(f_kp1, R * f_k).
+      drawDistinctSample(num_correspondences, kRotationSampleSize, &rng, &sample);
+      rotated_f_k.noalias() = computeRotationKabsch(f_kp1, f_k, sample) * f_k;
+      distances = 1.0 - f_kp1.cwiseProduct(rotated_f_k).colwise().sum().array().transpose();
+      rotation_search.update(distances, ransac_threshold);
+    }
+
+    if (!translation_search.is_done) {
+      // Translation direction from two rays given the prior rotation.
+      drawDistinctSample(num_correspondences, kTranslationSampleSize, &rng, &sample);
+      if (translation_scorer.score(sample[0], sample[1], &distances)) {
+        translation_search.update(distances, ransac_threshold);
+      }
+    }
+
+    // A model stops once its best inlier ratio reaches the early exit ratio or an all-inlier
+    // sample has been drawn with high probability.
+    for (std::pair<ModelSearch*, int> search_and_sample_size :
+         {std::make_pair(&rotation_search, kRotationSampleSize),
+          std::make_pair(&translation_search, kTranslationSampleSize)}) {
+      ModelSearch& search = *search_and_sample_size.first;
+      if (search.is_done || search.best_num_inliers <= 0) {
+        continue;
+      }
+      search.is_done =
+          search.best_num_inliers >= early_exit_inlier_ratio * num_correspondences ||
+          iteration + 1 >= getRequiredIterations(
+              search.best_num_inliers, num_correspondences, search_and_sample_size.second);
+    }
+  }
+  VLOG(5) << "Single pass two-point RANSAC stopped after " << iteration << " iterations.";
+
+  // Take the union of both inlier sets as final inlier set, see
+  // rejectOutlierFeatureMatchesTranslationRotationSAC().
+  const Eigen::Array<bool, Eigen::Dynamic, 1> is_inlier =
+      rotation_search.best_inliers || translation_search.best_inliers;
+  if (is_inlier.count() < kMinKeypointCorrespondences) {
+    VLOG(1) << "Too few inliers to reliably classify outlier matches.";
+    *outlier_matches_kp1_k = matches_kp1_k;
+    return false;
+  }
+  splitMatchesByInlierFlag(matches_kp1_k, match_indices, is_inlier, inlier_matches_kp1_k,
+                           outlier_matches_kp1_k);
+  return true;
+}
+
+bool rejectOutlierFeatureMatchesGyroPriorSAC(
+    const aslam::VisualFrame& frame_kp1, const aslam::VisualFrame& frame_k,
+    const aslam::Quaternion& q_Ckp1_Ck,
+    const aslam::FrameToFrameMatchesWithScore& matches_kp1_k, bool fix_random_seed,
+    double ransac_threshold, size_t ransac_max_iterations, bool refine_rotation,
+    aslam::FrameToFrameMatchesWithScore* inlier_matches_kp1_k,
+    aslam::FrameToFrameMatchesWithScore* outlier_matches_kp1_k) {
+  CHECK_NOTNULL(inlier_matches_kp1_k)->clear();
+  CHECK_NOTNULL(outlier_matches_kp1_k)->clear();
+  CHECK_GT(ransac_threshold, 0.0);
+  CHECK_GT(ransac_max_iterations, 0u);
+
+  Eigen::Matrix3Xd f_kp1;
+  Eigen::Matrix3Xd f_k;
+  std::vector<int> match_indices;
+  getBackProjectedBearingVectors(frame_kp1, frame_k, matches_kp1_k, &f_kp1, &f_k, &match_indices);
+  const int num_correspondences = static_cast<int>(match_indices.size());
+  if (num_correspondences < kMinKeypointCorrespondences) {
+    VLOG(1) << "Too few matches to run RANSAC.";
+    *outlier_matches_kp1_k = matches_kp1_k;
+    return false;
+  }
+
+  // Derotate the rays once. With the rotation given, the rotation-only model needs no
+  // hypotheses: every match is tested against the prior directly.
+  Eigen::Matrix3d R_kp1_k = q_Ckp1_Ck.getRotationMatrix();
+  Eigen::Matrix3Xd f_k_rotated = R_kp1_k * f_k;
+  Eigen::ArrayXd rotation_distances =
+      1.0 - f_kp1.cwiseProduct(f_k_rotated).colwise().sum().array().transpose();
+  if (refine_rotation) {
+    // Absorb the gyro bias and the camera-IMU misalignment by refitting the rotation to the
+    // rays consistent with the prior.
+    std::vector<int> rotation_inliers;
+    for (int i = 0; i < num_correspondences; ++i) {
+      if (rotation_distances(i) < ransac_threshold) {
+        rotation_inliers.push_back(i);
+      }
+    }
+    if (static_cast<int>(rotation_inliers.size()) >= kRotationSampleSize) {
+      R_kp1_k = computeRotationKabsch(f_kp1, f_k, rotation_inliers);
+      f_k_rotated.noalias() = R_kp1_k * f_k;
+      rotation_distances =
+          1.0 - f_kp1.cwiseProduct(f_k_rotated).colwise().sum().array().transpose();
+    }
+  }
+  const Eigen::Array<bool, Eigen::Dynamic, 1> is_rotation_inlier =
+      rotation_distances < ransac_threshold;
+
+  // Translation-only RANSAC with two-ray samples on the derotated rays.
+  TranslationOnlyScorer translation_scorer(f_kp1, f_k_rotated);
+  std::mt19937 rng(fix_random_seed ? 42u : std::random_device()());
+  ModelSearch translation_search(num_correspondences);
+  std::vector<int> sample;
+  Eigen::ArrayXd distances(num_correspondences);
+  int iteration = 0;
+  for (; iteration < static_cast<int>(ransac_max_iterations) && !translation_search.is_done;
+      ++iteration) {
+    drawDistinctSample(num_correspondences, kTranslationSampleSize, &rng, &sample);
+    if (translation_scorer.score(sample[0], sample[1], &distances)) {
+      translation_search.update(distances, ransac_threshold);
+    }
+    translation_search.is_done = translation_search.best_num_inliers > 0 &&
+        iteration + 1 >= getRequiredIterations(translation_search.best_num_inliers,
+                                               num_correspondences, kTranslationSampleSize);
+  }
+  VLOG(5) << "Gyro prior RANSAC stopped after " << iteration << " iterations.";
+
+  // Take the union of both inlier sets as final inlier set, see
+  // rejectOutlierFeatureMatchesTranslationRotationSAC().
+  const Eigen::Array<bool, Eigen::Dynamic, 1> is_inlier =
+      is_rotation_inlier || translation_search.best_inliers;
+  if (is_inlier.count() < kMinKeypointCorrespondences) {
+    VLOG(1) << "Too few inliers to reliably classify outlier matches.";
+    *outlier_matches_kp1_k = matches_kp1_k;
+    return false;
+  }
+  splitMatchesByInlierFlag(matches_kp1_k, match_indices, is_inlier, inlier_matches_kp1_k,
+                           outlier_matches_kp1_k);
+  return true;
+}
 
 }  // namespace gv
 }  // namespace aslam
@@ -0,0 +1,66 @@
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "aslam/geometric-vision/opengv-eigen-adapters.h"
+
+namespace aslam {
+namespace geometric_vision {
+namespace {
+/// Number of correspondences of two indexed column matrices, checking the indices.
+size_t getNumCorrespondences(
+    const Eigen::Matrix3Xd& matrix_a, const std::vector<size_t>* indices_a,
+    const Eigen::Matrix3Xd& matrix_b, const std::vector<size_t>* indices_b) {
+  const size_t num_a = indices_a == nullptr ? static_cast<size_t>(matrix_a.cols()) :
+      indices_a->size();
+  const size_t num_b = indices_b == nullptr ? static_cast<size_t>(matrix_b.cols()) :
+      indices_b->size();
+  CHECK_EQ(num_a, num_b) << "Mismatch between the number of correspondences.";
+  for (const std::pair<const Eigen::Matrix3Xd*, const std::vector<size_t>*>& matrix_and_indices :
+       {std::make_pair(&matrix_a, indices_a), std::make_pair(&matrix_b, indices_b)}) {
+    if (matrix_and_indices.second != nullptr) {
+      for (const size_t column : *matrix_and_indices.second) {
+        CHECK_LT(column, static_cast<size_t>(matrix_and_indices.first->cols()));
+      }
+    }
+  }
+  return num_a;
+}
+}  // namespace
+
+EigenCentralAbsoluteAdapter::EigenCentralAbsoluteAdapter(
+    const Eigen::Matrix3Xd& bearing_vectors, const std::vector<size_t>* bearing_vector_indices,
+    const Eigen::Matrix3Xd& points, const std::vector<size_t>* point_indices)
+    : bearing_vectors_(bearing_vectors), bearing_vector_indices_(bearing_vector_indices),
+      points_(points), point_indices_(point_indices),
+      num_correspondences_(getNumCorrespondences(
+          bearing_vectors, bearing_vector_indices, points, point_indices)) {}
+
+EigenNoncentralAbsoluteAdapter::EigenNoncentralAbsoluteAdapter(
+    const Eigen::Matrix3Xd& bearing_vectors, const std::vector<int>& camera_indices,
+    const Eigen::Matrix3Xd& points, const opengv::translations_t& camera_offsets,
+    const opengv::rotations_t& camera_rotations)
+    : bearing_vectors_(bearing_vectors), camera_indices_(camera_indices), points_(points),
+      camera_offsets_(camera_offsets), camera_rotations_(camera_rotations) {
+  CHECK_EQ(bearing_vectors_.cols(), points_.cols());
+  CHECK_EQ(static_cast<size_t>(bearing_vectors_.cols()), camera_indices_.size());
+  CHECK_EQ(camera_offsets_.size(), camera_rotations_.size());
+  for (const int camera_index : camera_indices_) {
+    CHECK_GE(camera_index, 0);
+    CHECK_LT(static_cast<size_t>(camera_index), camera_offsets_.size());
+  }
+}
+
+EigenCentralRelativeAdapter::EigenCentralRelativeAdapter(
+    const Eigen::Matrix3Xd& bearing_vectors_1, const std::vector<size_t>* bearing_vector_indices_1,
+    const Eigen::Matrix3Xd& bearing_vectors_2, const std::vector<size_t>* bearing_vector_indices_2,
+    const opengv::rotation_t& R12)
+    : opengv::relative_pose::RelativeAdapterBase(R12),
+      bearing_vectors_1_(bearing_vectors_1), bearing_vector_indices_1_(bearing_vector_indices_1),
+      bearing_vectors_2_(bearing_vectors_2), bearing_vector_indices_2_(bearing_vector_indices_2),
+      num_correspondences_(getNumCorrespondences(
+          bearing_vectors_1, bearing_vector_indices_1, bearing_vectors_2,
+          bearing_vector_indices_2)) {}
+
+}  // namespace geometric_vision
+}  // namespace aslam
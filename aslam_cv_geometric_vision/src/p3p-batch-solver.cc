@@ -0,0 +1,254 @@
+#include <cmath>
+#include <limits>
+
+#include <glog/logging.h>
+
+#include "aslam/geometric-vision/p3p-batch-solver.h"
+
+namespace aslam {
+namespace geometric_vision {
+namespace {
+typedef Eigen::Array<double, P3pBatchSolver::kNumLanes, 1> LaneArray;
+typedef Eigen::Array<bool, P3pBatchSolver::kNumLanes, 1> LaneMask;
+
+// Newton steps polishing the roots of the quartic.
+constexpr int kNumNewtonSteps = 5;
+// Relative magnitude below which a quantity is treated as zero, e.g. for collinear points.
+constexpr double kDegeneracyTolerance = 1e-10;
+
+/// A 3d vector per lane.
+struct LaneVector3 {
+  LaneArray x;
+  LaneArray y;
+  LaneArray z;
+};
+
+inline LaneVector3 getLaneVector(const P3pBatchSolver::LaneCorrespondences& correspondences,
+                                 int index) {
+  return LaneVector3{correspondences.col(3 * index).array(),
+                     correspondences.col(3 * index + 1).array(),
+                     correspondences.col(3 * index + 2).array()};
+}
+
+inline LaneVector3 operator-(const LaneVector3& lhs, const LaneVector3& rhs) {
+  return LaneVector3{lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z};
+}
+
+inline LaneVector3 operator*(const LaneVector3& vector, const LaneArray& scale) {
+  return LaneVector3{vector.x * scale, vector.y * scale, vector.z * scale};
+}
+
+inline LaneArray dot(const LaneVector3& lhs, const LaneVector3& rhs) {
+  return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z;
+}
+
+inline LaneVector3 cross(const LaneVector3& lhs, const LaneVector3& rhs) {
+  return LaneVector3{lhs.y * rhs.z - lhs.z * rhs.y, lhs.z * rhs.x - lhs.x * rhs.z,
+                     lhs.x * rhs.y - lhs.y * rhs.x};
+}
+
+inline LaneVector3 normalized(const LaneVector3& vector) {
+  return vector * dot(vector, vector).sqrt().inverse();
+}
+
+inline LaneMask isFinite(const LaneArray& values) {
+  // Also false for NaN.
+  return values.abs() < std::numeric_limits<double>::infinity();
+}
+
+inline LaneArray cubeRoot(const LaneArray& values) {
+  const LaneArray root = values.abs().pow(1.0 / 3.0);
+  return (values < 0.0).select(-root, root);
+}
+
+/// Largest real root of m^3 + b m^2 + c m + d = 0 with Cardano's formula, or the trigonometric
+/// solution if all three roots are real.
+LaneArray getLargestCubicRoot(const LaneArray& b, const LaneArray& c, const LaneArray& d) {
+  const LaneArray shift = b / 3.0;
+  const LaneArray p = c - b * shift;
+  const LaneArray q = (2.0 / 27.0) * b * b * b - c * shift + d;
+  const LaneArray discriminant = 0.25 * q * q + p * p * p / 27.0;
+
+  const LaneArray sqrt_discriminant = discriminant.max(0.0).sqrt();
+  const LaneArray single_root =
+      cubeRoot(-0.5 * q + sqrt_discriminant) + cubeRoot(-0.5 * q - sqrt_discriminant);
+
+  // p < 0 if the discriminant is not positive.
+  const LaneArray negative_p = p.min(-std::numeric_limits<double>::min());
+  const LaneArray cos_argument =
+      ((1.5 * q / negative_p) * (-3.0 / negative_p).sqrt()).max(-1.0).min(1.0);
+  const LaneArray largest_root =
+      2.0 * (-negative_p / 3.0).sqrt() * (cos_argument.acos() / 3.0).cos();
+  return (discriminant > 0.0).select(single_root, largest_root) - shift;
+}
+
+/// Real roots of sum_i coefficients[i] v^i = 0 with Ferrari's method. Root k of a lane is only
+/// valid where valid[k] is set.
+void solveQuartic(const LaneArray coefficients[5], LaneArray roots[4], LaneMask valid[4]) {
+  const LaneArray max_coefficient = coefficients[0].abs().max(coefficients[1].abs())
+      .max(coefficients[2].abs()).max(coefficients[3].abs()).max(coefficients[4].abs());
+  const LaneMask is_quartic =
+      coefficients[4].abs() > kDegeneracyTolerance * max_coefficient;
+  const LaneArray inverse_leading =
+      is_quartic.select(coefficients[4], LaneArray::Ones()).inverse();
+  const LaneArray a = coefficients[3] * inverse_leading;
+  const LaneArray b = coefficients[2] * inverse_leading;
+  const LaneArray c = coefficients[1] * inverse_leading;
+  const LaneArray d = coefficients[0] * inverse_leading;
+
+  // Depressed quartic y^4 + p y^2 + q y + r = 0 with v = y - a / 4.
+  const LaneArray a_pw2 = a * a;
+  const LaneArray p = b - 0.375 * a_pw2;
+  const LaneArray q = c - 0.5 * a * b + 0.125 * a_pw2 * a;
+  const LaneArray r = d - 0.25 * a * c + 0.0625 * a_pw2 * b - (3.0 / 256.0) * a_pw2 * a_pw2;
+
+  // With a positive root m of the resolvent cubic, the quartic factors into
+  // (y^2 - s y + p / 2 + m + q / (2 s)) (y^2 + s y + p / 2 + m - q / (2 s)) with s = sqrt(2 m).
+  const LaneArray m = getLargestCubicRoot(p, 0.25 * p * p - r, -0.125 * q * q)
+      .max(std::numeric_limits<double>::epsilon());
+  const LaneArray s = (2.0 * m).sqrt();
+  const LaneArray q_over_2s = 0.5 * q / s;
+  const LaneArray shift = 0.25 * a;
+  for (int quadratic = 0; quadratic < 2; ++quadratic) {
+    const double sign = quadratic == 0 ? 1.0 : -1.0;
+    const LaneArray constant = 0.5 * p + m + sign * q_over_2s;
+    const LaneArray discriminant = s * s - 4.0 * constant;
+    // Tolerate round-off for double roots.
+    const LaneMask is_real =
+        discriminant > -kDegeneracyTolerance * (s * s + constant.abs());
+    const LaneArray sqrt_discriminant = discriminant.max(0.0).sqrt();
+    roots[2 * quadratic] = 0.5 * (sign * s + sqrt_discriminant) - shift;
+    roots[2 * quadratic + 1] = 0.5 * (sign * s - sqrt_discriminant) - shift;
+    valid[2 * quadratic] = is_quartic && is_real;
+    valid[2 * quadratic + 1] = is_quartic && is_real;
+  }
+
+  for (int k = 0; k < 4; ++k) {
+    LaneArray& v = roots[k];
+    for (int step = 0; step < kNumNewtonSteps; ++step) {
+      const LaneArray value =
+          (((coefficients[4] * v + coefficients[3]) * v + coefficients[2]) * v +
+              coefficients[1]) * v + coefficients[0];
+      const LaneArray derivative =
+          ((4.0 * coefficients[4] * v + 3.0 * coefficients[3]) * v + 2.0 * coefficients[2]) *
+              v + coefficients[1];
+      const LaneMask has_derivative = derivative.abs() > std::numeric_limits<double>::min();
+      v -= has_derivative.select(value / derivative, LaneArray::Zero());
+    }
+    valid[k] = valid[k] && isFinite(v);
+  }
+}
+
+/// Orthonormal frame of a triangle: x along the first edge, z along the triangle normal.
+inline void getTriangleFrame(const LaneVector3& point_1, const LaneVector3& point_2,
+                             const LaneVector3& point_3, LaneVector3 axes[3]) {
+  const LaneVector3 edge_12 = point_2 - point_1;
+  axes[0] = normalized(edge_12);
+  axes[2] = normalized(cross(edge_12, point_3 - point_1));
+  axes[1] = cross(axes[2], axes[0]);
+}
+}  // namespace
+
+constexpr int P3pBatchSolver::kNumLanes;
+constexpr int P3pBatchSolver::kMaxNumSolutions;
+
+void P3pBatchSolver::solve(const LaneCorrespondences& bearing_vectors,
+                           const LaneCorrespondences& points, Solutions* solutions) {
+  CHECK_NOTNULL(solutions);
+  const LaneVector3 f_1 = getLaneVector(bearing_vectors, 0);
+  const LaneVector3 f_2 = getLaneVector(bearing_vectors, 1);
+  const LaneVector3 f_3 = getLaneVector(bearing_vectors, 2);
+  const LaneVector3 P_1 = getLaneVector(points, 0);
+  const LaneVector3 P_2 = getLaneVector(points, 1);
+  const LaneVector3 P_3 = getLaneVector(points, 2);
+
+  // Grunert: angles between the bearing vectors and the squared sides of the triangle opposite
+  // to the points 1, 2 and 3.
+  const LaneArray cos_alpha = dot(f_2, f_3);
+  const LaneArray cos_beta = dot(f_1, f_3);
+  const LaneArray cos_gamma = dot(f_1, f_2);
+  const LaneVector3 P_12 = P_2 - P_1;
+  const LaneVector3 P_13 = P_3 - P_1;
+  const LaneVector3 P_23 = P_3 - P_2;
+  const LaneArray a_pw2 = dot(P_23, P_23);
+  const LaneArray b_pw2 = dot(P_13, P_13);
+  const LaneArray c_pw2 = dot(P_12, P_12);
+  const LaneVector3 normal = cross(P_12, P_13);
+  const LaneMask is_triangle =
+      dot(normal, normal) > kDegeneracyTolerance * b_pw2 * c_pw2 && b_pw2 > 0.0;
+
+  const LaneArray inverse_b_pw2 = is_triangle.select(b_pw2, LaneArray::Ones()).inverse();
+  const LaneArray k_1 = (a_pw2 - c_pw2) * inverse_b_pw2;
+  const LaneArray k_2 = (a_pw2 + c_pw2) * inverse_b_pw2;
+  const LaneArray a_pw2_b_pw2 = a_pw2 * inverse_b_pw2;
+  const LaneArray c_pw2_b_pw2 = c_pw2 * inverse_b_pw2;
+  const LaneArray cos_alpha_pw2 = cos_alpha * cos_alpha;
+  const LaneArray cos_beta_pw2 = cos_beta * cos_beta;
+  const LaneArray cos_gamma_pw2 = cos_gamma * cos_gamma;
+  const LaneArray cos_alpha_cos_gamma = cos_alpha * cos_gamma;
+
+  // Quartic in v = s_3 / s_1, the ratio of the depths of points 3 and 1.
+  LaneArray coefficients[5];
+  coefficients[4] = (k_1 - 1.0) * (k_1 - 1.0) - 4.0 * c_pw2_b_pw2 * cos_alpha_pw2;
+  coefficients[3] = 4.0 * (k_1 * (1.0 - k_1) * cos_beta - (1.0 - k_2) * cos_alpha_cos_gamma +
+      2.0 * c_pw2_b_pw2 * cos_alpha_pw2 * cos_beta);
+  coefficients[2] = 2.0 * (k_1 * k_1 - 1.0 + 2.0 * k_1 * k_1 * cos_beta_pw2 +
+      2.0 * (1.0 - c_pw2_b_pw2) * cos_alpha_pw2 - 4.0 * k_2 * cos_alpha_cos_gamma * cos_beta +
+      2.0 * (1.0 - a_pw2_b_pw2) * cos_gamma_pw2);
+  coefficients[1] = 4.0 * (-k_1 * (1.0 + k_1) * cos_beta +
+      2.0 * a_pw2_b_pw2 * cos_gamma_pw2 * cos_beta - (1.0 - k_2) * cos_alpha_cos_gamma);
+  coefficients[0] = (1.0 + k_1) * (1.0 + k_1) - 4.0 * a_pw2_b_pw2 * cos_gamma_pw2;
+
+  LaneArray roots[4];
+  LaneMask valid[4];
+  solveQuartic(coefficients, roots, valid);
+
+  LaneVector3 world_axes[3];
+  getTriangleFrame(P_1, P_2, P_3, world_axes);
+  for (int lane = 0; lane < kNumLanes; ++lane) {
+    solutions->num_solutions[lane] = 0;
+  }
+  for (int k = 0; k < 4; ++k) {
+    const LaneArray& v = roots[k];
+    const LaneArray u_denominator = 2.0 * (cos_gamma - v * cos_alpha);
+    const LaneArray u = ((k_1 - 1.0) * v * v - 2.0 * k_1 * cos_beta * v + 1.0 + k_1) /
+        u_denominator;
+    const LaneArray depth_denominator = 1.0 + v * v - 2.0 * v * cos_beta;
+    const LaneArray depth_1 = (b_pw2 / depth_denominator).sqrt();
+    const LaneArray depth_2 = u * depth_1;
+    const LaneArray depth_3 = v * depth_1;
+    const LaneMask is_solution = valid[k] && is_triangle &&
+        u_denominator.abs() > kDegeneracyTolerance && depth_denominator > 0.0 &&
+        depth_1 > 0.0 && depth_2 > 0.0 && depth_3 > 0.0 && isFinite(depth_2);
+    if (!is_solution.any()) {
+      continue;
+    }
+
+    const LaneVector3 X_1 = f_1 * depth_1;
+    LaneVector3 camera_axes[3];
+    getTriangleFrame(X_1, f_2 * depth_2, f_3 * depth_3, camera_axes);
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      if (!is_solution(lane)) {
+        continue;
+      }
+      Eigen::Matrix3d world_frame, camera_frame;
+      for (int axis = 0; axis < 3; ++axis) {
+        world_frame.col(axis) << world_axes[axis].x(lane), world_axes[axis].y(lane),
+            world_axes[axis].z(lane);
+        camera_frame.col(axis) << camera_axes[axis].x(lane), camera_axes[axis].y(lane),
+            camera_axes[axis].z(lane);
+      }
+      Eigen::Matrix<double, 3, 4>& model =
+          solutions->models[lane][solutions->num_solutions[lane]];
+      model.leftCols<3>() = world_frame * camera_frame.transpose();
+      model.col(3) = Eigen::Vector3d(P_1.x(lane), P_1.y(lane), P_1.z(lane)) -
+          model.leftCols<3>() * Eigen::Vector3d(X_1.x(lane), X_1.y(lane), X_1.z(lane));
+      if (model.allFinite()) {
+        ++solutions->num_solutions[lane];
+      }
+    }
+  }
+}
+
+}  // namespace geometric_vision
+}  // namespace aslam
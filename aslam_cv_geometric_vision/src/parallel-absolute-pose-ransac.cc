@@ -0,0 +1,440 @@
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+
+#include <aslam/common/deadline.h>
+#include <Eigen/Dense>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <opengv/absolute_pose/methods.hpp>
+
+#include "aslam/geometric-vision/p3p-batch-solver.h"
+#include "aslam/geometric-vision/parallel-absolute-pose-ransac.h"
+#include "aslam/geometric-vision/prosac-sampler.h"
+
+DEFINE_int32(acv_ransac_fixed_seed, 42,
+             "Seed of the absolute pose RANSAC RNGs if no random seed is requested.");
+
+namespace aslam {
+namespace geometric_vision {
+namespace {
+// Hypotheses per thread between two updates of the stopping criterion. Small enough to not
+// overshoot the required iterations by much, large enough to amortize the dispatch.
+constexpr int kNumHypothesesPerThreadAndRound = 16;
+// Minimum PROSAC sampling set size for its inlier ratio to end the search, smaller sets are
+// too easily explained by a wrong model.
+constexpr int kMinProsacSamplingSetSize = 16;
+// Re-collections of the inliers per local optimization, and Gauss-Newton steps per collection.
+constexpr int kMaxNumLocalOptimizationIterations = 4;
+constexpr int kNumRefinementSteps = 5;
+// Step norm below which the Gauss-Newton refinement has converged.
+constexpr double kRefinementConvergenceThreshold = 1e-10;
+
+inline Eigen::Matrix3d skew(const Eigen::Vector3d& vector) {
+  Eigen::Matrix3d matrix;
+  matrix << 0.0, -vector.z(), vector.y(),
+            vector.z(), 0.0, -vector.x(),
+            -vector.y(), vector.x(), 0.0;
+  return matrix;
+}
+}  // namespace
+
+constexpr int ParallelAbsolutePoseRansac::kSampleSize;
+
+ParallelAbsolutePoseRansac::ParallelAbsolutePoseRansac(size_t num_threads, bool random_seed)
+    : num_threads_(num_threads),
+      random_seed_(random_seed),
+      probability_(0.99),
+      max_num_local_optimizations_(0),
+      has_camera_offsets_(false) {
+  CHECK_GT(num_threads_, 0u);
+}
+
+ParallelAbsolutePoseRansac::~ParallelAbsolutePoseRansac() {}
+
+void ParallelAbsolutePoseRansac::setProbability(double probability) {
+  CHECK_GT(probability, 0.0);
+  CHECK_LT(probability, 1.0);
+  probability_ = probability;
+}
+
+void ParallelAbsolutePoseRansac::setLocalOptimization(int max_num_local_optimizations) {
+  CHECK_GE(max_num_local_optimizations, 0);
+  max_num_local_optimizations_ = max_num_local_optimizations;
+}
+
+void ParallelAbsolutePoseRansac::setCorrespondences(
+    const opengv::absolute_pose::AbsoluteAdapterBase& adapter) {
+  const size_t num_correspondences = adapter.getNumberCorrespondences();
+  bearing_vectors_B_.resize(Eigen::NoChange, num_correspondences);
+  camera_offsets_B_.resize(Eigen::NoChange, num_correspondences);
+  points_G_.resize(Eigen::NoChange, num_correspondences);
+  has_camera_offsets_ = false;
+  for (size_t i = 0u; i < num_correspondences; ++i) {
+    bearing_vectors_B_.col(i) = adapter.getCamRotation(i) * adapter.getBearingVector(i);
+    camera_offsets_B_.col(i) = adapter.getCamOffset(i);
+    points_G_.col(i) = adapter.getPoint(i);
+    has_camera_offsets_ |= !camera_offsets_B_.col(i).isZero();
+  }
+}
+
+void ParallelAbsolutePoseRansac::computeDistances(
+    const Eigen::Matrix<double, 3, 4>& model, ThreadState* state) const {
+  CHECK_NOTNULL(state);
+  const Eigen::Matrix3d R_B_G = model.leftCols<3>().transpose();
+  const Eigen::Vector3d p_B_G = -R_B_G * model.col(3);
+  // Rays from the camera centers to the points, in the body frame.
+  state->points_B.noalias() = R_B_G * points_G_;
+  state->points_B.colwise() += p_B_G;
+  if (has_camera_offsets_) {
+    state->points_B -= camera_offsets_B_;
+  }
+  state->distances = 1.0 - (state->points_B.cwiseProduct(bearing_vectors_B_).colwise().sum().array()
+      / state->points_B.colwise().norm().array()).transpose();
+}
+
+void ParallelAbsolutePoseRansac::scoreHypothesis(
+    const opengv::transformation_t* solutions, size_t num_solutions, int disambiguation_index,
+    double threshold, ThreadState* state) const {
+  CHECK_NOTNULL(state);
+  // Keep the solution that best explains the fourth correspondence.
+  const Eigen::Vector3d& point_G = points_G_.col(disambiguation_index);
+  const Eigen::Vector3d& bearing_vector_B = bearing_vectors_B_.col(disambiguation_index);
+  const Eigen::Vector3d& camera_offset_B = camera_offsets_B_.col(disambiguation_index);
+  const opengv::transformation_t* best_solution = nullptr;
+  double best_solution_distance = std::numeric_limits<double>::infinity();
+  for (size_t i = 0u; i < num_solutions; ++i) {
+    const opengv::transformation_t& solution = solutions[i];
+    const Eigen::Vector3d ray_B = solution.leftCols<3>().transpose() *
+        (point_G - solution.col(3)) - camera_offset_B;
+    const double distance = 1.0 - bearing_vector_B.dot(ray_B) / ray_B.norm();
+    if (distance < best_solution_distance) {
+      best_solution_distance = distance;
+      best_solution = &solution;
+    }
+  }
+  if (best_solution == nullptr) {
+    return;
+  }
+
+  computeDistances(*best_solution, state);
+  const int num_inliers = static_cast<int>((state->distances < threshold).count());
+  if (num_inliers > state->best_num_inliers) {
+    state->best_num_inliers = num_inliers;
+    state->best_model = *best_solution;
+  }
+}
+
+void ParallelAbsolutePoseRansac::runHypotheses(
+    const opengv::absolute_pose::AbsoluteAdapterBase& adapter, Algorithm algorithm,
+    double threshold, int num_hypotheses, const int* samples, ThreadState* state) const {
+  CHECK_NOTNULL(state);
+  state->best_num_inliers = -1;
+  if (samples == nullptr) {
+    // Draw kSampleSize distinct correspondences per hypothesis.
+    const int num_correspondences = static_cast<int>(points_G_.cols());
+    std::uniform_int_distribution<int> index_distribution(0, num_correspondences - 1);
+    state->samples.clear();
+    for (int hypothesis = 0; hypothesis < num_hypotheses; ++hypothesis) {
+      const size_t sample_begin = state->samples.size();
+      while (state->samples.size() - sample_begin < static_cast<size_t>(kSampleSize)) {
+        const int index = index_distribution(state->rng);
+        if (std::find(state->samples.begin() + sample_begin, state->samples.end(), index) ==
+            state->samples.end()) {
+          state->samples.push_back(index);
+        }
+      }
+    }
+    samples = state->samples.data();
+  }
+
+  if (algorithm == Algorithm::kKneip && !has_camera_offsets_) {
+    // Solve kNumLanes hypotheses at once, padding the last batch with its last hypothesis.
+    P3pBatchSolver::LaneCorrespondences lane_bearing_vectors;
+    P3pBatchSolver::LaneCorrespondences lane_points;
+    P3pBatchSolver::Solutions lane_solutions;
+    for (int first_hypothesis = 0; first_hypothesis < num_hypotheses;
+         first_hypothesis += P3pBatchSolver::kNumLanes) {
+      for (int lane = 0; lane < P3pBatchSolver::kNumLanes; ++lane) {
+        const int hypothesis = std::min(first_hypothesis + lane, num_hypotheses - 1);
+        const int* sample = samples + hypothesis * kSampleSize;
+        for (int i = 0; i < 3; ++i) {
+          lane_bearing_vectors.block<1, 3>(lane, 3 * i) =
+              bearing_vectors_B_.col(sample[i]).transpose();
+          lane_points.block<1, 3>(lane, 3 * i) = points_G_.col(sample[i]).transpose();
+        }
+      }
+      P3pBatchSolver::solve(lane_bearing_vectors, lane_points, &lane_solutions);
+      const int num_lanes =
+          std::min(P3pBatchSolver::kNumLanes, num_hypotheses - first_hypothesis);
+      for (int lane = 0; lane < num_lanes; ++lane) {
+        const int* sample = samples + (first_hypothesis + lane) * kSampleSize;
+        scoreHypothesis(lane_solutions.models[lane], lane_solutions.num_solutions[lane],
+                        sample[kSampleSize - 1], threshold, state);
+      }
+    }
+    return;
+  }
+
+  std::vector<int>& sample = state->sample;
+  for (int hypothesis = 0; hypothesis < num_hypotheses; ++hypothesis) {
+    sample.assign(samples + hypothesis * kSampleSize,
+                  samples + (hypothesis + 1) * kSampleSize - 1);
+    const opengv::transformations_t solutions = (algorithm == Algorithm::kKneip) ?
+        opengv::absolute_pose::p3p_kneip(adapter, sample) :
+        opengv::absolute_pose::gp3p(adapter, sample);
+    scoreHypothesis(solutions.data(), solutions.size(),
+                    samples[(hypothesis + 1) * kSampleSize - 1], threshold, state);
+  }
+}
+
+void ParallelAbsolutePoseRansac::refineModel(
+    double threshold, const ThreadState& state, Eigen::Matrix<double, 3, 4>* model) const {
+  CHECK_NOTNULL(model);
+  // The rotation is perturbed on the right, R_G_B * exp(delta_theta), the position additively.
+  Eigen::Matrix3d R_G_B = model->leftCols<3>();
+  Eigen::Vector3d p_G_B = model->col(3);
+  for (int step = 0; step < kNumRefinementSteps; ++step) {
+    const Eigen::Matrix3d R_B_G = R_G_B.transpose();
+    Eigen::Matrix<double, 6, 6> hessian = Eigen::Matrix<double, 6, 6>::Zero();
+    Eigen::Matrix<double, 6, 1> gradient = Eigen::Matrix<double, 6, 1>::Zero();
+    for (int i = 0; i < state.distances.rows(); ++i) {
+      if (!(state.distances(i) < threshold)) {
+        continue;
+      }
+      const Eigen::Vector3d point_B = R_B_G * (points_G_.col(i) - p_G_B);
+      const Eigen::Vector3d ray_B = point_B - camera_offsets_B_.col(i);
+      const double ray_norm = ray_B.norm();
+      if (ray_norm <= std::numeric_limits<double>::epsilon()) {
+        continue;
+      }
+      const Eigen::Vector3d direction_B = ray_B / ray_norm;
+      // Residual of the normalized ray, its squared norm is twice the 1 - cos distance.
+      const Eigen::Matrix3d d_direction_d_ray =
+          (Eigen::Matrix3d::Identity() - direction_B * direction_B.transpose()) / ray_norm;
+      Eigen::Matrix<double, 3, 6> jacobian;
+      jacobian.leftCols<3>() = d_direction_d_ray * skew(point_B);
+      jacobian.rightCols<3>() = -d_direction_d_ray * R_B_G;
+      hessian.noalias() += jacobian.transpose() * jacobian;
+      gradient.noalias() += jacobian.transpose() * (direction_B - bearing_vectors_B_.col(i));
+    }
+    const Eigen::Matrix<double, 6, 1> delta = -hessian.ldlt().solve(gradient);
+    if (!delta.allFinite()) {
+      return;
+    }
+    const double angle = delta.head<3>().norm();
+    if (angle > 0.0) {
+      R_G_B = R_G_B * Eigen::AngleAxisd(angle, delta.head<3>() / angle).toRotationMatrix();
+    }
+    p_G_B += delta.tail<3>();
+    if (delta.norm() < kRefinementConvergenceThreshold) {
+      break;
+    }
+  }
+  model->leftCols<3>() = R_G_B;
+  model->col(3) = p_G_B;
+}
+
+void ParallelAbsolutePoseRansac::optimizeLocally(
+    double threshold, Eigen::Matrix<double, 3, 4>* model, int* num_inliers,
+    ThreadState* state) const {
+  CHECK_NOTNULL(model);
+  CHECK_NOTNULL(num_inliers);
+  CHECK_NOTNULL(state);
+  Eigen::Matrix<double, 3, 4> refined_model = *model;
+  computeDistances(refined_model, state);
+  int num_refined_inliers = static_cast<int>((state->distances < threshold).count());
+  for (int iteration = 0; iteration < kMaxNumLocalOptimizationIterations; ++iteration) {
+    Eigen::Matrix<double, 3, 4> candidate_model = refined_model;
+    refineModel(threshold, *state, &candidate_model);
+    computeDistances(candidate_model, state);
+    const int num_candidate_inliers = static_cast<int>((state->distances < threshold).count());
+    if (num_candidate_inliers < num_refined_inliers) {
+      break;
+    }
+    const bool inliers_grew = num_candidate_inliers > num_refined_inliers;
+    refined_model = candidate_model;
+    num_refined_inliers = num_candidate_inliers;
+    if (!inliers_grew) {
+      break;
+    }
+  }
+  if (num_refined_inliers >= *num_inliers) {
+    *model = refined_model;
+    *num_inliers = num_refined_inliers;
+  }
+}
+
+double ParallelAbsolutePoseRansac::getRequiredIterations(double inlier_ratio) const {
+  const double probability_good_sample = std::pow(inlier_ratio, kSampleSize);
+  if (probability_good_sample >= 1.0) {
+    return 1.0;
+  }
+  if (probability_good_sample <= std::numeric_limits<double>::epsilon()) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return std::log(1.0 - probability_) / std::log(1.0 - probability_good_sample);
+}
+
+bool ParallelAbsolutePoseRansac::computeModel(
+    const opengv::absolute_pose::AbsoluteAdapterBase& adapter, Algorithm algorithm,
+    double threshold, int max_iterations, Eigen::Matrix<double, 3, 4>* model,
+    std::vector<int>* inliers, std::vector<double>* inlier_distances_to_model,
+    int* num_iterations) {
+  return computeModelImpl(adapter, nullptr, algorithm, threshold, max_iterations, model,
+                          inliers, inlier_distances_to_model, num_iterations);
+}
+
+bool ParallelAbsolutePoseRansac::computeModel(
+    const opengv::absolute_pose::AbsoluteAdapterBase& adapter,
+    const std::vector<double>& correspondence_scores, Algorithm algorithm, double threshold,
+    int max_iterations, Eigen::Matrix<double, 3, 4>* model, std::vector<int>* inliers,
+    std::vector<double>* inlier_distances_to_model, int* num_iterations) {
+  CHECK_EQ(correspondence_scores.size(), adapter.getNumberCorrespondences());
+  return computeModelImpl(adapter, &correspondence_scores, algorithm, threshold,
+                          max_iterations, model, inliers, inlier_distances_to_model,
+                          num_iterations);
+}
+
+bool ParallelAbsolutePoseRansac::computeModelImpl(
+    const opengv::absolute_pose::AbsoluteAdapterBase& adapter,
+    const std::vector<double>* correspondence_scores, Algorithm algorithm, double threshold,
+    int max_iterations, Eigen::Matrix<double, 3, 4>* model, std::vector<int>* inliers,
+    std::vector<double>* inlier_distances_to_model, int* num_iterations) {
+  CHECK_NOTNULL(model);
+  CHECK_NOTNULL(inliers)->clear();
+  CHECK_NOTNULL(inlier_distances_to_model)->clear();
+  CHECK_NOTNULL(num_iterations);
+  *num_iterations = 0;
+  const int num_correspondences = static_cast<int>(adapter.getNumberCorrespondences());
+  if (num_correspondences < kSampleSize || max_iterations <= 0) {
+    return false;
+  }
+  setCorrespondences(adapter);
+
+  // Every thread has its own RNG, seeded from the base seed and the thread index. The PROSAC
+  // samples are drawn on this thread from the RNG of the first thread.
+  const unsigned int base_seed = random_seed_ ?
+      std::random_device()() : static_cast<unsigned int>(FLAGS_acv_ransac_fixed_seed);
+  thread_states_.resize(num_threads_);
+  for (size_t thread_idx = 0u; thread_idx < num_threads_; ++thread_idx) {
+    std::seed_seq seed_sequence{base_seed, static_cast<unsigned int>(thread_idx)};
+    thread_states_[thread_idx].rng.seed(seed_sequence);
+  }
+  if (num_threads_ > 1u && !thread_pool_) {
+    thread_pool_.reset(new ThreadPool(num_threads_));
+  }
+  std::unique_ptr<ProsacSampler> prosac_sampler;
+  if (correspondence_scores != nullptr) {
+    prosac_sampler.reset(
+        new ProsacSampler(*correspondence_scores, kSampleSize, max_iterations));
+  }
+
+  // Read once as the rounds run on this thread.
+  const common::Deadline& deadline = common::DeadlineScope::getCurrentDeadline();
+  int best_num_inliers = -1;
+  int num_local_optimizations = 0;
+  double required_iterations = std::numeric_limits<double>::infinity();
+  std::vector<std::future<void>> round_futures;
+  while (*num_iterations < max_iterations && *num_iterations < required_iterations) {
+    const double iteration_limit = std::min<double>(max_iterations, std::ceil(required_iterations));
+    const int remaining_iterations = static_cast<int>(iteration_limit) - *num_iterations;
+    const int num_round_hypotheses = std::min(
+        remaining_iterations, static_cast<int>(num_threads_) * kNumHypothesesPerThreadAndRound);
+    if (prosac_sampler) {
+      round_samples_.clear();
+      for (int hypothesis = 0; hypothesis < num_round_hypotheses; ++hypothesis) {
+        prosac_sampler->drawSample(&thread_states_.front().rng, &sample_buffer_);
+        round_samples_.insert(round_samples_.end(), sample_buffer_.begin(), sample_buffer_.end());
+      }
+    }
+
+    round_futures.clear();
+    for (size_t thread_idx = 0u; thread_idx < num_threads_; ++thread_idx) {
+      const int first_hypothesis = static_cast<int>(thread_idx) * kNumHypothesesPerThreadAndRound;
+      const int num_hypotheses = std::max(0, std::min(kNumHypothesesPerThreadAndRound,
+          num_round_hypotheses - first_hypothesis));
+      ThreadState* state = &thread_states_[thread_idx];
+      state->best_num_inliers = -1;
+      if (num_hypotheses == 0) {
+        continue;
+      }
+      const int* samples =
+          prosac_sampler ? round_samples_.data() + first_hypothesis * kSampleSize : nullptr;
+      if (num_threads_ == 1u) {
+        runHypotheses(adapter, algorithm, threshold, num_hypotheses, samples, state);
+      } else {
+        round_futures.emplace_back(thread_pool_->enqueue(
+            [this, &adapter, algorithm, threshold, num_hypotheses, samples, state]() {
+          runHypotheses(adapter, algorithm, threshold, num_hypotheses, samples, state);
+        }));
+      }
+    }
+    for (std::future<void>& round_future : round_futures) {
+      CHECK(round_future.valid());
+      round_future.get();
+    }
+    *num_iterations += num_round_hypotheses;
+
+    // Merge in thread order, such that ties are resolved independently of the timing.
+    const int previous_best_num_inliers = best_num_inliers;
+    for (const ThreadState& state : thread_states_) {
+      if (state.best_num_inliers > best_num_inliers) {
+        best_num_inliers = state.best_num_inliers;
+        *model = state.best_model;
+      }
+    }
+    if (best_num_inliers <= 0) {
+      continue;
+    }
+    if (best_num_inliers > previous_best_num_inliers && best_num_inliers >= kSampleSize &&
+        num_local_optimizations < max_num_local_optimizations_) {
+      optimizeLocally(threshold, model, &best_num_inliers, &thread_states_.front());
+      ++num_local_optimizations;
+    }
+    required_iterations = getRequiredIterations(
+        static_cast<double>(best_num_inliers) / static_cast<double>(num_correspondences));
+    if (prosac_sampler && prosac_sampler->getSamplingSetSize() >= kMinProsacSamplingSetSize) {
+      // All samples so far were drawn from the current sampling set, hence its inlier ratio
+      // bounds the iterations as well.
+      ThreadState& state = thread_states_.front();
+      computeDistances(*model, &state);
+      const int sampling_set_size = prosac_sampler->getSamplingSetSize();
+      const std::vector<int>& sorted_indices = prosac_sampler->getSortedIndices();
+      int num_sampling_set_inliers = 0;
+      for (int i = 0; i < sampling_set_size; ++i) {
+        num_sampling_set_inliers += state.distances(sorted_indices[i]) < threshold ? 1 : 0;
+      }
+      required_iterations = std::min(required_iterations, getRequiredIterations(
+          static_cast<double>(num_sampling_set_inliers) /
+              static_cast<double>(sampling_set_size)));
+    }
+    if (*num_iterations < max_iterations && *num_iterations < required_iterations &&
+        deadline.hasExpired()) {
+      // The best model so far is returned.
+      common::DeadlineScope::addDegradation(common::Degradation::kCutRansacIterations);
+      break;
+    }
+  }
+
+  if (best_num_inliers < 0) {
+    return false;
+  }
+  ThreadState& state = thread_states_.front();
+  computeDistances(*model, &state);
+  inliers->reserve(best_num_inliers);
+  inlier_distances_to_model->reserve(best_num_inliers);
+  for (int i = 0; i < state.distances.rows(); ++i) {
+    if (state.distances(i) < threshold) {
+      inliers->push_back(i);
+      inlier_distances_to_model->push_back(state.distances(i));
+    }
+  }
+  VLOG(5) << "Parallel RANSAC: " << inliers->size() << " inliers out of "
+      << points_G_.cols() << " after " << *num_iterations << " iterations.";
+  return true;
+}
+
+}  // namespace geometric_vision
+}  // namespace aslam
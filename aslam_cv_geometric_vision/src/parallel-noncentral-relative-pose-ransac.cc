@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+
+#include <Eigen/Dense>
+#include <glog/logging.h>
+#include <opengv/relative_pose/methods.hpp>
+
+#include "aslam/geometric-vision/parallel-noncentral-relative-pose-ransac.h"
+
+namespace aslam {
+namespace geometric_vision {
+namespace {
+// Hypotheses per thread between two updates of the stopping criterion, see
+// ParallelAbsolutePoseRansac.
+constexpr int kNumHypothesesPerThreadAndRound = 16;
+// Seed of the RNGs if no random seed is requested.
+constexpr unsigned int kFixedSeed = 42u;
+// Below this value of 1 - cos^2 of the angle between the two rays of a correspondence, the
+// rays are considered parallel.
+constexpr double kMinParallaxDeterminant = 1e-12;
+}  // namespace
+
+ParallelNoncentralRelativePoseRansac::ParallelNoncentralRelativePoseRansac(
+    size_t num_threads, bool random_seed)
+    : num_threads_(num_threads),
+      random_seed_(random_seed),
+      probability_(0.99),
+      min_cos_rotation_deviation_from_prior_(-std::numeric_limits<double>::infinity()),
+      R_12_prior_(Eigen::Matrix3d::Identity()) {
+  CHECK_GT(num_threads_, 0u);
+}
+
+ParallelNoncentralRelativePoseRansac::~ParallelNoncentralRelativePoseRansac() {}
+
+void ParallelNoncentralRelativePoseRansac::setProbability(double probability) {
+  CHECK_GT(probability, 0.0);
+  CHECK_LT(probability, 1.0);
+  probability_ = probability;
+}
+
+void ParallelNoncentralRelativePoseRansac::setMaxRotationDeviationFromPrior(
+    double max_angle_rad) {
+  CHECK_GE(max_angle_rad, 0.0);
+  min_cos_rotation_deviation_from_prior_ = std::cos(std::min(max_angle_rad, M_PI));
+}
+
+int ParallelNoncentralRelativePoseRansac::getSampleSize(Algorithm algorithm) {
+  switch (algorithm) {
+    case Algorithm::kGivenRotation:
+      return 3;
+    case Algorithm::kSixPoint:
+      return 7;
+    case Algorithm::kSeventeenPoint:
+      return 17;
+  }
+  LOG(FATAL) << "Unknown algorithm.";
+  return 0;
+}
+
+void ParallelNoncentralRelativePoseRansac::setCorrespondences(
+    const opengv::relative_pose::RelativeAdapterBase& adapter) {
+  const size_t num_correspondences = adapter.getNumberCorrespondences();
+  bearing_vectors_1_.resize(Eigen::NoChange, num_correspondences);
+  camera_offsets_1_.resize(Eigen::NoChange, num_correspondences);
+  bearing_vectors_2_.resize(Eigen::NoChange, num_correspondences);
+  camera_offsets_2_.resize(Eigen::NoChange, num_correspondences);
+  for (size_t i = 0u; i < num_correspondences; ++i) {
+    bearing_vectors_1_.col(i) =
+        (adapter.getCamRotation1(i) * adapter.getBearingVector1(i)).normalized();
+    camera_offsets_1_.col(i) = adapter.getCamOffset1(i);
+    bearing_vectors_2_.col(i) =
+        (adapter.getCamRotation2(i) * adapter.getBearingVector2(i)).normalized();
+    camera_offsets_2_.col(i) = adapter.getCamOffset2(i);
+  }
+  R_12_prior_ = adapter.getR12();
+}
+
+bool ParallelNoncentralRelativePoseRansac::solveTranslation(
+    const Eigen::Matrix3d& R_12, const std::vector<int>& indices, Eigen::Vector3d* t_12) const {
+  CHECK_NOTNULL(t_12);
+  // The rays c_1 + l * f_1 and R_12 * c_2 + t_12 + m * R_12 * f_2 intersect if
+  // (f_1 x R_12 * f_2)^T * t_12 = (f_1 x R_12 * f_2)^T * (c_1 - R_12 * c_2).
+  Eigen::MatrixX3d A(indices.size(), 3);
+  Eigen::VectorXd b(indices.size());
+  for (size_t row = 0u; row < indices.size(); ++row) {
+    const int index = indices[row];
+    const Eigen::Vector3d normal =
+        bearing_vectors_1_.col(index).cross(R_12 * bearing_vectors_2_.col(index));
+    A.row(row) = normal.transpose();
+    b(row) = normal.dot(camera_offsets_1_.col(index) - R_12 * camera_offsets_2_.col(index));
+  }
+  const Eigen::ColPivHouseholderQR<Eigen::MatrixX3d> qr(A);
+  if (qr.rank() < 3) {
+    return false;
+  }
+  *t_12 = qr.solve(b);
+  return true;
+}
+
+void ParallelNoncentralRelativePoseRansac::computeDistances(
+    const Eigen::Matrix<double, 3, 4>& model, ThreadState* state) const {
+  CHECK_NOTNULL(state);
+  const Eigen::Matrix3d R_12 = model.leftCols<3>();
+  // Both rays of every correspondence in viewpoint 1.
+  state->rays_2_in_1.noalias() = R_12 * bearing_vectors_2_;
+  state->origins_2_in_1.noalias() = R_12 * camera_offsets_2_;
+  state->origins_2_in_1.colwise() += model.col(3);
+  const Eigen::Matrix3Xd& f_1 = bearing_vectors_1_;
+  const Eigen::Matrix3Xd& f_2 = state->rays_2_in_1;
+
+  // Midpoint of the closest points of the rays.
+  state->points_1 = camera_offsets_1_ - state->origins_2_in_1;
+  const Eigen::ArrayXd cos_12 = f_1.cwiseProduct(f_2).colwise().sum().array().transpose();
+  const Eigen::ArrayXd w_1 =
+      f_1.cwiseProduct(state->points_1).colwise().sum().array().transpose();
+  const Eigen::ArrayXd w_2 =
+      f_2.cwiseProduct(state->points_1).colwise().sum().array().transpose();
+  const Eigen::ArrayXd determinant = 1.0 - cos_12.square();
+  const Eigen::ArrayXd lambda_1 = (cos_12 * w_2 - w_1) / determinant;
+  const Eigen::ArrayXd lambda_2 = (w_2 - cos_12 * w_1) / determinant;
+  state->points_1 = 0.5 * (camera_offsets_1_ + state->origins_2_in_1 +
+      (f_1.array().rowwise() * lambda_1.transpose()).matrix() +
+      (f_2.array().rowwise() * lambda_2.transpose()).matrix());
+
+  // Reuse the ray buffers for the rays from the camera centers to the points.
+  const Eigen::ArrayXd cos_1 =
+      f_1.cwiseProduct(state->points_1 - camera_offsets_1_).colwise().sum().array().transpose() /
+      (state->points_1 - camera_offsets_1_).colwise().norm().array().transpose();
+  state->origins_2_in_1 = state->points_1 - state->origins_2_in_1;
+  const Eigen::ArrayXd cos_2 =
+      f_2.cwiseProduct(state->origins_2_in_1).colwise().sum().array().transpose() /
+      state->origins_2_in_1.colwise().norm().array().transpose();
+  state->distances = (determinant < kMinParallaxDeterminant).select(
+      1.0 - cos_12, 2.0 - cos_1 - cos_2);
+}
+
+void ParallelNoncentralRelativePoseRansac::runHypotheses(
+    const opengv::relative_pose::RelativeAdapterBase& adapter, Algorithm algorithm,
+    double threshold, int num_hypotheses, ThreadState* state) const {
+  CHECK_NOTNULL(state);
+  const int num_correspondences = static_cast<int>(bearing_vectors_1_.cols());
+  const int sample_size = getSampleSize(algorithm);
+  std::uniform_int_distribution<int> index_distribution(0, num_correspondences - 1);
+  std::vector<int>& sample = state->sample;
+  state->best_num_inliers = -1;
+  const double min_trace_rotation_deviation =
+      2.0 * min_cos_rotation_deviation_from_prior_ + 1.0;
+  auto is_rotation_close_to_prior = [&](const Eigen::Matrix3d& R_12) {
+    return (R_12_prior_.transpose() * R_12).trace() >= min_trace_rotation_deviation;
+  };
+
+  Eigen::Matrix<double, 3, 4> hypothesis;
+  for (int hypothesis_idx = 0; hypothesis_idx < num_hypotheses; ++hypothesis_idx) {
+    // Draw sample_size distinct correspondences.
+    sample.clear();
+    while (static_cast<int>(sample.size()) < sample_size) {
+      const int index = index_distribution(state->rng);
+      if (std::find(sample.begin(), sample.end(), index) == sample.end()) {
+        sample.push_back(index);
+      }
+    }
+
+    bool has_hypothesis = false;
+    switch (algorithm) {
+      case Algorithm::kGivenRotation: {
+        Eigen::Vector3d t_12;
+        if (solveTranslation(R_12_prior_, sample, &t_12)) {
+          hypothesis << R_12_prior_, t_12;
+          has_hypothesis = true;
+        }
+        break;
+      }
+      case Algorithm::kSixPoint: {
+        // Keep the rotation whose translation best explains the seventh correspondence.
+        const int disambiguation_index = sample.back();
+        sample.pop_back();
+        const opengv::rotations_t rotations = opengv::relative_pose::sixpt(adapter, sample);
+        double best_distance = std::numeric_limits<double>::infinity();
+        Eigen::Matrix<double, 3, 4> candidate;
+        for (const opengv::rotation_t& R_12 : rotations) {
+          Eigen::Vector3d t_12;
+          if (!is_rotation_close_to_prior(R_12) || !solveTranslation(R_12, sample, &t_12)) {
+            continue;
+          }
+          // Residual of the generalized epipolar constraint of the seventh correspondence.
+          const Eigen::Vector3d normal = bearing_vectors_1_.col(disambiguation_index).cross(
+              R_12 * bearing_vectors_2_.col(disambiguation_index));
+          const double distance = std::abs(normal.dot(
+              camera_offsets_1_.col(disambiguation_index) -
+              R_12 * camera_offsets_2_.col(disambiguation_index) - t_12));
+          if (distance < best_distance) {
+            best_distance = distance;
+            candidate << R_12, t_12;
+          }
+        }
+        if (best_distance < std::numeric_limits<double>::infinity()) {
+          hypothesis = candidate;
+          has_hypothesis = true;
+        }
+        break;
+      }
+      case Algorithm::kSeventeenPoint: {
+        hypothesis = opengv::relative_pose::seventeenpt(adapter, sample);
+        has_hypothesis = hypothesis.allFinite() &&
+            is_rotation_close_to_prior(hypothesis.leftCols<3>());
+        break;
+      }
+    }
+    if (!has_hypothesis) {
+      continue;
+    }
+
+    computeDistances(hypothesis, state);
+    const int num_inliers = static_cast<int>((state->distances < threshold).count());
+    if (num_inliers > state->best_num_inliers) {
+      state->best_num_inliers = num_inliers;
+      state->best_model = hypothesis;
+    }
+  }
+}
+
+double ParallelNoncentralRelativePoseRansac::getRequiredIterations(
+    double inlier_ratio, int sample_size) const {
+  const double probability_good_sample = std::pow(inlier_ratio, sample_size);
+  if (probability_good_sample >= 1.0) {
+    return 1.0;
+  }
+  if (probability_good_sample <= std::numeric_limits<double>::epsilon()) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return std::log(1.0 - probability_) / std::log(1.0 - probability_good_sample);
+}
+
+bool ParallelNoncentralRelativePoseRansac::computeModel(
+    const opengv::relative_pose::RelativeAdapterBase& adapter, Algorithm algorithm,
+    double threshold, int max_iterations, Eigen::Matrix<double, 3, 4>* model,
+    std::vector<int>* inliers, int* num_iterations) {
+  CHECK_NOTNULL(model);
+  CHECK_NOTNULL(inliers)->clear();
+  CHECK_NOTNULL(num_iterations);
+  *num_iterations = 0;
+  const int sample_size = getSampleSize(algorithm);
+  const int num_correspondences = static_cast<int>(adapter.getNumberCorrespondences());
+  if (num_correspondences < sample_size || max_iterations <= 0) {
+    return false;
+  }
+  setCorrespondences(adapter);
+
+  // Every thread has its own RNG, seeded from the base seed and the thread index.
+  const unsigned int base_seed = random_seed_ ? std::random_device()() : kFixedSeed;
+  thread_states_.resize(num_threads_);
+  for (size_t thread_idx = 0u; thread_idx < num_threads_; ++thread_idx) {
+    std::seed_seq seed_sequence{base_seed, static_cast<unsigned int>(thread_idx)};
+    thread_states_[thread_idx].rng.seed(seed_sequence);
+  }
+  if (num_threads_ > 1u && !thread_pool_) {
+    thread_pool_.reset(new ThreadPool(num_threads_));
+  }
+
+  int best_num_inliers = -1;
+  double required_iterations = std::numeric_limits<double>::infinity();
+  std::vector<std::future<void>> round_futures;
+  while (*num_iterations < max_iterations && *num_iterations < required_iterations) {
+    const double iteration_limit = std::min<double>(max_iterations, std::ceil(required_iterations));
+    const int remaining_iterations = static_cast<int>(iteration_limit) - *num_iterations;
+    const int num_round_hypotheses = std::min(
+        remaining_iterations, static_cast<int>(num_threads_) * kNumHypothesesPerThreadAndRound);
+
+    round_futures.clear();
+    for (size_t thread_idx = 0u; thread_idx < num_threads_; ++thread_idx) {
+      const int first_hypothesis = static_cast<int>(thread_idx) * kNumHypothesesPerThreadAndRound;
+      const int num_hypotheses = std::max(0, std::min(kNumHypothesesPerThreadAndRound,
+          num_round_hypotheses - first_hypothesis));
+      ThreadState* state = &thread_states_[thread_idx];
+      state->best_num_inliers = -1;
+      if (num_hypotheses == 0) {
+        continue;
+      }
+      if (num_threads_ == 1u) {
+        runHypotheses(adapter, algorithm, threshold, num_hypotheses, state);
+      } else {
+        round_futures.emplace_back(thread_pool_->enqueue(
+            [this, &adapter, algorithm, threshold, num_hypotheses, state]() {
+          runHypotheses(adapter, algorithm, threshold, num_hypotheses, state);
+        }));
+      }
+    }
+    for (std::future<void>& round_future : round_futures) {
+      CHECK(round_future.valid());
+      round_future.get();
+    }
+    *num_iterations += num_round_hypotheses;
+
+    // Merge in thread order, such that ties are resolved independently of the timing.
+    for (const ThreadState& state : thread_states_) {
+      if (state.best_num_inliers > best_num_inliers) {
+        best_num_inliers = state.best_num_inliers;
+        *model = state.best_model;
+      }
+    }
+    if (best_num_inliers > 0) {
+      required_iterations = getRequiredIterations(
+          static_cast<double>(best_num_inliers) / static_cast<double>(num_correspondences),
+          sample_size);
+    }
+  }
+
+  if (best_num_inliers < 0) {
+    return false;
+  }
+  ThreadState& state = thread_states_.front();
+  computeDistances(*model, &state);
+  inliers->reserve(best_num_inliers);
+  for (int i = 0; i < state.distances.rows(); ++i) {
+    if (state.distances(i) < threshold) {
+      inliers->push_back(i);
+    }
+  }
+  VLOG(5) << "Parallel non-central relative pose RANSAC: " << inliers->size()
+      << " inliers out of " << num_correspondences << " after " << *num_iterations
+      << " iterations.";
+  return true;
+}
+
+}  // namespace geometric_vision
+}  // namespace aslam
@@ -3,12 +3,10 @@
 #include <aslam/cameras/camera-pinhole.h>
 #include <aslam/cameras/camera-unified-projection.h>
 #include <aslam/common/memory.h>
-#include <opengv/absolute_pose/CentralAbsoluteAdapter.hpp>
 #include <opengv/absolute_pose/methods.hpp>
-#include <opengv/absolute_pose/NoncentralAbsoluteAdapter.hpp>
-#include <opengv/sac/Ransac.hpp>
 #include <opengv/sac_problems/absolute_pose/AbsolutePoseSacProblem.hpp>
 
+#include "aslam/geometric-vision/opengv-eigen-adapters.h"
 #include "aslam/geometric-vision/pnp-pose-estimator.h"
 
 namespace aslam {
@@ -138,39 +136,75 @@ bool PnpPoseEstimator::absolutePoseRansac(
   CHECK_NOTNULL(num_iters);
   CHECK_EQ(measurements.cols(), G_landmark_positions.cols());
 
-  opengv::points_t points;
-  opengv::bearingVectors_t bearing_vectors;
-  points.resize(measurements.cols());
-  bearing_vectors.resize(measurements.cols());
-  for (int i = 0; i < measurements.cols(); ++i) {
-    camera_ptr->backProject3(measurements.col(i), &bearing_vectors[i]);
-    bearing_vectors[i].normalize();
-    points[i] = G_landmark_positions.col(i);
-  }
+  backProjectMeasurements(measurements, *camera_ptr);
+  EigenCentralAbsoluteAdapter adapter(bearing_vectors_, nullptr, G_landmark_positions, nullptr);
+  return absolutePoseRansac(adapter, nullptr, ransac_threshold, max_ransac_iters, T_G_C,
+                            inliers, num_iters);
+}
+
+bool PnpPoseEstimator::absolutePoseRansac(
+    const Eigen::Matrix2Xd& measurements,
+    const Eigen::Matrix3Xd& G_landmark_positions,
+    const std::vector<double>& correspondence_scores, double ransac_threshold,
+    int max_ransac_iters, aslam::Camera::ConstPtr camera_ptr,
+    aslam::Transformation* T_G_C, std::vector<int>* inliers, int* num_iters) {
+  CHECK_NOTNULL(T_G_C);
+  CHECK_NOTNULL(inliers);
+  CHECK_NOTNULL(num_iters);
+  CHECK_EQ(measurements.cols(), G_landmark_positions.cols());
+  CHECK_EQ(measurements.cols(), static_cast<int>(correspondence_scores.size()));
+
+  backProjectMeasurements(measurements, *camera_ptr);
+  EigenCentralAbsoluteAdapter adapter(bearing_vectors_, nullptr, G_landmark_positions, nullptr);
+  return absolutePoseRansac(adapter, &correspondence_scores, ransac_threshold,
+                            max_ransac_iters, T_G_C, inliers, num_iters);
+}
+
+bool PnpPoseEstimator::absolutePoseRansac(
+    const aslam::VisualFrame& frame, const std::vector<size_t>& keypoint_indices,
+    const Eigen::Matrix3Xd& G_landmark_positions, double ransac_threshold,
+    int max_ransac_iters, aslam::Transformation* T_G_C, std::vector<int>* inliers,
+    int* num_iters) {
+  CHECK_NOTNULL(T_G_C);
+  CHECK_NOTNULL(inliers);
+  CHECK_NOTNULL(num_iters);
+  CHECK_EQ(static_cast<int>(keypoint_indices.size()), G_landmark_positions.cols());
+
+  // The cached bearing vectors of the frame are read in place.
+  EigenCentralAbsoluteAdapter adapter(frame.getNormalizedBearingVectors(), &keypoint_indices,
+                                      G_landmark_positions, nullptr);
+  return absolutePoseRansac(adapter, nullptr, ransac_threshold, max_ransac_iters, T_G_C,
+                            inliers, num_iters);
+}
+
+void PnpPoseEstimator::backProjectMeasurements(const Eigen::Matrix2Xd& measurements,
+                                               const aslam::Camera& camera) {
+  // The buffers keep their memory across calls with the same number of measurements.
+  camera.backProject3Vectorized(measurements, &bearing_vectors_, &backprojection_success_);
+  bearing_vectors_.colwise().normalize();
+}
 
-  opengv::absolute_pose::CentralAbsoluteAdapter adapter(bearing_vectors,
-                                                        points);
-  opengv::sac::Ransac<
-      opengv::sac_problems::absolute_pose::AbsolutePoseSacProblem> ransac;
-  std::shared_ptr<opengv::sac_problems::absolute_pose::AbsolutePoseSacProblem>
-      absposeproblem_ptr(
-          new opengv::sac_problems::absolute_pose::AbsolutePoseSacProblem(
-              adapter, opengv::sac_problems::absolute_pose::
-                           AbsolutePoseSacProblem::KNEIP,
-              random_seed_));
-  ransac.sac_model_ = absposeproblem_ptr;
-  ransac.threshold_ = ransac_threshold;
-  ransac.max_iterations_ = max_ransac_iters;
-  bool ransac_success = ransac.computeModel();
+bool PnpPoseEstimator::absolutePoseRansac(
+    const opengv::absolute_pose::AbsoluteAdapterBase& adapter,
+    const std::vector<double>* correspondence_scores, double ransac_threshold,
+    int max_ransac_iters, aslam::Transformation* T_G_C, std::vector<int>* inliers,
+    int* num_iters) {
+  Eigen::Matrix<double, 3, 4> model;
+  std::vector<double> inlier_distances_to_model;
+  const ParallelAbsolutePoseRansac::Algorithm kAlgorithm =
+      ParallelAbsolutePoseRansac::Algorithm::kKneip;
+  const bool ransac_success = (correspondence_scores == nullptr) ?
+      ransac_.computeModel(adapter, kAlgorithm, ransac_threshold, max_ransac_iters, &model,
+                           inliers, &inlier_distances_to_model, num_iters) :
+      ransac_.computeModel(adapter, *correspondence_scores, kAlgorithm, ransac_threshold,
+                           max_ransac_iters, &model, inliers, &inlier_distances_to_model,
+                           num_iters);
 
   if (ransac_success) {
-    T_G_C->getPosition() = ransac.model_coefficients_.rightCols(1);
-    Eigen::Matrix<double, 3, 3> R_G_C(ransac.model_coefficients_.leftCols(3));
+    T_G_C->getPosition() = model.rightCols(1);
+    Eigen::Matrix<double, 3, 3> R_G_C(model.leftCols(3));
     T_G_C->getRotation() = aslam::Quaternion(R_G_C);
   }
-
-  *inliers = ransac.inliers_;
-  *num_iters = ransac.iterations_;
   return ransac_success;
 }
 
@@ -193,6 +227,35 @@ bool PnpPoseEstimator::absoluteMultiPoseRansac(
     int max_ransac_iters, aslam::NCamera::ConstPtr ncamera_ptr,
     aslam::Transformation* T_G_I, std::vector<int>* inliers,
     std::vector<double>* inlier_distances_to_model, int* num_iters) {
+  return absoluteMultiPoseRansac(
+      measurements, measurement_camera_indices, G_landmark_positions, nullptr,
+      ransac_threshold, max_ransac_iters, ncamera_ptr, T_G_I, inliers,
+      inlier_distances_to_model, num_iters);
+}
+
+bool PnpPoseEstimator::absoluteMultiPoseRansac(
+    const Eigen::Matrix2Xd& measurements,
+    const std::vector<int>& measurement_camera_indices,
+    const Eigen::Matrix3Xd& G_landmark_positions,
+    const std::vector<double>& correspondence_scores, double ransac_threshold,
+    int max_ransac_iters, aslam::NCamera::ConstPtr ncamera_ptr,
+    aslam::Transformation* T_G_I, std::vector<int>* inliers,
+    std::vector<double>* inlier_distances_to_model, int* num_iters) {
+  CHECK_EQ(measurements.cols(), static_cast<int>(correspondence_scores.size()));
+  return absoluteMultiPoseRansac(
+      measurements, measurement_camera_indices, G_landmark_positions,
+      &correspondence_scores, ransac_threshold, max_ransac_iters, ncamera_ptr, T_G_I,
+      inliers, inlier_distances_to_model, num_iters);
+}
+
+bool PnpPoseEstimator::absoluteMultiPoseRansac(
+    const Eigen::Matrix2Xd& measurements,
+    const std::vector<int>& measurement_camera_indices,
+    const Eigen::Matrix3Xd& G_landmark_positions,
+    const std::vector<double>* correspondence_scores, double ransac_threshold,
+    int max_ransac_iters, aslam::NCamera::ConstPtr ncamera_ptr,
+    aslam::Transformation* T_G_I, std::vector<int>* inliers,
+    std::vector<double>* inlier_distances_to_model, int* num_iters) {
   CHECK_NOTNULL(T_G_I);
   CHECK_NOTNULL(inliers);
   CHECK_NOTNULL(inlier_distances_to_model);
@@ -218,46 +281,42 @@ bool PnpPoseEstimator::absoluteMultiPoseRansac(
     cam_translations[camera_index] = T_B_C.getPosition();
   }
 
-  opengv::points_t points;
-  opengv::bearingVectors_t bearing_vectors;
-  points.resize(measurements.cols());
-  bearing_vectors.resize(measurements.cols());
+  bearing_vectors_.resize(Eigen::NoChange, measurements.cols());
+  Eigen::Vector3d bearing_vector;
   for (int i = 0; i < measurements.cols(); ++i) {
     // Figure out which camera this corresponds to, and reproject it in the
     // correct camera.
     int camera_index = measurement_camera_indices[i];
     ncamera_ptr->getCamera(camera_index)
-        .backProject3(measurements.col(i), &bearing_vectors[i]);
-    bearing_vectors[i].normalize();
-    points[i] = G_landmark_positions.col(i);
+        .backProject3(measurements.col(i), &bearing_vector);
+    bearing_vectors_.col(i) = bearing_vector.normalized();
   }
   // Basically same as the Central, except measurement_camera_indices, which
   // assigns a camera index to each bearing_vector, and cam_offsets and
   // cam_rotations, which describe the position and orientation of the cameras
-  // with respect to the body frame.
-  opengv::absolute_pose::NoncentralAbsoluteAdapter adapter(
-      bearing_vectors, measurement_camera_indices, points, cam_translations,
-      cam_rotations);
-  opengv::sac::Ransac<
-      opengv::sac_problems::absolute_pose::AbsolutePoseSacProblem> ransac;
-  std::shared_ptr<opengv::sac_problems::absolute_pose::AbsolutePoseSacProblem>
-      absposeproblem_ptr(
-          new opengv::sac_problems::absolute_pose::AbsolutePoseSacProblem(adapter,
-              opengv::sac_problems::absolute_pose::AbsolutePoseSacProblem::GP3P,
-              random_seed_));
-  ransac.sac_model_ = absposeproblem_ptr;
-  ransac.threshold_ = ransac_threshold;
-  ransac.max_iterations_ = max_ransac_iters;
-  bool ransac_success = ransac.computeModel();
-  CHECK_EQ(ransac.inliers_.size(), ransac.inlier_distances_to_model_.size());
+  // with respect to the body frame. The landmark positions are read in place.
+  EigenNoncentralAbsoluteAdapter adapter(
+      bearing_vectors_, measurement_camera_indices, G_landmark_positions,
+      cam_translations, cam_rotations);
+  Eigen::Matrix<double, 3, 4> model;
+  const ParallelAbsolutePoseRansac::Algorithm kAlgorithm =
+      ParallelAbsolutePoseRansac::Algorithm::kGp3p;
+  const bool ransac_success = (correspondence_scores == nullptr) ?
+      ransac_.computeModel(adapter, kAlgorithm, ransac_threshold, max_ransac_iters, &model,
+                           inliers, inlier_distances_to_model, num_iters) :
+      ransac_.computeModel(adapter, *correspondence_scores, kAlgorithm, ransac_threshold,
+                           max_ransac_iters, &model, inliers, inlier_distances_to_model,
+                           num_iters);
+  CHECK_EQ(inliers->size(), inlier_distances_to_model->size());
 
   if (ransac_success) {
     // Optional nonlinear model refinement over all inliers.
-    Eigen::Matrix<double, 3, 4> final_model = ransac.model_coefficients_;
+    Eigen::Matrix<double, 3, 4> final_model = model;
     if (run_nonlinear_refinement_) {
-      absposeproblem_ptr->optimizeModelCoefficients(ransac.inliers_,
-                                                    ransac.model_coefficients_,
-                                                    final_model);
+      opengv::sac_problems::absolute_pose::AbsolutePoseSacProblem absposeproblem(
+          adapter, opengv::sac_problems::absolute_pose::AbsolutePoseSacProblem::GP3P,
+          random_seed_);
+      absposeproblem.optimizeModelCoefficients(*inliers, model, final_model);
     }
 
     // Set result.
@@ -266,10 +325,6 @@ bool PnpPoseEstimator::absoluteMultiPoseRansac(
     T_G_I->getRotation() = aslam::Quaternion(R_G_I);
   }
 
-  *inliers = ransac.inliers_;
-  *inlier_distances_to_model = ransac.inlier_distances_to_model_;
-  *num_iters = ransac.iterations_;
-
   return ransac_success;
 }
 
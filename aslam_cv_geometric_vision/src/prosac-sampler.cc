@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <glog/logging.h>
+
+#include "aslam/geometric-vision/prosac-sampler.h"
+
+namespace aslam {
+namespace geometric_vision {
+
+ProsacSampler::ProsacSampler(
+    const std::vector<double>& scores, int sample_size, int max_iterations)
+    : sample_size_(sample_size),
+      num_drawn_samples_(0),
+      sampling_set_size_(sample_size),
+      expected_num_samples_(static_cast<double>(max_iterations)),
+      growth_num_samples_(1) {
+  CHECK_GT(sample_size_, 0);
+  CHECK_GT(max_iterations, 0);
+  const int num_correspondences = static_cast<int>(scores.size());
+  CHECK_GE(num_correspondences, sample_size_);
+
+  // Stable, such that equal scores keep the input order.
+  sorted_indices_.resize(num_correspondences);
+  std::iota(sorted_indices_.begin(), sorted_indices_.end(), 0);
+  std::stable_sort(sorted_indices_.begin(), sorted_indices_.end(),
+                   [&scores](int lhs, int rhs) { return scores[lhs] > scores[rhs]; });
+
+  // T_m = T_N * prod_{i=0}^{m-1} (m - i) / (N - i).
+  for (int i = 0; i < sample_size_; ++i) {
+    expected_num_samples_ *= static_cast<double>(sample_size_ - i) /
+        static_cast<double>(num_correspondences - i);
+  }
+}
+
+void ProsacSampler::drawDistinct(
+    int num_candidates, std::mt19937* rng, std::vector<int>* sample) const {
+  CHECK_NOTNULL(rng);
+  CHECK_NOTNULL(sample);
+  std::uniform_int_distribution<int> distribution(0, num_candidates - 1);
+  while (true) {
+    const int index = sorted_indices_[distribution(*rng)];
+    if (std::find(sample->begin(), sample->end(), index) == sample->end()) {
+      sample->push_back(index);
+      return;
+    }
+  }
+}
+
+void ProsacSampler::drawSample(std::mt19937* rng, std::vector<int>* sample) {
+  CHECK_NOTNULL(rng);
+  CHECK_NOTNULL(sample)->clear();
+  ++num_drawn_samples_;
+  const int num_correspondences = static_cast<int>(sorted_indices_.size());
+  if (num_drawn_samples_ > growth_num_samples_ && sampling_set_size_ < num_correspondences) {
+    // T_{n+1} = T_n * (n + 1) / (n + 1 - m) and T'_{n+1} = T'_n + ceil(T_{n+1} - T_n).
+    const double next_expected_num_samples = expected_num_samples_ *
+        static_cast<double>(sampling_set_size_ + 1) /
+        static_cast<double>(sampling_set_size_ + 1 - sample_size_);
+    growth_num_samples_ +=
+        static_cast<int>(std::ceil(next_expected_num_samples - expected_num_samples_));
+    expected_num_samples_ = next_expected_num_samples;
+    ++sampling_set_size_;
+  }
+
+  if (num_drawn_samples_ > growth_num_samples_) {
+    // The sampling set stopped growing, sample uniformly from it.
+    for (int i = 0; i < sample_size_; ++i) {
+      drawDistinct(sampling_set_size_, rng, sample);
+    }
+  } else {
+    // The newest correspondence of the sampling set and the rest from the better ones.
+    sample->push_back(sorted_indices_[sampling_set_size_ - 1]);
+    for (int i = 1; i < sample_size_; ++i) {
+      drawDistinct(sampling_set_size_ - 1, rng, sample);
+    }
+  }
+}
+
+}  // namespace geometric_vision
+}  // namespace aslam
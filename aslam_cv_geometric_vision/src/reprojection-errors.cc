@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <limits>
+
+#include <aslam/common/memory.h>
+#include <aslam/common/parallel-for.h>
+#include <glog/logging.h>
+
+#include "aslam/geometric-vision/reprojection-errors.h"
+
+namespace aslam {
+namespace geometric_vision {
+
+void computeReprojectionErrors(
+    const aslam::NCamera& ncamera, const Eigen::Matrix3Xd& G_points,
+    const aslam::TransformationVector& T_G_Bs, const ReprojectionObservations& observations,
+    double keypoint_sigma_px, size_t num_threads, Eigen::Matrix2Xd* residuals,
+    Eigen::VectorXd* chi2, std::vector<ProjectionResult>* projection_results) {
+  CHECK_NOTNULL(residuals);
+  CHECK_NOTNULL(chi2);
+  CHECK_GT(keypoint_sigma_px, 0.0);
+  const size_t num_observations = observations.size();
+  CHECK_EQ(observations.pose_indices.size(), num_observations);
+  CHECK_EQ(observations.camera_indices.size(), num_observations);
+  CHECK_EQ(static_cast<size_t>(observations.measurements.cols()), num_observations);
+
+  residuals->resize(Eigen::NoChange, num_observations);
+  chi2->resize(num_observations);
+  std::vector<ProjectionResult> local_projection_results;
+  std::vector<ProjectionResult>& results =
+      (projection_results != nullptr) ? *projection_results : local_projection_results;
+  results.resize(num_observations);
+  if (num_observations == 0u) {
+    return;
+  }
+
+  // Group the observations by camera.
+  const size_t num_cameras = ncamera.getNumCameras();
+  std::vector<size_t> camera_begin(num_cameras + 1u, 0u);
+  for (const size_t camera_idx : observations.camera_indices) {
+    CHECK_LT(camera_idx, num_cameras);
+    ++camera_begin[camera_idx + 1u];
+  }
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    camera_begin[camera_idx + 1u] += camera_begin[camera_idx];
+  }
+  std::vector<size_t> fill_position(camera_begin.begin(), camera_begin.end() - 1);
+  std::vector<size_t> sorted_observations(num_observations);
+  for (size_t observation_idx = 0u; observation_idx < num_observations; ++observation_idx) {
+    sorted_observations[fill_position[observations.camera_indices[observation_idx]]++] =
+        observation_idx;
+  }
+
+  // Rotation matrices of the poses and the cameras, converted once.
+  Aligned<std::vector, Eigen::Matrix3d> R_B_Gs(T_G_Bs.size());
+  for (size_t pose_idx = 0u; pose_idx < T_G_Bs.size(); ++pose_idx) {
+    R_B_Gs[pose_idx] = T_G_Bs[pose_idx].getRotationMatrix().transpose();
+  }
+  Aligned<std::vector, Eigen::Matrix3d> R_C_Bs(num_cameras);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    R_C_Bs[camera_idx] = ncamera.get_T_C_B(camera_idx).getRotationMatrix();
+  }
+
+  // Blocks of observations of the same camera.
+  struct Block {
+    size_t camera_idx;
+    size_t begin;
+    size_t end;
+  };
+  static constexpr size_t kNumObservationsPerBlock = 512u;
+  std::vector<Block> blocks;
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    for (size_t begin = camera_begin[camera_idx]; begin < camera_begin[camera_idx + 1u];
+        begin += kNumObservationsPerBlock) {
+      blocks.push_back(Block{camera_idx, begin,
+          std::min(begin + kNumObservationsPerBlock, camera_begin[camera_idx + 1u])});
+    }
+  }
+
+  const double inverse_keypoint_variance = 1.0 / (keypoint_sigma_px * keypoint_sigma_px);
+  auto process_block = [&](const Block& block) {
+    const size_t num_block_observations = block.end - block.begin;
+    const Eigen::Matrix3d& R_C_B = R_C_Bs[block.camera_idx];
+    const Eigen::Vector3d& p_C_B = ncamera.get_T_C_B(block.camera_idx).getPosition();
+    Eigen::Matrix3Xd C_points(3, num_block_observations);
+    for (size_t i = 0u; i < num_block_observations; ++i) {
+      const size_t observation_idx = sorted_observations[block.begin + i];
+      const size_t point_idx = observations.point_indices[observation_idx];
+      const size_t pose_idx = observations.pose_indices[observation_idx];
+      CHECK_LT(point_idx, static_cast<size_t>(G_points.cols()));
+      CHECK_LT(pose_idx, T_G_Bs.size());
+      C_points.col(i) = R_C_B * (R_B_Gs[pose_idx] *
+          (G_points.col(point_idx) - T_G_Bs[pose_idx].getPosition())) + p_C_B;
+    }
+
+    Eigen::Matrix2Xd projections;
+    std::vector<ProjectionResult> block_results;
+    ncamera.getCamera(block.camera_idx).project3Vectorized(C_points, &projections,
+                                                           &block_results);
+    CHECK_EQ(block_results.size(), num_block_observations);
+
+    for (size_t i = 0u; i < num_block_observations; ++i) {
+      const size_t observation_idx = sorted_observations[block.begin + i];
+      const ProjectionResult::Status status = block_results[i].getDetailedStatus();
+      results[observation_idx] = block_results[i];
+      if (status == ProjectionResult::Status::POINT_BEHIND_CAMERA ||
+          status == ProjectionResult::Status::PROJECTION_INVALID) {
+        residuals->col(observation_idx).setZero();
+        (*chi2)(observation_idx) = std::numeric_limits<double>::infinity();
+        continue;
+      }
+      residuals->col(observation_idx) =
+          observations.measurements.col(observation_idx) - projections.col(i);
+      (*chi2)(observation_idx) =
+          residuals->col(observation_idx).squaredNorm() * inverse_keypoint_variance;
+    }
+  };
+
+  // Every block writes the entries of its own observations.
+  common::parallelFor(common::IndexRange(0u, blocks.size()),
+                      num_threads == 1u ? blocks.size() : 1u,
+                      [&](size_t block_begin, size_t block_end) {
+    for (size_t block_idx = block_begin; block_idx < block_end; ++block_idx) {
+      process_block(blocks[block_idx]);
+    }
+  });
+}
+
+void getReprojectionInliers(const Eigen::VectorXd& chi2, double chi2_threshold,
+                            std::vector<size_t>* inlier_indices) {
+  CHECK_NOTNULL(inlier_indices)->clear();
+  for (int observation_idx = 0; observation_idx < chi2.size(); ++observation_idx) {
+    if (chi2(observation_idx) < chi2_threshold) {
+      inlier_indices->push_back(static_cast<size_t>(observation_idx));
+    }
+  }
+}
+
+}  // namespace geometric_vision
+}  // namespace aslam
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/match.h>
+
+#include "aslam/geometric-vision/match-outlier-rejection-twopt.h"
+
+namespace aslam {
+namespace geometric_vision {
+
+class MatchOutlierRejectionTwoPtTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumMatches = 300;
+  // Every fifth match has a random keypoint in frame (k+1).
+  static constexpr int kOutlierStride = 5;
+  static constexpr size_t kMaxNumIterations = 500u;
+
+  virtual void SetUp() {
+    srand(3);
+    camera_ = PinholeCamera::createTestCamera();
+    q_Ckp1_Ck_ = Quaternion(Eigen::AngleAxisd(
+        3.0 / 180.0 * M_PI, Eigen::Vector3d(0.3, 1.0, 0.1).normalized()).toRotationMatrix());
+    // 1 - cos(0.5 deg), the ray disparity threshold of the tracker.
+    ransac_threshold_ = 1.0 - std::cos(0.5 / 180.0 * M_PI);
+    createFrames(Eigen::Vector3d(0.2, -0.05, 0.1), 2.0, 10.0);
+  }
+
+  /// Frames observing landmarks at the given distance from camera k.
+  void createFrames(const Eigen::Vector3d& p_Ckp1_Ck, double min_distance_m,
+                    double max_distance_m) {
+    matches_kp1_k_.clear();
+    Eigen::Matrix2Xd keypoints_k(2, kNumMatches);
+    Eigen::Matrix2Xd keypoints_kp1(2, kNumMatches);
+    for (int i = 0; i < kNumMatches; ++i) {
+      // A landmark in front of camera k that is visible in both frames.
+      Eigen::Vector2d keypoint_kp1;
+      Eigen::Vector3d Ck_point;
+      do {
+        Ck_point = camera_->createRandomVisiblePoint(min_distance_m +
+            (max_distance_m - min_distance_m) * static_cast<double>(rand()) / RAND_MAX);
+      } while (!camera_->project3(q_Ckp1_Ck_.rotate(Ck_point) + p_Ckp1_Ck, &keypoint_kp1)
+                    .isKeypointVisible());
+      Eigen::Vector2d keypoint_k;
+      CHECK(camera_->project3(Ck_point, &keypoint_k).isKeypointVisible());
+      keypoints_k.col(i) = keypoint_k;
+      if (i % kOutlierStride == 0) {
+        Eigen::Vector2d outlier_keypoint;
+        do {
+          outlier_keypoint = camera_->createRandomKeypoint();
+        } while ((outlier_keypoint - keypoint_kp1).norm() < 30.0);
+        keypoint_kp1 = outlier_keypoint;
+      }
+      keypoints_kp1.col(i) = keypoint_kp1;
+      matches_kp1_k_.emplace_back(i, i, 1.0);
+    }
+    frame_k_ = VisualFrame::createEmptyTestVisualFrame(camera_, 0);
+    frame_k_->setKeypointMeasurements(keypoints_k);
+    frame_kp1_ = VisualFrame::createEmptyTestVisualFrame(camera_, 1);
+    frame_kp1_->setKeypointMeasurements(keypoints_kp1);
+  }
+
+  static std::vector<int> getSortedMatchIndices(const FrameToFrameMatchesWithScore& matches) {
+    std::vector<int> match_indices;
+    for (const FrameToFrameMatchWithScore& match : matches) {
+      match_indices.push_back(match.getKeypointIndexAppleFrame());
+    }
+    std::sort(match_indices.begin(), match_indices.end());
+    return match_indices;
+  }
+
+  /// All inliers are kept and at most a few outliers that are close to one of the models.
+  void expectInliersFound(const FrameToFrameMatchesWithScore& inlier_matches_kp1_k,
+                          const FrameToFrameMatchesWithScore& outlier_matches_kp1_k) const {
+    EXPECT_EQ(static_cast<size_t>(kNumMatches),
+              inlier_matches_kp1_k.size() + outlier_matches_kp1_k.size());
+    for (const FrameToFrameMatchWithScore& match : outlier_matches_kp1_k) {
+      EXPECT_EQ(0, match.getKeypointIndexAppleFrame() % kOutlierStride);
+    }
+    const int num_outliers = (kNumMatches + kOutlierStride - 1) / kOutlierStride;
+    EXPECT_GE(static_cast<int>(outlier_matches_kp1_k.size()), num_outliers * 9 / 10);
+  }
+
+  Camera::Ptr camera_;
+  Quaternion q_Ckp1_Ck_;
+  double ransac_threshold_;
+  VisualFrame::Ptr frame_k_;
+  VisualFrame::Ptr frame_kp1_;
+  FrameToFrameMatchesWithScore matches_kp1_k_;
+};
+
+TEST_F(MatchOutlierRejectionTwoPtTest, SinglePassMatchesTwoPass) {
+  FrameToFrameMatchesWithScore two_pass_inliers;
+  FrameToFrameMatchesWithScore two_pass_outliers;
+  ASSERT_TRUE(rejectOutlierFeatureMatchesTranslationRotationSAC(
+      *frame_kp1_, *frame_k_, q_Ckp1_Ck_, matches_kp1_k_, true, ransac_threshold_,
+      kMaxNumIterations, &two_pass_inliers, &two_pass_outliers));
+  expectInliersFound(two_pass_inliers, two_pass_outliers);
+
+  // Without and with the early exit.
+  for (const double early_exit_inlier_ratio : {1.0, 0.7}) {
+    FrameToFrameMatchesWithScore single_pass_inliers;
+    FrameToFrameMatchesWithScore single_pass_outliers;
+    ASSERT_TRUE(rejectOutlierFeatureMatchesTranslationRotationSinglePass(
+        *frame_kp1_, *frame_k_, q_Ckp1_Ck_, matches_kp1_k_, true, ransac_threshold_,
+        kMaxNumIterations, early_exit_inlier_ratio, &single_pass_inliers,
+        &single_pass_outliers));
+    expectInliersFound(single_pass_inliers, single_pass_outliers);
+
+    // Both find the exact translation of the inliers, only outliers close to the rotation-only
+    // models may be classified differently.
+    const std::vector<int> two_pass_indices = getSortedMatchIndices(two_pass_inliers);
+    const std::vector<int> single_pass_indices = getSortedMatchIndices(single_pass_inliers);
+    std::vector<int> differing_indices;
+    std::set_symmetric_difference(two_pass_indices.begin(), two_pass_indices.end(),
+                                  single_pass_indices.begin(), single_pass_indices.end(),
+                                  std::back_inserter(differing_indices));
+    EXPECT_LE(differing_indices.size(), 3u) << "Early exit ratio " << early_exit_inlier_ratio;
+    for (const int match_index : differing_indices) {
+      EXPECT_EQ(0, match_index % kOutlierStride);
+    }
+  }
+}
+
+TEST_F(MatchOutlierRejectionTwoPtTest, SinglePassRejectsTooFewMatches) {
+  const FrameToFrameMatchesWithScore matches_kp1_k(
+      matches_kp1_k_.begin(), matches_kp1_k_.begin() + 4);
+  FrameToFrameMatchesWithScore inlier_matches_kp1_k;
+  FrameToFrameMatchesWithScore outlier_matches_kp1_k;
+  EXPECT_FALSE(rejectOutlierFeatureMatchesTranslationRotationSinglePass(
+      *frame_kp1_, *frame_k_, q_Ckp1_Ck_, matches_kp1_k, true, ransac_threshold_,
+      kMaxNumIterations, 1.0, &inlier_matches_kp1_k, &outlier_matches_kp1_k));
+  EXPECT_TRUE(inlier_matches_kp1_k.empty());
+  EXPECT_EQ(matches_kp1_k.size(), outlier_matches_kp1_k.size());
+}
+
+TEST_F(MatchOutlierRejectionTwoPtTest, GyroPriorMatchesTwoPass) {
+  FrameToFrameMatchesWithScore two_pass_inliers;
+  FrameToFrameMatchesWithScore two_pass_outliers;
+  ASSERT_TRUE(rejectOutlierFeatureMatchesTranslationRotationSAC(
+      *frame_kp1_, *frame_k_, q_Ckp1_Ck_, matches_kp1_k_, true, ransac_threshold_,
+      kMaxNumIterations, &two_pass_inliers, &two_pass_outliers));
+
+  FrameToFrameMatchesWithScore gyro_prior_inliers;
+  FrameToFrameMatchesWithScore gyro_prior_outliers;
+  ASSERT_TRUE(rejectOutlierFeatureMatchesGyroPriorSAC(
+      *frame_kp1_, *frame_k_, q_Ckp1_Ck_, matches_kp1_k_, true, ransac_threshold_,
+      kMaxNumIterations, false, &gyro_prior_inliers, &gyro_prior_outliers));
+  expectInliersFound(gyro_prior_inliers, gyro_prior_outliers);
+
+  // The exact prior is at least as good as the estimated rotation of the two-pass RANSAC.
+  const std::vector<int> two_pass_indices = getSortedMatchIndices(two_pass_inliers);
+  const std::vector<int> gyro_prior_indices = getSortedMatchIndices(gyro_prior_inliers);
+  std::vector<int> differing_indices;
+  std::set_symmetric_difference(two_pass_indices.begin(), two_pass_indices.end(),
+                                gyro_prior_indices.begin(), gyro_prior_indices.end(),
+                                std::back_inserter(differing_indices));
+  EXPECT_LE(differing_indices.size(), 3u);
+  for (const int match_index : differing_indices) {
+    EXPECT_EQ(0, match_index % kOutlierStride);
+  }
+}
+
+TEST_F(MatchOutlierRejectionTwoPtTest, GyroPriorRefinesABiasedRotation) {
+  // Distant landmarks and a small translation, such that the inliers are consistent with the
+  // rotation and refit it.
+  createFrames(Eigen::Vector3d(0.02, 0.0, 0.03), 50.0, 100.0);
+  // A gyro bias rotates the prior by 0.4 deg, close to the threshold of 0.5 deg.
+  const Quaternion q_bias(Eigen::AngleAxisd(
+      0.4 / 180.0 * M_PI, Eigen::Vector3d(1.0, -0.5, 0.2).normalized()).toRotationMatrix());
+  const Quaternion q_Ckp1_Ck_prior = q_bias * q_Ckp1_Ck_;
+
+  FrameToFrameMatchesWithScore inlier_matches_kp1_k;
+  FrameToFrameMatchesWithScore outlier_matches_kp1_k;
+  ASSERT_TRUE(rejectOutlierFeatureMatchesGyroPriorSAC(
+      *frame_kp1_, *frame_k_, q_Ckp1_Ck_prior, matches_kp1_k_, true, ransac_threshold_,
+      kMaxNumIterations, true, &inlier_matches_kp1_k, &outlier_matches_kp1_k));
+  expectInliersFound(inlier_matches_kp1_k, outlier_matches_kp1_k);
+}
+
+TEST_F(MatchOutlierRejectionTwoPtTest, GyroPriorRejectsTooFewMatches) {
+  const FrameToFrameMatchesWithScore matches_kp1_k(
+      matches_kp1_k_.begin(), matches_kp1_k_.begin() + 4);
+  FrameToFrameMatchesWithScore inlier_matches_kp1_k;
+  FrameToFrameMatchesWithScore outlier_matches_kp1_k;
+  EXPECT_FALSE(rejectOutlierFeatureMatchesGyroPriorSAC(
+      *frame_kp1_, *frame_k_, q_Ckp1_Ck_, matches_kp1_k, true, ransac_threshold_,
+      kMaxNumIterations, true, &inlier_matches_kp1_k, &outlier_matches_kp1_k));
+  EXPECT_TRUE(inlier_matches_kp1_k.empty());
+  EXPECT_EQ(matches_kp1_k.size(), outlier_matches_kp1_k.size());
+}
+
+}  // namespace geometric_vision
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,123 @@
+#include <cmath>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <eigen-checks/gtest.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <opengv/relative_pose/NoncentralRelativeAdapter.hpp>
+
+#include <aslam/common/entrypoint.h>
+
+#include "aslam/geometric-vision/parallel-noncentral-relative-pose-ransac.h"
+
+namespace aslam {
+namespace geometric_vision {
+
+class NoncentralRelativePoseRansacTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumCorrespondences = 200;
+  // Every fifth correspondence is an outlier.
+  static constexpr int kOutlierStride = 5;
+
+  virtual void SetUp() {
+    srand(11);
+    // A rig with three cameras looking to the front and to the sides. The camera centers are
+    // not collinear, as the seventeen-point solver is degenerate for axial rigs.
+    camera_offsets_ = {Eigen::Vector3d(0.25, 0.0, 0.0), Eigen::Vector3d(-0.25, 0.0, 0.1),
+                       Eigen::Vector3d(0.0, 0.3, -0.1)};
+    camera_rotations_ = {
+        Eigen::Matrix3d::Identity(),
+        Eigen::AngleAxisd(M_PI / 2.0, Eigen::Vector3d::UnitY()).toRotationMatrix(),
+        Eigen::AngleAxisd(-M_PI / 2.0, Eigen::Vector3d::UnitY()).toRotationMatrix()};
+    R_12_ = Eigen::AngleAxisd(0.2, Eigen::Vector3d(0.1, 1.0, 0.3).normalized())
+        .toRotationMatrix();
+    t_12_ << 0.3, -0.1, 0.2;
+
+    for (int i = 0; i < kNumCorrespondences; ++i) {
+      const int camera_1 = i % 3;
+      const int camera_2 = (i / 3) % 3;
+      // A point in front of camera 1 of viewpoint 1, between 2m and 10m away.
+      Eigen::Vector3d C1_point = Eigen::Vector3d::Random();
+      C1_point.z() = 1.0;
+      C1_point *= 2.0 + 8.0 * std::abs(static_cast<double>(rand()) / RAND_MAX);
+      const Eigen::Vector3d point_1 =
+          camera_rotations_[camera_1] * C1_point + camera_offsets_[camera_1];
+      const Eigen::Vector3d point_2 = R_12_.transpose() * (point_1 - t_12_);
+      bearing_vectors_1_.push_back(C1_point.normalized());
+      Eigen::Vector3d bearing_vector_2 = camera_rotations_[camera_2].transpose() *
+          (point_2 - camera_offsets_[camera_2]);
+      if (i % kOutlierStride == 0) {
+        bearing_vector_2 += Eigen::Vector3d::Random() * bearing_vector_2.norm();
+      }
+      bearing_vectors_2_.push_back(bearing_vector_2.normalized());
+      camera_correspondences_1_.push_back(camera_1);
+      camera_correspondences_2_.push_back(camera_2);
+    }
+  }
+
+  void runRansac(ParallelNoncentralRelativePoseRansac::Algorithm algorithm,
+                 const Eigen::Matrix3d& R_12_prior, double max_rotation_deviation_rad,
+                 size_t num_threads, double tolerance = 1e-6) {
+    opengv::relative_pose::NoncentralRelativeAdapter adapter(
+        bearing_vectors_1_, bearing_vectors_2_, camera_correspondences_1_,
+        camera_correspondences_2_, camera_offsets_, camera_rotations_, R_12_prior);
+    ParallelNoncentralRelativePoseRansac ransac(num_threads, false);
+    ransac.setMaxRotationDeviationFromPrior(max_rotation_deviation_rad);
+    Eigen::Matrix<double, 3, 4> model;
+    std::vector<int> inliers;
+    int num_iterations = 0;
+    ASSERT_TRUE(ransac.computeModel(adapter, algorithm, 1e-5, 1000, &model, &inliers,
+                                    &num_iterations));
+    EXPECT_LE(num_iterations, 1000);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(R_12_, model.leftCols<3>(), tolerance));
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(t_12_, model.col(3), tolerance));
+
+    const int num_outliers = (kNumCorrespondences + kOutlierStride - 1) / kOutlierStride;
+    EXPECT_EQ(kNumCorrespondences - num_outliers, static_cast<int>(inliers.size()));
+    for (const int inlier : inliers) {
+      EXPECT_NE(0, inlier % kOutlierStride);
+    }
+  }
+
+  opengv::translations_t camera_offsets_;
+  opengv::rotations_t camera_rotations_;
+  Eigen::Matrix3d R_12_;
+  Eigen::Vector3d t_12_;
+  opengv::bearingVectors_t bearing_vectors_1_;
+  opengv::bearingVectors_t bearing_vectors_2_;
+  std::vector<int> camera_correspondences_1_;
+  std::vector<int> camera_correspondences_2_;
+};
+
+TEST_F(NoncentralRelativePoseRansacTest, GivenRotation) {
+  // The translation, with scale, from three correspondences given the rotation.
+  runRansac(ParallelNoncentralRelativePoseRansac::Algorithm::kGivenRotation, R_12_, M_PI, 1u);
+  runRansac(ParallelNoncentralRelativePoseRansac::Algorithm::kGivenRotation, R_12_, M_PI, 3u);
+}
+
+TEST_F(NoncentralRelativePoseRansacTest, SixPoint) {
+  // The polynomial solver of the rotation is less accurate than the linear ones.
+  const double kTolerance = 1e-4;
+  runRansac(ParallelNoncentralRelativePoseRansac::Algorithm::kSixPoint, R_12_, M_PI, 1u,
+            kTolerance);
+  // With a biased prior that only rejects the solutions far from it.
+  const Eigen::Matrix3d R_12_prior =
+      Eigen::AngleAxisd(0.02, Eigen::Vector3d::UnitX()).toRotationMatrix() * R_12_;
+  runRansac(ParallelNoncentralRelativePoseRansac::Algorithm::kSixPoint, R_12_prior, 0.1, 2u,
+            kTolerance);
+}
+
+TEST_F(NoncentralRelativePoseRansacTest, SeventeenPoint) {
+  // The prior rotation is only used to reject hypotheses far from it.
+  const Eigen::Matrix3d R_12_prior =
+      Eigen::AngleAxisd(0.02, Eigen::Vector3d::UnitX()).toRotationMatrix() * R_12_;
+  runRansac(ParallelNoncentralRelativePoseRansac::Algorithm::kSeventeenPoint, R_12_prior, 0.1,
+            2u);
+}
+
+}  // namespace geometric_vision
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,165 @@
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <eigen-checks/gtest.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <opengv/absolute_pose/CentralAbsoluteAdapter.hpp>
+#include <opengv/absolute_pose/NoncentralAbsoluteAdapter.hpp>
+#include <opengv/relative_pose/CentralRelativeAdapter.hpp>
+
+#include <aslam/common/entrypoint.h>
+
+#include "aslam/geometric-vision/opengv-eigen-adapters.h"
+
+namespace aslam {
+namespace geometric_vision {
+
+class OpengvEigenAdaptersTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumColumns = 20;
+
+  virtual void SetUp() {
+    srand(5);
+    bearing_vectors_1_ = Eigen::Matrix3Xd::Random(3, kNumColumns);
+    bearing_vectors_2_ = Eigen::Matrix3Xd::Random(3, kNumColumns);
+    for (int i = 0; i < kNumColumns; ++i) {
+      bearing_vectors_1_.col(i).normalize();
+      bearing_vectors_2_.col(i).normalize();
+    }
+    points_ = Eigen::Matrix3Xd::Random(3, kNumColumns) * 10.0;
+    // Correspondences that skip, reorder and repeat columns.
+    indices_1_ = {3u, 0u, 19u, 7u, 7u, 12u, 5u, 1u};
+    indices_2_ = {11u, 2u, 4u, 18u, 0u, 9u, 9u, 16u};
+    R12_ = Eigen::AngleAxisd(0.3, Eigen::Vector3d(1.0, 0.5, -0.2).normalized())
+        .toRotationMatrix();
+  }
+
+  /// The columns of the matrix in the order of the indices, as copied by the callers before.
+  static opengv::bearingVectors_t gatherColumns(const Eigen::Matrix3Xd& matrix,
+                                                const std::vector<size_t>& indices) {
+    opengv::bearingVectors_t columns;
+    for (const size_t index : indices) {
+      columns.push_back(matrix.col(index));
+    }
+    return columns;
+  }
+
+  static opengv::bearingVectors_t getColumns(const Eigen::Matrix3Xd& matrix) {
+    opengv::bearingVectors_t columns;
+    for (int i = 0; i < matrix.cols(); ++i) {
+      columns.push_back(matrix.col(i));
+    }
+    return columns;
+  }
+
+  static void expectAbsoluteAdaptersEqual(
+      const opengv::absolute_pose::AbsoluteAdapterBase& expected_adapter,
+      const opengv::absolute_pose::AbsoluteAdapterBase& adapter) {
+    ASSERT_EQ(expected_adapter.getNumberCorrespondences(), adapter.getNumberCorrespondences());
+    for (size_t i = 0u; i < adapter.getNumberCorrespondences(); ++i) {
+      EXPECT_EQ(expected_adapter.getBearingVector(i), adapter.getBearingVector(i)) << i;
+      EXPECT_EQ(expected_adapter.getPoint(i), adapter.getPoint(i)) << i;
+      EXPECT_EQ(expected_adapter.getCamOffset(i), adapter.getCamOffset(i)) << i;
+      EXPECT_EQ(expected_adapter.getCamRotation(i), adapter.getCamRotation(i)) << i;
+      EXPECT_EQ(expected_adapter.getWeight(i), adapter.getWeight(i)) << i;
+    }
+  }
+
+  Eigen::Matrix3Xd bearing_vectors_1_;
+  Eigen::Matrix3Xd bearing_vectors_2_;
+  Eigen::Matrix3Xd points_;
+  std::vector<size_t> indices_1_;
+  std::vector<size_t> indices_2_;
+  Eigen::Matrix3d R12_;
+};
+
+constexpr int OpengvEigenAdaptersTest::kNumColumns;
+
+TEST_F(OpengvEigenAdaptersTest, CentralAbsoluteAdapterEqualsCopies) {
+  // All columns.
+  const opengv::bearingVectors_t bearing_vectors = getColumns(bearing_vectors_1_);
+  const opengv::points_t points = getColumns(points_);
+  const opengv::absolute_pose::CentralAbsoluteAdapter expected_adapter(bearing_vectors, points);
+  const EigenCentralAbsoluteAdapter adapter(bearing_vectors_1_, nullptr, points_, nullptr);
+  expectAbsoluteAdaptersEqual(expected_adapter, adapter);
+
+  // Indexed columns.
+  const opengv::bearingVectors_t indexed_bearing_vectors =
+      gatherColumns(bearing_vectors_1_, indices_1_);
+  const opengv::points_t indexed_points = gatherColumns(points_, indices_2_);
+  const opengv::absolute_pose::CentralAbsoluteAdapter expected_indexed_adapter(
+      indexed_bearing_vectors, indexed_points);
+  const EigenCentralAbsoluteAdapter indexed_adapter(
+      bearing_vectors_1_, &indices_1_, points_, &indices_2_);
+  expectAbsoluteAdaptersEqual(expected_indexed_adapter, indexed_adapter);
+
+  // Only one side indexed.
+  const opengv::absolute_pose::CentralAbsoluteAdapter expected_partly_indexed_adapter(
+      gatherColumns(bearing_vectors_1_, indices_1_),
+      opengv::points_t(points.begin(), points.begin() + indices_1_.size()));
+  const Eigen::Matrix3Xd first_points = points_.leftCols(indices_1_.size());
+  const EigenCentralAbsoluteAdapter partly_indexed_adapter(
+      bearing_vectors_1_, &indices_1_, first_points, nullptr);
+  expectAbsoluteAdaptersEqual(expected_partly_indexed_adapter, partly_indexed_adapter);
+}
+
+TEST_F(OpengvEigenAdaptersTest, NoncentralAbsoluteAdapterEqualsCopies) {
+  const opengv::translations_t camera_offsets = {
+      Eigen::Vector3d(0.1, 0.0, 0.0), Eigen::Vector3d(-0.1, 0.2, 0.05)};
+  const opengv::rotations_t camera_rotations = {
+      Eigen::Matrix3d::Identity(),
+      Eigen::AngleAxisd(M_PI / 2.0, Eigen::Vector3d::UnitY()).toRotationMatrix()};
+  std::vector<int> camera_indices;
+  for (int i = 0; i < kNumColumns; ++i) {
+    camera_indices.push_back(i % 3 == 0 ? 1 : 0);
+  }
+  const opengv::bearingVectors_t bearing_vectors = getColumns(bearing_vectors_1_);
+  const opengv::points_t points = getColumns(points_);
+  const opengv::absolute_pose::NoncentralAbsoluteAdapter expected_adapter(
+      bearing_vectors, camera_indices, points, camera_offsets, camera_rotations);
+  const EigenNoncentralAbsoluteAdapter adapter(
+      bearing_vectors_1_, camera_indices, points_, camera_offsets, camera_rotations);
+  expectAbsoluteAdaptersEqual(expected_adapter, adapter);
+}
+
+TEST_F(OpengvEigenAdaptersTest, CentralRelativeAdapterEqualsCopies) {
+  const opengv::bearingVectors_t bearing_vectors_1 = gatherColumns(bearing_vectors_1_, indices_1_);
+  const opengv::bearingVectors_t bearing_vectors_2 = gatherColumns(bearing_vectors_2_, indices_2_);
+  const opengv::relative_pose::CentralRelativeAdapter expected_adapter(
+      bearing_vectors_1, bearing_vectors_2, R12_);
+  const EigenCentralRelativeAdapter adapter(
+      bearing_vectors_1_, &indices_1_, bearing_vectors_2_, &indices_2_, R12_);
+
+  ASSERT_EQ(expected_adapter.getNumberCorrespondences(), adapter.getNumberCorrespondences());
+  EXPECT_EQ(expected_adapter.getR12(), adapter.getR12());
+  EXPECT_EQ(expected_adapter.gett12(), adapter.gett12());
+  for (size_t i = 0u; i < adapter.getNumberCorrespondences(); ++i) {
+    EXPECT_EQ(expected_adapter.getBearingVector1(i), adapter.getBearingVector1(i)) << i;
+    EXPECT_EQ(expected_adapter.getBearingVector2(i), adapter.getBearingVector2(i)) << i;
+    EXPECT_EQ(expected_adapter.getCamOffset1(i), adapter.getCamOffset1(i)) << i;
+    EXPECT_EQ(expected_adapter.getCamRotation1(i), adapter.getCamRotation1(i)) << i;
+    EXPECT_EQ(expected_adapter.getCamOffset2(i), adapter.getCamOffset2(i)) << i;
+    EXPECT_EQ(expected_adapter.getCamRotation2(i), adapter.getCamRotation2(i)) << i;
+    EXPECT_EQ(expected_adapter.getWeight(i), adapter.getWeight(i)) << i;
+  }
+}
+
+TEST_F(OpengvEigenAdaptersTest, RejectsInvalidCorrespondences) {
+  // Different numbers of correspondences.
+  EXPECT_DEATH(EigenCentralAbsoluteAdapter(bearing_vectors_1_, &indices_1_, points_, nullptr),
+               "^");
+  // A column index out of range.
+  const std::vector<size_t> invalid_indices = {0u, static_cast<size_t>(kNumColumns)};
+  const std::vector<size_t> valid_indices = {0u, 1u};
+  EXPECT_DEATH(EigenCentralRelativeAdapter(bearing_vectors_1_, &valid_indices,
+                                           bearing_vectors_2_, &invalid_indices, R12_), "^");
+}
+
+}  // namespace geometric_vision
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <eigen-checks/gtest.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+
+#include "aslam/geometric-vision/p3p-batch-solver.h"
+
+namespace aslam {
+namespace geometric_vision {
+
+TEST(P3pBatchSolverTest, RecoversTheTruePoseInEveryLane) {
+  srand(5);
+  constexpr int kNumBatches = 50;
+  for (int batch = 0; batch < kNumBatches; ++batch) {
+    P3pBatchSolver::LaneCorrespondences bearing_vectors, points;
+    Eigen::Matrix<double, 3, 4> true_models[P3pBatchSolver::kNumLanes];
+    for (int lane = 0; lane < P3pBatchSolver::kNumLanes; ++lane) {
+      const Eigen::Matrix3d R_W_C =
+          Eigen::Quaterniond(Eigen::Vector4d::Random().normalized()).toRotationMatrix();
+      const Eigen::Vector3d p_W_C = 5.0 * Eigen::Vector3d::Random();
+      true_models[lane] << R_W_C, p_W_C;
+      for (int i = 0; i < 3; ++i) {
+        // Points between 1m and 9m in front of the camera.
+        Eigen::Vector3d C_point = Eigen::Vector3d::Random();
+        C_point.z() = 5.0 + 4.0 * C_point.z();
+        bearing_vectors.block<1, 3>(lane, 3 * i) = C_point.normalized().transpose();
+        points.block<1, 3>(lane, 3 * i) = (R_W_C * C_point + p_W_C).transpose();
+      }
+    }
+
+    P3pBatchSolver::Solutions solutions;
+    P3pBatchSolver::solve(bearing_vectors, points, &solutions);
+    for (int lane = 0; lane < P3pBatchSolver::kNumLanes; ++lane) {
+      ASSERT_GE(solutions.num_solutions[lane], 1);
+      ASSERT_LE(solutions.num_solutions[lane], P3pBatchSolver::kMaxNumSolutions);
+      double min_error = std::numeric_limits<double>::infinity();
+      for (int solution = 0; solution < solutions.num_solutions[lane]; ++solution) {
+        const Eigen::Matrix<double, 3, 4>& model = solutions.models[lane][solution];
+        EXPECT_NEAR(model.leftCols<3>().determinant(), 1.0, 1e-6);
+        min_error = std::min(min_error, (model - true_models[lane]).norm());
+      }
+      EXPECT_LT(min_error, 1e-5) << "Batch " << batch << ", lane " << lane;
+    }
+  }
+}
+
+TEST(P3pBatchSolverTest, CollinearPointsHaveNoSolution) {
+  P3pBatchSolver::LaneCorrespondences bearing_vectors, points;
+  for (int lane = 0; lane < P3pBatchSolver::kNumLanes; ++lane) {
+    for (int i = 0; i < 3; ++i) {
+      const Eigen::Vector3d point(0.5 * i, 0.1 * i, 4.0 + i);
+      bearing_vectors.block<1, 3>(lane, 3 * i) = point.normalized().transpose();
+      points.block<1, 3>(lane, 3 * i) = point.transpose();
+    }
+  }
+  P3pBatchSolver::Solutions solutions;
+  P3pBatchSolver::solve(bearing_vectors, points, &solutions);
+  for (int lane = 0; lane < P3pBatchSolver::kNumLanes; ++lane) {
+    EXPECT_EQ(0, solutions.num_solutions[lane]);
+  }
+}
+
+}  // namespace geometric_vision
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
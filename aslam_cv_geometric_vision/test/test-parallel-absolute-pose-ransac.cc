@@ -0,0 +1,96 @@
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <eigen-checks/gtest.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <opengv/absolute_pose/CentralAbsoluteAdapter.hpp>
+
+#include <aslam/common/deadline.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/time.h>
+
+#include "aslam/geometric-vision/parallel-absolute-pose-ransac.h"
+
+namespace aslam {
+namespace geometric_vision {
+
+class ParallelAbsolutePoseRansacTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumCorrespondences = 200;
+  // Only every third correspondence is an inlier, such that RANSAC needs hundreds of
+  // hypotheses.
+  static constexpr int kInlierStride = 3;
+  static constexpr int kMaxIterations = 2000;
+
+  virtual void SetUp() {
+    srand(7);
+    R_G_B_ = Eigen::AngleAxisd(0.3, Eigen::Vector3d(0.2, 1.0, -0.4).normalized())
+        .toRotationMatrix();
+    p_G_B_ << 0.5, -0.2, 1.0;
+    for (int i = 0; i < kNumCorrespondences; ++i) {
+      // A point in front of the camera, between 2m and 10m away.
+      Eigen::Vector3d B_point = Eigen::Vector3d::Random();
+      B_point.z() = 1.0;
+      B_point *= 2.0 + 8.0 * std::abs(static_cast<double>(rand()) / RAND_MAX);
+      Eigen::Vector3d bearing_vector = B_point;
+      if (i % kInlierStride != 0) {
+        bearing_vector += Eigen::Vector3d::Random() * bearing_vector.norm();
+      }
+      bearing_vectors_.push_back(bearing_vector.normalized());
+      points_G_.push_back(R_G_B_ * B_point + p_G_B_);
+    }
+  }
+
+  bool runRansac(Eigen::Matrix<double, 3, 4>* model, std::vector<int>* inliers,
+                 int* num_iterations) {
+    opengv::absolute_pose::CentralAbsoluteAdapter adapter(bearing_vectors_, points_G_);
+    ParallelAbsolutePoseRansac ransac(1u, false);
+    std::vector<double> inlier_distances_to_model;
+    return ransac.computeModel(adapter, ParallelAbsolutePoseRansac::Algorithm::kKneip, 1e-6,
+                               kMaxIterations, model, inliers, &inlier_distances_to_model,
+                               num_iterations);
+  }
+
+  Eigen::Matrix3d R_G_B_;
+  Eigen::Vector3d p_G_B_;
+  opengv::bearingVectors_t bearing_vectors_;
+  opengv::points_t points_G_;
+};
+
+constexpr int ParallelAbsolutePoseRansacTest::kNumCorrespondences;
+constexpr int ParallelAbsolutePoseRansacTest::kInlierStride;
+constexpr int ParallelAbsolutePoseRansacTest::kMaxIterations;
+
+TEST_F(ParallelAbsolutePoseRansacTest, ExpiredDeadlineCutsTheIterations) {
+  Eigen::Matrix<double, 3, 4> model;
+  std::vector<int> inliers;
+  int num_unbounded_iterations = 0;
+  {
+    common::DeadlineScope deadline_scope(common::Deadline::fromNow(time::seconds(100)));
+    ASSERT_TRUE(runRansac(&model, &inliers, &num_unbounded_iterations));
+    EXPECT_TRUE(deadline_scope.getDegradations().empty());
+  }
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(R_G_B_, model.leftCols<3>(), 1e-6));
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(p_G_B_, model.col(3), 1e-6));
+  EXPECT_EQ((kNumCorrespondences + kInlierStride - 1) / kInlierStride,
+            static_cast<int>(inliers.size()));
+  EXPECT_LT(num_unbounded_iterations, kMaxIterations);
+
+  // A single round is run and its best model returned.
+  common::DeadlineScope deadline_scope(common::Deadline::fromNow(0));
+  int num_iterations = 0;
+  EXPECT_TRUE(runRansac(&model, &inliers, &num_iterations));
+  EXPECT_TRUE(deadline_scope.getDegradations().has(common::Degradation::kCutRansacIterations));
+  EXPECT_GT(num_iterations, 0);
+  EXPECT_LT(num_iterations, num_unbounded_iterations);
+  EXPECT_GE(static_cast<int>(inliers.size()), 3);
+}
+
+}  // namespace geometric_vision
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
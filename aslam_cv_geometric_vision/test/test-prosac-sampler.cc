@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+
+#include "aslam/geometric-vision/prosac-sampler.h"
+
+namespace aslam {
+namespace geometric_vision {
+
+class ProsacSamplerTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumCorrespondences = 50;
+  static constexpr int kSampleSize = 3;
+  static constexpr int kMaxIterations = 1000;
+
+  virtual void SetUp() {
+    rng_.seed(11u);
+    // Shuffled scores, such that the sorted order differs from the input order.
+    for (int i = 0; i < kNumCorrespondences; ++i) {
+      scores_.push_back(static_cast<double>(i));
+    }
+    std::shuffle(scores_.begin(), scores_.end(), rng_);
+    ranks_.resize(kNumCorrespondences);
+    for (int i = 0; i < kNumCorrespondences; ++i) {
+      ranks_[i] = kNumCorrespondences - 1 - static_cast<int>(scores_[i]);
+    }
+  }
+
+  /// The sample has distinct indices, all within the current sampling set.
+  void expectSampleValid(const ProsacSampler& sampler, const std::vector<int>& sample) const {
+    ASSERT_EQ(static_cast<size_t>(kSampleSize), sample.size());
+    std::vector<int> sorted_sample = sample;
+    std::sort(sorted_sample.begin(), sorted_sample.end());
+    EXPECT_TRUE(std::adjacent_find(sorted_sample.begin(), sorted_sample.end()) ==
+                sorted_sample.end());
+    for (const int index : sample) {
+      ASSERT_GE(index, 0);
+      ASSERT_LT(index, kNumCorrespondences);
+      EXPECT_LT(ranks_[index], sampler.getSamplingSetSize());
+    }
+  }
+
+  std::mt19937 rng_;
+  std::vector<double> scores_;
+  /// Position of each correspondence in the order of decreasing scores.
+  std::vector<int> ranks_;
+};
+
+constexpr int ProsacSamplerTest::kNumCorrespondences;
+constexpr int ProsacSamplerTest::kSampleSize;
+constexpr int ProsacSamplerTest::kMaxIterations;
+
+TEST_F(ProsacSamplerTest, SortsByDecreasingScore) {
+  ProsacSampler sampler(scores_, kSampleSize, kMaxIterations);
+  const std::vector<int>& sorted_indices = sampler.getSortedIndices();
+  ASSERT_EQ(static_cast<size_t>(kNumCorrespondences), sorted_indices.size());
+  for (int rank = 0; rank < kNumCorrespondences; ++rank) {
+    EXPECT_EQ(rank, ranks_[sorted_indices[rank]]);
+  }
+
+  // Equal scores keep the input order.
+  ProsacSampler tied_sampler({1.0, 2.0, 1.0, 2.0, 1.0}, kSampleSize, kMaxIterations);
+  EXPECT_EQ(std::vector<int>({1, 3, 0, 2, 4}), tied_sampler.getSortedIndices());
+}
+
+TEST_F(ProsacSamplerTest, SamplesTheBestCorrespondencesFirst) {
+  ProsacSampler sampler(scores_, kSampleSize, kMaxIterations);
+  EXPECT_EQ(kSampleSize, sampler.getSamplingSetSize());
+  EXPECT_EQ(0, sampler.getNumDrawnSamples());
+
+  // The first sample are the best correspondences.
+  std::vector<int> sample;
+  sampler.drawSample(&rng_, &sample);
+  expectSampleValid(sampler, sample);
+  std::vector<int> sample_ranks;
+  for (const int index : sample) {
+    sample_ranks.push_back(ranks_[index]);
+  }
+  std::sort(sample_ranks.begin(), sample_ranks.end());
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), sample_ranks);
+
+  // The sampling set grows by at most one per sample, and while it grows each sample contains
+  // its newest correspondence.
+  int previous_sampling_set_size = sampler.getSamplingSetSize();
+  for (int i = 1; i < kMaxIterations / 10; ++i) {
+    sampler.drawSample(&rng_, &sample);
+    EXPECT_EQ(i + 1, sampler.getNumDrawnSamples());
+    expectSampleValid(sampler, sample);
+    const int sampling_set_size = sampler.getSamplingSetSize();
+    EXPECT_GE(sampling_set_size, previous_sampling_set_size);
+    EXPECT_LE(sampling_set_size, previous_sampling_set_size + 1);
+    if (sampling_set_size > previous_sampling_set_size) {
+      EXPECT_EQ(1, std::count(sample.begin(), sample.end(),
+                              sampler.getSortedIndices()[sampling_set_size - 1]));
+    }
+    previous_sampling_set_size = sampling_set_size;
+  }
+  // A tenth of the iterations have not reached the worse half yet.
+  EXPECT_LT(sampler.getSamplingSetSize(), kNumCorrespondences / 2);
+}
+
+TEST_F(ProsacSamplerTest, FallsBackToUniformSampling) {
+  ProsacSampler sampler(scores_, kSampleSize, kMaxIterations);
+  std::vector<int> sample;
+  // The rounded up growth steps add at most one sample per correspondence.
+  for (int i = 0; i < kMaxIterations + kNumCorrespondences; ++i) {
+    sampler.drawSample(&rng_, &sample);
+    expectSampleValid(sampler, sample);
+  }
+  ASSERT_EQ(kNumCorrespondences, sampler.getSamplingSetSize());
+
+  // Every correspondence is drawn about equally often.
+  const int kNumUniformSamples = 20000;
+  std::vector<int> counts(kNumCorrespondences, 0);
+  for (int i = 0; i < kNumUniformSamples; ++i) {
+    sampler.drawSample(&rng_, &sample);
+    expectSampleValid(sampler, sample);
+    for (const int index : sample) {
+      ++counts[index];
+    }
+  }
+  const double expected_count =
+      static_cast<double>(kNumUniformSamples * kSampleSize) / kNumCorrespondences;
+  for (int index = 0; index < kNumCorrespondences; ++index) {
+    EXPECT_NEAR(expected_count, counts[index], 0.15 * expected_count) << "Index " << index;
+  }
+}
+
+TEST_F(ProsacSamplerTest, SamplesUniformlyWithoutCorrespondencesToAdd) {
+  // As many correspondences as the sample size.
+  ProsacSampler sampler({3.0, 1.0, 2.0}, kSampleSize, kMaxIterations);
+  std::vector<int> sample;
+  for (int i = 0; i < 10; ++i) {
+    sampler.drawSample(&rng_, &sample);
+    EXPECT_EQ(kSampleSize, sampler.getSamplingSetSize());
+    std::sort(sample.begin(), sample.end());
+    EXPECT_EQ(std::vector<int>({0, 1, 2}), sample);
+  }
+}
+
+}  // namespace geometric_vision
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,105 @@
+#include <cmath>
+#include <vector>
+
+#include <Eigen/Core>
+#include <eigen-checks/gtest.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-types.h>
+
+#include "aslam/geometric-vision/reprojection-errors.h"
+
+TEST(ReprojectionErrorsTest, MatchSinglePointProjection) {
+  constexpr size_t kNumCameras = 2u;
+  constexpr size_t kNumPoses = 5u;
+  constexpr size_t kNumPoints = 1000u;
+  constexpr double kKeypointSigmaPx = 0.8;
+  const aslam::NCamera::Ptr ncamera = aslam::NCamera::createTestNCamera(kNumCameras);
+
+  aslam::TransformationVector T_G_Bs(kNumPoses);
+  for (aslam::Transformation& T_G_B : T_G_Bs) {
+    T_G_B.setRandom(0.5, 0.1);
+  }
+  // Points in front of the first camera at the identity pose.
+  Eigen::Matrix3Xd G_points(3, kNumPoints);
+  for (size_t point_idx = 0u; point_idx < kNumPoints; ++point_idx) {
+    const Eigen::Vector3d C_point(Eigen::Vector2d::Random().homogeneous() * 5.0);
+    G_points.col(point_idx) = ncamera->get_T_C_B(0u).inverse() * C_point;
+  }
+  // A point behind all cameras.
+  G_points.col(kNumPoints - 1u) = ncamera->get_T_C_B(0u).inverse() * Eigen::Vector3d(0, 0, -5);
+
+  aslam::geometric_vision::ReprojectionObservations observations;
+  for (size_t point_idx = 0u; point_idx < kNumPoints; ++point_idx) {
+    for (size_t pose_idx = 0u; pose_idx < kNumPoses; pose_idx += 2u) {
+      const size_t camera_idx = (point_idx + pose_idx) % kNumCameras;
+      observations.point_indices.push_back(point_idx);
+      observations.pose_indices.push_back(pose_idx);
+      observations.camera_indices.push_back(camera_idx);
+    }
+  }
+  const size_t num_observations = observations.size();
+  observations.measurements.resize(2, num_observations);
+  Eigen::Matrix2Xd expected_residuals(2, num_observations);
+  std::vector<aslam::ProjectionResult> expected_results(num_observations);
+  for (size_t i = 0u; i < num_observations; ++i) {
+    const aslam::Transformation T_C_G = ncamera->get_T_C_B(observations.camera_indices[i]) *
+        T_G_Bs[observations.pose_indices[i]].inverse();
+    Eigen::Vector2d keypoint;
+    expected_results[i] = ncamera->getCamera(observations.camera_indices[i]).project3(
+        T_C_G * G_points.col(observations.point_indices[i]), &keypoint);
+    // Up to 3 pixels, such that some observations are outliers.
+    expected_residuals.col(i) = 3.0 * Eigen::Vector2d::Random();
+    observations.measurements.col(i) = keypoint + expected_residuals.col(i);
+  }
+
+  constexpr double kChi2Threshold = 5.991;
+  std::vector<size_t> expected_inlier_indices;
+  for (size_t i = 0u; i < num_observations; ++i) {
+    const aslam::ProjectionResult::Status status = expected_results[i].getDetailedStatus();
+    if (status != aslam::ProjectionResult::Status::POINT_BEHIND_CAMERA &&
+        status != aslam::ProjectionResult::Status::PROJECTION_INVALID &&
+        expected_residuals.col(i).squaredNorm() / (kKeypointSigmaPx * kKeypointSigmaPx) <
+            kChi2Threshold) {
+      expected_inlier_indices.push_back(i);
+    }
+  }
+  ASSERT_GT(expected_inlier_indices.size(), 0u);
+  ASSERT_LT(expected_inlier_indices.size(), num_observations - 1u);
+
+  for (const size_t num_threads : {1u, 4u}) {
+    Eigen::Matrix2Xd residuals;
+    Eigen::VectorXd chi2;
+    std::vector<aslam::ProjectionResult> projection_results;
+    aslam::geometric_vision::computeReprojectionErrors(
+        *ncamera, G_points, T_G_Bs, observations, kKeypointSigmaPx, num_threads, &residuals,
+        &chi2, &projection_results);
+    ASSERT_EQ(static_cast<int>(num_observations), residuals.cols());
+    ASSERT_EQ(static_cast<int>(num_observations), chi2.size());
+    ASSERT_EQ(num_observations, projection_results.size());
+
+    size_t num_behind_camera = 0u;
+    for (size_t i = 0u; i < num_observations; ++i) {
+      EXPECT_EQ(expected_results[i], projection_results[i]);
+      if (projection_results[i].getDetailedStatus() ==
+          aslam::ProjectionResult::Status::POINT_BEHIND_CAMERA) {
+        ++num_behind_camera;
+        EXPECT_TRUE(std::isinf(chi2(i)));
+        continue;
+      }
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(expected_residuals.col(i), residuals.col(i), 1e-6));
+      EXPECT_NEAR(expected_residuals.col(i).squaredNorm() / (kKeypointSigmaPx * kKeypointSigmaPx),
+                  chi2(i), 1e-6);
+    }
+    EXPECT_GE(num_behind_camera, 1u);
+
+    std::vector<size_t> inlier_indices;
+    aslam::geometric_vision::getReprojectionInliers(chi2, kChi2Threshold, &inlier_indices);
+    EXPECT_EQ(expected_inlier_indices, inlier_indices);
+  }
+}
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <cstdlib>
 #include <memory>
 #include <vector>
@@ -184,4 +185,140 @@ TEST_P(VariableCameraAngle, MultiPinholeCameraP3pInterface) {
   EXPECT_EQ(inliers.size(), num_of_points - num_of_outliers);
 }
 
+TEST_P(VariableCameraAngle, ParallelRansacWithManyOutliers) {
+  // Relocalization-like inlier ratio of 30 %.
+  constexpr bool kNonlinearRefinement = false;
+  constexpr bool kRandomSeed = false;
+  constexpr size_t kNumRansacThreads = 4u;
+  aslam::geometric_vision::PnpPoseEstimator pose_estimator(
+      kNonlinearRefinement, kRandomSeed, kNumRansacThreads);
+
+  std::shared_ptr<CameraType> camera = createCamera();
+  Eigen::Quaterniond q_G_C(
+      Eigen::AngleAxisd(GetParam(), Eigen::Vector3d::UnitY()));
+  Eigen::Matrix3d R_G_C = q_G_C.toRotationMatrix();
+  const Eigen::Vector3d p_G_C(1, 2, 3);
+
+  const unsigned int num_of_points = 300;
+  const unsigned int num_of_inliers = 90;
+  Eigen::Matrix2Xd measurements(2, num_of_points);
+  Eigen::Matrix3Xd G_landmark_positions(3, num_of_points);
+  for (unsigned int i = 0; i < num_of_points; ++i) {
+    Eigen::Vector3d p_C_fi = camera->createRandomVisiblePoint(i + 50);
+    Eigen::Vector2d keypoint_measurement;
+    camera->project3(p_C_fi, &keypoint_measurement);
+    measurements.col(i) = keypoint_measurement;
+    if (i >= num_of_inliers) {
+      // Outliers observe the landmark of another measurement.
+      p_C_fi = camera->createRandomVisiblePoint(i + 1000);
+    }
+    G_landmark_positions.col(i) = R_G_C * p_C_fi + p_G_C;
+  }
+
+  std::vector<int> inliers;
+  int num_iters;
+  aslam::Transformation T_G_C;
+  ASSERT_TRUE(pose_estimator.absolutePoseRansacPinholeCam(
+      measurements, G_landmark_positions, 0.8, 5000, camera, &T_G_C, &inliers,
+      &num_iters));
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(T_G_C.getPosition(), p_G_C, 1e-5));
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(T_G_C.getRotation().toImplementation().coeffs(),
+                                q_G_C.coeffs(), 1e-5));
+  EXPECT_GE(inliers.size(), num_of_inliers);
+  // The adaptive stopping criterion ends well before the iteration limit.
+  EXPECT_LT(num_iters, 5000);
+
+  // The fixed seed makes the result independent of the thread timing.
+  std::vector<int> repeated_inliers;
+  int repeated_num_iters;
+  aslam::Transformation repeated_T_G_C;
+  ASSERT_TRUE(pose_estimator.absolutePoseRansacPinholeCam(
+      measurements, G_landmark_positions, 0.8, 5000, camera, &repeated_T_G_C,
+      &repeated_inliers, &repeated_num_iters));
+  EXPECT_EQ(num_iters, repeated_num_iters);
+  EXPECT_EQ(inliers, repeated_inliers);
+
+  // Another seed draws other samples but finds the same pose.
+  const int default_seed = FLAGS_acv_ransac_fixed_seed;
+  FLAGS_acv_ransac_fixed_seed = default_seed + 1;
+  ASSERT_TRUE(pose_estimator.absolutePoseRansacPinholeCam(
+      measurements, G_landmark_positions, 0.8, 5000, camera, &repeated_T_G_C,
+      &repeated_inliers, &repeated_num_iters));
+  FLAGS_acv_ransac_fixed_seed = default_seed;
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(repeated_T_G_C.getPosition(), p_G_C, 1e-5));
+  EXPECT_GE(repeated_inliers.size(), num_of_inliers);
+
+  // Scores that rank the inliers first let PROSAC stop much earlier.
+  std::vector<double> correspondence_scores(num_of_points, 0.0);
+  for (unsigned int i = 0; i < num_of_inliers; ++i) {
+    correspondence_scores[i] = 1.0;
+  }
+  std::vector<int> prosac_inliers;
+  int prosac_num_iters;
+  aslam::Transformation prosac_T_G_C;
+  const double focal_length = camera->getParameters()(CameraType::Parameters::kFu);
+  ASSERT_TRUE(pose_estimator.absolutePoseRansac(
+      measurements, G_landmark_positions, correspondence_scores,
+      1.0 - cos(atan(0.8 / focal_length)), 5000, camera, &prosac_T_G_C,
+      &prosac_inliers, &prosac_num_iters));
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(prosac_T_G_C.getPosition(), p_G_C, 1e-5));
+  EXPECT_EQ(inliers, prosac_inliers);
+  EXPECT_LT(prosac_num_iters, num_iters);
+}
+
+TEST_P(VariableCameraAngle, LocallyOptimizedRansacWithNoise) {
+  constexpr bool kNonlinearRefinement = false;
+  constexpr bool kRandomSeed = false;
+  constexpr size_t kNumRansacThreads = 2u;
+  aslam::geometric_vision::PnpPoseEstimator pose_estimator(
+      kNonlinearRefinement, kRandomSeed, kNumRansacThreads);
+  aslam::geometric_vision::PnpPoseEstimator lo_pose_estimator(
+      kNonlinearRefinement, kRandomSeed, kNumRansacThreads);
+  lo_pose_estimator.setLocalOptimization(10);
+
+  std::shared_ptr<CameraType> camera = createCamera();
+  Eigen::Quaterniond q_G_C(
+      Eigen::AngleAxisd(GetParam(), Eigen::Vector3d::UnitY()));
+  Eigen::Matrix3d R_G_C = q_G_C.toRotationMatrix();
+  const Eigen::Vector3d p_G_C(1, 2, 3);
+
+  // Noisy inliers, such that the minimal samples rarely explain all of them.
+  srand(7);
+  const unsigned int num_of_points = 300;
+  const unsigned int num_of_inliers = 150;
+  Eigen::Matrix2Xd measurements(2, num_of_points);
+  Eigen::Matrix3Xd G_landmark_positions(3, num_of_points);
+  for (unsigned int i = 0; i < num_of_points; ++i) {
+    Eigen::Vector3d p_C_fi = camera->createRandomVisiblePoint(i + 50);
+    Eigen::Vector2d keypoint_measurement;
+    camera->project3(p_C_fi, &keypoint_measurement);
+    measurements.col(i) = keypoint_measurement + 0.3 * Eigen::Vector2d::Random();
+    if (i >= num_of_inliers) {
+      p_C_fi = camera->createRandomVisiblePoint(i + 1000);
+    }
+    G_landmark_positions.col(i) = R_G_C * p_C_fi + p_G_C;
+  }
+
+  std::vector<int> inliers;
+  int num_iters;
+  aslam::Transformation T_G_C;
+  ASSERT_TRUE(pose_estimator.absolutePoseRansacPinholeCam(
+      measurements, G_landmark_positions, 0.8, 5000, camera, &T_G_C, &inliers,
+      &num_iters));
+  std::vector<int> lo_inliers;
+  int lo_num_iters;
+  aslam::Transformation lo_T_G_C;
+  ASSERT_TRUE(lo_pose_estimator.absolutePoseRansacPinholeCam(
+      measurements, G_landmark_positions, 0.8, 5000, camera, &lo_T_G_C,
+      &lo_inliers, &lo_num_iters));
+
+  // The same samples are drawn, but the refined inlier counts stop the search no later.
+  EXPECT_GE(lo_inliers.size(), inliers.size());
+  EXPECT_LE(lo_num_iters, num_iters);
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(lo_T_G_C.getPosition(), p_G_C, 0.05));
+  for (const int inlier : lo_inliers) {
+    EXPECT_LT(inlier, static_cast<int>(num_of_inliers));
+  }
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,119 @@
+#ifndef ASLAM_CV_MATCHER_BRUTE_FORCE_HAMMING_MATCHER_H_
+#define ASLAM_CV_MATCHER_BRUTE_FORCE_HAMMING_MATCHER_H_
+
+#include <memory>
+
+#include <aslam/common/aligned-descriptors.h>
+#include <aslam/common/macros.h>
+
+#include "aslam/matcher/match.h"
+
+namespace aslam {
+
+/// \class BruteForceHammingMatcher
+/// \brief Exhaustive k-nearest-neighbor search between large sets of binary descriptors, e.g.
+///        for map merging and offline loop closure.
+///
+/// The database descriptors, e.g. VisualFrame::DescriptorsT or concatenated landmark
+/// descriptors, are set once and stay resident; on the CUDA backend they are uploaded once to
+/// the device. The queries are processed in tiles of query_tile_size descriptors with the top-k
+/// selection on the device (cv::cuda::DescriptorMatcher) or, on the CPU backend, blocked over
+/// cache-sized database tiles with the batched Hamming kernel on the shared pool of
+/// common::parallelFor. The CUDA backend requires a build with ASLAM_CV_WITH_CUDA and a CUDA
+/// device, the CPU backend is used otherwise. The database may hold compressed descriptors (see
+/// common::descriptor_utils::compressDescriptors()), knnMatchVerified() then re-ranks the
+/// candidates by their full descriptors. Not thread-safe.
+class BruteForceHammingMatcher {
+ public:
+  ASLAM_POINTER_TYPEDEFS(BruteForceHammingMatcher);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(BruteForceHammingMatcher);
+
+  typedef common::AlignedDescriptors::DescriptorsT DescriptorsT;
+  /// The apples are the database descriptors, the bananas the query descriptors.
+  typedef FrameToFrameMatchesWithScore MatchesWithScore;
+
+  enum class Backend {
+    kCpu,
+    kCuda
+  };
+
+  struct Options {
+    Options() : use_cuda_if_available(true), query_tile_size(1024u), num_threads(0u) {}
+    bool use_cuda_if_available;
+    /// Number of queries per tile, bounds the device memory of the distance matrix.
+    size_t query_tile_size;
+    /// 1 runs the CPU backend on the calling thread, any other value on the shared pool of
+    /// common::parallelFor, see FLAGS_acv_parallel_for_num_threads.
+    size_t num_threads;
+  };
+
+  explicit BruteForceHammingMatcher(const Options& options);
+  ~BruteForceHammingMatcher();
+
+  /// True if the libraries were built with ASLAM_CV_WITH_CUDA and a CUDA device is present.
+  static bool isCudaBackendAvailable();
+  Backend getBackend() const { return backend_; }
+
+  /// Set the database descriptors, one per column, replacing the previous ones.
+  void setDatabase(const DescriptorsT& database_descriptors);
+  size_t getDatabaseSize() const { return database_size_; }
+
+  /// \brief Find the k nearest database descriptors of every query descriptor.
+  ///
+  /// @param[in]  query_descriptors    Query descriptors of the database descriptor size.
+  /// @param[in]  k                    Number of neighbors per query.
+  /// @param[in]  max_hamming_distance Neighbors with a larger distance are dropped.
+  /// @param[out] matches              Up to k matches per query, ordered by query and then by
+  ///                                  increasing distance. The score is the fraction of equal
+  ///                                  bits. Ties are resolved to the lower database index on
+  ///                                  the CPU backend.
+  void knnMatch(const DescriptorsT& query_descriptors, size_t k, int max_hamming_distance,
+                MatchesWithScore* matches);
+
+  /// \brief Set the full descriptors of the database descriptors for knnMatchVerified(), column
+  ///        i belongs to database descriptor i. Kept in host memory only.
+  void setVerificationDatabase(const DescriptorsT& full_database_descriptors);
+
+  /// \brief knnMatch() with a re-verification on the full descriptors, e.g. for a database of
+  ///        compressed map descriptors.
+  ///
+  /// The num_candidates nearest neighbors of the (compressed) queries are searched in the
+  /// database, then their distances between the full descriptors are computed and the k closest
+  /// ones within max_full_hamming_distance are kept.
+  /// @param[in]  query_descriptors          Queries of the database descriptor size.
+  /// @param[in]  full_query_descriptors     The full descriptors of the queries, of the size of
+  ///                                        the verification database.
+  /// @param[in]  num_candidates             Neighbors per query searched in the database, >= k.
+  /// @param[in]  max_hamming_distance       Candidates with a larger distance are dropped.
+  /// @param[in]  k                          Number of verified neighbors per query.
+  /// @param[in]  max_full_hamming_distance  Neighbors with a larger full distance are dropped.
+  /// @param[out] matches                    Up to k matches per query, ordered by query and then
+  ///                                        by increasing full distance. The score is the
+  ///                                        fraction of equal bits of the full descriptors.
+  void knnMatchVerified(const DescriptorsT& query_descriptors,
+                        const DescriptorsT& full_query_descriptors, size_t num_candidates,
+                        int max_hamming_distance, size_t k, int max_full_hamming_distance,
+                        MatchesWithScore* matches);
+
+ private:
+  void knnMatchCpu(const DescriptorsT& query_descriptors, size_t k, int max_hamming_distance,
+                   MatchesWithScore* matches) const;
+
+  const Options options_;
+  Backend backend_;
+  size_t database_size_;
+  size_t descriptor_size_bytes_;
+
+  /// The database of the CPU backend.
+  common::AlignedDescriptors database_descriptors_;
+  /// The full descriptors of the database for knnMatchVerified(), empty if not set.
+  DescriptorsT verification_descriptors_;
+
+  /// The device state of the CUDA backend.
+  struct CudaImpl;
+  std::unique_ptr<CudaImpl> cuda_impl_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_CV_MATCHER_BRUTE_FORCE_HAMMING_MATCHER_H_
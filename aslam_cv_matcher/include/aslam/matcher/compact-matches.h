@@ -0,0 +1,97 @@
+#ifndef ASLAM_MATCHER_COMPACT_MATCHES_H_
+#define ASLAM_MATCHER_COMPACT_MATCHES_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <aslam/common/memory-usage.h>
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+namespace aslam {
+
+/// \class CompactMatchesWithScore
+/// \brief Matches with score stored as structure of arrays with 32 bit indices and float scores.
+///
+/// A match takes 12 bytes instead of the 24 bytes of a (derived) MatchWithScore, which halves
+/// the memory traffic of large match sets passed between the matching engines, the track
+/// managers and RANSAC. The exclusive and non-exclusive engines write it directly; the index
+/// and score arrays can be used in place through the Eigen views.
+class CompactMatchesWithScore {
+ public:
+  typedef uint32_t Index;
+  typedef Eigen::Map<const Eigen::Matrix<Index, Eigen::Dynamic, 1>> IndexView;
+  typedef Eigen::Map<const Eigen::VectorXf> ScoreView;
+
+  CompactMatchesWithScore() = default;
+
+  size_t size() const { return indices_apple_.size(); }
+  bool empty() const { return indices_apple_.empty(); }
+  void clear() {
+    indices_apple_.clear();
+    indices_banana_.clear();
+    scores_.clear();
+  }
+  void reserve(size_t num_matches) {
+    indices_apple_.reserve(num_matches);
+    indices_banana_.reserve(num_matches);
+    scores_.reserve(num_matches);
+  }
+
+  /// Same signature as the MatchWithScore constructors, such that the engines can write either.
+  void emplace_back(int index_apple, int index_banana, double score) {
+    DCHECK_GE(index_apple, 0);
+    DCHECK_GE(index_banana, 0);
+    indices_apple_.push_back(static_cast<Index>(index_apple));
+    indices_banana_.push_back(static_cast<Index>(index_banana));
+    scores_.push_back(static_cast<float>(score));
+  }
+
+  Index getIndexApple(size_t match_idx) const {
+    DCHECK_LT(match_idx, size());
+    return indices_apple_[match_idx];
+  }
+  Index getIndexBanana(size_t match_idx) const {
+    DCHECK_LT(match_idx, size());
+    return indices_banana_[match_idx];
+  }
+  float getScore(size_t match_idx) const {
+    DCHECK_LT(match_idx, size());
+    return scores_[match_idx];
+  }
+
+  const std::vector<Index>& getIndicesApple() const { return indices_apple_; }
+  const std::vector<Index>& getIndicesBanana() const { return indices_banana_; }
+  const std::vector<float>& getScores() const { return scores_; }
+
+  /// Views of the arrays without copying, valid until the matches are modified.
+  IndexView getIndicesAppleView() const {
+    return IndexView(indices_apple_.data(), static_cast<int>(size()));
+  }
+  IndexView getIndicesBananaView() const {
+    return IndexView(indices_banana_.data(), static_cast<int>(size()));
+  }
+  ScoreView getScoresView() const {
+    return ScoreView(scores_.data(), static_cast<int>(size()));
+  }
+
+  /// Heap memory of the arrays.
+  size_t getMemoryUsageBytes() const {
+    return common::getMemoryUsageBytes(indices_apple_) +
+        common::getMemoryUsageBytes(indices_banana_) + common::getMemoryUsageBytes(scores_);
+  }
+
+  bool operator==(const CompactMatchesWithScore& other) const {
+    return indices_apple_ == other.indices_apple_ && indices_banana_ == other.indices_banana_ &&
+        scores_ == other.scores_;
+  }
+
+ private:
+  std::vector<Index> indices_apple_;
+  std::vector<Index> indices_banana_;
+  std::vector<float> scores_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_MATCHER_COMPACT_MATCHES_H_
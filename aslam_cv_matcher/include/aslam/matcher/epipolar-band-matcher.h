@@ -0,0 +1,71 @@
+#ifndef ASLAM_CV_MATCHER_EPIPOLAR_BAND_MATCHER_H_
+#define ASLAM_CV_MATCHER_EPIPOLAR_BAND_MATCHER_H_
+
+#include <utility>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <Eigen/Core>
+
+#include "aslam/matcher/match.h"
+
+namespace aslam {
+class VisualFrame;
+
+/// \class EpipolarBandMatcher
+/// \brief Matches the keypoints of two cameras with a fixed relative pose, e.g. the overlapping
+///        cameras of a rig, by searching along the epipolar lines.
+///
+/// The bearing vectors of both cameras are rotated into a common rectified frame whose x axis
+/// is the baseline, computed once from the extrinsics. Every epipolar plane then contains the x
+/// axis and is identified by its angle around it, hence corresponding keypoints have (nearly)
+/// the same angle for any camera model, including fisheye lenses. The apple keypoints are
+/// sorted by this angle and every banana keypoint is compared to the apples within a band of
+/// max_epipolar_angle_radians whose rays intersect in front of both cameras. Every apple is
+/// matched to at most one banana, the one with the smallest descriptor distance. Thread-safe,
+/// match() can be called concurrently.
+class EpipolarBandMatcher {
+ public:
+  ASLAM_POINTER_TYPEDEFS(EpipolarBandMatcher);
+
+  typedef FrameToFrameMatchesWithScore MatchesWithScore;
+
+  struct Options {
+    Options() : max_epipolar_angle_radians(0.005), hamming_distance_threshold(60) {}
+    /// Half-width of the band around the epipolar plane. An angle of d / f corresponds to about
+    /// d pixels at the focal length f.
+    double max_epipolar_angle_radians;
+    /// Pairs with a descriptor distance >= this threshold are not matched.
+    int hamming_distance_threshold;
+  };
+
+  /// @param[in]  T_A_B    Transformation taking points from the banana to the apple camera
+  ///                      frame, e.g. T_C_B(apple) * T_C_B(banana).inverse() of an NCamera.
+  ///                      The cameras must not share their optical center.
+  /// @param[in]  options  The search parameters.
+  EpipolarBandMatcher(const Transformation& T_A_B, const Options& options);
+
+  /// \brief Match the keypoints of the apple and the banana frame. Keypoints that can't be
+  ///        back-projected are not matched.
+  void match(const VisualFrame& apple_frame, const VisualFrame& banana_frame,
+             MatchesWithScore* matches_A_B) const;
+
+  const Options& getOptions() const { return options_; }
+
+ private:
+  /// The angle of the epipolar plane around the baseline and the angle of the ray to the
+  /// baseline, both in the rectified frame.
+  static void computeEpipolarAngles(const Eigen::Vector3d& R_bearing, double* plane_angle,
+                                    double* baseline_angle);
+
+  const Options options_;
+  /// Rotations from the apple and the banana camera frame into the rectified frame.
+  Eigen::Matrix3d R_R_A_;
+  Eigen::Matrix3d R_R_B_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_CV_MATCHER_EPIPOLAR_BAND_MATCHER_H_
@@ -6,6 +6,7 @@
 
 #include <aslam/common/pose-types.h>
 #include <aslam/common/feature-descriptor-ref.h>
+#include <aslam/common/keypoint-grid.h>
 #include <aslam/frames/visual-frame.h>
 #include <Eigen/Core>
 #include <glog/logging.h>
@@ -32,34 +33,61 @@ namespace aslam {
 /// The second matcher is executed several times because it is also allowed
 /// to discard inferior matches of the current iteration.
 /// The matches are exclusive.
+///
+/// In the optional coarse-to-fine mode for large motion, a subset of the strongest keypoints of
+/// frame k is first matched within a large window. An affine correction of the predicted
+/// keypoint positions is fitted to these matches and all keypoints are then matched as above
+/// around the corrected predictions, which keeps the windows small despite prediction errors.
+///
+/// Within a common::DeadlineScope, the large windows are skipped once less than a quarter of the
+/// budget is left and the inferior matches are not re-matched once the deadline expired. The
+/// degradations are recorded in the scope.
 class GyroTwoFrameMatcher {
  public:
   ASLAM_DISALLOW_EVIL_CONSTRUCTORS(GyroTwoFrameMatcher);
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-  /// \brief Constructs the GyroTwoFrameMatcher.
+  /// \brief Constructs the GyroTwoFrameMatcher. The matcher is meant to be long-lived, all
+  ///        internal buffers are reused across calls of match().
+  /// @param[in]  image_height  The image height of the given camera.
+  explicit GyroTwoFrameMatcher(const uint32_t image_height);
+  virtual ~GyroTwoFrameMatcher() {};
+
+  /// \brief Match the keypoints of two frames.
   /// @param[in]  q_Ckp1_Ck     Rotation matrix that describes the camera rotation between the
   ///                           two frames that are matched.
   /// @param[in]  frame_kp1     The current VisualFrame that needs to contain the keypoints and
   ///                           descriptor channels. Usually this is an output of the VisualPipeline.
   /// @param[in]  frame_k       The previous VisualFrame that needs to contain the keypoints and
   ///                           descriptor channels. Usually this is an output of the VisualPipeline.
-  /// @param[in]  image_height  The image height of the given camera.
   /// @param[in]  predicted_keypoint_positions_kp1  Predicted positions of keypoints in next frame.
   /// @param[in]  prediction_success  Was the prediction successful?
   /// @param[out] matches_kp1_k  Vector of structs containing the found matches. Indices
   ///                            correspond to the ordering of the keypoint/descriptor vector in the
   ///                            respective frame channels.
-  GyroTwoFrameMatcher(const Quaternion& q_Ckp1_Ck,
-                      const VisualFrame& frame_kp1,
-                      const VisualFrame& frame_k,
-                      const uint32_t image_height,
-                      const Eigen::Matrix2Xd& predicted_keypoint_positions_kp1,
-                      const std::vector<unsigned char>& prediction_success,
-                      FrameToFrameMatchesWithScore* matches_kp1_k);
-  virtual ~GyroTwoFrameMatcher() {};
+  void match(const Quaternion& q_Ckp1_Ck,
+             const VisualFrame& frame_kp1,
+             const VisualFrame& frame_k,
+             const Eigen::Matrix2Xd& predicted_keypoint_positions_kp1,
+             const std::vector<unsigned char>& prediction_success,
+             FrameToFrameMatchesWithScore* matches_kp1_k);
+
+  /// \brief Same as above, but with a search radius per keypoint of frame k, e.g. from the
+  ///        KeypointPredictionCache. The windows shrink for confident predictions: the small
+  ///        window is the radius and the large one twice the radius, both bounded by the
+  ///        default window sizes.
+  void match(const Quaternion& q_Ckp1_Ck,
+             const VisualFrame& frame_kp1,
+             const VisualFrame& frame_k,
+             const Eigen::Matrix2Xd& predicted_keypoint_positions_kp1,
+             const std::vector<unsigned char>& prediction_success,
+             const Eigen::VectorXd& search_radii_px,
+             FrameToFrameMatchesWithScore* matches_kp1_k);
 
-  void match();
+  /// \brief Enable the coarse-to-fine mode. The given predictions are used unchanged if too few
+  ///        of the coarse matches agree on a correction.
+  void setCoarseToFineMatching(const bool enabled) { coarse_to_fine_enabled_ = enabled; }
+  bool isCoarseToFineMatchingEnabled() const { return coarse_to_fine_enabled_; }
 
  private:
   struct KeypointData {
@@ -71,26 +99,32 @@ class GyroTwoFrameMatcher {
   };
 
   typedef typename Aligned<std::vector, KeypointData>::const_iterator KeyPointIterator;
-  typedef typename FrameToFrameMatchesWithScore::iterator MatchesIterator;
 
+  /// \brief The keypoints of frame (k+1) that were candidates for the match of a keypoint of
+  ///        frame k, as a range of the flat candidate pool.
   struct MatchData {
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-    MatchData() = default;
-    void addCandidate(
-        const KeyPointIterator keypoint_iterator_kp1, const double matching_score) {
-      CHECK_GT(matching_score, 0.0);
-      CHECK_LE(matching_score, 1.0);
-      keypoint_match_candidates_kp1.push_back(keypoint_iterator_kp1);
-      match_candidate_matching_scores.push_back(matching_score);
-    }
-    // Iterators of keypoints of frame (k+1) that were candidates for the match
-    // together with their scores.
-    std::vector<KeyPointIterator> keypoint_match_candidates_kp1;
-    std::vector<double> match_candidate_matching_scores;
+    MatchData() : candidates_begin(0u), num_candidates(0u) {}
+    size_t candidates_begin;
+    size_t num_candidates;
   };
 
-  /// \brief Initialize data the matcher relies on.
-  void initialize();
+  /// \brief Match with the search radii of the keypoints of frame k, or the default windows
+  ///        if search_radii_px is null.
+  void matchImpl(const Quaternion& q_Ckp1_Ck,
+                 const VisualFrame& frame_kp1,
+                 const VisualFrame& frame_k,
+                 const Eigen::Matrix2Xd& predicted_keypoint_positions_kp1,
+                 const std::vector<unsigned char>& prediction_success,
+                 const Eigen::VectorXd* search_radii_px,
+                 FrameToFrameMatchesWithScore* matches_kp1_k);
+
+  /// \brief Bind the frames and reset the data the matcher relies on.
+  void initialize(const Quaternion& q_Ckp1_Ck,
+                  const VisualFrame& frame_kp1,
+                  const VisualFrame& frame_k,
+                  const Eigen::Matrix2Xd& predicted_keypoint_positions_kp1,
+                  const std::vector<unsigned char>& prediction_success,
+                  FrameToFrameMatchesWithScore* matches_kp1_k);
 
   /// \brief Match a keypoint of frame k with one of frame (k+1) if possible.
   ///
@@ -99,12 +133,27 @@ class GyroTwoFrameMatcher {
   /// already existing match.
   void matchKeypoint(const int idx_k);
 
-  template <int WindowHalfSideLength>
+  /// \brief Get the range of keypoints of frame (k+1) in the rows of the window.
+  ///
+  /// The window size is a runtime argument rather than a template parameter, as the windows
+  /// of the search radii overload of match() are only known per keypoint. It only sets the
+  /// row range of the lookup, the inlined function costs the same for a constant argument.
   void getKeypointIteratorsInWindow(
       const Eigen::Vector2d& predicted_keypoint_position,
+      const int window_half_side_length,
       KeyPointIterator* it_keypoints_begin,
       KeyPointIterator* it_keypoints_end) const;
 
+  /// \brief Gather the keypoints of frame (k+1) within the given window and compute
+  ///        the descriptor distances to keypoint idx_k in one batch.
+  ///
+  /// The results are stored in window_keypoints_kp1_ and window_distances_kp1_.
+  /// Keypoints already processed in this iteration are skipped if requested.
+  void computeDistancesInWindow(
+      const int idx_k, const KeyPointIterator it_keypoints_begin,
+      const KeyPointIterator it_keypoints_end, const int bound_left,
+      const int bound_right, const bool skip_processed_keypoints);
+
   /// \brief Try to match inferior matches without modifying initial matches.
   ///
   /// Second matcher that is only quering keypoints of frame (k+1) that the
@@ -112,6 +161,20 @@ class GyroTwoFrameMatcher {
   /// Returns true if matches are still found.
   bool matchInferiorMatches(std::vector<bool>* is_inferior_keypoint_kp1_matched);
 
+  /// \brief Match the coarse keypoints of frame k within the large coarse window and fit the
+  ///        affine correction of the predictions to these matches.
+  ///
+  /// Returns true if the correction was estimated, the corrected predictions are then stored
+  /// in corrected_predicted_keypoint_positions_kp1_.
+  bool estimateCoarsePredictionCorrection();
+
+  /// \brief Least squares fit of measurement = A * [prediction; 1] to the coarse inliers.
+  ///        Returns false if the inliers are degenerate, e.g. collinear.
+  bool fitAffineCorrection(Eigen::Matrix<double, 2, 3>* A_kp1) const;
+
+  /// The match that the keypoint of frame (k+1) is currently part of.
+  FrameToFrameMatchWithScore& getMatchOfKeypointKp1(const int idx_kp1);
+
   int clamp(const int lower, const int upper, const int in) const;
 
   // The larger the matching score (which is smaller or equal to 1),
@@ -126,55 +189,82 @@ class GyroTwoFrameMatcher {
                  const unsigned int distance_second_shortest) const;
 
   // The current frame.
-  const VisualFrame& frame_kp1_;
+  const VisualFrame* frame_kp1_;
   // The previous frame.
-  const VisualFrame& frame_k_;
+  const VisualFrame* frame_k_;
   // Rotation matrix that describes the camera rotation between the
   // two frames that are matched.
-  const Quaternion& q_Ckp1_Ck_;
+  const Quaternion* q_Ckp1_Ck_;
   // Predicted locations of the keypoints in frame k
   // in frame (k+1) based on camera rotation.
-  const Eigen::Matrix2Xd& predicted_keypoint_positions_kp1_;
+  const Eigen::Matrix2Xd* predicted_keypoint_positions_kp1_;
   // Store prediction success for each keypoint of
   // frame k.
-  const std::vector<unsigned char>& prediction_success_;
-  // Descriptor size in bytes.
-  const size_t kDescriptorSizeBytes;
+  const std::vector<unsigned char>* prediction_success_;
+  // Search radius of each keypoint of frame k, null for the default windows.
+  const Eigen::VectorXd* search_radii_px_;
+  // Descriptor size in bytes and bits.
+  size_t descriptor_size_bytes_;
+  unsigned int descriptor_size_bits_;
+  // The distance kernel specialized for the descriptor size, null for the generic one.
+  common::Hamming::FixedSizeBatchFunction fixed_size_distance_function_;
+  // Descriptor distances are only computed exactly up to this bound.
+  int max_relevant_distance_;
   // Number of keypoints/descriptors in frame (k+1).
-  const int kNumPointsKp1;
+  int num_points_kp1_;
   // Number of keypoints/descriptors in frame k.
-  const int kNumPointsK;
+  int num_points_k_;
   const uint32_t kImageHeight;
 
   // Matches with scores with indices corresponding
   // to the ordering of the keypoint/descriptors in
   // the respective channels.
-  FrameToFrameMatchesWithScore* const matches_kp1_k_;
-  // Descriptors of frame (k+1).
-  std::vector<common::FeatureDescriptorConstRef> descriptors_kp1_wrapped_;
+  FrameToFrameMatchesWithScore* matches_kp1_k_;
   // Descriptors of frame k.
   std::vector<common::FeatureDescriptorConstRef> descriptors_k_wrapped_;
-  // Keypoints of frame (k+1) sorted from small to large y coordinates.
+  // Keypoints of frame (k+1) sorted by image row, in the order of the grid below.
   Aligned<std::vector, KeypointData> keypoints_kp1_sorted_by_y_;
-  // corner_row_LUT[i] is the number of keypoints that has y position
-  // lower than i in the image.
-  std::vector<int> corner_row_LUT_;
+  // Grid with one cell per image row. The cell offset of row i is the number
+  // of keypoints that has y position lower than i in the image.
+  common::KeypointGrid keypoints_kp1_grid_;
+  // Scratch buffers holding the keypoints of frame (k+1) inside the current
+  // search window, their channel indices and descriptor distances.
+  std::vector<KeyPointIterator> window_keypoints_kp1_;
+  std::vector<int> window_indices_kp1_;
+  std::vector<int> window_distances_kp1_;
   // Remember matched keypoints of frame (k+1).
   std::vector<bool> is_keypoint_kp1_matched_;
-  // Map from keypoint indices of frame (k+1) to
-  // the corresponding match iterator.
-  std::unordered_map<int, MatchesIterator> kp1_idx_to_matches_iterator_map_;
+  std::vector<bool> is_inferior_keypoint_kp1_matched_;
+  // Map from keypoint indices of frame (k+1) to the index of the
+  // corresponding match in matches_kp1_k_.
+  std::vector<int> kp1_idx_to_match_index_;
   // Keep track of processed keypoints s.t. we don't process them again in the
-  // large window. Set every element to false for each keypoint (of frame k) iteration!
+  // large window. Only the flags set for a keypoint of frame k are reset afterwards.
   std::vector<bool> iteration_processed_keypoints_kp1_;
   // The queried keypoints in frame (k+1) and the corresponding
-  // matching score are stored for each attempted match.
-  // A map from the keypoint in frame k to the corresponding
-  // match data is created.
-  std::unordered_map<int, MatchData> idx_k_to_attempted_match_data_map_;
+  // matching score are stored for each attempted match in a flat pool.
+  // The match data of a keypoint in frame k is its range in the pool.
+  std::vector<KeyPointIterator> candidate_keypoints_kp1_;
+  std::vector<double> candidate_matching_scores_;
+  std::vector<MatchData> idx_k_to_attempted_match_data_;
   // Inferior matches are a subset of all attempted matches.
   // Remeber indices of keypoints in frame k that are deemed inferior matches.
   std::vector<int> inferior_match_keypoint_idx_k_;
+  // Keypoints of frame k to remove from the inferior matches after an iteration.
+  std::vector<bool> erase_inferior_match_keypoint_idx_k_;
+  // Coarse-to-fine mode: the selected keypoints of frame k, the predicted and the matched
+  // positions in frame (k+1) of their coarse matches, the inlier flags of the correction and the
+  // corrected predictions of all keypoints of frame k.
+  bool coarse_to_fine_enabled_;
+  std::vector<int> coarse_keypoint_indices_k_;
+  Aligned<std::vector, Eigen::Vector2d> coarse_predictions_kp1_;
+  Aligned<std::vector, Eigen::Vector2d> coarse_measurements_kp1_;
+  std::vector<unsigned char> is_coarse_inlier_;
+  std::vector<double> coarse_displacements_;
+  Eigen::Matrix2Xd corrected_predicted_keypoint_positions_kp1_;
+  // Cleared within a call once the deadline is close, the unmatched keypoints are then not
+  // searched in the large window.
+  bool large_window_search_enabled_;
 
   // Two descriptors could match if the number of matching bits normalized
   // with the descriptor length in bits is higher than this threshold.
@@ -191,11 +281,24 @@ class GyroTwoFrameMatcher {
   static constexpr int kLargeSearchDistance = 20;
   // Number of iterations to match inferior matches.
   static constexpr size_t kMaxNumInferiorIterations = 3u;
+  // The large windows are skipped once less than this fraction of the deadline budget is left.
+  static constexpr double kLargeWindowMinRemainingBudgetRatio = 0.25;
+  // The deadline is checked every that many keypoints of frame k.
+  static constexpr int kNumKeypointsPerDeadlineCheck = 64;
+  // Number of the strongest keypoints of frame k matched in the coarse-to-fine mode.
+  static constexpr size_t kNumCoarseKeypoints = 100u;
+  // Image space distance for the coarse matches.
+  static constexpr int kCoarseSearchDistance = 60;
+  // The correction is only applied if at least this many coarse matches agree with it.
+  static constexpr size_t kMinNumCoarseMatches = 10u;
+  // Inlier thresholds of the median translation and of the affine correction. [px]
+  static constexpr double kCoarseTranslationInlierThresholdPx = 10.0;
+  static constexpr double kCoarseAffineInlierThresholdPx = 3.0;
 };
 
-template <int WindowHalfSideLength>
-void GyroTwoFrameMatcher::getKeypointIteratorsInWindow(
+inline void GyroTwoFrameMatcher::getKeypointIteratorsInWindow(
     const Eigen::Vector2d& predicted_keypoint_position,
+    const int window_half_side_length,
     KeyPointIterator* it_keypoints_begin,
     KeyPointIterator* it_keypoints_end) const {
   CHECK_NOTNULL(it_keypoints_begin);
@@ -203,12 +306,14 @@ void GyroTwoFrameMatcher::getKeypointIteratorsInWindow(
 
   // Compute search area for LUT iterators row-wise.
   int LUT_index_top = clamp(0, kImageHeight - 1, static_cast<int>(
-      predicted_keypoint_position(1) + 0.5 - WindowHalfSideLength));
+      predicted_keypoint_position(1) + 0.5 - window_half_side_length));
   int LUT_index_bottom = clamp(0, kImageHeight - 1, static_cast<int>(
-      predicted_keypoint_position(1) + 0.5 + WindowHalfSideLength));
+      predicted_keypoint_position(1) + 0.5 + window_half_side_length));
 
-  *it_keypoints_begin = keypoints_kp1_sorted_by_y_.begin() + corner_row_LUT_[LUT_index_top];
-  *it_keypoints_end = keypoints_kp1_sorted_by_y_.begin() + corner_row_LUT_[LUT_index_bottom];
+  *it_keypoints_begin =
+      keypoints_kp1_sorted_by_y_.begin() + keypoints_kp1_grid_.getCellOffset(LUT_index_top);
+  *it_keypoints_end =
+      keypoints_kp1_sorted_by_y_.begin() + keypoints_kp1_grid_.getCellOffset(LUT_index_bottom);
 
   CHECK_LE(LUT_index_top, LUT_index_bottom);
   CHECK_GE(LUT_index_bottom, 0);
@@ -217,6 +322,12 @@ void GyroTwoFrameMatcher::getKeypointIteratorsInWindow(
   CHECK_LT(LUT_index_bottom, kImageHeight);
 }
 
+inline FrameToFrameMatchWithScore& GyroTwoFrameMatcher::getMatchOfKeypointKp1(
+    const int idx_kp1) {
+  DCHECK_GE(kp1_idx_to_match_index_[idx_kp1], 0);
+  return (*matches_kp1_k_)[kp1_idx_to_match_index_[idx_kp1]];
+}
+
 inline int GyroTwoFrameMatcher::clamp(
     const int lower, const int upper, const int in) const {
   return std::min<int>(std::max<int>(in, lower), upper);
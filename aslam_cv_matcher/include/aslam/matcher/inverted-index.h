@@ -0,0 +1,93 @@
+#ifndef ASLAM_CV_MATCHER_INVERTED_INDEX_H_
+#define ASLAM_CV_MATCHER_INVERTED_INDEX_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/reader-writer-lock.h>
+
+#include "aslam/matcher/vocabulary-tree.h"
+
+namespace aslam {
+class VisualFrame;
+class VisualNFrame;
+
+/// \class InvertedIndex
+/// \brief Inverted file over the words of a BinaryVocabularyTree for place recognition.
+///
+/// Every document, e.g. the descriptors of a frame, is inserted as its L1 normalized TF-IDF
+/// bag-of-words vector. The posting list of a word holds the documents containing it with their
+/// word weight, a query only visits the posting lists of its own words. The score of a document
+/// is the L1 similarity 1 - |q - d|_1 / 2 in [0, 1], which for normalized vectors is the sum of
+/// min(q_w, d_w) over the shared words. Insertions and queries are thread-safe, queries run
+/// concurrently with each other.
+class InvertedIndex {
+ public:
+  ASLAM_POINTER_TYPEDEFS(InvertedIndex);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(InvertedIndex);
+
+  typedef BinaryVocabularyTree::DescriptorsT DescriptorsT;
+  typedef BinaryVocabularyTree::WordId WordId;
+  typedef uint32_t DocumentId;
+  /// Sparse bag-of-words vector sorted by word.
+  typedef std::vector<std::pair<WordId, float>> BowVector;
+
+  struct QueryResult {
+    QueryResult() : document_id(0u), score(0.0) {}
+    QueryResult(DocumentId _document_id, double _score)
+        : document_id(_document_id), score(_score) {}
+    DocumentId document_id;
+    double score;
+  };
+  typedef std::vector<QueryResult> QueryResults;
+
+  /// The vocabulary must outlive the index.
+  explicit InvertedIndex(const BinaryVocabularyTree& vocabulary);
+
+  /// Insert a document, the ids are assigned consecutively starting at 0.
+  DocumentId addDocument(const DescriptorsT& descriptors);
+  DocumentId addFrame(const VisualFrame& frame);
+  /// All frames of the nframe form one document.
+  DocumentId addNFrame(const VisualNFrame& nframe);
+
+  /// Get the documents with the highest scores, sorted by decreasing score. Documents without
+  /// a shared word are never returned.
+  void query(const DescriptorsT& descriptors, size_t max_num_results,
+             QueryResults* results) const;
+  void queryFrame(const VisualFrame& frame, size_t max_num_results, QueryResults* results) const;
+  void queryNFrame(const VisualNFrame& nframe, size_t max_num_results,
+                   QueryResults* results) const;
+  /// Answer many queries. num_threads = 1 runs them on the calling thread, any other value on
+  /// the shared pool of common::parallelFor.
+  void queryBatch(const std::vector<DescriptorsT>& queries, size_t max_num_results,
+                  size_t num_threads, std::vector<QueryResults>* results) const;
+
+  /// The L1 normalized TF-IDF vector of the descriptors.
+  void computeBowVector(const DescriptorsT& descriptors, BowVector* bow_vector) const;
+
+  size_t numDocuments() const;
+  const BinaryVocabularyTree& getVocabulary() const { return vocabulary_; }
+
+ private:
+  DocumentId addBowVector(const BowVector& bow_vector);
+  void queryBowVector(const BowVector& bow_vector, size_t max_num_results,
+                      QueryResults* results) const;
+
+  struct Posting {
+    DocumentId document_id;
+    float weight;
+  };
+
+  const BinaryVocabularyTree& vocabulary_;
+
+  mutable ReaderWriterMutex mutex_;
+  /// Posting list of every word, sorted by document.
+  std::vector<std::vector<Posting>> posting_lists_;
+  size_t num_documents_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_CV_MATCHER_INVERTED_INDEX_H_
@@ -0,0 +1,105 @@
+#ifndef ASLAM_CV_MATCHER_KEYPOINT_PREDICTION_CACHE_H_
+#define ASLAM_CV_MATCHER_KEYPOINT_PREDICTION_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/pose-types.h>
+#include <Eigen/Core>
+
+#include "aslam/matcher/match.h"
+
+namespace aslam {
+class VisualFrame;
+
+/// \class KeypointPredictionCache
+/// \brief Predicts the keypoints of the next frame from the gyro rotation plus the image
+///        velocity of every track, with a search radius per keypoint.
+///
+/// The rotation-only prediction of predictKeypointsByRotation(...) misses the flow induced by
+/// translation, hence the search windows have to absorb it for all keypoints. The cache keeps
+/// the residual image velocity of every track, i.e. its measured flow minus the flow predicted
+/// from the rotation, and adds it to the rotation-only prediction. The search radius grows with
+/// the expected error of this prediction, keypoints of tracks without history get the maximum
+/// radius. The radii are meant for GyroTwoFrameMatcher::match(...) and
+/// MatchingProblemFrameToFrame::setBananaPredictions(...).
+///
+/// Usage per frame: predictKeypoints(...) for frame k, match, apply the matches to the track ids
+/// of frame (k+1) and then update(...) with the matches. Not thread-safe.
+class KeypointPredictionCache {
+ public:
+  ASLAM_POINTER_TYPEDEFS(KeypointPredictionCache);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(KeypointPredictionCache);
+
+  struct Options {
+    Options()
+        : min_search_radius_px(4.0), max_search_radius_px(20.0), base_uncertainty_px(2.0),
+          velocity_uncertainty_ratio(0.5), velocity_smoothing(0.5), max_num_missed_updates(2u) {}
+    /// Bounds of the search radius.
+    double min_search_radius_px;
+    double max_search_radius_px;
+    /// The radius of a track with history is the base uncertainty plus this ratio of the
+    /// predicted residual flow, which covers changes of the velocity between frames.
+    double base_uncertainty_px;
+    double velocity_uncertainty_ratio;
+    /// Weight of the newest velocity measurement in the exponential smoothing, in (0, 1].
+    double velocity_smoothing;
+    /// Tracks that were not updated this many times in a row are dropped.
+    size_t max_num_missed_updates;
+  };
+
+  explicit KeypointPredictionCache(const Options& options);
+  virtual ~KeypointPredictionCache() {}
+
+  /// \brief Predict the keypoints of frame_k in frame (k+1).
+  /// @param[in]  frame_k               The frame whose keypoints are predicted. Tracks are
+  ///                                   looked up by its track ids, if any.
+  /// @param[in]  q_Ckp1_Ck             Rotation between the two frames, e.g. from the gyro.
+  /// @param[in]  timestamp_kp1_nanoseconds  Timestamp of frame (k+1).
+  /// @param[out] predicted_keypoints_kp1    Predictions, the keypoint of frame k if failed.
+  /// @param[out] prediction_success    Whether the rotation-only prediction succeeded.
+  /// @param[out] search_radii_px       Search radius of every predicted keypoint.
+  void predictKeypoints(const VisualFrame& frame_k, const Quaternion& q_Ckp1_Ck,
+                        int64_t timestamp_kp1_nanoseconds,
+                        Eigen::Matrix2Xd* predicted_keypoints_kp1,
+                        std::vector<unsigned char>* prediction_success,
+                        Eigen::VectorXd* search_radii_px);
+
+  /// \brief Update the velocities of the matched tracks with the measured keypoints of frame
+  ///        (k+1). Must follow predictKeypoints(...) for the frame k of the matches, and the
+  ///        matched keypoints of frame (k+1) must already carry their track ids.
+  void update(const VisualFrame& frame_kp1, const FrameToFrameMatches& matches_kp1_k);
+
+  /// Drop all tracks, e.g. after a tracking failure.
+  void clear();
+
+  size_t numTracks() const { return tracks_.size(); }
+  const Options& getOptions() const { return options_; }
+
+ private:
+  struct TrackState {
+    TrackState() : num_missed_updates(0u) {}
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    /// Image velocity not explained by the rotation. [px/s]
+    Eigen::Vector2d residual_velocity_px_per_second;
+    size_t num_missed_updates;
+  };
+
+  const Options options_;
+  std::unordered_map<int, TrackState, std::hash<int>, std::equal_to<int>,
+                     Eigen::aligned_allocator<std::pair<const int, TrackState>>> tracks_;
+
+  /// State of the last prediction, used by update(...).
+  Eigen::Matrix2Xd rotation_predicted_keypoints_kp1_;
+  std::vector<unsigned char> rotation_prediction_success_;
+  int64_t timestamp_k_nanoseconds_;
+  int64_t timestamp_kp1_nanoseconds_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_CV_MATCHER_KEYPOINT_PREDICTION_CACHE_H_
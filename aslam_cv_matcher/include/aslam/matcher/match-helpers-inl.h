@@ -38,6 +38,57 @@ void convertMatchesWithScoreToOpenCvMatches(
   CHECK_EQ(matches_with_score_A_B.size(), matches_A_B->size());
 }
 
+template <typename MatchWithScore>
+void convertMatchesWithScoreToCompactMatches(
+    const Aligned<std::vector, MatchWithScore>& matches_with_score_A_B,
+    CompactMatchesWithScore* matches_A_B) {
+  CHECK_NOTNULL(matches_A_B)->clear();
+  matches_A_B->reserve(matches_with_score_A_B.size());
+  for (const MatchWithScore& match : matches_with_score_A_B) {
+    CHECK_GE(match.getIndexApple(), 0) << "The apple index is negative.";
+    CHECK_GE(match.getIndexBanana(), 0) << "The banana index is negative.";
+    matches_A_B->emplace_back(match.getIndexApple(), match.getIndexBanana(), match.getScore());
+  }
+}
+
+template <typename MatchWithScore>
+void convertCompactMatchesToMatchesWithScore(
+    const CompactMatchesWithScore& matches_A_B,
+    Aligned<std::vector, MatchWithScore>* matches_with_score_A_B) {
+  CHECK_NOTNULL(matches_with_score_A_B)->clear();
+  const size_t num_matches = matches_A_B.size();
+  matches_with_score_A_B->reserve(num_matches);
+  for (size_t match_idx = 0u; match_idx < num_matches; ++match_idx) {
+    matches_with_score_A_B->emplace_back(static_cast<int>(matches_A_B.getIndexApple(match_idx)),
+                                         static_cast<int>(matches_A_B.getIndexBanana(match_idx)),
+                                         static_cast<double>(matches_A_B.getScore(match_idx)));
+  }
+}
+
+template <typename Match>
+void convertCompactMatchesToMatches(
+    const CompactMatchesWithScore& compact_matches_A_B, Aligned<std::vector, Match>* matches_A_B) {
+  CHECK_NOTNULL(matches_A_B)->clear();
+  const size_t num_matches = compact_matches_A_B.size();
+  matches_A_B->reserve(num_matches);
+  for (size_t match_idx = 0u; match_idx < num_matches; ++match_idx) {
+    matches_A_B->emplace_back(static_cast<size_t>(compact_matches_A_B.getIndexApple(match_idx)),
+                              static_cast<size_t>(compact_matches_A_B.getIndexBanana(match_idx)));
+  }
+}
+
+inline void convertCompactMatchesToOpenCvMatches(
+    const CompactMatchesWithScore& compact_matches_A_B, OpenCvMatches* matches_A_B) {
+  CHECK_NOTNULL(matches_A_B)->clear();
+  const size_t num_matches = compact_matches_A_B.size();
+  matches_A_B->reserve(num_matches);
+  for (size_t match_idx = 0u; match_idx < num_matches; ++match_idx) {
+    matches_A_B->emplace_back(static_cast<int>(compact_matches_A_B.getIndexApple(match_idx)),
+                              static_cast<int>(compact_matches_A_B.getIndexBanana(match_idx)),
+                              compact_matches_A_B.getScore(match_idx));
+  }
+}
+
 inline void convertMatchesWithScoreToMatches(
     const MatchesWithScore& matches_with_score_A_B, Matches* matches_A_B) {
   convertMatchesWithScoreToMatches<MatchWithScore, Match>(
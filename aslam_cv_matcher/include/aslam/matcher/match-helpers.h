@@ -3,6 +3,7 @@
 
 #include <aslam/common/pose-types.h>
 
+#include "aslam/matcher/compact-matches.h"
 #include "aslam/matcher/match.h"
 
 namespace aslam {
@@ -34,6 +35,27 @@ void convertMatchesWithScoreToOpenCvMatches(
     const Aligned<std::vector, MatchWithScore>& matches_with_score_A_B,
     OpenCvMatches* matches_A_B);
 
+/// Convert MatchesWithScore to the compact structure of arrays representation.
+template<typename MatchWithScore>
+void convertMatchesWithScoreToCompactMatches(
+    const Aligned<std::vector, MatchWithScore>& matches_with_score_A_B,
+    CompactMatchesWithScore* matches_A_B);
+
+/// Convert compact matches to (derived) MatchesWithScore, e.g. FrameToFrameMatchesWithScore.
+template<typename MatchWithScore>
+void convertCompactMatchesToMatchesWithScore(
+    const CompactMatchesWithScore& matches_A_B,
+    Aligned<std::vector, MatchWithScore>* matches_with_score_A_B);
+
+/// Convert compact matches to (derived) Matches without scores.
+template<typename Match>
+void convertCompactMatchesToMatches(
+    const CompactMatchesWithScore& compact_matches_A_B, Aligned<std::vector, Match>* matches_A_B);
+
+/// Convert compact matches to cv::DMatches.
+inline void convertCompactMatchesToOpenCvMatches(
+    const CompactMatchesWithScore& compact_matches_A_B, OpenCvMatches* matches_A_B);
+
 /// Select and return N random matches for each camera in the rig.
 void pickNRandomRigMatches(
     size_t n_per_camera, const FrameToFrameMatchesList& rig_matches,
@@ -12,6 +12,7 @@
 #include <opencv2/features2d/features2d.hpp>
 
 namespace aslam {
+class CompactMatchesWithScore;
 class VisualFrame;
 class VisualNFrame;
 
@@ -34,8 +35,14 @@ struct MatchWithScore {
   friend void convertMatchesWithScoreToOpenCvMatches(
       const Aligned<std::vector, MatchWithScore>& matches_with_score_A_B,
       OpenCvMatches* matches_A_B);
+  template <typename MatchWithScore>
+  friend void convertMatchesWithScoreToCompactMatches(
+      const Aligned<std::vector, MatchWithScore>& matches_with_score_A_B,
+      CompactMatchesWithScore* matches_A_B);
   FRIEND_TEST(TestMatcherExclusive, ExclusiveMatcher);
   FRIEND_TEST(TestMatcher, GreedyMatcher);
+  FRIEND_TEST(TestMatcherCrossCheck, CrossCheckMatcher);
+  FRIEND_TEST(TestMatcherCrossCheck, RatioTest);
   template<typename MatchingProblem> friend class MatchingEngineGreedy;
 
   /// \brief Initialize to an invalid match.
@@ -136,6 +143,10 @@ ASLAM_CREATE_MATCH_TYPES_WITH_ALIASES(
     FrameToFrame, getKeypointIndexAppleFrame, getKeypointIndexBananaFrame);
 ASLAM_CREATE_MATCH_TYPES_WITH_ALIASES(
     LandmarksToFrame, getKeypointIndex, getLandmarkIndex);
+ASLAM_CREATE_MATCH_TYPES_WITH_ALIASES(
+    FrameToIndex, getDescriptorId, getKeypointIndex);
+ASLAM_CREATE_MATCH_TYPES_WITH_ALIASES(
+    NFrameToNFrame, getKeypointIndexAppleNFrame, getKeypointIndexBananaNFrame);
 }  // namespace aslam
 
 #endif // ASLAM_MATCH_H_
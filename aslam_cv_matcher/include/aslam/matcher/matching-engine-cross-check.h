@@ -0,0 +1,184 @@
+#ifndef ASLAM_CV_MATCHING_ENGINE_CROSS_CHECK_H_
+#define ASLAM_CV_MATCHING_ENGINE_CROSS_CHECK_H_
+
+#include <limits>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <glog/logging.h>
+
+#include "aslam/matcher/matching-engine.h"
+
+/// \addtogroup Matching
+/// @{
+///
+/// @}
+
+namespace aslam {
+
+/// \brief Matching engine that only returns mutual best matches: the apple is the best candidate
+///        of the banana and the banana is the best candidate of the apple.
+///
+/// The candidates of all bananas are retrieved once and form a sparse score table restricted to
+/// the search window of the problem. The best apple of every banana and the best banana of every
+/// apple are both derived from this table in parallel, hence the descriptor distances are only
+/// computed once instead of running an exclusive engine in both directions.
+///
+/// Optionally, a ratio test rejects a best candidate if the second best candidate of the same
+/// priority is similar. The test compares the distances (1 - score), which assumes scores in
+/// [0, 1] with 1 for identical descriptors as the descriptor matching problems compute them.
+template<typename MatchingProblem>
+class MatchingEngineCrossCheck : public MatchingEngine<MatchingProblem> {
+ public:
+  using MatchingEngine<MatchingProblem>::match;
+  ASLAM_POINTER_TYPEDEFS(MatchingEngineCrossCheck);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(MatchingEngineCrossCheck);
+
+  MatchingEngineCrossCheck() : ratio_threshold_(1.0) {};
+  explicit MatchingEngineCrossCheck(size_t num_threads)
+      : MatchingEngine<MatchingProblem>(num_threads), ratio_threshold_(1.0) {};
+  /// @param[in] num_threads     Number of threads for the per-banana and per-apple work.
+  /// @param[in] ratio_threshold A best candidate is only accepted if its distance is smaller
+  ///                            than ratio_threshold times the distance of the second best
+  ///                            candidate. 1 disables the ratio test.
+  MatchingEngineCrossCheck(size_t num_threads, double ratio_threshold)
+      : MatchingEngine<MatchingProblem>(num_threads), ratio_threshold_(1.0) {
+    setRatioThreshold(ratio_threshold);
+  };
+  virtual ~MatchingEngineCrossCheck() {};
+
+  virtual bool match(MatchingProblem* problem,
+                     typename MatchingProblem::MatchesWithScore* matches_A_B);
+
+  void setRatioThreshold(double ratio_threshold) {
+    CHECK_GT(ratio_threshold, 0.0);
+    CHECK_LE(ratio_threshold, 1.0);
+    ratio_threshold_ = ratio_threshold;
+  }
+  double getRatioThreshold() const { return ratio_threshold_; }
+
+ private:
+  typedef typename MatchingProblem::Candidate Candidate;
+  static constexpr size_t kNoCandidate = std::numeric_limits<size_t>::max();
+
+  /// Tracks the best and the second best candidate of the same priority.
+  struct BestCandidates {
+    BestCandidates() : best(nullptr), second_best(nullptr) {}
+    void add(const Candidate* candidate) {
+      if (best == nullptr || *candidate > *best) {
+        second_best = (best != nullptr && best->priority == candidate->priority) ? best : nullptr;
+        best = candidate;
+      } else if (candidate->priority == best->priority &&
+          (second_best == nullptr || candidate->score > second_best->score)) {
+        second_best = candidate;
+      }
+    }
+    const Candidate* best;
+    const Candidate* second_best;
+  };
+
+  /// Offset of the accepted best candidate in candidates_ or kNoCandidate.
+  size_t getAcceptedOffset(const BestCandidates& best_candidates) const {
+    if (best_candidates.best == nullptr) {
+      return kNoCandidate;
+    }
+    if (ratio_threshold_ < 1.0 && best_candidates.second_best != nullptr &&
+        !(1.0 - best_candidates.best->score <
+            ratio_threshold_ * (1.0 - best_candidates.second_best->score))) {
+      return kNoCandidate;
+    }
+    return static_cast<size_t>(best_candidates.best - &candidates_[0u]);
+  }
+
+  double ratio_threshold_;
+
+  /// Buffers kept across calls, such that matching does not allocate once they are large enough.
+  typename MatchingProblem::FlatCandidatesList candidates_;
+  /// The candidates of apple i are the offsets [apple_candidate_begin_[i],
+  /// apple_candidate_begin_[i + 1]) of apple_candidate_offsets_, in banana order.
+  std::vector<size_t> apple_candidate_begin_;
+  std::vector<size_t> apple_candidate_offsets_;
+  std::vector<size_t> apple_fill_position_;
+  /// Offsets of the best candidate in candidates_ for every banana and every apple.
+  std::vector<size_t> best_candidate_for_banana_;
+  std::vector<size_t> best_candidate_for_apple_;
+};
+
+template<typename MatchingProblem>
+constexpr size_t MatchingEngineCrossCheck<MatchingProblem>::kNoCandidate;
+
+template<typename MatchingProblem>
+bool MatchingEngineCrossCheck<MatchingProblem>::match(
+    MatchingProblem* problem, typename MatchingProblem::MatchesWithScore* matches_A_B) {
+  CHECK_NOTNULL(problem);
+  CHECK_NOTNULL(matches_A_B);
+  matches_A_B->clear();
+  if (!problem->doSetup()) {
+    LOG(ERROR) << "Setting up the matching problem (.doSetup()) failed.";
+    return false;
+  }
+  const size_t num_apples = problem->numApples();
+  const size_t num_bananas = problem->numBananas();
+
+  this->getCandidates(problem, &candidates_);
+  CHECK_EQ(candidates_.numBananas(), num_bananas) << "The size of the candidates list does not "
+      << "match the number of bananas of the problem. getCandidates(...) of the given matching "
+      << "problem is supposed to return a vector of candidates for each banana and hence the "
+      << "size of the returned vector must match the number of bananas.";
+  const size_t num_candidates = candidates_.numCandidates();
+
+  // Transpose the candidates into per-apple lists of candidate offsets.
+  apple_candidate_begin_.assign(num_apples + 1u, 0u);
+  for (size_t offset = 0u; offset < num_candidates; ++offset) {
+    const int apple_idx = candidates_[offset].index_apple;
+    CHECK_GE(apple_idx, 0);
+    CHECK_LT(static_cast<size_t>(apple_idx), num_apples);
+    ++apple_candidate_begin_[apple_idx + 1];
+  }
+  for (size_t apple_idx = 0u; apple_idx < num_apples; ++apple_idx) {
+    apple_candidate_begin_[apple_idx + 1u] += apple_candidate_begin_[apple_idx];
+  }
+  apple_fill_position_.assign(apple_candidate_begin_.begin(), apple_candidate_begin_.end() - 1);
+  apple_candidate_offsets_.resize(num_candidates);
+  for (size_t offset = 0u; offset < num_candidates; ++offset) {
+    apple_candidate_offsets_[apple_fill_position_[candidates_[offset].index_apple]++] = offset;
+  }
+
+  // Best candidates in both directions, each index only writes its own entry.
+  best_candidate_for_banana_.resize(num_bananas);
+  this->forEachBanana(num_bananas, [this](size_t banana_idx) {
+    BestCandidates best_candidates;
+    for (const Candidate* candidate = candidates_.begin(banana_idx);
+        candidate != candidates_.end(banana_idx); ++candidate) {
+      best_candidates.add(candidate);
+    }
+    best_candidate_for_banana_[banana_idx] = getAcceptedOffset(best_candidates);
+  });
+  best_candidate_for_apple_.resize(num_apples);
+  this->forEachBanana(num_apples, [this](size_t apple_idx) {
+    BestCandidates best_candidates;
+    for (size_t i = apple_candidate_begin_[apple_idx]; i < apple_candidate_begin_[apple_idx + 1u];
+        ++i) {
+      best_candidates.add(&candidates_[apple_candidate_offsets_[i]]);
+    }
+    best_candidate_for_apple_[apple_idx] = getAcceptedOffset(best_candidates);
+  });
+
+  // Keep the mutual best matches.
+  for (size_t banana_idx = 0u; banana_idx < num_bananas; ++banana_idx) {
+    const size_t offset = best_candidate_for_banana_[banana_idx];
+    if (offset == kNoCandidate) {
+      continue;
+    }
+    const Candidate& candidate = candidates_[offset];
+    if (best_candidate_for_apple_[candidate.index_apple] == offset) {
+      matches_A_B->emplace_back(candidate.index_apple, banana_idx, candidate.score);
+    }
+  }
+  VLOG(10) << "Cross-checked " << matches_A_B->size() << " matches from " << num_candidates
+      << " candidates.";
+  return true;
+}
+
+}  // namespace aslam
+#endif // ASLAM_CV_MATCHING_ENGINE_CROSS_CHECK_H_
@@ -1,10 +1,13 @@
 #ifndef ASLAM_CV_MATCHINGENGINE_EXCLUSIVE_H_
 #define ASLAM_CV_MATCHINGENGINE_EXCLUSIVE_H_
+#include <algorithm>
+#include <functional>
 #include <vector>
 
 #include <glog/logging.h>
 #include <gtest/gtest_prod.h>
 
+#include <aslam/common/allocation-counter.h>
 #include <aslam/common/macros.h>
 #include <aslam/common/memory.h>
 #include <aslam/common/timer.h>
@@ -36,21 +39,33 @@ class MatchingEngineExclusive : public MatchingEngine<MatchingProblem> {
   ASLAM_DISALLOW_EVIL_CONSTRUCTORS(MatchingEngineExclusive);
 
   MatchingEngineExclusive() {};
+  explicit MatchingEngineExclusive(size_t num_threads)
+      : MatchingEngine<MatchingProblem>(num_threads) {};
   virtual ~MatchingEngineExclusive() {};
 
   virtual bool match(MatchingProblem* problem,
-                     typename MatchingProblem::MatchesWithScore* matches_A_B);
+                     typename MatchingProblem::MatchesWithScore* matches_A_B) {
+    return matchInto(problem, matches_A_B);
+  }
+  virtual bool match(MatchingProblem* problem, CompactMatchesWithScore* matches_A_B) {
+    return matchInto(problem, matches_A_B);
+  }
 
 private:
+  /// Writes the matches into either MatchesWithScore or CompactMatchesWithScore.
+  template<typename MatchesWithScoreType>
+  bool matchInto(MatchingProblem* problem, MatchesWithScoreType* matches_A_B);
+
   /// \brief Recursively assigns the next best apple to the given banana.
   inline void assignBest(int index_banana) {
     CHECK_GE(index_banana, 0);
 
     // Iterate through the next best apple candidates to find the next best fit (if any).
-    for (; iterator_to_next_best_apple_[index_banana] != candidates_[index_banana].end();
-        ++(iterator_to_next_best_apple_[index_banana])) {
-      const size_t next_best_apple_for_this_banana =
-          iterator_to_next_best_apple_[index_banana]->index_apple;
+    size_t& next_best_candidate = next_best_candidate_[index_banana];
+    const size_t end_candidate = candidates_.getEndOffset(index_banana);
+    for (; next_best_candidate < end_candidate; ++next_best_candidate) {
+      const typename MatchingProblem::Candidate& candidate = candidates_[next_best_candidate];
+      const size_t next_best_apple_for_this_banana = candidate.index_apple;
       CHECK_LT(next_best_apple_for_this_banana, temporary_matches_.size());
 
       // Write access to the next candidate.
@@ -59,12 +74,12 @@ private:
 
       if (temporary_candidate.index_apple < 0) {
         // Apple is still available. Assign the current candidate to this apple.
-        temporary_candidate = *iterator_to_next_best_apple_[index_banana];
+        temporary_candidate = candidate;
         break;
-      } else if (temporary_candidate < *iterator_to_next_best_apple_[index_banana]) {
+      } else if (temporary_candidate < candidate) {
         // Apple is already assigned, but this one is better.
         const int lonely_banana = temporary_candidate.index_banana;
-        temporary_candidate = *iterator_to_next_best_apple_[index_banana];
+        temporary_candidate = candidate;
         // Recursively look for an alternative for the lonely banana.
         assignBest(lonely_banana);
         break;
@@ -72,28 +87,29 @@ private:
     }
   }
 
-  /// \brief List of sorted candidates for a given banana. (i.e. candidates_[banana_index] refers
-  ///        to a list of apples sorted wrt. the matching score (note: it's sorted bottom-up, so
-  ///        .begin() points to the worst apple match for this banana. use .rbegin() instead to get
-  ///        best candidate.)
-  typename MatchingProblem::CandidatesList candidates_;
+  /// \brief Candidates of all bananas, the candidates of every banana are sorted by descending
+  ///        matching score. Kept across calls such that matching does not allocate once the
+  ///        buffers are large enough.
+  typename MatchingProblem::FlatCandidatesList candidates_;
 
   /// \brief The temporary matches assigned to each apple. (i.e. temporary_matches_[apple_index]
   ///        returns the current match for this apple. May change during the assignment procedure.
   typename MatchingProblem::Candidates temporary_matches_;
 
-  /// \brief Iterators to the next best apple candidate for each banana.
-  ///        (i.e. iterator_to_next_best_apple_[banana_index] points to the next best candidate
-  ///        for the given banana. Points to candiates_[banana_index].end() if no next best
-  ///        candidate available.
-  Aligned<std::vector, typename MatchingProblem::Candidates::iterator>
-      iterator_to_next_best_apple_;
+  /// \brief Offset of the next best apple candidate in candidates_ for each banana. Equals the
+  ///        end offset of the banana if no next best candidate is available.
+  std::vector<size_t> next_best_candidate_;
 };
 
 template<typename MatchingProblem>
-bool MatchingEngineExclusive<MatchingProblem>::match(
-    MatchingProblem* problem, typename MatchingProblem::MatchesWithScore* matches_A_B) {
-  timing::Timer method_timer("MatchingEngineExclusive<MatchingProblem>::match()");
+template<typename MatchesWithScoreType>
+bool MatchingEngineExclusive<MatchingProblem>::matchInto(
+    MatchingProblem* problem, MatchesWithScoreType* matches_A_B) {
+  // Looking the handle up once keeps the timer from allocating the tag on every call.
+  static const size_t kTimerHandle =
+      timing::Timing::GetHandle("MatchingEngineExclusive<MatchingProblem>::match()");
+  timing::Timer method_timer(kTimerHandle);
+  common::AllocationCounter allocation_counter("MatchingEngineExclusive::match");
 
   CHECK_NOTNULL(problem);
   CHECK_NOTNULL(matches_A_B);
@@ -103,8 +119,8 @@ bool MatchingEngineExclusive<MatchingProblem>::match(
     const size_t num_bananas = problem->numBananas();
     const size_t num_apples = problem->numApples();
 
-    problem->getCandidates(&candidates_);
-    CHECK_EQ(candidates_.size(), num_bananas) << "The size of the candidates list does not "
+    this->getCandidates(problem, &candidates_);
+    CHECK_EQ(candidates_.numBananas(), num_bananas) << "The size of the candidates list does not "
         << "match the number of bananas of the problem. getCandidates(...) of the given matching "
         << "problem is supposed to return a vector of candidates for each banana and hence the "
         << "size of the returned vector must match the number of bananas.";
@@ -112,16 +128,16 @@ bool MatchingEngineExclusive<MatchingProblem>::match(
     temporary_matches_.clear();
     temporary_matches_.resize(num_apples);
 
-    iterator_to_next_best_apple_.resize(num_bananas);
+    next_best_candidate_.resize(num_bananas);
 
-    // Collect all apple candidates for every banana.
-    for (size_t index_banana = 0; index_banana < num_bananas; ++index_banana) {
+    // The candidates of every banana are sorted independently, hence this can run in parallel.
+    this->forEachBanana(num_bananas, [this](size_t index_banana) {
       // Sorts the candidates in descending order.
-      std::sort(candidates_[index_banana].begin(), candidates_[index_banana].end(),
+      std::sort(candidates_.begin(index_banana), candidates_.end(index_banana),
                 std::greater<typename MatchingProblem::Candidate>());
 
-      iterator_to_next_best_apple_[index_banana] = candidates_[index_banana].begin();
-    }
+      next_best_candidate_[index_banana] = candidates_.getBeginOffset(index_banana);
+    });
 
     // Find the best apple for every banana.
     for (size_t index_banana = 0; index_banana < num_bananas; ++index_banana) {
@@ -1,6 +1,7 @@
 #ifndef ASLAM_CV_MATCHING_ENGINE_GREEDY_H_
 #define ASLAM_CV_MATCHING_ENGINE_GREEDY_H_
 
+#include <algorithm>
 #include <vector>
 
 #include <aslam/common/macros.h>
@@ -22,9 +23,16 @@ class MatchingEngineGreedy : public MatchingEngine<MatchingProblem> {
   ASLAM_DISALLOW_EVIL_CONSTRUCTORS(MatchingEngineGreedy);
 
   MatchingEngineGreedy() {};
+  explicit MatchingEngineGreedy(size_t num_threads)
+      : MatchingEngine<MatchingProblem>(num_threads) {};
   virtual ~MatchingEngineGreedy() {};
   virtual bool match(MatchingProblem* problem,
                      typename MatchingProblem::MatchesWithScore* matches_A_B);
+
+ private:
+  /// Buffers kept across calls, such that matching does not allocate once they are large enough.
+  typename MatchingProblem::FlatCandidatesList candidates_;
+  std::vector<unsigned char> is_apple_assigned_;
 };
 
 template<typename MatchingProblem>
@@ -37,40 +45,35 @@ bool MatchingEngineGreedy<MatchingProblem>::match(
     const size_t num_apples = problem->numApples();
     const size_t num_bananas = problem->numBananas();
 
-    typename MatchingProblem::CandidatesList candidates;
-    problem->getCandidates(&candidates);
-    CHECK_EQ(candidates.size(), num_bananas) << "The size of the candidates list does not "
+    this->getCandidates(problem, &candidates_);
+    CHECK_EQ(candidates_.numBananas(), num_bananas) << "The size of the candidates list does not "
         << "match the number of bananas of the problem. getCandidates(...) of the given matching "
         << "problem is supposed to return a vector of candidates for each banana and hence the "
         << "size of the returned vector must match the number of bananas.";
 
-    size_t total_num_candidates = 0u;
-    for (const typename MatchingProblem::Candidates& candidates_for_banana : candidates) {
-      total_num_candidates += candidates_for_banana.size();
-    }
-
-    matches_A_B->reserve(total_num_candidates);
+    matches_A_B->reserve(candidates_.numCandidates());
     for (size_t banana_idx = 0u; banana_idx < num_bananas; ++banana_idx) {
       // compute the score for each candidate and put in queue
-      for (const typename MatchingProblem::Candidate& candidate_for_banana :
-          candidates[banana_idx]) {
+      for (const typename MatchingProblem::Candidate* candidate_for_banana =
+          candidates_.begin(banana_idx); candidate_for_banana != candidates_.end(banana_idx);
+          ++candidate_for_banana) {
         matches_A_B->emplace_back(
-            candidate_for_banana.index_apple, banana_idx, candidate_for_banana.score);
+            candidate_for_banana->index_apple, banana_idx, candidate_for_banana->score);
       }
     }
     // Reverse sort with reverse iterators.
     std::sort(matches_A_B->rbegin(), matches_A_B->rend());
 
     // Compress the best unique match in place.
-    std::vector<unsigned char> is_apple_assigned(num_apples, false);
+    is_apple_assigned_.assign(num_apples, false);
 
     typename MatchingProblem::MatchesWithScore::iterator output_match_iterator =
         matches_A_B->begin();
     for (const typename MatchingProblem::MatchWithScore& match : *matches_A_B) {
       const int apple_index = match.getIndexApple();
 
-      if (!is_apple_assigned[apple_index]) {
-        is_apple_assigned[apple_index] = true;
+      if (!is_apple_assigned_[apple_index]) {
+        is_apple_assigned_[apple_index] = true;
         *output_match_iterator++ = match;
       }
     }
@@ -1,6 +1,7 @@
 #ifndef ASLAM_CV_MATCHINGENGINE_NON_EXCLUSIVE_H_
 #define ASLAM_CV_MATCHINGENGINE_NON_EXCLUSIVE_H_
 
+#include <algorithm>
 #include <set>
 #include <vector>
 
@@ -18,6 +19,11 @@ namespace aslam {
 
 /// \brief Matching engine to simply return the best apple for each banana.
 ///        This explicitly does not deal with bananas matching to multiple apples and vice versa.
+///
+/// Optionally returns the k best apples of every banana and applies a ratio test on the best
+/// two. Only the k (or two) best candidates of every banana are kept with a small sorted
+/// selection instead of sorting the candidate lists, and the candidates of problems supporting
+/// concurrent queries are already bounded during the retrieval.
 template<typename MatchingProblem>
 class MatchingEngineNonExclusive : public MatchingEngine<MatchingProblem> {
  public:
@@ -25,42 +31,122 @@ class MatchingEngineNonExclusive : public MatchingEngine<MatchingProblem> {
   ASLAM_POINTER_TYPEDEFS(MatchingEngineNonExclusive);
   ASLAM_DISALLOW_EVIL_CONSTRUCTORS(MatchingEngineNonExclusive);
 
-  MatchingEngineNonExclusive() {};
+  MatchingEngineNonExclusive() : max_matches_per_banana_(1u), ratio_threshold_(1.0) {};
+  explicit MatchingEngineNonExclusive(size_t num_threads)
+      : MatchingEngine<MatchingProblem>(num_threads), max_matches_per_banana_(1u),
+        ratio_threshold_(1.0) {};
+  /// @param[in] num_threads            Number of threads for the per-banana work.
+  /// @param[in] max_matches_per_banana Number of best apples returned for every banana.
+  /// @param[in] ratio_threshold        The matches of a banana are only accepted if the distance
+  ///                                   1 - score of the best candidate is smaller than
+  ///                                   ratio_threshold times the distance of the second best
+  ///                                   candidate of the same priority. For the descriptor
+  ///                                   matching problems this is the normalized Hamming
+  ///                                   distance. 1 disables the ratio test.
+  MatchingEngineNonExclusive(
+      size_t num_threads, size_t max_matches_per_banana, double ratio_threshold)
+      : MatchingEngine<MatchingProblem>(num_threads), max_matches_per_banana_(1u),
+        ratio_threshold_(1.0) {
+    setMaxMatchesPerBanana(max_matches_per_banana);
+    setRatioThreshold(ratio_threshold);
+  };
   virtual ~MatchingEngineNonExclusive() {};
   virtual bool match(MatchingProblem* problem,
-                     typename MatchingProblem::MatchesWithScore* matches_A_B);
+                     typename MatchingProblem::MatchesWithScore* matches_A_B) {
+    return matchInto(problem, matches_A_B);
+  }
+  virtual bool match(MatchingProblem* problem, CompactMatchesWithScore* matches_A_B) {
+    return matchInto(problem, matches_A_B);
+  }
+
+  void setMaxMatchesPerBanana(size_t max_matches_per_banana) {
+    CHECK_GT(max_matches_per_banana, 0u);
+    max_matches_per_banana_ = max_matches_per_banana;
+  }
+  size_t getMaxMatchesPerBanana() const { return max_matches_per_banana_; }
+
+  void setRatioThreshold(double ratio_threshold) {
+    CHECK_GT(ratio_threshold, 0.0);
+    CHECK_LE(ratio_threshold, 1.0);
+    ratio_threshold_ = ratio_threshold;
+  }
+  double getRatioThreshold() const { return ratio_threshold_; }
+
+ private:
+  typedef typename MatchingProblem::Candidate Candidate;
+
+  /// Writes the matches into either MatchesWithScore or CompactMatchesWithScore.
+  template<typename MatchesWithScoreType>
+  bool matchInto(MatchingProblem* problem, MatchesWithScoreType* matches_A_B);
+
+  /// The ratio test needs the second best candidate as well.
+  size_t getNumSelectedPerBanana() const {
+    return ratio_threshold_ < 1.0 ? std::max<size_t>(max_matches_per_banana_, 2u) :
+        max_matches_per_banana_;
+  }
+
+  /// Number of accepted matches of the selected candidates of a banana. The ratio test compares
+  /// the distances 1 - score, which are the normalized Hamming distances of the descriptor
+  /// matching problems.
+  size_t getNumAccepted(const Candidate* const* selected, size_t num_selected) const {
+    if (ratio_threshold_ < 1.0 && num_selected > 1u &&
+        selected[1]->priority == selected[0]->priority &&
+        !(1.0 - selected[0]->score < ratio_threshold_ * (1.0 - selected[1]->score))) {
+      return 0u;
+    }
+    return std::min(num_selected, max_matches_per_banana_);
+  }
+
+  size_t max_matches_per_banana_;
+  double ratio_threshold_;
+
+  /// Buffers kept across calls, such that matching does not allocate once they are large enough.
+  typename MatchingProblem::FlatCandidatesList candidates_;
+  /// The selected candidates of banana i start at i * getNumSelectedPerBanana().
+  std::vector<const Candidate*> selected_candidates_;
+  std::vector<size_t> num_accepted_;
 };
 
 template<typename MatchingProblem>
-bool MatchingEngineNonExclusive<MatchingProblem>::match(
-    MatchingProblem* problem, typename MatchingProblem::MatchesWithScore* matches_A_B) {
+template<typename MatchesWithScoreType>
+bool MatchingEngineNonExclusive<MatchingProblem>::matchInto(
+    MatchingProblem* problem, MatchesWithScoreType* matches_A_B) {
   CHECK_NOTNULL(problem);
   CHECK_NOTNULL(matches_A_B);
   matches_A_B->clear();
 
   if (problem->doSetup()) {
-    size_t num_bananas = problem->numBananas();
+    const size_t num_bananas = problem->numBananas();
+    const size_t num_selected_per_banana = getNumSelectedPerBanana();
 
-    typename MatchingProblem::CandidatesList candidates_for_bananas;
-    problem->getCandidates(&candidates_for_bananas);
-    CHECK_EQ(candidates_for_bananas.size(), num_bananas) << "The size of the candidates list does "
+    this->getCandidates(problem, &candidates_, num_selected_per_banana);
+    CHECK_EQ(candidates_.numBananas(), num_bananas) << "The size of the candidates list does "
         << "not match the number of bananas of the problem. getCandidates(...) of the given "
         << "matching problem is supposed to return a vector of candidates for each banana and "
         << "hence the size of the returned vector must match the number of bananas.";
-    for (size_t index_banana = 0u; index_banana < num_bananas; ++index_banana) {
-      const typename MatchingProblem::Candidates& candidates =
-          candidates_for_bananas[index_banana];
-
-      typename MatchingProblem::Candidates::const_iterator best_candidate = candidates.begin();
-      for (typename MatchingProblem::Candidates::const_iterator candidate_iterator =
-          candidates.begin(); candidate_iterator != candidates.end(); ++candidate_iterator) {
-        if (*candidate_iterator > *best_candidate) {
-          best_candidate = candidate_iterator;
-        }
-      }
 
-      if (best_candidate != candidates.end()) {
-        matches_A_B->emplace_back(best_candidate->index_apple, index_banana, best_candidate->score);
+    // Every banana only writes its own selection, hence this can run in parallel.
+    selected_candidates_.resize(num_bananas * num_selected_per_banana);
+    num_accepted_.resize(num_bananas);
+    this->forEachBanana(num_bananas, [this, num_selected_per_banana](size_t index_banana) {
+      const Candidate** selected = &selected_candidates_[index_banana * num_selected_per_banana];
+      const size_t num_selected = this->selectBestCandidates(
+          candidates_.begin(index_banana), candidates_.end(index_banana),
+          num_selected_per_banana, selected);
+      num_accepted_[index_banana] = getNumAccepted(selected, num_selected);
+    });
+
+    size_t num_matches = 0u;
+    for (size_t index_banana = 0u; index_banana < num_bananas; ++index_banana) {
+      num_matches += num_accepted_[index_banana];
+    }
+    matches_A_B->reserve(num_matches);
+    for (size_t index_banana = 0u; index_banana < num_bananas; ++index_banana) {
+      const Candidate* const* selected =
+          &selected_candidates_[index_banana * num_selected_per_banana];
+      for (size_t selected_idx = 0u; selected_idx < num_accepted_[index_banana]; ++selected_idx) {
+        matches_A_B->emplace_back(
+            selected[selected_idx]->index_apple, index_banana, selected[selected_idx]->score);
       }
     }
     return true;
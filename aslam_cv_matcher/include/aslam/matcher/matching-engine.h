@@ -1,7 +1,14 @@
 #ifndef ASLAM_CV_MATCHING_ENGINE_H_
 #define ASLAM_CV_MATCHING_ENGINE_H_
 
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <vector>
+
 #include <aslam/common/macros.h>
+#include <aslam/common/thread-pool.h>
+#include <glog/logging.h>
 
 #include "aslam/matcher/match-helpers.h"
 
@@ -15,7 +22,12 @@ class MatchingEngine {
   ASLAM_POINTER_TYPEDEFS(MatchingEngine);
   ASLAM_DISALLOW_EVIL_CONSTRUCTORS(MatchingEngine);
 
-  MatchingEngine() {};
+  MatchingEngine() : num_threads_(1u) {};
+  /// @param[in] num_threads Number of threads used for the per-banana work. The result does not
+  ///                        depend on the number of threads.
+  explicit MatchingEngine(size_t num_threads) : num_threads_(1u) {
+    setNumThreads(num_threads);
+  }
   virtual ~MatchingEngine() {};
 
   virtual bool match(
@@ -29,6 +41,186 @@ class MatchingEngine {
     convertMatchesWithScoreToMatches<MatchingProblem>(matches_with_score_A_B, matches_A_B);
     return success;
   }
+
+  /// \brief Match into the compact structure of arrays representation. Engines that do not
+  ///        write it directly convert their MatchesWithScore.
+  virtual bool match(MatchingProblem* problem, CompactMatchesWithScore* matches_A_B) {
+    CHECK_NOTNULL(problem);
+    CHECK_NOTNULL(matches_A_B);
+    typename MatchingProblem::MatchesWithScore matches_with_score_A_B;
+    const bool success = match(problem, &matches_with_score_A_B);
+    convertMatchesWithScoreToCompactMatches(matches_with_score_A_B, matches_A_B);
+    return success;
+  }
+
+  /// Sets the number of threads used for the per-banana work, 1 runs everything serially.
+  void setNumThreads(size_t num_threads) {
+    CHECK_GT(num_threads, 0u);
+    if (num_threads != num_threads_) {
+      num_threads_ = num_threads;
+      thread_pool_.reset();
+    }
+  }
+  size_t getNumThreads() const { return num_threads_; }
+
+ protected:
+  /// \brief Calls function(banana_index) for all bananas in [0, num_bananas). The bananas are
+  ///        split into contiguous blocks that are distributed over the thread pool if more than
+  ///        one thread is configured. The function must only write to per-banana state.
+  template<typename Function>
+  void forEachBanana(size_t num_bananas, const Function& function) {
+    forEachBananaBlock(num_bananas,
+                       [&function](size_t /*block_idx*/, size_t block_begin, size_t block_end) {
+      for (size_t banana_idx = block_begin; banana_idx < block_end; ++banana_idx) {
+        function(banana_idx);
+      }
+    });
+  }
+
+  /// \brief Calls function(block_index, block_begin, block_end) for the blocks of bananas of
+  ///        getBananaBlockSize(num_bananas) bananas, on the thread pool if more than one thread
+  ///        is configured. The function must only write to per-block state.
+  template<typename Function>
+  void forEachBananaBlock(size_t num_bananas, const Function& function) {
+    const size_t block_size = getBananaBlockSize(num_bananas);
+    const size_t num_blocks = (num_bananas + block_size - 1u) / block_size;
+    if (num_blocks <= 1u) {
+      if (num_bananas > 0u) {
+        function(0u, 0u, num_bananas);
+      }
+      return;
+    }
+    if (!thread_pool_) {
+      thread_pool_.reset(new ThreadPool(num_threads_));
+    }
+    std::vector<std::future<void>> block_futures;
+    for (size_t block_idx = 0u; block_idx < num_blocks; ++block_idx) {
+      const size_t block_begin = block_idx * block_size;
+      const size_t block_end = std::min(block_begin + block_size, num_bananas);
+      block_futures.emplace_back(thread_pool_->enqueue(
+          [&function, block_idx, block_begin, block_end]() {
+        function(block_idx, block_begin, block_end);
+      }));
+    }
+    for (std::future<void>& block_future : block_futures) {
+      CHECK(block_future.valid());
+      block_future.get();
+    }
+  }
+
+  /// Number of bananas per block of forEachBananaBlock(), all bananas form one block if the
+  /// engine runs serially.
+  size_t getBananaBlockSize(size_t num_bananas) const {
+    // Minimum number of bananas per block, smaller problems are not worth the dispatch.
+    constexpr size_t kMinNumBananasPerBlock = 32u;
+    // Blocks per thread, more than one to balance uneven candidate counts.
+    constexpr size_t kNumBlocksPerThread = 4u;
+    if (num_threads_ <= 1u || num_bananas <= kMinNumBananasPerBlock) {
+      return std::max<size_t>(num_bananas, 1u);
+    }
+    return std::max(kMinNumBananasPerBlock,
+                    (num_bananas + num_threads_ * kNumBlocksPerThread - 1u) /
+                        (num_threads_ * kNumBlocksPerThread));
+  }
+
+  /// \brief Selects the up to max_num_selected best candidates of [begin, end) in descending
+  ///        order, earlier candidates win ties. Keeps the selection sorted by insertion, hence
+  ///        this is meant for small bounds.
+  /// @param[out] selected Array of at least max_num_selected elements.
+  /// @return The number of selected candidates.
+  static size_t selectBestCandidates(
+      const typename MatchingProblem::Candidate* begin,
+      const typename MatchingProblem::Candidate* end, size_t max_num_selected,
+      const typename MatchingProblem::Candidate** selected) {
+    CHECK_GT(max_num_selected, 0u);
+    CHECK_NOTNULL(selected);
+    size_t num_selected = 0u;
+    for (const typename MatchingProblem::Candidate* candidate = begin; candidate != end;
+        ++candidate) {
+      if (num_selected == max_num_selected && !(*candidate > *selected[num_selected - 1u])) {
+        continue;
+      }
+      size_t position = num_selected < max_num_selected ? num_selected++ : num_selected - 1u;
+      for (; position > 0u && *candidate > *selected[position - 1u]; --position) {
+        selected[position] = selected[position - 1u];
+      }
+      selected[position] = candidate;
+    }
+    return num_selected;
+  }
+
+  /// \brief Retrieves the candidates of all bananas into the contiguous list, in parallel if the
+  ///        problem supports it. The parallel version counts and collects the candidates
+  ///        block-wise and then copies the blocks into place, hence the result equals the serial
+  ///        one. All buffers are reused across calls.
+  /// @param[in] max_candidates_per_banana If non-zero, only the best candidates of every banana
+  ///                                      are kept as selected by selectBestCandidates(...).
+  ///                                      Problems without concurrent candidate queries return
+  ///                                      all candidates regardless.
+  void getCandidates(MatchingProblem* problem,
+                     typename MatchingProblem::FlatCandidatesList* candidates,
+                     size_t max_candidates_per_banana = 0u) {
+    CHECK_NOTNULL(problem);
+    CHECK_NOTNULL(candidates);
+    const size_t num_bananas = problem->numBananas();
+    const size_t block_size = getBananaBlockSize(num_bananas);
+    const size_t num_blocks = (num_bananas + block_size - 1u) / block_size;
+    if ((num_blocks <= 1u && max_candidates_per_banana == 0u) ||
+        !problem->supportsConcurrentCandidateQueries()) {
+      problem->getCandidates(candidates);
+      return;
+    }
+    if (block_candidates_.size() < num_blocks) {
+      block_candidates_.resize(num_blocks);
+      block_query_buffers_.resize(num_blocks);
+      block_selection_buffers_.resize(num_blocks);
+    }
+
+    // Count pass: query the bananas and collect their (best) candidates per block.
+    candidates->resetCounts(num_bananas);
+    forEachBananaBlock(num_bananas, [this, problem, candidates, max_candidates_per_banana](
+        size_t block_idx, size_t block_begin, size_t block_end) {
+      typename MatchingProblem::Candidates& block_candidates = block_candidates_[block_idx];
+      typename MatchingProblem::Candidates& query_buffer = block_query_buffers_[block_idx];
+      std::vector<const typename MatchingProblem::Candidate*>& selection_buffer =
+          block_selection_buffers_[block_idx];
+      selection_buffer.resize(max_candidates_per_banana);
+      block_candidates.clear();
+      for (size_t banana_idx = block_begin; banana_idx < block_end; ++banana_idx) {
+        problem->getAppleCandidatesForBanana(banana_idx, &query_buffer);
+        if (max_candidates_per_banana == 0u) {
+          candidates->setNumCandidates(banana_idx, query_buffer.size());
+          block_candidates.insert(
+              block_candidates.end(), query_buffer.begin(), query_buffer.end());
+          continue;
+        }
+        const size_t num_selected = selectBestCandidates(
+            query_buffer.data(), query_buffer.data() + query_buffer.size(),
+            max_candidates_per_banana, selection_buffer.data());
+        candidates->setNumCandidates(banana_idx, num_selected);
+        for (size_t selected_idx = 0u; selected_idx < num_selected; ++selected_idx) {
+          block_candidates.push_back(*selection_buffer[selected_idx]);
+        }
+      }
+    });
+    candidates->allocateFromCounts();
+
+    // Fill pass: copy the blocks to their offsets.
+    forEachBananaBlock(num_bananas, [this, candidates](
+        size_t block_idx, size_t block_begin, size_t /*block_end*/) {
+      const typename MatchingProblem::Candidates& block_candidates = block_candidates_[block_idx];
+      std::copy(block_candidates.begin(), block_candidates.end(), candidates->begin(block_begin));
+    });
+  }
+
+ private:
+  size_t num_threads_;
+  /// Created lazily on the first parallel call and reused for subsequent matches.
+  std::unique_ptr<ThreadPool> thread_pool_;
+  /// Per-block buffers of the parallel candidate retrieval.
+  typename MatchingProblem::CandidatesList block_candidates_;
+  typename MatchingProblem::CandidatesList block_query_buffers_;
+  std::vector<std::vector<const typename MatchingProblem::Candidate*>> block_selection_buffers_;
 };
 
 }  // namespace aslam
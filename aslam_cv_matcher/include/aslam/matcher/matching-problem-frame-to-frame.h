@@ -6,14 +6,15 @@
 ///
 /// @}
 
-#include <map>
 #include <memory>
 #include <vector>
 
+#include <aslam/common/aligned-descriptors.h>
 #include <aslam/common/macros.h>
 #include <aslam/common/memory.h>
 #include <aslam/common/pose-types.h>
 #include <aslam/common/feature-descriptor-ref.h>
+#include <aslam/common/keypoint-grid.h>
 #include <Eigen/Core>
 
 #include "aslam/matcher/match.h"
@@ -59,6 +60,18 @@ public:
                               int hamming_distance_threshold);
   virtual ~MatchingProblemFrameToFrame() {};
 
+  /// \brief Use external predictions of the banana keypoints in the apple frame, e.g. from the
+  ///        KeypointPredictionCache, instead of the rotation-only projection, and search every
+  ///        banana within its own radius. The radii are bounded by the image space distance
+  ///        threshold. The arguments must outlive the matching and have one entry per banana.
+  /// @param[in]  A_predicted_keypoints_banana  Predicted banana keypoints in the apple frame.
+  /// @param[in]  prediction_success            Bananas whose prediction failed keep their
+  ///                                           rotation-only projection.
+  /// @param[in]  search_radii_px               Search radius of every banana.
+  void setBananaPredictions(const Eigen::Matrix2Xd& A_predicted_keypoints_banana,
+                            const std::vector<unsigned char>& prediction_success,
+                            const Eigen::VectorXd& search_radii_px);
+
   virtual size_t numApples() const;
   virtual size_t numBananas() const;
 
@@ -69,8 +82,14 @@ public:
   ///                         potentially match the given keypoint from the banana frame.
   virtual void getAppleCandidatesForBanana(int frame_banana_keypoint_index, Candidates* candidates);
 
+  /// Only reads the state built in doSetup(), hence bananas can be queried concurrently.
+  virtual bool supportsConcurrentCandidateQueries() const {
+    return true;
+  }
+
   inline double computeMatchScore(int hamming_distance) {
-    return static_cast<double>(384 - hamming_distance) / 384.0;
+    const double descriptor_size_bits = static_cast<double>(8u * descriptor_size_bytes_);
+    return (descriptor_size_bits - static_cast<double>(hamming_distance)) / descriptor_size_bits;
   }
 
   inline int computeHammingDistance(int banana_index, int apple_index) {
@@ -96,8 +115,24 @@ public:
     return common::GetNumBitsDifferent(banana_descriptor, apple_descriptor);
   }
 
+  /// \brief Computes the hamming distances between one banana and several apples at once.
+  ///
+  /// @param[in]  banana_index   Index of the (valid) banana.
+  /// @param[in]  apple_indices  Indices of the (valid) apples to compare against.
+  /// @param[out] distances      Hamming distances in the order of apple_indices.
+  void computeHammingDistancesBatch(int banana_index, const std::vector<int>& apple_indices,
+                                    std::vector<int>* distances) const;
+
+  /// \brief Same as above, but the distances are only exact up to max_distance. Larger
+  ///        distances are reported as some value above max_distance, which saves the work
+  ///        for the many apples that are far from the banana descriptor.
+  void computeHammingDistancesBatchBounded(int banana_index,
+                                           const std::vector<int>& apple_indices,
+                                           int max_distance,
+                                           std::vector<int>* distances) const;
+
   /// \brief Gets called at the beginning of the matching problem.
-  /// Creates a y-coordinate LUT for all apple keypoints and projects all banana keypoints into the
+  /// Sorts all valid apple keypoints into a grid and projects all banana keypoints into the
   /// apple frame.
   virtual bool doSetup();
 
@@ -108,8 +143,10 @@ private:
   const VisualFrame& banana_frame_;
   /// Rotation matrix taking vectors from the banana frame into the apple frame.
   aslam::Quaternion q_A_B_;
-  /// Map mapping y coordinates in the image plane onto keypoint indices of apple keypoints.
-  std::multimap<size_t, size_t> y_coordinate_to_apple_keypoint_index_map_;
+  /// Grid over the image plane holding the valid apple keypoints for the radius lookup.
+  common::KeypointGrid apple_keypoint_grid_;
+  /// Whether the apple grid was built for the current apple frame.
+  bool is_apple_keypoint_grid_built_;
 
   /// Index marking apples as valid or invalid.
   std::vector<bool> valid_apples_;
@@ -125,15 +162,23 @@ private:
   /// The banana descriptors.
   std::vector<common::FeatureDescriptorConstRef> banana_descriptors_;
 
+  /// Copies of the descriptors in the padded layout used for the batched distance computation.
+  common::AlignedDescriptors aligned_apple_descriptors_;
+  common::AlignedDescriptors aligned_banana_descriptors_;
+
   /// Descriptor size in bytes.
   size_t descriptor_size_bytes_;
-
-  /// Half width of the vertical band used for match lookup in pixels.
-  int vertical_band_halfwidth_pixels_;
+  /// The distance kernel specialized for the descriptor size, null for the generic one.
+  common::Hamming::FixedSizeBatchFunction fixed_size_distance_function_;
 
   /// Pairs with image space distance >= image_space_distance_threshold_pixels_ are
   /// excluded from matches.
-  double squared_image_space_distance_threshold_px_sq_;
+  double image_space_distance_threshold_pixels_;
+
+  /// The optional external banana predictions, see setBananaPredictions(...).
+  const Eigen::Matrix2Xd* A_predicted_keypoints_banana_;
+  const std::vector<unsigned char>* banana_prediction_success_;
+  const Eigen::VectorXd* banana_search_radii_px_;
 
   /// Pairs with descriptor distance >= hamming_distance_threshold_ are
   /// excluded from matches.
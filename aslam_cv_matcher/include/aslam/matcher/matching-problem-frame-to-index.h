@@ -0,0 +1,82 @@
+#ifndef ASLAM_CV_MATCHING_PROBLEM_FRAME_TO_INDEX_H_
+#define ASLAM_CV_MATCHING_PROBLEM_FRAME_TO_INDEX_H_
+
+/// \addtogroup Matching
+/// @{
+///
+/// @}
+
+#include <vector>
+
+#include <aslam/common/aligned-descriptors.h>
+#include <aslam/common/macros.h>
+
+#include "aslam/matcher/match.h"
+#include "aslam/matcher/matching-problem.h"
+#include "aslam/matcher/multi-index-hashing.h"
+
+namespace aslam {
+class VisualFrame;
+
+/// \class MatchingProblemFrameToIndex
+/// \brief Matches the keypoints of a frame against a large set of descriptors, e.g. of a map,
+///        held in a MultiIndexHashingDescriptorIndex.
+///
+/// The apples are the descriptors of the index, referenced by their id. The bananas are the
+/// keypoints of the frame. The candidates of a banana are its num_neighbors nearest descriptors
+/// within the Hamming distance threshold. The index must not be modified during matching.
+class MatchingProblemFrameToIndex : public MatchingProblem {
+public:
+  ASLAM_POINTER_TYPEDEFS(MatchingProblemFrameToIndex);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(MatchingProblemFrameToIndex);
+  ASLAM_ADD_MATCH_TYPEDEFS(FrameToIndex);
+
+  MatchingProblemFrameToIndex() = delete;
+
+  /// \brief Constructor for a frame-to-index matching problem.
+  ///
+  /// @param[in]  banana_frame                Banana frame.
+  /// @param[in]  apple_index                 Index holding the apple descriptors.
+  /// @param[in]  num_neighbors               Max number of candidates per banana.
+  /// @param[in]  hamming_distance_threshold  Pairs with a descriptor distance >= this threshold
+  ///                                         do not become candidates.
+  MatchingProblemFrameToIndex(const VisualFrame& banana_frame,
+                              const MultiIndexHashingDescriptorIndex& apple_index,
+                              size_t num_neighbors,
+                              int hamming_distance_threshold);
+  virtual ~MatchingProblemFrameToIndex() {};
+
+  /// Upper bound of the apple ids, removed descriptors never become candidates.
+  virtual size_t numApples() const;
+  virtual size_t numBananas() const;
+
+  virtual void getAppleCandidatesForBanana(int banana_index, Candidates* candidates);
+
+  /// The queries only take a read lock on the index.
+  virtual bool supportsConcurrentCandidateQueries() const {
+    return true;
+  }
+
+  inline double computeMatchScore(int hamming_distance) const {
+    return static_cast<double>(descriptor_size_bits_ - hamming_distance) /
+        static_cast<double>(descriptor_size_bits_);
+  }
+
+  /// Copies the banana descriptors into the padded layout of the index queries.
+  virtual bool doSetup();
+
+private:
+  /// The banana frame.
+  const VisualFrame& banana_frame_;
+  /// The index holding the apples.
+  const MultiIndexHashingDescriptorIndex& apple_index_;
+
+  /// The banana descriptors in the padded query layout.
+  common::AlignedDescriptors aligned_banana_descriptors_;
+
+  size_t num_neighbors_;
+  int hamming_distance_threshold_;
+  int descriptor_size_bits_;
+};
+}  // namespace aslam
+#endif  // ASLAM_CV_MATCHING_PROBLEM_FRAME_TO_INDEX_H_
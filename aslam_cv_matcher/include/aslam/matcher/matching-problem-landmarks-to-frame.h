@@ -0,0 +1,143 @@
+#ifndef ASLAM_CV_MATCHING_PROBLEM_LANDMARKS_TO_FRAME_H_
+#define ASLAM_CV_MATCHING_PROBLEM_LANDMARKS_TO_FRAME_H_
+
+/// \addtogroup Matching
+/// @{
+///
+/// @}
+
+#include <vector>
+
+#include <aslam/common/aligned-descriptors.h>
+#include <aslam/common/keypoint-grid.h>
+#include <aslam/common/macros.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <Eigen/Core>
+
+#include "aslam/matcher/match.h"
+#include "aslam/matcher/matching-problem.h"
+
+namespace aslam {
+class CameraVisibilityCone;
+class LandmarkSpatialHash;
+class VisualFrame;
+
+/// \class MatchingProblemLandmarksToFrame
+/// \brief Matches known 3d landmarks, e.g. of a local map, against the keypoints of a frame.
+///
+/// The apples are the keypoints of the frame, the bananas are the landmarks. All landmarks are
+/// projected into the frame at once; the candidates of a landmark are the unmasked keypoints
+/// within the search radius around its projection, looked up in a grid, whose descriptor is
+/// within the Hamming distance threshold of the landmark descriptor. The search radius is scaled
+/// by the predicted keypoint scale of the landmark, if given, such that landmarks expected at a
+/// coarse pyramid level get a proportionally larger window.
+///
+/// Coordinate Frames:
+///   G:  frame of the landmark positions
+///   C:  camera frame of the keypoints
+class MatchingProblemLandmarksToFrame : public MatchingProblem {
+public:
+  ASLAM_POINTER_TYPEDEFS(MatchingProblemLandmarksToFrame);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(MatchingProblemLandmarksToFrame);
+  ASLAM_ADD_MATCH_TYPEDEFS(LandmarksToFrame);
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef common::AlignedDescriptors::DescriptorsT DescriptorsT;
+
+  MatchingProblemLandmarksToFrame() = delete;
+
+  /// \brief Constructor for a landmarks-to-frame matching problem. The frame and the landmark
+  ///        data must outlive the problem.
+  ///
+  /// @param[in]  apple_frame                 Frame with keypoints and descriptors.
+  /// @param[in]  G_landmarks                 Landmark positions, one per column.
+  /// @param[in]  landmark_descriptors        Representative descriptor of every landmark, one
+  ///                                         per column, of the descriptor size of the frame.
+  /// @param[in]  T_C_G                       Transformation taking landmarks into the camera.
+  /// @param[in]  landmark_predicted_scales   Predicted keypoint scale of every landmark in the
+  ///                                         frame, in the units of the frame keypoint scales.
+  ///                                         Empty to use the unscaled search radius.
+  /// @param[in]  search_radius_pixels        Search radius around the projections at scale 1.
+  /// @param[in]  hamming_distance_threshold  Pairs with a descriptor distance >= this threshold
+  ///                                         do not become candidates.
+  MatchingProblemLandmarksToFrame(const VisualFrame& apple_frame,
+                                  const Eigen::Matrix3Xd& G_landmarks,
+                                  const DescriptorsT& landmark_descriptors,
+                                  const aslam::Transformation& T_C_G,
+                                  const Eigen::VectorXd& landmark_predicted_scales,
+                                  double search_radius_pixels,
+                                  int hamming_distance_threshold);
+  /// Same as above without scale-aware search radius.
+  MatchingProblemLandmarksToFrame(const VisualFrame& apple_frame,
+                                  const Eigen::Matrix3Xd& G_landmarks,
+                                  const DescriptorsT& landmark_descriptors,
+                                  const aslam::Transformation& T_C_G,
+                                  double search_radius_pixels,
+                                  int hamming_distance_threshold);
+  virtual ~MatchingProblemLandmarksToFrame() {};
+
+  virtual size_t numApples() const;
+  virtual size_t numBananas() const;
+
+  virtual void getAppleCandidatesForBanana(int banana_index, Candidates* candidates);
+
+  /// Only reads the state built in doSetup(), hence landmarks can be queried concurrently.
+  virtual bool supportsConcurrentCandidateQueries() const {
+    return true;
+  }
+
+  inline double computeMatchScore(int hamming_distance) const {
+    return static_cast<double>(descriptor_size_bits_ - hamming_distance) /
+        static_cast<double>(descriptor_size_bits_);
+  }
+
+  /// \brief Culls the landmarks outside the visibility cone of the camera of the frame before
+  ///        the projection, e.g. with the cone of NCameraGeometry::getVisibilityCone. With the
+  ///        spatial hash of the landmarks, whole cells outside the cone are culled at once.
+  ///
+  /// Culled landmarks are not visible. The cone and the hash must outlive the problem, the hash
+  /// must be built from the landmarks of the problem. Null disables the culling.
+  void setVisibilityCulling(const CameraVisibilityCone* camera_visibility_cone,
+                            const LandmarkSpatialHash* landmark_spatial_hash);
+
+  /// Sorts the unmasked keypoints into a grid and projects all landmarks into the frame.
+  virtual bool doSetup();
+
+  /// The projection of a landmark, only valid if isLandmarkVisible(banana_index).
+  Eigen::Vector2d getProjectedLandmark(int banana_index) const {
+    CHECK_LT(banana_index, static_cast<int>(C_projected_landmarks_.cols()));
+    return C_projected_landmarks_.col(banana_index);
+  }
+  bool isLandmarkVisible(int banana_index) const {
+    CHECK_LT(banana_index, static_cast<int>(valid_bananas_.size()));
+    return valid_bananas_[banana_index];
+  }
+
+private:
+  const VisualFrame& apple_frame_;
+  const Eigen::Matrix3Xd& G_landmarks_;
+  const DescriptorsT& landmark_descriptors_;
+  const aslam::Transformation T_C_G_;
+  const Eigen::VectorXd landmark_predicted_scales_;
+
+  const CameraVisibilityCone* camera_visibility_cone_;
+  const LandmarkSpatialHash* landmark_spatial_hash_;
+
+  double search_radius_pixels_;
+  int hamming_distance_threshold_;
+  int descriptor_size_bits_;
+
+  /// Grid over the image plane holding the unmasked keypoints.
+  common::KeypointGrid apple_keypoint_grid_;
+  std::vector<bool> valid_apples_;
+  /// Whether the landmark projects into the image.
+  std::vector<bool> valid_bananas_;
+  Eigen::Matrix2Xd C_projected_landmarks_;
+
+  /// The descriptors in the padded layout of the batched distance computation.
+  common::AlignedDescriptors aligned_apple_descriptors_;
+  common::AlignedDescriptors aligned_banana_descriptors_;
+};
+}  // namespace aslam
+#endif  // ASLAM_CV_MATCHING_PROBLEM_LANDMARKS_TO_FRAME_H_
@@ -0,0 +1,133 @@
+#ifndef ASLAM_CV_MATCHING_PROBLEM_NFRAME_TO_NFRAME_H_
+#define ASLAM_CV_MATCHING_PROBLEM_NFRAME_TO_NFRAME_H_
+
+/// \addtogroup Matching
+/// @{
+///
+/// @}
+
+#include <vector>
+
+#include <aslam/common/aligned-descriptors.h>
+#include <aslam/common/keypoint-grid.h>
+#include <aslam/common/macros.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <Eigen/Core>
+
+#include "aslam/matcher/match.h"
+#include "aslam/matcher/matching-problem.h"
+
+namespace aslam {
+class VisualNFrame;
+
+/// \class MatchingProblemNFrameToNFrame
+/// \brief Matches the keypoints of all cameras of a banana nframe against the keypoints of all
+///        cameras of an apple nframe, including pairs across different cameras of the rig.
+///
+/// The apples and bananas are the keypoints of all frames of the respective nframe, indexed
+/// camera after camera (see getAppleKeypoint() and getBananaKeypoint()). Every banana is
+/// rotated once into every camera of the apple nframe using q_A_B and the camera extrinsics
+/// T_C_B of the NCamera. Like MatchingProblemFrameToFrame, the translation is neglected, which
+/// holds for points that are far compared to the camera baseline and the motion. The bananas
+/// that project into an apple camera become candidates for the apples within the image space
+/// radius. The apple descriptors of all cameras share one padded block and every apple camera
+/// has one keypoint grid, hence a single exclusive engine can match the whole rig at once.
+///
+/// Coordinate Frames:
+///   A:  body frame of the apple nframe
+///   B:  body frame of the banana nframe
+class MatchingProblemNFrameToNFrame : public MatchingProblem {
+public:
+  ASLAM_POINTER_TYPEDEFS(MatchingProblemNFrameToNFrame);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(MatchingProblemNFrameToNFrame);
+  ASLAM_ADD_MATCH_TYPEDEFS(NFrameToNFrame);
+
+  MatchingProblemNFrameToNFrame() = delete;
+
+  /// \brief Constructor for a nframe-to-nframe matching problem.
+  ///
+  /// @param[in]  apple_nframe                           Apple nframe, all frames must be set.
+  /// @param[in]  banana_nframe                          Banana nframe, all frames must be set.
+  /// @param[in]  q_A_B                                  Quaternion taking vectors from the
+  ///                                                    banana body frame into the apple body
+  ///                                                    frame.
+  /// @param[in]  image_space_distance_threshold_pixels  Max image space distance for two pairs
+  ///                                                    to become match candidates.
+  /// @param[in]  hamming_distance_threshold             Pairs with a descriptor distance >= this
+  ///                                                    threshold do not become candidates.
+  MatchingProblemNFrameToNFrame(const VisualNFrame& apple_nframe,
+                                const VisualNFrame& banana_nframe,
+                                const aslam::Quaternion& q_A_B,
+                                double image_space_distance_threshold_pixels,
+                                int hamming_distance_threshold);
+  virtual ~MatchingProblemNFrameToNFrame() {};
+
+  virtual size_t numApples() const;
+  virtual size_t numBananas() const;
+
+  /// Candidates from all apple cameras the banana projects into.
+  virtual void getAppleCandidatesForBanana(int banana_index, Candidates* candidates);
+
+  /// Only reads the state built in doSetup(), hence bananas can be queried concurrently.
+  virtual bool supportsConcurrentCandidateQueries() const {
+    return true;
+  }
+
+  inline double computeMatchScore(int hamming_distance) const {
+    return static_cast<double>(descriptor_size_bits_ - hamming_distance) /
+        static_cast<double>(descriptor_size_bits_);
+  }
+
+  /// Camera and keypoint index of an apple or banana index.
+  void getAppleKeypoint(int apple_index, size_t* camera_index, size_t* keypoint_index) const;
+  void getBananaKeypoint(int banana_index, size_t* camera_index, size_t* keypoint_index) const;
+
+  /// Number of (banana, apple camera) pairs in which the banana projected into the apple image
+  /// during the last setup.
+  size_t getNumBananaProjections() const { return banana_projections_.size(); }
+
+  /// \brief Copies the apple descriptors of all cameras into one block, builds one keypoint grid
+  ///        per apple camera and rotates every banana into all apple cameras.
+  virtual bool doSetup();
+
+private:
+  /// A banana projected into one of the apple cameras.
+  struct BananaProjection {
+    size_t apple_camera_index;
+    Eigen::Vector2d keypoint;
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  static void getKeypoint(const std::vector<size_t>& offsets, int index, size_t* camera_index,
+                          size_t* keypoint_index);
+
+  const VisualNFrame& apple_nframe_;
+  const VisualNFrame& banana_nframe_;
+  aslam::Quaternion q_A_B_;
+
+  /// First apple and banana index of every camera, plus the total count at the end.
+  std::vector<size_t> apple_offsets_;
+  std::vector<size_t> banana_offsets_;
+
+  /// One grid holding the valid apple keypoints per apple camera.
+  Aligned<std::vector, common::KeypointGrid> apple_keypoint_grids_;
+  std::vector<bool> valid_apples_;
+  /// Whether the apple has a track id, which raises the priority of its candidates.
+  std::vector<bool> is_apple_tracked_;
+
+  /// The projections of banana i are [banana_projection_offsets_[i],
+  /// banana_projection_offsets_[i + 1]) in banana_projections_.
+  std::vector<size_t> banana_projection_offsets_;
+  Aligned<std::vector, BananaProjection> banana_projections_;
+
+  /// The descriptors of all cameras in one padded block each, indexed by apple / banana index.
+  common::AlignedDescriptors aligned_apple_descriptors_;
+  common::AlignedDescriptors aligned_banana_descriptors_;
+
+  double image_space_distance_threshold_pixels_;
+  int hamming_distance_threshold_;
+  int descriptor_size_bits_;
+};
+}  // namespace aslam
+#endif  // ASLAM_CV_MATCHING_PROBLEM_NFRAME_TO_NFRAME_H_
@@ -68,6 +68,89 @@ public:
   typedef Aligned<std::vector, Candidate> Candidates;
   typedef Aligned<std::vector, Candidates> CandidatesList;
 
+  /// \brief The candidates of all bananas in one contiguous array plus per-banana offsets
+  ///        (compressed sparse row layout). The candidates of banana i are [begin(i), end(i)).
+  ///
+  /// The list is either filled serially with appendBanana() or in two passes from several
+  /// threads: resetCounts() and setNumCandidates() for every banana, allocateFromCounts() and
+  /// then writing the candidates of every banana through begin(). The memory is kept when the
+  /// list is refilled, such that matching problems of similar size do not allocate.
+  class FlatCandidatesList {
+   public:
+    FlatCandidatesList() : offsets_(1u, 0u) {}
+
+    /// Removes all bananas.
+    void clear() {
+      offsets_.assign(1u, 0u);
+      candidates_.clear();
+    }
+    /// Appends the next banana with the given candidates.
+    void appendBanana(const Candidates& candidates) {
+      candidates_.insert(candidates_.end(), candidates.begin(), candidates.end());
+      offsets_.push_back(candidates_.size());
+    }
+
+    /// Sets the list to num_bananas bananas without candidates for the count pass.
+    void resetCounts(size_t num_bananas) {
+      offsets_.assign(num_bananas + 1u, 0u);
+      candidates_.clear();
+    }
+    /// Count pass, can be called concurrently for different bananas.
+    void setNumCandidates(size_t banana_index, size_t num_candidates) {
+      DCHECK_LT(banana_index + 1u, offsets_.size());
+      offsets_[banana_index + 1u] = num_candidates;
+    }
+    /// Turns the counts into offsets and sizes the candidate array for the fill pass.
+    void allocateFromCounts() {
+      for (size_t i = 1u; i < offsets_.size(); ++i) {
+        offsets_[i] += offsets_[i - 1u];
+      }
+      candidates_.resize(offsets_.back());
+    }
+
+    size_t numBananas() const { return offsets_.size() - 1u; }
+    /// Total number of candidates over all bananas.
+    size_t numCandidates() const { return candidates_.size(); }
+    size_t numCandidates(size_t banana_index) const {
+      return getEndOffset(banana_index) - getBeginOffset(banana_index);
+    }
+
+    /// Offsets of the candidates of a banana in the contiguous array.
+    size_t getBeginOffset(size_t banana_index) const {
+      DCHECK_LT(banana_index + 1u, offsets_.size());
+      return offsets_[banana_index];
+    }
+    size_t getEndOffset(size_t banana_index) const {
+      DCHECK_LT(banana_index + 1u, offsets_.size());
+      return offsets_[banana_index + 1u];
+    }
+
+    Candidate* begin(size_t banana_index) {
+      return candidates_.data() + getBeginOffset(banana_index);
+    }
+    Candidate* end(size_t banana_index) { return candidates_.data() + getEndOffset(banana_index); }
+    const Candidate* begin(size_t banana_index) const {
+      return candidates_.data() + getBeginOffset(banana_index);
+    }
+    const Candidate* end(size_t banana_index) const {
+      return candidates_.data() + getEndOffset(banana_index);
+    }
+
+    /// Access by the offset in the contiguous array.
+    Candidate& operator[](size_t offset) {
+      DCHECK_LT(offset, candidates_.size());
+      return candidates_[offset];
+    }
+    const Candidate& operator[](size_t offset) const {
+      DCHECK_LT(offset, candidates_.size());
+      return candidates_[offset];
+    }
+
+   private:
+    Candidates candidates_;
+    std::vector<size_t> offsets_;
+  };
+
   ASLAM_POINTER_TYPEDEFS(MatchingProblem);
   ASLAM_DISALLOW_EVIL_CONSTRUCTORS(MatchingProblem);
 
@@ -100,6 +183,17 @@ public:
     }
   }
 
+  /// Same as above, but into the contiguous candidate list used by the matching engines. Queries
+  /// the bananas one by one through getAppleCandidatesForBanana(...).
+  virtual void getCandidates(FlatCandidatesList* candidates_for_bananas) {
+    CHECK_NOTNULL(candidates_for_bananas)->clear();
+    const size_t num_bananas = numBananas();
+    for (size_t banana_idx = 0u; banana_idx < num_bananas; ++banana_idx) {
+      getAppleCandidatesForBanana(banana_idx, &banana_candidates_buffer_);
+      candidates_for_bananas->appendBanana(banana_candidates_buffer_);
+    }
+  }
+
   /// Get a short list of candidates for a given banana index.
   ///
   /// \param[in] banana_index The index of the banana queried for candidates.
@@ -109,6 +203,12 @@ public:
     LOG(FATAL) << "Not implemented.";
   }
 
+  /// Whether getAppleCandidatesForBanana(...) may be called concurrently for different bananas
+  /// after doSetup(). Matching engines only parallelize the candidate search if this is true.
+  virtual bool supportsConcurrentCandidateQueries() const {
+    return false;
+  }
+
   /// Gets called at the beginning of the matching problem; i.e. to setup kd-trees, lookup tables
   /// or the like.
   virtual bool doSetup() = 0;
@@ -116,6 +216,10 @@ public:
   /// List of tested match pairs for every banana. This is only retrieved and stored if the
   /// flag 'matcher_store_all_tested_pairs' is set to true.
   CandidatesList all_tested_pairs_;
+
+ private:
+  /// Reused by getCandidates(FlatCandidatesList*).
+  Candidates banana_candidates_buffer_;
 };
 }  // namespace aslam
 #endif //ASLAM_CV_MATCHING_PROBLEM_H_
@@ -0,0 +1,107 @@
+#ifndef ASLAM_CV_MATCHER_MULTI_INDEX_HASHING_H_
+#define ASLAM_CV_MATCHER_MULTI_INDEX_HASHING_H_
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <aslam/common/aligned-descriptors.h>
+#include <aslam/common/macros.h>
+#include <aslam/common/reader-writer-lock.h>
+#include <Eigen/Core>
+
+namespace aslam {
+
+/// \class MultiIndexHashingDescriptorIndex
+/// \brief Nearest neighbor index over binary descriptors based on multi-index hashing
+///        (Norouzi et al., "Fast Search in Hamming Space with Multi-Index Hashing", CVPR 2012).
+///
+/// Every descriptor is split into num_substrings disjoint bit substrings and each substring is
+/// hashed into its own table. By the pigeonhole principle, a descriptor within Hamming distance
+/// r of the query has at least one substring within distance floor(r / num_substrings) of the
+/// corresponding query substring. A query therefore probes the buckets of all substrings in
+/// growing substring radii and verifies the candidates with the full distance. The search stops
+/// as soon as no unseen descriptor can be closer than the k-th neighbor found so far.
+///
+/// Substrings of about log2(number of descriptors) bits give the best query times, e.g. 24
+/// substrings of 21 bits for 10^6 descriptors of 512 bits.
+///
+/// Queries take a read lock and can run concurrently, insert() and remove() take a write lock.
+class MultiIndexHashingDescriptorIndex {
+ public:
+  ASLAM_POINTER_TYPEDEFS(MultiIndexHashingDescriptorIndex);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(MultiIndexHashingDescriptorIndex);
+
+  typedef Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> DescriptorsT;
+
+  struct Neighbor {
+    Neighbor() : id(-1), distance(-1) {}
+    Neighbor(int _id, int _distance) : id(_id), distance(_distance) {}
+    int id;
+    int distance;
+  };
+
+  /// Substrings are at most this wide, such that a substring fits a hash key.
+  static constexpr size_t kMaxSubstringBits = 32u;
+
+  /// @param[in]  descriptor_size_bytes  Size of the indexed descriptors.
+  /// @param[in]  num_substrings         Number of substrings a descriptor is split into.
+  MultiIndexHashingDescriptorIndex(size_t descriptor_size_bytes, size_t num_substrings);
+  ~MultiIndexHashingDescriptorIndex() = default;
+
+  /// \brief Insert a batch of descriptors, one per column.
+  /// @return The id of the first descriptor, the descriptors get consecutive ids.
+  int insert(const DescriptorsT& descriptors);
+
+  /// \brief Remove the descriptors with the given ids. Ids are not reused.
+  void remove(const std::vector<int>& ids);
+
+  /// \brief Find the k nearest descriptors within Hamming distance max_distance of the query.
+  ///
+  /// @param[in]  query         The query descriptor, in the padded layout of AlignedDescriptors
+  ///                           (i.e. getStrideBytes() bytes with zero padding).
+  /// @param[in]  k             Maximum number of neighbors.
+  /// @param[in]  max_distance  Neighbors are at most this far from the query.
+  /// @param[out] neighbors     The neighbors sorted by increasing distance, ties by id.
+  void knnSearch(const unsigned char* query, size_t k, int max_distance,
+                 std::vector<Neighbor>* neighbors) const;
+
+  /// Whether the id refers to an inserted descriptor that was not removed.
+  bool isValidId(int id) const;
+  /// Number of descriptors in the index.
+  size_t size() const;
+  /// All ids handed out so far are smaller than this.
+  size_t getIdEnd() const;
+
+  size_t getDescriptorSizeBytes() const { return descriptor_size_bytes_; }
+  size_t getStrideBytes() const { return common::AlignedDescriptors::getStrideBytes(
+      descriptor_size_bytes_); }
+  size_t getNumSubstrings() const { return substrings_.size(); }
+
+ private:
+  struct Substring {
+    size_t begin_bit;
+    size_t num_bits;
+  };
+  typedef std::unordered_map<uint32_t, std::vector<int>> SubstringTable;
+
+  uint32_t getSubstringKey(const unsigned char* descriptor, const Substring& substring) const;
+
+  const size_t descriptor_size_bytes_;
+  std::vector<Substring> substrings_;
+  /// One table per substring, mapping the substring bits to the ids of the descriptors.
+  std::vector<SubstringTable> tables_;
+
+  /// Descriptor storage, one block per inserted batch such that the descriptors never move.
+  std::vector<std::unique_ptr<common::AlignedDescriptors>> descriptor_batches_;
+  /// Per id, the padded descriptor or nullptr if the descriptor was removed.
+  std::vector<const unsigned char*> descriptors_;
+  size_t num_valid_descriptors_;
+
+  mutable ReaderWriterMutex mutex_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_CV_MATCHER_MULTI_INDEX_HASHING_H_
@@ -0,0 +1,78 @@
+#ifndef ASLAM_CV_MATCHER_SLIDING_WINDOW_MATCHER_H_
+#define ASLAM_CV_MATCHER_SLIDING_WINDOW_MATCHER_H_
+
+#include <deque>
+#include <memory>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+
+#include "aslam/matcher/match.h"
+
+namespace aslam {
+class VisualFrame;
+
+/// \class SlidingWindowMatcher
+/// \brief Matches a new frame against the last N frames, e.g. to relocalize lost tracks.
+///
+/// Gives the same matches as one MatchingProblemFrameToFrame per window frame with the window
+/// frame as apple frame, solved with MatchingEngineExclusive. The keypoint grid, the valid flags
+/// and the padded descriptors of a window frame are built once when the frame enters the window.
+/// The masking, bearing vectors and padded descriptors of the new (banana) frame are collected
+/// once per match() and shared by all window frames; per window frame only the rotation and
+/// projection of the banana rays and the candidate search remain. Not thread-safe.
+class SlidingWindowMatcher {
+ public:
+  ASLAM_POINTER_TYPEDEFS(SlidingWindowMatcher);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(SlidingWindowMatcher);
+
+  typedef FrameToFrameMatchesWithScore MatchesWithScore;
+  typedef FrameToFrameMatchesWithScoreList MatchesWithScoreList;
+
+  /// @param[in]  max_num_frames                         Size of the window.
+  /// @param[in]  image_space_distance_threshold_pixels  Search radius around the projected
+  ///                                                    banana keypoints.
+  /// @param[in]  hamming_distance_threshold             Pairs with a descriptor distance >= this
+  ///                                                    threshold do not become candidates.
+  /// @param[in]  num_threads                            Threads of the matching engine.
+  SlidingWindowMatcher(size_t max_num_frames, double image_space_distance_threshold_pixels,
+                       int hamming_distance_threshold, size_t num_threads = 1u);
+  ~SlidingWindowMatcher();
+
+  /// Append the frame as the newest frame, the oldest frame leaves a full window.
+  void addFrame(const std::shared_ptr<const VisualFrame>& frame);
+  void removeOldestFrame();
+  void clear();
+
+  size_t numFrames() const { return window_.size(); }
+  size_t getMaxNumFrames() const { return max_num_frames_; }
+  /// The window frames from the oldest (0) to the newest.
+  const VisualFrame& getFrame(size_t window_index) const;
+
+  /// \brief Match the banana frame against all window frames.
+  ///
+  /// @param[in]  banana_frame       The new frame.
+  /// @param[in]  q_Ai_B             Rotation taking vectors from the banana frame into window
+  ///                                frame i, one per window frame.
+  /// @param[out] matches_per_frame  The matches against window frame i, the apples are the
+  ///                                keypoints of window frame i.
+  void match(const VisualFrame& banana_frame, const Aligned<std::vector, Quaternion>& q_Ai_B,
+             MatchesWithScoreList* matches_per_frame);
+
+ private:
+  struct WindowFrame;
+  struct BananaFrame;
+  class MatchingProblemWindowFrame;
+
+  const size_t max_num_frames_;
+  const double image_space_distance_threshold_pixels_;
+  const int hamming_distance_threshold_;
+  const size_t num_threads_;
+
+  std::deque<std::unique_ptr<WindowFrame>> window_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_CV_MATCHER_SLIDING_WINDOW_MATCHER_H_
@@ -0,0 +1,151 @@
+#ifndef ASLAM_CV_MATCHER_VOCABULARY_TREE_H_
+#define ASLAM_CV_MATCHER_VOCABULARY_TREE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <aslam/common/aligned-descriptors.h>
+#include <aslam/common/macros.h>
+#include <aslam/common/mapped-file.h>
+
+/// \file
+/// Hierarchical vocabulary of binary descriptors for bag-of-words place recognition.
+///
+/// Serialized form: a 64 byte VocabularyHeader, the VocabularyNode array in breadth-first order
+/// padded to 64 bytes and the node descriptors, one per node in the padded layout of
+/// common::AlignedDescriptors. All parts are used in place from the mapped file.
+
+namespace aslam {
+namespace vocabulary {
+constexpr uint32_t kVocabularyMagic = 0x42564341u;  // "ACVB"
+constexpr uint16_t kVocabularyFormatVersion = 1u;
+constexpr size_t kVocabularyAlignmentBytes = 64u;
+
+struct VocabularyHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t header_size_bytes;
+  uint32_t branching_factor;
+  uint32_t depth;
+  uint32_t descriptor_size_bytes;
+  uint32_t stride_bytes;
+  uint64_t num_nodes;
+  uint64_t num_words;
+  /// Offset of the node descriptors from the start of the file.
+  uint64_t descriptors_offset_bytes;
+  uint64_t reserved[2];
+};
+static_assert(sizeof(VocabularyHeader) == kVocabularyAlignmentBytes,
+              "Unexpected vocabulary header padding.");
+
+/// The children of a node are stored contiguously, such that their descriptors form one block
+/// for the batched Hamming kernel.
+struct VocabularyNode {
+  /// Index of the first child, 0 for the leaves.
+  uint32_t first_child;
+  uint32_t num_children;
+  /// Word of a leaf, kInvalidWordId for the inner nodes.
+  uint32_t word_id;
+  /// Inverse document frequency of the word of a leaf.
+  float weight;
+};
+static_assert(sizeof(VocabularyNode) == 16u, "Unexpected vocabulary node padding.");
+}  // namespace vocabulary
+
+/// \class BinaryVocabularyTree
+/// \brief Vocabulary tree over binary descriptors, trained by hierarchical k-majority clustering.
+///
+/// Every inner node has up to branching_factor children whose centers are the bitwise majority
+/// of their cluster; the leaves are the words. A descriptor is quantized by descending to the
+/// child with the smallest Hamming distance at every level. The words are weighted with their
+/// inverse document frequency over the training images. A loaded vocabulary is used in place
+/// from the memory-mapped file, such that even millions of words load instantly. Const methods
+/// are thread-safe.
+class BinaryVocabularyTree {
+ public:
+  ASLAM_POINTER_TYPEDEFS(BinaryVocabularyTree);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(BinaryVocabularyTree);
+
+  typedef common::AlignedDescriptors::DescriptorsT DescriptorsT;
+  typedef uint32_t WordId;
+  static constexpr WordId kInvalidWordId = 0xffffffffu;
+  static constexpr size_t kMaxBranchingFactor = 64u;
+
+  struct TrainingOptions {
+    TrainingOptions()
+        : branching_factor(10u), depth(6u), max_num_iterations(10u), random_seed(0u),
+          num_threads(0u) {}
+    /// Number of clusters per node, in [2, kMaxBranchingFactor].
+    size_t branching_factor;
+    /// Number of levels below the root, the vocabulary has up to branching_factor^depth words.
+    size_t depth;
+    /// The clustering of a node stops earlier if no assignment changed.
+    size_t max_num_iterations;
+    unsigned int random_seed;
+    /// 1 trains on the calling thread, any other value on the shared pool of
+    /// common::parallelFor, see FLAGS_acv_parallel_for_num_threads.
+    size_t num_threads;
+  };
+
+  BinaryVocabularyTree();
+  ~BinaryVocabularyTree();
+
+  /// Train the vocabulary, replacing the current one.
+  /// @param[in] training_images  Descriptors of every training image, one per column. The images
+  ///                             define the document frequencies of the words.
+  void train(const std::vector<DescriptorsT>& training_images, const TrainingOptions& options);
+
+  /// Write the vocabulary in the serialized form. Returns false on an IO error.
+  bool save(const std::string& path) const;
+  /// Map a vocabulary written by save(), replacing the current one. Returns false if the file
+  /// can not be mapped or is not a vocabulary.
+  bool load(const std::string& path);
+  bool isMapped() const { return mapped_file_.isOpen(); }
+
+  bool empty() const { return num_words_ == 0u; }
+  size_t numWords() const { return num_words_; }
+  size_t numNodes() const { return num_nodes_; }
+  size_t getBranchingFactor() const { return branching_factor_; }
+  size_t getDepth() const { return depth_; }
+  size_t getDescriptorSizeBytes() const { return descriptor_size_bytes_; }
+
+  /// Quantize a descriptor in the padded layout of common::AlignedDescriptors.
+  WordId quantize(const unsigned char* padded_descriptor) const;
+  /// Quantize all descriptors, words has one entry per descriptor.
+  void quantize(const common::AlignedDescriptors& descriptors, std::vector<WordId>* words) const;
+  void quantize(const DescriptorsT& descriptors, std::vector<WordId>* words) const;
+
+  /// Inverse document frequency of a word.
+  float getWordWeight(WordId word_id) const;
+
+ private:
+  void clear();
+  /// Make the node and descriptor pointers refer to the owned storage.
+  void useOwnedStorage();
+  const unsigned char* getNodeDescriptor(size_t node_index) const {
+    return node_descriptors_ + stride_bytes_ * node_index;
+  }
+
+  size_t branching_factor_;
+  size_t depth_;
+  size_t descriptor_size_bytes_;
+  size_t stride_bytes_;
+  size_t num_nodes_;
+  size_t num_words_;
+
+  /// Either the owned storage or the mapped file.
+  const vocabulary::VocabularyNode* nodes_;
+  const unsigned char* node_descriptors_;
+  /// Leaf node of every word.
+  std::vector<uint32_t> word_nodes_;
+
+  std::vector<vocabulary::VocabularyNode> owned_nodes_;
+  common::AlignedDescriptors owned_node_descriptors_;
+
+  common::MappedFile mapped_file_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_CV_MATCHER_VOCABULARY_TREE_H_
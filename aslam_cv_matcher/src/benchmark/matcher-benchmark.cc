@@ -0,0 +1,325 @@
+// Benchmarks of the matching problems and engines on synthetic frames:
+// MatchingProblemFrameToFrame::doSetup / getCandidates, the exclusive, greedy, non-exclusive and
+// cross-check matching engines on top of it and GyroTwoFrameMatcher::match. For every stage the
+// latency, the time per keypoint and the number of heap allocations per call are reported as JSON.
+//
+// The apple and banana frames observe a simulation::SyntheticScene rotating in place by the
+// configured angle per frame, with pixel noise, missed detections, outliers and a few flipped
+// descriptor bits, like the frames of tracker-benchmark.cc.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <aslam/common/allocation-counter.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/gyro-two-frame-matcher.h>
+#include <aslam/matcher/match-helpers.h>
+#include <aslam/matcher/matching-engine-cross-check.h>
+#include <aslam/matcher/matching-engine-exclusive.h>
+#include <aslam/matcher/matching-engine-greedy.h>
+#include <aslam/matcher/matching-engine-non-exclusive.h>
+#include <aslam/matcher/matching-problem-frame-to-frame.h>
+#include <aslam/simulation/synthetic-scene.h>
+#include <Eigen/Core>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_string(benchmark_num_keypoints, "500,1000,2000,5000",
+              "Comma separated numbers of keypoints per frame.");
+DEFINE_string(benchmark_descriptor_size_bytes, "48,64",
+              "Comma separated descriptor sizes in bytes.");
+DEFINE_string(benchmark_search_radius_px, "10,25",
+              "Comma separated image space search radii of the frame-to-frame problem.");
+DEFINE_string(benchmark_rotation_deg, "0.5,2,5",
+              "Comma separated interframe rotation angles in degrees.");
+DEFINE_string(benchmark_image_size, "752x480", "Image size <width>x<height>.");
+DEFINE_int32(benchmark_hamming_distance_threshold, 60,
+             "Hamming distance threshold of the frame-to-frame problem.");
+DEFINE_int32(benchmark_num_repetitions, 20, "Number of timed calls per configuration.");
+DEFINE_double(benchmark_keypoint_noise_px, 0.5, "Standard deviation of the keypoint noise.");
+DEFINE_string(benchmark_output_json, "", "Write the results to this file instead of stdout.");
+
+namespace aslam {
+namespace {
+
+const uint32_t kSeed = 42u;
+const size_t kMinDistanceToImageBorderPx = 30u;
+const int64_t kFramePeriodNanoseconds = 50000000;
+
+struct Configuration {
+  size_t num_keypoints;
+  size_t descriptor_size_bytes;
+  double search_radius_px;
+  double rotation_deg;
+};
+
+/// Timings in milliseconds and heap allocations of the timed calls.
+struct StageMeasurements {
+  std::vector<double> durations_ms;
+  std::vector<uint64_t> num_allocations;
+
+  double getMean() const {
+    CHECK(!durations_ms.empty());
+    double sum = 0.0;
+    for (const double duration_ms : durations_ms) {
+      sum += duration_ms;
+    }
+    return sum / durations_ms.size();
+  }
+  double getPercentile(double percentile) const {
+    CHECK(!durations_ms.empty());
+    std::vector<double> sorted = durations_ms;
+    std::sort(sorted.begin(), sorted.end());
+    const size_t index = std::min<size_t>(
+        sorted.size() - 1u, static_cast<size_t>(percentile * sorted.size()));
+    return sorted[index];
+  }
+  double getMeanNumAllocations() const {
+    CHECK(!num_allocations.empty());
+    double sum = 0.0;
+    for (const uint64_t count : num_allocations) {
+      sum += static_cast<double>(count);
+    }
+    return sum / num_allocations.size();
+  }
+};
+
+template <typename Function>
+void measure(const Function& function, StageMeasurements* measurements) {
+  CHECK_NOTNULL(measurements);
+  const common::ProcessAllocationCounter allocation_counter;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  function();
+  const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  measurements->num_allocations.push_back(allocation_counter.getNumAllocations());
+  measurements->durations_ms.push_back(
+      std::chrono::duration<double, std::milli>(end - start).count());
+}
+
+std::vector<std::string> splitList(const std::string& list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+std::vector<Configuration> parseConfigurations() {
+  std::vector<Configuration> configurations;
+  for (const std::string& num_keypoints : splitList(FLAGS_benchmark_num_keypoints)) {
+    for (const std::string& descriptor_size : splitList(FLAGS_benchmark_descriptor_size_bytes)) {
+      for (const std::string& radius : splitList(FLAGS_benchmark_search_radius_px)) {
+        for (const std::string& rotation_deg : splitList(FLAGS_benchmark_rotation_deg)) {
+          Configuration configuration;
+          configuration.num_keypoints = std::stoul(num_keypoints);
+          configuration.descriptor_size_bytes = std::stoul(descriptor_size);
+          configuration.search_radius_px = std::stod(radius);
+          configuration.rotation_deg = std::stod(rotation_deg);
+          CHECK_GT(configuration.num_keypoints, 0u);
+          CHECK_GT(configuration.descriptor_size_bytes, 0u);
+          CHECK_EQ(configuration.descriptor_size_bytes % 16u, 0u)
+              << "The Hamming kernels work on multiples of 16 bytes.";
+          CHECK_GE(configuration.search_radius_px, 0.0);
+          configurations.push_back(configuration);
+        }
+      }
+    }
+  }
+  return configurations;
+}
+
+void writeMeasurementsJson(const std::string& name, const StageMeasurements& measurements,
+                           size_t num_keypoints, std::ostream* out) {
+  CHECK_NOTNULL(out);
+  CHECK_GT(num_keypoints, 0u);
+  *out << "\"" << name << "\": {\"mean_ms\": " << measurements.getMean()
+       << ", \"p50_ms\": " << measurements.getPercentile(0.5)
+       << ", \"p99_ms\": " << measurements.getPercentile(0.99)
+       << ", \"ns_per_keypoint\": " << measurements.getMean() * 1.0e6 / num_keypoints
+       << ", \"allocations_per_call\": " << measurements.getMeanNumAllocations() << "}";
+}
+
+template <typename MatchingEngine>
+void measureEngine(const VisualFrame& apple_frame, const VisualFrame& banana_frame,
+                   const Quaternion& q_A_B, const Configuration& configuration,
+                   StageMeasurements* measurements, size_t* num_matches) {
+  CHECK_NOTNULL(measurements);
+  CHECK_NOTNULL(num_matches);
+  MatchingEngine engine;
+  MatchingProblemFrameToFrame problem(apple_frame, banana_frame, q_A_B,
+                                      configuration.search_radius_px,
+                                      FLAGS_benchmark_hamming_distance_threshold);
+  MatchingProblemFrameToFrame::MatchesWithScore matches;
+  measure([&]() { engine.match(&problem, &matches); }, measurements);
+  *num_matches += matches.size();
+}
+
+void runConfiguration(const Configuration& configuration, const NCamera::Ptr& ncamera,
+                      std::ostream* json) {
+  CHECK_NOTNULL(json);
+  CHECK(ncamera);
+  CHECK_GT(FLAGS_benchmark_num_repetitions, 0);
+
+  simulation::SyntheticScene::Options options;
+  options.num_frames = 2u;
+  options.frame_period_nanoseconds = kFramePeriodNanoseconds;
+  options.start_timestamp_nanoseconds = kFramePeriodNanoseconds;
+  options.trajectory_type = simulation::TrajectoryType::kRotation;
+  options.angular_speed_rad_s =
+      configuration.rotation_deg / 180.0 * M_PI / (kFramePeriodNanoseconds * 1e-9);
+  options.position_noise_m = 0.0;
+  options.orientation_noise_rad = 0.0;
+  options.descriptor_size_bytes = configuration.descriptor_size_bytes;
+  options.keypoint_noise_px = FLAGS_benchmark_keypoint_noise_px;
+  options.min_distance_to_image_border_px = kMinDistanceToImageBorderPx;
+  options.seed = kSeed;
+  const simulation::SyntheticScene::Ptr scene =
+      simulation::SyntheticScene::createWithNumKeypointsPerFrame(
+          ncamera, configuration.num_keypoints, options);
+
+  const Camera& camera = ncamera->getCamera(0u);
+  // Apples are the keypoints of frame k, bananas the ones of frame (k+1).
+  const VisualFrame::Ptr frame_k = scene->createNFrame(0u).nframe->getFrameShared(0u);
+  const VisualFrame::Ptr frame_kp1 = scene->createNFrame(1u).nframe->getFrameShared(0u);
+  const Quaternion q_Ckp1_Ck = scene->get_T_Ca_Cb(1u, 0u, 0u).getRotation();
+  const Quaternion q_Ck_Ckp1 = q_Ckp1_Ck.inverse();
+
+  StageMeasurements setup_measurements;
+  StageMeasurements candidates_measurements;
+  StageMeasurements exclusive_measurements;
+  StageMeasurements greedy_measurements;
+  StageMeasurements non_exclusive_measurements;
+  StageMeasurements cross_check_measurements;
+  StageMeasurements gyro_measurements;
+  size_t num_candidates = 0u;
+  size_t num_exclusive_matches = 0u;
+  size_t num_greedy_matches = 0u;
+  size_t num_non_exclusive_matches = 0u;
+  size_t num_cross_check_matches = 0u;
+  size_t num_gyro_matches = 0u;
+
+  Eigen::Matrix2Xd predicted_keypoints_kp1;
+  std::vector<unsigned char> prediction_success;
+  predictKeypointsByRotation(*frame_k, q_Ckp1_Ck, &predicted_keypoints_kp1, &prediction_success);
+  // The gyro matcher is long-lived like in the tracker and reuses its buffers.
+  GyroTwoFrameMatcher gyro_matcher(static_cast<uint32_t>(camera.imageHeight()));
+  MatchingProblem::CandidatesList candidates;
+  for (int repetition = 0; repetition < FLAGS_benchmark_num_repetitions; ++repetition) {
+    MatchingProblemFrameToFrame problem(*frame_k, *frame_kp1, q_Ck_Ckp1,
+                                        configuration.search_radius_px,
+                                        FLAGS_benchmark_hamming_distance_threshold);
+    measure([&]() { problem.doSetup(); }, &setup_measurements);
+    measure([&]() { problem.getCandidates(&candidates); }, &candidates_measurements);
+    for (const MatchingProblem::Candidates& banana_candidates : candidates) {
+      num_candidates += banana_candidates.size();
+    }
+
+    measureEngine<MatchingEngineExclusive<MatchingProblemFrameToFrame>>(
+        *frame_k, *frame_kp1, q_Ck_Ckp1, configuration, &exclusive_measurements,
+        &num_exclusive_matches);
+    measureEngine<MatchingEngineGreedy<MatchingProblemFrameToFrame>>(
+        *frame_k, *frame_kp1, q_Ck_Ckp1, configuration, &greedy_measurements,
+        &num_greedy_matches);
+    measureEngine<MatchingEngineNonExclusive<MatchingProblemFrameToFrame>>(
+        *frame_k, *frame_kp1, q_Ck_Ckp1, configuration, &non_exclusive_measurements,
+        &num_non_exclusive_matches);
+    measureEngine<MatchingEngineCrossCheck<MatchingProblemFrameToFrame>>(
+        *frame_k, *frame_kp1, q_Ck_Ckp1, configuration, &cross_check_measurements,
+        &num_cross_check_matches);
+
+    FrameToFrameMatchesWithScore matches_kp1_k;
+    measure([&]() {
+      gyro_matcher.match(q_Ckp1_Ck, *frame_kp1, *frame_k, predicted_keypoints_kp1,
+                         prediction_success, &matches_kp1_k);
+    }, &gyro_measurements);
+    num_gyro_matches += matches_kp1_k.size();
+  }
+
+  const double num_repetitions = static_cast<double>(FLAGS_benchmark_num_repetitions);
+  // The scene may not fill up every frame to the configured number of keypoints.
+  const size_t num_keypoints = frame_k->getNumKeypointMeasurements();
+  *json << "    {\"num_keypoints\": " << configuration.num_keypoints
+        << ", \"descriptor_size_bytes\": " << configuration.descriptor_size_bytes
+        << ", \"search_radius_px\": " << configuration.search_radius_px
+        << ", \"rotation_deg\": " << configuration.rotation_deg
+        << ", \"num_repetitions\": " << FLAGS_benchmark_num_repetitions
+        << ",\n     \"candidates_per_call\": " << num_candidates / num_repetitions
+        << ", \"matches_per_call\": {\"exclusive\": " << num_exclusive_matches / num_repetitions
+        << ", \"greedy\": " << num_greedy_matches / num_repetitions
+        << ", \"non_exclusive\": " << num_non_exclusive_matches / num_repetitions
+        << ", \"cross_check\": " << num_cross_check_matches / num_repetitions
+        << ", \"gyro_two_frame_matcher\": " << num_gyro_matches / num_repetitions << "}"
+        << ",\n     \"stages\": {";
+  writeMeasurementsJson("frame_to_frame_setup", setup_measurements, num_keypoints, json);
+  *json << ",\n       ";
+  writeMeasurementsJson("frame_to_frame_get_candidates", candidates_measurements,
+                        num_keypoints, json);
+  *json << ",\n       ";
+  writeMeasurementsJson("engine_exclusive", exclusive_measurements, num_keypoints, json);
+  *json << ",\n       ";
+  writeMeasurementsJson("engine_greedy", greedy_measurements, num_keypoints, json);
+  *json << ",\n       ";
+  writeMeasurementsJson("engine_non_exclusive", non_exclusive_measurements, num_keypoints, json);
+  *json << ",\n       ";
+  writeMeasurementsJson("engine_cross_check", cross_check_measurements, num_keypoints, json);
+  *json << ",\n       ";
+  writeMeasurementsJson("gyro_two_frame_matcher", gyro_measurements, num_keypoints, json);
+  *json << "}}";
+}
+
+int runBenchmark() {
+  const std::vector<Configuration> configurations = parseConfigurations();
+  CHECK(!configurations.empty());
+  const size_t separator = FLAGS_benchmark_image_size.find('x');
+  CHECK_NE(separator, std::string::npos) << "Malformed image size: "
+      << FLAGS_benchmark_image_size;
+  const uint32_t image_width = std::stoul(FLAGS_benchmark_image_size.substr(0u, separator));
+  const uint32_t image_height = std::stoul(FLAGS_benchmark_image_size.substr(separator + 1u));
+  CHECK_GT(image_width, 2u * kMinDistanceToImageBorderPx);
+  CHECK_GT(image_height, 2u * kMinDistanceToImageBorderPx);
+
+  const NCamera::Ptr ncamera = simulation::createPinholeNCamera(image_width, image_height);
+
+  std::ostringstream json;
+  json << "{\n  \"image_width\": " << image_width << ", \"image_height\": " << image_height
+       << ",\n  \"configurations\": [\n";
+  for (size_t i = 0u; i < configurations.size(); ++i) {
+    LOG(INFO) << "Running " << configurations[i].num_keypoints << " keypoints, "
+              << configurations[i].descriptor_size_bytes << " byte descriptors, "
+              << configurations[i].search_radius_px << " px radius, "
+              << configurations[i].rotation_deg << " deg.";
+    runConfiguration(configurations[i], ncamera, &json);
+    json << (i + 1u < configurations.size() ? ",\n" : "\n");
+  }
+  json << "  ]\n}\n";
+
+  if (FLAGS_benchmark_output_json.empty()) {
+    std::cout << json.str();
+  } else {
+    std::ofstream output(FLAGS_benchmark_output_json);
+    CHECK(output.is_open()) << "Could not open " << FLAGS_benchmark_output_json << ".";
+    output << json.str();
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace aslam
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  return aslam::runBenchmark();
+}
@@ -0,0 +1,290 @@
+#include "aslam/matcher/brute-force-hamming-matcher.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <aslam/common/descriptor-utils.h>
+#include <aslam/common/feature-descriptor-ref.h>
+#include <aslam/common/hamming.h>
+#include <aslam/common/parallel-for.h>
+#include <aslam/common/timer.h>
+#include <glog/logging.h>
+#ifdef ASLAM_CV_WITH_CUDA
+#include <opencv2/core/cuda.hpp>
+#include <opencv2/cudafeatures2d.hpp>
+#endif
+
+namespace aslam {
+namespace {
+/// Size of the database tiles of the CPU backend, such that a tile stays in the L2 cache while
+/// all queries of a tile are compared against it.
+constexpr size_t kDatabaseTileSizeBytes = 256u * 1024u;
+
+/// The k nearest neighbors of one query as (distance, database index), sorted by distance.
+class NeighborList {
+ public:
+  NeighborList(size_t k, int max_distance) : k_(k), max_distance_(max_distance) {
+    neighbors_.reserve(k_);
+  }
+
+  /// The database indices must be offered in increasing order, such that ties keep the lower
+  /// index.
+  inline void offer(int distance, int database_index) {
+    if (distance > max_distance_) {
+      return;
+    }
+    if (neighbors_.size() == k_) {
+      if (distance >= neighbors_.back().first) {
+        return;
+      }
+      neighbors_.pop_back();
+    }
+    const std::pair<int, int> neighbor(distance, database_index);
+    neighbors_.insert(
+        std::upper_bound(neighbors_.begin(), neighbors_.end(), neighbor,
+                         [](const std::pair<int, int>& lhs, const std::pair<int, int>& rhs) {
+                           return lhs.first < rhs.first;
+                         }),
+        neighbor);
+  }
+
+  const std::vector<std::pair<int, int>>& getNeighbors() const { return neighbors_; }
+
+ private:
+  const size_t k_;
+  const int max_distance_;
+  std::vector<std::pair<int, int>> neighbors_;
+};
+}  // namespace
+
+#ifdef ASLAM_CV_WITH_CUDA
+struct BruteForceHammingMatcher::CudaImpl {
+  CudaImpl() : matcher(cv::cuda::DescriptorMatcher::createBFMatcher(cv::NORM_HAMMING)) {}
+
+  cv::Ptr<cv::cuda::DescriptorMatcher> matcher;
+  cv::cuda::Stream stream;
+  /// One descriptor per row, uploaded once by setDatabase().
+  cv::cuda::GpuMat device_database;
+  // Reused across the query tiles.
+  cv::cuda::GpuMat device_queries;
+  cv::cuda::GpuMat device_matches;
+};
+#else
+struct BruteForceHammingMatcher::CudaImpl {};
+#endif
+
+bool BruteForceHammingMatcher::isCudaBackendAvailable() {
+#ifdef ASLAM_CV_WITH_CUDA
+  static const bool kHasCudaDevice = cv::cuda::getCudaEnabledDeviceCount() > 0;
+  return kHasCudaDevice;
+#else
+  return false;
+#endif
+}
+
+BruteForceHammingMatcher::BruteForceHammingMatcher(const Options& options)
+    : options_(options), backend_(Backend::kCpu), database_size_(0u),
+      descriptor_size_bytes_(0u) {
+  CHECK_GT(options_.query_tile_size, 0u);
+  if (options_.use_cuda_if_available && isCudaBackendAvailable()) {
+    backend_ = Backend::kCuda;
+    cuda_impl_.reset(new CudaImpl);
+  }
+  VLOG(3) << "Brute-force Hamming matching on the "
+          << (backend_ == Backend::kCuda ? "CUDA" : "CPU") << " backend.";
+}
+
+BruteForceHammingMatcher::~BruteForceHammingMatcher() {}
+
+void BruteForceHammingMatcher::setDatabase(const DescriptorsT& database_descriptors) {
+  CHECK_GT(database_descriptors.rows(), 0);
+  database_size_ = static_cast<size_t>(database_descriptors.cols());
+  descriptor_size_bytes_ = static_cast<size_t>(database_descriptors.rows());
+  if (backend_ == Backend::kCuda) {
+#ifdef ASLAM_CV_WITH_CUDA
+    // The columns of the descriptor matrix are the rows of the OpenCV descriptor matrix.
+    const cv::Mat host_database(
+        static_cast<int>(database_size_), static_cast<int>(descriptor_size_bytes_), CV_8UC1,
+        const_cast<unsigned char*>(database_descriptors.data()));
+    cuda_impl_->device_database.upload(host_database, cuda_impl_->stream);
+    cuda_impl_->stream.waitForCompletion();
+#endif
+  } else {
+    database_descriptors_.setDescriptors(database_descriptors);
+  }
+}
+
+void BruteForceHammingMatcher::knnMatch(
+    const DescriptorsT& query_descriptors, size_t k, int max_hamming_distance,
+    MatchesWithScore* matches) {
+  CHECK_NOTNULL(matches)->clear();
+  CHECK_GT(k, 0u);
+  if (query_descriptors.cols() == 0 || database_size_ == 0u) {
+    return;
+  }
+  CHECK_EQ(static_cast<size_t>(query_descriptors.rows()), descriptor_size_bytes_)
+      << "The query and the database descriptors have different sizes.";
+  static const size_t kTimerHandle =
+      timing::Timing::GetHandle("BruteForceHammingMatcher::knnMatch");
+  timing::Timer timer(kTimerHandle);
+
+  if (backend_ == Backend::kCpu) {
+    knnMatchCpu(query_descriptors, k, max_hamming_distance, matches);
+    return;
+  }
+#ifdef ASLAM_CV_WITH_CUDA
+  const double num_bits = static_cast<double>(descriptor_size_bytes_ * 8u);
+  const size_t num_queries = static_cast<size_t>(query_descriptors.cols());
+  std::vector<std::vector<cv::DMatch>> tile_matches;
+  for (size_t tile_begin = 0u; tile_begin < num_queries;
+      tile_begin += options_.query_tile_size) {
+    const size_t tile_size = std::min(options_.query_tile_size, num_queries - tile_begin);
+    const cv::Mat host_queries(
+        static_cast<int>(tile_size), static_cast<int>(descriptor_size_bytes_), CV_8UC1,
+        const_cast<unsigned char*>(query_descriptors.col(tile_begin).data()));
+    cuda_impl_->device_queries.upload(host_queries, cuda_impl_->stream);
+    cuda_impl_->matcher->knnMatchAsync(
+        cuda_impl_->device_queries, cuda_impl_->device_database, cuda_impl_->device_matches,
+        static_cast<int>(k), cv::noArray(), cuda_impl_->stream);
+    cuda_impl_->stream.waitForCompletion();
+    cuda_impl_->matcher->knnMatchConvert(cuda_impl_->device_matches, tile_matches);
+    for (const std::vector<cv::DMatch>& query_matches : tile_matches) {
+      for (const cv::DMatch& match : query_matches) {
+        const int distance = static_cast<int>(match.distance + 0.5f);
+        if (match.trainIdx >= 0 && distance <= max_hamming_distance) {
+          matches->emplace_back(match.trainIdx, static_cast<int>(tile_begin) + match.queryIdx,
+                                (num_bits - distance) / num_bits);
+        }
+      }
+    }
+  }
+#else
+  LOG(FATAL) << "Built without ASLAM_CV_WITH_CUDA.";
+#endif
+}
+
+void BruteForceHammingMatcher::setVerificationDatabase(
+    const DescriptorsT& full_database_descriptors) {
+  CHECK_GT(full_database_descriptors.rows(), 0);
+  verification_descriptors_ = full_database_descriptors;
+}
+
+void BruteForceHammingMatcher::knnMatchVerified(
+    const DescriptorsT& query_descriptors, const DescriptorsT& full_query_descriptors,
+    size_t num_candidates, int max_hamming_distance, size_t k, int max_full_hamming_distance,
+    MatchesWithScore* matches) {
+  CHECK_NOTNULL(matches)->clear();
+  CHECK_GT(k, 0u);
+  CHECK_GE(num_candidates, k);
+  CHECK_EQ(static_cast<size_t>(verification_descriptors_.cols()), database_size_)
+      << "The verification database doesn't match the database.";
+  CHECK_EQ(full_query_descriptors.cols(), query_descriptors.cols());
+  CHECK_EQ(full_query_descriptors.rows(), verification_descriptors_.rows())
+      << "The full query and database descriptors have different sizes.";
+  MatchesWithScore candidates;
+  knnMatch(query_descriptors, num_candidates, max_hamming_distance, &candidates);
+  static const size_t kTimerHandle =
+      timing::Timing::GetHandle("BruteForceHammingMatcher::knnMatchVerified");
+  timing::Timer timer(kTimerHandle);
+
+  const size_t full_size_bytes = static_cast<size_t>(verification_descriptors_.rows());
+  const double num_bits = static_cast<double>(full_size_bytes * 8u);
+  std::vector<int> candidate_indices;
+  std::vector<common::Hamming::ResultType> distances;
+  std::vector<std::pair<int, int>> verified_neighbors;
+  // The candidates are ordered by query.
+  for (size_t begin = 0u; begin < candidates.size();) {
+    const int query_idx = candidates[begin].getKeypointIndexBananaFrame();
+    candidate_indices.clear();
+    size_t end = begin;
+    for (; end < candidates.size() &&
+         candidates[end].getKeypointIndexBananaFrame() == query_idx; ++end) {
+      candidate_indices.push_back(candidates[end].getKeypointIndexAppleFrame());
+    }
+    common::computeHammingDistancesBatch(
+        common::FeatureDescriptorConstRef(full_query_descriptors.col(query_idx).data(),
+                                          full_size_bytes),
+        verification_descriptors_, candidate_indices, &distances);
+    verified_neighbors.clear();
+    for (size_t i = 0u; i < candidate_indices.size(); ++i) {
+      if (distances[i] <= max_full_hamming_distance) {
+        verified_neighbors.emplace_back(distances[i], candidate_indices[i]);
+      }
+    }
+    // Stable, such that ties keep the order of the candidate search.
+    std::stable_sort(verified_neighbors.begin(), verified_neighbors.end(),
+                     [](const std::pair<int, int>& lhs, const std::pair<int, int>& rhs) {
+                       return lhs.first < rhs.first;
+                     });
+    for (size_t i = 0u; i < std::min(k, verified_neighbors.size()); ++i) {
+      matches->emplace_back(verified_neighbors[i].second, query_idx,
+                            (num_bits - verified_neighbors[i].first) / num_bits);
+    }
+    begin = end;
+  }
+}
+
+void BruteForceHammingMatcher::knnMatchCpu(
+    const DescriptorsT& query_descriptors, size_t k, int max_hamming_distance,
+    MatchesWithScore* matches) const {
+  CHECK_NOTNULL(matches);
+  const common::AlignedDescriptors aligned_queries(query_descriptors);
+  const size_t stride_bytes = database_descriptors_.getStrideBytes();
+  CHECK_EQ(stride_bytes, aligned_queries.getStrideBytes());
+  const size_t num_queries = aligned_queries.size();
+  const size_t database_tile_size =
+      std::min(database_size_, std::max<size_t>(1u, kDatabaseTileSizeBytes / stride_bytes));
+  std::vector<int> database_tile_indices(database_tile_size);
+  std::iota(database_tile_indices.begin(), database_tile_indices.end(), 0);
+
+  // Every query tile is compared against all database tiles on one thread.
+  const size_t num_query_tiles =
+      (num_queries + options_.query_tile_size - 1u) / options_.query_tile_size;
+  std::vector<std::vector<NeighborList>> tile_neighbors(num_query_tiles);
+  common::parallelFor(common::IndexRange(0u, num_query_tiles),
+                      options_.num_threads == 1u ? std::max<size_t>(1u, num_query_tiles) : 1u,
+                      [&](size_t tiles_begin, size_t tiles_end) {
+    for (size_t query_tile_idx = tiles_begin; query_tile_idx < tiles_end; ++query_tile_idx) {
+      const size_t query_begin = query_tile_idx * options_.query_tile_size;
+      const size_t query_end = std::min(num_queries, query_begin + options_.query_tile_size);
+      std::vector<NeighborList>& neighbors = tile_neighbors[query_tile_idx];
+      neighbors.reserve(query_end - query_begin);
+      for (size_t query_idx = query_begin; query_idx < query_end; ++query_idx) {
+        neighbors.emplace_back(k, max_hamming_distance);
+      }
+      std::vector<common::Hamming::ResultType> distances(database_tile_size);
+      for (size_t database_begin = 0u; database_begin < database_size_;
+          database_begin += database_tile_size) {
+        const size_t num_database_descriptors =
+            std::min(database_tile_size, database_size_ - database_begin);
+        const unsigned char* database_tile = database_descriptors_.getDescriptor(database_begin);
+        for (size_t query_idx = query_begin; query_idx < query_end; ++query_idx) {
+          common::Hamming::evaluateBatch(
+              aligned_queries.getDescriptor(query_idx), database_tile, stride_bytes,
+              database_tile_indices.data(), num_database_descriptors,
+              static_cast<int>(stride_bytes), distances.data());
+          NeighborList& query_neighbors = neighbors[query_idx - query_begin];
+          for (size_t tile_idx = 0u; tile_idx < num_database_descriptors; ++tile_idx) {
+            query_neighbors.offer(distances[tile_idx],
+                                  static_cast<int>(database_begin + tile_idx));
+          }
+        }
+      }
+    }
+  });
+
+  const double num_bits = static_cast<double>(descriptor_size_bytes_ * 8u);
+  int query_idx = 0;
+  for (const std::vector<NeighborList>& neighbors : tile_neighbors) {
+    for (const NeighborList& query_neighbors : neighbors) {
+      for (const std::pair<int, int>& neighbor : query_neighbors.getNeighbors()) {
+        matches->emplace_back(neighbor.second, query_idx, (num_bits - neighbor.first) / num_bits);
+      }
+      ++query_idx;
+    }
+  }
+}
+
+}  // namespace aslam
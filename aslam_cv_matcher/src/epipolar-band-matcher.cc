@@ -0,0 +1,182 @@
+#include "aslam/matcher/epipolar-band-matcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <aslam/common/feature-descriptor-ref.h>
+#include <aslam/common/hamming.h>
+#include <aslam/common/timer.h>
+#include <aslam/frames/visual-frame.h>
+#include <glog/logging.h>
+
+namespace aslam {
+namespace {
+// Below this baseline the epipolar planes are not defined.
+constexpr double kMinBaselineMeters = 1e-9;
+constexpr double kPi = 3.14159265358979323846;
+
+typedef std::pair<double, int> AngleIndexPair;
+
+// Appends the indices of the apples whose plane angle is in [min_angle, max_angle].
+void collectApplesInBand(const std::vector<AngleIndexPair>& sorted_apples, double min_angle,
+                         double max_angle, std::vector<int>* apple_indices) {
+  CHECK_NOTNULL(apple_indices);
+  std::vector<AngleIndexPair>::const_iterator it = std::lower_bound(
+      sorted_apples.begin(), sorted_apples.end(),
+      AngleIndexPair(min_angle, std::numeric_limits<int>::min()));
+  for (; it != sorted_apples.end() && it->first <= max_angle; ++it) {
+    apple_indices->push_back(it->second);
+  }
+}
+}  // namespace
+
+EpipolarBandMatcher::EpipolarBandMatcher(const Transformation& T_A_B, const Options& options)
+    : options_(options) {
+  CHECK_GT(options_.max_epipolar_angle_radians, 0.0);
+  CHECK_GT(options_.hamming_distance_threshold, 0);
+  // The banana camera sits on the positive x axis of the rectified frame.
+  const Eigen::Vector3d A_p_A_B = T_A_B.getPosition();
+  const double baseline = A_p_A_B.norm();
+  CHECK_GT(baseline, kMinBaselineMeters) << "The cameras share their optical center.";
+  const Eigen::Vector3d x_axis = A_p_A_B / baseline;
+
+  // The z axis is the mean optical axis projected onto the plane orthogonal to the baseline,
+  // which keeps the rectified frame close to both cameras.
+  const Eigen::Matrix3d R_A_B = T_A_B.getRotationMatrix();
+  Eigen::Vector3d z_axis = Eigen::Vector3d::UnitZ() + R_A_B.col(2);
+  z_axis -= z_axis.dot(x_axis) * x_axis;
+  if (z_axis.norm() < 1e-6) {
+    // The optical axes are (anti-)parallel to the baseline.
+    Eigen::Vector3d::Index least_aligned_axis;
+    x_axis.cwiseAbs().minCoeff(&least_aligned_axis);
+    z_axis = Eigen::Vector3d::Unit(least_aligned_axis);
+    z_axis -= z_axis.dot(x_axis) * x_axis;
+  }
+  z_axis.normalize();
+  const Eigen::Vector3d y_axis = z_axis.cross(x_axis);
+
+  R_R_A_.row(0) = x_axis.transpose();
+  R_R_A_.row(1) = y_axis.transpose();
+  R_R_A_.row(2) = z_axis.transpose();
+  R_R_B_ = R_R_A_ * R_A_B;
+}
+
+void EpipolarBandMatcher::computeEpipolarAngles(const Eigen::Vector3d& R_bearing,
+                                                double* plane_angle, double* baseline_angle) {
+  CHECK_NOTNULL(plane_angle);
+  CHECK_NOTNULL(baseline_angle);
+  *plane_angle = std::atan2(R_bearing.y(), R_bearing.z());
+  *baseline_angle = std::atan2(R_bearing.tail<2>().norm(), R_bearing.x());
+}
+
+void EpipolarBandMatcher::match(const VisualFrame& apple_frame, const VisualFrame& banana_frame,
+                                MatchesWithScore* matches_A_B) const {
+  CHECK_NOTNULL(matches_A_B)->clear();
+  static const size_t kTimerHandle = timing::Timing::GetHandle("EpipolarBandMatcher::match");
+  timing::Timer timer(kTimerHandle);
+  const size_t num_apples = apple_frame.getNumKeypointMeasurements();
+  const size_t num_bananas = banana_frame.getNumKeypointMeasurements();
+  if (num_apples == 0u || num_bananas == 0u) {
+    return;
+  }
+  const uint32_t descriptor_size_bytes = apple_frame.getDescriptorSizeBytes();
+  CHECK_EQ(descriptor_size_bytes, banana_frame.getDescriptorSizeBytes())
+      << "Apple and banana frames have different descriptor lengths.";
+  const VisualFrame::DescriptorsT& apple_descriptors = apple_frame.getDescriptors();
+  const VisualFrame::DescriptorsT& banana_descriptors = banana_frame.getDescriptors();
+  CHECK_EQ(static_cast<size_t>(apple_descriptors.cols()), num_apples);
+  CHECK_EQ(static_cast<size_t>(banana_descriptors.cols()), num_bananas);
+  const common::Hamming::FixedSizeBatchFunction fixed_size_distance_function =
+      common::Hamming::getFixedSizeBatchFunction(static_cast<int>(descriptor_size_bytes));
+
+  // The apples sorted by the angle of their epipolar plane.
+  const Eigen::Matrix3Xd R_apple_bearings =
+      R_R_A_ * apple_frame.getNormalizedBearingVectors();
+  const std::vector<unsigned char>& apple_success =
+      apple_frame.getBearingVectorBackprojectionSuccess();
+  std::vector<AngleIndexPair> sorted_apples;
+  sorted_apples.reserve(num_apples);
+  std::vector<double> apple_baseline_angles(num_apples);
+  for (size_t apple_idx = 0u; apple_idx < num_apples; ++apple_idx) {
+    if (!apple_success[apple_idx]) {
+      continue;
+    }
+    double plane_angle;
+    computeEpipolarAngles(R_apple_bearings.col(apple_idx), &plane_angle,
+                          &apple_baseline_angles[apple_idx]);
+    sorted_apples.emplace_back(plane_angle, static_cast<int>(apple_idx));
+  }
+  std::sort(sorted_apples.begin(), sorted_apples.end());
+
+  const Eigen::Matrix3Xd R_banana_bearings =
+      R_R_B_ * banana_frame.getNormalizedBearingVectors();
+  const std::vector<unsigned char>& banana_success =
+      banana_frame.getBearingVectorBackprojectionSuccess();
+  const double band = options_.max_epipolar_angle_radians;
+  const common::Hamming::ResultType max_distance = options_.hamming_distance_threshold - 1;
+
+  // The best banana of every apple, exclusive.
+  std::vector<std::pair<int, int>> apple_distance_banana(
+      num_apples, std::make_pair(options_.hamming_distance_threshold, -1));
+  std::vector<int> apple_indices;
+  std::vector<common::Hamming::ResultType> distances;
+  for (size_t banana_idx = 0u; banana_idx < num_bananas; ++banana_idx) {
+    if (!banana_success[banana_idx]) {
+      continue;
+    }
+    double plane_angle, banana_baseline_angle;
+    computeEpipolarAngles(R_banana_bearings.col(banana_idx), &plane_angle,
+                          &banana_baseline_angle);
+    apple_indices.clear();
+    collectApplesInBand(sorted_apples, plane_angle - band, plane_angle + band, &apple_indices);
+    // The band wraps around at +-pi.
+    if (plane_angle - band < -kPi) {
+      collectApplesInBand(sorted_apples, plane_angle - band + 2.0 * kPi, kPi, &apple_indices);
+    }
+    if (plane_angle + band > kPi) {
+      collectApplesInBand(sorted_apples, -kPi, plane_angle + band - 2.0 * kPi, &apple_indices);
+    }
+    // The rays only intersect in front of both cameras if the banana ray is at a larger angle
+    // to the baseline than the apple ray, parallel rays correspond to points at infinity.
+    apple_indices.erase(std::remove_if(apple_indices.begin(), apple_indices.end(),
+                                       [&](int apple_idx) {
+                                         return banana_baseline_angle <
+                                             apple_baseline_angles[apple_idx] - band;
+                                       }),
+                        apple_indices.end());
+    if (apple_indices.empty()) {
+      continue;
+    }
+
+    common::computeHammingDistancesBatchBounded(
+        common::FeatureDescriptorConstRef(banana_descriptors.col(banana_idx).data(),
+                                          descriptor_size_bytes),
+        apple_descriptors, apple_indices, max_distance, &distances,
+        fixed_size_distance_function);
+    int best_distance = options_.hamming_distance_threshold;
+    int best_apple_idx = -1;
+    for (size_t candidate_idx = 0u; candidate_idx < apple_indices.size(); ++candidate_idx) {
+      if (distances[candidate_idx] < best_distance) {
+        best_distance = distances[candidate_idx];
+        best_apple_idx = apple_indices[candidate_idx];
+      }
+    }
+    if (best_apple_idx >= 0 && best_distance < apple_distance_banana[best_apple_idx].first) {
+      apple_distance_banana[best_apple_idx] =
+          std::make_pair(best_distance, static_cast<int>(banana_idx));
+    }
+  }
+
+  const double descriptor_size_bits = 8.0 * descriptor_size_bytes;
+  for (size_t apple_idx = 0u; apple_idx < num_apples; ++apple_idx) {
+    const std::pair<int, int>& distance_banana = apple_distance_banana[apple_idx];
+    if (distance_banana.second >= 0) {
+      matches_A_B->emplace_back(
+          static_cast<int>(apple_idx), distance_banana.second,
+          (descriptor_size_bits - distance_banana.first) / descriptor_size_bits);
+    }
+  }
+}
+
+}  // namespace aslam
@@ -1,27 +1,39 @@
 #include "aslam/matcher/gyro-two-frame-matcher.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <aslam/common/allocation-counter.h>
+#include <aslam/common/deadline.h>
 #include <aslam/common/statistics/statistics.h>
+#include <aslam/common/timer.h>
+#include <Eigen/Geometry>
+#include <Eigen/LU>
 
 namespace aslam {
 
-GyroTwoFrameMatcher::GyroTwoFrameMatcher(
+GyroTwoFrameMatcher::GyroTwoFrameMatcher(const uint32_t image_height)
+  : frame_kp1_(nullptr), frame_k_(nullptr), q_Ckp1_Ck_(nullptr),
+    predicted_keypoint_positions_kp1_(nullptr), prediction_success_(nullptr),
+    search_radii_px_(nullptr),
+    descriptor_size_bytes_(0u), descriptor_size_bits_(0u),
+    fixed_size_distance_function_(nullptr), max_relevant_distance_(0),
+    num_points_kp1_(0),
+    num_points_k_(0), kImageHeight(image_height), matches_kp1_k_(nullptr),
+    // A single column of one pixel high cells, i.e. one cell per image row.
+    keypoints_kp1_grid_(kImageHeight, 1u, 1.0, std::numeric_limits<double>::max()),
+    coarse_to_fine_enabled_(false), large_window_search_enabled_(true) {
+  CHECK_GT(kImageHeight, 0u);
+}
+
+void GyroTwoFrameMatcher::initialize(
     const Quaternion& q_Ckp1_Ck,
     const VisualFrame& frame_kp1,
     const VisualFrame& frame_k,
-    const uint32_t image_height,
     const Eigen::Matrix2Xd& predicted_keypoint_positions_kp1,
     const std::vector<unsigned char>& prediction_success,
-    FrameToFrameMatchesWithScore* matches_with_score_kp1_k)
-  : frame_kp1_(frame_kp1), frame_k_(frame_k), q_Ckp1_Ck_(q_Ckp1_Ck),
-    predicted_keypoint_positions_kp1_(predicted_keypoint_positions_kp1),
-    prediction_success_(prediction_success),
-    kDescriptorSizeBytes(frame_kp1.getDescriptorSizeBytes()),
-    kNumPointsKp1(frame_kp1.getKeypointMeasurements().cols()),
-    kNumPointsK(frame_k.getKeypointMeasurements().cols()),
-    kImageHeight(image_height),
-    matches_kp1_k_(matches_with_score_kp1_k),
-    is_keypoint_kp1_matched_(kNumPointsKp1, false),
-    iteration_processed_keypoints_kp1_(kNumPointsKp1, false) {
+    FrameToFrameMatchesWithScore* matches_kp1_k) {
   CHECK(frame_kp1.isValid());
   CHECK(frame_k.isValid());
   CHECK(frame_kp1.hasDescriptors());
@@ -29,133 +41,191 @@ GyroTwoFrameMatcher::GyroTwoFrameMatcher(
   CHECK(frame_kp1.hasKeypointMeasurements());
   CHECK(frame_k.hasKeypointMeasurements());
   CHECK_GT(frame_kp1.getTimestampNanoseconds(), frame_k.getTimestampNanoseconds());
-  CHECK_NOTNULL(matches_kp1_k_)->clear();
-  CHECK_EQ(kNumPointsKp1, frame_kp1.getDescriptors().cols()) <<
+  CHECK_NOTNULL(matches_kp1_k)->clear();
+
+  frame_kp1_ = &frame_kp1;
+  frame_k_ = &frame_k;
+  q_Ckp1_Ck_ = &q_Ckp1_Ck;
+  predicted_keypoint_positions_kp1_ = &predicted_keypoint_positions_kp1;
+  prediction_success_ = &prediction_success;
+  matches_kp1_k_ = matches_kp1_k;
+  descriptor_size_bytes_ = frame_kp1.getDescriptorSizeBytes();
+  descriptor_size_bits_ = static_cast<unsigned int>(8u * descriptor_size_bytes_);
+  fixed_size_distance_function_ = common::Hamming::getFixedSizeBatchFunction(
+      static_cast<int>(descriptor_size_bytes_));
+  num_points_kp1_ = frame_kp1.getKeypointMeasurements().cols();
+  num_points_k_ = frame_k.getKeypointMeasurements().cols();
+  // A match needs a distance of at most max_match_distance. A candidate farther away than
+  // max_match_distance / kLoweRatio neither matches nor fails the ratio test as second best,
+  // and its score is below the strict threshold of the inferior matching. Hence, distances
+  // above this bound don't need to be exact.
+  const int max_match_distance = static_cast<int>(descriptor_size_bits_) -
+      static_cast<int>(descriptor_size_bits_ * kMatchingThresholdBitsRatioRelaxed) - 1;
+  max_relevant_distance_ = static_cast<int>(std::ceil(max_match_distance / kLoweRatio));
+
+  CHECK_EQ(num_points_kp1_, frame_kp1.getDescriptors().cols()) <<
       "Number of keypoints and descriptors in frame k+1 is not the same.";
-  CHECK_EQ(kNumPointsK, frame_k.getDescriptors().cols()) <<
+  CHECK_EQ(num_points_k_, frame_k.getDescriptors().cols()) <<
       "Number of keypoints and descriptors in frame k is not the same.";
-  CHECK_LE(kDescriptorSizeBytes*8, 512u) << "Usually binary descriptors' size "
+  CHECK_LE(descriptor_size_bits_, 512u) << "Usually binary descriptors' size "
       "is less or equal to 512 bits. Adapt the following check if this "
       "framework uses larger binary descriptors.";
-  CHECK_GT(kImageHeight, 0u);
-  CHECK_EQ(iteration_processed_keypoints_kp1_.size(), kNumPointsKp1);
-  CHECK_EQ(is_keypoint_kp1_matched_.size(), kNumPointsKp1);
-  CHECK_EQ(prediction_success_.size(), predicted_keypoint_positions_kp1_.cols());
-
-  descriptors_kp1_wrapped_.reserve(kNumPointsKp1);
-  keypoints_kp1_sorted_by_y_.reserve(kNumPointsKp1);
-  descriptors_k_wrapped_.reserve(kNumPointsK);
-  matches_kp1_k_->reserve(kNumPointsK);
-  corner_row_LUT_.reserve(kImageHeight);
-}
+  CHECK_EQ(prediction_success.size(), predicted_keypoint_positions_kp1.cols());
+  CHECK_EQ(static_cast<int>(prediction_success.size()), num_points_k_);
+
+  // The buffers keep their capacity from previous calls. The match vector must not
+  // reallocate while matching as matches are referenced by index only, but reserving
+  // avoids the reallocation cost.
+  matches_kp1_k_->reserve(num_points_k_);
+  is_keypoint_kp1_matched_.assign(num_points_kp1_, false);
+  iteration_processed_keypoints_kp1_.assign(num_points_kp1_, false);
+  kp1_idx_to_match_index_.assign(num_points_kp1_, -1);
+  idx_k_to_attempted_match_data_.assign(num_points_k_, MatchData());
+  erase_inferior_match_keypoint_idx_k_.assign(num_points_k_, false);
+  candidate_keypoints_kp1_.clear();
+  candidate_matching_scores_.clear();
+  inferior_match_keypoint_idx_k_.clear();
 
-void GyroTwoFrameMatcher::initialize() {
   // Prepare descriptors for efficient matching.
-  const Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>& descriptors_kp1 =
-      frame_kp1_.getDescriptors();
   const Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>& descriptors_k =
-      frame_k_.getDescriptors();
-
-  for (int descriptor_kp1_idx = 0; descriptor_kp1_idx < kNumPointsKp1;
-      ++descriptor_kp1_idx) {
-    descriptors_kp1_wrapped_.emplace_back(
-        &(descriptors_kp1.coeffRef(0, descriptor_kp1_idx)), kDescriptorSizeBytes);
-  }
-
-  for (int descriptor_k_idx = 0; descriptor_k_idx < kNumPointsK;
+      frame_k.getDescriptors();
+  descriptors_k_wrapped_.clear();
+  for (int descriptor_k_idx = 0; descriptor_k_idx < num_points_k_;
       ++descriptor_k_idx) {
     descriptors_k_wrapped_.emplace_back(
-        &(descriptors_k.coeffRef(0, descriptor_k_idx)), kDescriptorSizeBytes);
+        &(descriptors_k.coeffRef(0, descriptor_k_idx)), descriptor_size_bytes_);
   }
 
-  // Sort keypoints of frame (k+1) from small to large y coordinates.
-  for (int i = 0; i < kNumPointsKp1; ++i) {
-    keypoints_kp1_sorted_by_y_.emplace_back(frame_kp1_.getKeypointMeasurement(i), i);
-  }
-
-  std::sort(keypoints_kp1_sorted_by_y_.begin(), keypoints_kp1_sorted_by_y_.end(),
-            [](const KeypointData& lhs, const KeypointData& rhs)-> bool {
-              return lhs.measurement(1) < rhs.measurement(1);
-            });
-
-  // Lookup table construction.
+  // Sort keypoints of frame (k+1) into the image rows.
   // TODO(magehrig):  Sort by y if image height >= image width,
   //                  otherwise sort by x.
-  int v = 0;
-  for (size_t y = 0u; y < kImageHeight; ++y) {
-    while (v < kNumPointsKp1 &&
-        y > static_cast<size_t>(keypoints_kp1_sorted_by_y_[v].measurement(1))) {
-      ++v;
-    }
-    corner_row_LUT_.push_back(v);
+  keypoints_kp1_grid_.build(frame_kp1.getKeypointMeasurements(), nullptr);
+  CHECK_EQ(static_cast<int>(keypoints_kp1_grid_.numKeypoints()), num_points_kp1_);
+  keypoints_kp1_sorted_by_y_.clear();
+  for (size_t sorted_idx = 0u; sorted_idx < keypoints_kp1_grid_.numKeypoints(); ++sorted_idx) {
+    keypoints_kp1_sorted_by_y_.emplace_back(
+        keypoints_kp1_grid_.getSortedKeypoints().col(sorted_idx),
+        keypoints_kp1_grid_.getSortedKeypointIndex(sorted_idx));
   }
-  CHECK_EQ(static_cast<int>(corner_row_LUT_.size()), kImageHeight);
 }
 
-void GyroTwoFrameMatcher::match() {
-  initialize();
+void GyroTwoFrameMatcher::match(
+    const Quaternion& q_Ckp1_Ck,
+    const VisualFrame& frame_kp1,
+    const VisualFrame& frame_k,
+    const Eigen::Matrix2Xd& predicted_keypoint_positions_kp1,
+    const std::vector<unsigned char>& prediction_success,
+    FrameToFrameMatchesWithScore* matches_kp1_k) {
+  matchImpl(q_Ckp1_Ck, frame_kp1, frame_k, predicted_keypoint_positions_kp1, prediction_success,
+            nullptr, matches_kp1_k);
+}
+
+void GyroTwoFrameMatcher::match(
+    const Quaternion& q_Ckp1_Ck,
+    const VisualFrame& frame_kp1,
+    const VisualFrame& frame_k,
+    const Eigen::Matrix2Xd& predicted_keypoint_positions_kp1,
+    const std::vector<unsigned char>& prediction_success,
+    const Eigen::VectorXd& search_radii_px,
+    FrameToFrameMatchesWithScore* matches_kp1_k) {
+  CHECK_EQ(static_cast<size_t>(search_radii_px.rows()), prediction_success.size());
+  matchImpl(q_Ckp1_Ck, frame_kp1, frame_k, predicted_keypoint_positions_kp1, prediction_success,
+            &search_radii_px, matches_kp1_k);
+}
 
-  if (kNumPointsK == 0 || kNumPointsKp1 == 0) {
+void GyroTwoFrameMatcher::matchImpl(
+    const Quaternion& q_Ckp1_Ck,
+    const VisualFrame& frame_kp1,
+    const VisualFrame& frame_k,
+    const Eigen::Matrix2Xd& predicted_keypoint_positions_kp1,
+    const std::vector<unsigned char>& prediction_success,
+    const Eigen::VectorXd* search_radii_px,
+    FrameToFrameMatchesWithScore* matches_kp1_k) {
+  common::AllocationCounter allocation_counter("GyroTwoFrameMatcher::match");
+  initialize(q_Ckp1_Ck, frame_kp1, frame_k, predicted_keypoint_positions_kp1,
+             prediction_success, matches_kp1_k);
+  search_radii_px_ = search_radii_px;
+
+  if (num_points_k_ == 0 || num_points_kp1_ == 0) {
     return;
   }
 
-  for (int i = 0; i < kNumPointsK; ++i) {
+  if (coarse_to_fine_enabled_ && estimateCoarsePredictionCorrection()) {
+    predicted_keypoint_positions_kp1_ = &corrected_predicted_keypoint_positions_kp1_;
+  }
+
+  // Under a deadline, the large windows are dropped once the budget runs low and the inferior
+  // matches are not re-matched once it expired.
+  const common::Deadline& deadline = common::DeadlineScope::getCurrentDeadline();
+  large_window_search_enabled_ = true;
+  for (int i = 0; i < num_points_k_; ++i) {
+    if (large_window_search_enabled_ && deadline.isBounded() &&
+        i % kNumKeypointsPerDeadlineCheck == 0 &&
+        deadline.getRemainingRatio() < kLargeWindowMinRemainingBudgetRatio) {
+      large_window_search_enabled_ = false;
+      common::DeadlineScope::addDegradation(common::Degradation::kShrunkSearchWindows);
+    }
     matchKeypoint(i);
   }
 
-  std::vector<bool> is_inferior_keypoint_kp1_matched(
-      is_keypoint_kp1_matched_);
+  is_inferior_keypoint_kp1_matched_ = is_keypoint_kp1_matched_;
   for (size_t i = 0u; i < kMaxNumInferiorIterations; ++i) {
-    if(!matchInferiorMatches(&is_inferior_keypoint_kp1_matched)) return;
+    if (deadline.hasExpired()) {
+      common::DeadlineScope::addDegradation(common::Degradation::kSkippedInferiorMatching);
+      return;
+    }
+    if(!matchInferiorMatches(&is_inferior_keypoint_kp1_matched_)) return;
   }
 }
 
 void GyroTwoFrameMatcher::matchKeypoint(const int idx_k) {
-  if (!prediction_success_[idx_k]) {
+  if (!(*prediction_success_)[idx_k]) {
     return;
   }
-
-  std::fill(iteration_processed_keypoints_kp1_.begin(),
-            iteration_processed_keypoints_kp1_.end(),
-            false);
+  // Runs per keypoint, sample it with timing::Timing::SetSamplingInterval.
+  static const size_t kTimerHandle =
+      timing::Timing::GetHandle("GyroTwoFrameMatcher::matchKeypoint");
+  timing::Timer timer(kTimerHandle);
 
   bool found = false;
   bool passed_ratio_test = false;
   int n_processed_corners = 0;
   KeyPointIterator it_best;
-  const static unsigned int kDescriptorSizeBits = 8 * kDescriptorSizeBytes;
+  const unsigned int kDescriptorSizeBits = descriptor_size_bits_;
   int best_score = static_cast<int>(
       kDescriptorSizeBits * kMatchingThresholdBitsRatioRelaxed);
   unsigned int distance_best = kDescriptorSizeBits + 1;
   unsigned int distance_second_best = kDescriptorSizeBits + 1;
-  const common::FeatureDescriptorConstRef& descriptor_k =
-      descriptors_k_wrapped_[idx_k];
-
   Eigen::Vector2d predicted_keypoint_position_kp1 =
-      predicted_keypoint_positions_kp1_.block<2, 1>(0, idx_k);
+      predicted_keypoint_positions_kp1_->block<2, 1>(0, idx_k);
+  int small_search_distance = kSmallSearchDistance;
+  int large_search_distance = kLargeSearchDistance;
+  if (search_radii_px_ != nullptr) {
+    small_search_distance = clamp(
+        1, kSmallSearchDistance, static_cast<int>(std::ceil((*search_radii_px_)(idx_k))));
+    large_search_distance = clamp(1, kLargeSearchDistance, 2 * small_search_distance);
+  }
   KeyPointIterator nearest_corners_begin, nearest_corners_end;
-  getKeypointIteratorsInWindow<kSmallSearchDistance>(
-      predicted_keypoint_position_kp1, &nearest_corners_begin, &nearest_corners_end);
+  getKeypointIteratorsInWindow(
+      predicted_keypoint_position_kp1, small_search_distance, &nearest_corners_begin,
+      &nearest_corners_end);
 
   const int bound_left_nearest =
-      predicted_keypoint_position_kp1(0) - kSmallSearchDistance;
+      predicted_keypoint_position_kp1(0) - small_search_distance;
   const int bound_right_nearest =
-      predicted_keypoint_position_kp1(0) + kSmallSearchDistance;
+      predicted_keypoint_position_kp1(0) + small_search_distance;
 
+  // The candidates are appended to the pool and dropped again if the match is rejected.
   MatchData current_match_data;
+  current_match_data.candidates_begin = candidate_keypoints_kp1_.size();
 
   // First search small window.
-  for (KeyPointIterator it = nearest_corners_begin; it != nearest_corners_end; ++it) {
-    if (it->measurement(0) < bound_left_nearest ||
-        it->measurement(0) > bound_right_nearest) {
-      continue;
-    }
-
-    CHECK_LT(it->channel_index, kNumPointsKp1);
-    CHECK_GE(it->channel_index, 0u);
-    const common::FeatureDescriptorConstRef& descriptor_kp1 =
-        descriptors_kp1_wrapped_[it->channel_index];
-    unsigned int distance = common::GetNumBitsDifferent(descriptor_k, descriptor_kp1);
+  computeDistancesInWindow(
+      idx_k, nearest_corners_begin, nearest_corners_end, bound_left_nearest,
+      bound_right_nearest, false /* skip_processed_keypoints */);
+  for (size_t window_idx = 0u; window_idx < window_keypoints_kp1_.size(); ++window_idx) {
+    const KeyPointIterator& it = window_keypoints_kp1_[window_idx];
+    const unsigned int distance = window_distances_kp1_[window_idx];
     int current_score = kDescriptorSizeBits - distance;
     if (current_score > best_score) {
       best_score = current_score;
@@ -172,34 +242,30 @@ void GyroTwoFrameMatcher::matchKeypoint(const int idx_k) {
     ++n_processed_corners;
     const double current_matching_score =
         computeMatchingScore(current_score, kDescriptorSizeBits);
-    current_match_data.addCandidate(it, current_matching_score);
+    candidate_keypoints_kp1_.push_back(it);
+    candidate_matching_scores_.push_back(current_matching_score);
   }
+  const size_t num_candidates_small_window =
+      candidate_keypoints_kp1_.size() - current_match_data.candidates_begin;
 
   // If no match in small window, increase window and search again.
-  if (!found) {
+  if (!found && large_window_search_enabled_) {
     const int bound_left_near =
-        predicted_keypoint_position_kp1(0) - kLargeSearchDistance;
+        predicted_keypoint_position_kp1(0) - large_search_distance;
     const int bound_right_near =
-        predicted_keypoint_position_kp1(0) + kLargeSearchDistance;
+        predicted_keypoint_position_kp1(0) + large_search_distance;
 
     KeyPointIterator near_corners_begin, near_corners_end;
-    getKeypointIteratorsInWindow<kLargeSearchDistance>(
-        predicted_keypoint_position_kp1, &near_corners_begin, &near_corners_end);
-
-    for (KeyPointIterator it = near_corners_begin; it != near_corners_end; ++it) {
-      if (iteration_processed_keypoints_kp1_[it->channel_index]) {
-        continue;
-      }
-      if (it->measurement(0) < bound_left_near ||
-          it->measurement(0) > bound_right_near) {
-        continue;
-      }
-      CHECK_LT(it->channel_index, kNumPointsKp1);
-      CHECK_GE(it->channel_index, 0);
-      const common::FeatureDescriptorConstRef& descriptor_kp1 =
-          descriptors_kp1_wrapped_[it->channel_index];
-      unsigned int distance =
-          common::GetNumBitsDifferent(descriptor_k, descriptor_kp1);
+    getKeypointIteratorsInWindow(
+        predicted_keypoint_position_kp1, large_search_distance, &near_corners_begin,
+        &near_corners_end);
+
+    computeDistancesInWindow(
+        idx_k, near_corners_begin, near_corners_end, bound_left_near,
+        bound_right_near, true /* skip_processed_keypoints */);
+    for (size_t window_idx = 0u; window_idx < window_keypoints_kp1_.size(); ++window_idx) {
+      const KeyPointIterator& it = window_keypoints_kp1_[window_idx];
+      const unsigned int distance = window_distances_kp1_[window_idx];
       int current_score = kDescriptorSizeBits - distance;
       if (current_score > best_score) {
         best_score = current_score;
@@ -215,38 +281,42 @@ void GyroTwoFrameMatcher::matchKeypoint(const int idx_k) {
       ++n_processed_corners;
       const double current_matching_score =
           computeMatchingScore(current_score, kDescriptorSizeBits);
-      current_match_data.addCandidate(it, current_matching_score);
+      candidate_keypoints_kp1_.push_back(it);
+      candidate_matching_scores_.push_back(current_matching_score);
     }
   }
 
+  // Only the keypoints of the small window were flagged.
+  for (size_t i = 0u; i < num_candidates_small_window; ++i) {
+    iteration_processed_keypoints_kp1_[
+        candidate_keypoints_kp1_[current_match_data.candidates_begin + i]->channel_index] = false;
+  }
+
   if (found) {
     passed_ratio_test = ratioTest(kDescriptorSizeBits, distance_best,
                                   distance_second_best);
   }
 
   if (passed_ratio_test) {
-    CHECK(idx_k_to_attempted_match_data_map_.insert(
-        std::make_pair(idx_k, current_match_data)).second);
+    current_match_data.num_candidates =
+        candidate_keypoints_kp1_.size() - current_match_data.candidates_begin;
+    idx_k_to_attempted_match_data_[idx_k] = current_match_data;
     const int best_match_keypoint_idx_kp1 = it_best->channel_index;
     const double matching_score = computeMatchingScore(
         best_score, kDescriptorSizeBits);
     if (is_keypoint_kp1_matched_[best_match_keypoint_idx_kp1]) {
-      if (matching_score > kp1_idx_to_matches_iterator_map_
-          [best_match_keypoint_idx_kp1]->getScore()) {
+      FrameToFrameMatchWithScore& previous_match =
+          getMatchOfKeypointKp1(best_match_keypoint_idx_kp1);
+      if (matching_score > previous_match.getScore()) {
         // The current match is better than a previous match associated with the
         // current keypoint of frame (k+1). Hence, the inferior match is the
         // previous match associated with the current keypoint of frame (k+1).
-        const int inferior_keypoint_idx_k =
-            kp1_idx_to_matches_iterator_map_
-            [best_match_keypoint_idx_kp1]->getKeypointIndexBananaFrame();
+        const int inferior_keypoint_idx_k = previous_match.getKeypointIndexBananaFrame();
         inferior_match_keypoint_idx_k_.push_back(inferior_keypoint_idx_k);
 
-        kp1_idx_to_matches_iterator_map_
-        [best_match_keypoint_idx_kp1]->setScore(matching_score);
-        kp1_idx_to_matches_iterator_map_
-        [best_match_keypoint_idx_kp1]->setIndexApple(best_match_keypoint_idx_kp1);
-        kp1_idx_to_matches_iterator_map_
-        [best_match_keypoint_idx_kp1]->setIndexBanana(idx_k);
+        previous_match.setScore(matching_score);
+        previous_match.setIndexApple(best_match_keypoint_idx_kp1);
+        previous_match.setIndexBanana(idx_k);
       } else {
         // The current match is inferior to a previous match associated with the
         // current keypoint of frame (k+1).
@@ -254,24 +324,196 @@ void GyroTwoFrameMatcher::matchKeypoint(const int idx_k) {
         }
     } else {
       is_keypoint_kp1_matched_[best_match_keypoint_idx_kp1] = true;
+      kp1_idx_to_match_index_[best_match_keypoint_idx_kp1] =
+          static_cast<int>(matches_kp1_k_->size());
       matches_kp1_k_->emplace_back(
           best_match_keypoint_idx_kp1, idx_k, matching_score);
-
-      CHECK(matches_kp1_k_->end() != matches_kp1_k_->begin())
-        << "Match vector should not be empty.";
-      CHECK(kp1_idx_to_matches_iterator_map_.emplace(
-          best_match_keypoint_idx_kp1, matches_kp1_k_->end() - 1).second);
     }
 
     statistics::StatsCollector stats_distance_match(
         "GyroTracker: number of matching bits");
     stats_distance_match.AddSample(best_score);
+  } else {
+    candidate_keypoints_kp1_.resize(current_match_data.candidates_begin);
+    candidate_matching_scores_.resize(current_match_data.candidates_begin);
   }
   statistics::StatsCollector stats_count_processed(
       "GyroTracker: number of computed distances per keypoint");
   stats_count_processed.AddSample(n_processed_corners);
 }
 
+void GyroTwoFrameMatcher::computeDistancesInWindow(
+    const int idx_k, const KeyPointIterator it_keypoints_begin,
+    const KeyPointIterator it_keypoints_end, const int bound_left,
+    const int bound_right, const bool skip_processed_keypoints) {
+  window_keypoints_kp1_.clear();
+  window_indices_kp1_.clear();
+  for (KeyPointIterator it = it_keypoints_begin; it != it_keypoints_end; ++it) {
+    if (skip_processed_keypoints &&
+        iteration_processed_keypoints_kp1_[it->channel_index]) {
+      continue;
+    }
+    if (it->measurement(0) < bound_left || it->measurement(0) > bound_right) {
+      continue;
+    }
+    CHECK_LT(it->channel_index, num_points_kp1_);
+    CHECK_GE(it->channel_index, 0);
+    window_keypoints_kp1_.push_back(it);
+    window_indices_kp1_.push_back(it->channel_index);
+  }
+
+  CHECK_LT(idx_k, num_points_k_);
+  common::computeHammingDistancesBatchBounded(
+      descriptors_k_wrapped_[idx_k], frame_kp1_->getDescriptors(),
+      window_indices_kp1_, max_relevant_distance_, &window_distances_kp1_,
+      fixed_size_distance_function_);
+}
+
+bool GyroTwoFrameMatcher::estimateCoarsePredictionCorrection() {
+  // The strongest keypoints of frame k, or evenly spread ones if there are no scores.
+  coarse_keypoint_indices_k_.clear();
+  for (int idx_k = 0; idx_k < num_points_k_; ++idx_k) {
+    if ((*prediction_success_)[idx_k]) {
+      coarse_keypoint_indices_k_.push_back(idx_k);
+    }
+  }
+  const size_t num_candidates_k = coarse_keypoint_indices_k_.size();
+  if (num_candidates_k < kMinNumCoarseMatches) {
+    return false;
+  }
+  if (num_candidates_k > kNumCoarseKeypoints) {
+    if (frame_k_->hasKeypointScores()) {
+      const Eigen::VectorXd& keypoint_scores_k = frame_k_->getKeypointScores();
+      std::nth_element(
+          coarse_keypoint_indices_k_.begin(),
+          coarse_keypoint_indices_k_.begin() + kNumCoarseKeypoints,
+          coarse_keypoint_indices_k_.end(), [&keypoint_scores_k](const int lhs, const int rhs) {
+        return keypoint_scores_k(lhs) > keypoint_scores_k(rhs);
+      });
+    } else {
+      for (size_t i = 0u; i < kNumCoarseKeypoints; ++i) {
+        coarse_keypoint_indices_k_[i] =
+            coarse_keypoint_indices_k_[i * num_candidates_k / kNumCoarseKeypoints];
+      }
+    }
+    coarse_keypoint_indices_k_.resize(kNumCoarseKeypoints);
+  }
+
+  // Unambiguous matches within the large window, without modifying the matcher state.
+  const int min_score =
+      static_cast<int>(descriptor_size_bits_ * kMatchingThresholdBitsRatioRelaxed);
+  coarse_predictions_kp1_.clear();
+  coarse_measurements_kp1_.clear();
+  for (const int idx_k : coarse_keypoint_indices_k_) {
+    const Eigen::Vector2d predicted_keypoint_position_kp1 =
+        predicted_keypoint_positions_kp1_->col(idx_k);
+    KeyPointIterator coarse_corners_begin, coarse_corners_end;
+    getKeypointIteratorsInWindow(
+        predicted_keypoint_position_kp1, kCoarseSearchDistance, &coarse_corners_begin,
+        &coarse_corners_end);
+    computeDistancesInWindow(
+        idx_k, coarse_corners_begin, coarse_corners_end,
+        static_cast<int>(predicted_keypoint_position_kp1(0) - kCoarseSearchDistance),
+        static_cast<int>(predicted_keypoint_position_kp1(0) + kCoarseSearchDistance),
+        false /* skip_processed_keypoints */);
+
+    unsigned int distance_best = descriptor_size_bits_ + 1u;
+    unsigned int distance_second_best = descriptor_size_bits_ + 1u;
+    KeyPointIterator it_best;
+    for (size_t window_idx = 0u; window_idx < window_keypoints_kp1_.size(); ++window_idx) {
+      const unsigned int distance = window_distances_kp1_[window_idx];
+      if (distance < distance_best) {
+        distance_second_best = distance_best;
+        distance_best = distance;
+        it_best = window_keypoints_kp1_[window_idx];
+      } else if (distance < distance_second_best) {
+        distance_second_best = distance;
+      }
+    }
+    if (distance_best <= descriptor_size_bits_ &&
+        static_cast<int>(descriptor_size_bits_ - distance_best) > min_score &&
+        ratioTest(descriptor_size_bits_, distance_best, distance_second_best)) {
+      coarse_predictions_kp1_.push_back(predicted_keypoint_position_kp1);
+      coarse_measurements_kp1_.push_back(it_best->measurement);
+    }
+  }
+  const size_t num_coarse_matches = coarse_predictions_kp1_.size();
+  statistics::StatsCollector stats_coarse_matches("GyroTracker: number of coarse matches");
+  stats_coarse_matches.AddSample(num_coarse_matches);
+  if (num_coarse_matches < kMinNumCoarseMatches) {
+    return false;
+  }
+
+  // The median translation rejects the gross outliers, the affine correction is then fitted
+  // to its inliers and refitted to the inliers of the first fit.
+  Eigen::Vector2d median_translation;
+  for (int dim = 0; dim < 2; ++dim) {
+    coarse_displacements_.clear();
+    for (size_t i = 0u; i < num_coarse_matches; ++i) {
+      coarse_displacements_.push_back(
+          coarse_measurements_kp1_[i](dim) - coarse_predictions_kp1_[i](dim));
+    }
+    std::nth_element(coarse_displacements_.begin(),
+                     coarse_displacements_.begin() + num_coarse_matches / 2u,
+                     coarse_displacements_.end());
+    median_translation(dim) = coarse_displacements_[num_coarse_matches / 2u];
+  }
+  Eigen::Matrix<double, 2, 3> A_kp1;
+  A_kp1 << Eigen::Matrix2d::Identity(), median_translation;
+  double inlier_threshold_px = kCoarseTranslationInlierThresholdPx;
+  size_t num_inliers = 0u;
+  for (int iteration = 0; iteration < 3; ++iteration) {
+    if (iteration > 0 && !fitAffineCorrection(&A_kp1)) {
+      return false;
+    }
+    is_coarse_inlier_.assign(num_coarse_matches, 0u);
+    num_inliers = 0u;
+    for (size_t i = 0u; i < num_coarse_matches; ++i) {
+      const double residual_px =
+          (A_kp1 * coarse_predictions_kp1_[i].homogeneous() - coarse_measurements_kp1_[i]).norm();
+      if (residual_px < inlier_threshold_px) {
+        is_coarse_inlier_[i] = 1u;
+        ++num_inliers;
+      }
+    }
+    if (num_inliers < kMinNumCoarseMatches) {
+      return false;
+    }
+    inlier_threshold_px = kCoarseAffineInlierThresholdPx;
+  }
+  statistics::StatsCollector stats_coarse_inliers("GyroTracker: number of coarse inliers");
+  stats_coarse_inliers.AddSample(num_inliers);
+
+  corrected_predicted_keypoint_positions_kp1_.resize(2, num_points_k_);
+  for (int idx_k = 0; idx_k < num_points_k_; ++idx_k) {
+    corrected_predicted_keypoint_positions_kp1_.col(idx_k) =
+        (*prediction_success_)[idx_k] ?
+        Eigen::Vector2d(A_kp1 * predicted_keypoint_positions_kp1_->col(idx_k).homogeneous()) :
+        Eigen::Vector2d(predicted_keypoint_positions_kp1_->col(idx_k));
+  }
+  return true;
+}
+
+bool GyroTwoFrameMatcher::fitAffineCorrection(Eigen::Matrix<double, 2, 3>* A_kp1) const {
+  CHECK_NOTNULL(A_kp1);
+  Eigen::Matrix3d XtX = Eigen::Matrix3d::Zero();
+  Eigen::Matrix<double, 3, 2> XtY = Eigen::Matrix<double, 3, 2>::Zero();
+  for (size_t i = 0u; i < coarse_predictions_kp1_.size(); ++i) {
+    if (!is_coarse_inlier_[i]) {
+      continue;
+    }
+    const Eigen::Vector3d x = coarse_predictions_kp1_[i].homogeneous();
+    XtX += x * x.transpose();
+    XtY += x * coarse_measurements_kp1_[i].transpose();
+  }
+  const Eigen::FullPivLU<Eigen::Matrix3d> lu(XtX);
+  if (!lu.isInvertible()) {
+    return false;
+  }
+  *A_kp1 = lu.solve(XtY).transpose();
+  return true;
+}
+
 bool GyroTwoFrameMatcher::matchInferiorMatches(
     std::vector<bool>* is_inferior_keypoint_kp1_matched) {
   CHECK_NOTNULL(is_inferior_keypoint_kp1_matched);
@@ -279,17 +521,18 @@ bool GyroTwoFrameMatcher::matchInferiorMatches(
 
   bool found_inferior_match = false;
 
-  std::unordered_set<int> erase_inferior_match_keypoint_idx_k;
+  std::vector<bool>& erase_inferior_match_keypoint_idx_k = erase_inferior_match_keypoint_idx_k_;
+  bool erase_any_inferior_match = false;
   for (const int inferior_keypoint_idx_k : inferior_match_keypoint_idx_k_) {
-    const MatchData& match_data =
-        idx_k_to_attempted_match_data_map_[inferior_keypoint_idx_k];
+    const MatchData& match_data = idx_k_to_attempted_match_data_[inferior_keypoint_idx_k];
     bool found = false;
     double best_matching_score = static_cast<double>(kMatchingThresholdBitsRatioStrict);
     KeyPointIterator it_best;
 
-    for (size_t i = 0u; i < match_data.keypoint_match_candidates_kp1.size(); ++i) {
-      const KeyPointIterator& keypoint_kp1 = match_data.keypoint_match_candidates_kp1[i];
-      const double matching_score = match_data.match_candidate_matching_scores[i];
+    const size_t candidates_end = match_data.candidates_begin + match_data.num_candidates;
+    for (size_t i = match_data.candidates_begin; i < candidates_end; ++i) {
+      const KeyPointIterator& keypoint_kp1 = candidate_keypoints_kp1_[i];
+      const double matching_score = candidate_matching_scores_[i];
       // Make sure that we don't try to match with already matched keypoints
       // of frame (k+1) (also previous inferior matches).
       if (is_keypoint_kp1_matched_[keypoint_kp1->channel_index]) continue;
@@ -304,53 +547,50 @@ bool GyroTwoFrameMatcher::matchInferiorMatches(
       found_inferior_match = true;
       const int best_match_keypoint_idx_kp1 = it_best->channel_index;
       if ((*is_inferior_keypoint_kp1_matched)[best_match_keypoint_idx_kp1]) {
-        if (best_matching_score > kp1_idx_to_matches_iterator_map_
-            [best_match_keypoint_idx_kp1]->getScore()) {
+        FrameToFrameMatchWithScore& previous_match =
+            getMatchOfKeypointKp1(best_match_keypoint_idx_kp1);
+        if (best_matching_score > previous_match.getScore()) {
           // The current match is better than a previous match associated with the
           // current keypoint of frame (k+1). Hence, the revoked match is the
           // previous match associated with the current keypoint of frame (k+1).
           const int revoked_inferior_keypoint_idx_k =
-              kp1_idx_to_matches_iterator_map_
-              [best_match_keypoint_idx_kp1]->getKeypointIndexBananaFrame();
+              previous_match.getKeypointIndexBananaFrame();
           // The current keypoint k does not have to be matched anymore
           // in the next iteration.
-          erase_inferior_match_keypoint_idx_k.insert(inferior_keypoint_idx_k);
+          erase_inferior_match_keypoint_idx_k[inferior_keypoint_idx_k] = true;
+          erase_any_inferior_match = true;
           // The keypoint k that was revoked. That means that it can be matched
           // again in the next iteration.
-          erase_inferior_match_keypoint_idx_k.erase(revoked_inferior_keypoint_idx_k);
-
-          kp1_idx_to_matches_iterator_map_
-          [best_match_keypoint_idx_kp1]->setScore(best_matching_score);
-          kp1_idx_to_matches_iterator_map_
-          [best_match_keypoint_idx_kp1]->setIndexApple(best_match_keypoint_idx_kp1);
-          kp1_idx_to_matches_iterator_map_
-          [best_match_keypoint_idx_kp1]->setIndexBanana(inferior_keypoint_idx_k);
+          erase_inferior_match_keypoint_idx_k[revoked_inferior_keypoint_idx_k] = false;
+
+          previous_match.setScore(best_matching_score);
+          previous_match.setIndexApple(best_match_keypoint_idx_kp1);
+          previous_match.setIndexBanana(inferior_keypoint_idx_k);
         }
       } else {
         (*is_inferior_keypoint_kp1_matched)[best_match_keypoint_idx_kp1] = true;
+        kp1_idx_to_match_index_[best_match_keypoint_idx_kp1] =
+            static_cast<int>(matches_kp1_k_->size());
         matches_kp1_k_->emplace_back(
             best_match_keypoint_idx_kp1, inferior_keypoint_idx_k, best_matching_score);
-        erase_inferior_match_keypoint_idx_k.insert(inferior_keypoint_idx_k);
-
-        CHECK(matches_kp1_k_->end() != matches_kp1_k_->begin())
-          << "Match vector should not be empty.";
-        CHECK(kp1_idx_to_matches_iterator_map_.emplace(
-            best_match_keypoint_idx_kp1, matches_kp1_k_->end() - 1).second);
+        erase_inferior_match_keypoint_idx_k[inferior_keypoint_idx_k] = true;
+        erase_any_inferior_match = true;
       }
     }
   }
 
-  if (erase_inferior_match_keypoint_idx_k.size() > 0u) {
+  if (erase_any_inferior_match) {
     // Do not iterate again over newly matched keypoints of frame k.
-    // Hence, remove the matched keypoints.
-    std::vector<int>::iterator iter_erase_from = std::remove_if(
-        inferior_match_keypoint_idx_k_.begin(), inferior_match_keypoint_idx_k_.end(),
-        [&erase_inferior_match_keypoint_idx_k](const int element) -> bool {
-          return erase_inferior_match_keypoint_idx_k.count(element) == 1u;
-        }
-    );
-    inferior_match_keypoint_idx_k_.erase(
-        iter_erase_from, inferior_match_keypoint_idx_k_.end());
+    // Hence, remove the matched keypoints and reset their flags.
+    size_t num_remaining = 0u;
+    for (const int inferior_keypoint_idx_k : inferior_match_keypoint_idx_k_) {
+      if (erase_inferior_match_keypoint_idx_k[inferior_keypoint_idx_k]) {
+        erase_inferior_match_keypoint_idx_k[inferior_keypoint_idx_k] = false;
+      } else {
+        inferior_match_keypoint_idx_k_[num_remaining++] = inferior_keypoint_idx_k;
+      }
+    }
+    inferior_match_keypoint_idx_k_.resize(num_remaining);
   }
 
   // Subsequent iterations should not mess with the current matches.
@@ -0,0 +1,175 @@
+#include "aslam/matcher/inverted-index.h"
+
+#include <algorithm>
+
+#include <aslam/common/descriptor-utils.h>
+#include <aslam/common/parallel-for.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <glog/logging.h>
+
+namespace aslam {
+namespace {
+/// Concatenate the descriptors of all frames of the nframe that have descriptors.
+void getNFrameDescriptors(const VisualNFrame& nframe, InvertedIndex::DescriptorsT* descriptors) {
+  CHECK_NOTNULL(descriptors);
+  int num_descriptors = 0;
+  int descriptor_size_bytes = 0;
+  for (size_t frame_idx = 0u; frame_idx < nframe.getNumFrames(); ++frame_idx) {
+    if (nframe.isFrameSet(frame_idx) && nframe.getFrame(frame_idx).hasDescriptors()) {
+      const VisualFrame::DescriptorsT& frame_descriptors =
+          nframe.getFrame(frame_idx).getDescriptors();
+      num_descriptors += frame_descriptors.cols();
+      descriptor_size_bytes = frame_descriptors.rows();
+    }
+  }
+  descriptors->resize(descriptor_size_bytes, num_descriptors);
+  int column = 0;
+  for (size_t frame_idx = 0u; frame_idx < nframe.getNumFrames(); ++frame_idx) {
+    if (nframe.isFrameSet(frame_idx) && nframe.getFrame(frame_idx).hasDescriptors()) {
+      const VisualFrame::DescriptorsT& frame_descriptors =
+          nframe.getFrame(frame_idx).getDescriptors();
+      CHECK_EQ(frame_descriptors.rows(), descriptor_size_bytes)
+          << "The frames of the nframe have different descriptor sizes.";
+      descriptors->middleCols(column, frame_descriptors.cols()) = frame_descriptors;
+      column += frame_descriptors.cols();
+    }
+  }
+}
+}  // namespace
+
+InvertedIndex::InvertedIndex(const BinaryVocabularyTree& vocabulary)
+    : vocabulary_(vocabulary), posting_lists_(vocabulary.numWords()), num_documents_(0u) {
+  CHECK(!vocabulary_.empty()) << "The vocabulary is empty.";
+}
+
+void InvertedIndex::computeBowVector(
+    const DescriptorsT& descriptors, BowVector* bow_vector) const {
+  CHECK_NOTNULL(bow_vector)->clear();
+  if (descriptors.cols() == 0) {
+    return;
+  }
+  std::vector<WordId> words;
+  vocabulary_.quantize(descriptors, &words);
+  std::sort(words.begin(), words.end());
+
+  // The term frequency times the inverse document frequency.
+  double weight_sum = 0.0;
+  for (size_t begin = 0u; begin < words.size();) {
+    const WordId word_id = words[begin];
+    size_t end = begin + 1u;
+    while (end < words.size() && words[end] == word_id) {
+      ++end;
+    }
+    const double weight = static_cast<double>(end - begin) * vocabulary_.getWordWeight(word_id);
+    if (weight > 0.0) {
+      bow_vector->emplace_back(word_id, static_cast<float>(weight));
+      weight_sum += weight;
+    }
+    begin = end;
+  }
+  for (std::pair<WordId, float>& word_weight : *bow_vector) {
+    word_weight.second = static_cast<float>(word_weight.second / weight_sum);
+  }
+}
+
+InvertedIndex::DocumentId InvertedIndex::addDocument(const DescriptorsT& descriptors) {
+  BowVector bow_vector;
+  computeBowVector(descriptors, &bow_vector);
+  return addBowVector(bow_vector);
+}
+
+InvertedIndex::DocumentId InvertedIndex::addFrame(const VisualFrame& frame) {
+  CHECK(frame.hasDescriptors());
+  return addDocument(frame.getDescriptors());
+}
+
+InvertedIndex::DocumentId InvertedIndex::addNFrame(const VisualNFrame& nframe) {
+  DescriptorsT descriptors;
+  getNFrameDescriptors(nframe, &descriptors);
+  return addDocument(descriptors);
+}
+
+InvertedIndex::DocumentId InvertedIndex::addBowVector(const BowVector& bow_vector) {
+  ScopedWriteLock lock(&mutex_);
+  const DocumentId document_id = static_cast<DocumentId>(num_documents_);
+  for (const std::pair<WordId, float>& word_weight : bow_vector) {
+    posting_lists_[word_weight.first].push_back(Posting{document_id, word_weight.second});
+  }
+  ++num_documents_;
+  return document_id;
+}
+
+void InvertedIndex::query(
+    const DescriptorsT& descriptors, size_t max_num_results, QueryResults* results) const {
+  BowVector bow_vector;
+  computeBowVector(descriptors, &bow_vector);
+  queryBowVector(bow_vector, max_num_results, results);
+}
+
+void InvertedIndex::queryFrame(
+    const VisualFrame& frame, size_t max_num_results, QueryResults* results) const {
+  CHECK(frame.hasDescriptors());
+  query(frame.getDescriptors(), max_num_results, results);
+}
+
+void InvertedIndex::queryNFrame(
+    const VisualNFrame& nframe, size_t max_num_results, QueryResults* results) const {
+  DescriptorsT descriptors;
+  getNFrameDescriptors(nframe, &descriptors);
+  query(descriptors, max_num_results, results);
+}
+
+void InvertedIndex::queryBatch(
+    const std::vector<DescriptorsT>& queries, size_t max_num_results, size_t num_threads,
+    std::vector<QueryResults>* results) const {
+  CHECK_NOTNULL(results)->resize(queries.size());
+  common::parallelFor(common::IndexRange(0u, queries.size()),
+                      num_threads == 1u ? std::max<size_t>(1u, queries.size()) : 1u,
+                      [&](size_t begin, size_t end) {
+    for (size_t query_idx = begin; query_idx < end; ++query_idx) {
+      query(queries[query_idx], max_num_results, &(*results)[query_idx]);
+    }
+  });
+}
+
+void InvertedIndex::queryBowVector(
+    const BowVector& bow_vector, size_t max_num_results, QueryResults* results) const {
+  CHECK_NOTNULL(results)->clear();
+  if (max_num_results == 0u || bow_vector.empty()) {
+    return;
+  }
+  std::vector<float> scores;
+  std::vector<DocumentId> scored_documents;
+  {
+    ScopedReadLock lock(&mutex_);
+    scores.resize(num_documents_, 0.0f);
+    for (const std::pair<WordId, float>& word_weight : bow_vector) {
+      for (const Posting& posting : posting_lists_[word_weight.first]) {
+        if (scores[posting.document_id] == 0.0f) {
+          scored_documents.push_back(posting.document_id);
+        }
+        scores[posting.document_id] += std::min(word_weight.second, posting.weight);
+      }
+    }
+  }
+
+  results->reserve(scored_documents.size());
+  for (const DocumentId document_id : scored_documents) {
+    results->emplace_back(document_id, scores[document_id]);
+  }
+  const auto is_better = [](const QueryResult& lhs, const QueryResult& rhs) {
+    return lhs.score > rhs.score ||
+        (lhs.score == rhs.score && lhs.document_id < rhs.document_id);
+  };
+  const size_t num_results = std::min(max_num_results, results->size());
+  std::partial_sort(results->begin(), results->begin() + num_results, results->end(), is_better);
+  results->resize(num_results);
+}
+
+size_t InvertedIndex::numDocuments() const {
+  ScopedReadLock lock(&mutex_);
+  return num_documents_;
+}
+
+}  // namespace aslam
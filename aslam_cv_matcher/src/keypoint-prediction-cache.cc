@@ -0,0 +1,121 @@
+#include "aslam/matcher/keypoint-prediction-cache.h"
+
+#include <algorithm>
+
+#include <aslam/frames/visual-frame.h>
+#include <glog/logging.h>
+
+#include "aslam/matcher/match-helpers.h"
+
+namespace aslam {
+namespace {
+constexpr double kNanosecondsToSeconds = 1e-9;
+}  // namespace
+
+KeypointPredictionCache::KeypointPredictionCache(const Options& options)
+    : options_(options), timestamp_k_nanoseconds_(0), timestamp_kp1_nanoseconds_(0) {
+  CHECK_GT(options_.min_search_radius_px, 0.0);
+  CHECK_GE(options_.max_search_radius_px, options_.min_search_radius_px);
+  CHECK_GE(options_.base_uncertainty_px, 0.0);
+  CHECK_GE(options_.velocity_uncertainty_ratio, 0.0);
+  CHECK_GT(options_.velocity_smoothing, 0.0);
+  CHECK_LE(options_.velocity_smoothing, 1.0);
+}
+
+void KeypointPredictionCache::predictKeypoints(
+    const VisualFrame& frame_k, const Quaternion& q_Ckp1_Ck, int64_t timestamp_kp1_nanoseconds,
+    Eigen::Matrix2Xd* predicted_keypoints_kp1, std::vector<unsigned char>* prediction_success,
+    Eigen::VectorXd* search_radii_px) {
+  CHECK_NOTNULL(predicted_keypoints_kp1);
+  CHECK_NOTNULL(prediction_success);
+  CHECK_NOTNULL(search_radii_px);
+  CHECK_GE(timestamp_kp1_nanoseconds, frame_k.getTimestampNanoseconds());
+  timestamp_k_nanoseconds_ = frame_k.getTimestampNanoseconds();
+  timestamp_kp1_nanoseconds_ = timestamp_kp1_nanoseconds;
+
+  predictKeypointsByRotation(
+      frame_k, q_Ckp1_Ck, &rotation_predicted_keypoints_kp1_, &rotation_prediction_success_);
+  *predicted_keypoints_kp1 = rotation_predicted_keypoints_kp1_;
+  *prediction_success = rotation_prediction_success_;
+  const int num_keypoints = static_cast<int>(prediction_success->size());
+  search_radii_px->setConstant(num_keypoints, options_.max_search_radius_px);
+  if (!frame_k.hasTrackIds() || tracks_.empty()) {
+    return;
+  }
+
+  const Eigen::VectorXi& track_ids_k = frame_k.getTrackIds();
+  CHECK_EQ(track_ids_k.rows(), num_keypoints);
+  const double dt_seconds =
+      static_cast<double>(timestamp_kp1_nanoseconds - timestamp_k_nanoseconds_) *
+      kNanosecondsToSeconds;
+  for (int idx_k = 0; idx_k < num_keypoints; ++idx_k) {
+    if (!(*prediction_success)[idx_k] || track_ids_k(idx_k) < 0) {
+      continue;
+    }
+    const auto track_it = tracks_.find(track_ids_k(idx_k));
+    if (track_it == tracks_.end()) {
+      continue;
+    }
+    const Eigen::Vector2d residual_flow_px =
+        dt_seconds * track_it->second.residual_velocity_px_per_second;
+    predicted_keypoints_kp1->col(idx_k) += residual_flow_px;
+    (*search_radii_px)(idx_k) = std::min(
+        options_.max_search_radius_px,
+        std::max(options_.min_search_radius_px, options_.base_uncertainty_px +
+                 options_.velocity_uncertainty_ratio * residual_flow_px.norm()));
+  }
+}
+
+void KeypointPredictionCache::update(
+    const VisualFrame& frame_kp1, const FrameToFrameMatches& matches_kp1_k) {
+  for (auto& track : tracks_) {
+    ++track.second.num_missed_updates;
+  }
+
+  const double dt_seconds =
+      static_cast<double>(timestamp_kp1_nanoseconds_ - timestamp_k_nanoseconds_) *
+      kNanosecondsToSeconds;
+  if (dt_seconds > 0.0 && frame_kp1.hasTrackIds()) {
+    CHECK_EQ(frame_kp1.getTimestampNanoseconds(), timestamp_kp1_nanoseconds_)
+        << "The update does not follow the prediction of its frames.";
+    const Eigen::VectorXi& track_ids_kp1 = frame_kp1.getTrackIds();
+    const Eigen::Matrix2Xd& keypoints_kp1 = frame_kp1.getKeypointMeasurements();
+    for (const FrameToFrameMatch& match_kp1_k : matches_kp1_k) {
+      const int idx_kp1 = static_cast<int>(match_kp1_k.getKeypointIndexAppleFrame());
+      const int idx_k = static_cast<int>(match_kp1_k.getKeypointIndexBananaFrame());
+      CHECK_LT(idx_kp1, track_ids_kp1.rows());
+      CHECK_LT(idx_k, static_cast<int>(rotation_prediction_success_.size()));
+      const int track_id = track_ids_kp1(idx_kp1);
+      if (track_id < 0 || !rotation_prediction_success_[idx_k]) {
+        continue;
+      }
+      const Eigen::Vector2d residual_velocity_px_per_second =
+          (keypoints_kp1.col(idx_kp1) - rotation_predicted_keypoints_kp1_.col(idx_k)) /
+          dt_seconds;
+      const auto inserted = tracks_.emplace(track_id, TrackState());
+      TrackState& track = inserted.first->second;
+      if (inserted.second) {
+        track.residual_velocity_px_per_second = residual_velocity_px_per_second;
+      } else {
+        track.residual_velocity_px_per_second +=
+            options_.velocity_smoothing *
+            (residual_velocity_px_per_second - track.residual_velocity_px_per_second);
+      }
+      track.num_missed_updates = 0u;
+    }
+  }
+
+  for (auto track_it = tracks_.begin(); track_it != tracks_.end();) {
+    if (track_it->second.num_missed_updates > options_.max_num_missed_updates) {
+      track_it = tracks_.erase(track_it);
+    } else {
+      ++track_it;
+    }
+  }
+}
+
+void KeypointPredictionCache::clear() {
+  tracks_.clear();
+}
+
+}  // namespace aslam
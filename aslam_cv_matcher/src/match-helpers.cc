@@ -1,6 +1,7 @@
 #include "aslam/matcher/match-helpers.h"
 
 #include <aslam/cameras/camera.h>
+#include <aslam/cameras/projection-kernel.h>
 #include <aslam/common/stl-helpers.h>
 #include <aslam/frames/visual-frame.h>
 #include <Eigen/Core>
@@ -85,6 +86,54 @@ size_t extractMatchesFromTrackIdChannels(
   return num_matches;
 }
 
+namespace {
+/// Appends the pixel disparities between the rotated bearing vectors of frame k and the matched
+/// keypoints of frame kp1. The camera is either a ProjectionKernel or a Camera.
+template <typename CameraType>
+void appendRotatedMatchPixelDisparities(
+    const CameraType& camera, const Eigen::Matrix3Xd& bearing_vectors_k_kp1,
+    const std::vector<unsigned char>& success, const Eigen::Matrix2Xd& keypoints_kp1,
+    const FrameToFrameMatches& matches_kp1_k, std::vector<double>* disparity_px,
+    size_t* projection_failed_counter) {
+  CHECK_NOTNULL(disparity_px);
+  CHECK_NOTNULL(projection_failed_counter);
+  for (int i = 0; i < bearing_vectors_k_kp1.cols(); ++i) {
+    if (success[i]) {
+      Eigen::Vector2d rotated_k_keypoint;
+      aslam::ProjectionResult projection_result =
+          camera.project3(bearing_vectors_k_kp1.col(i), &rotated_k_keypoint);
+      if (projection_result == aslam::ProjectionResult::KEYPOINT_VISIBLE) {
+        const size_t kp1_match_index = matches_kp1_k[i].first;
+        CHECK_LT(static_cast<int>(kp1_match_index), keypoints_kp1.cols());
+        disparity_px->emplace_back((keypoints_kp1.col(kp1_match_index)
+            - rotated_k_keypoint).norm());
+      } else {
+        ++(*projection_failed_counter);
+      }
+    } else {
+      ++(*projection_failed_counter);
+    }
+  }
+}
+
+/// Projects with the ProjectionKernel of the camera, see visitProjectionKernel.
+struct RotatedMatchPixelDisparityAppender {
+  template <typename KernelType>
+  void operator()(const KernelType& kernel) const {
+    appendRotatedMatchPixelDisparities(
+        kernel, *bearing_vectors_k_kp1, *success, *keypoints_kp1, *matches_kp1_k, disparity_px,
+        projection_failed_counter);
+  }
+
+  const Eigen::Matrix3Xd* bearing_vectors_k_kp1;
+  const std::vector<unsigned char>* success;
+  const Eigen::Matrix2Xd* keypoints_kp1;
+  const FrameToFrameMatches* matches_kp1_k;
+  std::vector<double>* disparity_px;
+  size_t* projection_failed_counter;
+};
+}  // namespace
+
 /// Get the median pixel disparity for all matches.
 double getMatchPixelDisparityMedian(
       const VisualNFrame& nframe_kp1, const VisualNFrame& nframe_k,
@@ -153,23 +202,14 @@ double getUnrotatedMatchPixelDisparityMedian(
       // Project the bearing vectors to the frame kp1 and calculate the disparity.
       const Eigen::Matrix2Xd& keypoints_kp1 =
           nframe_kp1.getFrame(cam_idx).getKeypointMeasurements();
-      for (int i = 0; i < bearing_vectors_k_kp1.cols(); ++i) {
-        if (success[i]) {
-          Eigen::Vector2d rotated_k_keypoint;
-          aslam::ProjectionResult projection_result =
-              nframe_kp1.getCamera(cam_idx).project3(bearing_vectors_k_kp1.col(i),
-                                                     &rotated_k_keypoint);
-          if (projection_result == aslam::ProjectionResult::KEYPOINT_VISIBLE) {
-            const size_t kp1_match_index = matches_kp1_k[cam_idx][i].first;
-            CHECK_LT(static_cast<int>(kp1_match_index), keypoints_kp1.cols());
-            disparity_px.emplace_back((keypoints_kp1.col(kp1_match_index)
-                - rotated_k_keypoint).norm());
-          } else {
-            ++projection_failed_counter;
-          }
-        } else {
-          ++projection_failed_counter;
-        }
+      RotatedMatchPixelDisparityAppender appender{
+          &bearing_vectors_k_kp1, &success, &keypoints_kp1, &matches_kp1_k[cam_idx],
+          &disparity_px, &projection_failed_counter};
+      const aslam::Camera& camera_kp1 = nframe_kp1.getCamera(cam_idx);
+      if (!visitProjectionKernel(camera_kp1, &appender)) {
+        appendRotatedMatchPixelDisparities(
+            camera_kp1, bearing_vectors_k_kp1, success, keypoints_kp1, matches_kp1_k[cam_idx],
+            &disparity_px, &projection_failed_counter);
       }
     }
   }
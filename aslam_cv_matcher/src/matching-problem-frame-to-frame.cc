@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <aslam/common/pose-batch.h>
 #include <aslam/frames/visual-frame.h>
 #include <aslam/frames/visual-nframe.h>
 #include <glog/logging.h>
@@ -5,6 +10,11 @@
 #include "aslam/matcher/matching-problem-frame-to-frame.h"
 
 namespace aslam {
+namespace {
+// Lower bound on the apple grid cell size, such that tiny search radii do not lead to huge
+// (and mostly empty) grids.
+constexpr double kMinAppleGridCellSizePixels = 4.0;
+}  // namespace
 
 MatchingProblemFrameToFrame::MatchingProblemFrameToFrame(const VisualFrame& apple_frame,
                                                          const VisualFrame& banana_frame,
@@ -14,8 +24,11 @@ MatchingProblemFrameToFrame::MatchingProblemFrameToFrame(const VisualFrame& appl
   : apple_frame_(apple_frame),
     banana_frame_(banana_frame),
     q_A_B_(q_A_B),
-    squared_image_space_distance_threshold_px_sq_(image_space_distance_threshold *
-                                                  image_space_distance_threshold),
+    is_apple_keypoint_grid_built_(false),
+    image_space_distance_threshold_pixels_(image_space_distance_threshold),
+    A_predicted_keypoints_banana_(nullptr),
+    banana_prediction_success_(nullptr),
+    banana_search_radii_px_(nullptr),
     hamming_distance_threshold_(hamming_distance_threshold) {
   CHECK_GE(hamming_distance_threshold, 0) << "Descriptor distance needs to be positive.";
   CHECK_GE(image_space_distance_threshold, 0.0) << "Image space distance needs to be positive.";
@@ -23,15 +36,26 @@ MatchingProblemFrameToFrame::MatchingProblemFrameToFrame(const VisualFrame& appl
   descriptor_size_bytes_ = apple_frame.getDescriptorSizeBytes();
   CHECK_EQ(descriptor_size_bytes_, banana_frame.getDescriptorSizeBytes()) << "Apple and banana "
       << "frames have different descriptor lengths.";
-
-  // The vertical search band must be at least twice the image space distance.
-  vertical_band_halfwidth_pixels_ = static_cast<int>(std::ceil(image_space_distance_threshold));
+  fixed_size_distance_function_ = common::Hamming::getFixedSizeBatchFunction(
+      static_cast<int>(descriptor_size_bytes_));
 
   CHECK(apple_frame.getCameraGeometry()) << "The iCam is NULL.";
   image_height_apple_frame_ = apple_frame.getCameraGeometry()->imageHeight();
   CHECK_GT(image_height_apple_frame_, 0u) << "The apple frame has zero image rows.";
 }
 
+void MatchingProblemFrameToFrame::setBananaPredictions(
+    const Eigen::Matrix2Xd& A_predicted_keypoints_banana,
+    const std::vector<unsigned char>& prediction_success,
+    const Eigen::VectorXd& search_radii_px) {
+  CHECK_EQ(static_cast<size_t>(A_predicted_keypoints_banana.cols()), numBananas());
+  CHECK_EQ(prediction_success.size(), numBananas());
+  CHECK_EQ(static_cast<size_t>(search_radii_px.rows()), numBananas());
+  A_predicted_keypoints_banana_ = &A_predicted_keypoints_banana;
+  banana_prediction_success_ = &prediction_success;
+  banana_search_radii_px_ = &search_radii_px;
+}
+
 bool MatchingProblemFrameToFrame::doSetup() {
   CHECK_GT(image_height_apple_frame_, 0u) << "The apple frame has zero image rows.";
 
@@ -73,8 +97,12 @@ bool MatchingProblemFrameToFrame::doSetup() {
     banana_descriptors_.emplace_back(
         &(banana_descriptors.coeffRef(0, banana_descriptor_idx)), descriptor_size_bytes_);
   }
+  // The batched distance computation runs over padded copies, such that every descriptor can be
+  // processed in whole SIMD words regardless of the descriptor size.
+  aligned_apple_descriptors_.setDescriptors(apple_descriptors);
+  aligned_banana_descriptors_.setDescriptors(banana_descriptors);
 
-  // Then, create a LUT mapping y coordinates to apple keypoint indices.
+  // Then, sort all valid apple keypoints into a grid with cells the size of the search radius.
   const Eigen::Matrix2Xd& A_keypoints_apple = apple_frame_.getKeypointMeasurements();
   CHECK_EQ(static_cast<int>(num_apple_keypoints), A_keypoints_apple.cols())
     << "The number of apple keypoints does not match the number of columns in the "
@@ -83,22 +111,27 @@ bool MatchingProblemFrameToFrame::doSetup() {
   Camera::ConstPtr apple_camera = apple_frame_.getCameraGeometry();
   CHECK(apple_camera);
 
+  std::vector<unsigned char> is_apple_masked;
+  apple_camera->isMaskedVectorized(A_keypoints_apple, &is_apple_masked);
   for (size_t apple_idx = 0; apple_idx < num_apple_keypoints; ++apple_idx) {
     // Check if the apple is valid.
     const Eigen::Vector2d& apple_keypoint = A_keypoints_apple.col(apple_idx);
-    if (apple_camera->isMasked(apple_keypoint)) {
+    if (is_apple_masked[apple_idx]) {
       // This keypoint is masked out and hence not valid.
       valid_apples_[apple_idx] = false;
     } else {
       size_t y_coordinate = static_cast<size_t>(std::floor(apple_keypoint(1)));
       CHECK_LT(y_coordinate, image_height_apple_frame_) << "The y coordinate for apple keypoint "
           << apple_idx << " is bigger than or equal to the number of rows in the image.";
-
-      y_coordinate_to_apple_keypoint_index_map_.insert(std::make_pair(y_coordinate, apple_idx));
       valid_apples_[apple_idx] = true;
     }
   }
-  VLOG(20) << "Built LUT for valid apples.";
+  apple_keypoint_grid_ = common::KeypointGrid::createForImage(
+      apple_camera->imageWidth(), image_height_apple_frame_,
+      std::max(image_space_distance_threshold_pixels_, kMinAppleGridCellSizePixels));
+  apple_keypoint_grid_.build(A_keypoints_apple, &valid_apples_);
+  is_apple_keypoint_grid_built_ = true;
+  VLOG(20) << "Built grid for valid apples.";
 
   // Then, project all banana keypoints into the apple frame.
   const Eigen::Matrix2Xd& banana_keypoints = banana_frame_.getKeypointMeasurements();
@@ -108,40 +141,58 @@ bool MatchingProblemFrameToFrame::doSetup() {
   Camera::ConstPtr banana_camera = banana_frame_.getCameraGeometry();
   CHECK(banana_camera);
 
-  Eigen::Matrix3Xd B_rays_banana = Eigen::Matrix3Xd::Zero(3, num_banana_keypoints);
-  // Compute all back projections in the banana frame.
+  // Collect the unmasked banana keypoints into one block, such that the back projection and
+  // projection below run through the batched camera paths instead of one virtual call per point.
+  std::vector<unsigned char> is_banana_masked;
+  banana_camera->isMaskedVectorized(banana_keypoints, &is_banana_masked);
+  std::vector<int> unmasked_banana_indices;
+  unmasked_banana_indices.reserve(num_banana_keypoints);
   for (size_t banana_idx = 0; banana_idx < num_banana_keypoints; ++banana_idx) {
-    const Eigen::Vector2d& banana_keypoint = banana_keypoints.col(banana_idx);
-    if (banana_camera->isMasked(banana_keypoint)) {
-      valid_bananas_[banana_idx] = false;
-    } else {
-      Eigen::Vector3d B_ray_banana;
-      banana_camera->backProject3(banana_keypoint, &B_ray_banana);
-      B_rays_banana.col(banana_idx) = B_ray_banana;
-      valid_bananas_[banana_idx] = true;
+    valid_bananas_[banana_idx] = false;
+    if (!is_banana_masked[banana_idx]) {
+      unmasked_banana_indices.push_back(banana_idx);
     }
   }
+  const int num_unmasked_bananas = static_cast<int>(unmasked_banana_indices.size());
+
+  // Gather the back projections of the unmasked bananas from the bearing vectors cached in the
+  // banana frame, which are shared by all matching problems and estimators using the frame.
+  const Eigen::Matrix3Xd& banana_bearing_vectors = banana_frame_.getNormalizedBearingVectors();
+  const std::vector<unsigned char>& banana_backprojection_success =
+      banana_frame_.getBearingVectorBackprojectionSuccess();
+  Eigen::Matrix3Xd B_rays_banana(3, num_unmasked_bananas);
+  std::vector<unsigned char> back_projection_success(num_unmasked_bananas);
+  for (int block_idx = 0; block_idx < num_unmasked_bananas; ++block_idx) {
+    const int banana_idx = unmasked_banana_indices[block_idx];
+    B_rays_banana.col(block_idx) = banana_bearing_vectors.col(banana_idx);
+    back_projection_success[block_idx] = banana_backprojection_success[banana_idx];
+  }
   VLOG(20) << "Computed all back projections of bananas in the banana frame.";
 
   // Rotate all banana rays into the apple frame.
-  Eigen::Matrix3Xd A_rays_banana = q_A_B_.getRotationMatrix() * B_rays_banana;
+  Eigen::Matrix3Xd A_rays_banana;
+  rotatePoints(q_A_B_, B_rays_banana, &A_rays_banana);
 
   // Project all banana rays in the apple frame to keypoints.
+  Eigen::Matrix2Xd A_keypoints_banana;
+  std::vector<ProjectionResult> projection_results;
+  apple_camera->project3Vectorized(A_rays_banana, &A_keypoints_banana, &projection_results);
+
   A_projected_keypoints_banana_.resize(num_banana_keypoints);
+  for (int block_idx = 0; block_idx < num_unmasked_bananas; ++block_idx) {
+    // If the banana keypoint projects into the image plane of the apple frame, we accept it.
+    if (back_projection_success[block_idx] &&
+        projection_results[block_idx].isKeypointVisible()) {
+      const int banana_idx = unmasked_banana_indices[block_idx];
+      A_projected_keypoints_banana_[banana_idx] = A_keypoints_banana.col(block_idx);
+      valid_bananas_[banana_idx] = true;
+    }
+  }
 
-  for (size_t banana_idx = 0; banana_idx < num_banana_keypoints; ++banana_idx) {
-    if (valid_bananas_[banana_idx]) {
-      Eigen::Vector2d A_keypoint_banana;
-      Eigen::Vector3d A_ray_banana = A_rays_banana.col(banana_idx);
-
-      ProjectionResult projection_result =
-          apple_camera->project3(A_ray_banana, &A_keypoint_banana);
-
-      // If the banana keypoint projects into the image plane of the apple frame, we accept it.
-      if (projection_result.isKeypointVisible()) {
-        A_projected_keypoints_banana_[banana_idx] = A_keypoint_banana;
-      } else {
-        valid_bananas_[banana_idx] = false;
+  if (A_predicted_keypoints_banana_ != nullptr) {
+    for (size_t banana_idx = 0u; banana_idx < num_banana_keypoints; ++banana_idx) {
+      if (valid_bananas_[banana_idx] && (*banana_prediction_success_)[banana_idx]) {
+        A_projected_keypoints_banana_[banana_idx] = A_predicted_keypoints_banana_->col(banana_idx);
       }
     }
   }
@@ -154,10 +205,10 @@ void MatchingProblemFrameToFrame::getAppleCandidatesForBanana(int banana_index,
                                                               Candidates* candidates) {
   // Get list of apple keypoint indices within some defined distance around the projected banana
   // keypoint and within some defined descriptor distance.
-  CHECK_EQ(numApples(), y_coordinate_to_apple_keypoint_index_map_.size()) << "The number of apples"
-    << " and the number of apples in the apple LUT differs. This can happen if 1. the apple frame "
-    << "was altered between calling setup() and getAppleCandidatesForBanana(...) or 2. if the "
-    << "setup() function did not build a valid LUT for apple keypoints.";
+  CHECK(is_apple_keypoint_grid_built_) << "The setup() function did not build the apple grid.";
+  CHECK_EQ(numApples(), valid_apples_.size()) << "The number of apples and the number of apples "
+    << "during setup differs. This can happen if the apple frame was altered between calling "
+    << "setup() and getAppleCandidatesForBanana(...).";
   CHECK_LT(banana_index, static_cast<int>(valid_bananas_.size()))
     << "No valid flag for this banana.";
   CHECK_LT(banana_index, static_cast<int>(A_projected_keypoints_banana_.size()))
@@ -174,7 +225,6 @@ void MatchingProblemFrameToFrame::getAppleCandidatesForBanana(int banana_index,
     << "There is no projected banana keypoint for the given banana index.";
   CHECK_GT(image_height_apple_frame_, 0u) << "The image height of the apple frame is zero.";
 
-  const Eigen::Matrix2Xd& A_keypoints_apple = apple_frame_.getKeypointMeasurements();
   const Eigen::VectorXi* apple_track_ids;
   if (apple_frame_.hasTrackIds()) {
     apple_track_ids = &apple_frame_.getTrackIds();
@@ -185,60 +235,39 @@ void MatchingProblemFrameToFrame::getAppleCandidatesForBanana(int banana_index,
   if (valid_bananas_[banana_index]) {
     const Eigen::Vector2d& A_keypoint_banana = A_projected_keypoints_banana_[banana_index];
 
-    // Get the y coordinate of the projected banana keypoint in the apple frame.
-    int projected_banana_keypoint_y_coordinate = static_cast<int>(std::round(A_keypoint_banana(1)));
-
-    // Compute the lower and upper bound of the vertical search window, making it respect the
-    // image dimension of the apple frame.
-    int y_lower_int = projected_banana_keypoint_y_coordinate - vertical_band_halfwidth_pixels_;
-    size_t y_lower = 0;
-    if (y_lower_int > 0) y_lower = static_cast<size_t>(y_lower_int);
-    CHECK_LT(y_lower, image_height_apple_frame_);
-
-    int y_upper_int = projected_banana_keypoint_y_coordinate + vertical_band_halfwidth_pixels_;
-    size_t y_upper = image_height_apple_frame_;
-    if (y_upper_int < static_cast<int>(image_height_apple_frame_)) y_upper = y_upper_int;
-    CHECK_GE(y_upper, 0u);
-    CHECK_GT(y_upper, y_lower);
-
-    auto it_lower = y_coordinate_to_apple_keypoint_index_map_.lower_bound(y_lower);
-    if (it_lower == y_coordinate_to_apple_keypoint_index_map_.end()) {
-      // All keypoints in the apple frame lie below the image band -> zero candiates!
-      return;
-    }
-
-    auto it_upper = y_coordinate_to_apple_keypoint_index_map_.lower_bound(y_upper);
-    if (it_upper != y_coordinate_to_apple_keypoint_index_map_.end()) {
-      // Pointing to a valid keypoint -> need to increment this because this needs to go one
-      // beyond the border (i.e. == end() in normal for loop over a vector).
-      ++it_upper;
-    }
-
-    for (auto it = it_lower; it != it_upper; ++it) {
-      // Go over all the apple keyponts and compute image space distance to the projected banana
-      // keypoint.
-      size_t apple_index = it->second;
-      CHECK_LT(static_cast<int>(apple_index), A_keypoints_apple.cols());
-      const Eigen::Vector2d& apple_keypoint = A_keypoints_apple.col(apple_index);
-
-      double squared_image_space_distance = (apple_keypoint - A_keypoint_banana).squaredNorm();
-
-      if (squared_image_space_distance < squared_image_space_distance_threshold_px_sq_) {
-        // This one is within the radius. Compute the descriptor distance.
-        int hamming_distance = computeHammingDistance(banana_index, apple_index);
-
-        if (hamming_distance < hamming_distance_threshold_) {
-          CHECK_GE(hamming_distance, 0);
-          int priority = 0;
-          if (apple_track_ids != nullptr) {
-            CHECK_LT(static_cast<int>(apple_index), apple_track_ids->rows());
-            if ((*apple_track_ids)(apple_index) >= 0) priority = 1;
-          }
-          candidates->emplace_back(apple_index,
-                                   banana_index,
-                                   computeMatchScore(hamming_distance),
-                                   priority);
+    // Collect all apples within the radius around the projected banana keypoint. The buffers
+    // are local such that several bananas can be queried concurrently.
+    const double search_radius_px = banana_search_radii_px_ == nullptr ?
+        image_space_distance_threshold_pixels_ :
+        std::min(image_space_distance_threshold_pixels_,
+                 (*banana_search_radii_px_)(banana_index));
+    std::vector<int> candidate_apple_indices;
+    apple_keypoint_grid_.getKeypointIndicesInRadius(
+        A_keypoint_banana, search_radius_px, &candidate_apple_indices);
+
+    // Compute the descriptor distances of all apples within the radius in one go. Only the
+    // distances below the threshold need to be exact.
+    std::vector<int> candidate_hamming_distances;
+    computeHammingDistancesBatchBounded(banana_index, candidate_apple_indices,
+                                        hamming_distance_threshold_ - 1,
+                                        &candidate_hamming_distances);
+
+    for (size_t candidate_idx = 0u; candidate_idx < candidate_apple_indices.size();
+        ++candidate_idx) {
+      const int apple_index = candidate_apple_indices[candidate_idx];
+      const int hamming_distance = candidate_hamming_distances[candidate_idx];
+
+      if (hamming_distance < hamming_distance_threshold_) {
+        CHECK_GE(hamming_distance, 0);
+        int priority = 0;
+        if (apple_track_ids != nullptr) {
+          CHECK_LT(apple_index, apple_track_ids->rows());
+          if ((*apple_track_ids)(apple_index) >= 0) priority = 1;
         }
+        candidates->emplace_back(apple_index,
+                                 banana_index,
+                                 computeMatchScore(hamming_distance),
+                                 priority);
       }
     }
   } else {
@@ -246,6 +275,32 @@ void MatchingProblemFrameToFrame::getAppleCandidatesForBanana(int banana_index,
   }
 }
 
+void MatchingProblemFrameToFrame::computeHammingDistancesBatch(
+    int banana_index, const std::vector<int>& apple_indices, std::vector<int>* distances) const {
+  computeHammingDistancesBatchBounded(banana_index, apple_indices,
+                                      std::numeric_limits<int>::max(), distances);
+}
+
+void MatchingProblemFrameToFrame::computeHammingDistancesBatchBounded(
+    int banana_index, const std::vector<int>& apple_indices, int max_distance,
+    std::vector<int>* distances) const {
+  CHECK_NOTNULL(distances);
+  CHECK_LT(banana_index, static_cast<int>(banana_descriptors_.size()))
+      << "No descriptor for this banana.";
+  CHECK_LT(banana_index, static_cast<int>(valid_bananas_.size()))
+      << "No valid flag for this banana.";
+  CHECK(valid_bananas_[banana_index]) << "The given banana is not valid.";
+  for (const int apple_index : apple_indices) {
+    DCHECK_LT(apple_index, static_cast<int>(valid_apples_.size()))
+        << "No valid flag for this apple.";
+    DCHECK(valid_apples_[apple_index]) << "The given apple is not valid.";
+  }
+
+  common::computeHammingDistancesBatchBounded(
+      aligned_banana_descriptors_.getDescriptor(banana_index), aligned_apple_descriptors_,
+      apple_indices, max_distance, distances, fixed_size_distance_function_);
+}
+
 size_t MatchingProblemFrameToFrame::numApples() const {
   return static_cast<size_t>(apple_frame_.getNumKeypointMeasurements());
 }
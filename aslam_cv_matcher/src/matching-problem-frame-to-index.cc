@@ -0,0 +1,61 @@
+#include <aslam/frames/visual-frame.h>
+#include <glog/logging.h>
+
+#include "aslam/matcher/matching-problem-frame-to-index.h"
+
+namespace aslam {
+
+MatchingProblemFrameToIndex::MatchingProblemFrameToIndex(
+    const VisualFrame& banana_frame, const MultiIndexHashingDescriptorIndex& apple_index,
+    size_t num_neighbors, int hamming_distance_threshold)
+  : banana_frame_(banana_frame),
+    apple_index_(apple_index),
+    num_neighbors_(num_neighbors),
+    hamming_distance_threshold_(hamming_distance_threshold),
+    descriptor_size_bits_(static_cast<int>(apple_index.getDescriptorSizeBytes() * 8u)) {
+  CHECK_GE(hamming_distance_threshold, 0) << "Descriptor distance needs to be positive.";
+  CHECK_GT(num_neighbors, 0u);
+  CHECK_GT(descriptor_size_bits_, 0);
+}
+
+size_t MatchingProblemFrameToIndex::numApples() const {
+  return apple_index_.getIdEnd();
+}
+
+size_t MatchingProblemFrameToIndex::numBananas() const {
+  return banana_frame_.getNumKeypointMeasurements();
+}
+
+bool MatchingProblemFrameToIndex::doSetup() {
+  CHECK_EQ(banana_frame_.getDescriptorSizeBytes(), apple_index_.getDescriptorSizeBytes())
+      << "The banana frame and the index have different descriptor lengths.";
+  const VisualFrame::DescriptorsT& banana_descriptors = banana_frame_.getDescriptors();
+  CHECK_EQ(static_cast<size_t>(banana_descriptors.cols()), numBananas()) << "Mismatch between "
+      << "the number of banana descriptors and the number of banana keypoints.";
+  aligned_banana_descriptors_.setDescriptors(banana_descriptors);
+  CHECK_EQ(aligned_banana_descriptors_.getStrideBytes(), apple_index_.getStrideBytes());
+  return true;
+}
+
+void MatchingProblemFrameToIndex::getAppleCandidatesForBanana(
+    int banana_index, Candidates* candidates) {
+  CHECK_NOTNULL(candidates)->clear();
+  CHECK_GE(banana_index, 0);
+  CHECK_LT(static_cast<size_t>(banana_index), aligned_banana_descriptors_.size())
+      << "The banana frame was altered after doSetup().";
+  if (hamming_distance_threshold_ == 0) {
+    return;
+  }
+
+  std::vector<MultiIndexHashingDescriptorIndex::Neighbor> neighbors;
+  apple_index_.knnSearch(aligned_banana_descriptors_.getDescriptor(banana_index), num_neighbors_,
+                         hamming_distance_threshold_ - 1, &neighbors);
+  candidates->reserve(neighbors.size());
+  for (const MultiIndexHashingDescriptorIndex::Neighbor& neighbor : neighbors) {
+    constexpr int kPriority = 0;
+    candidates->emplace_back(neighbor.id, banana_index, computeMatchScore(neighbor.distance),
+                             kPriority);
+  }
+}
+
+}  // namespace aslam
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cmath>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/camera-visibility-cone.h>
+#include <aslam/frames/visual-frame.h>
+#include <glog/logging.h>
+
+#include "aslam/matcher/matching-problem-landmarks-to-frame.h"
+
+namespace aslam {
+namespace {
+// Lower bound on the keypoint grid cell size, such that tiny search radii do not lead to huge
+// (and mostly empty) grids.
+constexpr double kMinKeypointGridCellSizePixels = 4.0;
+}  // namespace
+
+MatchingProblemLandmarksToFrame::MatchingProblemLandmarksToFrame(
+    const VisualFrame& apple_frame, const Eigen::Matrix3Xd& G_landmarks,
+    const DescriptorsT& landmark_descriptors, const aslam::Transformation& T_C_G,
+    const Eigen::VectorXd& landmark_predicted_scales, double search_radius_pixels,
+    int hamming_distance_threshold)
+  : apple_frame_(apple_frame),
+    G_landmarks_(G_landmarks),
+    landmark_descriptors_(landmark_descriptors),
+    T_C_G_(T_C_G),
+    landmark_predicted_scales_(landmark_predicted_scales),
+    camera_visibility_cone_(nullptr),
+    landmark_spatial_hash_(nullptr),
+    search_radius_pixels_(search_radius_pixels),
+    hamming_distance_threshold_(hamming_distance_threshold),
+    descriptor_size_bits_(static_cast<int>(apple_frame.getDescriptorSizeBytes() * 8u)) {
+  CHECK_GE(hamming_distance_threshold, 0) << "Descriptor distance needs to be positive.";
+  CHECK_GE(search_radius_pixels, 0.0) << "Image space distance needs to be positive.";
+  CHECK_GT(descriptor_size_bits_, 0);
+  CHECK_EQ(G_landmarks_.cols(), landmark_descriptors_.cols())
+      << "Every landmark needs a descriptor.";
+  CHECK_EQ(static_cast<size_t>(landmark_descriptors_.rows()),
+           apple_frame.getDescriptorSizeBytes()) << "The frame and the landmarks have "
+      << "different descriptor lengths.";
+  CHECK(landmark_predicted_scales_.size() == 0 ||
+        landmark_predicted_scales_.size() == G_landmarks_.cols())
+      << "Either none or every landmark needs a predicted scale.";
+  CHECK(apple_frame.getCameraGeometry()) << "The camera of the frame is NULL.";
+}
+
+MatchingProblemLandmarksToFrame::MatchingProblemLandmarksToFrame(
+    const VisualFrame& apple_frame, const Eigen::Matrix3Xd& G_landmarks,
+    const DescriptorsT& landmark_descriptors, const aslam::Transformation& T_C_G,
+    double search_radius_pixels, int hamming_distance_threshold)
+  : MatchingProblemLandmarksToFrame(apple_frame, G_landmarks, landmark_descriptors, T_C_G,
+                                    Eigen::VectorXd(), search_radius_pixels,
+                                    hamming_distance_threshold) {}
+
+size_t MatchingProblemLandmarksToFrame::numApples() const {
+  return static_cast<size_t>(apple_frame_.getNumKeypointMeasurements());
+}
+
+size_t MatchingProblemLandmarksToFrame::numBananas() const {
+  return static_cast<size_t>(G_landmarks_.cols());
+}
+
+void MatchingProblemLandmarksToFrame::setVisibilityCulling(
+    const CameraVisibilityCone* camera_visibility_cone,
+    const LandmarkSpatialHash* landmark_spatial_hash) {
+  CHECK(camera_visibility_cone != nullptr || landmark_spatial_hash == nullptr)
+      << "The spatial hash needs a visibility cone.";
+  if (landmark_spatial_hash != nullptr) {
+    CHECK_EQ(landmark_spatial_hash->getNumLandmarks(), numBananas())
+        << "The spatial hash was built from other landmarks.";
+  }
+  camera_visibility_cone_ = camera_visibility_cone;
+  landmark_spatial_hash_ = landmark_spatial_hash;
+}
+
+bool MatchingProblemLandmarksToFrame::doSetup() {
+  const size_t num_apples = numApples();
+  const size_t num_bananas = numBananas();
+  const Camera& camera = *CHECK_NOTNULL(apple_frame_.getCameraGeometry().get());
+
+  // Sort the unmasked keypoints into a grid with cells the size of the unscaled search radius.
+  const Eigen::Matrix2Xd& C_keypoints = apple_frame_.getKeypointMeasurements();
+  const VisualFrame::DescriptorsT& apple_descriptors = apple_frame_.getDescriptors();
+  CHECK_EQ(static_cast<size_t>(C_keypoints.cols()), num_apples);
+  CHECK_EQ(static_cast<size_t>(apple_descriptors.cols()), num_apples) << "Mismatch between the "
+      << "number of apple descriptors and the number of apple keypoints.";
+  std::vector<unsigned char> is_apple_masked;
+  camera.isMaskedVectorized(C_keypoints, &is_apple_masked);
+  valid_apples_.assign(num_apples, false);
+  for (size_t apple_idx = 0u; apple_idx < num_apples; ++apple_idx) {
+    valid_apples_[apple_idx] = !is_apple_masked[apple_idx];
+  }
+  apple_keypoint_grid_ = common::KeypointGrid::createForImage(
+      camera.imageWidth(), camera.imageHeight(),
+      std::max(search_radius_pixels_, kMinKeypointGridCellSizePixels));
+  apple_keypoint_grid_.build(C_keypoints, &valid_apples_);
+
+  // Project all landmarks through the batched camera path.
+  valid_bananas_.assign(num_bananas, false);
+  std::vector<ProjectionResult> projection_results;
+  if (camera_visibility_cone_ == nullptr) {
+    const Eigen::Matrix3Xd C_landmarks = T_C_G_.transformVectorized(G_landmarks_);
+    camera.project3Vectorized(C_landmarks, &C_projected_landmarks_, &projection_results);
+    CHECK_EQ(projection_results.size(), num_bananas);
+    for (size_t banana_idx = 0u; banana_idx < num_bananas; ++banana_idx) {
+      valid_bananas_[banana_idx] = projection_results[banana_idx].isKeypointVisible();
+    }
+  } else {
+    // Only the landmarks inside the cone are projected, which costs one dot product per culled
+    // landmark instead of the distorted projection.
+    std::vector<int> candidate_banana_indices;
+    if (landmark_spatial_hash_ != nullptr) {
+      landmark_spatial_hash_->getCandidates(*camera_visibility_cone_, T_C_G_,
+                                            &candidate_banana_indices);
+    } else {
+      camera_visibility_cone_->getCandidates(G_landmarks_, T_C_G_, &candidate_banana_indices);
+    }
+    const int num_candidates = static_cast<int>(candidate_banana_indices.size());
+    Eigen::Matrix3Xd G_candidate_landmarks(3, num_candidates);
+    for (int candidate_idx = 0; candidate_idx < num_candidates; ++candidate_idx) {
+      G_candidate_landmarks.col(candidate_idx) =
+          G_landmarks_.col(candidate_banana_indices[candidate_idx]);
+    }
+    Eigen::Matrix2Xd C_projected_candidates;
+    camera.project3Vectorized(T_C_G_.transformVectorized(G_candidate_landmarks),
+                              &C_projected_candidates, &projection_results);
+    CHECK_EQ(static_cast<int>(projection_results.size()), num_candidates);
+    C_projected_landmarks_.setZero(2, num_bananas);
+    for (int candidate_idx = 0; candidate_idx < num_candidates; ++candidate_idx) {
+      const int banana_idx = candidate_banana_indices[candidate_idx];
+      C_projected_landmarks_.col(banana_idx) = C_projected_candidates.col(candidate_idx);
+      valid_bananas_[banana_idx] = projection_results[candidate_idx].isKeypointVisible();
+    }
+    VLOG(30) << "Culled " << num_bananas - num_candidates << " of " << num_bananas
+             << " landmarks with the visibility cone.";
+  }
+
+  aligned_apple_descriptors_.setDescriptors(apple_descriptors);
+  aligned_banana_descriptors_.setDescriptors(landmark_descriptors_);
+  CHECK_EQ(aligned_apple_descriptors_.getStrideBytes(),
+           aligned_banana_descriptors_.getStrideBytes());
+  VLOG(30) << "Projected " << num_bananas << " landmarks into a frame with " << num_apples
+           << " keypoints.";
+  return true;
+}
+
+void MatchingProblemLandmarksToFrame::getAppleCandidatesForBanana(
+    int banana_index, Candidates* candidates) {
+  CHECK_NOTNULL(candidates)->clear();
+  CHECK_GE(banana_index, 0);
+  CHECK_LT(banana_index, static_cast<int>(valid_bananas_.size()))
+      << "The landmarks were altered after doSetup().";
+  CHECK_EQ(numApples(), valid_apples_.size())
+      << "The frame was altered after doSetup().";
+  if (!valid_bananas_[banana_index] || hamming_distance_threshold_ == 0) {
+    return;
+  }
+
+  double search_radius_pixels = search_radius_pixels_;
+  if (landmark_predicted_scales_.size() > 0) {
+    search_radius_pixels *= landmark_predicted_scales_(banana_index);
+  }
+  // The buffers are local such that several landmarks can be queried concurrently.
+  std::vector<int> candidate_apple_indices;
+  apple_keypoint_grid_.getKeypointIndicesInRadius(
+      C_projected_landmarks_.col(banana_index), search_radius_pixels, &candidate_apple_indices);
+  if (candidate_apple_indices.empty()) {
+    return;
+  }
+
+  // Only the distances below the threshold need to be exact.
+  std::vector<int> candidate_hamming_distances;
+  common::computeHammingDistancesBatchBounded(
+      aligned_banana_descriptors_.getDescriptor(banana_index), aligned_apple_descriptors_,
+      candidate_apple_indices, hamming_distance_threshold_ - 1, &candidate_hamming_distances);
+  for (size_t candidate_idx = 0u; candidate_idx < candidate_apple_indices.size();
+      ++candidate_idx) {
+    const int hamming_distance = candidate_hamming_distances[candidate_idx];
+    if (hamming_distance < hamming_distance_threshold_) {
+      constexpr int kPriority = 0;
+      candidates->emplace_back(candidate_apple_indices[candidate_idx], banana_index,
+                               computeMatchScore(hamming_distance), kPriority);
+    }
+  }
+}
+
+}  // namespace aslam
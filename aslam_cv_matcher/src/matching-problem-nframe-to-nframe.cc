@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/ncamera.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <glog/logging.h>
+
+#include "aslam/matcher/matching-problem-nframe-to-nframe.h"
+
+namespace aslam {
+namespace {
+// Lower bound on the apple grid cell size, such that tiny search radii do not lead to huge
+// (and mostly empty) grids.
+constexpr double kMinAppleGridCellSizePixels = 4.0;
+
+void computeKeypointOffsets(const VisualNFrame& nframe, std::vector<size_t>* offsets) {
+  CHECK_NOTNULL(offsets)->assign(1u, 0u);
+  for (size_t camera_idx = 0u; camera_idx < nframe.getNumFrames(); ++camera_idx) {
+    CHECK(nframe.isFrameSet(camera_idx)) << "Frame " << camera_idx << " is not set.";
+    offsets->push_back(offsets->back() + nframe.getFrame(camera_idx).getNumKeypointMeasurements());
+  }
+}
+}  // namespace
+
+MatchingProblemNFrameToNFrame::MatchingProblemNFrameToNFrame(
+    const VisualNFrame& apple_nframe, const VisualNFrame& banana_nframe,
+    const aslam::Quaternion& q_A_B, double image_space_distance_threshold_pixels,
+    int hamming_distance_threshold)
+  : apple_nframe_(apple_nframe),
+    banana_nframe_(banana_nframe),
+    q_A_B_(q_A_B),
+    image_space_distance_threshold_pixels_(image_space_distance_threshold_pixels),
+    hamming_distance_threshold_(hamming_distance_threshold),
+    descriptor_size_bits_(0) {
+  CHECK_GE(hamming_distance_threshold, 0) << "Descriptor distance needs to be positive.";
+  CHECK_GE(image_space_distance_threshold_pixels, 0.0)
+      << "Image space distance needs to be positive.";
+  CHECK_GT(apple_nframe.getNumFrames(), 0u);
+  CHECK_GT(banana_nframe.getNumFrames(), 0u);
+
+  const size_t descriptor_size_bytes = apple_nframe.getFrame(0u).getDescriptorSizeBytes();
+  for (size_t camera_idx = 0u; camera_idx < apple_nframe.getNumFrames(); ++camera_idx) {
+    CHECK_EQ(descriptor_size_bytes, apple_nframe.getFrame(camera_idx).getDescriptorSizeBytes())
+        << "The apple frames have different descriptor lengths.";
+  }
+  for (size_t camera_idx = 0u; camera_idx < banana_nframe.getNumFrames(); ++camera_idx) {
+    CHECK_EQ(descriptor_size_bytes, banana_nframe.getFrame(camera_idx).getDescriptorSizeBytes())
+        << "Apple and banana frames have different descriptor lengths.";
+  }
+  descriptor_size_bits_ = static_cast<int>(8u * descriptor_size_bytes);
+  CHECK_GT(descriptor_size_bits_, 0);
+
+  computeKeypointOffsets(apple_nframe_, &apple_offsets_);
+  computeKeypointOffsets(banana_nframe_, &banana_offsets_);
+}
+
+size_t MatchingProblemNFrameToNFrame::numApples() const {
+  return apple_offsets_.back();
+}
+
+size_t MatchingProblemNFrameToNFrame::numBananas() const {
+  return banana_offsets_.back();
+}
+
+void MatchingProblemNFrameToNFrame::getKeypoint(
+    const std::vector<size_t>& offsets, int index, size_t* camera_index,
+    size_t* keypoint_index) {
+  CHECK_NOTNULL(camera_index);
+  CHECK_NOTNULL(keypoint_index);
+  CHECK_GE(index, 0);
+  CHECK_LT(static_cast<size_t>(index), offsets.back());
+  // The first offset larger than the index ends the camera of the index.
+  const std::vector<size_t>::const_iterator it =
+      std::upper_bound(offsets.begin(), offsets.end(), static_cast<size_t>(index));
+  *camera_index = static_cast<size_t>(it - offsets.begin()) - 1u;
+  *keypoint_index = static_cast<size_t>(index) - offsets[*camera_index];
+}
+
+void MatchingProblemNFrameToNFrame::getAppleKeypoint(
+    int apple_index, size_t* camera_index, size_t* keypoint_index) const {
+  getKeypoint(apple_offsets_, apple_index, camera_index, keypoint_index);
+}
+
+void MatchingProblemNFrameToNFrame::getBananaKeypoint(
+    int banana_index, size_t* camera_index, size_t* keypoint_index) const {
+  getKeypoint(banana_offsets_, banana_index, camera_index, keypoint_index);
+}
+
+bool MatchingProblemNFrameToNFrame::doSetup() {
+  computeKeypointOffsets(apple_nframe_, &apple_offsets_);
+  computeKeypointOffsets(banana_nframe_, &banana_offsets_);
+  const size_t num_apple_cameras = apple_nframe_.getNumFrames();
+  const size_t num_banana_cameras = banana_nframe_.getNumFrames();
+  const size_t descriptor_size_bytes = static_cast<size_t>(descriptor_size_bits_ / 8);
+
+  // Gather the descriptors of all cameras into one padded block per nframe.
+  aligned_apple_descriptors_.resize(descriptor_size_bytes, numApples());
+  for (size_t camera_idx = 0u; camera_idx < num_apple_cameras; ++camera_idx) {
+    const VisualFrame::DescriptorsT& descriptors =
+        apple_nframe_.getFrame(camera_idx).getDescriptors();
+    const size_t num_keypoints = apple_offsets_[camera_idx + 1u] - apple_offsets_[camera_idx];
+    CHECK_EQ(static_cast<size_t>(descriptors.cols()), num_keypoints) << "Mismatch between the "
+        << "number of apple descriptors and the number of apple keypoints in camera "
+        << camera_idx << ".";
+    aligned_apple_descriptors_.getDescriptorsMutable().middleCols(
+        apple_offsets_[camera_idx], num_keypoints) = descriptors;
+  }
+  aligned_banana_descriptors_.resize(descriptor_size_bytes, numBananas());
+  for (size_t camera_idx = 0u; camera_idx < num_banana_cameras; ++camera_idx) {
+    const VisualFrame::DescriptorsT& descriptors =
+        banana_nframe_.getFrame(camera_idx).getDescriptors();
+    const size_t num_keypoints = banana_offsets_[camera_idx + 1u] - banana_offsets_[camera_idx];
+    CHECK_EQ(static_cast<size_t>(descriptors.cols()), num_keypoints) << "Mismatch between the "
+        << "number of banana descriptors and the number of banana keypoints in camera "
+        << camera_idx << ".";
+    aligned_banana_descriptors_.getDescriptorsMutable().middleCols(
+        banana_offsets_[camera_idx], num_keypoints) = descriptors;
+  }
+
+  // Sort the valid apples of every camera into a grid with cells the size of the search radius.
+  valid_apples_.assign(numApples(), false);
+  is_apple_tracked_.assign(numApples(), false);
+  apple_keypoint_grids_.resize(num_apple_cameras);
+  std::vector<bool> valid_camera_apples;
+  std::vector<unsigned char> is_masked;
+  for (size_t camera_idx = 0u; camera_idx < num_apple_cameras; ++camera_idx) {
+    const VisualFrame& apple_frame = apple_nframe_.getFrame(camera_idx);
+    const Camera& apple_camera = apple_nframe_.getNCamera().getCamera(camera_idx);
+    const Eigen::Matrix2Xd& keypoints = apple_frame.getKeypointMeasurements();
+    const size_t num_keypoints = static_cast<size_t>(keypoints.cols());
+    const size_t offset = apple_offsets_[camera_idx];
+    const Eigen::VectorXi* track_ids =
+        apple_frame.hasTrackIds() ? &apple_frame.getTrackIds() : nullptr;
+
+    valid_camera_apples.assign(num_keypoints, false);
+    apple_camera.isMaskedVectorized(keypoints, &is_masked);
+    for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints; ++keypoint_idx) {
+      const Eigen::Vector2d& keypoint = keypoints.col(keypoint_idx);
+      if (is_masked[keypoint_idx]) {
+        continue;
+      }
+      CHECK_LT(static_cast<size_t>(std::floor(keypoint(1))), apple_camera.imageHeight())
+          << "The y coordinate for apple keypoint " << keypoint_idx << " of camera "
+          << camera_idx << " is bigger than or equal to the number of rows in the image.";
+      valid_camera_apples[keypoint_idx] = true;
+      valid_apples_[offset + keypoint_idx] = true;
+      if (track_ids != nullptr) {
+        CHECK_LT(static_cast<int>(keypoint_idx), track_ids->rows());
+        is_apple_tracked_[offset + keypoint_idx] = (*track_ids)(keypoint_idx) >= 0;
+      }
+    }
+    apple_keypoint_grids_[camera_idx] = common::KeypointGrid::createForImage(
+        apple_camera.imageWidth(), apple_camera.imageHeight(),
+        std::max(image_space_distance_threshold_pixels_, kMinAppleGridCellSizePixels));
+    apple_keypoint_grids_[camera_idx].build(keypoints, &valid_camera_apples);
+  }
+
+  // Rotate the cached bearing vectors of every banana camera once into every apple camera.
+  const NCamera& apple_ncamera = apple_nframe_.getNCamera();
+  const NCamera& banana_ncamera = banana_nframe_.getNCamera();
+  const Eigen::Matrix3d R_A_B = q_A_B_.getRotationMatrix();
+  banana_projection_offsets_.assign(1u, 0u);
+  banana_projections_.clear();
+  std::vector<Eigen::Matrix2Xd> projected_keypoints(num_apple_cameras);
+  std::vector<std::vector<ProjectionResult>> projection_results(num_apple_cameras);
+  for (size_t banana_camera_idx = 0u; banana_camera_idx < num_banana_cameras;
+      ++banana_camera_idx) {
+    const VisualFrame& banana_frame = banana_nframe_.getFrame(banana_camera_idx);
+    const Camera& banana_camera = banana_ncamera.getCamera(banana_camera_idx);
+    const Eigen::Matrix2Xd& banana_keypoints = banana_frame.getKeypointMeasurements();
+    const Eigen::Matrix3Xd& Cb_rays = banana_frame.getNormalizedBearingVectors();
+    const std::vector<unsigned char>& backprojection_success =
+        banana_frame.getBearingVectorBackprojectionSuccess();
+    const size_t num_keypoints =
+        banana_offsets_[banana_camera_idx + 1u] - banana_offsets_[banana_camera_idx];
+    CHECK_EQ(static_cast<size_t>(Cb_rays.cols()), num_keypoints);
+
+    const Eigen::Matrix3d R_A_Cb = R_A_B *
+        banana_ncamera.get_T_C_B(banana_camera_idx).getRotation().inverse().getRotationMatrix();
+    for (size_t apple_camera_idx = 0u; apple_camera_idx < num_apple_cameras;
+        ++apple_camera_idx) {
+      const Eigen::Matrix3d R_Ca_Cb =
+          apple_ncamera.get_T_C_B(apple_camera_idx).getRotation().getRotationMatrix() * R_A_Cb;
+      apple_ncamera.getCamera(apple_camera_idx).project3Vectorized(
+          R_Ca_Cb * Cb_rays, &projected_keypoints[apple_camera_idx],
+          &projection_results[apple_camera_idx]);
+    }
+
+    banana_camera.isMaskedVectorized(banana_keypoints, &is_masked);
+    for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints; ++keypoint_idx) {
+      if (backprojection_success[keypoint_idx] && !is_masked[keypoint_idx]) {
+        for (size_t apple_camera_idx = 0u; apple_camera_idx < num_apple_cameras;
+            ++apple_camera_idx) {
+          if (projection_results[apple_camera_idx][keypoint_idx].isKeypointVisible()) {
+            BananaProjection projection;
+            projection.apple_camera_index = apple_camera_idx;
+            projection.keypoint = projected_keypoints[apple_camera_idx].col(keypoint_idx);
+            banana_projections_.push_back(projection);
+          }
+        }
+      }
+      banana_projection_offsets_.push_back(banana_projections_.size());
+    }
+  }
+  CHECK_EQ(banana_projection_offsets_.size(), numBananas() + 1u);
+  VLOG(30) << "Done with setup, " << banana_projections_.size() << " banana projections.";
+  return true;
+}
+
+void MatchingProblemNFrameToNFrame::getAppleCandidatesForBanana(
+    int banana_index, Candidates* candidates) {
+  CHECK_NOTNULL(candidates)->clear();
+  CHECK_GE(banana_index, 0);
+  CHECK_LT(static_cast<size_t>(banana_index) + 1u, banana_projection_offsets_.size())
+      << "The banana nframe was altered after doSetup().";
+  CHECK_EQ(valid_apples_.size(), numApples()) << "The apple nframe was altered after doSetup().";
+
+  const size_t banana_descriptor_idx = static_cast<size_t>(banana_index);
+  // The buffers are local such that several bananas can be queried concurrently.
+  std::vector<int> candidate_apple_indices;
+  std::vector<int> candidate_hamming_distances;
+  for (size_t projection_idx = banana_projection_offsets_[banana_index];
+      projection_idx < banana_projection_offsets_[banana_index + 1]; ++projection_idx) {
+    const BananaProjection& projection = banana_projections_[projection_idx];
+    candidate_apple_indices.clear();
+    apple_keypoint_grids_[projection.apple_camera_index].getKeypointIndicesInRadius(
+        projection.keypoint, image_space_distance_threshold_pixels_, &candidate_apple_indices);
+    // The grid holds the keypoint indices of the camera.
+    const int apple_offset = static_cast<int>(apple_offsets_[projection.apple_camera_index]);
+    for (int& apple_index : candidate_apple_indices) {
+      apple_index += apple_offset;
+    }
+
+    common::computeHammingDistancesBatchBounded(
+        aligned_banana_descriptors_.getDescriptor(banana_descriptor_idx),
+        aligned_apple_descriptors_, candidate_apple_indices, hamming_distance_threshold_ - 1,
+        &candidate_hamming_distances);
+    for (size_t candidate_idx = 0u; candidate_idx < candidate_apple_indices.size();
+        ++candidate_idx) {
+      const int hamming_distance = candidate_hamming_distances[candidate_idx];
+      if (hamming_distance < hamming_distance_threshold_) {
+        const int apple_index = candidate_apple_indices[candidate_idx];
+        DCHECK(valid_apples_[apple_index]);
+        const int priority = is_apple_tracked_[apple_index] ? 1 : 0;
+        candidates->emplace_back(apple_index, banana_index, computeMatchScore(hamming_distance),
+                                 priority);
+      }
+    }
+  }
+}
+
+}  // namespace aslam
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <unordered_set>
+
+#include <glog/logging.h>
+#include <aslam/common/hamming.h>
+
+#include "aslam/matcher/multi-index-hashing.h"
+
+namespace aslam {
+namespace {
+// Next larger integer with the same number of set bits (Gosper's hack), used to enumerate all
+// substring keys at a given Hamming distance from the query substring.
+inline uint64_t nextMaskWithSamePopcount(const uint64_t mask) {
+  const uint64_t lowest_bit = mask & (~mask + 1u);
+  const uint64_t ripple = mask + lowest_bit;
+  return (((ripple ^ mask) >> 2) / lowest_bit) | ripple;
+}
+
+inline bool isCloser(const MultiIndexHashingDescriptorIndex::Neighbor& lhs,
+                     const MultiIndexHashingDescriptorIndex::Neighbor& rhs) {
+  return lhs.distance < rhs.distance || (lhs.distance == rhs.distance && lhs.id < rhs.id);
+}
+}  // namespace
+
+constexpr size_t MultiIndexHashingDescriptorIndex::kMaxSubstringBits;
+
+MultiIndexHashingDescriptorIndex::MultiIndexHashingDescriptorIndex(
+    size_t descriptor_size_bytes, size_t num_substrings)
+    : descriptor_size_bytes_(descriptor_size_bytes), num_valid_descriptors_(0u) {
+  const size_t descriptor_size_bits = descriptor_size_bytes * 8u;
+  CHECK_GT(num_substrings, 0u);
+  CHECK_LE(num_substrings, descriptor_size_bits)
+      << "A descriptor can not be split into more substrings than it has bits.";
+  // The first substrings get one bit more if the bits do not divide evenly.
+  const size_t min_substring_bits = descriptor_size_bits / num_substrings;
+  const size_t num_wider_substrings = descriptor_size_bits % num_substrings;
+  CHECK_LE(min_substring_bits + (num_wider_substrings > 0u ? 1u : 0u), kMaxSubstringBits)
+      << "Increase the number of substrings.";
+
+  substrings_.resize(num_substrings);
+  size_t begin_bit = 0u;
+  for (size_t substring_idx = 0u; substring_idx < num_substrings; ++substring_idx) {
+    substrings_[substring_idx].begin_bit = begin_bit;
+    substrings_[substring_idx].num_bits =
+        min_substring_bits + (substring_idx < num_wider_substrings ? 1u : 0u);
+    begin_bit += substrings_[substring_idx].num_bits;
+  }
+  CHECK_EQ(begin_bit, descriptor_size_bits);
+  tables_.resize(num_substrings);
+}
+
+uint32_t MultiIndexHashingDescriptorIndex::getSubstringKey(
+    const unsigned char* descriptor, const Substring& substring) const {
+  DCHECK_NOTNULL(descriptor);
+  uint32_t key = 0u;
+  for (size_t bit_idx = 0u; bit_idx < substring.num_bits; ++bit_idx) {
+    const size_t descriptor_bit = substring.begin_bit + bit_idx;
+    key |= static_cast<uint32_t>((descriptor[descriptor_bit / 8u] >> (descriptor_bit % 8u)) & 1u)
+        << bit_idx;
+  }
+  return key;
+}
+
+int MultiIndexHashingDescriptorIndex::insert(const DescriptorsT& descriptors) {
+  CHECK_EQ(static_cast<size_t>(descriptors.rows()), descriptor_size_bytes_)
+      << "Descriptor size mismatch.";
+  ScopedWriteLock lock(&mutex_);
+  const int first_id = static_cast<int>(descriptors_.size());
+  const size_t num_descriptors = static_cast<size_t>(descriptors.cols());
+  if (num_descriptors == 0u) {
+    return first_id;
+  }
+  descriptor_batches_.emplace_back(new common::AlignedDescriptors(descriptors));
+  const common::AlignedDescriptors& batch = *descriptor_batches_.back();
+
+  descriptors_.reserve(descriptors_.size() + num_descriptors);
+  for (size_t descriptor_idx = 0u; descriptor_idx < num_descriptors; ++descriptor_idx) {
+    const int id = first_id + static_cast<int>(descriptor_idx);
+    const unsigned char* descriptor = batch.getDescriptor(descriptor_idx);
+    descriptors_.push_back(descriptor);
+    for (size_t substring_idx = 0u; substring_idx < substrings_.size(); ++substring_idx) {
+      tables_[substring_idx][getSubstringKey(descriptor, substrings_[substring_idx])].push_back(id);
+    }
+  }
+  num_valid_descriptors_ += num_descriptors;
+  return first_id;
+}
+
+void MultiIndexHashingDescriptorIndex::remove(const std::vector<int>& ids) {
+  ScopedWriteLock lock(&mutex_);
+  for (const int id : ids) {
+    CHECK_GE(id, 0);
+    CHECK_LT(static_cast<size_t>(id), descriptors_.size());
+    const unsigned char* descriptor = descriptors_[id];
+    if (descriptor == nullptr) {
+      continue;
+    }
+    for (size_t substring_idx = 0u; substring_idx < substrings_.size(); ++substring_idx) {
+      SubstringTable& table = tables_[substring_idx];
+      SubstringTable::iterator it =
+          table.find(getSubstringKey(descriptor, substrings_[substring_idx]));
+      CHECK(it != table.end());
+      std::vector<int>& bucket = it->second;
+      std::vector<int>::iterator id_it = std::find(bucket.begin(), bucket.end(), id);
+      CHECK(id_it != bucket.end());
+      *id_it = bucket.back();
+      bucket.pop_back();
+      if (bucket.empty()) {
+        table.erase(it);
+      }
+    }
+    descriptors_[id] = nullptr;
+    --num_valid_descriptors_;
+  }
+}
+
+void MultiIndexHashingDescriptorIndex::knnSearch(
+    const unsigned char* query, size_t k, int max_distance,
+    std::vector<Neighbor>* neighbors) const {
+  CHECK_NOTNULL(neighbors)->clear();
+  CHECK_NOTNULL(query);
+  if (k == 0u || max_distance < 0) {
+    return;
+  }
+  ScopedReadLock lock(&mutex_);
+  const size_t num_substrings = substrings_.size();
+  std::vector<uint32_t> query_keys(num_substrings);
+  for (size_t substring_idx = 0u; substring_idx < num_substrings; ++substring_idx) {
+    query_keys[substring_idx] = getSubstringKey(query, substrings_[substring_idx]);
+  }
+  const int stride_bytes = static_cast<int>(getStrideBytes());
+
+  // Max-heap of the closest neighbors found so far.
+  std::vector<Neighbor>& heap = *neighbors;
+  heap.reserve(k);
+  std::unordered_set<int> verified_ids;
+  const size_t max_substring_radius = static_cast<size_t>(max_distance) / num_substrings;
+  for (size_t radius = 0u; radius <= max_substring_radius; ++radius) {
+    for (size_t substring_idx = 0u; substring_idx < num_substrings; ++substring_idx) {
+      const size_t num_bits = substrings_[substring_idx].num_bits;
+      if (radius > num_bits) {
+        continue;
+      }
+      const SubstringTable& table = tables_[substring_idx];
+      const uint64_t end_mask = static_cast<uint64_t>(1u) << num_bits;
+      // Enumerate all keys that differ from the query key in exactly radius bits.
+      for (uint64_t flip_mask = (static_cast<uint64_t>(1u) << radius) - 1u;
+           flip_mask < end_mask; flip_mask = nextMaskWithSamePopcount(flip_mask)) {
+        SubstringTable::const_iterator it =
+            table.find(query_keys[substring_idx] ^ static_cast<uint32_t>(flip_mask));
+        if (it != table.end()) {
+          for (const int id : it->second) {
+            if (!verified_ids.insert(id).second) {
+              continue;
+            }
+            const int bound = heap.size() == k ? heap.front().distance : max_distance;
+            const int distance = common::Hamming::evaluateBounded(
+                query, descriptors_[id], stride_bytes, bound);
+            if (distance > bound) {
+              continue;
+            }
+            const Neighbor neighbor(id, distance);
+            if (heap.size() < k) {
+              heap.push_back(neighbor);
+              std::push_heap(heap.begin(), heap.end(), isCloser);
+            } else if (isCloser(neighbor, heap.front())) {
+              std::pop_heap(heap.begin(), heap.end(), isCloser);
+              heap.back() = neighbor;
+              std::push_heap(heap.begin(), heap.end(), isCloser);
+            }
+          }
+        }
+        if (flip_mask == 0u) {
+          break;
+        }
+      }
+    }
+    // All descriptors that were not seen yet differ from the query in more than radius bits in
+    // every substring.
+    if (heap.size() == k && heap.front().distance < static_cast<int>((radius + 1u) *
+        num_substrings)) {
+      break;
+    }
+  }
+  std::sort_heap(heap.begin(), heap.end(), isCloser);
+}
+
+bool MultiIndexHashingDescriptorIndex::isValidId(int id) const {
+  ScopedReadLock lock(&mutex_);
+  return id >= 0 && static_cast<size_t>(id) < descriptors_.size() && descriptors_[id] != nullptr;
+}
+
+size_t MultiIndexHashingDescriptorIndex::size() const {
+  ScopedReadLock lock(&mutex_);
+  return num_valid_descriptors_;
+}
+
+size_t MultiIndexHashingDescriptorIndex::getIdEnd() const {
+  ScopedReadLock lock(&mutex_);
+  return descriptors_.size();
+}
+
+}  // namespace aslam
@@ -0,0 +1,248 @@
+#include "aslam/matcher/sliding-window-matcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/common/aligned-descriptors.h>
+#include <aslam/common/keypoint-grid.h>
+#include <aslam/common/timer.h>
+#include <aslam/frames/visual-frame.h>
+#include <glog/logging.h>
+
+#include "aslam/matcher/matching-engine-exclusive.h"
+#include "aslam/matcher/matching-problem.h"
+
+namespace aslam {
+namespace {
+// Lower bound on the apple grid cell size, such that tiny search radii do not lead to huge
+// (and mostly empty) grids.
+constexpr double kMinAppleGridCellSizePixels = 4.0;
+}  // namespace
+
+/// The state of a window frame that does not depend on the banana frame.
+struct SlidingWindowMatcher::WindowFrame {
+  VisualFrame::ConstPtr frame;
+  common::KeypointGrid keypoint_grid;
+  std::vector<bool> valid_apples;
+  common::AlignedDescriptors descriptors;
+};
+
+/// The state of the banana frame shared by all window frames.
+struct SlidingWindowMatcher::BananaFrame {
+  size_t num_bananas;
+  /// The banana rays that can be projected, and the banana index of every column.
+  Eigen::Matrix3Xd B_rays;
+  std::vector<int> ray_banana_indices;
+  common::AlignedDescriptors descriptors;
+};
+
+/// Same candidates as MatchingProblemFrameToFrame, from the cached window frame state.
+class SlidingWindowMatcher::MatchingProblemWindowFrame : public MatchingProblem {
+ public:
+  ASLAM_ADD_MATCH_TYPEDEFS(FrameToFrame);
+
+  MatchingProblemWindowFrame(const WindowFrame& apple_frame, const BananaFrame& banana_frame,
+                             const Quaternion& q_A_B, double image_space_distance_threshold,
+                             int hamming_distance_threshold)
+      : apple_frame_(apple_frame), banana_frame_(banana_frame), q_A_B_(q_A_B),
+        image_space_distance_threshold_pixels_(image_space_distance_threshold),
+        hamming_distance_threshold_(hamming_distance_threshold) {}
+  virtual ~MatchingProblemWindowFrame() {}
+
+  virtual size_t numApples() const {
+    return apple_frame_.valid_apples.size();
+  }
+  virtual size_t numBananas() const {
+    return banana_frame_.num_bananas;
+  }
+
+  virtual bool supportsConcurrentCandidateQueries() const {
+    return true;
+  }
+
+  /// Projects the shared banana rays into the window frame.
+  virtual bool doSetup() {
+    const Camera& apple_camera = *CHECK_NOTNULL(apple_frame_.frame->getCameraGeometry().get());
+    const Eigen::Matrix3Xd A_rays_banana = q_A_B_.getRotationMatrix() * banana_frame_.B_rays;
+    Eigen::Matrix2Xd A_keypoints_banana;
+    std::vector<ProjectionResult> projection_results;
+    apple_camera.project3Vectorized(A_rays_banana, &A_keypoints_banana, &projection_results);
+
+    valid_bananas_.assign(banana_frame_.num_bananas, false);
+    A_projected_keypoints_banana_.resize(banana_frame_.num_bananas);
+    for (size_t ray_idx = 0u; ray_idx < banana_frame_.ray_banana_indices.size(); ++ray_idx) {
+      if (projection_results[ray_idx].isKeypointVisible()) {
+        const int banana_idx = banana_frame_.ray_banana_indices[ray_idx];
+        A_projected_keypoints_banana_[banana_idx] = A_keypoints_banana.col(ray_idx);
+        valid_bananas_[banana_idx] = true;
+      }
+    }
+    apple_track_ids_ =
+        apple_frame_.frame->hasTrackIds() ? &apple_frame_.frame->getTrackIds() : nullptr;
+    return true;
+  }
+
+  virtual void getAppleCandidatesForBanana(int banana_index, Candidates* candidates) {
+    CHECK_NOTNULL(candidates)->clear();
+    CHECK_LT(banana_index, static_cast<int>(valid_bananas_.size()));
+    if (!valid_bananas_[banana_index] || numApples() == 0u) {
+      return;
+    }
+    std::vector<int> candidate_apple_indices;
+    apple_frame_.keypoint_grid.getKeypointIndicesInRadius(
+        A_projected_keypoints_banana_[banana_index], image_space_distance_threshold_pixels_,
+        &candidate_apple_indices);
+    const double descriptor_size_bits =
+        static_cast<double>(8u * apple_frame_.descriptors.getDescriptorSizeBytes());
+    std::vector<int> candidate_hamming_distances;
+    common::computeHammingDistancesBatchBounded(
+        banana_frame_.descriptors.getDescriptor(banana_index), apple_frame_.descriptors,
+        candidate_apple_indices, hamming_distance_threshold_ - 1, &candidate_hamming_distances);
+    for (size_t candidate_idx = 0u; candidate_idx < candidate_apple_indices.size();
+        ++candidate_idx) {
+      const int apple_index = candidate_apple_indices[candidate_idx];
+      const int hamming_distance = candidate_hamming_distances[candidate_idx];
+      if (hamming_distance < hamming_distance_threshold_) {
+        int priority = 0;
+        if (apple_track_ids_ != nullptr && (*apple_track_ids_)(apple_index) >= 0) {
+          priority = 1;
+        }
+        // The score of MatchingProblemFrameToFrame.
+        candidates->emplace_back(
+            apple_index, banana_index,
+            (descriptor_size_bits - static_cast<double>(hamming_distance)) / descriptor_size_bits,
+            priority);
+      }
+    }
+  }
+
+ private:
+  const WindowFrame& apple_frame_;
+  const BananaFrame& banana_frame_;
+  const Quaternion q_A_B_;
+  const double image_space_distance_threshold_pixels_;
+  const int hamming_distance_threshold_;
+
+  std::vector<bool> valid_bananas_;
+  Aligned<std::vector, Eigen::Vector2d> A_projected_keypoints_banana_;
+  const Eigen::VectorXi* apple_track_ids_;
+};
+
+SlidingWindowMatcher::SlidingWindowMatcher(
+    size_t max_num_frames, double image_space_distance_threshold_pixels,
+    int hamming_distance_threshold, size_t num_threads)
+    : max_num_frames_(max_num_frames),
+      image_space_distance_threshold_pixels_(image_space_distance_threshold_pixels),
+      hamming_distance_threshold_(hamming_distance_threshold),
+      num_threads_(num_threads) {
+  CHECK_GT(max_num_frames_, 0u);
+  CHECK_GE(hamming_distance_threshold_, 0) << "Descriptor distance needs to be positive.";
+  CHECK_GE(image_space_distance_threshold_pixels_, 0.0)
+      << "Image space distance needs to be positive.";
+  CHECK_GT(num_threads_, 0u);
+}
+
+SlidingWindowMatcher::~SlidingWindowMatcher() {}
+
+void SlidingWindowMatcher::addFrame(const VisualFrame::ConstPtr& frame) {
+  CHECK(frame);
+  const Camera::ConstPtr camera = frame->getCameraGeometry();
+  CHECK(camera) << "The camera of the frame is NULL.";
+  const size_t num_keypoints = static_cast<size_t>(frame->getNumKeypointMeasurements());
+  const Eigen::Matrix2Xd& keypoints = frame->getKeypointMeasurements();
+  CHECK_EQ(static_cast<size_t>(frame->getDescriptors().cols()), num_keypoints)
+      << "Mismatch between the number of descriptors and the number of keypoints.";
+  if (!window_.empty()) {
+    CHECK_EQ(frame->getDescriptorSizeBytes(), window_.front()->frame->getDescriptorSizeBytes())
+        << "The window frames have different descriptor lengths.";
+  }
+  if (window_.size() == max_num_frames_) {
+    removeOldestFrame();
+  }
+
+  std::unique_ptr<WindowFrame> window_frame(new WindowFrame);
+  window_frame->frame = frame;
+  std::vector<unsigned char> is_masked;
+  camera->isMaskedVectorized(keypoints, &is_masked);
+  window_frame->valid_apples.resize(num_keypoints);
+  for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints; ++keypoint_idx) {
+    window_frame->valid_apples[keypoint_idx] = !is_masked[keypoint_idx];
+    if (!is_masked[keypoint_idx]) {
+      CHECK_LT(static_cast<size_t>(std::floor(keypoints(1, keypoint_idx))),
+               camera->imageHeight()) << "The y coordinate of keypoint " << keypoint_idx
+          << " is bigger than or equal to the number of rows in the image.";
+    }
+  }
+  window_frame->keypoint_grid = common::KeypointGrid::createForImage(
+      camera->imageWidth(), camera->imageHeight(),
+      std::max(image_space_distance_threshold_pixels_, kMinAppleGridCellSizePixels));
+  window_frame->keypoint_grid.build(keypoints, &window_frame->valid_apples);
+  window_frame->descriptors.setDescriptors(frame->getDescriptors());
+  window_.push_back(std::move(window_frame));
+}
+
+void SlidingWindowMatcher::removeOldestFrame() {
+  CHECK(!window_.empty());
+  window_.pop_front();
+}
+
+void SlidingWindowMatcher::clear() {
+  window_.clear();
+}
+
+const VisualFrame& SlidingWindowMatcher::getFrame(size_t window_index) const {
+  CHECK_LT(window_index, window_.size());
+  return *window_[window_index]->frame;
+}
+
+void SlidingWindowMatcher::match(
+    const VisualFrame& banana_frame, const Aligned<std::vector, Quaternion>& q_Ai_B,
+    MatchesWithScoreList* matches_per_frame) {
+  CHECK_NOTNULL(matches_per_frame)->clear();
+  CHECK_EQ(q_Ai_B.size(), window_.size()) << "Need one rotation per window frame.";
+  static const size_t kTimerHandle = timing::Timing::GetHandle("SlidingWindowMatcher::match");
+  timing::Timer timer(kTimerHandle);
+  matches_per_frame->resize(window_.size());
+  if (window_.empty()) {
+    return;
+  }
+
+  // Collect the banana state once for all window frames.
+  BananaFrame banana;
+  banana.num_bananas = static_cast<size_t>(banana_frame.getNumKeypointMeasurements());
+  CHECK_EQ(banana_frame.getDescriptorSizeBytes(),
+           window_.front()->frame->getDescriptorSizeBytes())
+      << "The banana and the window frames have different descriptor lengths.";
+  CHECK_EQ(static_cast<size_t>(banana_frame.getDescriptors().cols()), banana.num_bananas)
+      << "Mismatch between the number of banana descriptors and the number of keypoints.";
+  const Camera::ConstPtr banana_camera = banana_frame.getCameraGeometry();
+  CHECK(banana_camera);
+  std::vector<unsigned char> is_banana_masked;
+  banana_camera->isMaskedVectorized(banana_frame.getKeypointMeasurements(), &is_banana_masked);
+  const Eigen::Matrix3Xd& banana_bearing_vectors = banana_frame.getNormalizedBearingVectors();
+  const std::vector<unsigned char>& banana_backprojection_success =
+      banana_frame.getBearingVectorBackprojectionSuccess();
+  banana.ray_banana_indices.reserve(banana.num_bananas);
+  for (size_t banana_idx = 0u; banana_idx < banana.num_bananas; ++banana_idx) {
+    if (!is_banana_masked[banana_idx] && banana_backprojection_success[banana_idx]) {
+      banana.ray_banana_indices.push_back(static_cast<int>(banana_idx));
+    }
+  }
+  banana.B_rays.resize(3, banana.ray_banana_indices.size());
+  for (size_t ray_idx = 0u; ray_idx < banana.ray_banana_indices.size(); ++ray_idx) {
+    banana.B_rays.col(ray_idx) = banana_bearing_vectors.col(banana.ray_banana_indices[ray_idx]);
+  }
+  banana.descriptors.setDescriptors(banana_frame.getDescriptors());
+
+  MatchingEngineExclusive<MatchingProblemWindowFrame> matching_engine(num_threads_);
+  for (size_t window_idx = 0u; window_idx < window_.size(); ++window_idx) {
+    MatchingProblemWindowFrame matching_problem(
+        *window_[window_idx], banana, q_Ai_B[window_idx], image_space_distance_threshold_pixels_,
+        hamming_distance_threshold_);
+    matching_engine.match(&matching_problem, &(*matches_per_frame)[window_idx]);
+  }
+}
+
+}  // namespace aslam
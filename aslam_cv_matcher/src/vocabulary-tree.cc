@@ -0,0 +1,520 @@
+#include "aslam/matcher/vocabulary-tree.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <utility>
+
+#include <aslam/common/descriptor-utils.h>
+#include <aslam/common/hamming.h>
+#include <aslam/common/parallel-for.h>
+#include <aslam/common/timer.h>
+#include <glog/logging.h>
+
+namespace aslam {
+using vocabulary::VocabularyHeader;
+using vocabulary::VocabularyNode;
+
+constexpr BinaryVocabularyTree::WordId BinaryVocabularyTree::kInvalidWordId;
+constexpr size_t BinaryVocabularyTree::kMaxBranchingFactor;
+
+namespace {
+typedef common::Hamming::ResultType HammingDistance;
+
+/// Indices of the children relative to the first child, for the batched Hamming kernel.
+struct ChildIndices {
+  ChildIndices() {
+    for (size_t child_idx = 0u; child_idx < BinaryVocabularyTree::kMaxBranchingFactor;
+        ++child_idx) {
+      values[child_idx] = static_cast<int>(child_idx);
+    }
+  }
+  int values[BinaryVocabularyTree::kMaxBranchingFactor];
+};
+
+/// Index of the closest of num_centers contiguous centers, the first one on ties.
+size_t findClosestCenter(const unsigned char* padded_descriptor, const unsigned char* centers,
+                         size_t num_centers, size_t stride_bytes) {
+  static const ChildIndices kChildIndices;
+  DCHECK_LE(num_centers, BinaryVocabularyTree::kMaxBranchingFactor);
+  HammingDistance distances[BinaryVocabularyTree::kMaxBranchingFactor];
+  common::Hamming::evaluateBatch(padded_descriptor, centers, stride_bytes, kChildIndices.values,
+                                 num_centers, static_cast<int>(stride_bytes), distances);
+  return std::min_element(distances, distances + num_centers) - distances;
+}
+
+/// Sets every bit of the center that is set in more than half of the member descriptors.
+void computeMajorityCenter(const common::AlignedDescriptors& descriptors,
+                           const std::vector<int>& members, unsigned char* center) {
+  CHECK_NOTNULL(center);
+  CHECK(!members.empty());
+  static const common::descriptor_utils::internal::SpreadBitsTable kSpreadBits;
+  constexpr size_t kBitsPerByte = common::descriptor_utils::kBitsPerByte;
+  // A byte of the partial sums overflows after 255 descriptors.
+  constexpr size_t kMaxNumDescriptorsPerPartialSum = 255u;
+  const size_t num_bytes = descriptors.getDescriptorSizeBytes();
+  std::vector<int> sums(num_bytes * kBitsPerByte, 0);
+  std::vector<uint64_t> partial_sums(num_bytes);
+  for (size_t begin = 0u; begin < members.size(); begin += kMaxNumDescriptorsPerPartialSum) {
+    const size_t end = std::min(members.size(), begin + kMaxNumDescriptorsPerPartialSum);
+    std::fill(partial_sums.begin(), partial_sums.end(), 0u);
+    for (size_t member_idx = begin; member_idx < end; ++member_idx) {
+      const unsigned char* descriptor = descriptors.getDescriptor(members[member_idx]);
+      for (size_t byte = 0u; byte < num_bytes; ++byte) {
+        partial_sums[byte] += kSpreadBits.values[descriptor[byte]];
+      }
+    }
+    for (size_t byte = 0u; byte < num_bytes; ++byte) {
+      for (size_t bit = 0u; bit < kBitsPerByte; ++bit) {
+        sums[byte * kBitsPerByte + bit] +=
+            static_cast<int>((partial_sums[byte] >> (kBitsPerByte * bit)) & 0xffu);
+      }
+    }
+  }
+  const int num_members = static_cast<int>(members.size());
+  std::fill(center, center + num_bytes, 0u);
+  for (size_t bit = 0u; bit < sums.size(); ++bit) {
+    if (2 * sums[bit] > num_members) {
+      center[bit / kBitsPerByte] |= static_cast<unsigned char>(1u << (bit % kBitsPerByte));
+    }
+  }
+}
+
+struct Clustering {
+  /// The centers in the padded layout, one after the other.
+  std::vector<unsigned char> centers;
+  std::vector<std::vector<int>> clusters;
+};
+
+/// k-majority clustering of the member descriptors with k-means++ seeding. Empty clusters are
+/// removed. Every descriptor becomes its own cluster if there are at most k members.
+void clusterKMajority(const common::AlignedDescriptors& descriptors,
+                      const std::vector<int>& members, size_t k, size_t max_num_iterations,
+                      unsigned int random_seed, bool run_in_parallel, Clustering* clustering) {
+  CHECK_NOTNULL(clustering);
+  CHECK(!members.empty());
+  const size_t stride_bytes = descriptors.getStrideBytes();
+  const size_t num_members = members.size();
+  std::vector<unsigned char>& centers = clustering->centers;
+  std::vector<std::vector<int>>& clusters = clustering->clusters;
+  if (num_members <= k) {
+    centers.resize(num_members * stride_bytes);
+    clusters.resize(num_members);
+    for (size_t member_idx = 0u; member_idx < num_members; ++member_idx) {
+      std::memcpy(&centers[member_idx * stride_bytes],
+                  descriptors.getDescriptor(members[member_idx]), stride_bytes);
+      clusters[member_idx].assign(1u, members[member_idx]);
+    }
+    return;
+  }
+
+  // k-means++ seeding on the squared Hamming distances.
+  std::mt19937 random_engine(random_seed);
+  centers.clear();
+  centers.reserve(k * stride_bytes);
+  const auto add_center = [&](size_t member_idx) {
+    const unsigned char* descriptor = descriptors.getDescriptor(members[member_idx]);
+    centers.insert(centers.end(), descriptor, descriptor + stride_bytes);
+  };
+  add_center(std::uniform_int_distribution<size_t>(0u, num_members - 1u)(random_engine));
+  std::vector<double> min_squared_distances(num_members, std::numeric_limits<double>::max());
+  while (centers.size() < k * stride_bytes) {
+    const unsigned char* last_center = &centers[centers.size() - stride_bytes];
+    double sum_squared_distances = 0.0;
+    for (size_t member_idx = 0u; member_idx < num_members; ++member_idx) {
+      const double distance = common::Hamming::evaluate(
+          descriptors.getDescriptor(members[member_idx]), last_center,
+          static_cast<int>(stride_bytes));
+      min_squared_distances[member_idx] =
+          std::min(min_squared_distances[member_idx], distance * distance);
+      sum_squared_distances += min_squared_distances[member_idx];
+    }
+    if (sum_squared_distances == 0.0) {
+      // All remaining descriptors are duplicates of a center.
+      break;
+    }
+    const double sample =
+        std::uniform_real_distribution<double>(0.0, sum_squared_distances)(random_engine);
+    double cumulative_squared_distance = 0.0;
+    size_t member_idx = 0u;
+    for (; member_idx + 1u < num_members; ++member_idx) {
+      cumulative_squared_distance += min_squared_distances[member_idx];
+      if (cumulative_squared_distance > sample && min_squared_distances[member_idx] > 0.0) {
+        break;
+      }
+    }
+    add_center(member_idx);
+  }
+  const size_t num_centers = centers.size() / stride_bytes;
+
+  // Alternate between assigning the members to the closest center and the majority update.
+  constexpr size_t kNumMembersPerTask = 1024u;
+  const size_t num_tasks = (num_members + kNumMembersPerTask - 1u) / kNumMembersPerTask;
+  const size_t grain_size = run_in_parallel ? kNumMembersPerTask : num_members;
+  std::vector<uint32_t> assignments(num_members, 0u);
+  std::vector<unsigned char> has_changed(num_tasks);
+  for (size_t iteration = 0u; iteration < max_num_iterations; ++iteration) {
+    std::fill(has_changed.begin(), has_changed.end(), iteration == 0u);
+    common::parallelFor(common::IndexRange(0u, num_members), grain_size,
+                        [&](size_t begin, size_t end) {
+      for (size_t member_idx = begin; member_idx < end; ++member_idx) {
+        const uint32_t center_idx = static_cast<uint32_t>(findClosestCenter(
+            descriptors.getDescriptor(members[member_idx]), centers.data(), num_centers,
+            stride_bytes));
+        if (center_idx != assignments[member_idx]) {
+          assignments[member_idx] = center_idx;
+          has_changed[member_idx / kNumMembersPerTask] = true;
+        }
+      }
+    });
+    if (std::find(has_changed.begin(), has_changed.end(), 1u) == has_changed.end()) {
+      break;
+    }
+    clusters.assign(num_centers, std::vector<int>());
+    for (size_t member_idx = 0u; member_idx < num_members; ++member_idx) {
+      clusters[assignments[member_idx]].push_back(members[member_idx]);
+    }
+    // The center of an empty cluster is kept and may attract members in the next iteration.
+    for (size_t center_idx = 0u; center_idx < num_centers; ++center_idx) {
+      if (!clusters[center_idx].empty()) {
+        computeMajorityCenter(descriptors, clusters[center_idx],
+                              &centers[center_idx * stride_bytes]);
+      }
+    }
+  }
+
+  // The clusters of the last assignment step.
+  clusters.assign(num_centers, std::vector<int>());
+  for (size_t member_idx = 0u; member_idx < num_members; ++member_idx) {
+    clusters[assignments[member_idx]].push_back(members[member_idx]);
+  }
+  size_t num_non_empty_clusters = 0u;
+  for (size_t center_idx = 0u; center_idx < num_centers; ++center_idx) {
+    if (clusters[center_idx].empty()) {
+      continue;
+    }
+    if (num_non_empty_clusters != center_idx) {
+      clusters[num_non_empty_clusters].swap(clusters[center_idx]);
+      std::memcpy(&centers[num_non_empty_clusters * stride_bytes],
+                  &centers[center_idx * stride_bytes], stride_bytes);
+    }
+    ++num_non_empty_clusters;
+  }
+  clusters.resize(num_non_empty_clusters);
+  centers.resize(num_non_empty_clusters * stride_bytes);
+}
+
+size_t alignToVocabulary(size_t size_bytes) {
+  return (size_bytes + vocabulary::kVocabularyAlignmentBytes - 1u) /
+      vocabulary::kVocabularyAlignmentBytes * vocabulary::kVocabularyAlignmentBytes;
+}
+}  // namespace
+
+BinaryVocabularyTree::BinaryVocabularyTree() {
+  clear();
+}
+
+BinaryVocabularyTree::~BinaryVocabularyTree() {
+  clear();
+}
+
+void BinaryVocabularyTree::clear() {
+  mapped_file_.close();
+  branching_factor_ = 0u;
+  depth_ = 0u;
+  descriptor_size_bytes_ = 0u;
+  stride_bytes_ = 0u;
+  num_nodes_ = 0u;
+  num_words_ = 0u;
+  nodes_ = nullptr;
+  node_descriptors_ = nullptr;
+  word_nodes_.clear();
+  owned_nodes_.clear();
+  owned_node_descriptors_.resize(0u, 0u);
+}
+
+void BinaryVocabularyTree::useOwnedStorage() {
+  num_nodes_ = owned_nodes_.size();
+  nodes_ = owned_nodes_.data();
+  node_descriptors_ = owned_node_descriptors_.data();
+  word_nodes_.clear();
+  for (size_t node_idx = 0u; node_idx < num_nodes_; ++node_idx) {
+    if (nodes_[node_idx].num_children == 0u) {
+      word_nodes_.push_back(static_cast<uint32_t>(node_idx));
+    }
+  }
+  num_words_ = word_nodes_.size();
+}
+
+void BinaryVocabularyTree::train(const std::vector<DescriptorsT>& training_images,
+                                 const TrainingOptions& options) {
+  CHECK_GE(options.branching_factor, 2u);
+  CHECK_LE(options.branching_factor, kMaxBranchingFactor);
+  CHECK_GT(options.depth, 0u);
+  CHECK_GT(options.max_num_iterations, 0u);
+  CHECK(!training_images.empty());
+  static const size_t kTimerHandle = timing::Timing::GetHandle("BinaryVocabularyTree::train");
+  timing::Timer timer(kTimerHandle);
+
+  clear();
+  branching_factor_ = options.branching_factor;
+  depth_ = options.depth;
+  descriptor_size_bytes_ = training_images.front().rows();
+  CHECK_GT(descriptor_size_bytes_, 0u);
+  stride_bytes_ = common::AlignedDescriptors::getStrideBytes(descriptor_size_bytes_);
+  size_t num_training_descriptors = 0u;
+  for (const DescriptorsT& image_descriptors : training_images) {
+    CHECK_EQ(static_cast<size_t>(image_descriptors.rows()), descriptor_size_bytes_)
+        << "All training descriptors need to have the same size.";
+    num_training_descriptors += image_descriptors.cols();
+  }
+  CHECK_GT(num_training_descriptors, 0u);
+  CHECK_LE(num_training_descriptors, static_cast<size_t>(std::numeric_limits<int>::max()));
+  DescriptorsT all_descriptors(descriptor_size_bytes_, num_training_descriptors);
+  size_t column = 0u;
+  for (const DescriptorsT& image_descriptors : training_images) {
+    all_descriptors.middleCols(column, image_descriptors.cols()) = image_descriptors;
+    column += image_descriptors.cols();
+  }
+  const common::AlignedDescriptors training_descriptors(all_descriptors);
+  const bool run_in_parallel = options.num_threads != 1u;
+
+  // Build the tree level by level, such that the children of a node are contiguous.
+  struct PendingNode {
+    uint32_t node_index;
+    std::vector<int> members;
+  };
+  std::vector<PendingNode> pending_nodes(1u);
+  pending_nodes.front().node_index = 0u;
+  pending_nodes.front().members.resize(num_training_descriptors);
+  for (size_t descriptor_idx = 0u; descriptor_idx < num_training_descriptors; ++descriptor_idx) {
+    pending_nodes.front().members[descriptor_idx] = static_cast<int>(descriptor_idx);
+  }
+  owned_nodes_.assign(1u, VocabularyNode{0u, 0u, kInvalidWordId, 0.0f});
+  // The root has no descriptor, its slot keeps the node and descriptor indices equal.
+  std::vector<unsigned char> node_descriptors(stride_bytes_, 0u);
+  for (size_t level = 0u; level < depth_ && !pending_nodes.empty(); ++level) {
+    // The nodes are clustered in parallel. The assignment steps are nested loops, such that the
+    // few large nodes of the upper levels are spread over the pool as well.
+    const size_t num_pending_nodes = pending_nodes.size();
+    std::vector<Clustering> clusterings(num_pending_nodes);
+    common::parallelFor(common::IndexRange(0u, num_pending_nodes),
+                        run_in_parallel ? 1u : num_pending_nodes, [&](size_t begin, size_t end) {
+      for (size_t pending_idx = begin; pending_idx < end; ++pending_idx) {
+        const PendingNode& pending_node = pending_nodes[pending_idx];
+        clusterKMajority(training_descriptors, pending_node.members, branching_factor_,
+                         options.max_num_iterations, options.random_seed + pending_node.node_index,
+                         run_in_parallel, &clusterings[pending_idx]);
+      }
+    });
+
+    std::vector<PendingNode> next_pending_nodes;
+    for (size_t pending_idx = 0u; pending_idx < pending_nodes.size(); ++pending_idx) {
+      Clustering& clustering = clusterings[pending_idx];
+      VocabularyNode& node = owned_nodes_[pending_nodes[pending_idx].node_index];
+      node.first_child = static_cast<uint32_t>(owned_nodes_.size());
+      node.num_children = static_cast<uint32_t>(clustering.clusters.size());
+      node_descriptors.insert(node_descriptors.end(), clustering.centers.begin(),
+                              clustering.centers.end());
+      for (std::vector<int>& cluster : clustering.clusters) {
+        const uint32_t child_index = static_cast<uint32_t>(owned_nodes_.size());
+        owned_nodes_.push_back(VocabularyNode{0u, 0u, kInvalidWordId, 0.0f});
+        if (level + 1u < depth_ && cluster.size() > 1u) {
+          next_pending_nodes.push_back(PendingNode{child_index, std::move(cluster)});
+        }
+      }
+    }
+    pending_nodes.swap(next_pending_nodes);
+  }
+  CHECK_LT(owned_nodes_.size(), static_cast<size_t>(kInvalidWordId));
+
+  owned_node_descriptors_.resize(descriptor_size_bytes_, owned_nodes_.size());
+  common::AlignedDescriptors::DescriptorsMap owned_descriptors =
+      owned_node_descriptors_.getDescriptorsMutable();
+  for (size_t node_idx = 0u; node_idx < owned_nodes_.size(); ++node_idx) {
+    std::memcpy(owned_descriptors.col(node_idx).data(), &node_descriptors[node_idx * stride_bytes_],
+                descriptor_size_bytes_);
+  }
+  uint32_t num_words = 0u;
+  for (VocabularyNode& node : owned_nodes_) {
+    if (node.num_children == 0u) {
+      node.word_id = num_words++;
+    }
+  }
+  useOwnedStorage();
+
+  // Inverse document frequencies over the training images.
+  const size_t num_training_images = training_images.size();
+  std::vector<std::vector<WordId>> image_words(num_training_images);
+  common::parallelFor(common::IndexRange(0u, num_training_images),
+                      run_in_parallel ? 1u : std::max<size_t>(1u, num_training_images),
+                      [&](size_t begin, size_t end) {
+    for (size_t image_idx = begin; image_idx < end; ++image_idx) {
+      std::vector<WordId>& words = image_words[image_idx];
+      quantize(training_images[image_idx], &words);
+      std::sort(words.begin(), words.end());
+      words.erase(std::unique(words.begin(), words.end()), words.end());
+    }
+  });
+  std::vector<size_t> document_frequencies(num_words_, 0u);
+  for (const std::vector<WordId>& words : image_words) {
+    for (const WordId word_id : words) {
+      ++document_frequencies[word_id];
+    }
+  }
+  const double num_images = static_cast<double>(training_images.size());
+  for (size_t word_id = 0u; word_id < num_words_; ++word_id) {
+    // Words no training image quantizes to get the weight of the rarest words.
+    owned_nodes_[word_nodes_[word_id]].weight = static_cast<float>(
+        std::log(num_images / std::max<size_t>(1u, document_frequencies[word_id])));
+  }
+  VLOG(3) << "Trained a vocabulary with " << num_words_ << " words and " << num_nodes_
+          << " nodes from " << num_training_descriptors << " descriptors.";
+}
+
+bool BinaryVocabularyTree::save(const std::string& path) const {
+  CHECK(!empty()) << "The vocabulary is empty.";
+  VocabularyHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = vocabulary::kVocabularyMagic;
+  header.version = vocabulary::kVocabularyFormatVersion;
+  header.header_size_bytes = sizeof(VocabularyHeader);
+  header.branching_factor = static_cast<uint32_t>(branching_factor_);
+  header.depth = static_cast<uint32_t>(depth_);
+  header.descriptor_size_bytes = static_cast<uint32_t>(descriptor_size_bytes_);
+  header.stride_bytes = static_cast<uint32_t>(stride_bytes_);
+  header.num_nodes = num_nodes_;
+  header.num_words = num_words_;
+  const size_t nodes_size_bytes = num_nodes_ * sizeof(VocabularyNode);
+  header.descriptors_offset_bytes = alignToVocabulary(sizeof(VocabularyHeader) + nodes_size_bytes);
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open " << path << " for writing.";
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(nodes_), nodes_size_bytes);
+  const std::vector<char> padding(
+      header.descriptors_offset_bytes - sizeof(VocabularyHeader) - nodes_size_bytes, 0);
+  file.write(padding.data(), padding.size());
+  file.write(reinterpret_cast<const char*>(node_descriptors_), num_nodes_ * stride_bytes_);
+  if (!file.good()) {
+    LOG(ERROR) << "Writing the vocabulary to " << path << " failed.";
+    return false;
+  }
+  return true;
+}
+
+bool BinaryVocabularyTree::load(const std::string& path) {
+  clear();
+  if (!mapped_file_.open(path)) {
+    LOG(ERROR) << "Could not open " << path << ": " << std::strerror(errno);
+    return false;
+  }
+  if (mapped_file_.sizeBytes() < sizeof(VocabularyHeader)) {
+    LOG(ERROR) << path << " is not a vocabulary.";
+    clear();
+    return false;
+  }
+
+  const char* data = mapped_file_.data();
+  const VocabularyHeader& header = *reinterpret_cast<const VocabularyHeader*>(data);
+  if (header.magic != vocabulary::kVocabularyMagic ||
+      header.version != vocabulary::kVocabularyFormatVersion ||
+      header.header_size_bytes != sizeof(VocabularyHeader)) {
+    LOG(ERROR) << path << " is not a vocabulary of format version "
+               << vocabulary::kVocabularyFormatVersion << ".";
+    clear();
+    return false;
+  }
+  const size_t nodes_size_bytes = header.num_nodes * sizeof(VocabularyNode);
+  if (header.num_nodes == 0u || header.num_nodes >= kInvalidWordId ||
+      header.branching_factor > kMaxBranchingFactor ||
+      header.stride_bytes !=
+          common::AlignedDescriptors::getStrideBytes(header.descriptor_size_bytes) ||
+      header.descriptors_offset_bytes !=
+          alignToVocabulary(sizeof(VocabularyHeader) + nodes_size_bytes) ||
+      header.descriptors_offset_bytes + header.num_nodes * header.stride_bytes >
+          mapped_file_.sizeBytes()) {
+    LOG(ERROR) << "The vocabulary " << path << " is truncated or corrupt.";
+    clear();
+    return false;
+  }
+  branching_factor_ = header.branching_factor;
+  depth_ = header.depth;
+  descriptor_size_bytes_ = header.descriptor_size_bytes;
+  stride_bytes_ = header.stride_bytes;
+  num_nodes_ = header.num_nodes;
+  nodes_ = reinterpret_cast<const VocabularyNode*>(data + sizeof(VocabularyHeader));
+  node_descriptors_ =
+      reinterpret_cast<const unsigned char*>(data + header.descriptors_offset_bytes);
+
+  word_nodes_.assign(header.num_words, kInvalidWordId);
+  for (size_t node_idx = 0u; node_idx < num_nodes_; ++node_idx) {
+    const VocabularyNode& node = nodes_[node_idx];
+    const bool is_leaf = node.num_children == 0u;
+    if (node.num_children > branching_factor_ ||
+        (!is_leaf && (node.first_child <= node_idx ||
+                      node.first_child + node.num_children > num_nodes_)) ||
+        (is_leaf && (node.word_id >= header.num_words ||
+                     word_nodes_[node.word_id] != kInvalidWordId))) {
+      LOG(ERROR) << "The vocabulary " << path << " has an invalid node " << node_idx << ".";
+      clear();
+      return false;
+    }
+    if (is_leaf) {
+      word_nodes_[node.word_id] = static_cast<uint32_t>(node_idx);
+    }
+  }
+  num_words_ = header.num_words;
+  if (std::find(word_nodes_.begin(), word_nodes_.end(), kInvalidWordId) != word_nodes_.end()) {
+    LOG(ERROR) << "The vocabulary " << path << " misses words.";
+    clear();
+    return false;
+  }
+  return true;
+}
+
+BinaryVocabularyTree::WordId BinaryVocabularyTree::quantize(
+    const unsigned char* padded_descriptor) const {
+  CHECK_NOTNULL(padded_descriptor);
+  DCHECK(!empty());
+  size_t node_idx = 0u;
+  while (nodes_[node_idx].num_children > 0u) {
+    const VocabularyNode& node = nodes_[node_idx];
+    node_idx = node.first_child + findClosestCenter(
+        padded_descriptor, getNodeDescriptor(node.first_child), node.num_children,
+        stride_bytes_);
+  }
+  return nodes_[node_idx].word_id;
+}
+
+void BinaryVocabularyTree::quantize(
+    const common::AlignedDescriptors& descriptors, std::vector<WordId>* words) const {
+  CHECK_NOTNULL(words);
+  CHECK(!empty()) << "The vocabulary is empty.";
+  CHECK(descriptors.empty() || descriptors.getDescriptorSizeBytes() == descriptor_size_bytes_)
+      << "The descriptors and the vocabulary have different descriptor sizes.";
+  words->resize(descriptors.size());
+  for (size_t descriptor_idx = 0u; descriptor_idx < descriptors.size(); ++descriptor_idx) {
+    (*words)[descriptor_idx] = quantize(descriptors.getDescriptor(descriptor_idx));
+  }
+}
+
+void BinaryVocabularyTree::quantize(
+    const DescriptorsT& descriptors, std::vector<WordId>* words) const {
+  const common::AlignedDescriptors aligned_descriptors(descriptors);
+  quantize(aligned_descriptors, words);
+}
+
+float BinaryVocabularyTree::getWordWeight(WordId word_id) const {
+  CHECK_LT(word_id, num_words_);
+  return nodes_[word_nodes_[word_id]].weight;
+}
+
+}  // namespace aslam
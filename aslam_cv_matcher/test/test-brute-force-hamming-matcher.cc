@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <aslam/common/descriptor-utils.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/hamming.h>
+#include <aslam/matcher/brute-force-hamming-matcher.h>
+
+namespace aslam {
+namespace {
+constexpr int kDescriptorSizeBytes = 48;
+
+BruteForceHammingMatcher::DescriptorsT createRandomDescriptors(int num_descriptors) {
+  BruteForceHammingMatcher::DescriptorsT descriptors(kDescriptorSizeBytes, num_descriptors);
+  for (int i = 0; i < descriptors.size(); ++i) {
+    descriptors(i) = static_cast<unsigned char>(rand() % 256);
+  }
+  return descriptors;
+}
+
+/// Exhaustive sort of all (distance, database index) pairs of every query.
+void knnMatchNaive(const BruteForceHammingMatcher::DescriptorsT& database,
+                   const BruteForceHammingMatcher::DescriptorsT& queries, size_t k,
+                   int max_hamming_distance, BruteForceHammingMatcher::MatchesWithScore* matches) {
+  CHECK_NOTNULL(matches)->clear();
+  const double num_bits = kDescriptorSizeBytes * 8.0;
+  for (int query_idx = 0; query_idx < queries.cols(); ++query_idx) {
+    std::vector<std::pair<int, int>> neighbors;
+    for (int database_idx = 0; database_idx < database.cols(); ++database_idx) {
+      const int distance = common::Hamming::evaluate(
+          queries.col(query_idx).data(), database.col(database_idx).data(),
+          kDescriptorSizeBytes);
+      if (distance <= max_hamming_distance) {
+        neighbors.emplace_back(distance, database_idx);
+      }
+    }
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.resize(std::min(neighbors.size(), k));
+    for (const std::pair<int, int>& neighbor : neighbors) {
+      matches->emplace_back(neighbor.second, query_idx, (num_bits - neighbor.first) / num_bits);
+    }
+  }
+}
+}  // namespace
+
+TEST(BruteForceHammingMatcher, CpuMatchesExhaustiveSearch) {
+  srand(3);
+  constexpr int kNumDatabaseDescriptors = 3000;
+  constexpr int kNumQueries = 50;
+  BruteForceHammingMatcher::DescriptorsT database =
+      createRandomDescriptors(kNumDatabaseDescriptors);
+  BruteForceHammingMatcher::DescriptorsT queries = createRandomDescriptors(kNumQueries);
+  // Some queries have a near-duplicate and some have exact duplicates in the database.
+  for (int query_idx = 0; query_idx < kNumQueries; query_idx += 3) {
+    queries.col(query_idx) = database.col(query_idx * 17);
+    queries(0, query_idx) ^= 0x1;
+    database.col(query_idx * 17 + 1) = queries.col(query_idx);
+    database.col(query_idx * 17 + 2) = queries.col(query_idx);
+  }
+
+  BruteForceHammingMatcher::Options options;
+  options.use_cuda_if_available = false;
+  options.query_tile_size = 7u;
+  options.num_threads = 2u;
+  BruteForceHammingMatcher matcher(options);
+  EXPECT_EQ(BruteForceHammingMatcher::Backend::kCpu, matcher.getBackend());
+  matcher.setDatabase(database);
+  EXPECT_EQ(static_cast<size_t>(kNumDatabaseDescriptors), matcher.getDatabaseSize());
+
+  for (const int max_hamming_distance : {kDescriptorSizeBytes * 8, 170}) {
+    constexpr size_t kNumNeighbors = 3u;
+    BruteForceHammingMatcher::MatchesWithScore matches;
+    matcher.knnMatch(queries, kNumNeighbors, max_hamming_distance, &matches);
+    BruteForceHammingMatcher::MatchesWithScore expected_matches;
+    knnMatchNaive(database, queries, kNumNeighbors, max_hamming_distance, &expected_matches);
+
+    EXPECT_GT(expected_matches.size(), static_cast<size_t>(kNumQueries));
+    ASSERT_EQ(expected_matches.size(), matches.size());
+    for (size_t match_idx = 0u; match_idx < matches.size(); ++match_idx) {
+      EXPECT_EQ(expected_matches[match_idx].getKeypointIndexAppleFrame(),
+                matches[match_idx].getKeypointIndexAppleFrame());
+      EXPECT_EQ(expected_matches[match_idx].getKeypointIndexBananaFrame(),
+                matches[match_idx].getKeypointIndexBananaFrame());
+      EXPECT_DOUBLE_EQ(expected_matches[match_idx].getScore(), matches[match_idx].getScore());
+    }
+  }
+}
+
+TEST(BruteForceHammingMatcher, FallsBackToTheCpuBackend) {
+  BruteForceHammingMatcher::Options options;
+  options.use_cuda_if_available = false;
+  BruteForceHammingMatcher cpu_matcher(options);
+  EXPECT_EQ(BruteForceHammingMatcher::Backend::kCpu, cpu_matcher.getBackend());
+
+  options.use_cuda_if_available = true;
+  BruteForceHammingMatcher matcher(options);
+  if (!BruteForceHammingMatcher::isCudaBackendAvailable()) {
+    EXPECT_EQ(BruteForceHammingMatcher::Backend::kCpu, matcher.getBackend());
+  }
+#ifndef ASLAM_CV_WITH_CUDA
+  EXPECT_FALSE(BruteForceHammingMatcher::isCudaBackendAvailable());
+#endif
+}
+
+TEST(BruteForceHammingMatcher, SameDistancesOnAllBackends) {
+  if (!BruteForceHammingMatcher::isCudaBackendAvailable()) {
+    ASLAM_SKIP_TEST("The CUDA backend is not available.");
+  }
+  srand(5);
+  const BruteForceHammingMatcher::DescriptorsT database = createRandomDescriptors(500);
+  const BruteForceHammingMatcher::DescriptorsT queries = createRandomDescriptors(40);
+
+  BruteForceHammingMatcher::Options cpu_options;
+  cpu_options.use_cuda_if_available = false;
+  BruteForceHammingMatcher cpu_matcher(cpu_options);
+  cpu_matcher.setDatabase(database);
+  BruteForceHammingMatcher::MatchesWithScore cpu_matches;
+  cpu_matcher.knnMatch(queries, 2u, kDescriptorSizeBytes * 8, &cpu_matches);
+
+  BruteForceHammingMatcher::Options options;
+  options.query_tile_size = 16u;
+  BruteForceHammingMatcher matcher(options);
+  ASSERT_EQ(BruteForceHammingMatcher::Backend::kCuda, matcher.getBackend());
+  matcher.setDatabase(database);
+  BruteForceHammingMatcher::MatchesWithScore matches;
+  matcher.knnMatch(queries, 2u, kDescriptorSizeBytes * 8, &matches);
+
+  // The backends may resolve ties differently, the scores have to agree.
+  ASSERT_EQ(cpu_matches.size(), matches.size());
+  for (size_t match_idx = 0u; match_idx < matches.size(); ++match_idx) {
+    EXPECT_EQ(cpu_matches[match_idx].getKeypointIndexBananaFrame(),
+              matches[match_idx].getKeypointIndexBananaFrame());
+    EXPECT_DOUBLE_EQ(cpu_matches[match_idx].getScore(), matches[match_idx].getScore());
+  }
+}
+
+TEST(BruteForceHammingMatcher, VerifiedMatchesOfCompressedDescriptors) {
+  srand(7);
+  constexpr int kNumDatabaseDescriptors = 1000;
+  constexpr int kNumQueries = 30;
+  BruteForceHammingMatcher::DescriptorsT database =
+      createRandomDescriptors(kNumDatabaseDescriptors);
+  BruteForceHammingMatcher::DescriptorsT queries = createRandomDescriptors(kNumQueries);
+  for (int query_idx = 0; query_idx < kNumQueries; query_idx += 2) {
+    queries.col(query_idx) = database.col(query_idx * 31);
+    queries(5, query_idx) ^= 0x3;
+  }
+  common::descriptor_utils::DescriptorBitSelection selection;
+  common::descriptor_utils::learnBitSelection(database, 16u, 0.5, &selection);
+  BruteForceHammingMatcher::DescriptorsT compressed_database, compressed_queries;
+  common::descriptor_utils::compressDescriptors(database, selection, 0u, &compressed_database);
+  common::descriptor_utils::compressDescriptors(queries, selection, 0u, &compressed_queries);
+
+  BruteForceHammingMatcher::Options options;
+  options.use_cuda_if_available = false;
+  BruteForceHammingMatcher matcher(options);
+  matcher.setDatabase(compressed_database);
+  matcher.setVerificationDatabase(database);
+
+  // With all database descriptors as candidates, the verification is an exhaustive search.
+  constexpr size_t kNumNeighbors = 3u;
+  constexpr int kMaxFullHammingDistance = 180;
+  BruteForceHammingMatcher::MatchesWithScore matches;
+  matcher.knnMatchVerified(compressed_queries, queries, kNumDatabaseDescriptors, 16 * 8,
+                           kNumNeighbors, kMaxFullHammingDistance, &matches);
+  BruteForceHammingMatcher::MatchesWithScore expected_matches;
+  knnMatchNaive(database, queries, kNumNeighbors, kMaxFullHammingDistance, &expected_matches);
+  ASSERT_EQ(expected_matches.size(), matches.size());
+  for (size_t match_idx = 0u; match_idx < matches.size(); ++match_idx) {
+    EXPECT_EQ(expected_matches[match_idx].getKeypointIndexBananaFrame(),
+              matches[match_idx].getKeypointIndexBananaFrame());
+    EXPECT_DOUBLE_EQ(expected_matches[match_idx].getScore(), matches[match_idx].getScore());
+  }
+
+  // A few candidates of the compressed descriptors suffice for the near-duplicates.
+  matcher.knnMatchVerified(compressed_queries, queries, 10u, 16 * 8, 1u, 20, &matches);
+  ASSERT_EQ(static_cast<size_t>(kNumQueries / 2), matches.size());
+  for (size_t match_idx = 0u; match_idx < matches.size(); ++match_idx) {
+    const int query_idx = matches[match_idx].getKeypointIndexBananaFrame();
+    EXPECT_EQ(static_cast<int>(2 * match_idx), query_idx);
+    EXPECT_EQ(query_idx * 31, matches[match_idx].getKeypointIndexAppleFrame());
+  }
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,93 @@
+#include <cstdlib>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/epipolar-band-matcher.h>
+
+namespace aslam {
+namespace {
+constexpr int kNumPoints = 300;
+constexpr int kDescriptorSizeBytes = 48;
+}  // namespace
+
+class EpipolarBandMatcherTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    srand(11);
+    camera_ = PinholeCamera::createTestCamera();
+    // A stereo pair with a slightly converging banana camera 20cm to the right.
+    T_A_B_ = Transformation(Quaternion(AngleAxis(0.05, Eigen::Vector3d::UnitY())),
+                            Position3D(0.2, 0.005, 0.0));
+
+    // Random points in front of both cameras, kept if they are visible in both.
+    Eigen::Matrix2Xd apple_keypoints(2, kNumPoints);
+    Eigen::Matrix2Xd banana_keypoints(2, kNumPoints);
+    int num_points = 0;
+    while (num_points < kNumPoints) {
+      const double depth = 2.0 + 18.0 * (rand() / static_cast<double>(RAND_MAX));
+      const Eigen::Vector3d A_p = depth * Eigen::Vector3d(
+          Eigen::Vector2d::Random().x() * 0.7, Eigen::Vector2d::Random().y() * 0.5, 1.0);
+      const Eigen::Vector3d B_p = T_A_B_.inverse() * A_p;
+      Eigen::Vector2d apple_keypoint, banana_keypoint;
+      if (camera_->project3(A_p, &apple_keypoint).isKeypointVisible() &&
+          camera_->project3(B_p, &banana_keypoint).isKeypointVisible()) {
+        apple_keypoints.col(num_points) = apple_keypoint;
+        // The bananas are in the opposite order.
+        banana_keypoints.col(kNumPoints - 1 - num_points) = banana_keypoint;
+        ++num_points;
+      }
+    }
+    VisualFrame::DescriptorsT apple_descriptors(kDescriptorSizeBytes, kNumPoints);
+    for (int i = 0; i < apple_descriptors.size(); ++i) {
+      apple_descriptors(i) = static_cast<unsigned char>(rand() % 256);
+    }
+    VisualFrame::DescriptorsT banana_descriptors = apple_descriptors.rowwise().reverse();
+
+    apple_frame_ = VisualFrame::createEmptyTestVisualFrame(camera_, 0);
+    apple_frame_->setKeypointMeasurements(apple_keypoints);
+    apple_frame_->setDescriptors(apple_descriptors);
+    banana_frame_ = VisualFrame::createEmptyTestVisualFrame(camera_, 0);
+    banana_frame_->setKeypointMeasurements(banana_keypoints);
+    banana_frame_->setDescriptors(banana_descriptors);
+  }
+
+  Camera::Ptr camera_;
+  Transformation T_A_B_;
+  VisualFrame::Ptr apple_frame_;
+  VisualFrame::Ptr banana_frame_;
+};
+
+TEST_F(EpipolarBandMatcherTest, MatchesCorrespondingKeypoints) {
+  EpipolarBandMatcher matcher(T_A_B_, EpipolarBandMatcher::Options());
+  EpipolarBandMatcher::MatchesWithScore matches;
+  matcher.match(*apple_frame_, *banana_frame_, &matches);
+
+  ASSERT_EQ(static_cast<size_t>(kNumPoints), matches.size());
+  for (const FrameToFrameMatchWithScore& match : matches) {
+    EXPECT_EQ(kNumPoints - 1 - match.getKeypointIndexAppleFrame(),
+              match.getKeypointIndexBananaFrame());
+    EXPECT_DOUBLE_EQ(1.0, match.getScore());
+  }
+}
+
+TEST_F(EpipolarBandMatcherTest, RejectsKeypointsOffTheEpipolarLine) {
+  // Moving the apples 20 pixels along the image columns takes them out of the band.
+  Eigen::Matrix2Xd* apple_keypoints = apple_frame_->getKeypointMeasurementsMutable();
+  apple_keypoints->row(1).array() += 20.0;
+  apple_frame_->invalidateNormalizedBearingVectors();
+
+  EpipolarBandMatcher matcher(T_A_B_, EpipolarBandMatcher::Options());
+  EpipolarBandMatcher::MatchesWithScore matches;
+  matcher.match(*apple_frame_, *banana_frame_, &matches);
+  EXPECT_TRUE(matches.empty());
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/deadline.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/common/time.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/gyro-two-frame-matcher.h>
+
+namespace aslam {
+namespace {
+constexpr int kDescriptorSizeBytes = 48;
+constexpr int kGridSpacingPx = 50;
+}  // namespace
+
+class GyroTwoFrameMatcherTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    srand(5);
+    camera_ = PinholeCamera::createTestCamera();
+    // A grid of keypoints, far enough apart that every search window holds at most one.
+    std::vector<Eigen::Vector2d> keypoints;
+    for (int y = kGridSpacingPx; y < static_cast<int>(camera_->imageHeight()) - kGridSpacingPx;
+         y += kGridSpacingPx) {
+      for (int x = kGridSpacingPx; x < static_cast<int>(camera_->imageWidth()) - kGridSpacingPx;
+           x += kGridSpacingPx) {
+        keypoints.emplace_back(x, y);
+      }
+    }
+    num_keypoints_ = static_cast<int>(keypoints.size());
+    keypoints_k_.resize(2, num_keypoints_);
+    for (int i = 0; i < num_keypoints_; ++i) {
+      keypoints_k_.col(i) = keypoints[i];
+    }
+    descriptors_.resize(kDescriptorSizeBytes, num_keypoints_);
+    for (int i = 0; i < descriptors_.size(); ++i) {
+      descriptors_(i) = static_cast<unsigned char>(rand() % 256);
+    }
+    frame_k_ = VisualFrame::createEmptyTestVisualFrame(camera_, 0);
+    frame_k_->setKeypointMeasurements(keypoints_k_);
+    frame_k_->setDescriptors(descriptors_);
+    prediction_success_.assign(num_keypoints_, 1u);
+  }
+
+  /// Frame (k+1) observes the keypoints of frame k shifted by the offset, with the same
+  /// descriptors.
+  VisualFrame::Ptr createFrameKp1(const Eigen::Vector2d& offset_px) const {
+    VisualFrame::Ptr frame_kp1 = VisualFrame::createEmptyTestVisualFrame(camera_, 1);
+    frame_kp1->setKeypointMeasurements(keypoints_k_.colwise() + offset_px);
+    frame_kp1->setDescriptors(descriptors_);
+    return frame_kp1;
+  }
+
+  /// Matches with the keypoints of frame k as their predictions.
+  void match(const VisualFrame& frame_kp1, FrameToFrameMatchesWithScore* matches_kp1_k) {
+    GyroTwoFrameMatcher matcher(camera_->imageHeight());
+    matcher.match(Quaternion(), frame_kp1, *frame_k_, keypoints_k_, prediction_success_,
+                  matches_kp1_k);
+  }
+
+  Camera::Ptr camera_;
+  int num_keypoints_;
+  Eigen::Matrix2Xd keypoints_k_;
+  VisualFrame::DescriptorsT descriptors_;
+  VisualFrame::Ptr frame_k_;
+  std::vector<unsigned char> prediction_success_;
+};
+
+TEST_F(GyroTwoFrameMatcherTest, DeadlineShrinksTheSearchWindows) {
+  // Outside of the small but within the large search window.
+  const VisualFrame::Ptr frame_kp1 = createFrameKp1(Eigen::Vector2d(15.0, 0.0));
+
+  FrameToFrameMatchesWithScore matches_kp1_k;
+  {
+    common::DeadlineScope deadline_scope;
+    match(*frame_kp1, &matches_kp1_k);
+    EXPECT_TRUE(deadline_scope.getDegradations().empty());
+  }
+  ASSERT_EQ(static_cast<size_t>(num_keypoints_), matches_kp1_k.size());
+  for (const FrameToFrameMatchWithScore& match : matches_kp1_k) {
+    EXPECT_EQ(match.getKeypointIndexAppleFrame(), match.getKeypointIndexBananaFrame());
+  }
+
+  // Most of a long budget is left, the matcher doesn't degrade.
+  {
+    common::DeadlineScope deadline_scope(common::Deadline::fromNow(time::seconds(100)));
+    match(*frame_kp1, &matches_kp1_k);
+    EXPECT_TRUE(deadline_scope.getDegradations().empty());
+    EXPECT_EQ(static_cast<size_t>(num_keypoints_), matches_kp1_k.size());
+  }
+
+  // An expired deadline drops the large windows and the inferior matching.
+  common::DeadlineScope deadline_scope(common::Deadline::fromNow(0));
+  match(*frame_kp1, &matches_kp1_k);
+  EXPECT_TRUE(matches_kp1_k.empty());
+  EXPECT_TRUE(deadline_scope.getDegradations().has(common::Degradation::kShrunkSearchWindows));
+  EXPECT_TRUE(
+      deadline_scope.getDegradations().has(common::Degradation::kSkippedInferiorMatching));
+}
+
+TEST_F(GyroTwoFrameMatcherTest, ExpiredDeadlineKeepsTheSmallWindowMatches) {
+  // Within the small search window.
+  const VisualFrame::Ptr frame_kp1 = createFrameKp1(Eigen::Vector2d(4.0, -3.0));
+
+  common::DeadlineScope deadline_scope(common::Deadline::fromNow(0));
+  FrameToFrameMatchesWithScore matches_kp1_k;
+  match(*frame_kp1, &matches_kp1_k);
+  EXPECT_EQ(static_cast<size_t>(num_keypoints_), matches_kp1_k.size());
+  EXPECT_TRUE(deadline_scope.getDegradations().has(common::Degradation::kShrunkSearchWindows));
+  EXPECT_TRUE(
+      deadline_scope.getDegradations().has(common::Degradation::kSkippedInferiorMatching));
+}
+
+TEST_F(GyroTwoFrameMatcherTest, SearchRadiiShrinkTheSearchWindows) {
+  // Outside of the small but within the large default search window.
+  const VisualFrame::Ptr frame_kp1 = createFrameKp1(Eigen::Vector2d(15.0, 0.0));
+  GyroTwoFrameMatcher matcher(camera_->imageHeight());
+
+  // Radii at least as large as the default windows are bounded by them.
+  FrameToFrameMatchesWithScore default_matches_kp1_k;
+  matcher.match(Quaternion(), *frame_kp1, *frame_k_, keypoints_k_, prediction_success_,
+                &default_matches_kp1_k);
+  FrameToFrameMatchesWithScore matches_kp1_k;
+  matcher.match(Quaternion(), *frame_kp1, *frame_k_, keypoints_k_, prediction_success_,
+                Eigen::VectorXd::Constant(num_keypoints_, 100.0), &matches_kp1_k);
+  EXPECT_EQ(static_cast<size_t>(num_keypoints_), matches_kp1_k.size());
+  EXPECT_TRUE(default_matches_kp1_k == matches_kp1_k);
+
+  // Every other keypoint has a confident prediction, its large window of twice the radius
+  // doesn't reach the observation.
+  Eigen::VectorXd search_radii_px(num_keypoints_);
+  for (int i = 0; i < num_keypoints_; ++i) {
+    search_radii_px(i) = i % 2 == 0 ? 5.0 : 8.0;
+  }
+  matcher.match(Quaternion(), *frame_kp1, *frame_k_, keypoints_k_, prediction_success_,
+                search_radii_px, &matches_kp1_k);
+  EXPECT_EQ(static_cast<size_t>(num_keypoints_ / 2), matches_kp1_k.size());
+  for (const FrameToFrameMatchWithScore& match : matches_kp1_k) {
+    EXPECT_EQ(match.getKeypointIndexAppleFrame(), match.getKeypointIndexBananaFrame());
+    EXPECT_EQ(1, match.getKeypointIndexBananaFrame() % 2);
+  }
+
+  // The radius must be given for every keypoint of frame k.
+  EXPECT_DEATH(matcher.match(Quaternion(), *frame_kp1, *frame_k_, keypoints_k_,
+                             prediction_success_, Eigen::VectorXd::Constant(1, 10.0),
+                             &matches_kp1_k), "^");
+}
+
+TEST_F(GyroTwoFrameMatcherTest, CoarseToFineCorrectsAnAffinePredictionError) {
+  // Frame (k+1) observes the keypoints of frame k scaled about the image center and shifted
+  // by more than the large search window, but within the coarse search window.
+  const Eigen::Vector2d image_center(camera_->imageWidth() / 2.0, camera_->imageHeight() / 2.0);
+  const double kScale = 1.02;
+  const Eigen::Vector2d translation_px(35.0, 0.0);
+  // Every tenth keypoint is a gross outlier of the affine motion.
+  const Eigen::Vector2d outlier_offset_px(0.0, 25.0);
+  constexpr int kOutlierStride = 10;
+  Eigen::Matrix2Xd keypoints_kp1(2, num_keypoints_);
+  for (int i = 0; i < num_keypoints_; ++i) {
+    keypoints_kp1.col(i) =
+        image_center + kScale * (keypoints_k_.col(i) - image_center) + translation_px;
+    if (i % kOutlierStride == 0) {
+      keypoints_kp1.col(i) += outlier_offset_px;
+    }
+  }
+  const VisualFrame::Ptr frame_kp1 = VisualFrame::createEmptyTestVisualFrame(camera_, 1);
+  frame_kp1->setKeypointMeasurements(keypoints_kp1);
+  frame_kp1->setDescriptors(descriptors_);
+
+  // The uncorrected predictions are too far off for the fine windows.
+  GyroTwoFrameMatcher matcher(camera_->imageHeight());
+  EXPECT_FALSE(matcher.isCoarseToFineMatchingEnabled());
+  FrameToFrameMatchesWithScore matches_kp1_k;
+  matcher.match(Quaternion(), *frame_kp1, *frame_k_, keypoints_k_, prediction_success_,
+                &matches_kp1_k);
+  EXPECT_TRUE(matches_kp1_k.empty());
+
+  // The affine correction is fitted to the coarse matches without the outliers, the corrected
+  // predictions of the inliers are exact and those of the outliers out of the windows.
+  matcher.setCoarseToFineMatching(true);
+  EXPECT_TRUE(matcher.isCoarseToFineMatchingEnabled());
+  matcher.match(Quaternion(), *frame_kp1, *frame_k_, keypoints_k_, prediction_success_,
+                &matches_kp1_k);
+  const int num_outliers = (num_keypoints_ + kOutlierStride - 1) / kOutlierStride;
+  EXPECT_EQ(static_cast<size_t>(num_keypoints_ - num_outliers), matches_kp1_k.size());
+  for (const FrameToFrameMatchWithScore& match : matches_kp1_k) {
+    EXPECT_EQ(match.getKeypointIndexAppleFrame(), match.getKeypointIndexBananaFrame());
+    EXPECT_NE(0, match.getKeypointIndexBananaFrame() % kOutlierStride);
+  }
+}
+
+TEST_F(GyroTwoFrameMatcherTest, CoarseToFineFallsBackWithTooFewPredictions) {
+  // Within the large search window, such that the uncorrected predictions match.
+  const VisualFrame::Ptr frame_kp1 = createFrameKp1(Eigen::Vector2d(15.0, 0.0));
+  // Fewer successful predictions than needed for the coarse correction.
+  constexpr int kNumSuccessfulPredictions = 5;
+  ASSERT_GT(num_keypoints_, kNumSuccessfulPredictions);
+  prediction_success_.assign(num_keypoints_, 0u);
+  std::fill(prediction_success_.begin(), prediction_success_.begin() + kNumSuccessfulPredictions,
+            1u);
+
+  GyroTwoFrameMatcher matcher(camera_->imageHeight());
+  FrameToFrameMatchesWithScore fine_matches_kp1_k;
+  matcher.match(Quaternion(), *frame_kp1, *frame_k_, keypoints_k_, prediction_success_,
+                &fine_matches_kp1_k);
+  EXPECT_EQ(static_cast<size_t>(kNumSuccessfulPredictions), fine_matches_kp1_k.size());
+
+  matcher.setCoarseToFineMatching(true);
+  FrameToFrameMatchesWithScore coarse_to_fine_matches_kp1_k;
+  matcher.match(Quaternion(), *frame_kp1, *frame_k_, keypoints_k_, prediction_success_,
+                &coarse_to_fine_matches_kp1_k);
+  EXPECT_TRUE(fine_matches_kp1_k == coarse_to_fine_matches_kp1_k);
+}
+
+namespace {
+/// A frame pair for the regression of the reused matcher: frame (k+1) observes a shuffled
+/// subset of the keypoints of frame k with pixel noise and flipped descriptor bits, plus
+/// distractors with random descriptors.
+struct RandomFramePair {
+  VisualFrame::Ptr frame_k;
+  VisualFrame::Ptr frame_kp1;
+  Eigen::Matrix2Xd predicted_keypoints_kp1;
+  std::vector<unsigned char> prediction_success;
+};
+
+RandomFramePair createRandomFramePair(
+    const Camera::Ptr& camera, int num_keypoints_k, int descriptor_size_bytes,
+    const Eigen::Vector2d& offset_px) {
+  const double kBorderPx = 30.0;
+  auto random_uniform = [](double min, double max) {
+    return min + (max - min) * static_cast<double>(rand()) / RAND_MAX;
+  };
+  RandomFramePair frame_pair;
+  Eigen::Matrix2Xd keypoints_k(2, num_keypoints_k);
+  VisualFrame::DescriptorsT descriptors_k(descriptor_size_bytes, num_keypoints_k);
+  frame_pair.predicted_keypoints_kp1.resize(2, num_keypoints_k);
+  for (int i = 0; i < num_keypoints_k; ++i) {
+    keypoints_k.col(i) << random_uniform(kBorderPx, camera->imageWidth() - kBorderPx),
+        random_uniform(kBorderPx, camera->imageHeight() - kBorderPx);
+    frame_pair.predicted_keypoints_kp1.col(i) = keypoints_k.col(i) + offset_px;
+    frame_pair.prediction_success.push_back(rand() % 10 == 0 ? 0u : 1u);
+    for (int byte = 0; byte < descriptor_size_bytes; ++byte) {
+      descriptors_k(byte, i) = static_cast<unsigned char>(rand() % 256);
+    }
+  }
+
+  std::vector<int> observed_indices_k;
+  for (int i = 0; i < num_keypoints_k; ++i) {
+    if (rand() % 4 != 0) {
+      observed_indices_k.push_back(i);
+    }
+  }
+  const int num_distractors = num_keypoints_k / 5;
+  for (int i = 0; i < num_distractors; ++i) {
+    observed_indices_k.push_back(-1);
+  }
+  std::random_shuffle(observed_indices_k.begin(), observed_indices_k.end(),
+                      [](int n) { return rand() % n; });
+  const int num_keypoints_kp1 = static_cast<int>(observed_indices_k.size());
+  Eigen::Matrix2Xd keypoints_kp1(2, num_keypoints_kp1);
+  VisualFrame::DescriptorsT descriptors_kp1(descriptor_size_bytes, num_keypoints_kp1);
+  for (int i = 0; i < num_keypoints_kp1; ++i) {
+    const int index_k = observed_indices_k[i];
+    if (index_k < 0) {
+      keypoints_kp1.col(i) << random_uniform(kBorderPx, camera->imageWidth() - kBorderPx),
+          random_uniform(kBorderPx, camera->imageHeight() - kBorderPx);
+      for (int byte = 0; byte < descriptor_size_bytes; ++byte) {
+        descriptors_kp1(byte, i) = static_cast<unsigned char>(rand() % 256);
+      }
+      continue;
+    }
+    keypoints_kp1.col(i) = keypoints_k.col(index_k) + offset_px +
+        Eigen::Vector2d(random_uniform(-3.0, 3.0), random_uniform(-3.0, 3.0));
+    descriptors_kp1.col(i) = descriptors_k.col(index_k);
+    for (int flip = 0; flip < descriptor_size_bytes / 4; ++flip) {
+      descriptors_kp1(rand() % descriptor_size_bytes, i) ^=
+          static_cast<unsigned char>(1u << (rand() % 8));
+    }
+  }
+
+  frame_pair.frame_k = VisualFrame::createEmptyTestVisualFrame(camera, 0);
+  frame_pair.frame_k->setKeypointMeasurements(keypoints_k);
+  frame_pair.frame_k->setDescriptors(descriptors_k);
+  frame_pair.frame_kp1 = VisualFrame::createEmptyTestVisualFrame(camera, 1);
+  frame_pair.frame_kp1->setKeypointMeasurements(keypoints_kp1);
+  frame_pair.frame_kp1->setDescriptors(descriptors_kp1);
+  return frame_pair;
+}
+}  // namespace
+
+TEST_F(GyroTwoFrameMatcherTest, ReusedMatcherEqualsFreshMatcher) {
+  // Frame pairs of varying sizes and descriptor lengths, such that stale buffers or a cached
+  // descriptor size of an earlier call would change the result.
+  struct FramePairOptions {
+    int num_keypoints_k;
+    int descriptor_size_bytes;
+    double offset_x_px;
+    double offset_y_px;
+  };
+  const std::vector<FramePairOptions> frame_pair_options = {
+      {300, 48, 2.0, 1.0}, {50, 48, -8.0, 12.0}, {600, 64, 0.0, -5.0}, {200, 32, 15.0, 0.0},
+      {300, 48, 2.0, 1.0}};
+
+  GyroTwoFrameMatcher reused_matcher(camera_->imageHeight());
+  for (size_t pair_idx = 0u; pair_idx < frame_pair_options.size(); ++pair_idx) {
+    SCOPED_TRACE(::testing::Message() << "Frame pair " << pair_idx);
+    const FramePairOptions& options = frame_pair_options[pair_idx];
+    const RandomFramePair frame_pair = createRandomFramePair(
+        camera_, options.num_keypoints_k, options.descriptor_size_bytes,
+        Eigen::Vector2d(options.offset_x_px, options.offset_y_px));
+
+    FrameToFrameMatchesWithScore fresh_matches_kp1_k;
+    GyroTwoFrameMatcher fresh_matcher(camera_->imageHeight());
+    fresh_matcher.match(Quaternion(), *frame_pair.frame_kp1, *frame_pair.frame_k,
+                        frame_pair.predicted_keypoints_kp1, frame_pair.prediction_success,
+                        &fresh_matches_kp1_k);
+    FrameToFrameMatchesWithScore reused_matches_kp1_k;
+    reused_matcher.match(Quaternion(), *frame_pair.frame_kp1, *frame_pair.frame_k,
+                         frame_pair.predicted_keypoints_kp1, frame_pair.prediction_success,
+                         &reused_matches_kp1_k);
+    EXPECT_TRUE(fresh_matches_kp1_k == reused_matches_kp1_k);
+    EXPECT_FALSE(reused_matches_kp1_k.empty());
+
+    // The matches are exclusive and only match keypoints with a successful prediction.
+    std::vector<bool> is_matched_k(options.num_keypoints_k, false);
+    std::vector<bool> is_matched_kp1(frame_pair.frame_kp1->getNumKeypointMeasurements(), false);
+    for (const FrameToFrameMatchWithScore& match : reused_matches_kp1_k) {
+      const int index_k = match.getKeypointIndexBananaFrame();
+      const int index_kp1 = match.getKeypointIndexAppleFrame();
+      EXPECT_FALSE(is_matched_k[index_k]);
+      EXPECT_FALSE(is_matched_kp1[index_kp1]);
+      is_matched_k[index_k] = true;
+      is_matched_kp1[index_kp1] = true;
+      EXPECT_EQ(1u, frame_pair.prediction_success[index_k]);
+      EXPECT_GT(match.getScore(), 0.0);
+      EXPECT_LE(match.getScore(), 1.0);
+    }
+  }
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
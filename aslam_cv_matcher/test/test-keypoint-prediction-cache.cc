@@ -0,0 +1,85 @@
+#include <vector>
+
+#include <eigen-checks/gtest.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/keypoint-prediction-cache.h>
+
+namespace aslam {
+namespace {
+constexpr int64_t kFramePeriodNanoseconds = 100000000;
+}  // namespace
+
+TEST(KeypointPredictionCache, PredictsWithTheTrackVelocities) {
+  const Camera::ConstPtr camera = PinholeCamera::createTestCamera();
+  Eigen::Matrix2Xd keypoints_k(2, 3);
+  keypoints_k << 100.0, 300.0, 200.0,
+                 100.0, 200.0, 400.0;
+  const Eigen::Vector2d flow_px(5.0, -3.0);
+  const Eigen::Matrix2Xd keypoints_kp1 = keypoints_k.colwise() + flow_px;
+  Eigen::VectorXi track_ids(3);
+  track_ids << 7, 8, -1;
+
+  VisualFrame::Ptr frame_k = VisualFrame::createEmptyTestVisualFrame(camera, 0);
+  frame_k->setKeypointMeasurements(keypoints_k);
+  frame_k->setTrackIds(track_ids);
+  VisualFrame::Ptr frame_kp1 =
+      VisualFrame::createEmptyTestVisualFrame(camera, kFramePeriodNanoseconds);
+  frame_kp1->setKeypointMeasurements(keypoints_kp1);
+  frame_kp1->setTrackIds(track_ids);
+  VisualFrame::Ptr frame_kp2 =
+      VisualFrame::createEmptyTestVisualFrame(camera, 2 * kFramePeriodNanoseconds);
+
+  KeypointPredictionCache::Options options;
+  KeypointPredictionCache cache(options);
+  const Quaternion q_identity;
+
+  // Without history the prediction is rotation-only with the largest radius.
+  Eigen::Matrix2Xd predicted_keypoints;
+  std::vector<unsigned char> prediction_success;
+  Eigen::VectorXd search_radii_px;
+  cache.predictKeypoints(*frame_k, q_identity, frame_kp1->getTimestampNanoseconds(),
+                         &predicted_keypoints, &prediction_success, &search_radii_px);
+  ASSERT_EQ(3u, prediction_success.size());
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(keypoints_k, predicted_keypoints, 1e-9));
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(Eigen::VectorXd::Constant(3, options.max_search_radius_px),
+                                search_radii_px, 1e-12));
+
+  // Only the keypoints with a track id are cached.
+  FrameToFrameMatches matches_kp1_k;
+  for (size_t i = 0u; i < 3u; ++i) {
+    matches_kp1_k.emplace_back(i, i);
+  }
+  cache.update(*frame_kp1, matches_kp1_k);
+  EXPECT_EQ(2u, cache.numTracks());
+
+  // The tracked keypoints move on with their velocity and a tighter radius.
+  cache.predictKeypoints(*frame_kp1, q_identity, frame_kp2->getTimestampNanoseconds(),
+                         &predicted_keypoints, &prediction_success, &search_radii_px);
+  ASSERT_EQ(3, predicted_keypoints.cols());
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(Eigen::Vector2d(keypoints_kp1.col(i) + flow_px),
+                                  Eigen::Vector2d(predicted_keypoints.col(i)), 1e-6));
+    EXPECT_NEAR(options.base_uncertainty_px + options.velocity_uncertainty_ratio *
+                flow_px.norm(), search_radii_px(i), 1e-6);
+  }
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(Eigen::Vector2d(keypoints_kp1.col(2)),
+                                Eigen::Vector2d(predicted_keypoints.col(2)), 1e-6));
+  EXPECT_DOUBLE_EQ(options.max_search_radius_px, search_radii_px(2));
+
+  // Tracks without matches are dropped after max_num_missed_updates.
+  for (size_t i = 0u; i < options.max_num_missed_updates; ++i) {
+    cache.update(*frame_kp2, FrameToFrameMatches());
+    EXPECT_EQ(2u, cache.numTracks());
+  }
+  cache.update(*frame_kp2, FrameToFrameMatches());
+  EXPECT_EQ(0u, cache.numTracks());
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
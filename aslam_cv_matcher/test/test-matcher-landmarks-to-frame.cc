@@ -0,0 +1,162 @@
+#include <vector>
+
+#include <eigen-checks/gtest.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/camera-visibility-cone.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/match.h>
+#include <aslam/matcher/matching-engine-exclusive.h>
+#include <aslam/matcher/matching-problem-landmarks-to-frame.h>
+
+namespace aslam {
+namespace {
+constexpr int kDescriptorSizeBytes = 48;
+constexpr double kSearchRadiusPixels = 5.0;
+constexpr int kHammingDistanceThreshold = 10;
+
+class MatcherLandmarksToFrameTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    camera_ = PinholeCamera::createTestCamera();
+    frame_.setCameraGeometry(camera_);
+
+    // Landmark i projects to pixel_i, its keypoint is offset by keypoint_offsets_(i).
+    const Eigen::Matrix2Xd pixels =
+        (Eigen::Matrix2Xd(2, 4) << 100, 300, 500, 320, 100, 200, 400, 240).finished();
+    keypoint_offsets_.resize(2, pixels.cols());
+    keypoint_offsets_ << 1.0, -2.0, 8.0, 0.0,
+                         1.0, 2.0, 0.0, 0.0;
+    G_landmarks_.resize(3, pixels.cols());
+    for (int idx = 0; idx < pixels.cols(); ++idx) {
+      Eigen::Vector3d bearing;
+      CHECK(camera_->backProject3(pixels.col(idx), &bearing));
+      G_landmarks_.col(idx) = 5.0 * bearing / bearing.z();
+    }
+    const Eigen::Matrix2Xd keypoints = pixels + keypoint_offsets_;
+    frame_.setKeypointMeasurements(keypoints);
+
+    VisualFrame::DescriptorsT descriptors(kDescriptorSizeBytes, keypoints.cols());
+    for (int keypoint_idx = 0; keypoint_idx < keypoints.cols(); ++keypoint_idx) {
+      for (int byte_idx = 0; byte_idx < kDescriptorSizeBytes; ++byte_idx) {
+        descriptors(byte_idx, keypoint_idx) =
+            static_cast<unsigned char>(31 * keypoint_idx + 7 * byte_idx);
+      }
+    }
+    frame_.setDescriptors(descriptors);
+    landmark_descriptors_ = descriptors;
+    // The last landmark projects onto the image center but has a different descriptor.
+    landmark_descriptors_.col(3).setConstant(0xaa);
+
+    T_C_G_.setIdentity();
+  }
+
+  std::vector<bool> getMatchedLandmarks(MatchingProblemLandmarksToFrame* matching_problem) {
+    CHECK_NOTNULL(matching_problem);
+    MatchingEngineExclusive<MatchingProblemLandmarksToFrame> matching_engine;
+    MatchingProblemLandmarksToFrame::MatchesWithScore matches;
+    matching_engine.match(matching_problem, &matches);
+    std::vector<bool> is_landmark_matched(G_landmarks_.cols(), false);
+    for (const MatchingProblemLandmarksToFrame::MatchWithScore& match : matches) {
+      // Every landmark can only match its own keypoint.
+      EXPECT_EQ(match.getKeypointIndex(), match.getLandmarkIndex());
+      EXPECT_DOUBLE_EQ(1.0, match.getScore());
+      is_landmark_matched[match.getLandmarkIndex()] = true;
+    }
+    return is_landmark_matched;
+  }
+
+  PinholeCamera::Ptr camera_;
+  VisualFrame frame_;
+  Eigen::Matrix2Xd keypoint_offsets_;
+  Eigen::Matrix3Xd G_landmarks_;
+  MatchingProblemLandmarksToFrame::DescriptorsT landmark_descriptors_;
+  Transformation T_C_G_;
+};
+}  // namespace
+
+TEST_F(MatcherLandmarksToFrameTest, MatchWithinSearchRadius) {
+  MatchingProblemLandmarksToFrame matching_problem(
+      frame_, G_landmarks_, landmark_descriptors_, T_C_G_, kSearchRadiusPixels,
+      kHammingDistanceThreshold);
+  const std::vector<bool> is_landmark_matched = getMatchedLandmarks(&matching_problem);
+
+  for (int idx = 0; idx < G_landmarks_.cols(); ++idx) {
+    ASSERT_TRUE(matching_problem.isLandmarkVisible(idx));
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(
+        frame_.getKeypointMeasurement(idx) - keypoint_offsets_.col(idx),
+        matching_problem.getProjectedLandmark(idx), 1e-9));
+  }
+  EXPECT_TRUE(is_landmark_matched[0]);
+  EXPECT_TRUE(is_landmark_matched[1]);
+  // Outside of the search radius.
+  EXPECT_FALSE(is_landmark_matched[2]);
+  // Above the descriptor distance threshold.
+  EXPECT_FALSE(is_landmark_matched[3]);
+}
+
+TEST_F(MatcherLandmarksToFrameTest, ScaleAwareSearchRadius) {
+  Eigen::VectorXd landmark_predicted_scales = Eigen::VectorXd::Ones(G_landmarks_.cols());
+  landmark_predicted_scales(1) = 0.2;
+  landmark_predicted_scales(2) = 2.0;
+  MatchingProblemLandmarksToFrame matching_problem(
+      frame_, G_landmarks_, landmark_descriptors_, T_C_G_, landmark_predicted_scales,
+      kSearchRadiusPixels, kHammingDistanceThreshold);
+  const std::vector<bool> is_landmark_matched = getMatchedLandmarks(&matching_problem);
+
+  EXPECT_TRUE(is_landmark_matched[0]);
+  EXPECT_FALSE(is_landmark_matched[1]);
+  EXPECT_TRUE(is_landmark_matched[2]);
+  EXPECT_FALSE(is_landmark_matched[3]);
+}
+
+TEST_F(MatcherLandmarksToFrameTest, SkipLandmarksOutsideOfTheImage) {
+  // The first landmark is behind the camera.
+  G_landmarks_.col(0) *= -1.0;
+  MatchingProblemLandmarksToFrame matching_problem(
+      frame_, G_landmarks_, landmark_descriptors_, T_C_G_, kSearchRadiusPixels,
+      kHammingDistanceThreshold);
+  const std::vector<bool> is_landmark_matched = getMatchedLandmarks(&matching_problem);
+  EXPECT_FALSE(matching_problem.isLandmarkVisible(0));
+  EXPECT_FALSE(is_landmark_matched[0]);
+  EXPECT_TRUE(is_landmark_matched[1]);
+}
+
+TEST_F(MatcherLandmarksToFrameTest, VisibilityCullingKeepsTheMatches) {
+  // The first landmark is behind the camera, the last one far off the optical axis.
+  G_landmarks_.col(0) *= -1.0;
+  G_landmarks_.col(3) << 100.0, 0.0, 1.0;
+  MatchingProblemLandmarksToFrame reference_problem(
+      frame_, G_landmarks_, landmark_descriptors_, T_C_G_, kSearchRadiusPixels,
+      kHammingDistanceThreshold);
+  const std::vector<bool> reference_matches = getMatchedLandmarks(&reference_problem);
+
+  const CameraVisibilityCone cone(*camera_);
+  const LandmarkSpatialHash landmark_hash(G_landmarks_, 1.0);
+  for (const LandmarkSpatialHash* hash : {static_cast<const LandmarkSpatialHash*>(nullptr),
+                                          &landmark_hash}) {
+    MatchingProblemLandmarksToFrame matching_problem(
+        frame_, G_landmarks_, landmark_descriptors_, T_C_G_, kSearchRadiusPixels,
+        kHammingDistanceThreshold);
+    matching_problem.setVisibilityCulling(&cone, hash);
+    EXPECT_EQ(reference_matches, getMatchedLandmarks(&matching_problem));
+    for (int idx = 0; idx < G_landmarks_.cols(); ++idx) {
+      ASSERT_EQ(reference_problem.isLandmarkVisible(idx),
+                matching_problem.isLandmarkVisible(idx));
+      if (matching_problem.isLandmarkVisible(idx)) {
+        EXPECT_TRUE(EIGEN_MATRIX_NEAR(reference_problem.getProjectedLandmark(idx),
+                                      matching_problem.getProjectedLandmark(idx), 1e-9));
+      }
+    }
+    EXPECT_FALSE(matching_problem.isLandmarkVisible(0));
+    EXPECT_FALSE(matching_problem.isLandmarkVisible(3));
+  }
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,80 @@
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <aslam/matcher/match.h>
+#include <aslam/matcher/matching-engine-exclusive.h>
+#include <aslam/matcher/matching-problem-nframe-to-nframe.h>
+
+namespace aslam {
+namespace {
+constexpr size_t kNumCameras = 2u;
+constexpr int kNumKeypoints = 8;
+constexpr int kDescriptorSizeBytes = 48;
+
+void setFrameContent(const Eigen::Matrix2Xd& keypoints, unsigned char descriptor_seed,
+                     VisualFrame* frame) {
+  CHECK_NOTNULL(frame);
+  frame->setKeypointMeasurements(keypoints);
+  VisualFrame::DescriptorsT descriptors(kDescriptorSizeBytes, keypoints.cols());
+  for (int keypoint_idx = 0; keypoint_idx < keypoints.cols(); ++keypoint_idx) {
+    for (int byte_idx = 0; byte_idx < kDescriptorSizeBytes; ++byte_idx) {
+      descriptors(byte_idx, keypoint_idx) = static_cast<unsigned char>(
+          descriptor_seed ^ (31 * keypoint_idx + 7 * byte_idx));
+    }
+  }
+  frame->setDescriptors(descriptors);
+}
+}  // namespace
+
+TEST(MatcherNFrameTest, MatchesAcrossCameras) {
+  // All cameras of the test rig face the same direction, hence a ray observed in one banana
+  // camera projects to the same pixel in every apple camera.
+  NCamera::Ptr ncamera = NCamera::createTestNCamera(kNumCameras);
+  VisualNFrame::Ptr apple_nframe = VisualNFrame::createEmptyTestVisualNFrame(ncamera, 0);
+  VisualNFrame::Ptr banana_nframe = VisualNFrame::createEmptyTestVisualNFrame(ncamera, 1);
+
+  Eigen::Matrix2Xd keypoints(2, kNumKeypoints);
+  for (int keypoint_idx = 0; keypoint_idx < kNumKeypoints; ++keypoint_idx) {
+    keypoints.col(keypoint_idx) << 100.0 + 40.0 * keypoint_idx, 200.0 + 10.0 * keypoint_idx;
+  }
+  // The descriptors of banana camera 0 match apple camera 1 and vice versa.
+  setFrameContent(keypoints, 0x00, apple_nframe->getFrameShared(0u).get());
+  setFrameContent(keypoints, 0xff, apple_nframe->getFrameShared(1u).get());
+  setFrameContent(keypoints, 0xff, banana_nframe->getFrameShared(0u).get());
+  setFrameContent(keypoints, 0x00, banana_nframe->getFrameShared(1u).get());
+
+  Quaternion q_A_B;
+  q_A_B.setIdentity();
+  MatchingProblemNFrameToNFrame matching_problem(*apple_nframe, *banana_nframe, q_A_B, 5.0, 10);
+  MatchingEngineExclusive<MatchingProblemNFrameToNFrame> matching_engine;
+  MatchingProblemNFrameToNFrame::MatchesWithScore matches;
+  matching_engine.match(&matching_problem, &matches);
+
+  EXPECT_EQ(kNumCameras * kNumKeypoints, matching_problem.numApples());
+  EXPECT_EQ(kNumCameras * kNumKeypoints, matching_problem.numBananas());
+  EXPECT_EQ(kNumCameras * kNumCameras * kNumKeypoints,
+            matching_problem.getNumBananaProjections());
+  ASSERT_EQ(kNumCameras * kNumKeypoints, matches.size());
+  for (const MatchingProblemNFrameToNFrame::MatchWithScore& match : matches) {
+    size_t apple_camera_idx, apple_keypoint_idx;
+    size_t banana_camera_idx, banana_keypoint_idx;
+    matching_problem.getAppleKeypoint(
+        match.getKeypointIndexAppleNFrame(), &apple_camera_idx, &apple_keypoint_idx);
+    matching_problem.getBananaKeypoint(
+        match.getKeypointIndexBananaNFrame(), &banana_camera_idx, &banana_keypoint_idx);
+    EXPECT_NE(apple_camera_idx, banana_camera_idx);
+    EXPECT_EQ(apple_keypoint_idx, banana_keypoint_idx);
+    EXPECT_DOUBLE_EQ(1.0, match.getScore());
+  }
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
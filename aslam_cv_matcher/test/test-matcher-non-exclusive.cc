@@ -1,5 +1,7 @@
 #include <algorithm>
 #include <cmath>
+#include <random>
+#include <utility>
 #include <vector>
 
 #include <glog/logging.h>
@@ -9,6 +11,7 @@
 #include <aslam/common/entrypoint.h>
 #include <aslam/common/pose-types.h>
 #include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/compact-matches.h>
 #include <aslam/matcher/match.h>
 #include <aslam/matcher/matching-engine-non-exclusive.h>
 #include <aslam/matcher/matching-problem-frame-to-frame.h>
@@ -24,6 +27,25 @@ class MatcherTest : public testing::Test {
     hamming_distance_threshold_ = 60;
   }
 
+  /// Set the first num_bits bits of the descriptor in the column, the others are cleared.
+  static void setDescriptorBits(size_t column, size_t num_bits,
+                                aslam::VisualFrame::DescriptorsT* descriptors) {
+    CHECK_NOTNULL(descriptors)->col(column).setZero();
+    for (size_t bit_idx = 0u; bit_idx < num_bits; ++bit_idx) {
+      (*descriptors)(bit_idx / 8u, column) |= static_cast<unsigned char>(1u << (bit_idx % 8u));
+    }
+  }
+
+  /// The (apple, banana) pairs of the matches in their order.
+  static std::vector<std::pair<int, int>> getMatchedPairs(
+      const aslam::MatchingProblemFrameToFrame::MatchesWithScore& matches_A_B) {
+    std::vector<std::pair<int, int>> pairs;
+    for (const aslam::MatchingProblemFrameToFrame::MatchWithScore& match : matches_A_B) {
+      pairs.emplace_back(match.getKeypointIndexAppleFrame(), match.getKeypointIndexBananaFrame());
+    }
+    return pairs;
+  }
+
   double image_space_distance_threshold_;
   int hamming_distance_threshold_;
 
@@ -280,4 +302,164 @@ TEST_F(MatcherTest, TestComplex) {
   }
 }
 
+TEST_F(MatcherTest, BananaPredictionsReplaceTheRotationOnlyProjection) {
+  // The bananas moved beyond the image space distance threshold.
+  Eigen::Matrix2Xd apple_keypoints(2, 2);
+  apple_keypoints << 200.0, 400.0,
+                     200.0, 300.0;
+  const Eigen::Matrix2Xd banana_keypoints =
+      apple_keypoints.colwise() + Eigen::Vector2d(40.0, 0.0);
+  apple_frame_->setKeypointMeasurements(apple_keypoints);
+  apple_frame_->setDescriptors(Eigen::Matrix<unsigned char, 48, 2>::Zero());
+  banana_frame_->setKeypointMeasurements(banana_keypoints);
+  banana_frame_->setDescriptors(Eigen::Matrix<unsigned char, 48, 2>::Zero());
+
+  aslam::Quaternion q_A_B;
+  q_A_B.setIdentity();
+  auto match = [&](const Eigen::Matrix2Xd* A_predicted_keypoints_banana,
+                   const std::vector<unsigned char>& prediction_success,
+                   const Eigen::VectorXd& search_radii_px)
+      -> aslam::MatchingProblemFrameToFrame::MatchesWithScore {
+    aslam::MatchingProblemFrameToFrame::Ptr matching_problem =
+        aligned_shared<aslam::MatchingProblemFrameToFrame>(
+            *apple_frame_, *banana_frame_, q_A_B, image_space_distance_threshold_,
+            hamming_distance_threshold_);
+    if (A_predicted_keypoints_banana != nullptr) {
+      matching_problem->setBananaPredictions(
+          *A_predicted_keypoints_banana, prediction_success, search_radii_px);
+    }
+    aslam::MatchingProblemFrameToFrame::MatchesWithScore matches_A_B;
+    matching_engine_.match(matching_problem.get(), &matches_A_B);
+    return matches_A_B;
+  };
+  const std::vector<unsigned char> prediction_success = {1u, 0u};
+  Eigen::VectorXd search_radii_px(2);
+  search_radii_px << 10.0, 100.0;
+  EXPECT_TRUE(match(nullptr, prediction_success, search_radii_px).empty());
+
+  // The prediction of banana 0 is close to its apple, banana 1 keeps its projection.
+  Eigen::Matrix2Xd A_predicted_keypoints_banana(2, 2);
+  A_predicted_keypoints_banana << 205.0, 400.0,
+                                  200.0, 300.0;
+  aslam::MatchingProblemFrameToFrame::MatchesWithScore matches_A_B =
+      match(&A_predicted_keypoints_banana, prediction_success, search_radii_px);
+  ASSERT_EQ(1u, matches_A_B.size());
+  EXPECT_EQ(0, matches_A_B[0].getKeypointIndexAppleFrame());
+  EXPECT_EQ(0, matches_A_B[0].getKeypointIndexBananaFrame());
+
+  // A radius below the prediction error drops the candidate.
+  search_radii_px(0) = 4.0;
+  EXPECT_TRUE(match(&A_predicted_keypoints_banana, prediction_success, search_radii_px).empty());
+
+  // The radii are bounded by the image space distance threshold.
+  A_predicted_keypoints_banana(0, 0) = 200.0 + image_space_distance_threshold_ + 5.0;
+  search_radii_px(0) = 100.0;
+  EXPECT_TRUE(match(&A_predicted_keypoints_banana, prediction_success, search_radii_px).empty());
+}
+
+TEST_F(MatcherTest, BoundedTopKMatchesWithRatioTest) {
+  // Apples 0 to 3 surround banana 0 at Hamming distances of 2, 4, 20 and 40 bits. Apples 4 and 5
+  // surround banana 1 at the ambiguous distances of 10 and 11 bits.
+  Eigen::Matrix2Xd apple_keypoints(2, 6);
+  apple_keypoints << 100.0, 101.0, 102.0, 103.0, 300.0, 301.0,
+                     100.0, 100.0, 100.0, 100.0, 300.0, 300.0;
+  Eigen::Matrix2Xd banana_keypoints(2, 2);
+  banana_keypoints << 100.0, 300.0,
+                      101.0, 301.0;
+  aslam::VisualFrame::DescriptorsT apple_descriptors(48, 6);
+  const size_t kAppleDistancesBits[] = {2u, 4u, 20u, 40u, 10u, 11u};
+  for (size_t apple_idx = 0u; apple_idx < 6u; ++apple_idx) {
+    setDescriptorBits(apple_idx, kAppleDistancesBits[apple_idx], &apple_descriptors);
+  }
+  apple_frame_->setKeypointMeasurements(apple_keypoints);
+  apple_frame_->setDescriptors(apple_descriptors);
+  banana_frame_->setKeypointMeasurements(banana_keypoints);
+  banana_frame_->setDescriptors(aslam::VisualFrame::DescriptorsT::Zero(48, 2));
+
+  aslam::Quaternion q_A_B;
+  q_A_B.setIdentity();
+  auto match = [&](aslam::MatchingEngineNonExclusive<aslam::MatchingProblemFrameToFrame>* engine)
+      -> aslam::MatchingProblemFrameToFrame::MatchesWithScore {
+    aslam::MatchingProblemFrameToFrame::Ptr matching_problem =
+        aligned_shared<aslam::MatchingProblemFrameToFrame>(
+            *apple_frame_, *banana_frame_, q_A_B, image_space_distance_threshold_,
+            hamming_distance_threshold_);
+    aslam::MatchingProblemFrameToFrame::MatchesWithScore matches_A_B;
+    EXPECT_TRUE(engine->match(matching_problem.get(), &matches_A_B));
+    return matches_A_B;
+  };
+  typedef std::vector<std::pair<int, int>> Pairs;
+
+  // The best apple of every banana by default.
+  EXPECT_EQ(Pairs({{0, 0}, {4, 1}}), getMatchedPairs(match(&matching_engine_)));
+
+  // The two best apples of every banana, best first.
+  aslam::MatchingEngineNonExclusive<aslam::MatchingProblemFrameToFrame> top_2_engine(
+      1u, 2u, 1.0);
+  aslam::MatchingProblemFrameToFrame::MatchesWithScore matches_A_B = match(&top_2_engine);
+  EXPECT_EQ(Pairs({{0, 0}, {1, 0}, {4, 1}, {5, 1}}), getMatchedPairs(matches_A_B));
+  ASSERT_EQ(4u, matches_A_B.size());
+  EXPECT_DOUBLE_EQ(1.0 - 2.0 / 384.0, matches_A_B[0].getScore());
+  EXPECT_DOUBLE_EQ(1.0 - 4.0 / 384.0, matches_A_B[1].getScore());
+
+  // The ratio test compares the normalized Hamming distances 1 - score of the best two apples.
+  // It rejects banana 1 with 10 / 11 bits and keeps banana 0 with 2 / 4 bits.
+  aslam::MatchingEngineNonExclusive<aslam::MatchingProblemFrameToFrame> ratio_engine(
+      1u, 1u, 0.8);
+  EXPECT_EQ(Pairs({{0, 0}}), getMatchedPairs(match(&ratio_engine)));
+  aslam::MatchingEngineNonExclusive<aslam::MatchingProblemFrameToFrame> strict_ratio_engine(
+      1u, 2u, 0.4);
+  EXPECT_TRUE(match(&strict_ratio_engine).empty());
+}
+
+TEST_F(MatcherTest, ParallelMatchesEqualSerialMatches) {
+  // Descriptors within a few bits of each other, such that most bananas have several
+  // candidates within the Hamming distance threshold.
+  const size_t kNumApples = 300u;
+  const size_t kNumBananas = 400u;
+  std::mt19937 random_engine(42u);
+  std::uniform_real_distribution<double> x_distribution(0.0, camera_->imageWidth() - 1.0);
+  std::uniform_real_distribution<double> y_distribution(0.0, camera_->imageHeight() - 1.0);
+  std::uniform_int_distribution<size_t> num_bits_distribution(0u, 25u);
+  auto setRandomFrame = [&](size_t num_keypoints, aslam::VisualFrame* frame) {
+    Eigen::Matrix2Xd keypoints(2, num_keypoints);
+    aslam::VisualFrame::DescriptorsT descriptors(48, num_keypoints);
+    for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints; ++keypoint_idx) {
+      keypoints.col(keypoint_idx) << x_distribution(random_engine), y_distribution(random_engine);
+      setDescriptorBits(keypoint_idx, num_bits_distribution(random_engine), &descriptors);
+    }
+    frame->setKeypointMeasurements(keypoints);
+    frame->setDescriptors(descriptors);
+  };
+  setRandomFrame(kNumApples, apple_frame_.get());
+  setRandomFrame(kNumBananas, banana_frame_.get());
+
+  aslam::Quaternion q_A_B;
+  q_A_B.setIdentity();
+  aslam::MatchingProblemFrameToFrame::Ptr matching_problem =
+      aligned_shared<aslam::MatchingProblemFrameToFrame>(
+          *apple_frame_, *banana_frame_, q_A_B, image_space_distance_threshold_,
+          hamming_distance_threshold_);
+  const std::vector<std::pair<size_t, double>> kTopKAndRatioThresholds = {{1u, 1.0}, {3u, 0.999}};
+  for (const std::pair<size_t, double>& k_and_ratio : kTopKAndRatioThresholds) {
+    aslam::MatchingEngineNonExclusive<aslam::MatchingProblemFrameToFrame> serial_engine(
+        1u, k_and_ratio.first, k_and_ratio.second);
+    aslam::CompactMatchesWithScore serial_matches;
+    ASSERT_TRUE(serial_engine.match(matching_problem.get(), &serial_matches));
+    ASSERT_FALSE(serial_matches.empty());
+    for (size_t num_threads : {2u, 5u}) {
+      aslam::MatchingEngineNonExclusive<aslam::MatchingProblemFrameToFrame> parallel_engine(
+          num_threads, k_and_ratio.first, k_and_ratio.second);
+      aslam::CompactMatchesWithScore parallel_matches;
+      ASSERT_TRUE(parallel_engine.match(matching_problem.get(), &parallel_matches));
+      EXPECT_TRUE(serial_matches == parallel_matches)
+          << "Threads: " << num_threads << ", k: " << k_and_ratio.first;
+      // The reused candidate buffers give the same result.
+      ASSERT_TRUE(parallel_engine.match(matching_problem.get(), &parallel_matches));
+      EXPECT_TRUE(serial_matches == parallel_matches)
+          << "Threads: " << num_threads << ", k: " << k_and_ratio.first;
+    }
+  }
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
@@ -2,8 +2,12 @@
 #include <cmath>
 #include <vector>
 
+#include <aslam/common/allocation-predicates.h>
 #include <aslam/common/entrypoint.h>
+#include <aslam/matcher/compact-matches.h>
 #include <aslam/matcher/match.h>
+#include <aslam/matcher/match-helpers.h>
+#include <aslam/matcher/matching-engine-cross-check.h>
 #include <aslam/matcher/matching-engine-exclusive.h>
 #include <aslam/matcher/matching-engine-greedy.h>
 #include <aslam/matcher/matching-problem.h>
@@ -37,6 +41,10 @@ class SimpleMatchProblem : public aslam::MatchingProblem {
     return true;
   }
 
+  virtual bool supportsConcurrentCandidateQueries() const {
+    return true;
+  }
+
   template<typename iter>
   void setApples(const iter& first, const iter& last) {
     apples_.clear();
@@ -105,32 +113,29 @@ TEST(PriorityMatchingTest, TestAssignBest) {
   // (2, 2)
   aslam::MatchingEngineExclusive<SimpleMatchProblem> matching_engine;
 
-  matching_engine.candidates_.resize(4);
-  matching_engine.iterator_to_next_best_apple_.resize(4);
-  matching_engine.temporary_matches_.resize(4);
+  aslam::MatchingProblem::CandidatesList candidates(4);
+  candidates[0].emplace_back(0, 0, 0.0, 0);
+
+  candidates[1].emplace_back(0, 1, 1.0, 0);
+  candidates[1].emplace_back(1, 1, 2.0, 1);
+  candidates[1].emplace_back(2, 1, 3.0, 0);
+
+  candidates[2].emplace_back(1, 2, 4.0, 1);
+  candidates[2].emplace_back(2, 2, 5.0, 0);
 
-  matching_engine.candidates_[0].emplace_back(0, 0, 0.0, 0);
-  matching_engine.iterator_to_next_best_apple_[0] = matching_engine.candidates_[0].begin();
-
-  matching_engine.candidates_[1].emplace_back(0, 1, 1.0, 0);
-  matching_engine.candidates_[1].emplace_back(1, 1, 2.0, 1);
-  matching_engine.candidates_[1].emplace_back(2, 1, 3.0, 0);
-  std::sort(matching_engine.candidates_[1].begin(), matching_engine.candidates_[1].end(),
-            std::greater<aslam::MatchingProblem::Candidate>());
-  matching_engine.iterator_to_next_best_apple_[1] = matching_engine.candidates_[1].begin();
-
-  matching_engine.candidates_[2].emplace_back(1, 2, 4.0, 1);
-  matching_engine.candidates_[2].emplace_back(2, 2, 5.0, 0);
-  std::sort(matching_engine.candidates_[2].begin(), matching_engine.candidates_[2].end(),
-            std::greater<aslam::MatchingProblem::Candidate>());
-  matching_engine.iterator_to_next_best_apple_[2] = matching_engine.candidates_[2].begin();
-
-  matching_engine.candidates_[3].emplace_back(1, 3, 6.0, 1);
-  matching_engine.candidates_[3].emplace_back(2, 3, 7.0, 0);
-  matching_engine.candidates_[3].emplace_back(3, 3, 0.5, 1);
-  std::sort(matching_engine.candidates_[3].begin(), matching_engine.candidates_[3].end(),
-            std::greater<aslam::MatchingProblem::Candidate>());
-  matching_engine.iterator_to_next_best_apple_[3] = matching_engine.candidates_[3].begin();
+  candidates[3].emplace_back(1, 3, 6.0, 1);
+  candidates[3].emplace_back(2, 3, 7.0, 0);
+  candidates[3].emplace_back(3, 3, 0.5, 1);
+
+  matching_engine.candidates_.clear();
+  matching_engine.next_best_candidate_.resize(4);
+  matching_engine.temporary_matches_.resize(4);
+  for (size_t i = 0; i < 4; ++i) {
+    std::sort(candidates[i].begin(), candidates[i].end(),
+              std::greater<aslam::MatchingProblem::Candidate>());
+    matching_engine.candidates_.appendBanana(candidates[i]);
+    matching_engine.next_best_candidate_[i] = matching_engine.candidates_.getBeginOffset(i);
+  }
 
   for (size_t i = 0; i < 4; ++i) {
     matching_engine.assignBest(i);
@@ -193,6 +198,26 @@ TEST(TestMatcherExclusive, ExclusiveMatcher) {
   }
 }
 
+TEST(TestMatcherExclusive, MatchingIsAllocationFreeOnceWarmedUp) {
+  std::vector<double> apples;
+  std::vector<double> bananas;
+  for (int i = 0; i < 100; ++i) {
+    apples.push_back(0.1 * i);
+    bananas.push_back(0.1 * (99 - i) + 0.01);
+  }
+  SimpleMatchProblem match_problem;
+  match_problem.setApples(apples.begin(), apples.end());
+  match_problem.setBananas(bananas.begin(), bananas.end());
+  aslam::MatchingEngineExclusive<SimpleMatchProblem> matching_engine;
+  SimpleMatchProblem::MatchesWithScore matches;
+  ASSERT_TRUE(matching_engine.match(&match_problem, &matches));
+  ASSERT_EQ(100u, matches.size());
+
+  // The candidates and temporary matches keep their capacity between the calls.
+  EXPECT_MAX_ALLOCATIONS(0u, { matching_engine.match(&match_problem, &matches); });
+  EXPECT_EQ(100u, matches.size());
+}
+
 TEST(TestMatcher, EmptyMatch) {
   SimpleMatchProblem mp;
   aslam::MatchingEngineGreedy<SimpleMatchProblem> me;
@@ -238,6 +263,215 @@ TEST(TestMatcher, GreedyMatcher) {
   }
 }
 
+TEST(TestMatcherCrossCheck, CrossCheckMatcher) {
+  std::vector<float> apples( { 1.1, 2.2, 3.3, 4.4, 5.5 });
+  std::vector<float> bananas = { 1.0, 2.0, 3.0, 4.0, 5.0, 1.1 };
+  // Banana 0 prefers apple 0, which prefers banana 5.
+  std::vector<int> banana_index_for_apple = { 5, 1, 2, 3, 4 };
+
+  SimpleMatchProblem match_problem;
+  aslam::MatchingEngineCrossCheck<SimpleMatchProblem> matching_engine;
+  match_problem.setApples(apples.begin(), apples.end());
+
+  SimpleMatchProblem::MatchesWithScore matches;
+  matching_engine.match(&match_problem, &matches);
+  EXPECT_TRUE(matches.empty());
+
+  match_problem.setBananas(bananas.begin(), bananas.end());
+  matching_engine.match(&match_problem, &matches);
+  EXPECT_EQ(5u, matches.size());
+  for (const SimpleMatchProblem::MatchWithScore& match : matches) {
+    EXPECT_EQ(match.getIndexBanana(), banana_index_for_apple[match.getIndexApple()]);
+  }
+}
+
+TEST(TestMatcherCrossCheck, RatioTest) {
+  std::vector<float> apples( { 0.0, 0.1, 5.0 });
+  std::vector<float> bananas = { 0.0, 5.0 };
+
+  SimpleMatchProblem match_problem;
+  match_problem.setApples(apples.begin(), apples.end());
+  match_problem.setBananas(bananas.begin(), bananas.end());
+
+  aslam::MatchingEngineCrossCheck<SimpleMatchProblem> matching_engine;
+  SimpleMatchProblem::MatchesWithScore matches;
+  matching_engine.match(&match_problem, &matches);
+  EXPECT_EQ(2u, matches.size());
+
+  // The apples 0 and 1 are too similar for banana 0.
+  aslam::MatchingEngineCrossCheck<SimpleMatchProblem> ratio_matching_engine(1u, 0.8);
+  ratio_matching_engine.match(&match_problem, &matches);
+  ASSERT_EQ(1u, matches.size());
+  EXPECT_EQ(2, matches[0].getIndexApple());
+  EXPECT_EQ(1, matches[0].getIndexBanana());
+}
+
+template<typename MatchingEngineType>
+void expectParallelMatchesEqualSerialMatches() {
+  constexpr size_t kNumApples = 500u;
+  constexpr size_t kNumBananas = 700u;
+  std::vector<double> apples(kNumApples);
+  std::vector<double> bananas(kNumBananas);
+  for (size_t apple_idx = 0u; apple_idx < kNumApples; ++apple_idx) {
+    apples[apple_idx] = std::fmod(apple_idx * 0.37, 11.0);
+  }
+  for (size_t banana_idx = 0u; banana_idx < kNumBananas; ++banana_idx) {
+    bananas[banana_idx] = std::fmod(banana_idx * 0.53, 13.0);
+  }
+
+  SimpleMatchProblem mp;
+  mp.setApples(apples.begin(), apples.end());
+  mp.setBananas(bananas.begin(), bananas.end());
+
+  MatchingEngineType serial_engine;
+  SimpleMatchProblem::MatchesWithScore serial_matches;
+  ASSERT_TRUE(serial_engine.match(&mp, &serial_matches));
+  ASSERT_FALSE(serial_matches.empty());
+
+  for (size_t num_threads : {2u, 4u, 7u}) {
+    MatchingEngineType parallel_engine(num_threads);
+    SimpleMatchProblem::MatchesWithScore parallel_matches;
+    ASSERT_TRUE(parallel_engine.match(&mp, &parallel_matches));
+    ASSERT_EQ(serial_matches.size(), parallel_matches.size());
+    EXPECT_TRUE(serial_matches == parallel_matches) << "Threads: " << num_threads;
+    // The reused candidate buffers give the same result.
+    ASSERT_TRUE(parallel_engine.match(&mp, &parallel_matches));
+    EXPECT_TRUE(serial_matches == parallel_matches) << "Threads: " << num_threads;
+  }
+}
+
+TEST(TestMatcher, FlatCandidatesList) {
+  MatchingProblem::Candidates candidates_banana_0;
+  candidates_banana_0.emplace_back(3, 0, 1.0, 0);
+  candidates_banana_0.emplace_back(1, 0, 0.5, 0);
+  MatchingProblem::Candidates candidates_banana_2;
+  candidates_banana_2.emplace_back(2, 2, 0.7, 1);
+
+  // Serial fill.
+  MatchingProblem::FlatCandidatesList appended;
+  appended.appendBanana(candidates_banana_0);
+  appended.appendBanana(MatchingProblem::Candidates());
+  appended.appendBanana(candidates_banana_2);
+
+  // Count-then-fill, reusing the memory of a previous fill.
+  MatchingProblem::FlatCandidatesList counted;
+  counted.appendBanana(candidates_banana_0);
+  counted.resetCounts(3u);
+  counted.setNumCandidates(2u, candidates_banana_2.size());
+  counted.setNumCandidates(0u, candidates_banana_0.size());
+  counted.allocateFromCounts();
+  std::copy(candidates_banana_2.begin(), candidates_banana_2.end(), counted.begin(2u));
+  std::copy(candidates_banana_0.begin(), candidates_banana_0.end(), counted.begin(0u));
+
+  for (const MatchingProblem::FlatCandidatesList* list : {&appended, &counted}) {
+    ASSERT_EQ(3u, list->numBananas());
+    EXPECT_EQ(3u, list->numCandidates());
+    EXPECT_EQ(2u, list->numCandidates(0u));
+    EXPECT_EQ(0u, list->numCandidates(1u));
+    EXPECT_EQ(1u, list->numCandidates(2u));
+    EXPECT_EQ(2u, list->getBeginOffset(2u));
+    EXPECT_EQ(1, list->begin(0u)[1].index_apple);
+    EXPECT_EQ(2, (*list)[2u].index_apple);
+    EXPECT_EQ(2, list->begin(2u)->index_banana);
+  }
+
+  counted.clear();
+  EXPECT_EQ(0u, counted.numBananas());
+  EXPECT_EQ(0u, counted.numCandidates());
+}
+
+TEST(TestMatcherExclusive, ParallelMatchesEqualSerialMatches) {
+  expectParallelMatchesEqualSerialMatches<aslam::MatchingEngineExclusive<SimpleMatchProblem>>();
+}
+
+TEST(TestMatcher, ParallelMatchesEqualSerialMatches) {
+  expectParallelMatchesEqualSerialMatches<aslam::MatchingEngineGreedy<SimpleMatchProblem>>();
+}
+
+TEST(TestMatcherCrossCheck, ParallelMatchesEqualSerialMatches) {
+  expectParallelMatchesEqualSerialMatches<aslam::MatchingEngineCrossCheck<SimpleMatchProblem>>();
+}
+
+template<typename MatchingEngineType>
+void expectCompactMatchesEqualMatchesWithScore() {
+  std::vector<double> apples;
+  std::vector<double> bananas;
+  for (int i = 0; i < 50; ++i) {
+    apples.push_back(std::fmod(i * 0.37, 5.0));
+    bananas.push_back(std::fmod(i * 0.53, 7.0));
+  }
+  SimpleMatchProblem mp;
+  mp.setApples(apples.begin(), apples.end());
+  mp.setBananas(bananas.begin(), bananas.end());
+
+  MatchingEngineType matching_engine;
+  SimpleMatchProblem::MatchesWithScore matches;
+  ASSERT_TRUE(matching_engine.match(&mp, &matches));
+  ASSERT_FALSE(matches.empty());
+  CompactMatchesWithScore compact_matches;
+  ASSERT_TRUE(matching_engine.match(&mp, &compact_matches));
+
+  CompactMatchesWithScore converted_matches;
+  convertMatchesWithScoreToCompactMatches(matches, &converted_matches);
+  EXPECT_TRUE(converted_matches == compact_matches);
+}
+
+TEST(TestMatcherExclusive, CompactMatchesEqualMatchesWithScore) {
+  expectCompactMatchesEqualMatchesWithScore<aslam::MatchingEngineExclusive<SimpleMatchProblem>>();
+}
+
+TEST(TestMatcherCrossCheck, CompactMatchesEqualMatchesWithScore) {
+  expectCompactMatchesEqualMatchesWithScore<
+      aslam::MatchingEngineCrossCheck<SimpleMatchProblem>>();
+}
+
+TEST(TestMatcher, CompactMatchesConversions) {
+  CompactMatchesWithScore compact_matches;
+  EXPECT_TRUE(compact_matches.empty());
+  compact_matches.emplace_back(3, 1, 0.5);
+  compact_matches.emplace_back(0, 2, -1.25);
+  ASSERT_EQ(2u, compact_matches.size());
+  EXPECT_EQ(3u, compact_matches.getIndexApple(0u));
+  EXPECT_EQ(2u, compact_matches.getIndexBanana(1u));
+  EXPECT_FLOAT_EQ(-1.25f, compact_matches.getScore(1u));
+  EXPECT_GE(compact_matches.getMemoryUsageBytes(), 2u * 12u);
+
+  // The views alias the arrays.
+  const CompactMatchesWithScore::IndexView indices_apple = compact_matches.getIndicesAppleView();
+  ASSERT_EQ(2, indices_apple.size());
+  EXPECT_EQ(compact_matches.getIndicesApple().data(), indices_apple.data());
+  EXPECT_EQ(0u, indices_apple(1));
+  EXPECT_EQ(1u, compact_matches.getIndicesBananaView()(0));
+  EXPECT_FLOAT_EQ(0.5f, compact_matches.getScoresView()(0));
+
+  FrameToFrameMatchesWithScore matches_with_score;
+  convertCompactMatchesToMatchesWithScore(compact_matches, &matches_with_score);
+  ASSERT_EQ(2u, matches_with_score.size());
+  EXPECT_EQ(3, matches_with_score[0].getKeypointIndexAppleFrame());
+  EXPECT_EQ(1, matches_with_score[0].getKeypointIndexBananaFrame());
+  EXPECT_DOUBLE_EQ(-1.25, matches_with_score[1].getScore());
+
+  CompactMatchesWithScore round_trip_matches;
+  convertMatchesWithScoreToCompactMatches(matches_with_score, &round_trip_matches);
+  EXPECT_TRUE(round_trip_matches == compact_matches);
+
+  FrameToFrameMatches matches;
+  convertCompactMatchesToMatches(compact_matches, &matches);
+  ASSERT_EQ(2u, matches.size());
+  EXPECT_EQ(0u, matches[1].getKeypointIndexAppleFrame());
+  EXPECT_EQ(2u, matches[1].getKeypointIndexBananaFrame());
+
+  OpenCvMatches opencv_matches;
+  convertCompactMatchesToOpenCvMatches(compact_matches, &opencv_matches);
+  ASSERT_EQ(2u, opencv_matches.size());
+  EXPECT_EQ(3, opencv_matches[0].queryIdx);
+  EXPECT_EQ(1, opencv_matches[0].trainIdx);
+  EXPECT_FLOAT_EQ(0.5f, opencv_matches[0].distance);
+
+  compact_matches.clear();
+  EXPECT_TRUE(compact_matches.empty());
+}
+
 }  // namespace aslam
 
 ASLAM_UNITTEST_ENTRYPOINT
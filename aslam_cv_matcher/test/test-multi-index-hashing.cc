@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/aligned-descriptors.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/hamming.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/matching-engine-exclusive.h>
+#include <aslam/matcher/matching-problem-frame-to-index.h>
+#include <aslam/matcher/multi-index-hashing.h>
+
+namespace aslam {
+namespace {
+constexpr size_t kDescriptorSizeBytes = 64u;
+constexpr size_t kNumSubstrings = 32u;
+constexpr int kNumDescriptors = 2000;
+constexpr int kNumQueries = 100;
+constexpr size_t kNumNeighbors = 5u;
+
+typedef MultiIndexHashingDescriptorIndex::Neighbor Neighbor;
+typedef MultiIndexHashingDescriptorIndex::DescriptorsT DescriptorsT;
+
+DescriptorsT createRandomDescriptors(int num_descriptors) {
+  DescriptorsT descriptors(kDescriptorSizeBytes, num_descriptors);
+  for (int i = 0; i < descriptors.size(); ++i) {
+    descriptors(i) = static_cast<unsigned char>(rand() % 256);
+  }
+  return descriptors;
+}
+
+/// Copies of some of the descriptors with up to max_flipped_bits random bit flips.
+DescriptorsT createQueries(const DescriptorsT& descriptors, int max_flipped_bits) {
+  DescriptorsT queries(descriptors.rows(), kNumQueries);
+  for (int query_idx = 0; query_idx < kNumQueries; ++query_idx) {
+    queries.col(query_idx) = descriptors.col(rand() % descriptors.cols());
+    const int num_flipped_bits = rand() % (max_flipped_bits + 1);
+    for (int flip = 0; flip < num_flipped_bits; ++flip) {
+      const int bit = rand() % (kDescriptorSizeBytes * 8u);
+      queries(bit / 8, query_idx) ^= static_cast<unsigned char>(1u << (bit % 8));
+    }
+  }
+  return queries;
+}
+
+std::vector<Neighbor> bruteForceKnn(
+    const common::AlignedDescriptors& descriptors, const std::vector<bool>& removed,
+    const unsigned char* query, size_t k, int max_distance) {
+  std::vector<Neighbor> neighbors;
+  for (size_t id = 0u; id < descriptors.size(); ++id) {
+    if (removed[id]) {
+      continue;
+    }
+    const int distance = common::Hamming::evaluate(
+        query, descriptors.getDescriptor(id), descriptors.getStrideBytes());
+    if (distance <= max_distance) {
+      neighbors.emplace_back(static_cast<int>(id), distance);
+    }
+  }
+  std::sort(neighbors.begin(), neighbors.end(), [](const Neighbor& lhs, const Neighbor& rhs) {
+    return lhs.distance < rhs.distance || (lhs.distance == rhs.distance && lhs.id < rhs.id);
+  });
+  if (neighbors.size() > k) {
+    neighbors.resize(k);
+  }
+  return neighbors;
+}
+
+void expectSameNeighbors(const std::vector<Neighbor>& expected,
+                         const std::vector<Neighbor>& actual) {
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0u; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].id, actual[i].id);
+    EXPECT_EQ(expected[i].distance, actual[i].distance);
+  }
+}
+}  // namespace
+
+class MultiIndexHashingTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    srand(42);
+    descriptors_ = createRandomDescriptors(kNumDescriptors);
+    aligned_descriptors_.setDescriptors(descriptors_);
+    removed_.assign(kNumDescriptors, false);
+    index_.reset(new MultiIndexHashingDescriptorIndex(kDescriptorSizeBytes, kNumSubstrings));
+    // Two batches, the ids continue over batches.
+    const int num_first_batch = kNumDescriptors / 2;
+    EXPECT_EQ(0, index_->insert(descriptors_.leftCols(num_first_batch)));
+    EXPECT_EQ(num_first_batch,
+              index_->insert(descriptors_.rightCols(kNumDescriptors - num_first_batch)));
+    EXPECT_EQ(static_cast<size_t>(kNumDescriptors), index_->size());
+  }
+
+  void expectMatchesBruteForce(const DescriptorsT& queries, int max_distance) {
+    const common::AlignedDescriptors aligned_queries(queries);
+    std::vector<Neighbor> neighbors;
+    for (size_t query_idx = 0u; query_idx < aligned_queries.size(); ++query_idx) {
+      const unsigned char* query = aligned_queries.getDescriptor(query_idx);
+      index_->knnSearch(query, kNumNeighbors, max_distance, &neighbors);
+      expectSameNeighbors(
+          bruteForceKnn(aligned_descriptors_, removed_, query, kNumNeighbors, max_distance),
+          neighbors);
+    }
+  }
+
+  DescriptorsT descriptors_;
+  common::AlignedDescriptors aligned_descriptors_;
+  std::vector<bool> removed_;
+  MultiIndexHashingDescriptorIndex::UniquePtr index_;
+};
+
+TEST_F(MultiIndexHashingTest, KnnSearchMatchesBruteForce) {
+  expectMatchesBruteForce(createQueries(descriptors_, 40), 63);
+  expectMatchesBruteForce(createQueries(descriptors_, 80), 100);
+  // Unrelated descriptors are about 256 bits away and mostly have no neighbor in the radius.
+  expectMatchesBruteForce(createRandomDescriptors(kNumQueries), 100);
+}
+
+TEST_F(MultiIndexHashingTest, RemovedDescriptorsAreNotFound) {
+  std::vector<int> removed_ids;
+  for (int id = 0; id < kNumDescriptors; id += 3) {
+    removed_ids.push_back(id);
+    removed_[id] = true;
+  }
+  index_->remove(removed_ids);
+  EXPECT_EQ(static_cast<size_t>(kNumDescriptors) - removed_ids.size(), index_->size());
+  EXPECT_EQ(static_cast<size_t>(kNumDescriptors), index_->getIdEnd());
+  EXPECT_FALSE(index_->isValidId(0));
+  EXPECT_TRUE(index_->isValidId(1));
+
+  expectMatchesBruteForce(createQueries(descriptors_, 40), 63);
+
+  // Removing twice is a no-op.
+  index_->remove(removed_ids);
+  EXPECT_EQ(static_cast<size_t>(kNumDescriptors) - removed_ids.size(), index_->size());
+}
+
+TEST_F(MultiIndexHashingTest, ConcurrentQueries) {
+  const common::AlignedDescriptors aligned_queries(createQueries(descriptors_, 40));
+  std::vector<std::vector<Neighbor>> expected_neighbors(aligned_queries.size());
+  for (size_t query_idx = 0u; query_idx < aligned_queries.size(); ++query_idx) {
+    index_->knnSearch(aligned_queries.getDescriptor(query_idx), kNumNeighbors, 63,
+                      &expected_neighbors[query_idx]);
+  }
+
+  constexpr size_t kNumThreads = 4u;
+  std::vector<std::vector<std::vector<Neighbor>>> thread_neighbors(kNumThreads);
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&, thread_idx]() {
+      std::vector<std::vector<Neighbor>>& neighbors = thread_neighbors[thread_idx];
+      neighbors.resize(aligned_queries.size());
+      for (size_t query_idx = 0u; query_idx < aligned_queries.size(); ++query_idx) {
+        index_->knnSearch(aligned_queries.getDescriptor(query_idx), kNumNeighbors, 63,
+                          &neighbors[query_idx]);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    for (size_t query_idx = 0u; query_idx < aligned_queries.size(); ++query_idx) {
+      expectSameNeighbors(expected_neighbors[query_idx], thread_neighbors[thread_idx][query_idx]);
+    }
+  }
+}
+
+TEST_F(MultiIndexHashingTest, MatchFrameAgainstIndex) {
+  constexpr int kNumKeypoints = 10;
+  PinholeCamera::Ptr camera = PinholeCamera::createTestCamera();
+  VisualFrame::Ptr frame = VisualFrame::createEmptyTestVisualFrame(camera, 0);
+  frame->setKeypointMeasurements(Eigen::Matrix2Xd::Ones(2, kNumKeypoints));
+  // Keypoint i observes the descriptor with id 7 * i.
+  DescriptorsT frame_descriptors(kDescriptorSizeBytes, kNumKeypoints);
+  for (int keypoint_idx = 0; keypoint_idx < kNumKeypoints; ++keypoint_idx) {
+    frame_descriptors.col(keypoint_idx) = descriptors_.col(7 * keypoint_idx);
+  }
+  frame->setDescriptors(frame_descriptors);
+
+  MatchingProblemFrameToIndex matching_problem(*frame, *index_, kNumNeighbors, 60);
+  MatchingEngineExclusive<MatchingProblemFrameToIndex> matching_engine;
+  MatchingProblemFrameToIndex::MatchesWithScore matches;
+  matching_engine.match(&matching_problem, &matches);
+
+  ASSERT_EQ(static_cast<size_t>(kNumKeypoints), matches.size());
+  for (const MatchingProblemFrameToIndex::MatchWithScore& match : matches) {
+    EXPECT_EQ(7 * match.getKeypointIndex(), match.getDescriptorId());
+    EXPECT_DOUBLE_EQ(1.0, match.getScore());
+  }
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/match.h>
+#include <aslam/matcher/matching-engine-exclusive.h>
+#include <aslam/matcher/matching-problem-frame-to-frame.h>
+#include <aslam/matcher/sliding-window-matcher.h>
+
+namespace aslam {
+namespace {
+constexpr int kNumKeypoints = 300;
+constexpr int kDescriptorSizeBytes = 48;
+constexpr double kImageSpaceDistanceThreshold = 15.0;
+constexpr int kHammingDistanceThreshold = 60;
+
+/// A frame with keypoints and descriptors that are perturbed copies of the base frame content.
+VisualFrame::Ptr createFrame(const Camera::ConstPtr& camera, const Eigen::Matrix2Xd& keypoints,
+                             const VisualFrame::DescriptorsT& descriptors, int64_t timestamp) {
+  VisualFrame::Ptr frame = VisualFrame::createEmptyTestVisualFrame(camera, timestamp);
+  Eigen::Matrix2Xd noisy_keypoints =
+      keypoints + 2.0 * Eigen::Matrix2Xd::Random(2, keypoints.cols());
+  noisy_keypoints = noisy_keypoints.cwiseMax(0.0);
+  noisy_keypoints.row(0) = noisy_keypoints.row(0).cwiseMin(camera->imageWidth() - 1.0);
+  noisy_keypoints.row(1) = noisy_keypoints.row(1).cwiseMin(camera->imageHeight() - 1.0);
+  frame->setKeypointMeasurements(noisy_keypoints);
+  VisualFrame::DescriptorsT noisy_descriptors = descriptors;
+  for (int col = 0; col < descriptors.cols(); ++col) {
+    for (int flip_idx = 0; flip_idx < 20; ++flip_idx) {
+      const int bit = rand() % (static_cast<int>(descriptors.rows()) * 8);
+      noisy_descriptors(bit / 8, col) ^= static_cast<unsigned char>(1u << (bit % 8));
+    }
+  }
+  frame->setDescriptors(noisy_descriptors);
+  return frame;
+}
+}  // namespace
+
+class SlidingWindowMatcherTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    srand(7);
+    camera_ = PinholeCamera::createTestCamera();
+    keypoints_ = 0.5 * (Eigen::Matrix2Xd::Random(2, kNumKeypoints).array() + 1.0);
+    keypoints_.row(0) *= camera_->imageWidth() - 1.0;
+    keypoints_.row(1) *= camera_->imageHeight() - 1.0;
+    descriptors_.resize(kDescriptorSizeBytes, kNumKeypoints);
+    for (int i = 0; i < descriptors_.size(); ++i) {
+      descriptors_(i) = static_cast<unsigned char>(rand() % 256);
+    }
+  }
+
+  /// Check the matches against a MatchingProblemFrameToFrame solved with the exclusive engine.
+  void expectSameAsFrameToFrame(
+      const VisualFrame& apple_frame, const VisualFrame& banana_frame, const Quaternion& q_A_B,
+      const SlidingWindowMatcher::MatchesWithScore& matches) {
+    MatchingProblemFrameToFrame matching_problem(
+        apple_frame, banana_frame, q_A_B, kImageSpaceDistanceThreshold,
+        kHammingDistanceThreshold);
+    MatchingEngineExclusive<MatchingProblemFrameToFrame> matching_engine;
+    MatchingProblemFrameToFrame::MatchesWithScore expected_matches;
+    matching_engine.match(&matching_problem, &expected_matches);
+
+    EXPECT_GT(expected_matches.size(), kNumKeypoints / 2u);
+    ASSERT_EQ(expected_matches.size(), matches.size());
+    for (size_t match_idx = 0u; match_idx < matches.size(); ++match_idx) {
+      EXPECT_EQ(expected_matches[match_idx].getKeypointIndexAppleFrame(),
+                matches[match_idx].getKeypointIndexAppleFrame());
+      EXPECT_EQ(expected_matches[match_idx].getKeypointIndexBananaFrame(),
+                matches[match_idx].getKeypointIndexBananaFrame());
+      EXPECT_DOUBLE_EQ(expected_matches[match_idx].getScore(), matches[match_idx].getScore());
+    }
+  }
+
+  Camera::Ptr camera_;
+  Eigen::Matrix2Xd keypoints_;
+  VisualFrame::DescriptorsT descriptors_;
+};
+
+TEST_F(SlidingWindowMatcherTest, MatchAgainstWindow) {
+  constexpr size_t kWindowSize = 3u;
+  SlidingWindowMatcher matcher(kWindowSize, kImageSpaceDistanceThreshold,
+                               kHammingDistanceThreshold, 2u);
+  EXPECT_EQ(kWindowSize, matcher.getMaxNumFrames());
+
+  std::vector<VisualFrame::Ptr> frames;
+  for (size_t frame_idx = 0u; frame_idx < kWindowSize + 1u; ++frame_idx) {
+    frames.push_back(createFrame(camera_, keypoints_, descriptors_, frame_idx));
+    matcher.addFrame(frames.back());
+    EXPECT_EQ(std::min(frame_idx + 1u, kWindowSize), matcher.numFrames());
+  }
+  // The first frame left the window.
+  for (size_t window_idx = 0u; window_idx < kWindowSize; ++window_idx) {
+    EXPECT_EQ(frames[window_idx + 1u].get(), &matcher.getFrame(window_idx));
+  }
+
+  VisualFrame::Ptr banana_frame =
+      createFrame(camera_, keypoints_, descriptors_, kWindowSize + 1u);
+  Aligned<std::vector, Quaternion> q_Ai_B(kWindowSize);
+  for (Quaternion& q_A_B : q_Ai_B) {
+    q_A_B.setIdentity();
+  }
+  SlidingWindowMatcher::MatchesWithScoreList matches_per_frame;
+  matcher.match(*banana_frame, q_Ai_B, &matches_per_frame);
+  ASSERT_EQ(kWindowSize, matches_per_frame.size());
+  for (size_t window_idx = 0u; window_idx < kWindowSize; ++window_idx) {
+    expectSameAsFrameToFrame(matcher.getFrame(window_idx), *banana_frame, q_Ai_B[window_idx],
+                             matches_per_frame[window_idx]);
+  }
+
+  // Frames leave in insertion order.
+  matcher.removeOldestFrame();
+  ASSERT_EQ(kWindowSize - 1u, matcher.numFrames());
+  EXPECT_EQ(frames[2].get(), &matcher.getFrame(0u));
+  q_Ai_B.resize(kWindowSize - 1u);
+  matcher.match(*banana_frame, q_Ai_B, &matches_per_frame);
+  ASSERT_EQ(kWindowSize - 1u, matches_per_frame.size());
+  expectSameAsFrameToFrame(*frames[2], *banana_frame, q_Ai_B[0], matches_per_frame[0]);
+
+  matcher.clear();
+  EXPECT_EQ(0u, matcher.numFrames());
+}
+
+TEST_F(SlidingWindowMatcherTest, MatchRotated) {
+  SlidingWindowMatcher matcher(2u, kImageSpaceDistanceThreshold, kHammingDistanceThreshold);
+  VisualFrame::Ptr apple_frame = createFrame(camera_, keypoints_, descriptors_, 0);
+  matcher.addFrame(apple_frame);
+
+  // The banana frame observes the keypoints of the apple frame through a rotated camera.
+  const Quaternion q_A_B(Eigen::Vector3d(0.0, 0.05, 0.0));
+  Eigen::Matrix2Xd banana_keypoints(2, kNumKeypoints);
+  for (int keypoint_idx = 0; keypoint_idx < kNumKeypoints; ++keypoint_idx) {
+    Eigen::Vector3d A_ray;
+    ASSERT_TRUE(camera_->backProject3(keypoints_.col(keypoint_idx), &A_ray));
+    Eigen::Vector2d keypoint;
+    camera_->project3(q_A_B.inverse().rotate(A_ray), &keypoint);
+    banana_keypoints.col(keypoint_idx) = keypoint;
+  }
+  VisualFrame::Ptr banana_frame = createFrame(camera_, banana_keypoints, descriptors_, 1);
+  Aligned<std::vector, Quaternion> q_Ai_B(1u, q_A_B);
+  SlidingWindowMatcher::MatchesWithScoreList matches_per_frame;
+  matcher.match(*banana_frame, q_Ai_B, &matches_per_frame);
+  ASSERT_EQ(1u, matches_per_frame.size());
+  expectSameAsFrameToFrame(*apple_frame, *banana_frame, q_A_B, matches_per_frame[0]);
+}
+
+TEST_F(SlidingWindowMatcherTest, ScoresFollowTheDescriptorSize) {
+  // BRIEF sized descriptors, the score is relative to their 256 bits.
+  constexpr int kShortDescriptorSizeBytes = 32;
+  const VisualFrame::DescriptorsT short_descriptors =
+      descriptors_.topRows(kShortDescriptorSizeBytes);
+  SlidingWindowMatcher matcher(1u, kImageSpaceDistanceThreshold, kHammingDistanceThreshold);
+  VisualFrame::Ptr apple_frame = createFrame(camera_, keypoints_, short_descriptors, 0);
+  matcher.addFrame(apple_frame);
+  VisualFrame::Ptr banana_frame = createFrame(camera_, keypoints_, short_descriptors, 1);
+  Quaternion q_A_B;
+  q_A_B.setIdentity();
+  const Aligned<std::vector, Quaternion> q_Ai_B(1u, q_A_B);
+  SlidingWindowMatcher::MatchesWithScoreList matches_per_frame;
+  matcher.match(*banana_frame, q_Ai_B, &matches_per_frame);
+  ASSERT_EQ(1u, matches_per_frame.size());
+  expectSameAsFrameToFrame(*apple_frame, *banana_frame, q_A_B, matches_per_frame[0]);
+  for (const FrameToFrameMatchWithScore& match : matches_per_frame[0]) {
+    EXPECT_GT(match.getScore(), 1.0 - static_cast<double>(kHammingDistanceThreshold) /
+        (8.0 * kShortDescriptorSizeBytes));
+  }
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
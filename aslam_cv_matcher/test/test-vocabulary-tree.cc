@@ -0,0 +1,180 @@
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/matcher/inverted-index.h>
+#include <aslam/matcher/vocabulary-tree.h>
+
+namespace aslam {
+namespace {
+constexpr size_t kDescriptorSizeBytes = 32u;
+constexpr int kNumPlaces = 20;
+constexpr int kNumDescriptorsPerPlace = 50;
+constexpr int kNumFlippedBits = 3;
+
+typedef BinaryVocabularyTree::DescriptorsT DescriptorsT;
+typedef BinaryVocabularyTree::WordId WordId;
+
+class VocabularyTreeTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    random_engine_.seed(42u);
+    for (int place_idx = 0; place_idx < kNumPlaces; ++place_idx) {
+      places_.push_back(createRandomDescriptors(kNumDescriptorsPerPlace));
+    }
+    BinaryVocabularyTree::TrainingOptions options;
+    options.branching_factor = 8u;
+    options.depth = 3u;
+    options.num_threads = 2u;
+    vocabulary_.train(places_, options);
+    path_ = "/tmp/test-vocabulary-tree-" + std::to_string(::getpid()) + "-" +
+        ::testing::UnitTest::GetInstance()->current_test_info()->name();
+  }
+
+  virtual void TearDown() {
+    std::remove(path_.c_str());
+  }
+
+  DescriptorsT createRandomDescriptors(int num_descriptors) {
+    std::uniform_int_distribution<int> byte_distribution(0, 255);
+    DescriptorsT descriptors(kDescriptorSizeBytes, num_descriptors);
+    for (int i = 0; i < descriptors.size(); ++i) {
+      descriptors(i) = static_cast<unsigned char>(byte_distribution(random_engine_));
+    }
+    return descriptors;
+  }
+
+  DescriptorsT flipRandomBits(const DescriptorsT& descriptors) {
+    std::uniform_int_distribution<int> bit_distribution(
+        0, static_cast<int>(kDescriptorSizeBytes * 8u) - 1);
+    DescriptorsT noisy_descriptors = descriptors;
+    for (int col = 0; col < descriptors.cols(); ++col) {
+      for (int flip_idx = 0; flip_idx < kNumFlippedBits; ++flip_idx) {
+        const int bit = bit_distribution(random_engine_);
+        noisy_descriptors(bit / 8, col) ^= static_cast<unsigned char>(1u << (bit % 8));
+      }
+    }
+    return noisy_descriptors;
+  }
+
+  std::mt19937 random_engine_;
+  std::vector<DescriptorsT> places_;
+  BinaryVocabularyTree vocabulary_;
+  std::string path_;
+};
+}  // namespace
+
+TEST_F(VocabularyTreeTest, Train) {
+  ASSERT_FALSE(vocabulary_.empty());
+  EXPECT_FALSE(vocabulary_.isMapped());
+  EXPECT_EQ(kDescriptorSizeBytes, vocabulary_.getDescriptorSizeBytes());
+  EXPECT_GT(vocabulary_.numWords(), 8u);
+  EXPECT_LE(vocabulary_.numWords(), 8u * 8u * 8u);
+  EXPECT_GT(vocabulary_.numNodes(), vocabulary_.numWords());
+
+  for (const DescriptorsT& place : places_) {
+    std::vector<WordId> words;
+    vocabulary_.quantize(place, &words);
+    ASSERT_EQ(static_cast<size_t>(kNumDescriptorsPerPlace), words.size());
+    for (const WordId word_id : words) {
+      ASSERT_LT(word_id, vocabulary_.numWords());
+    }
+  }
+  // A word of a single training image has the largest weight.
+  for (size_t word_id = 0u; word_id < vocabulary_.numWords(); ++word_id) {
+    EXPECT_GE(vocabulary_.getWordWeight(word_id), 0.0f);
+    EXPECT_LE(vocabulary_.getWordWeight(word_id), std::log(static_cast<float>(kNumPlaces)));
+  }
+}
+
+TEST_F(VocabularyTreeTest, SaveAndMap) {
+  ASSERT_TRUE(vocabulary_.save(path_));
+  BinaryVocabularyTree mapped_vocabulary;
+  ASSERT_TRUE(mapped_vocabulary.load(path_));
+  EXPECT_TRUE(mapped_vocabulary.isMapped());
+  EXPECT_EQ(vocabulary_.numWords(), mapped_vocabulary.numWords());
+  EXPECT_EQ(vocabulary_.numNodes(), mapped_vocabulary.numNodes());
+  EXPECT_EQ(vocabulary_.getBranchingFactor(), mapped_vocabulary.getBranchingFactor());
+  EXPECT_EQ(vocabulary_.getDepth(), mapped_vocabulary.getDepth());
+
+  const DescriptorsT queries = createRandomDescriptors(500);
+  std::vector<WordId> words, mapped_words;
+  vocabulary_.quantize(queries, &words);
+  mapped_vocabulary.quantize(queries, &mapped_words);
+  EXPECT_EQ(words, mapped_words);
+  for (size_t word_id = 0u; word_id < vocabulary_.numWords(); ++word_id) {
+    EXPECT_EQ(vocabulary_.getWordWeight(word_id), mapped_vocabulary.getWordWeight(word_id));
+  }
+}
+
+TEST_F(VocabularyTreeTest, RejectCorruptFiles) {
+  BinaryVocabularyTree mapped_vocabulary;
+  EXPECT_FALSE(mapped_vocabulary.load(path_ + "-missing"));
+  {
+    std::ofstream file(path_, std::ios::binary | std::ios::trunc);
+    file << "not a vocabulary, but long enough to hold a vocabulary header of 64 bytes......";
+  }
+  EXPECT_FALSE(mapped_vocabulary.load(path_));
+  EXPECT_TRUE(mapped_vocabulary.empty());
+  EXPECT_FALSE(mapped_vocabulary.isMapped());
+
+  // Truncate the node descriptors.
+  ASSERT_TRUE(vocabulary_.save(path_));
+  ASSERT_EQ(0, ::truncate(path_.c_str(), 200));
+  EXPECT_FALSE(mapped_vocabulary.load(path_));
+}
+
+TEST_F(VocabularyTreeTest, RecognizePlaces) {
+  InvertedIndex index(vocabulary_);
+  for (int place_idx = 0; place_idx < kNumPlaces; ++place_idx) {
+    EXPECT_EQ(static_cast<InvertedIndex::DocumentId>(place_idx),
+              index.addDocument(places_[place_idx]));
+  }
+  EXPECT_EQ(static_cast<size_t>(kNumPlaces), index.numDocuments());
+
+  std::vector<DescriptorsT> queries;
+  for (const DescriptorsT& place : places_) {
+    queries.push_back(flipRandomBits(place));
+  }
+  constexpr size_t kMaxNumResults = 5u;
+  std::vector<InvertedIndex::QueryResults> batch_results;
+  index.queryBatch(queries, kMaxNumResults, 4u, &batch_results);
+  ASSERT_EQ(queries.size(), batch_results.size());
+  for (int place_idx = 0; place_idx < kNumPlaces; ++place_idx) {
+    InvertedIndex::QueryResults results;
+    index.query(queries[place_idx], kMaxNumResults, &results);
+    ASSERT_FALSE(results.empty());
+    EXPECT_LE(results.size(), kMaxNumResults);
+    EXPECT_EQ(static_cast<InvertedIndex::DocumentId>(place_idx), results.front().document_id);
+    EXPECT_LE(results.front().score, 1.0 + 1e-6);
+    for (size_t result_idx = 1u; result_idx < results.size(); ++result_idx) {
+      EXPECT_GE(results[result_idx - 1u].score, results[result_idx].score);
+    }
+
+    ASSERT_EQ(results.size(), batch_results[place_idx].size());
+    for (size_t result_idx = 0u; result_idx < results.size(); ++result_idx) {
+      EXPECT_EQ(results[result_idx].document_id,
+                batch_results[place_idx][result_idx].document_id);
+      EXPECT_EQ(results[result_idx].score, batch_results[place_idx][result_idx].score);
+    }
+  }
+
+  // A document scores 1 against itself.
+  InvertedIndex::QueryResults results;
+  index.query(places_.front(), 1u, &results);
+  ASSERT_EQ(1u, results.size());
+  EXPECT_EQ(0u, results.front().document_id);
+  EXPECT_NEAR(1.0, results.front().score, 1e-5);
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
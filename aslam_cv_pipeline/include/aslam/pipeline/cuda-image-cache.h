@@ -0,0 +1,57 @@
+#ifndef ASLAM_PIPELINE_CUDA_IMAGE_CACHE_H_
+#define ASLAM_PIPELINE_CUDA_IMAGE_CACHE_H_
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/cuda.hpp>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/unique-id.h>
+
+namespace aslam {
+
+/// \brief True if the libraries were built with ASLAM_CV_WITH_CUDA and a CUDA device is present.
+///        All CUDA code paths fall back to the CPU implementation otherwise.
+bool isCudaBackendAvailable();
+
+/// \class CudaImageCache
+/// \brief Keeps the device copies of the most recent frame images, such that the images
+///        uploaded by the pipeline stay resident on the device for the tracker stage.
+///
+/// The images are keyed by the frame id. cv::cuda::GpuMat is reference counted, hence an image
+/// returned by find() stays valid after it has been evicted. Thread-safe.
+class CudaImageCache {
+ public:
+  ASLAM_POINTER_TYPEDEFS(CudaImageCache);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(CudaImageCache);
+
+  /// @param[in] capacity Number of images to keep, the oldest image is evicted first.
+  explicit CudaImageCache(size_t capacity);
+
+  /// Add the device image of a frame, replacing an existing entry of the same frame.
+  void insert(const FrameId& frame_id, const cv::cuda::GpuMat& device_image);
+
+  /// @return False if there is no device image of this frame.
+  bool find(const FrameId& frame_id, cv::cuda::GpuMat* device_image) const;
+
+  void clear();
+  size_t size() const;
+  size_t capacity() const { return capacity_; }
+  /// Device memory of the cached images, including the row padding.
+  size_t getDeviceMemoryUsageBytes() const;
+
+ private:
+  typedef std::pair<FrameId, cv::cuda::GpuMat> Entry;
+
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  std::deque<Entry> entries_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_PIPELINE_CUDA_IMAGE_CACHE_H_
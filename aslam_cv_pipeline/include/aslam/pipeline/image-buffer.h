@@ -0,0 +1,31 @@
+#ifndef ASLAM_PIPELINE_IMAGE_BUFFER_H_
+#define ASLAM_PIPELINE_IMAGE_BUFFER_H_
+
+#include <cstddef>
+#include <functional>
+
+#include <opencv2/core/core.hpp>
+
+namespace aslam {
+
+/// Called with the buffer pointer once the last cv::Mat referencing the buffer is released.
+typedef std::function<void(void*)> ImageBufferDeleter;
+
+/// \brief Wrap an externally allocated image buffer, e.g. a camera driver DMA buffer, into a
+///        reference counted cv::Mat without copying the pixels.
+///
+/// The returned cv::Mat and all copies of it share ownership of the buffer. The deleter is
+/// called exactly once after the last reference is gone, from the thread that releases it.
+/// @param[in] rows    Image height in pixels.
+/// @param[in] cols    Image width in pixels.
+/// @param[in] type    OpenCV type of the pixels, e.g. CV_8UC1.
+/// @param[in] data    Pointer to the first pixel.
+/// @param[in] step    Number of bytes per image row, cv::Mat::AUTO_STEP for continuous buffers.
+/// @param[in] deleter Releases the buffer.
+/// @return A cv::Mat owning the buffer.
+cv::Mat wrapImageBuffer(int rows, int cols, int type, void* data, size_t step,
+                        const ImageBufferDeleter& deleter);
+
+}  // namespace aslam
+
+#endif  // ASLAM_PIPELINE_IMAGE_BUFFER_H_
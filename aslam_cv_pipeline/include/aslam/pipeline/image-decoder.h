@@ -0,0 +1,65 @@
+#ifndef ASLAM_PIPELINE_IMAGE_DECODER_H_
+#define ASLAM_PIPELINE_IMAGE_DECODER_H_
+
+#include <aslam/common/macros.h>
+#include <opencv2/core/core.hpp>
+
+namespace aslam {
+
+/// \class ImageDecoder
+/// \brief Decodes the compressed images of VisualNPipeline::processCompressedImage(), e.g. the
+///        JPEG frames of a camera driver.
+///
+/// The decoders can wrap hardware or vendor decoders. The images of a camera are decoded on the
+/// workers of the pipeline, in the kSharedPool scheduling mode concurrently and in any order,
+/// hence stateful decoders, e.g. of video streams, need the kPerCameraWorker mode.
+class ImageDecoder {
+ public:
+  ASLAM_POINTER_TYPEDEFS(ImageDecoder);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(ImageDecoder);
+
+  ImageDecoder() = default;
+  virtual ~ImageDecoder() {}
+
+  /// \brief Decode an image.
+  ///
+  /// @param[in]  data  The encoded image as a continuous CV_8UC1 row, see wrapImageBuffer() to
+  ///                   pass driver buffers without a copy.
+  /// @param[out] image A recycled image of an earlier call, or empty. Decoding into its pixels
+  ///                   avoids an allocation if the size and type are unchanged.
+  /// @return False if the data could not be decoded.
+  virtual bool decode(const cv::Mat& data, cv::Mat* image) const = 0;
+};
+
+/// \class OpenCvImageDecoder
+/// \brief Decodes all formats of cv::imdecode(), optionally to grayscale and at a reduced
+///        resolution. Thread-safe.
+class OpenCvImageDecoder : public ImageDecoder {
+ public:
+  ASLAM_POINTER_TYPEDEFS(OpenCvImageDecoder);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(OpenCvImageDecoder);
+
+  struct Options {
+    Options() : grayscale(true), scale_denominator(1) {}
+    /// Decode to 8 bit grayscale, otherwise to 8 bit BGR.
+    bool grayscale;
+    /// Decode at 1 / scale_denominator of the encoded resolution, one of 1, 2, 4 and 8. JPEG
+    /// images are scaled within the inverse DCT, which skips most of the decoding work. The
+    /// input camera of the pipeline must have the reduced resolution.
+    int scale_denominator;
+  };
+
+  explicit OpenCvImageDecoder(const Options& options);
+  virtual ~OpenCvImageDecoder() {}
+
+  virtual bool decode(const cv::Mat& data, cv::Mat* image) const;
+
+ private:
+  const Options options_;
+  /// The cv::ImreadModes flags of the options.
+  const int imread_flags_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_PIPELINE_IMAGE_DECODER_H_
@@ -0,0 +1,138 @@
+#ifndef ASLAM_PIPELINE_SHARDED_BATCH_PROCESSOR_H_
+#define ASLAM_PIPELINE_SHARDED_BATCH_PROCESSOR_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/macros.h>
+#include <aslam/frames/visual-nframe.h>
+#include <aslam/pipeline/visual-npipeline.h>
+
+namespace aslam {
+
+/// \brief A time range of a dataset that is processed independently of the other shards.
+///
+/// The shard owns the nframes in [begin, end). Processing starts earlier, at the warm-up begin,
+/// such that stateful consumers like trackers have converged at the begin. The nframe timestamps
+/// are the minimal timestamps of their images, as in the index of the VisualNFrameArchive.
+struct BatchShard {
+  size_t index;
+  int64_t warm_up_begin_timestamp_nanoseconds;
+  int64_t begin_timestamp_nanoseconds;
+  int64_t end_timestamp_nanoseconds;
+
+  bool isOwned(int64_t timestamp_nanoseconds) const {
+    return timestamp_nanoseconds >= begin_timestamp_nanoseconds &&
+        timestamp_nanoseconds < end_timestamp_nanoseconds;
+  }
+};
+
+/// Counts of the owned nframes of a shard or of the merged shards.
+struct BatchShardStatistics {
+  BatchShardStatistics()
+      : num_nframes(0u), num_warm_up_nframes(0u), num_keypoints(0u),
+        num_tracked_keypoints(0u), num_tracks(0u) {}
+  size_t num_nframes;
+  /// The nframes before the begin of the shard, not part of the output. 0 after merging.
+  size_t num_warm_up_nframes;
+  size_t num_keypoints;
+  /// The keypoints with a valid track id.
+  size_t num_tracked_keypoints;
+  /// The number of distinct track ids of all cameras, only counted when merging.
+  size_t num_tracks;
+};
+
+/// \brief Split a dataset into shards of about the same number of nframes.
+///
+/// \param[in] nframe_timestamps The increasing timestamps of all nframes of the dataset.
+/// \param[in] num_shards        The number of shards, fewer if the dataset has fewer nframes.
+/// \param[in] warm_up_duration_nanoseconds How long the shards are processed before their begin.
+std::vector<BatchShard> splitIntoBatchShards(const std::vector<int64_t>& nframe_timestamps,
+                                             size_t num_shards,
+                                             int64_t warm_up_duration_nanoseconds);
+
+/// \class ShardedBatchProcessor
+/// \brief Processes a recorded dataset as shards on many processes or machines and merges
+///        their outputs deterministically.
+///
+/// Every shard runs VisualNPipeline::processBatch() on a fresh pipeline over the images from its
+/// warm-up begin to its end, passes the nframes in order to a fresh nframe processor (e.g. a
+/// tracker assigning track ids) and appends all of them to its own VisualNFrameArchive. The
+/// shards don't share any state, hence a scheduler can start one process per shard with the
+/// shard index, or processShardsLocally() runs them on one machine.
+///
+/// mergeShardArchives() then writes the owned nframes of all shards in timestamp order into one
+/// archive. The track ids of a shard are renumbered to be unique across the shards, and the
+/// tracks that are alive at the end of the warm-up continue the ids of the previous shard: the
+/// pipelines process every image independently, hence the last warm-up nframe of a shard has
+/// the same keypoints as the same nframe of the previous shard. The merged output thus only
+/// depends on the shards, not on the order or the machines they ran on. Tracks longer than the
+/// warm-up can be split at the shard begin. If a camera has a different number of keypoints in
+/// the two shards, e.g. with a nondeterministic detector, its tracks are split at the shard begin
+/// with a warning.
+class ShardedBatchProcessor {
+ public:
+  ASLAM_POINTER_TYPEDEFS(ShardedBatchProcessor);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(ShardedBatchProcessor);
+
+  /// Creates the pipeline of a shard, e.g. from the same configuration for all shards.
+  typedef std::function<VisualNPipeline::Ptr()> PipelineFactory;
+  /// Creates the source of the nframes with timestamps in [begin, end) of the dataset.
+  typedef std::function<VisualNPipeline::BatchImageSource(
+      int64_t begin_timestamp_nanoseconds, int64_t end_timestamp_nanoseconds)> SourceFactory;
+  /// Creates the nframe processor of a shard, called for every nframe in order before it is
+  /// archived. It can modify the nframe, e.g. set the track ids.
+  typedef std::function<VisualNPipeline::NFrameCallback()> NFrameProcessorFactory;
+
+  struct Options {
+    Options() : max_num_lookahead_nframes(8u), max_num_concurrent_shards(1u) {}
+    /// See VisualNPipeline::processBatch().
+    size_t max_num_lookahead_nframes;
+    /// The number of shards processShardsLocally() runs at the same time.
+    size_t max_num_concurrent_shards;
+  };
+
+  /// \param[in] nframe_processor_factory Can be null to archive the nframes as they are.
+  ShardedBatchProcessor(const Options& options, const PipelineFactory& pipeline_factory,
+                        const SourceFactory& source_factory,
+                        const NFrameProcessorFactory& nframe_processor_factory);
+
+  /// \brief Process a shard into an archive, including the warm-up nframes.
+  /// @return False if the archive could not be written.
+  bool processShard(const BatchShard& shard, const std::string& archive_path,
+                    BatchShardStatistics* statistics) const;
+
+  /// \brief Process the shards on this machine, up to max_num_concurrent_shards at a time.
+  /// @return False if any archive could not be written.
+  bool processShardsLocally(const std::vector<BatchShard>& shards,
+                            const std::vector<std::string>& archive_paths,
+                            std::vector<BatchShardStatistics>* statistics) const;
+
+  /// \brief Merge the archives of all shards of a dataset into one archive.
+  ///
+  /// \param[in] shards         All shards, in the order of splitIntoBatchShards().
+  /// \param[in] archive_paths  The archive of every shard.
+  /// \param[in] camera_system  The output cameras of the pipelines, set on the merged frames.
+  /// \param[in] merged_archive_path The archive of the owned nframes of all shards.
+  /// \param[out] statistics    The counts of the merged nframes.
+  /// @return False if an archive could not be read or written.
+  static bool mergeShardArchives(const std::vector<BatchShard>& shards,
+                                 const std::vector<std::string>& archive_paths,
+                                 const std::shared_ptr<NCamera>& camera_system,
+                                 const std::string& merged_archive_path,
+                                 BatchShardStatistics* statistics);
+
+ private:
+  const Options options_;
+  const PipelineFactory pipeline_factory_;
+  const SourceFactory source_factory_;
+  const NFrameProcessorFactory nframe_processor_factory_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_PIPELINE_SHARDED_BATCH_PROCESSOR_H_
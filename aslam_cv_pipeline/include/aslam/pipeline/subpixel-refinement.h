@@ -0,0 +1,67 @@
+#ifndef ASLAM_PIPELINE_SUBPIXEL_REFINEMENT_H_
+#define ASLAM_PIPELINE_SUBPIXEL_REFINEMENT_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Core>
+#include <opencv2/core/core.hpp>
+
+namespace aslam {
+class VisualFrame;
+
+struct SubpixelRefinementSettings {
+  SubpixelRefinementSettings()
+      : half_window_size(3), max_iterations(10), epsilon_px(0.01), max_displacement_px(1.5),
+        min_eigenvalue_ratio(0.05), refined_uncertainty_px(0.4) {}
+  /// The window of a keypoint is (2 * half_window_size + 1) pixels wide.
+  int half_window_size;
+  /// The window is re-centered on the estimate until it moves less than epsilon_px, at most
+  /// max_iterations times.
+  int max_iterations;
+  double epsilon_px;
+  /// Keypoints whose estimate moves further from the detection keep the detected location.
+  double max_displacement_px;
+  /// Windows whose gradient structure tensor has a smaller ratio of the eigenvalues are edges or
+  /// flat, their keypoints keep the detected location.
+  double min_eigenvalue_ratio;
+  /// Measurement uncertainty assigned to the refined keypoints, the others keep theirs.
+  double refined_uncertainty_px;
+};
+
+/// \brief Compute the horizontal and vertical Scharr derivatives of an 8 bit gray image into a
+///        CV_16SC2 image, the layout of the derivatives of cv::buildOpticalFlowPyramid.
+void computeImageGradients(const cv::Mat& image, cv::Mat* gradients);
+
+/// \brief Refine keypoints to subpixel accuracy in place.
+///
+/// Every keypoint is moved to the point that minimizes the Gaussian weighted squared projections
+/// of the window pixels onto their gradients, i.e. the intersection of the edges in the window
+/// (Foerstner operator, the model of cv::cornerSubPix). The gradients are computed once for the
+/// whole image instead of interpolated per keypoint patch: the window is aligned to the pixel
+/// grid and only the separable Gaussian weights follow the subpixel estimate, hence the
+/// accumulation runs over contiguous rows of the gradient image.
+/// @param[in]  gradients  CV_16SC2 image derivatives, see computeImageGradients().
+/// @param[in]  settings   The refinement parameters.
+/// @param[in,out] keypoints  The keypoints in pixel coordinates, (x, y) per column.
+/// @param[out] is_refined  Whether a keypoint was moved, optional.
+/// @return The number of refined keypoints.
+size_t refineKeypointsSubpixel(const cv::Mat& gradients,
+                               const SubpixelRefinementSettings& settings,
+                               Eigen::Matrix2Xd* keypoints,
+                               std::vector<unsigned char>* is_refined);
+
+/// \brief Refine the keypoint measurements of the frame in place and set the uncertainty of the
+///        refined keypoints. Reuses the level 0 derivatives of the image pyramid channel if the
+///        frame has one, otherwise the gradients of the image are computed.
+/// @param[in]  image     The processed image the keypoints were detected in.
+/// @param[in]  settings  The refinement parameters.
+/// @param[in,out] frame  The frame, nothing is done if it has no keypoint measurements.
+/// @return The number of refined keypoints.
+size_t refineFrameKeypointsSubpixel(const cv::Mat& image,
+                                    const SubpixelRefinementSettings& settings,
+                                    VisualFrame* frame);
+
+}  // namespace aslam
+
+#endif  // ASLAM_PIPELINE_SUBPIXEL_REFINEMENT_H_
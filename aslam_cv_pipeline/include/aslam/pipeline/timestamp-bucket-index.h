@@ -0,0 +1,174 @@
+#ifndef ASLAM_PIPELINE_TIMESTAMP_BUCKET_INDEX_H_
+#define ASLAM_PIPELINE_TIMESTAMP_BUCKET_INDEX_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <glog/logging.h>
+
+namespace aslam {
+
+/// \class TimestampBucketIndex
+/// \brief Constant-time lookup of the entry closest to a timestamp within a tolerance.
+///
+/// The timestamps are quantized into buckets of tolerance + 1 nanoseconds, which are stored in
+/// an open addressing hash table with linear probing. Two entries in the same bucket would be
+/// within the tolerance of each other, hence the index holds at most one entry per bucket and
+/// requires that no entry is within the tolerance of an inserted timestamp. All entries within
+/// the tolerance of a timestamp are then in its own or one of the two neighboring buckets.
+/// Lookups and erasures don't allocate, inserts only if the table grows.
+template <typename ValueType>
+class TimestampBucketIndex {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(TimestampBucketIndex);
+
+  /// @param[in] timestamp_tolerance_ns Max. difference of a timestamp to a matching entry.
+  /// @param[in] initial_capacity The number of entries that fit without growing the table.
+  explicit TimestampBucketIndex(int64_t timestamp_tolerance_ns, size_t initial_capacity = 16u)
+      : bucket_width_ns_(timestamp_tolerance_ns + 1), num_entries_(0u) {
+    CHECK_GE(timestamp_tolerance_ns, 0);
+    size_t num_slots = 4u;
+    // Keep the load factor at most 1/2.
+    while (num_slots < 2u * initial_capacity) {
+      num_slots *= 2u;
+    }
+    slots_.resize(num_slots);
+  }
+
+  /// Returns the value of the entry closest to the timestamp within the tolerance, null if
+  /// there is none. Ties are resolved in favor of the older entry.
+  ValueType* findClosest(int64_t timestamp_ns) {
+    const int64_t bucket = getBucket(timestamp_ns);
+    Slot* closest_slot = nullptr;
+    int64_t min_time_diff = bucket_width_ns_;
+    for (int64_t neighbor_bucket = bucket - 1; neighbor_bucket <= bucket + 1; ++neighbor_bucket) {
+      const size_t slot_idx = findSlot(neighbor_bucket);
+      if (slot_idx == kInvalidSlot) {
+        continue;
+      }
+      Slot& slot = slots_[slot_idx];
+      const int64_t time_diff = std::abs(slot.timestamp_ns - timestamp_ns);
+      if (time_diff < min_time_diff) {
+        min_time_diff = time_diff;
+        closest_slot = &slot;
+      }
+    }
+    return closest_slot != nullptr ? &closest_slot->value : nullptr;
+  }
+
+  /// Add an entry, no entry may be within the tolerance of the timestamp.
+  void insert(int64_t timestamp_ns, const ValueType& value) {
+    if (2u * (num_entries_ + 1u) > slots_.size()) {
+      grow();
+    }
+    const int64_t bucket = getBucket(timestamp_ns);
+    size_t slot_idx = getHomeSlot(bucket);
+    while (slots_[slot_idx].is_occupied) {
+      CHECK_NE(slots_[slot_idx].bucket, bucket)
+          << "The entry at " << slots_[slot_idx].timestamp_ns << " is within the tolerance of "
+          << timestamp_ns << ".";
+      slot_idx = (slot_idx + 1u) & getSlotMask();
+    }
+    Slot& slot = slots_[slot_idx];
+    slot.is_occupied = true;
+    slot.bucket = bucket;
+    slot.timestamp_ns = timestamp_ns;
+    slot.value = value;
+    ++num_entries_;
+  }
+
+  /// Remove the entry with exactly this timestamp, returns false if there is none.
+  bool erase(int64_t timestamp_ns) {
+    size_t slot_idx = findSlot(getBucket(timestamp_ns));
+    if (slot_idx == kInvalidSlot || slots_[slot_idx].timestamp_ns != timestamp_ns) {
+      return false;
+    }
+    // Backward shift deletion: move the following entries of the probe sequence up such that no
+    // lookup stops at the freed slot.
+    size_t next_slot_idx = (slot_idx + 1u) & getSlotMask();
+    while (slots_[next_slot_idx].is_occupied) {
+      const size_t home_slot_idx = getHomeSlot(slots_[next_slot_idx].bucket);
+      // The entry may move to the freed slot if that is not before its home slot, cyclically.
+      if (((next_slot_idx - home_slot_idx) & getSlotMask()) >=
+          ((next_slot_idx - slot_idx) & getSlotMask())) {
+        slots_[slot_idx] = std::move(slots_[next_slot_idx]);
+        slot_idx = next_slot_idx;
+      }
+      next_slot_idx = (next_slot_idx + 1u) & getSlotMask();
+    }
+    slots_[slot_idx] = Slot();
+    --num_entries_;
+    return true;
+  }
+
+  void clear() {
+    for (Slot& slot : slots_) {
+      slot = Slot();
+    }
+    num_entries_ = 0u;
+  }
+
+  size_t size() const { return num_entries_; }
+  bool empty() const { return num_entries_ == 0u; }
+
+ private:
+  struct Slot {
+    Slot() : is_occupied(false), bucket(0), timestamp_ns(0) {}
+    bool is_occupied;
+    int64_t bucket;
+    int64_t timestamp_ns;
+    ValueType value;
+  };
+  static constexpr size_t kInvalidSlot = static_cast<size_t>(-1);
+
+  int64_t getBucket(int64_t timestamp_ns) const {
+    // Round towards negative infinity such that the buckets have the same width around zero.
+    const int64_t bucket = timestamp_ns / bucket_width_ns_;
+    return (timestamp_ns % bucket_width_ns_ < 0) ? bucket - 1 : bucket;
+  }
+
+  size_t getSlotMask() const { return slots_.size() - 1u; }
+
+  size_t getHomeSlot(int64_t bucket) const {
+    // Fibonacci hashing, consecutive buckets are spread over the table.
+    const uint64_t hash = static_cast<uint64_t>(bucket) * 0x9e3779b97f4a7c15ull;
+    return static_cast<size_t>(hash >> 32u) & getSlotMask();
+  }
+
+  size_t findSlot(int64_t bucket) const {
+    size_t slot_idx = getHomeSlot(bucket);
+    while (slots_[slot_idx].is_occupied) {
+      if (slots_[slot_idx].bucket == bucket) {
+        return slot_idx;
+      }
+      slot_idx = (slot_idx + 1u) & getSlotMask();
+    }
+    return kInvalidSlot;
+  }
+
+  void grow() {
+    std::vector<Slot> old_slots(2u * slots_.size());
+    old_slots.swap(slots_);
+    num_entries_ = 0u;
+    for (Slot& slot : old_slots) {
+      if (slot.is_occupied) {
+        insert(slot.timestamp_ns, slot.value);
+      }
+    }
+  }
+
+  const int64_t bucket_width_ns_;
+  /// The number of slots is a power of two.
+  std::vector<Slot> slots_;
+  size_t num_entries_;
+};
+
+template <typename ValueType>
+constexpr size_t TimestampBucketIndex<ValueType>::kInvalidSlot;
+
+}  // namespace aslam
+
+#endif  // ASLAM_PIPELINE_TIMESTAMP_BUCKET_INDEX_H_
@@ -0,0 +1,64 @@
+#ifndef ASLAM_PIPELINE_UNDISTORTER_MAP_CACHE_H_
+#define ASLAM_PIPELINE_UNDISTORTER_MAP_CACHE_H_
+
+#include <cstdint>
+#include <string>
+
+#include <gflags/gflags.h>
+#include <opencv2/core/core.hpp>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/common/macros.h>
+#include <aslam/common/types.h>
+
+DECLARE_string(acv_undistort_map_cache_directory);
+
+namespace aslam {
+
+/// \class UndistortMapCache
+/// \brief A persistent on-disk cache for undistortion maps.
+///
+/// Every map pair is stored in its own binary file named after a key that hashes the intrinsics,
+/// distortion parameters and resolutions of both cameras together with the map and interpolation
+/// type. A change of the calibration results in a different key, hence stale maps are never
+/// loaded. Files are read through a memory mapping and written atomically by renaming a
+/// temporary file, which makes it safe to share a cache directory between processes.
+class UndistortMapCache {
+ public:
+  ASLAM_POINTER_TYPEDEFS(UndistortMapCache);
+
+  /// @param[in] cache_directory Directory holding the cache files, created if it doesn't exist.
+  explicit UndistortMapCache(const std::string& cache_directory);
+
+  /// \brief Compute the cache key of the maps that transform images from the input to the
+  ///        output camera geometry.
+  static uint64_t computeKey(const Camera& input_camera, const Camera& output_camera,
+                             int map_type, InterpolationMethod interpolation);
+
+  /// \brief Load the maps stored under the given key.
+  /// @return False if there is no valid cache file for this key.
+  bool load(uint64_t key, cv::Mat* map_u, cv::Mat* map_v) const;
+
+  /// \brief Store the maps under the given key, replacing an existing entry.
+  /// @return False if the cache file could not be written.
+  bool store(uint64_t key, const cv::Mat& map_u, const cv::Mat& map_v) const;
+
+  /// Path of the cache file for the given key.
+  std::string getFilePath(uint64_t key) const;
+
+  const std::string& getCacheDirectory() const { return cache_directory_; }
+
+ private:
+  const std::string cache_directory_;
+};
+
+/// \brief Build the undistortion maps (see \ref common::buildUndistortMap) or load them from the
+///        cache in FLAGS_acv_undistort_map_cache_directory. The cache is disabled if the flag is
+///        empty. Newly built maps are added to the cache.
+void buildUndistortMapCached(const Camera& input_camera, const Camera& output_camera,
+                             int map_type, InterpolationMethod interpolation,
+                             cv::Mat* map_u, cv::Mat* map_v);
+
+}  // namespace aslam
+
+#endif  // ASLAM_PIPELINE_UNDISTORTER_MAP_CACHE_H_
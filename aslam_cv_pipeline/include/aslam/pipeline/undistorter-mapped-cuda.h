@@ -0,0 +1,86 @@
+#ifndef ASLAM_PIPELINE_MAPPED_UNDISTORTER_CUDA_H_
+#define ASLAM_PIPELINE_MAPPED_UNDISTORTER_CUDA_H_
+
+#include <memory>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/cuda.hpp>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/unique-id.h>
+#include <aslam/pipeline/cuda-image-cache.h>
+#include <aslam/pipeline/undistorter-mapped.h>
+
+namespace aslam {
+
+/// \class CudaMappedUndistorter
+/// \brief A MappedUndistorter that remaps the images on the CUDA device.
+///
+/// The maps are converted to floating point and uploaded once. cv::cuda::remap samples the
+/// input through a texture, such that the bilinear interpolation runs in the texture units.
+/// processImageOnDevice() enqueues the upload and the remap on the stream of the caller and
+/// leaves the result on the device. processImage() and processFrameImage() additionally
+/// download the result, on a stream of their own, hence concurrently processed frames don't
+/// serialize on the device. The device images of the frames can be kept in a CudaImageCache,
+/// where the CUDA detection of the BriskVisualPipeline and the CudaLkTracker pick them up
+/// instead of uploading the undistorted image again.
+///
+/// Falls back to the CPU remap of the MappedUndistorter if the CUDA backend is not available
+/// (see isCudaBackendAvailable()) or for Lanczos interpolation, which cv::cuda::remap doesn't
+/// support. The device remap differs from the CPU remap by the rounding of the interpolation.
+class CudaMappedUndistorter : public MappedUndistorter {
+ public:
+  ASLAM_POINTER_TYPEDEFS(CudaMappedUndistorter);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(CudaMappedUndistorter);
+
+  /// \brief Create the device undistorter of a mapped undistorter, e.g. of
+  ///        createMappedUndistorter(). The cameras are copied, the maps and the valid output
+  ///        rectangle are taken over.
+  ///
+  /// \param[in] undistorter   The CPU undistorter.
+  /// \param[in] device_images If set, the undistorted device images of the frames are stored
+  ///                          for later stages, see processFrameImage(). Can be null.
+  CudaMappedUndistorter(const MappedUndistorter& undistorter,
+                        const std::shared_ptr<CudaImageCache>& device_images);
+
+  virtual ~CudaMappedUndistorter() = default;
+
+  virtual void processImage(const cv::Mat& input_image, cv::Mat* output_image) const;
+
+  /// \brief Same as processImage(), and stores the device image of the output under the frame id
+  ///        if a cache is set and the frame id is valid.
+  virtual void processFrameImage(const cv::Mat& input_image, const FrameId& frame_id,
+                                 cv::Mat* output_image) const;
+
+  /// \brief Upload and remap a host image on the given stream, without downloading the result
+  ///        or waiting for it. The device image of the output is stored under the frame id if a
+  ///        cache is set and the frame id is valid. Requires the CUDA backend.
+  ///
+  /// The input image must stay unchanged and the cached image must not be read by later stages
+  /// until the caller has synchronized the stream. The caller downloads the output only if the
+  /// host needs it.
+  void processImageOnDevice(const cv::Mat& input_image, const FrameId& frame_id,
+                            cv::cuda::GpuMat* output_image, cv::cuda::Stream& stream) const;
+
+  /// \brief Remap an image that is already on the device, on the given stream. Nothing is
+  ///        downloaded, the caller synchronizes the stream. Requires the CUDA backend.
+  void processDeviceImage(const cv::cuda::GpuMat& input_image,
+                          cv::cuda::GpuMat* output_image, cv::cuda::Stream& stream) const;
+
+  /// False if the images are remapped on the CPU.
+  bool isUsingCuda() const { return use_cuda_; }
+
+  /// Device memory of the uploaded maps.
+  size_t getDeviceMemoryUsageBytes() const;
+
+ private:
+  bool use_cuda_;
+  /// \brief The CV_32FC1 source coordinates of the output pixels, uploaded once.
+  cv::cuda::GpuMat device_map_x_;
+  cv::cuda::GpuMat device_map_y_;
+  std::shared_ptr<CudaImageCache> device_images_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_PIPELINE_MAPPED_UNDISTORTER_CUDA_H_
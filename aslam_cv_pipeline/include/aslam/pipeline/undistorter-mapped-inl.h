@@ -4,25 +4,26 @@
 #include <aslam/cameras/camera-factory.h>
 #include <aslam/cameras/camera.h>
 #include <aslam/common/undistort-helpers.h>
+#include <aslam/pipeline/undistorter-map-cache.h>
 
 namespace aslam {
 
 template <>
 inline std::unique_ptr<MappedUndistorter> createMappedUndistorter(
-    const aslam::Camera& camera, float alpha, float scale,
+    const aslam::Camera& camera, float alpha, float scale, const cv::Rect& output_crop,
     aslam::InterpolationMethod interpolation_type) {
   switch (camera.getType()) {
     case Camera::Type::kUnifiedProjection: {
       const aslam::UnifiedProjectionCamera& unified_projection_cam =
           static_cast<const aslam::UnifiedProjectionCamera&>(camera);
       return createMappedUndistorter(
-          unified_projection_cam, alpha, scale, interpolation_type);
+          unified_projection_cam, alpha, scale, output_crop, interpolation_type);
     }
     case Camera::Type::kPinhole: {
       const aslam::PinholeCamera& pinhole_cam =
           static_cast<const aslam::PinholeCamera&>(camera);
       return createMappedUndistorter(
-          pinhole_cam, alpha, scale, interpolation_type);
+          pinhole_cam, alpha, scale, output_crop, interpolation_type);
     }
     default: {
       LOG(FATAL) << "Unknown camera model: "
@@ -37,6 +38,13 @@ template <typename CameraType>
 inline std::unique_ptr<MappedUndistorter> createMappedUndistorter(
     const CameraType& camera, float alpha, float scale,
     aslam::InterpolationMethod interpolation_type) {
+  return createMappedUndistorter(camera, alpha, scale, cv::Rect(), interpolation_type);
+}
+
+template <typename CameraType>
+inline std::unique_ptr<MappedUndistorter> createMappedUndistorter(
+    const CameraType& camera, float alpha, float scale, const cv::Rect& output_crop,
+    aslam::InterpolationMethod interpolation_type) {
   CHECK_GE(alpha, 0.0);
   CHECK_LE(alpha, 1.0);
   CHECK_GT(scale, 0.0);
@@ -50,9 +58,12 @@ inline std::unique_ptr<MappedUndistorter> createMappedUndistorter(
   Eigen::Matrix3d output_camera_matrix = common::getOptimalNewCameraMatrix(
       *input_camera, alpha, scale, kUndistortToPinhole);
 
-  const int output_width = static_cast<int>(scale * input_camera->imageWidth());
-  const int output_height =
-      static_cast<int>(scale * input_camera->imageHeight());
+  cv::Size output_size(static_cast<int>(scale * input_camera->imageWidth()),
+                       static_cast<int>(scale * input_camera->imageHeight()));
+  cv::Rect valid_output_roi = common::getValidUndistortedRoi(
+      *input_camera, output_camera_matrix, kUndistortToPinhole, output_size);
+  internal::cropUndistorterOutput(
+      output_crop, &output_camera_matrix, &output_size, &valid_output_roi);
 
   Camera::Ptr output_camera;
   Eigen::MatrixXd intrinsics(input_camera->getParameterSize(), 1);
@@ -61,7 +72,7 @@ inline std::unique_ptr<MappedUndistorter> createMappedUndistorter(
       intrinsics << output_camera_matrix(0, 0), output_camera_matrix(1, 1),
           output_camera_matrix(0, 2), output_camera_matrix(1, 2);
       output_camera.reset(
-          new PinholeCamera(intrinsics, output_width, output_height));
+          new PinholeCamera(intrinsics, output_size.width, output_size.height));
       CHECK(output_camera);
       break;
     case Camera::Type::kUnifiedProjection: {
@@ -74,7 +85,7 @@ inline std::unique_ptr<MappedUndistorter> createMappedUndistorter(
           output_camera_matrix(1, 1), output_camera_matrix(0, 2),
           output_camera_matrix(1, 2);
       output_camera.reset(
-          new UnifiedProjectionCamera(intrinsics, output_width, output_height));
+          new UnifiedProjectionCamera(intrinsics, output_size.width, output_size.height));
       CHECK(output_camera);
       break;
     }
@@ -84,12 +95,16 @@ inline std::unique_ptr<MappedUndistorter> createMappedUndistorter(
                         input_camera->getType());
   }
 
+  // The maps are built for the cropped output camera, hence the remap only visits the pixels of
+  // the crop.
   cv::Mat map_u, map_v;
-  common::buildUndistortMap(
-      *input_camera, *output_camera, CV_16SC2, map_u, map_v);
+  buildUndistortMapCached(
+      *input_camera, *output_camera, CV_16SC2, interpolation_type, &map_u, &map_v);
 
-  return std::unique_ptr<MappedUndistorter>(new MappedUndistorter(
+  std::unique_ptr<MappedUndistorter> undistorter(new MappedUndistorter(
       input_camera, output_camera, map_u, map_v, interpolation_type));
+  undistorter->setValidOutputRoi(valid_output_roi);
+  return undistorter;
 }
 
 }  // namespace aslam
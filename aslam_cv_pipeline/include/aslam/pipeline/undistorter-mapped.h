@@ -28,6 +28,16 @@ std::unique_ptr<MappedUndistorter> createMappedUndistorter(
     const CameraType& camera, float alpha, float scale,
     aslam::InterpolationMethod interpolation_type);
 
+/// \brief Same as above, but the output image is cropped to a region of the scaled output image.
+///        Undistortion, scaling and cropping are done by a single remap, the principal point and
+///        the size of the output camera are adjusted to the crop.
+/// @param[in] output_crop Region of the scaled output image to keep, in pixels of the scaled
+///                        image. An empty rectangle keeps the full image.
+template <typename CameraType>
+std::unique_ptr<MappedUndistorter> createMappedUndistorter(
+    const CameraType& camera, float alpha, float scale, const cv::Rect& output_crop,
+    aslam::InterpolationMethod interpolation_type);
+
 /// \brief Factory method to create a mapped undistorter for this camera geometry to undistorts
 ///        the image to a pinhole view.
 ///        NOTE: The undistorter stores a copy of the input camera and changes to the original
@@ -43,6 +53,21 @@ std::unique_ptr<MappedUndistorter> createMappedUndistorterToPinhole(
     const aslam::UnifiedProjectionCamera& unified_proj_camera,
     float alpha, float scale, aslam::InterpolationMethod interpolation_type);
 
+/// \brief Same as above, but the output image is cropped to a region of the scaled output image.
+/// @param[in] output_crop Region of the scaled output image to keep, in pixels of the scaled
+///                        image. An empty rectangle keeps the full image.
+std::unique_ptr<MappedUndistorter> createMappedUndistorterToPinhole(
+    const aslam::UnifiedProjectionCamera& unified_proj_camera, float alpha, float scale,
+    const cv::Rect& output_crop, aslam::InterpolationMethod interpolation_type);
+
+namespace internal {
+/// \brief Crop the scaled output image of an undistorter: shifts the principal point of the
+///        output camera matrix, sets the output size to the crop and moves the valid output
+///        rectangle into the crop. An empty crop leaves the arguments untouched.
+void cropUndistorterOutput(const cv::Rect& output_crop, Eigen::Matrix3d* output_camera_matrix,
+                           cv::Size* output_size, cv::Rect* valid_output_roi);
+}  // namespace internal
+
 /// \class MappedUndistorter
 /// \brief A class that encapsulates image undistortion for building frames from images.
 ///
@@ -74,14 +99,55 @@ public:
   virtual ~MappedUndistorter() = default;
 
   /// \brief Produce an undistorted image from an input image.
+  ///
+  /// The output image is reused if it already has the size of the output camera and the type of
+  /// the input image. Passing the same cv::Mat for consecutive frames hence avoids reallocations.
   virtual void processImage(const cv::Mat& input_image, cv::Mat* output_image) const;
 
+  /// \brief Remap using packed fixed-point maps (CV_16SC2 coordinates with a CV_16UC1
+  ///        interpolation table) which take the fast integer path of cv::remap.
+  ///
+  /// Floating point maps are converted once when enabling, fixed-point maps are used as they are.
+  /// Disabled by default as the fixed-point maps quantize the sub-pixel positions to
+  /// 1/cv::INTER_TAB_SIZE pixels.
+  void setUseFixedPointMaps(bool use_fixed_point_maps);
+  bool getUseFixedPointMaps() const { return use_fixed_point_maps_; }
+
+  /// \brief Set the rectangle of the output image that only contains valid pixels.
+  ///        Defaults to the full output image. (see \ref common::getValidUndistortedRoi)
+  void setValidOutputRoi(const cv::Rect& valid_output_roi);
+  const cv::Rect& getValidOutputRoi() const { return valid_output_roi_; }
+
+  /// \brief Only undistort the valid output rectangle, pixels outside of it are set to zero.
+  void setUndistortValidRoiOnly(bool undistort_valid_roi_only) {
+    undistort_valid_roi_only_ = undistort_valid_roi_only;
+  }
+  bool getUndistortValidRoiOnly() const { return undistort_valid_roi_only_; }
+
+  /// \brief Only undistort a rectangle of the output image, e.g. the bounding rectangle of the
+  ///        unmasked pixels (see VisualPipeline::setProcessingRoi). Pixels outside of it are set
+  ///        to zero. Combines with \ref setUndistortValidRoiOnly. An empty rectangle undistorts
+  ///        the full image. (default)
+  void setProcessingRoi(const cv::Rect& processing_roi);
+  const cv::Rect& getProcessingRoi() const { return processing_roi_; }
+
+  /// The rectangle of the output image that is remapped, the rest is set to zero.
+  cv::Rect getRemappedOutputRoi() const;
+
   /// Get the undistorter map for the u-coordinate.
   const cv::Mat& getUndistortMapU() const { return map_u_; };
 
   /// Get the undistorter map for the u-coordinate.
   const cv::Mat& getUndistortMapV() const { return map_v_; };
 
+  InterpolationMethod getInterpolationMethod() const { return interpolation_method_; }
+
+  /// Memory of the maps, including the fixed-point maps if enabled.
+  virtual size_t getMemoryUsageBytes() const;
+
+  /// Bind the maps to the node, including the fixed-point maps if enabled.
+  virtual bool bindMemoryToNumaNode(size_t node);
+
 private:
   /// \brief LUT for u coordinates.
   const cv::Mat map_u_;
@@ -89,6 +155,17 @@ private:
   const cv::Mat map_v_;
   /// \brief Interpolation strategy
   InterpolationMethod interpolation_method_;
+
+  /// \brief Fixed-point maps, only set if enabled with \ref setUseFixedPointMaps.
+  cv::Mat fixed_point_map_xy_;
+  cv::Mat fixed_point_map_table_;
+  bool use_fixed_point_maps_;
+
+  /// \brief Rectangle of the output image that only contains valid pixels.
+  cv::Rect valid_output_roi_;
+  bool undistort_valid_roi_only_;
+  /// \brief Rectangle of the output image that is processed, empty for the full image.
+  cv::Rect processing_roi_;
 };
 
 }  // namespace aslam
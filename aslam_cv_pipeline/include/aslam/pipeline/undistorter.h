@@ -3,6 +3,7 @@
 
 #include <aslam/cameras/camera.h>
 #include <aslam/common/macros.h>
+#include <aslam/common/unique-id.h>
 
 // Forward declarations.
 namespace cv { class Mat; };
@@ -31,6 +32,15 @@ public:
   /// \brief Produce an undistorted image from an input image.
   virtual void processImage(const cv::Mat& input_image, cv::Mat* output_image) const = 0;
 
+  /// \brief Produce the undistorted image of a frame. Undistorters that keep intermediate
+  ///        results for later stages, e.g. device images, store them under the frame id.
+  ///
+  /// \param[in] frame_id The frame of the image, invalid if the results must not be stored.
+  virtual void processFrameImage(const cv::Mat& input_image, const FrameId& /*frame_id*/,
+                                 cv::Mat* output_image) const {
+    processImage(input_image, output_image);
+  }
+
   /// \brief Get the input camera that corresponds to the image
   ///        passed in to processImage().
   ///
@@ -73,6 +83,14 @@ public:
   /// rectification, the input and output camera may not be the same.
   Camera::ConstPtr getOutputCameraShared() const { return output_camera_; };
 
+  /// Memory of the undistorter, e.g. its maps. The cameras are shared and not counted.
+  virtual size_t getMemoryUsageBytes() const = 0;
+
+  /// \brief Bind the memory of the undistorter, e.g. its maps, to a NUMA node (see
+  ///        common::bindMemoryToNumaNode). Nothing to bind by default.
+  /// @return False if binding failed.
+  virtual bool bindMemoryToNumaNode(size_t /*node*/) { return true; }
+
 protected:
   /// \brief The intrinsics of the raw image.
   Camera::Ptr input_camera_;
@@ -1,20 +1,35 @@
 #ifndef VISUAL_NPIPELINE_H_
 #define VISUAL_NPIPELINE_H_
 
+#include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <opencv2/core/core.hpp>
 
 #include <aslam/cameras/ncamera.h>
+#include <aslam/common/deadline.h>
 #include <aslam/common/macros.h>
+#include <aslam/common/object-pool.h>
+#include <aslam/common/spsc-queue.h>
 #include <aslam/common/thread-pool.h>
 #include <aslam/frames/visual-frame.h>
 #include <aslam/frames/visual-nframe.h>
+#include <aslam/matcher/epipolar-band-matcher.h>
+#include <aslam/matcher/match.h>
+#include <aslam/pipeline/image-buffer.h>
+#include <aslam/pipeline/image-decoder.h>
+#include <aslam/pipeline/timestamp-bucket-index.h>
 #include <aslam/pipeline/visual-pipeline.h>
+#include <aslam/pipeline/worker-scaling-policy.h>
 
 namespace aslam {
 
@@ -48,6 +63,102 @@ class VisualNPipeline final {
   ASLAM_POINTER_TYPEDEFS(VisualNPipeline);
   ASLAM_DISALLOW_EVIL_CONSTRUCTORS(VisualNPipeline);
 
+  /// \brief What to do with a new image once the in-flight limit is reached.
+  ///        (see \ref setMaxNumInFlight)
+  enum class InFlightPolicy {
+    /// Block the producer until the number of in-flight items drops below the limit. If only
+    /// incomplete nframes are left, the oldest is dropped as they can't complete without new
+    /// images.
+    kBlockProducer,
+    /// Drop the oldest incomplete nframe. Drops the new image if there is no incomplete nframe.
+    kDropOldestIncompleteNFrame,
+    /// Drop the new image.
+    kDropNewestImage
+  };
+
+  /// \brief On which threads the images are processed. (see \ref setSchedulingMode)
+  enum class SchedulingMode {
+    /// Every image is a task on the shared thread pool. (default)
+    kSharedPool,
+    /// Every camera is processed in order by its own worker thread, which keeps the detector
+    /// state and buffers of a camera in the cache of one core.
+    kPerCameraWorker
+  };
+
+  /// \brief Where completed nframes are published. (see \ref setOutputMode)
+  enum class OutputMode {
+    /// A mutex protected queue shared with the workers, supports all getters. (default)
+    kLockedQueue,
+    /// A bounded lock-free FIFO queue. Completed nframes are dropped while it is full.
+    kLockFreeQueue,
+    /// A lock-free slot holding the latest completed nframe, an unconsumed nframe is replaced.
+    kLockFreeLatest
+  };
+
+  /// The images of one nframe read from a dataset by the source of \ref processBatch.
+  struct BatchImages {
+    /// One image per camera, in the order of the camera system.
+    std::vector<cv::Mat> images;
+    /// The timestamps of the images in integer nanoseconds.
+    std::vector<int64_t> timestamps;
+  };
+  /// Fills the images of the next nframe, returns false at the end of the dataset.
+  typedef std::function<bool(BatchImages* images)> BatchImageSource;
+  /// Receives the nframes of \ref processBatch.
+  typedef std::function<void(const std::shared_ptr<VisualNFrame>& nframe)> NFrameCallback;
+
+  /// Number of frames of a camera that were dropped, by reason.
+  struct FrameDropCounters {
+    FrameDropCounters()
+        : num_dropped_newest_image(0u), num_dropped_oldest_incomplete_nframe(0u),
+          num_dropped_unsynchronized(0u), num_dropped_output_queue_full(0u),
+          num_dropped_decoding_failed(0u) {}
+    /// The image was dropped on arrival because of the in-flight limit.
+    size_t num_dropped_newest_image;
+    /// The frame was part of an incomplete nframe dropped because of the in-flight limit.
+    size_t num_dropped_oldest_incomplete_nframe;
+    /// The frame was part of an nframe that never completed as other cameras dropped images.
+    size_t num_dropped_unsynchronized;
+    /// The frame was part of a complete nframe dropped because the output queue was full or
+    /// replaced by a newer nframe in the lock-free latest output slot.
+    size_t num_dropped_output_queue_full;
+    /// The compressed image could not be decoded or had the wrong size.
+    size_t num_dropped_decoding_failed;
+  };
+
+  /// The real-time configuration of \ref setRealTimeOptions.
+  struct RealTimeOptions {
+    RealTimeOptions()
+        : num_preallocated_nframes(0u), max_num_keypoints_per_frame(0u),
+          descriptor_size_bytes(0u), lock_memory(false), worker_priority(0),
+          check_steady_state_allocations(false) {}
+    /// The budget of nframes and frames per camera which are allocated and pre-faulted up
+    /// front and recycled afterwards, see setFramePoolSize(). 0 keeps the frame pools.
+    size_t num_preallocated_nframes;
+    /// The heap memory of the keypoint channels of this many keypoints per frame is reserved.
+    size_t max_num_keypoints_per_frame;
+    /// Bytes per descriptor of the preallocated descriptor channel, 0 for no descriptors.
+    size_t descriptor_size_bytes;
+    /// Lock all current and future pages of the process in RAM.
+    bool lock_memory;
+    /// The SCHED_FIFO priority of all workers, 0 keeps the normal policy.
+    int worker_priority;
+    /// The CPUs of the workers of the shared pool, empty leaves the affinity unchanged. The
+    /// per-camera workers keep the CPUs of setSchedulingMode().
+    std::vector<size_t> worker_cpu_ids;
+    /// Process the images of the camera pipelines in a common::SteadyStateScope, which counts
+    /// or asserts on their heap allocations if the allocation hooks are linked.
+    bool check_steady_state_allocations;
+  };
+
+  /// The configuration of \ref setIntraRigMatching.
+  struct IntraRigMatchingOptions {
+    /// The (apple, banana) camera indices of the pairs with overlapping fields of view.
+    std::vector<std::pair<size_t, size_t>> camera_pairs;
+    /// The search parameters of all pairs.
+    EpipolarBandMatcher::Options matcher_options;
+  };
+
   /// \brief Initialize a working pipeline.
   ///
   /// \param[in] num_threads            The number of processing threads.
@@ -80,6 +191,70 @@ class VisualNPipeline final {
   /// \param[in] timestamp the time in integer nanoseconds.
   void processImage(size_t camera_index, const cv::Mat& image, int64_t timestamp);
 
+  /// \brief Same as \ref processImage but takes over the image. The pixels are passed on to the
+  ///        visual pipeline and the raw image of the VisualFrame without any copy, unless the
+  ///        visual pipeline is configured to copy images.
+  ///
+  /// \param[in] camera_index The index of the camera that this image corresponds to.
+  /// \param[in] image the image data.
+  /// \param[in] timestamp the time in integer nanoseconds.
+  void processImage(size_t camera_index, cv::Mat&& image, int64_t timestamp);
+
+  /// \brief Same as \ref processImage but takes ownership of an externally allocated buffer,
+  ///        e.g. a camera driver DMA buffer. The size of the image is given by the input camera.
+  ///
+  /// \param[in] camera_index The index of the camera that this image corresponds to.
+  /// \param[in] data Pointer to the first pixel.
+  /// \param[in] step Number of bytes per image row.
+  /// \param[in] type OpenCV type of the pixels, e.g. CV_8UC1.
+  /// \param[in] deleter Called with data once the pipeline and all frames released the image.
+  /// \param[in] timestamp the time in integer nanoseconds.
+  void processImageBuffer(size_t camera_index, void* data, size_t step, int type,
+                          const ImageBufferDeleter& deleter, int64_t timestamp);
+
+  /// \brief Same as \ref processImage but takes a compressed image, e.g. a JPEG frame, which is
+  ///        decoded on the worker by the decoder of the camera (see setImageDecoder()).
+  ///
+  /// Decoding is the first stage of the processing, hence the calling thread only admits the
+  /// image and the decoding of several images runs in parallel. The decoded images are recycled
+  /// once the frames referencing them are released. Images which can't be decoded or don't have
+  /// the size of the input camera are dropped and counted in the frame drop counters.
+  ///
+  /// \param[in] camera_index The index of the camera that this image corresponds to.
+  /// \param[in] data The encoded image as a continuous CV_8UC1 row, the bytes are shared until
+  ///                 the image is decoded. See wrapImageBuffer() for driver buffers.
+  /// \param[in] timestamp the time in integer nanoseconds.
+  void processCompressedImage(size_t camera_index, const cv::Mat& data, int64_t timestamp);
+
+  /// \brief Add the synchronized images of all cameras at once.
+  ///
+  /// The images are admitted under a single lock. In the kSharedPool scheduling mode all images
+  /// are processed by one task, which keeps the frames of an nframe on one core and saves the
+  /// per-image scheduling. In the kPerCameraWorker mode every image goes to its camera worker.
+  ///
+  /// \param[in] images     One image per camera, in the order of the camera system.
+  /// \param[in] timestamps The timestamps of the images in integer nanoseconds.
+  void processImages(const std::vector<cv::Mat>& images, const std::vector<int64_t>& timestamps);
+
+  /// \brief Process a dataset offline, without dropping or reordering nframes.
+  ///
+  /// The source is read on a separate thread, such that loading and decoding the images overlaps
+  /// with the processing. The images of up to max_num_lookahead_nframes nframes are processed in
+  /// parallel on the thread pool(s) of the scheduling mode, and the nframes are passed to the
+  /// callback on the calling thread in the order of the source, once all their frames are done.
+  /// The visual pipelines process every image independently, hence the nframes are the same as
+  /// those of a run with a single thread, apart from the random ids. The in-flight limit, the
+  /// synchronization tolerance, nframe preallocation and the output queue are not used. Must
+  /// not be called while images are processed or concurrently with shutdown().
+  ///
+  /// \param[in] source   The images of the nframes. The timestamps of every camera must
+  ///                     increase strictly.
+  /// \param[in] callback Called for every nframe, in the order of the source.
+  /// \param[in] max_num_lookahead_nframes The max. number of nframes read ahead of the callback.
+  /// @return  The number of nframes passed to the callback.
+  size_t processBatch(const BatchImageSource& source, const NFrameCallback& callback,
+                      size_t max_num_lookahead_nframes);
+
   /// \brief Same as \ref processImage with the difference that the function call blocks if the
   ///        output queue exceeds the specified limit.
   ///
@@ -137,6 +312,34 @@ class VisualNPipeline final {
   /// @return Returns false if the queue is shut down.
   bool getLatestAndClearBlocking(std::shared_ptr<VisualNFrame>* nframe);
 
+  /// \brief Push the completed nframes to a callback instead of waiting for them in a
+  ///        consumer thread.
+  ///
+  /// Every nframe completed after the registration is enqueued on the executor in the
+  /// exclusivity group of the callback id, hence a callback receives the nframes in
+  /// chronological order and never runs concurrently with itself, while several callbacks run in
+  /// parallel and share the nframes. While callbacks are registered, the completed nframes bypass
+  /// the output queue of every output mode. The callbacks are enqueued without holding the
+  /// internal lock, and they may call any method of the pipeline.
+  /// \param[in] callback  Called with every completed nframe.
+  /// \param[in] executor  The pool the callback runs on, e.g. a single thread per consumer or a
+  ///                      pool shared by all consumers.
+  /// @return The id of the callback, see removeNFrameCallback().
+  size_t addNFrameCallback(const NFrameCallback& callback,
+                           const std::shared_ptr<ThreadPool>& executor);
+
+  /// \brief Stop passing nframes to a callback. The nframes that completed before are still
+  ///        passed to it.
+  void removeNFrameCallback(size_t callback_id);
+
+  /// \brief Get the next nframe as a future, e.g. to wait for several sources at once or to
+  ///        wrap it in an awaitable of a coroutine framework.
+  ///
+  /// The future is ready if the output queue holds an nframe, otherwise the next completed
+  /// nframe fulfills the oldest pending future and bypasses the output queue. The futures hold a
+  /// null pointer once the pipeline is shut down. Requires the kLockedQueue output mode.
+  std::future<std::shared_ptr<VisualNFrame>> getNextAsync();
+
   /// Get the input camera system that corresponds to the images
   /// passed in to processImage().
   /// Because this pipeline may do things like image undistortion or
@@ -152,6 +355,174 @@ class VisualNPipeline final {
   /// Blocks until all waiting frames are processed.
   void waitForAllWorkToComplete() const;
 
+  /// \brief Bound the number of in-flight items, which are the images waiting for or undergoing
+  ///        processing plus the incomplete nframes.
+  ///
+  /// \param[in] max_num_in_flight The maximum number of in-flight items, 0 disables the limit.
+  ///                              (default)
+  /// \param[in] policy            What to do with new images once the limit is reached.
+  void setMaxNumInFlight(size_t max_num_in_flight, InFlightPolicy policy);
+
+  /// Get the number of images waiting for or undergoing processing plus the incomplete nframes.
+  size_t getNumInFlight() const;
+
+  /// \brief Give every frame a deadline that many nanoseconds after its image was passed to
+  ///        processImage(), including the time it waits for a worker.
+  ///
+  /// The camera pipelines and the intra-rig matching run in a common::DeadlineScope with the
+  /// deadline and degrade to finish in time, see VisualPipeline::processImage(). The applied
+  /// degradations are stored in the frames. The batch processing is not bounded.
+  /// \param[in] budget_nanoseconds The budget per frame, 0 disables the deadlines. (default)
+  void setFrameProcessingBudget(int64_t budget_nanoseconds);
+
+  /// Get the counters of dropped frames of a camera.
+  FrameDropCounters getFrameDropCounters(size_t camera_index) const;
+
+  /// \brief Memory of the pipeline, see VisualNFrame::getMemoryUsageBytes for the frames.
+  ///
+  /// The entries of the report are "<tag>/processing" for the finished frames of the incomplete
+  /// nframes, "<tag>/completed" for the output queue, "<tag>/pipeline_<i>" for the camera
+  /// pipelines, "<tag>/frame_pool_<i>" and "<tag>/nframe_pool" for the recycled frames,
+  /// "<tag>/decoded_image_pool_<i>" for the recycled decoded images and "<tag>/other" for the
+  /// rest. The nframes of the lock-free output modes are owned by the
+  /// consumer side and not counted, nor are the images waiting for a worker.
+  /// @param[out] report Can be null.
+  size_t getMemoryUsageBytes(const std::string& tag, common::MemoryUsageReport* report) const;
+  size_t getMemoryUsageBytes() const { return getMemoryUsageBytes(std::string(), nullptr); }
+
+  /// Add the memory usage under the tag "VisualNPipeline" to the statistics, see
+  /// common::MemoryUsageReport::addToStatistics. Call it periodically to track the usage.
+  void addMemoryUsageToStatistics() const;
+
+  /// \brief Add the memory usage to the statistics periodically, see
+  ///        addMemoryUsageToStatistics(). The first worker starting an image after the period
+  ///        elapsed collects the report.
+  /// \param[in] period_nanoseconds The reporting period, 0 disables the reports. (default)
+  void setMemoryUsageReportingPeriod(int64_t period_nanoseconds);
+
+  /// \brief Recycle the VisualFrames and VisualNFrames once the last reference to them is
+  ///        released instead of allocating new ones for every image.
+  ///
+  /// Recycled frames drop their raw image but keep their keypoint channels, hence the channel
+  /// buffers are reused if the next image of the camera yields the same number of keypoints. The
+  /// visual pipelines overwrite the channels they produce. Must not be called while images are
+  /// processed.
+  /// \param[in] max_num_pooled_nframes The number of nframes and frames per camera to keep for
+  ///                                   reuse, 0 disables recycling. (default)
+  void setFramePoolSize(size_t max_num_pooled_nframes);
+
+  /// \brief Preallocate the nframe and the frames of all cameras when the first image of a
+  ///        timestamp is admitted.
+  ///
+  /// The workers then fill their frame slot in place and mark it complete with an atomic flag.
+  /// Only the worker completing the last slot of an nframe takes the mutex to publish it, the
+  /// others finish without locking. A second image of a camera within the timestamp tolerance of
+  /// an admitted one is dropped instead of overwriting the frame. The frames are taken from the
+  /// frame pools if enabled. Must not be called while images are processed.
+  /// \param[in] preallocate Whether to preallocate the nframes, disabled by default.
+  void setPreallocateNFrames(bool preallocate);
+
+  /// \brief Select on which threads the images are processed.
+  ///
+  /// Waits for the queued images to be processed. A shared pool pinned by setNumaPlacement() is
+  /// unpinned. Must not be called concurrently with processImage().
+  /// \param[in] mode            The scheduling mode.
+  /// \param[in] camera_cpu_ids  Only for kPerCameraWorker, either empty or one list of CPUs per
+  ///                            camera that its worker is restricted to. An empty list leaves the
+  ///                            affinity of the worker unchanged.
+  /// @return False if a worker could not be pinned to its CPUs, it then runs unpinned, or if
+  ///         the shared pool could not be unpinned.
+  bool setSchedulingMode(SchedulingMode mode,
+                         const std::vector<std::vector<size_t>>& camera_cpu_ids);
+
+  /// \brief Select where completed nframes are published.
+  ///
+  /// In the lock-free modes getNext(), getLatestAndClear() and getNumFramesComplete() don't take
+  /// the mutex shared with the workers, hence a consumer polling at a high rate doesn't contend
+  /// with the processing. Only one thread may consume at a time. getLatestAndClear() doesn't drop
+  /// older incomplete nframes and the blocking getters and the output queue limits of
+  /// processImageBlockingIfFull() and processImageNonBlockingDroppingOldestNFrameIfFull() are
+  /// not supported. Must not be called while images are processed or consumed.
+  /// \param[in] mode                      Where to publish completed nframes.
+  /// \param[in] lock_free_queue_capacity  Capacity of the lock-free queue (kLockFreeQueue only).
+  void setOutputMode(OutputMode mode, size_t lock_free_queue_capacity);
+
+  /// \brief Configure the pipeline for bounded latency.
+  ///
+  /// The frame pools are sized to the nframe budget and filled up front. The frames are handed
+  /// out without keypoints, but the memory of their keypoint channels up to the keypoint limit
+  /// is allocated, pre-faulted and freed once, and the heap is told to retain freed memory (see
+  /// common::retainFreedHeapMemory), hence the channels of the pipelines reuse resident pages
+  /// instead of faulting new ones. The pages are locked before, so they stay resident. Real-time priorities and CPU affinities apply to the
+  /// current workers, call this after setSchedulingMode(). Heap allocations of the
+  /// synchronization itself (the nframe bookkeeping and the queued tasks) are not checked.
+  /// Must not be called while images are processed.
+  void setRealTimeOptions(const RealTimeOptions& options);
+
+  /// \brief Place the processing of every camera on a NUMA node of a multi-socket machine, such
+  ///        that the workers of a camera read and write memory of their own node.
+  ///
+  /// In the kPerCameraWorker mode the worker of every camera is pinned to the CPUs of its node.
+  /// In the kSharedPool mode all cameras must be on the same node and the shared pool is pinned,
+  /// e.g. to process independent sequences with one pipeline per node. The undistortion maps are
+  /// bound to the node of their camera (see VisualPipeline::bindMemoryToNumaNode) and the frames
+  /// preallocated by setRealTimeOptions() are written first by a worker of the node, hence the
+  /// kernel places them there. The intra-rig matching of cameras on different nodes reads one
+  /// frame remotely. Call this after setSchedulingMode() and before setRealTimeOptions(), whose
+  /// worker_cpu_ids replace the CPUs of the shared pool. Must not be called while images are
+  /// processed.
+  /// \param[in] camera_numa_nodes  The node of every camera, see distributeCamerasOverNumaNodes().
+  /// @return False if a worker could not be pinned to the CPUs of its node, it then keeps its
+  ///         previous CPUs. The memory is placed nevertheless.
+  bool setNumaPlacement(const std::vector<size_t>& camera_numa_nodes);
+
+  /// \brief Assign blocks of consecutive cameras to the nodes, such that every node gets about
+  ///        the same number of cameras and neighbouring cameras, e.g. stereo pairs, share a node.
+  static std::vector<size_t> distributeCamerasOverNumaNodes(size_t num_cameras, size_t num_nodes);
+
+  /// The CPUs the workers processing the camera may run on, see ThreadPool::getCpuAffinity().
+  std::vector<size_t> getWorkerCpuIds(size_t camera_index) const;
+
+  /// \brief Match the keypoints of camera pairs of the rig within every nframe.
+  ///
+  /// The keypoints of a pair are matched by an EpipolarBandMatcher whose rectification is
+  /// computed once from the extrinsics of the output camera system. The pair is matched on the
+  /// worker of whichever of its two frames is processed last, right when both frames exist, so
+  /// the matching of a pair overlaps with the processing of the other cameras. The matches of
+  /// all pairs are stored in the intra-rig matches of the nframe before it is published (see
+  /// VisualNFrame::getIntraRigMatches()). Frames without keypoints or descriptors are not
+  /// matched. Must not be called while images are processed.
+  /// \param[in] options  The camera pairs to match, no pairs disable the matching. (default)
+  void setIntraRigMatching(const IntraRigMatchingOptions& options);
+
+  /// \brief Select the decoder of the compressed images of a camera, an OpenCvImageDecoder with
+  ///        the default options by default. Must not be called while images are processed.
+  void setImageDecoder(size_t camera_index, const ImageDecoder::Ptr& decoder);
+
+  /// \brief Scale the number of active workers of the shared pool with the load, such that the
+  ///        latency target is kept with as few cores as possible.
+  ///
+  /// Every processed image adds its latency from the enqueue until its frame is processed and
+  /// the number of tasks waiting for a worker to the policy, which parks and unparks the workers
+  /// of the shared pool (see ThreadPool::setNumActiveThreads()). The pool starts with the
+  /// minimum number of workers of the options. Only the kSharedPool scheduling mode is
+  /// supported and processBatch() doesn't add samples. Must not be called while images are
+  /// processed.
+  /// \param[in] options The latency target and thresholds of the policy, see
+  ///                    WorkerScalingPolicy.
+  void enableWorkerScaling(const WorkerScalingPolicy::Options& options);
+
+  /// Stop the worker scaling and unpark all workers. Must not be called while images are
+  /// processed.
+  void disableWorkerScaling();
+
+  /// Get the number of workers of the shared pool which currently process images.
+  size_t getNumActiveWorkers() const;
+
+  /// \brief Restrict the keypoint detection of the following images of a camera to the non-zero
+  ///        pixels of the mask, see VisualPipeline::setDetectionMask().
+  void setDetectionMask(size_t camera_index, const cv::Mat& mask);
+
   /// \brief  Create a test visual npipeline.
   ///
   /// @param[in]  num_cameras   The number of cameras in the pipeline (determines the number of
@@ -164,17 +535,168 @@ class VisualNPipeline final {
       size_t num_threads, int64_t timestamp_tolerance_ns);
 
  private:
+  /// The completion state of a preallocated nframe, shared with the workers filling the slots.
+  struct PreallocatedSlots {
+    explicit PreallocatedSlots(size_t num_slots);
+    /// Whether an image was admitted for the slot, only accessed with the mutex locked.
+    std::vector<bool> is_slot_reserved;
+    /// Set by the worker once the frame of the slot is filled.
+    std::unique_ptr<std::atomic<bool>[]> is_slot_complete;
+    std::atomic<size_t> num_slots_incomplete;
+    /// The intra-rig matching of the nframe, the pairs are matched before the slots complete.
+    std::shared_ptr<IntraRigMatchingState> intra_rig_matching;
+  };
+
+  /// The intra-rig matching state of an nframe, shared with the workers of its frames.
+  struct IntraRigMatchingState {
+    IntraRigMatchingState(const std::shared_ptr<VisualNFrame>& nframe, size_t num_cameras,
+                          size_t num_pairs);
+    std::shared_ptr<VisualNFrame> nframe;
+    /// The frame of every camera, set by its worker before it is counted in the pairs.
+    std::vector<std::shared_ptr<const VisualFrame>> frames;
+    /// Whether the frame of a camera is counted in its pairs, a repeated frame is not.
+    std::unique_ptr<std::atomic<bool>[]> is_camera_counted;
+    /// The number of frames of every pair that are set, the worker of the second one matches
+    /// the pair.
+    std::unique_ptr<std::atomic<size_t>[]> num_pair_frames_set;
+    std::vector<FrameToFrameMatchesWithScore> pair_matches;
+    std::atomic<size_t> num_pairs_pending;
+    /// Set once the matches of all pairs are stored in the nframe.
+    std::atomic<bool> is_complete;
+  };
+
+  /// An nframe waiting for frames, slots is only set if it was preallocated and
+  /// intra_rig_matching only if the intra-rig matching is enabled.
+  struct ProcessingNFrame {
+    std::shared_ptr<VisualNFrame> nframe;
+    std::shared_ptr<PreallocatedSlots> slots;
+    std::shared_ptr<IntraRigMatchingState> intra_rig_matching;
+    bool isComplete() const;
+  };
+  typedef std::map<int64_t, ProcessingNFrame> TimestampProcessingNFrameMap;
+
   /// \brief A local function to be passed to the thread pool.
   ///
   /// \param[in] camera_index The index of the camera that this image corresponds to.
   /// \param[in] image The image data.
   /// \param[in] timestamp_nanoseconds The time in integer nanoseconds.
-  void work(size_t camera_index, const cv::Mat& image, int64_t timestamp_nanoseconds);
+  /// \param[in] enqueue_time_nanoseconds Trace clock time of the enqueue, -1 if neither traced
+  ///                                     nor used by the worker scaling.
+  /// \param[in] deadline The deadline of the frame, see \ref setFrameProcessingBudget.
+  /// \param[in] slots The preallocated nframe the frame belongs to, null if not preallocated.
+  /// \param[in] frame The preallocated frame to fill, null if not preallocated.
+  void work(size_t camera_index, const cv::Mat& image, int64_t timestamp_nanoseconds,
+            int64_t enqueue_time_nanoseconds, const common::Deadline& deadline,
+            const std::shared_ptr<PreallocatedSlots>& slots,
+            const std::shared_ptr<VisualFrame>& frame);
 
   std::shared_ptr<VisualNFrame> getNextImpl();
 
-  void processImageImpl(size_t camera_index, const cv::Mat& image,
-                        int64_t timestamp);
+  /// The deadline of a frame whose image arrives now, see \ref setFrameProcessingBudget. Created
+  /// before the admission of the image, which may block the producer.
+  common::Deadline createFrameDeadline() const;
+
+  /// Enqueue an admitted image, the mutex must be locked. Compressed images are decoded first.
+  void processImageImpl(size_t camera_index, cv::Mat image, int64_t timestamp,
+                        bool is_compressed, const common::Deadline& deadline);
+
+  /// Decode a compressed image and process it, see \ref work for the parameters.
+  void decodeAndWork(size_t camera_index, const cv::Mat& data, int64_t timestamp_nanoseconds,
+                     int64_t enqueue_time_nanoseconds, const common::Deadline& deadline,
+                     const std::shared_ptr<PreallocatedSlots>& slots,
+                     const std::shared_ptr<VisualFrame>& frame);
+
+  /// Decode a compressed image into a recycled buffer of the camera.
+  /// @return False if the image could not be decoded or doesn't have the input camera size.
+  bool decodeImage(size_t camera_index, const cv::Mat& data, cv::Mat* image);
+
+  /// The enqueue time of the trace events and the worker scaling, -1 if both are disabled.
+  int64_t recordEnqueueTraceEvent(size_t camera_index, int64_t timestamp);
+
+  /// Add the latency of a processed image to the worker scaling policy and apply its number of
+  /// workers to the shared pool.
+  void addWorkerScalingSample(int64_t enqueue_time_nanoseconds);
+
+  /// Add the memory usage to the statistics if the reporting period elapsed. The mutex must not
+  /// be locked.
+  void addPeriodicMemoryUsageToStatistics();
+
+  /// \brief Apply the in-flight limit to a new image, the mutex must be locked.
+  /// @return False if the image should not be processed.
+  bool admitImage(size_t camera_index, std::unique_lock<std::mutex>* lock);
+
+  /// \brief Apply the in-flight limit to a batch of images which is enqueued together, the mutex
+  ///        must be locked. Several images are only supported by the blocking producer policy.
+  /// @return False if the images should not be processed.
+  bool admitImages(size_t camera_index, size_t num_images, std::unique_lock<std::mutex>* lock);
+
+  /// Publish a completed nframe according to the output mode, the mutex must be locked.
+  void publishCompletedNFrame(int64_t timestamp_nanoseconds,
+                              const std::shared_ptr<VisualNFrame>& nframe);
+
+  /// \brief Queue a completed nframe for the pending futures or the callbacks, the mutex must be
+  ///        locked. It is delivered by deliverPendingNFrames().
+  /// @return False if there are neither, the nframe is published in the output mode then.
+  bool pushCompletedNFrame(int64_t timestamp_nanoseconds,
+                           const std::shared_ptr<VisualNFrame>& nframe);
+
+  /// \brief Fulfill the futures and enqueue the callbacks of the queued nframes while the mutex
+  ///        is released. The lock must own the mutex and owns it again on return.
+  ///
+  /// Only one thread delivers at a time and picks up the nframes the other threads queue in the
+  /// meantime, which keeps the nframes of every callback in chronological order.
+  void deliverPendingNFrames(std::unique_lock<std::mutex>* lock);
+
+  /// \brief Find the processing nframe within the timestamp tolerance or add a new one, the mutex
+  ///        must be locked.
+  TimestampProcessingNFrameMap::iterator findOrAddProcessingNFrame(
+      int64_t timestamp_nanoseconds, bool* is_new);
+
+  /// \brief Reserve the slot of a camera in the preallocated nframe of the timestamp, the mutex
+  ///        must be locked.
+  /// @return Null if the slot was already reserved, the image is dropped in that case.
+  std::shared_ptr<PreallocatedSlots> reserveNFrameSlot(
+      size_t camera_index, int64_t timestamp_nanoseconds, std::shared_ptr<VisualFrame>* frame);
+
+  /// Remove a processing nframe from the map and the synchronization index, the mutex must be
+  /// locked.
+  TimestampProcessingNFrameMap::iterator eraseProcessingNFrame(
+      TimestampProcessingNFrameMap::iterator it);
+
+  /// Drop nframes that can't complete anymore and publish the completed nframes in chronological
+  /// order, the mutex must be locked.
+  void publishCompletedNFrames(size_t camera_index);
+
+  /// The intra-rig matching state of a new nframe, null if the matching is disabled.
+  std::shared_ptr<IntraRigMatchingState> createIntraRigMatchingState(
+      const std::shared_ptr<VisualNFrame>& nframe) const;
+
+  /// \brief Count the frame of the camera in its pairs and match the pairs whose other frame is
+  ///        already set. The last matched pair stores the matches of all pairs in the nframe.
+  void matchIntraRigPairs(size_t camera_index, const std::shared_ptr<const VisualFrame>& frame,
+                          IntraRigMatchingState* state) const;
+
+  /// Count the frames of a dropped nframe.
+  void countDroppedFrames(const VisualNFrame& nframe, size_t FrameDropCounters::*counter);
+  /// Same as above, only the completed slots of a preallocated nframe are counted.
+  void countDroppedFrames(const ProcessingNFrame& processing_nframe,
+                          size_t FrameDropCounters::*counter);
+
+  /// A callback of addNFrameCallback().
+  struct NFrameCallbackEntry {
+    size_t id;
+    /// The exclusivity group of the callback on the executor, see
+    /// ThreadPool::reserveExclusivityGroupId().
+    size_t exclusivity_group_id;
+    NFrameCallback callback;
+    std::shared_ptr<ThreadPool> executor;
+  };
+  /// The callbacks are replaced instead of modified, such that the queued nframes keep the
+  /// callbacks registered at their completion.
+  typedef std::shared_ptr<const std::vector<NFrameCallbackEntry>> NFrameCallbacks;
+  typedef std::promise<std::shared_ptr<VisualNFrame>> NFramePromise;
+  typedef std::pair<NFramePromise, std::shared_ptr<VisualNFrame>> NFramePromiseDelivery;
+  typedef std::pair<NFrameCallbacks, std::shared_ptr<VisualNFrame>> NFrameCallbackDelivery;
 
   /// One visual pipeline for each camera.
   std::vector<std::shared_ptr<VisualPipeline>> pipelines_;
@@ -185,17 +707,87 @@ class VisualNPipeline final {
   std::condition_variable condition_not_full_;
   /// Condition variable signaling that the output queue is not empty.
   std::condition_variable condition_not_empty_;
+  /// Condition variable signaling that the number of in-flight items decreased.
+  std::condition_variable condition_in_flight_decreased_;
   /// A flag indicating a system shutdown.
   std::atomic<bool> shutdown_;
 
   typedef std::map<int64_t, std::shared_ptr<VisualNFrame>> TimestampVisualNFrameMap;
   /// The frames that are in progress.
-  TimestampVisualNFrameMap processing_;
+  TimestampProcessingNFrameMap processing_;
+  /// Whether the nframes are preallocated when the first image is admitted.
+  bool preallocate_nframes_;
+  /// Whether the camera pipelines run in a steady state scope.
+  bool check_steady_state_allocations_;
   /// The output queue of completed frames.
   TimestampVisualNFrameMap completed_;
 
+  typedef std::pair<int64_t, std::shared_ptr<VisualNFrame>> TimestampVisualNFramePair;
+  OutputMode output_mode_;
+  /// The lock-free output queue, only set in the kLockFreeQueue mode. The workers push while
+  /// holding the mutex, which leaves a single producer.
+  std::unique_ptr<common::SpscQueue<TimestampVisualNFramePair>> lock_free_queue_;
+  /// The latest completed nframe in the kLockFreeLatest mode, owned by the slot. Null if empty.
+  std::atomic<TimestampVisualNFramePair*> latest_nframe_;
+
+  /// The callbacks of the completed nframes, never null, guarded by the mutex.
+  NFrameCallbacks nframe_callbacks_;
+  /// The id of the next callback, guarded by the mutex.
+  size_t next_nframe_callback_id_;
+  /// The pending futures of getNextAsync(), oldest first, guarded by the mutex.
+  std::deque<NFramePromise> nframe_promises_;
+  /// The nframes queued by pushCompletedNFrame() in chronological order, guarded by the mutex.
+  std::vector<NFramePromiseDelivery> pending_nframe_promises_;
+  std::vector<NFrameCallbackDelivery> pending_nframe_callbacks_;
+  /// Whether a thread runs deliverPendingNFrames(), guarded by the mutex.
+  bool is_delivering_nframes_;
+  /// The nframes being delivered, only used by the delivering thread. Kept to reuse the memory.
+  std::vector<NFramePromiseDelivery> delivered_nframe_promises_;
+  std::vector<NFrameCallbackDelivery> delivered_nframe_callbacks_;
+
+  /// The number of images in the thread pool. Atomic as the workers of preallocated nframes
+  /// decrement it without the mutex.
+  std::atomic<size_t> num_images_queued_;
+  /// The maximum number of in-flight items, 0 if unbounded.
+  std::atomic<size_t> max_num_in_flight_;
+  InFlightPolicy in_flight_policy_;
+  /// The deadline budget of every frame, 0 if the frames have no deadline.
+  std::atomic<int64_t> frame_processing_budget_nanoseconds_;
+  /// The period of the memory usage reports, 0 if disabled, and the time of the next report.
+  std::atomic<int64_t> memory_usage_reporting_period_nanoseconds_;
+  std::atomic<int64_t> next_memory_usage_report_nanoseconds_;
+  /// The frame drop counters of every camera.
+  std::vector<FrameDropCounters> frame_drop_counters_;
+
+  /// Pools of recycled frames for every camera, empty if recycling is disabled.
+  std::vector<std::unique_ptr<common::ObjectPool<VisualFrame>>> frame_pools_;
+  /// Pool of recycled nframes, null if recycling is disabled.
+  std::unique_ptr<common::ObjectPool<VisualNFrame>> nframe_pool_;
+
+  /// The decoder of the compressed images of every camera.
+  std::vector<ImageDecoder::Ptr> image_decoders_;
+  /// Pools of the decoded images of every camera.
+  std::vector<std::unique_ptr<common::ObjectPool<cv::Mat>>> decoded_image_pools_;
+
   /// A thread pool for processing.
   std::shared_ptr<aslam::ThreadPool> thread_pool_;
+  SchedulingMode scheduling_mode_;
+  /// One single threaded pool per camera in the kPerCameraWorker mode, empty otherwise.
+  std::vector<std::shared_ptr<aslam::ThreadPool>> camera_thread_pools_;
+  /// The NUMA node of every camera of setNumaPlacement(), empty if not placed.
+  std::vector<size_t> camera_numa_nodes_;
+
+  /// The number of active workers of the shared pool, null if the worker scaling is disabled.
+  std::unique_ptr<WorkerScalingPolicy> worker_scaling_policy_;
+  /// Protects the policy, which is shared by the workers.
+  std::mutex worker_scaling_mutex_;
+  std::atomic<bool> is_worker_scaling_enabled_;
+
+  /// The camera pairs of the intra-rig matching and their matchers, empty if disabled.
+  std::vector<std::pair<size_t, size_t>> intra_rig_camera_pairs_;
+  std::vector<EpipolarBandMatcher::Ptr> intra_rig_matchers_;
+  /// The indices of the pairs every camera is part of.
+  std::vector<std::vector<size_t>> camera_intra_rig_pair_indices_;
 
   /// The camera system of the raw images.
   std::shared_ptr<NCamera> input_camera_system_;
@@ -204,6 +796,9 @@ class VisualNPipeline final {
 
   /// The tolerance for associating host timestamps as being captured at the same time
   int64_t timestamp_tolerance_ns_;
+  /// The processing nframes by timestamp bucket, such that the nframe of an image is found in
+  /// constant time.
+  TimestampBucketIndex<TimestampProcessingNFrameMap::iterator> processing_index_;
 };
 }  // namespace aslam
 #endif // VISUAL_NPIPELINE_H_
@@ -1,6 +1,9 @@
 #ifndef ASLAM_BRISK_PIPELINE_H_
 #define ASLAM_BRISK_PIPELINE_H_
 
+#include <memory>
+#include <mutex>
+
 #include <aslam/pipeline/visual-pipeline.h>
 #include <aslam/pipeline/visual-pipeline-null.h>
 
@@ -10,6 +13,7 @@ class Feature2D;
 
 namespace aslam {
 
+class CudaImageCache;
 class Undistorter;
 
 /// \class BriskVisualPipeline
@@ -75,6 +79,39 @@ public:
                        double absolute_threshold, size_t max_number_of_keypoints,
                        bool rotation_invariant, bool scale_invariant);
 
+  /// \brief Limit the number of described keypoints per frame.
+  ///
+  /// The detected keypoints are thinned out to a spatially uniform subset of the strongest
+  /// keypoints using an occupancy grid before the descriptors are computed. The detection
+  /// threshold is adapted after each frame such that the detector returns roughly
+  /// keypoint_budget * kDetectionOversamplingFactor keypoints.
+  ///
+  /// \param[in] keypoint_budget        The maximum number of keypoints to describe per frame.
+  ///                                   Zero disables the budget.
+  /// \param[in] grid_cell_size_pixels  The side length of the occupancy grid cells.
+  /// \param[in] min_detection_threshold Lower bound for the adapted detection threshold.
+  /// \param[in] max_detection_threshold Upper bound for the adapted detection threshold.
+  void setKeypointBudget(size_t keypoint_budget, double grid_cell_size_pixels,
+                         double min_detection_threshold, double max_detection_threshold);
+
+  /// Get the current (adapted) detection threshold of the keypoint budget mode.
+  double getAdaptiveDetectionThreshold() const;
+
+  /// \brief Detect the keypoints with the CUDA FAST detector instead of the BRISK detector. The
+  ///        descriptors are still computed on the CPU. Keeps the CPU detection if the CUDA
+  ///        backend is not available, see isCudaBackendAvailable().
+  ///
+  /// The FAST threshold is fixed, the keypoint budget is applied to the detections but doesn't
+  /// adapt the threshold.
+  /// \param[in] fast_threshold  The FAST intensity threshold.
+  /// \param[in] device_images   If set, the uploaded images are stored for later stages such
+  ///                            as the GyroTracker. Images a CudaMappedUndistorter stored in
+  ///                            the same cache are not uploaded again. Can be null.
+  void enableCudaDetection(int fast_threshold,
+                           const std::shared_ptr<CudaImageCache>& device_images);
+
+  bool isCudaDetectionEnabled() const { return use_cuda_detection_; }
+
 protected:
   /// \brief Process the frame and fill the results into the frame variable
   ///
@@ -84,6 +121,17 @@ protected:
   virtual void processFrameImpl(const cv::Mat& image,
                                 VisualFrame* frame) const;
 private:
+  std::shared_ptr<cv::Feature2D> createDetector(double threshold) const;
+
+  /// Adapt the detection threshold towards the targeted number of detections, scaled by the
+  /// ratio of the image area that was searched.
+  void updateAdaptiveDetectionThreshold(size_t num_detected_keypoints,
+                                        double detection_area_ratio) const;
+
+  /// Upload the image and detect FAST keypoints on the device.
+  void detectKeypointsCuda(const cv::Mat& image, const FrameId& frame_id,
+                           std::vector<cv::KeyPoint>* keypoints) const;
+
   std::shared_ptr<cv::Feature2D> detector_;
   std::shared_ptr<cv::Feature2D> extractor_;
 
@@ -93,6 +141,26 @@ private:
   size_t max_number_of_keypoints_;
   bool rotation_invariant_;
   bool scale_invariant_;
+
+  /// Keypoint budget mode, disabled if the budget is zero.
+  size_t keypoint_budget_;
+  double budget_grid_cell_size_pixels_;
+  double min_detection_threshold_;
+  double max_detection_threshold_;
+  /// The detection threshold adapted over time. Guarded by the mutex as frames of the same
+  /// camera may be processed concurrently.
+  mutable std::mutex adaptive_threshold_mutex_;
+  mutable double adaptive_detection_threshold_;
+
+  /// CUDA detection mode.
+  bool use_cuda_detection_;
+  int cuda_fast_threshold_;
+  std::shared_ptr<CudaImageCache> cuda_device_images_;
+
+  /// Detect more keypoints than the budget such that the grid can pick a uniform subset.
+  static constexpr double kDetectionOversamplingFactor = 1.5;
+  /// Size of the device keypoint buffer of the CUDA detector.
+  static constexpr int kCudaMaxNumDetections = 20000;
 };
 
 }  // namespace aslam
@@ -0,0 +1,114 @@
+#ifndef ASLAM_FAST_BRIEF_PIPELINE_H_
+#define ASLAM_FAST_BRIEF_PIPELINE_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <aslam/pipeline/visual-pipeline.h>
+
+namespace aslam {
+
+class Undistorter;
+
+/// \class FastBriefVisualPipeline
+/// \brief A lightweight visual pipeline for low-power platforms: FAST corners spread over the
+///        image with an occupancy grid, described with rotation-aware BRIEF descriptors.
+///
+/// The keypoints are detected on a single scale, hence the descriptors are not scale invariant.
+/// The orientation of a keypoint is the intensity centroid of a circular patch. The 256 intensity
+/// comparisons of the descriptor are rotated to the orientation, which is quantized to
+/// kNumOrientationBins steps such that the rotated patterns are computed only once. The
+/// comparisons run on a smoothed copy of the image, 16 at a time with SSE2 or NEON.
+///
+/// The descriptors are kDescriptorSizeBytes = 32 bytes long, the matchers use the Hamming kernels
+/// specialized for this size, see common::Hamming::getFixedSizeBatchFunction().
+class FastBriefVisualPipeline : public VisualPipeline {
+public:
+  ASLAM_POINTER_TYPEDEFS(FastBriefVisualPipeline);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(FastBriefVisualPipeline);
+
+  struct Options {
+    Options()
+        : fast_threshold(20), max_num_keypoints(1000u), grid_cell_size_pixels(40.0),
+          smoothing_kernel_size(7), smoothing_sigma(2.0), rotation_invariant(true) {}
+    /// The FAST intensity threshold. Low makes more keypoints.
+    int fast_threshold;
+    /// The maximum number of keypoints to describe per frame, selected with an occupancy grid.
+    /// Zero keeps all detections.
+    size_t max_num_keypoints;
+    /// The side length of the occupancy grid cells.
+    double grid_cell_size_pixels;
+    /// Size of the Gaussian kernel the image is smoothed with before the description. An odd
+    /// number, 0 or 1 describes the unsmoothed image.
+    int smoothing_kernel_size;
+    double smoothing_sigma;
+    /// Should the keypoint orientation be estimated and the descriptor rotated?
+    bool rotation_invariant;
+  };
+
+  static constexpr int kDescriptorSizeBytes = 32;
+  static constexpr int kNumOrientationBins = 32;
+
+protected:
+  /// Constructor for serialization.
+  FastBriefVisualPipeline();
+
+public:
+  /// \brief Initialize the FAST/BRIEF pipeline with a camera.
+  ///
+  /// \param[in] camera       The intrinsic calibration of this camera.
+  /// \param[in] copy_images  Should we deep copy the images passed in?
+  /// \param[in] options      Detection and description options.
+  FastBriefVisualPipeline(const Camera::ConstPtr& camera, bool copy_images,
+                          const Options& options);
+
+  /// \brief Initialize the FAST/BRIEF pipeline with a preprocessing pipeline.
+  ///
+  /// \param[in] preprocessing  An undistorter to do preprocessing such as
+  ///                           contrast enhancement or undistortion.
+  /// \param[in] copy_images    Should we deep copy the images passed in?
+  /// \param[in] options        Detection and description options.
+  FastBriefVisualPipeline(std::unique_ptr<Undistorter>& preprocessing, bool copy_images,
+                          const Options& options);
+
+  virtual ~FastBriefVisualPipeline();
+
+  const Options& getOptions() const { return options_; }
+
+protected:
+  /// \brief Process the frame and fill the results into the frame variable
+  ///
+  /// The top level function will already fill in the timestamps and the output camera.
+  /// \param[in]     image The image data.
+  /// \param[in/out] frame The visual frame. This will be constructed before calling.
+  virtual void processFrameImpl(const cv::Mat& image,
+                                VisualFrame* frame) const;
+
+private:
+  /// A point of the comparison pattern relative to the keypoint.
+  struct PatternPoint {
+    int8_t x;
+    int8_t y;
+  };
+
+  void initialize(const Options& options);
+
+  /// Set the orientations of the keypoints and compute their descriptors in the smoothed image.
+  /// The rotated patterns of the keypoints must lie within the image.
+  void describeKeypoints(const cv::Mat& smoothed_image, std::vector<cv::KeyPoint>* keypoints,
+                         VisualFrame::DescriptorsT* descriptors) const;
+
+  /// The orientation of the keypoint in degrees, in [0, 360).
+  float computeOrientation(const unsigned char* center, int row_stride) const;
+
+  Options options_;
+  /// The comparison pairs of the descriptor, rotated to every orientation bin.
+  std::vector<PatternPoint> rotated_patterns_;
+  /// Half width of every row of the circular patch of the orientation, from the center row on.
+  std::vector<int> orientation_patch_half_widths_;
+};
+
+}  // namespace aslam
+
+#endif // ASLAM_FAST_BRIEF_PIPELINE_H_
@@ -1,6 +1,10 @@
 #ifndef ASLAM_FREAK_PIPELINE_H_
 #define ASLAM_FREAK_PIPELINE_H_
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include <aslam/pipeline/visual-pipeline.h>
 #include <aslam/pipeline/visual-pipeline-null.h>
 
@@ -10,6 +14,7 @@ class Feature2D;
 
 namespace aslam {
 
+class ThreadPool;
 class Undistorter;
 
 /// \class FreakVisualPipeline
@@ -70,6 +75,15 @@ public:
                        int num_octave_layers, bool rotation_invariant,
                        bool scale_invariant, float pattern_scale);
 
+  /// \brief Parallelize the processing of a single frame to reduce its latency.
+  ///
+  /// The SURF detection runs on overlapping horizontal image tiles and the FREAK extraction on
+  /// chunks of the keypoints, both with one task per thread. The detectors, extractors and
+  /// intermediate buffers of the tasks are kept between frames. Frames of this pipeline are
+  /// processed one at a time in this mode.
+  /// \param[in] num_threads Number of threads that process a frame. 0 or 1 processes serially.
+  void setNumInternalThreads(size_t num_threads);
+
 
   /// \brief Process the frame and fill the results into the frame variable
   ///
@@ -79,9 +93,30 @@ public:
   virtual void processFrameImpl(const cv::Mat& image,
                                 VisualFrame* frame) const;
 private:
+  std::shared_ptr<cv::Feature2D> createDetector() const;
+  std::shared_ptr<cv::Feature2D> createExtractor() const;
+
+  /// Detect on tiles and describe on keypoint chunks using the internal thread pool. The
+  /// detection mask may be empty.
+  void detectAndDescribeParallel(const cv::Mat& image, const cv::Mat& detection_mask,
+                                 int64_t timestamp_nanoseconds,
+                                 std::vector<cv::KeyPoint>* keypoints,
+                                 cv::Mat* descriptors) const;
+
   std::shared_ptr<cv::Feature2D> detector_;
   std::shared_ptr<cv::Feature2D> extractor_;
 
+  /// Internal parallel mode. One detector and extractor per task as the FREAK extractor builds
+  /// its pattern lookup table lazily on the first call.
+  size_t num_internal_threads_;
+  std::unique_ptr<ThreadPool> internal_thread_pool_;
+  std::vector<std::shared_ptr<cv::Feature2D>> task_detectors_;
+  std::vector<std::shared_ptr<cv::Feature2D>> task_extractors_;
+  mutable std::vector<std::vector<cv::KeyPoint>> task_keypoints_;
+  mutable std::vector<cv::Mat> task_descriptors_;
+  /// Serializes the frames using the task buffers above.
+  mutable std::mutex internal_parallel_mutex_;
+
   size_t octaves_;
   int hessian_threshold_;
   int num_octave_layers_;
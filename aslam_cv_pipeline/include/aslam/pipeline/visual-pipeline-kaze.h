@@ -0,0 +1,69 @@
+#ifndef ASLAM_KAZE_PIPELINE_H_
+#define ASLAM_KAZE_PIPELINE_H_
+
+#include <memory>
+
+#include <aslam/pipeline/visual-pipeline.h>
+#include <kaze/KAZEConfig.h>
+
+namespace aslam {
+
+class KazeInstancePool;
+class Undistorter;
+
+/// \class KazeVisualPipeline
+/// \brief A visual pipeline to extract KAZE features.
+///
+/// Frames can be processed by several threads at the same time. Every frame is detected with a
+/// KAZE object of a KazeInstancePool, which keeps the nonlinear scale space allocated between
+/// the frames. The pool keeps one released object per hardware thread.
+///
+/// KAZE descriptors are vectors of 64 or 128 floats, depending on the descriptor type. They
+/// are stored in the float descriptors of the frame (see VisualFrame::getFloatDescriptors()),
+/// the frames have no binary descriptors.
+class KazeVisualPipeline : public VisualPipeline {
+public:
+  ASLAM_POINTER_TYPEDEFS(KazeVisualPipeline);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(KazeVisualPipeline);
+
+protected:
+  /// Constructor for serialization.
+  KazeVisualPipeline();
+
+public:
+  /// \brief Initialize the KAZE pipeline with a camera.
+  ///
+  /// \param[in] camera       The intrinsic calibration of this camera.
+  /// \param[in] copy_images  Should we deep copy the images passed in?
+  /// \param[in] options      KAZE options. The image size is taken from the images.
+  KazeVisualPipeline(const Camera::ConstPtr& camera, bool copy_images,
+                     const KAZEOptions& options);
+
+  /// \brief Initialize the KAZE pipeline with a preprocessing pipeline.
+  ///
+  /// \param[in] preprocessing  An undistorter to do preprocessing such as
+  ///                           contrast enhancement or undistortion.
+  /// \param[in] copy_images    Should we deep copy the images passed in?
+  /// \param[in] options        KAZE options. The image size is taken from the images.
+  KazeVisualPipeline(std::unique_ptr<Undistorter>& preprocessing, bool copy_images,
+                     const KAZEOptions& options);
+
+  virtual ~KazeVisualPipeline();
+
+  /// Number of KAZE objects that are ready for the next frames.
+  size_t getNumPooledKazeInstances() const;
+
+  /// \brief Process the frame and fill the results into the frame variable
+  ///
+  /// The top level function will already fill in the timestamps and the output camera.
+  /// \param[in]     image The image data.
+  /// \param[in/out] frame The visual frame. This will be constructed before calling.
+  virtual void processFrameImpl(const cv::Mat& image,
+                                VisualFrame* frame) const;
+private:
+  std::unique_ptr<KazeInstancePool> instance_pool_;
+};
+
+}  // namespace aslam
+
+#endif // ASLAM_KAZE_PIPELINE_H_
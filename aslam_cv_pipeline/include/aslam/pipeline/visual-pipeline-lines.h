@@ -0,0 +1,77 @@
+#ifndef ASLAM_LINE_PIPELINE_H_
+#define ASLAM_LINE_PIPELINE_H_
+
+#include <memory>
+#include <mutex>
+
+#include <aslam/detectors/line-segment-detector.h>
+#include <aslam/pipeline/visual-pipeline.h>
+
+namespace aslam {
+
+class Undistorter;
+
+/// \class LineVisualPipeline
+/// \brief A visual pipeline to extract line segments.
+///
+/// The segments are stored in the line segment channels of the frame, the segment length is
+/// used as score. An optional point pipeline, e.g. a BriskVisualPipeline, runs on the same
+/// image first, such that a VisualNPipeline extracts points and lines of a camera within the
+/// same task. The preprocessing of the point pipeline is not applied, the image is processed
+/// by the preprocessing of this pipeline only.
+///
+/// The segment detector is not thread-safe, frames of this pipeline are processed one at a
+/// time. Use the tiled mode of the detector to process a frame on several threads.
+class LineVisualPipeline : public VisualPipeline {
+public:
+  ASLAM_POINTER_TYPEDEFS(LineVisualPipeline);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(LineVisualPipeline);
+
+protected:
+  /// Constructor for serialization.
+  LineVisualPipeline();
+
+public:
+  /// \brief Initialize the line pipeline with a camera.
+  ///
+  /// \param[in] camera          The intrinsic calibration of this camera.
+  /// \param[in] copy_images     Should we deep copy the images passed in?
+  /// \param[in] options         Options of the line segment detector.
+  /// \param[in] point_pipeline  Pipeline that extracts the points of the frame. Can be null.
+  LineVisualPipeline(const Camera::ConstPtr& camera, bool copy_images,
+                     const LineSegmentDetector::Options& options,
+                     const VisualPipeline::Ptr& point_pipeline);
+
+  /// \brief Initialize the line pipeline with a preprocessing pipeline.
+  ///
+  /// \param[in] preprocessing   An undistorter to do preprocessing such as
+  ///                            contrast enhancement or undistortion.
+  /// \param[in] copy_images     Should we deep copy the images passed in?
+  /// \param[in] options         Options of the line segment detector.
+  /// \param[in] point_pipeline  Pipeline that extracts the points of the frame. Can be null.
+  LineVisualPipeline(std::unique_ptr<Undistorter>& preprocessing, bool copy_images,
+                     const LineSegmentDetector::Options& options,
+                     const VisualPipeline::Ptr& point_pipeline);
+
+  virtual ~LineVisualPipeline();
+
+  /// \brief Process the frame and fill the results into the frame variable
+  ///
+  /// The top level function will already fill in the timestamps and the output camera.
+  /// \param[in]     image The image data.
+  /// \param[in/out] frame The visual frame. This will be constructed before calling.
+  virtual void processFrameImpl(const cv::Mat& image,
+                                VisualFrame* frame) const;
+private:
+  void initializeLines(const LineSegmentDetector::Options& options);
+
+  std::unique_ptr<LineSegmentDetector> line_detector_;
+  /// Serializes the frames using the detector.
+  mutable std::mutex line_detector_mutex_;
+
+  VisualPipeline::Ptr point_pipeline_;
+};
+
+}  // namespace aslam
+
+#endif // ASLAM_LINE_PIPELINE_H_
@@ -2,11 +2,16 @@
 #define VISUAL_PROCESSOR_H
 
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 
 #include <aslam/cameras/camera.h>
 #include <aslam/common/macros.h>
+#include <aslam/common/object-pool.h>
+#include <aslam/pipeline/subpixel-refinement.h>
 #include <aslam/pipeline/undistorter.h>
 #include <aslam/frames/visual-frame.h>
 
@@ -32,8 +37,29 @@ public:
   ASLAM_POINTER_TYPEDEFS(VisualPipeline);
   ASLAM_DISALLOW_EVIL_CONSTRUCTORS(VisualPipeline);
 
+  /// \brief Image preprocessing applied after the undistortion, see setImagePreprocessing().
+  ///        The steps run in the order downsampling, CLAHE, gamma correction.
+  struct ImagePreprocessingSettings {
+    ImagePreprocessingSettings()
+        : num_downsample_levels(0), clahe_clip_limit(0.0), clahe_tile_grid_size(8, 8),
+          gamma(1.0) {}
+    /// How often the image is halved with cv::pyrDown, 0 disables the downsampling. The output
+    /// camera must have the resolution of the downsampled image.
+    int num_downsample_levels;
+    /// Contrast limit of the contrast limited adaptive histogram equalization, 0 disables it.
+    double clahe_clip_limit;
+    cv::Size clahe_tile_grid_size;
+    /// The intensities are mapped to 255 * (intensity / 255)^gamma, 1 disables the correction.
+    double gamma;
+
+    bool isEnabled() const {
+      return num_downsample_levels > 0 || clahe_clip_limit > 0.0 || gamma != 1.0;
+    }
+  };
+
 protected:
-  VisualPipeline() : copy_images_(false) {};
+  VisualPipeline()
+      : copy_images_(false), image_pyramid_max_level_(-1), subpixel_refinement_enabled_(false) {}
 
 public:
   /// \brief Construct a visual pipeline from the input and output cameras
@@ -58,11 +84,27 @@ public:
   /// The processor then processes the images and constructs a VisualFrame.
   /// This method constructs a basic frame and passes it on to processFrame().
   ///
+  /// Within a common::DeadlineScope the processing degrades as the deadline approaches: the
+  /// pipelines describe fewer keypoints (see capKeypointsToDeadline()) and the subpixel
+  /// refinement is skipped once the deadline expired. The applied degradations are stored in
+  /// the frame, see VisualFrame::getDegradations().
+  ///
   /// \param[in] image          The image data.
   /// \param[in] timestamp      The time in integer nanoseconds.
   /// \returns                  The visual frame built from the image data.
   VisualFrame::Ptr processImage(const cv::Mat& image, int64_t timestamp) const;
 
+  /// \brief Same as \ref processImage but fills the given frame, e.g. a frame recycled from a
+  ///        pool. The id, timestamp, cameras and raw image of the frame are overwritten, other
+  ///        channels are left to processFrameImpl().
+  ///
+  /// \param[in] image          The image data.
+  /// \param[in] timestamp      The time in integer nanoseconds.
+  /// \param[in] frame          The frame to fill.
+  /// \returns                  The visual frame built from the image data.
+  VisualFrame::Ptr processImage(const cv::Mat& image, int64_t timestamp,
+                                const VisualFrame::Ptr& frame) const;
+
   /// \brief Get the input camera that corresponds to the image
   ///        passed in to processImage().
   ///
@@ -91,6 +133,84 @@ public:
   /// rectification, the input and output camera may not be the same.
   Camera::ConstPtr getOutputCameraShared() const { return output_camera_; }
 
+  /// \brief Store an image pyramid of the processed image in every frame, such that stages like
+  ///        the Lucas-Kanade tracking don't have to rebuild it for every frame pair.
+  ///
+  /// \param[in] window_size The Lucas-Kanade window size the pyramid is padded for.
+  /// \param[in] max_level   The highest pyramid level, a negative value disables the pyramid.
+  void setImagePyramidSettings(const cv::Size& window_size, int max_level) {
+    image_pyramid_window_size_ = window_size;
+    image_pyramid_max_level_ = max_level;
+  }
+
+  /// \brief Refine the keypoints of every frame to subpixel accuracy after processFrameImpl(),
+  ///        see refineFrameKeypointsSubpixel(). The gradients of the image pyramid are reused if
+  ///        setImagePyramidSettings() enabled it. Must not be called while images are processed.
+  void setSubpixelRefinement(const SubpixelRefinementSettings& settings) {
+    subpixel_refinement_settings_ = settings;
+    subpixel_refinement_enabled_ = true;
+  }
+  void disableSubpixelRefinement() { subpixel_refinement_enabled_ = false; }
+
+  /// \brief Configure the preprocessing of the (undistorted) image before processFrameImpl().
+  ///
+  /// The steps work on 8 bit gray images and write into buffers that are kept per pipeline and
+  /// reused for the next images. The gamma correction is a lookup table applied in place on the
+  /// output of the previous step, and the downsampling comes first such that the other steps run
+  /// on fewer pixels. The downsampling is not supported together with an undistorter, scale the
+  /// undistorter output instead (see createMappedUndistorter). Must not be called while images are
+  /// processed.
+  void setImagePreprocessing(const ImagePreprocessingSettings& settings);
+  const ImagePreprocessingSettings& getImagePreprocessing() const {
+    return image_preprocessing_settings_;
+  }
+
+  /// \brief Restrict the keypoint detection of the following images to the non-zero pixels of
+  ///        the mask, e.g. to the cells that are not occupied by tracked keypoints (see
+  ///        GyroTracker::getDetectionMask()). The descriptors are only computed for the detected
+  ///        keypoints, hence the description is restricted as well.
+  ///
+  /// The mask is copied and applies until it is replaced, it can be set while images are
+  /// processed.
+  /// \param[in] mask  An 8 bit mask of the size of the output camera, an empty mask enables the
+  ///                  detection in the whole image. (default)
+  void setDetectionMask(const cv::Mat& mask);
+
+  /// \brief Restrict the undistortion and processFrameImpl() to a rectangle of the output
+  ///        image, e.g. to skip the vehicle body or the borders of a fisheye circle.
+  ///
+  /// processFrameImpl() gets the sub-image and the detection mask of the rectangle, the keypoints
+  /// and line segments are moved back to the coordinates of the full image. A MappedUndistorter
+  /// only remaps the rectangle (see MappedUndistorter::setProcessingRoi), the other pixels of the
+  /// image are zero. The image pyramid and the subpixel refinement still use the full image as
+  /// the trackers work in its coordinates. Must not be called while images are processed.
+  /// \param[in] roi  A rectangle within the output image, an empty rectangle processes the full
+  ///                 image. (default)
+  void setProcessingRoi(const cv::Rect& roi);
+
+  /// \brief Restrict the processing to the bounding rectangle of the unmasked pixels of the output
+  ///        camera mask, see setProcessingRoi().
+  ///
+  /// \param[in] border_pixels  Margin around the unmasked pixels, e.g. the border size of the
+  ///                           detector such that keypoints next to the mask are still found.
+  void setProcessingRoiFromCameraMask(int border_pixels);
+  const cv::Rect& getProcessingRoi() const { return processing_roi_; }
+
+  /// \brief The bounding rectangle of the non-zero pixels of a mask, grown by the border and
+  ///        clipped to the mask. Empty if all pixels are masked.
+  static cv::Rect computeMaskBoundingRoi(const cv::Mat& mask, int border_pixels);
+
+  /// \brief Memory of the pipeline: the undistorter, the detection mask and the recycled
+  ///        preprocessing buffers. Pipelines with a large detector state add it.
+  virtual size_t getMemoryUsageBytes() const;
+
+  /// \brief Bind the memory that is created up front to a NUMA node, by default the maps of the
+  ///        undistorter (see Undistorter::bindMemoryToNumaNode). The image buffers are written
+  ///        by the workers, which place them on their node on the first touch. Must not be
+  ///        called while images are processed.
+  /// @return False if binding failed.
+  virtual bool bindMemoryToNumaNode(size_t node);
+
 protected:
   /// \brief Process the frame and fill the results into the frame variable.
   ///
@@ -101,6 +221,34 @@ protected:
   virtual void processFrameImpl(const cv::Mat& image,
                                 VisualFrame* frame) const = 0;
 
+  /// \brief Run processFrameImpl() of another pipeline on the image of this pipeline, e.g. to
+  ///        add the results of several pipelines to the same frame.
+  static void processFrameWith(const VisualPipeline& pipeline, const cv::Mat& image,
+                               VisualFrame* frame) {
+    pipeline.processFrameImpl(image, frame);
+  }
+
+  /// The detection mask of setDetectionMask(), empty if the whole image is searched. Cropped to
+  /// the processing rectangle if set.
+  cv::Mat getDetectionMask() const;
+
+  /// The fraction of the image area in which keypoints are detected, in [0, 1].
+  static double getDetectionAreaRatio(const cv::Mat& detection_mask);
+
+  /// \brief Select up to max_num_keypoints strong keypoints that are spread over the image. The
+  ///        budget is distributed evenly over the cells of an occupancy grid and the strongest
+  ///        keypoints (see cv::KeyPoint::response) win within a cell. The selected keypoints keep
+  ///        their order.
+  static void selectKeypointsInGrid(const cv::Size& image_size, double grid_cell_size_pixels,
+                                    size_t max_num_keypoints,
+                                    std::vector<cv::KeyPoint>* keypoints);
+
+  /// \brief Keep only the strongest keypoints if less than half of the budget of the current
+  ///        deadline is left, see common::DeadlineScope. The number of kept keypoints shrinks
+  ///        with the remaining budget down to a minimum, such that the tracking can go on.
+  ///        Records common::Degradation::kCappedKeypoints if keypoints were removed.
+  static void capKeypointsToDeadline(std::vector<cv::KeyPoint>* keypoints);
+
   /// \brief Preprocessing for the image. Can be null.
   const std::unique_ptr<Undistorter> preprocessing_;
   /// \brief The intrinsics of the raw image.
@@ -109,6 +257,42 @@ protected:
   std::shared_ptr<const Camera> output_camera_;
   /// \brief Should we copy the image before storing it in the frame?
   bool copy_images_;
+  /// \brief Settings of the image pyramid stored in the frames, see setImagePyramidSettings().
+  cv::Size image_pyramid_window_size_;
+  int image_pyramid_max_level_;
+  /// \brief Subpixel refinement of the keypoints, see setSubpixelRefinement().
+  SubpixelRefinementSettings subpixel_refinement_settings_;
+  bool subpixel_refinement_enabled_;
+
+private:
+  /// The intermediate images of one processImage() call, recycled for the next images.
+  struct ImageBuffers {
+    cv::Mat undistorted_image;
+    std::vector<cv::Mat> downsampled_images;
+    cv::Mat equalized_image;
+    cv::Mat gamma_corrected_image;
+    /// CLAHE keeps internal buffers, hence every set of buffers has its own instance.
+    cv::Ptr<cv::CLAHE> clahe;
+  };
+
+  /// Run the preprocessing steps, image is replaced by the preprocessed image.
+  /// \param[in] may_modify_image Whether image is a buffer that may be overwritten.
+  void preprocessImage(bool may_modify_image, ImageBuffers* buffers, cv::Mat* image) const;
+
+  /// Move the keypoints and line segments of processFrameImpl() by the offset.
+  static void shiftFrameMeasurements(const Eigen::Vector2d& offset, VisualFrame* frame);
+
+  ImagePreprocessingSettings image_preprocessing_settings_;
+  /// The detection mask is replaced by the tracking loop while images are processed.
+  mutable std::mutex detection_mask_mutex_;
+  cv::Mat detection_mask_;
+  /// The rectangle of the output image passed to processFrameImpl(), empty for the full image.
+  cv::Rect processing_roi_;
+  /// Lookup table of the gamma correction.
+  cv::Mat gamma_lut_;
+  /// Thread-safe pool of buffers as images can be processed concurrently, only set if the
+  /// preprocessing is enabled.
+  std::unique_ptr<common::ObjectPool<ImageBuffers>> image_buffer_pool_;
 };
 }  // namespace aslam
 
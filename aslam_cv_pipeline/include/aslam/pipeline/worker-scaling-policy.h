@@ -0,0 +1,81 @@
+#ifndef ASLAM_PIPELINE_WORKER_SCALING_POLICY_H_
+#define ASLAM_PIPELINE_WORKER_SCALING_POLICY_H_
+
+#include <cstdint>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/statistics/histogram.h>
+
+namespace aslam {
+
+/// \class WorkerScalingPolicy
+/// \brief Chooses the number of active workers of a thread pool from the latency of the
+///        processed items and the number of items waiting for a worker.
+///
+/// The samples are collected over evaluation periods. A worker is added after a period in which
+/// the latency percentile exceeded scale_up_latency_fraction of the target or more items per
+/// active worker were waiting than allowed. A worker is only removed after
+/// num_periods_to_scale_down consecutive periods in which the latency percentile stayed below
+/// scale_down_latency_fraction of the target and no item was waiting. The gap between the two
+/// fractions and the number of periods keep the number of workers from oscillating. Periods
+/// without samples count as low load. Not thread-safe.
+class WorkerScalingPolicy {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(WorkerScalingPolicy);
+
+  struct Options {
+    Options()
+        : min_num_workers(1u), max_num_workers(0u), target_latency_nanoseconds(50000000),
+          latency_percentile(0.9), scale_up_latency_fraction(0.8),
+          scale_down_latency_fraction(0.4), max_num_waiting_items_per_worker(1.0),
+          evaluation_period_nanoseconds(100000000), num_periods_to_scale_down(10u) {}
+    /// The number of workers at the start and the lower bound.
+    size_t min_num_workers;
+    /// The upper bound, e.g. the number of cores the pipeline may use. 0 for all workers of
+    /// the pool.
+    size_t max_num_workers;
+    /// The latency the items should be processed within.
+    int64_t target_latency_nanoseconds;
+    /// The percentile of the latencies of a period compared to the target.
+    double latency_percentile;
+    double scale_up_latency_fraction;
+    double scale_down_latency_fraction;
+    /// A worker is added if the number of waiting items exceeds this times the active workers.
+    double max_num_waiting_items_per_worker;
+    int64_t evaluation_period_nanoseconds;
+    size_t num_periods_to_scale_down;
+  };
+
+  /// @param[in] options     The thresholds, see Options.
+  /// @param[in] num_threads The number of workers of the pool.
+  WorkerScalingPolicy(const Options& options, size_t num_threads);
+
+  /// \brief Add the latency of a processed item and evaluate the ended periods.
+  ///
+  /// @param[in] time_nanoseconds    The steady clock time of the sample, must not decrease.
+  /// @param[in] latency_nanoseconds The time from the enqueue until the item was processed.
+  /// @param[in] num_waiting_items   The number of items waiting for a worker.
+  /// @return True if the number of workers changed.
+  bool addSample(int64_t time_nanoseconds, int64_t latency_nanoseconds,
+                 size_t num_waiting_items);
+
+  size_t getNumWorkers() const { return num_workers_; }
+
+ private:
+  /// Apply the samples of the current period and start the next one.
+  void evaluatePeriod();
+
+  const Options options_;
+  const size_t max_num_workers_;
+  size_t num_workers_;
+
+  /// The start of the current period, -1 before the first sample.
+  int64_t period_start_time_nanoseconds_;
+  statistics::LogHistogram period_latencies_;
+  size_t max_num_waiting_items_in_period_;
+  size_t num_low_load_periods_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_PIPELINE_WORKER_SCALING_POLICY_H_
@@ -0,0 +1,68 @@
+#include "aslam/pipeline/cuda-image-cache.h"
+
+#include <glog/logging.h>
+
+namespace aslam {
+
+bool isCudaBackendAvailable() {
+#ifdef ASLAM_CV_WITH_CUDA
+  static const bool kHasCudaDevice = cv::cuda::getCudaEnabledDeviceCount() > 0;
+  return kHasCudaDevice;
+#else
+  return false;
+#endif
+}
+
+CudaImageCache::CudaImageCache(size_t capacity) : capacity_(capacity) {
+  CHECK_GT(capacity_, 0u);
+}
+
+void CudaImageCache::insert(const FrameId& frame_id, const cv::cuda::GpuMat& device_image) {
+  CHECK(frame_id.isValid());
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Entry& entry : entries_) {
+    if (entry.first == frame_id) {
+      entry.second = device_image;
+      return;
+    }
+  }
+  if (entries_.size() == capacity_) {
+    entries_.pop_front();
+  }
+  entries_.emplace_back(frame_id, device_image);
+}
+
+bool CudaImageCache::find(const FrameId& frame_id, cv::cuda::GpuMat* device_image) const {
+  CHECK_NOTNULL(device_image);
+  std::lock_guard<std::mutex> lock(mutex_);
+  // The cache only holds a few frames, the newest are looked up most often.
+  for (std::deque<Entry>::const_reverse_iterator it = entries_.rbegin(); it != entries_.rend();
+       ++it) {
+    if (it->first == frame_id) {
+      *device_image = it->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void CudaImageCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+}
+
+size_t CudaImageCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+size_t CudaImageCache::getDeviceMemoryUsageBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t num_bytes = 0u;
+  for (const Entry& entry : entries_) {
+    num_bytes += entry.second.step * static_cast<size_t>(entry.second.rows);
+  }
+  return num_bytes;
+}
+
+}  // namespace aslam
@@ -0,0 +1,70 @@
+#include "aslam/pipeline/image-buffer.h"
+
+#include <glog/logging.h>
+
+namespace aslam {
+namespace {
+
+/// Allocator of cv::Mat headers around external buffers. It never allocates pixels itself but
+/// calls the deleter stored in the user data once the reference count drops to zero.
+class ExternalBufferAllocator : public cv::MatAllocator {
+ public:
+  cv::UMatData* allocate(int /*dims*/, const int* /*sizes*/, int /*type*/, void* /*data*/,
+                         size_t* /*step*/, int /*flags*/,
+                         cv::UMatUsageFlags /*usage_flags*/) const override {
+    LOG(FATAL) << "The external buffer allocator can't allocate new pixel buffers.";
+    return nullptr;
+  }
+
+  bool allocate(cv::UMatData* /*data*/, int /*access_flags*/,
+                cv::UMatUsageFlags /*usage_flags*/) const override {
+    return false;
+  }
+
+  cv::UMatData* wrap(void* data, size_t num_bytes, const ImageBufferDeleter& deleter) const {
+    cv::UMatData* u = new cv::UMatData(this);
+    u->data = u->origdata = static_cast<uchar*>(data);
+    u->size = num_bytes;
+    u->userdata = new ImageBufferDeleter(deleter);
+    return u;
+  }
+
+  void deallocate(cv::UMatData* u) const override {
+    if (u == nullptr) {
+      return;
+    }
+    CHECK_EQ(u->refcount, 0);
+    CHECK_EQ(u->urefcount, 0);
+    ImageBufferDeleter* deleter = static_cast<ImageBufferDeleter*>(u->userdata);
+    CHECK_NOTNULL(deleter);
+    if (*deleter) {
+      (*deleter)(u->origdata);
+    }
+    delete deleter;
+    delete u;
+  }
+};
+
+ExternalBufferAllocator& getExternalBufferAllocator() {
+  // Never destroyed as images may outlive static destruction order.
+  static ExternalBufferAllocator* allocator = new ExternalBufferAllocator;
+  return *allocator;
+}
+
+}  // namespace
+
+cv::Mat wrapImageBuffer(int rows, int cols, int type, void* data, size_t step,
+                        const ImageBufferDeleter& deleter) {
+  CHECK_NOTNULL(data);
+  CHECK_GT(rows, 0);
+  CHECK_GT(cols, 0);
+  cv::Mat image(rows, cols, type, data, step);
+  ExternalBufferAllocator& allocator = getExternalBufferAllocator();
+  // Only the buffer data refers to the allocator, reallocations of the header (e.g. through
+  // cv::Mat::create) use the default allocator.
+  image.u = allocator.wrap(data, image.step[0] * rows, deleter);
+  image.addref();
+  return image;
+}
+
+}  // namespace aslam
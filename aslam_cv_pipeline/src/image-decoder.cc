@@ -0,0 +1,43 @@
+#include "aslam/pipeline/image-decoder.h"
+
+#include <glog/logging.h>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+
+namespace aslam {
+namespace {
+
+int getImreadFlags(const OpenCvImageDecoder::Options& options) {
+  switch (options.scale_denominator) {
+    case 1:
+      return options.grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+    case 2:
+      return options.grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+    case 4:
+      return options.grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+    case 8:
+      return options.grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+    default:
+      LOG(FATAL) << "Unsupported scale denominator " << options.scale_denominator
+                 << ", must be 1, 2, 4 or 8.";
+  }
+  return cv::IMREAD_UNCHANGED;
+}
+
+}  // namespace
+
+OpenCvImageDecoder::OpenCvImageDecoder(const Options& options)
+    : options_(options), imread_flags_(getImreadFlags(options)) {}
+
+bool OpenCvImageDecoder::decode(const cv::Mat& data, cv::Mat* image) const {
+  CHECK_NOTNULL(image);
+  CHECK_EQ(data.type(), CV_8UC1);
+  CHECK(data.empty() || data.isContinuous());
+  if (data.empty()) {
+    return false;
+  }
+  // Decodes into the pixels of the image if the size and type match. The image is left
+  // unchanged if the data can't be decoded, only the returned header is empty then.
+  return !cv::imdecode(data, imread_flags_, image).empty();
+}
+
+}  // namespace aslam
@@ -0,0 +1,279 @@
+#include "aslam/pipeline/sharded-batch-processor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <unordered_map>
+
+#include <aslam/frames/binary-serialization.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe-archive.h>
+#include <glog/logging.h>
+
+namespace aslam {
+namespace {
+// The merged track id of every track id of a shard, for one camera.
+typedef std::unordered_map<int, int> TrackIdMap;
+
+void addFrameToStatistics(const VisualFrame& frame, BatchShardStatistics* statistics) {
+  CHECK_NOTNULL(statistics);
+  if (frame.hasKeypointMeasurements()) {
+    statistics->num_keypoints += frame.getNumKeypointMeasurements();
+  }
+  if (frame.hasTrackIds()) {
+    const Eigen::VectorXi& track_ids = frame.getTrackIds();
+    statistics->num_tracked_keypoints +=
+        static_cast<size_t>((track_ids.array() >= 0).count());
+  }
+}
+
+// Map the track ids of the last warm-up nframe of a shard to the merged ids of the same
+// keypoints of the previous shard.
+void continueTracksOfPreviousShard(
+    const VisualNFrameArchive& previous_archive, const std::vector<TrackIdMap>& previous_track_ids,
+    const VisualNFrameArchive& archive, size_t warm_up_index, std::vector<TrackIdMap>* track_ids) {
+  CHECK_NOTNULL(track_ids);
+  const int64_t timestamp_nanoseconds = archive.getTimestampNanoseconds(warm_up_index);
+  const size_t previous_index = previous_archive.findFirstNFrameNotBefore(timestamp_nanoseconds);
+  if (previous_index == previous_archive.getNumNFrames() ||
+      previous_archive.getTimestampNanoseconds(previous_index) != timestamp_nanoseconds) {
+    // The shards don't overlap, e.g. without warm-up.
+    return;
+  }
+  BinaryVisualNFrameView nframe, previous_nframe;
+  archive.getNFrame(warm_up_index, &nframe);
+  previous_archive.getNFrame(previous_index, &previous_nframe);
+  CHECK_EQ(nframe.getNumFrames(), previous_nframe.getNumFrames());
+  for (size_t camera_index = 0u; camera_index < nframe.getNumFrames(); ++camera_index) {
+    if (!nframe.isFrameSet(camera_index) || !previous_nframe.isFrameSet(camera_index)) {
+      continue;
+    }
+    const BinaryVisualFrameView& frame = nframe.getFrame(camera_index);
+    const BinaryVisualFrameView& previous_frame = previous_nframe.getFrame(camera_index);
+    if (!frame.hasChannel("TRACK_IDS") || !previous_frame.hasChannel("TRACK_IDS")) {
+      continue;
+    }
+    const auto frame_track_ids = frame.getMatrixChannel<int>("TRACK_IDS");
+    const auto previous_frame_track_ids = previous_frame.getMatrixChannel<int>("TRACK_IDS");
+    if (frame_track_ids.size() != previous_frame_track_ids.size()) {
+      // E.g. a nondeterministic detector, the keypoints can't be associated by their index.
+      LOG(WARNING) << "The shards have different keypoints in camera " << camera_index << " at "
+                   << timestamp_nanoseconds << ", its tracks are not continued.";
+      continue;
+    }
+    for (int keypoint_index = 0; keypoint_index < frame_track_ids.size(); ++keypoint_index) {
+      if (frame_track_ids(keypoint_index) < 0 || previous_frame_track_ids(keypoint_index) < 0) {
+        continue;
+      }
+      const TrackIdMap::const_iterator it =
+          previous_track_ids[camera_index].find(previous_frame_track_ids(keypoint_index));
+      if (it != previous_track_ids[camera_index].end()) {
+        (*track_ids)[camera_index].emplace(frame_track_ids(keypoint_index), it->second);
+      }
+    }
+  }
+}
+
+void renumberTrackIds(TrackIdMap* merged_track_ids, int* next_track_id,
+                      Eigen::VectorXi* track_ids) {
+  CHECK_NOTNULL(merged_track_ids);
+  CHECK_NOTNULL(next_track_id);
+  CHECK_NOTNULL(track_ids);
+  for (int keypoint_index = 0; keypoint_index < track_ids->size(); ++keypoint_index) {
+    int& track_id = (*track_ids)(keypoint_index);
+    if (track_id < 0) {
+      continue;
+    }
+    const std::pair<TrackIdMap::iterator, bool> inserted =
+        merged_track_ids->emplace(track_id, *next_track_id);
+    if (inserted.second) {
+      ++(*next_track_id);
+    }
+    track_id = inserted.first->second;
+  }
+}
+}  // namespace
+
+std::vector<BatchShard> splitIntoBatchShards(const std::vector<int64_t>& nframe_timestamps,
+                                             size_t num_shards,
+                                             int64_t warm_up_duration_nanoseconds) {
+  CHECK_GT(num_shards, 0u);
+  CHECK_GE(warm_up_duration_nanoseconds, 0);
+  for (size_t i = 1u; i < nframe_timestamps.size(); ++i) {
+    CHECK_LT(nframe_timestamps[i - 1u], nframe_timestamps[i]);
+  }
+  const size_t num_nframes = nframe_timestamps.size();
+  num_shards = std::min(num_shards, num_nframes);
+  std::vector<BatchShard> shards(num_shards);
+  for (size_t shard_index = 0u; shard_index < num_shards; ++shard_index) {
+    BatchShard& shard = shards[shard_index];
+    shard.index = shard_index;
+    // The first and the last shard are open, such that they cover the whole dataset.
+    if (shard_index == 0u) {
+      shard.begin_timestamp_nanoseconds = std::numeric_limits<int64_t>::min();
+      shard.warm_up_begin_timestamp_nanoseconds = shard.begin_timestamp_nanoseconds;
+    } else {
+      shard.begin_timestamp_nanoseconds =
+          nframe_timestamps[shard_index * num_nframes / num_shards];
+      shard.warm_up_begin_timestamp_nanoseconds =
+          shard.begin_timestamp_nanoseconds - warm_up_duration_nanoseconds;
+    }
+    shard.end_timestamp_nanoseconds = (shard_index + 1u == num_shards) ?
+        std::numeric_limits<int64_t>::max() :
+        nframe_timestamps[(shard_index + 1u) * num_nframes / num_shards];
+  }
+  return shards;
+}
+
+ShardedBatchProcessor::ShardedBatchProcessor(
+    const Options& options, const PipelineFactory& pipeline_factory,
+    const SourceFactory& source_factory, const NFrameProcessorFactory& nframe_processor_factory)
+    : options_(options), pipeline_factory_(pipeline_factory), source_factory_(source_factory),
+      nframe_processor_factory_(nframe_processor_factory) {
+  CHECK(pipeline_factory_);
+  CHECK(source_factory_);
+  CHECK_GT(options_.max_num_lookahead_nframes, 0u);
+  CHECK_GT(options_.max_num_concurrent_shards, 0u);
+}
+
+bool ShardedBatchProcessor::processShard(const BatchShard& shard, const std::string& archive_path,
+                                         BatchShardStatistics* statistics) const {
+  CHECK_NOTNULL(statistics);
+  *statistics = BatchShardStatistics();
+  VisualNFrameArchiveWriter writer;
+  if (!writer.open(archive_path)) {
+    LOG(ERROR) << "Could not open the archive " << archive_path << " of shard " << shard.index
+               << ".";
+    return false;
+  }
+  const VisualNPipeline::Ptr pipeline = pipeline_factory_();
+  CHECK(pipeline);
+  const VisualNPipeline::NFrameCallback nframe_processor =
+      nframe_processor_factory_ ? nframe_processor_factory_() : VisualNPipeline::NFrameCallback();
+
+  bool success = true;
+  pipeline->processBatch(
+      source_factory_(shard.warm_up_begin_timestamp_nanoseconds,
+                      shard.end_timestamp_nanoseconds),
+      [&](const std::shared_ptr<VisualNFrame>& nframe) {
+        if (nframe_processor) {
+          nframe_processor(nframe);
+        }
+        if (nframe->getMinTimestampNanoseconds() < shard.begin_timestamp_nanoseconds) {
+          ++statistics->num_warm_up_nframes;
+        } else {
+          ++statistics->num_nframes;
+          for (size_t frame_index = 0u; frame_index < nframe->getNumFrames(); ++frame_index) {
+            addFrameToStatistics(nframe->getFrame(frame_index), statistics);
+          }
+        }
+        // The warm-up nframes are kept to continue the tracks when merging.
+        success = writer.append(*nframe) && success;
+      },
+      options_.max_num_lookahead_nframes);
+  pipeline->shutdown();
+  success = writer.close() && success;
+  LOG_IF(ERROR, !success) << "Could not write the archive " << archive_path << " of shard "
+                          << shard.index << ".";
+  return success;
+}
+
+bool ShardedBatchProcessor::processShardsLocally(
+    const std::vector<BatchShard>& shards, const std::vector<std::string>& archive_paths,
+    std::vector<BatchShardStatistics>* statistics) const {
+  CHECK_NOTNULL(statistics);
+  CHECK_EQ(shards.size(), archive_paths.size());
+  statistics->assign(shards.size(), BatchShardStatistics());
+  std::atomic<size_t> next_shard_index(0u);
+  std::atomic<bool> success(true);
+  const auto process_shards = [&]() {
+    for (size_t shard_index = next_shard_index++; shard_index < shards.size();
+         shard_index = next_shard_index++) {
+      if (!processShard(shards[shard_index], archive_paths[shard_index],
+                        &(*statistics)[shard_index])) {
+        success = false;
+      }
+    }
+  };
+  const size_t num_threads = std::min(options_.max_num_concurrent_shards, shards.size());
+  std::vector<std::thread> threads;
+  for (size_t thread_index = 0u; thread_index < num_threads; ++thread_index) {
+    threads.emplace_back(process_shards);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return success;
+}
+
+bool ShardedBatchProcessor::mergeShardArchives(
+    const std::vector<BatchShard>& shards, const std::vector<std::string>& archive_paths,
+    const std::shared_ptr<NCamera>& camera_system, const std::string& merged_archive_path,
+    BatchShardStatistics* statistics) {
+  CHECK_EQ(shards.size(), archive_paths.size());
+  CHECK(camera_system);
+  CHECK_NOTNULL(statistics);
+  *statistics = BatchShardStatistics();
+  const size_t num_cameras = camera_system->getNumCameras();
+  VisualNFrameArchiveWriter writer;
+  if (!writer.open(merged_archive_path)) {
+    LOG(ERROR) << "Could not open the merged archive " << merged_archive_path << ".";
+    return false;
+  }
+
+  std::unique_ptr<VisualNFrameArchive> previous_archive;
+  std::vector<TrackIdMap> previous_track_ids;
+  std::vector<int> next_track_ids(num_cameras, 0);
+  for (size_t shard_index = 0u; shard_index < shards.size(); ++shard_index) {
+    const BatchShard& shard = shards[shard_index];
+    CHECK_EQ(shard_index, shard.index);
+    std::unique_ptr<VisualNFrameArchive> archive(new VisualNFrameArchive);
+    if (!archive->open(archive_paths[shard_index])) {
+      LOG(ERROR) << "Could not open the archive " << archive_paths[shard_index] << " of shard "
+                 << shard_index << ".";
+      return false;
+    }
+    std::vector<TrackIdMap> track_ids(num_cameras);
+    const size_t begin_index = archive->findFirstNFrameNotBefore(shard.begin_timestamp_nanoseconds);
+    if (previous_archive && begin_index > 0u) {
+      continueTracksOfPreviousShard(*previous_archive, previous_track_ids, *archive,
+                                    begin_index - 1u, &track_ids);
+    }
+
+    for (size_t index = begin_index; index < archive->getNumNFrames() &&
+         shard.isOwned(archive->getTimestampNanoseconds(index)); ++index) {
+      BinaryVisualNFrameView nframe_view;
+      archive->getNFrame(index, &nframe_view);
+      CHECK_EQ(nframe_view.getNumFrames(), num_cameras);
+      VisualNFrame nframe(nframe_view.getId(), camera_system);
+      for (size_t camera_index = 0u; camera_index < num_cameras; ++camera_index) {
+        if (!nframe_view.isFrameSet(camera_index)) {
+          continue;
+        }
+        VisualFrame::Ptr frame(new VisualFrame);
+        nframe_view.getFrame(camera_index).copyToVisualFrame(frame.get());
+        frame->setCameraGeometry(camera_system->getCameraShared(camera_index));
+        if (frame->hasTrackIds()) {
+          renumberTrackIds(&track_ids[camera_index], &next_track_ids[camera_index],
+                           frame->getTrackIdsMutable());
+        }
+        addFrameToStatistics(*frame, statistics);
+        nframe.setFrame(camera_index, frame);
+      }
+      if (!writer.append(nframe)) {
+        LOG(ERROR) << "Could not write the merged archive " << merged_archive_path << ".";
+        return false;
+      }
+      ++statistics->num_nframes;
+    }
+    previous_archive = std::move(archive);
+    previous_track_ids.swap(track_ids);
+  }
+  for (const int num_tracks : next_track_ids) {
+    statistics->num_tracks += static_cast<size_t>(num_tracks);
+  }
+  return writer.close();
+}
+
+}  // namespace aslam
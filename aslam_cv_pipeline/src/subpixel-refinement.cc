@@ -0,0 +1,173 @@
+#include "aslam/pipeline/subpixel-refinement.h"
+
+#include <cmath>
+
+#include <aslam/common/timer.h>
+#include <aslam/frames/visual-frame.h>
+#include <glog/logging.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace aslam {
+namespace {
+// The level 0 derivatives of a pyramid built by cv::buildOpticalFlowPyramid with derivatives.
+constexpr size_t kPyramidLevel0DerivativesIndex = 1u;
+
+// Refines one keypoint, returns false if it keeps the detected location.
+bool refineKeypoint(const cv::Mat& gradients, const SubpixelRefinementSettings& settings,
+                    std::vector<float>* weights_x, std::vector<float>* weights_y,
+                    Eigen::Vector2d* keypoint) {
+  CHECK_NOTNULL(weights_x);
+  CHECK_NOTNULL(weights_y);
+  CHECK_NOTNULL(keypoint);
+  const int half_window_size = settings.half_window_size;
+  const int window_size = 2 * half_window_size + 1;
+  const float sigma = 0.5f * static_cast<float>(half_window_size + 1);
+  const float inverse_two_sigma_squared = 1.0f / (2.0f * sigma * sigma);
+  const Eigen::Vector2d detected_keypoint = *keypoint;
+  Eigen::Vector2d refined_keypoint = detected_keypoint;
+  for (int iteration = 0; iteration < settings.max_iterations; ++iteration) {
+    const int center_x = static_cast<int>(std::lround(refined_keypoint.x()));
+    const int center_y = static_cast<int>(std::lround(refined_keypoint.y()));
+    if (center_x - half_window_size < 0 || center_y - half_window_size < 0 ||
+        center_x + half_window_size >= gradients.cols ||
+        center_y + half_window_size >= gradients.rows) {
+      return false;
+    }
+    // The weights are centered on the estimate, the window on the closest pixel.
+    const float offset_x = static_cast<float>(refined_keypoint.x() - center_x);
+    const float offset_y = static_cast<float>(refined_keypoint.y() - center_y);
+    for (int i = 0; i < window_size; ++i) {
+      const float dx = static_cast<float>(i - half_window_size) - offset_x;
+      const float dy = static_cast<float>(i - half_window_size) - offset_y;
+      (*weights_x)[i] = std::exp(-dx * dx * inverse_two_sigma_squared);
+      (*weights_y)[i] = std::exp(-dy * dy * inverse_two_sigma_squared);
+    }
+
+    // The structure tensor and the right hand side, with the positions relative to the center.
+    float gxx = 0.0f, gxy = 0.0f, gyy = 0.0f, bx = 0.0f, by = 0.0f;
+    for (int dy = -half_window_size; dy <= half_window_size; ++dy) {
+      const cv::Vec2s* gradient_row =
+          gradients.ptr<cv::Vec2s>(center_y + dy) + center_x - half_window_size;
+      const float weight_y = (*weights_y)[dy + half_window_size];
+      const float y = static_cast<float>(dy);
+      for (int i = 0; i < window_size; ++i) {
+        const float gx = gradient_row[i][0];
+        const float gy = gradient_row[i][1];
+        const float w = weight_y * (*weights_x)[i];
+        const float x = static_cast<float>(i - half_window_size);
+        const float wgxx = w * gx * gx;
+        const float wgxy = w * gx * gy;
+        const float wgyy = w * gy * gy;
+        gxx += wgxx;
+        gxy += wgxy;
+        gyy += wgyy;
+        bx += wgxx * x + wgxy * y;
+        by += wgxy * x + wgyy * y;
+      }
+    }
+    const double half_trace = 0.5 * (static_cast<double>(gxx) + gyy);
+    const double half_difference = 0.5 * (static_cast<double>(gxx) - gyy);
+    const double discriminant =
+        std::sqrt(half_difference * half_difference + static_cast<double>(gxy) * gxy);
+    const double max_eigenvalue = half_trace + discriminant;
+    const double min_eigenvalue = half_trace - discriminant;
+    if (max_eigenvalue <= 0.0 || min_eigenvalue < settings.min_eigenvalue_ratio * max_eigenvalue) {
+      return false;
+    }
+    const double determinant = static_cast<double>(gxx) * gyy - static_cast<double>(gxy) * gxy;
+    const Eigen::Vector2d previous_keypoint = refined_keypoint;
+    refined_keypoint << center_x + (static_cast<double>(gyy) * bx - gxy * by) / determinant,
+                        center_y + (static_cast<double>(gxx) * by - gxy * bx) / determinant;
+    if ((refined_keypoint - detected_keypoint).norm() > settings.max_displacement_px) {
+      return false;
+    }
+    if ((refined_keypoint - previous_keypoint).norm() < settings.epsilon_px) {
+      break;
+    }
+  }
+  *keypoint = refined_keypoint;
+  return true;
+}
+}  // namespace
+
+void computeImageGradients(const cv::Mat& image, cv::Mat* gradients) {
+  CHECK_NOTNULL(gradients);
+  CHECK_EQ(image.type(), CV_8UC1);
+  cv::Mat derivatives[2];
+  cv::Scharr(image, derivatives[0], CV_16S, 1, 0);
+  cv::Scharr(image, derivatives[1], CV_16S, 0, 1);
+  cv::merge(derivatives, 2, *gradients);
+}
+
+size_t refineKeypointsSubpixel(const cv::Mat& gradients,
+                               const SubpixelRefinementSettings& settings,
+                               Eigen::Matrix2Xd* keypoints,
+                               std::vector<unsigned char>* is_refined) {
+  CHECK_NOTNULL(keypoints);
+  CHECK_EQ(gradients.type(), CV_16SC2);
+  CHECK_GT(settings.half_window_size, 0);
+  CHECK_GT(settings.max_iterations, 0);
+  CHECK_GE(settings.epsilon_px, 0.0);
+  CHECK_GT(settings.max_displacement_px, 0.0);
+  CHECK_GE(settings.min_eigenvalue_ratio, 0.0);
+  CHECK_LE(settings.min_eigenvalue_ratio, 1.0);
+  static const size_t kTimerHandle = timing::Timing::GetHandle("refineKeypointsSubpixel");
+  timing::Timer timer(kTimerHandle);
+
+  // Buffers of the separable weights shared by all keypoints.
+  const size_t window_size = 2u * static_cast<size_t>(settings.half_window_size) + 1u;
+  std::vector<float> weights_x(window_size);
+  std::vector<float> weights_y(window_size);
+
+  const int num_keypoints = static_cast<int>(keypoints->cols());
+  if (is_refined != nullptr) {
+    is_refined->assign(num_keypoints, 0u);
+  }
+  size_t num_refined = 0u;
+  for (int keypoint_idx = 0; keypoint_idx < num_keypoints; ++keypoint_idx) {
+    Eigen::Vector2d keypoint = keypoints->col(keypoint_idx);
+    if (refineKeypoint(gradients, settings, &weights_x, &weights_y, &keypoint)) {
+      keypoints->col(keypoint_idx) = keypoint;
+      ++num_refined;
+      if (is_refined != nullptr) {
+        (*is_refined)[keypoint_idx] = 1u;
+      }
+    }
+  }
+  return num_refined;
+}
+
+size_t refineFrameKeypointsSubpixel(const cv::Mat& image,
+                                    const SubpixelRefinementSettings& settings,
+                                    VisualFrame* frame) {
+  CHECK_NOTNULL(frame);
+  if (!frame->hasKeypointMeasurements() || frame->getNumKeypointMeasurements() == 0u) {
+    return 0u;
+  }
+  cv::Mat gradients;
+  if (frame->hasImagePyramid() &&
+      frame->getImagePyramid().size() > kPyramidLevel0DerivativesIndex &&
+      frame->getImagePyramid()[kPyramidLevel0DerivativesIndex].type() == CV_16SC2) {
+    gradients = frame->getImagePyramid()[kPyramidLevel0DerivativesIndex];
+    CHECK_EQ(gradients.size(), image.size());
+  } else {
+    computeImageGradients(image, &gradients);
+  }
+
+  std::vector<unsigned char> is_refined;
+  const size_t num_refined = refineKeypointsSubpixel(
+      gradients, settings, frame->getKeypointMeasurementsMutable(), &is_refined);
+  frame->invalidateNormalizedBearingVectors();
+  if (frame->hasKeypointMeasurementUncertainties()) {
+    Eigen::VectorXd* uncertainties = frame->getKeypointMeasurementUncertaintiesMutable();
+    CHECK_EQ(static_cast<size_t>(uncertainties->size()), is_refined.size());
+    for (size_t keypoint_idx = 0u; keypoint_idx < is_refined.size(); ++keypoint_idx) {
+      if (is_refined[keypoint_idx]) {
+        (*uncertainties)(keypoint_idx) = settings.refined_uncertainty_px;
+      }
+    }
+  }
+  return num_refined;
+}
+
+}  // namespace aslam
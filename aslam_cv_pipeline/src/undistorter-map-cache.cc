@@ -0,0 +1,231 @@
+#include "aslam/pipeline/undistorter-map-cache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <aslam/cameras/distortion.h>
+#include <aslam/common/mapped-file.h>
+#include <aslam/common/undistort-helpers.h>
+#include <glog/logging.h>
+
+DEFINE_string(acv_undistort_map_cache_directory, "",
+              "Directory of the on-disk undistortion map cache. The cache is disabled if empty.");
+
+namespace aslam {
+namespace {
+
+// Increment whenever the map computation or the file layout changes.
+constexpr uint32_t kCacheFormatVersion = 1u;
+constexpr char kCacheFileMagic[8] = {'A', 'C', 'V', 'U', 'M', 'A', 'P', '\0'};
+
+struct CacheFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t key;
+  int32_t rows;
+  int32_t cols;
+  int32_t type_u;
+  /// -1 if the second map is empty (CV_32FC2 maps).
+  int32_t type_v;
+};
+
+/// 64bit FNV-1a, used instead of std::hash as the keys must be stable across builds.
+class Fnv1aHasher {
+ public:
+  Fnv1aHasher() : hash_(14695981039346656037ull) {}
+
+  void add(const void* data, size_t num_bytes) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0u; i < num_bytes; ++i) {
+      hash_ ^= bytes[i];
+      hash_ *= 1099511628211ull;
+    }
+  }
+
+  template <typename Type>
+  void add(const Type& value) {
+    add(&value, sizeof(Type));
+  }
+
+  void add(const Eigen::VectorXd& vector) {
+    add(static_cast<int64_t>(vector.size()));
+    add(vector.data(), vector.size() * sizeof(double));
+  }
+
+  uint64_t get() const { return hash_; }
+
+ private:
+  uint64_t hash_;
+};
+
+void addCameraToHash(const Camera& camera, Fnv1aHasher* hasher) {
+  CHECK_NOTNULL(hasher);
+  hasher->add(static_cast<int32_t>(camera.getType()));
+  hasher->add(static_cast<uint64_t>(camera.imageWidth()));
+  hasher->add(static_cast<uint64_t>(camera.imageHeight()));
+  hasher->add(camera.getParameters());
+  hasher->add(static_cast<int32_t>(camera.getDistortion().getType()));
+  hasher->add(camera.getDistortion().getParameters());
+}
+
+size_t getMapNumBytes(int rows, int cols, int type) {
+  if (type < 0) {
+    return 0u;
+  }
+  return static_cast<size_t>(rows) * cols * CV_ELEM_SIZE(type);
+}
+
+}  // namespace
+
+UndistortMapCache::UndistortMapCache(const std::string& cache_directory)
+    : cache_directory_(cache_directory) {
+  CHECK(!cache_directory_.empty());
+  if (mkdir(cache_directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+    LOG(WARNING) << "Could not create the undistortion map cache directory "
+                 << cache_directory_ << ": " << std::strerror(errno);
+  }
+}
+
+uint64_t UndistortMapCache::computeKey(const Camera& input_camera, const Camera& output_camera,
+                                       int map_type, InterpolationMethod interpolation) {
+  Fnv1aHasher hasher;
+  hasher.add(kCacheFormatVersion);
+  addCameraToHash(input_camera, &hasher);
+  addCameraToHash(output_camera, &hasher);
+  hasher.add(static_cast<int32_t>(map_type));
+  hasher.add(static_cast<int32_t>(interpolation));
+  return hasher.get();
+}
+
+std::string UndistortMapCache::getFilePath(uint64_t key) const {
+  std::ostringstream path;
+  path << cache_directory_ << "/undistort-map-" << std::hex << std::setw(16)
+       << std::setfill('0') << key << ".bin";
+  return path.str();
+}
+
+bool UndistortMapCache::load(uint64_t key, cv::Mat* map_u, cv::Mat* map_v) const {
+  CHECK_NOTNULL(map_u);
+  CHECK_NOTNULL(map_v);
+  const std::string file_path = getFilePath(key);
+  common::MappedFile mapped_file;
+  if (!mapped_file.open(file_path)) {
+    if (errno != ENOENT) {
+      LOG(WARNING) << "Could not map the undistortion map cache file " << file_path << ": "
+                   << std::strerror(errno);
+    }
+    return false;
+  }
+  const size_t file_size = mapped_file.sizeBytes();
+  if (file_size < sizeof(CacheFileHeader)) {
+    return false;
+  }
+
+  CacheFileHeader header;
+  std::memcpy(&header, mapped_file.data(), sizeof(CacheFileHeader));
+  const size_t num_bytes_u = getMapNumBytes(header.rows, header.cols, header.type_u);
+  const size_t num_bytes_v = getMapNumBytes(header.rows, header.cols, header.type_v);
+  const bool is_valid = std::memcmp(header.magic, kCacheFileMagic, sizeof(kCacheFileMagic)) == 0 &&
+      header.version == kCacheFormatVersion && header.key == key && header.rows > 0 &&
+      header.cols > 0 && header.type_u >= 0 &&
+      file_size == sizeof(CacheFileHeader) + num_bytes_u + num_bytes_v;
+  if (!is_valid) {
+    LOG(WARNING) << "Ignoring the invalid undistortion map cache file " << file_path << ".";
+    return false;
+  }
+
+  // Copy the maps out of the mapping such that they don't depend on the lifetime of the file.
+  const char* data = mapped_file.data() + sizeof(CacheFileHeader);
+  map_u->create(header.rows, header.cols, header.type_u);
+  std::memcpy(map_u->data, data, num_bytes_u);
+  if (header.type_v >= 0) {
+    map_v->create(header.rows, header.cols, header.type_v);
+    std::memcpy(map_v->data, data + num_bytes_u, num_bytes_v);
+  } else {
+    map_v->release();
+  }
+  return true;
+}
+
+bool UndistortMapCache::store(uint64_t key, const cv::Mat& map_u, const cv::Mat& map_v) const {
+  CHECK(!map_u.empty());
+  if (!map_v.empty()) {
+    CHECK_EQ(map_u.size(), map_v.size());
+  }
+  const cv::Mat map_u_continuous = map_u.isContinuous() ? map_u : map_u.clone();
+  const cv::Mat map_v_continuous = map_v.isContinuous() ? map_v : map_v.clone();
+
+  CacheFileHeader header;
+  std::memset(&header, 0, sizeof(CacheFileHeader));
+  std::memcpy(header.magic, kCacheFileMagic, sizeof(kCacheFileMagic));
+  header.version = kCacheFormatVersion;
+  header.key = key;
+  header.rows = map_u.rows;
+  header.cols = map_u.cols;
+  header.type_u = map_u.type();
+  header.type_v = map_v.empty() ? -1 : map_v.type();
+
+  // Write to a temporary file first, the rename makes the new entry visible atomically.
+  const std::string file_path = getFilePath(key);
+  std::ostringstream temporary_file_path;
+  temporary_file_path << file_path << ".tmp." << getpid();
+  {
+    std::ofstream file(temporary_file_path.str(), std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      LOG(WARNING) << "Could not open " << temporary_file_path.str() << " for writing.";
+      return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(CacheFileHeader));
+    file.write(reinterpret_cast<const char*>(map_u_continuous.data),
+               getMapNumBytes(header.rows, header.cols, header.type_u));
+    if (!map_v.empty()) {
+      file.write(reinterpret_cast<const char*>(map_v_continuous.data),
+                 getMapNumBytes(header.rows, header.cols, header.type_v));
+    }
+    if (!file.good()) {
+      LOG(WARNING) << "Could not write the undistortion map cache file "
+                   << temporary_file_path.str() << ".";
+      std::remove(temporary_file_path.str().c_str());
+      return false;
+    }
+  }
+  if (std::rename(temporary_file_path.str().c_str(), file_path.c_str()) != 0) {
+    LOG(WARNING) << "Could not move the undistortion map cache file to " << file_path << ".";
+    std::remove(temporary_file_path.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+void buildUndistortMapCached(const Camera& input_camera, const Camera& output_camera,
+                             int map_type, InterpolationMethod interpolation,
+                             cv::Mat* map_u, cv::Mat* map_v) {
+  CHECK_NOTNULL(map_u);
+  CHECK_NOTNULL(map_v);
+  if (FLAGS_acv_undistort_map_cache_directory.empty()) {
+    common::buildUndistortMap(input_camera, output_camera, map_type, *map_u, *map_v);
+    return;
+  }
+
+  const UndistortMapCache cache(FLAGS_acv_undistort_map_cache_directory);
+  const uint64_t key =
+      UndistortMapCache::computeKey(input_camera, output_camera, map_type, interpolation);
+  if (cache.load(key, map_u, map_v) && map_u->type() == map_type &&
+      static_cast<size_t>(map_u->cols) == output_camera.imageWidth() &&
+      static_cast<size_t>(map_u->rows) == output_camera.imageHeight()) {
+    VLOG(3) << "Loaded the undistortion maps from " << cache.getFilePath(key) << ".";
+    return;
+  }
+  common::buildUndistortMap(input_camera, output_camera, map_type, *map_u, *map_v);
+  cache.store(key, *map_u, *map_v);
+}
+
+}  // namespace aslam
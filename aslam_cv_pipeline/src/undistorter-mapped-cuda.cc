@@ -0,0 +1,134 @@
+#include "aslam/pipeline/undistorter-mapped-cuda.h"
+
+#include <glog/logging.h>
+#include <opencv2/imgproc/imgproc.hpp>  // cv::convertMaps
+#ifdef ASLAM_CV_WITH_CUDA
+#include <opencv2/cudawarping.hpp>
+#endif
+
+namespace aslam {
+
+CudaMappedUndistorter::CudaMappedUndistorter(
+    const MappedUndistorter& undistorter, const std::shared_ptr<CudaImageCache>& device_images)
+    : MappedUndistorter(Camera::Ptr(undistorter.getInputCamera().clone()),
+                        Camera::Ptr(undistorter.getOutputCamera().clone()),
+                        undistorter.getUndistortMapU(), undistorter.getUndistortMapV(),
+                        undistorter.getInterpolationMethod()),
+      use_cuda_(false),
+      device_images_(device_images) {
+  setValidOutputRoi(undistorter.getValidOutputRoi());
+  setUndistortValidRoiOnly(undistorter.getUndistortValidRoiOnly());
+  setProcessingRoi(undistorter.getProcessingRoi());
+  setUseFixedPointMaps(undistorter.getUseFixedPointMaps());
+
+  if (!isCudaBackendAvailable()) {
+    LOG(WARNING) << "The CUDA backend is not available, the images are undistorted on the CPU.";
+    return;
+  }
+  if (getInterpolationMethod() == InterpolationMethod::Lanczos) {
+    LOG(WARNING) << "The CUDA remap has no Lanczos interpolation, the images are undistorted "
+                 << "on the CPU.";
+    return;
+  }
+#ifdef ASLAM_CV_WITH_CUDA
+  const cv::Mat& map_u = getUndistortMapU();
+  const cv::Mat& map_v = getUndistortMapV();
+  cv::Mat map_x, map_y;
+  if (map_u.type() == CV_32FC1) {
+    map_x = map_u;
+    map_y = map_v;
+  } else {
+    cv::convertMaps(map_u, map_v, map_x, map_y, CV_32FC1);
+  }
+  device_map_x_.upload(map_x);
+  device_map_y_.upload(map_y);
+  use_cuda_ = true;
+#endif
+}
+
+size_t CudaMappedUndistorter::getDeviceMemoryUsageBytes() const {
+  return device_map_x_.step * static_cast<size_t>(device_map_x_.rows) +
+      device_map_y_.step * static_cast<size_t>(device_map_y_.rows);
+}
+
+void CudaMappedUndistorter::processImage(
+    const cv::Mat& input_image, cv::Mat* output_image) const {
+  processFrameImage(input_image, FrameId(), output_image);
+}
+
+void CudaMappedUndistorter::processFrameImage(
+    const cv::Mat& input_image, const FrameId& frame_id, cv::Mat* output_image) const {
+  CHECK_NOTNULL(output_image);
+  if (!use_cuda_) {
+    MappedUndistorter::processImage(input_image, output_image);
+    return;
+  }
+  CHECK_EQ(input_camera_->imageWidth(), static_cast<size_t>(input_image.cols));
+  CHECK_EQ(input_camera_->imageHeight(), static_cast<size_t>(input_image.rows));
+#ifdef ASLAM_CV_WITH_CUDA
+  // The stream and the device images are created per call as frames may be processed
+  // concurrently. The output image is not reused as the cache may still reference it.
+  cv::cuda::Stream stream;
+  cv::cuda::GpuMat device_output_image;
+  processImageOnDevice(input_image, frame_id, &device_output_image, stream);
+  device_output_image.download(*output_image, stream);
+  stream.waitForCompletion();
+#else
+  static_cast<void>(frame_id);
+  LOG(FATAL) << "Built without ASLAM_CV_WITH_CUDA.";
+#endif
+}
+
+void CudaMappedUndistorter::processImageOnDevice(
+    const cv::Mat& input_image, const FrameId& frame_id, cv::cuda::GpuMat* output_image,
+    cv::cuda::Stream& stream) const {
+  CHECK_NOTNULL(output_image);
+  CHECK(use_cuda_) << "The CUDA backend is not available.";
+#ifdef ASLAM_CV_WITH_CUDA
+  cv::cuda::GpuMat device_input_image;
+  device_input_image.upload(input_image, stream);
+  processDeviceImage(device_input_image, output_image, stream);
+  if (device_images_ && frame_id.isValid()) {
+    device_images_->insert(frame_id, *output_image);
+  }
+#else
+  static_cast<void>(input_image);
+  static_cast<void>(frame_id);
+  static_cast<void>(stream);
+  LOG(FATAL) << "Built without ASLAM_CV_WITH_CUDA.";
+#endif
+}
+
+void CudaMappedUndistorter::processDeviceImage(
+    const cv::cuda::GpuMat& input_image, cv::cuda::GpuMat* output_image,
+    cv::cuda::Stream& stream) const {
+  CHECK_NOTNULL(output_image);
+  CHECK(use_cuda_) << "The CUDA backend is not available.";
+  CHECK_EQ(input_camera_->imageWidth(), static_cast<size_t>(input_image.cols));
+  CHECK_EQ(input_camera_->imageHeight(), static_cast<size_t>(input_image.rows));
+#ifdef ASLAM_CV_WITH_CUDA
+  const int interpolation = static_cast<int>(getInterpolationMethod());
+  const cv::Size output_size = device_map_x_.size();
+  const cv::Rect roi = getRemappedOutputRoi();
+  if (roi.size() == output_size) {
+    cv::cuda::remap(input_image, *output_image, device_map_x_, device_map_y_, interpolation,
+                    cv::BORDER_CONSTANT, cv::Scalar(), stream);
+    return;
+  }
+
+  // Same as the CPU remap, only the region is remapped and the rest is cleared.
+  output_image->create(output_size, input_image.type());
+  output_image->setTo(cv::Scalar::all(0), stream);
+  if (roi.area() == 0) {
+    return;
+  }
+  cv::cuda::GpuMat output_roi = (*output_image)(roi);
+  cv::cuda::remap(input_image, output_roi, device_map_x_(roi), device_map_y_(roi),
+                  interpolation, cv::BORDER_CONSTANT, cv::Scalar(), stream);
+#else
+  static_cast<void>(stream);
+  LOG(FATAL) << "Built without ASLAM_CV_WITH_CUDA.";
+#endif
+}
+
+}  // namespace aslam
@@ -1,16 +1,50 @@
 #include "aslam/pipeline/undistorter-mapped.h"
 
 #include <aslam/cameras/camera-factory.h>
+#include <aslam/common/memory-usage.h>
+#include <aslam/common/numa.h>
 #include <aslam/common/undistort-helpers.h>
+#include <aslam/pipeline/undistorter-map-cache.h>
 #include <aslam/frames/visual-frame.h>
 #include <glog/logging.h>
 #include <opencv2/imgproc/imgproc.hpp> // cv::remap
 
 namespace aslam {
 
+namespace internal {
+void cropUndistorterOutput(const cv::Rect& output_crop, Eigen::Matrix3d* output_camera_matrix,
+                           cv::Size* output_size, cv::Rect* valid_output_roi) {
+  CHECK_NOTNULL(output_camera_matrix);
+  CHECK_NOTNULL(output_size);
+  CHECK_NOTNULL(valid_output_roi);
+  if (output_crop.area() == 0) {
+    return;
+  }
+  CHECK_GE(output_crop.x, 0);
+  CHECK_GE(output_crop.y, 0);
+  CHECK_LE(output_crop.x + output_crop.width, output_size->width)
+      << "The crop exceeds the scaled output image.";
+  CHECK_LE(output_crop.y + output_crop.height, output_size->height)
+      << "The crop exceeds the scaled output image.";
+  (*output_camera_matrix)(0, 2) -= output_crop.x;
+  (*output_camera_matrix)(1, 2) -= output_crop.y;
+  *output_size = output_crop.size();
+  const cv::Rect valid_cropped_roi = *valid_output_roi & output_crop;
+  *valid_output_roi = (valid_cropped_roi.area() > 0) ?
+      valid_cropped_roi - output_crop.tl() : cv::Rect();
+}
+}  // namespace internal
+
 std::unique_ptr<MappedUndistorter> createMappedUndistorterToPinhole(
     const aslam::UnifiedProjectionCamera& unified_proj_camera, float alpha,
     float scale, aslam::InterpolationMethod interpolation_type) {
+  return createMappedUndistorterToPinhole(
+      unified_proj_camera, alpha, scale, cv::Rect(), interpolation_type);
+}
+
+std::unique_ptr<MappedUndistorter> createMappedUndistorterToPinhole(
+    const aslam::UnifiedProjectionCamera& unified_proj_camera, float alpha, float scale,
+    const cv::Rect& output_crop, aslam::InterpolationMethod interpolation_type) {
   CHECK_GE(alpha, 0.0);
   CHECK_LE(alpha, 1.0);
   CHECK_GT(scale, 0.0);
@@ -25,42 +59,139 @@ std::unique_ptr<MappedUndistorter> createMappedUndistorterToPinhole(
   Eigen::Matrix3d output_camera_matrix = common::getOptimalNewCameraMatrix(
       *input_camera, alpha, scale, kUndistortToPinhole);
 
+  cv::Size output_size(static_cast<int>(scale * input_camera->imageWidth()),
+                       static_cast<int>(scale * input_camera->imageHeight()));
+  cv::Rect valid_output_roi = common::getValidUndistortedRoi(
+      *input_camera, output_camera_matrix, kUndistortToPinhole, output_size);
+  internal::cropUndistorterOutput(
+      output_crop, &output_camera_matrix, &output_size, &valid_output_roi);
+
   Eigen::Matrix<double, PinholeCamera::parameterCount(), 1> intrinsics;
   intrinsics <<  output_camera_matrix(0, 0), output_camera_matrix(1, 1),
                  output_camera_matrix(0, 2), output_camera_matrix(1, 2);
 
-  const int output_width = static_cast<int>(scale * input_camera->imageWidth());
-  const int output_height = static_cast<int>(scale * input_camera->imageHeight());
   PinholeCamera::Ptr output_camera = aslam::createCamera<aslam::PinholeCamera>(
-      intrinsics, output_width, output_height);
+      intrinsics, output_size.width, output_size.height);
   CHECK(output_camera);
 
   cv::Mat map_u, map_v;
-  common::buildUndistortMap(*input_camera, *output_camera, CV_16SC2, map_u, map_v);
+  buildUndistortMapCached(
+      *input_camera, *output_camera, CV_16SC2, interpolation_type, &map_u, &map_v);
 
-  return std::unique_ptr<MappedUndistorter>(
+  std::unique_ptr<MappedUndistorter> undistorter(
       new MappedUndistorter(input_camera, output_camera, map_u, map_v, interpolation_type));
+  undistorter->setValidOutputRoi(valid_output_roi);
+  return undistorter;
 }
 
 MappedUndistorter::MappedUndistorter()
-    : interpolation_method_(aslam::InterpolationMethod::Linear) {}
+    : interpolation_method_(aslam::InterpolationMethod::Linear), use_fixed_point_maps_(false),
+      undistort_valid_roi_only_(false) {}
 
 MappedUndistorter::MappedUndistorter(Camera::Ptr input_camera, Camera::Ptr output_camera,
                                      const cv::Mat& map_u, const cv::Mat& map_v,
                                      aslam::InterpolationMethod interpolation)
 : Undistorter(input_camera, output_camera), map_u_(map_u), map_v_(map_v),
-  interpolation_method_(interpolation) {
+  interpolation_method_(interpolation), use_fixed_point_maps_(false),
+  valid_output_roi_(0, 0, map_u.cols, map_u.rows), undistort_valid_roi_only_(false) {
   CHECK_EQ(static_cast<size_t>(map_u_.rows), output_camera->imageHeight());
   CHECK_EQ(static_cast<size_t>(map_u_.cols), output_camera->imageWidth());
   CHECK_EQ(static_cast<size_t>(map_v_.rows), output_camera->imageHeight());
   CHECK_EQ(static_cast<size_t>(map_v_.cols), output_camera->imageWidth());
 }
 
+size_t MappedUndistorter::getMemoryUsageBytes() const {
+  return sizeof(*this) + common::getMemoryUsageBytes(map_u_) +
+      common::getMemoryUsageBytes(map_v_) + common::getMemoryUsageBytes(fixed_point_map_xy_) +
+      common::getMemoryUsageBytes(fixed_point_map_table_);
+}
+
+bool MappedUndistorter::bindMemoryToNumaNode(size_t node) {
+  bool success = true;
+  for (const cv::Mat* map : {&map_u_, &map_v_, &fixed_point_map_xy_, &fixed_point_map_table_}) {
+    if (!map->empty()) {
+      success &= common::bindMemoryToNumaNode(
+          map->datastart, static_cast<size_t>(map->dataend - map->datastart), node);
+    }
+  }
+  return success;
+}
+
+void MappedUndistorter::setUseFixedPointMaps(bool use_fixed_point_maps) {
+  use_fixed_point_maps_ = use_fixed_point_maps;
+  if (!use_fixed_point_maps_) {
+    fixed_point_map_xy_.release();
+    fixed_point_map_table_.release();
+    return;
+  }
+  if (!fixed_point_map_xy_.empty()) {
+    return;
+  }
+  if (map_u_.type() == CV_16SC2) {
+    fixed_point_map_xy_ = map_u_;
+    fixed_point_map_table_ = map_v_;
+  } else {
+    cv::convertMaps(map_u_, map_v_, fixed_point_map_xy_, fixed_point_map_table_, CV_16SC2);
+  }
+}
+
+void MappedUndistorter::setValidOutputRoi(const cv::Rect& valid_output_roi) {
+  const cv::Rect output_image_rect(0, 0, map_u_.cols, map_u_.rows);
+  CHECK_EQ(valid_output_roi & output_image_rect, valid_output_roi)
+      << "The valid region must lie within the output image.";
+  valid_output_roi_ = valid_output_roi;
+}
+
+void MappedUndistorter::setProcessingRoi(const cv::Rect& processing_roi) {
+  const cv::Rect output_image_rect(0, 0, map_u_.cols, map_u_.rows);
+  CHECK_EQ(processing_roi & output_image_rect, processing_roi)
+      << "The processed region must lie within the output image.";
+  processing_roi_ = processing_roi;
+}
+
+cv::Rect MappedUndistorter::getRemappedOutputRoi() const {
+  cv::Rect roi(0, 0, map_u_.cols, map_u_.rows);
+  if (undistort_valid_roi_only_) {
+    roi &= valid_output_roi_;
+  }
+  if (processing_roi_.area() > 0) {
+    roi &= processing_roi_;
+  }
+  return roi;
+}
+
 void MappedUndistorter::processImage(const cv::Mat& input_image, cv::Mat* output_image) const {
   CHECK_EQ(input_camera_->imageWidth(), static_cast<size_t>(input_image.cols));
   CHECK_EQ(input_camera_->imageHeight(), static_cast<size_t>(input_image.rows));
   CHECK_NOTNULL(output_image);
-  cv::remap(input_image, *output_image, map_u_, map_v_, static_cast<int>(interpolation_method_));
+  const cv::Mat& map_1 = use_fixed_point_maps_ ? fixed_point_map_xy_ : map_u_;
+  const cv::Mat& map_2 = use_fixed_point_maps_ ? fixed_point_map_table_ : map_v_;
+  const int interpolation = static_cast<int>(interpolation_method_);
+
+  const cv::Size output_size = map_u_.size();
+  const cv::Rect roi = getRemappedOutputRoi();
+  if (roi.size() == output_size) {
+    cv::remap(input_image, *output_image, map_1, map_2, interpolation);
+    return;
+  }
+
+  // Only remap the region and clear the borders around it. The output is allocated up front
+  // such that the remap writes directly into the sub-image.
+  output_image->create(output_size, input_image.type());
+  const int roi_bottom = roi.y + roi.height;
+  const int roi_right = roi.x + roi.width;
+  (*output_image)(cv::Rect(0, 0, output_size.width, roi.y)).setTo(cv::Scalar::all(0));
+  (*output_image)(cv::Rect(0, roi_bottom, output_size.width, output_size.height - roi_bottom))
+      .setTo(cv::Scalar::all(0));
+  (*output_image)(cv::Rect(0, roi.y, roi.x, roi.height)).setTo(cv::Scalar::all(0));
+  (*output_image)(cv::Rect(roi_right, roi.y, output_size.width - roi_right, roi.height))
+      .setTo(cv::Scalar::all(0));
+  if (roi.area() == 0) {
+    return;
+  }
+  cv::Mat output_roi = (*output_image)(roi);
+  cv::remap(input_image, output_roi, map_1(roi), map_2.empty() ? cv::Mat() : map_2(roi),
+            interpolation);
 }
 
 }  // namespace aslam
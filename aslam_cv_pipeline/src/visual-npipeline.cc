@@ -1,17 +1,34 @@
 #include <aslam/pipeline/visual-npipeline.h>
 
+#include <deque>
+#include <limits>
+#include <string>
+#include <thread>
+
 #include <aslam/cameras/camera.h>
 #include <aslam/cameras/ncamera.h>
+#include <aslam/common/allocation-counter.h>
 #include <aslam/common/memory.h>
+#include <aslam/common/memory-usage.h>
+#include <aslam/common/numa.h>
+#include <aslam/common/real-time.h>
 #include <aslam/common/thread-pool.h>
 #include <aslam/common/time.h>
+#include <aslam/common/timer.h>
+#include <aslam/common/trace-recorder.h>
 #include <aslam/frames/visual-nframe.h>
+#include <aslam/matcher/epipolar-band-matcher.h>
+#include <aslam/pipeline/image-decoder.h>
 #include <aslam/pipeline/visual-pipeline.h>
 #include <aslam/pipeline/visual-pipeline-null.h>
 #include <glog/logging.h>
 #include <opencv2/core/core.hpp>
 
 namespace aslam {
+namespace {
+/// The number of decoded images per camera kept for reuse.
+const size_t kMaxNumPooledDecodedImages = 8u;
+}  // namespace
 
 VisualNPipeline::VisualNPipeline(
     size_t num_threads,
@@ -21,9 +38,25 @@ VisualNPipeline::VisualNPipeline(
     int64_t timestamp_tolerance_ns) :
       pipelines_(pipelines),
       shutdown_(false),
+      preallocate_nframes_(false),
+      check_steady_state_allocations_(false),
+      num_images_queued_(0u),
+      max_num_in_flight_(0u),
+      in_flight_policy_(InFlightPolicy::kBlockProducer),
+      frame_processing_budget_nanoseconds_(0),
+      memory_usage_reporting_period_nanoseconds_(0),
+      next_memory_usage_report_nanoseconds_(0),
+      output_mode_(OutputMode::kLockedQueue),
+      scheduling_mode_(SchedulingMode::kSharedPool),
+      latest_nframe_(nullptr),
+      nframe_callbacks_(std::make_shared<std::vector<NFrameCallbackEntry>>()),
+      next_nframe_callback_id_(0u),
+      is_delivering_nframes_(false),
+      is_worker_scaling_enabled_(false),
       input_camera_system_(input_camera_system),
       output_camera_system_(output_camera_system),
-      timestamp_tolerance_ns_(timestamp_tolerance_ns)  {
+      timestamp_tolerance_ns_(timestamp_tolerance_ns),
+      processing_index_(timestamp_tolerance_ns)  {
   // Defensive programming ninjitsu.
   CHECK_NOTNULL(input_camera_system_.get());
   CHECK_NOTNULL(output_camera_system.get());
@@ -42,24 +75,47 @@ VisualNPipeline::VisualNPipeline(
     CHECK_EQ(output_camera_system_->getCameraShared(i).get(),
              pipelines[i]->getOutputCameraShared().get());
   }
+  frame_drop_counters_.resize(pipelines.size());
+  for (size_t camera_idx = 0u; camera_idx < pipelines.size(); ++camera_idx) {
+    image_decoders_.push_back(
+        std::make_shared<OpenCvImageDecoder>(OpenCvImageDecoder::Options()));
+    decoded_image_pools_.emplace_back(new common::ObjectPool<cv::Mat>(
+        kMaxNumPooledDecodedImages, []() { return new cv::Mat; }, nullptr));
+  }
   CHECK_GT(num_threads, 0u);
   thread_pool_.reset(new ThreadPool(num_threads));
 }
 
 VisualNPipeline::~VisualNPipeline() {
   shutdown();
+  // Join the camera workers while the members they use are still alive.
+  camera_thread_pools_.clear();
+  delete latest_nframe_.exchange(nullptr);
 }
 
 void VisualNPipeline::shutdown() {
   shutdown_ = true;
+  std::deque<NFramePromise> nframe_promises;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    nframe_promises.swap(nframe_promises_);
+  }
+  for (NFramePromise& nframe_promise : nframe_promises) {
+    nframe_promise.set_value(std::shared_ptr<VisualNFrame>());
+  }
   condition_not_empty_.notify_all();
   condition_not_full_.notify_all();
+  condition_in_flight_decreased_.notify_all();
   thread_pool_->stop();
+  for (const std::shared_ptr<ThreadPool>& camera_thread_pool : camera_thread_pools_) {
+    camera_thread_pool->stop();
+  }
 }
 
 bool VisualNPipeline::processImageBlockingIfFull(
     size_t camera_index, const cv::Mat& image, int64_t timestamp,
     size_t max_queue_size) {
+  const common::Deadline deadline = createFrameDeadline();
   std::unique_lock<std::mutex> lock(mutex_);
   while (!shutdown_) {
     if (completed_.size() >= max_queue_size) {
@@ -68,8 +124,10 @@ bool VisualNPipeline::processImageBlockingIfFull(
         continue;
       }
     }
-    processImageImpl(camera_index, image, timestamp);
-    return true;
+    if (admitImage(camera_index, &lock)) {
+      processImageImpl(camera_index, image, timestamp, false /* is_compressed */, deadline);
+    }
+    return !shutdown_;
   }
   return false;
 }
@@ -80,18 +138,25 @@ bool VisualNPipeline::processImageNonBlockingDroppingOldestNFrameIfFull(
   CHECK_GE(max_output_queue_size, 1u);
 
   bool oldest_dropped = false;
-  std::lock_guard<std::mutex> lock(mutex_);
+  const common::Deadline deadline = createFrameDeadline();
+  std::unique_lock<std::mutex> lock(mutex_);
   if (completed_.size() >= max_output_queue_size) {
+    countDroppedFrames(*completed_.begin()->second,
+                       &FrameDropCounters::num_dropped_output_queue_full);
     completed_.erase(completed_.begin());
     condition_not_full_.notify_all();
     oldest_dropped = true;
   }
-  processImageImpl(camera_index, image, timestamp);
+  if (admitImage(camera_index, &lock)) {
+    processImageImpl(camera_index, image, timestamp, false /* is_compressed */, deadline);
+  }
   return oldest_dropped;
 }
 
 bool VisualNPipeline::getNextBlocking(std::shared_ptr<VisualNFrame>* nframe) {
   CHECK_NOTNULL(nframe);
+  CHECK(output_mode_ == OutputMode::kLockedQueue)
+      << "The blocking getters require the locked output queue.";
 
   std::unique_lock<std::mutex> lock(mutex_);
   while (!shutdown_) {
@@ -111,20 +176,136 @@ bool VisualNPipeline::getNextBlocking(std::shared_ptr<VisualNFrame>* nframe) {
 
 void VisualNPipeline::processImage(
     size_t camera_index, const cv::Mat& image, int64_t timestamp) {
-  thread_pool_->enqueue(&VisualNPipeline::work, this, camera_index, image,
-                        timestamp);
+  // The deadline starts with the arrival of the image, also if the admission blocks.
+  const common::Deadline deadline = createFrameDeadline();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (admitImage(camera_index, &lock)) {
+    processImageImpl(camera_index, image, timestamp, false /* is_compressed */, deadline);
+  }
 }
 
 size_t VisualNPipeline::getNumFramesComplete() const {
+  if (output_mode_ == OutputMode::kLockFreeQueue) {
+    return lock_free_queue_->size();
+  } else if (output_mode_ == OutputMode::kLockFreeLatest) {
+    return (latest_nframe_.load() != nullptr) ? 1u : 0u;
+  }
   std::lock_guard<std::mutex> lock(mutex_);
   return completed_.size();
 }
 
 std::shared_ptr<VisualNFrame> VisualNPipeline::getNext() {
+  if (output_mode_ == OutputMode::kLockFreeQueue) {
+    TimestampVisualNFramePair timestamp_nframe;
+    if (!lock_free_queue_->tryPop(&timestamp_nframe)) {
+      return std::shared_ptr<VisualNFrame>();
+    }
+    common::TraceRecorder::instance().recordInstant(
+        common::TraceStage::kConsume, 0u, timestamp_nframe.first);
+    return timestamp_nframe.second;
+  } else if (output_mode_ == OutputMode::kLockFreeLatest) {
+    return getLatestAndClear();
+  }
   std::lock_guard<std::mutex> lock(mutex_);
   return getNextImpl();
 }
 
+size_t VisualNPipeline::addNFrameCallback(const NFrameCallback& callback,
+                                          const std::shared_ptr<ThreadPool>& executor) {
+  CHECK(callback);
+  CHECK(executor);
+  NFrameCallbackEntry entry;
+  entry.exclusivity_group_id = ThreadPool::reserveExclusivityGroupId();
+  entry.callback = callback;
+  entry.executor = executor;
+  std::lock_guard<std::mutex> lock(mutex_);
+  entry.id = next_nframe_callback_id_++;
+  std::shared_ptr<std::vector<NFrameCallbackEntry>> nframe_callbacks =
+      std::make_shared<std::vector<NFrameCallbackEntry>>(*nframe_callbacks_);
+  nframe_callbacks->push_back(entry);
+  nframe_callbacks_ = nframe_callbacks;
+  return entry.id;
+}
+
+void VisualNPipeline::removeNFrameCallback(size_t callback_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::vector<NFrameCallbackEntry>::const_iterator it = nframe_callbacks_->begin();
+       it != nframe_callbacks_->end(); ++it) {
+    if (it->id == callback_id) {
+      std::shared_ptr<std::vector<NFrameCallbackEntry>> nframe_callbacks =
+          std::make_shared<std::vector<NFrameCallbackEntry>>(*nframe_callbacks_);
+      nframe_callbacks->erase(nframe_callbacks->begin() + (it - nframe_callbacks_->begin()));
+      nframe_callbacks_ = nframe_callbacks;
+      return;
+    }
+  }
+  LOG(FATAL) << "There is no nframe callback with the id " << callback_id << ".";
+}
+
+std::future<std::shared_ptr<VisualNFrame>> VisualNPipeline::getNextAsync() {
+  CHECK(output_mode_ == OutputMode::kLockedQueue)
+      << "The asynchronous getter requires the locked output queue.";
+  NFramePromise nframe_promise;
+  std::future<std::shared_ptr<VisualNFrame>> nframe_future = nframe_promise.get_future();
+  std::shared_ptr<VisualNFrame> nframe;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (completed_.empty() && !shutdown_) {
+      nframe_promises_.push_back(std::move(nframe_promise));
+      return nframe_future;
+    }
+    nframe = getNextImpl();
+  }
+  nframe_promise.set_value(nframe);
+  return nframe_future;
+}
+
+bool VisualNPipeline::pushCompletedNFrame(
+    int64_t timestamp_nanoseconds, const std::shared_ptr<VisualNFrame>& nframe) {
+  if (nframe_promises_.empty() && nframe_callbacks_->empty()) {
+    return false;
+  }
+  common::TraceRecorder::instance().recordInstant(
+      common::TraceStage::kConsume, 0u, timestamp_nanoseconds);
+  if (!nframe_promises_.empty()) {
+    pending_nframe_promises_.emplace_back(std::move(nframe_promises_.front()), nframe);
+    nframe_promises_.pop_front();
+  }
+  if (!nframe_callbacks_->empty()) {
+    pending_nframe_callbacks_.emplace_back(nframe_callbacks_, nframe);
+  }
+  return true;
+}
+
+void VisualNPipeline::deliverPendingNFrames(std::unique_lock<std::mutex>* lock) {
+  CHECK_NOTNULL(lock);
+  CHECK(lock->owns_lock());
+  if (is_delivering_nframes_) {
+    // The delivering thread picks up the queued nframes after its current ones.
+    return;
+  }
+  is_delivering_nframes_ = true;
+  while (!pending_nframe_promises_.empty() || !pending_nframe_callbacks_.empty()) {
+    delivered_nframe_promises_.swap(pending_nframe_promises_);
+    delivered_nframe_callbacks_.swap(pending_nframe_callbacks_);
+    lock->unlock();
+    for (NFramePromiseDelivery& delivery : delivered_nframe_promises_) {
+      delivery.first.set_value(delivery.second);
+    }
+    for (const NFrameCallbackDelivery& delivery : delivered_nframe_callbacks_) {
+      for (const NFrameCallbackEntry& entry : *delivery.first) {
+        entry.executor->enqueueOrdered(
+            entry.exclusivity_group_id, entry.callback, delivery.second);
+      }
+    }
+    // The nframes are released without the lock, the vectors keep their capacity.
+    delivered_nframe_promises_.clear();
+    delivered_nframe_callbacks_.clear();
+    lock->lock();
+  }
+  is_delivering_nframes_ = false;
+}
+
 std::shared_ptr<VisualNFrame> VisualNPipeline::getNextImpl() {
   // Initialize the return value as null
   std::shared_ptr<VisualNFrame> nframe;
@@ -134,19 +315,591 @@ std::shared_ptr<VisualNFrame> VisualNPipeline::getNextImpl() {
   // Get the oldest frame.
   auto it_completed = completed_.begin();
   nframe = it_completed->second;
+  common::TraceRecorder::instance().recordInstant(
+      common::TraceStage::kConsume, 0u, it_completed->first);
   completed_.erase(it_completed);
   condition_not_full_.notify_all();
   return nframe;
 }
 
+void VisualNPipeline::processImage(
+    size_t camera_index, cv::Mat&& image, int64_t timestamp) {
+  const common::Deadline deadline = createFrameDeadline();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (admitImage(camera_index, &lock)) {
+    processImageImpl(camera_index, std::move(image), timestamp, false /* is_compressed */,
+                     deadline);
+  }
+}
+
+void VisualNPipeline::processImageBuffer(
+    size_t camera_index, void* data, size_t step, int type,
+    const ImageBufferDeleter& deleter, int64_t timestamp) {
+  CHECK_LT(camera_index, input_camera_system_->numCameras());
+  const Camera& camera = input_camera_system_->getCamera(camera_index);
+  processImage(camera_index,
+               wrapImageBuffer(static_cast<int>(camera.imageHeight()),
+                               static_cast<int>(camera.imageWidth()), type, data, step, deleter),
+               timestamp);
+}
+
+void VisualNPipeline::processCompressedImage(
+    size_t camera_index, const cv::Mat& data, int64_t timestamp) {
+  CHECK_LT(camera_index, pipelines_.size());
+  const common::Deadline deadline = createFrameDeadline();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (admitImage(camera_index, &lock)) {
+    processImageImpl(camera_index, data, timestamp, true /* is_compressed */, deadline);
+  }
+}
+
 void VisualNPipeline::processImageImpl(
-    size_t camera_index, const cv::Mat& image, int64_t timestamp) {
-  thread_pool_->enqueue(&VisualNPipeline::work, this, camera_index, image,
-                        timestamp);
+    size_t camera_index, cv::Mat image, int64_t timestamp, bool is_compressed,
+    const common::Deadline& deadline) {
+  std::shared_ptr<PreallocatedSlots> slots;
+  std::shared_ptr<VisualFrame> frame;
+  if (preallocate_nframes_) {
+    slots = reserveNFrameSlot(camera_index, timestamp, &frame);
+    if (!slots) {
+      return;
+    }
+  }
+  ++num_images_queued_;
+  // The enqueue time is passed on to the worker to trace the time spent in the queue.
+  const int64_t enqueue_time_nanoseconds = recordEnqueueTraceEvent(camera_index, timestamp);
+  ThreadPool* thread_pool = (scheduling_mode_ == SchedulingMode::kPerCameraWorker) ?
+      camera_thread_pools_[camera_index].get() : thread_pool_.get();
+  // The image header is moved into the task, the pixels are shared by reference counting.
+  if (is_compressed) {
+    thread_pool->enqueue(&VisualNPipeline::decodeAndWork, this, camera_index, std::move(image),
+                         timestamp, enqueue_time_nanoseconds, deadline, slots, frame);
+  } else {
+    thread_pool->enqueue(&VisualNPipeline::work, this, camera_index, std::move(image),
+                         timestamp, enqueue_time_nanoseconds, deadline, slots, frame);
+  }
+}
+
+int64_t VisualNPipeline::recordEnqueueTraceEvent(size_t camera_index, int64_t timestamp) {
+  common::TraceRecorder& trace_recorder = common::TraceRecorder::instance();
+  if (!trace_recorder.isEnabled()) {
+    // The worker scaling measures the latency from the enqueue time.
+    return is_worker_scaling_enabled_ ? common::TraceRecorder::now() : -1;
+  }
+  const int64_t enqueue_time_nanoseconds = common::TraceRecorder::now();
+  trace_recorder.record(common::TraceStage::kEnqueue, camera_index, timestamp,
+                        enqueue_time_nanoseconds, enqueue_time_nanoseconds);
+  return enqueue_time_nanoseconds;
+}
+
+void VisualNPipeline::processImages(
+    const std::vector<cv::Mat>& images, const std::vector<int64_t>& timestamps) {
+  CHECK_EQ(images.size(), pipelines_.size());
+  CHECK_EQ(timestamps.size(), images.size());
+  // The images arrive together and share the deadline.
+  const common::Deadline deadline = createFrameDeadline();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (scheduling_mode_ == SchedulingMode::kPerCameraWorker) {
+    for (size_t camera_index = 0u; camera_index < images.size(); ++camera_index) {
+      if (admitImage(camera_index, &lock)) {
+        processImageImpl(camera_index, images[camera_index], timestamps[camera_index],
+                         false /* is_compressed */, deadline);
+      }
+    }
+    return;
+  }
+
+  std::vector<size_t> admitted_camera_indices;
+  std::vector<int64_t> enqueue_times_nanoseconds;
+  std::vector<std::shared_ptr<PreallocatedSlots>> slots(images.size());
+  std::vector<std::shared_ptr<VisualFrame>> frames(images.size());
+  // The admitted images are only enqueued together with the whole batch. A blocking producer
+  // therefore has to wait for room for all images at once, waiting per image would wait for the
+  // images of this batch that are not enqueued yet.
+  const bool is_batch_admitted = in_flight_policy_ == InFlightPolicy::kBlockProducer;
+  if (is_batch_admitted && !admitImages(0u, images.size(), &lock)) {
+    return;
+  }
+  for (size_t camera_index = 0u; camera_index < images.size(); ++camera_index) {
+    if (is_batch_admitted || admitImage(camera_index, &lock)) {
+      if (preallocate_nframes_) {
+        slots[camera_index] =
+            reserveNFrameSlot(camera_index, timestamps[camera_index], &frames[camera_index]);
+        if (!slots[camera_index]) {
+          continue;
+        }
+      }
+      ++num_images_queued_;
+      admitted_camera_indices.push_back(camera_index);
+      enqueue_times_nanoseconds.push_back(
+          recordEnqueueTraceEvent(camera_index, timestamps[camera_index]));
+    }
+  }
+  if (admitted_camera_indices.empty()) {
+    return;
+  }
+  thread_pool_->enqueue(
+      [this, images, timestamps, admitted_camera_indices, enqueue_times_nanoseconds, deadline,
+       slots, frames]() {
+        for (size_t i = 0u; i < admitted_camera_indices.size(); ++i) {
+          const size_t camera_index = admitted_camera_indices[i];
+          work(camera_index, images[camera_index], timestamps[camera_index],
+               enqueue_times_nanoseconds[i], deadline, slots[camera_index],
+               frames[camera_index]);
+        }
+      });
+}
+
+size_t VisualNPipeline::processBatch(
+    const BatchImageSource& source, const NFrameCallback& callback,
+    size_t max_num_lookahead_nframes) {
+  CHECK(source);
+  CHECK(callback);
+  CHECK_GT(max_num_lookahead_nframes, 0u);
+  CHECK_EQ(num_images_queued_.load(), 0u) << "Images are still being processed.";
+  const size_t num_cameras = pipelines_.size();
+
+  struct BatchNFrame {
+    BatchNFrame() : num_frames_pending(0u) {}
+    std::shared_ptr<VisualNFrame> nframe;
+    std::shared_ptr<IntraRigMatchingState> intra_rig_matching;
+    /// Guarded by batch_mutex.
+    size_t num_frames_pending;
+  };
+  // The nframes read ahead, in the order of the source. The deque keeps the addresses of the
+  // elements stable for the workers.
+  std::deque<BatchNFrame> lookahead_nframes;
+  bool is_source_exhausted = false;
+  std::mutex batch_mutex;
+  std::condition_variable condition_nframe_complete;
+  std::condition_variable condition_lookahead_not_full;
+
+  std::thread reader_thread([&]() {
+    std::vector<int64_t> last_timestamps(num_cameras, std::numeric_limits<int64_t>::min());
+    BatchImages batch_images;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(batch_mutex);
+        condition_lookahead_not_full.wait(lock, [&]() {
+          return lookahead_nframes.size() < max_num_lookahead_nframes;
+        });
+      }
+      batch_images.images.clear();
+      batch_images.timestamps.clear();
+      if (!source(&batch_images)) {
+        break;
+      }
+      CHECK_EQ(batch_images.images.size(), num_cameras);
+      CHECK_EQ(batch_images.timestamps.size(), num_cameras);
+      for (size_t camera_index = 0u; camera_index < num_cameras; ++camera_index) {
+        CHECK_GT(batch_images.timestamps[camera_index], last_timestamps[camera_index])
+            << "The timestamps of camera " << camera_index << " don't increase.";
+        last_timestamps[camera_index] = batch_images.timestamps[camera_index];
+      }
+
+      std::shared_ptr<VisualNFrame> nframe = nframe_pool_ ?
+          nframe_pool_->acquire() :
+          std::shared_ptr<VisualNFrame>(new VisualNFrame(output_camera_system_));
+      BatchNFrame* batch_nframe = nullptr;
+      {
+        std::lock_guard<std::mutex> lock(batch_mutex);
+        lookahead_nframes.emplace_back();
+        batch_nframe = &lookahead_nframes.back();
+        batch_nframe->nframe = nframe;
+        batch_nframe->intra_rig_matching = createIntraRigMatchingState(nframe);
+        batch_nframe->num_frames_pending = num_cameras;
+      }
+      for (size_t camera_index = 0u; camera_index < num_cameras; ++camera_index) {
+        ThreadPool* thread_pool = (scheduling_mode_ == SchedulingMode::kPerCameraWorker) ?
+            camera_thread_pools_[camera_index].get() : thread_pool_.get();
+        const int64_t timestamp = batch_images.timestamps[camera_index];
+        thread_pool->enqueue(
+            [this, &batch_mutex, &condition_nframe_complete, batch_nframe, nframe, camera_index,
+             timestamp](const cv::Mat& image) {
+              common::ScopedThreadTraceContext trace_context(camera_index, timestamp);
+              std::shared_ptr<VisualFrame> frame;
+              if (frame_pools_.empty()) {
+                frame = pipelines_[camera_index]->processImage(image, timestamp);
+              } else {
+                frame = pipelines_[camera_index]->processImage(
+                    image, timestamp, frame_pools_[camera_index]->acquire());
+              }
+              nframe->setFrame(camera_index, frame);
+              if (batch_nframe->intra_rig_matching) {
+                matchIntraRigPairs(camera_index, frame, batch_nframe->intra_rig_matching.get());
+              }
+              // The batch nframe may be delivered and destroyed right after the decrement, and
+              // with the last nframe also the mutex and the condition on the stack of
+              // processBatch. Decrementing and notifying under the mutex keeps the consumer from
+              // observing the completion before the notification is done.
+              std::lock_guard<std::mutex> lock(batch_mutex);
+              CHECK_GT(batch_nframe->num_frames_pending, 0u);
+              if (--batch_nframe->num_frames_pending == 0u) {
+                condition_nframe_complete.notify_all();
+              }
+            },
+            std::move(batch_images.images[camera_index]));
+      }
+    }
+    std::lock_guard<std::mutex> lock(batch_mutex);
+    is_source_exhausted = true;
+    condition_nframe_complete.notify_all();
+  });
+
+  size_t num_nframes_delivered = 0u;
+  while (true) {
+    std::shared_ptr<VisualNFrame> nframe;
+    {
+      std::unique_lock<std::mutex> lock(batch_mutex);
+      condition_nframe_complete.wait(lock, [&]() {
+        return lookahead_nframes.empty() ? is_source_exhausted :
+            lookahead_nframes.front().num_frames_pending == 0u;
+      });
+      if (lookahead_nframes.empty()) {
+        break;
+      }
+      nframe = std::move(lookahead_nframes.front().nframe);
+      lookahead_nframes.pop_front();
+    }
+    condition_lookahead_not_full.notify_one();
+    callback(nframe);
+    ++num_nframes_delivered;
+  }
+  reader_thread.join();
+  return num_nframes_delivered;
+}
+
+bool VisualNPipeline::setSchedulingMode(
+    SchedulingMode mode, const std::vector<std::vector<size_t>>& camera_cpu_ids) {
+  waitForAllWorkToComplete();
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK(mode == SchedulingMode::kSharedPool || !is_worker_scaling_enabled_)
+      << "The worker scaling is only supported for the shared pool.";
+  bool success = true;
+  if (scheduling_mode_ == SchedulingMode::kSharedPool && !camera_numa_nodes_.empty() &&
+      !thread_pool_->resetCpuAffinity()) {
+    LOG(WARNING) << "Could not unpin the shared pool from its NUMA node.";
+    success = false;
+  }
+  scheduling_mode_ = mode;
+  camera_thread_pools_.clear();
+  // The new workers are not pinned to the nodes and the shared pool was unpinned.
+  camera_numa_nodes_.clear();
+  if (mode != SchedulingMode::kPerCameraWorker) {
+    CHECK(camera_cpu_ids.empty()) << "CPU ids are only supported for per-camera workers.";
+    return success;
+  }
+  CHECK(camera_cpu_ids.empty() || camera_cpu_ids.size() == pipelines_.size());
+  for (size_t camera_index = 0u; camera_index < pipelines_.size(); ++camera_index) {
+    camera_thread_pools_.emplace_back(new ThreadPool(1u));
+    if (!camera_cpu_ids.empty() && !camera_cpu_ids[camera_index].empty() &&
+        !camera_thread_pools_.back()->setCpuAffinity(camera_cpu_ids[camera_index])) {
+      LOG(WARNING) << "Could not pin the worker of camera " << camera_index << ".";
+      success = false;
+    }
+  }
+  return success;
+}
+
+bool VisualNPipeline::admitImage(size_t camera_index, std::unique_lock<std::mutex>* lock) {
+  return admitImages(camera_index, 1u, lock);
+}
+
+bool VisualNPipeline::admitImages(
+    size_t camera_index, size_t num_images, std::unique_lock<std::mutex>* lock) {
+  CHECK_NOTNULL(lock);
+  CHECK(lock->owns_lock());
+  CHECK_LT(camera_index, frame_drop_counters_.size());
+  CHECK_GT(num_images, 0u);
+  CHECK(num_images == 1u || in_flight_policy_ == InFlightPolicy::kBlockProducer)
+      << "Only a blocking producer admits several images at once.";
+  if (max_num_in_flight_ == 0u) {
+    return true;
+  }
+  switch (in_flight_policy_) {
+    case InFlightPolicy::kBlockProducer:
+      // A batch larger than the limit is admitted once nothing else is in flight.
+      while (!shutdown_ && num_images_queued_ + processing_.size() > 0u &&
+             num_images_queued_ + processing_.size() + num_images > max_num_in_flight_) {
+        if (num_images_queued_ == 0u) {
+          // Only incomplete nframes are left which can't complete without new images, waiting
+          // would block forever.
+          CHECK(!processing_.empty());
+          countDroppedFrames(processing_.begin()->second,
+                             &FrameDropCounters::num_dropped_oldest_incomplete_nframe);
+          eraseProcessingNFrame(processing_.begin());
+          continue;
+        }
+        condition_in_flight_decreased_.wait(*lock);
+      }
+      return !shutdown_;
+    case InFlightPolicy::kDropOldestIncompleteNFrame:
+      if (num_images_queued_ + processing_.size() < max_num_in_flight_) {
+        return true;
+      }
+      if (!processing_.empty()) {
+        countDroppedFrames(processing_.begin()->second,
+                           &FrameDropCounters::num_dropped_oldest_incomplete_nframe);
+        eraseProcessingNFrame(processing_.begin());
+        return true;
+      }
+      ++frame_drop_counters_[camera_index].num_dropped_newest_image;
+      return false;
+    case InFlightPolicy::kDropNewestImage:
+      if (num_images_queued_ + processing_.size() < max_num_in_flight_) {
+        return true;
+      }
+      ++frame_drop_counters_[camera_index].num_dropped_newest_image;
+      return false;
+    default:
+      LOG(FATAL) << "Unknown in-flight policy: " << static_cast<int>(in_flight_policy_);
+  }
+  return false;
+}
+
+void VisualNPipeline::countDroppedFrames(
+    const VisualNFrame& nframe, size_t FrameDropCounters::*counter) {
+  CHECK(counter != nullptr);
+  for (size_t frame_idx = 0u; frame_idx < nframe.getNumFrames(); ++frame_idx) {
+    if (nframe.isFrameSet(frame_idx)) {
+      CHECK_LT(frame_idx, frame_drop_counters_.size());
+      ++(frame_drop_counters_[frame_idx].*counter);
+    }
+  }
+}
+
+void VisualNPipeline::countDroppedFrames(
+    const ProcessingNFrame& processing_nframe, size_t FrameDropCounters::*counter) {
+  if (!processing_nframe.slots) {
+    countDroppedFrames(*CHECK_NOTNULL(processing_nframe.nframe.get()), counter);
+    return;
+  }
+  CHECK(counter != nullptr);
+  for (size_t frame_idx = 0u; frame_idx < frame_drop_counters_.size(); ++frame_idx) {
+    if (processing_nframe.slots->is_slot_complete[frame_idx].load(std::memory_order_acquire)) {
+      ++(frame_drop_counters_[frame_idx].*counter);
+    }
+  }
+}
+
+void VisualNPipeline::setFramePoolSize(size_t max_num_pooled_nframes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  frame_pools_.clear();
+  nframe_pool_.reset();
+  if (max_num_pooled_nframes == 0u) {
+    return;
+  }
+  for (size_t camera_idx = 0u; camera_idx < pipelines_.size(); ++camera_idx) {
+    frame_pools_.emplace_back(new common::ObjectPool<VisualFrame>(
+        max_num_pooled_nframes, []() { return new VisualFrame; },
+        [](VisualFrame* frame) {
+          // Release the image right away, it may refer to an external buffer.
+          frame->releaseRawImage();
+          if (frame->hasImagePyramid()) {
+            frame->releaseImagePyramid();
+          }
+          // The next image may have a different number of keypoints, stale channels of the
+          // previous size would not match the keypoints of the pipeline.
+          frame->releaseKeypointChannels();
+        }));
+  }
+  const std::shared_ptr<NCamera> output_camera_system = output_camera_system_;
+  nframe_pool_.reset(new common::ObjectPool<VisualNFrame>(
+      max_num_pooled_nframes,
+      [output_camera_system]() { return new VisualNFrame(output_camera_system); },
+      [](VisualNFrame* nframe) {
+        for (size_t frame_idx = 0u; frame_idx < nframe->getNumFrames(); ++frame_idx) {
+          nframe->unSetFrame(frame_idx);
+        }
+        // The matches refer to the keypoints of the released frames.
+        nframe->releaseIntraRigMatches();
+        NFramesId id;
+        id.randomize();
+        nframe->setId(id);
+      }));
+}
+
+void VisualNPipeline::setOutputMode(OutputMode mode, size_t lock_free_queue_capacity) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK(completed_.empty() && (!lock_free_queue_ || lock_free_queue_->empty()) &&
+        latest_nframe_.load() == nullptr) << "Can't change the output mode with pending nframes.";
+  output_mode_ = mode;
+  lock_free_queue_.reset();
+  if (mode == OutputMode::kLockFreeQueue) {
+    lock_free_queue_.reset(
+        new common::SpscQueue<TimestampVisualNFramePair>(lock_free_queue_capacity));
+  }
+}
+
+void VisualNPipeline::publishCompletedNFrame(
+    int64_t timestamp_nanoseconds, const std::shared_ptr<VisualNFrame>& nframe) {
+  CHECK(nframe);
+  if (pushCompletedNFrame(timestamp_nanoseconds, nframe)) {
+    return;
+  }
+  switch (output_mode_) {
+    case OutputMode::kLockedQueue:
+      completed_.emplace(timestamp_nanoseconds, nframe);
+      condition_not_empty_.notify_all();
+      break;
+    case OutputMode::kLockFreeQueue:
+      if (!lock_free_queue_->tryPush(TimestampVisualNFramePair(timestamp_nanoseconds, nframe))) {
+        countDroppedFrames(*nframe, &FrameDropCounters::num_dropped_output_queue_full);
+      }
+      break;
+    case OutputMode::kLockFreeLatest: {
+      std::unique_ptr<TimestampVisualNFramePair> replaced_nframe(latest_nframe_.exchange(
+          new TimestampVisualNFramePair(timestamp_nanoseconds, nframe)));
+      if (replaced_nframe) {
+        countDroppedFrames(*replaced_nframe->second,
+                           &FrameDropCounters::num_dropped_output_queue_full);
+      }
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unknown output mode " << static_cast<int>(output_mode_) << ".";
+  }
+}
+
+void VisualNPipeline::setMaxNumInFlight(size_t max_num_in_flight, InFlightPolicy policy) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_num_in_flight_ = max_num_in_flight;
+  in_flight_policy_ = policy;
+  condition_in_flight_decreased_.notify_all();
+}
+
+size_t VisualNPipeline::getNumInFlight() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_images_queued_ + processing_.size();
+}
+
+void VisualNPipeline::setFrameProcessingBudget(int64_t budget_nanoseconds) {
+  CHECK_GE(budget_nanoseconds, 0);
+  frame_processing_budget_nanoseconds_ = budget_nanoseconds;
+}
+
+common::Deadline VisualNPipeline::createFrameDeadline() const {
+  const int64_t budget_nanoseconds = frame_processing_budget_nanoseconds_;
+  return (budget_nanoseconds > 0) ? common::Deadline::fromNow(budget_nanoseconds)
+                                  : common::Deadline();
+}
+
+VisualNPipeline::FrameDropCounters VisualNPipeline::getFrameDropCounters(
+    size_t camera_index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK_LT(camera_index, frame_drop_counters_.size());
+  return frame_drop_counters_[camera_index];
+}
+
+size_t VisualNPipeline::getMemoryUsageBytes(const std::string& tag,
+                                            common::MemoryUsageReport* report) const {
+  size_t num_bytes = sizeof(*this);
+  if (report != nullptr) {
+    report->add(tag + "/other", num_bytes);
+  }
+  for (size_t camera_idx = 0u; camera_idx < pipelines_.size(); ++camera_idx) {
+    const size_t num_pipeline_bytes = pipelines_[camera_idx]->getMemoryUsageBytes();
+    if (report != nullptr) {
+      report->add(tag + "/pipeline_" + std::to_string(camera_idx), num_pipeline_bytes);
+    }
+    num_bytes += num_pipeline_bytes;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::string processing_tag = tag + "/processing";
+  for (const TimestampProcessingNFrameMap::value_type& timestamp_nframe : processing_) {
+    const ProcessingNFrame& processing_nframe = timestamp_nframe.second;
+    const VisualNFrame& nframe = *CHECK_NOTNULL(processing_nframe.nframe.get());
+    for (size_t frame_idx = 0u; frame_idx < nframe.getNumFrames(); ++frame_idx) {
+      // The workers fill the slots of preallocated nframes without the lock.
+      if (!nframe.isFrameSet(frame_idx) || (processing_nframe.slots &&
+          !processing_nframe.slots->is_slot_complete[frame_idx].load(
+              std::memory_order_acquire))) {
+        continue;
+      }
+      num_bytes += nframe.getFrame(frame_idx).getMemoryUsageBytes(processing_tag, report);
+    }
+  }
+  const std::string completed_tag = tag + "/completed";
+  for (const TimestampVisualNFrameMap::value_type& timestamp_nframe : completed_) {
+    num_bytes += CHECK_NOTNULL(timestamp_nframe.second.get())->getMemoryUsageBytes(
+        completed_tag, report);
+  }
+
+  const auto get_frame_bytes = [](const VisualFrame& frame) {
+    return frame.getMemoryUsageBytes();
+  };
+  for (size_t camera_idx = 0u; camera_idx < frame_pools_.size(); ++camera_idx) {
+    const size_t num_pool_bytes =
+        frame_pools_[camera_idx]->getPooledMemoryUsageBytes(get_frame_bytes);
+    if (report != nullptr) {
+      report->add(tag + "/frame_pool_" + std::to_string(camera_idx), num_pool_bytes);
+    }
+    num_bytes += num_pool_bytes;
+  }
+  for (size_t camera_idx = 0u; camera_idx < decoded_image_pools_.size(); ++camera_idx) {
+    const size_t num_pool_bytes = decoded_image_pools_[camera_idx]->getPooledMemoryUsageBytes(
+        [](const cv::Mat& image) { return common::getMemoryUsageBytes(image); });
+    if (report != nullptr) {
+      report->add(tag + "/decoded_image_pool_" + std::to_string(camera_idx), num_pool_bytes);
+    }
+    num_bytes += num_pool_bytes;
+  }
+  if (nframe_pool_) {
+    const size_t num_pool_bytes = nframe_pool_->getPooledMemoryUsageBytes(
+        [](const VisualNFrame& nframe) { return nframe.getMemoryUsageBytes(); });
+    if (report != nullptr) {
+      report->add(tag + "/nframe_pool", num_pool_bytes);
+    }
+    num_bytes += num_pool_bytes;
+  }
+  return num_bytes;
+}
+
+void VisualNPipeline::addMemoryUsageToStatistics() const {
+  common::MemoryUsageReport report;
+  getMemoryUsageBytes("VisualNPipeline", &report);
+  report.addToStatistics();
+}
+
+void VisualNPipeline::setMemoryUsageReportingPeriod(int64_t period_nanoseconds) {
+  CHECK_GE(period_nanoseconds, 0);
+  next_memory_usage_report_nanoseconds_ = common::TraceRecorder::now() + period_nanoseconds;
+  memory_usage_reporting_period_nanoseconds_ = period_nanoseconds;
+}
+
+void VisualNPipeline::addPeriodicMemoryUsageToStatistics() {
+  const int64_t period_nanoseconds = memory_usage_reporting_period_nanoseconds_;
+  if (period_nanoseconds <= 0) {
+    return;
+  }
+  const int64_t time_nanoseconds = common::TraceRecorder::now();
+  int64_t next_report_nanoseconds = next_memory_usage_report_nanoseconds_;
+  // Only the worker advancing the report time collects the report.
+  if (time_nanoseconds < next_report_nanoseconds ||
+      !next_memory_usage_report_nanoseconds_.compare_exchange_strong(
+          next_report_nanoseconds, time_nanoseconds + period_nanoseconds)) {
+    return;
+  }
+  addMemoryUsageToStatistics();
 }
 
 std::shared_ptr<VisualNFrame> VisualNPipeline::getLatestAndClear() {
   std::shared_ptr<VisualNFrame> nframe;
+  if (output_mode_ == OutputMode::kLockFreeQueue) {
+    std::shared_ptr<VisualNFrame> next_nframe;
+    while ((next_nframe = getNext())) {
+      nframe.swap(next_nframe);
+    }
+    return nframe;
+  } else if (output_mode_ == OutputMode::kLockFreeLatest) {
+    std::unique_ptr<TimestampVisualNFramePair> timestamp_nframe(latest_nframe_.exchange(nullptr));
+    if (timestamp_nframe) {
+      common::TraceRecorder::instance().recordInstant(
+          common::TraceStage::kConsume, 0u, timestamp_nframe->first);
+      nframe = timestamp_nframe->second;
+    }
+    return nframe;
+  }
   std::lock_guard<std::mutex> lock(mutex_);
   if (completed_.empty()) {
     return nframe;
@@ -154,20 +907,25 @@ std::shared_ptr<VisualNFrame> VisualNPipeline::getLatestAndClear() {
   auto reverse_it_completed = completed_.rbegin();
   nframe = reverse_it_completed->second;
   const int64_t timestamp_nanoseconds = reverse_it_completed->first;
+  common::TraceRecorder::instance().recordInstant(
+      common::TraceStage::kConsume, 0u, timestamp_nanoseconds);
   completed_.clear();
   condition_not_full_.notify_all();
   // Clear any processing frames older than this one.
   auto it_processing = processing_.begin();
   while (it_processing != processing_.end()
       && it_processing->first <= timestamp_nanoseconds) {
-    it_processing = processing_.erase(it_processing);
+    it_processing = eraseProcessingNFrame(it_processing);
   }
+  condition_in_flight_decreased_.notify_all();
   return nframe;
 }
 
 bool VisualNPipeline::getLatestAndClearBlocking(
     std::shared_ptr<VisualNFrame>* nframe)  {
   CHECK_NOTNULL(nframe);
+  CHECK(output_mode_ == OutputMode::kLockedQueue)
+      << "The blocking getters require the locked output queue.";
 
   std::unique_lock<std::mutex> lock(mutex_);
   while (!shutdown_) {
@@ -183,15 +941,18 @@ bool VisualNPipeline::getLatestAndClearBlocking(
     *nframe = nframe_iterator->second;
     CHECK(*nframe);
     const int64_t timestamp_nanoseconds = nframe_iterator->first;
+    common::TraceRecorder::instance().recordInstant(
+        common::TraceStage::kConsume, 0u, timestamp_nanoseconds);
     completed_.clear();
     condition_not_full_.notify_all();
     // Clear any processing frames older than this one.
-    TimestampVisualNFrameMap::iterator processing_iterator =
+    TimestampProcessingNFrameMap::iterator processing_iterator =
         processing_.begin();
     while (processing_iterator != processing_.end() &&
         processing_iterator->first <= timestamp_nanoseconds) {
-      processing_iterator = processing_.erase(processing_iterator);
+      processing_iterator = eraseProcessingNFrame(processing_iterator);
     }
+    condition_in_flight_decreased_.notify_all();
     return true;
   }
   return false;
@@ -211,125 +972,639 @@ size_t VisualNPipeline::getNumFramesProcessing() const {
 }
 
 void VisualNPipeline::work(size_t camera_index, const cv::Mat& image,
-                           int64_t timestamp_nanoseconds) {
+                           int64_t timestamp_nanoseconds, int64_t enqueue_time_nanoseconds,
+                           const common::Deadline& deadline,
+                           const std::shared_ptr<PreallocatedSlots>& slots,
+                           const std::shared_ptr<VisualFrame>& preallocated_frame) {
   CHECK_LE(camera_index, pipelines_.size());
+  common::ScopedThreadTraceContext trace_context(camera_index, timestamp_nanoseconds);
+  static const size_t kTimerHandle = timing::Timing::GetHandle("VisualNPipeline::work");
+  timing::Timer timer(kTimerHandle);
+  common::AllocationCounter allocation_counter("VisualNPipeline::work");
+  common::DeadlineScope deadline_scope(deadline);
+  if (enqueue_time_nanoseconds >= 0) {
+    common::TraceRecorder::instance().record(
+        common::TraceStage::kDequeue, camera_index, timestamp_nanoseconds,
+        enqueue_time_nanoseconds, common::TraceRecorder::now());
+  }
+  addPeriodicMemoryUsageToStatistics();
+
+  if (slots) {
+    // The frame is filled in place in the preallocated nframe.
+    CHECK(preallocated_frame);
+    {
+      common::SteadyStateScope steady_state(check_steady_state_allocations_);
+      pipelines_[camera_index]->processImage(image, timestamp_nanoseconds, preallocated_frame);
+    }
+    addWorkerScalingSample(enqueue_time_nanoseconds);
+    if (slots->intra_rig_matching) {
+      matchIntraRigPairs(camera_index, preallocated_frame, slots->intra_rig_matching.get());
+    }
+    slots->is_slot_complete[camera_index].store(true, std::memory_order_release);
+    if (slots->num_slots_incomplete.fetch_sub(1u) > 1u) {
+      // Other slots are still being filled, hence the nframe can't be published yet.
+      CHECK_GT(num_images_queued_.fetch_sub(1u), 0u);
+      if (max_num_in_flight_ != 0u) {
+        // Locking before notifying guarantees that a producer checking the in-flight count
+        // before the decrement is already waiting.
+        std::lock_guard<std::mutex> lock(mutex_);
+        condition_in_flight_decreased_.notify_all();
+      }
+      return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    publishCompletedNFrames(camera_index);
+    deliverPendingNFrames(&lock);
+    CHECK_GT(num_images_queued_.load(), 0u);
+    --num_images_queued_;
+    condition_in_flight_decreased_.notify_all();
+    return;
+  }
+
   std::shared_ptr<VisualFrame> frame;
-  frame = pipelines_[camera_index]->processImage(image, timestamp_nanoseconds);
+  if (frame_pools_.empty()) {
+    frame = pipelines_[camera_index]->processImage(image, timestamp_nanoseconds);
+  } else {
+    std::shared_ptr<VisualFrame> recycled_frame = frame_pools_[camera_index]->acquire();
+    common::SteadyStateScope steady_state(check_steady_state_allocations_);
+    frame = pipelines_[camera_index]->processImage(
+        image, timestamp_nanoseconds, recycled_frame);
+  }
+  addWorkerScalingSample(enqueue_time_nanoseconds);
 
-  /// Create an iterator into the processing queue.
-  std::map<int64_t, std::shared_ptr<VisualNFrame>>::iterator proc_it;
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Use the timestamp of the frame because there may be a timestamp corrector used in the
+  // pipeline.
+  bool is_new = false;
+  TimestampProcessingNFrameMap::iterator proc_it =
+      findOrAddProcessingNFrame(frame->getTimestampNanoseconds(), &is_new);
+  VisualFrame::Ptr existing_frame = proc_it->second.nframe->getFrameShared(camera_index);
+  if (existing_frame && proc_it->second.intra_rig_matching) {
+    // The intra-rig pairs of the camera are matched with the first frame.
+    LOG(ERROR) << "Dropping a second frame at index " << camera_index << " with timestamp "
+               << frame->getTimestampNanoseconds() << " of an nframe with intra-rig matching.";
+    ++frame_drop_counters_[camera_index].num_dropped_newest_image;
+    CHECK_GT(num_images_queued_.load(), 0u);
+    --num_images_queued_;
+    condition_in_flight_decreased_.notify_all();
+    return;
+  }
+  if (existing_frame) {
+    LOG(ERROR) << "Overwriting a frame at index " << camera_index << ":" << std::endl
+        << *existing_frame << std::endl << "with a new frame: "
+        << *frame << std::endl << "because the timestamp was the same.";
+  }
+  proc_it->second.nframe->setFrame(camera_index, frame);
+  if (proc_it->second.intra_rig_matching) {
+    // The pairs are matched without the lock, the nframe completes once all pairs are matched.
+    const std::shared_ptr<IntraRigMatchingState> intra_rig_matching =
+        proc_it->second.intra_rig_matching;
+    lock.unlock();
+    matchIntraRigPairs(camera_index, frame, intra_rig_matching.get());
+    lock.lock();
+  }
+
+  publishCompletedNFrames(camera_index);
+  deliverPendingNFrames(&lock);
+
+  CHECK_GT(num_images_queued_.load(), 0u);
+  --num_images_queued_;
+  condition_in_flight_decreased_.notify_all();
+}
+
+void VisualNPipeline::decodeAndWork(size_t camera_index, const cv::Mat& data,
+                                    int64_t timestamp_nanoseconds,
+                                    int64_t enqueue_time_nanoseconds,
+                                    const common::Deadline& deadline,
+                                    const std::shared_ptr<PreallocatedSlots>& slots,
+                                    const std::shared_ptr<VisualFrame>& frame) {
+  cv::Mat image;
+  bool is_decoded = false;
   {
-    std::lock_guard<std::mutex> lock(mutex_);
-    bool create_new_nframes = false;
-    if (processing_.empty()) {
-      create_new_nframes = true;
-    } else {
-      // Try to find an existing NFrame in the processing list.
-      // Use the timestamp of the frame because there may be a timestamp
-      // corrector used in the pipeline.
-      auto it_processing = processing_.lower_bound(
-          frame->getTimestampNanoseconds());
-      // Lower bound returns the first element that is not less than the value
-      // (i.e. greater than or equal to the value).
-      if (it_processing != processing_.begin()) { --it_processing; }
-      // Now it_processing points to the first element that is less than the
-      // value. Check both this value, and the one >=.
-      int64_t min_time_diff = std::abs(
-          it_processing->first - frame->getTimestampNanoseconds());
-      proc_it = it_processing;
-      if (++it_processing != processing_.end()) {
-        const int64_t time_diff = std::abs(
-            it_processing->first - frame->getTimestampNanoseconds());
-        if (time_diff < min_time_diff) {
-          proc_it = it_processing;
-          min_time_diff = time_diff;
-        }
+    common::ScopedTraceEvent trace_event(
+        common::TraceStage::kDecode, camera_index, timestamp_nanoseconds);
+    is_decoded = decodeImage(camera_index, data, &image);
+  }
+  if (is_decoded) {
+    work(camera_index, image, timestamp_nanoseconds, enqueue_time_nanoseconds, deadline, slots,
+         frame);
+    return;
+  }
+
+  // The nframe misses the frame of this camera, it is dropped as unsynchronized once newer
+  // nframes complete.
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++frame_drop_counters_[camera_index].num_dropped_decoding_failed;
+  CHECK_GT(num_images_queued_.load(), 0u);
+  --num_images_queued_;
+  condition_in_flight_decreased_.notify_all();
+}
+
+bool VisualNPipeline::decodeImage(size_t camera_index, const cv::Mat& data, cv::Mat* image) {
+  CHECK_NOTNULL(image);
+  static const size_t kTimerHandle = timing::Timing::GetHandle("VisualNPipeline::decodeImage");
+  timing::Timer timer(kTimerHandle);
+  const std::shared_ptr<cv::Mat> buffer = decoded_image_pools_[camera_index]->acquire();
+  if (!image_decoders_[camera_index]->decode(data, buffer.get())) {
+    LOG(ERROR) << "Could not decode the image of camera " << camera_index << ".";
+    return false;
+  }
+  const Camera& camera = input_camera_system_->getCamera(camera_index);
+  if (static_cast<size_t>(buffer->cols) != camera.imageWidth() ||
+      static_cast<size_t>(buffer->rows) != camera.imageHeight()) {
+    LOG(ERROR) << "The decoded image of camera " << camera_index << " has " << buffer->cols
+               << "x" << buffer->rows << " pixels instead of the " << camera.imageWidth() << "x"
+               << camera.imageHeight() << " pixels of the input camera.";
+    return false;
+  }
+  // The deleter holds the buffer, which returns to the pool once the last frame referencing the
+  // image is released.
+  *image = wrapImageBuffer(buffer->rows, buffer->cols, buffer->type(), buffer->data,
+                           buffer->step[0], [buffer](void* /*data*/) {});
+  return true;
+}
+
+VisualNPipeline::TimestampProcessingNFrameMap::iterator
+VisualNPipeline::findOrAddProcessingNFrame(int64_t timestamp_nanoseconds, bool* is_new) {
+  CHECK_NOTNULL(is_new);
+  /// Create an iterator into the processing queue.
+  TimestampProcessingNFrameMap::iterator proc_it;
+  // The index holds the processing nframe closest to the timestamp within the tolerance, if any.
+  TimestampProcessingNFrameMap::iterator* indexed_it =
+      processing_index_.findClosest(timestamp_nanoseconds);
+  const bool create_new_nframes = (indexed_it == nullptr);
+  if (!create_new_nframes) {
+    proc_it = *indexed_it;
+  }
+
+  if (create_new_nframes) {
+    ProcessingNFrame processing_nframe;
+    processing_nframe.nframe = nframe_pool_ ?
+        nframe_pool_->acquire() :
+        std::shared_ptr<VisualNFrame>(new VisualNFrame(output_camera_system_));
+    processing_nframe.intra_rig_matching = createIntraRigMatchingState(processing_nframe.nframe);
+    bool not_replaced;
+    std::tie(proc_it, not_replaced) = processing_.insert(
+        std::make_pair(timestamp_nanoseconds, processing_nframe));
+    CHECK(not_replaced);
+    processing_index_.insert(timestamp_nanoseconds, proc_it);
+  }
+  *is_new = create_new_nframes;
+  return proc_it;
+}
+
+std::shared_ptr<VisualNPipeline::PreallocatedSlots> VisualNPipeline::reserveNFrameSlot(
+    size_t camera_index, int64_t timestamp_nanoseconds, std::shared_ptr<VisualFrame>* frame) {
+  CHECK_NOTNULL(frame);
+  CHECK_LT(camera_index, pipelines_.size());
+  bool is_new = false;
+  ProcessingNFrame& processing_nframe =
+      findOrAddProcessingNFrame(timestamp_nanoseconds, &is_new)->second;
+  if (is_new) {
+    // Fill all camera slots up front, the workers only fill the frames.
+    const size_t num_cameras = pipelines_.size();
+    processing_nframe.slots.reset(new PreallocatedSlots(num_cameras));
+    processing_nframe.slots->intra_rig_matching = processing_nframe.intra_rig_matching;
+    for (size_t slot_idx = 0u; slot_idx < num_cameras; ++slot_idx) {
+      processing_nframe.nframe->setFrame(slot_idx, frame_pools_.empty() ?
+          std::shared_ptr<VisualFrame>(new VisualFrame) :
+          frame_pools_[slot_idx]->acquire());
+    }
+  }
+  CHECK(processing_nframe.slots) << "The nframe at " << timestamp_nanoseconds
+      << " was not preallocated.";
+  if (processing_nframe.slots->is_slot_reserved[camera_index]) {
+    LOG(ERROR) << "Dropping the image of camera " << camera_index << " at "
+               << timestamp_nanoseconds << " as the frame of the nframe is already taken.";
+    ++frame_drop_counters_[camera_index].num_dropped_newest_image;
+    return std::shared_ptr<PreallocatedSlots>();
+  }
+  processing_nframe.slots->is_slot_reserved[camera_index] = true;
+  *frame = processing_nframe.nframe->getFrameShared(camera_index);
+  return processing_nframe.slots;
+}
+
+VisualNPipeline::TimestampProcessingNFrameMap::iterator VisualNPipeline::eraseProcessingNFrame(
+    TimestampProcessingNFrameMap::iterator it) {
+  CHECK(it != processing_.end());
+  CHECK(processing_index_.erase(it->first));
+  return processing_.erase(it);
+}
+
+void VisualNPipeline::publishCompletedNFrames(size_t camera_index) {
+  // Find the first index that has N consecutive complete nframes following in chronological
+  // ordering.
+  // E.g. N=3    I I C I C C C C C   (I: incomplete, C: complete)
+  //      idx    0 1 2 3 4 5 6 7 8
+  //                     # --> first index with N complete = 4
+  const size_t kNumMinConsecutiveCompleteThreshold = 2u;
+  int delete_upto_including_index = -1;
+  if (processing_.size() > kNumMinConsecutiveCompleteThreshold + 1) {
+    size_t num_consecutive_complete = 0u;
+    size_t idx = 0u;
+    auto it_processing = processing_.begin();
+    while (it_processing != processing_.end()) {
+      bool is_complete = it_processing->second.isComplete();
+      if (is_complete) {
+        ++num_consecutive_complete;
+      } else {
+        num_consecutive_complete = 0u;
       }
-      // Now proc_it points to the closest nframes element.
-      if (min_time_diff > timestamp_tolerance_ns_) {
-       create_new_nframes = true;
+      if (num_consecutive_complete >= kNumMinConsecutiveCompleteThreshold) {
+        delete_upto_including_index = static_cast<int>(idx) -
+            static_cast<int>(kNumMinConsecutiveCompleteThreshold);
+        break;
       }
+      ++it_processing;
+      ++idx;
+    }
+  }
+
+  // Now drop all incomplete nframes up to delete_upto_including_index. All frames below this
+  // index will probably never complete as one camera in the rig dropped an image.
+  if (delete_upto_including_index >= 0) {
+    int num_nframes_to_delete = delete_upto_including_index + 1;
+    auto it_processing = processing_.begin();
+    while (it_processing != processing_.end() && num_nframes_to_delete-- > 0) {
+      countDroppedFrames(it_processing->second, &FrameDropCounters::num_dropped_unsynchronized);
+      it_processing = eraseProcessingNFrame(it_processing);
+    }
+    LOG(WARNING) << "Detected frame drop: removing " << delete_upto_including_index + 1
+                 << " nframes from the queue.";
+  }
+
+  // Move all completed nframes from the processed_ queue to the completed_ queue chronologically.
+  auto it_processing = processing_.begin();
+  while (it_processing != processing_.end()) {
+    // Check if all images have been received.
+    if (it_processing->second.isComplete()) {
+      common::TraceRecorder::instance().recordInstant(
+          common::TraceStage::kNFrameComplete, camera_index, it_processing->first);
+      publishCompletedNFrame(it_processing->first, it_processing->second.nframe);
+      it_processing = eraseProcessingNFrame(it_processing);
+    } else {
+      // As we are iterating over the map in chronological order we have to abort once an nframe
+      // is not yet finished processing to keep chronological ordering in the destination queue.
+      break;
     }
+  }
+}
+
+VisualNPipeline::PreallocatedSlots::PreallocatedSlots(size_t num_slots)
+    : is_slot_reserved(num_slots, false),
+      is_slot_complete(new std::atomic<bool>[num_slots]),
+      num_slots_incomplete(num_slots) {
+  for (size_t slot_idx = 0u; slot_idx < num_slots; ++slot_idx) {
+    is_slot_complete[slot_idx].store(false);
+  }
+}
+
+VisualNPipeline::IntraRigMatchingState::IntraRigMatchingState(
+    const std::shared_ptr<VisualNFrame>& nframe, size_t num_cameras, size_t num_pairs)
+    : nframe(nframe),
+      frames(num_cameras),
+      is_camera_counted(new std::atomic<bool>[num_cameras]),
+      num_pair_frames_set(new std::atomic<size_t>[num_pairs]),
+      pair_matches(num_pairs),
+      num_pairs_pending(num_pairs),
+      is_complete(false) {
+  CHECK(nframe);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    is_camera_counted[camera_idx].store(false);
+  }
+  for (size_t pair_idx = 0u; pair_idx < num_pairs; ++pair_idx) {
+    num_pair_frames_set[pair_idx].store(0u);
+  }
+}
 
-    if (create_new_nframes) {
-      std::shared_ptr<VisualNFrame> nframes(
-          new VisualNFrame(output_camera_system_));
-      bool not_replaced;
-      std::tie(proc_it, not_replaced) = processing_.insert(
-          std::make_pair(frame->getTimestampNanoseconds(), nframes)
-      );
-      CHECK(not_replaced);
-    }
-    // Now proc_it points to the correct place in the processing_ list and
-    // the NFrame has been created if necessary.
-    VisualFrame::Ptr existing_frame = proc_it->second->getFrameShared(
-        camera_index);
-    if (existing_frame) {
-      LOG(ERROR) << "Overwriting a frame at index " << camera_index << ":" << std::endl
-          << *existing_frame << std::endl << "with a new frame: "
-          << *frame << std::endl << "because the timestamp was the same.";
-    }
-    proc_it->second->setFrame(camera_index, frame);
-
-    // Find the first index that has N consecutive complete nframes following in chronological
-    // ordering.
-    // E.g. N=3    I I C I C C C C C   (I: incomplete, C: complete)
-    //      idx    0 1 2 3 4 5 6 7 8
-    //                     # --> first index with N complete = 4
-    const size_t kNumMinConsecutiveCompleteThreshold = 2u;
-    int delete_upto_including_index = -1;
-    if (processing_.size() > kNumMinConsecutiveCompleteThreshold + 1) {
-      size_t num_consecutive_complete = 0u;
-      size_t idx = 0u;
-      auto it_processing = processing_.begin();
-      while (it_processing != processing_.end()) {
-        bool is_complete = CHECK_NOTNULL(it_processing->second.get())->areAllFramesSet();
-        if (is_complete) {
-          ++num_consecutive_complete;
-        } else {
-          num_consecutive_complete = 0u;
+bool VisualNPipeline::ProcessingNFrame::isComplete() const {
+  if (slots) {
+    return slots->num_slots_incomplete.load() == 0u;
+  }
+  if (intra_rig_matching && !intra_rig_matching->is_complete.load(std::memory_order_acquire)) {
+    return false;
+  }
+  return CHECK_NOTNULL(nframe.get())->areAllFramesSet();
+}
+
+void VisualNPipeline::setPreallocateNFrames(bool preallocate) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK(processing_.empty() && num_images_queued_ == 0u)
+      << "Can't change the nframe preallocation while images are processed.";
+  preallocate_nframes_ = preallocate;
+}
+
+void VisualNPipeline::setRealTimeOptions(const RealTimeOptions& options) {
+  waitForAllWorkToComplete();
+  // Locking first keeps the preallocated pages resident as well.
+  if (options.lock_memory) {
+    common::lockAllMemory();
+  }
+  if (options.num_preallocated_nframes > 0u) {
+    setFramePoolSize(options.num_preallocated_nframes);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK(processing_.empty() && num_images_queued_ == 0u)
+      << "Can't change the real-time options while images are processed.";
+  if (options.num_preallocated_nframes > 0u) {
+    const int num_keypoints = static_cast<int>(options.max_num_keypoints_per_frame);
+    const int descriptor_size_bytes = static_cast<int>(options.descriptor_size_bytes);
+    // The channels have no capacity beyond their size, hence the memory is reserved in the heap:
+    // the channels of all frames are written, which pre-faults their pages, and released again
+    // by the recycler. The retained heap then serves the channels of the pipelines.
+    const auto initialize_frame = [num_keypoints, descriptor_size_bytes](VisualFrame* frame) {
+      frame->setKeypointMeasurements(Eigen::Matrix2Xd::Zero(2, num_keypoints));
+      frame->setKeypointMeasurementUncertainties(Eigen::VectorXd::Zero(num_keypoints));
+      frame->setKeypointOrientations(Eigen::VectorXd::Zero(num_keypoints));
+      frame->setKeypointScores(Eigen::VectorXd::Zero(num_keypoints));
+      frame->setKeypointScales(Eigen::VectorXd::Zero(num_keypoints));
+      frame->setTrackIds(Eigen::VectorXi::Constant(num_keypoints, -1));
+      if (descriptor_size_bytes > 0) {
+        frame->setDescriptors(
+            VisualFrame::DescriptorsT::Zero(descriptor_size_bytes, num_keypoints));
+      }
+    };
+    if (num_keypoints > 0) {
+      common::retainFreedHeapMemory();
+    }
+    // Acquired until the frames of all cameras are written, such that no frame reuses the
+    // memory of another one.
+    std::vector<std::shared_ptr<VisualFrame>> written_frames;
+    for (size_t camera_index = 0u; camera_index < frame_pools_.size(); ++camera_index) {
+      common::ObjectPool<VisualFrame>* frame_pool = frame_pools_[camera_index].get();
+      const auto preallocate_frames = [&options, &initialize_frame, &written_frames,
+                                       num_keypoints, frame_pool]() {
+        if (num_keypoints == 0) {
+          frame_pool->preallocate(options.num_preallocated_nframes, nullptr);
+          return;
         }
-        if (num_consecutive_complete >= kNumMinConsecutiveCompleteThreshold) {
-          delete_upto_including_index = static_cast<int>(idx) -
-              static_cast<int>(kNumMinConsecutiveCompleteThreshold);
-          break;
+        frame_pool->preallocate(options.num_preallocated_nframes, initialize_frame);
+        for (size_t frame_idx = 0u; frame_idx < options.num_preallocated_nframes; ++frame_idx) {
+          written_frames.emplace_back(frame_pool->acquire());
         }
-        ++it_processing;
-        ++idx;
+      };
+      if (camera_numa_nodes_.empty()) {
+        preallocate_frames();
+      } else {
+        // The first touch by a worker of the camera places the pages on its node.
+        ThreadPool* thread_pool = (scheduling_mode_ == SchedulingMode::kPerCameraWorker) ?
+            camera_thread_pools_[camera_index].get() : thread_pool_.get();
+        thread_pool->enqueue(preallocate_frames).wait();
       }
     }
+    // Returning the frames to their pools releases the channels, the frames are handed out
+    // without keypoints.
+    written_frames.clear();
+    nframe_pool_->preallocate(options.num_preallocated_nframes, nullptr);
+    VLOG(1) << "Preallocated " << options.num_preallocated_nframes << " nframes with room for "
+            << num_keypoints << " keypoints per frame.";
+  }
 
-    // Now drop all incomplete nframes up to delete_upto_including_index. All frames below this
-    // index will probably never complete as one camera in the rig dropped an image.
-    if (delete_upto_including_index >= 0) {
-      int num_nframes_to_delete = delete_upto_including_index + 1;
-      auto it_processing = processing_.begin();
-      while (it_processing != processing_.end() && num_nframes_to_delete-- > 0) {
-        it_processing = processing_.erase(it_processing);
+  if (!options.worker_cpu_ids.empty()) {
+    thread_pool_->setCpuAffinity(options.worker_cpu_ids);
+  }
+  if (options.worker_priority > 0) {
+    thread_pool_->setRealTimePriority(options.worker_priority);
+    for (const std::shared_ptr<ThreadPool>& camera_thread_pool : camera_thread_pools_) {
+      camera_thread_pool->setRealTimePriority(options.worker_priority);
+    }
+  }
+
+  check_steady_state_allocations_ = options.check_steady_state_allocations;
+  if (check_steady_state_allocations_ && !common::areAllocationHooksInstalled()) {
+    LOG(WARNING) << "Link aslam_cv_common_allocation_hooks to observe the steady-state "
+                 << "allocations of the camera pipelines.";
+  }
+}
+
+bool VisualNPipeline::setNumaPlacement(const std::vector<size_t>& camera_numa_nodes) {
+  waitForAllWorkToComplete();
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK(processing_.empty() && num_images_queued_ == 0u)
+      << "Can't change the NUMA placement while images are processed.";
+  CHECK_EQ(camera_numa_nodes.size(), pipelines_.size());
+  const size_t num_nodes = common::getNumNumaNodes();
+  for (const size_t node : camera_numa_nodes) {
+    CHECK_LT(node, num_nodes);
+  }
+  bool success = true;
+  if (scheduling_mode_ == SchedulingMode::kPerCameraWorker) {
+    for (size_t camera_index = 0u; camera_index < pipelines_.size(); ++camera_index) {
+      const std::vector<size_t> cpu_ids =
+          common::getNumaNodeCpuIds(camera_numa_nodes[camera_index]);
+      if (cpu_ids.empty() || !camera_thread_pools_[camera_index]->setCpuAffinity(cpu_ids)) {
+        LOG(WARNING) << "Could not pin the worker of camera " << camera_index << " to node "
+                     << camera_numa_nodes[camera_index] << ".";
+        success = false;
       }
-      LOG(WARNING) << "Detected frame drop: removing " << delete_upto_including_index + 1
-                   << " nframes from the queue.";
     }
+  } else {
+    for (const size_t node : camera_numa_nodes) {
+      CHECK_EQ(node, camera_numa_nodes.front())
+          << "The cameras of the shared pool must be on the same node.";
+    }
+    const std::vector<size_t> cpu_ids = common::getNumaNodeCpuIds(camera_numa_nodes.front());
+    if (cpu_ids.empty() || !thread_pool_->setCpuAffinity(cpu_ids)) {
+      LOG(WARNING) << "Could not pin the shared pool to node " << camera_numa_nodes.front()
+                   << ".";
+      success = false;
+    }
+  }
+  for (size_t camera_index = 0u; camera_index < pipelines_.size(); ++camera_index) {
+    if (!pipelines_[camera_index]->bindMemoryToNumaNode(camera_numa_nodes[camera_index])) {
+      LOG(WARNING) << "The memory of camera " << camera_index << " stays on its current node.";
+    }
+  }
+  camera_numa_nodes_ = camera_numa_nodes;
+  return success;
+}
 
-    // Move all completed nframes from the processed_ queue to the completed_ queue chronologically.
-    auto it_processing = processing_.begin();
-    while (it_processing != processing_.end()) {
-      // Check if all images have been received.
-      if (it_processing->second->areAllFramesSet()) {
-        completed_.insert(*it_processing);
-        it_processing = processing_.erase(it_processing);
-        condition_not_empty_.notify_all();
-      } else {
-        // As we are iterating over the map in chronological order we have to abort once an nframe
-        // is not yet finished processing to keep chronological ordering in the destination queue.
-        break;
+std::vector<size_t> VisualNPipeline::distributeCamerasOverNumaNodes(
+    size_t num_cameras, size_t num_nodes) {
+  CHECK_GT(num_nodes, 0u);
+  std::vector<size_t> camera_numa_nodes(num_cameras);
+  for (size_t camera_index = 0u; camera_index < num_cameras; ++camera_index) {
+    camera_numa_nodes[camera_index] = camera_index * num_nodes / num_cameras;
+  }
+  return camera_numa_nodes;
+}
+
+std::vector<size_t> VisualNPipeline::getWorkerCpuIds(size_t camera_index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK_LT(camera_index, pipelines_.size());
+  if (scheduling_mode_ == SchedulingMode::kPerCameraWorker) {
+    return camera_thread_pools_[camera_index]->getCpuAffinity();
+  }
+  return thread_pool_->getCpuAffinity();
+}
+
+void VisualNPipeline::setIntraRigMatching(const IntraRigMatchingOptions& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK(processing_.empty() && num_images_queued_ == 0u)
+      << "Can't change the intra-rig matching while images are processed.";
+  const size_t num_cameras = output_camera_system_->getNumCameras();
+  intra_rig_camera_pairs_ = options.camera_pairs;
+  intra_rig_matchers_.clear();
+  camera_intra_rig_pair_indices_.clear();
+  if (intra_rig_camera_pairs_.empty()) {
+    return;
+  }
+  camera_intra_rig_pair_indices_.resize(num_cameras);
+  for (size_t pair_idx = 0u; pair_idx < intra_rig_camera_pairs_.size(); ++pair_idx) {
+    const size_t apple_camera_idx = intra_rig_camera_pairs_[pair_idx].first;
+    const size_t banana_camera_idx = intra_rig_camera_pairs_[pair_idx].second;
+    CHECK_LT(apple_camera_idx, num_cameras);
+    CHECK_LT(banana_camera_idx, num_cameras);
+    CHECK_NE(apple_camera_idx, banana_camera_idx);
+    const Transformation T_A_B = output_camera_system_->get_T_C_B(apple_camera_idx) *
+        output_camera_system_->get_T_C_B(banana_camera_idx).inverse();
+    intra_rig_matchers_.emplace_back(new EpipolarBandMatcher(T_A_B, options.matcher_options));
+    camera_intra_rig_pair_indices_[apple_camera_idx].push_back(pair_idx);
+    camera_intra_rig_pair_indices_[banana_camera_idx].push_back(pair_idx);
+  }
+}
+
+void VisualNPipeline::setDetectionMask(size_t camera_index, const cv::Mat& mask) {
+  CHECK_LT(camera_index, pipelines_.size());
+  pipelines_[camera_index]->setDetectionMask(mask);
+}
+
+std::shared_ptr<VisualNPipeline::IntraRigMatchingState>
+VisualNPipeline::createIntraRigMatchingState(const std::shared_ptr<VisualNFrame>& nframe) const {
+  if (intra_rig_matchers_.empty()) {
+    return std::shared_ptr<IntraRigMatchingState>();
+  }
+  return std::make_shared<IntraRigMatchingState>(
+      nframe, pipelines_.size(), intra_rig_matchers_.size());
+}
+
+void VisualNPipeline::matchIntraRigPairs(
+    size_t camera_index, const std::shared_ptr<const VisualFrame>& frame,
+    IntraRigMatchingState* state) const {
+  CHECK_NOTNULL(state);
+  CHECK(frame);
+  CHECK_LT(camera_index, camera_intra_rig_pair_indices_.size());
+  const std::vector<size_t>& pair_indices = camera_intra_rig_pair_indices_[camera_index];
+  if (pair_indices.empty()) {
+    return;
+  }
+  if (state->is_camera_counted[camera_index].exchange(true)) {
+    // Counting the camera again would match its pairs before the other frame is set.
+    LOG(WARNING) << "The intra-rig pairs of camera " << camera_index << " are already counted, "
+                 << "the repeated frame is not matched.";
+    return;
+  }
+  static const size_t kTimerHandle =
+      timing::Timing::GetHandle("VisualNPipeline::matchIntraRigPairs");
+  timing::Timer timer(kTimerHandle);
+  const bool can_be_matched = frame->hasKeypointMeasurements() && frame->hasDescriptors();
+  if (can_be_matched) {
+    // The bearing vectors are cached in the frame, computing them here spreads the
+    // back-projection over the workers of both frames of a pair.
+    frame->getNormalizedBearingVectors();
+  }
+  state->frames[camera_index] = frame;
+
+  for (const size_t pair_idx : pair_indices) {
+    // The counter synchronizes the frames, the worker of the second frame sees both.
+    if (state->num_pair_frames_set[pair_idx].fetch_add(1u) != 1u) {
+      continue;
+    }
+    const VisualFrame& apple_frame =
+        *CHECK_NOTNULL(state->frames[intra_rig_camera_pairs_[pair_idx].first].get());
+    const VisualFrame& banana_frame =
+        *CHECK_NOTNULL(state->frames[intra_rig_camera_pairs_[pair_idx].second].get());
+    if (apple_frame.hasKeypointMeasurements() && apple_frame.hasDescriptors() &&
+        banana_frame.hasKeypointMeasurements() && banana_frame.hasDescriptors()) {
+      intra_rig_matchers_[pair_idx]->match(apple_frame, banana_frame,
+                                           &state->pair_matches[pair_idx]);
+    }
+    if (state->num_pairs_pending.fetch_sub(1u) != 1u) {
+      continue;
+    }
+
+    // All pairs are matched, store them in the nframe.
+    size_t num_matches = 0u;
+    for (const FrameToFrameMatchesWithScore& matches : state->pair_matches) {
+      num_matches += matches.size();
+    }
+    Eigen::Matrix4Xi intra_rig_matches(4, static_cast<int>(num_matches));
+    int match_idx = 0;
+    for (size_t matched_pair_idx = 0u; matched_pair_idx < state->pair_matches.size();
+         ++matched_pair_idx) {
+      const std::pair<size_t, size_t>& camera_pair = intra_rig_camera_pairs_[matched_pair_idx];
+      for (const FrameToFrameMatchWithScore& match : state->pair_matches[matched_pair_idx]) {
+        intra_rig_matches.col(match_idx++) << static_cast<int>(camera_pair.first),
+            match.getKeypointIndexAppleFrame(), static_cast<int>(camera_pair.second),
+            match.getKeypointIndexBananaFrame();
       }
     }
+    state->nframe->setIntraRigMatches(intra_rig_matches);
+    state->is_complete.store(true, std::memory_order_release);
+  }
+}
+
+void VisualNPipeline::setImageDecoder(size_t camera_index, const ImageDecoder::Ptr& decoder) {
+  CHECK_LT(camera_index, image_decoders_.size());
+  CHECK(decoder);
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK(processing_.empty() && num_images_queued_ == 0u)
+      << "Can't change the image decoder while images are processed.";
+  image_decoders_[camera_index] = decoder;
+}
+
+void VisualNPipeline::enableWorkerScaling(const WorkerScalingPolicy::Options& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK(processing_.empty() && num_images_queued_ == 0u)
+      << "Can't change the worker scaling while images are processed.";
+  CHECK(scheduling_mode_ == SchedulingMode::kSharedPool)
+      << "The worker scaling is only supported for the shared pool.";
+  std::lock_guard<std::mutex> scaling_lock(worker_scaling_mutex_);
+  worker_scaling_policy_.reset(new WorkerScalingPolicy(options, thread_pool_->numThreads()));
+  thread_pool_->setNumActiveThreads(worker_scaling_policy_->getNumWorkers());
+  is_worker_scaling_enabled_ = true;
+}
+
+void VisualNPipeline::disableWorkerScaling() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CHECK(processing_.empty() && num_images_queued_ == 0u)
+      << "Can't change the worker scaling while images are processed.";
+  std::lock_guard<std::mutex> scaling_lock(worker_scaling_mutex_);
+  is_worker_scaling_enabled_ = false;
+  worker_scaling_policy_.reset();
+  thread_pool_->setNumActiveThreads(thread_pool_->numThreads());
+}
+
+size_t VisualNPipeline::getNumActiveWorkers() const {
+  return thread_pool_->numActiveThreads();
+}
+
+void VisualNPipeline::addWorkerScalingSample(int64_t enqueue_time_nanoseconds) {
+  if (!is_worker_scaling_enabled_ || enqueue_time_nanoseconds < 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(worker_scaling_mutex_);
+  if (!worker_scaling_policy_) {
+    return;
+  }
+  // Read with the lock held, such that the sample times don't decrease.
+  const int64_t time_nanoseconds = common::TraceRecorder::now();
+  // The tasks which were not started yet, this one is already running.
+  const size_t num_waiting_tasks = thread_pool_->numQueuedTasks();
+  if (worker_scaling_policy_->addSample(
+          time_nanoseconds, time_nanoseconds - enqueue_time_nanoseconds, num_waiting_tasks)) {
+    VLOG(2) << "Scaling the pipeline workers from " << thread_pool_->numActiveThreads()
+            << " to " << worker_scaling_policy_->getNumWorkers() << ".";
+    thread_pool_->setNumActiveThreads(worker_scaling_policy_->getNumWorkers());
   }
 }
 
 void VisualNPipeline::waitForAllWorkToComplete() const {
   thread_pool_->waitForEmptyQueue();
+  for (const std::shared_ptr<ThreadPool>& camera_thread_pool : camera_thread_pools_) {
+    camera_thread_pool->waitForEmptyQueue();
+  }
 }
 
 VisualNPipeline::Ptr VisualNPipeline::createTestVisualNPipeline(
@@ -1,13 +1,28 @@
 #include <aslam/pipeline/visual-pipeline-brisk.h>
 
+#include <algorithm>
+#include <cmath>
+
+#include <aslam/common/trace-recorder.h>
 #include <aslam/frames/visual-frame.h>
+#include <aslam/pipeline/cuda-image-cache.h>
 #include <aslam/pipeline/undistorter.h>
 #include <brisk/brisk.h>
 #include <glog/logging.h>
+#include <opencv2/features2d/features2d.hpp>
+#ifdef ASLAM_CV_WITH_CUDA
+#include <opencv2/cudafeatures2d.hpp>
+#endif
 
 namespace aslam {
 
-BriskVisualPipeline::BriskVisualPipeline() {
+constexpr double BriskVisualPipeline::kDetectionOversamplingFactor;
+constexpr int BriskVisualPipeline::kCudaMaxNumDetections;
+
+BriskVisualPipeline::BriskVisualPipeline()
+    : keypoint_budget_(0u), budget_grid_cell_size_pixels_(0.0), min_detection_threshold_(0.0),
+      max_detection_threshold_(0.0), adaptive_detection_threshold_(0.0),
+      use_cuda_detection_(false), cuda_fast_threshold_(0) {
   // Just for serialization. Not meant to be used.
 }
 
@@ -43,28 +58,158 @@ void BriskVisualPipeline::initializeBrisk(size_t octaves,
   max_number_of_keypoints_ = max_number_of_keypoints;
   rotation_invariant_ = rotation_invariant;
   scale_invariant_ = scale_invariant;
+  keypoint_budget_ = 0u;
+  budget_grid_cell_size_pixels_ = 0.0;
+  min_detection_threshold_ = 0.0;
+  max_detection_threshold_ = 0.0;
+  use_cuda_detection_ = false;
+  cuda_fast_threshold_ = 0;
+  cuda_device_images_.reset();
 #if __arm__
   // \TODO(slynen): Currently no Harris on ARM. Adapt if we port it to ARM.
   static const int kAstThreshold = 70;
-  detector_.reset(new brisk::BriskFeatureDetector(kAstThreshold));
+  adaptive_detection_threshold_ = kAstThreshold;
 #else
-  detector_.reset(
-      new brisk::ScaleSpaceFeatureDetector<brisk::HarrisScoreCalculator>(
-          octaves_, uniformity_radius_, absolute_threshold_, max_number_of_keypoints_)
-  );
+  adaptive_detection_threshold_ = absolute_threshold_;
 #endif
+  detector_ = createDetector(adaptive_detection_threshold_);
   extractor_.reset(new brisk::BriskDescriptorExtractor(rotation_invariant_,
                                                        scale_invariant_));
 }
 
+std::shared_ptr<cv::Feature2D> BriskVisualPipeline::createDetector(double threshold) const {
+#if __arm__
+  return std::make_shared<brisk::BriskFeatureDetector>(static_cast<int>(threshold));
+#else
+  return std::make_shared<brisk::ScaleSpaceFeatureDetector<brisk::HarrisScoreCalculator>>(
+      octaves_, uniformity_radius_, threshold, max_number_of_keypoints_);
+#endif
+}
+
+void BriskVisualPipeline::setKeypointBudget(
+    size_t keypoint_budget, double grid_cell_size_pixels, double min_detection_threshold,
+    double max_detection_threshold) {
+  CHECK_GT(grid_cell_size_pixels, 0.0);
+  CHECK_GT(min_detection_threshold, 0.0);
+  CHECK_LE(min_detection_threshold, max_detection_threshold);
+  keypoint_budget_ = keypoint_budget;
+  budget_grid_cell_size_pixels_ = grid_cell_size_pixels;
+  min_detection_threshold_ = min_detection_threshold;
+  max_detection_threshold_ = max_detection_threshold;
+
+  std::lock_guard<std::mutex> lock(adaptive_threshold_mutex_);
+  adaptive_detection_threshold_ = std::min(
+      std::max(adaptive_detection_threshold_, min_detection_threshold_), max_detection_threshold_);
+}
+
+double BriskVisualPipeline::getAdaptiveDetectionThreshold() const {
+  std::lock_guard<std::mutex> lock(adaptive_threshold_mutex_);
+  return adaptive_detection_threshold_;
+}
+
+void BriskVisualPipeline::enableCudaDetection(
+    int fast_threshold, const std::shared_ptr<CudaImageCache>& device_images) {
+  CHECK_GT(fast_threshold, 0);
+  use_cuda_detection_ = isCudaBackendAvailable();
+  LOG_IF(WARNING, !use_cuda_detection_)
+      << "The CUDA backend is not available, the keypoints are detected on the CPU.";
+  cuda_fast_threshold_ = fast_threshold;
+  cuda_device_images_ = device_images;
+}
+
+void BriskVisualPipeline::detectKeypointsCuda(
+    const cv::Mat& image, const FrameId& frame_id, std::vector<cv::KeyPoint>* keypoints) const {
+  CHECK_NOTNULL(keypoints);
+#ifdef ASLAM_CV_WITH_CUDA
+  // The stream and the detector are created per call as frames may be processed concurrently.
+  cv::cuda::Stream stream;
+  cv::cuda::GpuMat device_image;
+  // A CudaMappedUndistorter with the same cache already left the undistorted image on the
+  // device.
+  const bool is_device_image_cached = cuda_device_images_ && frame_id.isValid() &&
+      cuda_device_images_->find(frame_id, &device_image) && device_image.size() == image.size();
+  if (!is_device_image_cached) {
+    device_image.upload(image, stream);
+  }
+  cv::Ptr<cv::cuda::FastFeatureDetector> detector = cv::cuda::FastFeatureDetector::create(
+      cuda_fast_threshold_, true /* nonmax suppression */, cv::FastFeatureDetector::TYPE_9_16,
+      kCudaMaxNumDetections);
+  cv::cuda::GpuMat device_keypoints;
+  detector->detectAsync(device_image, device_keypoints, cv::noArray(), stream);
+  stream.waitForCompletion();
+  detector->convert(device_keypoints, *keypoints);
+  if (max_number_of_keypoints_ > 0u && keypoints->size() > max_number_of_keypoints_) {
+    cv::KeyPointsFilter::retainBest(*keypoints, static_cast<int>(max_number_of_keypoints_));
+  }
+  if (cuda_device_images_ && frame_id.isValid() && !is_device_image_cached) {
+    cuda_device_images_->insert(frame_id, device_image);
+  }
+#else
+  static_cast<void>(image);
+  static_cast<void>(frame_id);
+  LOG(FATAL) << "Built without ASLAM_CV_WITH_CUDA.";
+#endif
+}
+
+void BriskVisualPipeline::updateAdaptiveDetectionThreshold(
+    size_t num_detected_keypoints, double detection_area_ratio) const {
+  CHECK_GT(keypoint_budget_, 0u);
+  if (detection_area_ratio <= 0.0) {
+    // Nothing was searched, the detections say nothing about the threshold.
+    return;
+  }
+  // Harris and AST scores grow roughly exponentially with the number of rejected corners, so
+  // adapt the threshold multiplicatively and limit the step to keep the count from oscillating.
+  const double kMaxStepFactor = 1.25;
+  const double target_num_keypoints = kDetectionOversamplingFactor * keypoint_budget_;
+  // The target is scaled to the searched part of the image if a detection mask is set.
+  const double ratio = std::max(static_cast<double>(num_detected_keypoints), 1.0) /
+      (target_num_keypoints * detection_area_ratio);
+  const double step_factor =
+      std::min(std::max(std::sqrt(ratio), 1.0 / kMaxStepFactor), kMaxStepFactor);
+
+  std::lock_guard<std::mutex> lock(adaptive_threshold_mutex_);
+  adaptive_detection_threshold_ = std::min(
+      std::max(adaptive_detection_threshold_ * step_factor, min_detection_threshold_),
+      max_detection_threshold_);
+}
+
 void BriskVisualPipeline::processFrameImpl(const cv::Mat& image, VisualFrame* frame) const {
   CHECK_NOTNULL(frame);
   // Now we use the image from the frame. It might be undistorted.
   std::vector<cv::KeyPoint> keypoints;
-  detector_->detect(image, keypoints);
+  const cv::Mat detection_mask = getDetectionMask();
+  {
+    common::ScopedTraceEvent trace_event(
+        common::TraceStage::kDetect, frame->getTimestampNanoseconds());
+    if (use_cuda_detection_) {
+      detectKeypointsCuda(image, frame->getId(), &keypoints);
+    } else if (keypoint_budget_ > 0u) {
+      // The detectors keep no state between frames, so a detector with the adapted threshold is
+      // cheap to create and keeps concurrently processed frames independent.
+      createDetector(getAdaptiveDetectionThreshold())->detect(image, keypoints, detection_mask);
+    } else {
+      detector_->detect(image, keypoints, detection_mask);
+    }
+    if (!detection_mask.empty()) {
+      // Not all detectors apply the mask, it is at least applied before the description.
+      cv::KeyPointsFilter::runByPixelsMask(keypoints, detection_mask);
+    }
+    if (keypoint_budget_ > 0u) {
+      if (!use_cuda_detection_) {
+        updateAdaptiveDetectionThreshold(keypoints.size(),
+                                         getDetectionAreaRatio(detection_mask));
+      }
+      selectKeypointsInGrid(image.size(), budget_grid_cell_size_pixels_, keypoint_budget_,
+                            &keypoints);
+    }
+    capKeypointsToDeadline(&keypoints);
+  }
 
   cv::Mat descriptors;
   if(!keypoints.empty()) {
+    common::ScopedTraceEvent trace_event(
+        common::TraceStage::kDescribe, frame->getTimestampNanoseconds());
     extractor_->compute(image, keypoints, descriptors);
   } else {
     descriptors = cv::Mat(0, 0, CV_8UC1);
@@ -0,0 +1,298 @@
+#include <aslam/pipeline/visual-pipeline-fast-brief.h>
+
+#include <cmath>
+#include <random>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif  // __ARM_NEON__
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+
+#include <aslam/common/trace-recorder.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/pipeline/undistorter.h>
+#include <glog/logging.h>
+#include <opencv2/features2d/features2d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace aslam {
+namespace {
+// All pattern points and the orientation patch lie within this radius around the keypoint.
+const int kPatchRadius = 15;
+// The patches of the described keypoints lie within the image.
+const int kBorderPixels = kPatchRadius + 1;
+const int kNumComparisons = 8 * FastBriefVisualPipeline::kDescriptorSizeBytes;
+// The comparisons are evaluated in groups of one 128 bit word of intensities.
+const int kNumComparisonsPerGroup = 16;
+// The pattern is drawn once with a fixed seed, the descriptors must not change between runs.
+const unsigned int kPatternSeed = 4711u;
+
+// The image is smoothed into a buffer that is reused for all frames of a thread.
+thread_local cv::Mat thread_smoothed_image;
+
+// Set the bit of the descriptor for every comparison of the group in which the first intensity
+// is smaller than the second intensity.
+inline void compareGroup(const unsigned char* first, const unsigned char* second,
+                         unsigned char* descriptor_bytes) {
+#if defined(__ARM_NEON__)
+  static const uint8_t kBitWeights[kNumComparisonsPerGroup] = {
+      1u, 2u, 4u, 8u, 16u, 32u, 64u, 128u, 1u, 2u, 4u, 8u, 16u, 32u, 64u, 128u};
+  const uint8x16_t bits =
+      vandq_u8(vcltq_u8(vld1q_u8(first), vld1q_u8(second)), vld1q_u8(kBitWeights));
+  // Sum up the bits of each half into one byte.
+  uint8x8_t sums = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+  sums = vpadd_u8(sums, sums);
+  sums = vpadd_u8(sums, sums);
+  descriptor_bytes[0] = vget_lane_u8(sums, 0);
+  descriptor_bytes[1] = vget_lane_u8(sums, 1);
+#elif defined(__SSE2__)
+  // SSE2 only compares signed bytes, flipping the sign bit maps the unsigned order onto it.
+  const __m128i kSignBit = _mm_set1_epi8(static_cast<char>(0x80));
+  const __m128i first_intensities = _mm_xor_si128(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(first)), kSignBit);
+  const __m128i second_intensities = _mm_xor_si128(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(second)), kSignBit);
+  const int bits = _mm_movemask_epi8(_mm_cmplt_epi8(first_intensities, second_intensities));
+  descriptor_bytes[0] = static_cast<unsigned char>(bits & 0xff);
+  descriptor_bytes[1] = static_cast<unsigned char>(bits >> 8);
+#else
+  descriptor_bytes[0] = 0u;
+  descriptor_bytes[1] = 0u;
+  for (int i = 0; i < kNumComparisonsPerGroup; ++i) {
+    if (first[i] < second[i]) {
+      descriptor_bytes[i / 8] |= static_cast<unsigned char>(1u << (i % 8));
+    }
+  }
+#endif
+}
+
+// A pattern coordinate roughly Gaussian distributed around the keypoint, as the sum of three
+// uniformly distributed integers. std::normal_distribution differs between standard libraries.
+int drawPatternCoordinate(std::mt19937* generator) {
+  CHECK_NOTNULL(generator);
+  const int kMaxValue = 6;
+  int coordinate = 0;
+  for (int i = 0; i < 3; ++i) {
+    coordinate += static_cast<int>((*generator)() % (2 * kMaxValue + 1)) - kMaxValue;
+  }
+  return coordinate;
+}
+}  // namespace
+
+constexpr int FastBriefVisualPipeline::kDescriptorSizeBytes;
+constexpr int FastBriefVisualPipeline::kNumOrientationBins;
+
+FastBriefVisualPipeline::FastBriefVisualPipeline() {
+  // Just for serialization. Not meant to be used.
+}
+
+FastBriefVisualPipeline::FastBriefVisualPipeline(const Camera::ConstPtr& camera, bool copy_images,
+                                                 const Options& options)
+    : VisualPipeline(camera, camera, copy_images) {
+  initialize(options);
+}
+
+FastBriefVisualPipeline::FastBriefVisualPipeline(std::unique_ptr<Undistorter>& preprocessing,
+                                                 bool copy_images, const Options& options)
+    : VisualPipeline(preprocessing, copy_images) {
+  initialize(options);
+}
+
+FastBriefVisualPipeline::~FastBriefVisualPipeline() { }
+
+void FastBriefVisualPipeline::initialize(const Options& options) {
+  CHECK_GT(options.fast_threshold, 0);
+  CHECK_GT(options.grid_cell_size_pixels, 0.0);
+  CHECK_GE(options.smoothing_kernel_size, 0);
+  CHECK(options.smoothing_kernel_size <= 1 || options.smoothing_kernel_size % 2 == 1)
+      << "The smoothing kernel size must be odd.";
+  options_ = options;
+
+  // The rows of the circle with the patch radius; x^2 + y^2 <= r^2 is symmetric under rotations
+  // by multiples of 90 degrees.
+  orientation_patch_half_widths_.resize(kPatchRadius + 1);
+  for (int y = 0; y <= kPatchRadius; ++y) {
+    orientation_patch_half_widths_[y] =
+        static_cast<int>(std::floor(std::sqrt(kPatchRadius * kPatchRadius - y * y)));
+  }
+
+  std::vector<PatternPoint> pattern;
+  pattern.reserve(2 * kNumComparisons);
+  std::mt19937 generator(kPatternSeed);
+  while (pattern.size() < 2u * kNumComparisons) {
+    PatternPoint points[2];
+    for (PatternPoint& point : points) {
+      int x, y;
+      do {
+        x = drawPatternCoordinate(&generator);
+        y = drawPatternCoordinate(&generator);
+      } while (x * x + y * y > kPatchRadius * kPatchRadius);
+      point.x = static_cast<int8_t>(x);
+      point.y = static_cast<int8_t>(y);
+    }
+    if (points[0].x != points[1].x || points[0].y != points[1].y) {
+      pattern.push_back(points[0]);
+      pattern.push_back(points[1]);
+    }
+  }
+
+  // Bin b holds the pattern rotated by b steps, in the orientation convention of
+  // computeOrientation().
+  const int num_bins = options_.rotation_invariant ? kNumOrientationBins : 1;
+  rotated_patterns_.resize(num_bins * pattern.size());
+  for (int bin = 0; bin < num_bins; ++bin) {
+    const double angle = 2.0 * M_PI * bin / kNumOrientationBins;
+    const double cos_angle = std::cos(angle);
+    const double sin_angle = std::sin(angle);
+    for (size_t i = 0u; i < pattern.size(); ++i) {
+      PatternPoint& rotated_point = rotated_patterns_[bin * pattern.size() + i];
+      rotated_point.x = static_cast<int8_t>(
+          std::lround(cos_angle * pattern[i].x - sin_angle * pattern[i].y));
+      rotated_point.y = static_cast<int8_t>(
+          std::lround(sin_angle * pattern[i].x + cos_angle * pattern[i].y));
+    }
+  }
+}
+
+float FastBriefVisualPipeline::computeOrientation(
+    const unsigned char* center, int row_stride) const {
+  CHECK_NOTNULL(center);
+  int m_10 = 0;
+  int m_01 = 0;
+  for (int x = -kPatchRadius; x <= kPatchRadius; ++x) {
+    m_10 += x * center[x];
+  }
+  for (int y = 1; y <= kPatchRadius; ++y) {
+    const unsigned char* row_below = center + y * row_stride;
+    const unsigned char* row_above = center - y * row_stride;
+    const int half_width = orientation_patch_half_widths_[y];
+    int sum_differences = 0;
+    for (int x = -half_width; x <= half_width; ++x) {
+      const int intensity_below = row_below[x];
+      const int intensity_above = row_above[x];
+      sum_differences += intensity_below - intensity_above;
+      m_10 += x * (intensity_below + intensity_above);
+    }
+    m_01 += y * sum_differences;
+  }
+  float angle_degrees = static_cast<float>(std::atan2(m_01, m_10) * 180.0 / M_PI);
+  if (angle_degrees < 0.0f) {
+    angle_degrees += 360.0f;
+  }
+  return angle_degrees >= 360.0f ? 0.0f : angle_degrees;
+}
+
+void FastBriefVisualPipeline::describeKeypoints(
+    const cv::Mat& smoothed_image, std::vector<cv::KeyPoint>* keypoints,
+    VisualFrame::DescriptorsT* descriptors) const {
+  CHECK_NOTNULL(keypoints);
+  CHECK_NOTNULL(descriptors);
+  CHECK_EQ(smoothed_image.type(), CV_8UC1);
+  const int row_stride = static_cast<int>(smoothed_image.step1());
+  // The offsets of the pattern points in memory depend on the row stride of the image.
+  std::vector<int> offsets(rotated_patterns_.size());
+  for (size_t i = 0u; i < rotated_patterns_.size(); ++i) {
+    offsets[i] = rotated_patterns_[i].y * row_stride + rotated_patterns_[i].x;
+  }
+
+  const float kDegreesPerBin = 360.0f / kNumOrientationBins;
+  descriptors->resize(kDescriptorSizeBytes, keypoints->size());
+  unsigned char first[kNumComparisonsPerGroup];
+  unsigned char second[kNumComparisonsPerGroup];
+  for (size_t keypoint_idx = 0u; keypoint_idx < keypoints->size(); ++keypoint_idx) {
+    cv::KeyPoint& keypoint = (*keypoints)[keypoint_idx];
+    const int x = cvRound(keypoint.pt.x);
+    const int y = cvRound(keypoint.pt.y);
+    CHECK(x >= kBorderPixels && y >= kBorderPixels &&
+          x < smoothed_image.cols - kBorderPixels && y < smoothed_image.rows - kBorderPixels);
+    const unsigned char* center = smoothed_image.ptr<unsigned char>(y) + x;
+
+    int bin = 0;
+    if (options_.rotation_invariant) {
+      keypoint.angle = computeOrientation(center, row_stride);
+      bin = static_cast<int>(std::floor(keypoint.angle / kDegreesPerBin + 0.5f)) %
+          kNumOrientationBins;
+    }
+    const int* pair_offsets = offsets.data() + 2 * kNumComparisons * bin;
+    unsigned char* descriptor = descriptors->data() + kDescriptorSizeBytes * keypoint_idx;
+    for (int group = 0; group < kNumComparisons / kNumComparisonsPerGroup; ++group) {
+      // Gathering the intensities is the scalar part, the comparisons are vectorized.
+      for (int i = 0; i < kNumComparisonsPerGroup; ++i) {
+        first[i] = center[pair_offsets[0]];
+        second[i] = center[pair_offsets[1]];
+        pair_offsets += 2;
+      }
+      compareGroup(first, second, descriptor + 2 * group);
+    }
+  }
+}
+
+void FastBriefVisualPipeline::processFrameImpl(const cv::Mat& image, VisualFrame* frame) const {
+  CHECK_NOTNULL(frame);
+  CHECK_EQ(image.type(), CV_8UC1);
+  // Now we use the image from the frame. It might be undistorted.
+  std::vector<cv::KeyPoint> keypoints;
+  {
+    common::ScopedTraceEvent trace_event(
+        common::TraceStage::kDetect, frame->getTimestampNanoseconds());
+    cv::FAST(image, keypoints, options_.fast_threshold, true /* nonmax suppression */);
+    // The rotated patterns of the described keypoints must lie within the image.
+    cv::KeyPointsFilter::runByImageBorder(keypoints, image.size(), kBorderPixels);
+    const cv::Mat detection_mask = getDetectionMask();
+    if (!detection_mask.empty()) {
+      cv::KeyPointsFilter::runByPixelsMask(keypoints, detection_mask);
+    }
+    if (options_.max_num_keypoints > 0u) {
+      selectKeypointsInGrid(image.size(), options_.grid_cell_size_pixels,
+                            options_.max_num_keypoints, &keypoints);
+    }
+    capKeypointsToDeadline(&keypoints);
+  }
+
+  VisualFrame::DescriptorsT descriptors(kDescriptorSizeBytes, 0);
+  if (!keypoints.empty()) {
+    common::ScopedTraceEvent trace_event(
+        common::TraceStage::kDescribe, frame->getTimestampNanoseconds());
+    const cv::Mat* smoothed_image = &image;
+    if (options_.smoothing_kernel_size > 1) {
+      const cv::Size kernel_size(options_.smoothing_kernel_size, options_.smoothing_kernel_size);
+      cv::GaussianBlur(image, thread_smoothed_image, kernel_size, options_.smoothing_sigma,
+                       options_.smoothing_sigma, cv::BORDER_REFLECT_101);
+      smoothed_image = &thread_smoothed_image;
+    }
+    describeKeypoints(*smoothed_image, &keypoints, &descriptors);
+  } else {
+    LOG(WARNING) << "Frame produced no keypoints:\n" << *frame;
+  }
+  // The values are set even if there are no keypoints as downstream code may rely on the
+  // keypoints being set.
+  frame->swapDescriptors(&descriptors);
+
+  // The keypoint uncertainty is set to a constant value.
+  const double kKeypointUncertaintyPixelSigma = 0.8;
+
+  Eigen::Matrix2Xd ikeypoints(2, keypoints.size());
+  Eigen::VectorXd scales(keypoints.size());
+  Eigen::VectorXd orientations(keypoints.size());
+  Eigen::VectorXd scores(keypoints.size());
+  Eigen::VectorXd uncertainties(keypoints.size());
+  for (size_t i = 0u; i < keypoints.size(); ++i) {
+    const cv::KeyPoint& kp = keypoints[i];
+    ikeypoints(0, i) = kp.pt.x;
+    ikeypoints(1, i) = kp.pt.y;
+    // The descriptor covers the patch, the keypoints have a single scale.
+    scales[i] = 2 * kPatchRadius + 1;
+    orientations[i] = kp.angle;
+    scores[i] = kp.response;
+    uncertainties[i] = kKeypointUncertaintyPixelSigma;
+  }
+  frame->swapKeypointMeasurements(&ikeypoints);
+  frame->swapKeypointScores(&scores);
+  frame->swapKeypointOrientations(&orientations);
+  frame->swapKeypointScales(&scales);
+  frame->swapKeypointMeasurementUncertainties(&uncertainties);
+}
+
+}  // namespace aslam
@@ -1,4 +1,11 @@
 #include <aslam/pipeline/visual-pipeline-freak.h>
+
+#include <algorithm>
+#include <functional>
+#include <future>
+
+#include <aslam/common/thread-pool.h>
+#include <aslam/common/trace-recorder.h>
 #include <aslam/frames/visual-frame.h>
 #include <aslam/pipeline/undistorter.h>
 #include <brisk/brisk.h>
@@ -7,8 +14,16 @@
 #include <opencv2/xfeatures2d.hpp>
 
 namespace aslam {
+namespace {
+// The OpenCV factories return cv::Ptr, keep it alive for as long as the shared_ptr lives.
+template <typename Type>
+std::shared_ptr<Type> toSharedPtr(const cv::Ptr<Type>& pointer) {
+  CHECK(!pointer.empty());
+  return std::shared_ptr<Type>(pointer.get(), [pointer](Type* /*raw_pointer*/) {});
+}
+}  // namespace
 
-FreakVisualPipeline::FreakVisualPipeline() {
+FreakVisualPipeline::FreakVisualPipeline() : num_internal_threads_(0u) {
   // Just for serialization. Not meant to be used.
 }
 
@@ -54,24 +69,181 @@ void FreakVisualPipeline::initializeFreak(size_t num_octaves,
   scale_invariant_ = scale_invariant;
   pattern_scale_ = pattern_scale;
 
-  detector_.reset(cv::xfeatures2d::SurfFeatureDetector::create(
-      hessian_threshold_, octaves_, num_octave_layers_).get());
-  extractor_.reset(cv::xfeatures2d::FREAK::create(
-      rotation_invariant_, scale_invariant_, pattern_scale_, octaves_).get());
+  detector_ = createDetector();
+  extractor_ = createExtractor();
+  setNumInternalThreads(0u);
+}
+
+std::shared_ptr<cv::Feature2D> FreakVisualPipeline::createDetector() const {
+  return toSharedPtr<cv::Feature2D>(cv::xfeatures2d::SurfFeatureDetector::create(
+      hessian_threshold_, octaves_, num_octave_layers_));
+}
+
+std::shared_ptr<cv::Feature2D> FreakVisualPipeline::createExtractor() const {
+  return toSharedPtr<cv::Feature2D>(cv::xfeatures2d::FREAK::create(
+      rotation_invariant_, scale_invariant_, pattern_scale_, octaves_));
+}
+
+void FreakVisualPipeline::setNumInternalThreads(size_t num_threads) {
+  std::lock_guard<std::mutex> lock(internal_parallel_mutex_);
+  num_internal_threads_ = num_threads;
+  internal_thread_pool_.reset();
+  task_detectors_.clear();
+  task_extractors_.clear();
+  task_keypoints_.clear();
+  task_descriptors_.clear();
+  if (num_threads <= 1u) {
+    return;
+  }
+  // The calling thread processes the first task.
+  internal_thread_pool_.reset(new ThreadPool(num_threads - 1u));
+  for (size_t i = 0u; i < num_threads; ++i) {
+    task_detectors_.emplace_back(createDetector());
+    task_extractors_.emplace_back(createExtractor());
+  }
+  task_keypoints_.resize(num_threads);
+  task_descriptors_.resize(num_threads);
+}
+
+void FreakVisualPipeline::detectAndDescribeParallel(
+    const cv::Mat& image, const cv::Mat& detection_mask, int64_t timestamp_nanoseconds,
+    std::vector<cv::KeyPoint>* keypoints, cv::Mat* descriptors) const {
+  CHECK_NOTNULL(keypoints)->clear();
+  CHECK_NOTNULL(descriptors);
+  CHECK(internal_thread_pool_);
+  const size_t num_tasks = task_detectors_.size();
+  CHECK_GT(num_tasks, 1u);
+
+  auto run_tasks = [this, num_tasks](const std::function<void(size_t)>& task) {
+    std::vector<std::future<void>> futures;
+    for (size_t task_index = 1u; task_index < num_tasks; ++task_index) {
+      futures.emplace_back(internal_thread_pool_->enqueue(task, task_index));
+    }
+    task(0u);
+    for (std::future<void>& future : futures) {
+      future.get();
+    }
+  };
+
+  {
+    common::ScopedTraceEvent trace_event(common::TraceStage::kDetect, timestamp_nanoseconds);
+    // The tiles overlap by the largest SURF box filter so that the responses next to the tile
+    // borders equal the ones of the full image. Aligning the tile borders to the sampling step
+    // of the coarsest octave keeps the sampled pixels identical as well.
+    const int kSurfFilterSize0 = 9;
+    const int kSurfFilterSizeIncrement = 6;
+    const int coarsest_octave = std::max(static_cast<int>(octaves_) - 1, 0);
+    const int alignment = 1 << coarsest_octave;
+    const int max_filter_size =
+        (kSurfFilterSize0 + kSurfFilterSizeIncrement * (num_octave_layers_ + 1)) <<
+        coarsest_octave;
+    const int margin = (max_filter_size + alignment - 1) / alignment * alignment;
+    const int tile_rows = (image.rows / static_cast<int>(num_tasks) + alignment - 1) /
+        alignment * alignment;
+
+    run_tasks([&](size_t task_index) {
+      std::vector<cv::KeyPoint>& tile_keypoints = task_keypoints_[task_index];
+      tile_keypoints.clear();
+      const int core_begin = std::min(static_cast<int>(task_index) * tile_rows, image.rows);
+      const int core_end = (task_index + 1u == num_tasks) ?
+          image.rows : std::min(core_begin + tile_rows, image.rows);
+      if (core_begin >= core_end) {
+        return;
+      }
+      const int roi_begin = std::max(core_begin - margin, 0);
+      const int roi_end = std::min(core_end + margin, image.rows);
+      task_detectors_[task_index]->detect(
+          image(cv::Range(roi_begin, roi_end), cv::Range::all()), tile_keypoints,
+          detection_mask.empty() ?
+              cv::Mat() : detection_mask(cv::Range(roi_begin, roi_end), cv::Range::all()));
+      // Move to image coordinates and keep the keypoints of the tile core only.
+      size_t num_kept = 0u;
+      for (cv::KeyPoint& keypoint : tile_keypoints) {
+        keypoint.pt.y += roi_begin;
+        if (keypoint.pt.y >= core_begin && keypoint.pt.y < core_end) {
+          tile_keypoints[num_kept++] = keypoint;
+        }
+      }
+      tile_keypoints.resize(num_kept);
+    });
+    for (const std::vector<cv::KeyPoint>& tile_keypoints : task_keypoints_) {
+      keypoints->insert(keypoints->end(), tile_keypoints.begin(), tile_keypoints.end());
+    }
+  }
+
+  if (keypoints->empty()) {
+    *descriptors = cv::Mat(0, 0, CV_8UC1);
+    return;
+  }
+
+  {
+    common::ScopedTraceEvent trace_event(common::TraceStage::kDescribe, timestamp_nanoseconds);
+    const size_t chunk_size = (keypoints->size() + num_tasks - 1u) / num_tasks;
+    run_tasks([&](size_t task_index) {
+      std::vector<cv::KeyPoint>& chunk_keypoints = task_keypoints_[task_index];
+      const size_t chunk_begin = std::min(task_index * chunk_size, keypoints->size());
+      const size_t chunk_end = std::min(chunk_begin + chunk_size, keypoints->size());
+      chunk_keypoints.assign(keypoints->begin() + chunk_begin, keypoints->begin() + chunk_end);
+      if (chunk_keypoints.empty()) {
+        task_descriptors_[task_index].release();
+        return;
+      }
+      task_extractors_[task_index]->compute(
+          image, chunk_keypoints, task_descriptors_[task_index]);
+    });
+
+    // The extractor may have removed keypoints, so gather the surviving ones per chunk.
+    keypoints->clear();
+    std::vector<cv::Mat> chunk_descriptors;
+    for (size_t task_index = 0u; task_index < num_tasks; ++task_index) {
+      if (task_keypoints_[task_index].empty() || task_descriptors_[task_index].empty()) {
+        continue;
+      }
+      CHECK_EQ(static_cast<int>(task_keypoints_[task_index].size()),
+               task_descriptors_[task_index].rows);
+      keypoints->insert(keypoints->end(), task_keypoints_[task_index].begin(),
+                        task_keypoints_[task_index].end());
+      chunk_descriptors.emplace_back(task_descriptors_[task_index]);
+    }
+    if (chunk_descriptors.empty()) {
+      *descriptors = cv::Mat(0, 0, CV_8UC1);
+    } else {
+      cv::vconcat(chunk_descriptors, *descriptors);
+    }
+  }
 }
 
 void FreakVisualPipeline::processFrameImpl(const cv::Mat& image, VisualFrame* frame) const {
   CHECK_NOTNULL(frame);
   // Now we use the image from the frame. It might be undistorted.
   std::vector<cv::KeyPoint> keypoints;
-  detector_->detect(image, keypoints);
-
   cv::Mat descriptors;
-  if(!keypoints.empty()) {
-    extractor_->compute(image, keypoints, descriptors);
+  const cv::Mat detection_mask = getDetectionMask();
+  std::unique_lock<std::mutex> parallel_lock(internal_parallel_mutex_);
+  if (internal_thread_pool_) {
+    detectAndDescribeParallel(image, detection_mask, frame->getTimestampNanoseconds(),
+                              &keypoints, &descriptors);
+    parallel_lock.unlock();
+    if (keypoints.empty()) {
+      LOG(WARNING) << "Frame produced no keypoints:\n" << *frame;
+    }
   } else {
-    descriptors = cv::Mat(0, 0, CV_8UC1);
-    LOG(WARNING) << "Frame produced no keypoints:\n" << *frame;
+    parallel_lock.unlock();
+    {
+      common::ScopedTraceEvent trace_event(
+          common::TraceStage::kDetect, frame->getTimestampNanoseconds());
+      detector_->detect(image, keypoints, detection_mask);
+      capKeypointsToDeadline(&keypoints);
+    }
+
+    if(!keypoints.empty()) {
+      common::ScopedTraceEvent trace_event(
+          common::TraceStage::kDescribe, frame->getTimestampNanoseconds());
+      extractor_->compute(image, keypoints, descriptors);
+    } else {
+      descriptors = cv::Mat(0, 0, CV_8UC1);
+      LOG(WARNING) << "Frame produced no keypoints:\n" << *frame;
+    }
   }
   // Note: It is important that
   //       (a) this happens after the descriptor extractor as the extractor
@@ -0,0 +1,107 @@
+#include <aslam/pipeline/visual-pipeline-kaze.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <aslam/common/trace-recorder.h>
+#include <aslam/detectors/kaze-instance-pool.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/pipeline/undistorter.h>
+#include <glog/logging.h>
+#include <kaze/KAZE.h>
+#include <opencv2/features2d/features2d.hpp>
+
+namespace aslam {
+namespace {
+// KAZE runs on float images in [0, 1]. The buffer of a thread is reused for all its frames.
+thread_local cv::Mat thread_float_image;
+
+size_t getMaxNumPooledKazeInstances() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+}  // namespace
+
+KazeVisualPipeline::KazeVisualPipeline() {
+  // Just for serialization. Not meant to be used.
+}
+
+KazeVisualPipeline::KazeVisualPipeline(const Camera::ConstPtr& camera, bool copy_images,
+                                       const KAZEOptions& options)
+: VisualPipeline(camera, camera, copy_images),
+  instance_pool_(new KazeInstancePool(options, getMaxNumPooledKazeInstances())) {}
+
+KazeVisualPipeline::KazeVisualPipeline(std::unique_ptr<Undistorter>& preprocessing,
+                                       bool copy_images, const KAZEOptions& options)
+: VisualPipeline(preprocessing, copy_images),
+  instance_pool_(new KazeInstancePool(options, getMaxNumPooledKazeInstances())) {}
+
+KazeVisualPipeline::~KazeVisualPipeline() { }
+
+size_t KazeVisualPipeline::getNumPooledKazeInstances() const {
+  CHECK(instance_pool_);
+  return instance_pool_->getNumPooledInstances();
+}
+
+void KazeVisualPipeline::processFrameImpl(const cv::Mat& image, VisualFrame* frame) const {
+  CHECK_NOTNULL(frame);
+  CHECK(instance_pool_);
+  CHECK_EQ(image.type(), CV_8UC1);
+  // Now we use the image from the frame. It might be undistorted.
+  const std::shared_ptr<libKAZE::KAZE> kaze = instance_pool_->acquire(image.cols, image.rows);
+  CHECK(kaze);
+
+  std::vector<cv::KeyPoint> keypoints;
+  {
+    common::ScopedTraceEvent trace_event(
+        common::TraceStage::kDetect, frame->getTimestampNanoseconds());
+    image.convertTo(thread_float_image, CV_32F, 1.0 / 255.0, 0);
+    CHECK_EQ(kaze->Create_Nonlinear_Scale_Space(thread_float_image), 0);
+    kaze->Feature_Detection(keypoints);
+    // KAZE detects in the whole scale space, the mask only saves the description.
+    const cv::Mat detection_mask = getDetectionMask();
+    if (!detection_mask.empty()) {
+      cv::KeyPointsFilter::runByPixelsMask(keypoints, detection_mask);
+    }
+  }
+
+  // Every column is a descriptor, KAZE writes into the matrix of the frame without an
+  // intermediate cv::Mat.
+  VisualFrame::FloatDescriptorsT descriptors(kaze->Get_Descriptor_Size(), keypoints.size());
+  if (!keypoints.empty()) {
+    common::ScopedTraceEvent trace_event(
+        common::TraceStage::kDescribe, frame->getTimestampNanoseconds());
+    kaze->Compute_Descriptors(keypoints, descriptors.data());
+  } else {
+    LOG(WARNING) << "Frame produced no keypoints:\n" << *frame;
+  }
+  // Note: The values are set even if there are no keypoints as downstream
+  //       code may rely on the keypoints being set.
+  frame->swapFloatDescriptors(&descriptors);
+
+  // The keypoint uncertainty is set to a constant value.
+  const double kKeypointUncertaintyPixelSigma = 0.8;
+
+  Eigen::Matrix2Xd ikeypoints(2, keypoints.size());
+  Eigen::VectorXd scales(keypoints.size());
+  Eigen::VectorXd orientations(keypoints.size());
+  Eigen::VectorXd scores(keypoints.size());
+  Eigen::VectorXd uncertainties(keypoints.size());
+
+  for(size_t i = 0; i < keypoints.size(); ++i) {
+    const cv::KeyPoint& kp = keypoints[i];
+    ikeypoints(0,i)  = kp.pt.x;
+    ikeypoints(1,i)  = kp.pt.y;
+    scales[i]        = kp.size;
+    orientations[i]  = kp.angle;
+    scores[i]        = kp.response;
+    uncertainties[i] = kKeypointUncertaintyPixelSigma;
+  }
+  frame->swapKeypointMeasurements(&ikeypoints);
+  frame->swapKeypointScores(&scores);
+  frame->swapKeypointOrientations(&orientations);
+  frame->swapKeypointScales(&scales);
+  frame->swapKeypointMeasurementUncertainties(&uncertainties);
+}
+
+}  // namespace aslam
@@ -0,0 +1,67 @@
+#include <aslam/pipeline/visual-pipeline-lines.h>
+
+#include <aslam/common/trace-recorder.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/pipeline/undistorter.h>
+#include <glog/logging.h>
+
+namespace aslam {
+
+LineVisualPipeline::LineVisualPipeline() {
+  // Just for serialization. Not meant to be used.
+}
+
+LineVisualPipeline::LineVisualPipeline(const Camera::ConstPtr& camera, bool copy_images,
+                                       const LineSegmentDetector::Options& options,
+                                       const VisualPipeline::Ptr& point_pipeline)
+: VisualPipeline(camera, camera, copy_images), point_pipeline_(point_pipeline) {
+  initializeLines(options);
+}
+
+LineVisualPipeline::LineVisualPipeline(std::unique_ptr<Undistorter>& preprocessing,
+                                       bool copy_images,
+                                       const LineSegmentDetector::Options& options,
+                                       const VisualPipeline::Ptr& point_pipeline)
+: VisualPipeline(preprocessing, copy_images), point_pipeline_(point_pipeline) {
+  initializeLines(options);
+}
+
+LineVisualPipeline::~LineVisualPipeline() { }
+
+void LineVisualPipeline::initializeLines(const LineSegmentDetector::Options& options) {
+  if (point_pipeline_) {
+    // The points have to be in the images of this pipeline.
+    CHECK_EQ(point_pipeline_->getOutputCamera().getId(), getOutputCamera().getId());
+  }
+  line_detector_.reset(new LineSegmentDetector(options));
+}
+
+void LineVisualPipeline::processFrameImpl(const cv::Mat& image, VisualFrame* frame) const {
+  CHECK_NOTNULL(frame);
+  CHECK(line_detector_);
+  if (point_pipeline_) {
+    processFrameWith(*point_pipeline_, image, frame);
+  }
+
+  Lines lines;
+  {
+    common::ScopedTraceEvent trace_event(
+        common::TraceStage::kDetect, frame->getTimestampNanoseconds());
+    std::lock_guard<std::mutex> lock(line_detector_mutex_);
+    line_detector_->detect(image, &lines);
+  }
+
+  // The values are set even if there are no segments as downstream code may rely on the
+  // segments being set.
+  Eigen::Matrix4Xd line_segments(4, lines.size());
+  Eigen::VectorXd scores(lines.size());
+  for (size_t i = 0u; i < lines.size(); ++i) {
+    line_segments.block<2, 1>(0, i) = lines[i].start_point;
+    line_segments.block<2, 1>(2, i) = lines[i].end_point;
+    scores[i] = (lines[i].end_point - lines[i].start_point).norm();
+  }
+  frame->swapLineSegments(&line_segments);
+  frame->swapLineSegmentScores(&scores);
+}
+
+}  // namespace aslam
@@ -1,17 +1,52 @@
 #include <aslam/pipeline/visual-pipeline.h>
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+
 #include <aslam/cameras/camera.h>
+#include <aslam/common/deadline.h>
+#include <aslam/common/memory-usage.h>
+#include <aslam/common/occupancy-grid.h>
+#include <aslam/common/timer.h>
+#include <aslam/common/trace-recorder.h>
 #include <aslam/frames/visual-frame.h>
 #include <aslam/pipeline/undistorter.h>
+#include <aslam/pipeline/undistorter-mapped.h>
 
 #include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
 
 namespace aslam {
+namespace {
+// More buffers than concurrently processed images are not kept.
+const size_t kMaxNumPooledImageBuffers = 8u;
+// The keypoints are capped once less than this fraction of the deadline budget is left, the
+// tracker needs the rest.
+const double kKeypointCapRemainingBudgetRatio = 0.5;
+// Minimum number of keypoints kept under a deadline.
+const size_t kMinNumKeypointsUnderDeadline = 50u;
+
+typedef common::WeightedKeypoint<double, double, int> KeypointGridPoint;
+typedef common::FixedCapacityOccupancyGrid<KeypointGridPoint> KeypointOccupancyGrid;
+// The grid of selectKeypointsInGrid, reused by the frames selected on the same thread as long
+// as the image size and the grid layout stay the same.
+struct KeypointGridCache {
+  cv::Size image_size;
+  double grid_cell_size_pixels = 0.0;
+  size_t max_points_per_cell = 0u;
+  std::unique_ptr<KeypointOccupancyGrid> grid;
+};
+thread_local KeypointGridCache thread_keypoint_grid_cache;
+}  // namespace
 
 VisualPipeline::VisualPipeline(const Camera::ConstPtr& input_camera,
                                const Camera::ConstPtr& output_camera, bool copy_images)
 : input_camera_(input_camera), output_camera_(output_camera),
-  copy_images_(copy_images) {
+  copy_images_(copy_images), image_pyramid_max_level_(-1), subpixel_refinement_enabled_(false) {
   CHECK(input_camera);
   CHECK(output_camera);
 }
@@ -19,7 +54,7 @@ VisualPipeline::VisualPipeline(const Camera::ConstPtr& input_camera,
 
 VisualPipeline::VisualPipeline(std::unique_ptr<Undistorter>& preprocessing, bool copy_images)
 : preprocessing_(std::move(preprocessing)),
-  copy_images_(copy_images) {
+  copy_images_(copy_images), image_pyramid_max_level_(-1), subpixel_refinement_enabled_(false) {
   CHECK_NOTNULL(preprocessing_.get());
   input_camera_ = preprocessing_->getInputCameraShared();
   output_camera_ = preprocessing_->getOutputCameraShared();
@@ -27,33 +62,367 @@ VisualPipeline::VisualPipeline(std::unique_ptr<Undistorter>& preprocessing, bool
 
 std::shared_ptr<VisualFrame> VisualPipeline::processImage(const cv::Mat& raw_image,
                                                           int64_t timestamp) const {
+  return processImage(raw_image, timestamp, std::shared_ptr<VisualFrame>(new VisualFrame));
+}
+
+std::shared_ptr<VisualFrame> VisualPipeline::processImage(
+    const cv::Mat& raw_image, int64_t timestamp,
+    const std::shared_ptr<VisualFrame>& frame) const {
   CHECK_EQ(input_camera_->imageWidth(), static_cast<size_t>(raw_image.cols));
   CHECK_EQ(input_camera_->imageHeight(), static_cast<size_t>(raw_image.rows));
+  CHECK(frame);
 
   // \TODO(PTF) Eventually we can put timestamp correction policies in here.
-  std::shared_ptr<VisualFrame> frame(new VisualFrame);
   frame->setTimestampNanoseconds(timestamp);
   frame->setRawCameraGeometry(input_camera_);
   frame->setCameraGeometry(output_camera_);
   FrameId id;
   id.randomize();
   frame->setId(id);
+  // Collects the degradations of this frame, recycled frames still hold the previous ones.
+  common::DeadlineScope deadline_scope;
   if(copy_images_) {
     frame->setRawImage(raw_image.clone());
   } else {
     frame->setRawImage(raw_image);
   }
 
+  // Keeps the intermediate images alive until the pyramid is built.
+  std::shared_ptr<ImageBuffers> image_buffers;
+  if (image_buffer_pool_) {
+    image_buffers = image_buffer_pool_->acquire();
+  }
+
   cv::Mat image;
   if(preprocessing_) {
-    preprocessing_->processImage(raw_image, &image);
+    common::ScopedTraceEvent trace_event(common::TraceStage::kUndistort, timestamp);
+    if (image_buffers) {
+      // The undistorter writes into the buffer if it has the output size already. The
+      // undistorted image is preprocessed further, hence the undistorter must not keep it
+      // as the image of the frame.
+      image = image_buffers->undistorted_image;
+      preprocessing_->processFrameImage(raw_image, FrameId(), &image);
+      image_buffers->undistorted_image = image;
+    } else {
+      preprocessing_->processFrameImage(raw_image, id, &image);
+    }
   } else {
     image = raw_image;
   }
+  if (image_buffers) {
+    // The raw image is shared with the frame, only the undistorted image may be overwritten.
+    preprocessImage(static_cast<bool>(preprocessing_), image_buffers.get(), &image);
+    CHECK_EQ(output_camera_->imageWidth(), static_cast<size_t>(image.cols));
+    CHECK_EQ(output_camera_->imageHeight(), static_cast<size_t>(image.rows));
+  }
   /// Send the image to the derived class for processing
-  processFrameImpl(image, frame.get());
+  if (processing_roi_.area() > 0) {
+    processFrameImpl(image(processing_roi_), frame.get());
+    shiftFrameMeasurements(Eigen::Vector2d(processing_roi_.x, processing_roi_.y), frame.get());
+  } else {
+    processFrameImpl(image, frame.get());
+  }
 
+  if (image_pyramid_max_level_ >= 0) {
+    // Built into a new vector as copies of a previous pyramid may still be in use.
+    std::vector<cv::Mat> image_pyramid;
+    cv::buildOpticalFlowPyramid(image, image_pyramid, image_pyramid_window_size_,
+                                image_pyramid_max_level_);
+    frame->setImagePyramid(image_pyramid);
+  } else if (frame->hasImagePyramid()) {
+    frame->releaseImagePyramid();
+  }
+
+  if (subpixel_refinement_enabled_) {
+    if (deadline_scope.getDeadline().hasExpired()) {
+      common::DeadlineScope::addDegradation(common::Degradation::kSkippedSubpixelRefinement);
+    } else {
+      // After the pyramid is built, such that its derivatives can be reused.
+      refineFrameKeypointsSubpixel(image, subpixel_refinement_settings_, frame.get());
+    }
+  }
+
+  frame->setDegradations(deadline_scope.getDegradations());
   return frame;
 }
 
+void VisualPipeline::capKeypointsToDeadline(std::vector<cv::KeyPoint>* keypoints) {
+  CHECK_NOTNULL(keypoints);
+  const double remaining_budget_ratio =
+      common::DeadlineScope::getCurrentDeadline().getRemainingRatio();
+  if (remaining_budget_ratio >= kKeypointCapRemainingBudgetRatio ||
+      keypoints->size() <= kMinNumKeypointsUnderDeadline) {
+    return;
+  }
+  const size_t max_num_keypoints = std::max(kMinNumKeypointsUnderDeadline, static_cast<size_t>(
+      keypoints->size() * remaining_budget_ratio / kKeypointCapRemainingBudgetRatio));
+  if (max_num_keypoints < keypoints->size()) {
+    cv::KeyPointsFilter::retainBest(*keypoints, static_cast<int>(max_num_keypoints));
+    common::DeadlineScope::addDegradation(common::Degradation::kCappedKeypoints);
+  }
+}
+
+void VisualPipeline::selectKeypointsInGrid(
+    const cv::Size& image_size, double grid_cell_size_pixels, size_t max_num_keypoints,
+    std::vector<cv::KeyPoint>* keypoints) {
+  CHECK_NOTNULL(keypoints);
+  CHECK_GT(grid_cell_size_pixels, 0.0);
+  CHECK_GT(max_num_keypoints, 0u);
+  if (keypoints->size() <= max_num_keypoints || image_size.area() == 0) {
+    return;
+  }
+
+  typedef KeypointGridPoint GridPoint;
+  typedef KeypointOccupancyGrid OccupancyGrid;
+  const double image_rows = static_cast<double>(image_size.height);
+  const double image_cols = static_cast<double>(image_size.width);
+  const double cell_size_rows = std::min(grid_cell_size_pixels, image_rows);
+  const double cell_size_cols = std::min(grid_cell_size_pixels, image_cols);
+
+  // Distribute the budget evenly over the cells; the strongest keypoints win within a cell.
+  const size_t num_cells =
+      static_cast<size_t>(std::ceil(image_rows / cell_size_rows)) *
+      static_cast<size_t>(std::ceil(image_cols / cell_size_cols));
+  const size_t max_points_per_cell = std::max<size_t>(
+      1u, (max_num_keypoints + num_cells - 1u) / num_cells);
+  KeypointGridCache& grid_cache = thread_keypoint_grid_cache;
+  if (!grid_cache.grid || grid_cache.image_size != image_size ||
+      grid_cache.grid_cell_size_pixels != grid_cell_size_pixels ||
+      grid_cache.max_points_per_cell != max_points_per_cell) {
+    grid_cache.grid.reset(new OccupancyGrid(image_rows, image_cols, cell_size_rows,
+                                            cell_size_cols, max_points_per_cell));
+    grid_cache.image_size = image_size;
+    grid_cache.grid_cell_size_pixels = grid_cell_size_pixels;
+    grid_cache.max_points_per_cell = max_points_per_cell;
+  } else {
+    grid_cache.grid->reset();
+  }
+  OccupancyGrid& grid = *grid_cache.grid;
+  for (size_t i = 0u; i < keypoints->size(); ++i) {
+    const cv::KeyPoint& keypoint = (*keypoints)[i];
+    // Clamp to the image as subpixel refinement can push keypoints onto the border.
+    const double u_rows = std::min(std::max(static_cast<double>(keypoint.pt.y), 0.0),
+                                   image_rows - 1.0);
+    const double v_cols = std::min(std::max(static_cast<double>(keypoint.pt.x), 0.0),
+                                   image_cols - 1.0);
+    grid.addPointOrReplaceWeakestIfCellFull(
+        GridPoint(u_rows, v_cols, keypoint.response, static_cast<int>(i)));
+  }
+  // Rounding up the points per cell can exceed the budget if most cells are full.
+  if (grid.getNumPoints() > max_num_keypoints && max_points_per_cell > 1u) {
+    grid.removePointsFromFullestCellsUntilSize(max_num_keypoints);
+  }
+
+  OccupancyGrid::PointList selected_points;
+  grid.getAllPointsInGrid(&selected_points);
+  if (selected_points.size() > max_num_keypoints) {
+    // More cells than budget: keep the strongest of the single-point cells.
+    std::nth_element(selected_points.begin(), selected_points.begin() + max_num_keypoints,
+                     selected_points.end(), std::greater<GridPoint>());
+    selected_points.erase(selected_points.begin() + max_num_keypoints, selected_points.end());
+  }
+  // Keep the detector order of the selected keypoints.
+  std::sort(selected_points.begin(), selected_points.end(),
+            [](const GridPoint& lhs, const GridPoint& rhs) { return lhs.id < rhs.id; });
+  std::vector<cv::KeyPoint> selected_keypoints;
+  selected_keypoints.reserve(selected_points.size());
+  for (const GridPoint& point : selected_points) {
+    selected_keypoints.emplace_back((*keypoints)[point.id]);
+  }
+  keypoints->swap(selected_keypoints);
+}
+
+void VisualPipeline::setImagePreprocessing(const ImagePreprocessingSettings& settings) {
+  CHECK_GE(settings.num_downsample_levels, 0);
+  CHECK_GE(settings.clahe_clip_limit, 0.0);
+  CHECK_GT(settings.gamma, 0.0);
+  if (settings.num_downsample_levels > 0) {
+    CHECK(!preprocessing_) << "Downsampling after the undistortion is not supported, scale the "
+        << "output of the undistorter instead.";
+    int width = static_cast<int>(input_camera_->imageWidth());
+    int height = static_cast<int>(input_camera_->imageHeight());
+    for (int level = 0; level < settings.num_downsample_levels; ++level) {
+      // The size of cv::pyrDown.
+      width = (width + 1) / 2;
+      height = (height + 1) / 2;
+    }
+    CHECK_EQ(output_camera_->imageWidth(), static_cast<size_t>(width))
+        << "The output camera must have the resolution of the downsampled image.";
+    CHECK_EQ(output_camera_->imageHeight(), static_cast<size_t>(height))
+        << "The output camera must have the resolution of the downsampled image.";
+  }
+  if (settings.clahe_clip_limit > 0.0) {
+    CHECK_GT(settings.clahe_tile_grid_size.area(), 0);
+  }
+
+  image_preprocessing_settings_ = settings;
+  gamma_lut_.release();
+  if (settings.gamma != 1.0) {
+    gamma_lut_.create(1, 256, CV_8UC1);
+    for (int intensity = 0; intensity < 256; ++intensity) {
+      gamma_lut_.at<uchar>(0, intensity) = cv::saturate_cast<uchar>(
+          255.0 * std::pow(intensity / 255.0, settings.gamma));
+    }
+  }
+  image_buffer_pool_.reset();
+  if (settings.isEnabled()) {
+    const double clahe_clip_limit = settings.clahe_clip_limit;
+    const cv::Size clahe_tile_grid_size = settings.clahe_tile_grid_size;
+    image_buffer_pool_.reset(new common::ObjectPool<ImageBuffers>(
+        kMaxNumPooledImageBuffers, [clahe_clip_limit, clahe_tile_grid_size]() {
+          ImageBuffers* buffers = new ImageBuffers;
+          if (clahe_clip_limit > 0.0) {
+            buffers->clahe = cv::createCLAHE(clahe_clip_limit, clahe_tile_grid_size);
+          }
+          return buffers;
+        }, common::ObjectPool<ImageBuffers>::Recycler()));
+  }
+}
+
+void VisualPipeline::setDetectionMask(const cv::Mat& mask) {
+  cv::Mat mask_copy;
+  if (!mask.empty()) {
+    CHECK_EQ(mask.type(), CV_8UC1);
+    CHECK_EQ(output_camera_->imageWidth(), static_cast<size_t>(mask.cols));
+    CHECK_EQ(output_camera_->imageHeight(), static_cast<size_t>(mask.rows));
+    // Frames that are being processed keep the previous mask.
+    mask_copy = mask.clone();
+  }
+  std::lock_guard<std::mutex> lock(detection_mask_mutex_);
+  detection_mask_ = mask_copy;
+}
+
+size_t VisualPipeline::getMemoryUsageBytes() const {
+  size_t num_bytes = sizeof(*this) + common::getMemoryUsageBytes(gamma_lut_);
+  if (preprocessing_) {
+    num_bytes += preprocessing_->getMemoryUsageBytes();
+  }
+  {
+    std::lock_guard<std::mutex> lock(detection_mask_mutex_);
+    num_bytes += common::getMemoryUsageBytes(detection_mask_);
+  }
+  if (image_buffer_pool_) {
+    // The internal buffers of CLAHE are not visible.
+    num_bytes += image_buffer_pool_->getPooledMemoryUsageBytes([](const ImageBuffers& buffers) {
+      return sizeof(ImageBuffers) + common::getMemoryUsageBytes(buffers.undistorted_image) +
+          common::getMemoryUsageBytes(buffers.downsampled_images) +
+          common::getMemoryUsageBytes(buffers.equalized_image) +
+          common::getMemoryUsageBytes(buffers.gamma_corrected_image);
+    });
+  }
+  return num_bytes;
+}
+
+bool VisualPipeline::bindMemoryToNumaNode(size_t node) {
+  return !preprocessing_ || preprocessing_->bindMemoryToNumaNode(node);
+}
+
+void VisualPipeline::setProcessingRoi(const cv::Rect& roi) {
+  const cv::Rect output_image_rect(0, 0, static_cast<int>(output_camera_->imageWidth()),
+                                   static_cast<int>(output_camera_->imageHeight()));
+  CHECK_EQ(roi & output_image_rect, roi) << "The processed region must lie within the image.";
+  processing_roi_ = (roi == output_image_rect) ? cv::Rect() : roi;
+  if (preprocessing_) {
+    MappedUndistorter* mapped_undistorter =
+        dynamic_cast<MappedUndistorter*>(preprocessing_.get());
+    if (mapped_undistorter != nullptr) {
+      mapped_undistorter->setProcessingRoi(processing_roi_);
+    }
+  }
+}
+
+void VisualPipeline::setProcessingRoiFromCameraMask(int border_pixels) {
+  CHECK(output_camera_->hasMask()) << "The output camera has no mask.";
+  const cv::Rect roi = computeMaskBoundingRoi(output_camera_->getMask(), border_pixels);
+  CHECK_GT(roi.area(), 0) << "All pixels of the camera are masked.";
+  setProcessingRoi(roi);
+}
+
+cv::Rect VisualPipeline::computeMaskBoundingRoi(const cv::Mat& mask, int border_pixels) {
+  CHECK_EQ(mask.type(), CV_8UC1);
+  CHECK_GE(border_pixels, 0);
+  std::vector<cv::Point> unmasked_pixels;
+  cv::findNonZero(mask, unmasked_pixels);
+  if (unmasked_pixels.empty()) {
+    return cv::Rect();
+  }
+  const cv::Rect bounding_roi = cv::boundingRect(unmasked_pixels);
+  const cv::Rect grown_roi(bounding_roi.x - border_pixels, bounding_roi.y - border_pixels,
+                           bounding_roi.width + 2 * border_pixels,
+                           bounding_roi.height + 2 * border_pixels);
+  return grown_roi & cv::Rect(0, 0, mask.cols, mask.rows);
+}
+
+void VisualPipeline::shiftFrameMeasurements(const Eigen::Vector2d& offset, VisualFrame* frame) {
+  CHECK_NOTNULL(frame);
+  if (frame->hasKeypointMeasurements()) {
+    frame->getKeypointMeasurementsMutable()->colwise() += offset;
+  }
+  if (frame->hasLineSegments()) {
+    Eigen::Matrix4Xd line_segments = frame->getLineSegments();
+    line_segments.topRows<2>().colwise() += offset;
+    line_segments.bottomRows<2>().colwise() += offset;
+    frame->swapLineSegments(&line_segments);
+  }
+}
+
+cv::Mat VisualPipeline::getDetectionMask() const {
+  std::lock_guard<std::mutex> lock(detection_mask_mutex_);
+  if (!detection_mask_.empty() && processing_roi_.area() > 0) {
+    return detection_mask_(processing_roi_);
+  }
+  return detection_mask_;
+}
+
+double VisualPipeline::getDetectionAreaRatio(const cv::Mat& detection_mask) {
+  if (detection_mask.empty()) {
+    return 1.0;
+  }
+  return static_cast<double>(cv::countNonZero(detection_mask)) / detection_mask.total();
+}
+
+void VisualPipeline::preprocessImage(
+    bool may_modify_image, ImageBuffers* buffers, cv::Mat* image) const {
+  CHECK_NOTNULL(buffers);
+  CHECK_NOTNULL(image);
+  CHECK_EQ(image->type(), CV_8UC1) << "The preprocessing requires 8 bit gray images.";
+  const ImagePreprocessingSettings& settings = image_preprocessing_settings_;
+
+  if (settings.num_downsample_levels > 0) {
+    static const size_t kTimerHandle =
+        timing::Timing::GetHandle("VisualPipeline::preprocessImage/downsample");
+    timing::Timer timer(kTimerHandle);
+    buffers->downsampled_images.resize(settings.num_downsample_levels);
+    for (int level = 0; level < settings.num_downsample_levels; ++level) {
+      cv::pyrDown(level == 0 ? *image : buffers->downsampled_images[level - 1],
+                  buffers->downsampled_images[level]);
+    }
+    *image = buffers->downsampled_images.back();
+    may_modify_image = true;
+  }
+
+  if (settings.clahe_clip_limit > 0.0) {
+    static const size_t kTimerHandle =
+        timing::Timing::GetHandle("VisualPipeline::preprocessImage/clahe");
+    timing::Timer timer(kTimerHandle);
+    CHECK(buffers->clahe);
+    buffers->clahe->apply(*image, buffers->equalized_image);
+    *image = buffers->equalized_image;
+    may_modify_image = true;
+  }
+
+  if (!gamma_lut_.empty()) {
+    static const size_t kTimerHandle =
+        timing::Timing::GetHandle("VisualPipeline::preprocessImage/gamma");
+    timing::Timer timer(kTimerHandle);
+    if (may_modify_image) {
+      // The lookup is applied in place on the output of the previous step.
+      cv::LUT(*image, gamma_lut_, *image);
+    } else {
+      cv::LUT(*image, gamma_lut_, buffers->gamma_corrected_image);
+      *image = buffers->gamma_corrected_image;
+    }
+  }
+}
+
 }  // namespace aslam
@@ -0,0 +1,88 @@
+#include <aslam/pipeline/worker-scaling-policy.h>
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace aslam {
+
+WorkerScalingPolicy::WorkerScalingPolicy(const Options& options, size_t num_threads)
+    : options_(options),
+      max_num_workers_(options.max_num_workers > 0u ? options.max_num_workers : num_threads),
+      num_workers_(options.min_num_workers),
+      period_start_time_nanoseconds_(-1),
+      max_num_waiting_items_in_period_(0u),
+      num_low_load_periods_(0u) {
+  CHECK_GT(num_threads, 0u);
+  CHECK_GT(options_.min_num_workers, 0u);
+  CHECK_LE(options_.min_num_workers, max_num_workers_);
+  CHECK_LE(max_num_workers_, num_threads);
+  CHECK_GT(options_.target_latency_nanoseconds, 0);
+  CHECK_GT(options_.latency_percentile, 0.0);
+  CHECK_LE(options_.latency_percentile, 1.0);
+  CHECK_GT(options_.scale_down_latency_fraction, 0.0);
+  CHECK_LT(options_.scale_down_latency_fraction, options_.scale_up_latency_fraction);
+  CHECK_GE(options_.max_num_waiting_items_per_worker, 0.0);
+  CHECK_GT(options_.evaluation_period_nanoseconds, 0);
+  CHECK_GT(options_.num_periods_to_scale_down, 0u);
+}
+
+bool WorkerScalingPolicy::addSample(int64_t time_nanoseconds, int64_t latency_nanoseconds,
+                                    size_t num_waiting_items) {
+  const size_t previous_num_workers = num_workers_;
+  if (period_start_time_nanoseconds_ < 0) {
+    period_start_time_nanoseconds_ = time_nanoseconds;
+  }
+  CHECK_GE(time_nanoseconds, period_start_time_nanoseconds_);
+  const int64_t num_ended_periods =
+      (time_nanoseconds - period_start_time_nanoseconds_) / options_.evaluation_period_nanoseconds;
+  if (num_ended_periods > 0) {
+    evaluatePeriod();
+    // The following periods had no samples. Enough of them scale down to the minimum, hence the
+    // rest is skipped.
+    const int64_t max_num_empty_periods =
+        static_cast<int64_t>(options_.num_periods_to_scale_down * max_num_workers_);
+    const int64_t num_empty_periods = std::min(num_ended_periods - 1, max_num_empty_periods);
+    for (int64_t i = 0; i < num_empty_periods; ++i) {
+      evaluatePeriod();
+    }
+    period_start_time_nanoseconds_ +=
+        num_ended_periods * options_.evaluation_period_nanoseconds;
+  }
+  period_latencies_.Record(static_cast<double>(latency_nanoseconds));
+  max_num_waiting_items_in_period_ =
+      std::max(max_num_waiting_items_in_period_, num_waiting_items);
+  return num_workers_ != previous_num_workers;
+}
+
+void WorkerScalingPolicy::evaluatePeriod() {
+  const bool has_samples = period_latencies_.GetCount() > 0u;
+  const double latency_nanoseconds =
+      has_samples ? period_latencies_.GetPercentile(options_.latency_percentile) : 0.0;
+  const double target_latency_nanoseconds =
+      static_cast<double>(options_.target_latency_nanoseconds);
+  const bool is_queue_too_long = max_num_waiting_items_in_period_ >
+      options_.max_num_waiting_items_per_worker * num_workers_;
+
+  if (is_queue_too_long ||
+      latency_nanoseconds > options_.scale_up_latency_fraction * target_latency_nanoseconds) {
+    num_low_load_periods_ = 0u;
+    num_workers_ = std::min(num_workers_ + 1u, max_num_workers_);
+  } else if (max_num_waiting_items_in_period_ == 0u &&
+             latency_nanoseconds <
+                 options_.scale_down_latency_fraction * target_latency_nanoseconds) {
+    if (++num_low_load_periods_ >= options_.num_periods_to_scale_down) {
+      num_low_load_periods_ = 0u;
+      num_workers_ = std::max(num_workers_ - 1u, options_.min_num_workers);
+    }
+  } else {
+    num_low_load_periods_ = 0u;
+  }
+
+  if (has_samples) {
+    period_latencies_.Reset();
+  }
+  max_num_waiting_items_in_period_ = 0u;
+}
+
+}  // namespace aslam
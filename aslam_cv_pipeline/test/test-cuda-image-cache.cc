@@ -0,0 +1,42 @@
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/unique-id.h>
+#include <aslam/pipeline/cuda-image-cache.h>
+
+namespace aslam {
+
+TEST(CudaImageCache, EvictsOldestImage) {
+  CudaImageCache cache(2u);
+  FrameId frame_ids[3];
+  for (FrameId& frame_id : frame_ids) {
+    frame_id.randomize();
+  }
+  // Empty device images don't need a CUDA device.
+  cv::cuda::GpuMat device_image;
+  cache.insert(frame_ids[0], device_image);
+  cache.insert(frame_ids[1], device_image);
+  cache.insert(frame_ids[1], device_image);
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_TRUE(cache.find(frame_ids[0], &device_image));
+
+  cache.insert(frame_ids[2], device_image);
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_FALSE(cache.find(frame_ids[0], &device_image));
+  EXPECT_TRUE(cache.find(frame_ids[1], &device_image));
+  EXPECT_TRUE(cache.find(frame_ids[2], &device_image));
+
+  cache.clear();
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_FALSE(cache.find(frame_ids[2], &device_image));
+}
+
+#ifndef ASLAM_CV_WITH_CUDA
+TEST(CudaImageCache, NoBackendWithoutCuda) {
+  EXPECT_FALSE(isCudaBackendAvailable());
+}
+#endif
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,201 @@
+#include <unistd.h>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/binary-serialization.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe-archive.h>
+#include <aslam/frames/visual-nframe.h>
+#include <aslam/pipeline/sharded-batch-processor.h>
+#include <aslam/pipeline/visual-npipeline.h>
+#include <aslam/pipeline/visual-pipeline-null.h>
+
+namespace aslam {
+
+class ShardedBatchProcessorTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kNumCameras = 2u;
+  static constexpr size_t kNumNFrames = 20u;
+  static constexpr int64_t kFramePeriod = 1000;
+
+  virtual void SetUp() {
+    camera_rig_ = NCamera::createTestNCamera(kNumCameras);
+    for (size_t i = 0u; i < kNumNFrames; ++i) {
+      nframe_timestamps_.push_back(kFramePeriod * static_cast<int64_t>(i));
+    }
+  }
+
+  virtual void TearDown() {
+    for (const std::string& path : paths_) {
+      ::unlink(path.c_str());
+      ::unlink((path + ".index").c_str());
+    }
+  }
+
+  std::string createTemporaryPath() {
+    char path[] = "/tmp/test-sharded-batch-processor-XXXXXX";
+    const int file_descriptor = mkstemp(path);
+    CHECK_GE(file_descriptor, 0);
+    ::close(file_descriptor);
+    paths_.push_back(path);
+    return paths_.back();
+  }
+
+  ShardedBatchProcessor::Ptr createProcessor(size_t max_num_concurrent_shards) {
+    ShardedBatchProcessor::Options options;
+    options.max_num_lookahead_nframes = 3u;
+    options.max_num_concurrent_shards = max_num_concurrent_shards;
+    const NCamera::Ptr camera_rig = camera_rig_;
+    const auto pipeline_factory = [camera_rig]() {
+      std::vector<VisualPipeline::Ptr> pipelines;
+      for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+        pipelines.emplace_back(
+            new NullVisualPipeline(camera_rig->getCameraShared(camera_idx), false));
+      }
+      return VisualNPipeline::Ptr(
+          new VisualNPipeline(2u, pipelines, camera_rig, camera_rig, 100));
+    };
+    const std::vector<int64_t> nframe_timestamps = nframe_timestamps_;
+    const auto source_factory = [nframe_timestamps](int64_t begin, int64_t end) {
+      std::shared_ptr<size_t> next_index(new size_t(0u));
+      return [nframe_timestamps, begin, end, next_index](VisualNPipeline::BatchImages* images) {
+        while (*next_index < nframe_timestamps.size() &&
+               nframe_timestamps[*next_index] < begin) {
+          ++(*next_index);
+        }
+        if (*next_index == nframe_timestamps.size() ||
+            nframe_timestamps[*next_index] >= end) {
+          return false;
+        }
+        for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+          images->images.emplace_back(cv::Mat::zeros(4, 4, CV_8UC1));
+          images->timestamps.push_back(nframe_timestamps[*next_index] + camera_idx);
+        }
+        ++(*next_index);
+        return true;
+      };
+    };
+    // Keypoint 0 is tracked through the whole dataset, keypoint 1 starts a new track in every
+    // nframe. Every shard numbers its tracks from 0.
+    const auto nframe_processor_factory = []() {
+      std::shared_ptr<int> next_track_id(new int(1));
+      return VisualNPipeline::NFrameCallback(
+          [next_track_id](const std::shared_ptr<VisualNFrame>& nframe) {
+            for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+              const VisualFrame::Ptr frame = nframe->getFrameShared(camera_idx);
+              frame->setKeypointMeasurements(Eigen::Matrix2Xd::Zero(2, 2));
+              frame->setTrackIds(Eigen::Vector2i(0, *next_track_id));
+            }
+            ++(*next_track_id);
+          });
+    };
+    return ShardedBatchProcessor::Ptr(new ShardedBatchProcessor(
+        options, pipeline_factory, source_factory, nframe_processor_factory));
+  }
+
+  void processAndMerge(size_t num_shards, int64_t warm_up_duration,
+                       const std::string& merged_path, BatchShardStatistics* statistics) {
+    const std::vector<BatchShard> shards =
+        splitIntoBatchShards(nframe_timestamps_, num_shards, warm_up_duration);
+    ASSERT_EQ(num_shards, shards.size());
+    std::vector<std::string> archive_paths;
+    for (size_t shard_idx = 0u; shard_idx < num_shards; ++shard_idx) {
+      archive_paths.push_back(createTemporaryPath());
+    }
+    std::vector<BatchShardStatistics> shard_statistics;
+    ASSERT_TRUE(createProcessor(2u)->processShardsLocally(
+        shards, archive_paths, &shard_statistics));
+    size_t num_warm_up_nframes = 0u;
+    for (const BatchShardStatistics& shard_statistic : shard_statistics) {
+      num_warm_up_nframes += shard_statistic.num_warm_up_nframes;
+    }
+    EXPECT_EQ((num_shards - 1u) * static_cast<size_t>(warm_up_duration / kFramePeriod),
+              num_warm_up_nframes);
+    ASSERT_TRUE(ShardedBatchProcessor::mergeShardArchives(
+        shards, archive_paths, camera_rig_, merged_path, statistics));
+  }
+
+  NCamera::Ptr camera_rig_;
+  std::vector<int64_t> nframe_timestamps_;
+  std::vector<std::string> paths_;
+};
+
+constexpr size_t ShardedBatchProcessorTest::kNumCameras;
+constexpr size_t ShardedBatchProcessorTest::kNumNFrames;
+constexpr int64_t ShardedBatchProcessorTest::kFramePeriod;
+
+TEST_F(ShardedBatchProcessorTest, SplitIntoBalancedShardsCoveringTheDataset) {
+  const std::vector<BatchShard> shards = splitIntoBatchShards(nframe_timestamps_, 3u, 2500);
+  ASSERT_EQ(3u, shards.size());
+  std::vector<size_t> num_owned_nframes(3u, 0u);
+  for (const int64_t timestamp : nframe_timestamps_) {
+    size_t num_owners = 0u;
+    for (const BatchShard& shard : shards) {
+      if (shard.isOwned(timestamp)) {
+        ++num_owners;
+        ++num_owned_nframes[shard.index];
+      }
+    }
+    EXPECT_EQ(1u, num_owners);
+  }
+  EXPECT_EQ((std::vector<size_t>{6u, 7u, 7u}), num_owned_nframes);
+  EXPECT_EQ(6000, shards[1].begin_timestamp_nanoseconds);
+  EXPECT_EQ(3500, shards[1].warm_up_begin_timestamp_nanoseconds);
+  EXPECT_EQ(shards[1].end_timestamp_nanoseconds, shards[2].begin_timestamp_nanoseconds);
+
+  EXPECT_EQ(2u, splitIntoBatchShards({0, 1}, 5u, 0).size());
+  EXPECT_TRUE(splitIntoBatchShards({}, 5u, 0).empty());
+}
+
+TEST_F(ShardedBatchProcessorTest, MergedShardsEqualASingleShard) {
+  const std::string single_shard_path = createTemporaryPath();
+  BatchShardStatistics single_shard_statistics;
+  processAndMerge(1u, 0, single_shard_path, &single_shard_statistics);
+  const std::string merged_path = createTemporaryPath();
+  BatchShardStatistics merged_statistics;
+  processAndMerge(3u, 3 * kFramePeriod, merged_path, &merged_statistics);
+
+  // One track through the dataset and one track per nframe for every camera.
+  for (const BatchShardStatistics& statistics :
+       {single_shard_statistics, merged_statistics}) {
+    EXPECT_EQ(kNumNFrames, statistics.num_nframes);
+    EXPECT_EQ(0u, statistics.num_warm_up_nframes);
+    EXPECT_EQ(2u * kNumCameras * kNumNFrames, statistics.num_keypoints);
+    EXPECT_EQ(2u * kNumCameras * kNumNFrames, statistics.num_tracked_keypoints);
+    EXPECT_EQ(kNumCameras * (kNumNFrames + 1u), statistics.num_tracks);
+  }
+
+  VisualNFrameArchive single_shard_archive, merged_archive;
+  ASSERT_TRUE(single_shard_archive.open(single_shard_path));
+  ASSERT_TRUE(merged_archive.open(merged_path));
+  ASSERT_EQ(kNumNFrames, merged_archive.getNumNFrames());
+  for (size_t index = 0u; index < kNumNFrames; ++index) {
+    EXPECT_EQ(nframe_timestamps_[index], merged_archive.getTimestampNanoseconds(index));
+    BinaryVisualNFrameView single_shard_nframe, merged_nframe;
+    single_shard_archive.getNFrame(index, &single_shard_nframe);
+    merged_archive.getNFrame(index, &merged_nframe);
+    for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+      const auto expected_track_ids =
+          single_shard_nframe.getFrame(camera_idx).getMatrixChannel<int>("TRACK_IDS");
+      const auto track_ids =
+          merged_nframe.getFrame(camera_idx).getMatrixChannel<int>("TRACK_IDS");
+      ASSERT_EQ(2, track_ids.size());
+      // The track through the dataset continues across the shard borders.
+      EXPECT_EQ(0, track_ids(0));
+      EXPECT_EQ(expected_track_ids(0), track_ids(0));
+      EXPECT_EQ(static_cast<int>(index) + 1, track_ids(1));
+    }
+  }
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
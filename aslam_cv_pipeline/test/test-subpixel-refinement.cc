@@ -0,0 +1,80 @@
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/pipeline/subpixel-refinement.h>
+
+namespace aslam {
+namespace {
+constexpr int kImageSize = 80;
+constexpr int kNumSamplesPerAxis = 8;
+
+// Renders a blurred checkerboard corner at the given location with supersampling. Pixel
+// centers are at integer coordinates.
+cv::Mat renderCorner(const Eigen::Vector2d& corner, bool vertical_edge_only) {
+  cv::Mat image(kImageSize, kImageSize, CV_8UC1);
+  for (int y = 0; y < kImageSize; ++y) {
+    for (int x = 0; x < kImageSize; ++x) {
+      double intensity = 0.0;
+      for (int sy = 0; sy < kNumSamplesPerAxis; ++sy) {
+        for (int sx = 0; sx < kNumSamplesPerAxis; ++sx) {
+          const double sample_x = x + (sx + 0.5) / kNumSamplesPerAxis - 0.5;
+          const double sample_y = y + (sy + 0.5) / kNumSamplesPerAxis - 0.5;
+          const bool is_bright = vertical_edge_only ? sample_x < corner.x() :
+              (sample_x < corner.x()) == (sample_y < corner.y());
+          intensity += is_bright ? 200.0 : 50.0;
+        }
+      }
+      image.at<unsigned char>(y, x) = cv::saturate_cast<unsigned char>(
+          intensity / (kNumSamplesPerAxis * kNumSamplesPerAxis));
+    }
+  }
+  cv::GaussianBlur(image, image, cv::Size(5, 5), 1.0);
+  return image;
+}
+}  // namespace
+
+TEST(SubpixelRefinementTest, RefinesCornersTowardsTheTrueLocation) {
+  const Eigen::Vector2d corner(40.3, 30.6);
+  cv::Mat gradients;
+  computeImageGradients(renderCorner(corner, false), &gradients);
+  ASSERT_EQ(CV_16SC2, gradients.type());
+
+  // Detections off by up to a pixel, and one too close to the border for the window.
+  Eigen::Matrix2Xd keypoints(2, 4);
+  keypoints << 40.0, 41.0, 39.6, 1.0,
+               31.0, 30.0, 31.4, 1.0;
+  std::vector<unsigned char> is_refined;
+  EXPECT_EQ(3u, refineKeypointsSubpixel(gradients, SubpixelRefinementSettings(), &keypoints,
+                                        &is_refined));
+  ASSERT_EQ(4u, is_refined.size());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(is_refined[i]);
+    EXPECT_NEAR(corner.x(), keypoints(0, i), 0.05);
+    EXPECT_NEAR(corner.y(), keypoints(1, i), 0.05);
+  }
+  EXPECT_FALSE(is_refined[3]);
+  EXPECT_EQ(Eigen::Vector2d(1.0, 1.0), Eigen::Vector2d(keypoints.col(3)));
+}
+
+TEST(SubpixelRefinementTest, KeepsKeypointsOnEdges) {
+  cv::Mat gradients;
+  computeImageGradients(renderCorner(Eigen::Vector2d(40.3, 30.6), true), &gradients);
+
+  Eigen::Matrix2Xd keypoints(2, 1);
+  keypoints << 40.0, 30.0;
+  const Eigen::Matrix2Xd detected_keypoints = keypoints;
+  std::vector<unsigned char> is_refined;
+  EXPECT_EQ(0u, refineKeypointsSubpixel(gradients, SubpixelRefinementSettings(), &keypoints,
+                                        &is_refined));
+  EXPECT_FALSE(is_refined[0]);
+  EXPECT_EQ(detected_keypoints, keypoints);
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
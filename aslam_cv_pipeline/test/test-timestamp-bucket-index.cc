@@ -0,0 +1,82 @@
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/pipeline/timestamp-bucket-index.h>
+
+namespace aslam {
+
+TEST(TimestampBucketIndex, FindClosestWithinTolerance) {
+  const int64_t kToleranceNs = 10;
+  TimestampBucketIndex<int> index(kToleranceNs);
+  EXPECT_EQ(index.findClosest(0), nullptr);
+
+  index.insert(100, 1);
+  index.insert(121, 2);
+  index.insert(-50, 3);
+  EXPECT_EQ(index.size(), 3u);
+
+  ASSERT_NE(index.findClosest(110), nullptr);
+  EXPECT_EQ(*index.findClosest(110), 1);
+  EXPECT_EQ(*index.findClosest(111), 2);
+  EXPECT_EQ(*index.findClosest(131), 2);
+  EXPECT_EQ(index.findClosest(132), nullptr);
+  EXPECT_EQ(*index.findClosest(-60), 3);
+  EXPECT_EQ(*index.findClosest(-40), 3);
+  EXPECT_EQ(index.findClosest(-61), nullptr);
+  EXPECT_EQ(index.findClosest(89), nullptr);
+
+  EXPECT_FALSE(index.erase(101));
+  EXPECT_TRUE(index.erase(100));
+  EXPECT_EQ(index.findClosest(100), nullptr);
+  EXPECT_EQ(*index.findClosest(111), 2);
+  EXPECT_EQ(index.size(), 2u);
+}
+
+TEST(TimestampBucketIndex, MatchesLinearSearch) {
+  const int64_t kToleranceNs = 1000;
+  const size_t kNumSteps = 20000u;
+  TimestampBucketIndex<int64_t> index(kToleranceNs, 4u);
+  std::map<int64_t, int64_t> reference;
+
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int64_t> timestamp_distribution(-100000, 100000);
+  for (size_t step = 0u; step < kNumSteps; ++step) {
+    const int64_t timestamp_ns = timestamp_distribution(generator);
+    // The closest entry within the tolerance, the older one on ties.
+    std::map<int64_t, int64_t>::const_iterator closest_it = reference.end();
+    for (std::map<int64_t, int64_t>::const_iterator it = reference.begin();
+         it != reference.end(); ++it) {
+      const int64_t time_diff = std::abs(it->first - timestamp_ns);
+      if (time_diff <= kToleranceNs && (closest_it == reference.end() ||
+          time_diff < std::abs(closest_it->first - timestamp_ns))) {
+        closest_it = it;
+      }
+    }
+    int64_t* value = index.findClosest(timestamp_ns);
+    if (closest_it == reference.end()) {
+      ASSERT_EQ(value, nullptr);
+      if (reference.size() < 50u) {
+        index.insert(timestamp_ns, timestamp_ns);
+        reference.emplace(timestamp_ns, timestamp_ns);
+      }
+    } else {
+      ASSERT_NE(value, nullptr);
+      ASSERT_EQ(*value, closest_it->second);
+      // Erase some entries to exercise the backward shift deletion.
+      if (step % 3u == 0u) {
+        ASSERT_TRUE(index.erase(closest_it->first));
+        reference.erase(closest_it);
+      }
+    }
+    ASSERT_EQ(index.size(), reference.size());
+  }
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
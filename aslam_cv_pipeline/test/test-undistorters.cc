@@ -1,4 +1,9 @@
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
 
 #include <Eigen/Core>
 #include <eigen-checks/gtest.h>
@@ -16,7 +21,9 @@
 #include <aslam/common/entrypoint.h>
 #include <aslam/common/memory.h>
 #include <aslam/pipeline/test/convert-maps-legacy.h>
+#include <aslam/pipeline/undistorter-map-cache.h>
 #include <aslam/pipeline/undistorter-mapped.h>
+#include <aslam/pipeline/undistorter-mapped-cuda.h>
 
 ///////////////////////////////////////////////
 // Types to test
@@ -112,6 +119,166 @@ TYPED_TEST(TestUndistorters, TestMappedUndistorter) {
   }
 }
 
+TYPED_TEST(TestUndistorters, TestFixedPointAndValidRoiProcessing) {
+  std::unique_ptr<aslam::MappedUndistorter> undistorter =
+      aslam::createMappedUndistorter(*(this->camera_), 0.5, 1.0,
+                                     aslam::InterpolationMethod::Linear);
+  const aslam::Camera& input_camera = undistorter->getInputCamera();
+  cv::Mat input_image(input_camera.imageHeight(), input_camera.imageWidth(), CV_8UC1);
+  cv::randu(input_image, cv::Scalar::all(0), cv::Scalar::all(255));
+
+  cv::Mat reference_image;
+  undistorter->processImage(input_image, &reference_image);
+
+  // The output buffer is reused for consecutive frames.
+  cv::Mat output_image;
+  undistorter->processImage(input_image, &output_image);
+  const uchar* output_data = output_image.data;
+  undistorter->processImage(input_image, &output_image);
+  EXPECT_EQ(output_data, output_image.data);
+
+  // Floating point maps converted to fixed-point give the same result as the fixed-point maps
+  // built directly, up to rounding of the interpolation.
+  cv::Mat map_u_float, map_v_float;
+  aslam::common::buildUndistortMap(input_camera, undistorter->getOutputCamera(), CV_32FC1,
+                                   map_u_float, map_v_float);
+  aslam::MappedUndistorter float_map_undistorter(
+      undistorter->getInputCameraShared(), undistorter->getOutputCameraShared(),
+      map_u_float, map_v_float, aslam::InterpolationMethod::Linear);
+  float_map_undistorter.setUseFixedPointMaps(true);
+  cv::Mat fixed_point_image;
+  float_map_undistorter.processImage(input_image, &fixed_point_image);
+  EXPECT_LE(cv::norm(reference_image, fixed_point_image, cv::NORM_INF), 1.0);
+
+  // Only the valid region is undistorted, everything else is zero.
+  const cv::Rect roi = undistorter->getValidOutputRoi();
+  ASSERT_GT(roi.area(), 0);
+  undistorter->setUndistortValidRoiOnly(true);
+  cv::Mat roi_image(reference_image.size(), CV_8UC1, cv::Scalar(255));
+  undistorter->processImage(input_image, &roi_image);
+  EXPECT_EQ(cv::norm(reference_image(roi), roi_image(roi), cv::NORM_INF), 0.0);
+  cv::Mat outside_roi_image = roi_image.clone();
+  outside_roi_image(roi).setTo(cv::Scalar(0));
+  EXPECT_EQ(cv::countNonZero(outside_roi_image), 0);
+
+  // The processing region further restricts the remapped region.
+  const cv::Rect processing_roi(0, 0, reference_image.cols / 2, reference_image.rows);
+  undistorter->setProcessingRoi(processing_roi);
+  const cv::Rect remapped_roi = roi & processing_roi;
+  EXPECT_EQ(undistorter->getRemappedOutputRoi(), remapped_roi);
+  undistorter->processImage(input_image, &roi_image);
+  EXPECT_EQ(cv::norm(reference_image(remapped_roi), roi_image(remapped_roi), cv::NORM_INF), 0.0);
+  outside_roi_image = roi_image.clone();
+  outside_roi_image(remapped_roi).setTo(cv::Scalar(0));
+  EXPECT_EQ(cv::countNonZero(outside_roi_image), 0);
+}
+
+TYPED_TEST(TestUndistorters, TestCudaUndistorterEqualsCpuUndistorter) {
+  if (!aslam::isCudaBackendAvailable()) {
+    ASLAM_SKIP_TEST("The CUDA backend is not available.");
+  }
+  std::unique_ptr<aslam::MappedUndistorter> undistorter =
+      aslam::createMappedUndistorter(*(this->camera_), 0.5, 1.0,
+                                     aslam::InterpolationMethod::Linear);
+  const aslam::Camera& input_camera = undistorter->getInputCamera();
+  cv::Mat input_image(input_camera.imageHeight(), input_camera.imageWidth(), CV_8UC1);
+  cv::randu(input_image, cv::Scalar::all(0), cv::Scalar::all(255));
+  undistorter->setUndistortValidRoiOnly(true);
+  cv::Mat reference_image;
+  undistorter->processImage(input_image, &reference_image);
+
+  std::shared_ptr<aslam::CudaImageCache> device_images(new aslam::CudaImageCache(2u));
+  aslam::CudaMappedUndistorter cuda_undistorter(*undistorter, device_images);
+  ASSERT_TRUE(cuda_undistorter.isUsingCuda());
+  EXPECT_EQ(cuda_undistorter.getValidOutputRoi(), undistorter->getValidOutputRoi());
+  aslam::FrameId frame_id;
+  frame_id.randomize();
+  cv::Mat image;
+  cuda_undistorter.processFrameImage(input_image, frame_id, &image);
+  ASSERT_EQ(image.size(), reference_image.size());
+  EXPECT_LE(cv::norm(reference_image, image, cv::NORM_INF), 1.0);
+  cv::cuda::GpuMat device_image;
+  EXPECT_TRUE(device_images->find(frame_id, &device_image));
+
+  // The result stays on the device until it is downloaded.
+  aslam::FrameId device_frame_id;
+  device_frame_id.randomize();
+  cv::cuda::Stream stream;
+  cv::cuda::GpuMat device_output_image;
+  cuda_undistorter.processImageOnDevice(input_image, device_frame_id, &device_output_image,
+                                        stream);
+  stream.waitForCompletion();
+  ASSERT_TRUE(device_images->find(device_frame_id, &device_image));
+  cv::Mat downloaded_image;
+  device_image.download(downloaded_image);
+  ASSERT_EQ(downloaded_image.size(), reference_image.size());
+  EXPECT_LE(cv::norm(reference_image, downloaded_image, cv::NORM_INF), 1.0);
+}
+
+TYPED_TEST(TestUndistorters, TestScaledAndCroppedUndistorter) {
+  const float kAlpha = 0.5;
+  const float kScale = 0.5;
+  std::unique_ptr<aslam::MappedUndistorter> scaled_undistorter =
+      aslam::createMappedUndistorter(*(this->camera_), kAlpha, kScale,
+                                     aslam::InterpolationMethod::Linear);
+  const aslam::Camera& scaled_camera = scaled_undistorter->getOutputCamera();
+  const cv::Rect crop(scaled_camera.imageWidth() / 8u, scaled_camera.imageHeight() / 4u,
+                      scaled_camera.imageWidth() / 2u, scaled_camera.imageHeight() / 2u);
+  std::unique_ptr<aslam::MappedUndistorter> cropped_undistorter =
+      aslam::createMappedUndistorter(*(this->camera_), kAlpha, kScale, crop,
+                                     aslam::InterpolationMethod::Linear);
+  const aslam::Camera& cropped_camera = cropped_undistorter->getOutputCamera();
+  ASSERT_EQ(cropped_camera.imageWidth(), static_cast<uint32_t>(crop.width));
+  ASSERT_EQ(cropped_camera.imageHeight(), static_cast<uint32_t>(crop.height));
+
+  // The crop only shifts the principal point.
+  const Eigen::VectorXd& scaled_intrinsics = scaled_camera.getParameters();
+  const Eigen::VectorXd& cropped_intrinsics = cropped_camera.getParameters();
+  const int kCuIndex = scaled_intrinsics.size() - 2;
+  const int kCvIndex = scaled_intrinsics.size() - 1;
+  EXPECT_DOUBLE_EQ(cropped_intrinsics(kCuIndex), scaled_intrinsics(kCuIndex) - crop.x);
+  EXPECT_DOUBLE_EQ(cropped_intrinsics(kCvIndex), scaled_intrinsics(kCvIndex) - crop.y);
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(cropped_intrinsics.head(kCuIndex),
+                                 scaled_intrinsics.head(kCuIndex)));
+
+  const cv::Rect expected_valid_roi =
+      (scaled_undistorter->getValidOutputRoi() & crop) - crop.tl();
+  EXPECT_EQ(cropped_undistorter->getValidOutputRoi(), expected_valid_roi);
+
+  // A single remap gives the crop of the scaled undistorted image.
+  const aslam::Camera& input_camera = scaled_undistorter->getInputCamera();
+  cv::Mat input_image(input_camera.imageHeight(), input_camera.imageWidth(), CV_8UC1);
+  cv::randu(input_image, cv::Scalar::all(0), cv::Scalar::all(255));
+  cv::Mat scaled_image, cropped_image;
+  scaled_undistorter->processImage(input_image, &scaled_image);
+  cropped_undistorter->processImage(input_image, &cropped_image);
+  ASSERT_EQ(cropped_image.size(), crop.size());
+  EXPECT_LE(cv::norm(scaled_image(crop), cropped_image, cv::NORM_INF), 1.0);
+}
+
+TYPED_TEST(TestUndistorters, TestParallelMapsEqualSerialMaps) {
+  std::unique_ptr<aslam::MappedUndistorter> undistorter =
+      aslam::createMappedUndistorter(*(this->camera_), 1.0, 1.0,
+                                     aslam::InterpolationMethod::Linear);
+  const aslam::Camera& output_camera = undistorter->getOutputCamera();
+  for (const int map_type : {CV_16SC2, CV_32FC1, CV_32FC2}) {
+    cv::Mat map_u_serial, map_v_serial;
+    aslam::common::buildUndistortMap(*(this->camera_), output_camera, map_type, map_u_serial,
+                                     map_v_serial, 1u);
+    for (const size_t num_threads : {2u, 3u, 8u}) {
+      cv::Mat map_u, map_v;
+      aslam::common::buildUndistortMap(*(this->camera_), output_camera, map_type, map_u, map_v,
+                                       num_threads);
+      ASSERT_EQ(map_u.size(), map_u_serial.size());
+      EXPECT_EQ(cv::countNonZero(cv::Mat(map_u.reshape(1) != map_u_serial.reshape(1))), 0);
+      ASSERT_EQ(map_v.empty(), map_v_serial.empty());
+      if (!map_v.empty()) {
+        EXPECT_EQ(cv::countNonZero(cv::Mat(map_v != map_v_serial)), 0);
+      }
+    }
+  }
+}
+
 ////////////////////////////////////
 // Camera model specific test cases
 ////////////////////////////////////
@@ -165,4 +332,42 @@ TEST(TestUndistortersNoPinhole, TestMappedUndistorterUpcToPinhole) {
   }
 }
 
+TEST(TestUndistortMapCache, StoreAndLoadMaps) {
+  char cache_directory_template[] = "/tmp/aslam_undistort_map_cache_XXXXXX";
+  ASSERT_NE(mkdtemp(cache_directory_template), nullptr);
+  const aslam::UndistortMapCache cache(cache_directory_template);
+
+  aslam::PinholeCamera::Ptr camera =
+      aslam::PinholeCamera::createTestCamera<aslam::RadTanDistortion>();
+  std::unique_ptr<aslam::MappedUndistorter> undistorter =
+      aslam::createMappedUndistorter(*camera, 1.0, 1.0, aslam::InterpolationMethod::Linear);
+  const aslam::Camera& output_camera = undistorter->getOutputCamera();
+  const uint64_t key = aslam::UndistortMapCache::computeKey(
+      *camera, output_camera, CV_16SC2, aslam::InterpolationMethod::Linear);
+
+  cv::Mat map_u, map_v;
+  EXPECT_FALSE(cache.load(key, &map_u, &map_v));
+  ASSERT_TRUE(cache.store(key, undistorter->getUndistortMapU(), undistorter->getUndistortMapV()));
+  ASSERT_TRUE(cache.load(key, &map_u, &map_v));
+  ASSERT_EQ(map_u.type(), undistorter->getUndistortMapU().type());
+  ASSERT_EQ(map_v.type(), undistorter->getUndistortMapV().type());
+  EXPECT_EQ(cv::countNonZero(
+      cv::Mat(map_u.reshape(1) != undistorter->getUndistortMapU().reshape(1))), 0);
+  EXPECT_EQ(cv::countNonZero(cv::Mat(map_v != undistorter->getUndistortMapV())), 0);
+
+  // A different map entry is not found under this key.
+  EXPECT_FALSE(cache.load(key + 1u, &map_u, &map_v));
+
+  // Changes of the calibration or the interpolation result in a different key.
+  EXPECT_NE(key, aslam::UndistortMapCache::computeKey(
+      *camera, output_camera, CV_16SC2, aslam::InterpolationMethod::Cubic));
+  aslam::Camera::Ptr changed_camera(camera->clone());
+  changed_camera->getDistortionMutable()->getParametersMutable()[0] += 1e-6;
+  EXPECT_NE(key, aslam::UndistortMapCache::computeKey(
+      *changed_camera, output_camera, CV_16SC2, aslam::InterpolationMethod::Linear));
+
+  std::remove(cache.getFilePath(key).c_str());
+  rmdir(cache_directory_template);
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
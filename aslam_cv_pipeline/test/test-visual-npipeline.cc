@@ -1,11 +1,36 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 #include <gtest/gtest.h>
 #include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
 
 #include <aslam/cameras/camera.h>
 #include <aslam/cameras/camera-pinhole.h>
 #include <aslam/cameras/distortion-radtan.h>
 #include <aslam/cameras/ncamera.h>
+#include <aslam/common/deadline.h>
 #include <aslam/common/entrypoint.h>
+#include <aslam/common/memory-usage.h>
+#include <aslam/common/numa.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/common/real-time.h>
+#include <aslam/common/statistics/statistics.h>
+#include <aslam/common/time.h>
 #include <aslam/frames/visual-nframe.h>
 #include <aslam/pipeline/visual-pipeline-null.h>
 #include <aslam/pipeline/visual-pipeline.h>
@@ -13,14 +38,138 @@
 
 using namespace aslam;
 
+/// Sets a configurable number of keypoints and descriptors, optionally with scores.
+class KeypointVisualPipeline : public VisualPipeline {
+ public:
+  KeypointVisualPipeline(const Camera::ConstPtr& camera)
+      : VisualPipeline(camera, camera, false), num_keypoints_(0u), set_scores_(false) {}
+  virtual ~KeypointVisualPipeline() {}
+
+  void setNumKeypoints(size_t num_keypoints, bool set_scores) {
+    num_keypoints_ = num_keypoints;
+    set_scores_ = set_scores;
+  }
+
+ protected:
+  virtual void processFrameImpl(const cv::Mat& /* image */, VisualFrame* frame) const {
+    const int num_keypoints = static_cast<int>(num_keypoints_.load());
+    frame->setKeypointMeasurements(Eigen::Matrix2Xd::Random(2, num_keypoints));
+    frame->setDescriptors(VisualFrame::DescriptorsT::Zero(48, num_keypoints));
+    if (set_scores_) {
+      frame->setKeypointScores(Eigen::VectorXd::Ones(num_keypoints));
+    }
+  }
+
+ private:
+  std::atomic<size_t> num_keypoints_;
+  std::atomic<bool> set_scores_;
+};
+
+/// Projects fixed points of the body frame into its camera, every keypoint has the descriptor
+/// of its point. The keypoints of the cameras are in different orders.
+class ProjectingVisualPipeline : public VisualPipeline {
+ public:
+  ProjectingVisualPipeline(const Camera::ConstPtr& camera, const Transformation& T_C_B,
+                           const Eigen::Matrix3Xd& B_points,
+                           const VisualFrame::DescriptorsT& point_descriptors, unsigned seed)
+      : VisualPipeline(camera, camera, false) {
+    std::vector<int> point_order(B_points.cols());
+    std::iota(point_order.begin(), point_order.end(), 0);
+    std::shuffle(point_order.begin(), point_order.end(), std::mt19937(seed));
+    std::vector<Eigen::Vector2d> keypoints;
+    for (const int point_idx : point_order) {
+      const Eigen::Vector3d B_point = B_points.col(point_idx);
+      Eigen::Vector2d keypoint;
+      if (camera->project3(T_C_B * B_point, &keypoint).isKeypointVisible()) {
+        keypoints.push_back(keypoint);
+        point_indices_.push_back(point_idx);
+      }
+    }
+    const int num_keypoints = static_cast<int>(point_indices_.size());
+    keypoints_.resize(2, num_keypoints);
+    descriptors_.resize(point_descriptors.rows(), num_keypoints);
+    for (int keypoint_idx = 0; keypoint_idx < num_keypoints; ++keypoint_idx) {
+      keypoints_.col(keypoint_idx) = keypoints[keypoint_idx];
+      descriptors_.col(keypoint_idx) = point_descriptors.col(point_indices_[keypoint_idx]);
+    }
+  }
+  virtual ~ProjectingVisualPipeline() {}
+
+  int getPointIndex(int keypoint_idx) const {
+    CHECK_LT(static_cast<size_t>(keypoint_idx), point_indices_.size());
+    return point_indices_[keypoint_idx];
+  }
+
+  size_t getNumCommonPoints(const ProjectingVisualPipeline& other) const {
+    size_t num_common_points = 0u;
+    for (const int point_idx : point_indices_) {
+      num_common_points += std::count(
+          other.point_indices_.begin(), other.point_indices_.end(), point_idx);
+    }
+    return num_common_points;
+  }
+
+ protected:
+  virtual void processFrameImpl(const cv::Mat& /* image */, VisualFrame* frame) const {
+    frame->setKeypointMeasurements(keypoints_);
+    frame->setDescriptors(descriptors_);
+  }
+
+ private:
+  Eigen::Matrix2Xd keypoints_;
+  VisualFrame::DescriptorsT descriptors_;
+  /// The point of every keypoint.
+  std::vector<int> point_indices_;
+};
+
+/// Records the deadline of every frame, then sleeps and degrades the frame if the deadline
+/// expired meanwhile.
+class DeadlineRecordingVisualPipeline : public VisualPipeline {
+ public:
+  DeadlineRecordingVisualPipeline(const Camera::ConstPtr& camera)
+      : VisualPipeline(camera, camera, false), sleep_milliseconds_(0) {}
+  virtual ~DeadlineRecordingVisualPipeline() {}
+
+  void setSleepMilliseconds(int sleep_milliseconds) { sleep_milliseconds_ = sleep_milliseconds; }
+
+  common::Deadline getDeadline(int64_t timestamp_nanoseconds) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::map<int64_t, common::Deadline>::const_iterator it =
+        deadlines_.find(timestamp_nanoseconds);
+    CHECK(it != deadlines_.end()) << "No frame at " << timestamp_nanoseconds;
+    return it->second;
+  }
+
+ protected:
+  virtual void processFrameImpl(const cv::Mat& /* image */, VisualFrame* frame) const {
+    const common::Deadline& deadline = common::DeadlineScope::getCurrentDeadline();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      deadlines_[frame->getTimestampNanoseconds()] = deadline;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(sleep_milliseconds_.load()));
+    if (deadline.hasExpired()) {
+      common::DeadlineScope::addDegradation(common::Degradation::kCappedKeypoints);
+    }
+  }
+
+ private:
+  std::atomic<int> sleep_milliseconds_;
+  mutable std::mutex mutex_;
+  mutable std::map<int64_t, common::Deadline> deadlines_;
+};
+
 class VisualNPipelineTest : public ::testing::Test {
  protected:
   typedef aslam::RadTanDistortion DistortionType;
   typedef aslam::PinholeCamera CameraType;
 
+  typedef std::function<VisualPipeline::Ptr(const Camera::Ptr&)> PipelineFactory;
+
   void constructNCamera(unsigned num_cameras,
                         unsigned num_threads,
-                        int64_t timestamp_tolerance_ns) {
+                        int64_t timestamp_tolerance_ns,
+                        const PipelineFactory& create_pipeline = PipelineFactory()) {
     NCameraId id;
     id.randomize();
     Aligned<std::vector, kindr::minimal::QuatTransformation> T_C_B;
@@ -32,7 +181,12 @@ class VisualNPipelineTest : public ::testing::Test {
 
       CameraType::Ptr camera = CameraType::createTestCamera<DistortionType>();
       cameras.push_back(camera);
-      pipelines.push_back(std::shared_ptr<VisualPipeline>(new NullVisualPipeline(camera, false)));
+      if (create_pipeline) {
+        pipelines.push_back(create_pipeline(camera));
+      } else {
+        pipelines.push_back(
+            std::shared_ptr<VisualPipeline>(new NullVisualPipeline(camera, false)));
+      }
     }
     camera_rig_.reset(new NCamera(id, T_C_B, cameras, "Test Camera System"));
 
@@ -206,4 +360,842 @@ TEST_F(VisualNPipelineTest, testTimestampDiff) {
   ASSERT_TRUE(nframes.get() == NULL);
 }
 
+TEST_F(VisualNPipelineTest, testInFlightLimitPolicies) {
+  this->constructNCamera(2, 4, 100);
+
+  // Fill the pipeline with two incomplete nframes.
+  pipeline_->setMaxNumInFlight(2u, VisualNPipeline::InFlightPolicy::kDropNewestImage);
+  pipeline_->processImage(0, getImageFromCamera(0), 0);
+  pipeline_->waitForAllWorkToComplete();
+  pipeline_->processImage(0, getImageFromCamera(0), 1000);
+  pipeline_->waitForAllWorkToComplete();
+  ASSERT_EQ(2u, pipeline_->getNumFramesProcessing());  // 0, 1000
+  ASSERT_EQ(2u, pipeline_->getNumInFlight());
+
+  // The newest image is dropped.
+  pipeline_->processImage(0, getImageFromCamera(0), 2000);
+  pipeline_->waitForAllWorkToComplete();
+  ASSERT_EQ(2u, pipeline_->getNumFramesProcessing());  // 0, 1000
+  EXPECT_EQ(1u, pipeline_->getFrameDropCounters(0).num_dropped_newest_image);
+  EXPECT_EQ(0u, pipeline_->getFrameDropCounters(1).num_dropped_newest_image);
+
+  // The oldest incomplete nframe is dropped.
+  pipeline_->setMaxNumInFlight(2u, VisualNPipeline::InFlightPolicy::kDropOldestIncompleteNFrame);
+  pipeline_->processImage(0, getImageFromCamera(0), 3000);
+  pipeline_->waitForAllWorkToComplete();
+  ASSERT_EQ(2u, pipeline_->getNumFramesProcessing());  // 1000, 3000
+  EXPECT_EQ(1u, pipeline_->getFrameDropCounters(0).num_dropped_oldest_incomplete_nframe);
+
+  // Blocking doesn't wait for incomplete nframes that need new images to complete.
+  pipeline_->setMaxNumInFlight(2u, VisualNPipeline::InFlightPolicy::kBlockProducer);
+  pipeline_->processImage(1, getImageFromCamera(1), 3001);
+  pipeline_->waitForAllWorkToComplete();
+  ASSERT_EQ(0u, pipeline_->getNumFramesProcessing());
+  ASSERT_EQ(1u, pipeline_->getNumFramesComplete());  // 3000
+  EXPECT_EQ(2u, pipeline_->getFrameDropCounters(0).num_dropped_oldest_incomplete_nframe);
+  EXPECT_EQ(0u, pipeline_->getFrameDropCounters(1).num_dropped_oldest_incomplete_nframe);
+
+  std::shared_ptr<VisualNFrame> nframes = pipeline_->getNext();
+  ASSERT_TRUE(nframes.get() != NULL);
+  EXPECT_EQ(3000, nframes->getFrame(0).getTimestampNanoseconds());
+  EXPECT_EQ(3001, nframes->getFrame(1).getTimestampNanoseconds());
+}
+
+TEST_F(VisualNPipelineTest, testZeroCopyImageBuffer) {
+  this->constructNCamera(2, 4, 100);
+
+  const Camera& camera = camera_rig_->getCamera(0);
+  std::vector<uint8_t> buffer(camera.imageWidth() * camera.imageHeight(), 7u);
+  std::atomic<int> num_deleter_calls(0);
+  pipeline_->processImageBuffer(
+      0, buffer.data(), camera.imageWidth(), CV_8UC1,
+      [&](void* data) {
+        EXPECT_EQ(data, buffer.data());
+        ++num_deleter_calls;
+      }, 0);
+  pipeline_->processImage(1, getImageFromCamera(1), 1);
+  pipeline_->waitForAllWorkToComplete();
+  ASSERT_EQ(1u, pipeline_->getNumFramesComplete());
+
+  // The raw image of the frame refers to the buffer of the caller.
+  std::shared_ptr<VisualNFrame> nframes = pipeline_->getNext();
+  ASSERT_TRUE(nframes.get() != NULL);
+  EXPECT_EQ(buffer.data(), nframes->getFrame(0).getRawImage().data);
+  EXPECT_EQ(0, num_deleter_calls);
+
+  // The buffer is released together with the last frame referring to it.
+  nframes.reset();
+  EXPECT_EQ(1, num_deleter_calls);
+}
+
+TEST_F(VisualNPipelineTest, testFramePoolRecyclesFrames) {
+  this->constructNCamera(2, 4, 100);
+  pipeline_->setFramePoolSize(2u);
+
+  pipeline_->processImage(0, getImageFromCamera(0), 0);
+  pipeline_->processImage(1, getImageFromCamera(1), 1);
+  pipeline_->waitForAllWorkToComplete();
+  std::shared_ptr<VisualNFrame> nframes = pipeline_->getNext();
+  ASSERT_TRUE(nframes.get() != NULL);
+  const VisualNFrame* nframe_address = nframes.get();
+  const VisualFrame* frame_address = &nframes->getFrame(0);
+  const NFramesId nframe_id = nframes->getId();
+  nframes.reset();
+
+  // The next nframe reuses the released objects but gets a new id and new frames.
+  pipeline_->processImage(0, getImageFromCamera(0), 1000);
+  pipeline_->processImage(1, getImageFromCamera(1), 1001);
+  pipeline_->waitForAllWorkToComplete();
+  nframes = pipeline_->getNext();
+  ASSERT_TRUE(nframes.get() != NULL);
+  EXPECT_EQ(nframe_address, nframes.get());
+  EXPECT_NE(nframe_id, nframes->getId());
+  EXPECT_EQ(frame_address, &nframes->getFrame(0));
+  EXPECT_EQ(1000, nframes->getFrame(0).getTimestampNanoseconds());
+  EXPECT_EQ(1001, nframes->getFrame(1).getTimestampNanoseconds());
+  EXPECT_TRUE(nframes->getFrame(0).hasRawImage());
+}
+
+TEST_F(VisualNPipelineTest, testFramePoolResizesTheKeypointChannels) {
+  for (const bool preallocate_nframes : {false, true}) {
+    std::vector<std::shared_ptr<KeypointVisualPipeline>> keypoint_pipelines;
+    this->constructNCamera(2, 4, 100, [&keypoint_pipelines](const Camera::Ptr& camera) {
+      keypoint_pipelines.emplace_back(new KeypointVisualPipeline(camera));
+      return keypoint_pipelines.back();
+    });
+    pipeline_->setFramePoolSize(2u);
+    pipeline_->setPreallocateNFrames(preallocate_nframes);
+
+    for (const std::shared_ptr<KeypointVisualPipeline>& keypoint_pipeline : keypoint_pipelines) {
+      keypoint_pipeline->setNumKeypoints(10u, true);
+    }
+    pipeline_->processImage(0, getImageFromCamera(0), 0);
+    pipeline_->processImage(1, getImageFromCamera(1), 1);
+    pipeline_->waitForAllWorkToComplete();
+    std::shared_ptr<VisualNFrame> nframes = pipeline_->getNext();
+    ASSERT_TRUE(nframes.get() != NULL);
+    // Like the tracker, add the track ids of the keypoints.
+    for (size_t frame_idx = 0u; frame_idx < 2u; ++frame_idx) {
+      nframes->getFrameShared(frame_idx)->setTrackIds(Eigen::VectorXi::Constant(10, 3));
+    }
+    const VisualFrame* frame_address = &nframes->getFrame(0);
+    nframes.reset();
+
+    // The recycled frames get fewer keypoints and no scores.
+    for (const std::shared_ptr<KeypointVisualPipeline>& keypoint_pipeline : keypoint_pipelines) {
+      keypoint_pipeline->setNumKeypoints(4u, false);
+    }
+    pipeline_->processImage(0, getImageFromCamera(0), 1000);
+    pipeline_->processImage(1, getImageFromCamera(1), 1001);
+    pipeline_->waitForAllWorkToComplete();
+    nframes = pipeline_->getNext();
+    ASSERT_TRUE(nframes.get() != NULL);
+    EXPECT_EQ(frame_address, &nframes->getFrame(0));
+    for (size_t frame_idx = 0u; frame_idx < 2u; ++frame_idx) {
+      const VisualFrame& frame = nframes->getFrame(frame_idx);
+      EXPECT_EQ(4u, frame.getNumKeypointMeasurements());
+      EXPECT_EQ(4, frame.getDescriptors().cols());
+      EXPECT_FALSE(frame.hasKeypointScores());
+      EXPECT_FALSE(frame.hasTrackIds());
+    }
+  }
+}
+
+TEST_F(VisualNPipelineTest, testMemoryUsageCountsTheQueuedNFrames) {
+  constexpr size_t kNumKeypoints = 20u;
+  this->constructNCamera(2, 4, 100, [](const Camera::Ptr& camera) {
+    KeypointVisualPipeline* pipeline = new KeypointVisualPipeline(camera);
+    pipeline->setNumKeypoints(kNumKeypoints, false);
+    return VisualPipeline::Ptr(pipeline);
+  });
+  common::MemoryUsageReport report;
+  size_t num_bytes = pipeline_->getMemoryUsageBytes("VisualNPipeline", &report);
+  EXPECT_EQ(num_bytes, pipeline_->getMemoryUsageBytes());
+  EXPECT_EQ(num_bytes, report.getBytes("VisualNPipeline"));
+  EXPECT_EQ(0u, report.getBytes("VisualNPipeline/completed"));
+  const size_t num_idle_bytes = num_bytes;
+
+  pipeline_->processImage(0, getImageFromCamera(0), 0);
+  pipeline_->processImage(1, getImageFromCamera(1), 1);
+  pipeline_->waitForAllWorkToComplete();
+  ASSERT_EQ(1u, pipeline_->getNumFramesComplete());
+  report.clear();
+  num_bytes = pipeline_->getMemoryUsageBytes("VisualNPipeline", &report);
+  EXPECT_EQ(num_bytes, report.getBytes("VisualNPipeline"));
+  // The keypoints, descriptors and raw images of both frames wait in the output queue.
+  const size_t num_frame_data_bytes = kNumKeypoints * (2u * sizeof(double) + 48u);
+  const size_t num_completed_bytes = report.getBytes("VisualNPipeline/completed");
+  EXPECT_GE(num_completed_bytes, 2u * num_frame_data_bytes +
+            common::getMemoryUsageBytes(getImageFromCamera(0)) +
+            common::getMemoryUsageBytes(getImageFromCamera(1)));
+  EXPECT_GE(report.getBytes("VisualNPipeline/completed/frame_1"), num_frame_data_bytes);
+  EXPECT_EQ(num_idle_bytes + num_completed_bytes, num_bytes);
+
+  std::shared_ptr<VisualNFrame> nframe = pipeline_->getNext();
+  ASSERT_TRUE(nframe);
+  EXPECT_EQ(num_completed_bytes, nframe->getMemoryUsageBytes());
+  EXPECT_EQ(num_idle_bytes, pipeline_->getMemoryUsageBytes());
+}
+
+TEST_F(VisualNPipelineTest, testMemoryUsageIsReportedPeriodically) {
+  this->constructNCamera(2, 4, 100);
+  const std::string kTag = "memory/VisualNPipeline/other";
+  const size_t num_samples = statistics::Statistics::GetNumSamples(kTag);
+  // Disabled by default.
+  pipeline_->processImage(0, getImageFromCamera(0), 0);
+  pipeline_->processImage(1, getImageFromCamera(1), 1);
+  pipeline_->waitForAllWorkToComplete();
+  EXPECT_EQ(num_samples, statistics::Statistics::GetNumSamples(kTag));
+
+  // The period elapses after every image.
+  pipeline_->setMemoryUsageReportingPeriod(1);
+  for (int64_t timestamp = 1000; timestamp <= 3000; timestamp += 1000) {
+    pipeline_->processImage(0, getImageFromCamera(0), timestamp);
+    pipeline_->waitForAllWorkToComplete();
+  }
+  EXPECT_GT(statistics::Statistics::GetNumSamples(kTag), num_samples);
+  EXPECT_LE(statistics::Statistics::GetNumSamples(kTag), num_samples + 3u);
+
+  // Not before the period elapsed.
+  const size_t num_periodic_samples = statistics::Statistics::GetNumSamples(kTag);
+  pipeline_->setMemoryUsageReportingPeriod(int64_t(3600) * 1000000000);
+  pipeline_->processImage(0, getImageFromCamera(0), 4000);
+  pipeline_->waitForAllWorkToComplete();
+  EXPECT_EQ(num_periodic_samples, statistics::Statistics::GetNumSamples(kTag));
+}
+
+TEST_F(VisualNPipelineTest, testRealTimeOptionsPreallocateFrames) {
+  this->constructNCamera(2, 4, 100, [](const Camera::Ptr& camera) {
+    KeypointVisualPipeline* pipeline = new KeypointVisualPipeline(camera);
+    pipeline->setNumKeypoints(20u, false);
+    return VisualPipeline::Ptr(pipeline);
+  });
+  VisualNPipeline::RealTimeOptions options;
+  options.num_preallocated_nframes = 2u;
+  options.max_num_keypoints_per_frame = 50u;
+  options.descriptor_size_bytes = 48u;
+  pipeline_->setRealTimeOptions(options);
+
+  pipeline_->processImage(0, getImageFromCamera(0), 0);
+  pipeline_->processImage(1, getImageFromCamera(1), 1);
+  pipeline_->waitForAllWorkToComplete();
+  std::shared_ptr<VisualNFrame> nframes = pipeline_->getNext();
+  ASSERT_TRUE(nframes.get() != NULL);
+  // The frames come from the budget, the reserved memory doesn't show as keypoints.
+  for (size_t frame_idx = 0u; frame_idx < 2u; ++frame_idx) {
+    const VisualFrame& frame = nframes->getFrame(frame_idx);
+    EXPECT_TRUE(frame.hasRawImage());
+    EXPECT_EQ(20u, frame.getNumKeypointMeasurements());
+    EXPECT_EQ(48, frame.getDescriptors().rows());
+    EXPECT_EQ(20, frame.getDescriptors().cols());
+    EXPECT_FALSE(frame.hasKeypointScores());
+    EXPECT_FALSE(frame.hasTrackIds());
+  }
+}
+
+TEST_F(VisualNPipelineTest, testRealTimeOptionsCheckSteadyStateAllocations) {
+  ASSERT_TRUE(common::areAllocationHooksInstalled());
+  const bool abort_on_steady_state_allocation = FLAGS_acv_abort_on_steady_state_allocation;
+  FLAGS_acv_abort_on_steady_state_allocation = false;
+  this->constructNCamera(2, 4, 100, [](const Camera::Ptr& camera) {
+    KeypointVisualPipeline* pipeline = new KeypointVisualPipeline(camera);
+    pipeline->setNumKeypoints(20u, false);
+    return VisualPipeline::Ptr(pipeline);
+  });
+  VisualNPipeline::RealTimeOptions options;
+  options.num_preallocated_nframes = 2u;
+  options.max_num_keypoints_per_frame = 50u;
+  options.descriptor_size_bytes = 48u;
+
+  // The pipelines allocate their keypoint matrices, which is only counted while checked.
+  for (const bool check_steady_state_allocations : {false, true}) {
+    options.check_steady_state_allocations = check_steady_state_allocations;
+    pipeline_->setRealTimeOptions(options);
+    common::resetNumSteadyStateAllocations();
+    pipeline_->processImage(0, getImageFromCamera(0), 0);
+    pipeline_->processImage(1, getImageFromCamera(1), 1);
+    pipeline_->waitForAllWorkToComplete();
+    ASSERT_TRUE(pipeline_->getNext().get() != NULL);
+    if (check_steady_state_allocations) {
+      EXPECT_GT(common::getNumSteadyStateAllocations(), 0u);
+    } else {
+      EXPECT_EQ(0u, common::getNumSteadyStateAllocations());
+    }
+  }
+  FLAGS_acv_abort_on_steady_state_allocation = abort_on_steady_state_allocation;
+}
+
+TEST_F(VisualNPipelineTest, testNumaPlacementPreallocatesOnTheCameraWorkers) {
+  EXPECT_EQ((std::vector<size_t>{0u, 0u, 1u, 1u}),
+            VisualNPipeline::distributeCamerasOverNumaNodes(4u, 2u));
+  EXPECT_EQ((std::vector<size_t>{0u, 0u, 0u}),
+            VisualNPipeline::distributeCamerasOverNumaNodes(3u, 1u));
+
+  this->constructNCamera(2, 4, 100, [](const Camera::Ptr& camera) {
+    KeypointVisualPipeline* pipeline = new KeypointVisualPipeline(camera);
+    pipeline->setNumKeypoints(20u, false);
+    return VisualPipeline::Ptr(pipeline);
+  });
+  pipeline_->setSchedulingMode(VisualNPipeline::SchedulingMode::kPerCameraWorker, {});
+  // The test machine may have a single node only.
+  pipeline_->setNumaPlacement(VisualNPipeline::distributeCamerasOverNumaNodes(2u, 1u));
+  VisualNPipeline::RealTimeOptions options;
+  options.num_preallocated_nframes = 2u;
+  options.max_num_keypoints_per_frame = 50u;
+  pipeline_->setRealTimeOptions(options);
+
+  pipeline_->processImage(0, getImageFromCamera(0), 0);
+  pipeline_->processImage(1, getImageFromCamera(1), 1);
+  pipeline_->waitForAllWorkToComplete();
+  std::shared_ptr<VisualNFrame> nframes = pipeline_->getNext();
+  ASSERT_TRUE(nframes.get() != NULL);
+  for (size_t frame_idx = 0u; frame_idx < 2u; ++frame_idx) {
+    EXPECT_EQ(20u, nframes->getFrame(frame_idx).getNumKeypointMeasurements());
+  }
+}
+
+TEST_F(VisualNPipelineTest, testNumaPlacementPinsTheWorkers) {
+  this->constructNCamera(2, 4, 100);
+  const std::vector<size_t> unpinned_cpu_ids = pipeline_->getWorkerCpuIds(0u);
+  // The workers can only run on the CPUs of the node that the process may use.
+  const std::vector<size_t> node_cpu_ids = common::getNumaNodeCpuIds(0u);
+  std::vector<size_t> pinned_cpu_ids;
+  std::set_intersection(node_cpu_ids.begin(), node_cpu_ids.end(), unpinned_cpu_ids.begin(),
+                        unpinned_cpu_ids.end(), std::back_inserter(pinned_cpu_ids));
+  if (pinned_cpu_ids.empty()) {
+    LOG(WARNING) << "The CPUs of the NUMA node 0 are not available, skipping the test.";
+    return;
+  }
+
+  EXPECT_TRUE(pipeline_->setNumaPlacement({0u, 0u}));
+  EXPECT_EQ(pinned_cpu_ids, pipeline_->getWorkerCpuIds(0u));
+  EXPECT_EQ(pinned_cpu_ids, pipeline_->getWorkerCpuIds(1u));
+  // Switching the mode unpins the shared pool.
+  EXPECT_TRUE(pipeline_->setSchedulingMode(VisualNPipeline::SchedulingMode::kSharedPool, {}));
+  EXPECT_EQ(unpinned_cpu_ids, pipeline_->getWorkerCpuIds(0u));
+
+  EXPECT_TRUE(
+      pipeline_->setSchedulingMode(VisualNPipeline::SchedulingMode::kPerCameraWorker, {}));
+  EXPECT_EQ(unpinned_cpu_ids, pipeline_->getWorkerCpuIds(1u));
+  EXPECT_TRUE(pipeline_->setNumaPlacement({0u, 0u}));
+  EXPECT_EQ(pinned_cpu_ids, pipeline_->getWorkerCpuIds(0u));
+  EXPECT_EQ(pinned_cpu_ids, pipeline_->getWorkerCpuIds(1u));
+  // The shared pool was not pinned with the per-camera workers.
+  EXPECT_TRUE(pipeline_->setSchedulingMode(VisualNPipeline::SchedulingMode::kSharedPool, {}));
+  EXPECT_EQ(unpinned_cpu_ids, pipeline_->getWorkerCpuIds(0u));
+}
+
+TEST_F(VisualNPipelineTest, testLockFreeOutputModes) {
+  this->constructNCamera(2, 4, 100);
+
+  // The lock-free queue keeps the order and drops new nframes while it is full.
+  pipeline_->setOutputMode(VisualNPipeline::OutputMode::kLockFreeQueue, 2u);
+  for (int64_t timestamp = 0; timestamp < 3000; timestamp += 1000) {
+    pipeline_->processImage(0, getImageFromCamera(0), timestamp);
+    pipeline_->processImage(1, getImageFromCamera(1), timestamp + 1);
+    pipeline_->waitForAllWorkToComplete();
+  }
+  ASSERT_EQ(2u, pipeline_->getNumFramesComplete());
+  EXPECT_EQ(1u, pipeline_->getFrameDropCounters(0).num_dropped_output_queue_full);
+  std::shared_ptr<VisualNFrame> nframes = pipeline_->getNext();
+  ASSERT_TRUE(nframes.get() != NULL);
+  EXPECT_EQ(0, nframes->getFrame(0).getTimestampNanoseconds());
+  nframes = pipeline_->getLatestAndClear();
+  ASSERT_TRUE(nframes.get() != NULL);
+  EXPECT_EQ(1000, nframes->getFrame(0).getTimestampNanoseconds());
+  EXPECT_FALSE(pipeline_->getNext());
+
+  // The latest slot only keeps the newest nframe.
+  pipeline_->setOutputMode(VisualNPipeline::OutputMode::kLockFreeLatest, 0u);
+  for (int64_t timestamp = 3000; timestamp < 5000; timestamp += 1000) {
+    pipeline_->processImage(0, getImageFromCamera(0), timestamp);
+    pipeline_->processImage(1, getImageFromCamera(1), timestamp + 1);
+    pipeline_->waitForAllWorkToComplete();
+  }
+  ASSERT_EQ(1u, pipeline_->getNumFramesComplete());
+  EXPECT_EQ(2u, pipeline_->getFrameDropCounters(1).num_dropped_output_queue_full);
+  nframes = pipeline_->getNext();
+  ASSERT_TRUE(nframes.get() != NULL);
+  EXPECT_EQ(4000, nframes->getFrame(0).getTimestampNanoseconds());
+  EXPECT_EQ(4001, nframes->getFrame(1).getTimestampNanoseconds());
+  EXPECT_EQ(0u, pipeline_->getNumFramesComplete());
+  EXPECT_FALSE(pipeline_->getLatestAndClear());
+}
+
+TEST_F(VisualNPipelineTest, testBatchedProcessingInSchedulingModes) {
+  this->constructNCamera(2, 4, 100);
+  const std::vector<cv::Mat> images = {getImageFromCamera(0), getImageFromCamera(1)};
+
+  pipeline_->processImages(images, {0, 1});
+  pipeline_->waitForAllWorkToComplete();
+  ASSERT_EQ(1u, pipeline_->getNumFramesComplete());
+
+  // Pin the camera workers to the first two CPUs this process may run on.
+  std::vector<std::vector<size_t>> camera_cpu_ids = {{}, {}};
+#ifdef __linux__
+  cpu_set_t allowed_cpus;
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(cpu_set_t), &allowed_cpus));
+  std::vector<size_t> allowed_cpu_ids;
+  for (size_t cpu_id = 0u; cpu_id < static_cast<size_t>(CPU_SETSIZE); ++cpu_id) {
+    if (CPU_ISSET(cpu_id, &allowed_cpus)) {
+      allowed_cpu_ids.push_back(cpu_id);
+    }
+  }
+  ASSERT_FALSE(allowed_cpu_ids.empty());
+  camera_cpu_ids = {{allowed_cpu_ids.front()}, {allowed_cpu_ids.back()}};
+#endif
+  EXPECT_TRUE(pipeline_->setSchedulingMode(
+      VisualNPipeline::SchedulingMode::kPerCameraWorker, camera_cpu_ids));
+  pipeline_->processImages(images, {1000, 1001});
+  pipeline_->processImage(0, getImageFromCamera(0), 2000);
+  pipeline_->processImage(1, getImageFromCamera(1), 2001);
+  pipeline_->waitForAllWorkToComplete();
+  ASSERT_EQ(3u, pipeline_->getNumFramesComplete());
+  ASSERT_EQ(0u, pipeline_->getNumInFlight());
+
+  for (int64_t timestamp = 0; timestamp <= 2000; timestamp += 1000) {
+    std::shared_ptr<VisualNFrame> nframes = pipeline_->getNext();
+    ASSERT_TRUE(nframes.get() != NULL);
+    EXPECT_EQ(timestamp, nframes->getFrame(0).getTimestampNanoseconds());
+    EXPECT_EQ(timestamp + 1, nframes->getFrame(1).getTimestampNanoseconds());
+  }
+}
+
+TEST_F(VisualNPipelineTest, testBatchedProcessingWithBlockingProducer) {
+  // The batches have more images than the in-flight limit.
+  this->constructNCamera(3, 4, 100);
+  pipeline_->setMaxNumInFlight(2u, VisualNPipeline::InFlightPolicy::kBlockProducer);
+  const std::vector<cv::Mat> images = {
+      getImageFromCamera(0), getImageFromCamera(1), getImageFromCamera(2)};
+  const size_t kNumBatches = 5u;
+  for (size_t batch_idx = 0u; batch_idx < kNumBatches; ++batch_idx) {
+    const int64_t timestamp = static_cast<int64_t>(batch_idx) * 1000;
+    pipeline_->processImages(images, {timestamp, timestamp + 1, timestamp + 2});
+  }
+  pipeline_->waitForAllWorkToComplete();
+  ASSERT_EQ(kNumBatches, pipeline_->getNumFramesComplete());
+  for (size_t camera_idx = 0u; camera_idx < 3u; ++camera_idx) {
+    EXPECT_EQ(0u,
+              pipeline_->getFrameDropCounters(camera_idx).num_dropped_oldest_incomplete_nframe);
+  }
+  for (size_t batch_idx = 0u; batch_idx < kNumBatches; ++batch_idx) {
+    std::shared_ptr<VisualNFrame> nframes = pipeline_->getNext();
+    ASSERT_TRUE(nframes.get() != NULL);
+    ASSERT_TRUE(nframes->areAllFramesSet());
+    EXPECT_EQ(static_cast<int64_t>(batch_idx) * 1000,
+              nframes->getFrame(0).getTimestampNanoseconds());
+  }
+}
+
+TEST_F(VisualNPipelineTest, testPreallocatedNFrames) {
+  this->constructNCamera(3, 4, 100);
+  pipeline_->setPreallocateNFrames(true);
+
+  // The nframe is preallocated by the first image, hence the number of in-flight items counts it
+  // right away.
+  pipeline_->processImage(2, getImageFromCamera(2), 1002);
+  pipeline_->processImage(0, getImageFromCamera(0), 1000);
+  pipeline_->waitForAllWorkToComplete();
+  EXPECT_EQ(1u, pipeline_->getNumFramesProcessing());
+  EXPECT_EQ(0u, pipeline_->getNumFramesComplete());
+
+  // A second image of a camera within the tolerance is dropped.
+  pipeline_->processImage(0, getImageFromCamera(0), 1010);
+  EXPECT_EQ(1u, pipeline_->getFrameDropCounters(0).num_dropped_newest_image);
+  pipeline_->processImage(1, getImageFromCamera(1), 1001);
+  pipeline_->waitForAllWorkToComplete();
+  ASSERT_EQ(1u, pipeline_->getNumFramesComplete());
+  EXPECT_EQ(0u, pipeline_->getNumInFlight());
+
+  pipeline_->processImages(
+      {getImageFromCamera(0), getImageFromCamera(1), getImageFromCamera(2)}, {2000, 2001, 2002});
+  pipeline_->waitForAllWorkToComplete();
+  ASSERT_EQ(2u, pipeline_->getNumFramesComplete());
+
+  for (int64_t timestamp = 1000; timestamp <= 2000; timestamp += 1000) {
+    std::shared_ptr<VisualNFrame> nframes = pipeline_->getNext();
+    ASSERT_TRUE(nframes.get() != NULL);
+    ASSERT_TRUE(nframes->areAllFramesSet());
+    for (size_t camera_idx = 0u; camera_idx < 3u; ++camera_idx) {
+      EXPECT_EQ(timestamp + static_cast<int64_t>(camera_idx),
+                nframes->getFrame(camera_idx).getTimestampNanoseconds());
+      EXPECT_TRUE(nframes->getFrame(camera_idx).hasRawImage());
+    }
+  }
+}
+
+TEST_F(VisualNPipelineTest, testProcessBatchInSourceOrder) {
+  this->constructNCamera(3, 4, 100);
+  const size_t kNumNFrames = 50u;
+  const size_t kMaxNumLookaheadNFrames = 3u;
+  // Written by the reader thread, preallocated such that the callback can read concurrently.
+  std::vector<std::vector<cv::Mat>> source_images(kNumNFrames);
+  std::atomic<size_t> num_nframes_read(0u);
+  const VisualNPipeline::BatchImageSource source =
+      [&](VisualNPipeline::BatchImages* batch_images) {
+    if (num_nframes_read == kNumNFrames) {
+      return false;
+    }
+    for (size_t camera_idx = 0u; camera_idx < 3u; ++camera_idx) {
+      cv::Mat image = getImageFromCamera(camera_idx);
+      cv::randu(image, cv::Scalar(0), cv::Scalar(255));
+      batch_images->images.push_back(image);
+      batch_images->timestamps.push_back(
+          1000 * static_cast<int64_t>(num_nframes_read.load()) + camera_idx);
+    }
+    source_images[num_nframes_read] = batch_images->images;
+    ++num_nframes_read;
+    return true;
+  };
+
+  size_t num_nframes_received = 0u;
+  const VisualNPipeline::NFrameCallback callback =
+      [&](const std::shared_ptr<VisualNFrame>& nframe) {
+    ASSERT_TRUE(nframe);
+    ASSERT_TRUE(nframe->areAllFramesSet());
+    EXPECT_LE(num_nframes_read - num_nframes_received, kMaxNumLookaheadNFrames);
+    for (size_t camera_idx = 0u; camera_idx < 3u; ++camera_idx) {
+      const VisualFrame& frame = nframe->getFrame(camera_idx);
+      EXPECT_EQ(1000 * static_cast<int64_t>(num_nframes_received) + camera_idx,
+                frame.getTimestampNanoseconds());
+      EXPECT_EQ(0.0, cv::norm(frame.getRawImage(),
+                              source_images[num_nframes_received][camera_idx], cv::NORM_INF));
+    }
+    ++num_nframes_received;
+  };
+  EXPECT_EQ(kNumNFrames, pipeline_->processBatch(source, callback, kMaxNumLookaheadNFrames));
+  EXPECT_EQ(kNumNFrames, num_nframes_received);
+  EXPECT_EQ(0u, pipeline_->getNumFramesComplete());
+  EXPECT_EQ(0u, pipeline_->getNumInFlight());
+}
+
+TEST_F(VisualNPipelineTest, testIntraRigMatchingInAllCompletionPaths) {
+  // Points in front of the test rig, whose cameras have a baseline.
+  camera_rig_ = NCamera::createTestNCamera(3);
+  const int kNumPoints = 200;
+  std::mt19937 random_engine(17);
+  std::uniform_real_distribution<double> unit_distribution(-1.0, 1.0);
+  std::uniform_real_distribution<double> depth_distribution(2.0, 20.0);
+  std::uniform_int_distribution<int> byte_distribution(0, 255);
+  Eigen::Matrix3Xd B_points(3, kNumPoints);
+  VisualFrame::DescriptorsT point_descriptors(48, kNumPoints);
+  for (int point_idx = 0; point_idx < kNumPoints; ++point_idx) {
+    const Eigen::Vector3d C0_point = depth_distribution(random_engine) * Eigen::Vector3d(
+        0.5 * unit_distribution(random_engine), 0.4 * unit_distribution(random_engine), 1.0);
+    B_points.col(point_idx) = camera_rig_->get_T_C_B(0u).inverse() * C0_point;
+    for (int byte_idx = 0; byte_idx < point_descriptors.rows(); ++byte_idx) {
+      point_descriptors(byte_idx, point_idx) =
+          static_cast<unsigned char>(byte_distribution(random_engine));
+    }
+  }
+  std::vector<std::shared_ptr<ProjectingVisualPipeline>> projecting_pipelines;
+  std::vector<VisualPipeline::Ptr> pipelines;
+  for (size_t camera_idx = 0u; camera_idx < 3u; ++camera_idx) {
+    projecting_pipelines.emplace_back(new ProjectingVisualPipeline(
+        camera_rig_->getCameraShared(camera_idx), camera_rig_->get_T_C_B(camera_idx), B_points,
+        point_descriptors, static_cast<unsigned>(camera_idx)));
+    pipelines.push_back(projecting_pipelines.back());
+  }
+  pipeline_.reset(new VisualNPipeline(4, pipelines, camera_rig_, camera_rig_, 100));
+  VisualNPipeline::IntraRigMatchingOptions options;
+  options.camera_pairs = {{0u, 1u}, {1u, 2u}};
+  pipeline_->setIntraRigMatching(options);
+  pipeline_->setFramePoolSize(2u);
+
+  // Every match is a pair of keypoints of the same point, and most of the points visible in
+  // both cameras of a pair are matched.
+  const auto expect_correct_matches = [&projecting_pipelines](const VisualNFrame& nframe) {
+    ASSERT_TRUE(nframe.hasIntraRigMatches());
+    const Eigen::Matrix4Xi& matches = nframe.getIntraRigMatches();
+    std::vector<size_t> num_pair_matches(2u, 0u);
+    for (int match_idx = 0; match_idx < matches.cols(); ++match_idx) {
+      const size_t apple_camera_idx = static_cast<size_t>(matches(0, match_idx));
+      const size_t banana_camera_idx = static_cast<size_t>(matches(2, match_idx));
+      ASSERT_LT(apple_camera_idx, 2u);
+      ASSERT_EQ(apple_camera_idx + 1u, banana_camera_idx);
+      EXPECT_EQ(projecting_pipelines[apple_camera_idx]->getPointIndex(matches(1, match_idx)),
+                projecting_pipelines[banana_camera_idx]->getPointIndex(matches(3, match_idx)));
+      ++num_pair_matches[apple_camera_idx];
+    }
+    for (size_t pair_idx = 0u; pair_idx < 2u; ++pair_idx) {
+      const size_t num_common_points = projecting_pipelines[pair_idx]->getNumCommonPoints(
+          *projecting_pipelines[pair_idx + 1u]);
+      ASSERT_GT(num_common_points, 50u);
+      EXPECT_GE(num_pair_matches[pair_idx], num_common_points * 9u / 10u);
+    }
+  };
+
+  for (const bool preallocate : {false, true}) {
+    pipeline_->setPreallocateNFrames(preallocate);
+    const int64_t timestamp = preallocate ? 2000 : 1000;
+    pipeline_->processImage(1, getImageFromCamera(1), timestamp);
+    pipeline_->waitForAllWorkToComplete();
+    // A second image of a camera within the tolerance is dropped, its pairs are matched with
+    // the first one.
+    pipeline_->processImage(1, getImageFromCamera(1), timestamp + 5);
+    pipeline_->processImage(0, getImageFromCamera(0), timestamp + 1);
+    pipeline_->waitForAllWorkToComplete();
+    EXPECT_EQ(0u, pipeline_->getNumFramesComplete());
+    EXPECT_EQ(preallocate ? 2u : 1u, pipeline_->getFrameDropCounters(1).num_dropped_newest_image);
+    pipeline_->processImage(2, getImageFromCamera(2), timestamp + 2);
+    pipeline_->waitForAllWorkToComplete();
+    std::shared_ptr<VisualNFrame> nframe = pipeline_->getNext();
+    ASSERT_TRUE(nframe);
+    EXPECT_EQ(timestamp, nframe->getFrame(1).getTimestampNanoseconds());
+    expect_correct_matches(*nframe);
+  }
+
+  pipeline_->setPreallocateNFrames(false);
+  size_t num_nframes_read = 0u;
+  const VisualNPipeline::BatchImageSource source =
+      [&](VisualNPipeline::BatchImages* batch_images) {
+    if (num_nframes_read == 5u) {
+      return false;
+    }
+    for (size_t camera_idx = 0u; camera_idx < 3u; ++camera_idx) {
+      batch_images->images.push_back(getImageFromCamera(camera_idx));
+      batch_images->timestamps.push_back(
+          3000 + 1000 * static_cast<int64_t>(num_nframes_read) + camera_idx);
+    }
+    ++num_nframes_read;
+    return true;
+  };
+  const VisualNPipeline::NFrameCallback callback =
+      [&expect_correct_matches](const std::shared_ptr<VisualNFrame>& nframe) {
+    expect_correct_matches(*nframe);
+  };
+  EXPECT_EQ(5u, pipeline_->processBatch(source, callback, 2u));
+
+  // The recycled nframes don't keep the matches of their previous frames.
+  pipeline_->setIntraRigMatching(VisualNPipeline::IntraRigMatchingOptions());
+  pipeline_->processImages(
+      {getImageFromCamera(0), getImageFromCamera(1), getImageFromCamera(2)}, {9000, 9001, 9002});
+  pipeline_->waitForAllWorkToComplete();
+  std::shared_ptr<VisualNFrame> nframe = pipeline_->getNext();
+  ASSERT_TRUE(nframe);
+  EXPECT_FALSE(nframe->hasIntraRigMatches());
+}
+
+TEST_F(VisualNPipelineTest, testCompressedImagesAreDecodedOnTheWorkers) {
+  this->constructNCamera(2, 4, 100);
+  const auto encode = [](const cv::Mat& image) {
+    std::vector<uchar> data;
+    CHECK(cv::imencode(".png", image, data));
+    return cv::Mat(data, true).reshape(1, 1);
+  };
+
+  for (int64_t timestamp = 0; timestamp < 3000; timestamp += 1000) {
+    for (size_t camera_idx = 0u; camera_idx < 2u; ++camera_idx) {
+      pipeline_->processCompressedImage(
+          camera_idx, encode(getImageFromCamera(camera_idx)), timestamp);
+    }
+    pipeline_->waitForAllWorkToComplete();
+    std::shared_ptr<VisualNFrame> nframe = pipeline_->getNext();
+    ASSERT_TRUE(nframe);
+    for (size_t camera_idx = 0u; camera_idx < 2u; ++camera_idx) {
+      const cv::Mat& raw_image = nframe->getFrame(camera_idx).getRawImage();
+      ASSERT_EQ(CV_8UC1, raw_image.type());
+      EXPECT_EQ(0, cv::countNonZero(raw_image != getImageFromCamera(camera_idx)));
+    }
+  }
+
+  // Invalid data and images of the wrong size are dropped.
+  const cv::Mat small_image(10, 10, CV_8UC1, cv::Scalar(0));
+  pipeline_->processCompressedImage(0u, cv::Mat(1, 100, CV_8UC1, cv::Scalar(7)), 3000);
+  pipeline_->processCompressedImage(1u, encode(small_image), 3000);
+  pipeline_->waitForAllWorkToComplete();
+  EXPECT_EQ(1u, pipeline_->getFrameDropCounters(0u).num_dropped_decoding_failed);
+  EXPECT_EQ(1u, pipeline_->getFrameDropCounters(1u).num_dropped_decoding_failed);
+  EXPECT_EQ(0u, pipeline_->getNumFramesComplete());
+  EXPECT_EQ(0u, pipeline_->getNumInFlight());
+}
+
+TEST_F(VisualNPipelineTest, testFailedDecodingOfPreallocatedNFrames) {
+  this->constructNCamera(2, 4, 100);
+  pipeline_->setPreallocateNFrames(true);
+  const auto encode = [](const cv::Mat& image) {
+    std::vector<uchar> data;
+    CHECK(cv::imencode(".png", image, data));
+    return cv::Mat(data, true).reshape(1, 1);
+  };
+
+  // The slot of the failed image stays empty, the nframe never completes.
+  pipeline_->processCompressedImage(0u, encode(getImageFromCamera(0)), 1000);
+  pipeline_->processCompressedImage(1u, cv::Mat(1, 100, CV_8UC1, cv::Scalar(7)), 1001);
+  pipeline_->waitForAllWorkToComplete();
+  EXPECT_EQ(1u, pipeline_->getFrameDropCounters(1u).num_dropped_decoding_failed);
+  EXPECT_EQ(1u, pipeline_->getNumFramesProcessing());
+  EXPECT_EQ(0u, pipeline_->getNumFramesComplete());
+
+  // It is dropped once the next nframe completes.
+  for (size_t camera_idx = 0u; camera_idx < 2u; ++camera_idx) {
+    const int64_t timestamp = 2000 + static_cast<int64_t>(camera_idx);
+    pipeline_->processCompressedImage(
+        camera_idx, encode(getImageFromCamera(camera_idx)), timestamp);
+  }
+  pipeline_->waitForAllWorkToComplete();
+  EXPECT_EQ(1u, pipeline_->getFrameDropCounters(0u).num_dropped_unsynchronized);
+  EXPECT_EQ(0u, pipeline_->getFrameDropCounters(1u).num_dropped_unsynchronized);
+  EXPECT_EQ(0u, pipeline_->getNumFramesProcessing());
+  ASSERT_EQ(1u, pipeline_->getNumFramesComplete());
+  EXPECT_EQ(0u, pipeline_->getNumInFlight());
+  std::shared_ptr<VisualNFrame> nframe = pipeline_->getNext();
+  ASSERT_TRUE(nframe);
+  ASSERT_TRUE(nframe->areAllFramesSet());
+  for (size_t camera_idx = 0u; camera_idx < 2u; ++camera_idx) {
+    EXPECT_EQ(2000 + static_cast<int64_t>(camera_idx),
+              nframe->getFrame(camera_idx).getTimestampNanoseconds());
+    EXPECT_TRUE(nframe->getFrame(camera_idx).hasRawImage());
+  }
+}
+
+TEST_F(VisualNPipelineTest, testWorkerScalingFollowsTheLatency) {
+  this->constructNCamera(2, 4, 100);
+  ASSERT_EQ(4u, pipeline_->getNumActiveWorkers());
+
+  // Every image misses the target and ends a period, hence adds a worker.
+  WorkerScalingPolicy::Options options;
+  options.min_num_workers = 1u;
+  options.max_num_workers = 3u;
+  options.target_latency_nanoseconds = 1;
+  options.evaluation_period_nanoseconds = 1;
+  pipeline_->enableWorkerScaling(options);
+  EXPECT_EQ(1u, pipeline_->getNumActiveWorkers());
+  for (int64_t timestamp = 0; timestamp < 5000; timestamp += 1000) {
+    pipeline_->processImage(0, getImageFromCamera(0), timestamp);
+    pipeline_->processImage(1, getImageFromCamera(1), timestamp);
+    pipeline_->waitForAllWorkToComplete();
+  }
+  EXPECT_EQ(3u, pipeline_->getNumActiveWorkers());
+  EXPECT_EQ(5u, pipeline_->getNumFramesComplete());
+
+  pipeline_->disableWorkerScaling();
+  EXPECT_EQ(4u, pipeline_->getNumActiveWorkers());
+
+  // Every image is far below the target, hence the pool stays at the minimum.
+  options.target_latency_nanoseconds = 3600000000000;
+  pipeline_->enableWorkerScaling(options);
+  for (int64_t timestamp = 5000; timestamp < 10000; timestamp += 1000) {
+    pipeline_->processImage(0, getImageFromCamera(0), timestamp);
+    pipeline_->processImage(1, getImageFromCamera(1), timestamp);
+    pipeline_->waitForAllWorkToComplete();
+  }
+  EXPECT_EQ(1u, pipeline_->getNumActiveWorkers());
+  EXPECT_EQ(10u, pipeline_->getNumFramesComplete());
+}
+
+TEST_F(VisualNPipelineTest, testNFrameCallbacksAndFutures) {
+  this->constructNCamera(2, 4, 100);
+
+  // The futures are fulfilled before the callbacks are registered, by the queued nframe first.
+  pipeline_->processImage(0, getImageFromCamera(0), 0);
+  pipeline_->processImage(1, getImageFromCamera(1), 0);
+  pipeline_->waitForAllWorkToComplete();
+  std::future<std::shared_ptr<VisualNFrame>> queued_nframe = pipeline_->getNextAsync();
+  std::future<std::shared_ptr<VisualNFrame>> next_nframe = pipeline_->getNextAsync();
+  ASSERT_TRUE(queued_nframe.get());
+  EXPECT_EQ(0u, pipeline_->getNumFramesComplete());
+  pipeline_->processImage(0, getImageFromCamera(0), 1000);
+  pipeline_->processImage(1, getImageFromCamera(1), 1000);
+  const std::shared_ptr<VisualNFrame> nframe = next_nframe.get();
+  ASSERT_TRUE(nframe);
+  EXPECT_EQ(1000, nframe->getMinTimestampNanoseconds());
+  pipeline_->waitForAllWorkToComplete();
+  EXPECT_EQ(0u, pipeline_->getNumFramesComplete());
+
+  // Every callback receives all nframes in order, on a shared executor.
+  std::shared_ptr<ThreadPool> executor(new ThreadPool(2u));
+  std::vector<int64_t> timestamps[2];
+  std::vector<size_t> callback_ids;
+  for (std::vector<int64_t>& callback_timestamps : timestamps) {
+    callback_ids.push_back(pipeline_->addNFrameCallback(
+        [&callback_timestamps](const std::shared_ptr<VisualNFrame>& completed_nframe) {
+          callback_timestamps.push_back(completed_nframe->getMinTimestampNanoseconds());
+        }, executor));
+  }
+  std::vector<int64_t> expected_timestamps;
+  for (int64_t timestamp = 2000; timestamp < 7000; timestamp += 1000) {
+    pipeline_->processImage(0, getImageFromCamera(0), timestamp);
+    pipeline_->processImage(1, getImageFromCamera(1), timestamp);
+    expected_timestamps.push_back(timestamp);
+  }
+  pipeline_->waitForAllWorkToComplete();
+  executor->waitForEmptyQueue();
+  EXPECT_EQ(0u, pipeline_->getNumFramesComplete());
+  EXPECT_EQ(expected_timestamps, timestamps[0]);
+  EXPECT_EQ(expected_timestamps, timestamps[1]);
+
+  // Without callbacks the nframes are queued again.
+  for (const size_t callback_id : callback_ids) {
+    pipeline_->removeNFrameCallback(callback_id);
+  }
+  pipeline_->processImage(0, getImageFromCamera(0), 7000);
+  pipeline_->processImage(1, getImageFromCamera(1), 7000);
+  pipeline_->waitForAllWorkToComplete();
+  executor->waitForEmptyQueue();
+  EXPECT_EQ(1u, pipeline_->getNumFramesComplete());
+  EXPECT_EQ(5u, timestamps[0].size());
+
+  // Pending futures are released by the shutdown.
+  pipeline_->getNext();
+  std::future<std::shared_ptr<VisualNFrame>> pending_nframe = pipeline_->getNextAsync();
+  pipeline_->shutdown();
+  EXPECT_FALSE(pending_nframe.get());
+}
+
+TEST_F(VisualNPipelineTest, testFrameProcessingBudget) {
+  std::shared_ptr<DeadlineRecordingVisualPipeline> camera_pipeline;
+  this->constructNCamera(1, 1, 100, [&camera_pipeline](const Camera::Ptr& camera) {
+    camera_pipeline.reset(new DeadlineRecordingVisualPipeline(camera));
+    return camera_pipeline;
+  });
+
+  // Without a budget the frames have no deadline.
+  pipeline_->processImage(0, getImageFromCamera(0), 0);
+  pipeline_->waitForAllWorkToComplete();
+  EXPECT_FALSE(camera_pipeline->getDeadline(0).isBounded());
+
+  const int64_t kLongBudgetNanoseconds = time::seconds(10);
+  pipeline_->setFrameProcessingBudget(kLongBudgetNanoseconds);
+  const int64_t arrival_time_nanoseconds = common::Deadline::now();
+  pipeline_->processImage(0, getImageFromCamera(0), 1000);
+  pipeline_->waitForAllWorkToComplete();
+  const common::Deadline deadline = camera_pipeline->getDeadline(1000);
+  ASSERT_TRUE(deadline.isBounded());
+  EXPECT_EQ(kLongBudgetNanoseconds, deadline.getBudgetNanoseconds());
+  EXPECT_GE(deadline.getDeadlineTimeNanoseconds(),
+            arrival_time_nanoseconds + kLongBudgetNanoseconds);
+  EXPECT_LE(deadline.getDeadlineTimeNanoseconds(),
+            common::Deadline::now() + kLongBudgetNanoseconds);
+
+  // The second image waits for the admission until the first one is done. Its deadline starts
+  // when it is passed in, not when it is admitted.
+  const int64_t kShortBudgetNanoseconds = time::milliseconds(30);
+  const int kSleepMilliseconds = 100;
+  pipeline_->setFrameProcessingBudget(kShortBudgetNanoseconds);
+  pipeline_->setMaxNumInFlight(1u, VisualNPipeline::InFlightPolicy::kBlockProducer);
+  camera_pipeline->setSleepMilliseconds(kSleepMilliseconds);
+  pipeline_->processImage(0, getImageFromCamera(0), 2000);
+  const int64_t blocked_arrival_time_nanoseconds = common::Deadline::now();
+  pipeline_->processImage(0, getImageFromCamera(0), 3000);
+  const int64_t admission_time_nanoseconds = common::Deadline::now();
+  pipeline_->waitForAllWorkToComplete();
+  ASSERT_GE(admission_time_nanoseconds - blocked_arrival_time_nanoseconds,
+            time::milliseconds(kSleepMilliseconds / 2));
+  const common::Deadline blocked_deadline = camera_pipeline->getDeadline(3000);
+  EXPECT_LE(blocked_deadline.getDeadlineTimeNanoseconds(),
+            blocked_arrival_time_nanoseconds + kShortBudgetNanoseconds);
+
+  // The degradations of the expired frames are stored in the frames.
+  ASSERT_EQ(4u, pipeline_->getNumFramesComplete());
+  for (const int64_t timestamp : {0, 1000, 2000, 3000}) {
+    std::shared_ptr<VisualNFrame> nframe = pipeline_->getNext();
+    ASSERT_TRUE(nframe);
+    ASSERT_EQ(timestamp, nframe->getFrame(0).getTimestampNanoseconds());
+    EXPECT_EQ(timestamp >= 2000,
+              nframe->getFrame(0).getDegradations().has(common::Degradation::kCappedKeypoints))
+        << "Frame " << timestamp;
+  }
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cmath>
+
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/hamming.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/pipeline/visual-pipeline-fast-brief.h>
+
+namespace aslam {
+
+class FastBriefVisualPipelineTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    // A square image, such that the rotated image has the same camera.
+    const uint32_t kImageSize = 400u;
+    camera_.reset(new PinholeCamera(300.0, 300.0, 199.5, 199.5, kImageSize, kImageSize));
+    image_.create(kImageSize, kImageSize, CV_8UC1);
+    cv::randu(image_, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::GaussianBlur(image_, image_, cv::Size(5, 5), 2.0);
+  }
+
+  Camera::Ptr camera_;
+  cv::Mat image_;
+};
+
+TEST_F(FastBriefVisualPipelineTest, KeypointsAreSpreadAndDescribed) {
+  FastBriefVisualPipeline::Options options;
+  options.fast_threshold = 5;
+  options.max_num_keypoints = 100u;
+  options.grid_cell_size_pixels = 40.0;
+  FastBriefVisualPipeline pipeline(camera_, false, options);
+  VisualFrame::Ptr frame = pipeline.processImage(image_, 0);
+
+  const size_t num_keypoints = frame->getNumKeypointMeasurements();
+  ASSERT_GT(num_keypoints, 50u);
+  EXPECT_LE(num_keypoints, options.max_num_keypoints);
+  ASSERT_EQ(FastBriefVisualPipeline::kDescriptorSizeBytes, frame->getDescriptors().rows());
+  ASSERT_EQ(num_keypoints, static_cast<size_t>(frame->getDescriptors().cols()));
+  ASSERT_EQ(num_keypoints, static_cast<size_t>(frame->getKeypointOrientations().rows()));
+
+  // With 10 x 10 cells the budget allows one keypoint per cell.
+  cv::Mat cell_counts = cv::Mat::zeros(10, 10, CV_32SC1);
+  for (size_t i = 0u; i < num_keypoints; ++i) {
+    const Eigen::Vector2d keypoint = frame->getKeypointMeasurement(i);
+    EXPECT_GT(keypoint(0), 15.0);
+    EXPECT_GT(keypoint(1), 15.0);
+    EXPECT_LT(keypoint(0), image_.cols - 16.0);
+    EXPECT_LT(keypoint(1), image_.rows - 16.0);
+    EXPECT_GE(frame->getKeypointOrientation(i), 0.0);
+    EXPECT_LT(frame->getKeypointOrientation(i), 360.0);
+    ++cell_counts.at<int>(static_cast<int>(keypoint(1) / 40.0),
+                          static_cast<int>(keypoint(0) / 40.0));
+  }
+  double max_cell_count;
+  cv::minMaxLoc(cell_counts, nullptr, &max_cell_count);
+  EXPECT_EQ(1.0, max_cell_count);
+}
+
+TEST_F(FastBriefVisualPipelineTest, DescriptorsAreRotationInvariant) {
+  // Rotated by 90 degrees clockwise, the pixel (x, y) moves to (rows - 1 - y, x).
+  cv::Mat rotated_image;
+  cv::transpose(image_, rotated_image);
+  cv::flip(rotated_image, rotated_image, 1);
+
+  FastBriefVisualPipeline::Options options;
+  options.fast_threshold = 5;
+  options.max_num_keypoints = 0u;
+  FastBriefVisualPipeline pipeline(camera_, false, options);
+  VisualFrame::Ptr frame = pipeline.processImage(image_, 0);
+  VisualFrame::Ptr rotated_frame = pipeline.processImage(rotated_image, 1);
+  ASSERT_GT(frame->getNumKeypointMeasurements(), 100u);
+
+  size_t num_corresponding_keypoints = 0u;
+  size_t num_similar_descriptors = 0u;
+  for (size_t i = 0u; i < frame->getNumKeypointMeasurements(); ++i) {
+    const Eigen::Vector2d keypoint = frame->getKeypointMeasurement(i);
+    const Eigen::Vector2d rotated_keypoint(image_.rows - 1.0 - keypoint(1), keypoint(0));
+    for (size_t j = 0u; j < rotated_frame->getNumKeypointMeasurements(); ++j) {
+      if ((rotated_frame->getKeypointMeasurement(j) - rotated_keypoint).norm() > 0.5) {
+        continue;
+      }
+      ++num_corresponding_keypoints;
+      const double orientation_error = std::fmod(
+          rotated_frame->getKeypointOrientation(j) - frame->getKeypointOrientation(i) + 630.0,
+          360.0);
+      EXPECT_LT(std::min(orientation_error, 360.0 - orientation_error), 5.0);
+      const uint32_t distance = common::Hamming::evaluate(
+          frame->getDescriptors().col(i).data(), rotated_frame->getDescriptors().col(j).data(),
+          FastBriefVisualPipeline::kDescriptorSizeBytes);
+      if (distance <= 16u) {
+        ++num_similar_descriptors;
+      }
+      break;
+    }
+  }
+  // FAST and the orientation patch are symmetric under rotations by 90 degrees.
+  EXPECT_GT(num_corresponding_keypoints, frame->getNumKeypointMeasurements() * 8u / 10u);
+  EXPECT_GT(num_similar_descriptors, num_corresponding_keypoints * 9u / 10u);
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
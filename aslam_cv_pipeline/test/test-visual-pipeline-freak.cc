@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/pipeline/visual-pipeline-freak.h>
+
+namespace aslam {
+
+class FreakVisualPipelineTest : public ::testing::Test {
+ protected:
+  static constexpr size_t kNumOctaves = 3u;
+  static constexpr int kHessianThreshold = 100;
+  static constexpr int kNumOctaveLayers = 3;
+
+  virtual void SetUp() {
+    camera_ = PinholeCamera::createTestCamera();
+    image_.create(camera_->imageHeight(), camera_->imageWidth(), CV_8UC1);
+    cv::randu(image_, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::GaussianBlur(image_, image_, cv::Size(9, 9), 3.0);
+  }
+
+  FreakVisualPipeline::Ptr createPipeline() const {
+    return FreakVisualPipeline::Ptr(new FreakVisualPipeline(
+        camera_, false, kNumOctaves, kHessianThreshold, kNumOctaveLayers, true, true, 22.0f));
+  }
+
+  /// The keypoint indices ordered by position, as the SURF octaves are detected in parallel
+  /// and the tiles are concatenated.
+  static std::vector<size_t> getIndicesSortedByPosition(const VisualFrame& frame) {
+    std::vector<size_t> indices(frame.getNumKeypointMeasurements());
+    std::iota(indices.begin(), indices.end(), 0u);
+    std::sort(indices.begin(), indices.end(), [&frame](size_t lhs, size_t rhs) {
+      const Eigen::Vector2d keypoint_lhs = frame.getKeypointMeasurement(lhs);
+      const Eigen::Vector2d keypoint_rhs = frame.getKeypointMeasurement(rhs);
+      if (keypoint_lhs(1) != keypoint_rhs(1)) {
+        return keypoint_lhs(1) < keypoint_rhs(1);
+      }
+      if (keypoint_lhs(0) != keypoint_rhs(0)) {
+        return keypoint_lhs(0) < keypoint_rhs(0);
+      }
+      return frame.getKeypointScale(lhs) < frame.getKeypointScale(rhs);
+    });
+    return indices;
+  }
+
+  static void expectFramesEqual(const VisualFrame& expected_frame, const VisualFrame& frame) {
+    ASSERT_EQ(expected_frame.getNumKeypointMeasurements(), frame.getNumKeypointMeasurements());
+    ASSERT_EQ(expected_frame.getDescriptors().rows(), frame.getDescriptors().rows());
+    const std::vector<size_t> expected_indices = getIndicesSortedByPosition(expected_frame);
+    const std::vector<size_t> indices = getIndicesSortedByPosition(frame);
+    for (size_t i = 0u; i < indices.size(); ++i) {
+      const size_t expected_index = expected_indices[i];
+      const size_t index = indices[i];
+      EXPECT_EQ(expected_frame.getKeypointMeasurement(expected_index),
+                frame.getKeypointMeasurement(index));
+      EXPECT_EQ(expected_frame.getKeypointScale(expected_index), frame.getKeypointScale(index));
+      EXPECT_EQ(expected_frame.getKeypointScore(expected_index), frame.getKeypointScore(index));
+      EXPECT_EQ(expected_frame.getKeypointOrientation(expected_index),
+                frame.getKeypointOrientation(index));
+      EXPECT_TRUE(expected_frame.getDescriptors().col(expected_index) ==
+                  frame.getDescriptors().col(index)) << "Keypoint " << index;
+    }
+  }
+
+  Camera::Ptr camera_;
+  cv::Mat image_;
+};
+
+TEST_F(FreakVisualPipelineTest, TiledOutputEqualsUntiled) {
+  FreakVisualPipeline::Ptr serial_pipeline = createPipeline();
+  VisualFrame::Ptr serial_frame = serial_pipeline->processImage(image_, 0);
+  ASSERT_GT(serial_frame->getNumKeypointMeasurements(), 100u);
+
+  // Including a tile count that doesn't divide the image rows.
+  for (const size_t num_threads : {2u, 3u, 4u, 7u}) {
+    FreakVisualPipeline::Ptr tiled_pipeline = createPipeline();
+    tiled_pipeline->setNumInternalThreads(num_threads);
+    // The second frame reuses the buffers of the tasks.
+    for (int64_t timestamp = 0; timestamp < 2; ++timestamp) {
+      VisualFrame::Ptr tiled_frame = tiled_pipeline->processImage(image_, timestamp);
+      SCOPED_TRACE(::testing::Message() << num_threads << " threads, frame " << timestamp);
+      expectFramesEqual(*serial_frame, *tiled_frame);
+    }
+  }
+}
+
+TEST_F(FreakVisualPipelineTest, TiledOutputEqualsUntiledWithDetectionMask) {
+  // Masks the left half and a band of rows that crosses the tile borders.
+  cv::Mat mask(image_.rows, image_.cols, CV_8UC1, cv::Scalar(255));
+  mask(cv::Range::all(), cv::Range(0, image_.cols / 2)).setTo(0);
+  mask(cv::Range(image_.rows / 2 - 20, image_.rows / 2 + 20), cv::Range::all()).setTo(0);
+
+  FreakVisualPipeline::Ptr serial_pipeline = createPipeline();
+  serial_pipeline->setDetectionMask(mask);
+  VisualFrame::Ptr serial_frame = serial_pipeline->processImage(image_, 0);
+  ASSERT_GT(serial_frame->getNumKeypointMeasurements(), 20u);
+
+  FreakVisualPipeline::Ptr tiled_pipeline = createPipeline();
+  tiled_pipeline->setDetectionMask(mask);
+  tiled_pipeline->setNumInternalThreads(4u);
+  VisualFrame::Ptr tiled_frame = tiled_pipeline->processImage(image_, 0);
+  expectFramesEqual(*serial_frame, *tiled_frame);
+  for (size_t i = 0u; i < tiled_frame->getNumKeypointMeasurements(); ++i) {
+    EXPECT_GE(tiled_frame->getKeypointMeasurement(i)(0), image_.cols / 2 - 1.0);
+  }
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
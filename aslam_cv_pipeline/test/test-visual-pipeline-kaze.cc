@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/detectors/kaze-instance-pool.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/pipeline/visual-pipeline-kaze.h>
+
+namespace aslam {
+
+class KazeVisualPipelineTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    const uint32_t kImageWidth = 320u;
+    const uint32_t kImageHeight = 240u;
+    camera_.reset(new PinholeCamera(300.0, 300.0, 159.5, 119.5, kImageWidth, kImageHeight));
+    image_.create(kImageHeight, kImageWidth, CV_8UC1);
+    cv::randu(image_, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::GaussianBlur(image_, image_, cv::Size(9, 9), 3.0);
+  }
+
+  static void expectFramesEqual(const VisualFrame& expected_frame, const VisualFrame& frame) {
+    EXPECT_EQ(expected_frame.getKeypointMeasurements(), frame.getKeypointMeasurements());
+    EXPECT_EQ(expected_frame.getKeypointScales(), frame.getKeypointScales());
+    EXPECT_EQ(expected_frame.getKeypointOrientations(), frame.getKeypointOrientations());
+    EXPECT_EQ(expected_frame.getFloatDescriptors(), frame.getFloatDescriptors());
+  }
+
+  Camera::Ptr camera_;
+  cv::Mat image_;
+};
+
+TEST_F(KazeVisualPipelineTest, DescriptorsAreFloatVectors) {
+  KAZEOptions options;
+  options.descriptor = MSURF;
+  KazeVisualPipeline pipeline(camera_, false, options);
+  VisualFrame::Ptr frame = pipeline.processImage(image_, 0);
+
+  const size_t num_keypoints = frame->getNumKeypointMeasurements();
+  ASSERT_GT(num_keypoints, 10u);
+  EXPECT_FALSE(frame->hasDescriptors());
+  ASSERT_TRUE(frame->hasFloatDescriptors());
+  const VisualFrame::FloatDescriptorsT& descriptors = frame->getFloatDescriptors();
+  EXPECT_EQ(64, descriptors.rows());
+  ASSERT_EQ(num_keypoints, static_cast<size_t>(descriptors.cols()));
+  // The M-SURF descriptors have unit length.
+  for (size_t i = 0u; i < num_keypoints; ++i) {
+    EXPECT_NEAR(1.0f, descriptors.col(i).norm(), 1e-4f) << "Keypoint " << i;
+  }
+
+  // Compacting the keypoints keeps the descriptors of the kept keypoints.
+  std::vector<bool> keep_mask(num_keypoints, false);
+  for (size_t i = 0u; i < num_keypoints; i += 2u) {
+    keep_mask[i] = true;
+  }
+  const VisualFrame::FloatDescriptorsT original_descriptors = descriptors;
+  frame->compactKeypointChannels(keep_mask);
+  ASSERT_EQ((num_keypoints + 1u) / 2u, static_cast<size_t>(frame->getFloatDescriptors().cols()));
+  for (size_t i = 0u; i < num_keypoints; i += 2u) {
+    EXPECT_EQ(original_descriptors.col(i), frame->getFloatDescriptors().col(i / 2u));
+  }
+}
+
+TEST_F(KazeVisualPipelineTest, ReusedInstancesGiveTheSameFrames) {
+  KazeVisualPipeline pipeline(camera_, false, KAZEOptions());
+  VisualFrame::Ptr first_frame = pipeline.processImage(image_, 0);
+  ASSERT_GT(first_frame->getNumKeypointMeasurements(), 10u);
+  EXPECT_EQ(1u, pipeline.getNumPooledKazeInstances());
+
+  // The reused scale space of the first frame.
+  VisualFrame::Ptr frame = pipeline.processImage(image_, 1);
+  EXPECT_EQ(1u, pipeline.getNumPooledKazeInstances());
+  expectFramesEqual(*first_frame, *frame);
+
+  // Concurrently processed frames use instances of their own.
+  const size_t kNumThreads = 4u;
+  std::vector<VisualFrame::Ptr> frames(kNumThreads);
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&, thread_idx]() {
+      frames[thread_idx] = pipeline.processImage(image_, 2 + thread_idx);
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (const VisualFrame::Ptr& thread_frame : frames) {
+    ASSERT_TRUE(thread_frame);
+    expectFramesEqual(*first_frame, *thread_frame);
+  }
+  EXPECT_GE(pipeline.getNumPooledKazeInstances(), 1u);
+  EXPECT_LE(pipeline.getNumPooledKazeInstances(),
+            std::max(1u, std::thread::hardware_concurrency()));
+}
+
+TEST(KazeInstancePoolTest, EvictsInstancesBeyondTheCapacity) {
+  const size_t kMaxNumPooledInstances = 2u;
+  KazeInstancePool pool(KAZEOptions(), kMaxNumPooledInstances);
+  EXPECT_EQ(0u, pool.getNumPooledInstances());
+  {
+    // As many instances in use as threads that process images at the same time.
+    std::vector<std::shared_ptr<libKAZE::KAZE>> instances;
+    for (size_t i = 0u; i < 4u; ++i) {
+      instances.emplace_back(pool.acquire(320, 240));
+      ASSERT_TRUE(instances.back());
+      for (size_t j = 0u; j < i; ++j) {
+        EXPECT_NE(instances[j].get(), instances[i].get());
+      }
+    }
+    EXPECT_EQ(0u, pool.getNumPooledInstances());
+  }
+  // Only the capacity is kept once they are released.
+  EXPECT_EQ(kMaxNumPooledInstances, pool.getNumPooledInstances());
+
+  // A pooled instance is reused, also for another image size.
+  std::shared_ptr<libKAZE::KAZE> instance = pool.acquire(160, 120);
+  ASSERT_TRUE(instance);
+  EXPECT_EQ(kMaxNumPooledInstances - 1u, pool.getNumPooledInstances());
+  libKAZE::KAZE* const reused_instance = instance.get();
+  instance.reset();
+  instance = pool.acquire(320, 240);
+  EXPECT_EQ(reused_instance, instance.get());
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,69 @@
+#include <algorithm>
+
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/pipeline/visual-pipeline-lines.h>
+#include <aslam/pipeline/visual-pipeline-null.h>
+
+namespace aslam {
+
+class LineVisualPipelineTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    camera_ = PinholeCamera::createTestCamera<RadTanDistortion>();
+    image_ = cv::Mat::zeros(camera_->imageHeight(), camera_->imageWidth(), CV_8UC1);
+    // The edges of the rectangle cross several tiles of the tiled mode.
+    cv::rectangle(image_, cv::Point(100, 90), cv::Point(340, 300), cv::Scalar(255), CV_FILLED);
+  }
+
+  void expectRectangleEdges(const VisualFrame& frame) const {
+    ASSERT_TRUE(frame.hasLineSegments());
+    ASSERT_TRUE(frame.hasLineSegmentScores());
+    ASSERT_EQ(frame.getNumLineSegments(),
+              static_cast<size_t>(frame.getLineSegmentScores().rows()));
+    EXPECT_GE(frame.getNumLineSegments(), 4u);
+
+    double max_length = 0.0;
+    for (size_t i = 0u; i < frame.getNumLineSegments(); ++i) {
+      const Eigen::Vector4d segment = frame.getLineSegments().col(i);
+      const double length = (segment.head<2>() - segment.tail<2>()).norm();
+      EXPECT_NEAR(length, frame.getLineSegmentScores()(i), 1e-9);
+      max_length = std::max(max_length, length);
+    }
+    // The longest edge is 240 pixels long.
+    EXPECT_GT(max_length, 200.0);
+  }
+
+  PinholeCamera::Ptr camera_;
+  cv::Mat image_;
+};
+
+TEST_F(LineVisualPipelineTest, DetectsEdges) {
+  LineVisualPipeline pipeline(camera_, false, LineSegmentDetector::Options(),
+                              VisualPipeline::Ptr());
+  VisualFrame::Ptr frame = pipeline.processImage(image_, 0);
+  ASSERT_TRUE(frame);
+  expectRectangleEdges(*frame);
+}
+
+TEST_F(LineVisualPipelineTest, MergesSegmentsOfTiles) {
+  LineSegmentDetector::Options options;
+  options.tile_size_px = 128u;
+  options.tile_overlap_px = 16u;
+  options.num_threads = 4u;
+  VisualPipeline::Ptr point_pipeline(new NullVisualPipeline(camera_, false));
+  LineVisualPipeline pipeline(camera_, false, options, point_pipeline);
+  VisualFrame::Ptr frame = pipeline.processImage(image_, 0);
+  ASSERT_TRUE(frame);
+  expectRectangleEdges(*frame);
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/deadline.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/pipeline/visual-pipeline-brisk.h>
+#include <aslam/pipeline/visual-pipeline.h>
+
+namespace aslam {
+
+/// Keeps a copy of the image passed to processFrameImpl().
+class ImageCapturingPipeline : public VisualPipeline {
+ public:
+  ImageCapturingPipeline(const Camera::ConstPtr& input_camera,
+                         const Camera::ConstPtr& output_camera)
+      : VisualPipeline(input_camera, output_camera, false) {}
+  virtual ~ImageCapturingPipeline() {}
+
+  const cv::Mat& getLastImage() const { return last_image_; }
+
+  using VisualPipeline::selectKeypointsInGrid;
+
+ protected:
+  virtual void processFrameImpl(const cv::Mat& image, VisualFrame* /*frame*/) const {
+    last_image_ = image.clone();
+  }
+
+ private:
+  mutable cv::Mat last_image_;
+};
+
+class VisualPipelinePreprocessingTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    camera_ = PinholeCamera::createTestCamera();
+    image_.create(camera_->imageHeight(), camera_->imageWidth(), CV_8UC1);
+    cv::randu(image_, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::GaussianBlur(image_, image_, cv::Size(5, 5), 2.0);
+  }
+
+  static cv::Mat gammaCorrect(const cv::Mat& image, double gamma) {
+    cv::Mat lut(1, 256, CV_8UC1);
+    for (int intensity = 0; intensity < 256; ++intensity) {
+      lut.at<uchar>(0, intensity) =
+          cv::saturate_cast<uchar>(255.0 * std::pow(intensity / 255.0, gamma));
+    }
+    cv::Mat corrected_image;
+    cv::LUT(image, lut, corrected_image);
+    return corrected_image;
+  }
+
+  Camera::Ptr camera_;
+  cv::Mat image_;
+};
+
+TEST_F(VisualPipelinePreprocessingTest, ClaheAndGamma) {
+  ImageCapturingPipeline pipeline(camera_, camera_);
+  VisualPipeline::ImagePreprocessingSettings settings;
+  settings.clahe_clip_limit = 2.0;
+  settings.gamma = 0.5;
+  pipeline.setImagePreprocessing(settings);
+
+  cv::Mat expected_image;
+  cv::createCLAHE(settings.clahe_clip_limit, settings.clahe_tile_grid_size)->apply(
+      image_, expected_image);
+  expected_image = gammaCorrect(expected_image, settings.gamma);
+
+  const cv::Mat input_image = image_.clone();
+  // The buffers are reused for the second image.
+  for (int image_idx = 0; image_idx < 2; ++image_idx) {
+    VisualFrame::Ptr frame = pipeline.processImage(image_, image_idx);
+    ASSERT_EQ(pipeline.getLastImage().size(), expected_image.size());
+    EXPECT_EQ(cv::norm(pipeline.getLastImage(), expected_image, cv::NORM_INF), 0.0);
+    // The raw image is not modified by the preprocessing.
+    EXPECT_EQ(cv::norm(frame->getRawImage(), input_image, cv::NORM_INF), 0.0);
+  }
+}
+
+TEST_F(VisualPipelinePreprocessingTest, DownsampleAndGamma) {
+  Eigen::VectorXd intrinsics = camera_->getParameters() / 2.0;
+  Camera::Ptr output_camera(new PinholeCamera(
+      intrinsics, (camera_->imageWidth() + 1u) / 2u, (camera_->imageHeight() + 1u) / 2u));
+  ImageCapturingPipeline pipeline(camera_, output_camera);
+  VisualPipeline::ImagePreprocessingSettings settings;
+  settings.num_downsample_levels = 1;
+  settings.gamma = 2.0;
+  pipeline.setImagePreprocessing(settings);
+
+  cv::Mat expected_image;
+  cv::pyrDown(image_, expected_image);
+  expected_image = gammaCorrect(expected_image, settings.gamma);
+
+  const cv::Mat input_image = image_.clone();
+  VisualFrame::Ptr frame = pipeline.processImage(image_, 0);
+  ASSERT_EQ(pipeline.getLastImage().size(), expected_image.size());
+  EXPECT_EQ(cv::norm(pipeline.getLastImage(), expected_image, cv::NORM_INF), 0.0);
+  EXPECT_EQ(cv::norm(frame->getRawImage(), input_image, cv::NORM_INF), 0.0);
+}
+
+TEST_F(VisualPipelinePreprocessingTest, DetectionMask) {
+  const size_t kOctaves = 0u;
+  const double kUniformityRadius = 0.0;
+  const double kAbsoluteThreshold = 10.0;
+  const size_t kMaxNumKeypoints = 0u;
+  BriskVisualPipeline pipeline(camera_, false, kOctaves, kUniformityRadius, kAbsoluteThreshold,
+                               kMaxNumKeypoints, true, false);
+  const size_t num_unmasked_keypoints =
+      pipeline.processImage(image_, 0)->getNumKeypointMeasurements();
+  ASSERT_GT(num_unmasked_keypoints, 0u);
+
+  // Only the right half of the image is searched.
+  cv::Mat mask(image_.size(), CV_8UC1, cv::Scalar(255));
+  mask.colRange(0, image_.cols / 2).setTo(cv::Scalar(0));
+  pipeline.setDetectionMask(mask);
+  VisualFrame::Ptr frame = pipeline.processImage(image_, 1);
+  ASSERT_GT(frame->getNumKeypointMeasurements(), 0u);
+  EXPECT_LT(frame->getNumKeypointMeasurements(), num_unmasked_keypoints);
+  EXPECT_EQ(frame->getNumKeypointMeasurements(),
+            static_cast<size_t>(frame->getDescriptors().cols()));
+  for (size_t keypoint_idx = 0u; keypoint_idx < frame->getNumKeypointMeasurements();
+       ++keypoint_idx) {
+    EXPECT_GE(frame->getKeypointMeasurement(keypoint_idx)(0), image_.cols / 2 - 0.5);
+  }
+
+  pipeline.setDetectionMask(cv::Mat());
+  EXPECT_EQ(num_unmasked_keypoints,
+            pipeline.processImage(image_, 2)->getNumKeypointMeasurements());
+}
+
+TEST_F(VisualPipelinePreprocessingTest, ProcessingRoiFromCameraMask) {
+  // The left half, a top and a bottom stripe of the image are masked, such that the region of
+  // interest is offset in both directions.
+  Camera::Ptr masked_camera(camera_->clone());
+  cv::Mat camera_mask(image_.size(), CV_8UC1, cv::Scalar(255));
+  const int kMaskedTopRows = 100;
+  const int kMaskedBottomRows = 20;
+  camera_mask.colRange(0, image_.cols / 2).setTo(cv::Scalar(0));
+  camera_mask.rowRange(0, kMaskedTopRows).setTo(cv::Scalar(0));
+  camera_mask.rowRange(image_.rows - kMaskedBottomRows, image_.rows).setTo(cv::Scalar(0));
+  masked_camera->setMask(camera_mask);
+  const int kBorderPixels = 4;
+  const cv::Rect expected_roi(
+      image_.cols / 2 - kBorderPixels, kMaskedTopRows - kBorderPixels,
+      image_.cols - image_.cols / 2 + kBorderPixels,
+      image_.rows - kMaskedTopRows - kMaskedBottomRows + 2 * kBorderPixels);
+  EXPECT_EQ(expected_roi, VisualPipeline::computeMaskBoundingRoi(camera_mask, kBorderPixels));
+
+  ImageCapturingPipeline capturing_pipeline(masked_camera, masked_camera);
+  capturing_pipeline.setProcessingRoiFromCameraMask(kBorderPixels);
+  EXPECT_EQ(expected_roi, capturing_pipeline.getProcessingRoi());
+  capturing_pipeline.processImage(image_, 0);
+  ASSERT_EQ(capturing_pipeline.getLastImage().size(), expected_roi.size());
+  EXPECT_EQ(cv::norm(capturing_pipeline.getLastImage(), image_(expected_roi), cv::NORM_INF),
+            0.0);
+
+  // The keypoints are detected in the sub-image and moved back to the full image.
+  const size_t kOctaves = 0u;
+  const double kUniformityRadius = 0.0;
+  const double kAbsoluteThreshold = 10.0;
+  const size_t kMaxNumKeypoints = 0u;
+  BriskVisualPipeline pipeline(masked_camera, false, kOctaves, kUniformityRadius,
+                               kAbsoluteThreshold, kMaxNumKeypoints, true, false);
+  pipeline.setProcessingRoi(expected_roi);
+  VisualFrame::Ptr frame = pipeline.processImage(image_, 1);
+  ASSERT_GT(frame->getNumKeypointMeasurements(), 0u);
+  for (size_t keypoint_idx = 0u; keypoint_idx < frame->getNumKeypointMeasurements();
+       ++keypoint_idx) {
+    const Eigen::Vector2d keypoint = frame->getKeypointMeasurement(keypoint_idx);
+    EXPECT_GE(keypoint(0), expected_roi.x - 0.5);
+    EXPECT_LE(keypoint(0), expected_roi.x + expected_roi.width + 0.5);
+    EXPECT_GE(keypoint(1), expected_roi.y - 0.5);
+    EXPECT_LE(keypoint(1), expected_roi.y + expected_roi.height + 0.5);
+  }
+}
+
+TEST_F(VisualPipelinePreprocessingTest, DegradesUnderAnExpiredDeadline) {
+  const size_t kOctaves = 0u;
+  const double kUniformityRadius = 0.0;
+  const double kAbsoluteThreshold = 10.0;
+  const size_t kMaxNumKeypoints = 0u;
+  BriskVisualPipeline pipeline(camera_, false, kOctaves, kUniformityRadius, kAbsoluteThreshold,
+                               kMaxNumKeypoints, true, false);
+  pipeline.setSubpixelRefinement(SubpixelRefinementSettings());
+  VisualFrame::Ptr frame = pipeline.processImage(image_, 0);
+  EXPECT_TRUE(frame->getDegradations().empty());
+  const size_t num_keypoints = frame->getNumKeypointMeasurements();
+  ASSERT_GT(num_keypoints, 100u);
+
+  common::DeadlineScope deadline_scope(common::Deadline::fromNow(0));
+  frame = pipeline.processImage(image_, 1);
+  EXPECT_TRUE(frame->getDegradations().has(common::Degradation::kCappedKeypoints));
+  EXPECT_TRUE(frame->getDegradations().has(common::Degradation::kSkippedSubpixelRefinement));
+  EXPECT_EQ(frame->getDegradations(), deadline_scope.getDegradations());
+  // The strongest keypoints are kept, the descriptor extraction can still drop some of them.
+  ASSERT_GT(frame->getNumKeypointMeasurements(), 0u);
+  EXPECT_LE(frame->getNumKeypointMeasurements(), 50u);
+  EXPECT_EQ(frame->getNumKeypointMeasurements(),
+            static_cast<size_t>(frame->getDescriptors().cols()));
+}
+
+TEST(VisualPipelineKeypointSelectionTest, GridSelectionKeepsTheBudget) {
+  const cv::Size kImageSize(640, 480);
+  const double kCellSizePixels = 40.0;
+  cv::RNG rng(7);
+  // A dense cluster in the top left cell and a keypoint in every other cell.
+  std::vector<cv::KeyPoint> keypoints;
+  for (int keypoint_idx = 0; keypoint_idx < 500; ++keypoint_idx) {
+    keypoints.emplace_back(rng.uniform(0.f, 40.f), rng.uniform(0.f, 40.f), 7.f, -1.f,
+                           rng.uniform(0.f, 1.f), 0, keypoint_idx);
+  }
+  for (int row = 0; row < 12; ++row) {
+    for (int col = row == 0 ? 1 : 0; col < 16; ++col) {
+      keypoints.emplace_back(40.f * col + 20.f, 40.f * row + 20.f, 7.f, -1.f,
+                             rng.uniform(0.f, 1.f), 0, static_cast<int>(keypoints.size()));
+    }
+  }
+
+  // A budget above the number of cells, the cluster cell gets its share.
+  std::vector<cv::KeyPoint> selected_keypoints = keypoints;
+  ImageCapturingPipeline::selectKeypointsInGrid(kImageSize, kCellSizePixels, 300u,
+                                                &selected_keypoints);
+  ASSERT_LE(selected_keypoints.size(), 300u);
+  // Two keypoints per cell: the 191 other cells keep their keypoint.
+  EXPECT_EQ(191u + 2u, selected_keypoints.size());
+  size_t num_cluster_keypoints = 0u;
+  for (size_t idx = 0u; idx < selected_keypoints.size(); ++idx) {
+    if (idx > 0u) {
+      // The detector order is kept.
+      EXPECT_LT(selected_keypoints[idx - 1u].class_id, selected_keypoints[idx].class_id);
+    }
+    if (selected_keypoints[idx].class_id < 500) {
+      ++num_cluster_keypoints;
+    }
+  }
+  EXPECT_EQ(2u, num_cluster_keypoints);
+
+  // The second selection of the same layout reuses the grid of the thread.
+  std::vector<cv::KeyPoint> reselected_keypoints = keypoints;
+  ImageCapturingPipeline::selectKeypointsInGrid(kImageSize, kCellSizePixels, 300u,
+                                                &reselected_keypoints);
+  ASSERT_EQ(selected_keypoints.size(), reselected_keypoints.size());
+  for (size_t idx = 0u; idx < selected_keypoints.size(); ++idx) {
+    EXPECT_EQ(selected_keypoints[idx].class_id, reselected_keypoints[idx].class_id);
+  }
+
+  // A budget below the number of cells keeps the strongest keypoints of different cells.
+  selected_keypoints = keypoints;
+  ImageCapturingPipeline::selectKeypointsInGrid(kImageSize, kCellSizePixels, 50u,
+                                                &selected_keypoints);
+  ASSERT_EQ(50u, selected_keypoints.size());
+  std::vector<float> cell_responses;
+  float max_cluster_response = 0.f;
+  for (const cv::KeyPoint& keypoint : keypoints) {
+    if (keypoint.class_id < 500) {
+      max_cluster_response = std::max(max_cluster_response, keypoint.response);
+    } else {
+      cell_responses.push_back(keypoint.response);
+    }
+  }
+  cell_responses.push_back(max_cluster_response);
+  std::sort(cell_responses.begin(), cell_responses.end(), std::greater<float>());
+  for (const cv::KeyPoint& keypoint : selected_keypoints) {
+    EXPECT_GE(keypoint.response, cell_responses[49]);
+  }
+
+  // Within the budget all keypoints are kept.
+  selected_keypoints = keypoints;
+  ImageCapturingPipeline::selectKeypointsInGrid(kImageSize, kCellSizePixels, 1000u,
+                                                &selected_keypoints);
+  EXPECT_EQ(keypoints.size(), selected_keypoints.size());
+}
+
+TEST_F(VisualPipelinePreprocessingTest, AdaptiveDetectionThresholdConverges) {
+  const size_t kOctaves = 0u;
+  const double kUniformityRadius = 0.0;
+  const size_t kMaxNumKeypoints = 0u;
+  const size_t kKeypointBudget = 150u;
+  const int kNumFrames = 40;
+
+  // Starting with a low and a high threshold.
+  std::vector<double> converged_thresholds;
+  for (const double initial_threshold : {5.0, 500.0}) {
+    BriskVisualPipeline pipeline(camera_, false, kOctaves, kUniformityRadius, initial_threshold,
+                                 kMaxNumKeypoints, true, false);
+    pipeline.setKeypointBudget(kKeypointBudget, 40.0, 1.0, 1000.0);
+    EXPECT_EQ(initial_threshold, pipeline.getAdaptiveDetectionThreshold());
+    double previous_threshold = initial_threshold;
+    for (int frame_idx = 0; frame_idx < kNumFrames; ++frame_idx) {
+      VisualFrame::Ptr frame = pipeline.processImage(image_, frame_idx);
+      EXPECT_LE(frame->getNumKeypointMeasurements(), kKeypointBudget);
+      previous_threshold = pipeline.getAdaptiveDetectionThreshold();
+    }
+    // The detections of the same image settle at the target, the threshold stops moving.
+    VisualFrame::Ptr frame = pipeline.processImage(image_, kNumFrames);
+    const double threshold = pipeline.getAdaptiveDetectionThreshold();
+    EXPECT_NEAR(1.0, threshold / previous_threshold, 0.1) << "Initial " << initial_threshold;
+    EXPECT_GT(frame->getNumKeypointMeasurements(), kKeypointBudget / 2u);
+    EXPECT_LE(frame->getNumKeypointMeasurements(), kKeypointBudget);
+    converged_thresholds.push_back(threshold);
+  }
+  EXPECT_NEAR(1.0, converged_thresholds[0] / converged_thresholds[1], 0.25);
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/pipeline/worker-scaling-policy.h>
+
+namespace aslam {
+
+class WorkerScalingPolicyTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    options_.min_num_workers = 1u;
+    options_.max_num_workers = 4u;
+    options_.target_latency_nanoseconds = 1000;
+    options_.scale_up_latency_fraction = 0.8;
+    options_.scale_down_latency_fraction = 0.4;
+    options_.max_num_waiting_items_per_worker = 1.0;
+    options_.evaluation_period_nanoseconds = kPeriod;
+    options_.num_periods_to_scale_down = 3u;
+  }
+
+  static constexpr int64_t kPeriod = 100;
+  static constexpr int64_t kHighLatency = 900;
+  static constexpr int64_t kMediumLatency = 600;
+  static constexpr int64_t kLowLatency = 100;
+  WorkerScalingPolicy::Options options_;
+};
+
+constexpr int64_t WorkerScalingPolicyTest::kPeriod;
+constexpr int64_t WorkerScalingPolicyTest::kHighLatency;
+constexpr int64_t WorkerScalingPolicyTest::kMediumLatency;
+constexpr int64_t WorkerScalingPolicyTest::kLowLatency;
+
+TEST_F(WorkerScalingPolicyTest, ScalesUpOneWorkerPerPeriodUpToTheLimit) {
+  WorkerScalingPolicy policy(options_, 8u);
+  EXPECT_EQ(1u, policy.getNumWorkers());
+  // The period is only evaluated once it ended.
+  EXPECT_FALSE(policy.addSample(0, kHighLatency, 0u));
+  EXPECT_FALSE(policy.addSample(kPeriod / 2, kHighLatency, 0u));
+  EXPECT_EQ(1u, policy.getNumWorkers());
+
+  for (size_t expected_num_workers = 2u; expected_num_workers <= 4u; ++expected_num_workers) {
+    const int64_t time = (expected_num_workers - 1u) * kPeriod;
+    EXPECT_TRUE(policy.addSample(time, kHighLatency, 0u));
+    EXPECT_EQ(expected_num_workers, policy.getNumWorkers());
+  }
+  EXPECT_FALSE(policy.addSample(4 * kPeriod, kHighLatency, 0u));
+  EXPECT_EQ(4u, policy.getNumWorkers());
+}
+
+TEST_F(WorkerScalingPolicyTest, ScalesUpIfTooManyItemsWait) {
+  WorkerScalingPolicy policy(options_, 4u);
+  policy.addSample(0, kLowLatency, 2u);
+  EXPECT_TRUE(policy.addSample(kPeriod, kLowLatency, 2u));
+  EXPECT_EQ(2u, policy.getNumWorkers());
+  // Two waiting items are fine for two workers.
+  EXPECT_FALSE(policy.addSample(2 * kPeriod, kLowLatency, 0u));
+  EXPECT_EQ(2u, policy.getNumWorkers());
+}
+
+TEST_F(WorkerScalingPolicyTest, ScalesDownOnlyAfterConsecutiveLowLoadPeriods) {
+  WorkerScalingPolicy policy(options_, 4u);
+  int64_t time = 0;
+  policy.addSample(time, kHighLatency, 0u);
+  time += kPeriod;
+  policy.addSample(time, kLowLatency, 0u);
+  ASSERT_EQ(2u, policy.getNumWorkers());
+
+  // A medium latency neither scales up nor counts as low load.
+  time += kPeriod;
+  policy.addSample(time, kLowLatency, 0u);
+  time += kPeriod;
+  policy.addSample(time, kMediumLatency, 0u);
+  time += kPeriod;
+  policy.addSample(time, kLowLatency, 0u);
+  EXPECT_EQ(2u, policy.getNumWorkers());
+  // Waiting items don't count as low load either.
+  policy.addSample(time, kLowLatency, 1u);
+  time += kPeriod;
+  policy.addSample(time, kLowLatency, 0u);
+  EXPECT_EQ(2u, policy.getNumWorkers());
+
+  for (size_t i = 0u; i < options_.num_periods_to_scale_down - 1u; ++i) {
+    time += kPeriod;
+    EXPECT_FALSE(policy.addSample(time, kLowLatency, 0u));
+  }
+  time += kPeriod;
+  EXPECT_TRUE(policy.addSample(time, kLowLatency, 0u));
+  EXPECT_EQ(1u, policy.getNumWorkers());
+
+  // Never below the minimum.
+  for (size_t i = 0u; i < 2u * options_.num_periods_to_scale_down; ++i) {
+    time += kPeriod;
+    EXPECT_FALSE(policy.addSample(time, kLowLatency, 0u));
+  }
+  EXPECT_EQ(1u, policy.getNumWorkers());
+}
+
+TEST_F(WorkerScalingPolicyTest, PeriodsWithoutSamplesCountAsLowLoad) {
+  options_.max_num_workers = 0u;
+  WorkerScalingPolicy policy(options_, 3u);
+  int64_t time = 0;
+  for (size_t i = 0u; i < 3u; ++i) {
+    policy.addSample(time, kHighLatency, 0u);
+    time += kPeriod;
+  }
+  policy.addSample(time, kLowLatency, 0u);
+  ASSERT_EQ(3u, policy.getNumWorkers());
+
+  time += 1000 * kPeriod;
+  EXPECT_TRUE(policy.addSample(time, kLowLatency, 0u));
+  EXPECT_EQ(1u, policy.getNumWorkers());
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,21 @@
+#ifndef ASLAM_PYTHON_BINDINGS_H_
+#define ASLAM_PYTHON_BINDINGS_H_
+
+#include <pybind11/pybind11.h>
+
+namespace aslam {
+namespace python {
+
+/// Cameras and camera rigs with batch projection and back-projection.
+void bindCameras(pybind11::module& module);
+
+/// Visual frames, whose channels are exposed as NumPy views without copies.
+void bindFrames(pybind11::module& module);
+
+/// The matching engines on frame pairs.
+void bindMatchers(pybind11::module& module);
+
+}  // namespace python
+}  // namespace aslam
+
+#endif  // ASLAM_PYTHON_BINDINGS_H_
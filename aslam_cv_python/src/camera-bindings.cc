@@ -0,0 +1,105 @@
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/ncamera.h>
+#include <Eigen/Core>
+#include <pybind11/eigen.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include "aslam/python/bindings.h"
+
+namespace py = pybind11;
+
+namespace aslam {
+namespace python {
+namespace {
+// The status codes of the projections, see ProjectionResult::Status.
+Eigen::VectorXi toStatusCodes(const std::vector<ProjectionResult>& results) {
+  Eigen::VectorXi status_codes(static_cast<int>(results.size()));
+  for (size_t i = 0u; i < results.size(); ++i) {
+    status_codes(static_cast<int>(i)) = static_cast<int>(results[i].getDetailedStatus());
+  }
+  return status_codes;
+}
+
+Eigen::Matrix<bool, Eigen::Dynamic, 1> toSuccessFlags(const std::vector<unsigned char>& success) {
+  Eigen::Matrix<bool, Eigen::Dynamic, 1> flags(static_cast<int>(success.size()));
+  for (size_t i = 0u; i < success.size(); ++i) {
+    flags(static_cast<int>(i)) = success[i] != 0u;
+  }
+  return flags;
+}
+}  // namespace
+
+void bindCameras(py::module& module) {
+  py::enum_<ProjectionResult::Status>(module, "ProjectionStatus")
+      .value("KEYPOINT_VISIBLE", ProjectionResult::Status::KEYPOINT_VISIBLE)
+      .value("KEYPOINT_OUTSIDE_IMAGE_BOX", ProjectionResult::Status::KEYPOINT_OUTSIDE_IMAGE_BOX)
+      .value("POINT_BEHIND_CAMERA", ProjectionResult::Status::POINT_BEHIND_CAMERA)
+      .value("PROJECTION_INVALID", ProjectionResult::Status::PROJECTION_INVALID)
+      .value("UNINITIALIZED", ProjectionResult::Status::UNINITIALIZED);
+
+  // The arrays are converted before the GIL is released. Points and keypoints are passed as
+  // 3xN and 2xN arrays, Fortran ordered arrays (or C ordered Nx3 transposes) are not copied.
+  py::class_<Camera, std::shared_ptr<Camera>>(module, "Camera")
+      .def_static("load_from_yaml", &Camera::loadFromYaml, py::arg("yaml_file"))
+      .def_property_readonly("image_width", &Camera::imageWidth)
+      .def_property_readonly("image_height", &Camera::imageHeight)
+      .def("project3",
+           [](const Camera& camera, const Eigen::Ref<const Eigen::Matrix3Xd>& points_3d) {
+             Eigen::Matrix2Xd keypoints;
+             std::vector<ProjectionResult> results;
+             camera.project3Vectorized(points_3d, &keypoints, &results);
+             return std::make_tuple(std::move(keypoints), toStatusCodes(results));
+           },
+           py::arg("points_3d"), py::call_guard<py::gil_scoped_release>(),
+           "Projects the 3xN points, returns the 2xN keypoints and the ProjectionStatus code "
+           "of every point.")
+      .def("back_project3",
+           [](const Camera& camera, const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints) {
+             Eigen::Matrix3Xd points_3d;
+             std::vector<unsigned char> success;
+             camera.backProject3Vectorized(keypoints, &points_3d, &success);
+             return std::make_tuple(std::move(points_3d), toSuccessFlags(success));
+           },
+           py::arg("keypoints"), py::call_guard<py::gil_scoped_release>(),
+           "Back-projects the 2xN keypoints, returns the 3xN bearing vectors and whether "
+           "every back-projection succeeded.")
+      .def("is_keypoint_visible",
+           [](const Camera& camera, const Eigen::Ref<const Eigen::Matrix2Xd>& keypoints) {
+             Eigen::Matrix<bool, Eigen::Dynamic, 1> visible(keypoints.cols());
+             for (int i = 0; i < keypoints.cols(); ++i) {
+               visible(i) = camera.isKeypointVisible(keypoints.col(i));
+             }
+             return visible;
+           },
+           py::arg("keypoints"), py::call_guard<py::gil_scoped_release>());
+
+  py::class_<NCamera, std::shared_ptr<NCamera>>(module, "NCamera")
+      .def_static("load_from_yaml", &NCamera::loadFromYaml, py::arg("yaml_file"))
+      .def_static("create_test_ncamera", &NCamera::createTestNCamera, py::arg("num_cameras"))
+      .def_property_readonly("num_cameras", &NCamera::getNumCameras)
+      .def("get_camera",
+           [](const NCamera& ncamera, size_t camera_index) {
+             if (camera_index >= ncamera.getNumCameras()) {
+               throw py::index_error("Camera index out of range.");
+             }
+             return ncamera.getCameraVector()[camera_index];
+           },
+           py::arg("camera_index"))
+      .def("get_T_C_B",
+           [](const NCamera& ncamera, size_t camera_index) -> Eigen::Matrix4d {
+             if (camera_index >= ncamera.getNumCameras()) {
+               throw py::index_error("Camera index out of range.");
+             }
+             return ncamera.get_T_C_B(camera_index).getTransformationMatrix();
+           },
+           py::arg("camera_index"), "The 4x4 transformation from the body to the camera frame.");
+}
+
+}  // namespace python
+}  // namespace aslam
@@ -0,0 +1,85 @@
+#include <memory>
+#include <string>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/frames/visual-frame.h>
+#include <Eigen/Core>
+#include <pybind11/eigen.h>
+#include <pybind11/pybind11.h>
+
+#include "aslam/python/bindings.h"
+
+namespace py = pybind11;
+
+namespace aslam {
+namespace python {
+namespace {
+void checkHasChannel(const bool has_channel, const char* channel_name) {
+  if (!has_channel) {
+    throw py::key_error(std::string("The frame has no ") + channel_name + " channel.");
+  }
+}
+
+// Binds a channel as a property whose value is a writeable NumPy view that keeps the frame
+// alive. Assigning the property copies into the channel and may reallocate the buffer, which
+// invalidates earlier views.
+template <typename ChannelData>
+void bindChannel(py::class_<VisualFrame, VisualFrame::Ptr>* visual_frame, const char* name,
+                 bool (VisualFrame::*has_channel)() const,
+                 ChannelData* (VisualFrame::*get_channel_mutable)(),
+                 void (VisualFrame::*set_channel)(const ChannelData&)) {
+  visual_frame->def_property(
+      name,
+      [name, has_channel, get_channel_mutable](VisualFrame& frame) {
+        checkHasChannel((frame.*has_channel)(), name);
+        return (frame.*get_channel_mutable)();
+      },
+      [set_channel](VisualFrame& frame, const ChannelData& data) {
+        (frame.*set_channel)(data);
+      },
+      py::return_value_policy::reference_internal);
+}
+}  // namespace
+
+void bindFrames(py::module& module) {
+  py::class_<VisualFrame, VisualFrame::Ptr> visual_frame(module, "VisualFrame");
+  visual_frame.def(py::init<>())
+      .def_property("timestamp_nanoseconds", &VisualFrame::getTimestampNanoseconds,
+                    &VisualFrame::setTimestampNanoseconds)
+      .def_property(
+          "camera_geometry",
+          [](const VisualFrame& frame) {
+            return std::const_pointer_cast<Camera>(frame.getCameraGeometry());
+          },
+          [](VisualFrame& frame, const std::shared_ptr<Camera>& camera) {
+            frame.setCameraGeometry(camera);
+          })
+      .def_property_readonly("num_keypoints", [](const VisualFrame& frame) {
+        return frame.hasKeypointMeasurements() ? frame.getNumKeypointMeasurements() : 0u;
+      })
+      .def("has_keypoint_measurements", &VisualFrame::hasKeypointMeasurements)
+      .def("has_keypoint_orientations", &VisualFrame::hasKeypointOrientations)
+      .def("has_keypoint_scores", &VisualFrame::hasKeypointScores)
+      .def("has_keypoint_scales", &VisualFrame::hasKeypointScales)
+      .def("has_descriptors", &VisualFrame::hasDescriptors)
+      .def("has_track_ids", &VisualFrame::hasTrackIds);
+
+  bindChannel(&visual_frame, "keypoint_measurements", &VisualFrame::hasKeypointMeasurements,
+              &VisualFrame::getKeypointMeasurementsMutable,
+              &VisualFrame::setKeypointMeasurements);
+  bindChannel(&visual_frame, "keypoint_orientations", &VisualFrame::hasKeypointOrientations,
+              &VisualFrame::getKeypointOrientationsMutable,
+              &VisualFrame::setKeypointOrientations);
+  bindChannel(&visual_frame, "keypoint_scores", &VisualFrame::hasKeypointScores,
+              &VisualFrame::getKeypointScoresMutable, &VisualFrame::setKeypointScores);
+  bindChannel(&visual_frame, "keypoint_scales", &VisualFrame::hasKeypointScales,
+              &VisualFrame::getKeypointScalesMutable, &VisualFrame::setKeypointScales);
+  // One descriptor per column, i.e. a (descriptor size in bytes)xN uint8 array.
+  bindChannel(&visual_frame, "descriptors", &VisualFrame::hasDescriptors,
+              &VisualFrame::getDescriptorsMutable, &VisualFrame::setDescriptors);
+  bindChannel(&visual_frame, "track_ids", &VisualFrame::hasTrackIds,
+              &VisualFrame::getTrackIdsMutable, &VisualFrame::setTrackIds);
+}
+
+}  // namespace python
+}  // namespace aslam
@@ -0,0 +1,143 @@
+#include <string>
+#include <tuple>
+
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/matching-engine-cross-check.h>
+#include <aslam/matcher/matching-engine-exclusive.h>
+#include <aslam/matcher/matching-engine-greedy.h>
+#include <aslam/matcher/matching-engine-non-exclusive.h>
+#include <aslam/matcher/matching-problem-frame-to-frame.h>
+#include <Eigen/Core>
+#include <pybind11/eigen.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include "aslam/python/bindings.h"
+
+namespace py = pybind11;
+
+namespace aslam {
+namespace python {
+namespace {
+typedef Eigen::Matrix<int, Eigen::Dynamic, 2> MatchIndices;
+
+// Tolerance on the Frobenius norm of R^T * R - I of the rotation matrices.
+constexpr double kRotationTolerance = 1e-6;
+
+template <typename MatchingEngine>
+std::tuple<MatchIndices, Eigen::VectorXd> matchFrames(
+    MatchingEngine* engine, const VisualFrame& apple_frame, const VisualFrame& banana_frame,
+    const Quaternion& q_A_B, double image_space_distance_threshold_pixels,
+    int hamming_distance_threshold) {
+  CHECK_NOTNULL(engine);
+  MatchingProblemFrameToFrame problem(apple_frame, banana_frame, q_A_B,
+                                      image_space_distance_threshold_pixels,
+                                      hamming_distance_threshold);
+  MatchingProblemFrameToFrame::MatchesWithScore matches;
+  engine->match(&problem, &matches);
+
+  MatchIndices indices(static_cast<int>(matches.size()), 2);
+  Eigen::VectorXd scores(static_cast<int>(matches.size()));
+  for (size_t i = 0u; i < matches.size(); ++i) {
+    indices(static_cast<int>(i), 0) = matches[i].getKeypointIndexAppleFrame();
+    indices(static_cast<int>(i), 1) = matches[i].getKeypointIndexBananaFrame();
+    scores(static_cast<int>(i)) = matches[i].getScore();
+  }
+  return std::make_tuple(std::move(indices), std::move(scores));
+}
+
+// The matching problem and engines CHECK their inputs, which would abort the interpreter. Hence
+// the arguments are validated here and rejected with a ValueError.
+void checkFrameCanBeMatched(const VisualFrame& frame, const char* frame_name) {
+  if (!frame.getCameraGeometry() || !frame.hasKeypointMeasurements() ||
+      !frame.hasDescriptors()) {
+    throw py::value_error(std::string("The ") + frame_name + " frame needs a camera geometry, "
+                          "keypoint measurements and descriptors.");
+  }
+  if (frame.getDescriptors().cols() != frame.getKeypointMeasurements().cols()) {
+    throw py::value_error(std::string("The ") + frame_name + " frame has a different number "
+                          "of descriptors and keypoint measurements.");
+  }
+  if (frame.getCameraGeometry()->imageHeight() == 0u) {
+    throw py::value_error(std::string("The camera of the ") + frame_name + " frame has zero "
+                          "image rows.");
+  }
+}
+
+void checkMatchingArguments(const VisualFrame& apple_frame, const VisualFrame& banana_frame,
+                            const Eigen::Matrix3d& R_A_B,
+                            double image_space_distance_threshold_pixels,
+                            int hamming_distance_threshold, size_t num_threads,
+                            double ratio_threshold) {
+  checkFrameCanBeMatched(apple_frame, "apple");
+  checkFrameCanBeMatched(banana_frame, "banana");
+  if (apple_frame.getDescriptorSizeBytes() != banana_frame.getDescriptorSizeBytes()) {
+    throw py::value_error("The apple and banana frames have different descriptor lengths.");
+  }
+  if ((R_A_B.transpose() * R_A_B - Eigen::Matrix3d::Identity()).norm() > kRotationTolerance ||
+      R_A_B.determinant() <= 0.0) {
+    throw py::value_error("R_A_B is not a rotation matrix.");
+  }
+  if (!(image_space_distance_threshold_pixels >= 0.0)) {
+    throw py::value_error("image_space_distance_threshold_pixels must not be negative.");
+  }
+  if (hamming_distance_threshold < 0) {
+    throw py::value_error("hamming_distance_threshold must not be negative.");
+  }
+  if (num_threads == 0u) {
+    throw py::value_error("num_threads must be positive.");
+  }
+  if (!(ratio_threshold > 0.0 && ratio_threshold <= 1.0)) {
+    throw py::value_error("ratio_threshold must be in (0, 1].");
+  }
+}
+}  // namespace
+
+void bindMatchers(py::module& module) {
+  // The problem setup and matching run without the GIL, such that frame pairs can be matched
+  // on several Python threads.
+  module.def(
+      "match_frames",
+      [](const VisualFrame& apple_frame, const VisualFrame& banana_frame,
+         const Eigen::Matrix3d& R_A_B, double image_space_distance_threshold_pixels,
+         int hamming_distance_threshold, const std::string& engine, size_t num_threads,
+         double ratio_threshold) {
+        checkMatchingArguments(apple_frame, banana_frame, R_A_B,
+                               image_space_distance_threshold_pixels, hamming_distance_threshold,
+                               num_threads, ratio_threshold);
+        const Quaternion q_A_B(R_A_B);
+
+        py::gil_scoped_release release;
+        if (engine == "exclusive") {
+          MatchingEngineExclusive<MatchingProblemFrameToFrame> matching_engine(num_threads);
+          return matchFrames(&matching_engine, apple_frame, banana_frame, q_A_B,
+                             image_space_distance_threshold_pixels, hamming_distance_threshold);
+        } else if (engine == "greedy") {
+          MatchingEngineGreedy<MatchingProblemFrameToFrame> matching_engine(num_threads);
+          return matchFrames(&matching_engine, apple_frame, banana_frame, q_A_B,
+                             image_space_distance_threshold_pixels, hamming_distance_threshold);
+        } else if (engine == "non_exclusive") {
+          MatchingEngineNonExclusive<MatchingProblemFrameToFrame> matching_engine(num_threads);
+          return matchFrames(&matching_engine, apple_frame, banana_frame, q_A_B,
+                             image_space_distance_threshold_pixels, hamming_distance_threshold);
+        } else if (engine == "cross_check") {
+          MatchingEngineCrossCheck<MatchingProblemFrameToFrame> matching_engine(
+              num_threads, ratio_threshold);
+          return matchFrames(&matching_engine, apple_frame, banana_frame, q_A_B,
+                             image_space_distance_threshold_pixels, hamming_distance_threshold);
+        }
+        throw py::value_error("Unknown matching engine " + engine + ", use exclusive, greedy, "
+                              "non_exclusive or cross_check.");
+      },
+      py::arg("apple_frame"), py::arg("banana_frame"), py::arg("R_A_B"),
+      py::arg("image_space_distance_threshold_pixels"), py::arg("hamming_distance_threshold"),
+      py::arg("engine") = "exclusive", py::arg("num_threads") = 1u,
+      py::arg("ratio_threshold") = 1.0,
+      "Matches the keypoints of two frames, R_A_B rotates bearing vectors from the banana to "
+      "the apple camera frame. Returns an Nx2 array of (apple, banana) keypoint indices and the "
+      "scores of the matches.");
+}
+
+}  // namespace python
+}  // namespace aslam
@@ -0,0 +1,13 @@
+#include <pybind11/pybind11.h>
+
+#include "aslam/python/bindings.h"
+
+PYBIND11_MODULE(aslam_cv, module) {
+  module.doc() =
+      "Bindings of the aslam_cv frames, cameras and matchers for offline analysis. The frame "
+      "channels are NumPy views of the C++ buffers, the batch operations release the GIL.";
+  // The frames reference their camera, hence the cameras are bound first.
+  aslam::python::bindCameras(module);
+  aslam::python::bindFrames(module);
+  aslam::python::bindMatchers(module);
+}
@@ -0,0 +1,101 @@
+#!/usr/bin/env python
+import threading
+import unittest
+
+import numpy as np
+
+import aslam_cv
+
+
+def create_frame(camera, num_keypoints, descriptor_size_bytes=48, seed=0):
+    rng = np.random.RandomState(seed)
+    frame = aslam_cv.VisualFrame()
+    frame.camera_geometry = camera
+    frame.keypoint_measurements = np.vstack((
+        rng.uniform(0.0, camera.image_width - 1.0, num_keypoints),
+        rng.uniform(0.0, camera.image_height - 1.0, num_keypoints)))
+    frame.descriptors = rng.randint(
+        0, 256, (descriptor_size_bytes, num_keypoints)).astype(np.uint8)
+    return frame
+
+
+class BindingsTest(unittest.TestCase):
+    def setUp(self):
+        self.camera = aslam_cv.NCamera.create_test_ncamera(1).get_camera(0)
+
+    def test_channels_are_views(self):
+        frame = create_frame(self.camera, 10)
+        keypoints = frame.keypoint_measurements
+        self.assertEqual((2, 10), keypoints.shape)
+        keypoints[0, 3] = 12.5
+        self.assertEqual(12.5, frame.keypoint_measurements[0, 3])
+        self.assertTrue(np.shares_memory(keypoints, frame.keypoint_measurements))
+        self.assertEqual((48, 10), frame.descriptors.shape)
+        self.assertEqual(np.uint8, frame.descriptors.dtype)
+        with self.assertRaises(KeyError):
+            frame.track_ids
+
+    def test_projection_round_trip(self):
+        keypoints = create_frame(self.camera, 100).keypoint_measurements
+        bearings, success = self.camera.back_project3(keypoints)
+        self.assertTrue(np.all(success))
+        projected, status = self.camera.project3(bearings)
+        visible = int(aslam_cv.ProjectionStatus.KEYPOINT_VISIBLE)
+        self.assertTrue(np.all(status == visible))
+        np.testing.assert_allclose(keypoints, projected, atol=1e-4)
+
+    def test_match_identical_frames(self):
+        apple_frame = create_frame(self.camera, 200)
+        banana_frame = create_frame(self.camera, 200)
+        for engine in ('exclusive', 'greedy', 'non_exclusive', 'cross_check'):
+            indices, scores = aslam_cv.match_frames(
+                apple_frame, banana_frame, np.eye(3), 10.0, 10, engine=engine)
+            self.assertEqual(200, indices.shape[0], engine)
+            np.testing.assert_array_equal(indices[:, 0], indices[:, 1])
+            np.testing.assert_allclose(scores, 1.0)
+        with self.assertRaises(ValueError):
+            aslam_cv.match_frames(apple_frame, banana_frame, np.eye(3), 10.0, 10,
+                                  engine='unknown')
+
+    def test_invalid_matching_arguments_raise(self):
+        apple_frame = create_frame(self.camera, 20)
+        banana_frame = create_frame(self.camera, 20)
+        invalid_arguments = [
+            dict(R_A_B=2.0 * np.eye(3)),
+            dict(image_space_distance_threshold_pixels=-1.0),
+            dict(hamming_distance_threshold=-1),
+            dict(num_threads=0),
+            dict(engine='cross_check', ratio_threshold=1.5),
+        ]
+        for arguments in invalid_arguments:
+            kwargs = dict(R_A_B=np.eye(3), image_space_distance_threshold_pixels=10.0,
+                          hamming_distance_threshold=10)
+            kwargs.update(arguments)
+            with self.assertRaises(ValueError, msg=str(arguments)):
+                aslam_cv.match_frames(apple_frame, banana_frame, **kwargs)
+
+        short_descriptor_frame = create_frame(self.camera, 20, descriptor_size_bytes=32)
+        with self.assertRaises(ValueError):
+            aslam_cv.match_frames(apple_frame, short_descriptor_frame, np.eye(3), 10.0, 10)
+        banana_frame.descriptors = banana_frame.descriptors[:, :10]
+        with self.assertRaises(ValueError):
+            aslam_cv.match_frames(apple_frame, banana_frame, np.eye(3), 10.0, 10)
+
+    def test_matching_on_threads(self):
+        frames = [create_frame(self.camera, 200, seed=seed) for seed in range(4)]
+        num_matches = [0] * len(frames)
+
+        def match(index):
+            indices, _ = aslam_cv.match_frames(
+                frames[index], frames[index], np.eye(3), 10.0, 10)
+            num_matches[index] = indices.shape[0]
+        threads = [threading.Thread(target=match, args=(i,)) for i in range(len(frames))]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual([200] * len(frames), num_matches)
+
+
+if __name__ == '__main__':
+    unittest.main()
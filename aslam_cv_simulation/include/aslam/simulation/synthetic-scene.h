@@ -0,0 +1,178 @@
+#ifndef ASLAM_SIMULATION_SYNTHETIC_SCENE_H_
+#define ASLAM_SIMULATION_SYNTHETIC_SCENE_H_
+
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/macros.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <Eigen/Core>
+#include <opencv2/core/core.hpp>
+
+namespace aslam {
+namespace simulation {
+
+/// Path of the rig. The body frame has x forward, y left and z up, like the test rigs of
+/// NCamera, and moves in the xy plane of the global frame.
+enum class TrajectoryType {
+  /// Straight along the x axis of the global frame.
+  kStraight,
+  /// Circle of trajectory_radius_m around the origin, heading along the tangent.
+  kCircle,
+  /// Rotation in place at the origin about a random axis, e.g. for the rotation predictions of
+  /// the gyro matcher and tracker.
+  kRotation
+};
+
+/// A generated nframe with the ground truth of its keypoints.
+struct SyntheticNFrame {
+  VisualNFrame::Ptr nframe;
+  Transformation T_G_B;
+  /// Per camera, the index of the observed landmark of every keypoint or -1 for outliers.
+  std::vector<Eigen::VectorXi> landmark_indices;
+};
+
+/// \class SyntheticScene
+/// \brief Landmark cloud and rig trajectory for load and stress tests of the matchers, trackers
+///        and triangulation, which need many frames with consistent observations.
+///
+/// The rig follows the trajectory and every camera observes the landmarks in front of it with
+/// keypoint noise, missed detections, outliers and perturbed descriptors. The keypoints of a
+/// frame are in random order and have no track ids. All samples are deterministic for a seed,
+/// every frame uses its own random generator such that the frames can be generated in any order
+/// and in parallel with the same result.
+class SyntheticScene {
+ public:
+  ASLAM_POINTER_TYPEDEFS(SyntheticScene);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(SyntheticScene);
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  struct Options {
+    size_t num_landmarks;
+    size_t num_frames;
+    int64_t frame_period_nanoseconds;
+    int64_t start_timestamp_nanoseconds;
+
+    TrajectoryType trajectory_type;
+    double speed_m_s;
+    double trajectory_radius_m;
+    /// The angular speed of the kRotation trajectory.
+    double angular_speed_rad_s;
+    /// Standard deviations of the random perturbations of every pose of the trajectory.
+    double position_noise_m;
+    double orientation_noise_rad;
+
+    /// Landmarks are sampled in random directions around random poses of the trajectory at a
+    /// uniformly distributed distance, such that every part of the trajectory sees landmarks.
+    double min_landmark_distance_m;
+    double max_landmark_distance_m;
+
+    size_t descriptor_size_bytes;
+    /// Every observation flips this many random bits of the descriptor of its landmark.
+    size_t num_flipped_descriptor_bits;
+    double keypoint_noise_px;
+    double min_distance_to_image_border_px;
+    /// Probability that a visible landmark is detected, to emulate missed detections.
+    double detection_probability;
+    /// Number of random outliers with random descriptors per frame, relative to the number of
+    /// detected landmarks.
+    double outlier_ratio;
+    /// At most this many keypoints per frame, 0 for no limit. The kept keypoints are a random
+    /// subset which keeps the ratio of inliers and outliers.
+    size_t max_num_keypoints_per_frame;
+    /// Add a random textured image of the size of the camera to every frame, see
+    /// createTexturedImage(). The images are not renderings of the landmarks.
+    bool add_raw_images;
+
+    uint32_t seed;
+
+    Options() :
+      num_landmarks(10000u),
+      num_frames(100u),
+      frame_period_nanoseconds(50000000),
+      start_timestamp_nanoseconds(0),
+      trajectory_type(TrajectoryType::kCircle),
+      speed_m_s(2.0),
+      trajectory_radius_m(10.0),
+      angular_speed_rad_s(0.35),
+      position_noise_m(0.01),
+      orientation_noise_rad(0.005),
+      min_landmark_distance_m(2.0),
+      max_landmark_distance_m(20.0),
+      descriptor_size_bytes(48u),
+      num_flipped_descriptor_bits(4u),
+      keypoint_noise_px(0.5),
+      min_distance_to_image_border_px(5.0),
+      detection_probability(0.9),
+      outlier_ratio(0.1),
+      max_num_keypoints_per_frame(0u),
+      add_raw_images(false),
+      seed(42u) {}
+  };
+
+  SyntheticScene(const NCamera::Ptr& ncamera, const Options& options);
+
+  /// \brief Creates a scene whose frames have num_keypoints_per_frame keypoints, e.g. to time
+  ///        the matchers for a number of keypoints.
+  ///
+  /// The number of landmarks of the options is replaced: it is scaled from the keypoints of the
+  /// first frame of a trial scene, such that the keypoint limit only drops a few observations and
+  /// consecutive frames share most landmarks.
+  static SyntheticScene::Ptr createWithNumKeypointsPerFrame(
+      const NCamera::Ptr& ncamera, size_t num_keypoints_per_frame, const Options& options);
+
+  /// Generates the nframe at the given index of the trajectory. Thread-safe.
+  SyntheticNFrame createNFrame(size_t frame_index) const;
+
+  /// Generates all nframes of the trajectory in parallel on the shared pool of parallelFor.
+  std::vector<SyntheticNFrame> createAllNFrames() const;
+
+  /// The ground truth correspondences between the keypoints of camera camera_index of two
+  /// nframes as pairs of keypoint indices (a, b), in the order of the keypoints of a.
+  static std::vector<std::pair<int, int>> getGroundTruthCorrespondences(
+      const SyntheticNFrame& nframe_a, const SyntheticNFrame& nframe_b, size_t camera_index);
+
+  size_t getNumFrames() const { return T_G_Bs_.size(); }
+  size_t getNumLandmarks() const { return static_cast<size_t>(G_landmarks_.cols()); }
+  const Transformation& get_T_G_B(size_t frame_index) const;
+  /// The pose of camera camera_index at frame_index_b in the camera at frame_index_a.
+  Transformation get_T_Ca_Cb(size_t frame_index_a, size_t frame_index_b,
+                             size_t camera_index) const;
+  int64_t getTimestampNanoseconds(size_t frame_index) const;
+  const Eigen::Matrix3Xd& getLandmarks() const { return G_landmarks_; }
+  const VisualFrame::DescriptorsT& getLandmarkDescriptors() const {
+    return landmark_descriptors_;
+  }
+  const NCamera::Ptr& getNCamera() const { return ncamera_; }
+  const Options& getOptions() const { return options_; }
+
+ private:
+  void createTrajectory();
+  void createLandmarks();
+  VisualFrame::Ptr createFrame(size_t frame_index, size_t camera_index,
+                               Eigen::VectorXi* landmark_indices) const;
+
+  const NCamera::Ptr ncamera_;
+  const Options options_;
+  TransformationVector T_G_Bs_;
+  Eigen::Matrix3Xd G_landmarks_;
+  VisualFrame::DescriptorsT landmark_descriptors_;
+};
+
+/// A rig of an undistorted pinhole camera with a focal length of 0.8 times the image width,
+/// looking along the x axis of the body frame.
+NCamera::Ptr createPinholeNCamera(uint32_t image_width, uint32_t image_height);
+
+/// Random rectangles on smoothed noise, such that detectors find corners and edges and the LK
+/// iterations cost about the same as on real images.
+cv::Mat createTexturedImage(uint32_t image_width, uint32_t image_height, std::mt19937* generator);
+
+}  // namespace simulation
+}  // namespace aslam
+
+#endif  // ASLAM_SIMULATION_SYNTHETIC_SCENE_H_
@@ -0,0 +1,394 @@
+#include "aslam/simulation/synthetic-scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <unordered_map>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/parallel-for.h>
+#include <glog/logging.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace aslam {
+namespace simulation {
+namespace {
+
+/// Separate streams of random numbers for the parts of the scene, combined with the seed.
+const uint32_t kTrajectoryStream = 1u;
+const uint32_t kLandmarkStream = 2u;
+const uint32_t kFrameStream = 3u;
+
+/// Landmarks are sampled in chunks of this size, every chunk with its own generator.
+const size_t kLandmarkGrainSize = 1024u;
+/// Landmarks are spread less in height than horizontally, like in a street or a building.
+const double kLandmarkHeightScale = 0.3;
+const double kMinKeypointUncertaintyPx = 0.1;
+const double kKeypointScalePx = 12.0;
+const int kNumImageRectangles = 60;
+/// The trial scene of createWithNumKeypointsPerFrame() has this many landmarks per keypoint.
+const size_t kNumTrialLandmarksPerKeypoint = 10u;
+/// Landmarks in excess of the keypoint limit, such that most frames reach the limit.
+const double kLandmarkMargin = 1.05;
+
+Quaternion sampleRotation(double sigma_rad, std::mt19937* generator) {
+  CHECK_NOTNULL(generator);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  const Eigen::Vector3d rotation_vector =
+      sigma_rad * Eigen::Vector3d(normal(*generator), normal(*generator), normal(*generator));
+  const double angle = rotation_vector.norm();
+  if (angle == 0.0) {
+    return Quaternion();
+  }
+  return Quaternion(Eigen::AngleAxisd(angle, rotation_vector / angle).toRotationMatrix());
+}
+
+Quaternion getYawRotation(double yaw_rad) {
+  return Quaternion(Eigen::AngleAxisd(yaw_rad, Eigen::Vector3d::UnitZ()).toRotationMatrix());
+}
+
+void flipRandomBits(size_t num_bits, size_t descriptor_idx, std::mt19937* generator,
+                    VisualFrame::DescriptorsT* descriptors) {
+  CHECK_NOTNULL(generator);
+  CHECK_NOTNULL(descriptors);
+  std::uniform_int_distribution<int> bit(0, descriptors->rows() * 8 - 1);
+  for (size_t i = 0u; i < num_bits; ++i) {
+    const int flipped_bit = bit(*generator);
+    (*descriptors)(flipped_bit / 8, descriptor_idx) ^=
+        static_cast<unsigned char>(1u << (flipped_bit % 8));
+  }
+}
+
+}  // namespace
+
+NCamera::Ptr createPinholeNCamera(uint32_t image_width, uint32_t image_height) {
+  CHECK_GT(image_width, 0u);
+  CHECK_GT(image_height, 0u);
+  const double focal_length = 0.8 * image_width;
+  std::vector<Camera::Ptr> cameras;
+  cameras.emplace_back(new PinholeCamera(
+      focal_length, focal_length, 0.5 * image_width, 0.5 * image_height, image_width,
+      image_height));
+  CameraId camera_id;
+  camera_id.randomize();
+  cameras.back()->setId(camera_id);
+
+  // The optical axis along the body x axis, the image x axis along the body -y axis.
+  Eigen::Matrix3d R_B_C = Eigen::Matrix3d::Zero();
+  R_B_C(1, 0) = -1.0;
+  R_B_C(2, 1) = -1.0;
+  R_B_C(0, 2) = 1.0;
+  TransformationVector T_C_Bs;
+  T_C_Bs.emplace_back(Quaternion(R_B_C).inverse(), Position3D::Zero());
+  NCameraId ncamera_id;
+  ncamera_id.randomize();
+  return aligned_shared<NCamera>(ncamera_id, T_C_Bs, cameras, "Synthetic pinhole camera");
+}
+
+cv::Mat createTexturedImage(uint32_t image_width, uint32_t image_height,
+                            std::mt19937* generator) {
+  CHECK_NOTNULL(generator);
+  CHECK_GT(image_width, 0u);
+  CHECK_GT(image_height, 0u);
+  cv::Mat image(image_height, image_width, CV_8UC1);
+  cv::theRNG().state = (*generator)();
+  cv::randu(image, cv::Scalar(0), cv::Scalar(255));
+  cv::GaussianBlur(image, image, cv::Size(7, 7), 2.0);
+
+  std::uniform_int_distribution<int> u(0, image_width - 1);
+  std::uniform_int_distribution<int> v(0, image_height - 1);
+  std::uniform_int_distribution<int> intensity(0, 255);
+  for (int i = 0; i < kNumImageRectangles; ++i) {
+    const cv::Point corner(u(*generator), v(*generator));
+    const cv::Point opposite_corner(u(*generator), v(*generator));
+    cv::rectangle(image, corner, opposite_corner, cv::Scalar(intensity(*generator)), -1);
+  }
+  cv::GaussianBlur(image, image, cv::Size(3, 3), 1.0);
+  return image;
+}
+
+SyntheticScene::SyntheticScene(const NCamera::Ptr& ncamera, const Options& options)
+    : ncamera_(ncamera), options_(options) {
+  CHECK(ncamera_);
+  CHECK_GT(options_.num_frames, 0u);
+  CHECK_GT(options_.num_landmarks, 0u);
+  CHECK_GT(options_.frame_period_nanoseconds, 0);
+  CHECK_GT(options_.trajectory_radius_m, 0.0);
+  CHECK_GT(options_.min_landmark_distance_m, 0.0);
+  CHECK_GE(options_.max_landmark_distance_m, options_.min_landmark_distance_m);
+  CHECK_GT(options_.descriptor_size_bytes, 0u);
+  CHECK_GE(options_.keypoint_noise_px, 0.0);
+  CHECK_GE(options_.detection_probability, 0.0);
+  CHECK_LE(options_.detection_probability, 1.0);
+  CHECK_GE(options_.outlier_ratio, 0.0);
+  createTrajectory();
+  createLandmarks();
+}
+
+SyntheticScene::Ptr SyntheticScene::createWithNumKeypointsPerFrame(
+    const NCamera::Ptr& ncamera, size_t num_keypoints_per_frame, const Options& options) {
+  CHECK(ncamera);
+  CHECK_GT(num_keypoints_per_frame, 0u);
+  Options trial_options = options;
+  trial_options.num_landmarks = kNumTrialLandmarksPerKeypoint * num_keypoints_per_frame;
+  trial_options.max_num_keypoints_per_frame = 0u;
+  trial_options.add_raw_images = false;
+  const SyntheticScene trial_scene(ncamera, trial_options);
+  const SyntheticNFrame trial_nframe = trial_scene.createNFrame(0u);
+  size_t num_trial_keypoints = 0u;
+  for (size_t camera_idx = 0u; camera_idx < ncamera->getNumCameras(); ++camera_idx) {
+    num_trial_keypoints += trial_nframe.nframe->getFrame(camera_idx).getNumKeypointMeasurements();
+  }
+  CHECK_GT(num_trial_keypoints, 0u) << "The cameras observe none of the landmarks.";
+  const double num_keypoints_per_landmark =
+      static_cast<double>(num_trial_keypoints) /
+      (trial_options.num_landmarks * ncamera->getNumCameras());
+
+  Options scene_options = options;
+  scene_options.num_landmarks = static_cast<size_t>(std::ceil(
+      kLandmarkMargin * num_keypoints_per_frame / num_keypoints_per_landmark));
+  scene_options.max_num_keypoints_per_frame = num_keypoints_per_frame;
+  return aligned_shared<SyntheticScene>(ncamera, scene_options);
+}
+
+void SyntheticScene::createTrajectory() {
+  std::seed_seq seed_sequence{options_.seed, kTrajectoryStream};
+  std::mt19937 generator(seed_sequence);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  Eigen::Vector3d rotation_axis = Eigen::Vector3d::UnitZ();
+  if (options_.trajectory_type == TrajectoryType::kRotation) {
+    rotation_axis = Eigen::Vector3d(normal(generator), normal(generator), normal(generator));
+    rotation_axis.normalize();
+  }
+
+  T_G_Bs_.resize(options_.num_frames);
+  for (size_t frame_idx = 0u; frame_idx < options_.num_frames; ++frame_idx) {
+    const double time_s = frame_idx * options_.frame_period_nanoseconds * 1e-9;
+    const double distance_m = options_.speed_m_s * time_s;
+    Eigen::Vector3d p_G_B;
+    Quaternion q_G_B;
+    switch (options_.trajectory_type) {
+      case TrajectoryType::kStraight:
+        p_G_B = Eigen::Vector3d(distance_m, 0.0, 0.0);
+        break;
+      case TrajectoryType::kCircle: {
+        // Counterclockwise, the body x axis along the tangent.
+        const double angle_rad = distance_m / options_.trajectory_radius_m;
+        p_G_B = options_.trajectory_radius_m *
+            Eigen::Vector3d(std::cos(angle_rad), std::sin(angle_rad), 0.0);
+        q_G_B = getYawRotation(angle_rad + 0.5 * M_PI);
+        break;
+      }
+      case TrajectoryType::kRotation:
+        p_G_B.setZero();
+        q_G_B = Quaternion(Eigen::AngleAxisd(
+            options_.angular_speed_rad_s * time_s, rotation_axis).toRotationMatrix());
+        break;
+      default:
+        LOG(FATAL) << "Unknown trajectory type.";
+    }
+    p_G_B += options_.position_noise_m *
+        Eigen::Vector3d(normal(generator), normal(generator), normal(generator));
+    q_G_B = q_G_B * sampleRotation(options_.orientation_noise_rad, &generator);
+    T_G_Bs_[frame_idx] = Transformation(q_G_B, p_G_B);
+  }
+}
+
+void SyntheticScene::createLandmarks() {
+  G_landmarks_.resize(3, options_.num_landmarks);
+  landmark_descriptors_.resize(options_.descriptor_size_bytes, options_.num_landmarks);
+  // A rotating body looks in all directions, hence its landmarks cover the whole sphere.
+  const double height_scale =
+      options_.trajectory_type == TrajectoryType::kRotation ? 1.0 : kLandmarkHeightScale;
+  common::parallelFor(common::IndexRange(0u, options_.num_landmarks), kLandmarkGrainSize,
+                      [this, height_scale](size_t begin, size_t end) {
+    std::seed_seq seed_sequence{options_.seed, kLandmarkStream, static_cast<uint32_t>(begin)};
+    std::mt19937 generator(seed_sequence);
+    std::uniform_int_distribution<size_t> frame(0u, options_.num_frames - 1u);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_real_distribution<double> distance(
+        options_.min_landmark_distance_m, options_.max_landmark_distance_m);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (size_t i = begin; i < end; ++i) {
+      Eigen::Vector3d direction(
+          normal(generator), normal(generator), height_scale * normal(generator));
+      direction.normalize();
+      G_landmarks_.col(i) =
+          T_G_Bs_[frame(generator)].getPosition() + distance(generator) * direction;
+      for (size_t byte_idx = 0u; byte_idx < options_.descriptor_size_bytes; ++byte_idx) {
+        landmark_descriptors_(byte_idx, i) = static_cast<unsigned char>(byte(generator));
+      }
+    }
+  });
+}
+
+SyntheticNFrame SyntheticScene::createNFrame(size_t frame_index) const {
+  CHECK_LT(frame_index, getNumFrames());
+  const size_t num_cameras = ncamera_->getNumCameras();
+  SyntheticNFrame synthetic_nframe;
+  synthetic_nframe.nframe = aligned_shared<VisualNFrame>(ncamera_);
+  synthetic_nframe.T_G_B = T_G_Bs_[frame_index];
+  synthetic_nframe.landmark_indices.resize(num_cameras);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    synthetic_nframe.nframe->setFrame(camera_idx, createFrame(
+        frame_index, camera_idx, &synthetic_nframe.landmark_indices[camera_idx]));
+  }
+  return synthetic_nframe;
+}
+
+std::vector<SyntheticNFrame> SyntheticScene::createAllNFrames() const {
+  std::vector<SyntheticNFrame> nframes(getNumFrames());
+  const size_t kGrainSize = 1u;
+  common::parallelFor(common::IndexRange(0u, getNumFrames()), kGrainSize,
+                      [this, &nframes](size_t begin, size_t end) {
+    for (size_t frame_idx = begin; frame_idx < end; ++frame_idx) {
+      nframes[frame_idx] = createNFrame(frame_idx);
+    }
+  });
+  return nframes;
+}
+
+VisualFrame::Ptr SyntheticScene::createFrame(
+    size_t frame_index, size_t camera_index, Eigen::VectorXi* landmark_indices) const {
+  CHECK_NOTNULL(landmark_indices);
+  std::seed_seq seed_sequence{options_.seed, kFrameStream, static_cast<uint32_t>(frame_index),
+                              static_cast<uint32_t>(camera_index)};
+  std::mt19937 generator(seed_sequence);
+  const Camera::ConstPtr camera = ncamera_->getCameraShared(camera_index);
+  const Transformation T_C_G = ncamera_->get_T_C_B(camera_index) * T_G_Bs_[frame_index].inverse();
+
+  const Eigen::Matrix3Xd C_landmarks =
+      (T_C_G.getRotationMatrix() * G_landmarks_).colwise() + T_C_G.getPosition();
+  Eigen::Matrix2Xd projected_keypoints;
+  std::vector<ProjectionResult> projection_results;
+  camera->project3Vectorized(C_landmarks, &projected_keypoints, &projection_results);
+
+  // The detected landmarks, then the outliers with index -1.
+  std::bernoulli_distribution is_detected(options_.detection_probability);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  std::vector<int> observed_landmarks;
+  Aligned<std::vector, Eigen::Vector2d> keypoints;
+  for (size_t i = 0u; i < getNumLandmarks(); ++i) {
+    if (!projection_results[i].isKeypointVisible() || !is_detected(generator)) {
+      continue;
+    }
+    Eigen::Vector2d keypoint = projected_keypoints.col(i);
+    keypoint += options_.keypoint_noise_px *
+        Eigen::Vector2d(normal(generator), normal(generator));
+    if (camera->isKeypointVisibleWithMargin(
+        keypoint, options_.min_distance_to_image_border_px)) {
+      observed_landmarks.push_back(static_cast<int>(i));
+      keypoints.push_back(keypoint);
+    }
+  }
+  const size_t num_outliers = static_cast<size_t>(
+      std::round(options_.outlier_ratio * observed_landmarks.size()));
+  std::uniform_real_distribution<double> u(
+      options_.min_distance_to_image_border_px,
+      camera->imageWidth() - options_.min_distance_to_image_border_px);
+  std::uniform_real_distribution<double> v(
+      options_.min_distance_to_image_border_px,
+      camera->imageHeight() - options_.min_distance_to_image_border_px);
+  for (size_t i = 0u; i < num_outliers; ++i) {
+    observed_landmarks.push_back(-1);
+    keypoints.emplace_back(u(generator), v(generator));
+  }
+
+  // Random order, such that matchers and trackers can't rely on the order of the landmarks.
+  std::vector<size_t> order(keypoints.size());
+  for (size_t i = 0u; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::shuffle(order.begin(), order.end(), generator);
+  if (options_.max_num_keypoints_per_frame > 0u &&
+      order.size() > options_.max_num_keypoints_per_frame) {
+    order.resize(options_.max_num_keypoints_per_frame);
+  }
+
+  const size_t num_keypoints = order.size();
+  Eigen::Matrix2Xd keypoint_measurements(2, num_keypoints);
+  VisualFrame::DescriptorsT descriptors(options_.descriptor_size_bytes, num_keypoints);
+  Eigen::VectorXd scores(num_keypoints);
+  landmark_indices->resize(num_keypoints);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_real_distribution<double> score(0.0, 1.0);
+  for (size_t i = 0u; i < num_keypoints; ++i) {
+    const int landmark_idx = observed_landmarks[order[i]];
+    keypoint_measurements.col(i) = keypoints[order[i]];
+    (*landmark_indices)(i) = landmark_idx;
+    scores(i) = score(generator);
+    if (landmark_idx < 0) {
+      for (size_t byte_idx = 0u; byte_idx < options_.descriptor_size_bytes; ++byte_idx) {
+        descriptors(byte_idx, i) = static_cast<unsigned char>(byte(generator));
+      }
+    } else {
+      descriptors.col(i) = landmark_descriptors_.col(landmark_idx);
+      flipRandomBits(options_.num_flipped_descriptor_bits, i, &generator, &descriptors);
+    }
+  }
+
+  VisualFrame::Ptr frame = VisualFrame::createEmptyTestVisualFrame(
+      camera, getTimestampNanoseconds(frame_index));
+  frame->setKeypointMeasurements(keypoint_measurements);
+  frame->setKeypointMeasurementUncertainties(Eigen::VectorXd::Constant(
+      num_keypoints, std::max(options_.keypoint_noise_px, kMinKeypointUncertaintyPx)));
+  frame->setKeypointOrientations(Eigen::VectorXd::Zero(num_keypoints));
+  frame->setKeypointScales(Eigen::VectorXd::Constant(num_keypoints, kKeypointScalePx));
+  frame->setKeypointScores(scores);
+  frame->setDescriptors(descriptors);
+  frame->setTrackIds(Eigen::VectorXi::Constant(num_keypoints, -1));
+  if (options_.add_raw_images) {
+    frame->setRawImage(
+        createTexturedImage(camera->imageWidth(), camera->imageHeight(), &generator));
+  }
+  return frame;
+}
+
+std::vector<std::pair<int, int>> SyntheticScene::getGroundTruthCorrespondences(
+    const SyntheticNFrame& nframe_a, const SyntheticNFrame& nframe_b, size_t camera_index) {
+  CHECK_LT(camera_index, nframe_a.landmark_indices.size());
+  CHECK_LT(camera_index, nframe_b.landmark_indices.size());
+  const Eigen::VectorXi& landmark_indices_a = nframe_a.landmark_indices[camera_index];
+  const Eigen::VectorXi& landmark_indices_b = nframe_b.landmark_indices[camera_index];
+  std::unordered_map<int, int> landmark_to_keypoint_b;
+  landmark_to_keypoint_b.reserve(landmark_indices_b.size());
+  for (int i = 0; i < landmark_indices_b.size(); ++i) {
+    if (landmark_indices_b(i) >= 0) {
+      landmark_to_keypoint_b.emplace(landmark_indices_b(i), i);
+    }
+  }
+  std::vector<std::pair<int, int>> correspondences_a_b;
+  for (int i = 0; i < landmark_indices_a.size(); ++i) {
+    if (landmark_indices_a(i) < 0) {
+      continue;
+    }
+    const std::unordered_map<int, int>::const_iterator it =
+        landmark_to_keypoint_b.find(landmark_indices_a(i));
+    if (it != landmark_to_keypoint_b.end()) {
+      correspondences_a_b.emplace_back(i, it->second);
+    }
+  }
+  return correspondences_a_b;
+}
+
+const Transformation& SyntheticScene::get_T_G_B(size_t frame_index) const {
+  CHECK_LT(frame_index, T_G_Bs_.size());
+  return T_G_Bs_[frame_index];
+}
+
+Transformation SyntheticScene::get_T_Ca_Cb(
+    size_t frame_index_a, size_t frame_index_b, size_t camera_index) const {
+  const Transformation& T_C_B = ncamera_->get_T_C_B(camera_index);
+  return T_C_B * get_T_G_B(frame_index_a).inverse() * get_T_G_B(frame_index_b) *
+      T_C_B.inverse();
+}
+
+int64_t SyntheticScene::getTimestampNanoseconds(size_t frame_index) const {
+  return options_.start_timestamp_nanoseconds +
+      static_cast<int64_t>(frame_index) * options_.frame_period_nanoseconds;
+}
+
+}  // namespace simulation
+}  // namespace aslam
@@ -0,0 +1,150 @@
+#include <utility>
+#include <vector>
+
+#include <eigen-checks/gtest.h>
+#include <gtest/gtest.h>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <aslam/simulation/synthetic-scene.h>
+
+namespace aslam {
+namespace simulation {
+
+class SyntheticSceneTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ncamera_ = NCamera::createSurroundViewTestNCamera();
+    options_.num_landmarks = 5000u;
+    options_.num_frames = 20u;
+  }
+
+  NCamera::Ptr ncamera_;
+  SyntheticScene::Options options_;
+};
+
+TEST_F(SyntheticSceneTest, FramesAreDeterministicAndIndependentOfTheOrder) {
+  const SyntheticScene scene(ncamera_, options_);
+  const std::vector<SyntheticNFrame> nframes = scene.createAllNFrames();
+  ASSERT_EQ(nframes.size(), options_.num_frames);
+
+  const SyntheticScene other_scene(ncamera_, options_);
+  for (const size_t frame_idx : {7u, 0u, 19u}) {
+    const SyntheticNFrame nframe = other_scene.createNFrame(frame_idx);
+    for (size_t camera_idx = 0u; camera_idx < ncamera_->getNumCameras(); ++camera_idx) {
+      const VisualFrame& frame = nframe.nframe->getFrame(camera_idx);
+      const VisualFrame& expected_frame = nframes[frame_idx].nframe->getFrame(camera_idx);
+      EXPECT_TRUE(EIGEN_MATRIX_EQUAL(
+          frame.getKeypointMeasurements(), expected_frame.getKeypointMeasurements()));
+      EXPECT_TRUE(EIGEN_MATRIX_EQUAL(frame.getDescriptors(), expected_frame.getDescriptors()));
+      EXPECT_TRUE(EIGEN_MATRIX_EQUAL(
+          nframe.landmark_indices[camera_idx], nframes[frame_idx].landmark_indices[camera_idx]));
+      EXPECT_EQ(frame.getTimestampNanoseconds(), scene.getTimestampNanoseconds(frame_idx));
+    }
+  }
+}
+
+TEST_F(SyntheticSceneTest, InliersAreProjectionsOfTheirLandmarks) {
+  const SyntheticScene scene(ncamera_, options_);
+  const size_t kFrameIdx = 5u;
+  const SyntheticNFrame nframe = scene.createNFrame(kFrameIdx);
+  size_t num_inliers = 0u;
+  size_t num_outliers = 0u;
+  for (size_t camera_idx = 0u; camera_idx < ncamera_->getNumCameras(); ++camera_idx) {
+    const VisualFrame& frame = nframe.nframe->getFrame(camera_idx);
+    const Eigen::VectorXi& landmark_indices = nframe.landmark_indices[camera_idx];
+    ASSERT_EQ(static_cast<size_t>(landmark_indices.size()), frame.getNumKeypointMeasurements());
+    const Transformation T_C_G =
+        ncamera_->get_T_C_B(camera_idx) * scene.get_T_G_B(kFrameIdx).inverse();
+    for (int i = 0; i < landmark_indices.size(); ++i) {
+      if (landmark_indices(i) < 0) {
+        ++num_outliers;
+        continue;
+      }
+      ++num_inliers;
+      Eigen::Vector2d keypoint;
+      ASSERT_TRUE(ncamera_->getCamera(camera_idx).project3(
+          T_C_G.transform(scene.getLandmarks().col(landmark_indices(i))),
+          &keypoint).isKeypointVisible());
+      EXPECT_LT((keypoint - frame.getKeypointMeasurement(i)).norm(),
+                6.0 * options_.keypoint_noise_px);
+    }
+  }
+  EXPECT_GT(num_inliers, 100u);
+  EXPECT_NEAR(static_cast<double>(num_outliers) / num_inliers, options_.outlier_ratio, 0.01);
+}
+
+TEST_F(SyntheticSceneTest, GroundTruthCorrespondencesObserveTheSameLandmark) {
+  const SyntheticScene scene(ncamera_, options_);
+  const SyntheticNFrame nframe_a = scene.createNFrame(3u);
+  const SyntheticNFrame nframe_b = scene.createNFrame(4u);
+  const size_t kCameraIdx = 0u;
+  const std::vector<std::pair<int, int>> correspondences_a_b =
+      SyntheticScene::getGroundTruthCorrespondences(nframe_a, nframe_b, kCameraIdx);
+  EXPECT_GT(correspondences_a_b.size(), 50u);
+  for (const std::pair<int, int>& correspondence : correspondences_a_b) {
+    const int landmark_idx = nframe_a.landmark_indices[kCameraIdx](correspondence.first);
+    EXPECT_GE(landmark_idx, 0);
+    EXPECT_EQ(landmark_idx, nframe_b.landmark_indices[kCameraIdx](correspondence.second));
+  }
+}
+
+TEST_F(SyntheticSceneTest, KeypointsPerFrameAreLimited) {
+  options_.max_num_keypoints_per_frame = 100u;
+  options_.trajectory_type = TrajectoryType::kStraight;
+  const SyntheticScene scene(ncamera_, options_);
+  const SyntheticNFrame nframe = scene.createNFrame(0u);
+  for (size_t camera_idx = 0u; camera_idx < ncamera_->getNumCameras(); ++camera_idx) {
+    EXPECT_LE(nframe.nframe->getFrame(camera_idx).getNumKeypointMeasurements(),
+              options_.max_num_keypoints_per_frame);
+  }
+}
+
+TEST(SyntheticRotationSceneTest, RotationPredictsTheKeypointsOfTheNextFrame) {
+  const NCamera::Ptr ncamera = createPinholeNCamera(752u, 480u);
+  SyntheticScene::Options options;
+  options.num_frames = 3u;
+  options.trajectory_type = TrajectoryType::kRotation;
+  options.position_noise_m = 0.0;
+  options.orientation_noise_rad = 0.0;
+  options.add_raw_images = true;
+  const size_t kNumKeypoints = 500u;
+  const SyntheticScene::Ptr scene =
+      SyntheticScene::createWithNumKeypointsPerFrame(ncamera, kNumKeypoints, options);
+
+  const size_t kCameraIdx = 0u;
+  const Camera& camera = ncamera->getCamera(kCameraIdx);
+  const SyntheticNFrame nframe_k = scene->createNFrame(1u);
+  const SyntheticNFrame nframe_kp1 = scene->createNFrame(2u);
+  const VisualFrame& frame_k = nframe_k.nframe->getFrame(kCameraIdx);
+  const VisualFrame& frame_kp1 = nframe_kp1.nframe->getFrame(kCameraIdx);
+  EXPECT_LE(frame_k.getNumKeypointMeasurements(), kNumKeypoints);
+  EXPECT_GT(frame_k.getNumKeypointMeasurements(), 9u * kNumKeypoints / 10u);
+  ASSERT_TRUE(frame_k.hasRawImage());
+  EXPECT_EQ(static_cast<int>(camera.imageWidth()), frame_k.getRawImage().cols);
+  EXPECT_EQ(static_cast<int>(camera.imageHeight()), frame_k.getRawImage().rows);
+
+  const Transformation T_Ckp1_Ck = scene->get_T_Ca_Cb(2u, 1u, kCameraIdx);
+  EXPECT_LT(T_Ckp1_Ck.getPosition().norm(), 1e-12);
+  const std::vector<std::pair<int, int>> correspondences_k_kp1 =
+      SyntheticScene::getGroundTruthCorrespondences(nframe_k, nframe_kp1, kCameraIdx);
+  EXPECT_GT(correspondences_k_kp1.size(), kNumKeypoints / 2u);
+  for (const std::pair<int, int>& correspondence : correspondences_k_kp1) {
+    Eigen::Vector3d C_ray_k;
+    ASSERT_TRUE(camera.backProject3(
+        frame_k.getKeypointMeasurement(correspondence.first), &C_ray_k));
+    Eigen::Vector2d predicted_keypoint_kp1;
+    camera.project3(T_Ckp1_Ck.getRotation().rotate(C_ray_k), &predicted_keypoint_kp1);
+    EXPECT_LT((predicted_keypoint_kp1 -
+               frame_kp1.getKeypointMeasurement(correspondence.second)).norm(),
+              8.0 * options.keypoint_noise_px);
+  }
+}
+
+}  // namespace simulation
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,73 @@
+#ifndef ASLAM_GYRO_TRACKER_NCAMERA_H_
+#define ASLAM_GYRO_TRACKER_NCAMERA_H_
+
+#include <memory>
+#include <vector>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/macros.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/common/thread-pool.h>
+#include <aslam/matcher/match.h>
+#include <opencv2/features2d/features2d.hpp>
+
+#include "aslam/tracker/feature-tracker-gyro.h"
+
+namespace aslam {
+class VisualNFrame;
+class VisualNPipeline;
+
+/// \class GyroNCameraTracker
+/// \brief Runs one GyroTracker per camera of a camera rig, all cameras of an nframe in parallel.
+///
+/// The tracker of a camera only runs on one thread at a time, as every camera is an exclusivity
+/// group of the thread pool. The interframe rotation of every camera is derived from the rotation
+/// of the rig body frame.
+class GyroNCameraTracker {
+ public:
+  ASLAM_POINTER_TYPEDEFS(GyroNCameraTracker);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(GyroNCameraTracker);
+
+  /// \brief Construct the trackers.
+  /// @param[in] ncamera       The camera rig, the trackers refer to its cameras.
+  /// @param[in] min_distance_to_image_border See GyroTracker.
+  /// @param[in] extractors    One descriptor extractor per camera. The extractors are used
+  ///                          concurrently, hence must not be shared between cameras.
+  /// @param[in] num_threads   The number of threads tracking the cameras.
+  GyroNCameraTracker(const NCamera::ConstPtr& ncamera, size_t min_distance_to_image_border,
+                     const std::vector<cv::Ptr<cv::DescriptorExtractor>>& extractors,
+                     size_t num_threads);
+  ~GyroNCameraTracker();
+
+  /// \brief Track the features of all cameras between two nframes.
+  /// @param[in]  q_Bkp1_Bk      Rotation of the rig body frame between the two nframes, e.g.
+  ///                            integrated from the gyroscope.
+  /// @param[in]  nframe_k       The previous nframe, all frames must be set.
+  /// @param[out] nframe_kp1     The current nframe, all frames must be set. LK-tracked keypoints
+  ///                            are appended to its frames, see GyroTracker::track().
+  /// @param[out] matches_kp1_k  The matches of every camera, indexed like the cameras.
+  ///
+  /// The cameras are tracked with the deadline of the calling thread, see
+  /// common::DeadlineScope. Their degradations are only added to the frames of nframe_kp1.
+  void track(const Quaternion& q_Bkp1_Bk, const VisualNFrame& nframe_k,
+             VisualNFrame* nframe_kp1,
+             std::vector<FrameToFrameMatchesWithScore>* matches_kp1_k);
+
+  size_t getNumCameras() const { return trackers_.size(); }
+  GyroTracker& getTracker(size_t camera_index);
+
+  /// \brief Pass the detection masks of the last track() call to the pipeline, such that its
+  ///        next images are only searched for new keypoints where no keypoints are tracked.
+  ///        Requires the detection mask mode of GyroTrackerSettings, otherwise the masks are
+  ///        empty and the whole images are searched.
+  void setDetectionMasks(VisualNPipeline* pipeline) const;
+
+ private:
+  const NCamera::ConstPtr ncamera_;
+  std::vector<std::unique_ptr<GyroTracker>> trackers_;
+  ThreadPool thread_pool_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_GYRO_TRACKER_NCAMERA_H_
@@ -1,12 +1,16 @@
 #ifndef ASLAM_GYRO_TRACKER_H_
 #define ASLAM_GYRO_TRACKER_H_
 
+#include <algorithm>
 #include <array>
-#include <deque>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
 #include <aslam/common/macros.h>
+#include <aslam/common/occupancy-grid.h>
+#include <aslam/common/unique-id.h>
+#include <aslam/matcher/gyro-two-frame-matcher.h>
 #include <Eigen/Dense>
 #include <glog/logging.h>
 #include <opencv2/features2d/features2d.hpp>
@@ -14,8 +18,10 @@
 #include "aslam/tracker/feature-tracker.h"
 
 namespace aslam {
-class VisualFrame;
 class Camera;
+class CudaImageCache;
+class CudaLkTracker;
+class VisualFrame;
 
 struct GyroTrackerSettings {
   GyroTrackerSettings();
@@ -30,6 +36,35 @@ struct GyroTrackerSettings {
   int lk_operation_flag;
   double lk_min_eigenvalue_threshold;
 
+  // Adaptive LK mode: the window size, the number of pyramid levels and the iteration count are
+  // chosen per call from the gyro predicted keypoint displacement. The fixed parameters above act
+  // as upper bounds.
+  bool lk_adaptive_window;
+  int lk_adaptive_min_window_size;
+  int lk_adaptive_max_iterations;
+  double lk_adaptive_base_residual_px;
+  double lk_adaptive_residual_ratio;
+
+  // Detection mask mode: after tracking, the parts of the image covered by the keypoints of frame
+  // (k+1) are masked (see GyroTracker::getDetectionMask()), such that the pipeline only detects
+  // new keypoints in the free parts. The keypoints in the masked parts can only be tracked with
+  // LK, hence all unmatched keypoints are LK candidates in this mode.
+  bool detection_mask_enabled;
+  double detection_mask_cell_size_px;
+  double detection_mask_radius_px;
+  size_t detection_mask_max_points_per_cell;
+
+  // Descriptor keyframe cadence: only every lk_descriptor_keyframe_interval-th track() call
+  // extracts descriptors for the LK-tracked keypoints, in all other calls they carry forward the
+  // descriptor of the keypoint they were tracked from. With the detection mask mode, the mask
+  // before a keyframe is left empty, such that the pipeline re-detects and describes the whole
+  // keyframe while the frames in between only describe their newly detected keypoints. 1
+  // describes every LK-tracked keypoint.
+  size_t lk_descriptor_keyframe_interval;
+
+  // Coarse-to-fine descriptor matching for large motion, see GyroTwoFrameMatcher.
+  bool matcher_coarse_to_fine;
+
   // Keypoint uncertainty.
   static constexpr double kKeypointUncertaintyPx = 0.8;
 };
@@ -54,7 +89,7 @@ class GyroTracker : public FeatureTracker{
   explicit GyroTracker(const Camera& camera,
                        const size_t min_distance_to_image_border,
                        const cv::Ptr<cv::DescriptorExtractor>& extractor_ptr);
-  virtual ~GyroTracker() {}
+  virtual ~GyroTracker();
 
   /// \brief Track features between the current and the previous frames using a given interframe
   ///        rotation q_Ckp1_Ck to predict the feature positions.
@@ -67,13 +102,32 @@ class GyroTracker : public FeatureTracker{
   /// @param[out] matches_kp1_k  Vector of structs containing the found matches. Indices
   ///                            correspond to the ordering of the keypoint/descriptor vector in the
   ///                            respective frame channels.
+  ///
+  /// Within a common::DeadlineScope, the matcher shrinks its search (see GyroTwoFrameMatcher)
+  /// and the LK tracking is skipped once the deadline expired. The applied degradations are
+  /// added to frame (k+1), see VisualFrame::getDegradations().
   virtual void track(const Quaternion& q_Ckp1_Ck,
                      const VisualFrame& frame_k,
                      VisualFrame* frame_kp1,
                      FrameToFrameMatchesWithScore* matches_kp1_k) override;
 
+  /// \brief Run the LK tracking on the CUDA device, see CudaLkTracker. Keeps the CPU tracking
+  ///        if the CUDA backend is not available. The minimum eigenvalue threshold and the
+  ///        termination epsilon of the settings only apply to the CPU tracking.
+  /// @param[in] device_images  Device images uploaded by the pipeline, can be null.
+  void enableCudaLkTracking(const std::shared_ptr<const CudaImageCache>& device_images);
+
+  bool isCudaLkTrackingEnabled() const { return static_cast<bool>(cuda_lk_tracker_); }
+
+  /// \brief The mask of the parts of frame (k+1) of the last track() call that are free of
+  ///        keypoints, 255 where the next frame should detect new keypoints and 0 elsewhere. A
+  ///        cell is masked entirely once it contains detection_mask_max_points_per_cell
+  ///        keypoints. Pass it to VisualPipeline::setDetectionMask() of the camera. Empty if the
+  ///        detection mask mode is disabled or if the next frame is a descriptor keyframe.
+  const cv::Mat& getDetectionMask() const { return detection_mask_; }
+
  private:
-  enum class FeatureStatus {
+  enum class FeatureStatus : unsigned char {
     kDetected,
     kLkTracked
   };
@@ -81,8 +135,36 @@ class GyroTracker : public FeatureTracker{
   // first: index_k, second: index_km1.
   typedef std::pair<int, int> TrackedMatch;
   typedef std::vector<FeatureStatus> FrameFeatureStatus;
-  typedef std::vector<size_t> FrameStatusTrackLength;
-  typedef Eigen::VectorXi TrackIds;
+  typedef std::vector<uint32_t> FrameStatusTrackLength;
+  typedef std::vector<int> TrackIds;
+
+  /// \brief Fixed-capacity ring of the per-frame state arrays of the frames k and (k-1).
+  ///        Pushing a frame hands out the arrays of the dropped oldest frame for reuse, such that
+  ///        no memory is allocated once they have grown to the number of keypoints per frame.
+  template <typename FrameState>
+  class FrameStateHistory {
+   public:
+    static constexpr size_t kCapacity = 2u;
+    FrameStateHistory() : newest_(0u), size_(0u) {}
+
+    /// Returns the arrays of the new newest frame. They hold stale data and must be overwritten.
+    FrameState* push() {
+      newest_ = (newest_ + kCapacity - 1u) % kCapacity;
+      size_ = std::min(size_ + 1u, kCapacity);
+      return &frames_[newest_];
+    }
+    /// Age 0 is the newest frame.
+    const FrameState& operator[](size_t age) const {
+      DCHECK_LT(age, size_);
+      return frames_[(newest_ + age) % kCapacity];
+    }
+    size_t size() const { return size_; }
+
+   private:
+    std::array<FrameState, kCapacity> frames_;
+    size_t newest_;
+    size_t size_;
+  };
 
   /// Track candidate features from frame k to (k+1) with optical flow.
   /// Extract descriptors for successful tracks and insert keypoint
@@ -92,9 +174,16 @@ class GyroTracker : public FeatureTracker{
       const std::vector<unsigned char>& prediction_success,
       const std::vector<int>& lk_candidate_indices_k,
       const VisualFrame& frame_k,
+      bool extract_descriptors,
       VisualFrame* frame_kp1,
       FrameToFrameMatchesWithScore* matches_kp1_k);
 
+  /// Copy the descriptors of the given keypoints of frame k into the rows of descriptors_kp1.
+  /// Like the extractor, removes the keypoints whose descriptor support leaves the image.
+  void carryForwardDescriptors(
+      const VisualFrame& frame_k, const std::vector<int>& lk_definite_indices_k,
+      std::vector<cv::KeyPoint>* lk_cv_keypoints_kp1, cv::Mat* descriptors_kp1) const;
+
   /// In general, not all unmatched features will be tracked with the optical
   /// flow algorithm. This function computes the candidates that will be tracked.
   virtual void computeLKCandidates(
@@ -102,7 +191,7 @@ class GyroTracker : public FeatureTracker{
       const FrameStatusTrackLength& status_track_length_k,
       const VisualFrame& frame_k,
       const VisualFrame& frame_kp1,
-      std::vector<int>* lk_candidate_indices_k) const;
+      std::vector<int>* lk_candidate_indices_k);
 
   /// Compute matches from frame k and frame (k-1). They are called tracked
   /// matches since not all original matches get tracked (e.g. rejected by RANSAC).
@@ -113,7 +202,7 @@ class GyroTracker : public FeatureTracker{
   /// This function computes the indices of unmatched features in frame k.
   virtual void computeUnmatchedIndicesOfFrameK(
       const FrameToFrameMatchesWithScore& matches_kp1_k,
-      std::vector<int>* unmatched_indices_k) const;
+      std::vector<int>* unmatched_indices_k);
 
   /// Status track length is defined as the track length since the status
   /// (lk-tracked or detected) of the tracked feature has changed.
@@ -121,19 +210,27 @@ class GyroTracker : public FeatureTracker{
       const std::vector<TrackedMatch>& tracked_matches,
       FrameStatusTrackLength* status_track_length_k);
 
-  virtual void initializeFeatureStatusDeque();
+  virtual void initializeFeatureStatusHistory();
 
-  virtual void updateFeatureStatusDeque(
-      const FrameFeatureStatus& frame_feature_status_kp1);
+  /// Push the feature status of frame (k+1): the first num_detected keypoints are detected, the
+  /// following num_lk_tracked ones lk-tracked.
+  virtual void updateFeatureStatusHistory(size_t num_detected, size_t num_lk_tracked);
 
-  virtual void updateTrackIdDeque(
+  virtual void updateTrackIdHistory(
       const VisualFrame& new_frame_k);
 
-  /// Erase elements of a vector based on a set of indices.
-  template <typename Type>
-  void eraseVectorElementsByIndex(
-          const std::unordered_set<size_t>& indices_to_erase,
-          std::vector<Type>* vec) const;
+  /// Choose the LK parameters of the adaptive mode from the predicted displacement of the
+  /// candidates.
+  void computeAdaptiveLkParameters(
+      const std::vector<cv::Point2f>& lk_cv_points_k,
+      const std::vector<cv::Point2f>& lk_cv_points_kp1, cv::Size* lk_window_size,
+      int* lk_max_pyramid_levels, cv::TermCriteria* lk_termination_criteria);
+
+  /// Mask the parts of the frame that are covered by its keypoints into detection_mask_.
+  void computeDetectionMask(const VisualFrame& frame);
+
+  /// Build the LK pyramid of an image with the tracker settings into the given buffers.
+  void buildImagePyramid(const cv::Mat& image, std::vector<cv::Mat>* image_pyramid) const;
 
   /// The camera model used in the tracker.
   const aslam::Camera& camera_;
@@ -144,38 +241,57 @@ class GyroTracker : public FeatureTracker{
   const cv::Ptr<cv::DescriptorExtractor> extractor_;
   /// Remember if we have initialized already.
   bool initialized_;
+  /// Number of track() calls, used for the descriptor keyframe cadence.
+  size_t num_tracked_frames_;
   // Store track IDs of frame k and (k-1) in that order.
-  std::deque<TrackIds> track_ids_k_km1_;
+  FrameStateHistory<TrackIds> track_ids_k_km1_;
   /// Keep feature status for every index. For frames k and km1 in that order.
-  std::deque<FrameFeatureStatus> feature_status_k_km1_;
-  /// Keep status track length of frame (k-1) for every index.
+  FrameStateHistory<FrameFeatureStatus> feature_status_k_km1_;
+  /// Keep status track length of frames k and (k-1) for every index, swapped after every call.
   /// Status track length refers to the track length
   /// since the status of the feature has changed.
+  FrameStatusTrackLength status_track_length_k_;
   FrameStatusTrackLength status_track_length_km1_;
 
+  /// Buffers of track() and the LK candidate selection, kept to reuse their capacity.
+  Eigen::Matrix2Xd predicted_keypoint_positions_kp1_;
+  std::vector<unsigned char> prediction_success_;
+  std::vector<TrackedMatch> tracked_matches_;
+  std::vector<int> lk_candidate_indices_k_;
+  std::vector<int> unmatched_indices_k_;
+  std::vector<bool> is_unmatched_k_;
+  std::vector<std::pair<int, size_t>> indices_detected_and_tracked_;
+  std::vector<std::pair<int, size_t>> indices_lktracked_;
+  /// Matcher of the keypoints of frame k and (k+1), reused for every frame pair.
+  GyroTwoFrameMatcher matcher_;
+
+  /// LK pyramid of frame k built by the tracker, i.e. of frame (k+1) of the previous call. Only
+  /// used if the pipeline doesn't provide the pyramids.
+  std::vector<cv::Mat> image_pyramid_k_;
+  std::vector<cv::Mat> image_pyramid_kp1_;
+  FrameId image_pyramid_frame_id_k_;
+  bool has_image_pyramid_k_;
+
+  // LK tracking on the CUDA device, the CPU tracking is used if null.
+  std::unique_ptr<CudaLkTracker> cuda_lk_tracker_;
+
+  /// Buffers of lkTracking(), kept to reuse their capacity.
+  std::vector<int> lk_definite_indices_k_;
+  std::vector<cv::Point2f> lk_cv_points_k_;
+  std::vector<cv::Point2f> lk_cv_points_kp1_;
+  std::vector<unsigned char> lk_tracking_success_;
+  std::vector<float> lk_tracking_errors_;
+  std::vector<bool> lk_keep_mask_;
+  std::vector<cv::KeyPoint> lk_cv_keypoints_kp1_;
+  std::vector<float> lk_predicted_displacements_px_;
+
+  /// Detection mask mode, the grid is null if disabled.
+  std::unique_ptr<common::WeightedOccupancyGrid<>> detection_mask_grid_;
+  cv::Mat detection_mask_;
+
   const GyroTrackerSettings settings_;
 };
 
-template <typename Type>
-void GyroTracker::eraseVectorElementsByIndex(
-        const std::unordered_set<size_t>& indices_to_erase,
-        std::vector<Type>* vec) const {
-  CHECK_NOTNULL(vec);
-    std::vector<bool> erase_index(vec->size(), false);
-    for (const size_t i: indices_to_erase) {
-        erase_index[i] = true;
-    }
-    std::vector<bool>::const_iterator it_to_erase = erase_index.begin();
-    typename std::vector<Type>::iterator it_erase_from = std::remove_if(
-        vec->begin(), vec->end(),
-        [&it_to_erase](const Type& whatever) -> bool {
-          return *it_to_erase++ == true;
-        }
-    );
-    vec->erase(it_erase_from, vec->end());
-    vec->shrink_to_fit();
-}
-
 } // namespace aslam
 
 #endif  // ASLAM_GYRO_TRACKER_H_
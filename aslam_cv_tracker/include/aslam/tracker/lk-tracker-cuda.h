@@ -0,0 +1,44 @@
+#ifndef ASLAM_LK_TRACKER_CUDA_H_
+#define ASLAM_LK_TRACKER_CUDA_H_
+
+#include <memory>
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <opencv2/core/core.hpp>
+
+namespace aslam {
+class CudaImageCache;
+class VisualFrame;
+
+/// \class CudaLkTracker
+/// \brief Pyramidal Lucas-Kanade tracking on a CUDA device (cv::cuda::SparsePyrLKOpticalFlow).
+///
+/// The frame images are taken from a CudaImageCache filled by the pipeline if possible.
+/// Otherwise the raw images are uploaded, the image of frame (k+1) is kept on the device for
+/// the next call. Only usable if isCudaBackendAvailable() returns true. Not thread-safe.
+class CudaLkTracker {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(CudaLkTracker);
+
+  /// @param[in] device_images Device images of the pipeline, can be null.
+  explicit CudaLkTracker(const std::shared_ptr<const CudaImageCache>& device_images);
+  ~CudaLkTracker();
+
+  /// \brief Track the points from frame k to (k+1).
+  /// @param[in]     points_k         The points in frame k.
+  /// @param[in,out] points_kp1       The initial guesses, overwritten by the tracked points.
+  /// @param[out]    tracking_success Nonzero for the successfully tracked points.
+  void track(const VisualFrame& frame_k, const VisualFrame& frame_kp1,
+             const cv::Size& window_size, int max_pyramid_levels, int max_iterations,
+             const std::vector<cv::Point2f>& points_k, std::vector<cv::Point2f>* points_kp1,
+             std::vector<unsigned char>* tracking_success);
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_LK_TRACKER_CUDA_H_
@@ -1,8 +1,9 @@
 #ifndef ASLAM_TRACK_MANAGER_H_
 #define ASLAM_TRACK_MANAGER_H_
 
-#include <mutex>
+#include <atomic>
 #include <unordered_set>
+#include <vector>
 
 #include <aslam/matcher/match.h>
 #include <glog/logging.h>
@@ -11,27 +12,29 @@ namespace aslam {
   struct MatchWithScore;
   class VisualNFrame;
 
+  /// \brief Lock-free provider of consecutive ids.
   template<typename IdType>
   class ThreadSafeIdProvider {
    public:
-    ThreadSafeIdProvider(IdType initial_id) : initial_id_(initial_id) {
-      reset();
-    }
+    ThreadSafeIdProvider(IdType initial_id) : id_(initial_id), initial_id_(initial_id) {}
 
     IdType getNewId() {
-      std::lock_guard<std::mutex> lock(mutex_);
-      return id_++;
+      return id_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// \brief Reserve num_ids consecutive ids at once.
+    /// @return The first id of the range [first, first + num_ids).
+    IdType reserveIds(IdType num_ids) {
+      return id_.fetch_add(num_ids, std::memory_order_relaxed);
     }
 
     void reset() {
-      std::lock_guard<std::mutex> lock(mutex_);
-      id_ = initial_id_;
+      id_.store(initial_id_, std::memory_order_relaxed);
     }
 
    private:
-    std::mutex mutex_;
-    IdType id_;
-    IdType initial_id_;
+    std::atomic<IdType> id_;
+    const IdType initial_id_;
   };
 
   /// \brief The Track manager assigns track ids to the given matches with different strategies.
@@ -147,6 +150,25 @@ namespace aslam {
     double match_score_very_strong_new_tracks_threshold_;
   };
 
+  /// \brief Same as addToSetsAndCheckExclusiveness() with bitmaps indexed by keypoint, which
+  ///        must be sized to the number of keypoints of the respective frame.
+  inline void markConsumedAndCheckExclusiveness(
+      int index_apple, int index_banana, std::vector<bool>* consumed_apples,
+      std::vector<bool>* consumed_bananas) {
+    CHECK_NOTNULL(consumed_apples);
+    CHECK_NOTNULL(consumed_bananas);
+    CHECK_GE(index_apple, 0);
+    CHECK_LT(index_apple, static_cast<int>(consumed_apples->size()));
+    CHECK_GE(index_banana, 0);
+    CHECK_LT(index_banana, static_cast<int>(consumed_bananas->size()));
+    CHECK(!(*consumed_apples)[index_apple]) << "The given matches don't seem to be exclusive."
+        " Trying to assign apple " << index_apple << " more than once!";
+    (*consumed_apples)[index_apple] = true;
+    CHECK(!(*consumed_bananas)[index_banana]) << "The given matches don't seem to be "
+        "exclusive. Trying to assign banana " << index_banana << " more than once!";
+    (*consumed_bananas)[index_banana] = true;
+  }
+
   inline void addToSetsAndCheckExclusiveness(
       int index_apple, int index_banana, std::unordered_set<int>* consumed_apples,
       std::unordered_set<int>* consumed_bananas) {
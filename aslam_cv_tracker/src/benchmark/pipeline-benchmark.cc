@@ -0,0 +1,291 @@
+// Replays a recorded multi-camera image sequence through
+// VisualNPipeline -> GyroTracker -> UniformTrackManager and reports the throughput, the per-stage
+// latencies, the number of heap allocations per nframe and the peak resident set size as JSON.
+//
+// The dataset is expected in the ASL/EuRoC layout:
+//   <dataset_dir>/cam<i>/data.csv    Lines "timestamp_ns,filename", '#' starts a comment.
+//   <dataset_dir>/cam<i>/data/<filename>
+// The tracker is run with the identity as interframe rotation as no gyro data is replayed.
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/allocation-counter.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/common/trace-recorder.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <aslam/pipeline/visual-npipeline.h>
+#include <aslam/pipeline/visual-pipeline-brisk.h>
+#include <aslam/tracker/feature-tracker-gyro.h>
+#include <aslam/tracker/track-manager.h>
+#include <brisk/brisk.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <opencv2/highgui/highgui.hpp>
+
+DEFINE_string(benchmark_dataset_dir, "", "Directory containing the cam<i> folders.");
+DEFINE_string(benchmark_ncamera_yaml, "", "Calibration of the camera system.");
+DEFINE_string(benchmark_output_json, "", "Write the results to this file instead of stdout.");
+DEFINE_int32(benchmark_num_threads, 4, "Number of VisualNPipeline worker threads.");
+DEFINE_int32(benchmark_max_output_queue_size, 5,
+             "Block the image producer once this many nframes wait for the tracker.");
+DEFINE_int32(benchmark_max_num_nframes, -1, "Stop after this many nframes, -1 replays all.");
+DEFINE_int64(benchmark_timestamp_tolerance_ns, 1000000,
+             "Images closer than this are grouped into one nframe.");
+DEFINE_bool(benchmark_preload_images, true,
+            "Load all images before the replay so that disk IO is not measured.");
+DEFINE_int32(benchmark_brisk_octaves, 0, "BRISK octaves.");
+DEFINE_double(benchmark_brisk_uniformity_radius, 5.0, "BRISK uniformity radius.");
+DEFINE_double(benchmark_brisk_absolute_threshold, 45.0, "BRISK absolute threshold.");
+DEFINE_int32(benchmark_brisk_max_num_keypoints, 1000, "BRISK max. number of keypoints.");
+DEFINE_int32(benchmark_keypoint_budget, 0,
+             "If positive, use the keypoint budget mode of the BRISK pipeline.");
+
+namespace aslam {
+namespace {
+
+struct ImageRecord {
+  int64_t timestamp_nanoseconds;
+  std::string path;
+  cv::Mat image;
+};
+
+// Returns the images of one camera ordered as in the csv file.
+std::vector<ImageRecord> readImageList(const std::string& camera_dir) {
+  std::ifstream csv(camera_dir + "/data.csv");
+  CHECK(csv.is_open()) << "Could not open " << camera_dir << "/data.csv.";
+  std::vector<ImageRecord> records;
+  std::string line;
+  while (std::getline(csv, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    const size_t separator = line.find(',');
+    CHECK_NE(separator, std::string::npos) << "Malformed line: " << line;
+    std::string filename = line.substr(separator + 1u);
+    // Strip whitespace and Windows line endings.
+    filename.erase(0u, filename.find_first_not_of(" \t"));
+    filename.erase(filename.find_last_not_of(" \t\r") + 1u);
+
+    ImageRecord record;
+    record.timestamp_nanoseconds = std::stoll(line.substr(0u, separator));
+    record.path = camera_dir + "/data/" + filename;
+    records.emplace_back(std::move(record));
+  }
+  return records;
+}
+
+cv::Mat loadImage(const ImageRecord& record) {
+  if (!record.image.empty()) {
+    return record.image;
+  }
+  cv::Mat image = cv::imread(record.path, cv::IMREAD_GRAYSCALE);
+  CHECK(!image.empty()) << "Could not load " << record.path << ".";
+  return image;
+}
+
+int64_t getPeakResidentSetSizeKilobytes() {
+  struct rusage usage;
+  CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+  // Linux reports kilobytes.
+  return static_cast<int64_t>(usage.ru_maxrss);
+}
+
+void writeStageSummaryJson(const common::TraceRecorder& recorder, std::ostream* out) {
+  CHECK_NOTNULL(out);
+  *out << "  \"stages_ms\": {";
+  bool first = true;
+  for (int i = 0; i < static_cast<int>(common::TraceStage::kNumStages); ++i) {
+    const common::TraceStage stage = static_cast<common::TraceStage>(i);
+    const common::TraceRecorder::StageSummary summary = recorder.getStageSummary(stage);
+    if (summary.num_events == 0u) {
+      continue;
+    }
+    *out << (first ? "" : ",") << "\n    \"" << common::getTraceStageName(stage) << "\": {"
+         << "\"count\": " << summary.num_events
+         << ", \"mean\": " << summary.mean_nanoseconds * 1e-6
+         << ", \"p50\": " << summary.p50_nanoseconds * 1e-6
+         << ", \"p99\": " << summary.p99_nanoseconds * 1e-6
+         << ", \"max\": " << summary.max_nanoseconds * 1e-6 << "}";
+    first = false;
+  }
+  *out << "\n  }";
+}
+
+int runBenchmark() {
+  CHECK(!FLAGS_benchmark_dataset_dir.empty()) << "Set --benchmark_dataset_dir.";
+  CHECK(!FLAGS_benchmark_ncamera_yaml.empty()) << "Set --benchmark_ncamera_yaml.";
+  CHECK_GT(FLAGS_benchmark_num_threads, 0);
+
+  NCamera::Ptr camera_system = NCamera::loadFromYaml(FLAGS_benchmark_ncamera_yaml);
+  CHECK(camera_system) << "Could not load " << FLAGS_benchmark_ncamera_yaml << ".";
+  const size_t num_cameras = camera_system->numCameras();
+
+  // Load the image lists, the shortest camera sequence determines the number of nframes.
+  std::vector<std::vector<ImageRecord>> images(num_cameras);
+  size_t num_nframes = std::numeric_limits<size_t>::max();
+  for (size_t camera_index = 0u; camera_index < num_cameras; ++camera_index) {
+    images[camera_index] = readImageList(
+        FLAGS_benchmark_dataset_dir + "/cam" + std::to_string(camera_index));
+    num_nframes = std::min(num_nframes, images[camera_index].size());
+  }
+  if (FLAGS_benchmark_max_num_nframes >= 0) {
+    num_nframes = std::min(num_nframes, static_cast<size_t>(FLAGS_benchmark_max_num_nframes));
+  }
+  CHECK_GT(num_nframes, 1u) << "Need at least two nframes to track.";
+  if (FLAGS_benchmark_preload_images) {
+    for (std::vector<ImageRecord>& camera_images : images) {
+      for (size_t i = 0u; i < num_nframes; ++i) {
+        camera_images[i].image = loadImage(camera_images[i]);
+      }
+    }
+  }
+
+  // Set up the processing chain.
+  std::vector<VisualPipeline::Ptr> pipelines;
+  std::vector<std::unique_ptr<GyroTracker>> trackers;
+  const size_t kMinDistanceToImageBorderPx = 30u;
+  cv::Ptr<cv::DescriptorExtractor> tracker_extractor(
+      new brisk::BriskDescriptorExtractor(true, false));
+  for (size_t camera_index = 0u; camera_index < num_cameras; ++camera_index) {
+    std::shared_ptr<BriskVisualPipeline> pipeline = std::make_shared<BriskVisualPipeline>(
+        camera_system->getCameraShared(camera_index), false /*copy_images*/,
+        FLAGS_benchmark_brisk_octaves, FLAGS_benchmark_brisk_uniformity_radius,
+        FLAGS_benchmark_brisk_absolute_threshold, FLAGS_benchmark_brisk_max_num_keypoints,
+        true /*rotation_invariant*/, false /*scale_invariant*/);
+    if (FLAGS_benchmark_keypoint_budget > 0) {
+      const double kGridCellSizePx = 40.0;
+      pipeline->setKeypointBudget(FLAGS_benchmark_keypoint_budget, kGridCellSizePx,
+                                  FLAGS_benchmark_brisk_absolute_threshold * 0.1,
+                                  FLAGS_benchmark_brisk_absolute_threshold * 10.0);
+    }
+    pipelines.emplace_back(pipeline);
+    trackers.emplace_back(new GyroTracker(*camera_system->getCameraShared(camera_index),
+                                          kMinDistanceToImageBorderPx, tracker_extractor));
+  }
+  VisualNPipeline npipeline(FLAGS_benchmark_num_threads, pipelines, camera_system, camera_system,
+                            FLAGS_benchmark_timestamp_tolerance_ns);
+  const size_t kNumTrackingBucketsRoot = 4u;
+  const size_t kMaxNumWeakNewTracks = 200u;
+  const size_t kNumStrongNewTracksToForcePush = 50u;
+  const double kStrongNewTrackScoreThreshold = 0.85;
+  UniformTrackManager track_manager(kNumTrackingBucketsRoot, kMaxNumWeakNewTracks,
+                                    kNumStrongNewTracksToForcePush,
+                                    kStrongNewTrackScoreThreshold);
+
+  common::TraceRecorder& recorder = common::TraceRecorder::instance();
+  recorder.clear();
+  recorder.setEnabled(true);
+
+  // Feed the images from a separate thread to keep the pipeline saturated.
+  CHECK_GT(FLAGS_benchmark_max_output_queue_size, 0);
+  std::atomic<bool> producer_done(false);
+  const common::ProcessAllocationCounter allocation_counter;
+  const int64_t start_nanoseconds = common::TraceRecorder::now();
+  std::thread producer([&]() {
+    for (size_t i = 0u; i < num_nframes; ++i) {
+      for (size_t camera_index = 0u; camera_index < num_cameras; ++camera_index) {
+        const ImageRecord& record = images[camera_index][i];
+        npipeline.processImageBlockingIfFull(
+            camera_index, loadImage(record), record.timestamp_nanoseconds,
+            static_cast<size_t>(FLAGS_benchmark_max_output_queue_size));
+      }
+    }
+    npipeline.waitForAllWorkToComplete();
+    producer_done = true;
+  });
+
+  const Quaternion q_Ckp1_Ck;
+  std::shared_ptr<VisualNFrame> nframe_k;
+  size_t num_processed_nframes = 0u;
+  size_t num_tracked_features = 0u;
+  // Poll instead of blocking as incomplete nframes (e.g. missing images) are never published.
+  while (true) {
+    std::shared_ptr<VisualNFrame> nframe_kp1 = npipeline.getNext();
+    if (!nframe_kp1) {
+      if (producer_done && npipeline.getNumFramesComplete() == 0u) {
+        break;
+      }
+      std::this_thread::yield();
+      continue;
+    }
+    ++num_processed_nframes;
+    for (size_t camera_index = 0u; camera_index < num_cameras; ++camera_index) {
+      VisualFrame* frame_kp1 = nframe_kp1->getFrameShared(camera_index).get();
+      TrackManager::createAndGetTrackIdChannel(frame_kp1);
+      if (!nframe_k) {
+        continue;
+      }
+      VisualFrame* frame_k = nframe_k->getFrameShared(camera_index).get();
+      const int64_t timestamp_nanoseconds = frame_kp1->getTimestampNanoseconds();
+
+      FrameToFrameMatchesWithScore matches_kp1_k;
+      const int64_t track_start_nanoseconds = common::TraceRecorder::now();
+      trackers[camera_index]->track(q_Ckp1_Ck, *frame_k, frame_kp1, &matches_kp1_k);
+      const int64_t assign_start_nanoseconds = common::TraceRecorder::now();
+      track_manager.applyMatchesToFrames(matches_kp1_k, frame_kp1, frame_k);
+      const int64_t assign_end_nanoseconds = common::TraceRecorder::now();
+      recorder.record(common::TraceStage::kTrack, camera_index, timestamp_nanoseconds,
+                      track_start_nanoseconds, assign_start_nanoseconds);
+      recorder.record(common::TraceStage::kAssignTrackIds, camera_index, timestamp_nanoseconds,
+                      assign_start_nanoseconds, assign_end_nanoseconds);
+      num_tracked_features += matches_kp1_k.size();
+    }
+    nframe_k = nframe_kp1;
+  }
+  producer.join();
+  const int64_t end_nanoseconds = common::TraceRecorder::now();
+  const uint64_t num_allocations = allocation_counter.getNumAllocations();
+  npipeline.shutdown();
+  recorder.setEnabled(false);
+
+  const double wall_time_seconds = (end_nanoseconds - start_nanoseconds) * 1e-9;
+  CHECK_GT(num_processed_nframes, 0u);
+  std::ostringstream json;
+  json << "{\n"
+       << "  \"num_cameras\": " << num_cameras << ",\n"
+       << "  \"num_nframes\": " << num_processed_nframes << ",\n"
+       << "  \"num_threads\": " << FLAGS_benchmark_num_threads << ",\n"
+       << "  \"wall_time_s\": " << wall_time_seconds << ",\n"
+       << "  \"nframes_per_s\": " << num_processed_nframes / wall_time_seconds << ",\n"
+       << "  \"tracked_features_per_frame\": "
+       << static_cast<double>(num_tracked_features) /
+          static_cast<double>(num_processed_nframes * num_cameras) << ",\n"
+       << "  \"allocations_per_nframe\": "
+       << static_cast<double>(num_allocations) / static_cast<double>(num_processed_nframes)
+       << ",\n"
+       << "  \"peak_rss_kb\": " << getPeakResidentSetSizeKilobytes() << ",\n";
+  writeStageSummaryJson(recorder, &json);
+  json << "\n}\n";
+
+  if (FLAGS_benchmark_output_json.empty()) {
+    std::cout << json.str();
+  } else {
+    std::ofstream output(FLAGS_benchmark_output_json);
+    CHECK(output.is_open()) << "Could not open " << FLAGS_benchmark_output_json << ".";
+    output << json.str();
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace aslam
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  return aslam::runBenchmark();
+}
@@ -0,0 +1,266 @@
+// Micro benchmarks of the tracker stages on synthetic frames: predictKeypointsByRotation,
+// GyroTwoFrameMatcher::match, GyroTracker::track and UniformTrackManager::applyMatchesToFrames.
+// The results are reported as JSON, see pipeline-benchmark.cc for recorded sequences.
+//
+// The frames (k-1), k and (k+1) observe a simulation::SyntheticScene rotating in place by the
+// configured angle per frame, with pixel noise, missed detections, outliers and a few flipped
+// descriptor bits. The images are textured noise, so the LK iterations don't converge on true
+// correspondences but cost about the same.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/matcher/gyro-two-frame-matcher.h>
+#include <aslam/matcher/match-helpers.h>
+#include <aslam/simulation/synthetic-scene.h>
+#include <aslam/tracker/feature-tracker-gyro.h>
+#include <aslam/tracker/track-manager.h>
+#include <brisk/brisk.h>
+#include <Eigen/Core>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_string(benchmark_num_keypoints, "500,1000,2000,5000",
+              "Comma separated numbers of keypoints per frame.");
+DEFINE_string(benchmark_rotation_deg, "0.5,2,5",
+              "Comma separated interframe rotation angles in degrees.");
+DEFINE_string(benchmark_image_sizes, "752x480,1280x720",
+              "Comma separated image sizes <width>x<height>.");
+DEFINE_int32(benchmark_num_repetitions, 20, "Number of timed calls per configuration.");
+DEFINE_double(benchmark_keypoint_noise_px, 0.5, "Standard deviation of the keypoint noise.");
+DEFINE_string(benchmark_output_json, "", "Write the results to this file instead of stdout.");
+
+namespace aslam {
+namespace {
+
+const uint32_t kSeed = 42u;
+const size_t kDescriptorSizeBytes = 48u;
+const size_t kMinDistanceToImageBorderPx = 30u;
+const int64_t kFramePeriodNanoseconds = 50000000;
+
+struct Configuration {
+  uint32_t image_width;
+  uint32_t image_height;
+  size_t num_keypoints;
+  double rotation_deg;
+};
+
+/// Timings in milliseconds of the timed calls.
+struct StageTimings {
+  std::vector<double> durations_ms;
+
+  double getMean() const {
+    CHECK(!durations_ms.empty());
+    double sum = 0.0;
+    for (const double duration_ms : durations_ms) {
+      sum += duration_ms;
+    }
+    return sum / durations_ms.size();
+  }
+  double getPercentile(double percentile) const {
+    CHECK(!durations_ms.empty());
+    std::vector<double> sorted = durations_ms;
+    std::sort(sorted.begin(), sorted.end());
+    const size_t index = std::min<size_t>(
+        sorted.size() - 1u, static_cast<size_t>(percentile * sorted.size()));
+    return sorted[index];
+  }
+};
+
+template <typename Function>
+double measureMilliseconds(const Function& function) {
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  function();
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<std::string> splitList(const std::string& list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+std::vector<Configuration> parseConfigurations() {
+  std::vector<Configuration> configurations;
+  for (const std::string& image_size : splitList(FLAGS_benchmark_image_sizes)) {
+    const size_t separator = image_size.find('x');
+    CHECK_NE(separator, std::string::npos) << "Malformed image size: " << image_size;
+    for (const std::string& num_keypoints : splitList(FLAGS_benchmark_num_keypoints)) {
+      for (const std::string& rotation_deg : splitList(FLAGS_benchmark_rotation_deg)) {
+        Configuration configuration;
+        configuration.image_width = std::stoul(image_size.substr(0u, separator));
+        configuration.image_height = std::stoul(image_size.substr(separator + 1u));
+        configuration.num_keypoints = std::stoul(num_keypoints);
+        configuration.rotation_deg = std::stod(rotation_deg);
+        CHECK_GT(configuration.image_width, 2u * kMinDistanceToImageBorderPx);
+        CHECK_GT(configuration.image_height, 2u * kMinDistanceToImageBorderPx);
+        CHECK_GT(configuration.num_keypoints, 0u);
+        configurations.push_back(configuration);
+      }
+    }
+  }
+  return configurations;
+}
+
+void writeTimingsJson(const std::string& name, const StageTimings& timings, std::ostream* out) {
+  CHECK_NOTNULL(out);
+  *out << "\"" << name << "\": {\"mean\": " << timings.getMean()
+       << ", \"p50\": " << timings.getPercentile(0.5)
+       << ", \"p99\": " << timings.getPercentile(0.99)
+       << ", \"max\": " << timings.getPercentile(1.0) << "}";
+}
+
+void runConfiguration(const Configuration& configuration, std::ostream* json) {
+  CHECK_NOTNULL(json);
+  CHECK_GT(FLAGS_benchmark_num_repetitions, 0);
+  simulation::SyntheticScene::Options options;
+  options.num_frames = 3u;
+  options.frame_period_nanoseconds = kFramePeriodNanoseconds;
+  options.start_timestamp_nanoseconds = kFramePeriodNanoseconds;
+  options.trajectory_type = simulation::TrajectoryType::kRotation;
+  options.angular_speed_rad_s =
+      configuration.rotation_deg / 180.0 * M_PI / (kFramePeriodNanoseconds * 1e-9);
+  options.position_noise_m = 0.0;
+  options.orientation_noise_rad = 0.0;
+  options.descriptor_size_bytes = kDescriptorSizeBytes;
+  options.keypoint_noise_px = FLAGS_benchmark_keypoint_noise_px;
+  options.min_distance_to_image_border_px = kMinDistanceToImageBorderPx;
+  options.add_raw_images = true;
+  options.seed = kSeed;
+  const NCamera::Ptr ncamera =
+      simulation::createPinholeNCamera(configuration.image_width, configuration.image_height);
+  const simulation::SyntheticScene::Ptr scene =
+      simulation::SyntheticScene::createWithNumKeypointsPerFrame(
+          ncamera, configuration.num_keypoints, options);
+
+  const Camera::ConstPtr camera = ncamera->getCameraShared(0u);
+  const VisualFrame::Ptr frame_km1 = scene->createNFrame(0u).nframe->getFrameShared(0u);
+  const VisualFrame::Ptr frame_k = scene->createNFrame(1u).nframe->getFrameShared(0u);
+  const VisualFrame::Ptr frame_kp1 = scene->createNFrame(2u).nframe->getFrameShared(0u);
+  const Quaternion q_Ck_Ckm1 = scene->get_T_Ca_Cb(1u, 0u, 0u).getRotation();
+  const Quaternion q_Ckp1_Ck = scene->get_T_Ca_Cb(2u, 1u, 0u).getRotation();
+
+  const cv::Ptr<cv::DescriptorExtractor> extractor(
+      new brisk::BriskDescriptorExtractor(true, false));
+  const size_t kNumTrackingBucketsRoot = 4u;
+  const size_t kMaxNumWeakNewTracks = 200u;
+  const size_t kNumStrongNewTracksToForcePush = 50u;
+  const double kStrongNewTrackScoreThreshold = 0.85;
+  UniformTrackManager track_manager(kNumTrackingBucketsRoot, kMaxNumWeakNewTracks,
+                                    kNumStrongNewTracksToForcePush,
+                                    kStrongNewTrackScoreThreshold);
+
+  StageTimings predict_timings;
+  StageTimings match_timings;
+  StageTimings track_timings;
+  StageTimings assign_timings;
+  size_t num_matches = 0u;
+  size_t num_tracked = 0u;
+  // The matcher is long-lived like in the tracker and reuses its buffers across repetitions.
+  GyroTwoFrameMatcher matcher(static_cast<uint32_t>(camera->imageHeight()));
+  for (int repetition = 0; repetition < FLAGS_benchmark_num_repetitions; ++repetition) {
+    Eigen::Matrix2Xd predicted_keypoints_kp1;
+    std::vector<unsigned char> prediction_success;
+    predict_timings.durations_ms.push_back(measureMilliseconds([&]() {
+      predictKeypointsByRotation(*frame_k, q_Ckp1_Ck, &predicted_keypoints_kp1,
+                                 &prediction_success);
+    }));
+
+    FrameToFrameMatchesWithScore matches_kp1_k;
+    match_timings.durations_ms.push_back(measureMilliseconds([&]() {
+      matcher.match(q_Ckp1_Ck, *frame_kp1, *frame_k, predicted_keypoints_kp1,
+                    prediction_success, &matches_kp1_k);
+    }));
+    num_matches += matches_kp1_k.size();
+
+    // The tracker and the frames are modified by a call, start every repetition from copies
+    // and track frame (k-1) -> k first, such that the LK tracking of k -> (k+1) has candidates.
+    GyroTracker tracker(*camera, kMinDistanceToImageBorderPx, extractor);
+    VisualFrame tracked_frame_km1(*frame_km1);
+    VisualFrame tracked_frame_k(*frame_k);
+    VisualFrame tracked_frame_kp1(*frame_kp1);
+    FrameToFrameMatchesWithScore tracker_matches_k_km1;
+    tracker.track(q_Ck_Ckm1, tracked_frame_km1, &tracked_frame_k, &tracker_matches_k_km1);
+    track_manager.applyMatchesToFrames(tracker_matches_k_km1, &tracked_frame_k,
+                                       &tracked_frame_km1);
+
+    FrameToFrameMatchesWithScore tracker_matches_kp1_k;
+    track_timings.durations_ms.push_back(measureMilliseconds([&]() {
+      tracker.track(q_Ckp1_Ck, tracked_frame_k, &tracked_frame_kp1, &tracker_matches_kp1_k);
+    }));
+    num_tracked += tracker_matches_kp1_k.size();
+    assign_timings.durations_ms.push_back(measureMilliseconds([&]() {
+      track_manager.applyMatchesToFrames(tracker_matches_kp1_k, &tracked_frame_kp1,
+                                         &tracked_frame_k);
+    }));
+  }
+
+  *json << "    {\"image_width\": " << configuration.image_width
+        << ", \"image_height\": " << configuration.image_height
+        << ", \"num_keypoints\": " << configuration.num_keypoints
+        << ", \"rotation_deg\": " << configuration.rotation_deg
+        << ", \"num_repetitions\": " << FLAGS_benchmark_num_repetitions
+        << ",\n     \"matches_per_call\": "
+        << static_cast<double>(num_matches) / FLAGS_benchmark_num_repetitions
+        << ", \"tracked_per_call\": "
+        << static_cast<double>(num_tracked) / FLAGS_benchmark_num_repetitions
+        << ",\n     \"stages_ms\": {";
+  writeTimingsJson("predict_keypoints_by_rotation", predict_timings, json);
+  *json << ", ";
+  writeTimingsJson("gyro_two_frame_matcher", match_timings, json);
+  *json << ", ";
+  writeTimingsJson("gyro_tracker", track_timings, json);
+  *json << ", ";
+  writeTimingsJson("uniform_track_manager", assign_timings, json);
+  *json << "}}";
+}
+
+int runBenchmark() {
+  const std::vector<Configuration> configurations = parseConfigurations();
+  CHECK(!configurations.empty());
+
+  std::ostringstream json;
+  json << "{\n  \"configurations\": [\n";
+  for (size_t i = 0u; i < configurations.size(); ++i) {
+    LOG(INFO) << "Running " << configurations[i].image_width << "x"
+              << configurations[i].image_height << ", " << configurations[i].num_keypoints
+              << " keypoints, " << configurations[i].rotation_deg << " deg.";
+    runConfiguration(configurations[i], &json);
+    json << (i + 1u < configurations.size() ? ",\n" : "\n");
+  }
+  json << "  ]\n}\n";
+
+  if (FLAGS_benchmark_output_json.empty()) {
+    std::cout << json.str();
+  } else {
+    std::ofstream output(FLAGS_benchmark_output_json);
+    CHECK(output.is_open()) << "Could not open " << FLAGS_benchmark_output_json << ".";
+    output << json.str();
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace aslam
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  return aslam::runBenchmark();
+}
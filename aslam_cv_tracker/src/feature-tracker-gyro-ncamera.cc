@@ -0,0 +1,80 @@
+#include "aslam/tracker/feature-tracker-gyro-ncamera.h"
+
+#include <future>
+
+#include <aslam/common/deadline.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <aslam/pipeline/visual-npipeline.h>
+#include <glog/logging.h>
+
+namespace aslam {
+
+GyroNCameraTracker::GyroNCameraTracker(
+    const NCamera::ConstPtr& ncamera, size_t min_distance_to_image_border,
+    const std::vector<cv::Ptr<cv::DescriptorExtractor>>& extractors, size_t num_threads)
+    : ncamera_(ncamera), thread_pool_(num_threads) {
+  CHECK(ncamera_);
+  CHECK_EQ(extractors.size(), ncamera_->getNumCameras());
+  for (size_t camera_idx = 0u; camera_idx < ncamera_->getNumCameras(); ++camera_idx) {
+    CHECK(!extractors[camera_idx].empty());
+    trackers_.emplace_back(new GyroTracker(
+        ncamera_->getCamera(camera_idx), min_distance_to_image_border, extractors[camera_idx]));
+  }
+}
+
+GyroNCameraTracker::~GyroNCameraTracker() {
+  thread_pool_.stop();
+}
+
+void GyroNCameraTracker::track(
+    const Quaternion& q_Bkp1_Bk, const VisualNFrame& nframe_k, VisualNFrame* nframe_kp1,
+    std::vector<FrameToFrameMatchesWithScore>* matches_kp1_k) {
+  CHECK_NOTNULL(nframe_kp1);
+  CHECK_NOTNULL(matches_kp1_k);
+  const size_t num_cameras = trackers_.size();
+  CHECK_EQ(nframe_k.getNumFrames(), num_cameras);
+  CHECK_EQ(nframe_kp1->getNumFrames(), num_cameras);
+  matches_kp1_k->resize(num_cameras);
+
+  // The cameras are tracked on the pool, with the deadline of the calling thread.
+  const common::Deadline deadline = common::DeadlineScope::getCurrentDeadline();
+  std::vector<std::future<void>> results;
+  results.reserve(num_cameras);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    CHECK(nframe_k.isFrameSet(camera_idx));
+    CHECK(nframe_kp1->isFrameSet(camera_idx));
+    // The rotation of the body frame expressed in the camera frame.
+    const Quaternion& q_C_B = ncamera_->get_T_C_B(camera_idx).getRotation();
+    const Quaternion q_Ckp1_Ck = q_C_B * q_Bkp1_Bk * q_C_B.inverse();
+
+    GyroTracker* tracker = trackers_[camera_idx].get();
+    const VisualFrame* frame_k = &nframe_k.getFrame(camera_idx);
+    VisualFrame* frame_kp1 = nframe_kp1->getFrameShared(camera_idx).get();
+    FrameToFrameMatchesWithScore* camera_matches_kp1_k = &(*matches_kp1_k)[camera_idx];
+    results.emplace_back(thread_pool_.enqueueOrdered(
+        camera_idx, [tracker, q_Ckp1_Ck, frame_k, frame_kp1, camera_matches_kp1_k, deadline]() {
+          common::DeadlineScope deadline_scope(deadline);
+          tracker->track(q_Ckp1_Ck, *frame_k, frame_kp1, camera_matches_kp1_k);
+        }));
+  }
+  for (std::future<void>& result : results) {
+    CHECK(result.valid()) << "The thread pool was stopped.";
+    result.get();
+  }
+}
+
+GyroTracker& GyroNCameraTracker::getTracker(size_t camera_index) {
+  CHECK_LT(camera_index, trackers_.size());
+  return *trackers_[camera_index];
+}
+
+void GyroNCameraTracker::setDetectionMasks(VisualNPipeline* pipeline) const {
+  CHECK_NOTNULL(pipeline);
+  CHECK_EQ(pipeline->getOutputNCameras()->getNumCameras(), trackers_.size());
+  for (size_t camera_index = 0u; camera_index < trackers_.size(); ++camera_index) {
+    pipeline->setDetectionMask(camera_index, trackers_[camera_index]->getDetectionMask());
+  }
+}
+
+}  // namespace aslam
@@ -1,16 +1,21 @@
 #include "aslam/tracker/feature-tracker-gyro.h"
 
 #include <algorithm>
+#include <cmath>
 
 #include <aslam/cameras/camera.h>
+#include <aslam/common/allocation-counter.h>
+#include <aslam/common/deadline.h>
 #include <aslam/common/memory.h>
+#include <aslam/common/stl-helpers.h>
 #include <aslam/frames/visual-frame.h>
-#include <aslam/matcher/gyro-two-frame-matcher.h>
 #include <aslam/matcher/match-helpers.h>
+#include <aslam/pipeline/cuda-image-cache.h>
 #include <Eigen/Core>
 #include <glog/logging.h>
 #include <opencv2/video/tracking.hpp>
 
+#include "aslam/tracker/lk-tracker-cuda.h"
 #include "aslam/tracker/tracking-helpers.h"
 
 DEFINE_double(gyro_lk_candidate_ratio, 0.4, "This ratio defines the number of "
@@ -39,6 +44,32 @@ DEFINE_double(gyro_lk_min_eigenvalue_threshold, 0.001, "The algorithm "
     "than this threshold, the corresponding feature is filtered out and its "
     "flow is not processed, so it allows to remove bad points and get a "
     "performance boost.");
+DEFINE_bool(gyro_lk_adaptive_window, false, "Choose the LK window size, pyramid depth and "
+    "iteration count per call from the gyro predicted keypoint displacement instead of using "
+    "the fixed settings, which act as upper bounds.");
+DEFINE_int32(gyro_lk_adaptive_min_window_size, 9, "Smallest LK window size of the adaptive "
+    "mode.");
+DEFINE_int32(gyro_lk_adaptive_max_iterations, 20, "Max. number of LK iterations per pyramid "
+    "level of the adaptive mode.");
+DEFINE_double(gyro_lk_adaptive_base_residual_px, 2.0, "Expected error of the gyro prediction "
+    "without rotation, e.g. from translation. [px]");
+DEFINE_double(gyro_lk_adaptive_residual_ratio, 0.2, "Expected error of the gyro prediction "
+    "relative to the predicted keypoint displacement.");
+DEFINE_bool(gyro_detection_mask, false, "Compute a mask of the image parts covered by the "
+    "tracked keypoints after every frame, such that the pipeline only detects new keypoints "
+    "in the free parts of the next frame. All unmatched keypoints are tracked with LK.");
+DEFINE_double(gyro_detection_mask_cell_size_px, 40.0, "Cell size of the detection mask "
+    "grid. [px]");
+DEFINE_double(gyro_detection_mask_radius_px, 10.0, "Radius masked around every keypoint of "
+    "the detection mask. [px]");
+DEFINE_uint64(gyro_detection_mask_max_points_per_cell, 3u, "Cells of the detection mask with "
+    "this many keypoints are masked entirely.");
+DEFINE_uint64(gyro_lk_descriptor_keyframe_interval, 1u, "Only every n-th frame extracts "
+    "descriptors for the LK-tracked keypoints, the others carry forward the descriptors of "
+    "frame k. With the detection mask, the keyframes are detected and described entirely.");
+DEFINE_bool(gyro_matcher_coarse_to_fine, false, "Match a subset of the strongest keypoints "
+    "in a large window first and correct the gyro predictions of all keypoints with the affine "
+    "transformation fitted to these matches, for fast motion or inaccurate gyro predictions.");
 
 namespace aslam {
 
@@ -50,7 +81,18 @@ GyroTrackerSettings::GyroTrackerSettings()
     lk_window_size(FLAGS_gyro_lk_window_size, FLAGS_gyro_lk_window_size),
     lk_max_pyramid_levels(FLAGS_gyro_lk_max_pyramid_levels),
     lk_operation_flag(cv::OPTFLOW_USE_INITIAL_FLOW),
-    lk_min_eigenvalue_threshold(FLAGS_gyro_lk_min_eigenvalue_threshold) {
+    lk_min_eigenvalue_threshold(FLAGS_gyro_lk_min_eigenvalue_threshold),
+    lk_adaptive_window(FLAGS_gyro_lk_adaptive_window),
+    lk_adaptive_min_window_size(FLAGS_gyro_lk_adaptive_min_window_size),
+    lk_adaptive_max_iterations(FLAGS_gyro_lk_adaptive_max_iterations),
+    lk_adaptive_base_residual_px(FLAGS_gyro_lk_adaptive_base_residual_px),
+    lk_adaptive_residual_ratio(FLAGS_gyro_lk_adaptive_residual_ratio),
+    detection_mask_enabled(FLAGS_gyro_detection_mask),
+    detection_mask_cell_size_px(FLAGS_gyro_detection_mask_cell_size_px),
+    detection_mask_radius_px(FLAGS_gyro_detection_mask_radius_px),
+    detection_mask_max_points_per_cell(FLAGS_gyro_detection_mask_max_points_per_cell),
+    lk_descriptor_keyframe_interval(FLAGS_gyro_lk_descriptor_keyframe_interval),
+    matcher_coarse_to_fine(FLAGS_gyro_matcher_coarse_to_fine) {
   CHECK_GE(lk_max_num_candidates_ratio_kp1, 0.0);
   CHECK_LE(lk_max_num_candidates_ratio_kp1, 1.0) <<
       "Higher values than 1.0 are possible. Change this check if you really "
@@ -60,6 +102,19 @@ GyroTrackerSettings::GyroTrackerSettings()
   CHECK_GT(FLAGS_gyro_lk_window_size, 0);
   CHECK_GE(lk_max_pyramid_levels, 0);
   CHECK_GT(lk_min_eigenvalue_threshold, 0.0);
+  CHECK_GT(lk_adaptive_min_window_size, 0);
+  CHECK_LE(lk_adaptive_min_window_size, FLAGS_gyro_lk_window_size);
+  CHECK_GT(lk_adaptive_max_iterations, 0);
+  CHECK_GE(lk_adaptive_base_residual_px, 0.0);
+  CHECK_GE(lk_adaptive_residual_ratio, 0.0);
+  if (detection_mask_enabled) {
+    CHECK_GT(lk_max_num_candidates_ratio_kp1, 0.0)
+        << "The detection mask requires the LK tracking to carry the masked keypoints.";
+    CHECK_GT(detection_mask_cell_size_px, 0.0);
+    CHECK_GT(detection_mask_radius_px, 0.0);
+    CHECK_GT(detection_mask_max_points_per_cell, 0u);
+  }
+  CHECK_GT(lk_descriptor_keyframe_interval, 0u);
 }
 
 GyroTracker::GyroTracker(const Camera& camera,
@@ -68,13 +123,37 @@ GyroTracker::GyroTracker(const Camera& camera,
     : camera_(camera) ,
       kMinDistanceToImageBorderPx(min_distance_to_image_border),
       extractor_(extractor_ptr),
-      initialized_(false) {
+      initialized_(false),
+      num_tracked_frames_(0u),
+      matcher_(static_cast<uint32_t>(camera.imageHeight())),
+      has_image_pyramid_k_(false) {
+  matcher_.setCoarseToFineMatching(settings_.matcher_coarse_to_fine);
+  if (settings_.detection_mask_enabled) {
+    const double image_rows = static_cast<double>(camera.imageHeight());
+    const double image_cols = static_cast<double>(camera.imageWidth());
+    detection_mask_grid_.reset(new common::WeightedOccupancyGrid<>(
+        image_rows, image_cols, std::min(settings_.detection_mask_cell_size_px, image_rows),
+        std::min(settings_.detection_mask_cell_size_px, image_cols)));
+  }
+}
+
+GyroTracker::~GyroTracker() {}
+
+void GyroTracker::enableCudaLkTracking(
+    const std::shared_ptr<const CudaImageCache>& device_images) {
+  if (!isCudaBackendAvailable()) {
+    LOG(WARNING) << "The CUDA backend is not available, the LK tracking runs on the CPU.";
+    cuda_lk_tracker_.reset();
+    return;
+  }
+  cuda_lk_tracker_.reset(new CudaLkTracker(device_images));
 }
 
 void GyroTracker::track(const Quaternion& q_Ckp1_Ck,
                         const VisualFrame& frame_k,
                         VisualFrame* frame_kp1,
                         FrameToFrameMatchesWithScore* matches_kp1_k) {
+  common::AllocationCounter allocation_counter("GyroTracker::track");
   CHECK(frame_k.isValid());
   CHECK(frame_k.hasKeypointMeasurements());
   CHECK(frame_k.hasKeypointOrientations());
@@ -104,46 +183,84 @@ void GyroTracker::track(const Quaternion& q_Ckp1_Ck,
   CHECK_GT(frame_kp1->getTimestampNanoseconds(),
            frame_k.getTimestampNanoseconds());
 
+  const bool is_descriptor_keyframe =
+      num_tracked_frames_ % settings_.lk_descriptor_keyframe_interval == 0u;
+  ++num_tracked_frames_;
+  // Collects the degradations of the matcher and the LK tracking for frame (k+1).
+  common::DeadlineScope deadline_scope;
+
   if (settings_.lk_max_num_candidates_ratio_kp1 > 0.0) {
-    // It is important, that the track Id deque is updated at the beginning
+    // It is important, that the track Id history is updated at the beginning
     // because the rest of the code relies on this.
-    updateTrackIdDeque(frame_k);
+    updateTrackIdHistory(frame_k);
     if (!initialized_) {
-      initializeFeatureStatusDeque();
+      initializeFeatureStatusHistory();
     }
   }
 
   // Predict keypoint positions for all keypoints in current frame k.
-  Eigen::Matrix2Xd predicted_keypoint_positions_kp1;
-  std::vector<unsigned char> prediction_success;
+  Eigen::Matrix2Xd& predicted_keypoint_positions_kp1 = predicted_keypoint_positions_kp1_;
+  std::vector<unsigned char>& prediction_success = prediction_success_;
   predictKeypointsByRotation(frame_k, q_Ckp1_Ck,
                              &predicted_keypoint_positions_kp1,
                              &prediction_success);
   CHECK_EQ(prediction_success.size(), predicted_keypoint_positions_kp1.cols());
 
   // Match descriptors of frame k with those of frame (k+1).
-  GyroTwoFrameMatcher matcher(
-      q_Ckp1_Ck, *frame_kp1, frame_k, camera_.imageHeight(),
-      predicted_keypoint_positions_kp1,
-      prediction_success, matches_kp1_k);
-  matcher.match();
+  matcher_.match(q_Ckp1_Ck, *frame_kp1, frame_k, predicted_keypoint_positions_kp1,
+                 prediction_success, matches_kp1_k);
 
   if (settings_.lk_max_num_candidates_ratio_kp1 > 0.0) {
     // Compute LK candidates and track them.
-    FrameStatusTrackLength status_track_length_k;
-    std::vector<TrackedMatch> tracked_matches;
-    std::vector<int> lk_candidate_indices_k;
+    // The buffers are members to keep their capacity across calls.
+    FrameStatusTrackLength& status_track_length_k = status_track_length_k_;
+    std::vector<TrackedMatch>& tracked_matches = tracked_matches_;
+    std::vector<int>& lk_candidate_indices_k = lk_candidate_indices_k_;
 
     computeTrackedMatches(&tracked_matches);
     computeStatusTrackLengthOfFrameK(tracked_matches, &status_track_length_k);
     computeLKCandidates(*matches_kp1_k, status_track_length_k,
                         frame_k, *frame_kp1, &lk_candidate_indices_k);
+    if (!lk_candidate_indices_k.empty() && deadline_scope.getDeadline().hasExpired()) {
+      // The unmatched keypoints are dropped, the tracks continue with the matched ones.
+      lk_candidate_indices_k.clear();
+      common::DeadlineScope::addDegradation(common::Degradation::kSkippedLkTracking);
+    }
     lkTracking(predicted_keypoint_positions_kp1, prediction_success,
-               lk_candidate_indices_k, frame_k, frame_kp1, matches_kp1_k);
+               lk_candidate_indices_k, frame_k, is_descriptor_keyframe, frame_kp1,
+               matches_kp1_k);
 
     status_track_length_km1_.swap(status_track_length_k);
     initialized_ = true;
   }
+
+  if (detection_mask_grid_) {
+    if (num_tracked_frames_ % settings_.lk_descriptor_keyframe_interval == 0u) {
+      // The next frame is a keyframe, its descriptors are refreshed in the whole image.
+      detection_mask_.release();
+    } else {
+      computeDetectionMask(*frame_kp1);
+    }
+  }
+  frame_kp1->addDegradations(deadline_scope.getDegradations());
+}
+
+void GyroTracker::computeDetectionMask(const VisualFrame& frame) {
+  CHECK(detection_mask_grid_);
+  const Eigen::Matrix2Xd& keypoints = frame.getKeypointMeasurements();
+  const double max_row = static_cast<double>(camera_.imageHeight()) - 1.0;
+  const double max_col = static_cast<double>(camera_.imageWidth()) - 1.0;
+  detection_mask_grid_->reset();
+  for (int keypoint_idx = 0; keypoint_idx < keypoints.cols(); ++keypoint_idx) {
+    // Clamp to the image as LK-tracked keypoints may lie on the border.
+    const double u_rows = std::min(std::max(keypoints(1, keypoint_idx), 0.0), max_row);
+    const double v_cols = std::min(std::max(keypoints(0, keypoint_idx), 0.0), max_col);
+    detection_mask_grid_->addPointUnconditional(
+        common::WeightedOccupancyGrid<>::Point(u_rows, v_cols, 1.0, keypoint_idx));
+  }
+  detection_mask_grid_->getOccupancyMask(settings_.detection_mask_radius_px,
+                                         settings_.detection_mask_max_points_per_cell,
+                                         &detection_mask_);
 }
 
 void GyroTracker::lkTracking(
@@ -151,6 +268,7 @@ void GyroTracker::lkTracking(
       const std::vector<unsigned char>& prediction_success,
       const std::vector<int>& lk_candidate_indices_k,
       const VisualFrame& frame_k,
+      const bool extract_descriptors,
       VisualFrame* frame_kp1,
       FrameToFrameMatchesWithScore* matches_kp1_k) {
   CHECK_NOTNULL(frame_kp1);
@@ -161,8 +279,10 @@ void GyroTracker::lkTracking(
   const int kInitialSizeKp1 = frame_kp1->getTrackIds().size();
 
   // Definite lk indices are the subset of lk candidate indices with
-  // successfully predicted keypoint locations in frame (k+1).
-  std::vector<int> lk_definite_indices_k;
+  // successfully predicted keypoint locations in frame (k+1). The buffers are members to keep
+  // their capacity across calls.
+  std::vector<int>& lk_definite_indices_k = lk_definite_indices_k_;
+  lk_definite_indices_k.clear();
   for (const int candidate_index_k: lk_candidate_indices_k) {
     if (prediction_success[candidate_index_k] == 1) {
       lk_definite_indices_k.push_back(candidate_index_k);
@@ -174,19 +294,16 @@ void GyroTracker::lkTracking(
     // Since only inserted keypoints are those that are lk-tracked, all
     // keypoints in frame (k+1) were detected.
     // Update feature status for next iteration.
-    FrameFeatureStatus frame_feature_status_kp1(kInitialSizeKp1);
-    std::fill(frame_feature_status_kp1.begin(), frame_feature_status_kp1.end(),
-              FeatureStatus::kDetected);
-    updateFeatureStatusDeque(frame_feature_status_kp1);
+    updateFeatureStatusHistory(kInitialSizeKp1, 0u);
     VLOG(4) << "No LK candidates to track.";
     return;
   }
 
   // Get definite lk keypoint locations in OpenCV format.
-  std::vector<cv::Point2f> lk_cv_points_k;
-  std::vector<cv::Point2f> lk_cv_points_kp1;
-  lk_cv_points_k.reserve(lk_definite_indices_k.size());
-  lk_cv_points_kp1.reserve(lk_definite_indices_k.size());
+  std::vector<cv::Point2f>& lk_cv_points_k = lk_cv_points_k_;
+  std::vector<cv::Point2f>& lk_cv_points_kp1 = lk_cv_points_kp1_;
+  lk_cv_points_k.clear();
+  lk_cv_points_kp1.clear();
   for (const int lk_definite_index_k: lk_definite_indices_k) {
     // Compute Cv points in frame k.
     const Eigen::Vector2d& lk_keypoint_location_k =
@@ -200,15 +317,50 @@ void GyroTracker::lkTracking(
         static_cast<float>(predicted_keypoint_positions_kp1(1, lk_definite_index_k)));
   }
 
-  std::vector<unsigned char> lk_tracking_success;
-  std::vector<float> lk_tracking_errors;
+  std::vector<unsigned char>& lk_tracking_success = lk_tracking_success_;
+  std::vector<float>& lk_tracking_errors = lk_tracking_errors_;
+
+  cv::Size lk_window_size = settings_.lk_window_size;
+  int lk_max_pyramid_levels = settings_.lk_max_pyramid_levels;
+  cv::TermCriteria lk_termination_criteria = settings_.lk_termination_criteria;
+  if (settings_.lk_adaptive_window) {
+    computeAdaptiveLkParameters(lk_cv_points_k, lk_cv_points_kp1, &lk_window_size,
+                                &lk_max_pyramid_levels, &lk_termination_criteria);
+  }
 
-  cv::calcOpticalFlowPyrLK(
-      frame_k.getRawImage(), frame_kp1->getRawImage(), lk_cv_points_k,
-      lk_cv_points_kp1, lk_tracking_success, lk_tracking_errors,
-      settings_.lk_window_size, settings_.lk_max_pyramid_levels,
-      settings_.lk_termination_criteria, settings_.lk_operation_flag,
-      settings_.lk_min_eigenvalue_threshold);
+  // Use the pyramids built by the pipeline if available, the pyramid of frame k was already
+  // stored when it was frame (k+1). Otherwise the tracker builds the pyramids itself and keeps
+  // the one of frame (k+1) for the next call.
+  const bool use_image_pyramids = frame_k.hasImagePyramid() && frame_kp1->hasImagePyramid();
+  if (cuda_lk_tracker_) {
+    // The device builds its own pyramids, the images stay on the device between calls.
+    cuda_lk_tracker_->track(
+        frame_k, *frame_kp1, lk_window_size, lk_max_pyramid_levels,
+        lk_termination_criteria.maxCount, lk_cv_points_k, &lk_cv_points_kp1,
+        &lk_tracking_success);
+  } else if (use_image_pyramids) {
+    cv::calcOpticalFlowPyrLK(
+        frame_k.getImagePyramid(), frame_kp1->getImagePyramid(), lk_cv_points_k,
+        lk_cv_points_kp1, lk_tracking_success, lk_tracking_errors,
+        lk_window_size, lk_max_pyramid_levels, lk_termination_criteria,
+        settings_.lk_operation_flag, settings_.lk_min_eigenvalue_threshold);
+  } else {
+    // Frames without a valid id can't be recognized as the previous frame (k+1).
+    if (!has_image_pyramid_k_ || !frame_k.getId().isValid() ||
+        image_pyramid_frame_id_k_ != frame_k.getId()) {
+      buildImagePyramid(frame_k.getRawImage(), &image_pyramid_k_);
+    }
+    buildImagePyramid(frame_kp1->getRawImage(), &image_pyramid_kp1_);
+    cv::calcOpticalFlowPyrLK(
+        image_pyramid_k_, image_pyramid_kp1_, lk_cv_points_k,
+        lk_cv_points_kp1, lk_tracking_success, lk_tracking_errors,
+        lk_window_size, lk_max_pyramid_levels, lk_termination_criteria,
+        settings_.lk_operation_flag, settings_.lk_min_eigenvalue_threshold);
+    // The buffers of the old pyramid are reused for the next frame.
+    image_pyramid_k_.swap(image_pyramid_kp1_);
+    image_pyramid_frame_id_k_ = frame_kp1->getId();
+    has_image_pyramid_k_ = true;
+  }
 
   CHECK_EQ(lk_tracking_success.size(), lk_definite_indices_k.size());
   CHECK_EQ(lk_cv_points_kp1.size(), lk_tracking_success.size());
@@ -222,14 +374,14 @@ void GyroTracker::lkTracking(
          point.y >= (camera_.imageHeight() - kMinDistanceToImageBorderPx);
   };
 
-  std::unordered_set<size_t> indices_to_erase;
-  for (size_t i = 0u; i < lk_tracking_success.size(); ++i) {
-    if (lk_tracking_success[i] == 0u || is_outside_roi(lk_cv_points_kp1[i])) {
-      indices_to_erase.insert(i);
-    }
+  const size_t num_lk_points = lk_tracking_success.size();
+  std::vector<bool>& keep_mask = lk_keep_mask_;
+  keep_mask.resize(num_lk_points);
+  for (size_t i = 0u; i < num_lk_points; ++i) {
+    keep_mask[i] = lk_tracking_success[i] != 0u && !is_outside_roi(lk_cv_points_kp1[i]);
   }
-  eraseVectorElementsByIndex(indices_to_erase, &lk_definite_indices_k);
-  eraseVectorElementsByIndex(indices_to_erase, &lk_cv_points_kp1);
+  common::stl_helpers::compactInPlace(keep_mask, num_lk_points, &lk_definite_indices_k);
+  common::stl_helpers::compactInPlace(keep_mask, num_lk_points, &lk_cv_points_kp1);
 
   const size_t kNumPointsSuccessfullyTracked = lk_cv_points_kp1.size();
 
@@ -238,7 +390,8 @@ void GyroTracker::lkTracking(
   // (such as score and size) from frame k.
   // Assign unique class_id to keypoints because some of them will get removed
   // during the extraction phase and we want to be able to identify them.
-  std::vector<cv::KeyPoint> lk_cv_keypoints_kp1;
+  std::vector<cv::KeyPoint>& lk_cv_keypoints_kp1 = lk_cv_keypoints_kp1_;
+  lk_cv_keypoints_kp1.clear();
   lk_cv_keypoints_kp1.reserve(kNumPointsSuccessfullyTracked);
   for (size_t i = 0u; i < kNumPointsSuccessfullyTracked; ++i) {
     const size_t channel_idx = lk_definite_indices_k[i];
@@ -251,7 +404,12 @@ void GyroTracker::lkTracking(
   }
 
   cv::Mat lk_descriptors_kp1;
-  extractor_->compute(frame_kp1->getRawImage(), lk_cv_keypoints_kp1, lk_descriptors_kp1);
+  if (extract_descriptors) {
+    extractor_->compute(frame_kp1->getRawImage(), lk_cv_keypoints_kp1, lk_descriptors_kp1);
+  } else {
+    carryForwardDescriptors(frame_k, lk_definite_indices_k, &lk_cv_keypoints_kp1,
+                            &lk_descriptors_kp1);
+  }
   CHECK_EQ(lk_descriptors_kp1.type(), CV_8UC1);
 
   const size_t kNumPointsAfterExtraction = lk_cv_keypoints_kp1.size();
@@ -263,14 +421,7 @@ void GyroTracker::lkTracking(
   }
 
   // Update feature status for next iteration.
-  const size_t extended_size_pk1 = static_cast<size_t>(kInitialSizeKp1) +
-      kNumPointsAfterExtraction;
-  FrameFeatureStatus frame_feature_status_kp1(extended_size_pk1);
-  std::fill(frame_feature_status_kp1.begin(), frame_feature_status_kp1.begin() +
-            kInitialSizeKp1, FeatureStatus::kDetected);
-  std::fill(frame_feature_status_kp1.begin() + kInitialSizeKp1,
-            frame_feature_status_kp1.end(), FeatureStatus::kLkTracked);
-  updateFeatureStatusDeque(frame_feature_status_kp1);
+  updateFeatureStatusHistory(kInitialSizeKp1, kNumPointsAfterExtraction);
 
   if (lk_descriptors_kp1.empty()) {
     return;
@@ -283,6 +434,87 @@ void GyroTracker::lkTracking(
       GyroTrackerSettings::kKeypointUncertaintyPx, frame_kp1);
 }
 
+void GyroTracker::carryForwardDescriptors(
+    const VisualFrame& frame_k, const std::vector<int>& lk_definite_indices_k,
+    std::vector<cv::KeyPoint>* lk_cv_keypoints_kp1, cv::Mat* descriptors_kp1) const {
+  CHECK_NOTNULL(lk_cv_keypoints_kp1);
+  CHECK_NOTNULL(descriptors_kp1);
+  // The extractor drops the keypoints whose descriptor support leaves the image. Drop them here
+  // as well, such that the keyframes don't change which keypoints are tracked.
+  const float image_width = static_cast<float>(camera_.imageWidth());
+  const float image_height = static_cast<float>(camera_.imageHeight());
+  lk_cv_keypoints_kp1->erase(std::remove_if(
+      lk_cv_keypoints_kp1->begin(), lk_cv_keypoints_kp1->end(),
+      [image_width, image_height](const cv::KeyPoint& keypoint) {
+        const float radius = 0.5f * keypoint.size;
+        return keypoint.pt.x < radius || keypoint.pt.y < radius ||
+            keypoint.pt.x >= image_width - radius || keypoint.pt.y >= image_height - radius;
+      }), lk_cv_keypoints_kp1->end());
+
+  const VisualFrame::DescriptorsT& descriptors_k = frame_k.getDescriptors();
+  const int descriptor_size_bytes = static_cast<int>(descriptors_k.rows());
+  descriptors_kp1->create(static_cast<int>(lk_cv_keypoints_kp1->size()), descriptor_size_bytes,
+                          CV_8UC1);
+  for (size_t i = 0u; i < lk_cv_keypoints_kp1->size(); ++i) {
+    const int index_k = lk_definite_indices_k[(*lk_cv_keypoints_kp1)[i].class_id];
+    std::copy(descriptors_k.col(index_k).data(),
+              descriptors_k.col(index_k).data() + descriptor_size_bytes,
+              descriptors_kp1->ptr<unsigned char>(static_cast<int>(i)));
+  }
+}
+
+void GyroTracker::computeAdaptiveLkParameters(
+    const std::vector<cv::Point2f>& lk_cv_points_k,
+    const std::vector<cv::Point2f>& lk_cv_points_kp1, cv::Size* lk_window_size,
+    int* lk_max_pyramid_levels, cv::TermCriteria* lk_termination_criteria) {
+  CHECK_NOTNULL(lk_window_size);
+  CHECK_NOTNULL(lk_max_pyramid_levels);
+  CHECK_NOTNULL(lk_termination_criteria);
+  CHECK_EQ(lk_cv_points_k.size(), lk_cv_points_kp1.size());
+  CHECK(!lk_cv_points_k.empty());
+
+  // The median displacement predicted by the gyro scales with the rotation magnitude.
+  std::vector<float>& displacements_px = lk_predicted_displacements_px_;
+  displacements_px.resize(lk_cv_points_k.size());
+  for (size_t i = 0u; i < lk_cv_points_k.size(); ++i) {
+    displacements_px[i] = static_cast<float>(cv::norm(lk_cv_points_kp1[i] - lk_cv_points_k[i]));
+  }
+  std::vector<float>::iterator median = displacements_px.begin() + displacements_px.size() / 2u;
+  std::nth_element(displacements_px.begin(), median, displacements_px.end());
+  const double residual_px = settings_.lk_adaptive_base_residual_px +
+      settings_.lk_adaptive_residual_ratio * (*median);
+
+  // The smallest odd window covering the expected prediction error on the finest level. If the
+  // window is at the upper bound, every pyramid level doubles the covered error.
+  const int kMaxWindowSize = settings_.lk_window_size.width;
+  int window_size = 2 * static_cast<int>(std::ceil(residual_px)) + 1;
+  window_size = std::max(settings_.lk_adaptive_min_window_size,
+                         std::min(window_size, kMaxWindowSize));
+  int num_levels = 0;
+  while (num_levels < settings_.lk_max_pyramid_levels &&
+         (window_size / 2) * (1 << num_levels) < residual_px) {
+    ++num_levels;
+  }
+  *lk_window_size = cv::Size(window_size, window_size);
+  *lk_max_pyramid_levels = num_levels;
+
+  // Small windows converge in fewer iterations, the epsilon criterion still stops earlier.
+  *lk_termination_criteria = cv::TermCriteria(
+      cv::TermCriteria::COUNT | cv::TermCriteria::EPS,
+      std::min(settings_.lk_adaptive_max_iterations, settings_.lk_termination_criteria.maxCount),
+      settings_.lk_termination_criteria.epsilon);
+  VLOG(4) << "Adaptive LK: median predicted displacement " << *median << " px, window "
+          << window_size << ", levels " << num_levels << ".";
+}
+
+void GyroTracker::buildImagePyramid(
+    const cv::Mat& image, std::vector<cv::Mat>* image_pyramid) const {
+  CHECK_NOTNULL(image_pyramid);
+  // Reuses the level buffers of the given pyramid if the image size didn't change.
+  cv::buildOpticalFlowPyramid(image, *image_pyramid, settings_.lk_window_size,
+                              settings_.lk_max_pyramid_levels);
+}
+
 void GyroTracker::computeTrackedMatches(
       std::vector<TrackedMatch>* tracked_matches) const {
   CHECK_NOTNULL(tracked_matches)->clear();
@@ -303,16 +535,13 @@ void GyroTracker::computeTrackedMatches(
     }
   };
 
-  const Eigen::VectorXi& track_ids_k_eigen = track_ids_k_km1_[0];
-  const Eigen::VectorXi& track_ids_km1_eigen = track_ids_k_km1_[1];
-  const std::vector<int> track_ids_km1(
-      track_ids_km1_eigen.data(),
-      track_ids_km1_eigen.data() + track_ids_km1_eigen.size());
-  for (int index_k = 0; index_k < track_ids_k_eigen.size(); ++index_k) {
-    const int track_id_k = track_ids_k_eigen(index_k);
+  const TrackIds& track_ids_k = track_ids_k_km1_[0];
+  const TrackIds& track_ids_km1 = track_ids_k_km1_[1];
+  for (int index_k = 0; index_k < static_cast<int>(track_ids_k.size()); ++index_k) {
+    const int track_id_k = track_ids_k[index_k];
     // Skip invalid track IDs.
     if (track_id_k == -1) continue;
-    const int index_km1 = GetIndexOfValue(track_ids_km1, track_ids_k_eigen(index_k));
+    const int index_km1 = GetIndexOfValue(track_ids_km1, track_id_k);
     if (index_km1 >= 0) {
       tracked_matches->emplace_back(index_k, index_km1);
     }
@@ -324,25 +553,30 @@ void GyroTracker::computeLKCandidates(
     const FrameStatusTrackLength& status_track_length_k,
     const VisualFrame& frame_k,
     const VisualFrame& frame_kp1,
-    std::vector<int>* lk_candidate_indices_k) const {
+    std::vector<int>* lk_candidate_indices_k) {
   CHECK_NOTNULL(lk_candidate_indices_k)->clear();
   CHECK_EQ(status_track_length_k.size(), track_ids_k_km1_[0].size());
 
-  std::vector<int> unmatched_indices_k;
+  std::vector<int>& unmatched_indices_k = unmatched_indices_k_;
   computeUnmatchedIndicesOfFrameK(
       matches_kp1_k, &unmatched_indices_k);
 
   typedef std::pair<int, size_t> IndexTrackLengthPair;
 
-  std::vector<IndexTrackLengthPair> indices_detected_and_tracked;
-  std::vector<IndexTrackLengthPair> indices_lktracked;
+  std::vector<IndexTrackLengthPair>& indices_detected_and_tracked = indices_detected_and_tracked_;
+  std::vector<IndexTrackLengthPair>& indices_lktracked = indices_lktracked_;
+  indices_detected_and_tracked.clear();
+  indices_lktracked.clear();
   for (const int unmatched_index_k: unmatched_indices_k) {
     const size_t current_status_track_length =
         status_track_length_k[unmatched_index_k];
     const FeatureStatus current_feature_status =
         feature_status_k_km1_[0][unmatched_index_k];
     if (current_feature_status == FeatureStatus::kDetected) {
-      if (current_status_track_length >= FLAGS_gyro_lk_track_detected_threshold) {
+      // Keypoints in the masked parts of frame (k+1) are not detected again, hence can't wait
+      // for a second detection.
+      if (settings_.detection_mask_enabled ||
+          current_status_track_length >= FLAGS_gyro_lk_track_detected_threshold) {
         // These candidates have the highest priority as lk candidates.
         // The most valuable candidates have the longest status track length.
         indices_detected_and_tracked.emplace_back(
@@ -364,8 +598,11 @@ void GyroTracker::computeLKCandidates(
   CHECK_EQ(kNumPointsKp1, frame_kp1.getDescriptors().cols());
   const size_t kLkNumCandidatesBeforeCutoff =
       indices_detected_and_tracked.size() + indices_lktracked.size();
-  const size_t kLkNumMaxCandidates = static_cast<size_t>(
-      kNumPointsKp1*settings_.lk_max_num_candidates_ratio_kp1);
+  // With the detection mask frame (k+1) only has the keypoints of the free parts, all
+  // candidates are tracked.
+  const size_t kLkNumMaxCandidates = settings_.detection_mask_enabled ?
+      kLkNumCandidatesBeforeCutoff :
+      static_cast<size_t>(kNumPointsKp1*settings_.lk_max_num_candidates_ratio_kp1);
   const size_t kNumLkCandidatesAfterCutoff = std::min(
       kLkNumCandidatesBeforeCutoff, kLkNumMaxCandidates);
   lk_candidate_indices_k->reserve(kNumLkCandidatesAfterCutoff);
@@ -410,7 +647,7 @@ void GyroTracker::computeLKCandidates(
 
 void GyroTracker::computeUnmatchedIndicesOfFrameK(
     const FrameToFrameMatchesWithScore& matches_kp1_k,
-    std::vector<int>* unmatched_indices_k) const {
+    std::vector<int>* unmatched_indices_k) {
   CHECK_GT(track_ids_k_km1_.size(), 0u);
   CHECK_GE(track_ids_k_km1_[0].size(), matches_kp1_k.size());
   CHECK_NOTNULL(unmatched_indices_k)->clear();
@@ -420,7 +657,8 @@ void GyroTracker::computeUnmatchedIndicesOfFrameK(
   const size_t kNumUnmatchedK = kNumPointsK - kNumMatchesK;
 
   unmatched_indices_k->reserve(kNumUnmatchedK);
-  std::vector<bool> is_unmatched(kNumPointsK, true);
+  std::vector<bool>& is_unmatched = is_unmatched_k_;
+  is_unmatched.assign(kNumPointsK, true);
 
   for (const FrameToFrameMatchWithScore& match: matches_kp1_k) {
     is_unmatched[match.getKeypointIndexBananaFrame()] = false;
@@ -466,30 +704,25 @@ void GyroTracker::computeStatusTrackLengthOfFrameK(
   }
 }
 
-void GyroTracker::initializeFeatureStatusDeque() {
+void GyroTracker::initializeFeatureStatusHistory() {
   CHECK_EQ(track_ids_k_km1_.size(), 1u);
-  const size_t num_points_k = track_ids_k_km1_[0].size();
-  FrameFeatureStatus frame_feature_status_k(num_points_k, FeatureStatus::kDetected);
-  updateFeatureStatusDeque(frame_feature_status_k);
+  updateFeatureStatusHistory(track_ids_k_km1_[0].size(), 0u);
 }
 
-void GyroTracker::updateFeatureStatusDeque(
-    const FrameFeatureStatus& frame_feature_status_kp1) {
-  feature_status_k_km1_.emplace_front(
-      frame_feature_status_kp1.begin(), frame_feature_status_kp1.end());
-  if (feature_status_k_km1_.size() == 3u) {
-    feature_status_k_km1_.pop_back();
-  }
+void GyroTracker::updateFeatureStatusHistory(
+    const size_t num_detected, const size_t num_lk_tracked) {
+  // Overwrites the status of the oldest frame, resizing within the capacity of earlier frames.
+  FrameFeatureStatus* frame_feature_status_kp1 = feature_status_k_km1_.push();
+  frame_feature_status_kp1->assign(num_detected, FeatureStatus::kDetected);
+  frame_feature_status_kp1->insert(
+      frame_feature_status_kp1->end(), num_lk_tracked, FeatureStatus::kLkTracked);
 }
 
-void GyroTracker::updateTrackIdDeque(
+void GyroTracker::updateTrackIdHistory(
     const VisualFrame& new_frame_k) {
   const Eigen::VectorXi& track_ids_k = new_frame_k.getTrackIds();
-
-  track_ids_k_km1_.push_front(track_ids_k);
-  if (track_ids_k_km1_.size() == 3u) {
-    track_ids_k_km1_.pop_back();
-  }
+  track_ids_k_km1_.push()->assign(
+      track_ids_k.data(), track_ids_k.data() + track_ids_k.size());
 }
 
 }  //namespace aslam
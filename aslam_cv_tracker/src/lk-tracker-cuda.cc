@@ -0,0 +1,122 @@
+#include "aslam/tracker/lk-tracker-cuda.h"
+
+#include <aslam/common/unique-id.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/pipeline/cuda-image-cache.h>
+#include <glog/logging.h>
+#ifdef ASLAM_CV_WITH_CUDA
+#include <opencv2/core/cuda.hpp>
+#include <opencv2/cudaoptflow.hpp>
+#endif
+
+namespace aslam {
+
+#ifdef ASLAM_CV_WITH_CUDA
+struct CudaLkTracker::Impl {
+  explicit Impl(const std::shared_ptr<const CudaImageCache>& device_images_in)
+      : device_images(device_images_in),
+        optical_flow(cv::cuda::SparsePyrLKOpticalFlow::create()) {
+    optical_flow->setUseInitialFlow(true);
+  }
+
+  /// Get the device image of the frame, uploading it on the stream if needed.
+  void getDeviceImage(const VisualFrame& frame, cv::cuda::GpuMat* device_image) {
+    CHECK_NOTNULL(device_image);
+    const FrameId& frame_id = frame.getId();
+    if (frame_id.isValid()) {
+      if (device_images && device_images->find(frame_id, device_image)) {
+        return;
+      }
+      if (!last_uploaded_image.empty() && last_uploaded_frame_id == frame_id) {
+        *device_image = last_uploaded_image;
+        return;
+      }
+    }
+    // A new buffer as the previous upload may still be referenced by device_image_k.
+    cv::cuda::GpuMat uploaded_image;
+    uploaded_image.upload(frame.getRawImage(), stream);
+    last_uploaded_image = uploaded_image;
+    last_uploaded_frame_id = frame_id;
+    *device_image = uploaded_image;
+  }
+
+  const std::shared_ptr<const CudaImageCache> device_images;
+  cv::Ptr<cv::cuda::SparsePyrLKOpticalFlow> optical_flow;
+  cv::cuda::Stream stream;
+
+  cv::cuda::GpuMat last_uploaded_image;
+  FrameId last_uploaded_frame_id;
+
+  // Device and page-locked host buffers, reused across calls.
+  cv::cuda::GpuMat device_points_k;
+  cv::cuda::GpuMat device_points_kp1;
+  cv::cuda::GpuMat device_status;
+  cv::cuda::HostMem host_points_kp1;
+  cv::cuda::HostMem host_status;
+};
+#else
+struct CudaLkTracker::Impl {};
+#endif
+
+CudaLkTracker::CudaLkTracker(const std::shared_ptr<const CudaImageCache>& device_images) {
+  CHECK(isCudaBackendAvailable()) << "The CUDA backend is not available.";
+#ifdef ASLAM_CV_WITH_CUDA
+  impl_.reset(new Impl(device_images));
+#else
+  static_cast<void>(device_images);
+#endif
+}
+
+CudaLkTracker::~CudaLkTracker() {}
+
+void CudaLkTracker::track(
+    const VisualFrame& frame_k, const VisualFrame& frame_kp1, const cv::Size& window_size,
+    int max_pyramid_levels, int max_iterations, const std::vector<cv::Point2f>& points_k,
+    std::vector<cv::Point2f>* points_kp1, std::vector<unsigned char>* tracking_success) {
+  CHECK_NOTNULL(points_kp1);
+  CHECK_NOTNULL(tracking_success);
+  CHECK_EQ(points_k.size(), points_kp1->size());
+  CHECK(!points_k.empty());
+#ifdef ASLAM_CV_WITH_CUDA
+  CHECK(impl_);
+  Impl& impl = *impl_;
+  cv::cuda::GpuMat device_image_k, device_image_kp1;
+  impl.getDeviceImage(frame_k, &device_image_k);
+  impl.getDeviceImage(frame_kp1, &device_image_kp1);
+
+  const int num_points = static_cast<int>(points_k.size());
+  impl.device_points_k.upload(cv::Mat(1, num_points, CV_32FC2,
+                                      const_cast<cv::Point2f*>(points_k.data())), impl.stream);
+  impl.device_points_kp1.upload(cv::Mat(1, num_points, CV_32FC2, points_kp1->data()),
+                                impl.stream);
+
+  impl.optical_flow->setWinSize(window_size);
+  impl.optical_flow->setMaxLevel(max_pyramid_levels);
+  impl.optical_flow->setNumIters(max_iterations);
+  impl.optical_flow->calc(device_image_k, device_image_kp1, impl.device_points_k,
+                          impl.device_points_kp1, impl.device_status, cv::noArray(),
+                          impl.stream);
+
+  impl.device_points_kp1.download(impl.host_points_kp1, impl.stream);
+  impl.device_status.download(impl.host_status, impl.stream);
+  impl.stream.waitForCompletion();
+
+  const cv::Mat host_points_kp1 = impl.host_points_kp1.createMatHeader();
+  const cv::Mat host_status = impl.host_status.createMatHeader();
+  CHECK_EQ(host_points_kp1.cols, num_points);
+  CHECK_EQ(host_status.cols, num_points);
+  const cv::Point2f* tracked_points = host_points_kp1.ptr<cv::Point2f>();
+  points_kp1->assign(tracked_points, tracked_points + num_points);
+  const unsigned char* status = host_status.ptr<unsigned char>();
+  tracking_success->assign(status, status + num_points);
+#else
+  static_cast<void>(frame_k);
+  static_cast<void>(frame_kp1);
+  static_cast<void>(window_size);
+  static_cast<void>(max_pyramid_levels);
+  static_cast<void>(max_iterations);
+  LOG(FATAL) << "Built without ASLAM_CV_WITH_CUDA.";
+#endif
+}
+
+}  // namespace aslam
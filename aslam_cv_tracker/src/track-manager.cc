@@ -1,4 +1,8 @@
-#include <set>
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -8,6 +12,162 @@
 #include "aslam/tracker/track-manager.h"
 
 namespace aslam {
+  namespace {
+  /// \brief Candidate match for a new track, in a compact layout for the bucket selection.
+  struct NewTrackCandidate {
+    double score;
+    /// Position in the input matches.
+    int order;
+    int index_apple;
+    int index_banana;
+    size_t bucket_index;
+  };
+
+  /// \brief Order by decreasing score. Equal scores are ordered by the input position, which is
+  ///        the order in which they were inserted into the former std::set of candidates.
+  inline bool isStrongerCandidate(const NewTrackCandidate& lhs, const NewTrackCandidate& rhs) {
+    return (lhs.score > rhs.score) || ((lhs.score == rhs.score) && (lhs.order < rhs.order));
+  }
+
+  /// \brief Selects the new tracks exactly as walking a std::set<..., std::greater<>> of the
+  ///        candidates would: a candidate with the same score as an earlier one is dropped,
+  ///        the num_to_force_push strongest candidates not below force_push_threshold are
+  ///        accepted unconditionally and the remaining ones in order of decreasing score as
+  ///        long as their bucket has capacity left.
+  ///
+  ///        Instead of sorting all candidates, the forced candidates and the accepted
+  ///        candidates of every bucket are partially selected with nth_element. Only the
+  ///        scores of the selected candidates are checked for duplicates; dropping an
+  ///        unselected duplicate can't change the selection. If selected duplicates are
+  ///        dropped, the selection is repeated.
+  ///
+  /// @param[in,out] candidates    The candidates, duplicates are removed.
+  /// @param[in]  bucket_levels    Number of tracks per bucket before the new tracks were added.
+  /// @param[out] selected         The accepted candidates in order of decreasing score.
+  void selectNewTrackCandidates(
+      const std::vector<size_t>& bucket_levels, const size_t bucket_capacity,
+      const size_t num_to_force_push, const double force_push_threshold,
+      std::vector<NewTrackCandidate>* candidates, std::vector<NewTrackCandidate>* selected) {
+    CHECK_NOTNULL(candidates);
+    CHECK_NOTNULL(selected);
+    const size_t num_buckets = bucket_levels.size();
+
+    std::vector<int> strong_indices;
+    std::vector<unsigned char> is_forced;
+    std::vector<size_t> levels;
+    std::vector<size_t> bucket_offsets;
+    std::vector<size_t> bucket_fill;
+    std::vector<int> indices_by_bucket;
+    std::vector<double> selected_scores;
+    std::vector<int> first_order_of_selected_score;
+
+    bool dropped_duplicates = true;
+    while (dropped_duplicates) {
+      selected->clear();
+      const int num_candidates = static_cast<int>(candidates->size());
+      const auto is_stronger = [candidates](int lhs, int rhs) -> bool {
+        return isStrongerCandidate((*candidates)[lhs], (*candidates)[rhs]);
+      };
+
+      // Force push the strongest candidates, regardless of the bucket levels.
+      strong_indices.clear();
+      for (int i = 0; i < num_candidates; ++i) {
+        if ((*candidates)[i].score >= force_push_threshold) {
+          strong_indices.push_back(i);
+        }
+      }
+      const size_t num_forced = std::min(num_to_force_push, strong_indices.size());
+      if (num_forced < strong_indices.size()) {
+        std::nth_element(strong_indices.begin(), strong_indices.begin() + num_forced,
+                         strong_indices.end(), is_stronger);
+      }
+      levels = bucket_levels;
+      is_forced.assign(num_candidates, 0u);
+      for (size_t i = 0u; i < num_forced; ++i) {
+        const NewTrackCandidate& candidate = (*candidates)[strong_indices[i]];
+        is_forced[strong_indices[i]] = 1u;
+        ++levels[candidate.bucket_index];
+        selected->push_back(candidate);
+      }
+
+      // Group the remaining candidates by bucket.
+      bucket_offsets.assign(num_buckets + 1u, 0u);
+      for (int i = 0; i < num_candidates; ++i) {
+        if (!is_forced[i]) {
+          ++bucket_offsets[(*candidates)[i].bucket_index + 1u];
+        }
+      }
+      for (size_t bucket_idx = 0u; bucket_idx < num_buckets; ++bucket_idx) {
+        bucket_offsets[bucket_idx + 1u] += bucket_offsets[bucket_idx];
+      }
+      bucket_fill.assign(bucket_offsets.begin(), bucket_offsets.end() - 1);
+      indices_by_bucket.resize(bucket_offsets.back());
+      for (int i = 0; i < num_candidates; ++i) {
+        if (!is_forced[i]) {
+          indices_by_bucket[bucket_fill[(*candidates)[i].bucket_index]++] = i;
+        }
+      }
+
+      // Fill every bucket with its strongest remaining candidates.
+      for (size_t bucket_idx = 0u; bucket_idx < num_buckets; ++bucket_idx) {
+        if (levels[bucket_idx] >= bucket_capacity) {
+          continue;
+        }
+        const std::vector<int>::iterator begin =
+            indices_by_bucket.begin() + bucket_offsets[bucket_idx];
+        const std::vector<int>::iterator end =
+            indices_by_bucket.begin() + bucket_offsets[bucket_idx + 1u];
+        const size_t num_accepted = std::min(
+            bucket_capacity - levels[bucket_idx], static_cast<size_t>(end - begin));
+        if (static_cast<std::ptrdiff_t>(num_accepted) < end - begin) {
+          std::nth_element(begin, begin + num_accepted, end, is_stronger);
+        }
+        for (std::vector<int>::iterator it = begin; it != begin + num_accepted; ++it) {
+          selected->push_back((*candidates)[*it]);
+        }
+      }
+
+      // Drop all candidates that share the score of a selected candidate but were not the
+      // first having it.
+      selected_scores.clear();
+      for (const NewTrackCandidate& candidate : *selected) {
+        selected_scores.push_back(candidate.score);
+      }
+      std::sort(selected_scores.begin(), selected_scores.end());
+      selected_scores.erase(std::unique(selected_scores.begin(), selected_scores.end()),
+                            selected_scores.end());
+      first_order_of_selected_score.assign(
+          selected_scores.size(), std::numeric_limits<int>::max());
+      const auto find_selected_score = [&selected_scores](double score) -> int {
+        std::vector<double>::const_iterator it =
+            std::lower_bound(selected_scores.begin(), selected_scores.end(), score);
+        if (it == selected_scores.end() || *it != score) {
+          return -1;
+        }
+        return static_cast<int>(it - selected_scores.begin());
+      };
+      for (const NewTrackCandidate& candidate : *candidates) {
+        const int score_idx = find_selected_score(candidate.score);
+        if (score_idx >= 0) {
+          first_order_of_selected_score[score_idx] =
+              std::min(first_order_of_selected_score[score_idx], candidate.order);
+        }
+      }
+      const std::vector<NewTrackCandidate>::iterator new_end = std::remove_if(
+          candidates->begin(), candidates->end(),
+          [&](const NewTrackCandidate& candidate) -> bool {
+        const int score_idx = find_selected_score(candidate.score);
+        return score_idx >= 0 && candidate.order != first_order_of_selected_score[score_idx];
+      });
+      dropped_duplicates = (new_end != candidates->end());
+      candidates->erase(new_end, candidates->end());
+    }
+
+    // The new track ids are assigned in order of decreasing score.
+    std::sort(selected->begin(), selected->end(), isStrongerCandidate);
+  }
+  }  // namespace
+
   ThreadSafeIdProvider<size_t> TrackManager::track_id_provider_(0u);
 
   Eigen::VectorXi* TrackManager::createAndGetTrackIdChannel(VisualFrame* frame) {
@@ -33,8 +193,8 @@ namespace aslam {
     size_t num_apple_track_ids = static_cast<size_t>(apple_track_ids.rows());
     size_t num_banana_track_ids = static_cast<size_t>(banana_track_ids.rows());
 
-    std::unordered_set<int> consumed_apples;
-    std::unordered_set<int> consumed_bananas;
+    std::vector<bool> consumed_apples(num_apple_track_ids, false);
+    std::vector<bool> consumed_bananas(num_banana_track_ids, false);
 
     for (const FrameToFrameMatchWithScore& match : matches_A_B) {
       int index_apple = match.getKeypointIndexAppleFrame();
@@ -45,7 +205,7 @@ namespace aslam {
       CHECK_LT(index_banana, static_cast<int>(num_banana_track_ids));
       CHECK_GE(index_banana, 0);
 
-      addToSetsAndCheckExclusiveness(index_apple,
+      markConsumedAndCheckExclusiveness(index_apple,
                                      index_banana,
                                      &consumed_apples,
                                      &consumed_bananas);
@@ -94,8 +254,8 @@ namespace aslam {
     size_t num_apple_track_ids = static_cast<size_t>(apple_track_ids.rows());
     size_t num_banana_track_ids = static_cast<size_t>(banana_track_ids.rows());
 
-    std::unordered_set<int> consumed_apples;
-    std::unordered_set<int> consumed_bananas;
+    std::vector<bool> consumed_apples(num_apple_track_ids, false);
+    std::vector<bool> consumed_bananas(num_banana_track_ids, false);
 
     const aslam::Camera::ConstPtr& camera = apple_frame->getCameraGeometry();
 
@@ -124,17 +284,18 @@ namespace aslam {
           return bin_index;
         };
 
-    std::set<FrameToFrameMatchWithScore, std::greater<MatchWithScore>>
-      candidates_for_new_tracks;
+    std::vector<NewTrackCandidate> candidates_for_new_tracks;
+    candidates_for_new_tracks.reserve(matches_A_B.size());
 
-    for (const FrameToFrameMatchWithScore& match : matches_A_B) {
+    for (size_t match_idx = 0u; match_idx < matches_A_B.size(); ++match_idx) {
+      const FrameToFrameMatchWithScore& match = matches_A_B[match_idx];
       int index_apple = match.getKeypointIndexAppleFrame();
       CHECK_LT(index_apple, static_cast<int>(num_apple_track_ids));
 
       int index_banana = match.getKeypointIndexBananaFrame();
       CHECK_LT(index_banana, static_cast<int>(num_banana_track_ids));
 
-      addToSetsAndCheckExclusiveness(index_apple,
+      markConsumedAndCheckExclusiveness(index_apple,
                                      index_banana,
                                      &consumed_apples,
                                      &consumed_bananas);
@@ -143,15 +304,20 @@ namespace aslam {
       int track_id_banana= banana_track_ids(index_banana);
 
       if ((track_id_apple) < 0 && (track_id_banana < 0)) {
-        // Both track ids are < 0. Candidate for a new track.
-        FrameToFrameMatchWithScore match_scored_by_keypoint_strenght = match;
+        // Both track ids are < 0. Candidate for a new track, scored by keypoint strength.
         const double apple_keypoint_score =
             apple_frame->getKeypointScores()(index_apple);
         const double banana_keypoint_score =
             banana_frame->getKeypointScores()(index_banana);
-        match_scored_by_keypoint_strenght.setScore(
-            0.5 * (apple_keypoint_score + banana_keypoint_score));
-        candidates_for_new_tracks.emplace(match_scored_by_keypoint_strenght);
+        const Eigen::Vector2d& keypoint =
+            apple_frame->getKeypointMeasurement(index_apple);
+        NewTrackCandidate candidate;
+        candidate.score = 0.5 * (apple_keypoint_score + banana_keypoint_score);
+        candidate.order = static_cast<int>(match_idx);
+        candidate.index_apple = index_apple;
+        candidate.index_banana = index_banana;
+        candidate.bucket_index = compute_bin_index(keypoint);
+        candidates_for_new_tracks.push_back(candidate);
       } else {
         // Either one of the track ids is >= 0.
         if (track_id_apple != track_id_banana) {
@@ -176,60 +342,19 @@ namespace aslam {
         ++buckets[bin_index];
       }
     }
-    // Push some number of very strong new track candidates.
-    size_t num_very_strong_candidates_pushed = 0u;
-    std::set<FrameToFrameMatchWithScore, std::greater<FrameToFrameMatchWithScore>>::
-      const_iterator iterator_matches_fo_new_tracks = candidates_for_new_tracks.begin();
-    for (; (iterator_matches_fo_new_tracks != candidates_for_new_tracks.end())
-        &&  (num_very_strong_candidates_pushed <
-            number_of_very_strong_new_tracks_to_force_push_);
-              ++iterator_matches_fo_new_tracks,
-              ++num_very_strong_candidates_pushed) {
-      // The matches are sorted. If we get below the unconditional threshold,
-      // we can stop.
-      if (iterator_matches_fo_new_tracks->getScore() <
-          match_score_very_strong_new_tracks_threshold_) break;
-
-      int index_apple = iterator_matches_fo_new_tracks->getKeypointIndexAppleFrame();
-      CHECK_LT(index_apple, static_cast<int>(num_apple_track_ids));
-
-      int index_banana = iterator_matches_fo_new_tracks->getKeypointIndexBananaFrame();
-      CHECK_LT(index_banana, static_cast<int>(num_banana_track_ids));
-
-      // Increment the corresponding bucket.
-      const Eigen::Vector2d& keypoint =
-          apple_frame->getKeypointMeasurement(index_apple);
-      int bin_index = compute_bin_index(keypoint);
-      ++buckets[bin_index];
-
-      // Write back the applied match.
-      int new_track_id = track_id_provider_.getNewId();
-      apple_track_ids(index_apple) = new_track_id;
-      banana_track_ids(index_banana) = new_track_id;
-    }
-
-    // Fill the buckets with the renmaining candidates.
-    for (; iterator_matches_fo_new_tracks != candidates_for_new_tracks.end();
-        ++iterator_matches_fo_new_tracks) {
-      int index_apple = iterator_matches_fo_new_tracks->getKeypointIndexAppleFrame();
-      CHECK_LT(index_apple, static_cast<int>(num_apple_track_ids));
-
-      int index_banana = iterator_matches_fo_new_tracks->getKeypointIndexBananaFrame();
-      CHECK_LT(index_banana, static_cast<int>(num_banana_track_ids));
-
-      // Get the bucket index and check if there is still space left.
-      const Eigen::Vector2d& keypoint =
-          apple_frame->getKeypointMeasurement(index_apple);
-      int bin_index = compute_bin_index(keypoint);
-
-      if (buckets[bin_index] < bucket_capacity_) {
-        ++buckets[bin_index];
-
-        // Write back the applied match.
-        int new_track_id = track_id_provider_.getNewId();
-        apple_track_ids(index_apple) = new_track_id;
-        banana_track_ids(index_banana) = new_track_id;
-      }
+    // Push some number of very strong new track candidates and fill the buckets with the
+    // remaining ones.
+    std::vector<NewTrackCandidate> new_tracks;
+    selectNewTrackCandidates(
+        buckets, bucket_capacity_, number_of_very_strong_new_tracks_to_force_push_,
+        match_score_very_strong_new_tracks_threshold_, &candidates_for_new_tracks, &new_tracks);
+
+    // Write back the applied matches with one contiguous range of new track ids.
+    int new_track_id = track_id_provider_.reserveIds(new_tracks.size());
+    for (const NewTrackCandidate& new_track : new_tracks) {
+      apple_track_ids(new_track.index_apple) = new_track_id;
+      banana_track_ids(new_track.index_banana) = new_track_id;
+      ++new_track_id;
     }
   }
 }
@@ -0,0 +1,174 @@
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <aslam/matcher/match.h>
+#include <aslam/simulation/synthetic-scene.h>
+#include <aslam/tracker/feature-tracker-gyro-ncamera.h>
+#include <aslam/tracker/feature-tracker-gyro.h>
+#include <aslam/tracker/track-manager.h>
+#include <brisk/brisk.h>
+#include <Eigen/Geometry>
+#include <eigen-checks/gtest.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace aslam {
+
+constexpr size_t kNumCameras = 4u;
+constexpr size_t kNumFrames = 4u;
+constexpr size_t kNumKeypointsPerFrame = 300u;
+constexpr size_t kMinDistanceToImageBorderPx = 30u;
+constexpr int64_t kFramePeriodNanoseconds = 50000000;
+
+class GyroNCameraTrackerTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    simulation::SyntheticScene::Options options;
+    options.num_frames = kNumFrames;
+    options.frame_period_nanoseconds = kFramePeriodNanoseconds;
+    options.start_timestamp_nanoseconds = kFramePeriodNanoseconds;
+    options.trajectory_type = simulation::TrajectoryType::kRotation;
+    // Two degrees per frame.
+    options.angular_speed_rad_s = 2.0 / 180.0 * M_PI / (kFramePeriodNanoseconds * 1e-9);
+    options.position_noise_m = 0.0;
+    options.orientation_noise_rad = 0.0;
+    options.min_distance_to_image_border_px = kMinDistanceToImageBorderPx;
+    options.add_raw_images = true;
+    scene_ = simulation::SyntheticScene::createWithNumKeypointsPerFrame(
+        createSurroundNCamera(), kNumKeypointsPerFrame, options);
+  }
+
+  /// The synthetic pinhole camera, rotated about the body z axis in steps of 90 degrees, such
+  /// that every camera has other extrinsics.
+  static NCamera::Ptr createSurroundNCamera() {
+    const NCamera::Ptr forward_ncamera = simulation::createPinholeNCamera(640u, 480u);
+    const Transformation& T_C_B_forward = forward_ncamera->get_T_C_B(0u);
+    std::vector<Camera::Ptr> cameras;
+    TransformationVector T_C_Bs;
+    for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+      cameras.emplace_back(forward_ncamera->getCamera(0u).clone());
+      CameraId camera_id;
+      camera_id.randomize();
+      cameras.back()->setId(camera_id);
+      const Quaternion q_B_Bcamera(Eigen::AngleAxisd(
+          0.5 * M_PI * camera_idx, Eigen::Vector3d::UnitZ()).toRotationMatrix());
+      T_C_Bs.push_back(
+          T_C_B_forward * Transformation(q_B_Bcamera, Position3D::Zero()).inverse());
+    }
+    NCameraId ncamera_id;
+    ncamera_id.randomize();
+    return aligned_shared<NCamera>(ncamera_id, T_C_Bs, cameras, "Synthetic surround camera");
+  }
+
+  static std::vector<cv::Ptr<cv::DescriptorExtractor>> createExtractors() {
+    std::vector<cv::Ptr<cv::DescriptorExtractor>> extractors;
+    for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+      extractors.emplace_back(new brisk::BriskDescriptorExtractor(true, false));
+    }
+    return extractors;
+  }
+
+  Quaternion get_q_Bkp1_Bk(size_t frame_index_k) const {
+    return (scene_->get_T_G_B(frame_index_k + 1u).inverse() *
+        scene_->get_T_G_B(frame_index_k)).getRotation();
+  }
+
+  simulation::SyntheticScene::Ptr scene_;
+};
+
+TEST_F(GyroNCameraTrackerTest, CameraRotationsAreDerivedFromTheBodyRotation) {
+  const NCamera::Ptr& ncamera = scene_->getNCamera();
+  for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+    const Quaternion& q_C_B = ncamera->get_T_C_B(camera_idx).getRotation();
+    const Quaternion q_Ckp1_Ck = q_C_B * get_q_Bkp1_Bk(0u) * q_C_B.inverse();
+    const Quaternion expected_q_Ckp1_Ck = scene_->get_T_Ca_Cb(1u, 0u, camera_idx).getRotation();
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(expected_q_Ckp1_Ck.getRotationMatrix(),
+                                  q_Ckp1_Ck.getRotationMatrix(), 1e-9)) << "Camera " << camera_idx;
+  }
+}
+
+TEST_F(GyroNCameraTrackerTest, ParallelTrackingEqualsSequentialTracking) {
+  const NCamera::Ptr& ncamera = scene_->getNCamera();
+  ASSERT_EQ(kNumCameras, ncamera->getNumCameras());
+
+  // The reference tracks the cameras one after another with a tracker per camera.
+  const std::vector<cv::Ptr<cv::DescriptorExtractor>> sequential_extractors = createExtractors();
+  std::vector<std::unique_ptr<GyroTracker>> sequential_trackers;
+  std::vector<std::unique_ptr<UniformTrackManager>> sequential_track_managers;
+  std::vector<std::unique_ptr<UniformTrackManager>> parallel_track_managers;
+  for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+    sequential_trackers.emplace_back(new GyroTracker(
+        ncamera->getCamera(camera_idx), kMinDistanceToImageBorderPx,
+        sequential_extractors[camera_idx]));
+    sequential_track_managers.emplace_back(new UniformTrackManager(4u, 200u, 50u, 0.85));
+    parallel_track_managers.emplace_back(new UniformTrackManager(4u, 200u, 50u, 0.85));
+  }
+  // Fewer threads than cameras, such that the trackers are queued.
+  GyroNCameraTracker parallel_tracker(
+      ncamera, kMinDistanceToImageBorderPx, createExtractors(), kNumCameras / 2u);
+  ASSERT_EQ(kNumCameras, parallel_tracker.getNumCameras());
+
+  VisualNFrame::Ptr sequential_nframe_k = scene_->createNFrame(0u).nframe;
+  VisualNFrame::Ptr parallel_nframe_k = scene_->createNFrame(0u).nframe;
+  for (size_t frame_idx = 1u; frame_idx < kNumFrames; ++frame_idx) {
+    SCOPED_TRACE(::testing::Message() << "Frame " << frame_idx);
+    const Quaternion q_Bkp1_Bk = get_q_Bkp1_Bk(frame_idx - 1u);
+
+    const VisualNFrame::Ptr sequential_nframe_kp1 = scene_->createNFrame(frame_idx).nframe;
+    std::vector<FrameToFrameMatchesWithScore> sequential_matches_kp1_k(kNumCameras);
+    for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+      const Quaternion& q_C_B = ncamera->get_T_C_B(camera_idx).getRotation();
+      sequential_trackers[camera_idx]->track(
+          q_C_B * q_Bkp1_Bk * q_C_B.inverse(), sequential_nframe_k->getFrame(camera_idx),
+          sequential_nframe_kp1->getFrameShared(camera_idx).get(),
+          &sequential_matches_kp1_k[camera_idx]);
+    }
+
+    const VisualNFrame::Ptr parallel_nframe_kp1 = scene_->createNFrame(frame_idx).nframe;
+    std::vector<FrameToFrameMatchesWithScore> parallel_matches_kp1_k;
+    parallel_tracker.track(q_Bkp1_Bk, *parallel_nframe_k, parallel_nframe_kp1.get(),
+                           &parallel_matches_kp1_k);
+
+    ASSERT_EQ(kNumCameras, parallel_matches_kp1_k.size());
+    for (size_t camera_idx = 0u; camera_idx < kNumCameras; ++camera_idx) {
+      SCOPED_TRACE(::testing::Message() << "Camera " << camera_idx);
+      EXPECT_FALSE(parallel_matches_kp1_k[camera_idx].empty());
+      EXPECT_TRUE(sequential_matches_kp1_k[camera_idx] == parallel_matches_kp1_k[camera_idx]);
+      // Including the keypoints and the descriptors appended by the LK tracking.
+      const VisualFrame& sequential_frame_kp1 = sequential_nframe_kp1->getFrame(camera_idx);
+      const VisualFrame& parallel_frame_kp1 = parallel_nframe_kp1->getFrame(camera_idx);
+      EXPECT_EQ(sequential_frame_kp1.getKeypointMeasurements(),
+                parallel_frame_kp1.getKeypointMeasurements());
+      EXPECT_EQ(sequential_frame_kp1.getDescriptors(), parallel_frame_kp1.getDescriptors());
+
+      sequential_track_managers[camera_idx]->applyMatchesToFrames(
+          sequential_matches_kp1_k[camera_idx],
+          sequential_nframe_kp1->getFrameShared(camera_idx).get(),
+          sequential_nframe_k->getFrameShared(camera_idx).get());
+      parallel_track_managers[camera_idx]->applyMatchesToFrames(
+          parallel_matches_kp1_k[camera_idx],
+          parallel_nframe_kp1->getFrameShared(camera_idx).get(),
+          parallel_nframe_k->getFrameShared(camera_idx).get());
+      // The track ids are drawn from a shared provider, only the tracked keypoints are equal.
+      const Eigen::VectorXi& sequential_track_ids = sequential_frame_kp1.getTrackIds();
+      const Eigen::VectorXi& parallel_track_ids = parallel_frame_kp1.getTrackIds();
+      ASSERT_EQ(sequential_track_ids.size(), parallel_track_ids.size());
+      for (int i = 0; i < sequential_track_ids.size(); ++i) {
+        EXPECT_EQ(sequential_track_ids(i) >= 0, parallel_track_ids(i) >= 0) << "Keypoint " << i;
+      }
+    }
+    sequential_nframe_k = sequential_nframe_kp1;
+    parallel_nframe_k = parallel_nframe_kp1;
+  }
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/deadline.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <aslam/matcher/match.h>
+#include <aslam/simulation/synthetic-scene.h>
+#include <aslam/tracker/feature-tracker-gyro.h>
+#include <aslam/tracker/track-manager.h>
+#include <brisk/brisk.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+DECLARE_bool(gyro_detection_mask);
+DECLARE_double(gyro_detection_mask_cell_size_px);
+DECLARE_double(gyro_detection_mask_radius_px);
+DECLARE_uint64(gyro_detection_mask_max_points_per_cell);
+DECLARE_uint64(gyro_lk_descriptor_keyframe_interval);
+
+namespace aslam {
+
+constexpr size_t kNumKeypointsPerFrame = 500u;
+constexpr size_t kMinDistanceToImageBorderPx = 30u;
+constexpr int64_t kFramePeriodNanoseconds = 50000000;
+
+class GyroTrackerTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    simulation::SyntheticScene::Options options;
+    options.num_frames = 3u;
+    options.frame_period_nanoseconds = kFramePeriodNanoseconds;
+    options.start_timestamp_nanoseconds = kFramePeriodNanoseconds;
+    options.trajectory_type = simulation::TrajectoryType::kRotation;
+    // Two degrees per frame.
+    options.angular_speed_rad_s = 2.0 / 180.0 * M_PI / (kFramePeriodNanoseconds * 1e-9);
+    options.position_noise_m = 0.0;
+    options.orientation_noise_rad = 0.0;
+    options.min_distance_to_image_border_px = kMinDistanceToImageBorderPx;
+    options.add_raw_images = true;
+    const NCamera::Ptr ncamera = simulation::createPinholeNCamera(640u, 480u);
+    scene_ = simulation::SyntheticScene::createWithNumKeypointsPerFrame(
+        ncamera, kNumKeypointsPerFrame, options);
+    camera_ = ncamera->getCameraShared(0u);
+    extractor_ = new brisk::BriskDescriptorExtractor(true, false);
+  }
+
+  VisualFrame::Ptr createFrame(size_t frame_index) const {
+    return scene_->createNFrame(frame_index).nframe->getFrameShared(0u);
+  }
+
+  /// Tracks frame 0 to frame 1, such that the matched keypoints of frame 1 are LK candidates
+  /// once they are not matched in frame 2.
+  void trackFirstFrames(GyroTracker* tracker, VisualFrame::Ptr* frame_k) const {
+    CHECK_NOTNULL(tracker);
+    const VisualFrame::Ptr frame_km1 = createFrame(0u);
+    *CHECK_NOTNULL(frame_k) = createFrame(1u);
+    FrameToFrameMatchesWithScore matches_k_km1;
+    tracker->track(scene_->get_T_Ca_Cb(1u, 0u, 0u).getRotation(), *frame_km1,
+                   frame_k->get(), &matches_k_km1);
+    ASSERT_FALSE(matches_k_km1.empty());
+    UniformTrackManager track_manager(4u, 200u, 50u, 0.85);
+    track_manager.applyMatchesToFrames(matches_k_km1, frame_k->get(), frame_km1.get());
+  }
+
+  simulation::SyntheticScene::Ptr scene_;
+  Camera::Ptr camera_;
+  cv::Ptr<cv::DescriptorExtractor> extractor_;
+};
+
+TEST_F(GyroTrackerTest, ExpiredDeadlineSkipsLkTracking) {
+  const Quaternion q_Ckp1_Ck = scene_->get_T_Ca_Cb(2u, 1u, 0u).getRotation();
+
+  GyroTracker tracker(*camera_, kMinDistanceToImageBorderPx, extractor_);
+  VisualFrame::Ptr frame_k;
+  trackFirstFrames(&tracker, &frame_k);
+  const VisualFrame::Ptr frame_kp1 = createFrame(2u);
+  const size_t num_keypoints_kp1 = frame_kp1->getNumKeypointMeasurements();
+  FrameToFrameMatchesWithScore matches_kp1_k;
+  {
+    common::DeadlineScope deadline_scope(common::Deadline::fromNow(0));
+    tracker.track(q_Ckp1_Ck, *frame_k, frame_kp1.get(), &matches_kp1_k);
+  }
+  const common::Degradations& degradations = frame_kp1->getDegradations();
+  EXPECT_TRUE(degradations.has(common::Degradation::kSkippedLkTracking));
+  EXPECT_TRUE(degradations.has(common::Degradation::kShrunkSearchWindows));
+  // No keypoints are LK-tracked into frame (k+1), the gyro predictions are exact and the
+  // descriptor matches are found in the small windows.
+  EXPECT_EQ(num_keypoints_kp1, frame_kp1->getNumKeypointMeasurements());
+  EXPECT_FALSE(matches_kp1_k.empty());
+  for (const FrameToFrameMatchWithScore& match : matches_kp1_k) {
+    EXPECT_LT(static_cast<size_t>(match.getKeypointIndexAppleFrame()), num_keypoints_kp1);
+  }
+}
+
+TEST_F(GyroTrackerTest, UnboundedDeadlineKeepsLkTracking) {
+  GyroTracker tracker(*camera_, kMinDistanceToImageBorderPx, extractor_);
+  VisualFrame::Ptr frame_k;
+  trackFirstFrames(&tracker, &frame_k);
+  const VisualFrame::Ptr frame_kp1 = createFrame(2u);
+  FrameToFrameMatchesWithScore matches_kp1_k;
+  {
+    common::DeadlineScope deadline_scope(
+        common::Deadline::fromNow(100 * kFramePeriodNanoseconds));
+    tracker.track(scene_->get_T_Ca_Cb(2u, 1u, 0u).getRotation(), *frame_k, frame_kp1.get(),
+                  &matches_kp1_k);
+  }
+  EXPECT_TRUE(frame_kp1->getDegradations().empty());
+  EXPECT_FALSE(matches_kp1_k.empty());
+}
+
+// Sets the detection mask mode and the descriptor keyframe interval and restores the flags at
+// the end of a test.
+class ScopedTrackerFlags {
+ public:
+  ScopedTrackerFlags(bool detection_mask, uint64_t descriptor_keyframe_interval)
+      : previous_detection_mask_(FLAGS_gyro_detection_mask),
+        previous_keyframe_interval_(FLAGS_gyro_lk_descriptor_keyframe_interval) {
+    FLAGS_gyro_detection_mask = detection_mask;
+    FLAGS_gyro_lk_descriptor_keyframe_interval = descriptor_keyframe_interval;
+  }
+  ~ScopedTrackerFlags() {
+    FLAGS_gyro_detection_mask = previous_detection_mask_;
+    FLAGS_gyro_lk_descriptor_keyframe_interval = previous_keyframe_interval_;
+  }
+
+ private:
+  const bool previous_detection_mask_;
+  const uint64_t previous_keyframe_interval_;
+};
+
+TEST_F(GyroTrackerTest, CarriedDescriptorsKeepTheExtractorBorder) {
+  // Only the first track() call describes the LK-tracked keypoints.
+  ScopedTrackerFlags tracker_flags(false, 1000u);
+  GyroTracker tracker(*camera_, kMinDistanceToImageBorderPx, extractor_);
+  VisualFrame::Ptr frame_k;
+  trackFirstFrames(&tracker, &frame_k);
+  // Keypoints whose descriptor support reaches further than the border of the LK tracking.
+  const double kKeypointScale = 100.0;
+  frame_k->getKeypointScalesMutable()->setConstant(kKeypointScale);
+
+  const VisualFrame::Ptr frame_kp1 = createFrame(2u);
+  const size_t num_detected_keypoints_kp1 = frame_kp1->getNumKeypointMeasurements();
+  FrameToFrameMatchesWithScore matches_kp1_k;
+  tracker.track(scene_->get_T_Ca_Cb(2u, 1u, 0u).getRotation(), *frame_k, frame_kp1.get(),
+                &matches_kp1_k);
+  const size_t num_keypoints_kp1 = frame_kp1->getNumKeypointMeasurements();
+  ASSERT_GT(num_keypoints_kp1, num_detected_keypoints_kp1);
+
+  const double min_distance_px = 0.5 * kKeypointScale;
+  for (size_t i = num_detected_keypoints_kp1; i < num_keypoints_kp1; ++i) {
+    const Eigen::Vector2d keypoint = frame_kp1->getKeypointMeasurement(i);
+    EXPECT_GE(keypoint(0), min_distance_px) << "Keypoint " << i;
+    EXPECT_GE(keypoint(1), min_distance_px) << "Keypoint " << i;
+    EXPECT_LT(keypoint(0), camera_->imageWidth() - min_distance_px) << "Keypoint " << i;
+    EXPECT_LT(keypoint(1), camera_->imageHeight() - min_distance_px) << "Keypoint " << i;
+  }
+  // The LK-tracked keypoints have the descriptors of the keypoints they were tracked from.
+  for (const FrameToFrameMatchWithScore& match : matches_kp1_k) {
+    const size_t index_kp1 = static_cast<size_t>(match.getKeypointIndexAppleFrame());
+    if (index_kp1 >= num_detected_keypoints_kp1) {
+      EXPECT_EQ(frame_k->getDescriptors().col(match.getKeypointIndexBananaFrame()),
+                frame_kp1->getDescriptors().col(index_kp1)) << "Keypoint " << index_kp1;
+    }
+  }
+}
+
+TEST_F(GyroTrackerTest, DetectionMaskCoversTheTrackedKeypoints) {
+  // A descriptor keyframe every second frame.
+  ScopedTrackerFlags tracker_flags(true, 2u);
+  GyroTracker tracker(*camera_, kMinDistanceToImageBorderPx, extractor_);
+  VisualFrame::Ptr frame_k;
+  trackFirstFrames(&tracker, &frame_k);
+
+  // The mask of frame k, which was frame (k+1) of the first track() call.
+  const cv::Mat& mask = tracker.getDetectionMask();
+  ASSERT_EQ(static_cast<int>(camera_->imageHeight()), mask.rows);
+  ASSERT_EQ(static_cast<int>(camera_->imageWidth()), mask.cols);
+  ASSERT_EQ(CV_8UC1, mask.type());
+
+  const int cell_size_px = static_cast<int>(FLAGS_gyro_detection_mask_cell_size_px);
+  const int num_cell_rows = (mask.rows + cell_size_px - 1) / cell_size_px;
+  const int num_cell_cols = (mask.cols + cell_size_px - 1) / cell_size_px;
+  std::vector<size_t> num_points_per_cell(num_cell_rows * num_cell_cols, 0u);
+  const Eigen::Matrix2Xd& keypoints = frame_k->getKeypointMeasurements();
+  std::vector<cv::Point> keypoint_pixels;
+  for (int i = 0; i < keypoints.cols(); ++i) {
+    const cv::Point pixel(
+        std::min(std::max(static_cast<int>(keypoints(0, i)), 0), mask.cols - 1),
+        std::min(std::max(static_cast<int>(keypoints(1, i)), 0), mask.rows - 1));
+    keypoint_pixels.push_back(pixel);
+    ++num_points_per_cell[(pixel.y / cell_size_px) * num_cell_cols + pixel.x / cell_size_px];
+    // No new keypoints are detected on the tracked ones.
+    EXPECT_EQ(0u, mask.at<unsigned char>(pixel)) << "Keypoint " << i;
+  }
+
+  // Away from the keypoints, only the full cells are masked.
+  const double free_distance_px = FLAGS_gyro_detection_mask_radius_px + 1.5;
+  size_t num_free_pixels = 0u;
+  size_t num_full_cell_pixels = 0u;
+  for (int row = 0; row < mask.rows; row += 3) {
+    for (int col = 0; col < mask.cols; col += 3) {
+      const bool is_cell_full =
+          num_points_per_cell[(row / cell_size_px) * num_cell_cols + col / cell_size_px] >=
+          FLAGS_gyro_detection_mask_max_points_per_cell;
+      const bool is_near_keypoint = std::any_of(
+          keypoint_pixels.begin(), keypoint_pixels.end(), [&](const cv::Point& pixel) {
+            return std::hypot(pixel.x - col, pixel.y - row) <= free_distance_px;
+          });
+      if (is_cell_full) {
+        EXPECT_EQ(0u, mask.at<unsigned char>(row, col)) << row << ", " << col;
+        ++num_full_cell_pixels;
+      } else if (!is_near_keypoint) {
+        EXPECT_EQ(255u, mask.at<unsigned char>(row, col)) << row << ", " << col;
+        ++num_free_pixels;
+      }
+    }
+  }
+  EXPECT_GT(num_free_pixels, 0u);
+  EXPECT_GT(num_full_cell_pixels, 0u);
+
+  // The next frame is a descriptor keyframe, which is searched in the whole image.
+  const VisualFrame::Ptr frame_kp1 = createFrame(2u);
+  FrameToFrameMatchesWithScore matches_kp1_k;
+  tracker.track(scene_->get_T_Ca_Cb(2u, 1u, 0u).getRotation(), *frame_k, frame_kp1.get(),
+                &matches_kp1_k);
+  EXPECT_TRUE(tracker.getDetectionMask().empty());
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 #include <aslam/cameras/camera-pinhole.h>
 #include <aslam/common/entrypoint.h>
 #include <aslam/frames/visual-frame.h>
@@ -242,6 +246,62 @@ TEST(TrackManagerTests, TestApplyMatchesUniformly) {
   EXPECT_TRUE(EIGEN_MATRIX_EQUAL(expected_apple_tracks, apple_tracks));
 }
 
+TEST(TrackManagerTests, TestApplyMatchesUniformlyEqualScores) {
+  aslam::TrackManager::resetIdProvider();
+
+  aslam::Camera::Ptr camera = aslam::PinholeCamera::createTestCamera();
+  aslam::VisualFrame::Ptr banana_frame =
+      aslam::VisualFrame::createEmptyTestVisualFrame(camera, 0);
+  aslam::VisualFrame::Ptr apple_frame =
+      aslam::VisualFrame::createEmptyTestVisualFrame(camera, 1);
+
+  const size_t kNumKeypoints = 10u;
+  Eigen::Matrix2Xd banana_keypoints = Eigen::Matrix2Xd::Ones(2, kNumKeypoints);
+  Eigen::Matrix2Xd apple_keypoints = Eigen::Matrix2Xd::Ones(2, kNumKeypoints);
+  Eigen::VectorXi banana_tracks = Eigen::VectorXi::Constant(kNumKeypoints, -1);
+  Eigen::VectorXi apple_tracks = Eigen::VectorXi::Constant(kNumKeypoints, -1);
+
+  // Pairs of equal scores: {0.9, 0.9, 0.7, 0.7, 0.5, 0.5, ...}.
+  Eigen::VectorXd banana_scores(kNumKeypoints);
+  Eigen::VectorXd apple_scores(kNumKeypoints);
+  aslam::FrameToFrameMatchesWithScore matches_A_B;
+  for (size_t match_idx = 0; match_idx < kNumKeypoints; ++match_idx) {
+    const double score = 0.9 - 0.2 * static_cast<double>(match_idx / 2u);
+    matches_A_B.emplace_back(match_idx, match_idx, score);
+    apple_scores(match_idx) = score;
+    banana_scores(match_idx) = score;
+  }
+
+  banana_frame->swapKeypointMeasurements(&banana_keypoints);
+  apple_frame->swapKeypointMeasurements(&apple_keypoints);
+  banana_frame->swapTrackIds(&banana_tracks);
+  apple_frame->swapTrackIds(&apple_tracks);
+  banana_frame->swapKeypointScores(&banana_scores);
+  apple_frame->swapKeypointScores(&apple_scores);
+
+  // A single bucket of capacity 3 of which the force pushed track takes one.
+  const size_t kNumBucketsRoot = 1u;
+  const size_t kMaxNumWeakNewTracks = 3u;
+  const size_t kNumStrongToPush = 1u;
+  const double kScoreTresholdUnconditional = 0.8;
+  aslam::UniformTrackManager track_manager(kNumBucketsRoot,
+                                           kMaxNumWeakNewTracks,
+                                           kNumStrongToPush,
+                                           kScoreTresholdUnconditional);
+  track_manager.applyMatchesToFrames(matches_A_B,
+                                     apple_frame.get(),
+                                     banana_frame.get());
+
+  // Of the candidates with equal scores only the first one is considered.
+  Eigen::VectorXi expected_tracks = Eigen::VectorXi::Constant(kNumKeypoints, -1);
+  expected_tracks(0) = 0;
+  expected_tracks(2) = 1;
+  expected_tracks(4) = 2;
+
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(expected_tracks, banana_frame->getTrackIds()));
+  EXPECT_TRUE(EIGEN_MATRIX_EQUAL(expected_tracks, apple_frame->getTrackIds()));
+}
+
 TEST(TrackManagerTests, TestApplyMatchesUniformEmpty) {
   aslam::TrackManager::resetIdProvider();
 
@@ -296,4 +356,42 @@ TEST(TrackManagerTests, TestApplyMatchesUniformEmpty) {
   EXPECT_TRUE(EIGEN_MATRIX_EQUAL(expected_apple_tracks, apple_tracks));
 }
 
+TEST(TrackManagerTests, TestIdProviderIsUniqueAcrossThreads) {
+  aslam::ThreadSafeIdProvider<size_t> id_provider(10u);
+  EXPECT_EQ(10u, id_provider.getNewId());
+  EXPECT_EQ(11u, id_provider.reserveIds(5u));
+  EXPECT_EQ(16u, id_provider.getNewId());
+  id_provider.reset();
+
+  const size_t kNumThreads = 4u;
+  const size_t kNumIterations = 1000u;
+  const size_t kBlockSize = 3u;
+  std::vector<std::vector<size_t>> ids(kNumThreads);
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0u; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&, thread_idx]() {
+      for (size_t i = 0u; i < kNumIterations; ++i) {
+        ids[thread_idx].push_back(id_provider.getNewId());
+        const size_t first_id = id_provider.reserveIds(kBlockSize);
+        for (size_t j = 0u; j < kBlockSize; ++j) {
+          ids[thread_idx].push_back(first_id + j);
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<size_t> all_ids;
+  for (const std::vector<size_t>& thread_ids : ids) {
+    all_ids.insert(all_ids.end(), thread_ids.begin(), thread_ids.end());
+  }
+  std::sort(all_ids.begin(), all_ids.end());
+  ASSERT_EQ(kNumThreads * kNumIterations * (kBlockSize + 1u), all_ids.size());
+  for (size_t i = 0u; i < all_ids.size(); ++i) {
+    EXPECT_EQ(10u + i, all_ids[i]);
+  }
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,82 @@
+#ifndef ASLAM_INCREMENTAL_TRIANGULATOR_H_
+#define ASLAM_INCREMENTAL_TRIANGULATOR_H_
+
+#include <vector>
+
+#include <aslam/common/macros.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <Eigen/Core>
+
+#include "aslam/triangulation/triangulation.h"
+
+namespace aslam {
+
+/// \class IncrementalTriangulator
+/// \brief Keeps the landmark estimates of growing feature tracks, such that adding an
+///        observation to a long track does not re-triangulate it from scratch.
+///
+/// Every track stores the 3x3 normal equations of the ray distances
+/// sum_i w_i * |(I - d_i * d_i^T) * (p_G_P - p_G_C[i])|^2 with unit directions d_i. The weight of
+/// an observation is the inverse squared distance of the camera to the last estimate, which
+/// turns the ray distances into the angular errors around the warm start. The cost is linear in
+/// the landmark, hence the Gauss-Newton step from the last estimate solves the updated system
+/// exactly. A new observation is added in O(1), independent of the track length. The
+/// observations are only buffered until the first successful triangulation, which weights them
+/// with the first estimate.
+class IncrementalTriangulator {
+ public:
+  ASLAM_POINTER_TYPEDEFS(IncrementalTriangulator);
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(IncrementalTriangulator);
+
+  IncrementalTriangulator() {};
+
+  /// \brief Adds an observation to a track and updates its landmark.
+  /// @param[in]  track_id         Id of the track, a new track is created for unknown ids.
+  /// @param[in]  C_bearing_vector Bearing vector of the observation in the camera frame,
+  ///                              need not be normalized.
+  /// @param[in]  T_G_C            Pose of the observing camera.
+  /// @param[out] G_point          Updated landmark, only set if the triangulation succeeded.
+  /// @return Result of the triangulation with all observations of the track.
+  TriangulationResult addObservation(size_t track_id, const Eigen::Vector3d& C_bearing_vector,
+                                     const aslam::Transformation& T_G_C, Eigen::Vector3d* G_point);
+
+  /// Last successful estimate of the landmark. Returns false if there is none.
+  bool getLandmark(size_t track_id, Eigen::Vector3d* G_point) const;
+  /// Number of observations of the track, 0 for unknown tracks.
+  size_t getNumObservations(size_t track_id) const;
+
+  void removeTrack(size_t track_id) { track_states_.erase(track_id); }
+  void clear() { track_states_.clear(); }
+  size_t numTracks() const { return track_states_.size(); }
+
+ private:
+  struct TrackState {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    TrackState()
+        : AtA(Eigen::Matrix3d::Zero()), Atb(Eigen::Vector3d::Zero()),
+          G_point(Eigen::Vector3d::Zero()), num_observations(0u), has_estimate(false) {}
+    /// Accumulated normal equations AtA * p_G_P = Atb.
+    Eigen::Matrix3d AtA;
+    Eigen::Vector3d Atb;
+    Eigen::Vector3d G_point;
+    size_t num_observations;
+    bool has_estimate;
+    /// Unit directions and camera positions in the global frame, only kept until the first
+    /// successful triangulation.
+    Aligned<std::vector, Eigen::Vector3d> pending_G_directions;
+    Aligned<std::vector, Eigen::Vector3d> pending_p_G_Cs;
+  };
+
+  /// Adds the weighted ray of one observation to the normal equations.
+  static void accumulateRay(const Eigen::Vector3d& G_direction, const Eigen::Vector3d& p_G_C,
+                            double weight, TrackState* state);
+  /// Solves the normal equations and updates the estimate on success.
+  static TriangulationResult solve(TrackState* state);
+
+  AlignedUnorderedMap<size_t, TrackState> track_states_;
+};
+
+}  // namespace aslam
+
+#endif  // ASLAM_INCREMENTAL_TRIANGULATOR_H_
@@ -4,8 +4,12 @@
 #include <Eigen/Eigen>
 #include <gtest/gtest.h>
 
+#include <aslam/cameras/camera.h>
+#include <aslam/cameras/ncamera.h>
 #include <aslam/common/memory.h>
 #include <aslam/common/pose-types.h>
+#include <aslam/frames/feature-track.h>
+#include <aslam/frames/visual-nframe.h>
 #include <aslam/triangulation/triangulation.h>
 #include <eigen-checks/gtest.h>
 
@@ -53,6 +57,55 @@ void fillObservations(
   }
 }
 
+/// Creates feature tracks of landmarks in front of a test camera moving sideways, with one
+/// nframe per pose. Track i is observed from the first 2 + i % (num_poses - 1) poses.
+void createTestFeatureTracks(
+    size_t num_tracks, size_t num_poses, aslam::FeatureTracks* tracks,
+    std::vector<aslam::TransformationVector>* T_W_Bs_per_track,
+    Aligned<std::vector, Eigen::Vector3d>* W_landmarks) {
+  CHECK_NOTNULL(tracks)->clear();
+  CHECK_NOTNULL(T_W_Bs_per_track)->clear();
+  CHECK_NOTNULL(W_landmarks)->clear();
+  CHECK_GE(num_poses, 2u);
+
+  const aslam::NCamera::Ptr ncamera = aslam::NCamera::createTestNCamera(1u);
+  const aslam::Camera& camera = ncamera->getCamera(0u);
+  const aslam::Transformation& T_C_B = ncamera->get_T_C_B(0u);
+
+  // Landmarks in the field of view of the first camera, which defines the world frame.
+  for (size_t track_idx = 0u; track_idx < num_tracks; ++track_idx) {
+    const double depth = 4.0 + 4.0 * static_cast<double>(track_idx) / num_tracks;
+    const Eigen::Vector2d offset = 0.3 * depth * Eigen::Vector2d::Random();
+    W_landmarks->emplace_back(offset(0), offset(1), depth);
+  }
+
+  aslam::TransformationVector T_W_Bs;
+  std::vector<aslam::VisualNFrame::Ptr> nframes;
+  for (size_t pose_idx = 0u; pose_idx < num_poses; ++pose_idx) {
+    aslam::Transformation T_W_C;
+    T_W_C.getPosition() << 0.1 * static_cast<double>(pose_idx), 0.0, 0.0;
+    T_W_Bs.push_back(T_W_C * T_C_B);
+
+    Eigen::Matrix2Xd keypoints(2, num_tracks);
+    for (size_t track_idx = 0u; track_idx < num_tracks; ++track_idx) {
+      Eigen::Vector2d keypoint;
+      camera.project3(T_W_C.inverse() * (*W_landmarks)[track_idx], &keypoint);
+      keypoints.col(track_idx) = keypoint;
+    }
+    nframes.push_back(aslam::VisualNFrame::createEmptyTestVisualNFrame(ncamera, pose_idx));
+    nframes.back()->getFrameShared(0u)->setKeypointMeasurements(keypoints);
+  }
+
+  for (size_t track_idx = 0u; track_idx < num_tracks; ++track_idx) {
+    const size_t track_length = 2u + track_idx % (num_poses - 1u);
+    tracks->emplace_back(track_idx, track_length);
+    for (size_t pose_idx = 0u; pose_idx < track_length; ++pose_idx) {
+      tracks->back().addKeypointObservationAtBack(nframes[pose_idx], 0u, track_idx);
+    }
+    T_W_Bs_per_track->emplace_back(T_W_Bs.begin(), T_W_Bs.begin() + track_length);
+  }
+}
+
 template <typename MeasurementsType>
 class TriangulationFixture : public testing::Test {
  protected:
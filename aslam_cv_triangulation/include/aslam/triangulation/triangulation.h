@@ -1,5 +1,7 @@
 #ifndef TRIANGULATION_H_
 #define TRIANGULATION_H_
+#include <cstdint>
+#include <map>
 #include <vector>
 
 #include <aslam/common/memory.h>
@@ -20,6 +22,8 @@ struct TriangulationResult {
     kTooFewMeasurments,
     /// The landmark is not fully observable (rank deficiency).
     kUnobservable,
+    /// Too few observations agree with the landmark, see robustTriangulateFeatureTracks.
+    kTooFewInliers,
     /// Default value after construction.
     kUninitialized
   };
@@ -28,6 +32,7 @@ struct TriangulationResult {
   static Status SUCCESSFUL;
   static Status TOO_FEW_MEASUREMENTS;
   static Status UNOBSERVABLE;
+  static Status TOO_FEW_INLIERS;
   static Status UNINITIALIZED;
 
   constexpr TriangulationResult() : status_(Status::kUninitialized) {};
@@ -44,6 +49,7 @@ struct TriangulationResult {
       case Status::kSuccessful:         enum_str = "SUCCESSFUL"; break;
       case Status::kTooFewMeasurments:  enum_str = "TOO_FEW_MEASUREMENTS"; break;
       case Status::kUnobservable:       enum_str = "UNOBSERVABLE"; break;
+      case Status::kTooFewInliers:      enum_str = "TOO_FEW_INLIERS"; break;
       default:
         case Status::kUninitialized:    enum_str = "UNINITIALIZED"; break;
     }
@@ -63,8 +69,8 @@ struct TriangulationResult {
   Status status_;
 };
 
-/// brief Triangulate a 3d point from a set of n keypoint measurements on the
-///       normalized camera plane.
+/// \brief Triangulate a 3d point from a set of n keypoint measurements on the
+///        normalized camera plane.
 /// @param measurements_normalized Keypoint measurements on normalized camera
 ///       plane.
 /// @param T_G_B Pose of the body frame of reference w.r.t. the global frame,
@@ -73,13 +79,36 @@ struct TriangulationResult {
 ///       frame of reference.
 /// @param G_point Triangulated point in global frame.
 /// @return Was the triangulation successful?
+///
+/// Two and three views, the most common cases, use the fixed-size versions below.
 TriangulationResult linearTriangulateFromNViews(
     const Aligned<std::vector, Eigen::Vector2d>& measurements_normalized,
     const aslam::TransformationVector& T_G_B,
     const aslam::Transformation& T_B_C, Eigen::Vector3d* G_point);
 
-/// brief Triangulate a 3d point from a set of n keypoint measurements on the
-///       normalized camera plane.
+/// \brief Same as above for a number of views known at compile time. The linear
+///        system is built from fixed-size matrices and no memory is allocated.
+///        Instantiated for 3 and Eigen::Dynamic, the latter being the general
+///        version for any number of views.
+template <int kNumViews>
+TriangulationResult linearTriangulateFromNViews(
+    const Aligned<std::vector, Eigen::Vector2d>& measurements_normalized,
+    const aslam::TransformationVector& T_G_B,
+    const aslam::Transformation& T_B_C, Eigen::Vector3d* G_point);
+
+/// \brief Two-view version, computes the midpoint of the shortest segment
+///        between the two rays in closed form. This is the least-squares
+///        solution of the general version. The point is unobservable if the
+///        angle between the rays is below ~0.11 degrees, which is where the
+///        general version loses rank.
+template <>
+TriangulationResult linearTriangulateFromNViews<2>(
+    const Aligned<std::vector, Eigen::Vector2d>& measurements_normalized,
+    const aslam::TransformationVector& T_G_B,
+    const aslam::Transformation& T_B_C, Eigen::Vector3d* G_point);
+
+/// \brief Triangulate a 3d point from a set of n keypoint measurements on the
+///        normalized camera plane.
 /// @param measurements_normalized Keypoint measurements on normalized camera
 ///       plane.
 /// @param T_G_B Pose of the body frame of reference w.r.t. the global frame,
@@ -93,8 +122,8 @@ TriangulationResult iterativeGaussNewtonTriangulateFromNViews(
     const Aligned<std::vector, aslam::Transformation>& T_G_B,
     const aslam::Transformation& T_B_C, Eigen::Vector3d* G_point);
 
-/// brief Triangulate a 3d point from a set of n keypoint measurements as
-///       bearing vectors.
+/// \brief Triangulate a 3d point from a set of n keypoint measurements as
+///        bearing vectors.
 /// @param t_G_bv Back-projected bearing vectors from visual frames to
 ///               observations, expressed in the global frame.
 /// @param p_G_C Global positions of visual frames (cameras).
@@ -103,8 +132,8 @@ TriangulationResult iterativeGaussNewtonTriangulateFromNViews(
 TriangulationResult linearTriangulateFromNViews(
     const Eigen::Matrix3Xd& t_G_bv, const Eigen::Matrix3Xd& p_G_C, Eigen::Vector3d* p_G_P);
 
-/// brief Triangulate a 3d point from a set of n keypoint measurements in
-///       m cameras.
+/// \brief Triangulate a 3d point from a set of n keypoint measurements in
+///        m cameras.
 /// @param measurements_normalized Keypoint measurements on normalized image
 ///        plane. Should be n long.
 /// @param measurement_camera_indices Which camera index each measurement
@@ -122,8 +151,8 @@ TriangulationResult linearTriangulateFromNViewsMultiCam(
     const Aligned<std::vector, aslam::Transformation>& T_B_C,
     Eigen::Vector3d* G_point);
 
-/// brief Triangulates a feature track together with a list of body poses.
-///       Track length and size of T_W_Bs is expected to be equal.
+/// \brief Triangulates a feature track together with a list of body poses.
+///        Track length and size of T_W_Bs is expected to be equal.
 ///
 /// Frames: W: Arbitrary frame which the resulting landmark will be expressed in.
 ///         B: Body frame (of the nframe).
@@ -136,9 +165,9 @@ TriangulationResult triangulateFeatureTrack(
     const aslam::TransformationVector& T_W_Bs,
     Eigen::Vector3d* W_landmark);
 
-/// brief Triangulates a feature track together with a list of body poses.
-///       Track length and size of T_W_Bs is expected to be equal.
-///       Uses the faster linearTriangulateFromNViews(Matrix3d, Matrix3d, Vector3d*).
+/// \brief Triangulates a feature track together with a list of body poses.
+///        Track length and size of T_W_Bs is expected to be equal.
+///        Uses the faster linearTriangulateFromNViews(Matrix3d, Matrix3d, Vector3d*).
 ///
 /// Frames: W: Arbitrary frame which the resulting landmark will be expressed in.
 ///         B: Body frame (of the nframe).
@@ -150,5 +179,120 @@ TriangulationResult fastTriangulateFeatureTrack(
     const aslam::FeatureTrack& track,
     const aslam::TransformationVector& T_W_Bs,
     Eigen::Vector3d* W_landmark);
+
+/// \brief Triangulates many feature tracks in parallel with triangulateFeatureTrack.
+///
+/// The tracks are processed in chunks, every chunk reuses its scratch buffers for all of its
+/// tracks. Tracks with less than two observations are reported as
+/// TOO_FEW_MEASUREMENTS instead of failing a check.
+///
+/// @param[in]  tracks               The feature tracks to be triangulated.
+/// @param[in]  T_W_Bs_per_track     The list of body poses the landmark was seen from for every
+///                                  track, in the order of the tracks.
+/// @param[in]  num_threads          1 runs on the calling thread, any other value on the shared
+///                                  pool of common::parallelFor.
+/// @param[out] W_landmarks          Landmark per track in input order, zero if the
+///                                  triangulation failed.
+/// @param[out] results              Triangulation result per track in input order.
+/// @param[out] failed_track_indices Optional, indices of the failed tracks by status in
+///                                  increasing order.
+void triangulateFeatureTracks(
+    const aslam::FeatureTracks& tracks,
+    const std::vector<aslam::TransformationVector>& T_W_Bs_per_track,
+    size_t num_threads, Aligned<std::vector, Eigen::Vector3d>* W_landmarks,
+    std::vector<TriangulationResult>* results,
+    std::map<TriangulationResult::Status, std::vector<size_t>>* failed_track_indices);
+
+/// \brief Observations of many feature tracks in a flat layout: the observations of track i are
+///        the columns [track_offsets[i], track_offsets[i + 1]) of C_bearing_vectors and
+///        pose_indices.
+struct FeatureTrackObservations {
+  /// Offset of the first observation of every track, followed by the number of observations.
+  std::vector<size_t> track_offsets;
+  /// Bearing vectors expressed in the frame of the observing camera, need not be normalized.
+  Eigen::Matrix3Xd C_bearing_vectors;
+  /// Index of the observing camera pose for every observation.
+  std::vector<size_t> pose_indices;
+
+  size_t numTracks() const {
+    return track_offsets.empty() ? 0u : track_offsets.size() - 1u;
+  }
+  size_t numObservations() const {
+    return track_offsets.empty() ? 0u : track_offsets.back();
+  }
+};
+
+/// \brief Triangulates all tracks of the observation table with the same linear least-squares
+///        formulation as linearTriangulateFromNViews(Matrix3Xd, Matrix3Xd, Vector3d*).
+///
+/// Every track accumulates its 3x3 normal equations with fixed-size math, hence no memory is
+/// allocated per track. The tracks are processed in chunks.
+///
+/// @param[in]  observations Flat observation table of all tracks.
+/// @param[in]  T_G_Cs       Camera poses the pose indices of the observations refer to.
+/// @param[in]  num_threads  1 runs on the calling thread, any other value on the shared pool
+///                          of common::parallelFor.
+/// @param[out] G_points     Triangulated points, one column per track. Columns of tracks that
+///                          failed to triangulate are set to zero.
+/// @param[out] results      Triangulation result per track.
+void linearTriangulateFeatureTracks(
+    const FeatureTrackObservations& observations,
+    const Aligned<std::vector, aslam::Transformation>& T_G_Cs,
+    size_t num_threads, Eigen::Matrix3Xd* G_points,
+    std::vector<TriangulationResult>* results);
+
+/// \brief Options of robustTriangulateFeatureTracks.
+struct RobustTriangulationOptions {
+  /// Max. angle between an observed bearing vector and the ray from its camera to the landmark
+  /// for the observation to be an inlier.
+  double max_angular_error_rad;
+  /// Min. number of inliers of a landmark, at least 2.
+  size_t min_num_inliers;
+  /// Max. number of two-view hypotheses per track. All pairs of observations are tried if there
+  /// are not more, otherwise random pairs.
+  size_t max_num_hypotheses;
+  /// Min. angle between the two rays of a hypothesis.
+  double min_parallax_rad;
+  /// Max. number of Gauss-Newton steps of the refinement on the inliers.
+  size_t max_num_refinement_iterations;
+  /// Seed of the pair sampling, track i uses seed + i, such that the result does not depend on
+  /// the number of threads.
+  uint32_t seed;
+
+  RobustTriangulationOptions() :
+    max_angular_error_rad(0.005),
+    min_num_inliers(2u),
+    max_num_hypotheses(50u),
+    min_parallax_rad(0.005),
+    max_num_refinement_iterations(5u),
+    seed(0u) {};
+};
+
+/// \brief Triangulates all tracks of the observation table robustly against outlier
+///        observations.
+///
+/// Every track scores two-view hypotheses against all of its observations with a truncated
+/// angular cost. The best hypothesis is refined on its inliers with the linear solution and
+/// Gauss-Newton steps on the angular errors, then the inliers are selected again for the refined
+/// landmark. Tracks without outliers give the same landmark as linearTriangulateFeatureTracks up
+/// to the refinement. Scratch buffers are allocated per chunk of tracks, not per track.
+///
+/// @param[in]  observations Flat observation table of all tracks.
+/// @param[in]  T_G_Cs       Camera poses the pose indices of the observations refer to.
+/// @param[in]  options      Thresholds of the hypotheses and the inliers.
+/// @param[in]  num_threads  1 runs on the calling thread, any other value on the shared pool
+///                          of common::parallelFor.
+/// @param[out] G_points     Triangulated points, one column per track. Columns of tracks that
+///                          failed to triangulate are set to zero.
+/// @param[out] results      Triangulation result per track, TOO_FEW_INLIERS if fewer than
+///                          options.min_num_inliers observations agree with the best landmark.
+/// @param[out] inlier_masks One entry per observation, 1 for the inliers of successful tracks
+///                          and 0 otherwise.
+void robustTriangulateFeatureTracks(
+    const FeatureTrackObservations& observations,
+    const Aligned<std::vector, aslam::Transformation>& T_G_Cs,
+    const RobustTriangulationOptions& options, size_t num_threads,
+    Eigen::Matrix3Xd* G_points, std::vector<TriangulationResult>* results,
+    std::vector<unsigned char>* inlier_masks);
 }  // namespace aslam
 #endif  // TRIANGULATION_H_
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/feature-track.h>
+#include <aslam/triangulation/test/triangulation-fixture.h>
+#include <aslam/triangulation/triangulation.h>
+
+DEFINE_int32(num_tracks, 8000, "Number of feature tracks per pass.");
+DEFINE_int32(num_poses, 10, "Number of poses, the tracks have 2 to num_poses observations.");
+DEFINE_int32(num_repetitions, 10, "Number of passes over the tracks.");
+
+namespace {
+double getElapsedMilliseconds(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count() / FLAGS_num_repetitions;
+}
+}  // namespace
+
+// Compares triangulating the tracks one by one with triangulateFeatureTrack against the
+// parallel triangulateFeatureTracks for an increasing number of threads.
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  CHECK_GT(FLAGS_num_tracks, 0);
+  CHECK_GE(FLAGS_num_poses, 2);
+  CHECK_GT(FLAGS_num_repetitions, 0);
+
+  aslam::FeatureTracks tracks;
+  std::vector<aslam::TransformationVector> T_W_Bs_per_track;
+  Aligned<std::vector, Eigen::Vector3d> W_landmarks_expected;
+  createTestFeatureTracks(FLAGS_num_tracks, FLAGS_num_poses, &tracks, &T_W_Bs_per_track,
+                          &W_landmarks_expected);
+
+  Aligned<std::vector, Eigen::Vector3d> W_landmarks_serial(tracks.size());
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int repetition = 0; repetition < FLAGS_num_repetitions; ++repetition) {
+    for (size_t track_idx = 0u; track_idx < tracks.size(); ++track_idx) {
+      CHECK(aslam::triangulateFeatureTrack(
+          tracks[track_idx], T_W_Bs_per_track[track_idx], &W_landmarks_serial[track_idx]));
+    }
+  }
+  const double serial_ms = getElapsedMilliseconds(start);
+  std::cout << "triangulateFeatureTrack          " << std::fixed << std::setprecision(2)
+            << std::setw(8) << serial_ms << " ms" << std::endl;
+
+  const size_t max_num_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t num_threads = 1u; num_threads <= max_num_threads; num_threads *= 2u) {
+    Aligned<std::vector, Eigen::Vector3d> W_landmarks;
+    std::vector<aslam::TriangulationResult> results;
+    std::map<aslam::TriangulationResult::Status, std::vector<size_t>> failed_track_indices;
+    start = std::chrono::steady_clock::now();
+    for (int repetition = 0; repetition < FLAGS_num_repetitions; ++repetition) {
+      aslam::triangulateFeatureTracks(tracks, T_W_Bs_per_track, num_threads, &W_landmarks,
+                                      &results, &failed_track_indices);
+    }
+    const double parallel_ms = getElapsedMilliseconds(start);
+    CHECK(failed_track_indices.empty());
+    for (size_t track_idx = 0u; track_idx < tracks.size(); ++track_idx) {
+      CHECK_EQ(W_landmarks_serial[track_idx], W_landmarks[track_idx]);
+    }
+    std::cout << "triangulateFeatureTracks " << std::setw(2) << num_threads << " thr  "
+              << std::setw(8) << parallel_ms << " ms  speed-up " << serial_ms / parallel_ms
+              << "x" << std::endl;
+  }
+  return 0;
+}
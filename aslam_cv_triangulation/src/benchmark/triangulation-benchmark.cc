@@ -1,164 +1,412 @@
-// TODO(tcies) reenable once sm timing is fixed in tango (linker errors).
-//#include <aslam/common/entrypoint.h>
-//#include <aslam/test/triangulation-fixture.h>
-//#include <sm/timing/Timer.hpp>
+// Accuracy and timing of the triangulation variants on synthetic landmarks, swept over the
+// number of observations, the keypoint noise and the number of cameras of the rig. The results
+// are reported as JSON or CSV.
 //
-//void sampleXYPlaneSine(const double x_min, const double x_max,
-//                       const size_t num_samples, Eigen::Matrix3Xd* result) {
-//  CHECK_NOTNULL(result)->resize(3, num_samples);
-//  CHECK_GT(num_samples, 1);
-//  for (size_t i = 0; i < num_samples; ++i) {
-//    double x = x_min + i * (x_max - x_min) / (num_samples - 1);
-//    result->block<3, 1>(0, i) << x, sin(x), 0;
-//  }
-//}
+// Every landmark lies 4 - 8 m in front of a rig whose body poses are perturbed along a baseline.
+// Observation i is taken by camera i % num_cameras. The single-camera variants get the camera
+// poses T_G_B * T_B_C as body poses with an identity extrinsic calibration, the conversion is
+// not timed.
 //
-//template <typename MeasurementType>
-//size_t handleOffset() {
-//  CHECK(false);
-//  return 0u;
-//}
-//
-//template <>
-//size_t handleOffset<Vector2dList>() { return 1000u; }
-//
-//template <>
-//size_t handleOffset<Eigen::Matrix3Xd>() { return 2000u; }
-//
-//template <typename MeasurementType>
-//void plotIfDone() {}
-//
-//constexpr size_t kMaxNumMeasurements = 50;
-//
-//template <>
-//void plotIfDone<Eigen::Matrix3Xd>() {
-//  FILE* plot = popen("gnuplot --persist", "w");
-//  fprintf(plot, "set logscale y\n");
-//  fprintf(plot, "plot '-' w l, '-' w l\n");
-//  for (size_t i = 2; i <= kMaxNumMeasurements; ++i) {
-//    fprintf(plot, "%lu %lf\n", i, sm::timing::Timing::getMeanSeconds(
-//        std::to_string(handleOffset<Vector2dList>() + i)));
-//  }
-//  fprintf(plot, "e\n");
-//  for (size_t i = 2; i <= kMaxNumMeasurements; ++i) {
-//    fprintf(plot, "%lu %lf\n", i, sm::timing::Timing::getMeanSeconds(
-//        std::to_string(handleOffset<Eigen::Matrix3Xd>() + i)));
-//  }
-//  fprintf(plot, "e\n");
-//  fflush(plot);
-//}
-//
-//TYPED_TEST(TriangulationFixture, Performance) {
-//  constexpr double kDepth = 5;
-//  constexpr size_t kNumSamples = 10;
-//  this->p_W_L_ << 1, 1, kDepth;
-//  CHECK_GT(kMaxNumMeasurements, 1);
-//  for (size_t num_measurements = 2; num_measurements <= kMaxNumMeasurements;
-//      ++num_measurements) {
-//    this->setNMeasurements(num_measurements);
-//    Eigen::Matrix3Xd p_W_B;
-//    sampleXYPlaneSine(-100., 100., num_measurements, &p_W_B);
-//    for (size_t i = 0; i < num_measurements; ++i) {
-//      this->T_W_B_[i].getPosition() = p_W_B.block<3, 1>(0, i);
-//    }
-//    this->inferMeasurements();
-//    for (size_t i = 0; i < kNumSamples; ++i) {
-//      sm::timing::Timer timer(std::to_string(
-//          handleOffset<TypeParam>() + num_measurements));
-//      this->expectSuccess();
-//      timer.stop();
-//    }
-//  }
-//  plotIfDone<TypeParam>();
-//}
-//
-//constexpr double kMaxAngleDisparity = 20. / 180. * M_PI;
-//static_assert(kMaxAngleDisparity > 0. && kMaxAngleDisparity < M_PI / 2,
-//              "Maximum angle disparity must be between 0 and Pi/2.");
-//constexpr size_t kNumAngleDisparitySteps = 50u;
-//static_assert(kNumAngleDisparitySteps > 0u, "Need at least one disparity step.");
-//constexpr double kDAngleDisparity = kMaxAngleDisparity / kNumAngleDisparitySteps;
-//constexpr size_t kMinNumNoisyMeasurements = 2u;
-//constexpr size_t kMaxNumNoisyMeasurements = 18u;
-//constexpr size_t kNumNoisyMeasurementsMultiplier = 3u;
-//static_assert((kMaxNumNoisyMeasurements / kMinNumNoisyMeasurements) %
-//              kNumNoisyMeasurementsMultiplier == 0u, "Inconsistent series.");
-//constexpr size_t kNumNoisyMeasurementsSteps = kMaxNumNoisyMeasurements /
-//    (kMinNumNoisyMeasurements * kNumNoisyMeasurementsMultiplier) + 1;
-//
-//double stats[2][kNumAngleDisparitySteps][kNumNoisyMeasurementsSteps];
-//
-//template <typename MeasurementType>
-//void plotAngleNoiseIfDone() {}
-//
-//template <>
-//void plotAngleNoiseIfDone<Eigen::Matrix3Xd>() {
-//  FILE* plot = popen("gnuplot --persist", "w");
-//
-//  for (size_t measurement_i = 0u; measurement_i < 2 * kNumNoisyMeasurementsSteps;
-//      ++measurement_i) {
-//    if (measurement_i == 0) {
-//      fprintf(plot, "plot ");
-//    } else {
-//      fprintf(plot, ", ");
-//    }
-//    fprintf(plot, "'-' w l");
-//  }
-//  fprintf(plot, "\n");
-//  for (size_t measurement_i = 0u; measurement_i < kNumNoisyMeasurementsSteps;
-//      ++measurement_i) {
-//    for (size_t i = 0u; i < kNumAngleDisparitySteps; ++i) {
-//      fprintf(plot, "%lf %lf\n", kDAngleDisparity * (1 + i) * 180 / M_PI,
-//              stats[0][i][measurement_i]);
-//    }
-//    fprintf(plot, "e\n");
-//  }
-//  for (size_t measurement_i = 0u; measurement_i < kNumNoisyMeasurementsSteps;
-//      ++measurement_i) {
-//    for (size_t i = 0u; i < kNumAngleDisparitySteps; ++i) {
-//      fprintf(plot, "%lf %lf\n", kDAngleDisparity * (1 + i) * 180 / M_PI,
-//              stats[1][i][measurement_i]);
-//    }
-//    fprintf(plot, "e\n");
-//  }
-//
-//  fflush(plot);
-//}
-//
-//
-//TYPED_TEST(TriangulationFixture, AngleNoise) {
-//  constexpr double kDepth = 1;
-//  constexpr size_t kNumSamples = 50;
-//  this->p_W_L_ << 0, 0, kDepth;
-//  CHECK_GT(kMinNumNoisyMeasurements, 1);
-//  CHECK_GE(kMaxNumNoisyMeasurements, kMinNumNoisyMeasurements);
-//  CHECK_GE(kNumNoisyMeasurementsMultiplier, 1);
-//
-//  for (size_t disparity_i = 0u; disparity_i < kNumAngleDisparitySteps; ++disparity_i) {
-//    double disparity = kDAngleDisparity * (1 + disparity_i);
-//    for (size_t measurement_i = 0; measurement_i < kNumNoisyMeasurementsSteps;
-//        ++measurement_i) {
-//      size_t num_measurements = kMinNumNoisyMeasurements *
-//          pow(kNumNoisyMeasurementsMultiplier, measurement_i);
-//      this->setNMeasurements(num_measurements);
-//      Eigen::Matrix3Xd p_W_B;
-//      sampleXYPlaneSine(-1., 1., num_measurements, &p_W_B);
-//      for (size_t i = 0; i < num_measurements; ++i) {
-//        this->T_W_B_[i].getPosition() = p_W_B.block<3, 1>(0, i);
-//      }
-//      Eigen::VectorXd samples(kNumSamples, 1);
-//      for (size_t i = 0u; i < kNumSamples; ++i) {
-//        this->inferMeasurements(disparity);
-//        Eigen::Vector3d triangulation;
-//        aslam::TriangulationResult result = this->triangulate(&triangulation);
-//        EXPECT_TRUE(result.wasTriangulationSuccessful());
-//        samples[i] = (this->p_W_L_ - triangulation).norm();
-//      }
-//      stats[handleOffset<TypeParam>() / 1000 - 1][disparity_i][measurement_i] =
-//                  samples.mean();
-//    }
-//  }
-//  plotAngleNoiseIfDone<TypeParam>();
-//}
-//
-//ASLAM_UNITTEST_ENTRYPOINT
+// The benchmark doubles as a regression check: the fixed-size and the batched versions must
+// agree with the general linear triangulation they replace, otherwise it returns 1.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/triangulation/triangulation.h>
+
+DEFINE_string(benchmark_num_observations, "2,3,5,10,20,50",
+              "Comma separated numbers of observations per landmark.");
+DEFINE_string(benchmark_keypoint_noise_px, "0,0.5,1,2",
+              "Comma separated standard deviations of the keypoint noise in pixels.");
+DEFINE_string(benchmark_num_cameras, "1,2,4", "Comma separated numbers of cameras of the rig.");
+DEFINE_int32(benchmark_num_landmarks, 2000, "Number of landmarks per configuration.");
+DEFINE_int32(benchmark_num_repetitions, 3, "Number of timed passes over the landmarks.");
+DEFINE_double(benchmark_focal_length_px, 400.0,
+              "Focal length converting the keypoint noise to the normalized image plane.");
+DEFINE_string(benchmark_output_format, "json", "Output format, json or csv.");
+DEFINE_string(benchmark_output_file, "", "Write the results to this file instead of stdout.");
+
+namespace aslam {
+namespace {
+
+/// The fixed-size and batched versions only reorder the floating point operations.
+const double kRegressionTolerance = 1e-6;
+
+struct Configuration {
+  size_t num_observations;
+  double keypoint_noise_px;
+  size_t num_cameras;
+};
+
+/// All landmarks of one configuration.
+struct Problems {
+  Aligned<std::vector, aslam::Transformation> T_B_Cs;
+  Aligned<std::vector, Eigen::Vector3d> G_landmarks;
+  // Per landmark and observation.
+  std::vector<Aligned<std::vector, Eigen::Vector2d>> measurements;
+  std::vector<std::vector<size_t>> camera_indices;
+  std::vector<aslam::TransformationVector> T_G_Bs;
+  std::vector<aslam::TransformationVector> T_G_Cs;
+  std::vector<Eigen::Matrix3Xd> G_bearing_vectors;
+  std::vector<Eigen::Matrix3Xd> p_G_Cs;
+};
+
+/// Estimates of one variant for all landmarks of a configuration.
+struct VariantResult {
+  std::string name;
+  double ns_per_landmark;
+  Aligned<std::vector, Eigen::Vector3d> G_points;
+  std::vector<unsigned char> success;
+
+  double getSuccessRate() const {
+    return static_cast<double>(std::count(success.begin(), success.end(), 1u)) /
+        success.size();
+  }
+  /// Mean and median position error of the successful triangulations.
+  void getErrors(const Aligned<std::vector, Eigen::Vector3d>& G_landmarks, double* mean,
+                 double* median) const {
+    CHECK_NOTNULL(mean);
+    CHECK_NOTNULL(median);
+    std::vector<double> errors;
+    for (size_t i = 0u; i < G_points.size(); ++i) {
+      if (success[i]) {
+        errors.push_back((G_points[i] - G_landmarks[i]).norm());
+      }
+    }
+    if (errors.empty()) {
+      *mean = *median = std::numeric_limits<double>::quiet_NaN();
+      return;
+    }
+    double sum = 0.0;
+    for (const double error : errors) {
+      sum += error;
+    }
+    *mean = sum / errors.size();
+    std::nth_element(errors.begin(), errors.begin() + errors.size() / 2u, errors.end());
+    *median = errors[errors.size() / 2u];
+  }
+};
+
+std::vector<std::string> splitList(const std::string& list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+std::vector<Configuration> parseConfigurations() {
+  std::vector<Configuration> configurations;
+  for (const std::string& num_cameras : splitList(FLAGS_benchmark_num_cameras)) {
+    for (const std::string& noise : splitList(FLAGS_benchmark_keypoint_noise_px)) {
+      for (const std::string& num_observations : splitList(FLAGS_benchmark_num_observations)) {
+        Configuration configuration;
+        configuration.num_observations = std::stoul(num_observations);
+        configuration.keypoint_noise_px = std::stod(noise);
+        configuration.num_cameras = std::stoul(num_cameras);
+        CHECK_GE(configuration.num_observations, 2u);
+        CHECK_GE(configuration.keypoint_noise_px, 0.0);
+        CHECK_GT(configuration.num_cameras, 0u);
+        configurations.push_back(configuration);
+      }
+    }
+  }
+  return configurations;
+}
+
+void createProblems(const Configuration& configuration, std::mt19937* generator,
+                    Problems* problems) {
+  CHECK_NOTNULL(generator);
+  CHECK_NOTNULL(problems);
+  std::uniform_real_distribution<double> unit_distribution(-1.0, 1.0);
+  // The standard deviation of a normal distribution must be positive.
+  const double noise_sigma = configuration.keypoint_noise_px / FLAGS_benchmark_focal_length_px;
+  std::normal_distribution<double> noise_distribution(
+      0.0, std::max(noise_sigma, std::numeric_limits<double>::min()));
+  const size_t num_landmarks = FLAGS_benchmark_num_landmarks;
+
+  problems->T_B_Cs.resize(configuration.num_cameras);
+  for (aslam::Transformation& T_B_C : problems->T_B_Cs) {
+    T_B_C.setRandom(0.2, 0.1);
+  }
+  problems->G_landmarks.resize(num_landmarks);
+  problems->measurements.resize(num_landmarks);
+  problems->camera_indices.resize(num_landmarks);
+  problems->T_G_Bs.resize(num_landmarks);
+  problems->T_G_Cs.resize(num_landmarks);
+  problems->G_bearing_vectors.resize(num_landmarks);
+  problems->p_G_Cs.resize(num_landmarks);
+
+  const size_t num_observations = configuration.num_observations;
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks; ++landmark_idx) {
+    const double depth = 6.0 + 2.0 * unit_distribution(*generator);
+    const Eigen::Vector3d G_landmark(unit_distribution(*generator),
+                                     unit_distribution(*generator), depth);
+    problems->G_landmarks[landmark_idx] = G_landmark;
+    problems->measurements[landmark_idx].resize(num_observations);
+    problems->camera_indices[landmark_idx].resize(num_observations);
+    problems->T_G_Bs[landmark_idx].resize(num_observations);
+    problems->T_G_Cs[landmark_idx].resize(num_observations);
+    problems->G_bearing_vectors[landmark_idx].resize(3, num_observations);
+    problems->p_G_Cs[landmark_idx].resize(3, num_observations);
+
+    for (size_t i = 0u; i < num_observations; ++i) {
+      // Body poses along a 1 m baseline.
+      aslam::Transformation& T_G_B = problems->T_G_Bs[landmark_idx][i];
+      T_G_B.setRandom(0.05, 0.05);
+      T_G_B.getPosition() += Eigen::Vector3d(
+          static_cast<double>(i) / (num_observations - 1u) - 0.5, 0.0, 0.0);
+      const size_t camera_idx = i % configuration.num_cameras;
+      const aslam::Transformation T_G_C = T_G_B * problems->T_B_Cs[camera_idx];
+
+      const Eigen::Vector3d C_landmark = T_G_C.inverse().transform(G_landmark);
+      Eigen::Vector2d measurement = C_landmark.head<2>() / C_landmark(2);
+      if (noise_sigma > 0.0) {
+        measurement += Eigen::Vector2d(noise_distribution(*generator),
+                                       noise_distribution(*generator));
+      }
+
+      problems->measurements[landmark_idx][i] = measurement;
+      problems->camera_indices[landmark_idx][i] = camera_idx;
+      problems->T_G_Cs[landmark_idx][i] = T_G_C;
+      problems->G_bearing_vectors[landmark_idx].col(i) =
+          T_G_C.getRotationMatrix() * measurement.homogeneous();
+      problems->p_G_Cs[landmark_idx].col(i) = T_G_C.getPosition();
+    }
+  }
+}
+
+/// Runs the variant on all landmarks and keeps the estimates of the last repetition.
+template <typename TriangulationFunction>
+VariantResult runVariant(const std::string& name, size_t num_landmarks,
+                         const TriangulationFunction& triangulate) {
+  VariantResult result;
+  result.name = name;
+  result.G_points.resize(num_landmarks, Eigen::Vector3d::Zero());
+  result.success.resize(num_landmarks, 0u);
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int repetition = 0; repetition < FLAGS_benchmark_num_repetitions; ++repetition) {
+    for (size_t landmark_idx = 0u; landmark_idx < num_landmarks; ++landmark_idx) {
+      result.success[landmark_idx] = static_cast<unsigned char>(static_cast<bool>(
+          triangulate(landmark_idx, &result.G_points[landmark_idx])));
+    }
+  }
+  const double elapsed_ns = std::chrono::duration<double, std::nano>(
+      std::chrono::steady_clock::now() - start).count();
+  result.ns_per_landmark =
+      elapsed_ns / (static_cast<double>(num_landmarks) * FLAGS_benchmark_num_repetitions);
+  return result;
+}
+
+/// Triangulates all landmarks with one call of linearTriangulateFeatureTracks.
+VariantResult runBatchedVariant(const Problems& problems) {
+  const size_t num_landmarks = problems.G_landmarks.size();
+  FeatureTrackObservations observations;
+  Aligned<std::vector, aslam::Transformation> T_G_Cs;
+  observations.track_offsets.push_back(0u);
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks; ++landmark_idx) {
+    for (size_t i = 0u; i < problems.measurements[landmark_idx].size(); ++i) {
+      observations.pose_indices.push_back(T_G_Cs.size());
+      T_G_Cs.push_back(problems.T_G_Cs[landmark_idx][i]);
+    }
+    observations.track_offsets.push_back(T_G_Cs.size());
+  }
+  observations.C_bearing_vectors.resize(3, T_G_Cs.size());
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks; ++landmark_idx) {
+    for (size_t i = 0u; i < problems.measurements[landmark_idx].size(); ++i) {
+      observations.C_bearing_vectors.col(observations.track_offsets[landmark_idx] + i) =
+          problems.measurements[landmark_idx][i].homogeneous();
+    }
+  }
+
+  VariantResult result;
+  result.name = "batched_linear";
+  Eigen::Matrix3Xd G_points;
+  std::vector<TriangulationResult> results;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int repetition = 0; repetition < FLAGS_benchmark_num_repetitions; ++repetition) {
+    linearTriangulateFeatureTracks(observations, T_G_Cs, 1u, &G_points, &results);
+  }
+  const double elapsed_ns = std::chrono::duration<double, std::nano>(
+      std::chrono::steady_clock::now() - start).count();
+  result.ns_per_landmark =
+      elapsed_ns / (static_cast<double>(num_landmarks) * FLAGS_benchmark_num_repetitions);
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks; ++landmark_idx) {
+    result.G_points.push_back(G_points.col(landmark_idx));
+    result.success.push_back(static_cast<unsigned char>(
+        results[landmark_idx].wasTriangulationSuccessful()));
+  }
+  return result;
+}
+
+/// Number of landmarks both variants triangulated with different results.
+size_t countMismatches(const VariantResult& reference, const VariantResult& variant) {
+  size_t num_mismatches = 0u;
+  for (size_t i = 0u; i < reference.G_points.size(); ++i) {
+    if (reference.success[i] && variant.success[i] &&
+        (reference.G_points[i] - variant.G_points[i]).norm() >
+            kRegressionTolerance * std::max(1.0, reference.G_points[i].norm())) {
+      ++num_mismatches;
+    }
+  }
+  return num_mismatches;
+}
+
+/// Returns the number of regression failures of the configuration.
+size_t runConfiguration(const Configuration& configuration, std::mt19937* generator,
+                        std::vector<std::string>* rows) {
+  CHECK_NOTNULL(rows);
+  Problems problems;
+  createProblems(configuration, generator, &problems);
+  const size_t num_landmarks = problems.G_landmarks.size();
+  const aslam::Transformation T_identity;
+
+  std::vector<VariantResult> variants;
+  variants.push_back(runVariant("linear_dynamic", num_landmarks,
+      [&](size_t i, Eigen::Vector3d* G_point) {
+        return linearTriangulateFromNViews<Eigen::Dynamic>(
+            problems.measurements[i], problems.T_G_Cs[i], T_identity, G_point);
+      }));
+  variants.push_back(runVariant("linear", num_landmarks,
+      [&](size_t i, Eigen::Vector3d* G_point) {
+        return linearTriangulateFromNViews(
+            problems.measurements[i], problems.T_G_Cs[i], T_identity, G_point);
+      }));
+  variants.push_back(runVariant("linear_multicam", num_landmarks,
+      [&](size_t i, Eigen::Vector3d* G_point) {
+        return linearTriangulateFromNViewsMultiCam(
+            problems.measurements[i], problems.camera_indices[i], problems.T_G_Bs[i],
+            problems.T_B_Cs, G_point);
+      }));
+  variants.push_back(runVariant("linear_bearing_vectors", num_landmarks,
+      [&](size_t i, Eigen::Vector3d* G_point) {
+        return linearTriangulateFromNViews(
+            problems.G_bearing_vectors[i], problems.p_G_Cs[i], G_point);
+      }));
+  variants.push_back(runVariant("gauss_newton", num_landmarks,
+      [&](size_t i, Eigen::Vector3d* G_point) {
+        return iterativeGaussNewtonTriangulateFromNViews(
+            problems.measurements[i], problems.T_G_Cs[i], T_identity, G_point);
+      }));
+  variants.push_back(runBatchedVariant(problems));
+
+  // The fixed-size versions replace linear_dynamic, the batched version solves the problem of
+  // linear_bearing_vectors.
+  size_t num_failures = 0u;
+  const size_t num_fixed_size_mismatches = countMismatches(variants[0], variants[1]);
+  const size_t num_batched_mismatches = countMismatches(variants[3], variants[5]);
+  if (num_fixed_size_mismatches > 0u || num_batched_mismatches > 0u) {
+    LOG(ERROR) << "Regression for " << configuration.num_observations << " observations, "
+               << configuration.keypoint_noise_px << " px, " << configuration.num_cameras
+               << " cameras: " << num_fixed_size_mismatches << " fixed-size and "
+               << num_batched_mismatches << " batched landmarks disagree.";
+    num_failures = num_fixed_size_mismatches + num_batched_mismatches;
+  }
+
+  const bool csv = (FLAGS_benchmark_output_format == "csv");
+  for (const VariantResult& variant : variants) {
+    double mean_error_m;
+    double median_error_m;
+    variant.getErrors(problems.G_landmarks, &mean_error_m, &median_error_m);
+    std::ostringstream row;
+    if (csv) {
+      row << variant.name << "," << configuration.num_cameras << ","
+          << configuration.num_observations << "," << configuration.keypoint_noise_px << ","
+          << variant.getSuccessRate() << "," << mean_error_m << "," << median_error_m << ","
+          << variant.ns_per_landmark;
+    } else {
+      // NaN is not valid JSON.
+      auto json_number = [](double value) {
+        std::ostringstream number;
+        if (std::isnan(value)) {
+          number << "null";
+        } else {
+          number << value;
+        }
+        return number.str();
+      };
+      row << "    {\"variant\": \"" << variant.name
+          << "\", \"num_cameras\": " << configuration.num_cameras
+          << ", \"num_observations\": " << configuration.num_observations
+          << ", \"keypoint_noise_px\": " << configuration.keypoint_noise_px
+          << ", \"success_rate\": " << variant.getSuccessRate()
+          << ", \"mean_error_m\": " << json_number(mean_error_m)
+          << ", \"median_error_m\": " << json_number(median_error_m)
+          << ", \"ns_per_landmark\": " << variant.ns_per_landmark << "}";
+    }
+    rows->push_back(row.str());
+  }
+  return num_failures;
+}
+
+int runBenchmark() {
+  CHECK(FLAGS_benchmark_output_format == "json" || FLAGS_benchmark_output_format == "csv")
+      << "Unknown output format " << FLAGS_benchmark_output_format << ".";
+  CHECK_GT(FLAGS_benchmark_num_landmarks, 0);
+  CHECK_GT(FLAGS_benchmark_num_repetitions, 0);
+  CHECK_GT(FLAGS_benchmark_focal_length_px, 0.0);
+  const std::vector<Configuration> configurations = parseConfigurations();
+  CHECK(!configurations.empty());
+  std::mt19937 generator(42);
+
+  std::vector<std::string> rows;
+  size_t num_failures = 0u;
+  for (const Configuration& configuration : configurations) {
+    LOG(INFO) << "Running " << configuration.num_observations << " observations, "
+              << configuration.keypoint_noise_px << " px, " << configuration.num_cameras
+              << " cameras.";
+    num_failures += runConfiguration(configuration, &generator, &rows);
+  }
+
+  std::ostringstream output;
+  if (FLAGS_benchmark_output_format == "csv") {
+    output << "variant,num_cameras,num_observations,keypoint_noise_px,success_rate,"
+           << "mean_error_m,median_error_m,ns_per_landmark\n";
+    for (const std::string& row : rows) {
+      output << row << "\n";
+    }
+  } else {
+    output << "{\n  \"results\": [\n";
+    for (size_t i = 0u; i < rows.size(); ++i) {
+      output << rows[i] << (i + 1u < rows.size() ? ",\n" : "\n");
+    }
+    output << "  ]\n}\n";
+  }
+
+  if (FLAGS_benchmark_output_file.empty()) {
+    std::cout << output.str();
+  } else {
+    std::ofstream file(FLAGS_benchmark_output_file);
+    CHECK(file.is_open()) << "Could not open " << FLAGS_benchmark_output_file << ".";
+    file << output.str();
+  }
+  return (num_failures == 0u) ? 0 : 1;
+}
+
+}  // namespace
+}  // namespace aslam
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  return aslam::runBenchmark();
+}
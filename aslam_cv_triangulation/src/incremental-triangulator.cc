@@ -0,0 +1,103 @@
+#include "aslam/triangulation/incremental-triangulator.h"
+
+#include <algorithm>
+
+#include <Eigen/QR>
+#include <glog/logging.h>
+
+namespace aslam {
+
+TriangulationResult IncrementalTriangulator::addObservation(
+    size_t track_id, const Eigen::Vector3d& C_bearing_vector,
+    const aslam::Transformation& T_G_C, Eigen::Vector3d* G_point) {
+  CHECK_NOTNULL(G_point);
+  CHECK_GT(C_bearing_vector.squaredNorm(), 0.0);
+  TrackState& state = track_states_[track_id];
+  const Eigen::Vector3d G_direction =
+      (T_G_C.getRotationMatrix() * C_bearing_vector).normalized();
+  const Eigen::Vector3d& p_G_C = T_G_C.getPosition();
+  ++state.num_observations;
+
+  // Inverse squared distance to the warm start, bounded for cameras at the landmark.
+  static constexpr double kMinSquaredDistance = 1e-12;
+  auto weight = [&state](const Eigen::Vector3d& p_G_C) {
+    return 1.0 / std::max((state.G_point - p_G_C).squaredNorm(), kMinSquaredDistance);
+  };
+
+  if (state.has_estimate) {
+    accumulateRay(G_direction, p_G_C, weight(p_G_C), &state);
+    const TriangulationResult result = solve(&state);
+    if (result) {
+      *G_point = state.G_point;
+    }
+    return result;
+  }
+
+  // No estimate yet to weight the observations with, solve without weights first.
+  state.pending_G_directions.push_back(G_direction);
+  state.pending_p_G_Cs.push_back(p_G_C);
+  accumulateRay(G_direction, p_G_C, 1.0, &state);
+  if (state.num_observations < 2u) {
+    return TriangulationResult(TriangulationResult::TOO_FEW_MEASUREMENTS);
+  }
+  TriangulationResult result = solve(&state);
+  if (!result) {
+    return result;
+  }
+
+  // Re-weight the buffered observations with the first estimate, from now on the track only
+  // keeps the normal equations.
+  state.AtA.setZero();
+  state.Atb.setZero();
+  for (size_t i = 0u; i < state.pending_G_directions.size(); ++i) {
+    accumulateRay(state.pending_G_directions[i], state.pending_p_G_Cs[i],
+                  weight(state.pending_p_G_Cs[i]), &state);
+  }
+  Aligned<std::vector, Eigen::Vector3d>().swap(state.pending_G_directions);
+  Aligned<std::vector, Eigen::Vector3d>().swap(state.pending_p_G_Cs);
+  result = solve(&state);
+  if (result) {
+    *G_point = state.G_point;
+  }
+  return result;
+}
+
+bool IncrementalTriangulator::getLandmark(size_t track_id, Eigen::Vector3d* G_point) const {
+  CHECK_NOTNULL(G_point);
+  AlignedUnorderedMap<size_t, TrackState>::const_iterator it = track_states_.find(track_id);
+  if (it == track_states_.end() || !it->second.has_estimate) {
+    return false;
+  }
+  *G_point = it->second.G_point;
+  return true;
+}
+
+size_t IncrementalTriangulator::getNumObservations(size_t track_id) const {
+  AlignedUnorderedMap<size_t, TrackState>::const_iterator it = track_states_.find(track_id);
+  return (it == track_states_.end()) ? 0u : it->second.num_observations;
+}
+
+void IncrementalTriangulator::accumulateRay(
+    const Eigen::Vector3d& G_direction, const Eigen::Vector3d& p_G_C, double weight,
+    TrackState* state) {
+  CHECK_NOTNULL(state);
+  const Eigen::Matrix3d weighted_projector = weight *
+      (Eigen::Matrix3d::Identity() - G_direction * G_direction.transpose());
+  state->AtA += weighted_projector;
+  state->Atb.noalias() += weighted_projector * p_G_C;
+}
+
+TriangulationResult IncrementalTriangulator::solve(TrackState* state) {
+  CHECK_NOTNULL(state);
+  Eigen::ColPivHouseholderQR<Eigen::Matrix3d> qr(state->AtA);
+  static constexpr double kRankLossTolerance = 1e-5;
+  qr.setThreshold(kRankLossTolerance);
+  if (qr.rank() < 3) {
+    return TriangulationResult(TriangulationResult::UNOBSERVABLE);
+  }
+  state->G_point = qr.solve(state->Atb);
+  state->has_estimate = true;
+  return TriangulationResult(TriangulationResult::SUCCESSFUL);
+}
+
+}  // namespace aslam
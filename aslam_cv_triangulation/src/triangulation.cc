@@ -1,5 +1,10 @@
 #include "aslam/triangulation/triangulation.h"
 
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <aslam/common/parallel-for.h>
 #include <Eigen/QR>
 #include <glog/logging.h>
 
@@ -11,25 +16,51 @@ TriangulationResult::Status TriangulationResult::TOO_FEW_MEASUREMENTS =
     TriangulationResult::Status::kTooFewMeasurments;
 TriangulationResult::Status TriangulationResult::UNOBSERVABLE =
     TriangulationResult::Status::kUnobservable;
+TriangulationResult::Status TriangulationResult::TOO_FEW_INLIERS =
+    TriangulationResult::Status::kTooFewInliers;
 TriangulationResult::Status TriangulationResult::UNINITIALIZED =
     TriangulationResult::Status::kUninitialized;
 
+TriangulationResult linearTriangulateFromNViews(
+    const Aligned<std::vector, Eigen::Vector2d>& measurements_normalized,
+    const aslam::TransformationVector& T_G_B,
+    const aslam::Transformation& T_B_C, Eigen::Vector3d* G_point) {
+  switch (measurements_normalized.size()) {
+    case 2u:
+      return linearTriangulateFromNViews<2>(measurements_normalized, T_G_B, T_B_C, G_point);
+    case 3u:
+      return linearTriangulateFromNViews<3>(measurements_normalized, T_G_B, T_B_C, G_point);
+    default:
+      return linearTriangulateFromNViews<Eigen::Dynamic>(
+          measurements_normalized, T_G_B, T_B_C, G_point);
+  }
+}
+
+template <int kNumViews>
 TriangulationResult linearTriangulateFromNViews(
     const Aligned<std::vector, Eigen::Vector2d>& measurements_normalized,
     const aslam::TransformationVector& T_G_B,
     const aslam::Transformation& T_B_C, Eigen::Vector3d* G_point) {
   CHECK_NOTNULL(G_point);
   CHECK_EQ(measurements_normalized.size(), T_G_B.size());
+  if (kNumViews != Eigen::Dynamic) {
+    CHECK_EQ(measurements_normalized.size(), static_cast<size_t>(kNumViews));
+  }
   if (measurements_normalized.size() < 2u) {
     return TriangulationResult(TriangulationResult::TOO_FEW_MEASUREMENTS);
   }
 
   VLOG(200) << "Triangulating from " << T_G_B.size() << " views.";
 
+  constexpr int kRows = (kNumViews == Eigen::Dynamic) ? Eigen::Dynamic : 3 * kNumViews;
+  constexpr int kCols = (kNumViews == Eigen::Dynamic) ? Eigen::Dynamic : 3 + kNumViews;
+  typedef Eigen::Matrix<double, kRows, kCols> MatrixA;
+  typedef Eigen::Matrix<double, kRows, 1> VectorB;
+
   const size_t rows = 3 * measurements_normalized.size();
   const size_t cols = 3 + measurements_normalized.size();
-  Eigen::MatrixXd A = Eigen::MatrixXd::Zero(rows, cols);
-  Eigen::VectorXd b = Eigen::VectorXd::Zero(rows);
+  MatrixA A = MatrixA::Zero(rows, cols);
+  VectorB b = VectorB::Zero(rows);
 
   const Eigen::Matrix3d R_B_C = T_B_C.getRotationMatrix();
 
@@ -39,12 +70,12 @@ TriangulationResult linearTriangulateFromNViews(
         measurements_normalized[i](1), 1.);
     Eigen::Matrix3d R_G_B = T_G_B[i].getRotationMatrix();
     const Eigen::Vector3d& p_G_B = T_G_B[i].getPosition();
-    A.block<3, 3>(3 * i, 0) = Eigen::Matrix3d::Identity();
-    A.block<3, 1>(3 * i, 3 + i) = -R_G_B * R_B_C * v;
-    b.segment<3>(3 * i) = p_G_B + R_G_B * T_B_C.getPosition();
+    A.template block<3, 3>(3 * i, 0) = Eigen::Matrix3d::Identity();
+    A.template block<3, 1>(3 * i, 3 + i) = -R_G_B * R_B_C * v;
+    b.template segment<3>(3 * i) = p_G_B + R_G_B * T_B_C.getPosition();
   }
 
-  Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr = A.colPivHouseholderQr();
+  Eigen::ColPivHouseholderQR<MatrixA> qr = A.colPivHouseholderQr();
   static constexpr double kRankLossTolerance = 0.001;
   qr.setThreshold(kRankLossTolerance);
   const size_t rank = qr.rank();
@@ -53,11 +84,60 @@ TriangulationResult linearTriangulateFromNViews(
     return TriangulationResult(TriangulationResult::UNOBSERVABLE);
   }
 
-  *G_point = qr.solve(b).head<3>();
+  const Eigen::Matrix<double, kCols, 1> x = qr.solve(b);
+  *G_point = x.template head<3>();
 
   return TriangulationResult(TriangulationResult::SUCCESSFUL);
 }
 
+template TriangulationResult linearTriangulateFromNViews<3>(
+    const Aligned<std::vector, Eigen::Vector2d>& measurements_normalized,
+    const aslam::TransformationVector& T_G_B,
+    const aslam::Transformation& T_B_C, Eigen::Vector3d* G_point);
+template TriangulationResult linearTriangulateFromNViews<Eigen::Dynamic>(
+    const Aligned<std::vector, Eigen::Vector2d>& measurements_normalized,
+    const aslam::TransformationVector& T_G_B,
+    const aslam::Transformation& T_B_C, Eigen::Vector3d* G_point);
+
+template <>
+TriangulationResult linearTriangulateFromNViews<2>(
+    const Aligned<std::vector, Eigen::Vector2d>& measurements_normalized,
+    const aslam::TransformationVector& T_G_B,
+    const aslam::Transformation& T_B_C, Eigen::Vector3d* G_point) {
+  CHECK_NOTNULL(G_point);
+  CHECK_EQ(measurements_normalized.size(), 2u);
+  CHECK_EQ(T_G_B.size(), 2u);
+
+  // Rays c_i + s_i * d_i with unit directions.
+  const Eigen::Matrix3d R_B_C = T_B_C.getRotationMatrix();
+  const Eigen::Vector3d c_1 = T_G_B[0] * T_B_C.getPosition();
+  const Eigen::Vector3d c_2 = T_G_B[1] * T_B_C.getPosition();
+  const Eigen::Vector3d d_1 = (T_G_B[0].getRotationMatrix() * R_B_C *
+      measurements_normalized[0].homogeneous()).normalized();
+  const Eigen::Vector3d d_2 = (T_G_B[1].getRotationMatrix() * R_B_C *
+      measurements_normalized[1].homogeneous()).normalized();
+
+  // sin^2 of the angle between the rays. The QR of the general version loses rank once the
+  // smallest pivot falls below 0.001 of the largest one. For two views this ratio only depends on
+  // the rays and is about sin(parallax) / 2, hence the limit (2 * 0.001)^2, i.e. ~0.11 degrees.
+  static constexpr double kMinSquaredSinParallax = 4e-6;
+  const double cos_parallax = d_1.dot(d_2);
+  const double squared_sin_parallax = 1.0 - cos_parallax * cos_parallax;
+  if (squared_sin_parallax < kMinSquaredSinParallax) {
+    return TriangulationResult(TriangulationResult::UNOBSERVABLE);
+  }
+
+  // Closest points of the two rays.
+  const Eigen::Vector3d c_2_c_1 = c_1 - c_2;
+  const double d_1_dot_c = d_1.dot(c_2_c_1);
+  const double d_2_dot_c = d_2.dot(c_2_c_1);
+  const double s_1 = (cos_parallax * d_2_dot_c - d_1_dot_c) / squared_sin_parallax;
+  const double s_2 = (d_2_dot_c - cos_parallax * d_1_dot_c) / squared_sin_parallax;
+
+  *G_point = 0.5 * (c_1 + s_1 * d_1 + c_2 + s_2 * d_2);
+  return TriangulationResult(TriangulationResult::SUCCESSFUL);
+}
+
 TriangulationResult linearTriangulateFromNViews(
     const Eigen::Matrix3Xd& t_G_bv,
     const Eigen::Matrix3Xd& p_G_C,
@@ -261,10 +341,15 @@ TriangulationResult iterativeGaussNewtonTriangulateFromNViews(
   return TriangulationResult(TriangulationResult::SUCCESSFUL);
 }
 
-TriangulationResult triangulateFeatureTrack(
+namespace {
+/// Same as triangulateFeatureTrack with a buffer for the normalized measurements, such that
+/// repeated calls do not allocate once the buffer is large enough.
+TriangulationResult triangulateFeatureTrackWithBuffer(
     const aslam::FeatureTrack& track,
     const aslam::TransformationVector& T_W_Bs,
+    Aligned<std::vector, Eigen::Vector2d>* normalized_measurements,
     Eigen::Vector3d* W_landmark) {
+  CHECK_NOTNULL(normalized_measurements);
   CHECK_NOTNULL(W_landmark);
   size_t track_length = track.getTrackLength();
   CHECK_GT(track_length, 1u);
@@ -274,14 +359,12 @@ TriangulationResult triangulateFeatureTrack(
 
   const aslam::Camera::ConstPtr& camera = track.getFirstKeypointIdentifier().getCamera();
   CHECK(camera);
-  const aslam::CameraId track_camera_id = camera->getId();
   aslam::Transformation T_B_C = track.getFirstKeypointIdentifier().get_T_C_B().inverse();
 
   // Get the normalized measurements for all observations on the track.
-  Aligned<std::vector, Eigen::Vector2d> normalized_measurements;
-  normalized_measurements.reserve(track_length);
+  normalized_measurements->clear();
+  normalized_measurements->reserve(track_length);
 
-  size_t index = 0u;
   for (const aslam::KeypointIdentifier& keypoint_on_track : track.getKeypointIdentifiers()) {
     const aslam::Camera::ConstPtr& camera = keypoint_on_track.getCamera();
     CHECK(camera) << "Missing camera for keypoint on track with frame index: "
@@ -292,16 +375,16 @@ TriangulationResult triangulateFeatureTrack(
     Eigen::Vector3d C_ray;
     camera->backProject3(keypoint_measurement, &C_ray);
     Eigen::Vector2d normalized_measurement = C_ray.head<2>() / C_ray[2];
-    normalized_measurements.push_back(normalized_measurement);
+    normalized_measurements->push_back(normalized_measurement);
   }
 
   VLOG(200) << "Assembled triangulation data.";
 
   // Triangulate the landmark.
-  CHECK_EQ(track_length, normalized_measurements.size());
+  CHECK_EQ(track_length, normalized_measurements->size());
   CHECK_EQ(track_length, T_W_Bs.size());
   aslam::TriangulationResult triangulation_result = linearTriangulateFromNViews(
-                                                        normalized_measurements,
+                                                        *normalized_measurements,
                                                         T_W_Bs,
                                                         T_B_C,
                                                         W_landmark);
@@ -311,6 +394,73 @@ TriangulationResult triangulateFeatureTrack(
 
   return triangulation_result;
 }
+}  // namespace
+
+TriangulationResult triangulateFeatureTrack(
+    const aslam::FeatureTrack& track,
+    const aslam::TransformationVector& T_W_Bs,
+    Eigen::Vector3d* W_landmark) {
+  Aligned<std::vector, Eigen::Vector2d> normalized_measurements;
+  return triangulateFeatureTrackWithBuffer(track, T_W_Bs, &normalized_measurements, W_landmark);
+}
+
+namespace {
+/// Calls process_chunk(track_begin, track_end) for chunks of tracks on the shared pool of
+/// common::parallelFor, or for all tracks on the calling thread if num_threads is 1. Every chunk
+/// writes the outputs of its own tracks.
+template <typename ProcessChunkFunction>
+void processTrackChunks(size_t num_tracks, size_t num_tracks_per_chunk, size_t num_threads,
+                        const ProcessChunkFunction& process_chunk) {
+  const size_t grain_size =
+      num_threads == 1u ? std::max<size_t>(1u, num_tracks) : num_tracks_per_chunk;
+  common::parallelFor(common::IndexRange(0u, num_tracks), grain_size, process_chunk);
+}
+}  // namespace
+
+void triangulateFeatureTracks(
+    const aslam::FeatureTracks& tracks,
+    const std::vector<aslam::TransformationVector>& T_W_Bs_per_track,
+    size_t num_threads, Aligned<std::vector, Eigen::Vector3d>* W_landmarks,
+    std::vector<TriangulationResult>* results,
+    std::map<TriangulationResult::Status, std::vector<size_t>>* failed_track_indices) {
+  CHECK_NOTNULL(W_landmarks);
+  CHECK_NOTNULL(results);
+  const size_t num_tracks = tracks.size();
+  CHECK_EQ(T_W_Bs_per_track.size(), num_tracks);
+  W_landmarks->resize(num_tracks);
+  results->resize(num_tracks);
+
+  // Lengths of the tracks vary, the pool balances the chunks by stealing. Every chunk reuses
+  // its scratch buffer for all of its tracks and only writes its own output entries.
+  static constexpr size_t kNumTracksPerChunk = 32u;
+  processTrackChunks(num_tracks, kNumTracksPerChunk, num_threads,
+                     [&](size_t track_begin, size_t track_end) {
+    Aligned<std::vector, Eigen::Vector2d> normalized_measurements;
+    for (size_t track_idx = track_begin; track_idx < track_end; ++track_idx) {
+      TriangulationResult& result = (*results)[track_idx];
+      Eigen::Vector3d& W_landmark = (*W_landmarks)[track_idx];
+      if (tracks[track_idx].getTrackLength() < 2u) {
+        result = TriangulationResult(TriangulationResult::TOO_FEW_MEASUREMENTS);
+      } else {
+        result = triangulateFeatureTrackWithBuffer(
+            tracks[track_idx], T_W_Bs_per_track[track_idx], &normalized_measurements,
+            &W_landmark);
+      }
+      if (!result) {
+        W_landmark.setZero();
+      }
+    }
+  });
+
+  if (failed_track_indices != nullptr) {
+    failed_track_indices->clear();
+    for (size_t track_idx = 0u; track_idx < num_tracks; ++track_idx) {
+      if (!(*results)[track_idx]) {
+        (*failed_track_indices)[(*results)[track_idx].status()].push_back(track_idx);
+      }
+    }
+  }
+}
 
 TriangulationResult fastTriangulateFeatureTrack(
     const aslam::FeatureTrack& track,
@@ -363,5 +513,318 @@ TriangulationResult fastTriangulateFeatureTrack(
   return triangulation_result;
 }
 
-}  // namespace aslam
+void linearTriangulateFeatureTracks(
+    const FeatureTrackObservations& observations,
+    const Aligned<std::vector, aslam::Transformation>& T_G_Cs,
+    size_t num_threads, Eigen::Matrix3Xd* G_points,
+    std::vector<TriangulationResult>* results) {
+  CHECK_NOTNULL(G_points);
+  CHECK_NOTNULL(results);
+  const size_t num_tracks = observations.numTracks();
+  const size_t num_observations = observations.numObservations();
+  CHECK_EQ(static_cast<size_t>(observations.C_bearing_vectors.cols()), num_observations);
+  CHECK_EQ(observations.pose_indices.size(), num_observations);
+
+  G_points->resize(Eigen::NoChange, num_tracks);
+  results->resize(num_tracks);
+  if (num_tracks == 0u) {
+    return;
+  }
+
+  // Convert the poses once instead of once per observation.
+  Aligned<std::vector, Eigen::Matrix3d> R_G_Cs(T_G_Cs.size());
+  for (size_t pose_idx = 0u; pose_idx < T_G_Cs.size(); ++pose_idx) {
+    R_G_Cs[pose_idx] = T_G_Cs[pose_idx].getRotationMatrix();
+  }
+
+  // Per track, the Schur complement of linearTriangulateFromNViews(Matrix3Xd, ...) is a sum of
+  // one projector P = I - v * v^T / |v|^2 per bearing vector v:
+  // (sum_i P_i) * p_G_P = sum_i P_i * p_G_C[i].
+  auto triangulate_tracks = [&](size_t track_begin, size_t track_end) {
+    static constexpr double kRankLossTolerance = 1e-5;
+    for (size_t track_idx = track_begin; track_idx < track_end; ++track_idx) {
+      const size_t observation_begin = observations.track_offsets[track_idx];
+      const size_t observation_end = observations.track_offsets[track_idx + 1u];
+      CHECK_LE(observation_begin, observation_end);
+      if (observation_end - observation_begin < 2u) {
+        G_points->col(track_idx).setZero();
+        (*results)[track_idx] = TriangulationResult(TriangulationResult::TOO_FEW_MEASUREMENTS);
+        continue;
+      }
+
+      Eigen::Matrix3d AxtAx = Eigen::Matrix3d::Zero();
+      Eigen::Vector3d Axtbx = Eigen::Vector3d::Zero();
+      for (size_t i = observation_begin; i < observation_end; ++i) {
+        const size_t pose_idx = observations.pose_indices[i];
+        CHECK_LT(pose_idx, T_G_Cs.size());
+        const Eigen::Vector3d G_bearing_vector =
+            R_G_Cs[pose_idx] * observations.C_bearing_vectors.col(i);
+        const Eigen::Matrix3d projector = Eigen::Matrix3d::Identity() -
+            G_bearing_vector * G_bearing_vector.transpose() / G_bearing_vector.squaredNorm();
+        AxtAx += projector;
+        Axtbx.noalias() += projector * T_G_Cs[pose_idx].getPosition();
+      }
+
+      Eigen::ColPivHouseholderQR<Eigen::Matrix3d> qr(AxtAx);
+      qr.setThreshold(kRankLossTolerance);
+      if (qr.rank() < 3) {
+        G_points->col(track_idx).setZero();
+        (*results)[track_idx] = TriangulationResult(TriangulationResult::UNOBSERVABLE);
+        continue;
+      }
+      G_points->col(track_idx) = qr.solve(Axtbx);
+      (*results)[track_idx] = TriangulationResult(TriangulationResult::SUCCESSFUL);
+    }
+  };
+
+  // Chunks large enough to amortize the task overhead, every chunk writes its own columns.
+  static constexpr size_t kNumTracksPerChunk = 256u;
+  processTrackChunks(num_tracks, kNumTracksPerChunk, num_threads, triangulate_tracks);
+}
+
+namespace {
+/// Two-view hypothesis of robustTriangulateFeatureTracks, the midpoint of the rays c_a + s * d_a
+/// and c_b + s * d_b with unit directions. Fails for rays with too little parallax and points
+/// behind one of the cameras.
+bool triangulateRobustHypothesis(
+    const Eigen::Vector3d& c_a, const Eigen::Vector3d& d_a, const Eigen::Vector3d& c_b,
+    const Eigen::Vector3d& d_b, double min_squared_sin_parallax, Eigen::Vector3d* G_point) {
+  const double cos_parallax = d_a.dot(d_b);
+  const double squared_sin_parallax = 1.0 - cos_parallax * cos_parallax;
+  if (squared_sin_parallax < min_squared_sin_parallax) {
+    return false;
+  }
+  const Eigen::Vector3d c_b_c_a = c_a - c_b;
+  const double d_a_dot_c = d_a.dot(c_b_c_a);
+  const double d_b_dot_c = d_b.dot(c_b_c_a);
+  const double s_a = (cos_parallax * d_b_dot_c - d_a_dot_c) / squared_sin_parallax;
+  const double s_b = (d_b_dot_c - cos_parallax * d_a_dot_c) / squared_sin_parallax;
+  if (s_a <= 0.0 || s_b <= 0.0) {
+    return false;
+  }
+  *G_point = 0.5 * (c_a + s_a * d_a + c_b + s_b * d_b);
+  return true;
+}
+
+/// Scratch buffers of robustTriangulateFeatureTracks for the observations of one track.
+struct RobustTriangulationBuffers {
+  explicit RobustTriangulationBuffers(size_t max_track_length)
+      : G_bearing_vectors(3, max_track_length), p_G_Cs(3, max_track_length),
+        deltas(3, max_track_length), cos_angles(max_track_length),
+        is_inlier(max_track_length) {}
 
+  /// Unit bearing vectors and camera positions in the global frame.
+  Eigen::Matrix3Xd G_bearing_vectors;
+  Eigen::Matrix3Xd p_G_Cs;
+  Eigen::Matrix3Xd deltas;
+  Eigen::ArrayXd cos_angles;
+  Eigen::Array<bool, Eigen::Dynamic, 1> is_inlier;
+};
+
+/// Computes the cosines of the angles between the bearing vectors of the first n observations
+/// and the rays to G_point and selects the inliers. Returns the truncated angular cost.
+double scoreRobustHypothesis(
+    const Eigen::Vector3d& G_point, int n, double min_cos_angle,
+    RobustTriangulationBuffers* buffers) {
+  Eigen::Matrix3Xd::ColsBlockXpr deltas = buffers->deltas.leftCols(n);
+  deltas = -buffers->p_G_Cs.leftCols(n);
+  deltas.colwise() += G_point;
+  // Points at a camera give NaN, which is an outlier.
+  buffers->cos_angles.head(n) =
+      deltas.cwiseProduct(buffers->G_bearing_vectors.leftCols(n)).colwise().sum().array() /
+      deltas.colwise().norm().array();
+  buffers->is_inlier.head(n) = buffers->cos_angles.head(n) > min_cos_angle;
+  return buffers->is_inlier.head(n).select(
+      1.0 - buffers->cos_angles.head(n), 1.0 - min_cos_angle).sum();
+}
+
+/// Refines the landmark on the inliers of the first n observations.
+void refineRobustHypothesis(
+    int n, size_t max_num_iterations, const RobustTriangulationBuffers& buffers,
+    Eigen::Vector3d* G_point) {
+  static constexpr double kRankLossTolerance = 1e-5;
+  // Linear solution, see linearTriangulateFeatureTracks.
+  Eigen::Matrix3d AxtAx = Eigen::Matrix3d::Zero();
+  Eigen::Vector3d Axtbx = Eigen::Vector3d::Zero();
+  for (int i = 0; i < n; ++i) {
+    if (!buffers.is_inlier(i)) {
+      continue;
+    }
+    const Eigen::Vector3d G_bearing_vector = buffers.G_bearing_vectors.col(i);
+    const Eigen::Matrix3d projector =
+        Eigen::Matrix3d::Identity() - G_bearing_vector * G_bearing_vector.transpose();
+    AxtAx += projector;
+    Axtbx.noalias() += projector * buffers.p_G_Cs.col(i);
+  }
+  Eigen::ColPivHouseholderQR<Eigen::Matrix3d> qr(AxtAx);
+  qr.setThreshold(kRankLossTolerance);
+  if (qr.rank() == 3) {
+    *G_point = qr.solve(Axtbx);
+  }
+
+  // Gauss-Newton on the residuals u_i - v_i between the unit rays u_i to the landmark and the
+  // bearing vectors v_i. With distance l_i, J_i = (I - u_i u_i^T) / l_i, hence
+  // J_i^T J_i = (I - u_i u_i^T) / l_i^2 and J_i^T r_i = -(I - u_i u_i^T) v_i / l_i.
+  static constexpr double kMinSquaredStep = 1e-20;
+  for (size_t iteration = 0u; iteration < max_num_iterations; ++iteration) {
+    Eigen::Matrix3d JtJ = Eigen::Matrix3d::Zero();
+    Eigen::Vector3d Jtr = Eigen::Vector3d::Zero();
+    for (int i = 0; i < n; ++i) {
+      if (!buffers.is_inlier(i)) {
+        continue;
+      }
+      const Eigen::Vector3d delta = *G_point - buffers.p_G_Cs.col(i);
+      const double distance = delta.norm();
+      if (distance == 0.0) {
+        return;
+      }
+      const Eigen::Vector3d u = delta / distance;
+      const Eigen::Matrix3d projector = Eigen::Matrix3d::Identity() - u * u.transpose();
+      JtJ += projector / (distance * distance);
+      Jtr.noalias() -= projector * buffers.G_bearing_vectors.col(i) / distance;
+    }
+    const Eigen::LDLT<Eigen::Matrix3d> ldlt(JtJ);
+    if (ldlt.info() != Eigen::Success || !ldlt.isPositive()) {
+      return;
+    }
+    const Eigen::Vector3d step = -ldlt.solve(Jtr);
+    if (!step.allFinite()) {
+      return;
+    }
+    *G_point += step;
+    if (step.squaredNorm() < kMinSquaredStep * G_point->squaredNorm()) {
+      return;
+    }
+  }
+}
+}  // namespace
+
+void robustTriangulateFeatureTracks(
+    const FeatureTrackObservations& observations,
+    const Aligned<std::vector, aslam::Transformation>& T_G_Cs,
+    const RobustTriangulationOptions& options, size_t num_threads,
+    Eigen::Matrix3Xd* G_points, std::vector<TriangulationResult>* results,
+    std::vector<unsigned char>* inlier_masks) {
+  CHECK_NOTNULL(G_points);
+  CHECK_NOTNULL(results);
+  CHECK_NOTNULL(inlier_masks);
+  CHECK_GE(options.min_num_inliers, 2u);
+  CHECK_GT(options.max_num_hypotheses, 0u);
+  CHECK_GT(options.max_angular_error_rad, 0.0);
+  const size_t num_tracks = observations.numTracks();
+  const size_t num_observations = observations.numObservations();
+  CHECK_EQ(static_cast<size_t>(observations.C_bearing_vectors.cols()), num_observations);
+  CHECK_EQ(observations.pose_indices.size(), num_observations);
+
+  G_points->resize(Eigen::NoChange, num_tracks);
+  results->resize(num_tracks);
+  inlier_masks->assign(num_observations, 0u);
+  if (num_tracks == 0u) {
+    return;
+  }
+
+  Aligned<std::vector, Eigen::Matrix3d> R_G_Cs(T_G_Cs.size());
+  for (size_t pose_idx = 0u; pose_idx < T_G_Cs.size(); ++pose_idx) {
+    R_G_Cs[pose_idx] = T_G_Cs[pose_idx].getRotationMatrix();
+  }
+  size_t max_track_length = 0u;
+  for (size_t track_idx = 0u; track_idx < num_tracks; ++track_idx) {
+    CHECK_LE(observations.track_offsets[track_idx], observations.track_offsets[track_idx + 1u]);
+    max_track_length = std::max(max_track_length, observations.track_offsets[track_idx + 1u] -
+                                observations.track_offsets[track_idx]);
+  }
+
+  const double min_cos_angle = std::cos(options.max_angular_error_rad);
+  const double sin_parallax = std::sin(options.min_parallax_rad);
+  const double min_squared_sin_parallax = sin_parallax * sin_parallax;
+
+  auto triangulate_tracks = [&](size_t track_begin, size_t track_end) {
+    RobustTriangulationBuffers buffers(max_track_length);
+    for (size_t track_idx = track_begin; track_idx < track_end; ++track_idx) {
+      const size_t observation_begin = observations.track_offsets[track_idx];
+      const int n = static_cast<int>(observations.track_offsets[track_idx + 1u] -
+                                     observation_begin);
+      TriangulationResult& result = (*results)[track_idx];
+      G_points->col(track_idx).setZero();
+      if (n < 2) {
+        result = TriangulationResult(TriangulationResult::TOO_FEW_MEASUREMENTS);
+        continue;
+      }
+      for (int i = 0; i < n; ++i) {
+        const size_t pose_idx = observations.pose_indices[observation_begin + i];
+        CHECK_LT(pose_idx, T_G_Cs.size());
+        buffers.G_bearing_vectors.col(i) =
+            (R_G_Cs[pose_idx] * observations.C_bearing_vectors.col(observation_begin + i))
+            .normalized();
+        buffers.p_G_Cs.col(i) = T_G_Cs[pose_idx].getPosition();
+      }
+
+      // All pairs if there are few, else random pairs of different observations.
+      const size_t num_pairs = static_cast<size_t>(n) * (n - 1) / 2u;
+      const bool use_all_pairs = num_pairs <= options.max_num_hypotheses;
+      std::mt19937 generator(options.seed + static_cast<uint32_t>(track_idx));
+      std::uniform_int_distribution<int> first_distribution(0, n - 1);
+      std::uniform_int_distribution<int> second_distribution(0, n - 2);
+      int a = 0;
+      int b = 0;
+      bool has_hypothesis = false;
+      double best_cost = 0.0;
+      Eigen::Vector3d best_G_point;
+      for (size_t hypothesis_idx = 0u;
+          hypothesis_idx < (use_all_pairs ? num_pairs : options.max_num_hypotheses);
+          ++hypothesis_idx) {
+        if (use_all_pairs) {
+          // (0, 1), (0, 2), ..., (0, n - 1), (1, 2), ...
+          if (++b >= n) {
+            ++a;
+            b = a + 1;
+          }
+        } else {
+          a = first_distribution(generator);
+          b = second_distribution(generator);
+          b += (b >= a) ? 1 : 0;
+        }
+        Eigen::Vector3d G_point;
+        if (!triangulateRobustHypothesis(
+            buffers.p_G_Cs.col(a), buffers.G_bearing_vectors.col(a), buffers.p_G_Cs.col(b),
+            buffers.G_bearing_vectors.col(b), min_squared_sin_parallax, &G_point)) {
+          continue;
+        }
+        const double cost = scoreRobustHypothesis(G_point, n, min_cos_angle, &buffers);
+        if (!has_hypothesis || cost < best_cost) {
+          has_hypothesis = true;
+          best_cost = cost;
+          best_G_point = G_point;
+        }
+      }
+      if (!has_hypothesis) {
+        result = TriangulationResult(TriangulationResult::UNOBSERVABLE);
+        continue;
+      }
+
+      scoreRobustHypothesis(best_G_point, n, min_cos_angle, &buffers);
+      if (static_cast<size_t>(buffers.is_inlier.head(n).count()) < options.min_num_inliers) {
+        result = TriangulationResult(TriangulationResult::TOO_FEW_INLIERS);
+        continue;
+      }
+      refineRobustHypothesis(n, options.max_num_refinement_iterations, buffers, &best_G_point);
+      scoreRobustHypothesis(best_G_point, n, min_cos_angle, &buffers);
+      if (static_cast<size_t>(buffers.is_inlier.head(n).count()) < options.min_num_inliers) {
+        result = TriangulationResult(TriangulationResult::TOO_FEW_INLIERS);
+        continue;
+      }
+
+      G_points->col(track_idx) = best_G_point;
+      for (int i = 0; i < n; ++i) {
+        (*inlier_masks)[observation_begin + i] = buffers.is_inlier(i) ? 1u : 0u;
+      }
+      result = TriangulationResult(TriangulationResult::SUCCESSFUL);
+    }
+  };
+
+  // Robust tracks take longer than linear ones, smaller chunks balance the threads.
+  static constexpr size_t kNumTracksPerChunk = 64u;
+  processTrackChunks(num_tracks, kNumTracksPerChunk, num_threads, triangulate_tracks);
+}
+
+}  // namespace aslam
@@ -0,0 +1,106 @@
+#include <Eigen/Core>
+#include <eigen-checks/gtest.h>
+#include <gtest/gtest.h>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/triangulation/incremental-triangulator.h>
+#include <aslam/triangulation/triangulation.h>
+
+namespace aslam {
+
+class IncrementalTriangulatorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    G_landmark_ << 1.0, -0.5, 5.0;
+    T_G_Cs_.resize(kNumObservations);
+    for (size_t i = 0u; i < kNumObservations; ++i) {
+      // Cameras moving sideways with a perturbation.
+      T_G_Cs_[i].setRandom(0.2, 0.1);
+      T_G_Cs_[i].getPosition() += Eigen::Vector3d(0.1 * static_cast<double>(i), 0.0, 0.0);
+    }
+  }
+
+  Eigen::Vector3d getBearingVector(size_t i) const {
+    return T_G_Cs_[i].inverse().transform(G_landmark_);
+  }
+
+  static constexpr size_t kNumObservations = 30u;
+  Eigen::Vector3d G_landmark_;
+  Aligned<std::vector, aslam::Transformation> T_G_Cs_;
+
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+constexpr size_t IncrementalTriangulatorTest::kNumObservations;
+
+TEST_F(IncrementalTriangulatorTest, ConvergesToLandmark) {
+  constexpr size_t kTrackId = 7u;
+  IncrementalTriangulator triangulator;
+  Eigen::Vector3d G_point;
+  EXPECT_EQ(TriangulationResult::TOO_FEW_MEASUREMENTS, triangulator.addObservation(
+      kTrackId, getBearingVector(0u), T_G_Cs_[0u], &G_point).status());
+  EXPECT_FALSE(triangulator.getLandmark(kTrackId, &G_point));
+
+  for (size_t i = 1u; i < kNumObservations; ++i) {
+    ASSERT_TRUE(triangulator.addObservation(
+        kTrackId, getBearingVector(i), T_G_Cs_[i], &G_point).wasTriangulationSuccessful());
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(G_landmark_, G_point, 1e-6));
+  }
+  EXPECT_EQ(kNumObservations, triangulator.getNumObservations(kTrackId));
+  Eigen::Vector3d G_landmark_estimate;
+  ASSERT_TRUE(triangulator.getLandmark(kTrackId, &G_landmark_estimate));
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(G_point, G_landmark_estimate, 0.0));
+
+  triangulator.removeTrack(kTrackId);
+  EXPECT_EQ(0u, triangulator.numTracks());
+  EXPECT_EQ(0u, triangulator.getNumObservations(kTrackId));
+}
+
+TEST_F(IncrementalTriangulatorTest, NoisyObservationsMatchBatchTriangulation) {
+  constexpr size_t kTrackId = 0u;
+  constexpr double kAngleNoise = 1e-3;
+  IncrementalTriangulator triangulator;
+  Eigen::Matrix3Xd G_bearing_vectors(3, kNumObservations);
+  Eigen::Matrix3Xd p_G_Cs(3, kNumObservations);
+  Eigen::Vector3d G_point;
+  for (size_t i = 0u; i < kNumObservations; ++i) {
+    aslam::Transformation perturbation;
+    perturbation.setRandom(0.0, kAngleNoise);
+    const Eigen::Vector3d C_bearing_vector = perturbation.transform(getBearingVector(i));
+    triangulator.addObservation(kTrackId, C_bearing_vector, T_G_Cs_[i], &G_point);
+    G_bearing_vectors.col(i) = T_G_Cs_[i].getRotationMatrix() * C_bearing_vector;
+    p_G_Cs.col(i) = T_G_Cs_[i].getPosition();
+  }
+
+  // The inverse depth weights are almost equal for this landmark, hence the incremental result
+  // is close to the unweighted batch triangulation.
+  Eigen::Vector3d G_point_batch;
+  ASSERT_TRUE(linearTriangulateFromNViews(
+      G_bearing_vectors, p_G_Cs, &G_point_batch).wasTriangulationSuccessful());
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(G_point_batch, G_point, 0.05));
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(G_landmark_, G_point, 0.2));
+}
+
+TEST_F(IncrementalTriangulatorTest, StationaryCameraIsUnobservable) {
+  constexpr size_t kTrackId = 3u;
+  IncrementalTriangulator triangulator;
+  Eigen::Vector3d G_point;
+  triangulator.addObservation(kTrackId, getBearingVector(0u), T_G_Cs_[0u], &G_point);
+  for (size_t i = 0u; i < 5u; ++i) {
+    EXPECT_EQ(TriangulationResult::UNOBSERVABLE, triangulator.addObservation(
+        kTrackId, getBearingVector(0u), T_G_Cs_[0u], &G_point).status());
+  }
+  EXPECT_FALSE(triangulator.getLandmark(kTrackId, &G_point));
+
+  // A second view makes the track observable.
+  EXPECT_TRUE(triangulator.addObservation(
+      kTrackId, getBearingVector(10u), T_G_Cs_[10u], &G_point).wasTriangulationSuccessful());
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(G_landmark_, G_point, 1e-6));
+}
+
+}  // namespace aslam
+
+ASLAM_UNITTEST_ENTRYPOINT
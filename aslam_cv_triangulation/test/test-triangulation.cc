@@ -1,3 +1,6 @@
+#include <map>
+#include <vector>
+
 #include <Eigen/Eigen>
 #include <gtest/gtest.h>
 
@@ -157,4 +160,237 @@ TYPED_TEST(TriangulationFixture, CombinedParallelAndGoodRays) {
   this->expectSuccess();
 }
 
+TEST(TriangulationFixedSizeTest, MatchesDynamicVersion) {
+  constexpr size_t kNumTrials = 100u;
+  aslam::Transformation T_B_C;
+  T_B_C.setRandom(0.2, 0.1);
+  for (size_t num_views = 2u; num_views <= 3u; ++num_views) {
+    for (size_t trial = 0u; trial < kNumTrials; ++trial) {
+      const Eigen::Vector3d G_landmark = Eigen::Vector3d::Random() + Eigen::Vector3d(0, 0, 5);
+      aslam::TransformationVector T_G_B(num_views);
+      Aligned<std::vector, Eigen::Vector2d> measurements(num_views);
+      for (size_t i = 0u; i < num_views; ++i) {
+        T_G_B[i].setRandom(1.0, 0.1);
+        const Eigen::Vector3d C_landmark = (T_G_B[i] * T_B_C).inverse().transform(G_landmark);
+        // Noisy measurements, such that the rays do not intersect.
+        measurements[i] = C_landmark.head<2>() / C_landmark(2) + 1e-3 * Eigen::Vector2d::Random();
+      }
+
+      Eigen::Vector3d G_point_dynamic;
+      ASSERT_TRUE(aslam::linearTriangulateFromNViews<Eigen::Dynamic>(
+          measurements, T_G_B, T_B_C, &G_point_dynamic).wasTriangulationSuccessful());
+      Eigen::Vector3d G_point;
+      ASSERT_TRUE(aslam::linearTriangulateFromNViews(
+          measurements, T_G_B, T_B_C, &G_point).wasTriangulationSuccessful());
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(G_point_dynamic, G_point, 1e-6));
+    }
+  }
+}
+
+TEST(TriangulationFixedSizeTest, TwoViewParallaxLimitMatchesDynamicVersion) {
+  const aslam::Transformation T_B_C;
+  const double kDepth = 5.0;
+  // Parallax angles on both sides of the rank loss at ~0.11 degrees.
+  for (const double parallax_deg : {0.05, 0.08, 0.15, 0.2, 1.0}) {
+    for (const Eigen::Vector3d& G_landmark_direction :
+         {Eigen::Vector3d(0.0, 0.0, 1.0), Eigen::Vector3d(0.4, -0.3, 1.0)}) {
+      const Eigen::Vector3d G_landmark = kDepth * G_landmark_direction;
+      aslam::TransformationVector T_G_B(2u);
+      T_G_B[1].getPosition() = Eigen::Vector3d(
+          G_landmark.norm() * std::tan(parallax_deg / 180.0 * M_PI), 0.0, 0.0);
+      Aligned<std::vector, Eigen::Vector2d> measurements(2u);
+      for (size_t i = 0u; i < 2u; ++i) {
+        const Eigen::Vector3d C_landmark = T_G_B[i].inverse().transform(G_landmark);
+        measurements[i] = C_landmark.head<2>() / C_landmark(2);
+      }
+
+      Eigen::Vector3d G_point_dynamic, G_point;
+      EXPECT_EQ(aslam::linearTriangulateFromNViews<Eigen::Dynamic>(
+                    measurements, T_G_B, T_B_C, &G_point_dynamic).wasTriangulationSuccessful(),
+                aslam::linearTriangulateFromNViews<2>(
+                    measurements, T_G_B, T_B_C, &G_point).wasTriangulationSuccessful())
+          << "Parallax " << parallax_deg << " degrees";
+      EXPECT_EQ(parallax_deg > 0.11, aslam::linearTriangulateFromNViews<2>(
+          measurements, T_G_B, T_B_C, &G_point).wasTriangulationSuccessful())
+          << "Parallax " << parallax_deg << " degrees";
+    }
+  }
+}
+
+TEST(TriangulationBatchTest, LinearTriangulateFeatureTracks) {
+  constexpr size_t kNumPoses = 10u;
+  constexpr size_t kNumTracks = 1000u;
+  Aligned<std::vector, aslam::Transformation> T_G_Cs(kNumPoses);
+  for (aslam::Transformation& T_G_C : T_G_Cs) {
+    T_G_C.setRandom(1.0, 0.2);
+  }
+
+  // Every track observes its landmark from a varying number of consecutive poses, the last two
+  // tracks are too short and unobservable.
+  aslam::FeatureTrackObservations observations;
+  observations.track_offsets.push_back(0u);
+  std::vector<Eigen::Matrix3Xd> track_bearing_vectors;
+  std::vector<Eigen::Matrix3Xd> track_positions;
+  for (size_t track_idx = 0u; track_idx < kNumTracks; ++track_idx) {
+    const Eigen::Vector3d G_landmark = Eigen::Vector3d::Random() + Eigen::Vector3d(0, 0, 5);
+    size_t track_length = 2u + track_idx % (kNumPoses - 1u);
+    if (track_idx == kNumTracks - 2u) {
+      track_length = 1u;
+    }
+    Eigen::Matrix3Xd G_bearing_vectors(3, track_length);
+    Eigen::Matrix3Xd p_G_Cs(3, track_length);
+    for (size_t i = 0u; i < track_length; ++i) {
+      const size_t pose_idx = (track_idx == kNumTracks - 1u) ? 0u : (track_idx + i) % kNumPoses;
+      observations.pose_indices.push_back(pose_idx);
+      observations.C_bearing_vectors.conservativeResize(
+          Eigen::NoChange, observations.pose_indices.size());
+      observations.C_bearing_vectors.rightCols<1>() =
+          T_G_Cs[pose_idx].inverse().transform(G_landmark);
+      G_bearing_vectors.col(i) = G_landmark - T_G_Cs[pose_idx].getPosition();
+      p_G_Cs.col(i) = T_G_Cs[pose_idx].getPosition();
+    }
+    observations.track_offsets.push_back(observations.pose_indices.size());
+    track_bearing_vectors.push_back(G_bearing_vectors);
+    track_positions.push_back(p_G_Cs);
+  }
+
+  Eigen::Matrix3Xd G_points;
+  std::vector<aslam::TriangulationResult> results;
+  aslam::linearTriangulateFeatureTracks(observations, T_G_Cs, 4u, &G_points, &results);
+  ASSERT_EQ(static_cast<int>(kNumTracks), G_points.cols());
+  ASSERT_EQ(kNumTracks, results.size());
+
+  EXPECT_EQ(aslam::TriangulationResult::TOO_FEW_MEASUREMENTS, results[kNumTracks - 2u].status());
+  EXPECT_EQ(aslam::TriangulationResult::UNOBSERVABLE, results[kNumTracks - 1u].status());
+  for (size_t track_idx = 0u; track_idx < kNumTracks - 2u; ++track_idx) {
+    Eigen::Vector3d G_point_expected;
+    ASSERT_TRUE(aslam::linearTriangulateFromNViews(track_bearing_vectors[track_idx],
+        track_positions[track_idx], &G_point_expected).wasTriangulationSuccessful());
+    EXPECT_TRUE(results[track_idx].wasTriangulationSuccessful());
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(G_point_expected, G_points.col(track_idx), 1e-6));
+  }
+
+  // The serial computation gives the same result.
+  Eigen::Matrix3Xd G_points_serial;
+  std::vector<aslam::TriangulationResult> results_serial;
+  aslam::linearTriangulateFeatureTracks(observations, T_G_Cs, 1u, &G_points_serial,
+                                        &results_serial);
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(G_points, G_points_serial, 0.0));
+}
+
+TEST(TriangulationBatchTest, RobustTriangulateFeatureTracksRejectsOutliers) {
+  constexpr size_t kNumPoses = 10u;
+  constexpr size_t kNumTracks = 500u;
+  Aligned<std::vector, aslam::Transformation> T_G_Cs(kNumPoses);
+  for (aslam::Transformation& T_G_C : T_G_Cs) {
+    T_G_C.setRandom(1.0, 0.2);
+  }
+
+  // Tracks with at least four observations get the second observation rotated far off the
+  // landmark. All observations of the last track are outliers.
+  aslam::FeatureTrackObservations observations;
+  observations.track_offsets.push_back(0u);
+  std::vector<unsigned char> expected_inlier_masks;
+  Eigen::Matrix3Xd G_landmarks(3, kNumTracks);
+  for (size_t track_idx = 0u; track_idx < kNumTracks; ++track_idx) {
+    G_landmarks.col(track_idx) = Eigen::Vector3d::Random() + Eigen::Vector3d(0, 0, 5);
+    const size_t track_length = 2u + track_idx % (kNumPoses - 1u);
+    for (size_t i = 0u; i < track_length; ++i) {
+      const size_t pose_idx = (track_idx + i) % kNumPoses;
+      Eigen::Vector3d C_bearing_vector =
+          T_G_Cs[pose_idx].inverse().transform(G_landmarks.col(track_idx));
+      const bool is_outlier =
+          (track_length >= 4u && i == 1u) || track_idx == kNumTracks - 1u;
+      if (is_outlier) {
+        C_bearing_vector = Eigen::AngleAxisd(0.2, Eigen::Vector3d::Random().normalized()) *
+            C_bearing_vector;
+      }
+      observations.pose_indices.push_back(pose_idx);
+      observations.C_bearing_vectors.conservativeResize(
+          Eigen::NoChange, observations.pose_indices.size());
+      observations.C_bearing_vectors.rightCols<1>() = C_bearing_vector;
+      expected_inlier_masks.push_back(is_outlier ? 0u : 1u);
+    }
+    observations.track_offsets.push_back(observations.pose_indices.size());
+  }
+
+  aslam::RobustTriangulationOptions options;
+  options.min_num_inliers = 3u;
+  Eigen::Matrix3Xd G_points;
+  std::vector<aslam::TriangulationResult> results;
+  std::vector<unsigned char> inlier_masks;
+  aslam::robustTriangulateFeatureTracks(observations, T_G_Cs, options, 4u, &G_points, &results,
+                                        &inlier_masks);
+  ASSERT_EQ(static_cast<int>(kNumTracks), G_points.cols());
+  ASSERT_EQ(kNumTracks, results.size());
+  ASSERT_EQ(observations.numObservations(), inlier_masks.size());
+
+  for (size_t track_idx = 0u; track_idx < kNumTracks - 1u; ++track_idx) {
+    const size_t observation_begin = observations.track_offsets[track_idx];
+    const size_t observation_end = observations.track_offsets[track_idx + 1u];
+    // Too few observations remain if the track had two.
+    if (observation_end - observation_begin < 3u) {
+      EXPECT_EQ(aslam::TriangulationResult::TOO_FEW_INLIERS, results[track_idx].status());
+      continue;
+    }
+    ASSERT_TRUE(results[track_idx].wasTriangulationSuccessful()) << results[track_idx];
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(G_landmarks.col(track_idx), G_points.col(track_idx), 1e-6));
+    for (size_t i = observation_begin; i < observation_end; ++i) {
+      EXPECT_EQ(expected_inlier_masks[i], inlier_masks[i]);
+    }
+  }
+  EXPECT_EQ(aslam::TriangulationResult::TOO_FEW_INLIERS, results.back().status());
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(Eigen::Vector3d::Zero(), G_points.rightCols<1>(), 0.0));
+
+  // The serial computation gives the same result.
+  Eigen::Matrix3Xd G_points_serial;
+  std::vector<aslam::TriangulationResult> results_serial;
+  std::vector<unsigned char> inlier_masks_serial;
+  aslam::robustTriangulateFeatureTracks(observations, T_G_Cs, options, 1u, &G_points_serial,
+                                        &results_serial, &inlier_masks_serial);
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(G_points, G_points_serial, 0.0));
+  EXPECT_EQ(inlier_masks, inlier_masks_serial);
+}
+
+TEST(TriangulateFeatureTracksTest, ParallelMatchesSingleTrackTriangulation) {
+  constexpr size_t kNumTracks = 200u;
+  constexpr size_t kNumPoses = 8u;
+  aslam::FeatureTracks tracks;
+  std::vector<aslam::TransformationVector> T_W_Bs_per_track;
+  Aligned<std::vector, Eigen::Vector3d> W_landmarks_expected;
+  createTestFeatureTracks(kNumTracks, kNumPoses, &tracks, &T_W_Bs_per_track,
+                          &W_landmarks_expected);
+
+  // A track with a single observation.
+  tracks.push_back(tracks.front());
+  while (tracks.back().getTrackLength() > 1u) {
+    tracks.back().popLastKeypointIdentifier();
+  }
+  T_W_Bs_per_track.emplace_back(T_W_Bs_per_track.front().begin(),
+                                T_W_Bs_per_track.front().begin() + 1);
+
+  Aligned<std::vector, Eigen::Vector3d> W_landmarks;
+  std::vector<aslam::TriangulationResult> results;
+  std::map<aslam::TriangulationResult::Status, std::vector<size_t>> failed_track_indices;
+  aslam::triangulateFeatureTracks(tracks, T_W_Bs_per_track, 4u, &W_landmarks, &results,
+                                  &failed_track_indices);
+  ASSERT_EQ(kNumTracks + 1u, W_landmarks.size());
+  ASSERT_EQ(kNumTracks + 1u, results.size());
+
+  for (size_t track_idx = 0u; track_idx < kNumTracks; ++track_idx) {
+    Eigen::Vector3d W_landmark;
+    ASSERT_TRUE(aslam::triangulateFeatureTrack(
+        tracks[track_idx], T_W_Bs_per_track[track_idx], &W_landmark));
+    EXPECT_TRUE(results[track_idx].wasTriangulationSuccessful());
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(W_landmark, W_landmarks[track_idx], 0.0));
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(W_landmarks_expected[track_idx], W_landmarks[track_idx], 1e-4));
+  }
+
+  EXPECT_EQ(aslam::TriangulationResult::TOO_FEW_MEASUREMENTS, results.back().status());
+  ASSERT_EQ(1u, failed_track_indices.size());
+  ASSERT_EQ(1u, failed_track_indices.count(aslam::TriangulationResult::TOO_FEW_MEASUREMENTS));
+  EXPECT_EQ(std::vector<size_t>(1u, kNumTracks),
+            failed_track_indices[aslam::TriangulationResult::TOO_FEW_MEASUREMENTS]);
+}
+
 ASLAM_UNITTEST_ENTRYPOINT
@@ -36,6 +36,9 @@ typedef std::vector<ImagePositionOffset> Offsets;
 /// Takes an nframe, assembles all frames into one big image, puts in the raw images from the
 /// frames and draws keypoints on them.
 void visualizeKeypoints(const std::shared_ptr<const aslam::VisualNFrame>& nframe, cv::Mat* image);
+/// Same as above, but the image is rendered downscaled by image_scale in (0, 1].
+void visualizeKeypoints(const std::shared_ptr<const aslam::VisualNFrame>& nframe,
+                        double image_scale, cv::Mat* image);
 
 /// Takes two frames and list of matches between them and draws the raw images and the matches.
 template<typename MatchesWithScore>
@@ -50,6 +53,8 @@ void visualizeMatches(const aslam::VisualFrame& frame_kp1,
 
 /// Takes a frame and draws keypoints on it.
 void drawKeypoints(const aslam::VisualFrame& frame, cv::Mat* image);
+/// Takes a frame and draws its keypoints on an image downscaled by image_scale.
+void drawKeypoints(const aslam::VisualFrame& frame, double image_scale, cv::Mat* image);
 
 /// Takes two frames and a list of matches between them and draws the matches.
 /// Does not draw the raw image!
@@ -62,6 +67,19 @@ void drawKeypointMatches(const aslam::VisualFrame& frame_kp1,
 /// Takes an nframe and creates a single image patching together all raw images of all frames.
 void assembleMultiImage(const aslam::VisualNFrame::ConstPtr& nframe,
                         cv::Mat* full_image, Offsets* offsets);
+/// Same as above, but the raw images are downscaled by image_scale in (0, 1] before the color
+/// conversion. The offsets are in the downscaled image.
+void assembleMultiImage(const aslam::VisualNFrame::ConstPtr& nframe, double image_scale,
+                        cv::Mat* full_image, Offsets* offsets);
+
+/// The size of an image axis downscaled by image_scale, rounded and at least one pixel.
+size_t getScaledImageSize(size_t size, double image_scale);
+
+/// Computes the layout of assembleMultiImage for images of the given sizes: the images are
+/// placed in rows of ceil(N / floor(sqrt(N))) images each. Returns the offsets of the images in
+/// the assembled image and its size.
+void computeMultiImageLayout(const std::vector<cv::Size>& image_sizes, Offsets* offsets,
+                             cv::Size* full_image_size);
 
 /// Draw the patches around all keypoints for one features tracks.
 void drawFeatureTrackPatches(const aslam::FeatureTrack& track, size_t neighborhood_px,
@@ -1,6 +1,8 @@
 #ifndef VISUALIZATION_FEATURE_TRACK_VISUALIZER_H_
 #define VISUALIZATION_FEATURE_TRACK_VISUALIZER_H_
 
+#include <vector>
+
 #include <aslam/common/memory.h>
 #include <aslam/frames/feature-track.h>
 #include <aslam/frames/visual-frame.h>
@@ -11,9 +13,16 @@
 namespace aslam_cv_visualization {
 
 /// Visualization for aslam::FeatureTracks.
+///
+/// The tracks are kept in a flat slot array indexed by track id modulo its capacity, which
+/// is updated once per frame from the track ids of the new frame only. Each slot remembers the
+/// frame in which its track was last observed, a track is continued if it was observed in the
+/// previous frame and (re)started otherwise. A new track starts with the keypoint of the last
+/// frame that the tracker has since assigned its id to, hence a track is drawn from its second
+/// frame on. The array grows if two live tracks collide.
 class VisualFrameFeatureTrackVisualizer {
  public:
-  VisualFrameFeatureTrackVisualizer() : rng_(cv::RNG(0xFFFFFFFF)) {}
+  VisualFrameFeatureTrackVisualizer();
 
   void drawContinuousFeatureTracks(
       const aslam::VisualFrame::ConstPtr& frame,
@@ -21,20 +30,42 @@ class VisualFrameFeatureTrackVisualizer {
       cv::Mat* image);
 
  private:
-  typedef AlignedUnorderedMap<int, size_t> TrackIdToIndexMap;
+  struct TrackSlot {
+    TrackSlot() : track_id(-1), frame_index(0u), color_index(0u) {}
+    /// -1 if the slot is free.
+    int track_id;
+    /// Index of the frame in which the track was last observed.
+    size_t frame_index;
+    size_t color_index;
+    std::vector<cv::Point> keypoints;
+  };
 
-  void preprocessLastFrame(TrackIdToIndexMap* track_id_to_keypoint_index_map);
+  /// A track is live if it was observed in the current or the previous frame.
+  bool isLive(const TrackSlot& slot) const {
+    return slot.track_id >= 0 && slot.frame_index + 1u >= frame_index_;
+  }
+  TrackSlot& getSlot(int track_id) { return track_slots_[track_id & (track_slots_.size() - 1u)]; }
+  /// Returns the slot in which the track is stored, growing the slot array on collisions.
+  TrackSlot& insertTrack(int track_id);
+  void growSlots();
 
-  struct Track {
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-    Aligned<std::vector, Eigen::Vector2d> keypoints;
-    cv::Scalar color;
-  };
-  typedef AlignedUnorderedMap<int, Track> TrackMap;
-  TrackMap track_id_to_track_map_;
+  void drawTracks(cv::Mat* image);
 
+  std::vector<TrackSlot> track_slots_;
+  /// Index of the current frame, the first frame has index 1.
+  size_t frame_index_;
+  /// The track ids of the last frame are read again with the next frame.
   aslam::VisualFrame::ConstPtr last_frame_;
 
+  /// Tracks are drawn with a fixed palette such that all tracks of one color are drawn at once.
+  std::vector<cv::Scalar> palette_;
+
+  // Buffers of the polylines, kept to avoid allocations per frame.
+  std::vector<std::vector<const cv::Point*>> polyline_points_;
+  std::vector<std::vector<int>> polyline_num_points_;
+  std::vector<const cv::Point*> terminated_polyline_points_;
+  std::vector<int> terminated_polyline_num_points_;
+
   cv::RNG rng_;
 };
 
@@ -0,0 +1,74 @@
+#ifndef ASLAM_VISUALIZATION_MULTI_IMAGE_MOSAIC_H_
+#define ASLAM_VISUALIZATION_MULTI_IMAGE_MOSAIC_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/macros.h>
+#include <aslam/common/thread-pool.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <opencv2/core/core.hpp>
+
+#include "aslam/visualization/basic-visualization.h"
+
+namespace aslam_cv_visualization {
+
+/// \class MultiImageMosaic
+/// \brief Persistent mosaic of the raw images of all frames of an nframe.
+///
+/// Unlike assembleMultiImage, the mosaic buffer and its layout are only (re)allocated when the
+/// NCamera of the rendered nframes changes. Each frame is color converted straight into its tile,
+/// which is a view into the mosaic, and then drawn on by the optional draw function. The tiles
+/// are disjoint, hence the frames are rendered in parallel.
+class MultiImageMosaic {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(MultiImageMosaic);
+
+  /// Draws on the tile of a frame. Called concurrently for different frames.
+  typedef std::function<void(size_t frame_idx, const aslam::VisualFrame& frame,
+                             cv::Mat* tile)> DrawFunction;
+
+  /// \param[in] image_scale Scale in (0, 1] of the tiles w.r.t. the raw images.
+  /// \param[in] num_threads Number of threads rendering the tiles, 0 for one per core.
+  MultiImageMosaic(double image_scale, size_t num_threads);
+  MultiImageMosaic() : MultiImageMosaic(1.0, 1u) {}
+
+  /// Render the raw images of the nframe into the mosaic. Tiles of frames without a raw image are
+  /// black.
+  void render(const aslam::VisualNFrame::ConstPtr& nframe, const DrawFunction& draw_function);
+  /// Render the raw images and the keypoints of the nframe.
+  void renderKeypoints(const aslam::VisualNFrame::ConstPtr& nframe);
+
+  /// The mosaic is overwritten by the next call to render.
+  const cv::Mat& getImage() const { return mosaic_; }
+  const Offsets& getOffsets() const { return offsets_; }
+  /// View into the mosaic.
+  const cv::Mat& getTile(size_t frame_idx) const {
+    CHECK_LT(frame_idx, tiles_.size());
+    return tiles_[frame_idx];
+  }
+  double getImageScale() const { return image_scale_; }
+
+ private:
+  void updateLayout(const std::shared_ptr<const aslam::NCamera>& ncamera);
+  void renderTile(size_t frame_idx, const aslam::VisualFrame& frame,
+                  const DrawFunction& draw_function);
+
+  const double image_scale_;
+  std::unique_ptr<aslam::ThreadPool> thread_pool_;
+
+  /// The NCamera of the current layout, kept to detect a change of the NCamera.
+  std::shared_ptr<const aslam::NCamera> ncamera_;
+  cv::Mat mosaic_;
+  Offsets offsets_;
+  std::vector<cv::Mat> tiles_;
+  /// Buffers of the downscaled raw images.
+  std::vector<cv::Mat> scaled_raw_images_;
+};
+
+}  // namespace aslam_cv_visualization
+
+#endif  // ASLAM_VISUALIZATION_MULTI_IMAGE_MOSAIC_H_
@@ -0,0 +1,93 @@
+#ifndef ASLAM_VISUALIZATION_VISUALIZATION_WORKER_H_
+#define ASLAM_VISUALIZATION_VISUALIZATION_WORKER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <aslam/common/macros.h>
+#include <aslam/frames/visual-nframe.h>
+#include <opencv2/core/core.hpp>
+
+namespace aslam_cv_visualization {
+
+/// \class VisualizationWorker
+/// \brief Renders debug visualizations of nframes on a low priority thread.
+///
+/// submit() takes a snapshot of the nframe, which is cheap as the frames of the copy share their
+/// channels with the original until either is modified. The worker renders at most
+/// max_frame_rate_hz images per second and only keeps the latest pending snapshot: nframes
+/// submitted faster or while the worker is behind are dropped without being copied.
+class VisualizationWorker {
+ public:
+  ASLAM_DISALLOW_EVIL_CONSTRUCTORS(VisualizationWorker);
+
+  /// Renders the nframe, downscaled by image_scale, into the image.
+  typedef std::function<void(const aslam::VisualNFrame::ConstPtr& nframe, double image_scale,
+                             cv::Mat* image)> RenderFunction;
+  /// Receives the rendered images on the worker thread, e.g. to publish or show them.
+  typedef std::function<void(const aslam::VisualNFrame& nframe, const cv::Mat& image)>
+      ImageCallback;
+
+  struct Options {
+    Options()
+        : max_frame_rate_hz(10.0),
+          image_scale(1.0),
+          nice_increment(10) {};
+    /// Max. rate of the rendered images, 0 for no limit. [Hz]
+    double max_frame_rate_hz;
+    /// Scale in (0, 1] of the rendered images.
+    double image_scale;
+    /// Added to the niceness of the worker thread, 0 keeps the priority of the caller. Only
+    /// supported on Linux, where the niceness is per thread.
+    int nice_increment;
+  };
+
+  /// Renders the keypoints of all frames, see visualizeKeypoints.
+  static RenderFunction getKeypointRenderFunction();
+
+  VisualizationWorker(const RenderFunction& render_function,
+                      const ImageCallback& image_callback, const Options& options);
+  /// Renders the pending snapshot, if any, and stops the worker.
+  ~VisualizationWorker();
+
+  /// Returns false if the nframe was dropped by the rate limit.
+  bool submit(const aslam::VisualNFrame& nframe);
+
+  /// Wait until the pending snapshot is rendered.
+  void waitUntilIdle();
+
+  size_t getNumRendered() const { return num_rendered_; }
+  size_t getNumDropped() const { return num_dropped_; }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  void work();
+
+  const RenderFunction render_function_;
+  const ImageCallback image_callback_;
+  const Options options_;
+  const Clock::duration min_frame_period_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_work_;
+  std::condition_variable cv_idle_;
+  // Guarded by mutex_.
+  aslam::VisualNFrame::Ptr pending_nframe_;
+  bool is_rendering_;
+  bool shutdown_;
+  Clock::time_point last_accepted_time_;
+
+  std::atomic<size_t> num_rendered_;
+  std::atomic<size_t> num_dropped_;
+
+  std::thread thread_;
+};
+
+}  // namespace aslam_cv_visualization
+
+#endif  // ASLAM_VISUALIZATION_VISUALIZATION_WORKER_H_
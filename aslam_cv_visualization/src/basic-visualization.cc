@@ -1,6 +1,8 @@
 #include <algorithm>
+#include <cmath>
 
 #include <aslam/matcher/match-helpers.h>
+#include <opencv2/imgproc/imgproc.hpp>
 
 #include "aslam/frames/feature-track.h"
 #include "aslam/frames/keypoint-identifier.h"
@@ -8,8 +10,18 @@
 
 namespace aslam_cv_visualization {
 
+size_t getScaledImageSize(size_t size, double image_scale) {
+  return std::max<size_t>(1u, static_cast<size_t>(std::lround(size * image_scale)));
+}
+
 void drawKeypoints(const aslam::VisualFrame& frame, cv::Mat* image) {
+  constexpr double kFullResolution = 1.0;
+  drawKeypoints(frame, kFullResolution, image);
+}
+
+void drawKeypoints(const aslam::VisualFrame& frame, double image_scale, cv::Mat* image) {
   CHECK_NOTNULL(image);
+  CHECK_GT(image_scale, 0.0);
   if (!frame.hasKeypointMeasurements()) {
     return;
   }
@@ -21,12 +33,17 @@ void drawKeypoints(const aslam::VisualFrame& frame, cv::Mat* image) {
     } else {
       keypoint = frame.getKeypointMeasurement(keypoint_idx);
     }
+    if (image_scale != 1.0) {
+      // Pixel centers are at integer coordinates.
+      keypoint = (keypoint.array() + 0.5) * image_scale - 0.5;
+    }
     cv::circle(*image, cv::Point(keypoint[0], keypoint[1]), 1,
                cv::Scalar(0, 255, 255), 1, CV_AA);
   }
 }
 
-void visualizeKeypoints(const aslam::VisualNFrame::ConstPtr& nframe, cv::Mat* image_ptr) {
+void visualizeKeypoints(const aslam::VisualNFrame::ConstPtr& nframe, double image_scale,
+                        cv::Mat* image_ptr) {
   CHECK(nframe);
   CHECK_NOTNULL(image_ptr);
 
@@ -34,25 +51,28 @@ void visualizeKeypoints(const aslam::VisualNFrame::ConstPtr& nframe, cv::Mat* im
   CHECK_EQ(nframe->getNumCameras(), num_frames);
 
   Offsets offsets;
-  assembleMultiImage(nframe, image_ptr, &offsets);
+  assembleMultiImage(nframe, image_scale, image_ptr, &offsets);
   CHECK_EQ(offsets.size(), num_frames);
-  VLOG(4) << "Assembled full image.";
 
   cv::Mat& image = *image_ptr;
-
   for (size_t frame_idx = 0; frame_idx < num_frames; ++frame_idx) {
-    const size_t image_width =
-        nframe->getFrame(frame_idx).getCameraGeometry()->imageWidth();
-    const size_t image_height =
-        nframe->getFrame(frame_idx).getCameraGeometry()->imageHeight();
+    const size_t image_width = getScaledImageSize(
+        nframe->getFrame(frame_idx).getCameraGeometry()->imageWidth(), image_scale);
+    const size_t image_height = getScaledImageSize(
+        nframe->getFrame(frame_idx).getCameraGeometry()->imageHeight(), image_scale);
     cv::Mat frame_slice_of_multi_image =
         image(cv::Rect(
             offsets[frame_idx].width, offsets[frame_idx].height, image_width, image_height));
     aslam_cv_visualization::drawKeypoints(
-        nframe->getFrame(frame_idx), &frame_slice_of_multi_image);
+        nframe->getFrame(frame_idx), image_scale, &frame_slice_of_multi_image);
   }
 }
 
+void visualizeKeypoints(const aslam::VisualNFrame::ConstPtr& nframe, cv::Mat* image_ptr) {
+  constexpr double kFullResolution = 1.0;
+  visualizeKeypoints(nframe, kFullResolution, image_ptr);
+}
+
 void drawKeypointMatches(const aslam::VisualFrame& frame_kp1,
                          const aslam::VisualFrame& frame_k,
                          const aslam::Matches& matches_kp1_k,
@@ -82,18 +102,19 @@ void drawKeypointMatches(const aslam::VisualFrame& frame_kp1,
 
 void assembleMultiImage(const aslam::VisualNFrame::ConstPtr& nframe,
                         cv::Mat* full_image_ptr, Offsets* offsets_ptr) {
-  CHECK(nframe);
-  const size_t num_frames = nframe->getNumFrames();
-  CHECK_GT(num_frames, 0u);
-  CHECK_NOTNULL(full_image_ptr);
-  CHECK_NOTNULL(offsets_ptr);
-
-  cv::Mat& full_image = *full_image_ptr;
+  constexpr double kFullResolution = 1.0;
+  assembleMultiImage(nframe, kFullResolution, full_image_ptr, offsets_ptr);
+}
 
-  VLOG(5) << "assembleMultiImage: num frames: " << num_frames;
+void computeMultiImageLayout(const std::vector<cv::Size>& image_sizes, Offsets* offsets_ptr,
+                             cv::Size* full_image_size) {
+  CHECK_NOTNULL(offsets_ptr);
+  CHECK_NOTNULL(full_image_size);
+  const size_t num_images = image_sizes.size();
+  CHECK_GT(num_images, 0u);
 
-  size_t num_rows = static_cast<size_t>(std::floor(std::sqrt(static_cast<double>(num_frames))));
-  size_t num_images_per_row = static_cast<size_t>(std::ceil(static_cast<double>(num_frames) /
+  size_t num_rows = static_cast<size_t>(std::floor(std::sqrt(static_cast<double>(num_images))));
+  size_t num_images_per_row = static_cast<size_t>(std::ceil(static_cast<double>(num_images) /
                                                             static_cast<double>(num_rows)));
 
   VLOG(5) << "assembleMultiImage: num rows: " << num_rows;
@@ -102,18 +123,15 @@ void assembleMultiImage(const aslam::VisualNFrame::ConstPtr& nframe,
   CHECK_GT(num_rows, 0u);
   CHECK_GT(num_images_per_row, 0u);
 
-  size_t max_image_height_row = 0u;
-
   Offsets& offsets = *offsets_ptr;
-  offsets.resize(num_frames);
-  std::vector<cv::Mat> individual_images(num_frames);
+  offsets.resize(num_images);
 
+  size_t max_image_height_row = 0u;
   size_t row_index = 0u;
   size_t column_index = 0u;
-
   size_t max_column = 0;
-  for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
-    if ((frame_idx > 0u) && ((frame_idx % num_images_per_row) == 0u)) {
+  for (size_t image_idx = 0u; image_idx < num_images; ++image_idx) {
+    if ((image_idx > 0u) && ((image_idx % num_images_per_row) == 0u)) {
       // Time to switch rows.
       row_index += max_image_height_row;
 
@@ -124,46 +142,83 @@ void assembleMultiImage(const aslam::VisualNFrame::ConstPtr& nframe,
       column_index = 0u;
     }
 
-    cv::cvtColor(nframe->getFrame(frame_idx).getRawImage(), individual_images[frame_idx],
-                 CV_GRAY2BGR);
-
-    CHECK(nframe->getFrame(frame_idx).getCameraGeometry());
-    const size_t image_width =
-        nframe->getFrame(frame_idx).getCameraGeometry()->imageWidth();
-    const size_t image_height =
-        nframe->getFrame(frame_idx).getCameraGeometry()->imageHeight();
-
-    CHECK_EQ(individual_images[frame_idx].rows, static_cast<int>(image_height));
-    CHECK_EQ(individual_images[frame_idx].cols, static_cast<int>(image_width));
-
-    VLOG(4) << "Adding image of dimension " << image_width << " x " << image_height;
-
+    CHECK_GT(image_sizes[image_idx].width, 0);
+    CHECK_GT(image_sizes[image_idx].height, 0);
+    const size_t image_width = static_cast<size_t>(image_sizes[image_idx].width);
+    const size_t image_height = static_cast<size_t>(image_sizes[image_idx].height);
     if (image_height > max_image_height_row) {
       max_image_height_row = image_height;
     }
 
-    offsets[frame_idx].height = row_index;
-    offsets[frame_idx].width = column_index;
+    offsets[image_idx].height = row_index;
+    offsets[image_idx].width = column_index;
 
     column_index += image_width;
   }
 
   row_index += max_image_height_row;
+  // The last row can be the widest.
+  if (column_index > max_column) {
+    max_column = column_index;
+  }
+  *full_image_size = cv::Size(max_column, row_index);
+}
 
-  full_image = cv::Mat(row_index, max_column, CV_8UC3);
-  VLOG(3) << "Reshaped full image to the following dimensions: " << max_column << " x "
-          << row_index;
+void assembleMultiImage(const aslam::VisualNFrame::ConstPtr& nframe, double image_scale,
+                        cv::Mat* full_image_ptr, Offsets* offsets_ptr) {
+  CHECK(nframe);
+  const size_t num_frames = nframe->getNumFrames();
+  CHECK_GT(num_frames, 0u);
+  CHECK_GT(image_scale, 0.0);
+  CHECK_LE(image_scale, 1.0);
+  CHECK_NOTNULL(full_image_ptr);
+  CHECK_NOTNULL(offsets_ptr);
+
+  cv::Mat& full_image = *full_image_ptr;
+
+  VLOG(5) << "assembleMultiImage: num frames: " << num_frames;
 
+  std::vector<cv::Mat> individual_images(num_frames);
+  std::vector<cv::Size> image_sizes(num_frames);
   for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
-    const size_t image_width =
-        nframe->getFrame(frame_idx).getCameraGeometry()->imageWidth();
-    const size_t image_height =
-        nframe->getFrame(frame_idx).getCameraGeometry()->imageHeight();
+    CHECK(nframe->getFrame(frame_idx).getCameraGeometry());
+    const size_t image_width = getScaledImageSize(
+        nframe->getFrame(frame_idx).getCameraGeometry()->imageWidth(), image_scale);
+    const size_t image_height = getScaledImageSize(
+        nframe->getFrame(frame_idx).getCameraGeometry()->imageHeight(), image_scale);
+    image_sizes[frame_idx] = cv::Size(image_width, image_height);
+
+    // Downscale the gray image first, such that the color conversion runs on fewer pixels.
+    const cv::Mat& raw_image = nframe->getFrame(frame_idx).getRawImage();
+    if (image_scale < 1.0) {
+      cv::Mat scaled_raw_image;
+      cv::resize(raw_image, scaled_raw_image, cv::Size(image_width, image_height), 0.0, 0.0,
+                 cv::INTER_AREA);
+      cv::cvtColor(scaled_raw_image, individual_images[frame_idx], CV_GRAY2BGR);
+    } else {
+      cv::cvtColor(raw_image, individual_images[frame_idx], CV_GRAY2BGR);
+    }
 
+    CHECK_EQ(individual_images[frame_idx].rows, static_cast<int>(image_height));
+    CHECK_EQ(individual_images[frame_idx].cols, static_cast<int>(image_width));
+
+    VLOG(4) << "Adding image of dimension " << image_width << " x " << image_height;
+  }
+
+  cv::Size full_image_size;
+  computeMultiImageLayout(image_sizes, offsets_ptr, &full_image_size);
+  const Offsets& offsets = *offsets_ptr;
+
+  full_image = cv::Mat(full_image_size, CV_8UC3, kBlack);
+  VLOG(3) << "Reshaped full image to the following dimensions: " << full_image_size.width
+          << " x " << full_image_size.height;
+
+  for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
     VLOG(5) << "Accessing slice of full image starting at (" << offsets[frame_idx].width << " , "
             << offsets[frame_idx].height << ").";
     cv::Mat slice = full_image(cv::Rect(offsets[frame_idx].width, offsets[frame_idx].height,
-                                        image_width, image_height));
+                                        individual_images[frame_idx].cols,
+                                        individual_images[frame_idx].rows));
     individual_images[frame_idx].copyTo(slice);
   }
 }
@@ -196,18 +251,20 @@ void drawFeatureTrackPatches(const aslam::FeatureTrack& track, size_t keypoint_n
         cv::Point((subimage_col + 1) * subimage_edge_length_px,
                   (subimage_row + 1) * subimage_edge_length_px));
 
-    // Extract the image patch around the keypoint and write it to the full image.
+    // Extract the image patch around the keypoint and write it to the full image. Only the patch
+    // is decoded if the raw image is kept compressed.
     const Eigen::Vector2d keypoint = kip.getKeypointMeasurement();
-    const cv::Mat& keypoint_image = kip.getFrame().getRawImage();
-
     cv::Point roi_keypoint_topleft(std::max((keypoint(0) - keypoint_neighborhood_px), 0.0),
                                    std::max((keypoint(1) - keypoint_neighborhood_px), 0.0));
-    cv::Point roi_keypoint_bottomright(
-        std::min((keypoint(0) + keypoint_neighborhood_px),
-                 static_cast<double>(keypoint_image.cols)),
-        std::min((keypoint(1) + keypoint_neighborhood_px),
-                 static_cast<double>(keypoint_image.rows)));
-    cv::Rect roi_keypoint(roi_keypoint_topleft, roi_keypoint_bottomright);
+    cv::Point roi_keypoint_bottomright(keypoint(0) + keypoint_neighborhood_px,
+                                       keypoint(1) + keypoint_neighborhood_px);
+    cv::Mat keypoint_patch;
+    const cv::Rect roi_keypoint = kip.getFrame().getRawImagePatch(
+        cv::Rect(roi_keypoint_topleft, roi_keypoint_bottomright), &keypoint_patch);
+    if (roi_keypoint.area() == 0) {
+      ++keypoint_index;
+      continue;
+    }
 
     // Adjust the size in case of border truncation.
     roi_subimage.height = roi_keypoint.height;
@@ -217,7 +274,7 @@ void drawFeatureTrackPatches(const aslam::FeatureTrack& track, size_t keypoint_n
 
     // Draw the keypoint.
     cv::Mat keypoint_neighbourhood_image;
-    cv::cvtColor(keypoint_image(roi_keypoint), keypoint_neighbourhood_image, CV_GRAY2BGR);
+    cv::cvtColor(keypoint_patch, keypoint_neighbourhood_image, CV_GRAY2BGR);
     cv::Point keypoint_coords_subimage(keypoint[0] - roi_keypoint.x, keypoint[1] - roi_keypoint.y);
     cv::circle(keypoint_neighbourhood_image, keypoint_coords_subimage, 1,
                cv::Scalar(0, 255, 255), 1, CV_AA);
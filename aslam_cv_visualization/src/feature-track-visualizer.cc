@@ -1,6 +1,10 @@
 #include "aslam/visualization/feature-track-visualizer.h"
 
+#include <utility>
+#include <vector>
+
 #include <glog/logging.h>
+#include <opencv2/imgproc/imgproc.hpp>
 
 #include "aslam/visualization/basic-visualization.h"
 
@@ -8,119 +12,158 @@ namespace aslam_cv_visualization {
 
 const size_t kLineWidth = 1u;
 const size_t kCircleRadius = 1u;
+// Power of two, such that the slot of a track id is a bit mask.
+const size_t kInitialNumTrackSlots = 4096u;
+const size_t kNumPaletteColors = 64u;
+
+VisualFrameFeatureTrackVisualizer::VisualFrameFeatureTrackVisualizer()
+    : track_slots_(kInitialNumTrackSlots),
+      frame_index_(0u),
+      polyline_points_(kNumPaletteColors),
+      polyline_num_points_(kNumPaletteColors),
+      rng_(cv::RNG(0xFFFFFFFF)) {
+  palette_.reserve(kNumPaletteColors);
+  for (size_t color_idx = 0u; color_idx < kNumPaletteColors; ++color_idx) {
+    palette_.emplace_back(rng_.uniform(0, 255), rng_.uniform(0, 255), rng_.uniform(0, 255));
+  }
+}
 
 void VisualFrameFeatureTrackVisualizer::drawContinuousFeatureTracks(
     const aslam::VisualFrame::ConstPtr& frame,
     const aslam::FeatureTracks& terminated_feature_tracks,
     cv::Mat* image) {
+  CHECK(frame);
   CHECK_NOTNULL(image);
+  ++frame_index_;
 
+  // The tracker assigns the id of a new track to the keypoint of the previous frame only when
+  // matching the current frame, hence the first keypoint of a new track is read from the track
+  // ids of the last frame as they are now.
   if (last_frame_) {
-    VLOG(4) << "Last frame has ID " << last_frame_->getId();
-
-    // Preprocess the last frame. It has changed in the meantime.
-    TrackIdToIndexMap last_frame_track_id_to_index_map;
-    preprocessLastFrame(&last_frame_track_id_to_index_map);
-
-    VLOG(4) << "Pre-processed " << last_frame_track_id_to_index_map.size()
-            << " valid keypoints in last frame.";
-
-    const Eigen::VectorXi& track_ids = frame->getTrackIds();
-
-    const size_t num_track_ids = static_cast<size_t>(track_ids.rows());
-    CHECK_EQ(num_track_ids, frame->getNumKeypointMeasurements());
-    for (size_t idx = 0; idx < num_track_ids; ++idx) {
-      const int track_id = track_ids(idx);
-      if (track_id >= 0) {
-        // Active track. Look if this is ongoing.
-        TrackMap::iterator active_track_it =
-            track_id_to_track_map_.find(track_id);
-        if (active_track_it == track_id_to_track_map_.end()) {
-          // This is a new track. Get the first two keypoints using the last frame.
-          TrackIdToIndexMap::iterator last_frame_it =
-              last_frame_track_id_to_index_map.find(track_id);
-          CHECK(last_frame_it != last_frame_track_id_to_index_map.end())
-              << "Could not find track with ID "
-              << track_id << " in the last frame, although this is a new track. "
-              << "Current keypoint index: " << idx;
-          CHECK_LT(last_frame_it->second,
-                   last_frame_->getNumKeypointMeasurements());
-
-          Track new_track;
-          new_track.color = cv::Scalar(rng_.uniform(0, 255),
-                                       rng_.uniform(0, 255),
-                                       rng_.uniform(0, 255));
-          const Eigen::Vector2d measurement =
-              last_frame_->getKeypointMeasurement(last_frame_it->second);
-          new_track.keypoints.push_back(measurement);
-          track_id_to_track_map_.insert(std::make_pair(track_id, new_track));
-          active_track_it = track_id_to_track_map_.find(track_id);
-        }
-        CHECK(active_track_it != track_id_to_track_map_.end());
-
-        const Eigen::Vector2d measurement = frame->getKeypointMeasurement(idx);
-        active_track_it->second.keypoints.push_back(measurement);
+    const Eigen::VectorXi& last_track_ids = last_frame_->getTrackIds();
+    const size_t num_last_track_ids = static_cast<size_t>(last_track_ids.rows());
+    CHECK_EQ(num_last_track_ids, last_frame_->getNumKeypointMeasurements());
+    for (size_t idx = 0; idx < num_last_track_ids; ++idx) {
+      const int track_id = last_track_ids(idx);
+      if (track_id < 0) {
+        continue;
+      }
+      const TrackSlot& slot = getSlot(track_id);
+      if (slot.track_id == track_id && isLive(slot)) {
+        continue;
       }
+      TrackSlot& new_slot = insertTrack(track_id);
+      const Eigen::Vector2d measurement = last_frame_->getKeypointMeasurement(idx);
+      new_slot.keypoints.emplace_back(measurement(0), measurement(1));
+      new_slot.frame_index = frame_index_ - 1u;
+    }
+  }
+
+  const Eigen::VectorXi& track_ids = frame->getTrackIds();
+  const size_t num_track_ids = static_cast<size_t>(track_ids.rows());
+  CHECK_EQ(num_track_ids, frame->getNumKeypointMeasurements());
+  for (size_t idx = 0; idx < num_track_ids; ++idx) {
+    const int track_id = track_ids(idx);
+    if (track_id >= 0) {
+      TrackSlot& slot = insertTrack(track_id);
+      const Eigen::Vector2d measurement = frame->getKeypointMeasurement(idx);
+      slot.keypoints.emplace_back(measurement(0), measurement(1));
+      slot.frame_index = frame_index_;
     }
+  }
 
-    std::unordered_set<int> terminated_track_ids;
-    for (const aslam::FeatureTrack& track : terminated_feature_tracks) {
-      int track_id = static_cast<int>(track.getTrackId());
-      terminated_track_ids.insert(track_id);
+  // The terminated tracks are drawn once in red and then released.
+  terminated_polyline_points_.clear();
+  terminated_polyline_num_points_.clear();
+  std::vector<TrackSlot*> terminated_slots;
+  terminated_slots.reserve(terminated_feature_tracks.size());
+  for (const aslam::FeatureTrack& track : terminated_feature_tracks) {
+    const int track_id = static_cast<int>(track.getTrackId());
+    TrackSlot& slot = getSlot(track_id);
+    if (slot.track_id != track_id || !isLive(slot)) {
+      VLOG(4) << "Terminated track " << track_id << " is not visualized.";
+      continue;
     }
+    terminated_polyline_points_.push_back(slot.keypoints.data());
+    terminated_polyline_num_points_.push_back(static_cast<int>(slot.keypoints.size()));
+    terminated_slots.push_back(&slot);
+  }
+  if (!terminated_polyline_points_.empty()) {
+    cv::polylines(*image, terminated_polyline_points_.data(),
+                  terminated_polyline_num_points_.data(),
+                  static_cast<int>(terminated_polyline_points_.size()), false,
+                  cv::Scalar(0, 0, 255), kLineWidth, CV_AA);
+  }
+  for (TrackSlot* slot : terminated_slots) {
+    slot->track_id = -1;
+    slot->keypoints.clear();
+  }
 
-    for (TrackMap::const_iterator track_it = track_id_to_track_map_.begin();
-        track_it != track_id_to_track_map_.end(); ++track_it) {
-      CHECK_GT(track_it->second.keypoints.size(), 0u);
-      bool terminated = (terminated_track_ids.count(track_it->first) > 0u);
-      Aligned<std::vector, Eigen::Vector2d>::const_iterator
-        measurement_it = track_it->second.keypoints.begin();
-      cv::Point point_start_line((*measurement_it)(0), (*measurement_it)(1));
-      ++measurement_it;
-      for (; measurement_it != track_it->second.keypoints.end();
-          ++measurement_it) {
-        cv::Point point_end_line((*measurement_it)(0), (*measurement_it)(1));
-        if (terminated) {
-          cv::line(*image, point_start_line, point_end_line, cv::Scalar(0, 0, 255), kLineWidth,
-                   CV_AA);
-        } else {
-          cv::line(*image, point_start_line, point_end_line, track_it->second.color, kLineWidth,
-                   CV_AA);
-        }
-        point_start_line = point_end_line;
-      }
-      if (!terminated) {
-        cv::circle(*image, point_start_line, kCircleRadius, cv::Scalar(0.0, 255.0, 255.0, 20),
-                   kLineWidth, CV_AA);
-      }
+  drawTracks(image);
+  last_frame_ = frame;
+}
+
+void VisualFrameFeatureTrackVisualizer::drawTracks(cv::Mat* image) {
+  CHECK_NOTNULL(image);
+  for (size_t color_idx = 0u; color_idx < kNumPaletteColors; ++color_idx) {
+    polyline_points_[color_idx].clear();
+    polyline_num_points_[color_idx].clear();
+  }
+  // Only tracks that are observed in the current frame are drawn.
+  for (const TrackSlot& slot : track_slots_) {
+    if (slot.track_id >= 0 && slot.frame_index == frame_index_ && slot.keypoints.size() > 1u) {
+      polyline_points_[slot.color_index].push_back(slot.keypoints.data());
+      polyline_num_points_[slot.color_index].push_back(static_cast<int>(slot.keypoints.size()));
+    }
+  }
+  for (size_t color_idx = 0u; color_idx < kNumPaletteColors; ++color_idx) {
+    if (!polyline_points_[color_idx].empty()) {
+      cv::polylines(*image, polyline_points_[color_idx].data(),
+                    polyline_num_points_[color_idx].data(),
+                    static_cast<int>(polyline_points_[color_idx].size()), false,
+                    palette_[color_idx], kLineWidth, CV_AA);
     }
+  }
+  for (const TrackSlot& slot : track_slots_) {
+    if (slot.track_id >= 0 && slot.frame_index == frame_index_ && slot.keypoints.size() > 1u) {
+      cv::circle(*image, slot.keypoints.back(), kCircleRadius, cv::Scalar(0.0, 255.0, 255.0, 20),
+                 kLineWidth, CV_AA);
+    }
+  }
+}
 
-    for (const aslam::FeatureTrack& track : terminated_feature_tracks) {
-      int track_id = static_cast<int>(track.getTrackId());
-      TrackMap::iterator it = track_id_to_track_map_.find(track_id);
-      CHECK(it != track_id_to_track_map_.end());
-      track_id_to_track_map_.erase(track_id);
+VisualFrameFeatureTrackVisualizer::TrackSlot& VisualFrameFeatureTrackVisualizer::insertTrack(
+    int track_id) {
+  CHECK_GE(track_id, 0);
+  while (true) {
+    TrackSlot& slot = getSlot(track_id);
+    if (slot.track_id == track_id && isLive(slot)) {
+      return slot;
     }
+    if (!isLive(slot)) {
+      // Start a new track, or restart a track that was not observed in the last frame.
+      slot.track_id = track_id;
+      slot.color_index = static_cast<size_t>(rng_.uniform(0, static_cast<int>(kNumPaletteColors)));
+      slot.keypoints.clear();
+      return slot;
+    }
+    growSlots();
   }
-  last_frame_ = frame;
 }
 
-void VisualFrameFeatureTrackVisualizer::preprocessLastFrame(
-    TrackIdToIndexMap* last_frame_track_id_to_index_map) {
-  CHECK_NOTNULL(last_frame_track_id_to_index_map);
-  CHECK(last_frame_) << "No last frame available.";
-
-  const Eigen::VectorXi& last_frame_track_ids = last_frame_->getTrackIds();
-  const size_t last_frame_num_track_ids =
-      static_cast<size_t>(last_frame_track_ids.rows());
-  CHECK_EQ(last_frame_num_track_ids,
-           last_frame_->getNumKeypointMeasurements());
-  for (size_t idx = 0; idx < last_frame_num_track_ids; ++idx) {
-    int track_id = last_frame_track_ids(idx);
-    if (track_id >= 0) {
-      last_frame_track_id_to_index_map->insert(std::make_pair(track_id, idx));
+void VisualFrameFeatureTrackVisualizer::growSlots() {
+  // Ids that differ modulo the old capacity also differ modulo the doubled one, hence the live
+  // tracks cannot collide after the move.
+  std::vector<TrackSlot> track_slots(2u * track_slots_.size());
+  track_slots.swap(track_slots_);
+  for (TrackSlot& slot : track_slots) {
+    if (isLive(slot)) {
+      TrackSlot& new_slot = getSlot(slot.track_id);
+      CHECK_LT(new_slot.track_id, 0);
+      new_slot = std::move(slot);
     }
   }
+  VLOG(4) << "Grew the track slots to " << track_slots_.size() << ".";
 }
 
 VisualNFrameFeatureTrackVisualizer::VisualNFrameFeatureTrackVisualizer(const size_t num_frames) {
@@ -0,0 +1,117 @@
+#include "aslam/visualization/multi-image-mosaic.h"
+
+#include <algorithm>
+#include <future>
+#include <thread>
+
+#include <glog/logging.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace aslam_cv_visualization {
+
+MultiImageMosaic::MultiImageMosaic(double image_scale, size_t num_threads)
+    : image_scale_(image_scale) {
+  CHECK_GT(image_scale_, 0.0);
+  CHECK_LE(image_scale_, 1.0);
+  if (num_threads == 0u) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (num_threads > 1u) {
+    thread_pool_.reset(new aslam::ThreadPool(num_threads));
+  }
+}
+
+void MultiImageMosaic::updateLayout(const std::shared_ptr<const aslam::NCamera>& ncamera) {
+  CHECK(ncamera);
+  const size_t num_cameras = ncamera->getNumCameras();
+  std::vector<cv::Size> tile_sizes(num_cameras);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    const aslam::Camera& camera = ncamera->getCamera(camera_idx);
+    tile_sizes[camera_idx] = cv::Size(getScaledImageSize(camera.imageWidth(), image_scale_),
+                                      getScaledImageSize(camera.imageHeight(), image_scale_));
+  }
+
+  cv::Size mosaic_size;
+  computeMultiImageLayout(tile_sizes, &offsets_, &mosaic_size);
+  // The areas not covered by a tile stay black.
+  mosaic_ = cv::Mat(mosaic_size, CV_8UC3, kBlack);
+  tiles_.resize(num_cameras);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    tiles_[camera_idx] = mosaic_(cv::Rect(offsets_[camera_idx].width, offsets_[camera_idx].height,
+                                          tile_sizes[camera_idx].width,
+                                          tile_sizes[camera_idx].height));
+  }
+  scaled_raw_images_.resize(num_cameras);
+  ncamera_ = ncamera;
+  VLOG(3) << "Laid out a mosaic of " << mosaic_size.width << " x " << mosaic_size.height
+          << " for " << num_cameras << " cameras.";
+}
+
+void MultiImageMosaic::render(
+    const aslam::VisualNFrame::ConstPtr& nframe, const DrawFunction& draw_function) {
+  CHECK(nframe);
+  const std::shared_ptr<const aslam::NCamera> ncamera = nframe->getNCameraShared();
+  CHECK(ncamera);
+  const size_t num_frames = nframe->getNumFrames();
+  CHECK_EQ(ncamera->getNumCameras(), num_frames);
+  CHECK_GT(num_frames, 0u);
+  if (ncamera != ncamera_) {
+    updateLayout(ncamera);
+  }
+
+  if (!thread_pool_ || num_frames == 1u) {
+    for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+      renderTile(frame_idx, nframe->getFrame(frame_idx), draw_function);
+    }
+    return;
+  }
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_frames);
+  for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+    futures.emplace_back(thread_pool_->enqueue([this, &nframe, &draw_function, frame_idx]() {
+      renderTile(frame_idx, nframe->getFrame(frame_idx), draw_function);
+    }));
+  }
+  for (std::future<void>& future : futures) {
+    CHECK(future.valid());
+    future.get();
+  }
+}
+
+void MultiImageMosaic::renderKeypoints(const aslam::VisualNFrame::ConstPtr& nframe) {
+  const double image_scale = image_scale_;
+  render(nframe, [image_scale](size_t /*frame_idx*/, const aslam::VisualFrame& frame,
+                               cv::Mat* tile) {
+    drawKeypoints(frame, image_scale, tile);
+  });
+}
+
+void MultiImageMosaic::renderTile(
+    size_t frame_idx, const aslam::VisualFrame& frame, const DrawFunction& draw_function) {
+  CHECK_LT(frame_idx, tiles_.size());
+  cv::Mat& tile = tiles_[frame_idx];
+  if (!frame.hasRawImage()) {
+    tile.setTo(kBlack);
+  } else {
+    const cv::Mat& raw_image = frame.getRawImage();
+    CHECK_EQ(raw_image.type(), CV_8UC1);
+    const uchar* tile_data = tile.data;
+    // The tile has the size and type of the output, hence the conversions write into the mosaic
+    // instead of allocating a new image.
+    if (image_scale_ < 1.0) {
+      cv::Mat& scaled_raw_image = scaled_raw_images_[frame_idx];
+      cv::resize(raw_image, scaled_raw_image, tile.size(), 0.0, 0.0, cv::INTER_AREA);
+      cv::cvtColor(scaled_raw_image, tile, CV_GRAY2BGR);
+    } else {
+      CHECK(raw_image.size() == tile.size())
+          << "The raw image of frame " << frame_idx << " does not match its camera.";
+      cv::cvtColor(raw_image, tile, CV_GRAY2BGR);
+    }
+    CHECK(tile.data == tile_data) << "The tile was reallocated.";
+  }
+  if (draw_function) {
+    draw_function(frame_idx, frame, &tile);
+  }
+}
+
+}  // namespace aslam_cv_visualization
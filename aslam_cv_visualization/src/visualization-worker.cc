@@ -0,0 +1,137 @@
+#include "aslam/visualization/visualization-worker.h"
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "aslam/visualization/basic-visualization.h"
+
+namespace aslam_cv_visualization {
+namespace {
+void lowerThreadPriority(int nice_increment) {
+  if (nice_increment <= 0) {
+    return;
+  }
+#ifdef __linux__
+  // On Linux the niceness is a property of the thread, not of the process.
+  const id_t thread_id = static_cast<id_t>(syscall(SYS_gettid));
+  errno = 0;
+  const int niceness = getpriority(PRIO_PROCESS, thread_id);
+  if (errno == 0 && setpriority(PRIO_PROCESS, thread_id, niceness + nice_increment) == 0) {
+    return;
+  }
+  LOG(WARNING) << "Could not lower the priority of the visualization thread: "
+               << std::strerror(errno);
+#else
+  LOG(WARNING) << "Lowering the priority of the visualization thread is not supported.";
+#endif
+}
+}  // namespace
+
+VisualizationWorker::RenderFunction VisualizationWorker::getKeypointRenderFunction() {
+  return [](const aslam::VisualNFrame::ConstPtr& nframe, double image_scale, cv::Mat* image) {
+    visualizeKeypoints(nframe, image_scale, image);
+  };
+}
+
+VisualizationWorker::VisualizationWorker(
+    const RenderFunction& render_function, const ImageCallback& image_callback,
+    const Options& options)
+    : render_function_(render_function),
+      image_callback_(image_callback),
+      options_(options),
+      min_frame_period_(options.max_frame_rate_hz > 0.0 ?
+          std::chrono::duration_cast<Clock::duration>(
+              std::chrono::duration<double>(1.0 / options.max_frame_rate_hz)) :
+          Clock::duration::zero()),
+      is_rendering_(false),
+      shutdown_(false),
+      last_accepted_time_(Clock::time_point::min()),
+      num_rendered_(0u),
+      num_dropped_(0u) {
+  CHECK(render_function_);
+  CHECK(image_callback_);
+  CHECK_GE(options_.max_frame_rate_hz, 0.0);
+  CHECK_GT(options_.image_scale, 0.0);
+  CHECK_LE(options_.image_scale, 1.0);
+  thread_ = std::thread(&VisualizationWorker::work, this);
+}
+
+VisualizationWorker::~VisualizationWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  cv_work_.notify_all();
+  thread_.join();
+}
+
+bool VisualizationWorker::submit(const aslam::VisualNFrame& nframe) {
+  const Clock::time_point now = Clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK(!shutdown_);
+    if (last_accepted_time_ != Clock::time_point::min() &&
+        now - last_accepted_time_ < min_frame_period_) {
+      ++num_dropped_;
+      return false;
+    }
+    last_accepted_time_ = now;
+  }
+
+  // The copy shares the channels and images with the caller's frames.
+  aslam::VisualNFrame::Ptr snapshot(new aslam::VisualNFrame(nframe));
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_nframe_) {
+      // The worker is behind, only the latest snapshot is rendered.
+      ++num_dropped_;
+    }
+    pending_nframe_ = std::move(snapshot);
+  }
+  cv_work_.notify_one();
+  return true;
+}
+
+void VisualizationWorker::waitUntilIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_idle_.wait(lock, [this]() { return !pending_nframe_ && !is_rendering_; });
+}
+
+void VisualizationWorker::work() {
+  lowerThreadPriority(options_.nice_increment);
+  cv::Mat image;
+  while (true) {
+    aslam::VisualNFrame::Ptr nframe;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_work_.wait(lock, [this]() { return pending_nframe_ || shutdown_; });
+      if (!pending_nframe_) {
+        return;
+      }
+      nframe = std::move(pending_nframe_);
+      pending_nframe_.reset();
+      is_rendering_ = true;
+    }
+
+    render_function_(nframe, options_.image_scale, &image);
+    image_callback_(*nframe, image);
+    ++num_rendered_;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      is_rendering_ = false;
+    }
+    cv_idle_.notify_all();
+  }
+}
+
+}  // namespace aslam_cv_visualization
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/feature-track.h>
+#include <aslam/frames/visual-frame.h>
+
+#include "aslam/visualization/feature-track-visualizer.h"
+
+namespace aslam_cv_visualization {
+
+aslam::VisualFrame::Ptr createFrame(const Eigen::Vector2d& keypoint, int track_id) {
+  aslam::VisualFrame::Ptr frame(new aslam::VisualFrame);
+  frame->setKeypointMeasurements(keypoint);
+  frame->setTrackIds(Eigen::VectorXi::Constant(1, track_id));
+  return frame;
+}
+
+TEST(FeatureTrackVisualizer, DrawsTwoFrameTracks) {
+  VisualFrameFeatureTrackVisualizer visualizer;
+  const aslam::FeatureTracks kNoTerminatedTracks;
+  cv::Mat image = cv::Mat::zeros(100, 100, CV_8UC3);
+
+  aslam::VisualFrame::Ptr first_frame = createFrame(Eigen::Vector2d(20.0, 50.0), -1);
+  visualizer.drawContinuousFeatureTracks(first_frame, kNoTerminatedTracks, &image);
+  EXPECT_EQ(0, cv::countNonZero(image.reshape(1)));
+
+  // Matching the second frame assigns the new track id to the keypoint of the first frame.
+  aslam::VisualFrame::Ptr second_frame = createFrame(Eigen::Vector2d(80.0, 50.0), 5);
+  first_frame->getTrackIdsMutable()->setConstant(5);
+  visualizer.drawContinuousFeatureTracks(second_frame, kNoTerminatedTracks, &image);
+
+  // The line runs from the keypoint of the first frame to the one of the second frame.
+  EXPECT_NE(cv::Vec3b(0u, 0u, 0u), image.at<cv::Vec3b>(50, 30));
+  EXPECT_NE(cv::Vec3b(0u, 0u, 0u), image.at<cv::Vec3b>(50, 70));
+  EXPECT_EQ(cv::Vec3b(0u, 0u, 0u), image.at<cv::Vec3b>(20, 50));
+
+  // The terminated track is drawn once more in red and then forgotten.
+  aslam::FeatureTracks terminated_tracks;
+  terminated_tracks.emplace_back(5u);
+  image.setTo(cv::Scalar::all(0));
+  visualizer.drawContinuousFeatureTracks(createFrame(Eigen::Vector2d(50.0, 20.0), -1),
+                                         terminated_tracks, &image);
+  EXPECT_EQ(0u, image.at<cv::Vec3b>(50, 50)[0]);
+  EXPECT_GT(image.at<cv::Vec3b>(50, 50)[2], 0u);
+  image.setTo(cv::Scalar::all(0));
+  visualizer.drawContinuousFeatureTracks(createFrame(Eigen::Vector2d(50.0, 80.0), -1),
+                                         kNoTerminatedTracks, &image);
+  EXPECT_EQ(0, cv::countNonZero(image.reshape(1)));
+}
+
+}  // namespace aslam_cv_visualization
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,112 @@
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+
+#include "aslam/visualization/basic-visualization.h"
+#include "aslam/visualization/multi-image-mosaic.h"
+
+namespace aslam_cv_visualization {
+namespace {
+/// An nframe with a different gradient image and keypoint in each frame.
+aslam::VisualNFrame::Ptr createNFrame(const aslam::NCamera::Ptr& ncamera) {
+  aslam::VisualNFrame::Ptr nframe = aslam::VisualNFrame::createEmptyTestVisualNFrame(ncamera, 0);
+  for (size_t frame_idx = 0u; frame_idx < nframe->getNumFrames(); ++frame_idx) {
+    aslam::VisualFrame::Ptr frame = nframe->getFrameShared(frame_idx);
+    cv::Mat raw_image(frame->getCameraGeometry()->imageHeight(),
+                      frame->getCameraGeometry()->imageWidth(), CV_8UC1);
+    for (int row = 0; row < raw_image.rows; ++row) {
+      for (int col = 0; col < raw_image.cols; ++col) {
+        raw_image.at<uchar>(row, col) =
+            static_cast<uchar>((row + 3 * col + 50 * static_cast<int>(frame_idx)) % 256);
+      }
+    }
+    frame->setRawImage(raw_image);
+    frame->setKeypointMeasurements(Eigen::Vector2d(100.0 + 20.0 * frame_idx, 100.0));
+  }
+  return nframe;
+}
+
+bool areImagesEqual(const cv::Mat& expected_image, const cv::Mat& image) {
+  return expected_image.size() == image.size() && expected_image.type() == image.type() &&
+      cv::countNonZero((expected_image != image).reshape(1)) == 0;
+}
+}  // namespace
+
+TEST(MultiImageMosaicTest, EqualsTheAssembledMultiImage) {
+  const aslam::VisualNFrame::Ptr nframe = createNFrame(aslam::NCamera::createTestNCamera(3u));
+  for (const double image_scale : {1.0, 0.5, 0.3}) {
+    for (const size_t num_threads : {1u, 3u}) {
+      MultiImageMosaic mosaic(image_scale, num_threads);
+      mosaic.renderKeypoints(nframe);
+
+      cv::Mat expected_image;
+      visualizeKeypoints(nframe, image_scale, &expected_image);
+      EXPECT_TRUE(areImagesEqual(expected_image, mosaic.getImage()))
+          << "Scale " << image_scale << ", " << num_threads << " threads";
+
+      cv::Mat assembled_image;
+      Offsets offsets;
+      assembleMultiImage(nframe, image_scale, &assembled_image, &offsets);
+      ASSERT_EQ(offsets.size(), mosaic.getOffsets().size());
+      for (size_t frame_idx = 0u; frame_idx < offsets.size(); ++frame_idx) {
+        EXPECT_EQ(offsets[frame_idx].width, mosaic.getOffsets()[frame_idx].width);
+        EXPECT_EQ(offsets[frame_idx].height, mosaic.getOffsets()[frame_idx].height);
+        const aslam::Camera& camera = *nframe->getFrame(frame_idx).getCameraGeometry();
+        EXPECT_EQ(static_cast<int>(getScaledImageSize(camera.imageWidth(), image_scale)),
+                  mosaic.getTile(frame_idx).cols);
+        EXPECT_EQ(static_cast<int>(getScaledImageSize(camera.imageHeight(), image_scale)),
+                  mosaic.getTile(frame_idx).rows);
+      }
+    }
+  }
+}
+
+TEST(MultiImageMosaicTest, LayoutIsOnlyRebuiltForAnotherNCamera) {
+  const aslam::NCamera::Ptr ncamera = aslam::NCamera::createTestNCamera(2u);
+  MultiImageMosaic mosaic(0.5, 2u);
+  mosaic.renderKeypoints(createNFrame(ncamera));
+  const uchar* mosaic_data = mosaic.getImage().data;
+
+  // Another nframe of the same rig is rendered into the same buffer.
+  const aslam::VisualNFrame::Ptr nframe = createNFrame(ncamera);
+  nframe->getFrameShared(1u)->setRawImage(
+      cv::Mat::zeros(nframe->getFrame(1u).getRawImage().size(), CV_8UC1));
+  mosaic.renderKeypoints(nframe);
+  EXPECT_EQ(mosaic_data, mosaic.getImage().data);
+  cv::Mat expected_image;
+  visualizeKeypoints(nframe, 0.5, &expected_image);
+  EXPECT_TRUE(areImagesEqual(expected_image, mosaic.getImage()));
+
+  const aslam::VisualNFrame::Ptr other_nframe =
+      createNFrame(aslam::NCamera::createTestNCamera(4u));
+  mosaic.renderKeypoints(other_nframe);
+  EXPECT_EQ(4u, mosaic.getOffsets().size());
+  visualizeKeypoints(other_nframe, 0.5, &expected_image);
+  EXPECT_TRUE(areImagesEqual(expected_image, mosaic.getImage()));
+}
+
+TEST(MultiImageMosaicTest, FramesWithoutRawImageAreBlack) {
+  const aslam::VisualNFrame::Ptr nframe = createNFrame(aslam::NCamera::createTestNCamera(2u));
+  nframe->getFrameShared(0u)->releaseRawImage();
+  MultiImageMosaic mosaic;
+  std::vector<size_t> drawn_frames;
+  mosaic.render(nframe, [&drawn_frames](size_t frame_idx, const aslam::VisualFrame& /*frame*/,
+                                        cv::Mat* /*tile*/) {
+    drawn_frames.push_back(frame_idx);
+  });
+  EXPECT_EQ(0, cv::countNonZero(mosaic.getTile(0u).reshape(1)));
+  EXPECT_GT(cv::countNonZero(mosaic.getTile(1u).reshape(1)), 0);
+  // The draw function is called for all frames, serially with one thread.
+  EXPECT_EQ(std::vector<size_t>({0u, 1u}), drawn_frames);
+}
+
+}  // namespace aslam_cv_visualization
+
+ASLAM_UNITTEST_ENTRYPOINT
@@ -0,0 +1,208 @@
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/entrypoint.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+
+#include "aslam/visualization/basic-visualization.h"
+#include "aslam/visualization/visualization-worker.h"
+
+namespace aslam_cv_visualization {
+
+class VisualizationWorkerTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ncamera_ = aslam::NCamera::createTestNCamera(2u);
+  }
+
+  /// An nframe with black images and a keypoint in each frame.
+  aslam::VisualNFrame::Ptr createNFrame(int64_t timestamp_nanoseconds) const {
+    aslam::VisualNFrame::Ptr nframe =
+        aslam::VisualNFrame::createEmptyTestVisualNFrame(ncamera_, timestamp_nanoseconds);
+    for (size_t frame_idx = 0u; frame_idx < nframe->getNumFrames(); ++frame_idx) {
+      aslam::VisualFrame::Ptr frame = nframe->getFrameShared(frame_idx);
+      frame->setRawImage(cv::Mat::zeros(frame->getCameraGeometry()->imageHeight(),
+                                        frame->getCameraGeometry()->imageWidth(), CV_8UC1));
+      frame->setKeypointMeasurements(Eigen::Vector2d(100.0, 100.0));
+    }
+    return nframe;
+  }
+
+  /// Waits until the blocking render function was called num_started times.
+  void waitUntilRenderStarted(size_t num_started) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this, num_started]() { return num_render_started_ >= num_started; });
+  }
+
+  void openRender() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      is_render_open_ = true;
+    }
+    cv_.notify_all();
+  }
+
+  /// Renders the keypoints once openRender() was called.
+  VisualizationWorker::RenderFunction getBlockingRenderFunction() {
+    is_render_open_ = false;
+    num_render_started_ = 0u;
+    return [this](const aslam::VisualNFrame::ConstPtr& nframe, double image_scale,
+                  cv::Mat* image) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ++num_render_started_;
+      cv_.notify_all();
+      cv_.wait(lock, [this]() { return is_render_open_; });
+      lock.unlock();
+      visualizeKeypoints(nframe, image_scale, image);
+    };
+  }
+
+  /// Records the rendered nframes and images.
+  VisualizationWorker::ImageCallback getRecordingImageCallback() {
+    return [this](const aslam::VisualNFrame& nframe, const cv::Mat& image) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      rendered_ids_.push_back(nframe.getId());
+      rendered_keypoints_.push_back(nframe.getFrame(0u).getKeypointMeasurements());
+      // The worker reuses the image.
+      rendered_images_.push_back(image.clone());
+    };
+  }
+
+  static VisualizationWorker::Options getUnlimitedOptions() {
+    VisualizationWorker::Options options;
+    options.max_frame_rate_hz = 0.0;
+    options.nice_increment = 0;
+    return options;
+  }
+
+  aslam::NCamera::Ptr ncamera_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool is_render_open_;
+  size_t num_render_started_;
+  std::vector<aslam::NFramesId> rendered_ids_;
+  std::vector<Eigen::Matrix2Xd> rendered_keypoints_;
+  std::vector<cv::Mat> rendered_images_;
+};
+
+TEST_F(VisualizationWorkerTest, RendersTheSubmittedNFrames) {
+  VisualizationWorker worker(VisualizationWorker::getKeypointRenderFunction(),
+                             getRecordingImageCallback(), getUnlimitedOptions());
+  const aslam::VisualNFrame::Ptr nframe = createNFrame(0);
+  EXPECT_TRUE(worker.submit(*nframe));
+  worker.waitUntilIdle();
+  EXPECT_EQ(1u, worker.getNumRendered());
+  EXPECT_EQ(0u, worker.getNumDropped());
+
+  ASSERT_EQ(1u, rendered_ids_.size());
+  EXPECT_EQ(nframe->getId(), rendered_ids_[0]);
+  cv::Mat expected_image;
+  visualizeKeypoints(nframe, &expected_image);
+  ASSERT_EQ(expected_image.size(), rendered_images_[0].size());
+  EXPECT_EQ(0, cv::countNonZero((expected_image != rendered_images_[0]).reshape(1)));
+}
+
+TEST_F(VisualizationWorkerTest, DropsNFramesAboveTheMaxFrameRate) {
+  VisualizationWorker::Options options = getUnlimitedOptions();
+  // One image every 1000s.
+  options.max_frame_rate_hz = 1e-3;
+  VisualizationWorker worker(VisualizationWorker::getKeypointRenderFunction(),
+                             getRecordingImageCallback(), options);
+  EXPECT_TRUE(worker.submit(*createNFrame(0)));
+  EXPECT_FALSE(worker.submit(*createNFrame(1)));
+  EXPECT_FALSE(worker.submit(*createNFrame(2)));
+  worker.waitUntilIdle();
+  EXPECT_EQ(1u, worker.getNumRendered());
+  EXPECT_EQ(2u, worker.getNumDropped());
+  EXPECT_EQ(1u, rendered_ids_.size());
+}
+
+TEST_F(VisualizationWorkerTest, KeepsOnlyTheLatestPendingNFrame) {
+  VisualizationWorker worker(getBlockingRenderFunction(), getRecordingImageCallback(),
+                             getUnlimitedOptions());
+  const aslam::VisualNFrame::Ptr first_nframe = createNFrame(0);
+  EXPECT_TRUE(worker.submit(*first_nframe));
+  waitUntilRenderStarted(1u);
+
+  // The worker is behind, the second nframe is replaced by the third.
+  EXPECT_TRUE(worker.submit(*createNFrame(1)));
+  const aslam::VisualNFrame::Ptr third_nframe = createNFrame(2);
+  EXPECT_TRUE(worker.submit(*third_nframe));
+  EXPECT_EQ(1u, worker.getNumDropped());
+
+  openRender();
+  worker.waitUntilIdle();
+  EXPECT_EQ(2u, worker.getNumRendered());
+  EXPECT_EQ(1u, worker.getNumDropped());
+  ASSERT_EQ(2u, rendered_ids_.size());
+  EXPECT_EQ(first_nframe->getId(), rendered_ids_[0]);
+  EXPECT_EQ(third_nframe->getId(), rendered_ids_[1]);
+}
+
+TEST_F(VisualizationWorkerTest, DestructorRendersThePendingNFrame) {
+  const aslam::VisualNFrame::Ptr first_nframe = createNFrame(0);
+  const aslam::VisualNFrame::Ptr second_nframe = createNFrame(1);
+  {
+    VisualizationWorker worker(getBlockingRenderFunction(), getRecordingImageCallback(),
+                               getUnlimitedOptions());
+    EXPECT_TRUE(worker.submit(*first_nframe));
+    waitUntilRenderStarted(1u);
+    EXPECT_TRUE(worker.submit(*second_nframe));
+    openRender();
+  }
+  ASSERT_EQ(2u, rendered_ids_.size());
+  EXPECT_EQ(first_nframe->getId(), rendered_ids_[0]);
+  EXPECT_EQ(second_nframe->getId(), rendered_ids_[1]);
+}
+
+TEST_F(VisualizationWorkerTest, SnapshotIsIndependentOfLaterModifications) {
+  VisualizationWorker worker(getBlockingRenderFunction(), getRecordingImageCallback(),
+                             getUnlimitedOptions());
+  const aslam::VisualNFrame::Ptr nframe = createNFrame(0);
+  const Eigen::Matrix2Xd submitted_keypoints = nframe->getFrame(0u).getKeypointMeasurements();
+  EXPECT_TRUE(worker.submit(*nframe));
+
+  // The caller continues to process its frames while the worker renders.
+  nframe->getFrameShared(0u)->getKeypointMeasurementsMutable()->col(0) << 10.0, 20.0;
+  openRender();
+  worker.waitUntilIdle();
+
+  ASSERT_EQ(1u, rendered_keypoints_.size());
+  EXPECT_EQ(submitted_keypoints, rendered_keypoints_[0]);
+  EXPECT_EQ(Eigen::Vector2d(10.0, 20.0), nframe->getFrame(0u).getKeypointMeasurement(0u));
+}
+
+TEST_F(VisualizationWorkerTest, KeypointRenderFunctionScalesTheImage) {
+  const aslam::VisualNFrame::Ptr nframe = createNFrame(0);
+  const VisualizationWorker::RenderFunction render_function =
+      VisualizationWorker::getKeypointRenderFunction();
+
+  cv::Mat full_image;
+  render_function(nframe, 1.0, &full_image);
+  cv::Mat unscaled_image;
+  visualizeKeypoints(nframe, &unscaled_image);
+  ASSERT_EQ(unscaled_image.size(), full_image.size());
+  EXPECT_EQ(0, cv::countNonZero((unscaled_image != full_image).reshape(1)));
+  // The keypoint is drawn on the black image.
+  EXPECT_NE(cv::Vec3b(0, 0, 0), full_image.at<cv::Vec3b>(100, 100));
+
+  cv::Mat half_image;
+  render_function(nframe, 0.5, &half_image);
+  EXPECT_EQ(full_image.cols / 2, half_image.cols);
+  EXPECT_EQ(full_image.rows / 2, half_image.rows);
+  // The pixel centers of the keypoints are scaled.
+  EXPECT_NE(cv::Vec3b(0, 0, 0), half_image.at<cv::Vec3b>(49, 49));
+  EXPECT_EQ(cv::Vec3b(0, 0, 0), half_image.at<cv::Vec3b>(100, 100));
+}
+
+}  // namespace aslam_cv_visualization
+
+ASLAM_UNITTEST_ENTRYPOINT